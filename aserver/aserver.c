@@ -21,6 +21,8 @@
 #include <sys/shm.h>
 #include <sys/socket.h>
 #include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/un.h>
 #include <sys/uio.h>
 #include <stdio.h>
@@ -29,6 +31,7 @@
 #include <stddef.h>
 #include <getopt.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <netdb.h>
 #include <limits.h>
 #include <signal.h>
@@ -85,7 +88,7 @@ static int make_local_socket(const char *filename)
 static int make_inet_socket(int port)
 {
 	struct sockaddr_in addr;
-	int sock;
+	int sock, on = 1;
 
 	sock = socket(PF_INET, SOCK_STREAM, 0);
 	if (sock < 0) {
@@ -93,6 +96,8 @@ static int make_inet_socket(int port)
 		SYSERROR("socket failed");
 		return result;
 	}
+	/* restarting must not wait for the old connections to time out */
+	setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
 	
 	memset(&addr, 0, sizeof(addr));
 	addr.sin_family = AF_INET;
@@ -109,30 +114,46 @@ static int make_inet_socket(int port)
 	return sock;
 }
 
-struct pollfd *pollfds;
-unsigned int pollfds_count = 0;
+int epoll_fd = -1;
 typedef struct waiter waiter_t;
 typedef int (*waiter_handler_t)(waiter_t *waiter, unsigned short events);
 struct waiter {
 	int fd;
+	unsigned short events;
 	void *private_data;
 	waiter_handler_t handler;
 };
 waiter_t *waiters;
 
+#define WAITER_EVENTS_MAX	64
+
+/*
+ * epoll refuses regular files (the null plugin polls one), poll() reports
+ * them always ready: these are dispatched on every loop pass instead.
+ */
+int ready_fds[WAITER_EVENTS_MAX];
+unsigned int ready_count;
+
 static void add_waiter(int fd, unsigned short events, waiter_handler_t handler,
 		void *data)
 {
 	waiter_t *w = &waiters[fd];
-	struct pollfd *pfd = &pollfds[pollfds_count];
+	struct epoll_event ev;
 	assert(!w->handler);
-	pfd->fd = fd;
-	pfd->events = events;
-	pfd->revents = 0;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = events;	/* POLL* and EPOLL* bits are the same */
+	ev.data.fd = fd;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		if (errno != EPERM || ready_count >= WAITER_EVENTS_MAX) {
+			SYSERROR("epoll_ctl EPOLL_CTL_ADD failed");
+			return;
+		}
+		ready_fds[ready_count++] = fd;
+	}
 	w->fd = fd;
+	w->events = events;
 	w->private_data = data;
 	w->handler = handler;
-	pollfds_count++;
 }
 
 static void del_waiter(int fd)
@@ -141,13 +162,14 @@ static void del_waiter(int fd)
 	unsigned int k;
 	assert(w->handler);
 	w->handler = 0;
-	for (k = 0; k < pollfds_count; ++k) {
-		if (pollfds[k].fd == fd)
-			break;
+	for (k = 0; k < ready_count; k++) {
+		if (ready_fds[k] == fd) {
+			ready_fds[k] = ready_fds[--ready_count];
+			return;
+		}
 	}
-	assert(k < pollfds_count);
-	pollfds_count--;
-	memmove(&pollfds[k], &pollfds[k + 1], pollfds_count - k);
+	/* a closed descriptor is already gone from the epoll set */
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
 }
 
 typedef struct client client_t;
@@ -180,6 +202,8 @@ struct client {
 		struct {
 			snd_ctl_t *handle;
 			int fd;
+			int event_fd;		/* poll descriptor of a cache client */
+			int subscribed;		/* client wants the events */
 		} ctl;
 #if 0
 		struct {
@@ -204,6 +228,16 @@ struct client {
 			int ctrl_id;
 			void *ctrl;
 		} shm;
+		struct {
+			snd_pcm_shm_ctrl_t *ctrl;
+			char *buf;		/* frames on the wire */
+			size_t buf_size;
+			unsigned int epoch;
+			unsigned int seq;
+			snd_pcm_uframes_t appl;	/* capture appl_ptr of the client */
+			snd_pcm_uframes_t hw_sent;
+			int state_sent;
+		} tcp;
 	} transport;
 };
 
@@ -309,6 +343,7 @@ static int pcm_shm_open(client_t *client, int *cookie)
 		SYSERROR("shmat failed");
 		goto _err;
 	}
+	((snd_pcm_shm_ctrl_t *)client->transport.shm.ctrl)->ring.enabled = 1;
 	*cookie = shmid;
 	return 0;
 
@@ -387,36 +422,51 @@ static void async_handler(snd_async_handler_t *handler)
 	kill(client->async_pid, client->async_sig);
 }
 
-static int pcm_shm_cmd(client_t *client)
+/*
+ * Publish the PCM state for clients reading it directly from shm.
+ */
+static void pcm_shm_publish_state(client_t *client)
 {
 	volatile snd_pcm_shm_ctrl_t *ctrl = client->transport.shm.ctrl;
-	char buf[1];
-	int err;
-	int cmd;
-	snd_pcm_t *pcm;
-	err = read(client->ctrl_fd, buf, 1);
-	if (err != 1)
-		return -EBADFD;
-	cmd = ctrl->cmd;
-	ctrl->cmd = 0;
-	pcm = client->device.pcm.handle;
-	switch (cmd) {
-	case SND_PCM_IOCTL_ASYNC:
-		ctrl->result = snd_pcm_async(pcm, ctrl->u.async.sig, ctrl->u.async.pid);
-		if (ctrl->result < 0)
+
+	ctrl->ring.state = snd_pcm_state(client->device.pcm.handle);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	ctrl->ring.state_tail = ctrl->ring.tail;
+}
+
+/*
+ * Execute the commands queued in the ring, in order. Errors are kept in
+ * ring.error until the client picks them up.
+ */
+static void pcm_shm_ring_drain(client_t *client)
+{
+	volatile snd_pcm_shm_ctrl_t *ctrl = client->transport.shm.ctrl;
+	volatile snd_pcm_shm_ring_t *ring = &ctrl->ring;
+	snd_pcm_t *pcm = client->device.pcm.handle;
+	unsigned int tail = ring->tail;
+	snd_pcm_sframes_t err;
+
+	while (1) {
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (tail == ring->head)
 			break;
-		if (ctrl->u.async.sig >= 0) {
-			assert(client->async_sig < 0);
-			ctrl->result = snd_async_add_pcm_handler(&client->async_handler, pcm, async_handler, client);
-			if (ctrl->result < 0)
-				break;
-		} else {
-			assert(client->async_sig >= 0);
-			snd_async_del_handler(client->async_handler);
-		}
-		client->async_sig = ctrl->u.async.sig;
-		client->async_pid = ctrl->u.async.pid;
-		break;
+		err = snd_pcm_mmap_commit(pcm,
+				ring->cmd[tail % PCM_SHM_RING_SIZE].offset,
+				ring->cmd[tail % PCM_SHM_RING_SIZE].frames);
+		if (err < 0 && ring->error == 0)
+			ring->error = err;
+		ring->tail = ++tail;
+	}
+	pcm_shm_publish_state(client);
+}
+
+/*
+ * Execute the commands shared by the shm and the tcp transports.
+ * Returns -ENOSYS when the command is not one of them.
+ */
+static int pcm_run_cmd(snd_pcm_t *pcm, volatile snd_pcm_shm_ctrl_t *ctrl, int cmd)
+{
+	switch (cmd) {
 	case SNDRV_PCM_IOCTL_INFO:
 		ctrl->result = snd_pcm_info(pcm, (snd_pcm_info_t *) &ctrl->u.info);
 		break;
@@ -465,12 +515,6 @@ static int pcm_shm_cmd(client_t *client)
 	case SNDRV_PCM_IOCTL_PAUSE:
 		ctrl->result = snd_pcm_pause(pcm, ctrl->u.pause.enable);
 		break;
-	case SNDRV_PCM_IOCTL_CHANNEL_INFO:
-		ctrl->result = snd_pcm_channel_info(pcm, (snd_pcm_channel_info_t *) &ctrl->u.channel_info);
-		if (ctrl->result >= 0 &&
-		    ctrl->u.channel_info.type == SND_PCM_AREA_MMAP)
-			return shm_ack_fd(client, ctrl->u.channel_info.u.mmap.fd);
-		break;
 	case SNDRV_PCM_IOCTL_REWIND:
 		ctrl->result = snd_pcm_rewind(pcm, ctrl->u.rewind.frames);
 		break;
@@ -504,6 +548,51 @@ static int pcm_shm_cmd(client_t *client)
 						   ctrl->u.mmap_commit.offset,
 						   ctrl->u.mmap_commit.frames);
 		break;
+	default:
+		return -ENOSYS;
+	}
+	return 0;
+}
+
+static int pcm_shm_cmd(client_t *client)
+{
+	volatile snd_pcm_shm_ctrl_t *ctrl = client->transport.shm.ctrl;
+	char buf[1];
+	int err;
+	int cmd;
+	snd_pcm_t *pcm;
+	err = read(client->ctrl_fd, buf, 1);
+	if (err != 1)
+		return -EBADFD;
+	pcm_shm_ring_drain(client);
+	if (buf[0] == SND_PCM_SHM_RING_KICK)
+		return 0;
+	cmd = ctrl->cmd;
+	ctrl->cmd = 0;
+	pcm = client->device.pcm.handle;
+	switch (cmd) {
+	case SND_PCM_IOCTL_ASYNC:
+		ctrl->result = snd_pcm_async(pcm, ctrl->u.async.sig, ctrl->u.async.pid);
+		if (ctrl->result < 0)
+			break;
+		if (ctrl->u.async.sig >= 0) {
+			assert(client->async_sig < 0);
+			ctrl->result = snd_async_add_pcm_handler(&client->async_handler, pcm, async_handler, client);
+			if (ctrl->result < 0)
+				break;
+		} else {
+			assert(client->async_sig >= 0);
+			snd_async_del_handler(client->async_handler);
+		}
+		client->async_sig = ctrl->u.async.sig;
+		client->async_pid = ctrl->u.async.pid;
+		break;
+	case SNDRV_PCM_IOCTL_CHANNEL_INFO:
+		ctrl->result = snd_pcm_channel_info(pcm, (snd_pcm_channel_info_t *) &ctrl->u.channel_info);
+		if (ctrl->result >= 0 &&
+		    ctrl->u.channel_info.type == SND_PCM_AREA_MMAP)
+			return shm_ack_fd(client, ctrl->u.channel_info.u.mmap.fd);
+		break;
 	case SND_PCM_IOCTL_POLL_DESCRIPTOR:
 		ctrl->result = 0;
 		return shm_ack_fd(client, _snd_pcm_poll_descriptor(pcm));
@@ -515,9 +604,13 @@ static int pcm_shm_cmd(client_t *client)
 	case SND_PCM_IOCTL_APPL_PTR_FD:
 		return shm_rbptr_fd(client, &pcm->appl);
 	default:
-		ERROR("Bogus cmd: %x", ctrl->cmd);
-		ctrl->result = -ENOSYS;
+		if (pcm_run_cmd(pcm, ctrl, cmd) < 0) {
+			ERROR("Bogus cmd: %x", cmd);
+			ctrl->result = -ENOSYS;
+		}
 	}
+	if (client->open)
+		pcm_shm_publish_state(client);
 	return shm_ack(client);
 }
 
@@ -527,6 +620,299 @@ transport_ops_t pcm_shm_ops = {
 	.close	= pcm_shm_close,
 };
 
+static int tcp_read_full(int fd, void *buf, size_t len)
+{
+	char *p = buf;
+	ssize_t n;
+
+	while (len > 0) {
+		n = read(fd, p, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -EBADFD;
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int tcp_send(int fd, snd_pcm_tcp_msg_t *msg, const void *data)
+{
+	struct iovec iov[2];
+	int cnt = 1;
+	ssize_t n;
+
+	iov[0].iov_base = msg;
+	iov[0].iov_len = sizeof(*msg);
+	if (msg->len) {
+		iov[1].iov_base = (void *)data;
+		iov[1].iov_len = msg->len;
+		cnt = 2;
+	}
+	while (cnt > 0) {
+		n = writev(fd, iov, cnt);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -EBADFD;
+		while (cnt > 0 && (size_t) n >= iov[0].iov_len) {
+			n -= iov[0].iov_len;
+			iov[0] = iov[1];
+			cnt--;
+		}
+		if (cnt > 0) {
+			iov[0].iov_base = (char *)iov[0].iov_base + n;
+			iov[0].iov_len -= n;
+		}
+	}
+	return 0;
+}
+
+static int pcm_tcp_handler(waiter_t *waiter, unsigned short events);
+
+/*
+ * The slave descriptor is watched only while there may be something new
+ * to report; the handler stops watching when nothing changed.
+ */
+static void pcm_tcp_arm(client_t *client)
+{
+	snd_pcm_t *pcm = client->device.pcm.handle;
+
+	if (client->polling || client->device.pcm.fd < 0)
+		return;
+	add_waiter(client->device.pcm.fd, pcm->poll_events, pcm_tcp_handler, client);
+	client->polling = 1;
+}
+
+static void pcm_tcp_disarm(client_t *client)
+{
+	if (!client->polling)
+		return;
+	del_waiter(client->device.pcm.fd);
+	client->polling = 0;
+}
+
+/* the pointer the client sees as hw_ptr: frames played or sent to it */
+static snd_pcm_uframes_t pcm_tcp_hw_ptr(client_t *client)
+{
+	snd_pcm_t *pcm = client->device.pcm.handle;
+	snd_pcm_rbptr_t *rbptr;
+
+	rbptr = client->stream == SND_PCM_STREAM_PLAYBACK ? &pcm->hw : &pcm->appl;
+	return rbptr->ptr ? *rbptr->ptr : 0;
+}
+
+static snd_pcm_uframes_t pcm_tcp_appl_ptr(client_t *client)
+{
+	snd_pcm_t *pcm = client->device.pcm.handle;
+
+	if (client->stream == SND_PCM_STREAM_CAPTURE)
+		return client->transport.tcp.appl;
+	return pcm->appl.ptr ? *pcm->appl.ptr : 0;
+}
+
+/*
+ * Send the pointer update and, for capture, the frames the client has
+ * room for, in blocks of at least avail_min frames.
+ */
+static int pcm_tcp_handler(waiter_t *waiter, unsigned short events ATTRIBUTE_UNUSED)
+{
+	client_t *client = waiter->private_data;
+	snd_pcm_t *pcm = client->device.pcm.handle;
+	snd_pcm_sframes_t avail, room, frames = 0;
+	snd_pcm_uframes_t hw;
+	snd_pcm_tcp_msg_t msg;
+	int state;
+
+	avail = snd_pcm_avail_update(pcm);
+	state = snd_pcm_state(pcm);
+	if (client->stream == SND_PCM_STREAM_CAPTURE && avail > 0) {
+		room = *pcm->appl.ptr - client->transport.tcp.appl;
+		if (room < 0)
+			room += pcm->boundary;
+		room = pcm->buffer_size - room;
+		frames = avail < room ? avail : room;
+		if (frames < (snd_pcm_sframes_t) pcm->avail_min &&
+		    state == SND_PCM_STATE_RUNNING)
+			frames = 0;
+		if (frames > 0) {
+			frames = snd_pcm_readi(pcm, client->transport.tcp.buf, frames);
+			if (frames < 0)
+				frames = 0;
+			state = snd_pcm_state(pcm);
+		}
+	}
+	hw = pcm_tcp_hw_ptr(client);
+	if (!frames && hw == client->transport.tcp.hw_sent &&
+	    state == client->transport.tcp.state_sent) {
+		pcm_tcp_disarm(client);
+		return 0;
+	}
+	memset(&msg, 0, sizeof(msg));
+	msg.cmd = SND_PCM_TCP_POINTER;
+	msg.state = state;
+	msg.hw_ptr = hw;
+	msg.epoch = client->transport.tcp.epoch;
+	msg.seq = client->transport.tcp.seq;
+	msg.len = snd_pcm_frames_to_bytes(pcm, frames);
+	client->transport.tcp.hw_sent = hw;
+	client->transport.tcp.state_sent = state;
+	return tcp_send(client->poll_fd, &msg, client->transport.tcp.buf);
+}
+
+static int pcm_tcp_open(client_t *client, int *cookie)
+{
+	snd_pcm_t *pcm;
+	int err, on = 1;
+
+	err = snd_pcm_open(&pcm, client->name, client->stream, SND_PCM_NONBLOCK);
+	if (err < 0)
+		return err;
+	client->device.pcm.handle = pcm;
+	client->device.pcm.fd = _snd_pcm_poll_descriptor(pcm);
+	client->transport.tcp.ctrl = calloc(1, sizeof(snd_pcm_shm_ctrl_t));
+	if (!client->transport.tcp.ctrl) {
+		snd_pcm_close(pcm);
+		return -ENOMEM;
+	}
+	client->transport.tcp.state_sent = -1;
+	if (!client->local) {
+		setsockopt(client->ctrl_fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+		setsockopt(client->poll_fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	}
+	*cookie = 0;
+	return 0;
+}
+
+static int pcm_tcp_close(client_t *client)
+{
+	int err;
+
+	pcm_tcp_disarm(client);
+	err = snd_pcm_close(client->device.pcm.handle);
+	if (err < 0)
+		ERROR("snd_pcm_close");
+	free(client->transport.tcp.ctrl);
+	client->transport.tcp.ctrl = NULL;
+	free(client->transport.tcp.buf);
+	client->transport.tcp.buf = NULL;
+	client->transport.tcp.buf_size = 0;
+	client->open = 0;
+	return err;
+}
+
+static int pcm_tcp_write(client_t *client, snd_pcm_tcp_msg_t *msg)
+{
+	snd_pcm_t *pcm = client->device.pcm.handle;
+	snd_pcm_sframes_t frames, err;
+
+	if (msg->len > client->transport.tcp.buf_size)
+		return -EBADFD;
+	err = tcp_read_full(client->ctrl_fd, client->transport.tcp.buf, msg->len);
+	if (err < 0)
+		return err;
+	if (msg->epoch != client->transport.tcp.epoch)
+		return 0;
+	frames = snd_pcm_bytes_to_frames(pcm, msg->len);
+	err = snd_pcm_writei(pcm, client->transport.tcp.buf, frames);
+	if (err >= 0 && err < frames)
+		ERROR("%ld playback frames dropped", (long)(frames - err));
+	pcm_tcp_arm(client);
+	return 0;
+}
+
+static int pcm_tcp_cmd(client_t *client)
+{
+	snd_pcm_shm_ctrl_t *ctrl = client->transport.tcp.ctrl;
+	snd_pcm_t *pcm = client->device.pcm.handle;
+	snd_pcm_sw_params_t sw;
+	snd_pcm_uframes_t boundary;
+	snd_pcm_tcp_msg_t msg;
+	size_t size;
+	int cmd, err;
+
+	err = tcp_read_full(client->ctrl_fd, &msg, sizeof(msg));
+	if (err < 0)
+		return err;
+	cmd = msg.cmd;
+	switch (cmd) {
+	case SND_PCM_TCP_WRITE:
+		return pcm_tcp_write(client, &msg);
+	case SND_PCM_TCP_CONSUMED:
+		if (msg.epoch == client->transport.tcp.epoch)
+			client->transport.tcp.appl = msg.appl_ptr;
+		pcm_tcp_arm(client);
+		return 0;
+	}
+	size = snd_pcm_tcp_cmd_size(cmd);
+	if (msg.len != size)
+		return -EBADFD;
+	err = tcp_read_full(client->ctrl_fd, &ctrl->u, size);
+	if (err < 0)
+		return err;
+
+	switch (cmd) {
+	case SNDRV_PCM_IOCTL_SW_PARAMS:
+		/*
+		 * The client starts the stream, the queued frames must not;
+		 * the client keeps its own threshold.
+		 */
+		sw = ctrl->u.sw_params;
+		snd_pcm_sw_params_get_boundary(&sw, &boundary);
+		snd_pcm_sw_params_set_start_threshold(pcm, &sw, boundary);
+		ctrl->result = snd_pcm_sw_params(pcm, &sw);
+		break;
+	case SND_PCM_IOCTL_CLOSE:
+		memset(&msg, 0, sizeof(msg));
+		msg.cmd = cmd;
+		msg.result = client->ops->close(client);
+		return tcp_send(client->ctrl_fd, &msg, NULL);
+	default:
+		if (pcm_run_cmd(pcm, ctrl, cmd) < 0) {
+			ERROR("Bogus cmd: %x", cmd);
+			ctrl->result = -ENOSYS;
+		}
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.cmd = cmd;
+	msg.result = ctrl->result;
+	msg.len = size;
+	switch (cmd) {
+	case SNDRV_PCM_IOCTL_HW_PARAMS:
+		if (ctrl->result < 0)
+			break;
+		size = snd_pcm_frames_to_bytes(pcm, pcm->buffer_size);
+		free(client->transport.tcp.buf);
+		client->transport.tcp.buf = malloc(size);
+		client->transport.tcp.buf_size = client->transport.tcp.buf ? size : 0;
+		/* fall through */
+	case SNDRV_PCM_IOCTL_HW_FREE:
+	case SNDRV_PCM_IOCTL_PREPARE:
+	case SNDRV_PCM_IOCTL_RESET:
+	case SNDRV_PCM_IOCTL_DROP:
+		client->transport.tcp.epoch++;
+		client->transport.tcp.appl = pcm->appl.ptr ? *pcm->appl.ptr : 0;
+		break;
+	}
+	msg.state = snd_pcm_state(pcm);
+	msg.hw_ptr = pcm_tcp_hw_ptr(client);
+	msg.appl_ptr = pcm_tcp_appl_ptr(client);
+	msg.epoch = client->transport.tcp.epoch;
+	msg.seq = ++client->transport.tcp.seq;
+	client->transport.tcp.hw_sent = msg.hw_ptr;
+	client->transport.tcp.state_sent = msg.state;
+	pcm_tcp_arm(client);
+	return tcp_send(client->ctrl_fd, &msg, &ctrl->u);
+}
+
+transport_ops_t pcm_tcp_ops = {
+	.open	= pcm_tcp_open,
+	.cmd	= pcm_tcp_cmd,
+	.close	= pcm_tcp_close,
+};
+
 static int ctl_handler(waiter_t *waiter, unsigned short events)
 {
 	client_t *client = waiter->private_data;
@@ -544,6 +930,116 @@ static int ctl_handler(waiter_t *waiter, unsigned short events)
 	return 0;
 }
 
+/*
+ * Update the cache slot of numid: value NULL empties it.
+ */
+static void ctl_shm_cache_store(client_t *client, unsigned int numid,
+				const snd_ctl_elem_value_t *value)
+{
+	volatile snd_ctl_shm_cache_t *cache = CTL_SHM_CACHE(client->transport.shm.ctrl);
+	volatile snd_ctl_shm_value_t *slot = &cache->values[numid % CTL_SHM_VALUES];
+
+	if (numid == 0 || (!value && slot->numid != numid))
+		return;
+	slot->seq++;
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	slot->numid = value ? numid : 0;
+	if (value)
+		memcpy((void *)&slot->value, value, sizeof(*value));
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	slot->seq++;
+}
+
+static void ctl_shm_cache_refresh(client_t *client, unsigned int numid)
+{
+	volatile snd_ctl_shm_cache_t *cache = CTL_SHM_CACHE(client->transport.shm.ctrl);
+	snd_ctl_elem_value_t value;
+
+	if (numid == 0 || cache->values[numid % CTL_SHM_VALUES].numid != numid)
+		return;
+	memset(&value, 0, sizeof(value));
+	value.id.numid = numid;
+	if (snd_ctl_elem_read(client->device.ctl.handle, &value) < 0)
+		ctl_shm_cache_store(client, numid, NULL);
+	else
+		ctl_shm_cache_store(client, numid, &value);
+}
+
+/*
+ * Read all pending events of the device: refresh the cached values they
+ * touch and queue them for the client when it is subscribed.
+ */
+static void ctl_shm_events(client_t *client)
+{
+	volatile snd_ctl_shm_cache_t *cache = CTL_SHM_CACHE(client->transport.shm.ctrl);
+	snd_ctl_event_t event;
+	unsigned int numid, head;
+	int queued = 0;
+
+	while (snd_ctl_read(client->device.ctl.handle, &event) > 0) {
+		if (event.type == SNDRV_CTL_EVENT_ELEM) {
+			numid = event.data.elem.id.numid;
+			if (event.data.elem.mask == SNDRV_CTL_EVENT_MASK_REMOVE)
+				ctl_shm_cache_store(client, numid, NULL);
+			else if (event.data.elem.mask & (SNDRV_CTL_EVENT_MASK_VALUE |
+							 SNDRV_CTL_EVENT_MASK_INFO))
+				ctl_shm_cache_refresh(client, numid);
+		}
+		if (!client->device.ctl.subscribed)
+			continue;
+		head = cache->event_head;
+		if (head - cache->event_tail >= CTL_SHM_EVENTS) {
+			cache->event_lost++;
+			continue;
+		}
+		memcpy((void *)&cache->events[head % CTL_SHM_EVENTS], &event, sizeof(event));
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		cache->event_head = head + 1;
+		queued = 1;
+	}
+	if (queued)
+		eventfd_write(client->device.ctl.event_fd, 1);
+}
+
+static int ctl_shm_event_handler(waiter_t *waiter, unsigned short events ATTRIBUTE_UNUSED)
+{
+	ctl_shm_events(waiter->private_data);
+	return 0;
+}
+
+/*
+ * Execute the queued writes, in order. The events they cause are taken
+ * before the tail moves, so the cache is current once the queue is seen
+ * empty. A client kicks only when it sees the tail at its old head, so
+ * the head is checked again after the tail is published: a write queued
+ * meanwhile either sees the new tail and kicks, or is found here.
+ */
+static void ctl_shm_write_drain(client_t *client)
+{
+	volatile snd_ctl_shm_cache_t *cache = CTL_SHM_CACHE(client->transport.shm.ctrl);
+	snd_ctl_t *ctl = client->device.ctl.handle;
+	unsigned int tail = cache->write_tail;
+	snd_ctl_elem_value_t value;
+	int err, expected;
+
+	while (tail != __atomic_load_n(&cache->write_head, __ATOMIC_ACQUIRE)) {
+		do {
+			memcpy(&value, (void *)&cache->writes[tail % CTL_SHM_WRITES], sizeof(value));
+			err = snd_ctl_elem_write(ctl, &value);
+			expected = 0;
+			if (err < 0)
+				__atomic_compare_exchange_n(&cache->write_error, &expected, err, 0,
+							    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+			ctl_shm_cache_refresh(client, value.id.numid);
+			tail++;
+		} while (tail != __atomic_load_n(&cache->write_head, __ATOMIC_ACQUIRE));
+		ctl_shm_events(client);
+		__atomic_store_n(&cache->write_tail, tail, __ATOMIC_SEQ_CST);
+		/* pairs with the head store and tail load of the client */
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	}
+}
+
 static int ctl_shm_open(client_t *client, int *cookie)
 {
 	int shmid;
@@ -555,8 +1051,9 @@ static int ctl_shm_open(client_t *client, int *cookie)
 		return err;
 	client->device.ctl.handle = ctl;
 	client->device.ctl.fd = _snd_ctl_poll_descriptor(ctl);
+	client->device.ctl.subscribed = 0;
 
-	shmid = shmget(IPC_PRIVATE, CTL_SHM_SIZE, 0666);
+	shmid = shmget(IPC_PRIVATE, CTL_SHM_CACHE_SIZE, 0666);
 	if (shmid < 0) {
 		result = -errno;
 		SYSERROR("shmget failed");
@@ -571,7 +1068,18 @@ static int ctl_shm_open(client_t *client, int *cookie)
 		goto _err;
 	}
 	*cookie = shmid;
-	add_waiter(client->device.ctl.fd, POLLIN, ctl_handler, client);
+	/* the cache needs the value events, whoever subscribes */
+	client->device.ctl.event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (client->device.ctl.event_fd >= 0 &&
+	    snd_ctl_subscribe_events(ctl, 1) >= 0) {
+		CTL_SHM_CACHE(client->transport.shm.ctrl)->enabled = 1;
+		add_waiter(client->device.ctl.fd, POLLIN, ctl_shm_event_handler, client);
+	} else {
+		if (client->device.ctl.event_fd >= 0)
+			close(client->device.ctl.event_fd);
+		client->device.ctl.event_fd = -1;
+		add_waiter(client->device.ctl.fd, POLLIN, ctl_handler, client);
+	}
 	client->polling = 1;
 	return 0;
 
@@ -593,6 +1101,10 @@ static int ctl_shm_close(client_t *client)
 	ctrl->result = err;
 	if (err < 0) 
 		ERROR("snd_ctl_close");
+	if (client->device.ctl.event_fd >= 0) {
+		close(client->device.ctl.event_fd);
+		client->device.ctl.event_fd = -1;
+	}
 	if (client->transport.shm.ctrl) {
 		err = shmdt((void *)client->transport.shm.ctrl);
 		if (err < 0)
@@ -609,6 +1121,7 @@ static int ctl_shm_close(client_t *client)
 static int ctl_shm_cmd(client_t *client)
 {
 	snd_ctl_shm_ctrl_t *ctrl = client->transport.shm.ctrl;
+	volatile snd_ctl_shm_cache_t *cache;
 	char buf[1];
 	int err;
 	int cmd;
@@ -616,6 +1129,11 @@ static int ctl_shm_cmd(client_t *client)
 	err = read(client->ctrl_fd, buf, 1);
 	if (err != 1)
 		return -EBADFD;
+	cache = client->device.ctl.event_fd >= 0 ? CTL_SHM_CACHE(ctrl) : NULL;
+	if (cache)
+		ctl_shm_write_drain(client);
+	if (buf[0] == SND_CTL_SHM_WRITE_KICK)
+		return 0;
 	cmd = ctrl->cmd;
 	ctrl->cmd = 0;
 	ctl = client->device.ctl.handle;
@@ -638,7 +1156,14 @@ static int ctl_shm_cmd(client_t *client)
 		break;
 		break;
 	case SNDRV_CTL_IOCTL_SUBSCRIBE_EVENTS:
-		ctrl->result = snd_ctl_subscribe_events(ctl, ctrl->u.subscribe_events);
+		if (!cache) {
+			ctrl->result = snd_ctl_subscribe_events(ctl, ctrl->u.subscribe_events);
+			break;
+		}
+		/* the handle itself stays subscribed for the cache */
+		if (ctrl->u.subscribe_events >= 0)
+			client->device.ctl.subscribed = ctrl->u.subscribe_events > 0;
+		ctrl->result = ctrl->u.subscribe_events < 0 ? client->device.ctl.subscribed : 0;
 		break;
 	case SNDRV_CTL_IOCTL_CARD_INFO:
 		ctrl->result = snd_ctl_card_info(ctl, &ctrl->u.card_info);
@@ -659,9 +1184,14 @@ static int ctl_shm_cmd(client_t *client)
 		break;
 	case SNDRV_CTL_IOCTL_ELEM_READ:
 		ctrl->result = snd_ctl_elem_read(ctl, &ctrl->u.element_read);
+		if (cache && ctrl->result >= 0)
+			ctl_shm_cache_store(client, ctrl->u.element_read.id.numid,
+					    &ctrl->u.element_read);
 		break;
 	case SNDRV_CTL_IOCTL_ELEM_WRITE:
 		ctrl->result = snd_ctl_elem_write(ctl, &ctrl->u.element_write);
+		if (cache)
+			ctl_shm_cache_refresh(client, ctrl->u.element_write.id.numid);
 		break;
 	case SNDRV_CTL_IOCTL_ELEM_LOCK:
 		ctrl->result = snd_ctl_elem_lock(ctl, &ctrl->u.element_lock);
@@ -700,13 +1230,30 @@ static int ctl_shm_cmd(client_t *client)
 		ctrl->result = snd_ctl_get_power_state(ctl, &ctrl->u.power_state);
 		break;
 	case SND_CTL_IOCTL_READ:
-		ctrl->result = snd_ctl_read(ctl, &ctrl->u.read);
+		if (!cache) {
+			ctrl->result = snd_ctl_read(ctl, &ctrl->u.read);
+			break;
+		}
+		ctl_shm_events(client);
+		if (cache->event_tail == cache->event_head) {
+			ctrl->result = -EAGAIN;
+			break;
+		}
+		ctrl->u.read = cache->events[cache->event_tail % CTL_SHM_EVENTS];
+		cache->event_tail++;
+		if (cache->event_tail == cache->event_head) {
+			eventfd_t val;
+			eventfd_read(client->device.ctl.event_fd, &val);
+		}
+		ctrl->result = 1;
 		break;
 	case SND_CTL_IOCTL_CLOSE:
 		client->ops->close(client);
 		break;
 	case SND_CTL_IOCTL_POLL_DESCRIPTOR:
 		ctrl->result = 0;
+		if (cache)
+			return shm_ack_fd(client, client->device.ctl.event_fd);
 		return shm_ack_fd(client, _snd_ctl_poll_descriptor(ctl));
 	default:
 		ERROR("Bogus cmd: %x", ctrl->cmd);
@@ -766,6 +1313,13 @@ static int snd_client_open(client_t *client)
 			goto _answer;
 		}
 		break;
+	case SND_TRANSPORT_TYPE_TCP:
+		if (req.dev_type != SND_DEV_TYPE_PCM) {
+			ans.result = -EINVAL;
+			goto _answer;
+		}
+		client->ops = &pcm_tcp_ops;
+		break;
 	default:
 		ans.result = -EINVAL;
 		goto _answer;
@@ -817,6 +1371,11 @@ static int client_ctrl_handler(waiter_t *waiter, unsigned short events)
 			client->ops->close(client);
 		close(client->ctrl_fd);
 		del_waiter(client->ctrl_fd);
+		/* an inet client has a second connection watched for hangup */
+		if (!client->local) {
+			close(client->poll_fd);
+			del_waiter(client->poll_fd);
+		}
 		list_del(&client->list);
 		free(client);
 		return 0;
@@ -930,8 +1489,16 @@ static int server(const char *sockname, int port)
 		SYSERROR("sysconf failed");
 		return result;
 	}
-	pollfds = calloc((size_t) open_max, sizeof(*pollfds));
 	waiters = calloc((size_t) open_max, sizeof(*waiters));
+	if (!waiters)
+		return -ENOMEM;
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd < 0) {
+		result = -errno;
+		SYSERROR("epoll_create1 failed");
+		free(waiters);
+		return result;
+	}
 
 	if (sockname) {
 		sockn = make_local_socket(sockname);
@@ -967,28 +1534,29 @@ static int server(const char *sockname, int port)
 	}
 
 	while (1) {
-		struct pollfd pfds[open_max];
-		size_t pfds_count;
-		do {
-			err = poll(pollfds, pollfds_count, -1);
-		} while (err == 0);
-		if (err < 0) {
-			SYSERROR("poll failed");
+		struct epoll_event events[WAITER_EVENTS_MAX];
+		int count;
+		count = epoll_wait(epoll_fd, events, WAITER_EVENTS_MAX,
+				   ready_count ? 0 : -1);
+		if (count < 0) {
+			if (errno != EINTR)
+				SYSERROR("epoll_wait failed");
 			continue;
 		}
 
-		pfds_count = pollfds_count;
-		memcpy(pfds, pollfds, sizeof(*pfds) * pfds_count);
-		for (k = 0; k < pfds_count; k++) {
-			struct pollfd *pfd = &pfds[k];
-			if (pfd->revents) {
-				waiter_t *w = &waiters[pfd->fd];
-				if (!w->handler)
-					continue;
-				err = w->handler(w, pfd->revents);
-				if (err < 0)
-					ERROR("waiter handler failed");
-			}
+		for (k = 0; k < (unsigned int) count; k++) {
+			waiter_t *w = &waiters[events[k].data.fd];
+			if (!w->handler)
+				continue;
+			err = w->handler(w, events[k].events);
+			if (err < 0)
+				ERROR("waiter handler failed");
+		}
+		for (k = ready_count; k-- > 0; ) {
+			waiter_t *w = &waiters[ready_fds[k]];
+			err = w->handler(w, w->events);
+			if (err < 0)
+				ERROR("waiter handler failed");
 		}
 	}
  _end:
@@ -996,7 +1564,7 @@ static int server(const char *sockname, int port)
 		close(sockn);
 	if (socki >= 0)
 		close(socki);
-	free(pollfds);
+	close(epoll_fd);
 	free(waiters);
 	return result;
 }
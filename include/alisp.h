@@ -31,6 +31,15 @@ struct alisp_cfg {
 	snd_output_t *dout;	/* debug output */
 };
 
+struct alisp_stats {
+	long used_objs;		/* live objects */
+	long free_objs;		/* objects ready for reuse */
+	long max_objs;		/* peak of used + free objects */
+	long slabs;		/* allocated object slabs */
+	long gc_runs;		/* collector passes */
+	long gc_freed;		/* objects reclaimed by the collector */
+};
+
 struct alisp_instance;
 struct alisp_object;
 struct alisp_seq_iterator;
@@ -38,6 +47,10 @@ struct alisp_seq_iterator;
 struct alisp_cfg *alsa_lisp_default_cfg(snd_input_t *input);
 void alsa_lisp_default_cfg_free(struct alisp_cfg *cfg);
 int alsa_lisp(struct alisp_cfg *cfg, struct alisp_instance **instance);
+int alsa_lisp_file(struct alisp_cfg *cfg, const char *filename,
+		   struct alisp_instance **instance);
+void alsa_lisp_code_cache_free(void);
+int alsa_lisp_get_stats(struct alisp_instance *instance, struct alisp_stats *stats);
 void alsa_lisp_free(struct alisp_instance *instance);
 int alsa_lisp_function(struct alisp_instance *instance, struct alisp_seq_iterator **result,
 		       const char *id, const char *args, ...)
@@ -51,6 +51,9 @@ typedef enum _snd_transport_type {
 #define SND_PCM_IOCTL_APPL_PTR_FD	_IO ('A', 0xfa)
 #define SND_PCM_IOCTL_FORWARD		_IO ('A', 0xfb)
 
+/* request byte which only tells the server to drain the command ring */
+#define SND_PCM_SHM_RING_KICK		'k'
+
 typedef struct {
 	snd_pcm_uframes_t ptr;
 	int use_mmap;
@@ -58,11 +61,32 @@ typedef struct {
 	int changed;
 } snd_pcm_shm_rbptr_t;
 
+#define PCM_SHM_RING_SIZE	64
+
+/*
+ * Commands queued by the client without a socket round trip. The client
+ * owns head, the server owns tail; the server drains the ring when it is
+ * kicked and before executing any synchronous command.
+ */
+typedef struct {
+	int enabled;		/* set by the server */
+	int state;		/* PCM state after the last server action */
+	unsigned int state_tail;	/* tail at the time state was taken */
+	unsigned int head;
+	unsigned int tail;
+	long error;		/* first failure of a queued command */
+	struct {
+		snd_pcm_uframes_t offset;
+		snd_pcm_uframes_t frames;
+	} cmd[PCM_SHM_RING_SIZE];
+} snd_pcm_shm_ring_t;
+
 typedef struct {
 	long result;
 	int cmd;
 	snd_pcm_shm_rbptr_t hw;
 	snd_pcm_shm_rbptr_t appl;
+	snd_pcm_shm_ring_t ring;
 	union {
 		struct {
 			int sig;
@@ -106,6 +130,58 @@ typedef struct {
 } snd_pcm_shm_ctrl_t;
 
 #define PCM_SHM_SIZE sizeof(snd_pcm_shm_ctrl_t)
+
+/*
+ * TCP transport for PCM. The client opens two connections: the first
+ * one carries the pointer updates and the capture frames from the
+ * server, the second one the commands and the playback frames. Every
+ * message starts with snd_pcm_tcp_msg_t in the native layout (both ends
+ * must share the ABI, as with the shm area). Synchronous commands carry
+ * the ioctl code and the matching snd_pcm_shm_ctrl_t.u member as
+ * payload and get an answer of the same shape; the messages below get
+ * no answer.
+ */
+#define SND_PCM_TCP_WRITE		_IO ('A', 0xe0)	/* playback frames */
+#define SND_PCM_TCP_CONSUMED		_IO ('A', 0xe1)	/* capture appl_ptr */
+#define SND_PCM_TCP_POINTER		_IO ('A', 0xe2)	/* server: hw_ptr */
+
+typedef struct {
+	int32_t cmd;
+	int32_t state;
+	int64_t result;
+	uint64_t hw_ptr;
+	uint64_t appl_ptr;
+	uint32_t epoch;		/* incremented when the pointers are reset */
+	uint32_t len;		/* payload bytes following the header */
+	uint32_t seq;		/* commands done when the message was sent */
+	uint32_t pad;
+} snd_pcm_tcp_msg_t;
+
+static inline size_t snd_pcm_tcp_cmd_size(int cmd)
+{
+	switch (cmd) {
+	case SNDRV_PCM_IOCTL_INFO:
+		return sizeof(snd_pcm_info_t);
+	case SNDRV_PCM_IOCTL_HW_REFINE:
+	case SNDRV_PCM_IOCTL_HW_PARAMS:
+		return sizeof(snd_pcm_hw_params_t);
+	case SNDRV_PCM_IOCTL_SW_PARAMS:
+		return sizeof(snd_pcm_sw_params_t);
+	case SNDRV_PCM_IOCTL_STATUS:
+		return sizeof(snd_pcm_status_t);
+	case SNDRV_PCM_IOCTL_DELAY:
+		return sizeof(snd_pcm_sframes_t);
+	case SNDRV_PCM_IOCTL_PAUSE:
+		return sizeof(int);
+	default:
+		return 0;
+	}
+}
+
+#define snd_pcm_shm_tcp_open snd1_pcm_shm_tcp_open
+int snd_pcm_shm_tcp_open(snd_pcm_t **pcmp, const char *name,
+			 const char *host, int port, const char *sname,
+			 snd_pcm_stream_t stream, int mode, int nodelay);
 		
 #define SND_CTL_IOCTL_READ		_IOR('U', 0xf1, snd_ctl_event_t)
 #define SND_CTL_IOCTL_CLOSE		_IO ('U', 0xf2)
@@ -143,6 +219,44 @@ typedef struct {
 #define CTL_SHM_SIZE 65536
 #define CTL_SHM_DATA_MAXLEN (CTL_SHM_SIZE - offsetof(snd_ctl_shm_ctrl_t, data))
 
+#define CTL_SHM_VALUES		64	/* cached values, direct mapped by numid */
+#define CTL_SHM_EVENTS		64
+#define CTL_SHM_WRITES		16
+
+/* request byte which only tells the server to execute the queued writes */
+#define SND_CTL_SHM_WRITE_KICK		'k'
+
+typedef struct {
+	unsigned int seq;	/* odd while the server updates the slot */
+	unsigned int numid;	/* 0 = empty */
+	snd_ctl_elem_value_t value;
+} snd_ctl_shm_value_t;
+
+/*
+ * Follows the CTL_SHM_SIZE bytes of snd_ctl_shm_ctrl_t in the same
+ * segment. The server keeps the values read so far up to date from the
+ * element events, queues the events for a subscribed client and signals
+ * them on the poll descriptor; the client owns event_tail and
+ * write_head, the server the other indexes. Queued writes only kick the
+ * server, which drains them before executing any synchronous command.
+ */
+typedef struct {
+	int enabled;		/* set by the server */
+	unsigned int event_head;
+	unsigned int event_tail;
+	unsigned int event_lost;	/* dropped on a full ring */
+	unsigned int write_head;
+	unsigned int write_tail;
+	int write_error;	/* first failure of a queued write */
+	snd_ctl_shm_value_t values[CTL_SHM_VALUES];
+	snd_ctl_event_t events[CTL_SHM_EVENTS];
+	snd_ctl_elem_value_t writes[CTL_SHM_WRITES];
+} snd_ctl_shm_cache_t;
+
+#define CTL_SHM_CACHE(ctrl) \
+	((volatile snd_ctl_shm_cache_t *)((volatile char *)(ctrl) + CTL_SHM_SIZE))
+#define CTL_SHM_CACHE_SIZE (CTL_SHM_SIZE + sizeof(snd_ctl_shm_cache_t))
+
 typedef struct {
 	unsigned char dev_type;
 	unsigned char transport_type;
@@ -92,6 +92,7 @@ int snd_config_load(snd_config_t *config, snd_input_t *in);
 int snd_config_load_string(snd_config_t **config, const char *s, size_t size);
 int snd_config_load_override(snd_config_t *config, snd_input_t *in);
 int snd_config_save(snd_config_t *config, snd_output_t *out);
+int snd_config_save_compact(snd_config_t *config, snd_output_t *out);
 int snd_config_update(void);
 int snd_config_update_r(snd_config_t **top, snd_config_update_t **update, const char *path);
 int snd_config_update_free(snd_config_update_t *update);
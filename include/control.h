@@ -345,6 +345,8 @@ typedef enum _snd_ctl_type {
 	SND_CTL_TYPE_EXT,
 	/** Control functionality remapping */
 	SND_CTL_TYPE_REMAP,
+	/** Shared memory mirror of the control values */
+	SND_CTL_TYPE_MIRROR,
 } snd_ctl_type_t;
 
 /** Non blocking mode (flag for open mode) \hideinitializer */
@@ -365,6 +367,9 @@ typedef struct _snd_ctl snd_ctl_t;
 /** SCTL type */
 typedef struct _snd_sctl snd_sctl_t;
 
+/** Monitor of the device name hints */
+typedef struct _snd_device_name_monitor snd_device_name_monitor_t;
+
 int snd_card_load(int card);
 int snd_card_next(int *card);
 int snd_card_get_index(const char *name);
@@ -374,6 +379,11 @@ int snd_card_get_longname(int card, char **name);
 int snd_device_name_hint(int card, const char *iface, void ***hints);
 int snd_device_name_free_hint(void **hints);
 char *snd_device_name_get_hint(const void *hint, const char *id);
+int snd_device_name_monitor_open(snd_device_name_monitor_t **monitor, int card, const char *iface);
+int snd_device_name_monitor_close(snd_device_name_monitor_t *monitor);
+int snd_device_name_monitor_poll_descriptors_count(snd_device_name_monitor_t *monitor);
+int snd_device_name_monitor_poll_descriptors(snd_device_name_monitor_t *monitor, struct pollfd *pfds, unsigned int space);
+int snd_device_name_monitor_read(snd_device_name_monitor_t *monitor, void ***added, void ***removed);
 
 int snd_ctl_open(snd_ctl_t **ctl, const char *name, int mode);
 int snd_ctl_open_lconf(snd_ctl_t **ctl, const char *name, int mode, snd_config_t *lconf);
@@ -383,6 +393,9 @@ int snd_ctl_nonblock(snd_ctl_t *ctl, int nonblock);
 static __inline__ int snd_ctl_abort(snd_ctl_t *ctl) { return snd_ctl_nonblock(ctl, 2); }
 int snd_async_add_ctl_handler(snd_async_handler_t **handler, snd_ctl_t *ctl, 
 			      snd_async_callback_t callback, void *private_data);
+int snd_reactor_add_ctl(snd_reactor_t *reactor, snd_reactor_handle_t **handle,
+			snd_ctl_t *ctl, snd_reactor_callback_t callback,
+			void *private_data);
 snd_ctl_t *snd_async_handler_get_ctl(snd_async_handler_t *handler);
 int snd_ctl_poll_descriptors_count(snd_ctl_t *ctl);
 int snd_ctl_poll_descriptors(snd_ctl_t *ctl, struct pollfd *pfds, unsigned int space);
@@ -393,6 +406,8 @@ int snd_ctl_elem_list(snd_ctl_t *ctl, snd_ctl_elem_list_t *list);
 int snd_ctl_elem_info(snd_ctl_t *ctl, snd_ctl_elem_info_t *info);
 int snd_ctl_elem_read(snd_ctl_t *ctl, snd_ctl_elem_value_t *data);
 int snd_ctl_elem_write(snd_ctl_t *ctl, snd_ctl_elem_value_t *data);
+int snd_ctl_elem_read_multi(snd_ctl_t *ctl, snd_ctl_elem_value_t **data, unsigned int count);
+int snd_ctl_elem_write_multi(snd_ctl_t *ctl, snd_ctl_elem_value_t **data, unsigned int count);
 int snd_ctl_elem_lock(snd_ctl_t *ctl, snd_ctl_elem_id_t *id);
 int snd_ctl_elem_unlock(snd_ctl_t *ctl, snd_ctl_elem_id_t *id);
 int snd_ctl_elem_tlv_read(snd_ctl_t *ctl, const snd_ctl_elem_id_t *id,
@@ -613,6 +628,25 @@ int snd_ctl_add_bytes_elem_set(snd_ctl_t *ctl, snd_ctl_elem_info_t *info,
 			       unsigned int element_count,
 			       unsigned int member_count);
 
+/** Element set to be created by #snd_ctl_add_elem_sets() */
+typedef struct snd_ctl_elem_set_desc {
+	snd_ctl_elem_info_t *info;	/**< ID of the first element and access; filled on return */
+	snd_ctl_elem_type_t type;	/**< Element type */
+	unsigned int element_count;	/**< Number of elements in the set */
+	unsigned int member_count;	/**< Number of members in each element */
+	long long min;			/**< Minimum value (integer, integer64) */
+	long long max;			/**< Maximum value (integer, integer64) */
+	long long step;			/**< Step (integer, integer64) */
+	unsigned int items;		/**< Number of items (enumerated) */
+	const char *const *labels;	/**< Item labels (enumerated) */
+	const unsigned int *tlv;	/**< TLV data of the set or NULL */
+	const snd_ctl_elem_value_t *value; /**< Initial value of each element or NULL */
+	int result;			/**< Zero or a negative error code; filled on return */
+} snd_ctl_elem_set_desc_t;
+
+int snd_ctl_add_elem_sets(snd_ctl_t *ctl, snd_ctl_elem_set_desc_t *descs,
+			  unsigned int count);
+
 int snd_ctl_elem_add_integer(snd_ctl_t *ctl, const snd_ctl_elem_id_t *id, unsigned int count, long imin, long imax, long istep);
 int snd_ctl_elem_add_integer64(snd_ctl_t *ctl, const snd_ctl_elem_id_t *id, unsigned int count, long long imin, long long imax, long long istep);
 int snd_ctl_elem_add_boolean(snd_ctl_t *ctl, const snd_ctl_elem_id_t *id, unsigned int count);
@@ -746,6 +780,8 @@ void *snd_hctl_get_callback_private(snd_hctl_t *hctl);
 int snd_hctl_load(snd_hctl_t *hctl);
 int snd_hctl_free(snd_hctl_t *hctl);
 int snd_hctl_handle_events(snd_hctl_t *hctl);
+int snd_hctl_set_coalesce(snd_hctl_t *hctl, int enable, unsigned int interval);
+int snd_hctl_coalesce_timeout(snd_hctl_t *hctl);
 const char *snd_hctl_name(snd_hctl_t *hctl);
 int snd_hctl_wait(snd_hctl_t *hctl, int timeout);
 snd_ctl_t *snd_hctl_ctl(snd_hctl_t *hctl);
@@ -754,10 +790,15 @@ snd_hctl_elem_t *snd_hctl_elem_next(snd_hctl_elem_t *elem);
 snd_hctl_elem_t *snd_hctl_elem_prev(snd_hctl_elem_t *elem);
 int snd_hctl_elem_info(snd_hctl_elem_t *elem, snd_ctl_elem_info_t * info);
 int snd_hctl_elem_read(snd_hctl_elem_t *elem, snd_ctl_elem_value_t * value);
+int snd_hctl_elem_read_multi(snd_hctl_elem_t **elems, snd_ctl_elem_value_t **values, unsigned int count);
 int snd_hctl_elem_write(snd_hctl_elem_t *elem, snd_ctl_elem_value_t * value);
+int snd_hctl_elem_write_multi(snd_hctl_elem_t **elems, snd_ctl_elem_value_t **values, unsigned int count);
 int snd_hctl_elem_tlv_read(snd_hctl_elem_t *elem, unsigned int *tlv, unsigned int tlv_size);
 int snd_hctl_elem_tlv_write(snd_hctl_elem_t *elem, const unsigned int *tlv);
 int snd_hctl_elem_tlv_command(snd_hctl_elem_t *elem, const unsigned int *tlv);
+int snd_hctl_elem_get_dB_range(snd_hctl_elem_t *elem, long *min, long *max);
+int snd_hctl_elem_convert_to_dB(snd_hctl_elem_t *elem, long volume, long *db_gain);
+int snd_hctl_elem_convert_from_dB(snd_hctl_elem_t *elem, long db_gain, long *value, int xdir);
 
 snd_hctl_t *snd_hctl_elem_get_hctl(snd_hctl_elem_t *elem);
 
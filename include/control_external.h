@@ -74,7 +74,7 @@ typedef int (snd_ctl_ext_tlv_rw_t)(snd_ctl_ext_t *ext, snd_ctl_ext_key_t key, in
  */
 #define SND_CTL_EXT_VERSION_MAJOR	1	/**< Protocol major version */
 #define SND_CTL_EXT_VERSION_MINOR	0	/**< Protocol minor version */
-#define SND_CTL_EXT_VERSION_TINY	1	/**< Protocol tiny version */
+#define SND_CTL_EXT_VERSION_TINY	2	/**< Protocol tiny version */
 /**
  * external plugin protocol version
  */
@@ -141,8 +141,21 @@ struct snd_ctl_ext {
 		snd_ctl_ext_tlv_rw_t *c;
 		const unsigned int *p;
 	} tlv;
+
+	/**
+	 * SND_CTL_EXT_FLAG_XXX (since protocol 1.0.2)
+	 */
+	unsigned int flags;
 };
 
+/** cache the element ids, info, item names and TLV in the library;
+ * they are refreshed on INFO, TLV, ADD and REMOVE events */
+#define SND_CTL_EXT_FLAG_CACHE_INFO	(1<<0)
+/** cache the element values while events are subscribed, and skip writes
+ * of the cached value; read_event must report every VALUE change.
+ * Implies #SND_CTL_EXT_FLAG_CACHE_INFO */
+#define SND_CTL_EXT_FLAG_CACHE_VALUE	(1<<1)
+
 /** Callback table of ext. */
 struct snd_ctl_ext_callback {
 	/**
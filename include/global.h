@@ -121,6 +121,17 @@ typedef struct _snd_async_handler snd_async_handler_t;
  */
 typedef void (*snd_async_callback_t)(snd_async_handler_t *handler);
 
+/** Async notifications from the \c SIGIO handler (default) */
+#define SND_ASYNC_SIGNAL	0
+/** Async notifications from a thread of the library */
+#define SND_ASYNC_THREAD	1
+/** Async notifications from the event loop of the application */
+#define SND_ASYNC_DESCRIPTOR	2
+
+int snd_async_set_delivery(int delivery);
+int snd_async_get_delivery(void);
+int snd_async_descriptor(void);
+int snd_async_dispatch(int timeout);
 int snd_async_add_handler(snd_async_handler_t **handler, int fd, 
 			  snd_async_callback_t callback, void *private_data);
 int snd_async_del_handler(snd_async_handler_t *handler);
@@ -128,6 +139,50 @@ int snd_async_handler_get_fd(snd_async_handler_t *handler);
 int snd_async_handler_get_signo(snd_async_handler_t *handler);
 void *snd_async_handler_get_callback_private(snd_async_handler_t *handler);
 
+/**
+ * \brief Internal structure for a reactor servicing many handles.
+ *
+ * The ALSA library uses a pointer to this structure as a handle to a
+ * reactor object. Applications don't access its contents directly.
+ */
+typedef struct _snd_reactor snd_reactor_t;
+
+/**
+ * \brief Internal structure for a handle registered to a reactor.
+ */
+typedef struct _snd_reactor_handle snd_reactor_handle_t;
+
+/**
+ * \brief Reactor callback.
+ *
+ * See the #snd_reactor_dispatch function for details.
+ */
+typedef void (*snd_reactor_callback_t)(snd_reactor_handle_t *handle, unsigned short revents);
+
+int snd_reactor_open(snd_reactor_t **reactor);
+int snd_reactor_close(snd_reactor_t *reactor);
+int snd_reactor_add_fd(snd_reactor_t *reactor, snd_reactor_handle_t **handle,
+		       int fd, unsigned short events,
+		       snd_reactor_callback_t callback, void *private_data);
+int snd_reactor_del(snd_reactor_handle_t *handle);
+int snd_reactor_dispatch(snd_reactor_t *reactor, int timeout);
+void *snd_reactor_handle_get_callback_private(snd_reactor_handle_t *handle);
+
+/**
+ * \brief Creates a thread for the library.
+ *
+ * \p thread points to a \c pthread_t; it is passed untyped so that this
+ * header does not depend on \c <pthread.h>.  See the
+ * #snd_thread_set_factory function for details.
+ */
+typedef int (*snd_thread_factory_t)(void *thread, const char *role,
+				    void *(*start)(void *), void *arg,
+				    void *private_data);
+
+int snd_thread_set_factory(snd_thread_factory_t factory, void *private_data);
+int snd_thread_set_sched(const char *role, int policy, int priority);
+int snd_thread_set_affinity(const char *role, const char *cpus);
+
 struct snd_shm_area *snd_shm_area_create(int shmid, void *ptr);
 struct snd_shm_area *snd_shm_area_share(struct snd_shm_area *area);
 int snd_shm_area_destroy(struct snd_shm_area *area);
@@ -136,17 +191,22 @@ int snd_user_file(const char *file, char **result);
 
 #ifdef __GLIBC__
 #if !defined(_POSIX_C_SOURCE) && !defined(_POSIX_SOURCE)
+#ifndef __timeval_defined
 struct timeval {
 	time_t		tv_sec;		/* seconds */
 	long		tv_usec;	/* microseconds */
 };
+#endif
 
+/* ISO C11 <time.h> already has it */
+#if !defined(_STRUCT_TIMESPEC) && !defined(__timespec_defined)
 struct timespec {
 	time_t		tv_sec;		/* seconds */
 	long		tv_nsec;	/* nanoseconds */
 };
 #endif
 #endif
+#endif
 
 /** Timestamp */
 typedef struct timeval snd_timestamp_t;
@@ -105,6 +105,14 @@ typedef enum _snd_hwdep_type {
 /** HwDep handle */
 typedef struct _snd_hwdep snd_hwdep_t;
 
+/**
+ * \brief Progress callback of the bulk transfers.
+ *
+ * \p total is zero when the size is not known in advance.  A negative
+ * return value aborts the transfer.
+ */
+typedef int (*snd_hwdep_progress_t)(size_t done, size_t total, void *private_data);
+
 int snd_hwdep_open(snd_hwdep_t **hwdep, const char *name, int mode);
 int snd_hwdep_close(snd_hwdep_t *hwdep);
 int snd_hwdep_poll_descriptors(snd_hwdep_t *hwdep, struct pollfd *pfds, unsigned int space);
@@ -117,6 +125,13 @@ int snd_hwdep_dsp_load(snd_hwdep_t *hwdep, snd_hwdep_dsp_image_t *block);
 int snd_hwdep_ioctl(snd_hwdep_t *hwdep, unsigned int request, void * arg);
 ssize_t snd_hwdep_write(snd_hwdep_t *hwdep, const void *buffer, size_t size);
 ssize_t snd_hwdep_read(snd_hwdep_t *hwdep, void *buffer, size_t size);
+ssize_t snd_hwdep_write_area(snd_hwdep_t *hwdep, const void *buffer, size_t size,
+			     size_t chunk, snd_hwdep_progress_t progress,
+			     void *private_data);
+ssize_t snd_hwdep_write_file(snd_hwdep_t *hwdep, int fd, size_t chunk,
+			     snd_hwdep_progress_t progress, void *private_data);
+int snd_hwdep_dsp_load_file(snd_hwdep_t *hwdep, unsigned int index, const char *name,
+			    int fd, snd_hwdep_progress_t progress, void *private_data);
 
 size_t snd_hwdep_info_sizeof(void);
 /** allocate #snd_hwdep_info_t container on stack */
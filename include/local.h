@@ -354,22 +354,104 @@ static inline int snd_open_device(const char *filename, int fmode)
 	snd1_dlobj_cache_put
 #define snd_dlobj_cache_cleanup \
 	snd1_dlobj_cache_cleanup
+#define snd_dlobj_cache_prelink \
+	snd1_dlobj_cache_prelink
+#define snd_pcm_open_prelink \
+	snd1_pcm_open_prelink
+#define snd_ctl_open_prelink \
+	snd1_ctl_open_prelink
 #define snd_config_set_hop \
 	snd1_config_set_hop
 #define snd_config_check_hop \
 	snd1_config_check_hop
+#define snd_config_enter_hop \
+	snd1_config_enter_hop
+#define snd_config_leave_hop \
+	snd1_config_leave_hop
+#define snd_config_open_hop \
+	snd1_config_open_hop
 #define snd_config_search_alias_hooks \
 	snd1_config_search_alias_hooks
+#define snd_trace_begin \
+	snd1_trace_begin
+#define snd_trace_end \
+	snd1_trace_end
+#define snd_cpu_features \
+	snd1_cpu_features
+#define snd_cpu_select \
+	snd1_cpu_select
+#define snd_thread_create \
+	snd1_thread_create
+#define snd_thread_sched_get \
+	snd1_thread_sched_get
+#define snd_thread_sched_apply \
+	snd1_thread_sched_apply
+#define snd_input_mmap_open \
+	snd1_input_mmap_open
+#define snd_input_buffer_peek \
+	snd1_input_buffer_peek
+#define snd_input_buffer_skip \
+	snd1_input_buffer_skip
 
 /* dlobj cache */
 void *snd_dlobj_cache_get(const char *lib, const char *name, const char *version, int verbose);
 void *snd_dlobj_cache_get2(const char *lib, const char *name, const char *version, int verbose);
 int snd_dlobj_cache_put(void *open_func);
 void snd_dlobj_cache_cleanup(void);
+void __snd_pcm_info_eld_cache_free(void);
+void __snd_eval_cache_free(void);
+
+/* open path tracing, $LIBASOUND_TRACE */
+unsigned long long snd_trace_begin(void);
+void snd_trace_end(unsigned long long start, const char *cat,
+		   const char *name, const char *detail);
+
+/* CPU features for the kernel tables, $LIBASOUND_CPU */
+#define SND_CPU_MMX		(1U << 0)
+#define SND_CPU_CMOV		(1U << 1)
+#define SND_CPU_SSE		(1U << 2)
+#define SND_CPU_SSE2		(1U << 3)
+#define SND_CPU_SSE4_1		(1U << 4)
+#define SND_CPU_AVX2		(1U << 5)
+#define SND_CPU_FMA		(1U << 6)
+#define SND_CPU_NEON		(1U << 7)
+
+unsigned int snd_cpu_features(void);
+const void *snd_cpu_select(const void *table, size_t size);
+#define snd_cpu_has(features) \
+	((snd_cpu_features() & (features)) == (features))
+
+/* for the generic C kernels the compiler should vectorize even at -O2 */
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 4
+#define SND_VECTORIZE __attribute__((optimize("tree-vectorize")))
+#else
+#define SND_VECTORIZE
+#endif
+
+/* library threads, see thread.c */
+typedef struct _snd_thread_sched snd_thread_sched_t;
+int snd_thread_create(pthread_t *thread, const char *role,
+		      void *(*start)(void *), void *arg);
+snd_thread_sched_t *snd_thread_sched_get(const char *role);
+int snd_thread_sched_apply(pthread_t thread, const snd_thread_sched_t *sched,
+			   const char *role);
+
+/* memory backed inputs, for the bulk scanning of the config parser */
+int snd_input_mmap_open(snd_input_t **inputp, const char *file);
+int snd_input_buffer_peek(snd_input_t *input, const char **buf, size_t *size);
+void snd_input_buffer_skip(snd_input_t *input, size_t size);
+
+int snd_dlobj_cache_prelink(snd_config_t *top, const char *base,
+			    const char *const *build_in, const char *version);
+int snd_pcm_open_prelink(snd_config_t *top);
+int snd_ctl_open_prelink(snd_config_t *top);
 
 /* for recursive checks */
 void snd_config_set_hop(snd_config_t *conf, int hop);
 int snd_config_check_hop(snd_config_t *conf);
+int snd_config_enter_hop(int hop);
+void snd_config_leave_hop(int old);
+int snd_config_open_hop(void);
 #define SND_CONF_MAX_HOPS	64
 
 int snd_config_search_alias_hooks(snd_config_t *config,
@@ -380,6 +462,9 @@ int _snd_conf_generic_id(const char *id);
 
 int _snd_config_load_with_include(snd_config_t *config, snd_input_t *in,
 				  int override, const char * const *default_include_path);
+int _snd_config_search_definition(snd_config_t *config,
+				  const char *base, const char *name,
+				  snd_config_t **result, int share);
 
 /* convenience macros */
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof(x[0]))
@@ -109,6 +109,8 @@ int snd_mixer_poll_descriptors_revents(snd_mixer_t *mixer, struct pollfd *pfds,
 int snd_mixer_load(snd_mixer_t *mixer);
 void snd_mixer_free(snd_mixer_t *mixer);
 int snd_mixer_wait(snd_mixer_t *mixer, int timeout);
+int snd_mixer_begin(snd_mixer_t *mixer);
+int snd_mixer_commit(snd_mixer_t *mixer);
 int snd_mixer_set_compare(snd_mixer_t *mixer, snd_mixer_compare_t msort);
 void snd_mixer_set_callback(snd_mixer_t *obj, snd_mixer_callback_t val);
 void * snd_mixer_get_callback_private(const snd_mixer_t *obj);
@@ -403,6 +403,8 @@ typedef long snd_pcm_sframes_t;
 #define SND_PCM_NO_AUTO_FORMAT		0x00040000
 /** Disable soft volume control */
 #define SND_PCM_NO_SOFTVOL		0x00080000
+/** Lock and pre-fault the mmapped areas and plugin buffers at prepare */
+#define SND_PCM_MLOCK_AREAS		0x00100000
 
 /** PCM handle */
 typedef struct _snd_pcm snd_pcm_t;
@@ -488,6 +490,14 @@ typedef struct _snd_pcm_channel_area {
 	unsigned int step;
 } snd_pcm_channel_area_t;
 
+/** PCM segment of interleaved frames, for #snd_pcm_writev() and #snd_pcm_readv() */
+typedef struct _snd_pcm_segment {
+	/** base address of the frames */
+	void *addr;
+	/** number of frames */
+	snd_pcm_uframes_t frames;
+} snd_pcm_segment_t;
+
 /** PCM synchronization ID */
 typedef union _snd_pcm_sync_id {
 	/** 8-bit ID */
@@ -521,6 +531,9 @@ int snd_pcm_nonblock(snd_pcm_t *pcm, int nonblock);
 static __inline__ int snd_pcm_abort(snd_pcm_t *pcm) { return snd_pcm_nonblock(pcm, 2); }
 int snd_async_add_pcm_handler(snd_async_handler_t **handler, snd_pcm_t *pcm, 
 			      snd_async_callback_t callback, void *private_data);
+int snd_reactor_add_pcm(snd_reactor_t *reactor, snd_reactor_handle_t **handle,
+			snd_pcm_t *pcm, snd_reactor_callback_t callback,
+			void *private_data);
 snd_pcm_t *snd_async_handler_get_pcm(snd_async_handler_t *handler);
 int snd_pcm_info(snd_pcm_t *pcm, snd_pcm_info_t *info);
 int snd_pcm_hw_params_current(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
@@ -529,9 +542,26 @@ int snd_pcm_hw_free(snd_pcm_t *pcm);
 int snd_pcm_sw_params_current(snd_pcm_t *pcm, snd_pcm_sw_params_t *params);
 int snd_pcm_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t *params);
 int snd_pcm_prepare(snd_pcm_t *pcm);
+int snd_pcm_resync(snd_pcm_t *pcm);
 int snd_pcm_reset(snd_pcm_t *pcm);
 int snd_pcm_status(snd_pcm_t *pcm, snd_pcm_status_t *status);
+/** #snd_pcm_status_mask(): stream state */
+#define SND_PCM_STATUS_STATE	(1U << 0)
+/** #snd_pcm_status_mask(): available frames */
+#define SND_PCM_STATUS_AVAIL	(1U << 1)
+/** #snd_pcm_status_mask(): delay */
+#define SND_PCM_STATUS_DELAY	(1U << 2)
+/** #snd_pcm_status_mask(): timestamp of the last pointer update */
+#define SND_PCM_STATUS_TSTAMP	(1U << 3)
+/** #snd_pcm_status_mask(): positions of the last period update, without synchronization */
+#define SND_PCM_STATUS_NOSYNC	(1U << 30)
+/** #snd_pcm_status_mask(): all fields, same as #snd_pcm_status() */
+#define SND_PCM_STATUS_ALL	(~0U)
+int snd_pcm_status_mask(snd_pcm_t *pcm, snd_pcm_status_t *status, unsigned int mask);
 int snd_pcm_start(snd_pcm_t *pcm);
+int snd_pcm_start_at(snd_pcm_t *pcm, const snd_htimestamp_t *tstamp);
+int snd_pcm_start_at_multi(snd_pcm_t **pcms, unsigned int count,
+			   const snd_htimestamp_t *tstamp, long long *skew);
 int snd_pcm_drop(snd_pcm_t *pcm);
 int snd_pcm_drain(snd_pcm_t *pcm);
 int snd_pcm_pause(snd_pcm_t *pcm, int enable);
@@ -540,9 +570,24 @@ int snd_pcm_hwsync(snd_pcm_t *pcm);
 int snd_pcm_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp);
 int snd_pcm_resume(snd_pcm_t *pcm);
 int snd_pcm_htimestamp(snd_pcm_t *pcm, snd_pcm_uframes_t *avail, snd_htimestamp_t *tstamp);
+
+/** Timestamps of a period update recorded by #snd_pcm_tstamp_ring_enable() */
+typedef struct _snd_pcm_tstamp_entry {
+	snd_pcm_uframes_t hw_ptr;	/**< hw pointer (0...boundary-1) */
+	snd_htimestamp_t tstamp;	/**< system timestamp of the pointer update */
+	snd_htimestamp_t audio_tstamp;	/**< audio timestamp of the pointer update */
+} snd_pcm_tstamp_entry_t;
+
+int snd_pcm_tstamp_ring_enable(snd_pcm_t *pcm, unsigned int entries,
+			       const snd_pcm_audio_tstamp_config_t *config);
+int snd_pcm_tstamp_ring_read(snd_pcm_t *pcm, snd_pcm_tstamp_entry_t *entries,
+			     unsigned int count);
 snd_pcm_sframes_t snd_pcm_avail(snd_pcm_t *pcm);
 snd_pcm_sframes_t snd_pcm_avail_update(snd_pcm_t *pcm);
 int snd_pcm_avail_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *availp, snd_pcm_sframes_t *delayp);
+int snd_pcm_avail_delay_multi(snd_pcm_t **pcms, unsigned int count,
+			      snd_pcm_sframes_t *availp, snd_pcm_sframes_t *delayp,
+			      snd_htimestamp_t *tstamps);
 snd_pcm_sframes_t snd_pcm_rewindable(snd_pcm_t *pcm);
 snd_pcm_sframes_t snd_pcm_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t frames);
 snd_pcm_sframes_t snd_pcm_forwardable(snd_pcm_t *pcm);
@@ -551,6 +596,8 @@ snd_pcm_sframes_t snd_pcm_writei(snd_pcm_t *pcm, const void *buffer, snd_pcm_ufr
 snd_pcm_sframes_t snd_pcm_readi(snd_pcm_t *pcm, void *buffer, snd_pcm_uframes_t size);
 snd_pcm_sframes_t snd_pcm_writen(snd_pcm_t *pcm, void **bufs, snd_pcm_uframes_t size);
 snd_pcm_sframes_t snd_pcm_readn(snd_pcm_t *pcm, void **bufs, snd_pcm_uframes_t size);
+snd_pcm_sframes_t snd_pcm_writev(snd_pcm_t *pcm, const snd_pcm_segment_t *segs, unsigned int count);
+snd_pcm_sframes_t snd_pcm_readv(snd_pcm_t *pcm, const snd_pcm_segment_t *segs, unsigned int count);
 int snd_pcm_wait(snd_pcm_t *pcm, int timeout);
 
 int snd_pcm_link(snd_pcm_t *pcm1, snd_pcm_t *pcm2);
@@ -918,6 +965,8 @@ int snd_pcm_sw_params_set_avail_min(snd_pcm_t *pcm, snd_pcm_sw_params_t *params,
 int snd_pcm_sw_params_get_avail_min(const snd_pcm_sw_params_t *params, snd_pcm_uframes_t *val);
 int snd_pcm_sw_params_set_period_event(snd_pcm_t *pcm, snd_pcm_sw_params_t *params, int val);
 int snd_pcm_sw_params_get_period_event(const snd_pcm_sw_params_t *params, int *val);
+int snd_pcm_sw_params_set_avail_min_adaptive(snd_pcm_t *pcm, snd_pcm_sw_params_t *params, int val);
+int snd_pcm_sw_params_get_avail_min_adaptive(const snd_pcm_sw_params_t *params, int *val);
 int snd_pcm_sw_params_set_start_threshold(snd_pcm_t *pcm, snd_pcm_sw_params_t *params, snd_pcm_uframes_t val);
 int snd_pcm_sw_params_get_start_threshold(const snd_pcm_sw_params_t *paramsm, snd_pcm_uframes_t *val);
 int snd_pcm_sw_params_set_stop_threshold(snd_pcm_t *pcm, snd_pcm_sw_params_t *params, snd_pcm_uframes_t val);
@@ -1100,6 +1149,32 @@ int snd_pcm_dump_setup(snd_pcm_t *pcm, snd_output_t *out);
 int snd_pcm_hw_params_dump(snd_pcm_hw_params_t *params, snd_output_t *out);
 int snd_pcm_sw_params_dump(snd_pcm_sw_params_t *params, snd_output_t *out);
 int snd_pcm_status_dump(snd_pcm_status_t *status, snd_output_t *out);
+int snd_pcm_direct_stats_dump(int ipc_key, snd_output_t *out);
+
+/** Transfer counters of a plugin, see #snd_pcm_plugin_profile_get() */
+typedef struct _snd_pcm_plugin_profile {
+	/** PCM type of the plugin */
+	snd_pcm_type_t type;
+	/** PCM name of the plugin, may be NULL for inserted converters */
+	const char *name;
+	/** number of transfer callback invocations */
+	unsigned long long calls;
+	/** frames converted */
+	unsigned long long frames;
+	/** CPU cycles spent in the callback, 0 when not available */
+	unsigned long long cycles;
+	/** nanoseconds spent in the callback */
+	unsigned long long nsecs;
+	/** slowest single invocation in nanoseconds */
+	unsigned long long max_nsecs;
+	/** number of #snd_pcm_resync() recoveries */
+	unsigned long long resyncs;
+	/** nanoseconds spent in them, including the layers below */
+	unsigned long long resync_nsecs;
+} snd_pcm_plugin_profile_t;
+
+int snd_pcm_plugin_profile_get(snd_pcm_t *pcm, unsigned int index,
+			       snd_pcm_plugin_profile_t *prof);
 
 /** \} */
 
@@ -1266,11 +1341,50 @@ typedef struct _snd_pcm_scope_ops {
 	void (*close)(snd_pcm_scope_t *scope);
 } snd_pcm_scope_ops_t;
 
+/** #SND_PCM_TYPE_METER levels of a channel, full scale is 32768 */
+typedef struct _snd_pcm_meter_level {
+	unsigned int peak;	/**< largest absolute sample */
+	unsigned int rms;	/**< root mean square */
+	unsigned int clips;	/**< samples at full scale */
+} snd_pcm_meter_level_t;
+
+/** magic of a #snd_pcm_scope_shm_open() segment */
+#define SND_PCM_SCOPE_SHM_MAGIC		0x4d4c5341
+/** layout version of a #snd_pcm_scope_shm_open() segment */
+#define SND_PCM_SCOPE_SHM_VERSION	1
+
+/** levels of a channel in a #snd_pcm_scope_shm_open() segment */
+typedef struct _snd_pcm_scope_shm_channel {
+	unsigned int peak;		/**< peak since the previous update */
+	unsigned int rms;		/**< RMS since the previous update */
+	unsigned long long clips;	/**< samples at full scale so far */
+} snd_pcm_scope_shm_channel_t;
+
+/**
+ * \brief header of a #snd_pcm_scope_shm_open() segment
+ *
+ * The header is followed by \a channels #snd_pcm_scope_shm_channel_t.
+ * A reader loads \a seq, retries while it is odd, copies the levels and
+ * loads \a seq again; the copy is consistent when both loads match.
+ */
+typedef struct _snd_pcm_scope_shm_header {
+	unsigned int magic;		/**< #SND_PCM_SCOPE_SHM_MAGIC */
+	unsigned int version;		/**< #SND_PCM_SCOPE_SHM_VERSION */
+	unsigned int seq;		/**< seqlock generation, odd while written */
+	unsigned int channels;		/**< channels following the header */
+	unsigned int rate;		/**< sample rate */
+	unsigned int running;		/**< the PCM is running */
+	unsigned long long updates;	/**< updates published */
+} snd_pcm_scope_shm_header_t;
+
 snd_pcm_uframes_t snd_pcm_meter_get_bufsize(snd_pcm_t *pcm);
 unsigned int snd_pcm_meter_get_channels(snd_pcm_t *pcm);
 unsigned int snd_pcm_meter_get_rate(snd_pcm_t *pcm);
 snd_pcm_uframes_t snd_pcm_meter_get_now(snd_pcm_t *pcm);
 snd_pcm_uframes_t snd_pcm_meter_get_boundary(snd_pcm_t *pcm);
+int snd_pcm_meter_get_levels(snd_pcm_t *pcm, unsigned int channel,
+			     unsigned long long *pos,
+			     snd_pcm_meter_level_t *level);
 int snd_pcm_meter_add_scope(snd_pcm_t *pcm, snd_pcm_scope_t *scope);
 snd_pcm_scope_t *snd_pcm_meter_search_scope(snd_pcm_t *pcm, const char *name);
 int snd_pcm_scope_malloc(snd_pcm_scope_t **ptr);
@@ -1284,6 +1398,8 @@ int snd_pcm_scope_s16_open(snd_pcm_t *pcm, const char *name,
 			   snd_pcm_scope_t **scopep);
 int16_t *snd_pcm_scope_s16_get_channel_buffer(snd_pcm_scope_t *scope,
 					      unsigned int channel);
+int snd_pcm_scope_shm_open(snd_pcm_t *pcm, const char *name,
+			   const char *path, snd_pcm_scope_t **scopep);
 
 /** \} */
 
@@ -1350,6 +1466,28 @@ int snd_spcm_init_get_params(snd_pcm_t *pcm,
 
 /** \} */
 
+/**
+ * \defgroup PCM_Pool Handle Pool
+ * \ingroup PCM
+ * Configured handles kept for reuse, see the \ref pcm page.
+ * \{
+ */
+
+/** Pool of configured PCM handles */
+typedef struct _snd_pcm_pool snd_pcm_pool_t;
+
+int snd_pcm_pool_open(snd_pcm_pool_t **pool, unsigned int max_idle,
+		      unsigned int timeout);
+int snd_pcm_pool_close(snd_pcm_pool_t *pool);
+int snd_pcm_pool_get(snd_pcm_pool_t *pool, snd_pcm_t **pcm, const char *name,
+		     snd_pcm_stream_t stream, int mode,
+		     const snd_pcm_hw_params_t *params,
+		     const snd_pcm_sw_params_t *swparams);
+int snd_pcm_pool_put(snd_pcm_pool_t *pool, snd_pcm_t *pcm);
+int snd_pcm_pool_expire(snd_pcm_pool_t *pool);
+
+/** \} */
+
 /**
  * \defgroup PCM_Deprecated Deprecated Functions
  * \ingroup PCM
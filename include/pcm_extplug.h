@@ -44,6 +44,13 @@ enum {
 	SND_PCM_EXTPLUG_HW_CHANNELS,	/**< channels */
 	SND_PCM_EXTPLUG_HW_PARAMS	/**< max number of hw constraints */
 };
+
+/** slave buffer layout for the process callback */
+enum {
+	SND_PCM_EXTPLUG_LAYOUT_ANY,		/**< any mmap layout */
+	SND_PCM_EXTPLUG_LAYOUT_INTERLEAVED,	/**< interleaved frames */
+	SND_PCM_EXTPLUG_LAYOUT_PLANAR		/**< one buffer per channel */
+};
 	
 /** Handle of external filter plugin */
 typedef struct snd_pcm_extplug snd_pcm_extplug_t;
@@ -60,7 +67,7 @@ typedef snd_pcm_extplug_callback snd_pcm_extplug_callback_t;
  */
 #define SND_PCM_EXTPLUG_VERSION_MAJOR	1	/**< Protocol major version */
 #define SND_PCM_EXTPLUG_VERSION_MINOR	0	/**< Protocol minor version */
-#define SND_PCM_EXTPLUG_VERSION_TINY	2	/**< Protocol tiny version */
+#define SND_PCM_EXTPLUG_VERSION_TINY	3	/**< Protocol tiny version */
 /**
  * Filter-plugin protocol version
  */
@@ -168,6 +175,15 @@ struct snd_pcm_extplug_callback {
 	 * set the channel map; optional; since v1.0.2
 	 */
 	int (*set_chmap)(snd_pcm_extplug_t *ext, const snd_pcm_chmap_t *map);
+	/**
+	 * process the samples in place on the slave mmap area; optional;
+	 * used instead of transfer when the client and slave formats and
+	 * channels are equal; since v1.0.3
+	 */
+	snd_pcm_sframes_t (*process)(snd_pcm_extplug_t *ext,
+				     const snd_pcm_channel_area_t *areas,
+				     snd_pcm_uframes_t offset,
+				     snd_pcm_uframes_t size);
 };
 
 
@@ -186,6 +202,8 @@ int snd_pcm_extplug_set_slave_param_list(snd_pcm_extplug_t *extplug, int type, u
 int snd_pcm_extplug_set_slave_param_minmax(snd_pcm_extplug_t *extplug, int type, unsigned int min, unsigned int max);
 int snd_pcm_extplug_set_param_link(snd_pcm_extplug_t *extplug, int type,
 				   int keep_link);
+int snd_pcm_extplug_set_slave_layout(snd_pcm_extplug_t *extplug, int layout,
+				     unsigned int align);
 
 /**
  * set the parameter constraint with a single value
@@ -0,0 +1,96 @@
+/**
+ * \file include/pcm_file_encoder.h
+ * \brief External File-Encoder-Plugin SDK
+ * \date 2026
+ *
+ * External File-Encoder-Plugin SDK
+ */
+
+/*
+ * ALSA external PCM file encoder plugin SDK
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __ALSA_PCM_FILE_ENCODER_H
+#define __ALSA_PCM_FILE_ENCODER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Protocol version
+ */
+#define SND_PCM_FILE_ENCODER_VERSION	0x010000
+
+/** stream information passed to the encoder */
+typedef struct snd_pcm_file_encoder_info {
+	snd_pcm_format_t format;	/**< sample format, interleaved */
+	unsigned int channels;		/**< channels */
+	unsigned int rate;		/**< sample rate */
+} snd_pcm_file_encoder_info_t;
+
+/**
+ * Output callback handed to the encoder; writes the whole buffer to the
+ * file and returns zero or a negative error code
+ */
+typedef int (*snd_pcm_file_encoder_write_t)(void *priv, const void *buf,
+					    size_t size);
+
+/** Callback table of file encoder */
+typedef struct snd_pcm_file_encoder_ops {
+	/**
+	 * start a new stream; called before the first data, the encoder
+	 * may write its stream header through write
+	 */
+	int (*start)(void *obj, const snd_pcm_file_encoder_info_t *info,
+		     snd_pcm_file_encoder_write_t write, void *priv);
+	/**
+	 * encode interleaved frames; the encoder may keep them until it
+	 * has a complete block
+	 */
+	int (*encode)(void *obj, const void *buf, snd_pcm_uframes_t frames);
+	/**
+	 * flush the pending frames and finish the stream
+	 */
+	int (*stop)(void *obj);
+	/**
+	 * show the encoder state for snd_pcm_dump() (optional)
+	 */
+	void (*dump)(void *obj, snd_output_t *out);
+	/**
+	 * free the encoder object
+	 */
+	void (*close)(void *obj);
+} snd_pcm_file_encoder_ops_t;
+
+/** open function type; conf is the encoder definition or NULL */
+typedef int (*snd_pcm_file_encoder_open_func_t)(unsigned int version,
+						void **objp,
+						snd_pcm_file_encoder_ops_t *ops,
+						const snd_config_t *conf);
+
+/**
+ * Define the object entry for external PCM file encoder plugins
+ */
+#define SND_PCM_FILE_ENCODER_ENTRY(name) _snd_pcm_file_encoder_##name##_open
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ALSA_PCM_FILE_ENCODER_H */
@@ -31,6 +31,8 @@
 #ifndef __ALSA_PCM_IOPLUG_H
 #define __ALSA_PCM_IOPLUG_H
 
+#include <sys/uio.h>
+
 /**
  * \defgroup PCM_IOPlug External I/O plugin SDK
  * \ingroup Plugin_SDK
@@ -67,13 +69,15 @@ typedef snd_pcm_ioplug_callback snd_pcm_ioplug_callback_t;
 #define SND_PCM_IOPLUG_FLAG_MONOTONIC	(1<<1)		/**< monotonic timestamps */
 /** hw pointer wrap around at boundary instead of buffer_size */
 #define SND_PCM_IOPLUG_FLAG_BOUNDARY_WA	(1<<2)
+/** extrapolate hw pointer between pointer callbacks while running */
+#define SND_PCM_IOPLUG_FLAG_PTR_EXTRAPOLATE	(1<<3)
 
 /*
  * Protocol version
  */
 #define SND_PCM_IOPLUG_VERSION_MAJOR	1	/**< Protocol major version */
 #define SND_PCM_IOPLUG_VERSION_MINOR	0	/**< Protocol minor version */
-#define SND_PCM_IOPLUG_VERSION_TINY	2	/**< Protocol tiny version */
+#define SND_PCM_IOPLUG_VERSION_TINY	3	/**< Protocol tiny version */
 /**
  * IO-plugin protocol version
  */
@@ -211,6 +215,17 @@ struct snd_pcm_ioplug_callback {
 	 * set the channel map; optional; since v1.0.2
 	 */
 	int (*set_chmap)(snd_pcm_ioplug_t *io, const snd_pcm_chmap_t *map);
+	/**
+	 * transfer the data as byte vectors; optional, called inside mutex
+	 * lock; since v1.0.3
+	 * Takes precedence over transfer.  iov points straight into the
+	 * application (RW access) or mmap buffer; iovcnt is 1 for
+	 * interleaved and the number of channels for non-interleaved data.
+	 * \return the number of transferred frames or a negative error code
+	 */
+	snd_pcm_sframes_t (*transfer_iov)(snd_pcm_ioplug_t *io,
+					  const struct iovec *iov, int iovcnt,
+					  snd_pcm_uframes_t size);
 };
 
 
@@ -234,6 +249,9 @@ int snd_pcm_ioplug_set_param_list(snd_pcm_ioplug_t *io, int type, unsigned int n
 /* change PCM status */
 int snd_pcm_ioplug_set_state(snd_pcm_ioplug_t *ioplug, snd_pcm_state_t state);
 
+/* set max. frames between pointer callbacks (PTR_EXTRAPOLATE) */
+int snd_pcm_ioplug_set_pointer_resync(snd_pcm_ioplug_t *ioplug, snd_pcm_uframes_t frames);
+
 /* calucalte the available frames */
 snd_pcm_uframes_t snd_pcm_ioplug_avail(const snd_pcm_ioplug_t * const ioplug,
 				       const snd_pcm_uframes_t hw_ptr,
@@ -74,6 +74,20 @@ int _snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 		     snd_config_t *root ATTRIBUTE_UNUSED, snd_config_t *conf,
 		     snd_pcm_stream_t stream, int mode);
 
+/** io_uring context for batched hw transfers */
+typedef struct _snd_pcm_hw_uring snd_pcm_hw_uring_t;
+int snd_pcm_hw_uring_open(snd_pcm_hw_uring_t **ringp, unsigned int entries);
+int snd_pcm_hw_uring_close(snd_pcm_hw_uring_t *ring);
+int snd_pcm_hw_uring_writei(snd_pcm_hw_uring_t *ring, snd_pcm_t *pcm,
+			    const void *buffer, snd_pcm_uframes_t size,
+			    void *private_data);
+int snd_pcm_hw_uring_readi(snd_pcm_hw_uring_t *ring, snd_pcm_t *pcm,
+			   void *buffer, snd_pcm_uframes_t size,
+			   void *private_data);
+int snd_pcm_hw_uring_submit(snd_pcm_hw_uring_t *ring, unsigned int wait_nr);
+int snd_pcm_hw_uring_complete(snd_pcm_hw_uring_t *ring, snd_pcm_t **pcmp,
+			      snd_pcm_sframes_t *result, void **private_data);
+
 /*
  *  Copy plugin
  */
@@ -173,6 +187,12 @@ int _snd_pcm_hooks_open(snd_pcm_t **pcmp, const char *name,
 			snd_config_t *root, snd_config_t *conf,
 			snd_pcm_stream_t stream, int mode);
 
+/*
+ *  File plugin
+ */
+int snd_pcm_file_async_stats(snd_pcm_t *pcm, unsigned long long *overflows,
+			     unsigned long long *dropped);
+
 /*
  *  LADSPA plugin
  */
@@ -76,7 +76,9 @@ typedef enum _snd_rawmidi_type {
 	/** INET client RawMidi (not yet implemented) */
 	SND_RAWMIDI_TYPE_INET,
 	/** Virtual (sequencer) RawMidi */
-	SND_RAWMIDI_TYPE_VIRTUAL
+	SND_RAWMIDI_TYPE_VIRTUAL,
+	/** Lock-free ring buffer RawMidi */
+	SND_RAWMIDI_TYPE_RING
 } snd_rawmidi_type_t;
 
 /** Type of clock used with rawmidi timestamp */
@@ -93,6 +95,16 @@ typedef enum _snd_rawmidi_read_mode {
 	SND_RAWMIDI_READ_TSTAMP = 1,
 } snd_rawmidi_read_mode_t;
 
+/** Maximum count of MIDI bytes in one timestamped frame */
+#define SND_RAWMIDI_FRAME_DATA_LENGTH	16
+
+/** Timestamped MIDI data frame (#SND_RAWMIDI_READ_TSTAMP mode) */
+typedef struct _snd_rawmidi_tframe {
+	struct timespec tstamp;		/**< timestamp of the MIDI bytes */
+	size_t length;			/**< count of valid MIDI bytes */
+	unsigned char data[SND_RAWMIDI_FRAME_DATA_LENGTH];	/**< MIDI bytes */
+} snd_rawmidi_tframe_t;
+
 int snd_rawmidi_open(snd_rawmidi_t **in_rmidi, snd_rawmidi_t **out_rmidi,
 		     const char *name, int mode);
 int snd_rawmidi_open_lconf(snd_rawmidi_t **in_rmidi, snd_rawmidi_t **out_rmidi,
@@ -144,6 +156,8 @@ int snd_rawmidi_params_set_read_mode(const snd_rawmidi_t *rawmidi, snd_rawmidi_p
 snd_rawmidi_read_mode_t snd_rawmidi_params_get_read_mode(const snd_rawmidi_params_t *params);
 int snd_rawmidi_params_set_clock_type(const snd_rawmidi_t *rawmidi, snd_rawmidi_params_t *params, snd_rawmidi_clock_t val);
 snd_rawmidi_clock_t snd_rawmidi_params_get_clock_type(const snd_rawmidi_params_t *params);
+int snd_rawmidi_params_set_read_ahead(const snd_rawmidi_t *rawmidi, snd_rawmidi_params_t *params, size_t val);
+size_t snd_rawmidi_params_get_read_ahead(const snd_rawmidi_params_t *params);
 
 int snd_rawmidi_params(snd_rawmidi_t *rmidi, snd_rawmidi_params_t * params);
 int snd_rawmidi_params_current(snd_rawmidi_t *rmidi, snd_rawmidi_params_t *params);
@@ -165,6 +179,8 @@ int snd_rawmidi_drop(snd_rawmidi_t *rmidi);
 ssize_t snd_rawmidi_write(snd_rawmidi_t *rmidi, const void *buffer, size_t size);
 ssize_t snd_rawmidi_read(snd_rawmidi_t *rmidi, void *buffer, size_t size);
 ssize_t snd_rawmidi_tread(snd_rawmidi_t *rmidi, struct timespec *tstamp, void *buffer, size_t size);
+ssize_t snd_rawmidi_tread_frames(snd_rawmidi_t *rmidi, snd_rawmidi_tframe_t *frames, size_t count);
+int snd_rawmidi_tframe_next(const void *buffer, size_t size, size_t *pos, snd_rawmidi_tframe_t *frame);
 const char *snd_rawmidi_name(snd_rawmidi_t *rmidi);
 snd_rawmidi_type_t snd_rawmidi_type(snd_rawmidi_t *rmidi);
 snd_rawmidi_stream_t snd_rawmidi_stream(snd_rawmidi_t *rawmidi);
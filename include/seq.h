@@ -83,6 +83,9 @@ int snd_seq_close(snd_seq_t *handle);
 int snd_seq_poll_descriptors_count(snd_seq_t *handle, short events);
 int snd_seq_poll_descriptors(snd_seq_t *handle, struct pollfd *pfds, unsigned int space, short events);
 int snd_seq_poll_descriptors_revents(snd_seq_t *seq, struct pollfd *pfds, unsigned int nfds, unsigned short *revents);
+int snd_reactor_add_seq(snd_reactor_t *reactor, snd_reactor_handle_t **handle,
+			snd_seq_t *seq, short events,
+			snd_reactor_callback_t callback, void *private_data);
 int snd_seq_nonblock(snd_seq_t *handle, int nonblock);
 int snd_seq_client_id(snd_seq_t *handle);
 
@@ -91,6 +94,24 @@ size_t snd_seq_get_input_buffer_size(snd_seq_t *handle);
 int snd_seq_set_output_buffer_size(snd_seq_t *handle, size_t size);
 int snd_seq_set_input_buffer_size(snd_seq_t *handle, size_t size);
 
+/** Statistics of the automatic buffer and pool sizing */
+typedef struct snd_seq_autotune_stats {
+	unsigned int output_stalls;	/*!< drains stopped by a full output pool */
+	unsigned int input_overruns;	/*!< input FIFO overruns (-ENOSPC) */
+	unsigned int buffer_grows;	/*!< local buffers enlarged */
+	unsigned int buffer_shrinks;	/*!< local buffers reduced */
+	unsigned int pool_grows;	/*!< kernel pools enlarged */
+	unsigned int pool_shrinks;	/*!< kernel pools reduced */
+	unsigned int pool_refused;	/*!< pool changes not taken by the sequencer */
+	size_t output_buffer;		/*!< current output buffer size in bytes */
+	size_t input_buffer;		/*!< current input buffer size in bytes */
+	unsigned int output_pool;	/*!< current output pool size in events */
+	unsigned int input_pool;	/*!< current input pool size in events */
+} snd_seq_autotune_stats_t;
+
+int snd_seq_set_autotune(snd_seq_t *handle, size_t max_buffer, unsigned int max_pool);
+int snd_seq_autotune_stats(snd_seq_t *handle, snd_seq_autotune_stats_t *stats);
+
 /** system information container */
 typedef struct _snd_seq_system_info snd_seq_system_info_t;
 
@@ -521,9 +542,12 @@ ssize_t snd_seq_event_length(snd_seq_event_t *ev);
 int snd_seq_event_output(snd_seq_t *handle, snd_seq_event_t *ev);
 int snd_seq_event_output_buffer(snd_seq_t *handle, snd_seq_event_t *ev);
 int snd_seq_event_output_direct(snd_seq_t *handle, snd_seq_event_t *ev);
+int snd_seq_event_output_multi(snd_seq_t *handle, snd_seq_event_t *ev, unsigned int count);
 int snd_seq_event_input(snd_seq_t *handle, snd_seq_event_t **ev);
+int snd_seq_event_input_batch(snd_seq_t *handle, snd_seq_event_t **ev, unsigned int max);
 int snd_seq_event_input_pending(snd_seq_t *seq, int fetch_sequencer);
 int snd_seq_drain_output(snd_seq_t *handle);
+int snd_seq_drain_output_partial(snd_seq_t *handle, size_t *bytes, unsigned int *events);
 int snd_seq_event_output_pending(snd_seq_t *seq);
 int snd_seq_extract_output(snd_seq_t *handle, snd_seq_event_t **ev);
 int snd_seq_drop_output(snd_seq_t *handle);
@@ -574,6 +598,30 @@ int snd_seq_remove_events(snd_seq_t *handle, snd_seq_remove_events_t *info);
 
 /** \} */
 
+/**
+ *  \defgroup SeqGraph Sequencer Graph Snapshot
+ *  Sequencer Graph Snapshot
+ *  \ingroup Sequencer
+ *  \{
+ */
+
+/** snapshot of the clients, ports and connections */
+typedef struct _snd_seq_graph snd_seq_graph_t;
+
+int snd_seq_graph_open(snd_seq_graph_t **graph, snd_seq_t *handle);
+void snd_seq_graph_close(snd_seq_graph_t *graph);
+int snd_seq_graph_rebuild(snd_seq_graph_t *graph);
+int snd_seq_graph_update(snd_seq_graph_t *graph, const snd_seq_event_t *ev);
+unsigned int snd_seq_graph_get_version(const snd_seq_graph_t *graph);
+unsigned int snd_seq_graph_get_clients(const snd_seq_graph_t *graph);
+const snd_seq_client_info_t *snd_seq_graph_get_client(const snd_seq_graph_t *graph, unsigned int idx);
+unsigned int snd_seq_graph_get_ports(const snd_seq_graph_t *graph, unsigned int idx);
+const snd_seq_port_info_t *snd_seq_graph_get_port(const snd_seq_graph_t *graph, unsigned int idx, unsigned int port);
+unsigned int snd_seq_graph_get_connections(const snd_seq_graph_t *graph);
+const snd_seq_port_subscribe_t *snd_seq_graph_get_connection(const snd_seq_graph_t *graph, unsigned int idx);
+
+/** \} */
+
 /**
  *  \defgroup SeqMisc Sequencer Miscellaneous
  *  Sequencer Miscellaneous
@@ -338,6 +338,23 @@ int snd_seq_connect_to(snd_seq_t *seq, int my_port, int dest_client, int dest_po
 int snd_seq_disconnect_from(snd_seq_t *seq, int my_port, int src_client, int src_port);
 int snd_seq_disconnect_to(snd_seq_t *seq, int my_port, int dest_client, int dest_port);
 
+/** connection entry of #snd_seq_connect_multi() */
+typedef struct snd_seq_connect_entry {
+	snd_seq_addr_t sender;		/**< sender address */
+	snd_seq_addr_t dest;		/**< destination address */
+	unsigned int flags;		/**< SND_SEQ_CONNECT_* flags */
+	int queue;			/**< queue for the time stamps */
+	int result;			/**< result, 0 or a negative error code */
+} snd_seq_connect_entry_t;
+
+#define SND_SEQ_CONNECT_EXCLUSIVE	(1<<0)	/**< exclusive connection */
+#define SND_SEQ_CONNECT_TIME_UPDATE	(1<<1)	/**< time stamps are updated */
+#define SND_SEQ_CONNECT_TIME_REAL	(1<<2)	/**< real time stamps */
+
+/* several subscriptions in one call, with per-entry results */
+int snd_seq_connect_multi(snd_seq_t *seq, snd_seq_connect_entry_t *conns, unsigned int count);
+int snd_seq_disconnect_multi(snd_seq_t *seq, snd_seq_connect_entry_t *conns, unsigned int count);
+
 /*
  * set client information
  */
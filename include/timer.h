@@ -146,6 +146,8 @@ int snd_timer_query_next_device(snd_timer_query_t *handle, snd_timer_id_t *tid);
 int snd_timer_query_info(snd_timer_query_t *handle, snd_timer_ginfo_t *info);
 int snd_timer_query_params(snd_timer_query_t *handle, snd_timer_gparams_t *params);
 int snd_timer_query_status(snd_timer_query_t *handle, snd_timer_gstatus_t *status);
+int snd_timer_catalog_next(snd_timer_id_t *tid);
+int snd_timer_catalog_info(snd_timer_ginfo_t *info);
 
 int snd_timer_open(snd_timer_t **handle, const char *name, int mode);
 int snd_timer_open_lconf(snd_timer_t **handle, const char *name, int mode, snd_config_t *lconf);
@@ -163,6 +165,9 @@ int snd_timer_start(snd_timer_t *handle);
 int snd_timer_stop(snd_timer_t *handle);
 int snd_timer_continue(snd_timer_t *handle);
 ssize_t snd_timer_read(snd_timer_t *handle, void *buffer, size_t size);
+ssize_t snd_timer_read_events(snd_timer_t *handle, snd_timer_tread_t *events, size_t count);
+int snd_timer_tread_next(snd_timer_t *handle, const snd_timer_tread_t **event);
+unsigned int snd_timer_tread_pending(snd_timer_t *handle);
 
 size_t snd_timer_id_sizeof(void);
 /** allocate #snd_timer_id_t container on stack */
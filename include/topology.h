@@ -774,6 +774,7 @@ enum snd_tplg_type {
 /** Flags for the snd_tplg_create */
 #define SND_TPLG_CREATE_VERBOSE		(1<<0)	/*!< Verbose output */
 #define SND_TPLG_CREATE_DAPM_NOSORT	(1<<1)	/*!< Do not sort DAPM objects by index */
+#define SND_TPLG_CREATE_INCREMENTAL	(1<<2)	/*!< Reuse the previous build, see snd_tplg_build_file() */
 
 /**
  * \brief Return the version of the topology library.
@@ -814,6 +815,12 @@ int snd_tplg_load(snd_tplg_t *tplg, const char *buf, size_t size);
  * \param infile Topology text input file to be parsed
  * \param outfile Binary topology output file.
  * \return Zero on success, otherwise a negative error code
+ *
+ * With #SND_TPLG_CREATE_INCREMENTAL the instance can be called again
+ * after the sources were edited; each call replaces the objects of the
+ * previous one.  An unchanged source tree (including the data files)
+ * leaves the output file alone, otherwise only the blocks that differ
+ * from the previous image are rewritten in place.
  */
 int snd_tplg_build_file(snd_tplg_t *tplg, const char *infile,
 			const char *outfile);
@@ -1126,6 +1133,48 @@ int snd_tplg_build(snd_tplg_t *tplg, const char *outfile);
  */
 int snd_tplg_build_bin(snd_tplg_t *tplg, void **bin, size_t *size);
 
+/**
+ * \brief Build all registered topology data and stream it to a file descriptor.
+ * \param tplg Topology instance.
+ * \param fd Output file descriptor (file, pipe or socket).
+ * \return Zero on success, otherwise a negative error code
+ *
+ * The image is written as it is laid out, without building it in memory.
+ */
+int snd_tplg_build_fd(snd_tplg_t *tplg, int fd);
+
+/**
+ * \brief Build all registered topology data into a caller provided buffer.
+ * \param tplg Topology instance.
+ * \param buf Output buffer, e.g. a mmap'ed file.
+ * \param size Output buffer size in bytes.
+ * \param used Returns the binary topology size in bytes (may be NULL).
+ * \return Zero on success, -ENOSPC if the buffer is too small (*used is
+ * set, the call can be repeated with a large enough buffer), otherwise
+ * a negative error code
+ */
+int snd_tplg_build_mem(snd_tplg_t *tplg, void *buf, size_t size, size_t *used);
+
+/** Topology build statistics */
+typedef struct snd_tplg_build_stats {
+	size_t size;			/*!< binary size in bytes */
+	unsigned int blocks;		/*!< number of block headers */
+	unsigned int elems;		/*!< number of written elements */
+	unsigned int writes;		/*!< write() calls (fd output only) */
+	unsigned int reused;		/*!< blocks kept in the output file (incremental only) */
+	unsigned long integ_usec;	/*!< object build time in us */
+	unsigned long layout_usec;	/*!< layout time in us */
+	unsigned long write_usec;	/*!< output time in us */
+} snd_tplg_build_stats_t;
+
+/**
+ * \brief Get the statistics of the last build.
+ * \param tplg Topology instance.
+ * \param stats Returned statistics.
+ * \return Zero on success, otherwise a negative error code
+ */
+int snd_tplg_build_stats(snd_tplg_t *tplg, snd_tplg_build_stats_t *stats);
+
 /**
  * \brief Attach private data to topology manifest.
  * \param tplg Topology instance.
@@ -1167,6 +1216,48 @@ int snd_tplg_save(snd_tplg_t *tplg, char **dst, int flags);
  */
 int snd_tplg_decode(snd_tplg_t *tplg, void *bin, size_t size, int dflags);
 
+/** Block of a binary topology, pointing into the binary buffer */
+typedef struct snd_tplg_block {
+	int type;			/*!< SND_TPLG_TYPE_XXX or -1 if unknown */
+	unsigned int asoc_type;		/*!< SND_SOC_TPLG_TYPE_XXX */
+	unsigned int index;		/*!< group index */
+	unsigned int version;		/*!< block version */
+	unsigned int vendor_type;	/*!< vendor type */
+	unsigned int count;		/*!< number of objects in the block */
+	size_t offset;			/*!< header offset in the binary */
+	const void *payload;		/*!< block payload (in place) */
+	size_t payload_size;		/*!< payload size in bytes */
+} snd_tplg_block_t;
+
+/**
+ * \brief Iterate the blocks of a binary topology without decoding them.
+ * \param bin Binary topology buffer, e.g. a read-only mmap'ed file.
+ * \param size Binary topology buffer size.
+ * \param pos Iterator position, set to 0 for the first block.
+ * \param blk Returned block, valid as long as bin is.
+ * \return 1 if a block was returned, 0 at the end, otherwise a negative
+ * error code
+ *
+ * The block headers are validated, nothing is allocated or copied.
+ */
+int snd_tplg_block_next(const void *bin, size_t size, size_t *pos,
+			snd_tplg_block_t *blk);
+
+/**
+ * \brief Decode a single block into the topology instance.
+ * \param tplg Topology instance.
+ * \param bin Binary topology buffer passed to #snd_tplg_block_next().
+ * \param blk Block returned by #snd_tplg_block_next().
+ * \param dflags Decode flags (must be zero).
+ * \return Zero on success, otherwise a negative error code
+ *
+ * Only the objects of this block are created, so a tool can decode and
+ * save only the sections it is interested in.  References to objects in
+ * other blocks are kept by name.
+ */
+int snd_tplg_decode_block(snd_tplg_t *tplg, const void *bin,
+			  const snd_tplg_block_t *blk, int dflags);
+
 /* \} */
 
 #ifdef __cplusplus
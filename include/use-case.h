@@ -445,12 +445,30 @@ int snd_use_case_geti(snd_use_case_mgr_t *uc_mgr,
  *				  - disable old_device and then enable new_device
  *				  - if old_device is not enabled just return
  *				  - check transmit sequence firstly
+ *   - _swdiff/{old_device}	- new_device = value
+ *				  - like _swdev, but the cset steps of both
+ *				    sequences are merged: only the controls
+ *				    whose final value differs from the current
+ *				    one are written, in one bulk write per
+ *				    control device
+ *				  - other steps (sleep, exec, sysw, cset-tlv
+ *				    etc.) write the pending values first
  *   - _enamod			- enable given modifier = value
  *   - _dismod			- disable given modifier = value
  *   - _swmod/{old_modifier}	- new_modifier = value
  *				  - disable old_modifier and then enable new_modifier
  *				  - if old_modifier is not enabled just return
  *				  - check transmit sequence firstly
+ *   - _stsave			- save the state snapshot to file = value
+ *				  - active verb, devices, modifiers and the values
+ *				    of the controls written by the sequences
+ *   - _strestore		- restore the state snapshot from file = value
+ *				  - the manager must not have an active verb
+ *				  - when the saved controls still hold their
+ *				    values (one read per control), the verb,
+ *				    devices and modifiers are only marked active
+ *				  - otherwise the verb is set and the devices and
+ *				    modifiers are enabled (sequences executed)
  */
 int snd_use_case_set(snd_use_case_mgr_t *uc_mgr,
                      const char *identifier,
@@ -473,6 +491,14 @@ int snd_use_case_set(snd_use_case_mgr_t *uc_mgr,
  * for the ALSA card specified by the card index (value) or
  * the card string identificator.
  *
+ * The "lazy:" prefix (followed by any of the above) defers parsing of
+ * the verb files until the verb is used (set, or queried for its
+ * devices, modifiers or values); only the master file is parsed
+ * when the manager is opened.  Errors in a verb file are reported
+ * when the verb is used.  Variables defined in a verb file become
+ * visible only after that verb is loaded, so this mode is meant for
+ * configurations where the verb files are independent.
+ *
  * The sound card might be also composed from several physical
  * sound cards (for the default and strict card_name).
  * The application cannot expect that the device names will refer
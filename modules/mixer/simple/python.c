@@ -39,11 +39,82 @@ struct python_priv {
 
 #define SCRIPT "smixer/python/main.py"
 
+/*
+ * The ops methods are looked up once per class (not per element and call)
+ * and called unbound, with the element as the first argument.
+ */
+enum {
+	OPS_IS_ACTIVE,
+	OPS_IS_MONO,
+	OPS_IS_CHANNEL,
+	OPS_IS_ENUMERATED,
+	OPS_IS_ENUMCNT,
+	OPS_GET_RANGE,
+	OPS_SET_RANGE,
+	OPS_GET_DB_RANGE,
+	OPS_GET_VOL_DB,
+	OPS_GET_DB_VOL,
+	OPS_GET_VOLUME,
+	OPS_GET_DB,
+	OPS_SET_VOLUME,
+	OPS_SET_DB,
+	OPS_GET_SWITCH,
+	OPS_SET_SWITCH,
+	OPS_GET_ENUM_ITEM_NAME,
+	OPS_GET_ENUM_ITEM,
+	OPS_SET_ENUM_ITEM,
+	OPS_GET_VALUES,
+	OPS_COUNT
+};
+
+static const char *const ops_attr[OPS_COUNT] = {
+	[OPS_IS_ACTIVE] = "opsIsActive",
+	[OPS_IS_MONO] = "opsIsMono",
+	[OPS_IS_CHANNEL] = "opsIsChannel",
+	[OPS_IS_ENUMERATED] = "opsIsEnumerated",
+	[OPS_IS_ENUMCNT] = "opsIsEnumCnt",
+	[OPS_GET_RANGE] = "opsGetRange",
+	[OPS_SET_RANGE] = "opsSetRange",
+	[OPS_GET_DB_RANGE] = "opsGetDBRange",
+	[OPS_GET_VOL_DB] = "opsGetVolDB",
+	[OPS_GET_DB_VOL] = "opsGetDBVol",
+	[OPS_GET_VOLUME] = "opsGetVolume",
+	[OPS_GET_DB] = "opsGetDB",
+	[OPS_SET_VOLUME] = "opsSetVolume",
+	[OPS_SET_DB] = "opsSetDB",
+	[OPS_GET_SWITCH] = "opsGetSwitch",
+	[OPS_SET_SWITCH] = "opsSetSwitch",
+	[OPS_GET_ENUM_ITEM_NAME] = "opsGetEnumItemName",
+	[OPS_GET_ENUM_ITEM] = "opsGetEnumItem",
+	[OPS_SET_ENUM_ITEM] = "opsSetEnumItem",
+	[OPS_GET_VALUES] = "opsGetValues",
+};
+
+struct pyclass_ops {
+	PyTypeObject *type;
+	PyObject *func[OPS_COUNT];	/* NULL = not resolved yet, Py_None = missing */
+	struct pyclass_ops *next;
+};
+
+/* values of all channels as returned by opsGetValues() */
+#define VALUES_VOLUME	0
+#define VALUES_SWITCH	1
+#define VALUES_DB	2
+
+struct pyvalues {
+	unsigned int count[3];
+	long val[3][SND_MIXER_SCHN_LAST + 1];
+};
+
 struct pymelem {
 	PyObject_HEAD
 	sm_selem_t selem;
 	PyObject *py_mixer;
 	snd_mixer_elem_t *melem;
+	struct pyclass_ops *ops;
+	unsigned int values_gen;	/* generation of values[] */
+	int values_ok;
+	struct pyvalues values[2];
 };
 
 struct pymixer {
@@ -60,6 +131,10 @@ struct pymixer {
 };
 
 static PyInterpreterState *main_interpreter;
+static PyObject *ops_names[OPS_COUNT];
+static struct pyclass_ops *class_ops;
+/* bumped by every event and set operation, invalidates the values snapshots */
+static unsigned int values_generation = 1;
 
 #if PY_MAJOR_VERSION >= 3
   #define PyInt_FromLong PyLong_FromLong
@@ -111,15 +186,94 @@ static struct pymelem *melem_to_pymelem(snd_mixer_elem_t *elem)
 	return (struct pymelem *)((char *)snd_mixer_elem_get_private(elem) - offsetof(struct pymelem, selem));
 }
 
-static int pcall(struct pymelem *pymelem, const char *attr, PyObject *args, PyObject **_res)
+static struct pyclass_ops *class_ops_get(PyTypeObject *type)
+{
+	struct pyclass_ops *c;
+
+	for (c = class_ops; c; c = c->next)
+		if (c->type == type)
+			return c;
+	c = calloc(1, sizeof(*c));
+	if (c == NULL)
+		return NULL;
+	Py_INCREF(type);
+	c->type = type;
+	c->next = class_ops;
+	class_ops = c;
+	return c;
+}
+
+static void class_ops_free(void)
+{
+	struct pyclass_ops *c;
+	int op;
+
+	while ((c = class_ops) != NULL) {
+		class_ops = c->next;
+		for (op = 0; op < OPS_COUNT; op++)
+			Py_XDECREF(c->func[op]);
+		Py_DECREF(c->type);
+		free(c);
+	}
+	for (op = 0; op < OPS_COUNT; op++) {
+		Py_XDECREF(ops_names[op]);
+		ops_names[op] = NULL;
+	}
+}
+
+/* return the (borrowed) class function of op, Py_None when missing */
+static PyObject *ops_func(struct pymelem *pymelem, int op)
+{
+	PyTypeObject *type = Py_TYPE(pymelem);
+	PyObject *func;
+
+	if (pymelem->ops == NULL || pymelem->ops->type != type) {
+		pymelem->ops = class_ops_get(type);
+		if (pymelem->ops == NULL)
+			return Py_None;
+	}
+	func = pymelem->ops->func[op];
+	if (func)
+		return func;
+	if (ops_names[op] == NULL) {
+		ops_names[op] = InternFromString(ops_attr[op]);
+		if (ops_names[op] == NULL) {
+			PyErr_Clear();
+			return Py_None;
+		}
+	}
+	func = PyObject_GetAttr((PyObject *)type, ops_names[op]);
+	if (func == NULL) {
+		PyErr_Clear();
+		func = Py_None;
+		Py_INCREF(func);
+	}
+	pymelem->ops->func[op] = func;
+	return func;
+}
+
+/* argument tuple for an ops call, the element itself is the first item */
+static PyObject *ops_args(struct pymelem *pymelem, int count)
+{
+	PyObject *args = PyTuple_New(count + 1);
+
+	if (args) {
+		Py_INCREF(pymelem);
+		PyTuple_SET_ITEM(args, 0, (PyObject *)pymelem);
+	}
+	return args;
+}
+
+static int pcall(struct pymelem *pymelem, int op, PyObject *args, PyObject **_res)
 {
-	PyObject *obj = (PyObject *)pymelem, *res;
+	const char *attr = ops_attr[op];
+	PyObject *obj, *res;
 	long xres = 0;
 
 	if (_res)
 		*_res = NULL;
-	obj = PyObject_GetAttr(obj, InternFromString(attr));
-	if (!obj) {
+	obj = ops_func(pymelem, op);
+	if (obj == Py_None) {
 		PyErr_Format(PyExc_TypeError, "missing '%s' attribute", attr);
 		PyErr_Print();
 		PyErr_Clear();
@@ -166,40 +320,38 @@ static int is_ops(snd_mixer_elem_t *elem, int dir, int cmd, int val)
 {
 	PyObject *obj1;
 	struct pymelem *pymelem = melem_to_pymelem(elem);
-	char *s, fcn[32] = "opsIs";
-	int res, xdir = 1, xval = 0;
+	int op, res, xdir = 1, xval = 0;
 
 	switch (cmd) {
-	case SM_OPS_IS_ACTIVE: 	s = "Active"; xdir = 0; break;
-	case SM_OPS_IS_MONO:	s = "Mono"; break;
-	case SM_OPS_IS_CHANNEL:	s = "Channel"; xval = 1; break;
-	case SM_OPS_IS_ENUMERATED: s = "Enumerated"; xdir = val == 1; break;
-	case SM_OPS_IS_ENUMCNT:	s = "EnumCnt"; break;
+	case SM_OPS_IS_ACTIVE: 	op = OPS_IS_ACTIVE; xdir = 0; break;
+	case SM_OPS_IS_MONO:	op = OPS_IS_MONO; break;
+	case SM_OPS_IS_CHANNEL:	op = OPS_IS_CHANNEL; xval = 1; break;
+	case SM_OPS_IS_ENUMERATED: op = OPS_IS_ENUMERATED; xdir = val == 1; break;
+	case SM_OPS_IS_ENUMCNT:	op = OPS_IS_ENUMCNT; break;
 	default:
 		return 1;
 	}
-	strcat(fcn, s);
 
-	obj1 = PyTuple_New(xdir + xval);
+	obj1 = ops_args(pymelem, xdir + xval);
 	if (xdir) {
-		PyTuple_SET_ITEM(obj1, 0, PyInt_FromLong(dir));
+		PyTuple_SET_ITEM(obj1, 1, PyInt_FromLong(dir));
 		if (xval)
-			PyTuple_SET_ITEM(obj1, 1, PyInt_FromLong(val));
+			PyTuple_SET_ITEM(obj1, 2, PyInt_FromLong(val));
 	}
-	res = pcall(pymelem, fcn, obj1, NULL);
+	res = pcall(pymelem, op, obj1, NULL);
 	return res < 0 ? 0 : res;
 }
 
 static int get_x_range_ops(snd_mixer_elem_t *elem, int dir,
-                           long *min, long *max, const char *attr)
+                           long *min, long *max, int op)
 {
 	PyObject *obj1, *t1, *t2, *res;
 	struct pymelem *pymelem = melem_to_pymelem(elem);
 	int err;
 	
-	obj1 = PyTuple_New(1);
-	PyTuple_SET_ITEM(obj1, 0, PyInt_FromLong(dir));
-	err = pcall(pymelem, attr, obj1, &res);
+	obj1 = ops_args(pymelem, 1);
+	PyTuple_SET_ITEM(obj1, 1, PyInt_FromLong(dir));
+	err = pcall(pymelem, op, obj1, &res);
 	if (err >= 0) {
 		t1 = PyTuple_GetItem(res, 1);
 		t2 = PyTuple_GetItem(res, 2);
@@ -227,7 +379,7 @@ static int get_x_range_ops(snd_mixer_elem_t *elem, int dir,
 static int get_range_ops(snd_mixer_elem_t *elem, int dir,
                          long *min, long *max)
 {
-	return get_x_range_ops(elem, dir, min, max, "opsGetRange");
+	return get_x_range_ops(elem, dir, min, max, OPS_GET_RANGE);
 }
 
 static int set_range_ops(snd_mixer_elem_t *elem, int dir,
@@ -236,25 +388,26 @@ static int set_range_ops(snd_mixer_elem_t *elem, int dir,
 	PyObject *obj1;
 	struct pymelem *pymelem = melem_to_pymelem(elem);
 
-	obj1 = PyTuple_New(3);
-	PyTuple_SET_ITEM(obj1, 0, PyInt_FromLong(dir));
-	PyTuple_SET_ITEM(obj1, 1, PyInt_FromLong(min));
-	PyTuple_SET_ITEM(obj1, 2, PyInt_FromLong(max));
-	return pcall(pymelem, "opsGetRange", obj1, NULL);
+	obj1 = ops_args(pymelem, 3);
+	PyTuple_SET_ITEM(obj1, 1, PyInt_FromLong(dir));
+	PyTuple_SET_ITEM(obj1, 2, PyInt_FromLong(min));
+	PyTuple_SET_ITEM(obj1, 3, PyInt_FromLong(max));
+	values_generation++;
+	return pcall(pymelem, OPS_SET_RANGE, obj1, NULL);
 }
 
 static int get_x_ops(snd_mixer_elem_t *elem, int dir,
                      long channel, long *value,
-                     const char *attr)
+                     int op)
 {
 	PyObject *obj1, *t1, *res;
 	struct pymelem *pymelem = melem_to_pymelem(elem);
 	int err;
 	
-	obj1 = PyTuple_New(2);
-	PyTuple_SET_ITEM(obj1, 0, PyInt_FromLong(dir));
-	PyTuple_SET_ITEM(obj1, 1, PyInt_FromLong(channel));
-	err = pcall(pymelem, attr, obj1, &res);
+	obj1 = ops_args(pymelem, 2);
+	PyTuple_SET_ITEM(obj1, 1, PyInt_FromLong(dir));
+	PyTuple_SET_ITEM(obj1, 2, PyInt_FromLong(channel));
+	err = pcall(pymelem, op, obj1, &res);
 	if (err >= 0) {
 		t1 = PyTuple_GetItem(res, 1);
 		if (PyLong_Check(t1)) {
@@ -276,10 +429,103 @@ static int get_x_ops(snd_mixer_elem_t *elem, int dir,
 	return err;
 }
 
+static void values_fill(struct pyvalues *v, int kind, PyObject *seq)
+{
+	Py_ssize_t idx, count;
+	PyObject *o;
+	int err;
+
+	v->count[kind] = 0;
+	if (seq == NULL || seq == Py_None)
+		return;
+	count = PySequence_Size(seq);
+	if (count < 0 || count > SND_MIXER_SCHN_LAST + 1) {
+		PyErr_Clear();
+		return;
+	}
+	for (idx = 0; idx < count; idx++) {
+		o = PySequence_GetItem(seq, idx);
+		if (o == NULL) {
+			PyErr_Clear();
+			return;
+		}
+		err = get_long(o, &v->val[kind][idx]);
+		Py_DECREF(o);
+		/* let the per-channel op report the wrong value */
+		if (err)
+			return;
+	}
+	v->count[kind] = count;
+}
+
+/*
+ * Optional opsGetValues() returns the values of all channels in one call,
+ * ((volumes, switches[, dBs]), (volumes, switches[, dBs])) for playback
+ * and capture, any of them may be None.  The snapshot is kept until the
+ * next event or set operation; channels missing from it go through the
+ * single value ops as before.
+ */
+static int values_update(struct pymelem *pymelem)
+{
+	PyObject *func, *args, *res, *d, *seq;
+	int dir, kind;
+
+	if (pymelem->values_gen == values_generation)
+		return pymelem->values_ok;
+	pymelem->values_gen = values_generation;
+	pymelem->values_ok = 0;
+	func = ops_func(pymelem, OPS_GET_VALUES);
+	if (func == Py_None)
+		return 0;
+	args = ops_args(pymelem, 0);
+	res = PyObject_CallObject(func, args);
+	Py_XDECREF(args);
+	if (res == NULL) {
+		PyErr_Print();
+		PyErr_Clear();
+		return 0;
+	}
+	for (dir = 0; dir < 2; dir++) {
+		d = PySequence_Check(res) ? PySequence_GetItem(res, dir) : NULL;
+		if (d == NULL)
+			PyErr_Clear();
+		for (kind = VALUES_VOLUME; kind <= VALUES_DB; kind++) {
+			seq = NULL;
+			if (d && d != Py_None && PySequence_Check(d) &&
+			    kind < PySequence_Size(d))
+				seq = PySequence_GetItem(d, kind);
+			values_fill(&pymelem->values[dir], kind, seq);
+			Py_XDECREF(seq);
+		}
+		Py_XDECREF(d);
+	}
+	PyErr_Clear();
+	Py_DECREF(res);
+	pymelem->values_ok = 1;
+	return 1;
+}
+
+static int values_get(snd_mixer_elem_t *elem, int dir, int kind,
+		      long channel, long *value)
+{
+	struct pymelem *pymelem = melem_to_pymelem(elem);
+	struct pyvalues *v;
+
+	if (dir < SM_PLAY || dir > SM_CAPT || !values_update(pymelem))
+		return 0;
+	v = &pymelem->values[dir];
+	if (channel < 0 || channel >= (long)v->count[kind])
+		return 0;
+	*value = v->val[kind][channel];
+	return 1;
+}
+
 static int get_volume_ops(snd_mixer_elem_t *elem, int dir,
 			  snd_mixer_selem_channel_id_t channel, long *value)
 {
-	return get_x_ops(elem, dir, channel, value, "opsGetVolume");
+	if (values_get(elem, dir, VALUES_VOLUME, channel, value))
+		return 0;
+	return get_x_ops(elem, dir, channel, value, OPS_GET_VOLUME);
 }
 
 static int get_switch_ops(snd_mixer_elem_t *elem, int dir,
@@ -287,7 +533,12 @@ static int get_switch_ops(snd_mixer_elem_t *elem, int dir,
 {
 	long value1;
 	int res;
-	res = get_x_ops(elem, dir, channel, &value1, "opsGetSwitch");
+
+	if (values_get(elem, dir, VALUES_SWITCH, channel, &value1)) {
+		*value = value1;
+		return 0;
+	}
+	res = get_x_ops(elem, dir, channel, &value1, OPS_GET_SWITCH);
 	*value = value1;
 	return res;
 }
@@ -297,7 +548,7 @@ static int ask_vol_dB_ops(snd_mixer_elem_t *elem,
 			  long value,
 			  long *dbValue)
 {
-	return get_x_ops(elem, dir, value, dbValue, "opsGetVolDB");
+	return get_x_ops(elem, dir, value, dbValue, OPS_GET_VOL_DB);
 }
 
 static int ask_dB_vol_ops(snd_mixer_elem_t *elem,
@@ -310,11 +561,11 @@ static int ask_dB_vol_ops(snd_mixer_elem_t *elem,
 	struct pymelem *pymelem = melem_to_pymelem(elem);
 	int err;
 	
-	obj1 = PyTuple_New(3);
-	PyTuple_SET_ITEM(obj1, 0, PyInt_FromLong(dir));
-	PyTuple_SET_ITEM(obj1, 1, PyInt_FromLong(value));
-	PyTuple_SET_ITEM(obj1, 2, PyInt_FromLong(xdir));
-	err = pcall(pymelem, "opsGetDBVol", obj1, &res);
+	obj1 = ops_args(pymelem, 3);
+	PyTuple_SET_ITEM(obj1, 1, PyInt_FromLong(dir));
+	PyTuple_SET_ITEM(obj1, 2, PyInt_FromLong(value));
+	PyTuple_SET_ITEM(obj1, 3, PyInt_FromLong(xdir));
+	err = pcall(pymelem, OPS_GET_DB_VOL, obj1, &res);
 	if (err >= 0) {
 		t1 = PyTuple_GetItem(res, 1);
 		if (PyLong_Check(t1)) {
@@ -341,13 +592,15 @@ static int get_dB_ops(snd_mixer_elem_t *elem,
                       snd_mixer_selem_channel_id_t channel,
                       long *value)
 {
-	return get_x_ops(elem, dir, channel, value, "opsGetDB");
+	if (values_get(elem, dir, VALUES_DB, channel, value))
+		return 0;
+	return get_x_ops(elem, dir, channel, value, OPS_GET_DB);
 }
 
 static int get_dB_range_ops(snd_mixer_elem_t *elem, int dir,
                             long *min, long *max)
 {
-	return get_x_range_ops(elem, dir, min, max, "opsGetDBRange");
+	return get_x_range_ops(elem, dir, min, max, OPS_GET_DB_RANGE);
 }
 
 static int set_volume_ops(snd_mixer_elem_t *elem, int dir,
@@ -356,11 +609,12 @@ static int set_volume_ops(snd_mixer_elem_t *elem, int dir,
 	PyObject *obj1;
 	struct pymelem *pymelem = melem_to_pymelem(elem);
 
-	obj1 = PyTuple_New(3);
-	PyTuple_SET_ITEM(obj1, 0, PyInt_FromLong(dir));
-	PyTuple_SET_ITEM(obj1, 1, PyInt_FromLong(channel));
-	PyTuple_SET_ITEM(obj1, 2, PyInt_FromLong(value));
-	return pcall(pymelem, "opsSetVolume", obj1, NULL);
+	obj1 = ops_args(pymelem, 3);
+	PyTuple_SET_ITEM(obj1, 1, PyInt_FromLong(dir));
+	PyTuple_SET_ITEM(obj1, 2, PyInt_FromLong(channel));
+	PyTuple_SET_ITEM(obj1, 3, PyInt_FromLong(value));
+	values_generation++;
+	return pcall(pymelem, OPS_SET_VOLUME, obj1, NULL);
 }
 
 static int set_switch_ops(snd_mixer_elem_t *elem, int dir,
@@ -369,11 +623,12 @@ static int set_switch_ops(snd_mixer_elem_t *elem, int dir,
 	PyObject *obj1;
 	struct pymelem *pymelem = melem_to_pymelem(elem);
 
-	obj1 = PyTuple_New(3);
-	PyTuple_SET_ITEM(obj1, 0, PyInt_FromLong(dir));
-	PyTuple_SET_ITEM(obj1, 1, PyInt_FromLong(channel));
-	PyTuple_SET_ITEM(obj1, 2, PyInt_FromLong(value));
-	return pcall(pymelem, "opsSetSwitch", obj1, NULL);
+	obj1 = ops_args(pymelem, 3);
+	PyTuple_SET_ITEM(obj1, 1, PyInt_FromLong(dir));
+	PyTuple_SET_ITEM(obj1, 2, PyInt_FromLong(channel));
+	PyTuple_SET_ITEM(obj1, 3, PyInt_FromLong(value));
+	values_generation++;
+	return pcall(pymelem, OPS_SET_SWITCH, obj1, NULL);
 }
 
 static int set_dB_ops(snd_mixer_elem_t *elem, int dir,
@@ -383,12 +638,13 @@ static int set_dB_ops(snd_mixer_elem_t *elem, int dir,
 	PyObject *obj1;
 	struct pymelem *pymelem = melem_to_pymelem(elem);
 
-	obj1 = PyTuple_New(4);
-	PyTuple_SET_ITEM(obj1, 0, PyInt_FromLong(dir));
-	PyTuple_SET_ITEM(obj1, 1, PyInt_FromLong(channel));
-	PyTuple_SET_ITEM(obj1, 2, PyInt_FromLong(db_gain));
-	PyTuple_SET_ITEM(obj1, 3, PyInt_FromLong(xdir));
-	return pcall(pymelem, "opsSetDB", obj1, NULL);
+	obj1 = ops_args(pymelem, 4);
+	PyTuple_SET_ITEM(obj1, 1, PyInt_FromLong(dir));
+	PyTuple_SET_ITEM(obj1, 2, PyInt_FromLong(channel));
+	PyTuple_SET_ITEM(obj1, 3, PyInt_FromLong(db_gain));
+	PyTuple_SET_ITEM(obj1, 4, PyInt_FromLong(xdir));
+	values_generation++;
+	return pcall(pymelem, OPS_SET_DB, obj1, NULL);
 }
 
 static int enum_item_name_ops(snd_mixer_elem_t *elem,
@@ -401,9 +657,9 @@ static int enum_item_name_ops(snd_mixer_elem_t *elem,
 	unsigned int len;
 	char *s;
 	
-	obj1 = PyTuple_New(1);
-	PyTuple_SET_ITEM(obj1, 0, PyInt_FromLong(item));
-	err = pcall(pymelem, "opsGetEnumItemName", obj1, &res);
+	obj1 = ops_args(pymelem, 1);
+	PyTuple_SET_ITEM(obj1, 1, PyInt_FromLong(item));
+	err = pcall(pymelem, OPS_GET_ENUM_ITEM_NAME, obj1, &res);
 	if (err >= 0) {
 		t1 = PyTuple_GetItem(res, 1);
 		if (PyUnicode_Check(t1)) {
@@ -448,9 +704,9 @@ static int get_enum_item_ops(snd_mixer_elem_t *elem,
 	struct pymelem *pymelem = melem_to_pymelem(elem);
 	int err;
 	
-	obj1 = PyTuple_New(1);
-	PyTuple_SET_ITEM(obj1, 0, PyInt_FromLong(channel));
-	err = pcall(pymelem, "opsGetEnumItem", obj1, &res);
+	obj1 = ops_args(pymelem, 1);
+	PyTuple_SET_ITEM(obj1, 1, PyInt_FromLong(channel));
+	err = pcall(pymelem, OPS_GET_ENUM_ITEM, obj1, &res);
 	if (err >= 0) {
 		t1 = PyTuple_GetItem(res, 1);
 		if (PyLong_Check(t1)) {
@@ -479,10 +735,11 @@ static int set_enum_item_ops(snd_mixer_elem_t *elem,
 	PyObject *obj1;
 	struct pymelem *pymelem = melem_to_pymelem(elem);
 
-	obj1 = PyTuple_New(2);
-	PyTuple_SET_ITEM(obj1, 0, PyInt_FromLong(channel));
-	PyTuple_SET_ITEM(obj1, 1, PyInt_FromLong(item));
-	return pcall(pymelem, "opsSetEnumItem", obj1, NULL);
+	obj1 = ops_args(pymelem, 2);
+	PyTuple_SET_ITEM(obj1, 1, PyInt_FromLong(channel));
+	PyTuple_SET_ITEM(obj1, 2, PyInt_FromLong(item));
+	values_generation++;
+	return pcall(pymelem, OPS_SET_ENUM_ITEM, obj1, NULL);
 }
 
 static struct sm_elem_ops simple_python_ops = {
@@ -984,6 +1241,7 @@ int alsa_mixer_simple_event(snd_mixer_class_t *class, unsigned int mask,
 
 	tstate = PyThreadState_New(main_interpreter);
 	PyThreadState_Swap(tstate);
+	values_generation++;
         
         t = PyTuple_New(3);
         if (t) {
@@ -1033,6 +1291,7 @@ static void alsa_mixer_simple_free(snd_mixer_class_t *class)
 	}
 	if (priv->py_initialized) {
 		Py_XDECREF(priv->py_event_func);
+		class_ops_free();
 		Py_Finalize();
 	}
 	free(priv);
@@ -122,6 +122,19 @@ class StandardElement(BaseElement):
     hv.setArray(self.switchinfo[dir].type, self.switcharray[dir])
     hv.write()
 
+  def opsGetValues(self):
+    res = []
+    for dir in [0, 1]:
+      volumes = None
+      switches = None
+      if self.volume[dir]:
+        info = self.volumeinfo[dir]
+        volumes = [self.volumeToUser(info, dir, v) for v in self.volumearray[dir]]
+      if self.switch[dir]:
+        switches = self.switcharray[dir]
+      res.append((volumes, switches))
+    return res
+
   def update(self, helem):
     for i in [0, 1]:
       if helem == self.volume[i]:
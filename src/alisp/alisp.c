@@ -30,6 +30,7 @@
 #include <ctype.h>
 #include <math.h>
 #include <err.h>
+#include <sys/stat.h>
 
 #define alisp_seq_iterator alisp_object
 
@@ -37,6 +38,10 @@
 #include "alisp.h"
 #include "alisp_local.h"
 
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+
 struct alisp_object alsa_lisp_nil;
 struct alisp_object alsa_lisp_t;
 
@@ -130,21 +135,30 @@ static struct alisp_object * new_object(struct alisp_instance *instance, int typ
 	struct alisp_object * p;
 
 	if (list_empty(&instance->free_objs_list)) {
-		p = (struct alisp_object *)malloc(sizeof(struct alisp_object));
-		if (p == NULL) {
+		struct alisp_slab *slab;
+		int i;
+
+		slab = malloc(sizeof(*slab));
+		if (slab == NULL) {
 			nomem();
 			return NULL;
 		}
-		lisp_debug(instance, "allocating cons %p", p);
-	} else {
-		p = (struct alisp_object *)instance->free_objs_list.next;
-		list_del(&p->list);
-		instance->free_objs--;
-		lisp_debug(instance, "recycling cons %p", p);
-	}
+		lisp_debug(instance, "allocating slab %p", slab);
+		slab->next = instance->slab_list;
+		instance->slab_list = slab;
+		instance->slabs++;
+		for (i = 0; i < ALISP_SLAB_OBJS; i++)
+			list_add_tail(&slab->objs[i].list, &instance->free_objs_list);
+		instance->free_objs += ALISP_SLAB_OBJS;
+	}
+	p = (struct alisp_object *)instance->free_objs_list.next;
+	list_del(&p->list);
+	instance->free_objs--;
+	lisp_debug(instance, "recycling cons %p", p);
 
 	instance->used_objs++;
 
+	p->type_refs = 0;
 	alisp_set_type(p, type);
 	alisp_set_refs(p, 1);
 	if (type == ALISP_OBJ_CONS) {
@@ -188,11 +202,6 @@ static void delete_object(struct alisp_instance *instance, struct alisp_object *
 	list_del(&p->list);
 	instance->used_objs--;
 	free_object(p);
-	if (instance->free_objs >= ALISP_FREE_OBJ_POOL) {
-		lisp_debug(instance, "freed cons %p", p);
-		free(p);
-		return;
-	}
 	lisp_debug(instance, "moved cons %p to free list", p);
 	list_add(&p->list, &instance->free_objs_list);
 	instance->free_objs++;
@@ -286,12 +295,77 @@ static void free_objects(struct alisp_instance *instance)
 				delete_object(instance, p);
 			}
 		}
-	list_for_each_safe(pos, pos1, &instance->free_objs_list) {
-		p = list_entry(pos, struct alisp_object, list);
-		list_del(&p->list);
-		free(p);
-		lisp_debug(instance, "freed (all) cons %p", p);
+	while (instance->slab_list) {
+		struct alisp_slab *slab = instance->slab_list;
+		instance->slab_list = slab->next;
+		lisp_debug(instance, "freed slab %p", slab);
+		free(slab);
 	}
+	INIT_LIST_HEAD(&instance->free_objs_list);
+	instance->free_objs = 0;
+	instance->slabs = 0;
+}
+
+/*
+ * Mark and sweep collector. The reference counts free most objects
+ * immediately; this pass reclaims the objects which are no longer
+ * reachable from the variables (leaked or cyclic references). It may
+ * only run when no evaluation is in progress.
+ */
+static void gc_mark(struct alisp_object *p)
+{
+	while (p != NULL && p != &alsa_lisp_nil && p != &alsa_lisp_t &&
+	       !(p->type_refs & ALISP_MARK_MASK)) {
+		p->type_refs |= ALISP_MARK_MASK;
+		if (!alisp_compare_type(p, ALISP_OBJ_CONS))
+			break;
+		gc_mark(p->value.c.car);
+		p = p->value.c.cdr;
+	}
+}
+
+static void gc_collect(struct alisp_instance *instance)
+{
+	struct list_head *pos, *pos1;
+	struct alisp_object_pair *pair;
+	struct alisp_object *p;
+	long freed = 0;
+	int i, j;
+
+	for (i = 0; i < ALISP_OBJ_PAIR_HASH_SIZE; i++)
+		list_for_each(pos, &instance->setobjs_list[i]) {
+			pair = list_entry(pos, struct alisp_object_pair, list);
+			gc_mark(pair->value);
+		}
+	for (i = 0; i < ALISP_OBJ_PAIR_HASH_SIZE; i++)
+		for (j = 0; j <= ALISP_OBJ_LAST_SEARCH; j++) {
+			list_for_each_safe(pos, pos1, &instance->used_objs_list[i][j]) {
+				p = list_entry(pos, struct alisp_object, list);
+				if (p->type_refs & ALISP_MARK_MASK) {
+					p->type_refs &= ~ALISP_MARK_MASK;
+					continue;
+				}
+				list_del(&p->list);
+				free_object(p);
+				list_add(&p->list, &instance->free_objs_list);
+				instance->used_objs--;
+				instance->free_objs++;
+				freed++;
+			}
+		}
+	instance->gc_runs++;
+	instance->gc_freed += freed;
+	instance->gc_request = 0;
+	instance->gc_threshold = instance->used_objs * 2;
+	if (instance->gc_threshold < ALISP_GC_MIN_OBJS)
+		instance->gc_threshold = ALISP_GC_MIN_OBJS;
+	lisp_debug(instance, "gc: freed %li objects, used %li", freed, instance->used_objs);
+}
+
+static inline void gc_safe_point(struct alisp_instance *instance)
+{
+	if (instance->gc_request || instance->used_objs >= instance->gc_threshold)
+		gc_collect(instance);
 }
 
 static struct alisp_object * search_object_identifier(struct alisp_instance *instance, const char *s)
@@ -542,7 +616,7 @@ static char * extend_buf(struct alisp_instance *instance, char *p)
 	return instance->token_buffer + off;
 }
 
-static int gettoken(struct alisp_instance *instance)
+static int lex_token(struct alisp_instance *instance)
 {
 	char *p;
 	int c;
@@ -686,6 +760,23 @@ static int gettoken(struct alisp_instance *instance)
 	}
 }
 
+static int gettoken(struct alisp_instance *instance)
+{
+	struct alisp_token *t;
+
+	if (instance->code) {
+		if (instance->code_pos >= instance->code->ntokens)
+			return instance->thistoken = EOF;
+		t = &instance->code->tokens[instance->code_pos++];
+		instance->token = t->s;
+		instance->lineno = t->lineno;
+		return instance->thistoken = t->type;
+	}
+	lex_token(instance);
+	instance->token = instance->token_buffer;
+	return instance->thistoken;
+}
+
 /*
  *  parser
  */
@@ -792,25 +883,25 @@ static struct alisp_object * parse_object(struct alisp_instance *instance, int h
 		p = parse_quote(instance);
 		break;
 	case ALISP_IDENTIFIER:
-		if (!strcmp(instance->token_buffer, "t"))
+		if (!strcmp(instance->token, "t"))
 			p = &alsa_lisp_t;
-		else if (!strcmp(instance->token_buffer, "nil"))
+		else if (!strcmp(instance->token, "nil"))
 			p = &alsa_lisp_nil;
 		else {
-			p = new_identifier(instance, instance->token_buffer);
+			p = new_identifier(instance, instance->token);
 		}
 		break;
 	case ALISP_INTEGER: {
-		p = new_integer(instance, atol(instance->token_buffer));
+		p = new_integer(instance, atol(instance->token));
 		break;
 	}
 	case ALISP_FLOAT:
 	case ALISP_FLOATE: {
-		p = new_float(instance, atof(instance->token_buffer));
+		p = new_float(instance, atof(instance->token));
 		break;
 	}
 	case ALISP_STRING:
-		p = new_string(instance, instance->token_buffer);
+		p = new_string(instance, instance->token);
 		break;
 	default:
 		lisp_warn(instance, "%d:%d: unexpected character `%c'", instance->lineno, instance->charno, thistoken);
@@ -2376,9 +2467,11 @@ static struct alisp_object * eval_func(struct alisp_instance *instance, struct a
 	return &alsa_lisp_nil;
 }
 
-struct alisp_object * F_gc(struct alisp_instance *instance ATTRIBUTE_UNUSED, struct alisp_object * args ATTRIBUTE_UNUSED)
+struct alisp_object * F_gc(struct alisp_instance *instance, struct alisp_object * args)
 {
-	/* improved: no more traditional gc */
+	/* collect after the current top-level form */
+	delete_tree(instance, args);
+	instance->gc_request = 1;
 	return &alsa_lisp_t;
 }
 
@@ -2930,6 +3023,10 @@ static struct alisp_object * F_stat_memory(struct alisp_instance *instance, stru
 			  (int)sizeof(struct alisp_object),
 			  (long)((instance->used_objs + instance->free_objs) * sizeof(struct alisp_object)),
 			  (long)(instance->max_objs * sizeof(struct alisp_object)));
+	snd_output_printf(instance->out, "  slabs = %li, gc_runs = %li, gc_freed = %li\n",
+			  instance->slabs,
+			  instance->gc_runs,
+			  instance->gc_freed);
 	delete_tree(instance, args);
 	return &alsa_lisp_nil;
 }
@@ -3145,24 +3242,205 @@ static struct alisp_object * F_eval(struct alisp_instance *instance, struct alis
  *  main routine
  */
 
-static int alisp_include_file(struct alisp_instance *instance, const char *filename)
+/*
+ * Code cache: the files are lexed only once per process, the token
+ * stream is replayed by the parser on the next evaluation. An entry is
+ * rebuilt when the file changes (inode, size or mtime).
+ */
+
+static LIST_HEAD(code_cache);
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t code_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define code_cache_lock()	pthread_mutex_lock(&code_cache_mutex)
+#define code_cache_unlock()	pthread_mutex_unlock(&code_cache_mutex)
+#else
+#define code_cache_lock()	do { } while (0)
+#define code_cache_unlock()	do { } while (0)
+#endif
+
+static void code_free(struct alisp_code *code)
 {
-	snd_input_t *old_in;
-	struct alisp_object *p, *p1;
-	char *name;
-	int retval = 0, err;
+	free(code->filename);
+	free(code->tokens);
+	free(code->pool);
+	free(code);
+}
+
+static void code_put(struct alisp_code *code)
+{
+	code_cache_lock();
+	if (--code->refs == 0)
+		code_free(code);
+	code_cache_unlock();
+}
+
+static int code_has_text(int token)
+{
+	return token == ALISP_IDENTIFIER || token == ALISP_INTEGER ||
+	       token == ALISP_FLOAT || token == ALISP_FLOATE ||
+	       token == ALISP_STRING;
+}
+
+/*
+ * Lex the whole file into a token array with one string pool.
+ */
+static int code_compile(struct alisp_instance *instance, const char *name,
+			struct alisp_code *code)
+{
+	snd_input_t *old_in = instance->in;
+	int old_lineno = instance->lineno, old_charno = instance->charno;
+	struct alisp_token *t;
+	size_t pool_size = 0, pool_max = 0, len;
+	unsigned int tmax = 0, idx;
+	char *pool;
+	void *n;
+	int err, token;
 
-	err = snd_user_file(filename, &name);
-	if (err < 0)
-		return err;
-	old_in = instance->in;
 	err = snd_input_stdio_open(&instance->in, name, "r");
 	if (err < 0) {
-		retval = err;
-		goto _err;
+		instance->in = old_in;
+		return err;
 	}
-	if (instance->verbose)
-		lisp_verbose(instance, "** include filename '%s'", name);
+	instance->lineno = instance->charno = 1;
+	for (;;) {
+		token = lex_token(instance);
+		if (code->ntokens >= tmax) {
+			tmax = tmax ? tmax * 2 : 256;
+			n = realloc(code->tokens, tmax * sizeof(*code->tokens));
+			if (n == NULL)
+				goto __nomem;
+			code->tokens = n;
+		}
+		t = &code->tokens[code->ntokens];
+		t->type = token;
+		t->lineno = instance->lineno;
+		t->s = NULL;
+		if (token == EOF)
+			break;
+		code->ntokens++;
+		if (!code_has_text(token))
+			continue;
+		len = strlen(instance->token_buffer) + 1;
+		if (pool_size + len > pool_max) {
+			pool_max = pool_max ? pool_max * 2 : 4096;
+			if (pool_max < pool_size + len)
+				pool_max = pool_size + len;
+			n = realloc(code->pool, pool_max);
+			if (n == NULL)
+				goto __nomem;
+			code->pool = n;
+		}
+		memcpy(code->pool + pool_size, instance->token_buffer, len);
+		/* store the offset, the pool may move */
+		t->s = (const char *)pool_size;
+		pool_size += len;
+	}
+	pool = code->pool;
+	for (idx = 0; idx < code->ntokens; idx++) {
+		t = &code->tokens[idx];
+		if (code_has_text(t->type))
+			t->s = pool + (size_t)t->s;
+	}
+	err = 0;
+      __end:
+	snd_input_close(instance->in);
+	instance->in = old_in;
+	instance->lineno = old_lineno;
+	instance->charno = old_charno;
+	return err;
+      __nomem:
+	nomem();
+	err = -ENOMEM;
+	goto __end;
+}
+
+/*
+ * Return the compiled code of the file (with a reference).
+ */
+static int code_get(struct alisp_instance *instance, const char *name,
+		    struct alisp_code **res)
+{
+	struct list_head *pos;
+	struct alisp_code *code;
+	struct stat st;
+	int err;
+
+	if (stat(name, &st) < 0)
+		return -errno;
+	code_cache_lock();
+	list_for_each(pos, &code_cache) {
+		code = list_entry(pos, struct alisp_code, list);
+		if (strcmp(code->filename, name))
+			continue;
+		if (code->dev == st.st_dev && code->ino == st.st_ino &&
+		    code->size == st.st_size &&
+		    code->mtime == st.st_mtim.tv_sec &&
+		    code->mtime_nsec == st.st_mtim.tv_nsec) {
+			code->refs++;
+			code_cache_unlock();
+			*res = code;
+			return 0;
+		}
+		/* stale */
+		list_del(&code->list);
+		if (--code->refs == 0)
+			code_free(code);
+		break;
+	}
+	code_cache_unlock();
+
+	code = calloc(1, sizeof(*code));
+	if (code == NULL) {
+		nomem();
+		return -ENOMEM;
+	}
+	code->filename = strdup(name);
+	if (code->filename == NULL) {
+		free(code);
+		nomem();
+		return -ENOMEM;
+	}
+	code->dev = st.st_dev;
+	code->ino = st.st_ino;
+	code->size = st.st_size;
+	code->mtime = st.st_mtim.tv_sec;
+	code->mtime_nsec = st.st_mtim.tv_nsec;
+	err = code_compile(instance, name, code);
+	if (err < 0) {
+		code_free(code);
+		return err;
+	}
+	lisp_verbose(instance, "** compiled '%s' (%u tokens)", name, code->ntokens);
+	/* one reference for the cache, one for the caller */
+	code->refs = 2;
+	code_cache_lock();
+	list_add(&code->list, &code_cache);
+	code_cache_unlock();
+	*res = code;
+	return 0;
+}
+
+/**
+ * \brief Free the compiled code of all files evaluated so far.
+ */
+void alsa_lisp_code_cache_free(void)
+{
+	struct list_head *pos, *npos;
+	struct alisp_code *code;
+
+	code_cache_lock();
+	list_for_each_safe(pos, npos, &code_cache) {
+		code = list_entry(pos, struct alisp_code, list);
+		list_del(&code->list);
+		if (--code->refs == 0)
+			code_free(code);
+	}
+	code_cache_unlock();
+}
+
+static int alisp_eval_code(struct alisp_instance *instance, int toplevel)
+{
+	struct alisp_object *p, *p1;
 
 	for (;;) {
 		if ((p = parse_object(instance, 0)) == NULL)
@@ -3173,39 +3451,72 @@ static int alisp_include_file(struct alisp_instance *instance, const char *filen
 			snd_output_putc(instance->vout, '\n');
 		}
 		p1 = eval(instance, p);
-		if (p1 == NULL) {
-			retval = -ENOMEM;
-			break;
-		}
+		if (p1 == NULL)
+			return -ENOMEM;
 		if (instance->verbose) {
 			lisp_verbose(instance, "** result");
 			princ_object(instance->vout, p1);
 			snd_output_putc(instance->vout, '\n');
 		}
 		delete_tree(instance, p1);
+		if (toplevel)
+			gc_safe_point(instance);
 		if (instance->debug) {
 			lisp_debug(instance, "** objects after operation");
 			print_obj_lists(instance, instance->dout);
 		}
-	}	
+	}
+	return 0;
+}
 
-	snd_input_close(instance->in);
-       _err:
+/*
+ * Evaluate the compiled file in the instance.
+ */
+static int alisp_eval_file(struct alisp_instance *instance, const char *name,
+			   int toplevel)
+{
+	struct alisp_code *old_code = instance->code, *code = NULL;
+	unsigned int old_pos = instance->code_pos;
+	int old_lineno = instance->lineno;
+	int err;
+
+	err = code_get(instance, name, &code);
+	if (err < 0)
+		return err;
+	instance->code = code;
+	instance->code_pos = 0;
+	err = alisp_eval_code(instance, toplevel);
+	instance->code = old_code;
+	instance->code_pos = old_pos;
+	instance->lineno = old_lineno;
+	code_put(code);
+	return err;
+}
+
+static int alisp_include_file(struct alisp_instance *instance, const char *filename)
+{
+	char *name;
+	int err;
+
+	err = snd_user_file(filename, &name);
+	if (err < 0)
+		return err;
+	if (instance->verbose)
+		lisp_verbose(instance, "** include filename '%s'", name);
+	err = alisp_eval_file(instance, name, 0);
 	free(name);
-	instance->in = old_in;
-	return retval;
+	return err;
 }
  
-int alsa_lisp(struct alisp_cfg *cfg, struct alisp_instance **_instance)
+static struct alisp_instance *alisp_new_instance(struct alisp_cfg *cfg)
 {
 	struct alisp_instance *instance;
-	struct alisp_object *p, *p1;
-	int i, j, retval = 0;
-	
+	int i, j;
+
 	instance = (struct alisp_instance *)calloc(1, sizeof(struct alisp_instance));
 	if (instance == NULL) {
 		nomem();
-		return -ENOMEM;
+		return NULL;
 	}
 	instance->verbose = cfg->verbose && cfg->vout;
 	instance->warning = cfg->warning && cfg->wout;
@@ -3217,6 +3528,7 @@ int alsa_lisp(struct alisp_cfg *cfg, struct alisp_instance **_instance)
 	instance->wout = cfg->wout;
 	instance->dout = cfg->dout;
 	INIT_LIST_HEAD(&instance->free_objs_list);
+	instance->gc_threshold = ALISP_GC_MIN_OBJS;
 	for (i = 0; i < ALISP_OBJ_PAIR_HASH_SIZE; i++) {
 		for (j = 0; j <= ALISP_OBJ_LAST_SEARCH; j++)
 			INIT_LIST_HEAD(&instance->used_objs_list[i][j]);
@@ -3224,31 +3536,18 @@ int alsa_lisp(struct alisp_cfg *cfg, struct alisp_instance **_instance)
 	}
 	
 	init_lex(instance);
+	return instance;
+}
 
-	for (;;) {
-		if ((p = parse_object(instance, 0)) == NULL)
-			break;
-		if (instance->verbose) {
-			lisp_verbose(instance, "** code");
-			princ_object(instance->vout, p);
-			snd_output_putc(instance->vout, '\n');
-		}
-		p1 = eval(instance, p);
-		if (p1 == NULL) {
-			retval = -ENOMEM;
-			break;
-		}
-		if (instance->verbose) {
-			lisp_verbose(instance, "** result");
-			princ_object(instance->vout, p1);
-			snd_output_putc(instance->vout, '\n');
-		}
-		delete_tree(instance, p1);
-		if (instance->debug) {
-			lisp_debug(instance, "** objects after operation");
-			print_obj_lists(instance, instance->dout);
-		}
-	}
+int alsa_lisp(struct alisp_cfg *cfg, struct alisp_instance **_instance)
+{
+	struct alisp_instance *instance;
+	int retval;
+
+	instance = alisp_new_instance(cfg);
+	if (instance == NULL)
+		return -ENOMEM;
+	retval = alisp_eval_code(instance, 1);
 
 	if (_instance)
 		*_instance = instance;
@@ -3258,12 +3557,62 @@ int alsa_lisp(struct alisp_cfg *cfg, struct alisp_instance **_instance)
 	return retval;
 }
 
+/**
+ * \brief Evaluate a lisp file
+ * \param cfg Configuration (the input stream is not used)
+ * \param filename File name
+ * \param _instance Returned instance or NULL
+ * \return zero on success, otherwise a negative error code
+ *
+ * Like alsa_lisp(), but the file is lexed only once per process: the
+ * following calls (and the include function) replay the cached tokens
+ * until the file is modified.
+ */
+int alsa_lisp_file(struct alisp_cfg *cfg, const char *filename,
+		   struct alisp_instance **_instance)
+{
+	struct alisp_instance *instance;
+	int retval;
+
+	instance = alisp_new_instance(cfg);
+	if (instance == NULL)
+		return -ENOMEM;
+	retval = alisp_eval_file(instance, filename, 1);
+
+	if (_instance)
+		*_instance = instance;
+	else
+		alsa_lisp_free(instance);
+
+	return retval;
+}
+
+/**
+ * \brief Get the object allocator statistics
+ * \param instance Lisp instance
+ * \param stats Returned statistics
+ * \return zero on success, otherwise a negative error code
+ */
+int alsa_lisp_get_stats(struct alisp_instance *instance, struct alisp_stats *stats)
+{
+	if (instance == NULL || stats == NULL)
+		return -EINVAL;
+	stats->used_objs = instance->used_objs;
+	stats->free_objs = instance->free_objs;
+	stats->max_objs = instance->max_objs;
+	stats->slabs = instance->slabs;
+	stats->gc_runs = instance->gc_runs;
+	stats->gc_freed = instance->gc_freed;
+	return 0;
+}
+
 void alsa_lisp_free(struct alisp_instance *instance)
 {
 	if (instance == NULL)
 		return;
 	done_lex(instance);
 	free_objects(instance);
+	snd_elems_free(instance);
 	free(instance);
 }
 
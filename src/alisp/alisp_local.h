@@ -47,7 +47,8 @@ struct alisp_object;
 
 #define ALISP_TYPE_MASK	0xf0000000
 #define ALISP_TYPE_SHIFT 28
-#define ALISP_REFS_MASK 0x0fffffff
+#define ALISP_MARK_MASK 0x08000000	/* reached by the collector */
+#define ALISP_REFS_MASK 0x07ffffff
 #define ALISP_REFS_SHIFT 0
 #define ALISP_MAX_REFS (ALISP_REFS_MASK>>ALISP_REFS_SHIFT)
 #define ALISP_MAX_REFS_LIMIT ((ALISP_MAX_REFS + 1) / 2)
@@ -119,7 +120,34 @@ struct alisp_object_pair {
 #define ALISP_OBJ_PAIR_HASH_SHIFT 4
 #define ALISP_OBJ_PAIR_HASH_SIZE (1<<ALISP_OBJ_PAIR_HASH_SHIFT)
 #define ALISP_OBJ_PAIR_HASH_MASK (ALISP_OBJ_PAIR_HASH_SIZE-1)
-#define ALISP_FREE_OBJ_POOL	512	/* free objects above this pool */
+#define ALISP_SLAB_OBJS		256	/* objects allocated at once */
+#define ALISP_GC_MIN_OBJS	4096	/* don't collect below this count */
+
+struct alisp_slab {
+	struct alisp_slab *next;
+	struct alisp_object objs[ALISP_SLAB_OBJS];
+};
+
+/* a file pre-lexed by the code cache, the tokens are replayed by the parser */
+struct alisp_token {
+	int type;
+	int lineno;
+	const char *s;		/* token text (identifiers, numbers, strings) */
+};
+
+struct alisp_code {
+	struct list_head list;
+	char *filename;
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	time_t mtime;
+	long mtime_nsec;
+	unsigned int refs;
+	unsigned int ntokens;
+	struct alisp_token *tokens;
+	char *pool;
+};
 
 struct alisp_instance {
 	int verbose: 1,
@@ -140,12 +168,24 @@ struct alisp_instance {
 	char *token_buffer;
 	int token_buffer_max;
 	int thistoken;
+	const char *token;	/* text of thistoken */
+	struct alisp_code *code;	/* replayed code or NULL */
+	unsigned int code_pos;
 	/* object allocator / storage */
 	long free_objs;
 	long used_objs;
 	long max_objs;
+	long slabs;
+	struct alisp_slab *slab_list;
 	struct list_head free_objs_list;
 	struct list_head used_objs_list[ALISP_OBJ_PAIR_HASH_SIZE][ALISP_OBJ_LAST_SEARCH + 1];
 	/* set object */
 	struct list_head setobjs_list[ALISP_OBJ_PAIR_HASH_SIZE];
+	/* collector, runs only between the top-level forms */
+	long gc_threshold;
+	long gc_runs;
+	long gc_freed;
+	int gc_request;
+	/* element types of the hctl bindings (alisp_snd.c) */
+	struct alisp_snd_elem **snd_elems;
 };
@@ -521,6 +521,204 @@ static int parse_ctl_elem_id(struct alisp_instance * instance,
 	return 0;
 }
 
+/*
+ * The type and value count of the elements passed to the read and write
+ * calls, so a script polling many controls does not query the element
+ * info for each access.  An entry is checked against the numid of the
+ * element and dropped with its hctl handle.
+ */
+#define SND_ELEM_HASH	64
+
+struct alisp_snd_elem {
+	struct alisp_snd_elem *next;
+	snd_hctl_elem_t *elem;
+	snd_hctl_t *hctl;
+	unsigned int numid;
+	snd_ctl_elem_type_t type;
+	unsigned int count;
+};
+
+static unsigned int snd_elem_hash(const void *elem)
+{
+	return ((unsigned long)elem >> 4) % SND_ELEM_HASH;
+}
+
+static int snd_elem_get(struct alisp_instance *instance, snd_hctl_elem_t *handle,
+			snd_ctl_elem_type_t *type, unsigned int *count)
+{
+	struct alisp_snd_elem *e, **pe;
+	snd_ctl_elem_info_t info = {0};
+	int err;
+
+	if (instance->snd_elems) {
+		pe = &instance->snd_elems[snd_elem_hash(handle)];
+		for (; (e = *pe) != NULL; pe = &e->next) {
+			if (e->elem != handle)
+				continue;
+			if (e->hctl == snd_hctl_elem_get_hctl(handle) &&
+			    e->numid == snd_hctl_elem_get_numid(handle)) {
+				*type = e->type;
+				*count = e->count;
+				return 0;
+			}
+			*pe = e->next;	/* another element at this address */
+			free(e);
+			break;
+		}
+	}
+	err = snd_hctl_elem_info(handle, &info);
+	if (err < 0)
+		return err;
+	*type = snd_ctl_elem_info_get_type(&info);
+	*count = snd_ctl_elem_info_get_count(&info);
+	if (*type == SND_CTL_ELEM_TYPE_IEC958) {
+		*count = sizeof(snd_aes_iec958_t);
+		*type = SND_CTL_ELEM_TYPE_BYTES;
+	}
+	if (instance->snd_elems == NULL) {
+		instance->snd_elems = calloc(SND_ELEM_HASH, sizeof(*instance->snd_elems));
+		if (instance->snd_elems == NULL)
+			return 0;
+	}
+	e = malloc(sizeof(*e));
+	if (e == NULL)
+		return 0;
+	e->elem = handle;
+	e->hctl = snd_hctl_elem_get_hctl(handle);
+	e->numid = snd_hctl_elem_get_numid(handle);
+	e->type = *type;
+	e->count = *count;
+	pe = &instance->snd_elems[snd_elem_hash(handle)];
+	e->next = *pe;
+	*pe = e;
+	return 0;
+}
+
+/* drop the entries of one hctl handle, or all for NULL */
+static void snd_elems_drop(struct alisp_instance *instance, snd_hctl_t *hctl)
+{
+	struct alisp_snd_elem *e, **pe;
+	unsigned int i;
+
+	if (instance->snd_elems == NULL)
+		return;
+	for (i = 0; i < SND_ELEM_HASH; i++) {
+		pe = &instance->snd_elems[i];
+		while ((e = *pe) != NULL) {
+			if (hctl == NULL || e->hctl == hctl) {
+				*pe = e->next;
+				free(e);
+			} else {
+				pe = &e->next;
+			}
+		}
+	}
+}
+
+static void snd_elems_free(struct alisp_instance *instance)
+{
+	snd_elems_drop(instance, NULL);
+	free(instance->snd_elems);
+	instance->snd_elems = NULL;
+}
+
+/* append the values to the car of cons, NULL when there are none */
+static struct alisp_object * add_elem_value(struct alisp_instance * instance,
+					    struct alisp_object * cons,
+					    snd_ctl_elem_value_t * value,
+					    snd_ctl_elem_type_t type,
+					    unsigned int count)
+{
+	struct alisp_object * p1 = NULL, * obj;
+	unsigned int idx;
+
+	for (idx = 0; idx < count; idx++) {
+		switch (type) {
+		case SND_CTL_ELEM_TYPE_BOOLEAN:
+			obj = new_integer(instance, snd_ctl_elem_value_get_boolean(value, idx));
+			break;
+		case SND_CTL_ELEM_TYPE_INTEGER:
+			obj = new_integer(instance, snd_ctl_elem_value_get_integer(value, idx));
+			break;
+		case SND_CTL_ELEM_TYPE_INTEGER64:
+			obj = new_integer(instance, snd_ctl_elem_value_get_integer64(value, idx));
+			break;
+		case SND_CTL_ELEM_TYPE_ENUMERATED:
+			obj = new_integer(instance, snd_ctl_elem_value_get_enumerated(value, idx));
+			break;
+		case SND_CTL_ELEM_TYPE_BYTES:
+			obj = new_integer(instance, snd_ctl_elem_value_get_byte(value, idx));
+			break;
+		default:
+			obj = NULL;
+			break;
+		}
+		if (idx == 0) {
+			p1 = add_cons2(instance, cons, 0, obj);
+		} else {
+			p1 = add_cons2(instance, p1, 1, obj);
+		}
+	}
+	return p1 ? cons : NULL;
+}
+
+/* set the values from the list p1, which is consumed */
+static void set_elem_value(struct alisp_instance * instance,
+			   struct alisp_object * p1,
+			   snd_ctl_elem_value_t * value,
+			   snd_ctl_elem_type_t type,
+			   unsigned int count)
+{
+	struct alisp_object * obj;
+	unsigned int idx;
+
+	idx = -1;
+	do {
+		if (++idx >= count) {
+			delete_tree(instance, p1);
+			break;
+		}
+		obj = car(p1);
+		switch (type) {
+		case SND_CTL_ELEM_TYPE_BOOLEAN:
+			snd_ctl_elem_value_set_boolean(value, idx, get_integer(obj));
+			break;
+		case SND_CTL_ELEM_TYPE_INTEGER:
+			snd_ctl_elem_value_set_integer(value, idx, get_integer(obj));
+			break;
+		case SND_CTL_ELEM_TYPE_INTEGER64:
+			snd_ctl_elem_value_set_integer64(value, idx, get_integer(obj));
+			break;
+		case SND_CTL_ELEM_TYPE_ENUMERATED:
+			snd_ctl_elem_value_set_enumerated(value, idx, get_integer(obj));
+			break;
+		case SND_CTL_ELEM_TYPE_BYTES:
+			snd_ctl_elem_value_set_byte(value, idx, get_integer(obj));
+			break;
+		default:
+			break;
+		}
+		delete_tree(instance, obj);
+		p1 = cdr(obj = p1);
+		delete_object(instance, obj);
+	} while (p1 != &alsa_lisp_nil);
+}
+
+static struct alisp_object * FA_hctl_close(struct alisp_instance * instance, struct acall_table * item, struct alisp_object * args)
+{
+	void *handle;
+	struct alisp_object * p1;
+
+	p1 = eval(instance, car(args));
+	delete_tree(instance, cdr(args));
+	delete_object(instance, args);
+	handle = (void *)get_ptr(instance, p1, item->prefix);
+	if (handle == NULL)
+		return &alsa_lisp_nil;
+	snd_elems_drop(instance, handle);
+	return new_integer(instance, ((snd_int_p_t)item->xfunc)(handle));
+}
+
 static struct alisp_object * FA_hctl_find_elem(struct alisp_instance * instance, struct acall_table * item, struct alisp_object * args)
 {
 	snd_hctl_t *handle;
@@ -623,11 +821,10 @@ static struct alisp_object * FA_hctl_elem_info(struct alisp_instance * instance,
 static struct alisp_object * FA_hctl_elem_read(struct alisp_instance * instance, struct acall_table * item, struct alisp_object * args)
 {
 	snd_hctl_elem_t *handle;
-	struct alisp_object * lexpr, * p1 = NULL, * obj;
-	snd_ctl_elem_info_t info = {0};
+	struct alisp_object * lexpr, * p1 = NULL;
 	snd_ctl_elem_value_t value = {0};
 	snd_ctl_elem_type_t type;
-	unsigned int idx, count;
+	unsigned int count;
 	int err;
 
 	p1 = eval(instance, car(args));
@@ -636,46 +833,13 @@ static struct alisp_object * FA_hctl_elem_read(struct alisp_instance * instance,
 	handle = (snd_hctl_elem_t *)get_ptr(instance, p1, item->prefix);
 	if (handle == NULL)
 		return &alsa_lisp_nil;
-	err = snd_hctl_elem_info(handle, &info);
+	err = snd_elem_get(instance, handle, &type, &count);
 	if (err >= 0)
 		err = snd_hctl_elem_read(handle, &value);
 	lexpr = new_lexpr(instance, err);
 	if (err < 0)
 		return lexpr;
-	type = snd_ctl_elem_info_get_type(&info);
-	count = snd_ctl_elem_info_get_count(&info);
-	if (type == SND_CTL_ELEM_TYPE_IEC958) {
-		count = sizeof(snd_aes_iec958_t);
-		type = SND_CTL_ELEM_TYPE_BYTES;
-	}
-	for (idx = 0; idx < count; idx++) {
-		switch (type) {
-		case SND_CTL_ELEM_TYPE_BOOLEAN:
-			obj = new_integer(instance, snd_ctl_elem_value_get_boolean(&value, idx));
-			break;
-		case SND_CTL_ELEM_TYPE_INTEGER:
-			obj = new_integer(instance, snd_ctl_elem_value_get_integer(&value, idx));
-			break;
-		case SND_CTL_ELEM_TYPE_INTEGER64:
-			obj = new_integer(instance, snd_ctl_elem_value_get_integer64(&value, idx));
-			break;
-		case SND_CTL_ELEM_TYPE_ENUMERATED:
-			obj = new_integer(instance, snd_ctl_elem_value_get_enumerated(&value, idx));
-			break;
-		case SND_CTL_ELEM_TYPE_BYTES:
-			obj = new_integer(instance, snd_ctl_elem_value_get_byte(&value, idx));
-			break;
-		default:
-			obj = NULL;
-			break;
-		}
-		if (idx == 0) {
-			p1 = add_cons2(instance, lexpr->value.c.cdr, 0, obj);
-		} else {
-			p1 = add_cons2(instance, p1, 1, obj);
-		}
-	}
-	if (p1 == NULL) {
+	if (add_elem_value(instance, lexpr->value.c.cdr, &value, type, count) == NULL) {
 		delete_tree(instance, lexpr);
 		return &alsa_lisp_nil;
 	}
@@ -686,10 +850,9 @@ static struct alisp_object * FA_hctl_elem_write(struct alisp_instance * instance
 {
 	snd_hctl_elem_t *handle;
 	struct alisp_object * p1 = NULL, * obj;
-	snd_ctl_elem_info_t info = {0};
 	snd_ctl_elem_value_t value = {0};
 	snd_ctl_elem_type_t type;
-	unsigned int idx, count;
+	unsigned int count;
 	int err;
 
 	p1 = car(cdr(args));
@@ -702,48 +865,197 @@ static struct alisp_object * FA_hctl_elem_write(struct alisp_instance * instance
 		delete_tree(instance, p1);
 		return &alsa_lisp_nil;
 	}
-	err = snd_hctl_elem_info(handle, &info);
+	err = snd_elem_get(instance, handle, &type, &count);
 	if (err < 0) {
 		delete_tree(instance, p1);
 		return new_integer(instance, err);
 	}
-	type = snd_ctl_elem_info_get_type(&info);
-	count = snd_ctl_elem_info_get_count(&info);
-	if (type == SND_CTL_ELEM_TYPE_IEC958) {
-		count = sizeof(snd_aes_iec958_t);
-		type = SND_CTL_ELEM_TYPE_BYTES;
+	set_elem_value(instance, p1, &value, type, count);
+	err = snd_hctl_elem_write(handle, &value);
+	return new_integer(instance, err);
+}
+
+/*
+ * The elements of the list in p1 (consumed), NULL for the others.
+ * Returns the count or a negative error code.
+ */
+static int get_elem_list(struct alisp_instance * instance,
+			 struct alisp_object * p1, const char *prefix,
+			 snd_hctl_elem_t ***elems)
+{
+	struct alisp_object * p2;
+	unsigned int idx, count = 0;
+
+	for (p2 = p1; alisp_compare_type(p2, ALISP_OBJ_CONS); p2 = cdr(p2))
+		count++;
+	*elems = calloc(count + 1, sizeof(**elems));
+	if (*elems == NULL) {
+		delete_tree(instance, p1);
+		return -ENOMEM;
 	}
-	idx = -1;
-	do {
-		if (++idx >= count) {
-			delete_tree(instance, p1);
-			break;
+	for (idx = 0; idx < count; idx++) {
+		(*elems)[idx] = (snd_hctl_elem_t *)get_ptr(instance, car(p1), prefix);
+		p1 = cdr(p2 = p1);
+		delete_object(instance, p2);
+	}
+	delete_tree(instance, p1);
+	return count;
+}
+
+/*
+ * Move the values of the elements [idx, end) of one hctl with the bulk
+ * calls.  The failed elements get their errors in errs.
+ */
+static void transfer_multi(snd_hctl_elem_t **elems, snd_ctl_elem_value_t **vals,
+			   int *errs, unsigned int idx, unsigned int end, int write)
+{
+	int err;
+
+	while (idx < end) {
+		if (write)
+			err = snd_hctl_elem_write_multi(elems + idx, vals + idx, end - idx);
+		else
+			err = snd_hctl_elem_read_multi(elems + idx, vals + idx, end - idx);
+		if (err < 0) {
+			errs[idx++] = err;
+			continue;
 		}
-		obj = car(p1);
-		switch (type) {
-		case SND_CTL_ELEM_TYPE_BOOLEAN:
-			snd_ctl_elem_value_set_boolean(&value, idx, get_integer(obj));
-			break;
-		case SND_CTL_ELEM_TYPE_INTEGER:
-			snd_ctl_elem_value_set_integer(&value, idx, get_integer(obj));
-			break;
-		case SND_CTL_ELEM_TYPE_INTEGER64:
-			snd_ctl_elem_value_set_integer64(&value, idx, get_integer(obj));
-			break;
-		case SND_CTL_ELEM_TYPE_ENUMERATED:
-			snd_ctl_elem_value_set_enumerated(&value, idx, get_integer(obj));
-			break;
-		case SND_CTL_ELEM_TYPE_BYTES:
-			snd_ctl_elem_value_set_byte(&value, idx, get_integer(obj));
-			break;
-		default:
+		idx += err;
+		if (idx >= end)
 			break;
+		/* the error code of the element which stopped the batch */
+		if (write)
+			err = snd_hctl_elem_write(elems[idx], vals[idx]);
+		else
+			err = snd_hctl_elem_read(elems[idx], vals[idx]);
+		if (err < 0)
+			errs[idx] = err;
+		idx++;
+	}
+}
+
+/*
+ * Read or write the values of a list of elements, with one bulk call for
+ * each run of elements of the same hctl handle.
+ */
+static int transfer_elems(struct alisp_instance * instance,
+			  snd_hctl_elem_t **elems, unsigned int count,
+			  snd_ctl_elem_value_t **vals, int *errs,
+			  struct alisp_object * values)
+{
+	snd_ctl_elem_type_t type;
+	unsigned int idx, first, vcount;
+	struct alisp_object * p1;
+	int err, write = values != NULL;
+
+	for (idx = 0; idx < count; idx++) {
+		vals[idx] = (snd_ctl_elem_value_t *)(vals + count) + idx;
+		errs[idx] = 0;
+		if (elems[idx] == NULL) {
+			errs[idx] = -EINVAL;
+		} else {
+			err = snd_elem_get(instance, elems[idx], &type, &vcount);
+			if (err < 0)
+				errs[idx] = err;
 		}
-		delete_tree(instance, obj);
-		p1 = cdr(obj = p1);
-		delete_object(instance, obj);
-	} while (p1 != &alsa_lisp_nil);
-	err = snd_hctl_elem_write(handle, &value);
+		if (!write)
+			continue;
+		p1 = car(values);
+		if (errs[idx] == 0)
+			set_elem_value(instance, p1, vals[idx], type, vcount);
+		else
+			delete_tree(instance, p1);
+		values = cdr(p1 = values);
+		delete_object(instance, p1);
+	}
+	delete_tree(instance, values);
+	for (idx = 0; idx < count; idx = first) {
+		first = idx + 1;
+		if (errs[idx] < 0)
+			continue;
+		while (first < count && errs[first] == 0 &&
+		       snd_hctl_elem_get_hctl(elems[first]) ==
+		       snd_hctl_elem_get_hctl(elems[idx]))
+			first++;
+		transfer_multi(elems, vals, errs, idx, first, write);
+	}
+	for (idx = 0; idx < count; idx++) {
+		if (errs[idx] < 0)
+			return errs[idx];
+	}
+	return 0;
+}
+
+static struct alisp_object * FA_hctl_elems_read(struct alisp_instance * instance, struct acall_table * item, struct alisp_object * args)
+{
+	snd_hctl_elem_t **elems;
+	snd_ctl_elem_value_t **vals;
+	snd_ctl_elem_type_t type;
+	struct alisp_object * lexpr, * p1;
+	unsigned int idx, vcount;
+	int err, count, *errs;
+
+	p1 = eval(instance, car(args));
+	delete_tree(instance, cdr(args));
+	delete_object(instance, args);
+	count = get_elem_list(instance, p1, item->prefix, &elems);
+	if (count <= 0) {
+		free(elems);
+		return new_lexpr(instance, count);
+	}
+	vals = calloc(count, sizeof(*vals) + sizeof(**vals) + sizeof(*errs));
+	if (vals == NULL) {
+		free(elems);
+		return new_lexpr(instance, -ENOMEM);
+	}
+	errs = (int *)((snd_ctl_elem_value_t *)(vals + count) + count);
+	err = transfer_elems(instance, elems, count, vals, errs, NULL);
+	lexpr = new_lexpr(instance, err);
+	p1 = lexpr ? lexpr->value.c.cdr : NULL;
+	for (idx = 0; p1 && idx < (unsigned int)count; idx++) {
+		/* one list of values per element, nil for the failed ones */
+		p1 = add_cons2(instance, p1, idx > 0, &alsa_lisp_nil);
+		if (p1 && errs[idx] == 0 &&
+		    snd_elem_get(instance, elems[idx], &type, &vcount) >= 0)
+			add_elem_value(instance, p1, vals[idx], type, vcount);
+	}
+	if (lexpr && p1 == NULL) {
+		delete_tree(instance, lexpr);
+		lexpr = NULL;
+	}
+	free(vals);
+	free(elems);
+	return lexpr;
+}
+
+static struct alisp_object * FA_hctl_elems_write(struct alisp_instance * instance, struct acall_table * item, struct alisp_object * args)
+{
+	snd_hctl_elem_t **elems;
+	snd_ctl_elem_value_t **vals;
+	struct alisp_object * p1, * p2;
+	int err, count, *errs;
+
+	p1 = eval(instance, car(args));
+	p2 = eval(instance, car(cdr(args)));
+	delete_tree(instance, cdr(cdr(args)));
+	delete_object(instance, cdr(args));
+	delete_object(instance, args);
+	count = get_elem_list(instance, p1, item->prefix, &elems);
+	if (count <= 0) {
+		free(elems);
+		delete_tree(instance, p2);
+		return new_integer(instance, count);
+	}
+	vals = calloc(count, sizeof(*vals) + sizeof(**vals) + sizeof(*errs));
+	if (vals == NULL) {
+		free(elems);
+		delete_tree(instance, p2);
+		return new_integer(instance, -ENOMEM);
+	}
+	errs = (int *)((snd_ctl_elem_value_t *)(vals + count) + count);
+	err = transfer_elems(instance, elems, count, vals, errs, p2);
+	free(vals);
+	free(elems);
 	return new_integer(instance, err);
 }
 
@@ -790,16 +1102,18 @@ static const struct acall_table acall_table[] = {
 	{ "ctl_card_info", &FA_card_info, NULL, "ctl" },
 	{ "ctl_close", &FA_int_p, (void *)&snd_ctl_close, "ctl" },
 	{ "ctl_open", &FA_int_pp_strp_int, (void *)&snd_ctl_open, "ctl" },
-	{ "hctl_close", &FA_int_p, (void *)&snd_hctl_close, "hctl" },
+	{ "hctl_close", &FA_hctl_close, (void *)&snd_hctl_close, "hctl" },
 	{ "hctl_ctl", &FA_p_p, (void *)&snd_hctl_ctl, "hctl" },
 	{ "hctl_elem_info", &FA_hctl_elem_info, (void *)&snd_hctl_elem_info, "hctl_elem" },
 	{ "hctl_elem_next", &FA_p_p, (void *)&snd_hctl_elem_next, "hctl_elem" },
 	{ "hctl_elem_prev", &FA_p_p, (void *)&snd_hctl_elem_prev, "hctl_elem" },
 	{ "hctl_elem_read", &FA_hctl_elem_read, (void *)&snd_hctl_elem_read, "hctl_elem" },
 	{ "hctl_elem_write", &FA_hctl_elem_write, (void *)&snd_hctl_elem_write, "hctl_elem" },
+	{ "hctl_elems_read", &FA_hctl_elems_read, NULL, "hctl_elem" },
+	{ "hctl_elems_write", &FA_hctl_elems_write, NULL, "hctl_elem" },
 	{ "hctl_find_elem", &FA_hctl_find_elem, (void *)&snd_hctl_find_elem, "hctl" },
 	{ "hctl_first_elem", &FA_p_p, (void *)&snd_hctl_first_elem, "hctl" },
-	{ "hctl_free", &FA_int_p, (void *)&snd_hctl_free, "hctl" },
+	{ "hctl_free", &FA_hctl_close, (void *)&snd_hctl_free, "hctl" },
 	{ "hctl_last_elem", &FA_p_p, (void *)&snd_hctl_last_elem, "hctl" },
 	{ "hctl_load", &FA_int_p, (void *)&snd_hctl_load, "hctl" },
 	{ "hctl_open", &FA_int_pp_strp_int, (void *)&snd_hctl_open, "hctl" },
@@ -24,9 +24,30 @@
  *
  */
 
+/*
+ * Besides the SIGIO handler, the notifications can be delivered without
+ * signals: the descriptors of the handlers are watched by an edge
+ * triggered epoll set, which is either waited by a library thread
+ * (SND_ASYNC_THREAD) or exported to the event loop of the application
+ * (SND_ASYNC_DESCRIPTOR, see snd_async_descriptor() and
+ * snd_async_dispatch()).  The wakeups of the drivers raise an edge
+ * exactly where kill_fasync() raises the signal, so the callbacks are
+ * called at the same points.  The default mode can be chosen with
+ * LIBASOUND_ASYNC=signal, thread or descriptor.
+ */
+
 #include "pcm/pcm_local.h"
 #include "control/control_local.h"
+#include "timer/timer_local.h"
 #include <signal.h>
+#include <sys/epoll.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+#if defined(HAVE_LIBPTHREAD) && defined(HAVE_SYS_EVENTFD_H)
+#include <sys/eventfd.h>
+#define ASYNC_THREAD
+#endif
 
 static struct sigaction previous_action;
 #define MAX_SIG_FUNCTION_CODE 10 /* i.e. SIG_DFL SIG_IGN SIG_HOLD et al */
@@ -52,6 +73,47 @@ static const int snd_async_signo = SIGIO;
 
 static LIST_HEAD(snd_async_handlers);
 
+static int async_delivery = -1;		/* not chosen yet */
+static int async_epfd = -1;		/* watched handler descriptors */
+static struct list_head *async_cursor;	/* next handler to dispatch */
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t async_mutex;
+static pthread_once_t async_mutex_once = PTHREAD_ONCE_INIT;
+
+/* recursive, the callbacks run with the lock held and may delete handlers */
+static void async_init_mutex(void)
+{
+	pthread_mutexattr_t attr;
+
+	pthread_mutexattr_init(&attr);
+#ifdef HAVE_PTHREAD_MUTEX_RECURSIVE
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+#endif
+	pthread_mutex_init(&async_mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+
+static inline void async_lock(void)
+{
+	pthread_once(&async_mutex_once, async_init_mutex);
+	pthread_mutex_lock(&async_mutex);
+}
+
+static inline void async_unlock(void)
+{
+	pthread_mutex_unlock(&async_mutex);
+}
+#else
+static inline void async_lock(void) {}
+static inline void async_unlock(void) {}
+#endif
+
+#ifdef ASYNC_THREAD
+static int async_wake_fd = -1;		/* stops the thread */
+static int async_thread_running;
+#endif
+
 static void snd_async_handler(int signo ATTRIBUTE_UNUSED, siginfo_t *siginfo, void *context ATTRIBUTE_UNUSED)
 {
 	int fd;
@@ -68,6 +130,264 @@ static void snd_async_handler(int signo ATTRIBUTE_UNUSED, siginfo_t *siginfo, vo
 	}
 }
 
+static int async_default_delivery(void)
+{
+	const char *env = getenv("LIBASOUND_ASYNC");
+
+	if (env == NULL)
+		return SND_ASYNC_SIGNAL;
+#ifdef ASYNC_THREAD
+	if (strcmp(env, "thread") == 0)
+		return SND_ASYNC_THREAD;
+#endif
+	if (strcmp(env, "descriptor") == 0)
+		return SND_ASYNC_DESCRIPTOR;
+	return SND_ASYNC_SIGNAL;
+}
+
+/* call with the lock held */
+static int async_get_delivery(void)
+{
+	if (async_delivery < 0)
+		async_delivery = async_default_delivery();
+	return async_delivery;
+}
+
+static int async_watch(int fd)
+{
+	struct epoll_event ev;
+
+	if (async_epfd < 0) {
+		async_epfd = epoll_create1(EPOLL_CLOEXEC);
+		if (async_epfd < 0)
+			return -errno;
+	}
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLOUT | EPOLLPRI | EPOLLET;
+	ev.data.fd = fd;
+	/* EEXIST: another handler of the same descriptor */
+	if (epoll_ctl(async_epfd, EPOLL_CTL_ADD, fd, &ev) < 0 && errno != EEXIST)
+		return -errno;
+	return 0;
+}
+
+static void async_unwatch(int fd)
+{
+	struct list_head *i;
+
+	list_for_each(i, &snd_async_handlers) {
+		snd_async_handler_t *h = list_entry(i, snd_async_handler_t, glist);
+		if (h->fd == fd)
+			return;
+	}
+	/* the descriptor may be closed already */
+	epoll_ctl(async_epfd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+/* call with the lock held */
+static void async_dispatch(struct epoll_event *ev, int count)
+{
+	int k;
+
+	for (k = 0; k < count; k++) {
+		int fd = ev[k].data.fd;
+#ifdef ASYNC_THREAD
+		if (fd == async_wake_fd) {
+			eventfd_t val;
+			eventfd_read(async_wake_fd, &val);
+			continue;
+		}
+#endif
+		/* the callback may delete any handler, see snd_async_del_handler */
+		async_cursor = snd_async_handlers.next;
+		while (async_cursor != &snd_async_handlers) {
+			snd_async_handler_t *h = list_entry(async_cursor, snd_async_handler_t, glist);
+			async_cursor = async_cursor->next;
+			if (h->fd == fd && h->callback)
+				h->callback(h);
+		}
+		async_cursor = NULL;
+	}
+}
+
+#ifdef ASYNC_THREAD
+static void *async_thread(void *arg ATTRIBUTE_UNUSED)
+{
+	struct epoll_event ev[16];
+	sigset_t mask;
+	int count;
+
+	/* the signals stay with the application threads */
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, NULL);
+	async_lock();
+	while (!list_empty(&snd_async_handlers)) {
+		async_unlock();
+		count = epoll_wait(async_epfd, ev, ARRAY_SIZE(ev), -1);
+		async_lock();
+		if (count > 0)
+			async_dispatch(ev, count);
+	}
+	async_thread_running = 0;
+	async_unlock();
+	return NULL;
+}
+
+static int async_thread_start(void)
+{
+	pthread_t thread;
+	int err;
+
+	if (async_thread_running)
+		return 0;
+	if (async_wake_fd < 0) {
+		struct epoll_event ev;
+		async_wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		if (async_wake_fd < 0)
+			return -errno;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.fd = async_wake_fd;
+		if (epoll_ctl(async_epfd, EPOLL_CTL_ADD, async_wake_fd, &ev) < 0) {
+			err = -errno;
+			close(async_wake_fd);
+			async_wake_fd = -1;
+			return err;
+		}
+	}
+	err = snd_thread_create(&thread, "async", async_thread, NULL);
+	if (err)
+		return -err;
+	pthread_detach(thread);
+	async_thread_running = 1;
+	return 0;
+}
+#endif
+
+/**
+ * \brief Selects how the async notifications are delivered.
+ * \param delivery One of #SND_ASYNC_SIGNAL, #SND_ASYNC_THREAD or
+ *                 #SND_ASYNC_DESCRIPTOR.
+ * \result Zero if successful, otherwise a negative error code.
+ *
+ * With #SND_ASYNC_SIGNAL, the default, the callbacks are called from the
+ * \c SIGIO handler.  With #SND_ASYNC_THREAD, a thread of the library
+ * waits for the descriptors of the handlers and calls the callbacks;
+ * with #SND_ASYNC_DESCRIPTOR the application waits for the descriptor
+ * returned by #snd_async_descriptor in its own event loop and calls
+ * #snd_async_dispatch.  In both of the latter modes no signal is
+ * requested from the drivers, and the handler functions keep their
+ * meaning; the callbacks are serialized with the handler registration.
+ *
+ * The mode can only be changed while no async handler is registered
+ * (-EBUSY otherwise).  When this function is not called, the
+ * \c LIBASOUND_ASYNC environment variable (\c signal, \c thread or
+ * \c descriptor) gives the mode.
+ *
+ * This function is added in version 1.2.8.
+ */
+int snd_async_set_delivery(int delivery)
+{
+	int err = 0;
+
+	switch (delivery) {
+	case SND_ASYNC_SIGNAL:
+	case SND_ASYNC_DESCRIPTOR:
+		break;
+	case SND_ASYNC_THREAD:
+#ifdef ASYNC_THREAD
+		break;
+#else
+		return -ENOSYS;
+#endif
+	default:
+		return -EINVAL;
+	}
+	async_lock();
+	if (!list_empty(&snd_async_handlers) && async_get_delivery() != delivery)
+		err = -EBUSY;
+	else
+		async_delivery = delivery;
+	async_unlock();
+	return err;
+}
+
+/**
+ * \brief Returns the delivery mode of the async notifications.
+ * \result #SND_ASYNC_SIGNAL, #SND_ASYNC_THREAD or #SND_ASYNC_DESCRIPTOR.
+ *
+ * This function is added in version 1.2.8.
+ */
+int snd_async_get_delivery(void)
+{
+	int delivery;
+
+	async_lock();
+	delivery = async_get_delivery();
+	async_unlock();
+	return delivery;
+}
+
+/**
+ * \brief Returns the descriptor for the event loop of the application.
+ * \result The descriptor if successful, otherwise a negative error code.
+ *
+ * Only in the #SND_ASYNC_DESCRIPTOR mode.  The descriptor becomes
+ * readable (\c POLLIN) when a notification is pending; then
+ * #snd_async_dispatch calls the callbacks.  It is owned by the library
+ * and stays valid for the whole life of the process.
+ *
+ * This function is added in version 1.2.8.
+ */
+int snd_async_descriptor(void)
+{
+	int fd;
+
+	async_lock();
+	if (async_get_delivery() != SND_ASYNC_DESCRIPTOR) {
+		fd = -EINVAL;
+	} else {
+		if (async_epfd < 0) {
+			async_epfd = epoll_create1(EPOLL_CLOEXEC);
+			if (async_epfd < 0) {
+				async_unlock();
+				return -errno;
+			}
+		}
+		fd = async_epfd;
+	}
+	async_unlock();
+	return fd;
+}
+
+/**
+ * \brief Calls the callbacks of the pending async notifications.
+ * \param timeout Maximum time to wait in milliseconds, -1 for infinite.
+ * \result The number of notified descriptors (zero on timeout),
+ *         otherwise a negative error code.
+ *
+ * Only in the #SND_ASYNC_DESCRIPTOR mode, usually with zero \p timeout
+ * after #snd_async_descriptor became readable.
+ *
+ * This function is added in version 1.2.8.
+ */
+int snd_async_dispatch(int timeout)
+{
+	struct epoll_event ev[16];
+	int fd, count;
+
+	fd = snd_async_descriptor();
+	if (fd < 0)
+		return fd;
+	count = epoll_wait(fd, ev, ARRAY_SIZE(ev), timeout);
+	if (count < 0)
+		return errno == EINTR ? 0 : -errno;
+	async_lock();
+	async_dispatch(ev, count);
+	async_unlock();
+	return count;
+}
+
 /**
  * \brief Registers an async handler.
  * \param handler The function puts the pointer to the new async handler
@@ -90,7 +410,9 @@ static void snd_async_handler(int signo ATTRIBUTE_UNUSED, siginfo_t *siginfo, vo
  * to generate the \c SIGIO signal.
  *
  * The \c SIGIO signal may have been replaced with another signal,
- * see #snd_async_handler_get_signo.
+ * see #snd_async_handler_get_signo.  The notifications can also be
+ * delivered without a signal, see #snd_async_set_delivery; then the
+ * callback is called when the wakeup of \p fd reports it ready.
  *
  * When the async handler isn't needed anymore, you must delete it with
  * #snd_async_del_handler.
@@ -101,20 +423,40 @@ int snd_async_add_handler(snd_async_handler_t **handler, int fd,
 			  snd_async_callback_t callback, void *private_data)
 {
 	snd_async_handler_t *h;
-	int was_empty;
+	int was_empty, err = 0;
 	assert(handler);
 	h = malloc(sizeof(*h));
 	if (!h)
 		return -ENOMEM;
+	h->type = SND_ASYNC_HANDLER_GENERIC;
 	h->fd = fd;
 	h->callback = callback;
 	h->private_data = private_data;
+	async_lock();
 	was_empty = list_empty(&snd_async_handlers);
 	list_add_tail(&h->glist, &snd_async_handlers);
 	INIT_LIST_HEAD(&h->hlist);
+	if (async_get_delivery() != SND_ASYNC_SIGNAL) {
+		err = async_watch(fd);
+#ifdef ASYNC_THREAD
+		if (err >= 0 && async_delivery == SND_ASYNC_THREAD)
+			err = async_thread_start();
+#endif
+		if (err < 0) {
+			list_del(&h->glist);
+			if (async_epfd >= 0)
+				async_unwatch(fd);
+			async_unlock();
+			free(h);
+			return err;
+		}
+		async_unlock();
+		*handler = h;
+		return 0;
+	}
+	async_unlock();
 	*handler = h;
 	if (was_empty) {
-		int err;
 		struct sigaction act;
 		memset(&act, 0, sizeof(act));
 		act.sa_flags = SA_RESTART | SA_SIGINFO;
@@ -138,10 +480,23 @@ int snd_async_add_handler(snd_async_handler_t **handler, int fd,
 int snd_async_del_handler(snd_async_handler_t *handler)
 {
 	int err = 0;
-	int was_empty = list_empty(&snd_async_handlers);
+	int was_empty, sig_mode;
 	assert(handler);
+	async_lock();
+	sig_mode = async_get_delivery() == SND_ASYNC_SIGNAL;
+	was_empty = list_empty(&snd_async_handlers);
+	if (async_cursor == &handler->glist)
+		async_cursor = handler->glist.next;
 	list_del(&handler->glist);
-	if (!was_empty
+	if (!sig_mode) {
+		async_unwatch(handler->fd);
+#ifdef ASYNC_THREAD
+		if (async_thread_running && list_empty(&snd_async_handlers))
+			eventfd_write(async_wake_fd, 1);
+#endif
+	}
+	async_unlock();
+	if (sig_mode && !was_empty
 	 && list_empty(&snd_async_handlers)) {
 		err = sigaction(snd_async_signo, &previous_action, NULL);
 		if (err < 0) {
@@ -154,7 +509,7 @@ int snd_async_del_handler(snd_async_handler_t *handler)
 		goto _end;
 	if (!list_empty(&handler->hlist))
 		list_del(&handler->hlist);
-	if (!list_empty(&handler->hlist))
+	if (!list_empty(&handler->hlist) || !sig_mode)
 		goto _end;
 	switch (handler->type) {
 #ifdef BUILD_PCM
@@ -165,6 +520,9 @@ int snd_async_del_handler(snd_async_handler_t *handler)
 	case SND_ASYNC_HANDLER_CTL:
 		err = snd_ctl_async(handler->u.ctl, -1, 1);
 		break;
+	case SND_ASYNC_HANDLER_TIMER:
+		err = snd_timer_async(handler->u.timer, -1, 1);
+		break;
 	default:
 		assert(0);
 	}
@@ -180,11 +538,14 @@ int snd_async_del_handler(snd_async_handler_t *handler)
  *
  * The signal number for async handlers usually is \c SIGIO,
  * but wizards can redefine it to a realtime signal
- * when compiling the ALSA library.
+ * when compiling the ALSA library.  Without a signal (see
+ * #snd_async_set_delivery), -EINVAL is returned.
  */
 int snd_async_handler_get_signo(snd_async_handler_t *handler)
 {
 	assert(handler);
+	if (snd_async_get_delivery() != SND_ASYNC_SIGNAL)
+		return -EINVAL;
 	return snd_async_signo;
 }
 
@@ -419,6 +419,9 @@ beginning:</P>
       loads and parses the given configuration files for each installed sound
       card. The driver name (the type of the sound card) is passed in the
       private configuration node.
+  <LI>The function load_card - \c snd_config_hook_load_card() - loads
+      the files of one card into the parent node, for the lazy mode of
+      load_for_all_cards.
 </UL>
 
 */
@@ -431,6 +434,7 @@ beginning:</P>
 #include <sys/stat.h>
 #include <dirent.h>
 #include <locale.h>
+#include <sys/mman.h>
 #ifdef HAVE_LIBPTHREAD
 #include <pthread.h>
 #endif
@@ -455,16 +459,37 @@ struct _snd_config {
 		struct {
 			struct list_head fields;
 			bool join;
+			struct config_index *index;
 		} compound;
 	} u;
 	struct list_head list;
 	snd_config_t *parent;
 	int hop;
+	struct config_arena *arena;	/* the node lives in this arena */
+	unsigned int arena_mem;		/* CONFIG_ARENA_ID/STR are in the arena */
+};
+
+#define CONFIG_ARENA_ID		(1<<0)
+#define CONFIG_ARENA_STR	(1<<1)
+
+/*
+ * Hash index of the children of a large compound, built on the first
+ * search that walks CONFIG_INDEX_MIN children and kept in sync by the
+ * functions linking and unlinking the children (open addressing).
+ */
+#define CONFIG_INDEX_MIN	16
+
+struct config_index {
+	unsigned int mask;
+	unsigned int count;
+	snd_config_t *slots[];
 };
 
 struct filedesc {
 	char *name;
 	snd_input_t *in;
+	/* memory backed input, read directly instead of by snd_input_getc() */
+	const unsigned char *buf, *ptr, *end;
 	unsigned int line, column;
 	struct filedesc *next;
 
@@ -488,12 +513,160 @@ struct include_path {
 #define LOCAL_UNEXPECTED_CHAR		(LOCAL_ERROR - 2)
 #define LOCAL_UNEXPECTED_EOF		(LOCAL_ERROR - 3)
 
+/*
+ * Parsed file cache (see config_load_cached()).  The cache of a file
+ * holds the tokens the parser consumed from it and its includes, and
+ * the state of every file the tokens depend on.  Replaying the tokens
+ * through the parser gives the same merge semantics as parsing the text.
+ */
+#define CONFIG_CACHE_MAGIC	0x43534c41	/* ALSC */
+#define CONFIG_CACHE_VERSION	1
+
+enum {
+	CONFIG_TOKEN_CHAR,
+	CONFIG_TOKEN_STRING,
+	CONFIG_TOKEN_QSTRING,
+};
+
+struct config_cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t key_size;
+	uint32_t files;
+	uint64_t files_size;
+	uint64_t tokens_size;
+};
+
+struct config_cache_file {
+	uint64_t dev;
+	uint64_t ino;
+	uint64_t size;
+	int64_t mtime;
+	uint32_t absent;
+	uint32_t name_size;
+};
+
+struct config_cache_buf {
+	char *data;
+	size_t size;
+	size_t alloc;
+};
+
+/* recording state while parsing the text */
+struct config_cache_rec {
+	struct config_cache_buf files;
+	struct config_cache_buf tokens;
+	unsigned int count;
+	int err;
+};
+
+/* replay state, tokens are read from the mapped cache */
+struct config_cache_play {
+	const char *ptr;
+	const char *end;
+};
+
 typedef struct {
 	struct filedesc *current;
 	int unget;
 	int ch;
+	struct config_cache_rec *rec;
+	struct config_cache_play *play;
 } input_t;
 
+static int config_cache_buf_add(struct config_cache_buf *buf,
+				const void *data, size_t size)
+{
+	if (buf->size + size > buf->alloc) {
+		size_t nalloc = buf->alloc ? buf->alloc * 2 : 4096;
+		char *ptr;
+		while (nalloc < buf->size + size)
+			nalloc *= 2;
+		ptr = realloc(buf->data, nalloc);
+		if (!ptr)
+			return -ENOMEM;
+		buf->data = ptr;
+		buf->alloc = nalloc;
+	}
+	memcpy(buf->data + buf->size, data, size);
+	buf->size += size;
+	return 0;
+}
+
+static void config_cache_stat(struct config_cache_file *f, const char *name)
+{
+	struct stat64 st;
+
+	memset(f, 0, sizeof(*f));
+	if (stat64(name, &st) < 0) {
+		f->absent = 1;
+	} else {
+		f->dev = st.st_dev;
+		f->ino = st.st_ino;
+		f->size = st.st_size;
+		f->mtime = st.st_mtime;
+	}
+	f->name_size = strlen(name) + 1;
+}
+
+/* remember the state of a file before it is read (or looked for) */
+static void config_cache_rec_file(input_t *input, const char *name)
+{
+	struct config_cache_rec *rec = input->rec;
+	struct config_cache_file f;
+
+	if (!rec || rec->err < 0)
+		return;
+	config_cache_stat(&f, name);
+	rec->err = config_cache_buf_add(&rec->files, &f, sizeof(f));
+	if (rec->err >= 0)
+		rec->err = config_cache_buf_add(&rec->files, name, f.name_size);
+	rec->count++;
+}
+
+static void config_cache_rec_token(input_t *input, int type, int c, const char *str)
+{
+	struct config_cache_rec *rec = input->rec;
+	unsigned char t = type;
+	int32_t val = c;
+	uint32_t size;
+
+	if (!rec || rec->err < 0)
+		return;
+	rec->err = config_cache_buf_add(&rec->tokens, &t, 1);
+	if (rec->err < 0)
+		return;
+	if (type == CONFIG_TOKEN_CHAR) {
+		rec->err = config_cache_buf_add(&rec->tokens, &val, sizeof(val));
+		return;
+	}
+	size = strlen(str);
+	rec->err = config_cache_buf_add(&rec->tokens, &size, sizeof(size));
+	if (rec->err >= 0)
+		rec->err = config_cache_buf_add(&rec->tokens, str, size);
+}
+
+/* next token of the replay, returns its type or LOCAL_UNEXPECTED_EOF */
+static int config_cache_play_token(struct config_cache_play *play, int32_t *val,
+				   const char **str, uint32_t *size)
+{
+	int type;
+
+	if (play->ptr >= play->end)
+		return LOCAL_UNEXPECTED_EOF;
+	type = *(const unsigned char *)play->ptr++;
+	if (type == CONFIG_TOKEN_CHAR) {
+		memcpy(val, play->ptr, sizeof(*val));
+		play->ptr += sizeof(*val);
+	} else {
+		memcpy(size, play->ptr, sizeof(*size));
+		play->ptr += sizeof(*size);
+		*str = play->ptr;
+		play->ptr += *size;
+	}
+	return type;
+}
+
 #ifdef HAVE_LIBPTHREAD
 
 static void snd_config_init_mutex(void)
@@ -526,6 +699,59 @@ static inline void snd_config_unlock(void) { }
 
 #endif
 
+/*
+ * The configuration trees are searched under a shared lock, so that
+ * concurrent opens do not serialize on each other.  The lock is taken
+ * exclusively to run hooks, which change the tree, and to replace
+ * snd_config.  Nested locking in the same thread only counts: a thread
+ * searching a tree cannot change it, its hooks are skipped and recorded
+ * in config_tree_missed instead, and the outermost search is then done
+ * again under the exclusive lock.  snd_config_lock(), protecting the
+ * update state and the references, nests inside of this lock.
+ */
+#if defined(HAVE_LIBPTHREAD) && defined(HAVE___THREAD)
+
+static pthread_rwlock_t config_tree_rwlock = PTHREAD_RWLOCK_INITIALIZER;
+static __thread unsigned int config_tree_depth;
+static __thread int config_tree_write;
+static __thread int config_tree_missed;
+
+static void config_tree_rdlock(void)
+{
+	if (config_tree_depth++ == 0) {
+		pthread_rwlock_rdlock(&config_tree_rwlock);
+		config_tree_write = 0;
+	}
+}
+
+/* -EBUSY when this thread holds the lock shared */
+static int config_tree_wrlock(void)
+{
+	if (config_tree_depth > 0 && !config_tree_write)
+		return -EBUSY;
+	if (config_tree_depth++ == 0) {
+		pthread_rwlock_wrlock(&config_tree_rwlock);
+		config_tree_write = 1;
+	}
+	return 0;
+}
+
+static void config_tree_unlock(void)
+{
+	if (--config_tree_depth == 0)
+		pthread_rwlock_unlock(&config_tree_rwlock);
+}
+
+#else
+
+static int config_tree_missed;
+
+static inline void config_tree_rdlock(void) { snd_config_lock(); }
+static inline int config_tree_wrlock(void) { snd_config_lock(); return 0; }
+static inline void config_tree_unlock(void) { snd_config_unlock(); }
+
+#endif
+
 /*
  * Add a diretory to the paths to search included files.
  * param fd -  File object that owns these paths to search files included by it.
@@ -632,15 +858,18 @@ static char *_snd_config_path(const char *name)
  *    These directories should be subdirectories of /usr/share/alsa.
  */
 static int input_stdio_open(snd_input_t **inputp, const char *file,
-			    struct filedesc *current)
+			    input_t *input)
 {
+	struct filedesc *current = input->current;
 	struct list_head *pos;
 	struct include_path *path;
 	char full_path[PATH_MAX];
 	int err;
 
-	if (file[0] == '/')
-		return snd_input_stdio_open(inputp, file, "r");
+	if (file[0] == '/') {
+		config_cache_rec_file(input, file);
+		return snd_input_mmap_open(inputp, file);
+	}
 
 	/* search file in user specified include paths. These directories
 	 * are subdirectories of /usr/share/alsa.
@@ -653,7 +882,8 @@ static int input_stdio_open(snd_input_t **inputp, const char *file,
 				continue;
 
 			snprintf(full_path, PATH_MAX, "%s/%s", path->dir, file);
-			err = snd_input_stdio_open(inputp, full_path, "r");
+			config_cache_rec_file(input, full_path);
+			err = snd_input_mmap_open(inputp, full_path);
 			if (err == 0)
 				return 0;
 		}
@@ -739,6 +969,86 @@ int _snd_safe_strtod(const char *str, double *val)
 	return 0;
 }
 
+/* the byte classes for the bulk scanning of memory backed input */
+#define CHAR_BLANK	0x01	/* skipped by get_nonwhite_char() */
+#define CHAR_DELIM	0x02	/* ends a free string */
+#define CHAR_ID_DELIM	0x04	/* ends a free string parsed as id */
+#define CHAR_STR_STOP	0x08	/* needs get_char() in a delimited string */
+
+static const unsigned char char_class[256] = {
+	[' '] = CHAR_BLANK | CHAR_DELIM | CHAR_ID_DELIM,
+	['\f'] = CHAR_BLANK | CHAR_DELIM | CHAR_ID_DELIM,
+	['\t'] = CHAR_BLANK | CHAR_DELIM | CHAR_ID_DELIM | CHAR_STR_STOP,
+	['\n'] = CHAR_BLANK | CHAR_DELIM | CHAR_ID_DELIM | CHAR_STR_STOP,
+	['\r'] = CHAR_BLANK | CHAR_DELIM | CHAR_ID_DELIM,
+	['='] = CHAR_DELIM | CHAR_ID_DELIM,
+	[','] = CHAR_DELIM | CHAR_ID_DELIM,
+	[';'] = CHAR_DELIM | CHAR_ID_DELIM,
+	['{'] = CHAR_DELIM | CHAR_ID_DELIM,
+	['}'] = CHAR_DELIM | CHAR_ID_DELIM,
+	['['] = CHAR_DELIM | CHAR_ID_DELIM,
+	[']'] = CHAR_DELIM | CHAR_ID_DELIM,
+	['\''] = CHAR_DELIM | CHAR_ID_DELIM,
+	['"'] = CHAR_DELIM | CHAR_ID_DELIM,
+	['\\'] = CHAR_DELIM | CHAR_ID_DELIM | CHAR_STR_STOP,
+	['#'] = CHAR_DELIM | CHAR_ID_DELIM,
+	['.'] = CHAR_ID_DELIM,
+};
+
+static void filedesc_init(struct filedesc *fd, snd_input_t *in)
+{
+	const char *buf;
+	size_t size;
+
+	fd->in = in;
+	if (snd_input_buffer_peek(in, &buf, &size) == 0) {
+		fd->buf = fd->ptr = (const unsigned char *)buf;
+		fd->end = fd->buf + size;
+	} else {
+		fd->buf = fd->ptr = fd->end = NULL;
+	}
+	fd->line = 1;
+	fd->column = 0;
+}
+
+/*
+ * the bulk scanners below may only be used when the next character is
+ * not an ungot one; they keep the line and the column as get_char() does
+ */
+static inline struct filedesc *bulk_filedesc(input_t *input)
+{
+	struct filedesc *fd = input->current;
+
+	return fd->buf && !input->unget ? fd : NULL;
+}
+
+static void bulk_skip_blanks(struct filedesc *fd)
+{
+	const unsigned char *p = fd->ptr;
+
+	for (; p < fd->end && (char_class[*p] & CHAR_BLANK); p++) {
+		if (*p == '\n') {
+			fd->column = 0;
+			fd->line++;
+		} else if (*p == '\t') {
+			fd->column += 8 - fd->column % 8;
+		} else {
+			fd->column++;
+		}
+	}
+	fd->ptr = p;
+}
+
+/* the run of bytes up to the first one in the stop classes or delim */
+static size_t bulk_span(struct filedesc *fd, unsigned char stop, int delim)
+{
+	const unsigned char *p = fd->ptr;
+
+	while (p < fd->end && !(char_class[*p] & stop) && *p != delim)
+		p++;
+	return p - fd->ptr;
+}
+
 static int get_char(input_t *input)
 {
 	int c;
@@ -749,7 +1059,10 @@ static int get_char(input_t *input)
 	}
  again:
 	fd = input->current;
-	c = snd_input_getc(fd->in);
+	if (fd->buf)
+		c = fd->ptr < fd->end ? *fd->ptr++ : EOF;
+	else
+		c = snd_input_getc(fd->in);
 	switch (c) {
 	case '\n':
 		fd->column = 0;
@@ -776,6 +1089,9 @@ static int get_char(input_t *input)
 
 static void unget_char(int c, input_t *input)
 {
+	/* the replayed tokens already account for it */
+	if (input->play)
+		return;
 	assert(!input->unget);
 	input->ch = c;
 	input->unget = 1;
@@ -785,6 +1101,7 @@ static int get_delimstring(char **string, int delim, input_t *input);
 
 static int get_char_skip_comments(input_t *input)
 {
+	struct filedesc *cur;
 	int c;
 	while (1) {
 		c = get_char(input);
@@ -805,6 +1122,7 @@ static int get_char_skip_comments(input_t *input)
 					return -ENOMEM;
 				str = tmp;
 
+				config_cache_rec_file(input, str);
 				dirp = opendir(str);
 				if (!dirp) {
 					SNDERR("Invalid search dir %s", str);
@@ -829,9 +1147,10 @@ static int get_char_skip_comments(input_t *input)
 				if (tmp == NULL)
 					return -ENOMEM;
 				str = tmp;
-				err = snd_input_stdio_open(&in, str, "r");
+				config_cache_rec_file(input, str);
+				err = snd_input_mmap_open(&in, str);
 			} else { /* absolute or relative file path */
-				err = input_stdio_open(&in, str, input->current);
+				err = input_stdio_open(&in, str, input);
 			}
 
 			if (err < 0) {
@@ -845,16 +1164,24 @@ static int get_char_skip_comments(input_t *input)
 				return -ENOMEM;
 			}
 			fd->name = str;
-			fd->in = in;
+			filedesc_init(fd, in);
 			fd->next = input->current;
-			fd->line = 1;
-			fd->column = 0;
 			INIT_LIST_HEAD(&fd->include_paths);
 			input->current = fd;
 			continue;
 		}
 		if (c != '#')
 			break;
+		cur = bulk_filedesc(input);
+		if (cur) {
+			const unsigned char *nl = memchr(cur->ptr, '\n', cur->end - cur->ptr);
+			/* the newline itself is read below, it counts the line */
+			if (!nl) {
+				cur->column += cur->end - cur->ptr;
+				nl = cur->end;
+			}
+			cur->ptr = nl;
+		}
 		while (1) {
 			c = get_char(input);
 			if (c < 0)
@@ -868,10 +1195,14 @@ static int get_char_skip_comments(input_t *input)
 }
 			
 
-static int get_nonwhite(input_t *input)
+static int get_nonwhite_char(input_t *input)
 {
+	struct filedesc *fd;
 	int c;
 	while (1) {
+		fd = bulk_filedesc(input);
+		if (fd)
+			bulk_skip_blanks(fd);
 		c = get_char_skip_comments(input);
 		switch (c) {
 		case ' ':
@@ -962,10 +1293,12 @@ static void free_local_string(struct local_string *s)
 		free(s->buf);
 }
 
-static int add_char_local_string(struct local_string *s, int c)
+static int grow_local_string(struct local_string *s, size_t size)
 {
-	if (s->idx >= s->alloc) {
+	if (size > s->alloc) {
 		size_t nalloc = s->alloc * 2;
+		while (nalloc < size)
+			nalloc *= 2;
 		if (s->buf == s->tmpbuf) {
 			s->buf = malloc(nalloc);
 			if (s->buf == NULL)
@@ -979,10 +1312,30 @@ static int add_char_local_string(struct local_string *s, int c)
 		}
 		s->alloc = nalloc;
 	}
+	return 0;
+}
+
+static int add_char_local_string(struct local_string *s, int c)
+{
+	if (grow_local_string(s, s->idx + 1) < 0)
+		return -ENOMEM;
 	s->buf[s->idx++] = c;
 	return 0;
 }
 
+/* takes a run of plain bytes, without tabs and newlines, from fd */
+static int add_bulk_local_string(struct local_string *s, struct filedesc *fd,
+				 size_t len)
+{
+	if (grow_local_string(s, s->idx + len) < 0)
+		return -ENOMEM;
+	memcpy(s->buf + s->idx, fd->ptr, len);
+	s->idx += len;
+	fd->ptr += len;
+	fd->column += len;
+	return 0;
+}
+
 static char *copy_local_string(struct local_string *s)
 {
 	char *dst = malloc(s->idx + 1);
@@ -996,10 +1349,17 @@ static char *copy_local_string(struct local_string *s)
 static int get_freestring(char **string, int id, input_t *input)
 {
 	struct local_string str;
+	struct filedesc *fd;
 	int c;
 
 	init_local_string(&str);
 	while (1) {
+		fd = bulk_filedesc(input);
+		if (fd && add_bulk_local_string(&str, fd,
+				bulk_span(fd, id ? CHAR_ID_DELIM : CHAR_DELIM, -1)) < 0) {
+			c = -ENOMEM;
+			break;
+		}
 		c = get_char(input);
 		if (c < 0) {
 			if (c == LOCAL_UNEXPECTED_EOF) {
@@ -1056,10 +1416,17 @@ static int get_freestring(char **string, int id, input_t *input)
 static int get_delimstring(char **string, int delim, input_t *input)
 {
 	struct local_string str;
+	struct filedesc *fd;
 	int c;
 
 	init_local_string(&str);
 	while (1) {
+		fd = bulk_filedesc(input);
+		if (fd && add_bulk_local_string(&str, fd,
+				bulk_span(fd, CHAR_STR_STOP, delim)) < 0) {
+			c = -ENOMEM;
+			break;
+		}
 		c = get_char(input);
 		if (c < 0)
 			break;
@@ -1087,9 +1454,9 @@ static int get_delimstring(char **string, int delim, input_t *input)
 }
 
 /* Return 0 for free string, 1 for delimited string */
-static int get_string(char **string, int id, input_t *input)
+static int get_string_text(char **string, int id, input_t *input)
 {
-	int c = get_nonwhite(input), err;
+	int c = get_nonwhite_char(input), err;
 	if (c < 0)
 		return c;
 	switch (c) {
@@ -1118,11 +1485,230 @@ static int get_string(char **string, int id, input_t *input)
 	}
 }
 
+/*
+ * The parser reads the input through get_nonwhite() and get_string()
+ * only, these record or replay the cached tokens.
+ */
+static int get_nonwhite(input_t *input)
+{
+	const char *str;
+	uint32_t size;
+	int32_t val;
+	int c;
+
+	if (input->play) {
+		c = config_cache_play_token(input->play, &val, &str, &size);
+		if (c == CONFIG_TOKEN_CHAR)
+			return val;
+		return c < 0 ? c : LOCAL_UNEXPECTED_CHAR;
+	}
+	c = get_nonwhite_char(input);
+	config_cache_rec_token(input, CONFIG_TOKEN_CHAR, c, NULL);
+	return c;
+}
+
+static int get_string(char **string, int id, input_t *input)
+{
+	const char *str;
+	uint32_t size;
+	int32_t val;
+	int err;
+
+	if (input->play) {
+		err = config_cache_play_token(input->play, &val, &str, &size);
+		if (err == CONFIG_TOKEN_CHAR)
+			return val < 0 ? val : LOCAL_UNEXPECTED_CHAR;
+		if (err < 0)
+			return err;
+		*string = strndup(str, size);
+		if (!*string)
+			return -ENOMEM;
+		return err == CONFIG_TOKEN_QSTRING;
+	}
+	err = get_string_text(string, id, input);
+	if (err >= 0)
+		config_cache_rec_token(input, err ? CONFIG_TOKEN_QSTRING :
+				       CONFIG_TOKEN_STRING, 0, *string);
+	return err;
+}
+
+/*
+ * Arenas: the trees built by snd_config_expand() and snd_config_copy()
+ * take their nodes, ids and strings from one arena, set up for the
+ * thread doing the walk.  Each node holds a reference to its arena, so
+ * nodes may still be moved to other trees; the chunks are released
+ * together with the last node.  Memory of replaced strings is kept
+ * until then.
+ */
+#ifdef HAVE___THREAD
+#define CONFIG_ARENA_CHUNK	16384
+
+struct config_arena_chunk {
+	struct config_arena_chunk *next;
+	size_t size;
+	size_t used;
+	long long data[];
+};
+
+struct config_arena {
+	unsigned int refs;
+	struct config_arena_chunk *chunk;
+};
+
+static __thread struct config_arena *config_arena_current;
+
+/* use an arena for the nodes created until config_arena_end() */
+static struct config_arena *config_arena_begin(void)
+{
+	struct config_arena *arena;
+
+	if (config_arena_current)
+		return NULL;	/* nested, keep the outer one */
+	arena = calloc(1, sizeof(*arena));
+	if (!arena)
+		return NULL;
+	arena->refs = 1;
+	config_arena_current = arena;
+	return arena;
+}
+
+static void config_arena_unref(struct config_arena *arena)
+{
+	struct config_arena_chunk *c, *next;
+
+	if (__atomic_sub_fetch(&arena->refs, 1, __ATOMIC_ACQ_REL) > 0)
+		return;
+	for (c = arena->chunk; c; c = next) {
+		next = c->next;
+		free(c);
+	}
+	free(arena);
+}
+
+static void config_arena_end(struct config_arena *arena)
+{
+	if (!arena)
+		return;
+	config_arena_current = NULL;
+	config_arena_unref(arena);
+}
+
+static void *config_arena_alloc(struct config_arena *arena, size_t size)
+{
+	struct config_arena_chunk *c = arena->chunk;
+	void *ptr;
+
+	size = (size + sizeof(long long) - 1) & ~(sizeof(long long) - 1);
+	if (!c || c->size - c->used < size) {
+		size_t csize = size > CONFIG_ARENA_CHUNK ? size : CONFIG_ARENA_CHUNK;
+		c = malloc(sizeof(*c) + csize);
+		if (!c)
+			return NULL;
+		c->size = csize;
+		c->used = 0;
+		if (arena->chunk && size > CONFIG_ARENA_CHUNK) {
+			/* keep filling the current chunk */
+			c->next = arena->chunk->next;
+			arena->chunk->next = c;
+		} else {
+			c->next = arena->chunk;
+			arena->chunk = c;
+		}
+	}
+	ptr = (char *)c->data + c->used;
+	c->used += size;
+	return ptr;
+}
+
+static snd_config_t *config_node_alloc(void)
+{
+	struct config_arena *arena = config_arena_current;
+	snd_config_t *n;
+
+	if (!arena)
+		return calloc(1, sizeof(*n));
+	n = config_arena_alloc(arena, sizeof(*n));
+	if (!n)
+		return NULL;
+	memset(n, 0, sizeof(*n));
+	n->arena = arena;
+	__atomic_add_fetch(&arena->refs, 1, __ATOMIC_RELAXED);
+	return n;
+}
+
+static void config_node_free(snd_config_t *n)
+{
+	if (n->arena)
+		config_arena_unref(n->arena);
+	else
+		free(n);
+}
+
+/* copy of s owned by n, in the arena while it is being filled */
+static char *config_strdup(snd_config_t *n, const char *s, unsigned int *mem)
+{
+	size_t size;
+	char *d;
+
+	*mem = 0;
+	if (!n->arena || n->arena != config_arena_current)
+		return strdup(s);
+	size = strlen(s) + 1;
+	d = config_arena_alloc(n->arena, size);
+	if (d) {
+		memcpy(d, s, size);
+		*mem = 1;
+	}
+	return d;
+}
+#else
+#define config_arena_begin()	NULL
+#define config_arena_end(arena)	do { (void)(arena); } while (0)
+#define config_node_alloc()	calloc(1, sizeof(snd_config_t))
+#define config_node_free(n)	free(n)
+
+static char *config_strdup(snd_config_t *n ATTRIBUTE_UNUSED, const char *s,
+			   unsigned int *mem)
+{
+	*mem = 0;
+	return strdup(s);
+}
+#endif
+
+/* replace the id or string (bit) of n, s may be NULL */
+static int config_set_str(snd_config_t *n, char **dst, const char *s,
+			  unsigned int bit)
+{
+	unsigned int mem = 0;
+	char *d = NULL;
+
+	if (s) {
+		d = config_strdup(n, s, &mem);
+		if (!d)
+			return -ENOMEM;
+	}
+	if (!(n->arena_mem & bit))
+		free(*dst);
+	*dst = d;
+	n->arena_mem = mem ? n->arena_mem | bit : n->arena_mem & ~bit;
+	return 0;
+}
+
+/* replace the id or string (bit) of n with the allocated s */
+static void config_take_str(snd_config_t *n, char **dst, char *s,
+			    unsigned int bit)
+{
+	if (!(n->arena_mem & bit))
+		free(*dst);
+	*dst = s;
+	n->arena_mem &= ~bit;
+}
+
 static int _snd_config_make(snd_config_t **config, char **id, snd_config_type_t type)
 {
 	snd_config_t *n;
 	assert(config);
-	n = calloc(1, sizeof(*n));
+	n = config_node_alloc();
 	if (n == NULL) {
 		if (*id) {
 			free(*id);
@@ -1142,43 +1728,185 @@ static int _snd_config_make(snd_config_t **config, char **id, snd_config_type_t
 }
 	
 
-static int _snd_config_make_add(snd_config_t **config, char **id,
-				snd_config_type_t type, snd_config_t *parent)
+static unsigned int config_index_hash(const char *id, int len)
 {
-	snd_config_t *n;
-	int err;
-	assert(parent->type == SND_CONFIG_TYPE_COMPOUND);
-	err = _snd_config_make(&n, id, type);
-	if (err < 0)
-		return err;
-	n->parent = parent;
-	list_add_tail(&n->list, &parent->u.compound.fields);
-	*config = n;
+	unsigned int h = 2166136261U;
+
+	if (len < 0)
+		len = strlen(id);
+	while (len--) {
+		h ^= (unsigned char)*id++;
+		h *= 16777619U;
+	}
+	return h;
+}
+
+static void config_index_free(snd_config_t *config)
+{
+	free(config->u.compound.index);
+	config->u.compound.index = NULL;
+}
+
+/* returns -EEXIST for a duplicate id, the index can't be used then */
+static int config_index_insert(struct config_index *index, snd_config_t *child)
+{
+	unsigned int k = config_index_hash(child->id, -1) & index->mask;
+
+	while (index->slots[k]) {
+		if (strcmp(index->slots[k]->id, child->id) == 0)
+			return -EEXIST;
+		k = (k + 1) & index->mask;
+	}
+	index->slots[k] = child;
+	index->count++;
 	return 0;
 }
 
-static int _snd_config_search(snd_config_t *config, 
-			      const char *id, int len, snd_config_t **result)
+static void config_index_build(snd_config_t *config)
 {
+	struct config_index *index;
 	snd_config_iterator_t i, next;
+	unsigned int size = 32, count = 0;
+
+	snd_config_for_each(i, next, config)
+		count++;
+	while (size < count * 2)
+		size *= 2;
+	index = calloc(1, sizeof(*index) + size * sizeof(index->slots[0]));
+	if (!index)
+		return;
+	index->mask = size - 1;
 	snd_config_for_each(i, next, config) {
 		snd_config_t *n = snd_config_iterator_entry(i);
-		if (len < 0) {
-			if (strcmp(n->id, id) != 0)
-				continue;
-		} else if (strlen(n->id) != (size_t) len ||
-			   memcmp(n->id, id, (size_t) len) != 0)
-				continue;
-		if (result)
-			*result = n;
-		return 0;
+		if (!n->id || config_index_insert(index, n) < 0) {
+			free(index);
+			return;
+		}
 	}
-	return -ENOENT;
+	/* concurrent searches of a shared tree may race to build it */
+	if (!__atomic_compare_exchange_n(&config->u.compound.index,
+					 &(struct config_index *){ NULL }, index,
+					 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		free(index);
 }
 
-static int parse_value(snd_config_t **_n, snd_config_t *parent, input_t *input, char **id, int skip)
+/* a child was linked to parent */
+static void config_index_add(snd_config_t *parent, snd_config_t *child)
 {
-	snd_config_t *n = *_n;
+	struct config_index *index = parent->u.compound.index;
+
+	if (!index)
+		return;
+	if ((index->count + 1) * 2 > index->mask + 1) {
+		/* rebuilt larger on the next search */
+		config_index_free(parent);
+		return;
+	}
+	if (!child->id || config_index_insert(index, child) < 0)
+		config_index_free(parent);
+}
+
+/* a child is unlinked from parent */
+static void config_index_del(snd_config_t *parent, snd_config_t *child)
+{
+	struct config_index *index = parent->u.compound.index;
+	unsigned int k, j;
+
+	if (!index || !child->id)
+		return;
+	k = config_index_hash(child->id, -1) & index->mask;
+	while (index->slots[k] != child) {
+		if (!index->slots[k])
+			return;
+		k = (k + 1) & index->mask;
+	}
+	/* shift the following entries of the probe sequence back */
+	for (j = (k + 1) & index->mask; index->slots[j]; j = (j + 1) & index->mask) {
+		unsigned int h = config_index_hash(index->slots[j]->id, -1) & index->mask;
+		if (((j - h) & index->mask) >= ((j - k) & index->mask)) {
+			index->slots[k] = index->slots[j];
+			k = j;
+		}
+	}
+	index->slots[k] = NULL;
+	index->count--;
+}
+
+static int config_index_search(struct config_index *index,
+			       const char *id, int len, snd_config_t **result)
+{
+	unsigned int k = config_index_hash(id, len) & index->mask;
+	snd_config_t *n;
+
+	while ((n = index->slots[k]) != NULL) {
+		if (len < 0) {
+			if (strcmp(n->id, id) == 0)
+				break;
+		} else if (strlen(n->id) == (size_t) len &&
+			   memcmp(n->id, id, (size_t) len) == 0)
+			break;
+		k = (k + 1) & index->mask;
+	}
+	if (!n)
+		return -ENOENT;
+	if (result)
+		*result = n;
+	return 0;
+}
+
+static int _snd_config_make_add(snd_config_t **config, char **id,
+				snd_config_type_t type, snd_config_t *parent)
+{
+	snd_config_t *n;
+	int err;
+	assert(parent->type == SND_CONFIG_TYPE_COMPOUND);
+	err = _snd_config_make(&n, id, type);
+	if (err < 0)
+		return err;
+	n->parent = parent;
+	list_add_tail(&n->list, &parent->u.compound.fields);
+	config_index_add(parent, n);
+	*config = n;
+	return 0;
+}
+
+static int _snd_config_search(snd_config_t *config, 
+			      const char *id, int len, snd_config_t **result)
+{
+	snd_config_iterator_t i, next;
+	struct config_index *index;
+	unsigned int count = 0;
+
+	if (config->type != SND_CONFIG_TYPE_COMPOUND)
+		return -ENOENT;
+	index = __atomic_load_n(&config->u.compound.index, __ATOMIC_ACQUIRE);
+	if (index)
+		return config_index_search(index, id, len, result);
+	snd_config_for_each(i, next, config) {
+		snd_config_t *n = snd_config_iterator_entry(i);
+		if (++count == CONFIG_INDEX_MIN) {
+			config_index_build(config);
+			index = __atomic_load_n(&config->u.compound.index,
+						__ATOMIC_ACQUIRE);
+			if (index)
+				return config_index_search(index, id, len, result);
+		}
+		if (len < 0) {
+			if (strcmp(n->id, id) != 0)
+				continue;
+		} else if (strlen(n->id) != (size_t) len ||
+			   memcmp(n->id, id, (size_t) len) != 0)
+				continue;
+		if (result)
+			*result = n;
+		return 0;
+	}
+	return -ENOENT;
+}
+
+static int parse_value(snd_config_t **_n, snd_config_t *parent, input_t *input, char **id, int skip)
+{
+	snd_config_t *n = *_n;
 	char *s;
 	int err;
 
@@ -1246,8 +1974,7 @@ static int parse_value(snd_config_t **_n, snd_config_t *parent, input_t *input,
 		if (err < 0)
 			return err;
 	}
-	free(n->u.string);
-	n->u.string = s;
+	config_take_str(n, &n->u.string, s, CONFIG_ARENA_STR);
 	*_n = n;
 	return 0;
 }
@@ -1517,12 +2244,86 @@ static int parse_defs(snd_config_t *parent, input_t *input, int skip, int overri
 	return 0;
 }
 
-static void string_print(char *str, int id, snd_output_t *out)
+/*
+ * The text is assembled in a local chunk which is passed to the output
+ * in large pieces, rather than with an output call for each token.
+ */
+#define SAVE_CHUNK	4096
+
+typedef struct {
+	snd_output_t *out;
+	int compact;
+	int sep;		/* compact: an entry precedes */
+	size_t len;
+	char buf[SAVE_CHUNK + 1];
+} save_buf_t;
+
+static void save_flush(save_buf_t *sb)
+{
+	if (sb->len == 0)
+		return;
+	sb->buf[sb->len] = '\0';
+	snd_output_puts(sb->out, sb->buf);
+	sb->len = 0;
+}
+
+static inline void save_putc(save_buf_t *sb, int c)
+{
+	if (sb->len == SAVE_CHUNK)
+		save_flush(sb);
+	sb->buf[sb->len++] = c;
+}
+
+static void save_write(save_buf_t *sb, const char *str, size_t len)
+{
+	size_t n;
+
+	while (len > 0) {
+		if (sb->len == SAVE_CHUNK)
+			save_flush(sb);
+		n = SAVE_CHUNK - sb->len;
+		if (n > len)
+			n = len;
+		memcpy(sb->buf + sb->len, str, n);
+		sb->len += n;
+		str += n;
+		len -= n;
+	}
+}
+
+static inline void save_puts(save_buf_t *sb, const char *str)
+{
+	save_write(sb, str, strlen(str));
+}
+
+static void save_printf(save_buf_t *sb, const char *format, ...)
+{
+	char tmp[64];
+	va_list args;
+	int len;
+
+	va_start(args, format);
+	len = vsnprintf(tmp, sizeof(tmp), format, args);
+	va_end(args);
+	if (len < 0)
+		return;
+	if ((size_t)len >= sizeof(tmp)) {
+		/* not for the numeric formats used here */
+		save_flush(sb);
+		va_start(args, format);
+		snd_output_vprintf(sb->out, format, args);
+		va_end(args);
+		return;
+	}
+	save_write(sb, tmp, len);
+}
+
+static void string_print(char *str, int id, save_buf_t *sb)
 {
 	int q;
 	unsigned char *p = (unsigned char *)str;
 	if (!p || !*p) {
-		snd_output_puts(out, "''");
+		save_write(sb, "''", 2);
 		return;
 	}
 	if (!id) {
@@ -1558,144 +2359,167 @@ static void string_print(char *str, int id, snd_output_t *out)
 		goto loop;
 	}
  nonquoted:
-	snd_output_puts(out, str);
+	save_write(sb, str, (char *)p - str);
 	return;
  quoted:
 	q = strchr(str, '\'') ? '"' : '\'';
-	snd_output_putc(out, q);
+	save_putc(sb, q);
 	p = (unsigned char *)str;
 	while (*p) {
 		int c;
 		c = *p;
 		switch (c) {
 		case '\n':
-			snd_output_putc(out, '\\');
-			snd_output_putc(out, 'n');
+			save_putc(sb, '\\');
+			save_putc(sb, 'n');
 			break;
 		case '\t':
-			snd_output_putc(out, '\\');
-			snd_output_putc(out, 't');
+			save_putc(sb, '\\');
+			save_putc(sb, 't');
 			break;
 		case '\v':
-			snd_output_putc(out, '\\');
-			snd_output_putc(out, 'v');
+			save_putc(sb, '\\');
+			save_putc(sb, 'v');
 			break;
 		case '\b':
-			snd_output_putc(out, '\\');
-			snd_output_putc(out, 'b');
+			save_putc(sb, '\\');
+			save_putc(sb, 'b');
 			break;
 		case '\r':
-			snd_output_putc(out, '\\');
-			snd_output_putc(out, 'r');
+			save_putc(sb, '\\');
+			save_putc(sb, 'r');
 			break;
 		case '\f':
-			snd_output_putc(out, '\\');
-			snd_output_putc(out, 'f');
+			save_putc(sb, '\\');
+			save_putc(sb, 'f');
 			break;
 		default:
 			if (c == q) {
-				snd_output_putc(out, '\\');
-				snd_output_putc(out, c);
+				save_putc(sb, '\\');
+				save_putc(sb, c);
 			} else {
 				if (c >= 32 && c <= 126)
-					snd_output_putc(out, c);
+					save_putc(sb, c);
 				else
-					snd_output_printf(out, "\\%04o", c);
+					save_printf(sb, "\\%04o", c);
 			}
 			break;
 		}
 		p++;
 	}
-	snd_output_putc(out, q);
+	save_putc(sb, q);
 }
 
-static void level_print(snd_output_t *out, unsigned int level)
+static void level_print(save_buf_t *sb, unsigned int level)
 {
-	char a[level + 1];
-	memset(a, '\t', level);
-	a[level] = '\0';
-	snd_output_puts(out, a);
+	if (sb->compact)
+		return;
+	while (level-- > 0)
+		save_putc(sb, '\t');
 }
 
-static int _snd_config_save_children(snd_config_t *config, snd_output_t *out,
-				     unsigned int level, unsigned int joins,
-				     int array);
+static int save_children(snd_config_t *config, save_buf_t *sb,
+			 unsigned int level, unsigned int joins, int array);
 
-int _snd_config_save_node_value(snd_config_t *n, snd_output_t *out,
-				unsigned int level)
+static int save_node_value(snd_config_t *n, save_buf_t *sb, unsigned int level)
 {
 	int err, array;
 	switch (n->type) {
 	case SND_CONFIG_TYPE_INTEGER:
-		snd_output_printf(out, "%ld", n->u.integer);
+		save_printf(sb, "%ld", n->u.integer);
 		break;
 	case SND_CONFIG_TYPE_INTEGER64:
-		snd_output_printf(out, "%lld", n->u.integer64);
+		save_printf(sb, "%lld", n->u.integer64);
 		break;
 	case SND_CONFIG_TYPE_REAL:
-		snd_output_printf(out, "%-16g", n->u.real);
+		save_printf(sb, sb->compact ? "%g" : "%-16g", n->u.real);
 		break;
 	case SND_CONFIG_TYPE_STRING:
-		string_print(n->u.string, 0, out);
+		string_print(n->u.string, 0, sb);
 		break;
 	case SND_CONFIG_TYPE_POINTER:
 		SNDERR("cannot save runtime pointer type");
 		return -EINVAL;
 	case SND_CONFIG_TYPE_COMPOUND:
 		array = snd_config_is_array(n);
-		snd_output_putc(out, array ? '[' : '{');
-		snd_output_putc(out, '\n');
-		err = _snd_config_save_children(n, out, level + 1, 0, array);
+		save_putc(sb, array ? '[' : '{');
+		if (!sb->compact)
+			save_putc(sb, '\n');
+		sb->sep = 0;
+		err = save_children(n, sb, level + 1, 0, array);
 		if (err < 0)
 			return err;
-		level_print(out, level);
-		snd_output_putc(out, array ? ']' : '}');
+		level_print(sb, level);
+		save_putc(sb, array ? ']' : '}');
 		break;
 	}
 	return 0;
 }
 
-static void id_print(snd_config_t *n, snd_output_t *out, unsigned int joins)
+int _snd_config_save_node_value(snd_config_t *n, snd_output_t *out,
+				unsigned int level)
+{
+	save_buf_t sb;
+	int err;
+
+	sb.out = out;
+	sb.compact = 0;
+	sb.sep = 0;
+	sb.len = 0;
+	err = save_node_value(n, &sb, level);
+	save_flush(&sb);
+	return err;
+}
+
+static void id_print(snd_config_t *n, save_buf_t *sb, unsigned int joins)
 {
 	if (joins > 0) {
 		assert(n->parent);
-		id_print(n->parent, out, joins - 1);
-		snd_output_putc(out, '.');
+		id_print(n->parent, sb, joins - 1);
+		save_putc(sb, '.');
 	}
-	string_print(n->id, 1, out);
+	string_print(n->id, 1, sb);
 }
 
-static int _snd_config_save_children(snd_config_t *config, snd_output_t *out,
-				     unsigned int level, unsigned int joins,
-				     int array)
+/*
+ * The compact form has no indentation and separates the entries with a
+ * single space, the compound values follow their ids directly.
+ */
+static int save_children(snd_config_t *config, save_buf_t *sb,
+			 unsigned int level, unsigned int joins, int array)
 {
 	int err;
 	snd_config_iterator_t i, next;
-	assert(config && out);
+	assert(config && sb);
 	snd_config_for_each(i, next, config) {
 		snd_config_t *n = snd_config_iterator_entry(i);
 		if (n->type == SND_CONFIG_TYPE_COMPOUND &&
 		    n->u.compound.join) {
-			err = _snd_config_save_children(n, out, level, joins + 1, 0);
+			err = save_children(n, sb, level, joins + 1, 0);
 			if (err < 0)
 				return err;
 			continue;
 		}
-		level_print(out, level);
+		if (sb->compact && sb->sep)
+			save_putc(sb, ' ');
+		level_print(sb, level);
 		if (!array) {
-			id_print(n, out, joins);
-			snd_output_putc(out, ' ');
+			id_print(n, sb, joins);
+			if (!sb->compact || n->type != SND_CONFIG_TYPE_COMPOUND)
+				save_putc(sb, ' ');
 #if 0
-			snd_output_putc(out, '=');
+			save_putc(sb, '=');
 #endif
 		}
-		err = _snd_config_save_node_value(n, out, level);
+		err = save_node_value(n, sb, level);
 		if (err < 0)
 			return err;
 #if 0
-		snd_output_putc(out, ';');
+		save_putc(sb, ';');
 #endif
-		snd_output_putc(out, '\n');
+		if (!sb->compact)
+			save_putc(sb, '\n');
+		sb->sep = 1;
 	}
 	return 0;
 }
@@ -1724,7 +2548,31 @@ static int _snd_config_save_children(snd_config_t *config, snd_output_t *out,
  */
 int snd_config_substitute(snd_config_t *dst, snd_config_t *src)
 {
+	char *id, *str = NULL;
+	unsigned int mem;
+
 	assert(dst && src);
+	id = src->id;
+	if (src->type == SND_CONFIG_TYPE_STRING)
+		str = src->u.string;
+	mem = src->arena_mem;
+	if (src->arena != dst->arena && mem) {
+		/* the arena memory of src may go away with it */
+		if ((mem & CONFIG_ARENA_ID) && id) {
+			id = strdup(id);
+			if (!id)
+				return -ENOMEM;
+		}
+		if ((mem & CONFIG_ARENA_STR) && str) {
+			str = strdup(str);
+			if (!str) {
+				if (mem & CONFIG_ARENA_ID)
+					free(id);
+				return -ENOMEM;
+			}
+		}
+		mem = 0;
+	}
 	if (dst->type == SND_CONFIG_TYPE_COMPOUND) {
 		int err = snd_config_delete_compound_members(dst);
 		if (err < 0)
@@ -1740,13 +2588,22 @@ int snd_config_substitute(snd_config_t *dst, snd_config_t *src)
 		src->u.compound.fields.next->prev = &dst->u.compound.fields;
 		src->u.compound.fields.prev->next = &dst->u.compound.fields;
 	}
-	free(dst->id);
-	if (dst->type == SND_CONFIG_TYPE_STRING)
+	if (dst->parent)
+		config_index_del(dst->parent, dst);
+	if (!(dst->arena_mem & CONFIG_ARENA_ID))
+		free(dst->id);
+	if (dst->type == SND_CONFIG_TYPE_STRING &&
+	    !(dst->arena_mem & CONFIG_ARENA_STR))
 		free(dst->u.string);
-	dst->id = src->id;
+	dst->id = id;
 	dst->type = src->type;
 	dst->u = src->u;
-	free(src);
+	if (dst->type == SND_CONFIG_TYPE_STRING)
+		dst->u.string = str;
+	dst->arena_mem = mem;
+	if (dst->parent)
+		config_index_add(dst->parent, dst);
+	config_node_free(src);
 	return 0;
 }
 
@@ -1902,28 +2759,25 @@ int snd_config_get_id(const snd_config_t *config, const char **id)
  */
 int snd_config_set_id(snd_config_t *config, const char *id)
 {
-	snd_config_iterator_t i, next;
-	char *new_id;
+	int err;
 	assert(config);
 	if (id) {
 		if (config->parent) {
-			snd_config_for_each(i, next, config->parent) {
-				snd_config_t *n = snd_config_iterator_entry(i);
-				if (n != config && strcmp(id, n->id) == 0)
-					return -EEXIST;
-			}
+			snd_config_t *n;
+			if (_snd_config_search(config->parent, id, -1, &n) == 0 &&
+			    n != config)
+				return -EEXIST;
 		}
-		new_id = strdup(id);
-		if (!new_id)
-			return -ENOMEM;
 	} else {
 		if (config->parent)
 			return -EINVAL;
-		new_id = NULL;
 	}
-	free(config->id);
-	config->id = new_id;
-	return 0;
+	if (config->parent)
+		config_index_del(config->parent, config);
+	err = config_set_str(config, &config->id, id, CONFIG_ARENA_ID);
+	if (config->parent)
+		config_index_add(config->parent, config);
+	return err;
 }
 
 /**
@@ -1949,8 +2803,30 @@ int snd_config_top(snd_config_t **config)
 }
 
 #ifndef DOC_HIDDEN
-int _snd_config_load_with_include(snd_config_t *config, snd_input_t *in,
-				  int override, const char * const *include_paths)
+/* translate the parser errors, returns the message */
+static const char *parse_error(int *err)
+{
+	switch (*err) {
+	case LOCAL_UNTERMINATED_STRING:
+		*err = -EINVAL;
+		return "Unterminated string";
+	case LOCAL_UNTERMINATED_QUOTE:
+		*err = -EINVAL;
+		return "Unterminated quote";
+	case LOCAL_UNEXPECTED_CHAR:
+		*err = -EINVAL;
+		return "Unexpected char";
+	case LOCAL_UNEXPECTED_EOF:
+		*err = -EINVAL;
+		return "Unexpected end of file";
+	default:
+		return strerror(-*err);
+	}
+}
+
+static int config_load_input(snd_config_t *config, snd_input_t *in,
+			     int override, const char * const *include_paths,
+			     struct config_cache_rec *rec)
 {
 	int err;
 	input_t input;
@@ -1961,9 +2837,7 @@ int _snd_config_load_with_include(snd_config_t *config, snd_input_t *in,
 	if (!fd)
 		return -ENOMEM;
 	fd->name = NULL;
-	fd->in = in;
-	fd->line = 1;
-	fd->column = 0;
+	filedesc_init(fd, in);
 	fd->next = NULL;
 	INIT_LIST_HEAD(&fd->include_paths);
 	if (include_paths) {
@@ -1979,31 +2853,12 @@ int _snd_config_load_with_include(snd_config_t *config, snd_input_t *in,
 	}
 	input.current = fd;
 	input.unget = 0;
+	input.rec = rec;
+	input.play = NULL;
 	err = parse_defs(config, &input, 0, override);
 	fd = input.current;
 	if (err < 0) {
-		const char *str;
-		switch (err) {
-		case LOCAL_UNTERMINATED_STRING:
-			str = "Unterminated string";
-			err = -EINVAL;
-			break;
-		case LOCAL_UNTERMINATED_QUOTE:
-			str = "Unterminated quote";
-			err = -EINVAL;
-			break;
-		case LOCAL_UNEXPECTED_CHAR:
-			str = "Unexpected char";
-			err = -EINVAL;
-			break;
-		case LOCAL_UNEXPECTED_EOF:
-			str = "Unexpected end of file";
-			err = -EINVAL;
-			break;
-		default:
-			str = strerror(-err);
-			break;
-		}
+		const char *str = parse_error(&err);
 		SNDERR("%s:%d:%d:%s", fd->name ? fd->name : "_toplevel_", fd->line, fd->column, str);
 		goto _end;
 	}
@@ -2025,129 +2880,515 @@ int _snd_config_load_with_include(snd_config_t *config, snd_input_t *in,
 		fd = fd_next;
 	}
 
+	/* the caller owns the input, leave it where the parser stopped */
+	if (fd->buf)
+		snd_input_buffer_skip(fd->in, fd->ptr - fd->buf);
 	free_include_paths(fd);
 	free(fd);
 	return err;
 }
-#endif
 
-/**
- * \brief Loads a configuration tree.
- * \param config Handle to a top level configuration node.
- * \param in Input handle to read the configuration from.
- * \return Zero if successful, otherwise a negative error code.
- *
- * The definitions loaded from the input are added to \a config, which
- * must be a compound node.
- *
- * \par Errors:
- * Any errors encountered when parsing the input or returned by hooks or
- * functions.
- *
- * \par Conforming to:
- * LSB 3.2
- */
-int snd_config_load(snd_config_t *config, snd_input_t *in)
+int _snd_config_load_with_include(snd_config_t *config, snd_input_t *in,
+				  int override, const char * const *include_paths)
 {
-	return _snd_config_load_with_include(config, in, 0, NULL);
+	return config_load_input(config, in, override, include_paths, NULL);
 }
 
-/**
- * \brief Loads a configuration tree from a string.
- * \param[out] The function puts the handle to the configuration
- *	       node loaded from the file(s) at the address specified
- *             by \a config.
- * \param[in] s String with the ASCII configuration
- * \param[in] size String size, if zero, a C string is expected (with termination)
- * \return Zero if successful, otherwise a negative error code.
- *
- * The definitions loaded from the string are put to \a config, which
- * is created as a new top node.
- *
- * \par Errors:
- * Any errors encountered when parsing the input or returned by hooks or
- * functions.
- */
-int snd_config_load_string(snd_config_t **config, const char *s, size_t size)
+static uint64_t config_cache_hash(const char *key, size_t size)
 {
-	snd_input_t *input;
-	snd_config_t *dst;
-	int err;
+	uint64_t h = 0xcbf29ce484222325ULL;
 
-	assert(config && s);
-	if (size == 0)
-		size = strlen(s);
-	err = snd_input_buffer_open(&input, s, size);
-	if (err < 0)
-		return err;
-	err = snd_config_top(&dst);
-	if (err < 0) {
-		snd_input_close(input);
-		return err;
-	}
-	err = snd_config_load(dst, input);
-	snd_input_close(input);
-	if (err < 0) {
-		snd_config_delete(dst);
-		return err;
+	while (size--) {
+		h ^= (unsigned char)*key++;
+		h *= 0x100000001b3ULL;
 	}
-	*config = dst;
-	return 0;
+	return h;
 }
 
-/**
- * \brief Loads a configuration tree and overrides existing configuration nodes.
- * \param config Handle to a top level configuration node.
- * \param in Input handle to read the configuration from.
- * \return Zero if successful, otherwise a negative error code.
- *
- * This function loads definitions from \a in into \a config like
- * #snd_config_load, but the default mode for input nodes is 'override'
- * (!) instead of 'merge+create' (+).
- */
-int snd_config_load_override(snd_config_t *config, snd_input_t *in)
+/* check the recorded files against their current state */
+static int config_cache_files_valid(const char *ptr, const char *end,
+				    unsigned int count)
 {
-	return _snd_config_load_with_include(config, in, 1, NULL);
-}
+	unsigned int k;
 
-/**
- * \brief Adds a child to a compound configuration node.
- * \param parent Handle to a compound configuration node.
- * \param child Handle to the configuration node to be added.
- * \return Zero if successful, otherwise a negative error code.
- *
- * This function makes the node \a child a child of the node \a parent.
- *
- * The parent node then owns the child node, i.e., the child node gets
- * deleted together with its parent.
- *
- * \a child must have an id.
- *
- * \par Errors:
- * <dl>
- * <dt>-EINVAL<dd>\a child does not have an id.
- * <dt>-EINVAL<dd>\a child already has a parent.
- * <dt>-EEXIST<dd>\a parent already contains a child node with the same
- *                id as \a child.
- * </dl>
- *
- * \par Conforming to:
- * LSB 3.2
- */
-int snd_config_add(snd_config_t *parent, snd_config_t *child)
-{
-	snd_config_iterator_t i, next;
-	assert(parent && child);
-	if (!child->id || child->parent)
-		return -EINVAL;
-	snd_config_for_each(i, next, parent) {
-		snd_config_t *n = snd_config_iterator_entry(i);
-		if (strcmp(child->id, n->id) == 0)
-			return -EEXIST;
+	for (k = 0; k < count; k++) {
+		struct config_cache_file f, cur;
+		if ((size_t)(end - ptr) < sizeof(f))
+			return 0;
+		memcpy(&f, ptr, sizeof(f));
+		ptr += sizeof(f);
+		if ((size_t)(end - ptr) < f.name_size || !f.name_size ||
+		    ptr[f.name_size - 1])
+			return 0;
+		config_cache_stat(&cur, ptr);
+		if (cur.absent != f.absent || cur.dev != f.dev ||
+		    cur.ino != f.ino || cur.size != f.size ||
+		    cur.mtime != f.mtime)
+			return 0;
+		ptr += f.name_size;
 	}
-	child->parent = parent;
-	list_add_tail(&child->list, &parent->u.compound.fields);
-	return 0;
+	return ptr == end;
+}
+
+/*
+ * While snd_config_update_r() loads a tree, the files read for it are
+ * collected here, so that later calls detect a change of any of them.
+ */
+#ifdef HAVE___THREAD
+static __thread struct config_cache_rec *config_update_deps;
+#endif
+
+static void config_update_deps_add(const char *files, size_t size)
+{
+#ifdef HAVE___THREAD
+	struct config_cache_rec *deps = config_update_deps;
+
+	const char *end = files + size;
+
+	if (!deps)
+		return;
+	/* the same files are met by many loads, keep one record of each */
+	while (files < end && deps->err >= 0) {
+		const char *ptr = deps->files.data;
+		const char *dend = ptr + deps->files.size;
+		struct config_cache_file f;
+		size_t len;
+		memcpy(&f, files, sizeof(f));
+		len = sizeof(f) + f.name_size;
+		while (ptr < dend) {
+			struct config_cache_file d;
+			memcpy(&d, ptr, sizeof(d));
+			if (sizeof(d) + d.name_size == len &&
+			    memcmp(ptr, files, len) == 0)
+				break;
+			ptr += sizeof(d) + d.name_size;
+		}
+		if (ptr == dend) {
+			deps->err = config_cache_buf_add(&deps->files, files, len);
+			deps->count++;
+		}
+		files += len;
+	}
+#endif
+}
+
+/* check the cache against the key and the state of the files */
+static int config_cache_valid(const char *map, size_t size,
+			      const char *key, size_t key_size,
+			      struct config_cache_play *play)
+{
+	const struct config_cache_header *hdr = (const void *)map;
+	const char *ptr, *end;
+
+	if (size < sizeof(*hdr) ||
+	    hdr->magic != CONFIG_CACHE_MAGIC ||
+	    hdr->version != CONFIG_CACHE_VERSION ||
+	    hdr->key_size != key_size ||
+	    size != sizeof(*hdr) + hdr->key_size + hdr->files_size + hdr->tokens_size)
+		return 0;
+	ptr = map + sizeof(*hdr);
+	if (memcmp(ptr, key, key_size) != 0)
+		return 0;
+	ptr += key_size;
+	end = ptr + hdr->files_size;
+	if (!config_cache_files_valid(ptr, end, hdr->files))
+		return 0;
+	/* walk the tokens once, so the replay stays in bounds */
+	play->ptr = end;
+	play->end = end + hdr->tokens_size;
+	for (ptr = play->ptr; ptr < play->end; ) {
+		uint32_t len;
+		int type = *(const unsigned char *)ptr++;
+		if (type == CONFIG_TOKEN_CHAR) {
+			len = sizeof(int32_t);
+		} else if (type == CONFIG_TOKEN_STRING ||
+			   type == CONFIG_TOKEN_QSTRING) {
+			if ((size_t)(play->end - ptr) < sizeof(len))
+				return 0;
+			memcpy(&len, ptr, sizeof(len));
+			ptr += sizeof(len);
+		} else {
+			return 0;
+		}
+		if ((size_t)(play->end - ptr) < len)
+			return 0;
+		ptr += len;
+	}
+	return 1;
+}
+
+/* the files of a valid cache are dependencies of the tree being loaded */
+static void config_cache_deps_add(const char *data)
+{
+	const struct config_cache_header *hdr = (const void *)data;
+
+	config_update_deps_add(data + sizeof(*hdr) + hdr->key_size,
+			       hdr->files_size);
+}
+
+/* the cache contents: header, key, files and tokens */
+static char *config_cache_pack(const char *key, size_t key_size,
+			       struct config_cache_rec *rec, size_t *sizep)
+{
+	struct config_cache_header hdr;
+	size_t size;
+	char *data, *ptr;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = CONFIG_CACHE_MAGIC;
+	hdr.version = CONFIG_CACHE_VERSION;
+	hdr.key_size = key_size;
+	hdr.files = rec->count;
+	hdr.files_size = rec->files.size;
+	hdr.tokens_size = rec->tokens.size;
+	size = sizeof(hdr) + key_size + rec->files.size + rec->tokens.size;
+	data = malloc(size);
+	if (!data)
+		return NULL;
+	ptr = data;
+	memcpy(ptr, &hdr, sizeof(hdr));
+	ptr += sizeof(hdr);
+	memcpy(ptr, key, key_size);
+	ptr += key_size;
+	memcpy(ptr, rec->files.data, rec->files.size);
+	ptr += rec->files.size;
+	memcpy(ptr, rec->tokens.data, rec->tokens.size);
+	*sizep = size;
+	return data;
+}
+
+/*
+ * The tokens of a cache may load hooks and functions, so a cache is
+ * used only from a directory and a file that only the process user
+ * can change.
+ */
+static int config_cache_trusted(const struct stat64 *st)
+{
+	return st->st_uid == geteuid() && !(st->st_mode & (S_IWGRP | S_IWOTH));
+}
+
+static int config_cache_dir_trusted(const char *dir)
+{
+	struct stat64 st;
+
+	return stat64(dir, &st) == 0 && S_ISDIR(st.st_mode) &&
+	       config_cache_trusted(&st);
+}
+
+static void config_cache_write(const char *path, const char *data, size_t size)
+{
+	char tmp[PATH_MAX];
+	int fd;
+
+	if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= (int)sizeof(tmp))
+		return;
+	fd = mkstemp(tmp);
+	if (fd < 0)
+		return;
+	if (write(fd, data, size) != (ssize_t)size || fchmod(fd, 0600) < 0) {
+		close(fd);
+		unlink(tmp);
+		return;
+	}
+	close(fd);
+	/* readers see either the old or the new cache */
+	if (rename(tmp, path) < 0)
+		unlink(tmp);
+}
+
+static int config_cache_replay(snd_config_t *config, const char *filename,
+			       struct config_cache_play *play)
+{
+	input_t input;
+	int err;
+
+	memset(&input, 0, sizeof(input));
+	input.play = play;
+	err = parse_defs(config, &input, 0, 0);
+	if (err < 0) {
+		const char *str = parse_error(&err);
+		SNDERR("%s:%s", filename, str);
+	}
+	return err;
+}
+
+/*
+ * The caches of the files loaded by this process are also kept in
+ * memory, most recently used first, so that a reload after a change
+ * parses only the changed files.
+ */
+#define CONFIG_MEM_CACHE_MAX	64
+
+struct config_mem_cache {
+	struct list_head list;
+	size_t size;
+	char data[];
+};
+
+static struct list_head config_mem_caches = { &config_mem_caches, &config_mem_caches };
+static unsigned int config_mem_cache_count;
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t config_mem_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define config_mem_cache_lock()		pthread_mutex_lock(&config_mem_cache_mutex)
+#define config_mem_cache_unlock()	pthread_mutex_unlock(&config_mem_cache_mutex)
+#else
+#define config_mem_cache_lock()		do { } while (0)
+#define config_mem_cache_unlock()	do { } while (0)
+#endif
+
+/* replay the memory cache of key, returns 1 if there was a valid one */
+static int config_mem_cache_replay(snd_config_t *config, const char *filename,
+				   const char *key, size_t key_size, int *errp)
+{
+	struct config_cache_play play;
+	struct list_head *pos;
+	int found = 0;
+
+	config_mem_cache_lock();
+	list_for_each(pos, &config_mem_caches) {
+		struct config_mem_cache *c = list_entry(pos, struct config_mem_cache, list);
+		const struct config_cache_header *hdr = (const void *)c->data;
+		if (hdr->key_size != key_size ||
+		    memcmp(c->data + sizeof(*hdr), key, key_size) != 0)
+			continue;
+		list_del(&c->list);
+		if (!config_cache_valid(c->data, c->size, key, key_size, &play)) {
+			free(c);
+			config_mem_cache_count--;
+			break;
+		}
+		*errp = config_cache_replay(config, filename, &play);
+		config_cache_deps_add(c->data);
+		list_add(&c->list, &config_mem_caches);
+		found = 1;
+		break;
+	}
+	config_mem_cache_unlock();
+	return found;
+}
+
+static void config_mem_cache_add(const char *data, size_t size)
+{
+	struct config_mem_cache *c;
+
+	c = malloc(sizeof(*c) + size);
+	if (!c)
+		return;
+	c->size = size;
+	memcpy(c->data, data, size);
+	config_mem_cache_lock();
+	list_add(&c->list, &config_mem_caches);
+	if (++config_mem_cache_count > CONFIG_MEM_CACHE_MAX) {
+		struct config_mem_cache *last;
+		last = list_entry(config_mem_caches.prev, struct config_mem_cache, list);
+		list_del(&last->list);
+		free(last);
+		config_mem_cache_count--;
+	}
+	config_mem_cache_unlock();
+}
+
+/*
+ * Load a configuration file like snd_config_load(), through the parsed
+ * file cache: the copy in memory, or the one in the directory
+ * ALSA_CONFIG_CACHE when set.  A valid cache is replayed without
+ * reading in, otherwise in is parsed and the caches are rewritten.
+ */
+static int config_load_cached(snd_config_t *config, const char *filename,
+			      snd_input_t *in)
+{
+	struct config_cache_rec rec;
+	struct config_cache_play play;
+	struct stat64 st;
+	const char *dir, *topdir;
+	char path[PATH_MAX], *key, *data;
+	size_t key_size, size;
+	void *map;
+	int fd, err, valid = 0;
+
+	if (*filename != '/')
+		return snd_config_load(config, in);
+	/* included files are looked up relative to the top directory */
+	topdir = snd_config_topdir();
+	key_size = strlen(filename) + strlen(topdir) + 2;
+	key = alloca(key_size);
+	strcpy(key, filename);
+	strcpy(key + strlen(filename) + 1, topdir);
+	if (config_mem_cache_replay(config, filename, key, key_size, &err))
+		return err;
+
+	dir = getenv("ALSA_CONFIG_CACHE");
+	if (dir && (*dir != '/' || getuid() != geteuid()))
+		dir = NULL;
+	if (dir) {
+		snprintf(path, sizeof(path), "%s/%016llx.cache", dir,
+			 (unsigned long long)config_cache_hash(key, key_size));
+		fd = open(path, O_RDONLY | O_CLOEXEC);
+	} else {
+		fd = -1;
+	}
+	if (fd >= 0) {
+		if (fstat64(fd, &st) == 0 && S_ISREG(st.st_mode) &&
+		    st.st_size > 0 && config_cache_trusted(&st) &&
+		    config_cache_dir_trusted(dir)) {
+			map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (map != MAP_FAILED) {
+				valid = config_cache_valid(map, st.st_size, key,
+							   key_size, &play);
+				if (valid) {
+					err = config_cache_replay(config, filename, &play);
+					config_cache_deps_add(map);
+					if (err >= 0)
+						config_mem_cache_add(map, st.st_size);
+				}
+				munmap(map, st.st_size);
+			}
+		}
+		close(fd);
+		if (valid)
+			return err;
+	}
+
+	memset(&rec, 0, sizeof(rec));
+	{
+		input_t input = { .rec = &rec };
+		config_cache_rec_file(&input, filename);
+	}
+	err = config_load_input(config, in, 0, NULL, &rec);
+	if (rec.err >= 0)
+		config_update_deps_add(rec.files.data, rec.files.size);
+	if (err >= 0 && rec.err >= 0) {
+		data = config_cache_pack(key, key_size, &rec, &size);
+		if (data) {
+			config_mem_cache_add(data, size);
+			if (dir) {
+				mkdir(dir, 0700);
+				if (config_cache_dir_trusted(dir))
+					config_cache_write(path, data, size);
+			}
+			free(data);
+		}
+	}
+	free(rec.files.data);
+	free(rec.tokens.data);
+	return err;
+}
+#endif
+
+/**
+ * \brief Loads a configuration tree.
+ * \param config Handle to a top level configuration node.
+ * \param in Input handle to read the configuration from.
+ * \return Zero if successful, otherwise a negative error code.
+ *
+ * The definitions loaded from the input are added to \a config, which
+ * must be a compound node.
+ *
+ * \par Errors:
+ * Any errors encountered when parsing the input or returned by hooks or
+ * functions.
+ *
+ * \par Conforming to:
+ * LSB 3.2
+ */
+int snd_config_load(snd_config_t *config, snd_input_t *in)
+{
+	return _snd_config_load_with_include(config, in, 0, NULL);
+}
+
+/**
+ * \brief Loads a configuration tree from a string.
+ * \param[out] The function puts the handle to the configuration
+ *	       node loaded from the file(s) at the address specified
+ *             by \a config.
+ * \param[in] s String with the ASCII configuration
+ * \param[in] size String size, if zero, a C string is expected (with termination)
+ * \return Zero if successful, otherwise a negative error code.
+ *
+ * The definitions loaded from the string are put to \a config, which
+ * is created as a new top node.
+ *
+ * \par Errors:
+ * Any errors encountered when parsing the input or returned by hooks or
+ * functions.
+ */
+int snd_config_load_string(snd_config_t **config, const char *s, size_t size)
+{
+	snd_input_t *input;
+	snd_config_t *dst;
+	int err;
+
+	assert(config && s);
+	if (size == 0)
+		size = strlen(s);
+	err = snd_input_buffer_open(&input, s, size);
+	if (err < 0)
+		return err;
+	err = snd_config_top(&dst);
+	if (err < 0) {
+		snd_input_close(input);
+		return err;
+	}
+	err = snd_config_load(dst, input);
+	snd_input_close(input);
+	if (err < 0) {
+		snd_config_delete(dst);
+		return err;
+	}
+	*config = dst;
+	return 0;
+}
+
+/**
+ * \brief Loads a configuration tree and overrides existing configuration nodes.
+ * \param config Handle to a top level configuration node.
+ * \param in Input handle to read the configuration from.
+ * \return Zero if successful, otherwise a negative error code.
+ *
+ * This function loads definitions from \a in into \a config like
+ * #snd_config_load, but the default mode for input nodes is 'override'
+ * (!) instead of 'merge+create' (+).
+ */
+int snd_config_load_override(snd_config_t *config, snd_input_t *in)
+{
+	return _snd_config_load_with_include(config, in, 1, NULL);
+}
+
+/**
+ * \brief Adds a child to a compound configuration node.
+ * \param parent Handle to a compound configuration node.
+ * \param child Handle to the configuration node to be added.
+ * \return Zero if successful, otherwise a negative error code.
+ *
+ * This function makes the node \a child a child of the node \a parent.
+ *
+ * The parent node then owns the child node, i.e., the child node gets
+ * deleted together with its parent.
+ *
+ * \a child must have an id.
+ *
+ * \par Errors:
+ * <dl>
+ * <dt>-EINVAL<dd>\a child does not have an id.
+ * <dt>-EINVAL<dd>\a child already has a parent.
+ * <dt>-EEXIST<dd>\a parent already contains a child node with the same
+ *                id as \a child.
+ * </dl>
+ *
+ * \par Conforming to:
+ * LSB 3.2
+ */
+int snd_config_add(snd_config_t *parent, snd_config_t *child)
+{
+	assert(parent && child);
+	if (!child->id || child->parent)
+		return -EINVAL;
+	if (_snd_config_search(parent, child->id, -1, NULL) == 0)
+		return -EEXIST;
+	child->parent = parent;
+	list_add_tail(&child->list, &parent->u.compound.fields);
+	config_index_add(parent, child);
+	return 0;
 }
 
 /**
@@ -2174,20 +3415,17 @@ int snd_config_add(snd_config_t *parent, snd_config_t *child)
  */
 int snd_config_add_after(snd_config_t *after, snd_config_t *child)
 {
-	snd_config_iterator_t i, next;
 	snd_config_t *parent;
 	assert(after && child);
 	parent = after->parent;
 	assert(parent);
 	if (!child->id || child->parent)
 		return -EINVAL;
-	snd_config_for_each(i, next, parent) {
-		snd_config_t *n = snd_config_iterator_entry(i);
-		if (strcmp(child->id, n->id) == 0)
-			return -EEXIST;
-	}
+	if (_snd_config_search(parent, child->id, -1, NULL) == 0)
+		return -EEXIST;
 	child->parent = parent;
 	list_insert(&child->list, &after->list, after->list.next);
+	config_index_add(parent, child);
 	return 0;
 }
 
@@ -2215,20 +3453,17 @@ int snd_config_add_after(snd_config_t *after, snd_config_t *child)
  */
 int snd_config_add_before(snd_config_t *before, snd_config_t *child)
 {
-	snd_config_iterator_t i, next;
 	snd_config_t *parent;
 	assert(before && child);
 	parent = before->parent;
 	assert(parent);
 	if (!child->id || child->parent)
 		return -EINVAL;
-	snd_config_for_each(i, next, parent) {
-		snd_config_t *n = snd_config_iterator_entry(i);
-		if (strcmp(child->id, n->id) == 0)
-			return -EEXIST;
-	}
+	if (_snd_config_search(parent, child->id, -1, NULL) == 0)
+		return -EEXIST;
 	child->parent = parent;
 	list_insert(&child->list, before->list.prev, &before->list);
+	config_index_add(parent, child);
 	return 0;
 }
 
@@ -2252,6 +3487,7 @@ static int _snd_config_array_merge(snd_config_t *dst, snd_config_t *src, int ind
 		}
 		sn->parent = dst;
 		list_add_tail(&sn->list, &dst->u.compound.fields);
+		config_index_add(dst, sn);
 	}
 	snd_config_delete(src);
 	return 0;
@@ -2284,8 +3520,7 @@ static int _snd_config_array_merge(snd_config_t *dst, snd_config_t *src, int ind
  */
 int snd_config_merge(snd_config_t *dst, snd_config_t *src, int override)
 {
-	snd_config_iterator_t di, si, dnext, snext;
-	bool found;
+	snd_config_iterator_t si, snext;
 	int err, array;
 
 	assert(dst);
@@ -2298,31 +3533,26 @@ int snd_config_merge(snd_config_t *dst, snd_config_t *src, int override)
 		return _snd_config_array_merge(dst, src, array);
 	snd_config_for_each(si, snext, src) {
 		snd_config_t *sn = snd_config_iterator_entry(si);
-		found = false;
-		snd_config_for_each(di, dnext, dst) {
-			snd_config_t *dn = snd_config_iterator_entry(di);
-			if (strcmp(sn->id, dn->id) == 0) {
-				if (override ||
-				    sn->type != SND_CONFIG_TYPE_COMPOUND ||
-				    dn->type != SND_CONFIG_TYPE_COMPOUND) {
-					snd_config_remove(sn);
-					err = snd_config_substitute(dn, sn);
-					if (err < 0)
-						return err;
-				} else {
-					err = snd_config_merge(dn, sn, 0);
-					if (err < 0)
-						return err;
-				}
-				found = true;
-				break;
+		snd_config_t *dn;
+		if (_snd_config_search(dst, sn->id, -1, &dn) == 0) {
+			if (override ||
+			    sn->type != SND_CONFIG_TYPE_COMPOUND ||
+			    dn->type != SND_CONFIG_TYPE_COMPOUND) {
+				snd_config_remove(sn);
+				err = snd_config_substitute(dn, sn);
+				if (err < 0)
+					return err;
+			} else {
+				err = snd_config_merge(dn, sn, 0);
+				if (err < 0)
+					return err;
 			}
-		}
-		if (!found) {
+		} else {
 			/* move config from src to dst */
 			snd_config_remove(sn);
 			sn->parent = dst;
 			list_add_tail(&sn->list, &dst->u.compound.fields);
+			config_index_add(dst, sn);
 		}
 	}
 	snd_config_delete(src);
@@ -2345,8 +3575,10 @@ int snd_config_merge(snd_config_t *dst, snd_config_t *src, int override)
 int snd_config_remove(snd_config_t *config)
 {
 	assert(config);
-	if (config->parent)
+	if (config->parent) {
+		config_index_del(config->parent, config);
 		list_del(&config->list);
+	}
 	config->parent = NULL;
 	return 0;
 }
@@ -2375,16 +3607,22 @@ int snd_config_remove(snd_config_t *config)
  */
 int snd_config_delete(snd_config_t *config)
 {
+	int ref;
+
 	assert(config);
-	if (config->refcount > 0) {
-		config->refcount--;
-		return 0;
+	/* shared definitions are released without the config lock */
+	ref = __atomic_load_n(&config->refcount, __ATOMIC_RELAXED);
+	while (ref > 0) {
+		if (__atomic_compare_exchange_n(&config->refcount, &ref, ref - 1,
+						0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			return 0;
 	}
 	switch (config->type) {
 	case SND_CONFIG_TYPE_COMPOUND:
 	{
 		int err;
 		struct list_head *i;
+		config_index_free(config);
 		i = config->u.compound.fields.next;
 		while (i != &config->u.compound.fields) {
 			struct list_head *nexti = i->next;
@@ -2397,15 +3635,19 @@ int snd_config_delete(snd_config_t *config)
 		break;
 	}
 	case SND_CONFIG_TYPE_STRING:
-		free(config->u.string);
+		if (!(config->arena_mem & CONFIG_ARENA_STR))
+			free(config->u.string);
 		break;
 	default:
 		break;
 	}
-	if (config->parent)
+	if (config->parent) {
+		config_index_del(config->parent, config);
 		list_del(&config->list);
-	free(config->id);
-	free(config);
+	}
+	if (!(config->arena_mem & CONFIG_ARENA_ID))
+		free(config->id);
+	config_node_free(config);
 	return 0;
 }
 
@@ -2435,6 +3677,7 @@ int snd_config_delete_compound_members(const snd_config_t *config)
 	assert(config);
 	if (config->type != SND_CONFIG_TYPE_COMPOUND)
 		return -EINVAL;
+	config_index_free((snd_config_t *)config);
 	i = config->u.compound.fields.next;
 	while (i != &config->u.compound.fields) {
 		struct list_head *nexti = i->next;
@@ -2469,15 +3712,21 @@ int snd_config_delete_compound_members(const snd_config_t *config)
 int snd_config_make(snd_config_t **config, const char *id,
 		    snd_config_type_t type)
 {
-	char *id1;
-	assert(config);
+	snd_config_t *n;
+	int err;
+	assert(config);
+	err = _snd_config_make(&n, NULL, type);
+	if (err < 0)
+		return err;
 	if (id) {
-		id1 = strdup(id);
-		if (!id1)
-			return -ENOMEM;
-	} else
-		id1 = NULL;
-	return _snd_config_make(config, &id1, type);
+		err = config_set_str(n, &n->id, id, CONFIG_ARENA_ID);
+		if (err < 0) {
+			config_node_free(n);
+			return err;
+		}
+	}
+	*config = n;
+	return 0;
 }
 
 /**
@@ -2859,14 +4108,10 @@ int snd_config_imake_string(snd_config_t **config, const char *id, const char *v
 	err = snd_config_make(&tmp, id, SND_CONFIG_TYPE_STRING);
 	if (err < 0)
 		return err;
-	if (value) {
-		tmp->u.string = strdup(value);
-		if (!tmp->u.string) {
-			snd_config_delete(tmp);
-			return -ENOMEM;
-		}
-	} else {
-		tmp->u.string = NULL;
+	err = config_set_str(tmp, &tmp->u.string, value, CONFIG_ARENA_STR);
+	if (err < 0) {
+		snd_config_delete(tmp);
+		return err;
 	}
 	*config = tmp;
 	return 0;
@@ -2882,10 +4127,10 @@ int snd_config_imake_safe_string(snd_config_t **config, const char *id, const ch
 	if (err < 0)
 		return err;
 	if (value) {
-		tmp->u.string = strdup(value);
-		if (!tmp->u.string) {
+		err = config_set_str(tmp, &tmp->u.string, value, CONFIG_ARENA_STR);
+		if (err < 0) {
 			snd_config_delete(tmp);
-			return -ENOMEM;
+			return err;
 		}
 
 		for (c = tmp->u.string; *c; c++) {
@@ -2896,8 +4141,6 @@ int snd_config_imake_safe_string(snd_config_t **config, const char *id, const ch
 					continue;
 			*c = '_';
 		}
-	} else {
-		tmp->u.string = NULL;
 	}
 	*config = tmp;
 	return 0;
@@ -3016,20 +4259,10 @@ int snd_config_set_real(snd_config_t *config, double value)
  */
 int snd_config_set_string(snd_config_t *config, const char *value)
 {
-	char *new_string;
 	assert(config);
 	if (config->type != SND_CONFIG_TYPE_STRING)
 		return -EINVAL;
-	if (value) {
-		new_string = strdup(value);
-		if (!new_string)
-			return -ENOMEM;
-	} else {
-		new_string = NULL;
-	}
-	free(config->u.string);
-	config->u.string = new_string;
-	return 0;
+	return config_set_str(config, &config->u.string, value, CONFIG_ARENA_STR);
 }
 
 /**
@@ -3111,14 +4344,8 @@ int snd_config_set_ascii(snd_config_t *config, const char *ascii)
 			break;
 		}
 	case SND_CONFIG_TYPE_STRING:
-		{
-			char *ptr = strdup(ascii);
-			if (ptr == NULL)
-				return -ENOMEM;
-			free(config->u.string);
-			config->u.string = ptr;
-		}
-		break;
+		return config_set_str(config, &config->u.string, ascii,
+				      CONFIG_ARENA_STR);
 	default:
 		return -EINVAL;
 	}
@@ -3380,6 +4607,30 @@ int snd_config_test_id(const snd_config_t *config, const char *id)
 		return -1;
 }
 
+#ifndef DOC_HIDDEN
+static int config_save(snd_config_t *config, snd_output_t *out, int compact)
+{
+	save_buf_t sb;
+	int err;
+
+	assert(config && out);
+	sb.out = out;
+	sb.compact = compact;
+	sb.len = 0;
+	sb.sep = 0;
+	if (config->type == SND_CONFIG_TYPE_COMPOUND) {
+		int array = snd_config_is_array(config);
+		err = save_children(config, &sb, 0, 0, array);
+		if (compact && sb.sep)
+			save_putc(&sb, '\n');
+	} else {
+		err = save_node_value(config, &sb, 0);
+	}
+	save_flush(&sb);
+	return err;
+}
+#endif
+
 /**
  * \brief Dumps the contents of a configuration node or tree.
  * \param config Handle to the (root) configuration node.
@@ -3400,13 +4651,29 @@ int snd_config_test_id(const snd_config_t *config, const char *id)
  */
 int snd_config_save(snd_config_t *config, snd_output_t *out)
 {
-	assert(config && out);
-	if (config->type == SND_CONFIG_TYPE_COMPOUND) {
-		int array = snd_config_is_array(config);
-		return _snd_config_save_children(config, out, 0, 0, array);
-	} else {
-		return _snd_config_save_node_value(config, out, 0);
-	}
+	return config_save(config, out, 0);
+}
+
+/**
+ * \brief Dumps a configuration node or tree in the compact form.
+ * \param config Handle to the (root) configuration node.
+ * \param out Output handle.
+ * \return Zero if successful, otherwise a negative error code.
+ *
+ * The output is read back by #snd_config_load like the output of
+ * #snd_config_save, but it has no indentation and no line breaks between
+ * the entries, so it is smaller and faster to write and to parse.  It is
+ * meant for the files written and read by programs.
+ *
+ * \par Errors:
+ * <dl>
+ * <dt>-EINVAL<dd>A node in the tree has a type that cannot be printed,
+ *                i.e., #SND_CONFIG_TYPE_POINTER.
+ * </dl>
+ */
+int snd_config_save_compact(snd_config_t *config, snd_output_t *out)
+{
+	return config_save(config, out, 1);
 }
 
 /*
@@ -3928,10 +5195,13 @@ struct finfo {
 struct _snd_config_update {
 	unsigned int count;
 	struct finfo *finfo;
+	struct config_cache_rec deps;	/* all files read for the tree */
 };
 #endif /* DOC_HIDDEN */
 
 static snd_config_update_t *snd_config_global_update = NULL;
+/* bumped whenever snd_config is replaced */
+static unsigned int snd_config_global_generation;
 
 static int snd_config_hooks_call(snd_config_t *root, snd_config_t *config, snd_config_t *private_data)
 {
@@ -3941,6 +5211,7 @@ static int snd_config_hooks_call(snd_config_t *root, snd_config_t *config, snd_c
 	const char *lib = NULL, *func_name = NULL;
 	const char *str;
 	int (*func)(snd_config_t *root, snd_config_t *config, snd_config_t **dst, snd_config_t *private_data) = NULL;
+	unsigned long long trace = snd_trace_begin();
 	int err;
 
 	err = snd_config_search(config, "func", &c);
@@ -4020,6 +5291,7 @@ static int snd_config_hooks_call(snd_config_t *root, snd_config_t *config, snd_c
 		if (err >= 0 && nroot)
 			err = snd_config_substitute(root, nroot);
 	}
+	snd_trace_end(trace, "conf", "hook", func_name);
 	free(buf);
 	if (err < 0)
 		return err;
@@ -4034,7 +5306,15 @@ static int snd_config_hooks(snd_config_t *config, snd_config_t *private_data)
 
 	if ((err = snd_config_search(config, "@hooks", &n)) < 0)
 		return 0;
-	snd_config_lock();
+	if (config_tree_wrlock() < 0) {
+		config_tree_missed = 1;
+		return 0;
+	}
+	/* another thread may have run them meanwhile */
+	if ((err = snd_config_search(config, "@hooks", &n)) < 0) {
+		config_tree_unlock();
+		return 0;
+	}
 	snd_config_remove(n);
 	do {
 		hit = 0;
@@ -4060,7 +5340,7 @@ static int snd_config_hooks(snd_config_t *config, snd_config_t *private_data)
 	err = 0;
        _err:
 	snd_config_delete(n);
-	snd_config_unlock();
+	config_tree_unlock();
 	return err;
 }
 
@@ -4088,9 +5368,9 @@ static int config_file_open(snd_config_t *root, const char *filename)
 	snd_input_t *in;
 	int err;
 
-	err = snd_input_stdio_open(&in, filename, "r");
+	err = snd_input_mmap_open(&in, filename);
 	if (err >= 0) {
-		err = snd_config_load(root, in);
+		err = config_load_cached(root, filename, in);
 		snd_input_close(in);
 		if (err < 0)
 			SNDERR("%s may be old or corrupted: consider to remove or fix it", filename);
@@ -4221,77 +5501,127 @@ _fin:
 	return err;
 }
 
-/**
- * \brief Loads and parses the given configurations files.
- * \param[in] root Handle to the root configuration node.
- * \param[in] config Handle to the configuration node for this hook.
- * \param[out] dst The function puts the handle to the configuration
- *                 node loaded from the file(s) at the address specified
- *                 by \a dst.
- * \param[in] private_data Handle to the private data configuration node.
- * \return Zero if successful, otherwise a negative error code.
- *
- * See \ref confhooks for an example.
- */
-int snd_config_hook_load(snd_config_t *root, snd_config_t *config, snd_config_t **dst, snd_config_t *private_data)
+/* load the expanded files of a load hook, in the order of their ids */
+static int config_hook_load_files(snd_config_t *root, snd_config_t *files,
+				  int errors)
 {
-	snd_config_t *n;
 	snd_config_iterator_t i, next;
-	int err, idx = 0, errors = 1, hit;
+	int err, idx = 0, hit;
 
-	assert(root && dst);
-	if ((err = snd_config_search(config, "errors", &n)) >= 0) {
-		errors = snd_config_get_bool(n);
-		if (errors < 0) {
-			SNDERR("Invalid bool value in field errors");
-			return errors;
-		}
-	}
-	if ((err = snd_config_search(config, "files", &n)) < 0) {
-		SNDERR("Unable to find field files in the pre-load section");
-		return -EINVAL;
-	}
-	if ((err = snd_config_expand(n, root, NULL, private_data, &n)) < 0) {
-		SNDERR("Unable to expand filenames in the pre-load section");
-		return err;
-	}
-	if (snd_config_get_type(n) != SND_CONFIG_TYPE_COMPOUND) {
-		SNDERR("Invalid type for field filenames");
-		goto _err;
-	}
 	do {
 		hit = 0;
-		snd_config_for_each(i, next, n) {
+		snd_config_for_each(i, next, files) {
 			snd_config_t *n = snd_config_iterator_entry(i);
 			const char *id = n->id;
 			long i;
 			err = safe_strtol(id, &i);
 			if (err < 0) {
 				SNDERR("id of field %s is not and integer", id);
-				err = -EINVAL;
-				goto _err;
+				return -EINVAL;
 			}
 			if (i == idx) {
 				err = config_file_load_user_all(root, n, errors);
 				if (err < 0)
-					goto _err;
+					return err;
 				idx++;
 				hit = 1;
 			}
 		}
 	} while (hit);
-	*dst = NULL;
-	err = 0;
+	return 0;
+}
+
+/* load the files listed in the given field of a load hook */
+static int config_hook_load(snd_config_t *root, snd_config_t *config,
+			    const char *field, snd_config_t *private_data)
+{
+	snd_config_t *n;
+	int err, errors = 1;
+
+	if ((err = snd_config_search(config, "errors", &n)) >= 0) {
+		errors = snd_config_get_bool(n);
+		if (errors < 0) {
+			SNDERR("Invalid bool value in field errors");
+			return errors;
+		}
+	}
+	if ((err = snd_config_search(config, field, &n)) < 0) {
+		SNDERR("Unable to find field %s in the pre-load section", field);
+		return -EINVAL;
+	}
+	if ((err = snd_config_expand(n, root, NULL, private_data, &n)) < 0) {
+		SNDERR("Unable to expand filenames in the pre-load section");
+		return err;
+	}
+	if (snd_config_get_type(n) != SND_CONFIG_TYPE_COMPOUND) {
+		SNDERR("Invalid type for field filenames");
+		goto _err;
+	}
+	err = config_hook_load_files(root, n, errors);
        _err:
 	snd_config_delete(n);
 	return err;
 }
+
+/**
+ * \brief Loads and parses the given configurations files.
+ * \param[in] root Handle to the root configuration node.
+ * \param[in] config Handle to the configuration node for this hook.
+ * \param[out] dst The function puts the handle to the configuration
+ *                 node loaded from the file(s) at the address specified
+ *                 by \a dst.
+ * \param[in] private_data Handle to the private data configuration node.
+ * \return Zero if successful, otherwise a negative error code.
+ *
+ * See \ref confhooks for an example.
+ */
+int snd_config_hook_load(snd_config_t *root, snd_config_t *config, snd_config_t **dst, snd_config_t *private_data)
+{
+	int err;
+
+	assert(root && dst);
+	err = config_hook_load(root, config, "files", private_data);
+	if (err >= 0)
+		*dst = NULL;
+	return err;
+}
 #ifndef DOC_HIDDEN
 SND_DLSYM_BUILD_VERSION(snd_config_hook_load, SND_CONFIG_DLSYM_VERSION_HOOK);
 #endif
 
+/**
+ * \brief Loads and parses the configuration files of one sound card.
+ * \param[in] root Handle to the configuration node of the card.
+ * \param[in] config Handle to the configuration node for this hook.
+ * \param[out] dst The function puts the handle to the configuration
+ *                 node loaded from the file(s) at the address specified
+ *                 by \a dst.
+ * \param[in] private_data Handle to the private data configuration node.
+ * \return Zero if successful, otherwise a negative error code.
+ *
+ * This function works like #snd_config_hook_load, but the files are
+ * loaded into the parent of \a root.  The lazy mode of
+ * #snd_config_hook_load_for_all_cards leaves it on the node of each
+ * card, with the files already expanded for that card.
+ */
+int snd_config_hook_load_card(snd_config_t *root, snd_config_t *config, snd_config_t **dst, snd_config_t *private_data ATTRIBUTE_UNUSED)
+{
+	int err;
+
+	assert(root && dst);
+	err = config_hook_load(root->parent ? root->parent : root, config,
+			       "files", NULL);
+	if (err >= 0)
+		*dst = NULL;
+	return err;
+}
+#ifndef DOC_HIDDEN
+SND_DLSYM_BUILD_VERSION(snd_config_hook_load_card, SND_CONFIG_DLSYM_VERSION_HOOK);
+#endif
+
 #ifndef DOC_HIDDEN
 int snd_determine_driver(int card, char **driver);
+int _snd_determine_driver_hw(int card, char **driver);
 #endif
 
 snd_config_t *_snd_config_hook_private_data(int card, const char *driver)
@@ -4363,6 +5693,236 @@ static int _snd_config_hook_table(snd_config_t *root, snd_config_t *config, snd_
 	return 0;
 }
 
+/* the configuration name for a card driver, 0 if the card is skipped */
+static int card_config_driver(snd_config_t *root, const char *fdriver,
+			      const char **driver)
+{
+	snd_config_t *n;
+
+	if (snd_config_search(root, fdriver, &n) < 0) {
+		*driver = fdriver;
+		return 1;
+	}
+	if (snd_config_get_string(n, driver) < 0) {
+		if (snd_config_get_type(n) == SND_CONFIG_TYPE_COMPOUND) {
+			snd_config_get_id(n, driver);
+			return 1;
+		}
+		return 0;
+	}
+	while (1) {
+		char *s = strchr(*driver, '.');
+		if (s == NULL)
+			break;
+		*driver = s + 1;
+	}
+	if (snd_config_search(root, *driver, &n) >= 0)
+		return 0;
+	return 1;
+}
+
+#ifdef HAVE_LIBPTHREAD
+#define CARD_PROBE_THREADS	8
+
+/* the cards probed ahead by the parallel mode of load_for_all_cards */
+struct card_probe {
+	unsigned int count;
+	unsigned int next;
+	void (*work)(struct card_probe *probe, unsigned int k);
+	int card[SND_MAX_CARDS];
+	int err[SND_MAX_CARDS];
+	char *driver[SND_MAX_CARDS];
+	snd_config_t *files[SND_MAX_CARDS];
+};
+
+static void card_probe_silent(const char *file ATTRIBUTE_UNUSED,
+			      int line ATTRIBUTE_UNUSED,
+			      const char *func ATTRIBUTE_UNUSED,
+			      int err ATTRIBUTE_UNUSED,
+			      const char *fmt ATTRIBUTE_UNUSED,
+			      va_list arg ATTRIBUTE_UNUSED)
+{
+}
+
+/*
+ * The workers run while the caller holds snd_config_lock(), so they must
+ * not evaluate or search the configuration: the driver is queried
+ * through the hw control and only the already expanded files are parsed.
+ */
+static void card_probe_driver(struct card_probe *probe, unsigned int k)
+{
+	probe->err[k] = _snd_determine_driver_hw(probe->card[k], &probe->driver[k]);
+}
+
+/*
+ * Parse the files of a card into a scratch tree.  This only fills the
+ * parsed file cache, so the load in the order of the cards replays
+ * them; errors are reported by that load.
+ */
+static void card_probe_parse(struct card_probe *probe, unsigned int k)
+{
+	snd_local_error_handler_t handler;
+	snd_config_t *top;
+
+	if (!probe->files[k] || snd_config_top(&top) < 0)
+		return;
+	handler = snd_lib_error_set_local(card_probe_silent);
+	config_hook_load_files(top, probe->files[k], 0);
+	snd_lib_error_set_local(handler);
+	snd_config_delete(top);
+}
+
+static void *card_probe_thread(void *arg)
+{
+	struct card_probe *probe = arg;
+	unsigned int k;
+
+	while ((k = __atomic_fetch_add(&probe->next, 1, __ATOMIC_RELAXED)) < probe->count)
+		probe->work(probe, k);
+	return NULL;
+}
+
+static void card_probe_spawn(struct card_probe *probe,
+			     void (*work)(struct card_probe *probe, unsigned int k))
+{
+	pthread_t threads[CARD_PROBE_THREADS - 1];
+	unsigned int k, nthreads = 0;
+
+	probe->work = work;
+	probe->next = 0;
+	while (nthreads < CARD_PROBE_THREADS - 1 && nthreads + 1 < probe->count) {
+		if (pthread_create(&threads[nthreads], NULL, card_probe_thread, probe))
+			break;
+		nthreads++;
+	}
+	card_probe_thread(probe);
+	for (k = 0; k < nthreads; k++)
+		pthread_join(threads[k], NULL);
+}
+
+static void card_probe_free(struct card_probe *probe)
+{
+	unsigned int k;
+
+	for (k = 0; k < probe->count; k++) {
+		free(probe->driver[k]);
+		if (probe->files[k])
+			snd_config_delete(probe->files[k]);
+	}
+	free(probe);
+}
+
+/* probe all cards concurrently, NULL to fall back to the sequential mode */
+static struct card_probe *card_probe_run(snd_config_t *root, snd_config_t *config)
+{
+	struct card_probe *probe;
+	snd_config_t *files;
+	unsigned int k;
+	int card = -1;
+
+	if (snd_config_search(config, "files", &files) < 0)
+		return NULL;
+	probe = calloc(1, sizeof(*probe));
+	if (!probe)
+		return NULL;
+	while (snd_card_next(&card) >= 0 && card >= 0) {
+		if (probe->count >= SND_MAX_CARDS)
+			break;
+		probe->card[probe->count++] = card;
+	}
+	if (card >= 0) {
+		free(probe);
+		return NULL;
+	}
+	card_probe_spawn(probe, card_probe_driver);
+	/* the file names depend on the tree, they are expanded here */
+	for (k = 0; k < probe->count; k++) {
+		snd_config_t *private_data;
+		const char *driver;
+		if (probe->err[k] < 0 ||
+		    !card_config_driver(root, probe->driver[k], &driver))
+			continue;
+		private_data = _snd_config_hook_private_data(probe->card[k], driver);
+		if (!private_data)
+			continue;
+		if (snd_config_expand(files, root, NULL, private_data, &probe->files[k]) >= 0 &&
+		    snd_config_get_type(probe->files[k]) != SND_CONFIG_TYPE_COMPOUND) {
+			snd_config_delete(probe->files[k]);
+			probe->files[k] = NULL;
+		}
+		snd_config_delete(private_data);
+	}
+	card_probe_spawn(probe, card_probe_parse);
+	return probe;
+}
+#endif
+
+/*
+ * The lazy mode of load_for_all_cards: instead of loading the files of
+ * a card, leave a compound for its driver with a load_card hook, so the
+ * files are parsed when a search first enters the node.
+ */
+static int card_config_defer(snd_config_t *root, snd_config_t *config,
+			     const char *driver, snd_config_t *private_data)
+{
+	snd_config_t *node, *hooks, *hook, *files, *n;
+	int err;
+
+	/* defined by other files already, loaded as without the lazy mode */
+	if (snd_config_search(root, driver, &n) >= 0)
+		return snd_config_hook_load(root, config, &n, private_data);
+	if ((err = snd_config_search(config, "files", &files)) < 0) {
+		SNDERR("Unable to find field files in the pre-load section");
+		return -EINVAL;
+	}
+	err = snd_config_make_compound(&node, driver, 0);
+	if (err < 0)
+		return err;
+	err = snd_config_make_compound(&hooks, "@hooks", 0);
+	if (err < 0)
+		goto _err;
+	if ((err = snd_config_add(node, hooks)) < 0) {
+		snd_config_delete(hooks);
+		goto _err;
+	}
+	err = snd_config_make_compound(&hook, "0", 0);
+	if (err < 0)
+		goto _err;
+	if ((err = snd_config_add(hooks, hook)) < 0) {
+		snd_config_delete(hook);
+		goto _err;
+	}
+	err = snd_config_imake_string(&n, "func", "load_card");
+	if (err < 0)
+		goto _err;
+	if ((err = snd_config_add(hook, n)) < 0) {
+		snd_config_delete(n);
+		goto _err;
+	}
+	if ((err = snd_config_expand(files, root, NULL, private_data, &n)) < 0) {
+		SNDERR("Unable to expand filenames in the pre-load section");
+		goto _err;
+	}
+	if ((err = snd_config_add(hook, n)) < 0) {
+		snd_config_delete(n);
+		goto _err;
+	}
+	if (snd_config_search(config, "errors", &files) >= 0) {
+		if ((err = snd_config_copy(&n, files)) < 0)
+			goto _err;
+		if ((err = snd_config_add(hook, n)) < 0) {
+			snd_config_delete(n);
+			goto _err;
+		}
+	}
+	if ((err = snd_config_add(root, node)) < 0)
+		goto _err;
+	return 0;
+ _err:
+	snd_config_delete(node);
+	return err;
+}
+
 /**
  * \brief Loads and parses the given configurations files for each
  *        installed sound card.
@@ -4377,47 +5937,93 @@ static int _snd_config_hook_table(snd_config_t *root, snd_config_t *config, snd_
  * This function works like #snd_config_hook_load, but the files are
  * loaded once for each sound card.  The driver name is available with
  * the \c private_string function to customize the file name.
+ *
+ * When the field \c parallel of the hook is true, the cards are probed
+ * and their files are parsed by several threads first.  The files are
+ * then loaded in the order of the cards, as without it, so the result
+ * is the same.
+ *
+ * When the field \c lazy is true, the files of a card are parsed only
+ * when a search first enters the node of its driver (\c cards.DRIVER
+ * for the default configuration), so opening one card does not parse
+ * the files of all others.  The definitions the card files share with
+ * an include are then missing until some card is loaded, the field
+ * \c common lists files loaded at once for them:
+ *
+ * \code
+ *	lazy true
+ *	common [ { @func concat strings [ { @func datadir } "/pcm" ] } ]
+ * \endcode
+ *
+ * A card file defining nodes outside of its driver node is seen only
+ * after that node was searched.  The field \c parallel is ignored in
+ * this mode.
  */
 int snd_config_hook_load_for_all_cards(snd_config_t *root, snd_config_t *config, snd_config_t **dst, snd_config_t *private_data ATTRIBUTE_UNUSED)
 {
-	int card = -1, err;
-	snd_config_t *loaded;	// trace loaded cards
+	int card = -1, err, lazy = 0;
+	snd_config_t *loaded = NULL;	// trace loaded cards
+	snd_config_t *c;
+#ifdef HAVE_LIBPTHREAD
+	struct card_probe *probe = NULL;
+	unsigned int idx = 0;
+#endif
+
+	if (snd_config_search(config, "lazy", &c) >= 0) {
+		lazy = snd_config_get_bool(c);
+		if (lazy < 0) {
+			SNDERR("Invalid bool value in field lazy");
+			return lazy;
+		}
+		if (lazy && snd_config_search(config, "common", &c) >= 0) {
+			err = config_hook_load(root, config, "common", NULL);
+			if (err < 0)
+				return err;
+		}
+	}
+#ifdef HAVE_LIBPTHREAD
+	if (!lazy && snd_config_search(config, "parallel", &c) >= 0) {
+		err = snd_config_get_bool(c);
+		if (err < 0) {
+			SNDERR("Invalid bool value in field parallel");
+			return err;
+		}
+		if (err)
+			probe = card_probe_run(root, config);
+	}
+#endif
 	
 	err = snd_config_top(&loaded);
 	if (err < 0)
-		return err;
+		goto __fin_err;
 	do {
-		err = snd_card_next(&card);
-		if (err < 0)
-			goto __fin_err;
+#ifdef HAVE_LIBPTHREAD
+		if (probe)
+			card = idx < probe->count ? probe->card[idx] : -1;
+		else
+#endif
+		{
+			err = snd_card_next(&card);
+			if (err < 0)
+				goto __fin_err;
+		}
 		if (card >= 0) {
 			snd_config_t *n, *m, *private_data = NULL;
 			const char *driver;
 			char *fdriver = NULL;
 			bool load;
-			err = snd_determine_driver(card, &fdriver);
+#ifdef HAVE_LIBPTHREAD
+			if (probe) {
+				err = probe->err[idx];
+				fdriver = probe->driver[idx];
+				probe->driver[idx++] = NULL;
+			} else
+#endif
+				err = snd_determine_driver(card, &fdriver);
 			if (err < 0)
 				goto __fin_err;
-			if (snd_config_search(root, fdriver, &n) >= 0) {
-				if (snd_config_get_string(n, &driver) < 0) {
-					if (snd_config_get_type(n) == SND_CONFIG_TYPE_COMPOUND) {
-						snd_config_get_id(n, &driver);
-						goto __std;
-					}
-					goto __err;
-				}
-				while (1) {
-					char *s = strchr(driver, '.');
-					if (s == NULL)
-						break;
-					driver = s + 1;
-				}
-				if (snd_config_search(root, driver, &n) >= 0)
-					goto __err;
-			} else {
-				driver = fdriver;
-			}
-		      __std:
+			if (!card_config_driver(root, fdriver, &driver))
+				goto __err;
 			load = true;
 			err = snd_config_imake_integer(&m, driver, 1);
 			if (err < 0)
@@ -4439,7 +6045,9 @@ int snd_config_hook_load_for_all_cards(snd_config_t *root, snd_config_t *config,
 			err = _snd_config_hook_table(root, config, private_data);
 			if (err < 0)
 				goto __err;
-			if (load)
+			if (load && lazy)
+				err = card_config_defer(root, config, driver, private_data);
+			else if (load)
 				err = snd_config_hook_load(root, config, &n, private_data);
 		      __err:
 			if (private_data)
@@ -4449,57 +6057,31 @@ int snd_config_hook_load_for_all_cards(snd_config_t *root, snd_config_t *config,
 				goto __fin_err;
 		}
 	} while (card >= 0);
-	snd_config_delete(loaded);
 	*dst = NULL;
-	return 0;
-__fin_err:
-	snd_config_delete(loaded);
+	err = 0;
+ __fin_err:
+	if (loaded)
+		snd_config_delete(loaded);
+#ifdef HAVE_LIBPTHREAD
+	if (probe)
+		card_probe_free(probe);
+#endif
 	return err;
 }
 #ifndef DOC_HIDDEN
 SND_DLSYM_BUILD_VERSION(snd_config_hook_load_for_all_cards, SND_CONFIG_DLSYM_VERSION_HOOK);
 #endif
-
-/** 
- * \brief Updates a configuration tree by rereading the configuration files (if needed).
- * \param[in,out] _top Address of the handle to the top-level node.
- * \param[in,out] _update Address of a pointer to private update information.
- * \param[in] cfgs A list of configuration file names, delimited with ':'.
- *                 If \p cfgs is \c NULL, the default global
- *                 configuration file is used.
- * \return 0 if \a _top was up to date, 1 if the configuration files
- *         have been reread, otherwise a negative error code.
- *
- * The variables pointed to by \a _top and \a _update can be initialized
- * to \c NULL before the first call to this function.  The private
- * update information holds information about all used configuration
- * files that allows this function to detects changes to them; this data
- * can be freed with #snd_config_update_free.
- *
- * The global configuration files are specified in the environment variable
- * \c ALSA_CONFIG_PATH.
- *
- * \warning If the configuration tree is reread, all string pointers and
- * configuration node handles previously obtained from this tree become
- * invalid.
- *
- * \par Errors:
- * Any errors encountered when parsing the input or returned by hooks or
- * functions.
- */
-int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, const char *cfgs)
+
+/* the configuration files named by cfgs, with their current state */
+static int config_update_files(const char *cfgs, snd_config_update_t **_local)
 {
 	int err;
 	const char *configs, *c;
 	unsigned int k;
 	size_t l;
 	snd_config_update_t *local;
-	snd_config_update_t *update;
-	snd_config_t *top;
-	
-	assert(_top && _update);
-	top = *_top;
-	update = *_update;
+
+	*_local = NULL;
 	configs = cfgs;
 	if (!configs) {
 		configs = getenv(ALSA_CONFIG_PATH_VAR);
@@ -4518,10 +6100,8 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 			break;
 		c++;
 	}
-	if (k == 0) {
-		local = NULL;
-		goto _reread;
-	}
+	if (k == 0)
+		return 0;
 	local = (snd_config_update_t *)calloc(1, sizeof(snd_config_update_t));
 	if (!local)
 		return -ENOMEM;
@@ -4536,8 +6116,10 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 		memcpy(name, c, l);
 		name[l] = 0;
 		err = snd_user_file(name, &local->finfo[k].name);
-		if (err < 0)
-			goto _end;
+		if (err < 0) {
+			snd_config_update_free(local);
+			return err;
+		}
 		c += l;
 		k++;
 		if (!*c)
@@ -4559,10 +6141,20 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 			local->count--;
 		}
 	}
-	if (!update)
-		goto _reread;
+	*_local = local;
+	return 0;
+}
+
+/* does the tree loaded for update have to be reread? */
+static int config_update_needed(snd_config_update_t *local,
+				snd_config_update_t *update)
+{
+	unsigned int k;
+
+	if (!local || !update)
+		return 1;
 	if (local->count != update->count)
-		goto _reread;
+		return 1;
 	for (k = 0; k < local->count; ++k) {
 		struct finfo *lf = &local->finfo[k];
 		struct finfo *uf = &update->finfo[k];
@@ -4570,47 +6162,48 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 		    lf->dev != uf->dev ||
 		    lf->ino != uf->ino ||
 		    lf->mtime != uf->mtime)
-			goto _reread;
+			return 1;
 	}
-	err = 0;
+	/* the included files and those loaded by hooks */
+	if (update->deps.err >= 0 &&
+	    !config_cache_files_valid(update->deps.files.data,
+				      update->deps.files.data + update->deps.files.size,
+				      update->deps.count))
+		return 1;
+	return 0;
+}
 
- _end:
-	if (err < 0) {
-		if (top) {
-			snd_config_delete(top);
-			*_top = NULL;
-		}
-		if (update) {
-			snd_config_update_free(update);
-			*_update = NULL;
-		}
-	}
-	if (local)
-		snd_config_update_free(local);
-	return err;
+/*
+ * Load a new tree from the files of local and run the hooks.  Files
+ * unchanged since they were last loaded are replayed from the memory
+ * cache, only the changed ones are parsed again.
+ */
+static int config_update_load(snd_config_update_t *local, snd_config_t **_top)
+{
+	snd_config_t *top;
+#ifdef HAVE___THREAD
+	struct config_cache_rec *deps = config_update_deps;
+#endif
+	unsigned long long trace = snd_trace_begin(), tfile, thooks;
+	unsigned int k;
+	int err;
 
- _reread:
- 	*_top = NULL;
- 	*_update = NULL;
- 	if (update) {
- 		snd_config_update_free(update);
- 		update = NULL;
- 	}
-	if (top) {
-		snd_config_delete(top);
-		top = NULL;
-	}
+	*_top = NULL;
 	err = snd_config_top(&top);
 	if (err < 0)
-		goto _end;
-	if (!local)
-		goto _skip;
-	for (k = 0; k < local->count; ++k) {
+		return err;
+#ifdef HAVE___THREAD
+	if (local)
+		config_update_deps = &local->deps;
+#endif
+	for (k = 0; local && k < local->count; ++k) {
 		snd_input_t *in;
-		err = snd_input_stdio_open(&in, local->finfo[k].name, "r");
+		tfile = snd_trace_begin();
+		err = snd_input_mmap_open(&in, local->finfo[k].name);
 		if (err >= 0) {
-			err = snd_config_load(top, in);
+			err = config_load_cached(top, local->finfo[k].name, in);
 			snd_input_close(in);
+			snd_trace_end(tfile, "conf", "load file", local->finfo[k].name);
 			if (err < 0) {
 				SNDERR("%s may be old or corrupted: consider to remove or fix it", local->finfo[k].name);
 				goto _end;
@@ -4619,17 +6212,197 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 			SNDERR("cannot access file %s", local->finfo[k].name);
 		}
 	}
- _skip:
+	thooks = snd_trace_begin();
 	err = snd_config_hooks(top, NULL);
-	if (err < 0) {
+	snd_trace_end(thooks, "conf", "hooks", NULL);
+	if (err < 0)
 		SNDERR("hooks failed, removing configuration");
-		goto _end;
+ _end:
+	snd_trace_end(trace, "conf", "config update", NULL);
+#ifdef HAVE___THREAD
+	config_update_deps = deps;
+#else
+	/* without the collected files, only the top files are checked */
+	if (local)
+		local->deps.err = -ENOSYS;
+#endif
+	if (err < 0) {
+		snd_config_delete(top);
+		return err;
+	}
+	*_top = top;
+	return 0;
+}
+
+/** 
+ * \brief Updates a configuration tree by rereading the configuration files (if needed).
+ * \param[in,out] _top Address of the handle to the top-level node.
+ * \param[in,out] _update Address of a pointer to private update information.
+ * \param[in] cfgs A list of configuration file names, delimited with ':'.
+ *                 If \p cfgs is \c NULL, the default global
+ *                 configuration file is used.
+ * \return 0 if \a _top was up to date, 1 if the configuration files
+ *         have been reread, otherwise a negative error code.
+ *
+ * The variables pointed to by \a _top and \a _update can be initialized
+ * to \c NULL before the first call to this function.  The private
+ * update information holds information about all used configuration
+ * files that allows this function to detects changes to them; this data
+ * can be freed with #snd_config_update_free.
+ *
+ * The global configuration files are specified in the environment variable
+ * \c ALSA_CONFIG_PATH.
+ *
+ * A change of any file read for the tree, including the included files
+ * and the files loaded by hooks, causes a reread.  The parsed form of
+ * each file is kept in memory, so a reread parses only the files that
+ * changed; the others are replayed and the hooks are always run.
+ *
+ * If the environment variable \c ALSA_CONFIG_CACHE names a directory
+ * (absolute path), the parsed form of each configuration file is also
+ * cached there.  A cache is used only while the file, its includes and
+ * the directories searched for them are unchanged (device, inode, size
+ * and modification time), and only when the directory and the cache
+ * file are owned by the effective user and not writable by the group
+ * or others.  Set-user-ID processes do not use the directory.
+ *
+ * \warning If the configuration tree is reread, all string pointers and
+ * configuration node handles previously obtained from this tree become
+ * invalid.
+ *
+ * \par Errors:
+ * Any errors encountered when parsing the input or returned by hooks or
+ * functions.
+ */
+int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, const char *cfgs)
+{
+	int err;
+	snd_config_update_t *local;
+	snd_config_update_t *update;
+	snd_config_t *top;
+	
+	assert(_top && _update);
+	top = *_top;
+	update = *_update;
+	err = config_update_files(cfgs, &local);
+	if (err >= 0 && !config_update_needed(local, update)) {
+		snd_config_update_free(local);
+		return 0;
+	}
+ 	*_top = NULL;
+ 	*_update = NULL;
+ 	if (update)
+ 		snd_config_update_free(update);
+	if (top)
+		snd_config_delete(top);
+	if (err < 0)
+		return err;
+	err = config_update_load(local, &top);
+	if (err < 0) {
+		if (local)
+			snd_config_update_free(local);
+		return err;
 	}
 	*_top = top;
 	*_update = local;
 	return 1;
 }
 
+/*
+ * With defaults.prelink set, resolve the plugin open functions of the
+ * new tree at once, so the first opens don't load them one by one.
+ */
+static void config_prelink(snd_config_t *top)
+{
+	snd_config_t *n;
+
+	if (snd_config_search(top, "defaults.prelink", &n) < 0 ||
+	    snd_config_get_bool(n) <= 0)
+		return;
+#ifdef BUILD_PCM
+	snd_pcm_open_prelink(top);
+#endif
+	snd_ctl_open_prelink(top);
+}
+
+/*
+ * Update snd_config and optionally take its reference.  The new tree is
+ * built without holding snd_config_lock(), so opens using the current
+ * tree are not stalled by the reread; if another thread replaced the
+ * tree meanwhile, the result is dropped and the check is repeated.
+ * The tree is replaced under the exclusive tree lock, after the running
+ * searches of the old one.  A thread updating from within a search (a
+ * function evaluated for it opening a control) keeps the old tree.
+ */
+static int config_update_global(snd_config_t **top, int ref)
+{
+	snd_config_update_t *local;
+	snd_config_t *ntop = NULL;
+	unsigned int gen;
+	int err, tree_locked = 0;
+
+	snd_config_lock();
+ __retry:
+	err = config_update_files(NULL, &local);
+	if (err >= 0 && !config_update_needed(local, snd_config_global_update)) {
+		snd_config_update_free(local);
+		goto __ref;
+	}
+	gen = snd_config_global_generation;
+	snd_config_unlock();
+	if (err >= 0) {
+		err = config_update_load(local, &ntop);
+		if (err >= 0)
+			config_prelink(ntop);
+	}
+	tree_locked = config_tree_wrlock() >= 0;
+	snd_config_lock();
+	if (gen != snd_config_global_generation || !tree_locked) {
+		if (err >= 0)
+			snd_config_delete(ntop);
+		if (local)
+			snd_config_update_free(local);
+		if (!tree_locked) {
+			err = 0;
+			goto __ref;
+		}
+		config_tree_unlock();
+		tree_locked = 0;
+		goto __retry;
+	}
+	snd_config_global_generation++;
+	if (snd_config)
+		snd_config_delete(snd_config);
+	snd_config = NULL;
+	if (snd_config_global_update)
+		snd_config_update_free(snd_config_global_update);
+	snd_config_global_update = NULL;
+	if (err < 0) {
+		if (local)
+			snd_config_update_free(local);
+		goto __unlock;
+	}
+	snd_config = ntop;
+	snd_config_global_update = local;
+	err = 1;
+ __ref:
+	if (ref) {
+		if (snd_config) {
+			if (top) {
+				snd_config->refcount++;
+				*top = snd_config;
+			}
+		} else {
+			err = -ENODEV;
+		}
+	}
+ __unlock:
+	snd_config_unlock();
+	if (tree_locked)
+		config_tree_unlock();
+	return err;
+}
+
 /** 
  * \brief Updates #snd_config by rereading the global configuration files (if needed).
  * \return 0 if #snd_config was up to date, 1 if #snd_config was
@@ -4650,12 +6423,7 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
  */
 int snd_config_update(void)
 {
-	int err;
-
-	snd_config_lock();
-	err = snd_config_update_r(&snd_config, &snd_config_global_update, NULL);
-	snd_config_unlock();
-	return err;
+	return config_update_global(NULL, 0);
 }
 
 /**
@@ -4671,24 +6439,9 @@ int snd_config_update(void)
  */
 int snd_config_update_ref(snd_config_t **top)
 {
-	int err;
-
 	if (top)
 		*top = NULL;
-	snd_config_lock();
-	err = snd_config_update_r(&snd_config, &snd_config_global_update, NULL);
-	if (err >= 0) {
-		if (snd_config) {
-			if (top) {
-				snd_config->refcount++;
-				*top = snd_config;
-			}
-		} else {
-			err = -ENODEV;
-		}
-	}
-	snd_config_unlock();
-	return err;
+	return config_update_global(top, 1);
 }
 
 /**
@@ -4739,6 +6492,7 @@ int snd_config_update_free(snd_config_update_t *update)
 	for (k = 0; k < update->count; k++)
 		free(update->finfo[k].name);
 	free(update->finfo);
+	free(update->deps.files.data);
 	free(update);
 	return 0;
 }
@@ -4755,7 +6509,10 @@ int snd_config_update_free(snd_config_update_t *update)
  */
 int snd_config_update_free_global(void)
 {
+	int tree_locked = config_tree_wrlock() >= 0;
+
 	snd_config_lock();
+	snd_config_global_generation++;
 	if (snd_config)
 		snd_config_delete(snd_config);
 	snd_config = NULL;
@@ -4763,8 +6520,12 @@ int snd_config_update_free_global(void)
 		snd_config_update_free(snd_config_global_update);
 	snd_config_global_update = NULL;
 	snd_config_unlock();
+	if (tree_locked)
+		config_tree_unlock();
 	/* FIXME: better to place this in another place... */
 	snd_dlobj_cache_cleanup();
+	__snd_pcm_info_eld_cache_free();
+	__snd_eval_cache_free();
 
 	return 0;
 }
@@ -4990,7 +6751,12 @@ static int _snd_config_copy(snd_config_t *src,
 int snd_config_copy(snd_config_t **dst,
 		    snd_config_t *src)
 {
-	return snd_config_walk(src, NULL, dst, _snd_config_copy, NULL, NULL);
+	struct config_arena *arena = config_arena_begin();
+	int err;
+
+	err = snd_config_walk(src, NULL, dst, _snd_config_copy, NULL, NULL);
+	config_arena_end(arena);
+	return err;
 }
 
 static int _snd_config_expand_vars(snd_config_t **dst, const char *s, void *private_data)
@@ -5630,10 +7396,13 @@ int snd_config_expand_custom(snd_config_t *config, snd_config_t *root,
 			     snd_config_expand_fcn_t fcn, void *private_data,
 			     snd_config_t **result)
 {
+	struct config_arena *arena;
 	snd_config_t *res;
 	int err;
 
+	arena = config_arena_begin();
 	err = snd_config_walk(config, root, &res, _snd_config_expand, fcn, private_data);
+	config_arena_end(arena);
 	if (err < 0) {
 		SNDERR("Expand error (walk): %s", snd_strerror(err));
 		return err;
@@ -5642,6 +7411,10 @@ int snd_config_expand_custom(snd_config_t *config, snd_config_t *root,
 	return 1;
 }
 
+static int config_expand(snd_config_t *config, snd_config_t *root, const char *args,
+			 snd_config_t *private_data, snd_config_t **result,
+			 int share);
+
 /**
  * \brief Expands a configuration node, applying arguments and functions.
  * \param[in] config Handle to the configuration node.
@@ -5662,21 +7435,54 @@ int snd_config_expand_custom(snd_config_t *config, snd_config_t *root,
 int snd_config_expand(snd_config_t *config, snd_config_t *root, const char *args,
 		      snd_config_t *private_data, snd_config_t **result)
 {
+	return config_expand(config, root, args, private_data, result, 0);
+}
+
+/* no node of the tree would be changed by the evaluation */
+static int config_is_static(snd_config_t *config)
+{
+	snd_config_iterator_t i, next;
+
+	if (config->type != SND_CONFIG_TYPE_COMPOUND)
+		return 1;
+	snd_config_for_each(i, next, config) {
+		snd_config_t *n = snd_config_iterator_entry(i);
+		if (n->id && strcmp(n->id, "@func") == 0)
+			return 0;
+		if (!config_is_static(n))
+			return 0;
+	}
+	return 1;
+}
+
+static int config_expand(snd_config_t *config, snd_config_t *root, const char *args,
+			 snd_config_t *private_data, snd_config_t **result,
+			 int share)
+{
+	struct config_arena *arena;
 	int err;
 	snd_config_t *defs, *subs = NULL, *res;
 	err = snd_config_search(config, "@args", &defs);
+	if (err < 0 && !args && share && config_is_static(config)) {
+		/* the copy would be identical, hand out the node itself */
+		__atomic_add_fetch(&config->refcount, 1, __ATOMIC_RELAXED);
+		*result = config;
+		return 1;
+	}
+	arena = config_arena_begin();
 	if (err < 0) {
 		if (args != NULL) {
 			SNDERR("Unknown parameters %s", args);
-			return -EINVAL;
+			err = -EINVAL;
+			goto _end;
 		}
 		err = snd_config_copy(&res, config);
 		if (err < 0)
-			return err;
+			goto _end;
 	} else {
 		err = snd_config_top(&subs);
 		if (err < 0)
-			return err;
+			goto _end;
 		err = load_defaults(subs, defs);
 		if (err < 0) {
 			SNDERR("Load defaults error: %s", snd_strerror(err));
@@ -5709,6 +7515,7 @@ int snd_config_expand(snd_config_t *config, snd_config_t *root, const char *args
  _end:
  	if (subs)
 		snd_config_delete(subs);
+	config_arena_end(arena);
 	return err;
 }
 
@@ -5744,11 +7551,40 @@ int snd_config_expand(snd_config_t *config, snd_config_t *root, const char *args
 int snd_config_search_definition(snd_config_t *config,
 				 const char *base, const char *name,
 				 snd_config_t **result)
+{
+	return _snd_config_search_definition(config, base, name, result, 0);
+}
+
+#ifndef DOC_HIDDEN
+static int config_search_expand(snd_config_t *config, const char *base,
+				const char *key, const char *args,
+				snd_config_t **result, int share)
 {
 	snd_config_t *conf;
+	int err;
+
+	err = snd_config_search_alias_hooks(config, base, key, &conf);
+	if (err < 0)
+		return err;
+	return config_expand(conf, config, args, NULL, result, share);
+}
+
+/*
+ * With share set, a definition that expands to an identical copy is
+ * returned itself, with a reference taken.  The caller must not change
+ * the result, not even its hop (see snd_config_enter_hop()), and
+ * releases it with snd_config_delete() while it holds a reference on
+ * config.
+ */
+int _snd_config_search_definition(snd_config_t *config,
+				  const char *base, const char *name,
+				  snd_config_t **result, int share)
+{
 	char *key;
 	const char *args = strchr(name, ':');
-	int err;
+	unsigned long long trace = snd_trace_begin();
+	snd_config_t *conf;
+	int err, missed, expanded;
 	if (args) {
 		args++;
 		key = alloca(args - name);
@@ -5761,16 +7597,36 @@ int snd_config_search_definition(snd_config_t *config,
 	 *  if key contains dot (.), the implicit base is ignored
 	 *  and the key starts from root given by the 'config' parameter
 	 */
-	snd_config_lock();
-	err = snd_config_search_alias_hooks(config, strchr(key, '.') ? NULL : base, key, &conf);
-	if (err < 0) {
-		snd_config_unlock();
-		return err;
-	}
-	err = snd_config_expand(conf, config, args, NULL, result);
-	snd_config_unlock();
+	if (strchr(key, '.'))
+		base = NULL;
+	missed = config_tree_missed;
+	config_tree_missed = 0;
+	config_tree_rdlock();
+	err = snd_config_search_alias_hooks(config, base, key, &conf);
+	/* a definition found without its hooks run is not worth expanding */
+	expanded = err >= 0 && !config_tree_missed;
+	if (expanded)
+		err = config_expand(conf, config, args, NULL, result, share);
+	config_tree_unlock();
+	if (config_tree_missed && config_tree_wrlock() >= 0) {
+		/* a hook was due, redo it all with the hooks run */
+		if (expanded && err >= 0)
+			snd_config_delete(*result);
+		config_tree_missed = 0;
+		err = config_search_expand(config, base, key, args, result, share);
+		config_tree_unlock();
+	} else if (!expanded && err >= 0) {
+		/*
+		 * nested in a search of this thread, which still holds
+		 * the tree and will be redone
+		 */
+		err = config_expand(conf, config, args, NULL, result, share);
+	}
+	config_tree_missed |= missed;
+	snd_trace_end(trace, "conf", "search definition", name);
 	return err;
 }
+#endif
 
 #ifndef DOC_HIDDEN
 void snd_config_set_hop(snd_config_t *conf, int hop)
@@ -5789,6 +7645,44 @@ int snd_config_check_hop(snd_config_t *conf)
 	}
 	return 0;
 }
+
+#ifdef HAVE___THREAD
+#define HOP_TLS		__thread
+#else
+#define HOP_TLS		/* NOP */
+#endif
+
+/*
+ * Definition level of the PCM or CTL open in progress in this thread.
+ * The definitions found by _snd_config_search_definition() may be shared
+ * by concurrent opens, so the level is not stored in the node but kept
+ * here for the duration of the open function.
+ */
+static HOP_TLS int config_open_hop;
+
+/* returns the level to give back to snd_config_leave_hop() */
+int snd_config_enter_hop(int hop)
+{
+	int old = config_open_hop;
+
+	config_open_hop = hop;
+	return old;
+}
+
+void snd_config_leave_hop(int old)
+{
+	config_open_hop = old;
+}
+
+/* level of the open in progress, for the slave it opens */
+int snd_config_open_hop(void)
+{
+	if (config_open_hop >= SND_CONF_MAX_HOPS) {
+		SYSERR("Too many definition levels (looped?)\n");
+		return -EINVAL;
+	}
+	return config_open_hop;
+}
 #endif
 
 #if 0
@@ -37,6 +37,9 @@
 #include <ctype.h>
 #include <limits.h>
 #include "local.h"
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 typedef long long value_type_t;
 
@@ -119,13 +122,91 @@ static int _to_integer(value_type_t *val, snd_config_t *c)
 	return err;
 }
 
-int _snd_eval_string(snd_config_t **dst, const char *s,
-		     snd_config_expand_fcn_t fcn, void *private_data)
+/*
+ * An expression is compiled once to a small RPN program, which is kept in
+ * a direct mapped cache indexed by the hash of the expression string.  The
+ * later evaluations only resolve the variables and do the arithmetic.
+ */
+
+#define EVAL_CACHE_SIZE		64
+
+enum {
+	EVAL_INTEGER,
+	EVAL_VARIABLE,
+	EVAL_OPERATION,
+};
+
+struct eval_step {
+	int type;
+	int op;
+	value_type_t val;
+	char *name;
+};
+
+struct eval_prog {
+	char *str;
+	unsigned int hash;
+	unsigned int refs;
+	unsigned int nsteps;
+	unsigned int alloc;
+	unsigned int depth;
+	unsigned int sp;
+	struct eval_step *steps;
+};
+
+static struct eval_prog *eval_cache[EVAL_CACHE_SIZE];
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t eval_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline void eval_cache_lock(void)
+{
+	pthread_mutex_lock(&eval_cache_mutex);
+}
+
+static inline void eval_cache_unlock(void)
+{
+	pthread_mutex_unlock(&eval_cache_mutex);
+}
+#else
+static inline void eval_cache_lock(void) {}
+static inline void eval_cache_unlock(void) {}
+#endif
+
+static int eval_emit(struct eval_prog *prog, int type, int op,
+		     value_type_t val, char *name)
+{
+	struct eval_step *step;
+	unsigned int alloc;
+
+	if (prog->nsteps == prog->alloc) {
+		alloc = prog->alloc ? prog->alloc * 2 : 4;
+		step = realloc(prog->steps, alloc * sizeof(*step));
+		if (step == NULL) {
+			free(name);
+			return -ENOMEM;
+		}
+		prog->steps = step;
+		prog->alloc = alloc;
+	}
+	step = &prog->steps[prog->nsteps++];
+	step->type = type;
+	step->op = op;
+	step->val = val;
+	step->name = name;
+	if (type == EVAL_OPERATION) {
+		prog->sp--;
+	} else if (++prog->sp > prog->depth) {
+		prog->depth = prog->sp;
+	}
+	return 0;
+}
+
+static int eval_compile(struct eval_prog *prog, const char *s)
 {
-	snd_config_t *tmp;
 	const char *save, *e;
 	char *m;
-	value_type_t left, right;
+	value_type_t val;
 	int err, c, op, off;
 	enum {
 		LEFT,
@@ -180,10 +261,8 @@ int _snd_eval_string(snd_config_t **dst, const char *s,
 					return -ENOMEM;
 				memcpy(m, s + off, e - s - off);
 				m[e - s - (off + 1)] = '\0';
-				err = _snd_eval_string(&tmp, m, fcn, private_data);
+				err = eval_compile(prog, m);
 				free(m);
-				if (err < 0)
-					return err;
 				s = e;
 				if (*s)
 					s++;
@@ -199,45 +278,201 @@ int _snd_eval_string(snd_config_t **dst, const char *s,
 					return -ENOMEM;
 				memcpy(m, s + 1, e - s - 1);
 				m[e - s - 1] = '\0';
-				err = fcn(&tmp, m, private_data);
-				free(m);
-				if (err < 0)
-					return err;
-				if (tmp == NULL) {
-					err = snd_config_imake_integer(&tmp, NULL, 0);
-					if (err < 0)
-						return err;
-				}
+				err = eval_emit(prog, EVAL_VARIABLE, 0, 0, m);
 				s = e;
 			}
-			err = _to_integer(op == LEFT ? &left : &right, tmp);
-			snd_config_delete(tmp);
 		} else if (c == '-' || (c >= '0' && c <= '9')) {
-			err = _parse_integer(op == LEFT ? &left : &right, &s);
+			val = 0;
+			err = _parse_integer(&val, &s);
+			if (err < 0) {
+				SNDERR("invalid integer '%s'", s);
+				return err;
+			}
+			err = eval_emit(prog, EVAL_INTEGER, 0, val, NULL);
 		} else {
 			return -EINVAL;
 		}
 		if (err < 0)
 			return err;
-		pos = op == LEFT ? OP : END;
+		pos = op == 0 ? OP : END;
 	}
 	if (pos != OP && pos != END) {
 		SNDERR("incomplete expression '%s'", save);
 		return -EINVAL;
 	}
+	if (pos == END)
+		return eval_emit(prog, EVAL_OPERATION, op, 0, NULL);
+	return 0;
+}
+
+static int eval_run(struct eval_prog *prog, value_type_t *result,
+		    snd_config_expand_fcn_t fcn, void *private_data)
+{
+	value_type_t stack_local[16], *stack = stack_local;
+	value_type_t left, right;
+	struct eval_step *step;
+	snd_config_t *tmp;
+	unsigned int i, sp = 0;
+	int err = 0;
 
-	if (pos == END) {
-		switch (op) {
-		case '+': left = left + right; break;
-		case '-': left = left - right; break;
-		case '*': left = left * right; break;
-		case '/': left = left / right; break;
-		case '%': left = left % right; break;
-		case '|': left = left | right; break;
-		case '&': left = left & right; break;
-		default: return -EINVAL;
+	if (prog->depth > ARRAY_SIZE(stack_local)) {
+		stack = malloc(prog->depth * sizeof(*stack));
+		if (stack == NULL)
+			return -ENOMEM;
+	}
+	for (i = 0; i < prog->nsteps; i++) {
+		step = &prog->steps[i];
+		switch (step->type) {
+		case EVAL_INTEGER:
+			stack[sp++] = step->val;
+			break;
+		case EVAL_VARIABLE:
+			err = fcn(&tmp, step->name, private_data);
+			if (err < 0)
+				goto __end;
+			if (tmp == NULL) {
+				stack[sp++] = 0;
+				break;
+			}
+			err = _to_integer(&stack[sp++], tmp);
+			snd_config_delete(tmp);
+			if (err < 0)
+				goto __end;
+			break;
+		case EVAL_OPERATION:
+			right = stack[--sp];
+			left = stack[sp - 1];
+			switch (step->op) {
+			case '+': left = left + right; break;
+			case '-': left = left - right; break;
+			case '*': left = left * right; break;
+			case '/': left = left / right; break;
+			case '%': left = left % right; break;
+			case '|': left = left | right; break;
+			case '&': left = left & right; break;
+			default: err = -EINVAL; goto __end;
+			}
+			stack[sp - 1] = left;
+			break;
 		}
 	}
+	*result = stack[0];
+ __end:
+	if (stack != stack_local)
+		free(stack);
+	return err;
+}
+
+static unsigned int eval_hash(const char *s)
+{
+	unsigned int hash = 2166136261u;
+
+	while (*s)
+		hash = (hash ^ (unsigned char)*s++) * 16777619u;
+	return hash;
+}
+
+static void eval_prog_free(struct eval_prog *prog)
+{
+	unsigned int i;
+
+	for (i = 0; i < prog->nsteps; i++)
+		free(prog->steps[i].name);
+	free(prog->steps);
+	free(prog->str);
+	free(prog);
+}
+
+static void eval_prog_put(struct eval_prog *prog)
+{
+	unsigned int refs;
+
+	eval_cache_lock();
+	refs = --prog->refs;
+	eval_cache_unlock();
+	if (refs == 0)
+		eval_prog_free(prog);
+}
+
+/* return a referenced program for the expression, compile it on a miss */
+static int eval_prog_get(struct eval_prog **progp, const char *s)
+{
+	struct eval_prog *prog, *old = NULL;
+	unsigned int hash = eval_hash(s);
+	unsigned int slot = hash % EVAL_CACHE_SIZE;
+	int err;
+
+	eval_cache_lock();
+	prog = eval_cache[slot];
+	if (prog && prog->hash == hash && strcmp(prog->str, s) == 0) {
+		prog->refs++;
+		eval_cache_unlock();
+		*progp = prog;
+		return 0;
+	}
+	eval_cache_unlock();
+
+	prog = calloc(1, sizeof(*prog));
+	if (prog == NULL)
+		return -ENOMEM;
+	prog->refs = 1;
+	prog->hash = hash;
+	err = eval_compile(prog, s);
+	if (err >= 0) {
+		prog->str = strdup(s);
+		if (prog->str == NULL)
+			err = -ENOMEM;
+	}
+	if (err < 0) {
+		eval_prog_free(prog);
+		return err;
+	}
+
+	eval_cache_lock();
+	old = eval_cache[slot];
+	eval_cache[slot] = prog;
+	prog->refs++;
+	if (old && --old->refs > 0)
+		old = NULL;
+	eval_cache_unlock();
+	if (old)
+		eval_prog_free(old);
+	*progp = prog;
+	return 0;
+}
+
+/* drop the compiled expressions, called from snd_config_update_free_global() */
+void __snd_eval_cache_free(void)
+{
+	struct eval_prog *prog;
+	unsigned int i;
+
+	for (i = 0; i < EVAL_CACHE_SIZE; i++) {
+		eval_cache_lock();
+		prog = eval_cache[i];
+		eval_cache[i] = NULL;
+		if (prog && --prog->refs > 0)
+			prog = NULL;
+		eval_cache_unlock();
+		if (prog)
+			eval_prog_free(prog);
+	}
+}
+
+int _snd_eval_string(snd_config_t **dst, const char *s,
+		     snd_config_expand_fcn_t fcn, void *private_data)
+{
+	struct eval_prog *prog;
+	value_type_t left;
+	int err;
+
+	err = eval_prog_get(&prog, s);
+	if (err < 0)
+		return err;
+	err = eval_run(prog, &left, fcn, private_data);
+	eval_prog_put(prog);
+	if (err < 0)
+		return err;
 
 	if (left > INT_MAX || left < INT_MIN)
 		return snd_config_imake_integer64(dst, NULL, left);
@@ -79,7 +79,12 @@
 #include <string.h>
 #include <ctype.h>
 #include <limits.h>
+#include <sys/stat.h>
 #include "local.h"
+#include "control/control_local.h"
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 /**
  * \brief Gets the boolean value from the given ASCII string.
@@ -631,6 +636,104 @@ static int open_ctl(long card, snd_ctl_t **ctl)
 	return snd_ctl_open(ctl, name, 0);
 }
 
+/*
+ * The card information is remembered per card, so evaluating the same
+ * definitions for every open does not reopen the control device.  An
+ * entry is valid while the control device node is unchanged; a hotplug
+ * recreates the node and so invalidates the entry.
+ */
+struct card_info_memo {
+	int valid;
+	dev_t rdev;
+	ino_t ino;
+	time_t ctime;
+	snd_ctl_card_info_t info;
+};
+
+static struct card_info_memo card_info_memo[SND_MAX_CARDS];
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t card_info_memo_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define card_info_memo_lock()	pthread_mutex_lock(&card_info_memo_mutex)
+#define card_info_memo_unlock()	pthread_mutex_unlock(&card_info_memo_mutex)
+#else
+#define card_info_memo_lock()	do { } while (0)
+#define card_info_memo_unlock()	do { } while (0)
+#endif
+
+static int card_node_stat(long card, struct stat *st)
+{
+	char name[sizeof(ALSA_DEVICE_DIRECTORY "controlC") + 10];
+
+	snprintf(name, sizeof(name), ALSA_DEVICE_DIRECTORY "controlC%li", card);
+	return stat(name, st);
+}
+
+static int card_info_query(long card, snd_ctl_card_info_t *info, int verbose,
+			   int hw)
+{
+	struct card_info_memo *m = NULL;
+	snd_ctl_t *ctl;
+	struct stat st;
+	int err;
+
+	if (card >= 0 && card < SND_MAX_CARDS && card_node_stat(card, &st) == 0) {
+		m = &card_info_memo[card];
+		card_info_memo_lock();
+		if (m->valid && m->rdev == st.st_rdev && m->ino == st.st_ino &&
+		    m->ctime == st.st_ctime) {
+			*info = m->info;
+			card_info_memo_unlock();
+			return 0;
+		}
+		card_info_memo_unlock();
+	}
+	if (hw)
+		err = snd_ctl_hw_open(&ctl, NULL, card, 0);
+	else
+		err = open_ctl(card, &ctl);
+	if (err < 0) {
+		if (verbose)
+			SNDERR("could not open control for card %li", card);
+		return err;
+	}
+	err = snd_ctl_card_info(ctl, info);
+	snd_ctl_close(ctl);
+	if (err < 0) {
+		if (verbose)
+			SNDERR("snd_ctl_card_info error: %s", snd_strerror(err));
+		return err;
+	}
+	if (m) {
+		/* a change after the stat above only causes another query */
+		card_info_memo_lock();
+		m->valid = 1;
+		m->rdev = st.st_rdev;
+		m->ino = st.st_ino;
+		m->ctime = st.st_ctime;
+		m->info = *info;
+		card_info_memo_unlock();
+	}
+	return 0;
+}
+
+/* the card with the given id, through the remembered card information */
+static int card_index_by_id(const char *id)
+{
+	snd_ctl_card_info_t info;
+	struct stat st;
+	int card;
+
+	for (card = 0; card < SND_MAX_CARDS; card++) {
+		if (card_node_stat(card, &st) < 0)
+			continue;
+		if (card_info_query(card, &info, 0, 0) < 0)
+			continue;
+		if (!strcmp((const char *)info.id, id))
+			return card;
+	}
+	return -ENODEV;
+}
+
 #if 0
 static int string_from_integer(char **dst, long v)
 {
@@ -749,35 +852,35 @@ SND_DLSYM_BUILD_VERSION(snd_func_private_integer, SND_CONFIG_DLSYM_VERSION_EVALU
 #endif
 
 #ifndef DOC_HIDDEN
-int snd_determine_driver(int card, char **driver)
+static int determine_driver(int card, char **driver, int hw)
 {
-	snd_ctl_t *ctl = NULL;
 	snd_ctl_card_info_t info = {0};
-	char *res = NULL;
+	char *res;
 	int err;
 
 	assert(card >= 0 && card <= SND_MAX_CARDS);
-	err = open_ctl(card, &ctl);
-	if (err < 0) {
-		SNDERR("could not open control for card %i", card);
-		goto __error;
-	}
-	err = snd_ctl_card_info(ctl, &info);
-	if (err < 0) {
-		SNDERR("snd_ctl_card_info error: %s", snd_strerror(err));
-		goto __error;
-	}
+	err = card_info_query(card, &info, 1, hw);
+	if (err < 0)
+		return err;
 	res = strdup(snd_ctl_card_info_get_driver(&info));
 	if (res == NULL)
-		err = -ENOMEM;
-	else {
-		*driver = res;
-		err = 0;
-	}
-      __error:
-	if (ctl)
-		snd_ctl_close(ctl);
-	return err;
+		return -ENOMEM;
+	*driver = res;
+	return 0;
+}
+
+int snd_determine_driver(int card, char **driver)
+{
+	return determine_driver(card, driver, 0);
+}
+
+/*
+ * The same through the hw control directly, without the configuration,
+ * for threads working while another one holds the configuration lock.
+ */
+int _snd_determine_driver_hw(int card, char **driver)
+{
+	return determine_driver(card, driver, 1);
 }
 #endif
 
@@ -850,7 +953,11 @@ static int parse_card(snd_config_t *root, snd_config_t *src,
 		SNDERR("field card is not an integer or a string");
 		return err;
 	}
-	card = snd_card_get_index(str);
+	card = -ENODEV;
+	if (isalpha((unsigned char)*str))
+		card = card_index_by_id(str);
+	if (card < 0)
+		card = snd_card_get_index(str);
 	if (card < 0)
 		SNDERR("cannot find card '%s'", str);
 	free(str);
@@ -949,7 +1056,6 @@ SND_DLSYM_BUILD_VERSION(snd_func_card_driver, SND_CONFIG_DLSYM_VERSION_EVALUATE)
 int snd_func_card_id(snd_config_t **dst, snd_config_t *root, snd_config_t *src,
 		     snd_config_t *private_data)
 {
-	snd_ctl_t *ctl = NULL;
 	snd_ctl_card_info_t info = {0};
 	const char *id;
 	int card, err;
@@ -957,23 +1063,13 @@ int snd_func_card_id(snd_config_t **dst, snd_config_t *root, snd_config_t *src,
 	card = parse_card(root, src, private_data);
 	if (card < 0)
 		return card;
-	err = open_ctl(card, &ctl);
-	if (err < 0) {
-		SNDERR("could not open control for card %i", card);
-		goto __error;
-	}
-	err = snd_ctl_card_info(ctl, &info);
-	if (err < 0) {
-		SNDERR("snd_ctl_card_info error: %s", snd_strerror(err));
-		goto __error;
-	}
+	err = card_info_query(card, &info, 1, 0);
+	if (err < 0)
+		return err;
 	err = snd_config_get_id(src, &id);
 	if (err >= 0)
 		err = snd_config_imake_string(dst, id,
 					      snd_ctl_card_info_get_id(&info));
-      __error:
-      	if (ctl)
-      		snd_ctl_close(ctl);
 	return err;
 }
 #ifndef DOC_HIDDEN
@@ -1000,7 +1096,6 @@ SND_DLSYM_BUILD_VERSION(snd_func_card_id, SND_CONFIG_DLSYM_VERSION_EVALUATE);
 int snd_func_card_name(snd_config_t **dst, snd_config_t *root,
 		       snd_config_t *src, snd_config_t *private_data)
 {
-	snd_ctl_t *ctl = NULL;
 	snd_ctl_card_info_t info = {0};
 	const char *id;
 	int card, err;
@@ -1008,23 +1103,13 @@ int snd_func_card_name(snd_config_t **dst, snd_config_t *root,
 	card = parse_card(root, src, private_data);
 	if (card < 0)
 		return card;
-	err = open_ctl(card, &ctl);
-	if (err < 0) {
-		SNDERR("could not open control for card %i", card);
-		goto __error;
-	}
-	err = snd_ctl_card_info(ctl, &info);
-	if (err < 0) {
-		SNDERR("snd_ctl_card_info error: %s", snd_strerror(err));
-		goto __error;
-	}
+	err = card_info_query(card, &info, 1, 0);
+	if (err < 0)
+		return err;
 	err = snd_config_get_id(src, &id);
 	if (err >= 0)
 		err = snd_config_imake_safe_string(dst, id,
 					snd_ctl_card_info_get_name(&info));
-      __error:
-      	if (ctl)
-      		snd_ctl_close(ctl);
 	return err;
 }
 #ifndef DOC_HIDDEN
@@ -31,8 +31,15 @@
 #include <string.h>
 #include <ctype.h>
 #include <fcntl.h>
+#include <dirent.h>
 #include <sys/ioctl.h>
 #include "control_local.h"
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #ifndef DOC_HIDDEN
 #define SND_FILE_CONTROL	ALSA_DEVICE_DIRECTORY "controlC%i"
@@ -75,6 +82,154 @@ static int snd_card_load1(int card)
 	return res;
 }
 
+/*
+ * The present cards are kept in a bitmap built from one scan of the
+ * device directory, only the existing control nodes are opened.  An
+ * inotify watch on the directory invalidates it when a node is created,
+ * removed or gets other permissions.  Without the watch (no inotify, no
+ * directory yet) the directory is scanned on every call.
+ */
+#define CARD_MASK_WORDS		((SND_MAX_CARDS + 31) / 32)
+
+static unsigned int card_mask[CARD_MASK_WORDS];
+static int card_mask_valid;
+#ifdef HAVE_SYS_INOTIFY_H
+static int card_inotify_fd = -1;	/* -2 = inotify is not available */
+#endif
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t card_mask_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline void card_mask_lock(void)
+{
+	pthread_mutex_lock(&card_mask_mutex);
+}
+
+static inline void card_mask_unlock(void)
+{
+	pthread_mutex_unlock(&card_mask_mutex);
+}
+#else
+static inline void card_mask_lock(void) {}
+static inline void card_mask_unlock(void) {}
+#endif
+
+static void card_dir_scan(const char *dir, const char *prefix, unsigned int *mask)
+{
+	size_t len = strlen(prefix);
+	struct dirent *de;
+	DIR *d;
+
+	d = opendir(dir);
+	if (d == NULL)
+		return;
+	while ((de = readdir(d)) != NULL) {
+		char *end;
+		long card;
+
+		if (strncmp(de->d_name, prefix, len))
+			continue;
+		card = strtol(de->d_name + len, &end, 10);
+		if (end == de->d_name + len || *end ||
+		    card < 0 || card >= SND_MAX_CARDS)
+			continue;
+		mask[card / 32] |= 1U << (card % 32);
+	}
+	closedir(d);
+}
+
+#ifdef HAVE_SYS_INOTIFY_H
+/* returns 1 when the directory may have changed since the last call */
+static int card_dir_changed(void)
+{
+	char buf[1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+	int changed = 0;
+	ssize_t len;
+	int fd;
+
+	if (card_inotify_fd == -2)
+		return 1;
+	if (card_inotify_fd < 0) {
+		/* watch before the scan, so that no change is missed */
+		fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (fd < 0) {
+			card_inotify_fd = -2;
+			return 1;
+		}
+		if (inotify_add_watch(fd, ALSA_DEVICE_DIRECTORY,
+				      IN_CREATE | IN_DELETE | IN_ATTRIB |
+				      IN_MOVED_FROM | IN_MOVED_TO |
+				      IN_DELETE_SELF | IN_MOVE_SELF) < 0) {
+			/* try again when the directory exists */
+			close(fd);
+			return 1;
+		}
+		card_inotify_fd = fd;
+		return 1;
+	}
+	while ((len = read(card_inotify_fd, buf, sizeof(buf))) > 0) {
+		const struct inotify_event *ev;
+		char *ptr;
+
+		changed = 1;
+		for (ptr = buf; ptr < buf + len; ptr += sizeof(*ev) + ev->len) {
+			ev = (const struct inotify_event *)ptr;
+			if (ev->mask & IN_IGNORED) {
+				/* the directory itself is gone */
+				close(card_inotify_fd);
+				card_inotify_fd = -1;
+				return 1;
+			}
+		}
+	}
+	return changed;
+}
+#else
+static inline int card_dir_changed(void)
+{
+	return 1;
+}
+#endif
+
+static void card_mask_update(void)
+{
+	unsigned int nodes[CARD_MASK_WORDS];
+	int card;
+
+	if (card_dir_changed())
+		card_mask_valid = 0;
+	if (card_mask_valid)
+		return;
+	memset(nodes, 0, sizeof(nodes));
+	card_dir_scan(ALSA_DEVICE_DIRECTORY, "controlC", nodes);
+#ifdef SUPPORT_ALOAD
+	card_dir_scan(ALOAD_DEVICE_DIRECTORY, "aloadC", nodes);
+#endif
+	memset(card_mask, 0, sizeof(card_mask));
+	for (card = 0; card < SND_MAX_CARDS; card++) {
+		if (!(nodes[card / 32] & (1U << (card % 32))))
+			continue;
+		if (snd_card_load1(card) >= 0)
+			card_mask[card / 32] |= 1U << (card % 32);
+	}
+#ifdef HAVE_SYS_INOTIFY_H
+	card_mask_valid = card_inotify_fd >= 0;
+#endif
+}
+
+/* returns the first present card from the given index or -1 */
+static int card_mask_next(int card)
+{
+	card_mask_lock();
+	card_mask_update();
+	for (; card < SND_MAX_CARDS; card++) {
+		if (card_mask[card / 32] & (1U << (card % 32)))
+			break;
+	}
+	card_mask_unlock();
+	return card < SND_MAX_CARDS ? card : -1;
+}
+
 /**
  * \brief Try to load the driver for a card.
  * \param card Card index.
@@ -113,13 +268,7 @@ int snd_card_next(int *rcard)
 		return -EINVAL;
 	card = *rcard;
 	card = card < 0 ? 0 : card + 1;
-	for (; card < SND_MAX_CARDS; card++) {
-		if (snd_card_load(card)) {
-			*rcard = card;
-			return 0;
-		}
-	}
-	*rcard = -1;
+	*rcard = card < SND_MAX_CARDS ? card_mask_next(card) : -1;
 	return 0;
 }
 
@@ -161,11 +310,7 @@ int snd_card_get_index(const char *string)
 		/* We got a device name */
 		return snd_card_load2(string);
 	/* We got in ID */
-	for (card = 0; card < SND_MAX_CARDS; card++) {
-#ifdef SUPPORT_ALOAD
-		if (! snd_card_load(card))
-			continue;
-#endif
+	for (card = card_mask_next(0); card >= 0; card = card_mask_next(card + 1)) {
 		if (snd_ctl_hw_open(&handle, NULL, card, 0) < 0)
 			continue;
 		if (snd_ctl_card_info(handle, &info) < 0) {
@@ -853,6 +853,140 @@ int snd_ctl_add_bytes_elem_set(snd_ctl_t *ctl, snd_ctl_elem_info_t *info,
 	return __snd_ctl_add_elem_set(ctl, info, element_count, member_count);
 }
 
+static int add_elem_set_desc(snd_ctl_t *ctl, snd_ctl_elem_set_desc_t *desc)
+{
+	static const snd_ctl_elem_value_t zero_data;
+	snd_ctl_elem_info_t *info = desc->info;
+	snd_ctl_elem_value_t data;
+	unsigned int i, j, numid;
+	int err;
+
+	if (info == NULL)
+		return -EINVAL;
+
+	switch (desc->type) {
+	case SND_CTL_ELEM_TYPE_BOOLEAN:
+		info->type = desc->type;
+		info->value.integer.min = 0;
+		info->value.integer.max = 1;
+		break;
+	case SND_CTL_ELEM_TYPE_INTEGER:
+		info->type = desc->type;
+		info->value.integer.min = desc->min;
+		info->value.integer.max = desc->max;
+		info->value.integer.step = desc->step;
+		break;
+	case SND_CTL_ELEM_TYPE_INTEGER64:
+		info->type = desc->type;
+		info->value.integer64.min = desc->min;
+		info->value.integer64.max = desc->max;
+		info->value.integer64.step = desc->step;
+		break;
+	case SND_CTL_ELEM_TYPE_BYTES:
+		info->type = desc->type;
+		break;
+	case SND_CTL_ELEM_TYPE_ENUMERATED:
+		break;
+	default:
+		return -EINVAL;
+	}
+	if (desc->type == SND_CTL_ELEM_TYPE_ENUMERATED)
+		err = snd_ctl_add_enumerated_elem_set(ctl, info,
+						      desc->element_count,
+						      desc->member_count,
+						      desc->items,
+						      desc->labels);
+	else
+		err = __snd_ctl_add_elem_set(ctl, info, desc->element_count,
+					     desc->member_count);
+	if (err < 0)
+		return err;
+	numid = snd_ctl_elem_id_get_numid(&info->id);
+
+	/* the numid is known, no lookup by name as in snd_ctl_tlv_do() */
+	if (desc->tlv) {
+		err = ctl->ops->element_tlv(ctl, 1, numid,
+					    (unsigned int *)desc->tlv,
+					    desc->tlv[SNDRV_CTL_TLVO_LEN] +
+					    2 * sizeof(unsigned int));
+		if (err < 0)
+			goto __error;
+	}
+
+	/*
+	 * The members of new user elements are zero, so only the values
+	 * differing from that are written.
+	 */
+	if (desc->value) {
+		data = *desc->value;
+		if (!memcmp(&data.value, &zero_data.value, sizeof(data.value)))
+			return 0;
+	} else if (desc->min != 0 &&
+		   (desc->type == SND_CTL_ELEM_TYPE_INTEGER ||
+		    desc->type == SND_CTL_ELEM_TYPE_INTEGER64)) {
+		data = zero_data;
+		for (j = 0; j < desc->member_count; j++) {
+			if (desc->type == SND_CTL_ELEM_TYPE_INTEGER)
+				data.value.integer.value[j] = desc->min;
+			else
+				data.value.integer64.value[j] = desc->min;
+		}
+	} else {
+		return 0;
+	}
+	data.id = info->id;
+	for (i = 0; i < desc->element_count; i++) {
+		snd_ctl_elem_id_set_numid(&data.id, numid + i);
+		err = ctl->ops->element_write(ctl, &data);
+		if (err < 0)
+			goto __error;
+	}
+	return 0;
+
+      __error:
+	ctl->ops->element_remove(ctl, &info->id);
+	return err;
+}
+
+/**
+ * \brief Create and add several sets of user-defined control elements.
+ * \param ctl A handle of backend module for control interface.
+ * \param descs An array of element set descriptors.
+ * \param count The number of entries in \a descs.
+ * \return The number of element sets created.
+ *
+ * This function creates the element sets described by \a descs, as the
+ * snd_ctl_add_*_elem_set() functions do for each type, and writes the
+ * optional TLV data and initial values.  The result of each entry is stored
+ * in its \a result field, and the ID of its first element in its \a info.
+ * An element set whose TLV or initial value cannot be written is removed
+ * again.
+ *
+ * The TLV and the values are written straight to the numid of the new
+ * elements, without looking them up by name first.  Values which equal
+ * the initial state of user elements (all members zero) are not written,
+ * so such element sets cost one operation and produce only the add
+ * events.  Without a \a value, integer members start at \a min as with
+ * snd_ctl_add_integer_elem_set().
+ *
+ * \par Compatibility:
+ * This function is added in version 1.2.8.
+ */
+int snd_ctl_add_elem_sets(snd_ctl_t *ctl, snd_ctl_elem_set_desc_t *descs,
+			  unsigned int count)
+{
+	unsigned int i, done = 0;
+
+	if (ctl == NULL || descs == NULL)
+		return -EINVAL;
+	for (i = 0; i < count; i++) {
+		descs[i].result = add_elem_set_desc(ctl, &descs[i]);
+		if (descs[i].result >= 0)
+			done++;
+	}
+	return done;
+}
+
 /**
  * \brief Create and add an user-defined control element of integer type.
  *
@@ -1033,6 +1167,70 @@ int snd_ctl_elem_write(snd_ctl_t *ctl, snd_ctl_elem_value_t *data)
 	return ctl->ops->element_write(ctl, data);
 }
 
+/**
+ * \brief Get values of several CTL elements.
+ *
+ * Works like snd_ctl_elem_read() for each of \p data in turn, but
+ * the backend may transfer them in fewer calls.
+ *
+ * \param ctl CTL handle.
+ * \param data Array of the element values, with the IDs set.
+ * \param count Count of the elements in \p data.
+ *
+ * \return The count of the values read, which is less than \p count
+ *         when an element failed, or the negative error code of the
+ *         first element.
+ */
+int snd_ctl_elem_read_multi(snd_ctl_t *ctl, snd_ctl_elem_value_t **data,
+			    unsigned int count)
+{
+	unsigned int k;
+	int err;
+
+	assert(ctl && (data || !count));
+	if (ctl->ops->element_read_multi)
+		return ctl->ops->element_read_multi(ctl, data, count);
+	for (k = 0; k < count; k++) {
+		assert(data[k]->id.name[0] || data[k]->id.numid);
+		err = ctl->ops->element_read(ctl, data[k]);
+		if (err < 0)
+			return k ? (int)k : err;
+	}
+	return count;
+}
+
+/**
+ * \brief Set values of several CTL elements.
+ *
+ * Works like snd_ctl_elem_write() for each of \p data in turn, but
+ * the backend may transfer them in fewer calls.
+ *
+ * \param ctl CTL handle.
+ * \param data Array of the new values, with the IDs set.
+ * \param count Count of the elements in \p data.
+ *
+ * \return The count of the values written, which is less than \p count
+ *         when an element failed, or the negative error code of the
+ *         first element.
+ */
+int snd_ctl_elem_write_multi(snd_ctl_t *ctl, snd_ctl_elem_value_t **data,
+			     unsigned int count)
+{
+	unsigned int k;
+	int err;
+
+	assert(ctl && (data || !count));
+	if (ctl->ops->element_write_multi)
+		return ctl->ops->element_write_multi(ctl, data, count);
+	for (k = 0; k < count; k++) {
+		assert(data[k]->id.name[0] || data[k]->id.numid);
+		err = ctl->ops->element_write(ctl, data[k]);
+		if (err < 0)
+			return k ? (int)k : err;
+	}
+	return count;
+}
+
 static int snd_ctl_tlv_do(snd_ctl_t *ctl, int op_flag,
 			  const snd_ctl_elem_id_t *id,
 		          unsigned int *tlv, unsigned int tlv_size)
@@ -1369,7 +1567,7 @@ int snd_async_add_ctl_handler(snd_async_handler_t **handler, snd_ctl_t *ctl,
 	h->u.ctl = ctl;
 	was_empty = list_empty(&ctl->async_handlers);
 	list_add_tail(&h->hlist, &ctl->async_handlers);
-	if (was_empty) {
+	if (was_empty && snd_async_get_delivery() == SND_ASYNC_SIGNAL) {
 		err = snd_ctl_async(ctl, snd_async_handler_get_signo(h), getpid());
 		if (err < 0) {
 			snd_async_del_handler(h);
@@ -1392,9 +1590,16 @@ snd_ctl_t *snd_async_handler_get_ctl(snd_async_handler_t *handler)
 }
 
 static const char *const build_in_ctls[] = {
-	"hw", "empty", "remap", "shm", NULL
+	"hw", "empty", "remap", "shm", "mirror", NULL
 };
 
+/* resolve the open functions of all CTL definitions (defaults.prelink) */
+int snd_ctl_open_prelink(snd_config_t *top)
+{
+	return snd_dlobj_cache_prelink(top, "ctl", build_in_ctls,
+			SND_DLSYM_VERSION(SND_CONTROL_DLSYM_VERSION));
+}
+
 static int snd_ctl_open_conf(snd_ctl_t **ctlp, const char *name,
 			     snd_config_t *ctl_root, snd_config_t *ctl_conf, int mode)
 {
@@ -1523,7 +1728,7 @@ static int snd_ctl_open_noupdate(snd_ctl_t **ctlp, snd_config_t *root,
 	snd_config_t *ctl_conf;
 	const char *str;
 
-	err = snd_config_search_definition(root, "ctl", name, &ctl_conf);
+	err = _snd_config_search_definition(root, "ctl", name, &ctl_conf, 1);
 	if (err < 0) {
 		SNDERR("Invalid CTL %s", name);
 		return err;
@@ -1531,8 +1736,9 @@ static int snd_ctl_open_noupdate(snd_ctl_t **ctlp, snd_config_t *root,
 	if (snd_config_get_string(ctl_conf, &str) >= 0)
 		err = snd_ctl_open_noupdate(ctlp, root, str, mode, hop + 1);
 	else {
-		snd_config_set_hop(ctl_conf, hop);
+		hop = snd_config_enter_hop(hop);
 		err = snd_ctl_open_conf(ctlp, name, root, ctl_conf, mode);
+		snd_config_leave_hop(hop);
 	}
 	snd_config_delete(ctl_conf);
 	return err;
@@ -1546,7 +1752,7 @@ int _snd_ctl_open_named_child(snd_ctl_t **pctl, const char *name,
 	const char *str;
 	int hop;
 
-	if ((hop = snd_config_check_hop(parent_conf)) < 0)
+	if ((hop = snd_config_open_hop()) < 0)
 		return hop;
 	if (snd_config_get_string(conf, &str) >= 0)
 		return snd_ctl_open_noupdate(pctl, root, str, mode, hop + 1);
@@ -39,18 +39,167 @@
 const char *_snd_module_control_ext = "";
 #endif
 
+/*
+ * Library side cache of a plugin with SND_CTL_EXT_FLAG_CACHE_*, so that
+ * the repeated info, TLV and value requests do not go to the plugin,
+ * which may be a proxy to a remote server.  The elements are indexed
+ * by the (fake) numid.
+ */
+struct ctl_ext_elem {
+	snd_ctl_elem_id_t id;
+	snd_ctl_ext_key_t key;		/* only when there is no free_key */
+	unsigned int key_valid: 1;
+	unsigned int info_valid: 1;
+	unsigned int value_valid: 1;
+	snd_ctl_elem_info_t info;
+	char (*names)[sizeof(((snd_ctl_elem_info_t *)0)->value.enumerated.name)];
+	snd_ctl_elem_value_t value;	/* only the value union is used */
+	unsigned int *tlv;
+	unsigned int tlv_len;		/* in bytes */
+};
+
+typedef struct {
+	snd_ctl_ext_t *data;
+	unsigned int flags;
+	int count;			/* -1 = elements not listed yet */
+	struct ctl_ext_elem *elems;
+} ctl_ext_priv_t;
+
+static inline snd_ctl_ext_t *ext_data(snd_ctl_t *handle)
+{
+	return ((ctl_ext_priv_t *)handle->private_data)->data;
+}
+
+static void cache_elem_flush(struct ctl_ext_elem *e)
+{
+	e->info_valid = 0;
+	e->value_valid = 0;
+	free(e->names);
+	e->names = NULL;
+	free(e->tlv);
+	e->tlv = NULL;
+}
+
+static void cache_clear(ctl_ext_priv_t *priv)
+{
+	int i;
+
+	for (i = 0; i < priv->count; i++)
+		cache_elem_flush(&priv->elems[i]);
+	free(priv->elems);
+	priv->elems = NULL;
+	priv->count = -1;
+}
+
+static int cache_build(ctl_ext_priv_t *priv)
+{
+	snd_ctl_ext_t *ext = priv->data;
+	int i, count, err;
+
+	count = ext->callback->elem_count(ext);
+	if (count < 0)
+		return count;
+	priv->elems = calloc(count ? count : 1, sizeof(*priv->elems));
+	if (priv->elems == NULL)
+		return -ENOMEM;
+	for (i = 0; i < count; i++) {
+		snd_ctl_elem_id_clear(&priv->elems[i].id);
+		err = ext->callback->elem_list(ext, i, &priv->elems[i].id);
+		if (err < 0) {
+			free(priv->elems);
+			priv->elems = NULL;
+			return err;
+		}
+		priv->elems[i].id.numid = i + 1;
+	}
+	priv->count = count;
+	return 0;
+}
+
+/* the cached element, NULL when caching is off or the id is unknown */
+static struct ctl_ext_elem *cache_find(ctl_ext_priv_t *priv,
+				       const snd_ctl_elem_id_t *id)
+{
+	struct ctl_ext_elem *e;
+	int i;
+
+	if (!priv->flags)
+		return NULL;
+	if (priv->count < 0 && cache_build(priv) < 0)
+		return NULL;
+	if (id->numid > 0) {
+		if (id->numid > (unsigned int)priv->count)
+			return NULL;
+		return &priv->elems[id->numid - 1];
+	}
+	for (i = 0; i < priv->count; i++) {
+		e = &priv->elems[i];
+		if (e->id.iface == id->iface && e->id.device == id->device &&
+		    e->id.subdevice == id->subdevice &&
+		    e->id.index == id->index &&
+		    !strcmp((const char *)e->id.name, (const char *)id->name))
+			return e;
+	}
+	return NULL;
+}
+
+static snd_ctl_ext_key_t cache_key(snd_ctl_ext_t *ext, struct ctl_ext_elem *e)
+{
+	snd_ctl_elem_id_t id;
+
+	/* allocated keys are released after each use, don't keep them */
+	if (ext->callback->free_key || !e->key_valid) {
+		id = e->id;
+		e->key = ext->callback->find_elem(ext, &id);
+		if (e->key == SND_CTL_EXT_KEY_NOT_FOUND)
+			return e->key;
+		e->key_valid = !ext->callback->free_key;
+	}
+	return e->key;
+}
+
+/* the values are valid only as long as their change events are read */
+static inline int cache_value_ok(ctl_ext_priv_t *priv, struct ctl_ext_elem *e)
+{
+	return (priv->flags & SND_CTL_EXT_FLAG_CACHE_VALUE) &&
+		priv->data->subscribed &&
+		!(e->info.access & SNDRV_CTL_ELEM_ACCESS_VOLATILE);
+}
+
+static size_t value_size(const snd_ctl_elem_info_t *info)
+{
+	switch (info->type) {
+	case SND_CTL_ELEM_TYPE_BOOLEAN:
+	case SND_CTL_ELEM_TYPE_INTEGER:
+		return info->count * sizeof(long);
+	case SND_CTL_ELEM_TYPE_INTEGER64:
+		return info->count * sizeof(long long);
+	case SND_CTL_ELEM_TYPE_ENUMERATED:
+		return info->count * sizeof(unsigned int);
+	case SND_CTL_ELEM_TYPE_BYTES:
+		return info->count;
+	case SND_CTL_ELEM_TYPE_IEC958:
+		return sizeof(snd_aes_iec958_t);
+	default:
+		return 0;
+	}
+}
+
 static int snd_ctl_ext_close(snd_ctl_t *handle)
 {
-	snd_ctl_ext_t *ext = handle->private_data;
+	ctl_ext_priv_t *priv = handle->private_data;
+	snd_ctl_ext_t *ext = priv->data;
 	
 	if (ext->callback->close)
 		ext->callback->close(ext);
+	cache_clear(priv);
+	free(priv);
 	return 0;
 }
 
 static int snd_ctl_ext_nonblock(snd_ctl_t *handle, int nonblock)
 {
-	snd_ctl_ext_t *ext = handle->private_data;
+	snd_ctl_ext_t *ext = ext_data(handle);
 
 	ext->nonblock = nonblock;
 	return 0;
@@ -65,11 +214,15 @@ static int snd_ctl_ext_async(snd_ctl_t *ctl ATTRIBUTE_UNUSED,
 
 static int snd_ctl_ext_subscribe_events(snd_ctl_t *handle, int subscribe)
 {
-	snd_ctl_ext_t *ext = handle->private_data;
+	ctl_ext_priv_t *priv = handle->private_data;
+	snd_ctl_ext_t *ext = priv->data;
+	int i;
 
 	if (subscribe < 0)
 		return ext->subscribed;
 	ext->subscribed = !!subscribe;
+	for (i = 0; !subscribe && i < priv->count; i++)
+		priv->elems[i].value_valid = 0;
 	if (ext->callback->subscribe_events)
 		ext->callback->subscribe_events(ext, subscribe);
 	return 0;
@@ -77,7 +230,7 @@ static int snd_ctl_ext_subscribe_events(snd_ctl_t *handle, int subscribe)
 
 static int snd_ctl_ext_card_info(snd_ctl_t *handle, snd_ctl_card_info_t *info)
 {
-	snd_ctl_ext_t *ext = handle->private_data;
+	snd_ctl_ext_t *ext = ext_data(handle);
 
 	memset(info, 0, sizeof(*info));
 	info->card = ext->card_idx;
@@ -91,11 +244,27 @@ static int snd_ctl_ext_card_info(snd_ctl_t *handle, snd_ctl_card_info_t *info)
 
 static int snd_ctl_ext_elem_list(snd_ctl_t *handle, snd_ctl_elem_list_t *list)
 {
-	snd_ctl_ext_t *ext = handle->private_data;
+	ctl_ext_priv_t *priv = handle->private_data;
+	snd_ctl_ext_t *ext = priv->data;
 	int ret;
 	unsigned int i, offset;
 	snd_ctl_elem_id_t *ids;
 
+	if (priv->flags) {
+		if (priv->count < 0) {
+			ret = cache_build(priv);
+			if (ret < 0)
+				return ret;
+		}
+		list->count = priv->count;
+		list->used = 0;
+		for (i = 0, offset = list->offset;
+		     i < list->space && offset < list->count; i++, offset++) {
+			list->pids[i] = priv->elems[offset].id;
+			list->used++;
+		}
+		return 0;
+	}
 	list->count = ext->callback->elem_count(ext);
 	list->used = 0;
 	ids = list->pids;
@@ -126,15 +295,11 @@ static snd_ctl_ext_key_t get_elem(snd_ctl_ext_t *ext, snd_ctl_elem_id_t *id)
 	return ext->callback->find_elem(ext, id);
 }
 
-static int snd_ctl_ext_elem_info(snd_ctl_t *handle, snd_ctl_elem_info_t *info)
+static int ext_elem_info(snd_ctl_ext_t *ext, snd_ctl_ext_key_t key,
+			 snd_ctl_elem_info_t *info)
 {
-	snd_ctl_ext_t *ext = handle->private_data;
-	snd_ctl_ext_key_t key;
 	int type, ret;
 
-	key = get_elem(ext, &info->id);
-	if (key == SND_CTL_EXT_KEY_NOT_FOUND)
-		return -ENOENT;
 	ret = ext->callback->get_attribute(ext, key, &type, &info->access, &info->count);
 	if (ret < 0)
 		goto err;
@@ -180,6 +345,89 @@ static int snd_ctl_ext_elem_info(snd_ctl_t *handle, snd_ctl_elem_info_t *info)
 		break;
 	}
 
+ err:
+	return ret;
+}
+
+static int cache_info(snd_ctl_ext_t *ext, struct ctl_ext_elem *e,
+		      snd_ctl_ext_key_t key)
+{
+	unsigned int i, items;
+	int ret;
+
+	cache_elem_flush(e);
+	memset(&e->info, 0, sizeof(e->info));
+	e->info.id = e->id;
+	ret = ext_elem_info(ext, key, &e->info);
+	if (ret < 0)
+		return ret;
+	if (e->info.type == SND_CTL_ELEM_TYPE_ENUMERATED) {
+		items = e->info.value.enumerated.items;
+		e->names = calloc(items ? items : 1, sizeof(*e->names));
+		if (e->names == NULL)
+			return -ENOMEM;
+		for (i = 0; i < items; i++)
+			ext->callback->get_enumerated_name(ext, key, i, e->names[i],
+							   sizeof(e->names[i]));
+	}
+	e->info_valid = 1;
+	return 0;
+}
+
+/*
+ * resolve the id as get_elem() does, through the cache when it is on;
+ * *ep is the cache entry or NULL
+ */
+static snd_ctl_ext_key_t lookup_elem(ctl_ext_priv_t *priv, snd_ctl_elem_id_t *id,
+				     struct ctl_ext_elem **ep)
+{
+	struct ctl_ext_elem *e = cache_find(priv, id);
+
+	*ep = e;
+	if (e == NULL)
+		return get_elem(priv->data, id);
+	if (id->numid > 0)
+		*id = e->id;
+	return cache_key(priv->data, e);
+}
+
+static int snd_ctl_ext_elem_info(snd_ctl_t *handle, snd_ctl_elem_info_t *info)
+{
+	ctl_ext_priv_t *priv = handle->private_data;
+	snd_ctl_ext_t *ext = priv->data;
+	struct ctl_ext_elem *e;
+	snd_ctl_ext_key_t key;
+	snd_ctl_elem_id_t id;
+	unsigned int item;
+	int ret;
+
+	key = lookup_elem(priv, &info->id, &e);
+	if (key == SND_CTL_EXT_KEY_NOT_FOUND)
+		return -ENOENT;
+	if (e == NULL) {
+		ret = ext_elem_info(ext, key, info);
+		goto err;
+	}
+	if (!e->info_valid) {
+		ret = cache_info(ext, e, key);
+		if (ret < 0)
+			goto err;
+	}
+	id = info->id;
+	item = info->value.enumerated.item;
+	*info = e->info;
+	info->id = id;
+	ret = 0;
+	if (info->type == SND_CTL_ELEM_TYPE_ENUMERATED) {
+		info->value.enumerated.item = item;
+		if (item < info->value.enumerated.items)
+			strcpy(info->value.enumerated.name, e->names[item]);
+		else
+			ext->callback->get_enumerated_name(ext, key, item,
+							   info->value.enumerated.name,
+							   sizeof(info->value.enumerated.name));
+	}
+
  err:
 	if (ext->callback->free_key)
 		ext->callback->free_key(ext, key);
@@ -207,17 +455,33 @@ static int snd_ctl_ext_elem_remove(snd_ctl_t *handle ATTRIBUTE_UNUSED,
 
 static int snd_ctl_ext_elem_read(snd_ctl_t *handle, snd_ctl_elem_value_t *control)
 {
-	snd_ctl_ext_t *ext = handle->private_data;
+	ctl_ext_priv_t *priv = handle->private_data;
+	snd_ctl_ext_t *ext = priv->data;
+	struct ctl_ext_elem *e;
 	snd_ctl_ext_key_t key;
 	int type, ret;
 	unsigned int access, count;
 
-	key = get_elem(ext, &control->id);
+	key = lookup_elem(priv, &control->id, &e);
 	if (key == SND_CTL_EXT_KEY_NOT_FOUND)
 		return -ENOENT;
-	ret = ext->callback->get_attribute(ext, key, &type, &access, &count);
-	if (ret < 0)
-		goto err;
+	if (e) {
+		if (!e->info_valid) {
+			ret = cache_info(ext, e, key);
+			if (ret < 0)
+				goto err;
+		}
+		if (e->value_valid) {
+			control->value = e->value.value;
+			ret = 0;
+			goto err;
+		}
+		type = e->info.type;
+	} else {
+		ret = ext->callback->get_attribute(ext, key, &type, &access, &count);
+		if (ret < 0)
+			goto err;
+	}
 	ret = -EINVAL;
 	switch (type) {
 	case SND_CTL_ELEM_TYPE_BOOLEAN:
@@ -251,6 +515,10 @@ static int snd_ctl_ext_elem_read(snd_ctl_t *handle, snd_ctl_elem_value_t *contro
 	default:
 		break;
 	}
+	if (e && ret >= 0 && cache_value_ok(priv, e)) {
+		e->value.value = control->value;
+		e->value_valid = 1;
+	}
 
  err:
 	if (ext->callback->free_key)
@@ -261,17 +529,36 @@ static int snd_ctl_ext_elem_read(snd_ctl_t *handle, snd_ctl_elem_value_t *contro
 
 static int snd_ctl_ext_elem_write(snd_ctl_t *handle, snd_ctl_elem_value_t *control)
 {
-	snd_ctl_ext_t *ext = handle->private_data;
+	ctl_ext_priv_t *priv = handle->private_data;
+	snd_ctl_ext_t *ext = priv->data;
+	struct ctl_ext_elem *e;
 	snd_ctl_ext_key_t key;
 	int type, ret;
 	unsigned int access, count;
+	size_t size;
 
-	key = get_elem(ext, &control->id);
+	key = lookup_elem(priv, &control->id, &e);
 	if (key == SND_CTL_EXT_KEY_NOT_FOUND)
 		return -ENOENT;
-	ret = ext->callback->get_attribute(ext, key, &type, &access, &count);
-	if (ret < 0)
-		goto err;
+	if (e) {
+		if (!e->info_valid) {
+			ret = cache_info(ext, e, key);
+			if (ret < 0)
+				goto err;
+		}
+		/* writing the current value again changes nothing */
+		size = value_size(&e->info);
+		if (e->value_valid && size > 0 &&
+		    !memcmp(&e->value.value, &control->value, size)) {
+			ret = 0;
+			goto err;
+		}
+		type = e->info.type;
+	} else {
+		ret = ext->callback->get_attribute(ext, key, &type, &access, &count);
+		if (ret < 0)
+			goto err;
+	}
 	ret = -EINVAL;
 	switch (type) {
 	case SND_CTL_ELEM_TYPE_BOOLEAN:
@@ -304,6 +591,11 @@ static int snd_ctl_ext_elem_write(snd_ctl_t *handle, snd_ctl_elem_value_t *contr
 	default:
 		break;
 	}
+	if (e) {
+		e->value_valid = ret >= 0 && cache_value_ok(priv, e);
+		if (e->value_valid)
+			e->value.value = control->value;
+	}
 
  err:
 	if (ext->callback->free_key)
@@ -328,7 +620,9 @@ static int snd_ctl_ext_elem_tlv(snd_ctl_t *handle, int op_flag,
 				unsigned int numid,
 				unsigned int *tlv, unsigned int tlv_size)
 {
-	snd_ctl_ext_t *ext = handle->private_data;
+	ctl_ext_priv_t *priv = handle->private_data;
+	snd_ctl_ext_t *ext = priv->data;
+	struct ctl_ext_elem *e = NULL;
 	snd_ctl_ext_key_t key;
 	int type, ret;
 	unsigned int access, count, len;
@@ -339,25 +633,60 @@ static int snd_ctl_ext_elem_tlv(snd_ctl_t *handle, int op_flag,
 		return -ENXIO;
 
 	snd_ctl_elem_id_clear(&id);
-	if (numid > 0) {
-		ext->callback->elem_list(ext, numid - 1, &id);
-		id.numid = numid;
-	} else
-		id.numid = 0;
-	key = ext->callback->find_elem(ext, &id);
+	id.numid = numid;
+	if (numid > 0)
+		e = cache_find(priv, &id);
+	if (e) {
+		key = cache_key(ext, e);
+		if (key == SND_CTL_EXT_KEY_NOT_FOUND)
+			return -ENOENT;
+		if (!e->info_valid) {
+			ret = cache_info(ext, e, key);
+			if (ret < 0)
+				return ret;
+		}
+		access = e->info.access;
+	} else {
+		if (numid > 0) {
+			ext->callback->elem_list(ext, numid - 1, &id);
+			id.numid = numid;
+		}
+		key = ext->callback->find_elem(ext, &id);
 
-	if (key == SND_CTL_EXT_KEY_NOT_FOUND)
-		return -ENOENT;
-	ret = ext->callback->get_attribute(ext, key, &type, &access, &count);
-	if (ret < 0)
-		return ret;
+		if (key == SND_CTL_EXT_KEY_NOT_FOUND)
+			return -ENOENT;
+		ret = ext->callback->get_attribute(ext, key, &type, &access, &count);
+		if (ret < 0)
+			return ret;
+	}
 
 	if ((op_flag == 0 && (access & SND_CTL_EXT_ACCESS_TLV_READ) == 0) ||
 	    (op_flag > 0 && (access & SND_CTL_EXT_ACCESS_TLV_WRITE) == 0) ||
 	    (op_flag < 0 && (access & SND_CTL_EXT_ACCESS_TLV_COMMAND) == 0))
 		return -ENXIO;
 	if (access & SNDRV_CTL_ELEM_ACCESS_TLV_CALLBACK) {
-		return ext->tlv.c(ext, key, op_flag, numid, tlv, tlv_size);
+		if (e == NULL)
+			return ext->tlv.c(ext, key, op_flag, numid, tlv, tlv_size);
+		if (op_flag == 0 && e->tlv) {
+			if (tlv_size < e->tlv_len)
+				return -ENOMEM;
+			memcpy(tlv, e->tlv, e->tlv_len);
+			return 0;
+		}
+		ret = ext->tlv.c(ext, key, op_flag, numid, tlv, tlv_size);
+		free(e->tlv);
+		e->tlv = NULL;
+		if (op_flag == 0 && ret >= 0) {
+			len = tlv[SNDRV_CTL_TLVO_LEN] + 2 * sizeof(unsigned int);
+			if (len <= tlv_size) {
+				e->tlv = malloc(len);
+				if (e->tlv) {
+					memcpy(e->tlv, tlv, len);
+					e->tlv_len = len;
+				}
+			}
+		}
+		return ret;
 	} else {
 		if (op_flag)
 			return -ENXIO;
@@ -411,13 +740,42 @@ static int snd_ctl_ext_get_power_state(snd_ctl_t *handle ATTRIBUTE_UNUSED,
 	return 0;
 }
 
+static void cache_event(ctl_ext_priv_t *priv, const snd_ctl_elem_id_t *id,
+			unsigned int mask)
+{
+	struct ctl_ext_elem *e;
+
+	if (mask == SND_CTL_EVENT_MASK_REMOVE || (mask & SND_CTL_EVENT_MASK_ADD)) {
+		cache_clear(priv);
+		return;
+	}
+	e = cache_find(priv, id);
+	if (e == NULL)
+		return;
+	if (mask & SND_CTL_EVENT_MASK_INFO) {
+		cache_elem_flush(e);
+		return;
+	}
+	if (mask & SND_CTL_EVENT_MASK_VALUE)
+		e->value_valid = 0;
+	if (mask & SND_CTL_EVENT_MASK_TLV) {
+		free(e->tlv);
+		e->tlv = NULL;
+	}
+}
+
 static int snd_ctl_ext_read(snd_ctl_t *handle, snd_ctl_event_t *event)
 {
-	snd_ctl_ext_t *ext = handle->private_data;
+	ctl_ext_priv_t *priv = handle->private_data;
+	snd_ctl_ext_t *ext = priv->data;
+	int ret;
 
 	if (ext->callback->read_event) {
 		memset(event, 0, sizeof(*event));
-		return ext->callback->read_event(ext, &event->data.elem.id, &event->data.elem.mask);
+		ret = ext->callback->read_event(ext, &event->data.elem.id, &event->data.elem.mask);
+		if (ret > 0 && priv->count >= 0)
+			cache_event(priv, &event->data.elem.id, event->data.elem.mask);
+		return ret;
 	}
 
 	return -EINVAL;
@@ -425,7 +783,7 @@ static int snd_ctl_ext_read(snd_ctl_t *handle, snd_ctl_event_t *event)
 
 static int snd_ctl_ext_poll_descriptors_count(snd_ctl_t *handle)
 {
-	snd_ctl_ext_t *ext = handle->private_data;
+	snd_ctl_ext_t *ext = ext_data(handle);
 
 	if (ext->callback->poll_descriptors_count)
 		return ext->callback->poll_descriptors_count(ext);
@@ -436,7 +794,7 @@ static int snd_ctl_ext_poll_descriptors_count(snd_ctl_t *handle)
 
 static int snd_ctl_ext_poll_descriptors(snd_ctl_t *handle, struct pollfd *pfds, unsigned int space)
 {
-	snd_ctl_ext_t *ext = handle->private_data;
+	snd_ctl_ext_t *ext = ext_data(handle);
 
 	if (ext->callback->poll_descriptors)
 		return ext->callback->poll_descriptors(ext, pfds, space);
@@ -452,7 +810,7 @@ static int snd_ctl_ext_poll_descriptors(snd_ctl_t *handle, struct pollfd *pfds,
 
 static int snd_ctl_ext_poll_revents(snd_ctl_t *handle, struct pollfd *pfds, unsigned int nfds, unsigned short *revents)
 {
-	snd_ctl_ext_t *ext = handle->private_data;
+	snd_ctl_ext_t *ext = ext_data(handle);
 
 	if (ext->callback->poll_revents)
 		return ext->callback->poll_revents(ext, pfds, nfds, revents);
@@ -707,6 +1065,7 @@ The poll_revents callback is used for handle poll revents.
  */
 int snd_ctl_ext_create(snd_ctl_ext_t *ext, const char *name, int mode)
 {
+	ctl_ext_priv_t *priv;
 	snd_ctl_t *ctl;
 	int err;
 
@@ -716,14 +1075,27 @@ int snd_ctl_ext_create(snd_ctl_ext_t *ext, const char *name, int mode)
 		return -ENXIO;
 	}
 
+	priv = calloc(1, sizeof(*priv));
+	if (priv == NULL)
+		return -ENOMEM;
+	priv->data = ext;
+	priv->count = -1;
+	/* the flags field exists since protocol 1.0.2 */
+	if (ext->version >= SNDRV_PROTOCOL_VERSION(1, 0, 2))
+		priv->flags = ext->flags;
+	if (priv->flags & SND_CTL_EXT_FLAG_CACHE_VALUE)
+		priv->flags |= SND_CTL_EXT_FLAG_CACHE_INFO;
+
 	err = snd_ctl_new(&ctl, SND_CTL_TYPE_EXT, name);
-	if (err < 0)
+	if (err < 0) {
+		free(priv);
 		return err;
+	}
 
 	ext->handle = ctl;
 
 	ctl->ops = &snd_ctl_ext_ops;
-	ctl->private_data = ext;
+	ctl->private_data = priv;
 	ctl->poll_fd = ext->poll_fd;
 	if (mode & SND_CTL_NONBLOCK)
 		ext->nonblock = 1;
@@ -201,6 +201,38 @@ static int snd_ctl_hw_elem_write(snd_ctl_t *handle, snd_ctl_elem_value_t *contro
 	return 0;
 }
 
+/*
+ * The kernel has no batched value ioctl, so these only save the
+ * dispatch through the ops for each element.
+ */
+static int snd_ctl_hw_elem_read_multi(snd_ctl_t *handle,
+				      snd_ctl_elem_value_t **controls,
+				      unsigned int count)
+{
+	snd_ctl_hw_t *hw = handle->private_data;
+	unsigned int k;
+
+	for (k = 0; k < count; k++) {
+		if (ioctl(hw->fd, SNDRV_CTL_IOCTL_ELEM_READ, controls[k]) < 0)
+			return k ? (int)k : -errno;
+	}
+	return count;
+}
+
+static int snd_ctl_hw_elem_write_multi(snd_ctl_t *handle,
+				       snd_ctl_elem_value_t **controls,
+				       unsigned int count)
+{
+	snd_ctl_hw_t *hw = handle->private_data;
+	unsigned int k;
+
+	for (k = 0; k < count; k++) {
+		if (ioctl(hw->fd, SNDRV_CTL_IOCTL_ELEM_WRITE, controls[k]) < 0)
+			return k ? (int)k : -errno;
+	}
+	return count;
+}
+
 static int snd_ctl_hw_elem_lock(snd_ctl_t *handle, snd_ctl_elem_id_t *id)
 {
 	snd_ctl_hw_t *hw = handle->private_data;
@@ -368,6 +400,8 @@ static const snd_ctl_ops_t snd_ctl_hw_ops = {
 	.element_remove = snd_ctl_hw_elem_remove,
 	.element_read = snd_ctl_hw_elem_read,
 	.element_write = snd_ctl_hw_elem_write,
+	.element_read_multi = snd_ctl_hw_elem_read_multi,
+	.element_write_multi = snd_ctl_hw_elem_write_multi,
 	.element_lock = snd_ctl_hw_elem_lock,
 	.element_unlock = snd_ctl_hw_elem_unlock,
 	.element_tlv = snd_ctl_hw_elem_tlv,
@@ -53,6 +53,9 @@ typedef struct _snd_ctl_ops {
 	int (*poll_descriptors_count)(snd_ctl_t *handle);
 	int (*poll_descriptors)(snd_ctl_t *handle, struct pollfd *pfds, unsigned int space);
 	int (*poll_revents)(snd_ctl_t *handle, struct pollfd *pfds, unsigned int nfds, unsigned short *revents);
+	/* optional, snd_ctl_elem_read_multi() loops over element_read otherwise */
+	int (*element_read_multi)(snd_ctl_t *handle, snd_ctl_elem_value_t **controls, unsigned int count);
+	int (*element_write_multi)(snd_ctl_t *handle, snd_ctl_elem_value_t **controls, unsigned int count);
 } snd_ctl_ops_t;
 
 
@@ -76,6 +79,13 @@ struct _snd_hctl_elem {
 	void *callback_private;
 	/* links */
 	snd_hctl_t *hctl;		/* associated handle */
+	snd_hctl_elem_t *hash_next;	/* next element in the same hash bucket */
+	struct snd_hctl_elem_info_cache *info;	/* info read so far, or NULL */
+	struct snd_hctl_elem_db_cache *db;	/* parsed dB TLV, or NULL */
+	/* coalesced events */
+	struct list_head dirty_list;	/* link in the hctl dirty list */
+	unsigned int dirty;		/* events not dispatched yet */
+	unsigned long long stamp;	/* time of the last dispatch (usec) */
 };
 
 struct _snd_hctl {
@@ -84,9 +94,16 @@ struct _snd_hctl {
 	unsigned int alloc;	
 	unsigned int count;
 	snd_hctl_elem_t **pelems;
+	snd_hctl_elem_t **numids;	/* elements indexed by numid */
+	unsigned int numids_alloc;
+	snd_hctl_elem_t **hash;		/* elements hashed by their id fields */
+	unsigned int hash_size;		/* zero or a power of two */
 	snd_hctl_compare_t compare;
 	snd_hctl_callback_t callback;
 	void *callback_private;
+	struct list_head dirty;		/* elements with coalesced events */
+	int coalesce;			/* coalesce element events */
+	unsigned int coalesce_interval;	/* min. usec between element callbacks */
 };
 
 
@@ -98,6 +115,7 @@ int _snd_ctl_poll_descriptor(snd_ctl_t *ctl);
 #define _snd_ctl_async_descriptor _snd_ctl_poll_descriptor
 int snd_ctl_hw_open(snd_ctl_t **handle, const char *name, int card, int mode);
 int snd_ctl_shm_open(snd_ctl_t **handlep, const char *name, const char *sockname, const char *sname, int mode);
+int snd_ctl_mirror_open(snd_ctl_t **handlep, const char *name, int card, int mode);
 int snd_ctl_async(snd_ctl_t *ctl, int sig, pid_t pid);
 
 #define CTLINABORT(x) ((x)->nonblock == 2)
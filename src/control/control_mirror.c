@@ -0,0 +1,969 @@
+/**
+ * \file control/control_mirror.c
+ * \brief CTL Mirror Plugin Interface
+ * \date 2026
+ */
+/*
+ *  Control - Shared memory mirror of the control values
+ *
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+#include "control_local.h"
+
+#ifndef PIC
+/* entry for static linking */
+const char *_snd_module_control_mirror = "";
+#endif
+
+#ifndef DOC_HIDDEN
+#define MIRROR_MAGIC	0x4d435441	/* ATCM */
+#define MIRROR_RING	256		/* events kept for the clients */
+#define MIRROR_SPARE	32		/* free slots for added elements */
+#define MIRROR_RETRY	1000		/* standby poll interval (ms) */
+#define MIRROR_TRIES	64		/* attempts for a consistent read */
+
+/*
+ * The segment is written by one publisher per card and mapped read-only
+ * by the clients.  The element table is guarded by the generation and
+ * each value by its own seq; both are odd while being written, so the
+ * readers retry (or fall back to the kernel) instead of taking a lock.
+ */
+typedef struct {
+	unsigned int seq;		/* odd while the value is written */
+	unsigned int valid;		/* the value could be read */
+	snd_ctl_elem_id_t id;
+	snd_ctl_elem_value_t value;
+} snd_ctl_mirror_elem_t;
+
+typedef struct {
+	unsigned int mask;
+	snd_ctl_elem_id_t id;
+} snd_ctl_mirror_event_t;
+
+typedef struct {
+	unsigned int magic;
+	unsigned int generation;	/* odd while the table is rebuilt */
+	unsigned int size;		/* size of the segment in bytes */
+	unsigned int capacity;		/* element slots */
+	unsigned int count;		/* used slots, sorted by numid */
+	unsigned int head;		/* events written to the ring so far */
+	snd_ctl_mirror_event_t ring[MIRROR_RING];
+	snd_ctl_mirror_elem_t elems[];
+} snd_ctl_mirror_shm_t;
+
+typedef struct {
+	snd_ctl_t *child;		/* hw handle for everything but values */
+	int card;
+	int nonblock;
+	int shm_fd;
+	const snd_ctl_mirror_shm_t *shm;	/* read-only mapping */
+	size_t shm_size;
+	int event_fd;			/* wakes up the client */
+	int quit_fd;			/* stops the thread */
+	pthread_t thread;
+	int subscribed;
+	unsigned int head;		/* next ring event to deliver */
+	int resync;			/* set by the thread, all values changed */
+	int resyncing;
+	unsigned int resync_pos;
+	char shm_name[64];
+	struct sockaddr_un addr;
+	socklen_t addr_len;
+} snd_ctl_mirror_t;
+
+typedef struct {
+	snd_ctl_t *ctl;
+	snd_ctl_mirror_shm_t *shm;	/* writable mapping */
+	size_t size;
+	int listen_fd;
+	int *clients;
+	unsigned int clients_count;
+	unsigned int clients_alloc;
+} snd_ctl_mirror_pub_t;
+#endif
+
+static void mirror_seq_begin(unsigned int *seq)
+{
+	__atomic_store_n(seq, *seq | 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void mirror_seq_end(unsigned int *seq)
+{
+	__atomic_store_n(seq, (*seq | 1) + 1, __ATOMIC_RELEASE);
+}
+
+static ssize_t mirror_find(const snd_ctl_mirror_elem_t *elems, unsigned int count,
+			   unsigned int numid)
+{
+	unsigned int lo = 0, hi = count, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (elems[mid].id.numid == numid)
+			return mid;
+		if (elems[mid].id.numid < numid)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return -1;
+}
+
+/*
+ * client side
+ */
+
+/* map the segment or follow its growth, 0 when there is a table */
+static int mirror_map(snd_ctl_mirror_t *priv)
+{
+	struct stat st;
+	void *ptr;
+
+	if (priv->shm && priv->shm->size <= priv->shm_size)
+		return priv->shm->magic == MIRROR_MAGIC ? 0 : -EAGAIN;
+	if (fstat(priv->shm_fd, &st) < 0)
+		return -errno;
+	if ((size_t)st.st_size < sizeof(snd_ctl_mirror_shm_t))
+		return -EAGAIN;
+	ptr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, priv->shm_fd, 0);
+	if (ptr == MAP_FAILED)
+		return -errno;
+	if (priv->shm) {
+		munmap((void *)priv->shm, priv->shm_size);
+	} else {
+		/* the first mapping starts with the current events */
+		priv->head = __atomic_load_n(&((snd_ctl_mirror_shm_t *)ptr)->head,
+					     __ATOMIC_ACQUIRE);
+	}
+	priv->shm = ptr;
+	priv->shm_size = st.st_size;
+	return priv->shm->magic == MIRROR_MAGIC ? 0 : -EAGAIN;
+}
+
+/* the count of the slots covered by the current mapping */
+static unsigned int mirror_count(snd_ctl_mirror_t *priv)
+{
+	unsigned int count = __atomic_load_n(&priv->shm->count, __ATOMIC_RELAXED);
+	size_t max = (priv->shm_size - sizeof(snd_ctl_mirror_shm_t)) /
+		     sizeof(snd_ctl_mirror_elem_t);
+
+	return count < max ? count : max;
+}
+
+/* copy the published value, 0 when the kernel must be asked */
+static int mirror_read_value(snd_ctl_mirror_t *priv, snd_ctl_elem_value_t *control)
+{
+	const snd_ctl_mirror_shm_t *shm;
+	const snd_ctl_mirror_elem_t *elem;
+	unsigned int gen, seq, tries;
+	ssize_t idx;
+
+	if (control->id.numid == 0 || mirror_map(priv) < 0)
+		return 0;
+	shm = priv->shm;
+	for (tries = 0; tries < MIRROR_TRIES; tries++) {
+		gen = __atomic_load_n(&shm->generation, __ATOMIC_ACQUIRE);
+		if (gen & 1)
+			return 0;
+		idx = mirror_find(shm->elems, mirror_count(priv), control->id.numid);
+		if (idx < 0)
+			return 0;
+		elem = &shm->elems[idx];
+		seq = __atomic_load_n(&elem->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+		if (!elem->valid)
+			return 0;
+		*control = elem->value;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&elem->seq, __ATOMIC_RELAXED) == seq &&
+		    __atomic_load_n(&shm->generation, __ATOMIC_RELAXED) == gen)
+			return 1;
+	}
+	return 0;
+}
+
+/* next event from the ring, 0 if there is none */
+static int mirror_next_event(snd_ctl_mirror_t *priv, snd_ctl_event_t *event)
+{
+	const snd_ctl_mirror_shm_t *shm = priv->shm;
+	snd_ctl_mirror_event_t ev;
+	unsigned int head;
+
+	if (__atomic_exchange_n(&priv->resync, 0, __ATOMIC_ACQ_REL)) {
+		priv->resyncing = 1;
+		priv->resync_pos = 0;
+	}
+	for (;;) {
+		if (priv->resyncing) {
+			if (priv->resync_pos < mirror_count(priv)) {
+				memset(event, 0, sizeof(*event));
+				event->type = SND_CTL_EVENT_ELEM;
+				event->data.elem.mask = SNDRV_CTL_EVENT_MASK_VALUE;
+				event->data.elem.id = shm->elems[priv->resync_pos++].id;
+				return 1;
+			}
+			priv->resyncing = 0;
+		}
+		head = __atomic_load_n(&shm->head, __ATOMIC_ACQUIRE);
+		if (head == priv->head)
+			return 0;
+		if (head - priv->head <= MIRROR_RING) {
+			ev = shm->ring[priv->head % MIRROR_RING];
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			/* the slot is reused by the event priv->head + MIRROR_RING */
+			head = __atomic_load_n(&shm->head, __ATOMIC_RELAXED);
+			if (head - priv->head < MIRROR_RING) {
+				priv->head++;
+				memset(event, 0, sizeof(*event));
+				event->type = SND_CTL_EVENT_ELEM;
+				event->data.elem.mask = ev.mask;
+				event->data.elem.id = ev.id;
+				return 1;
+			}
+		}
+		/* overrun, report every element as changed */
+		priv->head = head;
+		priv->resyncing = 1;
+		priv->resync_pos = 0;
+	}
+}
+
+static int snd_ctl_mirror_read(snd_ctl_t *ctl, snd_ctl_event_t *event)
+{
+	snd_ctl_mirror_t *priv = ctl->private_data;
+	struct pollfd pfd;
+	eventfd_t val;
+
+	for (;;) {
+		if (priv->subscribed && mirror_map(priv) == 0) {
+			if (mirror_next_event(priv, event))
+				return 1;
+			/* clear the wakeup, then look once more for a race */
+			eventfd_read(priv->event_fd, &val);
+			if (mirror_next_event(priv, event))
+				return 1;
+		} else {
+			eventfd_read(priv->event_fd, &val);
+		}
+		if (priv->nonblock)
+			return -EAGAIN;
+		pfd.fd = priv->event_fd;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+			return -errno;
+	}
+}
+
+static int snd_ctl_mirror_elem_read(snd_ctl_t *ctl, snd_ctl_elem_value_t *control)
+{
+	snd_ctl_mirror_t *priv = ctl->private_data;
+
+	if (mirror_read_value(priv, control))
+		return 0;
+	return snd_ctl_elem_read(priv->child, control);
+}
+
+static int snd_ctl_mirror_subscribe_events(snd_ctl_t *ctl, int subscribe)
+{
+	snd_ctl_mirror_t *priv = ctl->private_data;
+
+	if (subscribe < 0)
+		return priv->subscribed;
+	subscribe = !!subscribe;
+	if (subscribe && !priv->subscribed && mirror_map(priv) == 0)
+		priv->head = __atomic_load_n(&priv->shm->head, __ATOMIC_ACQUIRE);
+	priv->subscribed = subscribe;
+	return 0;
+}
+
+/*
+ * publisher side, runs in the thread of the process holding the lock
+ */
+
+static int mirror_pub_map(snd_ctl_mirror_t *priv, snd_ctl_mirror_pub_t *pub,
+			  size_t need)
+{
+	struct stat st;
+	void *ptr;
+
+	if (fstat(priv->shm_fd, &st) < 0)
+		return -errno;
+	if ((size_t)st.st_size < need) {
+		if (ftruncate(priv->shm_fd, need) < 0)
+			return -errno;
+		st.st_size = need;
+	}
+	if (pub->shm && pub->size == (size_t)st.st_size)
+		return 0;
+	ptr = mmap(NULL, st.st_size, PROT_READ|PROT_WRITE, MAP_SHARED,
+		   priv->shm_fd, 0);
+	if (ptr == MAP_FAILED)
+		return -errno;
+	if (pub->shm)
+		munmap(pub->shm, pub->size);
+	pub->shm = ptr;
+	pub->size = st.st_size;
+	return 0;
+}
+
+static int mirror_id_compare(const void *a, const void *b)
+{
+	const snd_ctl_elem_id_t *id1 = a, *id2 = b;
+
+	return id1->numid < id2->numid ? -1 : id1->numid > id2->numid;
+}
+
+static void mirror_pub_read(snd_ctl_mirror_pub_t *pub, snd_ctl_mirror_elem_t *elem)
+{
+	snd_ctl_elem_value_t value;
+	int err;
+
+	snd_ctl_elem_value_clear(&value);
+	value.id = elem->id;
+	err = snd_ctl_elem_read(pub->ctl, &value);
+	mirror_seq_begin(&elem->seq);
+	elem->value = value;
+	elem->valid = err >= 0;
+	mirror_seq_end(&elem->seq);
+}
+
+/* (re)build the element table from the element list */
+static int mirror_pub_build(snd_ctl_mirror_t *priv, snd_ctl_mirror_pub_t *pub)
+{
+	snd_ctl_elem_list_t list;
+	snd_ctl_mirror_shm_t *shm;
+	unsigned int idx, capacity;
+	size_t need;
+	int err;
+
+	memset(&list, 0, sizeof(list));
+	err = snd_ctl_elem_list(pub->ctl, &list);
+	if (err < 0)
+		return err;
+	err = snd_ctl_elem_list_alloc_space(&list, list.count);
+	if (err < 0)
+		return err;
+	err = snd_ctl_elem_list(pub->ctl, &list);
+	if (err < 0)
+		goto __end;
+	qsort(list.pids, list.used, sizeof(list.pids[0]), mirror_id_compare);
+	capacity = list.used + MIRROR_SPARE;
+	need = sizeof(*shm) + capacity * sizeof(snd_ctl_mirror_elem_t);
+	err = mirror_pub_map(priv, pub, need);
+	if (err < 0)
+		goto __end;
+	shm = pub->shm;
+	mirror_seq_begin(&shm->generation);
+	shm->capacity = (pub->size - sizeof(*shm)) / sizeof(snd_ctl_mirror_elem_t);
+	shm->count = list.used;
+	for (idx = 0; idx < list.used; idx++) {
+		shm->elems[idx].id = list.pids[idx];
+		mirror_pub_read(pub, &shm->elems[idx]);
+	}
+	shm->size = pub->size;
+	shm->magic = MIRROR_MAGIC;
+	mirror_seq_end(&shm->generation);
+	err = 0;
+ __end:
+	snd_ctl_elem_list_free_space(&list);
+	return err;
+}
+
+static int mirror_pub_event(snd_ctl_mirror_t *priv, snd_ctl_mirror_pub_t *pub,
+			    snd_ctl_event_t *event)
+{
+	snd_ctl_mirror_shm_t *shm = pub->shm;
+	unsigned int mask = event->data.elem.mask;
+	unsigned int head;
+	ssize_t idx;
+	int err;
+
+	idx = mirror_find(shm->elems, shm->count, event->data.elem.id.numid);
+	if (mask == SNDRV_CTL_EVENT_MASK_REMOVE ||
+	    (mask & SNDRV_CTL_EVENT_MASK_ADD) || idx < 0) {
+		err = mirror_pub_build(priv, pub);
+		if (err < 0)
+			return err;
+		shm = pub->shm;
+	} else if (mask & (SNDRV_CTL_EVENT_MASK_VALUE | SNDRV_CTL_EVENT_MASK_INFO)) {
+		mirror_pub_read(pub, &shm->elems[idx]);
+	}
+	/* the value is in place before the event becomes visible */
+	head = shm->head;
+	shm->ring[head % MIRROR_RING].mask = mask;
+	shm->ring[head % MIRROR_RING].id = event->data.elem.id;
+	__atomic_store_n(&shm->head, head + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static void mirror_pub_notify(snd_ctl_mirror_t *priv, snd_ctl_mirror_pub_t *pub)
+{
+	unsigned int idx = 0;
+	char c = 0;
+
+	while (idx < pub->clients_count) {
+		/* a full socket means a wakeup is pending already */
+		if (send(pub->clients[idx], &c, 1, MSG_DONTWAIT | MSG_NOSIGNAL) < 0 &&
+		    errno != EAGAIN && errno != EWOULDBLOCK) {
+			close(pub->clients[idx]);
+			pub->clients[idx] = pub->clients[--pub->clients_count];
+			continue;
+		}
+		idx++;
+	}
+	eventfd_write(priv->event_fd, 1);
+}
+
+static void mirror_pub_accept(snd_ctl_mirror_pub_t *pub)
+{
+	int fd, *clients;
+
+	while ((fd = accept(pub->listen_fd, NULL, NULL)) >= 0) {
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+		fcntl(fd, F_SETFL, O_NONBLOCK);
+		if (pub->clients_count == pub->clients_alloc) {
+			clients = realloc(pub->clients, (pub->clients_alloc + 16) * sizeof(*clients));
+			if (clients == NULL) {
+				close(fd);
+				continue;
+			}
+			pub->clients = clients;
+			pub->clients_alloc += 16;
+		}
+		pub->clients[pub->clients_count++] = fd;
+	}
+}
+
+static void mirror_pub_free(snd_ctl_mirror_pub_t *pub)
+{
+	unsigned int idx;
+
+	for (idx = 0; idx < pub->clients_count; idx++)
+		close(pub->clients[idx]);
+	free(pub->clients);
+	if (pub->listen_fd >= 0)
+		close(pub->listen_fd);
+	if (pub->shm) {
+		/* no publisher, the clients ask the kernel meanwhile */
+		mirror_seq_begin(&pub->shm->generation);
+		munmap(pub->shm, pub->size);
+	}
+	if (pub->ctl)
+		snd_ctl_close(pub->ctl);
+}
+
+/* serve the segment until quit_fd is signalled (1) or on error (< 0) */
+static int mirror_publish(snd_ctl_mirror_t *priv)
+{
+	snd_ctl_mirror_pub_t pub;
+	struct pollfd *pfds = NULL, *p;
+	unsigned int idx, nfds, alloc = 0, cdesc;
+	unsigned short revents;
+	snd_ctl_event_t event;
+	int err, changed;
+
+	memset(&pub, 0, sizeof(pub));
+	pub.listen_fd = -1;
+	err = snd_ctl_hw_open(&pub.ctl, NULL, priv->card, SND_CTL_NONBLOCK);
+	if (err < 0)
+		goto __end;
+	err = snd_ctl_subscribe_events(pub.ctl, 1);
+	if (err < 0)
+		goto __end;
+	err = mirror_pub_build(priv, &pub);
+	if (err < 0)
+		goto __end;
+	pub.listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (pub.listen_fd < 0 ||
+	    bind(pub.listen_fd, (struct sockaddr *)&priv->addr, priv->addr_len) < 0 ||
+	    listen(pub.listen_fd, 16) < 0) {
+		err = -errno;
+		goto __end;
+	}
+	/* the own client may have missed events while in standby */
+	__atomic_store_n(&priv->resync, 1, __ATOMIC_RELEASE);
+	eventfd_write(priv->event_fd, 1);
+	cdesc = snd_ctl_poll_descriptors_count(pub.ctl);
+	for (;;) {
+		nfds = 2 + cdesc + pub.clients_count;
+		if (nfds > alloc) {
+			p = realloc(pfds, (nfds + 16) * sizeof(*pfds));
+			if (p == NULL) {
+				err = -ENOMEM;
+				goto __end;
+			}
+			pfds = p;
+			alloc = nfds + 16;
+		}
+		pfds[0].fd = priv->quit_fd;
+		pfds[0].events = POLLIN;
+		pfds[1].fd = pub.listen_fd;
+		pfds[1].events = POLLIN;
+		snd_ctl_poll_descriptors(pub.ctl, pfds + 2, cdesc);
+		for (idx = 0; idx < pub.clients_count; idx++) {
+			pfds[2 + cdesc + idx].fd = pub.clients[idx];
+			pfds[2 + cdesc + idx].events = POLLIN;
+		}
+		if (poll(pfds, nfds, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			err = -errno;
+			goto __end;
+		}
+		if (pfds[0].revents) {
+			err = 1;
+			goto __end;
+		}
+		if (pfds[1].revents)
+			mirror_pub_accept(&pub);
+		/* the clients never send anything, so this is a hangup */
+		for (idx = nfds - 2 - cdesc; idx-- > 0; ) {
+			if (!pfds[2 + cdesc + idx].revents)
+				continue;
+			close(pub.clients[idx]);
+			pub.clients[idx] = pub.clients[--pub.clients_count];
+		}
+		snd_ctl_poll_descriptors_revents(pub.ctl, pfds + 2, cdesc, &revents);
+		if (!(revents & POLLIN))
+			continue;
+		changed = 0;
+		while (snd_ctl_read(pub.ctl, &event) > 0) {
+			if (event.type != SND_CTL_EVENT_ELEM)
+				continue;
+			err = mirror_pub_event(priv, &pub, &event);
+			if (err < 0)
+				goto __end;
+			changed = 1;
+		}
+		if (changed)
+			mirror_pub_notify(priv, &pub);
+	}
+ __end:
+	free(pfds);
+	mirror_pub_free(&pub);
+	return err;
+}
+
+/*
+ * The thread of every client takes over the publishing when the lock
+ * becomes free, otherwise it forwards the wakeups of the publisher to
+ * the eventfd of the client.
+ */
+static void *mirror_thread(void *arg)
+{
+	snd_ctl_mirror_t *priv = arg;
+	struct pollfd pfds[2];
+	char buf[64];
+	ssize_t len;
+	int fd, err;
+
+	for (;;) {
+		if (flock(priv->shm_fd, LOCK_EX | LOCK_NB) == 0) {
+			err = mirror_publish(priv);
+			flock(priv->shm_fd, LOCK_UN);
+			if (err > 0)
+				return NULL;
+		} else {
+			fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+			if (fd >= 0 &&
+			    connect(fd, (struct sockaddr *)&priv->addr, priv->addr_len) == 0) {
+				__atomic_store_n(&priv->resync, 1, __ATOMIC_RELEASE);
+				eventfd_write(priv->event_fd, 1);
+				pfds[0].fd = priv->quit_fd;
+				pfds[0].events = POLLIN;
+				pfds[1].fd = fd;
+				pfds[1].events = POLLIN;
+				for (;;) {
+					if (poll(pfds, 2, -1) < 0) {
+						if (errno == EINTR)
+							continue;
+						break;
+					}
+					if (pfds[0].revents) {
+						close(fd);
+						return NULL;
+					}
+					len = recv(fd, buf, sizeof(buf), 0);
+					if (len <= 0)
+						break;	/* the publisher is gone */
+					eventfd_write(priv->event_fd, 1);
+				}
+				close(fd);
+				/* take over right away */
+				continue;
+			}
+			if (fd >= 0)
+				close(fd);
+		}
+		pfds[0].fd = priv->quit_fd;
+		pfds[0].events = POLLIN;
+		if (poll(pfds, 1, MIRROR_RETRY) > 0)
+			return NULL;
+	}
+}
+
+static int snd_ctl_mirror_close(snd_ctl_t *ctl)
+{
+	snd_ctl_mirror_t *priv = ctl->private_data;
+	int err;
+
+	eventfd_write(priv->quit_fd, 1);
+	pthread_join(priv->thread, NULL);
+	err = snd_ctl_close(priv->child);
+	if (priv->shm)
+		munmap((void *)priv->shm, priv->shm_size);
+	close(priv->shm_fd);
+	close(priv->event_fd);
+	close(priv->quit_fd);
+	free(priv);
+	return err;
+}
+
+static int snd_ctl_mirror_nonblock(snd_ctl_t *ctl, int nonblock)
+{
+	snd_ctl_mirror_t *priv = ctl->private_data;
+	int err = snd_ctl_nonblock(priv->child, nonblock);
+
+	if (err >= 0)
+		priv->nonblock = nonblock;
+	return err;
+}
+
+static int snd_ctl_mirror_async(snd_ctl_t *ctl ATTRIBUTE_UNUSED,
+				int sig ATTRIBUTE_UNUSED, pid_t pid ATTRIBUTE_UNUSED)
+{
+	return -ENOSYS;
+}
+
+static int snd_ctl_mirror_card_info(snd_ctl_t *ctl, snd_ctl_card_info_t *info)
+{
+	snd_ctl_mirror_t *priv = ctl->private_data;
+	return snd_ctl_card_info(priv->child, info);
+}
+
+static int snd_ctl_mirror_elem_list(snd_ctl_t *ctl, snd_ctl_elem_list_t *list)
+{
+	snd_ctl_mirror_t *priv = ctl->private_data;
+	return snd_ctl_elem_list(priv->child, list);
+}
+
+static int snd_ctl_mirror_elem_info(snd_ctl_t *ctl, snd_ctl_elem_info_t *info)
+{
+	snd_ctl_mirror_t *priv = ctl->private_data;
+	return snd_ctl_elem_info(priv->child, info);
+}
+
+static int snd_ctl_mirror_elem_add(snd_ctl_t *ctl, snd_ctl_elem_info_t *info)
+{
+	snd_ctl_mirror_t *priv = ctl->private_data;
+	return priv->child->ops->element_add(priv->child, info);
+}
+
+static int snd_ctl_mirror_elem_replace(snd_ctl_t *ctl, snd_ctl_elem_info_t *info)
+{
+	snd_ctl_mirror_t *priv = ctl->private_data;
+	return priv->child->ops->element_replace(priv->child, info);
+}
+
+static int snd_ctl_mirror_elem_remove(snd_ctl_t *ctl, snd_ctl_elem_id_t *id)
+{
+	snd_ctl_mirror_t *priv = ctl->private_data;
+	return snd_ctl_elem_remove(priv->child, id);
+}
+
+static int snd_ctl_mirror_elem_write(snd_ctl_t *ctl, snd_ctl_elem_value_t *control)
+{
+	snd_ctl_mirror_t *priv = ctl->private_data;
+	return snd_ctl_elem_write(priv->child, control);
+}
+
+static int snd_ctl_mirror_elem_lock(snd_ctl_t *ctl, snd_ctl_elem_id_t *id)
+{
+	snd_ctl_mirror_t *priv = ctl->private_data;
+	return snd_ctl_elem_lock(priv->child, id);
+}
+
+static int snd_ctl_mirror_elem_unlock(snd_ctl_t *ctl, snd_ctl_elem_id_t *id)
+{
+	snd_ctl_mirror_t *priv = ctl->private_data;
+	return snd_ctl_elem_unlock(priv->child, id);
+}
+
+static int snd_ctl_mirror_elem_tlv(snd_ctl_t *ctl, int op_flag,
+				   unsigned int numid,
+				   unsigned int *tlv, unsigned int tlv_size)
+{
+	snd_ctl_mirror_t *priv = ctl->private_data;
+	return priv->child->ops->element_tlv(priv->child, op_flag, numid, tlv, tlv_size);
+}
+
+static int snd_ctl_mirror_hwdep_next_device(snd_ctl_t *ctl, int *device)
+{
+	snd_ctl_mirror_t *priv = ctl->private_data;
+	return snd_ctl_hwdep_next_device(priv->child, device);
+}
+
+static int snd_ctl_mirror_hwdep_info(snd_ctl_t *ctl, snd_hwdep_info_t *info)
+{
+	snd_ctl_mirror_t *priv = ctl->private_data;
+	return snd_ctl_hwdep_info(priv->child, info);
+}
+
+static int snd_ctl_mirror_pcm_next_device(snd_ctl_t *ctl, int *device)
+{
+	snd_ctl_mirror_t *priv = ctl->private_data;
+	return snd_ctl_pcm_next_device(priv->child, device);
+}
+
+static int snd_ctl_mirror_pcm_info(snd_ctl_t *ctl, snd_pcm_info_t *info)
+{
+	snd_ctl_mirror_t *priv = ctl->private_data;
+	return snd_ctl_pcm_info(priv->child, info);
+}
+
+static int snd_ctl_mirror_pcm_prefer_subdevice(snd_ctl_t *ctl, int subdev)
+{
+	snd_ctl_mirror_t *priv = ctl->private_data;
+	return snd_ctl_pcm_prefer_subdevice(priv->child, subdev);
+}
+
+static int snd_ctl_mirror_rawmidi_next_device(snd_ctl_t *ctl, int *device)
+{
+	snd_ctl_mirror_t *priv = ctl->private_data;
+	return snd_ctl_rawmidi_next_device(priv->child, device);
+}
+
+static int snd_ctl_mirror_rawmidi_info(snd_ctl_t *ctl, snd_rawmidi_info_t *info)
+{
+	snd_ctl_mirror_t *priv = ctl->private_data;
+	return snd_ctl_rawmidi_info(priv->child, info);
+}
+
+static int snd_ctl_mirror_rawmidi_prefer_subdevice(snd_ctl_t *ctl, int subdev)
+{
+	snd_ctl_mirror_t *priv = ctl->private_data;
+	return snd_ctl_rawmidi_prefer_subdevice(priv->child, subdev);
+}
+
+static int snd_ctl_mirror_set_power_state(snd_ctl_t *ctl, unsigned int state)
+{
+	snd_ctl_mirror_t *priv = ctl->private_data;
+	return snd_ctl_set_power_state(priv->child, state);
+}
+
+static int snd_ctl_mirror_get_power_state(snd_ctl_t *ctl, unsigned int *state)
+{
+	snd_ctl_mirror_t *priv = ctl->private_data;
+	return snd_ctl_get_power_state(priv->child, state);
+}
+
+static const snd_ctl_ops_t snd_ctl_mirror_ops = {
+	.close = snd_ctl_mirror_close,
+	.nonblock = snd_ctl_mirror_nonblock,
+	.async = snd_ctl_mirror_async,
+	.subscribe_events = snd_ctl_mirror_subscribe_events,
+	.card_info = snd_ctl_mirror_card_info,
+	.element_list = snd_ctl_mirror_elem_list,
+	.element_info = snd_ctl_mirror_elem_info,
+	.element_add = snd_ctl_mirror_elem_add,
+	.element_replace = snd_ctl_mirror_elem_replace,
+	.element_remove = snd_ctl_mirror_elem_remove,
+	.element_read = snd_ctl_mirror_elem_read,
+	.element_write = snd_ctl_mirror_elem_write,
+	.element_lock = snd_ctl_mirror_elem_lock,
+	.element_unlock = snd_ctl_mirror_elem_unlock,
+	.element_tlv = snd_ctl_mirror_elem_tlv,
+	.hwdep_next_device = snd_ctl_mirror_hwdep_next_device,
+	.hwdep_info = snd_ctl_mirror_hwdep_info,
+	.pcm_next_device = snd_ctl_mirror_pcm_next_device,
+	.pcm_info = snd_ctl_mirror_pcm_info,
+	.pcm_prefer_subdevice = snd_ctl_mirror_pcm_prefer_subdevice,
+	.rawmidi_next_device = snd_ctl_mirror_rawmidi_next_device,
+	.rawmidi_info = snd_ctl_mirror_rawmidi_info,
+	.rawmidi_prefer_subdevice = snd_ctl_mirror_rawmidi_prefer_subdevice,
+	.set_power_state = snd_ctl_mirror_set_power_state,
+	.get_power_state = snd_ctl_mirror_get_power_state,
+	.read = snd_ctl_mirror_read,
+};
+
+/**
+ * \brief Creates a new mirror control handle
+ * \param handlep Returns created control handle
+ * \param name Name of control device
+ * \param card Number of card
+ * \param mode Control handle mode
+ * \retval zero on success otherwise a negative error code
+ * \warning Using of this function might be dangerous in the sense
+ *          of compatibility reasons. The prototype might be freely
+ *          changed in future.
+ */
+int snd_ctl_mirror_open(snd_ctl_t **handlep, const char *name, int card, int mode)
+{
+	snd_ctl_mirror_t *priv;
+	snd_ctl_t *ctl;
+	int err;
+
+	priv = calloc(1, sizeof(*priv));
+	if (priv == NULL)
+		return -ENOMEM;
+	priv->card = card;
+	priv->nonblock = !!(mode & SND_CTL_NONBLOCK);
+	priv->shm_fd = priv->event_fd = priv->quit_fd = -1;
+	err = snd_ctl_hw_open(&priv->child, NULL, card, mode & ~SND_CTL_ASYNC);
+	if (err < 0)
+		goto _err;
+	snprintf(priv->shm_name, sizeof(priv->shm_name),
+		 "/alsa-ctl-mirror-%i-%u", card, (unsigned int)getuid());
+	priv->addr.sun_family = AF_UNIX;
+	/* abstract socket, the name follows a null byte */
+	snprintf(priv->addr.sun_path + 1, sizeof(priv->addr.sun_path) - 1,
+		 "%s", priv->shm_name + 1);
+	priv->addr_len = offsetof(struct sockaddr_un, sun_path) + 1 +
+			 strlen(priv->addr.sun_path + 1);
+	priv->shm_fd = shm_open(priv->shm_name, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (priv->shm_fd < 0) {
+		SYSERR("shm_open %s failed", priv->shm_name);
+		err = -errno;
+		goto _err;
+	}
+	priv->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	priv->quit_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (priv->event_fd < 0 || priv->quit_fd < 0) {
+		err = -errno;
+		goto _err;
+	}
+	err = snd_ctl_new(&ctl, SND_CTL_TYPE_MIRROR, name);
+	if (err < 0)
+		goto _err;
+	err = -snd_thread_create(&priv->thread, "ctl_mirror", mirror_thread, priv);
+	if (err < 0) {
+		snd_ctl_close(ctl);
+		goto _err;
+	}
+	ctl->ops = &snd_ctl_mirror_ops;
+	ctl->private_data = priv;
+	ctl->poll_fd = priv->event_fd;
+	*handlep = ctl;
+	return 0;
+
+ _err:
+	if (priv->child)
+		snd_ctl_close(priv->child);
+	if (priv->shm_fd >= 0)
+		close(priv->shm_fd);
+	if (priv->event_fd >= 0)
+		close(priv->event_fd);
+	if (priv->quit_fd >= 0)
+		close(priv->quit_fd);
+	free(priv);
+	return err;
+}
+
+/*! \page control_plugins
+
+\section control_plugins_mirror Plugin: Mirror
+
+This plugin serves the element values of a card from a shared memory
+snapshot instead of the kernel.  It suits the processes which only watch
+the controls (volume displays, status LEDs and similar).
+
+One process per card and user (the first one opening the plugin) reads
+the values and the events from the kernel and publishes them, the other
+clients map the snapshot read-only.  The reads take no lock; a client
+asks the kernel itself only while the snapshot is being rebuilt or when
+no publisher is running.  When the publishing process exits, the thread
+of another client takes over.  The events are delivered through an
+eventfd, so the plugin provides one poll descriptor.  All other requests
+(info, writes, TLV, locks) go to the kernel directly.
+
+\code
+ctl.name {
+	type mirror		# Shared memory mirror
+	card INT/STR		# Card name (string) or number (integer)
+}
+\endcode
+
+\subsection control_plugins_mirror_funcref Function reference
+
+<UL>
+  <LI>snd_ctl_mirror_open()
+  <LI>_snd_ctl_mirror_open()
+</UL>
+
+*/
+
+/**
+ * \brief Creates a new mirror control handle
+ * \param handlep Returns created control handle
+ * \param name Name of control device
+ * \param root Root configuration node
+ * \param conf Configuration node with mirror control description
+ * \param mode Control handle mode
+ * \retval zero on success otherwise a negative error code
+ * \warning Using of this function might be dangerous in the sense
+ *          of compatibility reasons. The prototype might be freely
+ *          changed in future.
+ */
+int _snd_ctl_mirror_open(snd_ctl_t **handlep, char *name,
+			 snd_config_t *root ATTRIBUTE_UNUSED,
+			 snd_config_t *conf, int mode)
+{
+	snd_config_iterator_t i, next;
+	long card = -1;
+	int err;
+
+	snd_config_for_each(i, next, conf) {
+		snd_config_t *n = snd_config_iterator_entry(i);
+		const char *id;
+		if (snd_config_get_id(n, &id) < 0)
+			continue;
+		if (_snd_conf_generic_id(id))
+			continue;
+		if (strcmp(id, "card") == 0) {
+			err = snd_config_get_card(n);
+			if (err < 0)
+				return err;
+			card = err;
+			continue;
+		}
+		SNDERR("Unknown field %s", id);
+		return -EINVAL;
+	}
+	if (card < 0) {
+		SNDERR("card is not defined");
+		return -EINVAL;
+	}
+	return snd_ctl_mirror_open(handlep, name, card, mode);
+}
+SND_DLSYM_BUILD_VERSION(_snd_ctl_mirror_open, SND_CONTROL_DLSYM_VERSION);
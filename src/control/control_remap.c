@@ -31,6 +31,7 @@
 #include <stdarg.h>
 #include <unistd.h>
 #include <string.h>
+#include <stddef.h>
 #include "control_local.h"
 
 #if 0
@@ -65,6 +66,22 @@ typedef struct {
 	snd_ctl_elem_id_t id_app;
 } snd_ctl_remap_id_t;
 
+/*
+ * Hash index over one of the arrays below.  An entry is stored under
+ * several keys (id field hash, numids), so a lookup checks each candidate
+ * against the array element.  Entries are never removed; an entry whose
+ * numid changed simply fails the check.
+ */
+typedef struct {
+	unsigned int bits;	/* log2 of the slot count */
+	unsigned int used;
+	int broken;		/* allocation failed, use the linear scans */
+	struct snd_ctl_remap_slot {
+		unsigned int key;
+		unsigned int idx;	/* array index + 1, 0 for a free slot */
+	} *slot;
+} snd_ctl_remap_index_t;
+
 typedef struct {
 	snd_ctl_elem_id_t map_id;
 	snd_ctl_elem_type_t type;
@@ -96,9 +113,153 @@ typedef struct {
 	size_t map_read_queue_head;
 	size_t map_read_queue_tail;
 	snd_ctl_map_t **map_read_queue;
+	snd_ctl_remap_index_t numid_index;	/* numid by numid_app, numid_child */
+	snd_ctl_remap_index_t remap_index;	/* remap by id_child, id_app */
+	snd_ctl_remap_index_t map_index;	/* map by map_id */
+	snd_ctl_remap_index_t event_index;	/* map by id_child of its controls */
 } snd_ctl_remap_t;
 #endif
 
+static unsigned int remap_id_hash(const snd_ctl_elem_id_t *id)
+{
+	const unsigned char *p;
+	unsigned int h = 2166136261U;
+
+	h = (h ^ id->iface) * 16777619U;
+	h = (h ^ id->device) * 16777619U;
+	h = (h ^ id->subdevice) * 16777619U;
+	h = (h ^ id->index) * 16777619U;
+	for (p = id->name; *p && p < id->name + sizeof(id->name); p++)
+		h = (h ^ *p) * 16777619U;
+	return h;
+}
+
+static unsigned int remap_index_start(snd_ctl_remap_index_t *ix, unsigned int key)
+{
+	return (key * 2654435761U) >> (32 - ix->bits);
+}
+
+static void remap_index_free(snd_ctl_remap_index_t *ix)
+{
+	free(ix->slot);
+	ix->slot = NULL;
+	ix->bits = 0;
+	ix->used = 0;
+}
+
+static int remap_index_grow(snd_ctl_remap_index_t *ix)
+{
+	struct snd_ctl_remap_slot *slot, *old = ix->slot;
+	unsigned int bits = old ? ix->bits + 1 : 6;
+	unsigned int i, j, mask = (1U << bits) - 1;
+
+	slot = calloc(mask + 1, sizeof(*slot));
+	if (slot == NULL)
+		return -ENOMEM;
+	if (old) {
+		for (i = 0; i < (1U << ix->bits); i++) {
+			if (!old[i].idx)
+				continue;
+			j = (old[i].key * 2654435761U) >> (32 - bits);
+			while (slot[j].idx)
+				j = (j + 1) & mask;
+			slot[j] = old[i];
+		}
+		free(old);
+	}
+	ix->slot = slot;
+	ix->bits = bits;
+	return 0;
+}
+
+static void remap_index_add(snd_ctl_remap_index_t *ix, unsigned int key, size_t idx)
+{
+	unsigned int i, mask;
+
+	if (ix->broken)
+		return;
+	if (ix->slot) {
+		mask = (1U << ix->bits) - 1;
+		for (i = remap_index_start(ix, key); ix->slot[i].idx; i = (i + 1) & mask)
+			if (ix->slot[i].key == key && ix->slot[i].idx == idx + 1)
+				return;
+	}
+	if (ix->slot == NULL || (ix->used + 1) * 2 > (1U << ix->bits)) {
+		if (remap_index_grow(ix) < 0) {
+			remap_index_free(ix);
+			ix->broken = 1;
+			return;
+		}
+	}
+	mask = (1U << ix->bits) - 1;
+	for (i = remap_index_start(ix, key); ix->slot[i].idx; i = (i + 1) & mask)
+		;
+	ix->slot[i].key = key;
+	ix->slot[i].idx = idx + 1;
+	ix->used++;
+}
+
+/* iterate the entries stored under key, pos must be zero initially */
+static int remap_index_next(snd_ctl_remap_index_t *ix, unsigned int key,
+			    unsigned int *pos, size_t *idx)
+{
+	unsigned int i, mask = (1U << ix->bits) - 1;
+	unsigned int start = remap_index_start(ix, key);
+
+	while (*pos <= mask) {
+		i = (start + (*pos)++) & mask;
+		if (!ix->slot[i].idx)
+			break;
+		if (ix->slot[i].key == key) {
+			*idx = ix->slot[i].idx - 1;
+			return 1;
+		}
+	}
+	*pos = mask + 1;
+	return 0;
+}
+
+/*
+ * Return the lowest index of the array element (of size bytes) matching
+ * id, or - when id is NULL - having numid at offset, -1 if none matches.
+ * The lowest index keeps the result of the linear scans it replaces.
+ */
+static ssize_t remap_index_find(snd_ctl_remap_index_t *ix, const void *base,
+				size_t size, size_t offset,
+				const snd_ctl_elem_id_t *id, unsigned int numid)
+{
+	unsigned int key = id ? remap_id_hash(id) : numid;
+	unsigned int pos = 0;
+	ssize_t found = -1;
+	size_t idx;
+	const char *elem;
+
+	while (remap_index_next(ix, key, &pos, &idx)) {
+		if (found >= 0 && idx >= (size_t)found)
+			continue;
+		elem = (const char *)base + idx * size + offset;
+		if (id) {
+			if (snd_ctl_elem_id_compare_set(id, (const snd_ctl_elem_id_t *)elem))
+				continue;
+		} else if (*(const unsigned int *)elem != numid) {
+			continue;
+		}
+		found = idx;
+	}
+	return found;
+}
+
+/* index the numids of a remap entry, they are learned on the way */
+static void remap_index_rid(snd_ctl_remap_t *priv, snd_ctl_remap_id_t *rid)
+{
+	size_t idx = rid - priv->remap;
+
+	if (rid->id_child.numid)
+		remap_index_add(&priv->remap_index, rid->id_child.numid, idx);
+	if (rid->id_app.numid)
+		remap_index_add(&priv->remap_index, rid->id_app.numid, idx);
+}
+
 static snd_ctl_numid_t *remap_numid_temp(snd_ctl_remap_t *priv, unsigned int numid)
 {
 	priv->numid_temp.numid_child = numid;
@@ -113,6 +274,13 @@ static snd_ctl_numid_t *remap_find_numid_app(snd_ctl_remap_t *priv, unsigned int
 
 	if (!priv->numid_remap_active)
 		return remap_numid_temp(priv, numid_app);
+	if (priv->numid_index.slot) {
+		ssize_t idx = remap_index_find(&priv->numid_index, priv->numid,
+					       sizeof(*numid),
+					       offsetof(snd_ctl_numid_t, numid_app),
+					       NULL, numid_app);
+		return idx >= 0 ? &priv->numid[idx] : NULL;
+	}
 	numid = priv->numid;
 	for (count = priv->numid_items; count > 0; count--, numid++)
 		if (numid_app == numid->numid_app)
@@ -136,6 +304,8 @@ static snd_ctl_numid_t *remap_numid_new(snd_ctl_remap_t *priv, unsigned int numi
 	numid = &priv->numid[priv->numid_items++];
 	numid->numid_child = numid_child;
 	numid->numid_app = numid_app;
+	remap_index_add(&priv->numid_index, numid_child, priv->numid_items - 1);
+	remap_index_add(&priv->numid_index, numid_app, priv->numid_items - 1);
 	debug("new numid: child %u app %u\n", numid->numid_child, numid->numid_app);
 	return numid;
 }
@@ -163,6 +333,15 @@ static snd_ctl_numid_t *remap_find_numid_child(snd_ctl_remap_t *priv, unsigned i
 
 	if (!priv->numid_remap_active)
 		return remap_numid_temp(priv, numid_child);
+	if (priv->numid_index.slot) {
+		ssize_t idx = remap_index_find(&priv->numid_index, priv->numid,
+					       sizeof(*numid),
+					       offsetof(snd_ctl_numid_t, numid_child),
+					       NULL, numid_child);
+		if (idx >= 0)
+			return &priv->numid[idx];
+		return remap_numid_child_new(priv, numid_child);
+	}
 	numid = priv->numid;
 	for (count = priv->numid_items; count > 0; count--, numid++)
 		if (numid_child == numid->numid_child)
@@ -174,7 +353,21 @@ static snd_ctl_remap_id_t *remap_find_id_child(snd_ctl_remap_t *priv, snd_ctl_el
 {
 	size_t count;
 	snd_ctl_remap_id_t *rid;
-
+	ssize_t idx = -1;
+
+	if (priv->remap_index.slot) {
+		if (id->numid > 0)
+			idx = remap_index_find(&priv->remap_index, priv->remap,
+					       sizeof(*rid),
+					       offsetof(snd_ctl_remap_id_t, id_child.numid),
+					       NULL, id->numid);
+		if (idx < 0)
+			idx = remap_index_find(&priv->remap_index, priv->remap,
+					       sizeof(*rid),
+					       offsetof(snd_ctl_remap_id_t, id_child),
+					       id, 0);
+		return idx >= 0 ? &priv->remap[idx] : NULL;
+	}
 	if (id->numid > 0) {
 		rid = priv->remap;
 		for (count = priv->remap_items; count > 0; count--, rid++)
@@ -192,7 +385,21 @@ static snd_ctl_remap_id_t *remap_find_id_app(snd_ctl_remap_t *priv, snd_ctl_elem
 {
 	size_t count;
 	snd_ctl_remap_id_t *rid;
-
+	ssize_t idx = -1;
+
+	if (priv->remap_index.slot) {
+		if (id->numid > 0)
+			idx = remap_index_find(&priv->remap_index, priv->remap,
+					       sizeof(*rid),
+					       offsetof(snd_ctl_remap_id_t, id_app.numid),
+					       NULL, id->numid);
+		if (idx < 0)
+			idx = remap_index_find(&priv->remap_index, priv->remap,
+					       sizeof(*rid),
+					       offsetof(snd_ctl_remap_id_t, id_app),
+					       id, 0);
+		return idx >= 0 ? &priv->remap[idx] : NULL;
+	}
 	if (id->numid > 0) {
 		rid = priv->remap;
 		for (count = priv->remap_items; count > 0; count--, rid++)
@@ -213,6 +420,13 @@ static snd_ctl_map_t *remap_find_map_numid(snd_ctl_remap_t *priv, unsigned int n
 
 	if (numid == 0)
 		return NULL;
+	if (priv->map_index.slot) {
+		ssize_t idx = remap_index_find(&priv->map_index, priv->map,
+					       sizeof(*map),
+					       offsetof(snd_ctl_map_t, map_id.numid),
+					       NULL, numid);
+		return idx >= 0 ? &priv->map[idx] : NULL;
+	}
 	map = priv->map;
 	for (count = priv->map_items; count > 0; count--, map++) {
 		if (numid == map->map_id.numid)
@@ -227,6 +441,13 @@ static snd_ctl_map_t *remap_find_map_id(snd_ctl_remap_t *priv, snd_ctl_elem_id_t
 
 	if (id->numid > 0)
 		return remap_find_map_numid(priv, id->numid);
+	if (priv->map_index.slot) {
+		ssize_t idx = remap_index_find(&priv->map_index, priv->map,
+					       sizeof(*map),
+					       offsetof(snd_ctl_map_t, map_id),
+					       id, 0);
+		return idx >= 0 ? &priv->map[idx] : NULL;
+	}
 	map = priv->map;
 	for (count = priv->map_items; count > 0; count--, map++)
 		if (snd_ctl_elem_id_compare_set(id, &map->map_id) == 0)
@@ -247,6 +468,7 @@ static int remap_id_to_child(snd_ctl_remap_t *priv, snd_ctl_elem_id_t *id, snd_c
 			if (numid) {
 				rid->id_child.numid = numid->numid_child;
 				rid->id_app.numid = numid->numid_app;
+				remap_index_rid(priv, rid);
 			}
 		}
 		*id = rid->id_child;
@@ -275,6 +497,7 @@ static int remap_id_to_app(snd_ctl_remap_t *priv, snd_ctl_elem_id_t *id, snd_ctl
 				return -EIO;
 			rid->id_child.numid = numid->numid_child;
 			rid->id_app.numid = numid->numid_app;
+			remap_index_rid(priv, rid);
 		}
 		*id = rid->id_app;
 	} else {
@@ -299,6 +522,10 @@ static void remap_free(snd_ctl_remap_t *priv)
 			free(map->controls[idx2].channel_map);
 		free(map->controls);
 	}
+	remap_index_free(&priv->numid_index);
+	remap_index_free(&priv->remap_index);
+	remap_index_free(&priv->map_index);
+	remap_index_free(&priv->event_index);
 	free(priv->map_read_queue);
 	free(priv->map);
 	free(priv->remap);
@@ -357,6 +584,7 @@ static int snd_ctl_remap_elem_list(snd_ctl_t *ctl, snd_ctl_elem_list_t *list)
 		rid = remap_find_id_child(priv, id);
 		if (rid) {
 			rid->id_app.numid = id->numid;
+			remap_index_rid(priv, rid);
 			*id = rid->id_app;
 		}
 		numid = remap_find_numid_child(priv, id->numid);
@@ -789,45 +1017,57 @@ static void _next_ptr(size_t *ptr, size_t count)
 	*ptr = (*ptr + 1) % count;
 }
 
+static void remap_event_for_map(snd_ctl_remap_t *priv, snd_ctl_map_t *map,
+				snd_ctl_elem_id_t *id, unsigned int event_mask)
+{
+	size_t index;
+	struct snd_ctl_map_ctl *mctl;
+	int queued;
+
+	for (index = 0; index < map->controls_items; index++) {
+		mctl = &map->controls[index];
+		if (mctl->id_child.numid == 0) {
+			if (snd_ctl_elem_id_compare_set(id, &mctl->id_child))
+				continue;
+			mctl->id_child.numid = id->numid;
+		}
+		if (id->numid != mctl->id_child.numid)
+			continue;
+		debug_id(&map->map_id, "%s found (all)\n", __func__);
+		/* a non-zero mask means the map is in the read queue already */
+		queued = map->event_mask != 0;
+		map->event_mask |= event_mask;
+		if (queued)
+			continue;
+		debug_id(&map->map_id, "%s marking for read\n", __func__);
+		priv->map_read_queue[priv->map_read_queue_tail] = map;
+		_next_ptr(&priv->map_read_queue_tail, priv->map_items);
+	}
+}
+
 static void remap_event_for_all_map_controls(snd_ctl_remap_t *priv,
 					     snd_ctl_elem_id_t *id,
 					     unsigned int event_mask)
 {
-	size_t count, index, head;
+	size_t count, idx;
 	snd_ctl_map_t *map;
-	struct snd_ctl_map_ctl *mctl;
-	int found;
+	unsigned int pos;
 
 	if (event_mask == SNDRV_CTL_EVENT_MASK_REMOVE)
 		event_mask = SNDRV_CTL_EVENT_MASK_INFO;
-	map = priv->map;
-	for (count = priv->map_items; count > 0; count--, map++) {
-		for (index = 0; index < map->controls_items; index++) {
-			mctl = &map->controls[index];
-			if (mctl->id_child.numid == 0) {
-				if (snd_ctl_elem_id_compare_set(id, &mctl->id_child))
-					continue;
-				mctl->id_child.numid = id->numid;
-			}
-			if (id->numid != mctl->id_child.numid)
-				continue;
-			debug_id(&map->map_id, "%s found (all)\n", __func__);
-			map->event_mask |= event_mask;
-			found = 0;
-			for (head = priv->map_read_queue_head;
-			     head != priv->map_read_queue_tail;
-			     _next_ptr(&head, priv->map_items))
-				if (priv->map_read_queue[head] == map) {
-					found = 1;
-					break;
-				}
-			if (found)
-				continue;
-			debug_id(&map->map_id, "%s marking for read\n", __func__);
-			priv->map_read_queue[priv->map_read_queue_tail] = map;
-			_next_ptr(&priv->map_read_queue_tail, priv->map_items);
-		}
+	if (priv->event_index.slot) {
+		/* only the maps with a control of this id or numid */
+		pos = 0;
+		while (remap_index_next(&priv->event_index, remap_id_hash(id), &pos, &idx))
+			remap_event_for_map(priv, &priv->map[idx], id, event_mask);
+		pos = 0;
+		while (remap_index_next(&priv->event_index, id->numid, &pos, &idx))
+			remap_event_for_map(priv, &priv->map[idx], id, event_mask);
+		return;
 	}
+	map = priv->map;
+	for (count = priv->map_items; count > 0; count--, map++)
+		remap_event_for_map(priv, map, id, event_mask);
 }
 
 static int snd_ctl_remap_read(snd_ctl_t *ctl, snd_ctl_event_t *event)
@@ -865,6 +1105,7 @@ static int snd_ctl_remap_read(snd_ctl_t *ctl, snd_ctl_event_t *event)
 					return -EIO;
 				rid->id_child.numid = numid->numid_child;
 				rid->id_app.numid = numid->numid_app;
+				remap_index_rid(priv, rid);
 			}
 			event->data.elem.id = rid->id_app;
 		} else {
@@ -920,6 +1161,9 @@ static int add_to_remap(snd_ctl_remap_t *priv,
 	rid = &priv->remap[priv->remap_items++];
 	rid->id_child = *child;
 	rid->id_app = *app;
+	remap_index_add(&priv->remap_index, remap_id_hash(child), priv->remap_items - 1);
+	remap_index_add(&priv->remap_index, remap_id_hash(app), priv->remap_items - 1);
+	remap_index_rid(priv, rid);
 	debug_id(&rid->id_child, "%s remap child\n", __func__);
 	debug_id(&rid->id_app, "%s remap app\n", __func__);
 	return 0;
@@ -989,6 +1233,8 @@ static int new_map(snd_ctl_remap_t *priv, snd_ctl_map_t **_map, snd_ctl_elem_id_
 	if (numid == NULL)
 		return -ENOMEM;
 	map->map_id.numid = numid->numid_app;
+	remap_index_add(&priv->map_index, remap_id_hash(id), priv->map_items - 1);
+	remap_index_add(&priv->map_index, map->map_id.numid, priv->map_items - 1);
 	debug_id(&map->map_id, "%s created\n", __func__);
 	*_map = map;
 	return 0;
@@ -1135,6 +1381,26 @@ static int parse_map(snd_ctl_remap_t *priv, snd_config_t *conf)
 	return 0;
 }
 
+/*
+ * Index the maps by the ids of their child controls, so an event of
+ * a child control is routed only to the maps containing it.  A numid
+ * learned later is found through the id fields carried by the event.
+ */
+static void remap_build_event_index(snd_ctl_remap_t *priv)
+{
+	size_t idx1, idx2;
+	snd_ctl_elem_id_t *id;
+
+	for (idx1 = 0; idx1 < priv->map_items; idx1++) {
+		for (idx2 = 0; idx2 < priv->map[idx1].controls_items; idx2++) {
+			id = &priv->map[idx1].controls[idx2].id_child;
+			remap_index_add(&priv->event_index, remap_id_hash(id), idx1);
+			if (id->numid)
+				remap_index_add(&priv->event_index, id->numid, idx1);
+		}
+	}
+}
+
 /**
  * \brief Creates a new remap & map control handle
  * \param handlep Returns created control handle
@@ -1192,6 +1458,8 @@ int snd_ctl_remap_open(snd_ctl_t **handlep, const char *name, snd_config_t *rema
 		goto _err;
 	}
 
+	remap_build_event_index(priv);
+
 	priv->numid_remap_active = priv->map_items > 0;
 
 	priv->child = child;
@@ -31,6 +31,7 @@
 #include <sys/un.h>
 #include <sys/uio.h>
 #include <sys/mman.h>
+#include <sys/eventfd.h>
 #include <netinet/in.h>
 #include <netdb.h>
 #include "aserver.h"
@@ -44,6 +45,7 @@ const char *_snd_module_control_shm = "";
 typedef struct {
 	int socket;
 	volatile snd_ctl_shm_ctrl_t *ctrl;
+	volatile snd_ctl_shm_cache_t *cache;	/* NULL when the server has none */
 } snd_ctl_shm_t;
 #endif
 
@@ -70,7 +72,7 @@ static int snd_ctl_shm_action_fd(snd_ctl_t *ctl, int *fd)
 {
 	snd_ctl_shm_t *shm = ctl->private_data;
 	int err;
-	char buf[1];
+	char buf[1] = {0};
 	volatile snd_ctl_shm_ctrl_t *ctrl = shm->ctrl;
 	err = write(shm->socket, buf, 1);
 	if (err != 1)
@@ -186,11 +188,38 @@ static int snd_ctl_shm_elem_info(snd_ctl_t *ctl, snd_ctl_elem_info_t *info)
 	return err;
 }
 
+/*
+ * Take the value from the cache. Fails when the element is not cached or
+ * writes are still queued, so a client always reads back its own writes.
+ */
+static int snd_ctl_shm_cache_read(volatile snd_ctl_shm_cache_t *cache,
+				  snd_ctl_elem_value_t *control)
+{
+	unsigned int numid = control->id.numid;
+	volatile snd_ctl_shm_value_t *slot;
+	unsigned int seq;
+
+	if (numid == 0 || cache->write_head != cache->write_tail)
+		return 0;
+	slot = &cache->values[numid % CTL_SHM_VALUES];
+	do {
+		seq = slot->seq;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if ((seq & 1) || slot->numid != numid)
+			return 0;
+		memcpy(control, (void *)&slot->value, sizeof(*control));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while (slot->seq != seq);
+	return 1;
+}
+
 static int snd_ctl_shm_elem_read(snd_ctl_t *ctl, snd_ctl_elem_value_t *control)
 {
 	snd_ctl_shm_t *shm = ctl->private_data;
 	volatile snd_ctl_shm_ctrl_t *ctrl = shm->ctrl;
 	int err;
+	if (shm->cache && snd_ctl_shm_cache_read(shm->cache, control))
+		return 0;
 	ctrl->u.element_read = *control;
 	ctrl->cmd = SNDRV_CTL_IOCTL_ELEM_READ;
 	err = snd_ctl_shm_action(ctl);
@@ -204,7 +233,31 @@ static int snd_ctl_shm_elem_write(snd_ctl_t *ctl, snd_ctl_elem_value_t *control)
 {
 	snd_ctl_shm_t *shm = ctl->private_data;
 	volatile snd_ctl_shm_ctrl_t *ctrl = shm->ctrl;
+	volatile snd_ctl_shm_cache_t *cache = shm->cache;
+	char buf[1] = { SND_CTL_SHM_WRITE_KICK };
+	unsigned int head;
 	int err;
+	if (cache) {
+		if (__atomic_load_n(&cache->write_error, __ATOMIC_RELAXED) < 0) {
+			err = __atomic_exchange_n(&cache->write_error, 0, __ATOMIC_RELAXED);
+			if (err < 0)
+				return err;
+		}
+		head = cache->write_head;
+		if (head - __atomic_load_n(&cache->write_tail, __ATOMIC_ACQUIRE) < CTL_SHM_WRITES) {
+			memcpy((void *)&cache->writes[head % CTL_SHM_WRITES], control,
+			       sizeof(*control));
+			__atomic_store_n(&cache->write_head, head + 1, __ATOMIC_SEQ_CST);
+			/* kick the server only when it may have gone idle; the
+			 * server checks the head again after it moves the tail
+			 */
+			if (__atomic_load_n(&cache->write_tail, __ATOMIC_SEQ_CST) == head &&
+			    write(shm->socket, buf, 1) != 1)
+				return -EBADFD;
+			return 0;
+		}
+		/* the queue is full, the synchronous write drains it */
+	}
 	ctrl->u.element_write = *control;
 	ctrl->cmd = SNDRV_CTL_IOCTL_ELEM_WRITE;
 	err = snd_ctl_shm_action(ctl);
@@ -366,15 +419,51 @@ static int snd_ctl_shm_get_power_state(snd_ctl_t *ctl, unsigned int *state)
 	return err;
 }
 
+/*
+ * Take the next event from the ring; the poll descriptor stays readable
+ * as long as the ring is not empty.
+ */
+static int snd_ctl_shm_cache_event(snd_ctl_t *ctl, snd_ctl_event_t *event)
+{
+	snd_ctl_shm_t *shm = ctl->private_data;
+	volatile snd_ctl_shm_cache_t *cache = shm->cache;
+	unsigned int tail;
+	eventfd_t val;
+	int err;
+
+	while ((tail = cache->event_tail) == cache->event_head) {
+		err = snd_ctl_wait(ctl, -1);
+		if (err < 0)
+			return 0;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (cache->event_tail == cache->event_head)
+			eventfd_read(ctl->poll_fd, &val);	/* stale wakeup */
+	}
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	memcpy(event, (void *)&cache->events[tail % CTL_SHM_EVENTS], sizeof(*event));
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	cache->event_tail = tail + 1;
+	if (tail + 1 == cache->event_head) {
+		eventfd_read(ctl->poll_fd, &val);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		/* the server queued more meanwhile */
+		if (tail + 1 != cache->event_head)
+			eventfd_write(ctl->poll_fd, 1);
+	}
+	return 1;
+}
+
 static int snd_ctl_shm_read(snd_ctl_t *ctl, snd_ctl_event_t *event)
 {
 	snd_ctl_shm_t *shm;
 	volatile snd_ctl_shm_ctrl_t *ctrl;
 	int err;
+	shm = ctl->private_data;
+	if (shm->cache)
+		return snd_ctl_shm_cache_event(ctl, event);
 	err = snd_ctl_wait(ctl, -1);
 	if (err < 0)
 		return 0;
-	shm = ctl->private_data;
 	ctrl = shm->ctrl;
 	ctrl->u.read = *event;
 	ctrl->cmd = SND_CTL_IOCTL_READ;
@@ -442,6 +531,7 @@ int snd_ctl_shm_open(snd_ctl_t **handlep, const char *name, const char *sockname
 	int result;
 	int sock = -1;
 	snd_ctl_shm_ctrl_t *ctrl = NULL;
+	struct shmid_ds buf;
 	snamelen = strlen(sname);
 	if (snamelen > 255)
 		return -EINVAL;
@@ -501,6 +591,10 @@ int snd_ctl_shm_open(snd_ctl_t **handlep, const char *name, const char *sockname
 
 	shm->socket = sock;
 	shm->ctrl = ctrl;
+	/* an older server has no cache after the control area */
+	if (shmctl(ans.cookie, IPC_STAT, &buf) == 0 &&
+	    buf.shm_segsz >= CTL_SHM_CACHE_SIZE && CTL_SHM_CACHE(ctrl)->enabled)
+		shm->cache = CTL_SHM_CACHE(ctrl);
 
 	err = snd_ctl_new(&ctl, SND_CTL_TYPE_SHM, name);
 	if (err < 0) {
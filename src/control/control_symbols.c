@@ -25,6 +25,7 @@ extern const char *_snd_module_control_empty;
 extern const char *_snd_module_control_remap;
 extern const char *_snd_module_control_shm;
 extern const char *_snd_module_control_ext;
+extern const char *_snd_module_control_mirror;
 
 static const char **snd_control_open_objects[] = {
 	&_snd_module_control_hw,
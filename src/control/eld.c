@@ -32,6 +32,56 @@
 #include <string.h>
 #include <ctype.h>
 #include "control_local.h"
+#include "list.h"
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+
+/*
+ * The decoded ELD is cached per card.  Each card keeps a ctl handle
+ * which is subscribed to the control events, an ELD value or info
+ * change drops the cached entry of that device, so that repeated
+ * snd_pcm_info() calls of the HDMI devices need no ctl open and read.
+ */
+
+#define ELD_KEEP	0	/* no ELD, keep the name */
+#define ELD_NAME	1	/* replace the name with the monitor name */
+#define ELD_PRESENT	2	/* append " *" to the name */
+
+struct eld_entry {
+	struct list_head list;
+	int device;
+	int subdevice;
+	int ret;			/* result of the decoding */
+	int action;			/* ELD_* */
+	char name[17];			/* monitor name for ELD_NAME */
+};
+
+struct eld_card {
+	struct list_head list;
+	int card;
+	snd_ctl_t *ctl;			/* nonblock, subscribed to events */
+	struct list_head entries;
+};
+
+static LIST_HEAD(eld_cards);
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t eld_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline void eld_cache_lock(void)
+{
+	pthread_mutex_lock(&eld_cache_mutex);
+}
+
+static inline void eld_cache_unlock(void)
+{
+	pthread_mutex_unlock(&eld_cache_mutex);
+}
+#else
+static inline void eld_cache_lock(void) {}
+static inline void eld_cache_unlock(void) {}
+#endif
 
 static void __fill_eld_ctl_id(snd_ctl_elem_id_t *id, int dev, int subdev)
 {
@@ -41,66 +91,224 @@ static void __fill_eld_ctl_id(snd_ctl_elem_id_t *id, int dev, int subdev)
 	snd_ctl_elem_id_set_index(id, subdev);
 }
 
-int __snd_pcm_info_eld_fixup(snd_pcm_info_t * info)
+static void eld_card_flush(struct eld_card *c, int device, int subdevice)
 {
-	snd_ctl_t *ctl;
-	snd_ctl_elem_info_t cinfo = {0};
-	snd_ctl_elem_value_t value = {0};
-	unsigned char *eld;
-	unsigned int l;
-	char *s, c;
-	int ret, valid;
+	struct list_head *pos, *npos;
+	struct eld_entry *e;
 
-	ret = snd_ctl_hw_open(&ctl, NULL, info->card, 0);
-	if (ret < 0) {
-		SYSMSG("Cannot open the associated CTL\n");
-		return ret;
+	list_for_each_safe(pos, npos, &c->entries) {
+		e = list_entry(pos, struct eld_entry, list);
+		if (device >= 0 && (e->device != device || e->subdevice != subdevice))
+			continue;
+		list_del(&e->list);
+		free(e);
 	}
+}
 
-	__fill_eld_ctl_id(&cinfo.id, info->device, info->subdevice);
-	value.id = cinfo.id;
-	ret = snd_ctl_elem_info(ctl, &cinfo);
-	if (ret >= 0 && cinfo.type == SND_CTL_ELEM_TYPE_BYTES)
-		ret = snd_ctl_elem_read(ctl, &value);
-	snd_ctl_close(ctl);
-	if (ret == -ENOENT || cinfo.type != SND_CTL_ELEM_TYPE_BYTES || cinfo.count == 0)
-		return 0;
-	if (ret < 0) {
-		SYSMSG("Cannot read ELD\n");
-		return ret;
+static void eld_card_free(struct eld_card *c)
+{
+	eld_card_flush(c, -1, -1);
+	snd_ctl_close(c->ctl);
+	list_del(&c->list);
+	free(c);
+}
+
+/* apply the pending events, returns a negative error when the card is gone */
+static int eld_card_update(struct eld_card *c)
+{
+	snd_ctl_event_t ev;
+	int err;
+
+	while ((err = snd_ctl_read(c->ctl, &ev)) > 0) {
+		if (ev.type != SND_CTL_EVENT_ELEM)
+			continue;
+		if (ev.data.elem.id.iface != SND_CTL_ELEM_IFACE_PCM ||
+		    strcmp((char *)ev.data.elem.id.name, "ELD"))
+			continue;
+		eld_card_flush(c, ev.data.elem.id.device, ev.data.elem.id.index);
+	}
+	return err == -EAGAIN ? 0 : err;
+}
+
+static struct eld_card *eld_card_get(int card)
+{
+	struct list_head *pos;
+	struct eld_card *c;
+	int err;
+
+	list_for_each(pos, &eld_cards) {
+		c = list_entry(pos, struct eld_card, list);
+		if (c->card != card)
+			continue;
+		if (eld_card_update(c) < 0) {
+			eld_card_free(c);
+			break;
+		}
+		return c;
+	}
+	c = calloc(1, sizeof(*c));
+	if (c == NULL)
+		return NULL;
+	err = snd_ctl_hw_open(&c->ctl, NULL, card, SND_CTL_NONBLOCK);
+	if (err < 0) {
+		free(c);
+		return NULL;
+	}
+	/* subscribe before the first read, so that no change is missed */
+	if (snd_ctl_subscribe_events(c->ctl, 1) < 0) {
+		snd_ctl_close(c->ctl);
+		free(c);
+		return NULL;
+	}
+	c->card = card;
+	INIT_LIST_HEAD(&c->entries);
+	list_add_tail(&c->list, &eld_cards);
+	return c;
+}
+
+static struct eld_entry *eld_card_find(struct eld_card *c, int device, int subdevice)
+{
+	struct list_head *pos;
+	struct eld_entry *e;
+
+	list_for_each(pos, &c->entries) {
+		e = list_entry(pos, struct eld_entry, list);
+		if (e->device == device && e->subdevice == subdevice)
+			return e;
 	}
+	return NULL;
+}
+
+static void eld_decode(const unsigned char *eld, unsigned int count,
+		       struct eld_entry *e)
+{
+	unsigned int l;
+	char c;
+	int valid;
+
+	e->ret = 0;
+	e->action = ELD_KEEP;
 	/* decode connected HDMI device name */
-	eld = value.value.bytes.data;
-	if (cinfo.count < 20 || cinfo.count > 256)
-		return -EIO;
+	if (count < 20 || count > 256) {
+		e->ret = -EIO;
+		return;
+	}
 	l = eld[4] & 0x1f;
-	if (l == 0)
+	if (l == 0) {
 		/* no monitor name detected */
-		goto __present;
-	if (l > 16 || 20 + l > cinfo.count) {
+		e->action = ELD_PRESENT;
+		return;
+	}
+	if (l > 16 || 20 + l > count) {
 		SNDERR("ELD decode failed, using old HDMI output names\n");
-		return 0;
+		return;
 	}
-	s = alloca(l + 1);
-	s[l] = '\0';
+	e->name[l] = '\0';
 	/* sanitize */
 	valid = 0;
 	while (l > 0) {
 		l--;
 		c = eld[20 + l];
 		if (c < ' ' || c >= 0x7f) {
-			s[l] = ' ';
+			e->name[l] = ' ';
 		} else {
 			valid += !!isalnum(c);
-			s[l] = c;
+			e->name[l] = c;
 		}
 	}
-	if (valid > 3) {
-		snd_strlcpy((char *)info->name, s, sizeof(info->name));
-	} else {
-__present:
+	e->action = valid > 3 ? ELD_NAME : ELD_PRESENT;
+}
+
+/* returns a negative error when the ELD control cannot be read */
+static int eld_read(snd_ctl_t *ctl, snd_pcm_info_t *info, struct eld_entry *e)
+{
+	snd_ctl_elem_info_t cinfo = {0};
+	snd_ctl_elem_value_t value = {0};
+	int ret;
+
+	__fill_eld_ctl_id(&cinfo.id, info->device, info->subdevice);
+	value.id = cinfo.id;
+	ret = snd_ctl_elem_info(ctl, &cinfo);
+	if (ret >= 0 && cinfo.type == SND_CTL_ELEM_TYPE_BYTES)
+		ret = snd_ctl_elem_read(ctl, &value);
+	if (ret == -ENOENT || cinfo.type != SND_CTL_ELEM_TYPE_BYTES || cinfo.count == 0) {
+		e->ret = 0;
+		e->action = ELD_KEEP;
+		return 0;
+	}
+	if (ret < 0) {
+		SYSMSG("Cannot read ELD\n");
+		return ret;
+	}
+	eld_decode(value.value.bytes.data, cinfo.count, e);
+	return 0;
+}
+
+static void eld_apply(snd_pcm_info_t *info, const struct eld_entry *e)
+{
+	switch (e->action) {
+	case ELD_NAME:
+		snd_strlcpy((char *)info->name, e->name, sizeof(info->name));
+		break;
+	case ELD_PRESENT:
 		strncat((char *)info->name, " *", sizeof(info->name) - 1);
 		((char *)info->name)[sizeof(info->name)-1] = '\0';
+		break;
 	}
-	return 0;
+}
+
+int __snd_pcm_info_eld_fixup(snd_pcm_info_t * info)
+{
+	struct eld_entry tmp, *e;
+	struct eld_card *c;
+	snd_ctl_t *ctl;
+	int ret;
+
+	eld_cache_lock();
+	c = eld_card_get(info->card);
+	if (c) {
+		e = eld_card_find(c, info->device, info->subdevice);
+		if (e) {
+			eld_apply(info, e);
+			ret = e->ret;
+			eld_cache_unlock();
+			return ret;
+		}
+		ctl = c->ctl;
+	} else {
+		ret = snd_ctl_hw_open(&ctl, NULL, info->card, 0);
+		if (ret < 0) {
+			eld_cache_unlock();
+			SYSMSG("Cannot open the associated CTL\n");
+			return ret;
+		}
+	}
+	ret = eld_read(ctl, info, &tmp);
+	if (c == NULL)
+		snd_ctl_close(ctl);
+	if (ret < 0) {
+		eld_cache_unlock();
+		return ret;
+	}
+	if (c) {
+		e = malloc(sizeof(*e));
+		if (e) {
+			*e = tmp;
+			e->device = info->device;
+			e->subdevice = info->subdevice;
+			list_add_tail(&e->list, &c->entries);
+		}
+	}
+	eld_cache_unlock();
+	eld_apply(info, &tmp);
+	return tmp.ret;
+}
+
+/* called from snd_config_update_free_global() */
+void __snd_pcm_info_eld_cache_free(void)
+{
+	eld_cache_lock();
+	while (!list_empty(&eld_cards))
+		eld_card_free(list_entry(eld_cards.next, struct eld_card, list));
+	eld_cache_unlock();
 }
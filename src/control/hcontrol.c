@@ -47,6 +47,7 @@ to reduce overhead accessing the real controls in kernel drivers.
 #include <unistd.h>
 #include <string.h>
 #include <fcntl.h>
+#include <time.h>
 #include <sys/ioctl.h>
 #include "control_local.h"
 #ifdef HAVE_LIBPTHREAD
@@ -95,6 +96,7 @@ int snd_hctl_open_ctl(snd_hctl_t **hctlp, snd_ctl_t *ctl)
 	if ((hctl = (snd_hctl_t *)calloc(1, sizeof(snd_hctl_t))) == NULL)
 		return -ENOMEM;
 	INIT_LIST_HEAD(&hctl->elems);
+	INIT_LIST_HEAD(&hctl->dirty);
 	hctl->ctl = ctl;
 	*hctlp = hctl;
 	return 0;
@@ -317,6 +319,312 @@ static int get_compare_weight(const snd_ctl_elem_id_t *id)
 	return res + res1;
 }
 
+/*
+ * The element info is read from the driver on the first request and kept
+ * until an info event for the element arrives.  The info of enumerated
+ * elements depends on the requested item, so the item names are kept
+ * separately.
+ */
+#define HCTL_INFO_CACHE_ITEMS	1024
+
+struct snd_hctl_elem_info_cache {
+	snd_ctl_elem_info_t info;
+	unsigned int items;		/* count of entries in names and have */
+	char (*names)[sizeof(((snd_ctl_elem_info_t *)0)->value.enumerated.name)];
+	unsigned char *have;
+};
+
+static void hctl_info_cache_free(snd_hctl_elem_t *elem)
+{
+	struct snd_hctl_elem_info_cache *c = elem->info;
+
+	if (!c)
+		return;
+	free(c->names);
+	free(c->have);
+	free(c);
+	elem->info = NULL;
+}
+
+/* return the cached info for the item requested in info, 0 if missing */
+static int hctl_info_cache_get(snd_hctl_elem_t *elem, snd_ctl_elem_info_t *info)
+{
+	struct snd_hctl_elem_info_cache *c = elem->info;
+	unsigned int item;
+
+	if (!c)
+		return 0;
+	if (c->info.type != SND_CTL_ELEM_TYPE_ENUMERATED) {
+		*info = c->info;
+		return 1;
+	}
+	item = info->value.enumerated.item;
+	if (item >= c->items || !c->have[item])
+		return 0;
+	*info = c->info;
+	info->value.enumerated.item = item;
+	memcpy(info->value.enumerated.name, c->names[item],
+	       sizeof(info->value.enumerated.name));
+	return 1;
+}
+
+static void hctl_info_cache_put(snd_hctl_elem_t *elem, const snd_ctl_elem_info_t *info)
+{
+	struct snd_hctl_elem_info_cache *c = elem->info;
+	unsigned int item;
+
+	if (!c) {
+		c = calloc(1, sizeof(*c));
+		if (!c)
+			return;
+		c->info = *info;
+		if (info->type == SND_CTL_ELEM_TYPE_ENUMERATED &&
+		    info->value.enumerated.items <= HCTL_INFO_CACHE_ITEMS) {
+			c->items = info->value.enumerated.items;
+			c->names = calloc(c->items, sizeof(*c->names));
+			c->have = calloc(c->items, 1);
+			if (c->items && (!c->names || !c->have)) {
+				free(c->names);
+				free(c->have);
+				c->names = NULL;
+				c->have = NULL;
+				c->items = 0;
+			}
+		}
+		elem->info = c;
+	}
+	if (info->type != SND_CTL_ELEM_TYPE_ENUMERATED)
+		return;
+	item = info->value.enumerated.item;
+	if (item < c->items) {
+		memcpy(c->names[item], info->value.enumerated.name,
+		       sizeof(c->names[item]));
+		c->have[item] = 1;
+	}
+}
+
+/*
+ * The dB information of an element: the parsed TLV and, for ranges up to
+ * HCTL_DB_TABLE_MAX values, the dB gain of every raw value.  Dropped on
+ * a TLV or info event for the element.
+ */
+#define HCTL_DB_TLV_SIZE	4096
+#define HCTL_DB_TABLE_MAX	4096
+
+struct snd_hctl_elem_db_cache {
+	int err;			/* the result of the parsing */
+	long min, max;			/* raw volume range */
+	unsigned int *tlv;		/* parsed dB TLV */
+	int range_err;
+	long dbmin, dbmax;		/* dB range */
+	long *table;			/* dB per raw value, or NULL */
+};
+
+static void hctl_db_cache_free(snd_hctl_elem_t *elem)
+{
+	struct snd_hctl_elem_db_cache *c = elem->db;
+
+	if (!c)
+		return;
+	free(c->tlv);
+	free(c->table);
+	free(c);
+	elem->db = NULL;
+}
+
+static int hctl_db_cache_parse(snd_hctl_elem_t *elem,
+			       struct snd_hctl_elem_db_cache *c)
+{
+	snd_ctl_elem_info_t info = {0};
+	unsigned int *buf, *dbrec;
+	unsigned long k, count;
+	int err, size;
+
+	err = snd_hctl_elem_info(elem, &info);
+	if (err < 0)
+		return err;
+	if (!snd_ctl_elem_info_is_tlv_readable(&info) ||
+	    snd_ctl_elem_info_get_type(&info) != SND_CTL_ELEM_TYPE_INTEGER)
+		return -EINVAL;
+	c->min = snd_ctl_elem_info_get_min(&info);
+	c->max = snd_ctl_elem_info_get_max(&info);
+	buf = malloc(HCTL_DB_TLV_SIZE);
+	if (!buf)
+		return -ENOMEM;
+	err = snd_hctl_elem_tlv_read(elem, buf, HCTL_DB_TLV_SIZE);
+	if (err < 0)
+		goto out;
+	size = snd_tlv_parse_dB_info(buf, HCTL_DB_TLV_SIZE, &dbrec);
+	if (size < 0) {
+		err = size;
+		goto out;
+	}
+	c->tlv = malloc(size);
+	if (!c->tlv) {
+		err = -ENOMEM;
+		goto out;
+	}
+	memcpy(c->tlv, dbrec, size);
+	c->range_err = snd_tlv_get_dB_range(c->tlv, c->min, c->max,
+					    &c->dbmin, &c->dbmax);
+	/* without the table the conversions are done on each call */
+	if (c->max < c->min ||
+	    (unsigned long)(c->max - c->min) >= HCTL_DB_TABLE_MAX)
+		goto out;
+	count = c->max - c->min + 1;
+	c->table = malloc(count * sizeof(*c->table));
+	if (!c->table)
+		goto out;
+	for (k = 0; k < count; k++) {
+		if (snd_tlv_convert_to_dB(c->tlv, c->min, c->max,
+					  c->min + k, &c->table[k]) < 0) {
+			free(c->table);
+			c->table = NULL;
+			break;
+		}
+	}
+ out:
+	free(buf);
+	return err;
+}
+
+static struct snd_hctl_elem_db_cache *hctl_db_cache_get(snd_hctl_elem_t *elem)
+{
+	struct snd_hctl_elem_db_cache *c = elem->db;
+
+	if (c)
+		return c;
+	c = calloc(1, sizeof(*c));
+	if (!c)
+		return NULL;
+	c->err = hctl_db_cache_parse(elem, c);
+	/* a failed allocation is not remembered */
+	if (c->err == -ENOMEM) {
+		free(c->tlv);
+		free(c);
+		return NULL;
+	}
+	elem->db = c;
+	return c;
+}
+
+/*
+ * Besides the sorted array, the elements are indexed by numid and hashed
+ * by the fields compared by snd_hctl_compare_default(), so an element is
+ * found without string compares on large mixers.
+ */
+static int hctl_id_equal(const snd_ctl_elem_id_t *a, const snd_ctl_elem_id_t *b)
+{
+	return a->iface == b->iface && a->device == b->device &&
+	       a->subdevice == b->subdevice && a->index == b->index &&
+	       strcmp((const char *)a->name, (const char *)b->name) == 0;
+}
+
+static unsigned int hctl_id_hash(const snd_ctl_elem_id_t *id)
+{
+	const unsigned char *s = id->name;
+	unsigned int h = 2166136261u;
+
+	while (*s) {
+		h ^= *s++;
+		h *= 16777619u;
+	}
+	h ^= id->iface * 31 + id->device * 131 + id->subdevice * 1031 + id->index;
+	return h * 2654435761u;
+}
+
+static void hctl_hash_insert(snd_hctl_t *hctl, snd_hctl_elem_t *elem)
+{
+	unsigned int b = hctl_id_hash(&elem->id) & (hctl->hash_size - 1);
+
+	elem->hash_next = hctl->hash[b];
+	hctl->hash[b] = elem;
+}
+
+static int hctl_index_add(snd_hctl_t *hctl, snd_hctl_elem_t *elem)
+{
+	unsigned int numid = elem->id.numid;
+
+	if (numid >= hctl->numids_alloc) {
+		unsigned int nalloc = hctl->numids_alloc ? hctl->numids_alloc : 64;
+		snd_hctl_elem_t **n;
+		while (nalloc <= numid)
+			nalloc *= 2;
+		n = realloc(hctl->numids, nalloc * sizeof(*n));
+		if (!n)
+			return -ENOMEM;
+		memset(n + hctl->numids_alloc, 0,
+		       (nalloc - hctl->numids_alloc) * sizeof(*n));
+		hctl->numids = n;
+		hctl->numids_alloc = nalloc;
+	}
+	if (hctl->count >= hctl->hash_size) {
+		unsigned int k, size = hctl->hash_size ? hctl->hash_size * 2 : 64;
+		snd_hctl_elem_t **h;
+		while (size <= hctl->count)
+			size *= 2;
+		h = calloc(size, sizeof(*h));
+		if (!h)
+			return -ENOMEM;
+		free(hctl->hash);
+		hctl->hash = h;
+		hctl->hash_size = size;
+		for (k = 0; k < hctl->count; k++)
+			if (hctl->pelems[k] != elem)
+				hctl_hash_insert(hctl, hctl->pelems[k]);
+	}
+	hctl->numids[numid] = elem;
+	hctl_hash_insert(hctl, elem);
+	return 0;
+}
+
+static void hctl_index_del(snd_hctl_t *hctl, snd_hctl_elem_t *elem)
+{
+	snd_hctl_elem_t **p;
+
+	if (elem->id.numid < hctl->numids_alloc &&
+	    hctl->numids[elem->id.numid] == elem)
+		hctl->numids[elem->id.numid] = NULL;
+	if (!hctl->hash_size)
+		return;
+	p = &hctl->hash[hctl_id_hash(&elem->id) & (hctl->hash_size - 1)];
+	for (; *p; p = &(*p)->hash_next) {
+		if (*p == elem) {
+			*p = elem->hash_next;
+			break;
+		}
+	}
+}
+
+static void hctl_index_free(snd_hctl_t *hctl)
+{
+	free(hctl->numids);
+	hctl->numids = NULL;
+	hctl->numids_alloc = 0;
+	free(hctl->hash);
+	hctl->hash = NULL;
+	hctl->hash_size = 0;
+}
+
+static snd_hctl_elem_t *hctl_index_find(snd_hctl_t *hctl, const snd_ctl_elem_id_t *id)
+{
+	snd_hctl_elem_t *elem;
+
+	if (id->numid && id->numid < hctl->numids_alloc) {
+		elem = hctl->numids[id->numid];
+		if (elem && hctl_id_equal(&elem->id, id))
+			return elem;
+	}
+	if (!hctl->hash_size)
+		return NULL;
+	elem = hctl->hash[hctl_id_hash(id) & (hctl->hash_size - 1)];
+	for (; elem; elem = elem->hash_next) {
+		if (hctl_id_equal(&elem->id, id))
+			return elem;
+	}
+	return NULL;
+}
+
 static int _snd_hctl_find_elem(snd_hctl_t *hctl, const snd_ctl_elem_id_t *id, int *dir)
 {
 	unsigned int l, u;
@@ -376,6 +684,8 @@ static int snd_hctl_elem_add(snd_hctl_t *hctl, snd_hctl_elem_t *elem)
 		hctl->pelems[idx] = elem;
 	}
 	hctl->count++;
+	if (hctl_index_add(hctl, elem) < 0)
+		hctl_index_free(hctl);
 	return snd_hctl_throw_event(hctl, SNDRV_CTL_EVENT_MASK_ADD, elem);
 }
 
@@ -384,7 +694,12 @@ static void snd_hctl_elem_remove(snd_hctl_t *hctl, unsigned int idx)
 	snd_hctl_elem_t *elem = hctl->pelems[idx];
 	unsigned int m;
 	snd_hctl_elem_throw_event(elem, SNDRV_CTL_EVENT_MASK_REMOVE);
+	hctl_index_del(hctl, elem);
 	list_del(&elem->list);
+	if (elem->dirty)
+		list_del(&elem->dirty_list);
+	hctl_info_cache_free(elem);
+	hctl_db_cache_free(elem);
 	free(elem);
 	hctl->count--;
 	m = hctl->count - idx;
@@ -406,6 +721,7 @@ int snd_hctl_free(snd_hctl_t *hctl)
 	free(hctl->pelems);
 	hctl->pelems = 0;
 	hctl->alloc = 0;
+	hctl_index_free(hctl);
 	INIT_LIST_HEAD(&hctl->elems);
 	return 0;
 }
@@ -551,7 +867,12 @@ snd_hctl_elem_t *snd_hctl_elem_prev(snd_hctl_elem_t *elem)
 snd_hctl_elem_t *snd_hctl_find_elem(snd_hctl_t *hctl, const snd_ctl_elem_id_t *id)
 {
 	int dir;
-	int res = _snd_hctl_find_elem(hctl, id, &dir);
+	int res;
+
+	/* the index matches the elements equal for the default compare */
+	if (hctl->compare == snd_hctl_compare_default && hctl->hash_size)
+		return hctl_index_find(hctl, id);
+	res = _snd_hctl_find_elem(hctl, id, &dir);
 	if (res < 0 || dir != 0)
 		return NULL;
 	return hctl->pelems[res];
@@ -605,6 +926,8 @@ int snd_hctl_load(snd_hctl_t *hctl)
 		hctl->pelems[idx] = elem;
 		list_add_tail(&elem->list, &hctl->elems);
 		hctl->count++;
+		if (hctl_index_add(hctl, elem) < 0)
+			hctl_index_free(hctl);
 	}
 	if (!hctl->compare)
 		hctl->compare = snd_hctl_compare_default;
@@ -670,14 +993,19 @@ unsigned int snd_hctl_get_count(snd_hctl_t *hctl)
  * \param timeout maximum time in milliseconds to wait
  * \return a positive value on success otherwise a negative error code
  * \retval 0 timeout occurred
- * \retval 1 an event is pending
+ * \retval 1 an event is pending or coalesced events are due
  */
 int snd_hctl_wait(snd_hctl_t *hctl, int timeout)
 {
 	struct pollfd *pfd;
 	unsigned short *revents;
-	int i, npfds, pollio, err, err_poll;
+	int i, npfds, pollio, err, err_poll, due;
 	
+	due = snd_hctl_coalesce_timeout(hctl);
+	if (due >= 0 && (timeout < 0 || due <= timeout))
+		timeout = due;
+	else
+		due = -1;
 	npfds = snd_hctl_poll_descriptors_count(hctl);
 	if (npfds <= 0 || npfds >= 16) {
 		SNDERR("Invalid poll_fds %d\n", npfds);
@@ -713,7 +1041,7 @@ int snd_hctl_wait(snd_hctl_t *hctl, int timeout)
 			pollio++;
 		}
 	} while (! pollio);
-	return err_poll > 0 ? 1 : 0;
+	return err_poll > 0 || due >= 0 ? 1 : 0;
 }
 
 /**
@@ -747,6 +1075,12 @@ static int snd_hctl_handle_event(snd_hctl_t *hctl, snd_ctl_event_t *event)
 		snd_hctl_elem_remove(hctl, (unsigned int) res);
 		return 0;
 	}
+	if (event->data.elem.mask & (SNDRV_CTL_EVENT_MASK_TLV |
+				     SNDRV_CTL_EVENT_MASK_INFO)) {
+		elem = snd_hctl_find_elem(hctl, &event->data.elem.id);
+		if (elem)
+			hctl_db_cache_free(elem);
+	}
 	if (event->data.elem.mask & SNDRV_CTL_EVENT_MASK_ADD) {
 		elem = calloc(1, sizeof(snd_hctl_elem_t));
 		if (elem == NULL)
@@ -762,6 +1096,16 @@ static int snd_hctl_handle_event(snd_hctl_t *hctl, snd_ctl_event_t *event)
 		elem = snd_hctl_find_elem(hctl, &event->data.elem.id);
 		if (!elem)
 			return -ENOENT;
+		if (event->data.elem.mask & SNDRV_CTL_EVENT_MASK_INFO)
+			hctl_info_cache_free(elem);
+		if (hctl->coalesce) {
+			if (!elem->dirty)
+				list_add_tail(&elem->dirty_list, &hctl->dirty);
+			elem->dirty |= event->data.elem.mask &
+				       (SNDRV_CTL_EVENT_MASK_VALUE |
+					SNDRV_CTL_EVENT_MASK_INFO);
+			return 0;
+		}
 		res = snd_hctl_elem_throw_event(elem, event->data.elem.mask &
 						(SNDRV_CTL_EVENT_MASK_VALUE |
 						 SNDRV_CTL_EVENT_MASK_INFO));
@@ -771,10 +1115,113 @@ static int snd_hctl_handle_event(snd_hctl_t *hctl, snd_ctl_event_t *event)
 	return 0;
 }
 
+static unsigned long long hctl_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* usec until the coalesced events of elem may be dispatched */
+static unsigned long long hctl_dirty_delay(snd_hctl_t *hctl,
+					   snd_hctl_elem_t *elem,
+					   unsigned long long now)
+{
+	if (!hctl->coalesce || !elem->stamp ||
+	    now - elem->stamp >= hctl->coalesce_interval)
+		return 0;
+	return elem->stamp + hctl->coalesce_interval - now;
+}
+
+/*
+ * Invoke the callbacks of the elements with coalesced events, once per
+ * element.  Elements still within the rate limit stay on the list.
+ */
+static int hctl_dispatch_dirty(snd_hctl_t *hctl)
+{
+	struct list_head pending;
+	unsigned long long now;
+	snd_hctl_elem_t *elem;
+	unsigned int mask;
+	int res = 0;
+
+	if (list_empty(&hctl->dirty))
+		return 0;
+	/* callbacks may remove elements, so work on a private list */
+	INIT_LIST_HEAD(&pending);
+	list_insert(&pending, hctl->dirty.prev, hctl->dirty.next);
+	INIT_LIST_HEAD(&hctl->dirty);
+	now = hctl_now();
+	while (!list_empty(&pending)) {
+		elem = list_entry(pending.next, snd_hctl_elem_t, dirty_list);
+		list_del(&elem->dirty_list);
+		if (res < 0 || hctl_dirty_delay(hctl, elem, now)) {
+			list_add_tail(&elem->dirty_list, &hctl->dirty);
+			continue;
+		}
+		mask = elem->dirty;
+		elem->dirty = 0;
+		elem->stamp = now;
+		res = snd_hctl_elem_throw_event(elem, mask);
+	}
+	return res;
+}
+
+/**
+ * \brief Set the event coalescing mode of an HCTL
+ * \param hctl HCTL handle
+ * \param enable 0 = deliver every event, 1 = coalesce the events
+ * \param interval minimum time between two callbacks of an element (usec)
+ * \return 0 on success otherwise a negative error code
+ *
+ * In the coalescing mode #snd_hctl_handle_events drains all pending
+ * events first, merges the value and info events of each element and
+ * then invokes each element callback once with the merged mask.  An
+ * element called back less than \p interval ago is kept pending; use
+ * #snd_hctl_coalesce_timeout or #snd_hctl_wait to be woken up for it.
+ * Add and remove events are always delivered immediately.
+ */
+int snd_hctl_set_coalesce(snd_hctl_t *hctl, int enable, unsigned int interval)
+{
+	assert(hctl);
+	hctl->coalesce = !!enable;
+	hctl->coalesce_interval = enable ? interval : 0;
+	if (!enable)
+		return hctl_dispatch_dirty(hctl);
+	return 0;
+}
+
+/**
+ * \brief Get the time until the coalesced events are due
+ * \param hctl HCTL handle
+ * \return milliseconds until #snd_hctl_handle_events has coalesced events
+ *         to dispatch, 0 if they are due now or -1 if none are pending
+ */
+int snd_hctl_coalesce_timeout(snd_hctl_t *hctl)
+{
+	struct list_head *pos;
+	unsigned long long now, delay, min = ~0ULL;
+
+	assert(hctl);
+	if (list_empty(&hctl->dirty))
+		return -1;
+	now = hctl_now();
+	list_for_each(pos, &hctl->dirty) {
+		snd_hctl_elem_t *elem = list_entry(pos, snd_hctl_elem_t, dirty_list);
+		delay = hctl_dirty_delay(hctl, elem, now);
+		if (delay < min)
+			min = delay;
+	}
+	return (int)((min + 999) / 1000);
+}
+
 /**
  * \brief Handle pending HCTL events invoking callbacks
  * \param hctl HCTL handle
  * \return 0 otherwise a negative error code on failure
+ *
+ * See #snd_hctl_set_coalesce for the delivery in the coalescing mode.
  */
 int snd_hctl_handle_events(snd_hctl_t *hctl)
 {
@@ -793,6 +1240,9 @@ int snd_hctl_handle_events(snd_hctl_t *hctl)
 			return res;
 		count++;
 	}
+	res = hctl_dispatch_dirty(hctl);
+	if (res < 0)
+		return res;
 	return count;
 }
 
@@ -801,14 +1251,25 @@ int snd_hctl_handle_events(snd_hctl_t *hctl)
  * \param elem HCTL element
  * \param info HCTL element information
  * \return 0 otherwise a negative error code on failure
+ *
+ * The information is read from the driver once and then kept until an
+ * info event for the element is handled (#snd_hctl_handle_events).  The
+ * lock owner is therefore the one at the time of the first read.
  */
 int snd_hctl_elem_info(snd_hctl_elem_t *elem, snd_ctl_elem_info_t *info)
 {
+	int err;
+
 	assert(elem);
 	assert(elem->hctl);
 	assert(info);
+	if (hctl_info_cache_get(elem, info))
+		return 0;
 	info->id = elem->id;
-	return snd_ctl_elem_info(elem->hctl->ctl, info);
+	err = snd_ctl_elem_info(elem->hctl->ctl, info);
+	if (err >= 0)
+		hctl_info_cache_put(elem, info);
+	return err;
 }
 
 /**
@@ -826,6 +1287,29 @@ int snd_hctl_elem_read(snd_hctl_elem_t *elem, snd_ctl_elem_value_t * value)
 	return snd_ctl_elem_read(elem->hctl->ctl, value);
 }
 
+/**
+ * \brief Get values for several HCTL elements of the same HCTL handle
+ * \param elems HCTL elements
+ * \param values HCTL element values, one for each element
+ * \param count Count of the elements
+ * \return count of the values read (see #snd_ctl_elem_read_multi)
+ *         otherwise a negative error code on failure
+ */
+int snd_hctl_elem_read_multi(snd_hctl_elem_t **elems,
+			     snd_ctl_elem_value_t **values, unsigned int count)
+{
+	unsigned int k;
+
+	if (count == 0)
+		return 0;
+	assert(elems && values);
+	for (k = 0; k < count; k++) {
+		assert(elems[k]->hctl == elems[0]->hctl);
+		values[k]->id = elems[k]->id;
+	}
+	return snd_ctl_elem_read_multi(elems[0]->hctl->ctl, values, count);
+}
+
 /**
  * \brief Set value for an HCTL element
  * \param elem HCTL element
@@ -843,6 +1327,30 @@ int snd_hctl_elem_write(snd_hctl_elem_t *elem, snd_ctl_elem_value_t * value)
 	return snd_ctl_elem_write(elem->hctl->ctl, value);
 }
 
+/**
+ * \brief Set values for several HCTL elements
+ * \param elems HCTL elements, all of the same HCTL handle
+ * \param values new values, one for each element
+ * \param count count of the elements
+ * \return the count of the values written, or a negative error code
+ *
+ * See #snd_ctl_elem_write_multi() for the partial success.
+ */
+int snd_hctl_elem_write_multi(snd_hctl_elem_t **elems,
+			      snd_ctl_elem_value_t **values, unsigned int count)
+{
+	unsigned int k;
+
+	if (count == 0)
+		return 0;
+	assert(elems && values);
+	for (k = 0; k < count; k++) {
+		assert(elems[k]->hctl == elems[0]->hctl);
+		values[k]->id = elems[k]->id;
+	}
+	return snd_ctl_elem_write_multi(elems[0]->hctl->ctl, values, count);
+}
+
 /**
  * \brief Get TLV value for an HCTL element
  * \param elem HCTL element
@@ -890,6 +1398,89 @@ int snd_hctl_elem_tlv_command(snd_hctl_elem_t *elem, const unsigned int *tlv)
 	return snd_ctl_elem_tlv_command(elem->hctl->ctl, &elem->id, tlv);
 }
 
+/**
+ * \brief Get the dB min/max values of an HCTL element
+ * \param elem HCTL element
+ * \param min the pointer to store the minimum dB value (in 0.01dB unit)
+ * \param max the pointer to store the maximum dB value (in 0.01dB unit)
+ * \return 0 if successful, or a negative error code
+ *
+ * Same as #snd_ctl_get_dB_range(), but the TLV is read and parsed only
+ * once and kept until a TLV or info event for the element is handled
+ * (#snd_hctl_handle_events).
+ */
+int snd_hctl_elem_get_dB_range(snd_hctl_elem_t *elem, long *min, long *max)
+{
+	struct snd_hctl_elem_db_cache *c;
+
+	assert(elem);
+	c = hctl_db_cache_get(elem);
+	if (!c)
+		return -ENOMEM;
+	if (c->err < 0)
+		return c->err;
+	if (c->range_err < 0)
+		return c->range_err;
+	*min = c->dbmin;
+	*max = c->dbmax;
+	return 0;
+}
+
+/**
+ * \brief Convert the volume value to dB on an HCTL element
+ * \param elem HCTL element
+ * \param volume the raw volume value to convert
+ * \param db_gain the dB gain (in 0.01dB unit)
+ * \return 0 if successful, or a negative error code
+ *
+ * Same as #snd_ctl_convert_to_dB(), but uses the dB information kept
+ * with the element, see #snd_hctl_elem_get_dB_range().
+ */
+int snd_hctl_elem_convert_to_dB(snd_hctl_elem_t *elem, long volume,
+				long *db_gain)
+{
+	struct snd_hctl_elem_db_cache *c;
+
+	assert(elem);
+	c = hctl_db_cache_get(elem);
+	if (!c)
+		return -ENOMEM;
+	if (c->err < 0)
+		return c->err;
+	if (c->table && volume >= c->min && volume <= c->max) {
+		*db_gain = c->table[volume - c->min];
+		return 0;
+	}
+	return snd_tlv_convert_to_dB(c->tlv, c->min, c->max, volume, db_gain);
+}
+
+/**
+ * \brief Convert from dB gain to the raw volume value on an HCTL element
+ * \param elem HCTL element
+ * \param db_gain the dB gain to convert (in 0.01dB unit)
+ * \param value the pointer to store the converted raw volume value
+ * \param xdir the direction for round-up. The value is round up
+ *        when this is positive.
+ * \return 0 if successful, or a negative error code
+ *
+ * Same as #snd_ctl_convert_from_dB(), but uses the dB information kept
+ * with the element, see #snd_hctl_elem_get_dB_range().
+ */
+int snd_hctl_elem_convert_from_dB(snd_hctl_elem_t *elem, long db_gain,
+				  long *value, int xdir)
+{
+	struct snd_hctl_elem_db_cache *c;
+
+	assert(elem);
+	c = hctl_db_cache_get(elem);
+	if (!c)
+		return -ENOMEM;
+	if (c->err < 0)
+		return c->err;
+	return snd_tlv_convert_from_dB(c->tlv, c->min, c->max,
+				       db_gain, value, xdir);
+}
+
 /**
  * \brief Get HCTL handle for an HCTL element
  * \param elem HCTL element
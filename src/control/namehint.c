@@ -26,6 +26,11 @@
  */
 
 #include "local.h"
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #ifndef DOC_HIDDEN
 #define DEV_SKIP	9999 /* some non-existing device number */
@@ -553,47 +558,16 @@ static int add_software_devices(snd_config_t *config, snd_config_t *rw_config,
 	return 0;
 }
 
-/**
- * \brief Get a set of device name hints
- * \param card Card number or -1 (means all cards)
- * \param iface Interface identification (like "pcm", "rawmidi", "timer", "seq")
- * \param hints Result - array of device name hints
- * \result zero if success, otherwise a negative error code
- *
- * hints will receive a NULL-terminated array of device name hints,
- * which can be passed to #snd_device_name_get_hint to extract usable
- * values. When no longer needed, hints should be passed to
- * #snd_device_name_free_hint to release resources.
- *
- * User-defined hints are gathered from namehint.IFACE tree like:
- *
- * <code>
- * namehint.pcm [<br>
- *   myfile "file:FILE=/tmp/soundwave.raw|Save sound output to /tmp/soundwave.raw"<br>
- *   myplug "plug:front|Do all conversions for front speakers"<br>
- * ]
- * </code>
- *
- * Note: The device description is separated with '|' char.
- *
- * Special variables: defaults.namehint.showall specifies if all device
- * definitions are accepted (boolean type).
- */
-int snd_device_name_hint(int card, const char *iface, void ***hints)
+static int hint_build(snd_config_t *local_config, int card, const char *iface,
+		      char ***hints)
 {
 	struct hint_list list;
 	char ehints[24];
 	const char *str;
-	snd_config_t *conf, *local_config = NULL, *local_config_rw = NULL;
-	snd_config_update_t *local_config_update = NULL;
+	snd_config_t *conf, *local_config_rw = NULL;
 	snd_config_iterator_t i, next;
 	int err;
 
-	if (hints == NULL)
-		return -EINVAL;
-	err = snd_config_update_r(&local_config, &local_config_update, NULL);
-	if (err < 0)
-		return err;
 	err = snd_config_copy(&local_config_rw, local_config);
 	if (err < 0)
 		return err;
@@ -666,14 +640,181 @@ int snd_device_name_hint(int card, const char *iface, void ***hints)
 	if (err < 0)
       		snd_device_name_free_hint((void **)list.list);
 	else
-      		*hints = (void **)list.list;
+      		*hints = list.list;
 	free(list.cardname);
 	if (local_config_rw)
 		snd_config_delete(local_config_rw);
-	if (local_config)
-		snd_config_delete(local_config);
-	if (local_config_update)
-		snd_config_update_free(local_config_update);
+	return err;
+}
+
+/*
+ * The hints are remembered per card and interface.  They stay valid while
+ * the configuration files are unchanged, as the private tree is kept up
+ * to date with snd_config_update_r(), and while the device directory is
+ * unmodified: the device nodes are created and removed when cards or
+ * devices come and go.
+ */
+struct hint_cache {
+	struct hint_cache *next;
+	int card;
+	char *iface;
+	char **list;
+};
+
+struct hint_devdir {
+	int absent;
+	dev_t dev;
+	ino_t ino;
+	struct timespec mtime;
+};
+
+static snd_config_t *hint_cache_config;
+static snd_config_update_t *hint_cache_update;
+static struct hint_devdir hint_cache_devdir;
+static struct hint_cache *hint_cache_list;
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t hint_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define hint_cache_lock()	pthread_mutex_lock(&hint_cache_mutex)
+#define hint_cache_unlock()	pthread_mutex_unlock(&hint_cache_mutex)
+#else
+#define hint_cache_lock()	do { } while (0)
+#define hint_cache_unlock()	do { } while (0)
+#endif
+
+static void hint_devdir_stat(struct hint_devdir *d)
+{
+	struct stat st;
+
+	memset(d, 0, sizeof(*d));
+	if (stat(ALSA_DEVICE_DIRECTORY, &st) < 0) {
+		d->absent = 1;
+		return;
+	}
+	d->dev = st.st_dev;
+	d->ino = st.st_ino;
+	d->mtime = st.st_mtim;
+}
+
+static void hint_cache_flush(void)
+{
+	struct hint_cache *c;
+
+	while ((c = hint_cache_list) != NULL) {
+		hint_cache_list = c->next;
+		snd_device_name_free_hint((void **)c->list);
+		free(c->iface);
+		free(c);
+	}
+}
+
+static char **hint_list_dup(char **list)
+{
+	unsigned int k, count;
+	char **res;
+
+	for (count = 0; list[count]; count++)
+		;
+	res = calloc(count + 1, sizeof(*res));
+	if (res == NULL)
+		return NULL;
+	for (k = 0; k < count; k++) {
+		res[k] = strdup(list[k]);
+		if (res[k] == NULL) {
+			snd_device_name_free_hint((void **)res);
+			return NULL;
+		}
+	}
+	return res;
+}
+
+/* drop the remembered hints if the configuration or the devices changed */
+static int hint_cache_validate(void)
+{
+	struct hint_devdir d;
+	int err;
+
+	err = snd_config_update_r(&hint_cache_config, &hint_cache_update, NULL);
+	hint_devdir_stat(&d);
+	if (err != 0 ||
+	    d.absent != hint_cache_devdir.absent ||
+	    d.dev != hint_cache_devdir.dev || d.ino != hint_cache_devdir.ino ||
+	    d.mtime.tv_sec != hint_cache_devdir.mtime.tv_sec ||
+	    d.mtime.tv_nsec != hint_cache_devdir.mtime.tv_nsec)
+		hint_cache_flush();
+	hint_cache_devdir = d;
+	return err;
+}
+
+/**
+ * \brief Get a set of device name hints
+ * \param card Card number or -1 (means all cards)
+ * \param iface Interface identification (like "pcm", "rawmidi", "timer", "seq")
+ * \param hints Result - array of device name hints
+ * \result zero if success, otherwise a negative error code
+ *
+ * hints will receive a NULL-terminated array of device name hints,
+ * which can be passed to #snd_device_name_get_hint to extract usable
+ * values. When no longer needed, hints should be passed to
+ * #snd_device_name_free_hint to release resources.
+ *
+ * User-defined hints are gathered from namehint.IFACE tree like:
+ *
+ * <code>
+ * namehint.pcm [<br>
+ *   myfile "file:FILE=/tmp/soundwave.raw|Save sound output to /tmp/soundwave.raw"<br>
+ *   myplug "plug:front|Do all conversions for front speakers"<br>
+ * ]
+ * </code>
+ *
+ * Note: The device description is separated with '|' char.
+ *
+ * Special variables: defaults.namehint.showall specifies if all device
+ * definitions are accepted (boolean type).
+ *
+ * The hints are remembered, and are gathered again only when the
+ * configuration files or the device nodes change.  Use
+ * #snd_device_name_monitor_open to be notified about the changes.
+ */
+int snd_device_name_hint(int card, const char *iface, void ***hints)
+{
+	struct hint_cache *c;
+	char **list;
+	int err;
+
+	if (hints == NULL)
+		return -EINVAL;
+	hint_cache_lock();
+	err = hint_cache_validate();
+	if (err < 0)
+		goto __unlock;
+	for (c = hint_cache_list; c; c = c->next) {
+		if (c->card == card && strcmp(c->iface, iface) == 0)
+			break;
+	}
+	if (c == NULL) {
+		err = hint_build(hint_cache_config, card, iface, &list);
+		if (err < 0)
+			goto __unlock;
+		c = calloc(1, sizeof(*c));
+		if (c)
+			c->iface = strdup(iface);
+		if (c == NULL || c->iface == NULL) {
+			free(c);
+			*hints = (void **)list;
+			goto __unlock;
+		}
+		c->card = card;
+		c->list = list;
+		c->next = hint_cache_list;
+		hint_cache_list = c;
+	}
+	list = hint_list_dup(c->list);
+	if (list == NULL)
+		err = -ENOMEM;
+	else
+		*hints = (void **)list;
+      __unlock:
+	hint_cache_unlock();
 	return err;
 }
 
@@ -738,3 +879,218 @@ char *snd_device_name_get_hint(const void *hint, const char *id)
 	}
 	return NULL;
 }
+
+#ifndef DOC_HIDDEN
+struct _snd_device_name_monitor {
+	int fd;
+	int wd;
+	int card;
+	char *iface;
+	char **hints;
+};
+#endif
+
+/* watch the device directory, or its parent while it does not exist */
+static void monitor_watch(snd_device_name_monitor_t *monitor)
+{
+	char dir[sizeof(ALSA_DEVICE_DIRECTORY)], *s;
+
+	if (monitor->wd >= 0)
+		return;
+	monitor->wd = inotify_add_watch(monitor->fd, ALSA_DEVICE_DIRECTORY,
+					IN_CREATE | IN_DELETE | IN_ATTRIB |
+					IN_MOVED_FROM | IN_MOVED_TO |
+					IN_DELETE_SELF);
+	if (monitor->wd >= 0)
+		return;
+	strcpy(dir, ALSA_DEVICE_DIRECTORY);
+	s = dir + strlen(dir);
+	while (s > dir && s[-1] == '/')
+		*--s = '\0';
+	s = strrchr(dir, '/');
+	if (s == NULL)
+		return;
+	if (s == dir)
+		s[1] = '\0';
+	else
+		*s = '\0';
+	inotify_add_watch(monitor->fd, dir, IN_CREATE | IN_MOVED_TO);
+}
+
+/**
+ * \brief Open a monitor of the device name hints
+ * \param monitor Returned monitor handle
+ * \param card Card number or -1 (means all cards)
+ * \param iface Interface identification (like "pcm", "rawmidi", "timer", "seq")
+ * \result zero if success, otherwise a negative error code
+ *
+ * The monitor remembers the hints returned by #snd_device_name_hint for
+ * \a card and \a iface.  Its poll descriptor becomes readable when the
+ * device nodes change (cards or devices are added or removed); then
+ * #snd_device_name_monitor_read returns the hints which were added and
+ * removed since the last read.
+ */
+int snd_device_name_monitor_open(snd_device_name_monitor_t **monitor, int card,
+				 const char *iface)
+{
+	snd_device_name_monitor_t *m;
+	void **hints;
+	int err;
+
+	assert(monitor && iface);
+	m = calloc(1, sizeof(*m));
+	if (m == NULL)
+		return -ENOMEM;
+	m->wd = -1;
+	m->card = card;
+	m->iface = strdup(iface);
+	if (m->iface == NULL) {
+		err = -ENOMEM;
+		goto __error;
+	}
+	m->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m->fd < 0) {
+		err = -errno;
+		goto __error;
+	}
+	monitor_watch(m);
+	err = snd_device_name_hint(card, iface, &hints);
+	if (err < 0) {
+		close(m->fd);
+		goto __error;
+	}
+	m->hints = (char **)hints;
+	*monitor = m;
+	return 0;
+      __error:
+	free(m->iface);
+	free(m);
+	return err;
+}
+
+/**
+ * \brief Close a monitor of the device name hints
+ * \param monitor Monitor handle
+ * \result zero if success, otherwise a negative error code
+ */
+int snd_device_name_monitor_close(snd_device_name_monitor_t *monitor)
+{
+	assert(monitor);
+	close(monitor->fd);
+	snd_device_name_free_hint((void **)monitor->hints);
+	free(monitor->iface);
+	free(monitor);
+	return 0;
+}
+
+/**
+ * \brief Get the count of poll descriptors of a monitor
+ * \param monitor Monitor handle
+ * \result count of poll descriptors
+ */
+int snd_device_name_monitor_poll_descriptors_count(snd_device_name_monitor_t *monitor ATTRIBUTE_UNUSED)
+{
+	return 1;
+}
+
+/**
+ * \brief Get the poll descriptors of a monitor
+ * \param monitor Monitor handle
+ * \param pfds Array of poll descriptors
+ * \param space Space in the poll descriptor array
+ * \result count of filled descriptors
+ */
+int snd_device_name_monitor_poll_descriptors(snd_device_name_monitor_t *monitor,
+					     struct pollfd *pfds, unsigned int space)
+{
+	assert(monitor && pfds);
+	if (space < 1)
+		return 0;
+	pfds->fd = monitor->fd;
+	pfds->events = POLLIN;
+	pfds->revents = 0;
+	return 1;
+}
+
+static int hint_find(char **list, const char *hint)
+{
+	for (; *list; list++) {
+		if (strcmp(*list, hint) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+/* the hints of a which are not in b */
+static char **hint_list_diff(char **a, char **b)
+{
+	unsigned int k, count = 0;
+	char **res;
+
+	for (k = 0; a[k]; k++)
+		count++;
+	res = calloc(count + 1, sizeof(*res));
+	if (res == NULL)
+		return NULL;
+	for (k = 0, count = 0; a[k]; k++) {
+		if (hint_find(b, a[k]))
+			continue;
+		res[count] = strdup(a[k]);
+		if (res[count] == NULL) {
+			snd_device_name_free_hint((void **)res);
+			return NULL;
+		}
+		count++;
+	}
+	return res;
+}
+
+/**
+ * \brief Read the changes of the device name hints
+ * \param monitor Monitor handle
+ * \param added Result - NULL-terminated array of the new hints
+ * \param removed Result - NULL-terminated array of the removed hints
+ * \result 1 if the hints changed, 0 if not, otherwise a negative error code
+ *
+ * The pending events of the poll descriptor are consumed.  Changes of the
+ * configuration files are also detected, but they do not wake up the poll
+ * descriptor.  Both arrays are returned on success (empty when nothing
+ * changed) and must be released with #snd_device_name_free_hint.
+ */
+int snd_device_name_monitor_read(snd_device_name_monitor_t *monitor,
+				 void ***added, void ***removed)
+{
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	char **add, **rem;
+	void **hints;
+	ssize_t len;
+	char *ptr;
+	int err;
+
+	assert(monitor && added && removed);
+	while ((len = read(monitor->fd, buf, sizeof(buf))) > 0) {
+		for (ptr = buf; ptr < buf + len; ) {
+			struct inotify_event *ev = (struct inotify_event *)ptr;
+			if (ev->wd == monitor->wd && (ev->mask & IN_IGNORED))
+				monitor->wd = -1;
+			ptr += sizeof(*ev) + ev->len;
+		}
+	}
+	monitor_watch(monitor);
+	err = snd_device_name_hint(monitor->card, monitor->iface, &hints);
+	if (err < 0)
+		return err;
+	add = hint_list_diff((char **)hints, monitor->hints);
+	rem = hint_list_diff(monitor->hints, (char **)hints);
+	if (add == NULL || rem == NULL) {
+		snd_device_name_free_hint((void **)add);
+		snd_device_name_free_hint((void **)rem);
+		snd_device_name_free_hint(hints);
+		return -ENOMEM;
+	}
+	snd_device_name_free_hint((void **)monitor->hints);
+	monitor->hints = (char **)hints;
+	*added = (void **)add;
+	*removed = (void **)rem;
+	return *add || *rem;
+}
@@ -0,0 +1,150 @@
+/*
+ *  CPU feature detection for the DSP kernels
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * The mixing, conversion and resampling code keeps its variants in
+ * tables of entries starting with the SND_CPU_* mask they need, best
+ * first and closed by the generic entry (mask 0), and takes the first
+ * one snd_cpu_select() finds runnable, usually once per setup.
+ *
+ * LIBASOUND_CPU caps the detected features at a level, to compare the
+ * kernels or to rule one out while debugging: generic, mmx, sse2,
+ * sse4.1, avx2 or neon.  A level above the CPU gives what it has.
+ *
+ *	LIBASOUND_CPU=generic aplay -D plug:dmix foo.wav
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "local.h"
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+
+#define CPU_X86_MMX	(SND_CPU_MMX | SND_CPU_CMOV)
+#define CPU_X86_SSE2	(CPU_X86_MMX | SND_CPU_SSE | SND_CPU_SSE2)
+#define CPU_X86_SSE4_1	(CPU_X86_SSE2 | SND_CPU_SSE4_1)
+#define CPU_X86_AVX2	(CPU_X86_SSE4_1 | SND_CPU_AVX2 | SND_CPU_FMA)
+
+static const struct {
+	const char *name;
+	unsigned int mask;
+} cpu_levels[] = {
+	{ "generic", 0 },
+	{ "mmx", CPU_X86_MMX },
+	{ "sse2", CPU_X86_SSE2 },
+	{ "sse4.1", CPU_X86_SSE4_1 },
+	{ "avx2", CPU_X86_AVX2 },
+	{ "neon", SND_CPU_NEON },
+};
+
+static int cpu_state;		/* 0 = not checked yet */
+static unsigned int cpu_features;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t cpu_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline void cpu_lock(void)
+{
+	pthread_mutex_lock(&cpu_mutex);
+}
+
+static inline void cpu_unlock(void)
+{
+	pthread_mutex_unlock(&cpu_mutex);
+}
+#else
+static inline void cpu_lock(void) {}
+static inline void cpu_unlock(void) {}
+#endif
+
+static unsigned int cpu_detect(void)
+{
+	unsigned int features = 0;
+
+#if (defined(__i386__) || defined(__x86_64__)) && \
+    (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("mmx"))
+		features |= SND_CPU_MMX;
+	if (__builtin_cpu_supports("cmov"))
+		features |= SND_CPU_CMOV;
+	if (__builtin_cpu_supports("sse"))
+		features |= SND_CPU_SSE;
+	if (__builtin_cpu_supports("sse2"))
+		features |= SND_CPU_SSE2;
+	if (__builtin_cpu_supports("sse4.1"))
+		features |= SND_CPU_SSE4_1;
+	if (__builtin_cpu_supports("avx2"))
+		features |= SND_CPU_AVX2;
+	if (__builtin_cpu_supports("fma"))
+		features |= SND_CPU_FMA;
+#elif defined(__x86_64__)
+	features |= CPU_X86_SSE2;	/* part of the base instruction set */
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+	features |= SND_CPU_NEON;	/* the library is built for it */
+#endif
+	return features;
+}
+
+static unsigned int cpu_override(unsigned int features)
+{
+	const char *env = getenv("LIBASOUND_CPU");
+	unsigned int i;
+
+	if (env == NULL || *env == '\0')
+		return features;
+	for (i = 0; i < ARRAY_SIZE(cpu_levels); i++) {
+		if (strcmp(env, cpu_levels[i].name) == 0)
+			return features & cpu_levels[i].mask;
+	}
+	SNDERR("Unknown LIBASOUND_CPU level %s", env);
+	return features;
+}
+
+/* the usable SND_CPU_* features */
+unsigned int snd_cpu_features(void)
+{
+	if (cpu_state)
+		return cpu_features;
+	cpu_lock();
+	if (!cpu_state) {
+		cpu_features = cpu_override(cpu_detect());
+		cpu_state = 1;
+	}
+	cpu_unlock();
+	return cpu_features;
+}
+
+/*
+ * first entry of the table (entries of size bytes, each starting with
+ * its unsigned int mask) whose features are all usable
+ */
+const void *snd_cpu_select(const void *table, size_t size)
+{
+	unsigned int features = snd_cpu_features();
+	const char *p = table;
+
+	for (;; p += size) {
+		unsigned int need = *(const unsigned int *)p;
+		if ((need & features) == need)
+			return p;
+	}
+}
@@ -277,13 +277,16 @@ void *snd_dlsym(void *handle, const char *name, const char *version)
  */
 
 #ifndef DOC_HIDDEN
+#define DLOBJ_HASH_SIZE		64	/* must be a power of two */
+
 struct dlobj_cache {
 	const char *lib;
 	const char *name;
 	void *dlobj;
 	void *func;
 	unsigned int refcnt;
-	struct list_head list;
+	struct list_head list;		/* bucket by lib and name */
+	struct list_head flist;		/* bucket by func */
 };
 
 #ifdef HAVE_LIBPTHREAD
@@ -303,18 +306,66 @@ static inline void snd_dlobj_lock(void) {}
 static inline void snd_dlobj_unlock(void) {}
 #endif
 
-static LIST_HEAD(pcm_dlobj_list);
+static struct list_head pcm_dlobj_hash[DLOBJ_HASH_SIZE];
+static struct list_head pcm_dlobj_fhash[DLOBJ_HASH_SIZE];
+static int pcm_dlobj_hash_ready;
+
+/* called with snd_dlobj_lock() held */
+static void snd_dlobj_hash_init(void)
+{
+	unsigned int k;
+
+	if (pcm_dlobj_hash_ready)
+		return;
+	for (k = 0; k < DLOBJ_HASH_SIZE; k++) {
+		INIT_LIST_HEAD(&pcm_dlobj_hash[k]);
+		INIT_LIST_HEAD(&pcm_dlobj_fhash[k]);
+	}
+	pcm_dlobj_hash_ready = 1;
+}
+
+static unsigned int snd_dlobj_hash(const char *lib, const char *name)
+{
+	unsigned int h = 2166136261U;
+
+	/* NULL (builtin) hashes differently from an empty library name */
+	if (lib) {
+		while (*lib) {
+			h ^= (unsigned char)*lib++;
+			h *= 16777619U;
+		}
+		h ^= '/';
+		h *= 16777619U;
+	}
+	while (*name) {
+		h ^= (unsigned char)*name++;
+		h *= 16777619U;
+	}
+	return h & (DLOBJ_HASH_SIZE - 1);
+}
+
+static unsigned int snd_dlobj_fhash(void *func)
+{
+	uintptr_t v = (uintptr_t)func;
+
+	v ^= v >> 12;
+	v ^= v >> 6;
+	return (unsigned int)v & (DLOBJ_HASH_SIZE - 1);
+}
 
 static struct dlobj_cache *
 snd_dlobj_cache_get0(const char *lib, const char *name,
 		     const char *version, int verbose)
 {
-	struct list_head *p;
+	struct list_head *p, *bucket;
 	struct dlobj_cache *c;
 	void *func, *dlobj;
 	char errbuf[256];
+	unsigned long long trace;
 
-	list_for_each(p, &pcm_dlobj_list) {
+	snd_dlobj_hash_init();
+	bucket = &pcm_dlobj_hash[snd_dlobj_hash(lib, name)];
+	list_for_each(p, bucket) {
 		c = list_entry(p, struct dlobj_cache, list);
 		if (c->lib && lib && strcmp(c->lib, lib) != 0)
 			continue;
@@ -329,9 +380,11 @@ snd_dlobj_cache_get0(const char *lib, const char *name,
 	}
 
 	errbuf[0] = '\0';
+	trace = snd_trace_begin();
 	dlobj = INTERNAL(snd_dlopen)(lib, RTLD_NOW,
 	                   verbose ? errbuf : 0,
 	                   verbose ? sizeof(errbuf) : 0);
+	snd_trace_end(trace, "dl", "dlopen", lib ? lib : "[builtin]");
 	if (dlobj == NULL) {
 		if (verbose)
 			SNDERR("Cannot open shared library %s (%s)",
@@ -363,7 +416,8 @@ snd_dlobj_cache_get0(const char *lib, const char *name,
 	}
 	c->dlobj = dlobj;
 	c->func = func;
-	list_add_tail(&c->list, &pcm_dlobj_list);
+	list_add_tail(&c->list, bucket);
+	list_add_tail(&c->flist, &pcm_dlobj_fhash[snd_dlobj_fhash(func)]);
 	return c;
 }
 
@@ -408,8 +462,9 @@ int snd_dlobj_cache_put(void *func)
 		return -ENOENT;
 
 	snd_dlobj_lock();
-	list_for_each(p, &pcm_dlobj_list) {
-		c = list_entry(p, struct dlobj_cache, list);
+	snd_dlobj_hash_init();
+	list_for_each(p, &pcm_dlobj_fhash[snd_dlobj_fhash(func)]) {
+		c = list_entry(p, struct dlobj_cache, flist);
 		if (c->func == func) {
 			refcnt = c->refcnt;
 			if (c->refcnt > 0)
@@ -422,21 +477,86 @@ int snd_dlobj_cache_put(void *func)
 	return -ENOENT;
 }
 
+/*
+ * Resolve the open functions of all definitions in the base compound
+ * of the configuration ("pcm" or "ctl") the way the open does, so the
+ * first open of each type finds them in the cache. The entries stay
+ * unreferenced until snd_dlobj_cache_cleanup(). Returns the number of
+ * resolved definitions.
+ */
+int snd_dlobj_cache_prelink(snd_config_t *top, const char *base,
+			    const char *const *build_in, const char *version)
+{
+	snd_config_iterator_t i, next;
+	snd_config_t *defs, *n, *t, *type_conf;
+	const char *str, *lib, *open_name;
+	const char *const *b;
+	char key[32], buf[128], buf1[128];
+	void *func;
+	int count = 0;
+
+	if (snd_config_search(top, base, &defs) < 0 ||
+	    snd_config_get_type(defs) != SND_CONFIG_TYPE_COMPOUND)
+		return 0;
+	snprintf(key, sizeof(key), "%s_type", base);
+	snd_config_for_each(i, next, defs) {
+		n = snd_config_iterator_entry(i);
+		if (snd_config_get_type(n) != SND_CONFIG_TYPE_COMPOUND)
+			continue;
+		if (snd_config_search(n, "type", &t) < 0 ||
+		    snd_config_get_string(t, &str) < 0)
+			continue;
+		lib = open_name = NULL;
+		if (snd_config_searchv(top, &type_conf, key, str, NULL) >= 0 &&
+		    snd_config_get_type(type_conf) == SND_CONFIG_TYPE_COMPOUND) {
+			if (snd_config_search(type_conf, "lib", &t) >= 0)
+				snd_config_get_string(t, &lib);
+			if (snd_config_search(type_conf, "open", &t) >= 0)
+				snd_config_get_string(t, &open_name);
+		}
+		if (!open_name) {
+			snprintf(buf, sizeof(buf), "_snd_%s_%s_open", base, str);
+			open_name = buf;
+		}
+		if (!lib) {
+			for (b = build_in; *b; b++)
+				if (strcmp(*b, str) == 0)
+					break;
+			if (*b == NULL) {
+				snprintf(buf1, sizeof(buf1),
+					 "libasound_module_%s_%s.so", base, str);
+				lib = buf1;
+			}
+		}
+		func = snd_dlobj_cache_get(lib, open_name, version, 0);
+		if (func) {
+			snd_dlobj_cache_put(func);
+			count++;
+		}
+	}
+	return count;
+}
+
 void snd_dlobj_cache_cleanup(void)
 {
 	struct list_head *p, *npos;
 	struct dlobj_cache *c;
+	unsigned int k;
 
 	snd_dlobj_lock();
-	list_for_each_safe(p, npos, &pcm_dlobj_list) {
-		c = list_entry(p, struct dlobj_cache, list);
-		if (c->refcnt)
-			continue;
-		list_del(p);
-		snd_dlclose(c->dlobj);
-		free((void *)c->name); /* shut up gcc warning */
-		free((void *)c->lib); /* shut up gcc warning */
-		free(c);
+	snd_dlobj_hash_init();
+	for (k = 0; k < DLOBJ_HASH_SIZE; k++) {
+		list_for_each_safe(p, npos, &pcm_dlobj_hash[k]) {
+			c = list_entry(p, struct dlobj_cache, list);
+			if (c->refcnt)
+				continue;
+			list_del(p);
+			list_del(&c->flist);
+			snd_dlclose(c->dlobj);
+			free((void *)c->name); /* shut up gcc warning */
+			free((void *)c->lib); /* shut up gcc warning */
+			free(c);
+		}
 	}
 	snd_dlobj_unlock();
 	snd_dlpath_lock();
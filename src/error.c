@@ -32,7 +32,12 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <errno.h>
+#include <time.h>
 #include "local.h"
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 /**
  * Array of error codes in US ASCII.
@@ -70,6 +75,247 @@ const char *snd_strerror(int errnum)
 
 static TLS_PFX snd_local_error_handler_t local_error = NULL;
 
+#ifndef DOC_HIDDEN
+/*
+ * Deferred messages: the default handlers format the message into a slot
+ * of a bounded lock-free ring (the sequence scheme of D. Vyukov) instead
+ * of writing it, so that an error on a realtime thread does not block on
+ * stderr.  Any thread may log, snd_lib_error_flush() writes and frees the
+ * slots.  A message finding the ring full is dropped and counted.
+ */
+#define ERROR_DEFER_MSG		240
+
+struct error_slot {
+	unsigned int seq;
+	int err;
+	char msg[ERROR_DEFER_MSG];
+};
+
+struct error_ring {
+	unsigned int mask;
+	unsigned int head;		/* next slot to write, producers */
+	unsigned int tail;		/* next slot to flush, under flush_mutex */
+	unsigned long long dropped;
+	struct error_slot slots[];
+};
+
+static struct error_ring *error_ring;
+static unsigned long long error_dropped;	/* of the rings freed already */
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t error_flush_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t error_flush_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t error_flush_thread;
+static int error_flush_running;
+static int error_flush_quit;
+
+static inline void error_flush_lock(void)
+{
+	pthread_mutex_lock(&error_flush_mutex);
+}
+
+static inline void error_flush_unlock(void)
+{
+	pthread_mutex_unlock(&error_flush_mutex);
+}
+#else
+static inline void error_flush_lock(void) {}
+static inline void error_flush_unlock(void) {}
+#endif
+
+/* queues a message, returns -1 when the messages are not deferred */
+static int error_defer(const char *file, int line, const char *function,
+		       int err, const char *fmt, va_list arg)
+{
+	struct error_ring *ring = __atomic_load_n(&error_ring, __ATOMIC_ACQUIRE);
+	struct error_slot *slot;
+	unsigned int pos, seq;
+	int len;
+
+	if (ring == NULL)
+		return -1;
+	pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	for (;;) {
+		slot = &ring->slots[pos & ring->mask];
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if ((int)(seq - pos) == 0) {
+			if (__atomic_compare_exchange_n(&ring->head, &pos, pos + 1, 1,
+							__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if ((int)(seq - pos) < 0) {
+			__atomic_add_fetch(&ring->dropped, 1, __ATOMIC_RELAXED);
+			return 0;
+		} else {
+			pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+		}
+	}
+	len = snprintf(slot->msg, sizeof(slot->msg), "ALSA lib %s:%i:(%s) ",
+		       file, line, function);
+	if (len >= 0 && (size_t)len < sizeof(slot->msg))
+		vsnprintf(slot->msg + len, sizeof(slot->msg) - len, fmt, arg);
+	/* the text of err is looked up at the flush, strerror() may lock */
+	slot->err = err;
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static int error_ring_flush(struct error_ring *ring)
+{
+	struct error_slot *slot;
+	int count = 0;
+
+	for (;;) {
+		slot = &ring->slots[ring->tail & ring->mask];
+		if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != ring->tail + 1)
+			break;
+		fputs(slot->msg, stderr);
+		if (slot->err)
+			fprintf(stderr, ": %s", snd_strerror(slot->err));
+		putc('\n', stderr);
+		__atomic_store_n(&slot->seq, ring->tail + ring->mask + 1, __ATOMIC_RELEASE);
+		ring->tail++;
+		count++;
+	}
+	return count;
+}
+
+#ifdef HAVE_LIBPTHREAD
+static void *error_flush_thread_func(void *arg ATTRIBUTE_UNUSED)
+{
+	struct timespec ts;
+
+	error_flush_lock();
+	while (!error_flush_quit) {
+		if (error_ring)
+			error_ring_flush(error_ring);
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += 100 * 1000000;
+		if (ts.tv_nsec >= 1000000000) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+		pthread_cond_timedwait(&error_flush_cond, &error_flush_mutex, &ts);
+	}
+	error_flush_unlock();
+	return NULL;
+}
+
+static void error_flush_thread_stop(void)
+{
+	if (!error_flush_running)
+		return;
+	error_flush_lock();
+	error_flush_quit = 1;
+	pthread_cond_signal(&error_flush_cond);
+	error_flush_unlock();
+	pthread_join(error_flush_thread, NULL);
+	error_flush_running = 0;
+	error_flush_quit = 0;
+}
+#else
+static inline void error_flush_thread_stop(void) {}
+#endif
+#endif /* DOC_HIDDEN */
+
+/**
+ * \brief Defers the messages of the default error handlers
+ * \param size Ring size in messages (rounded up to a power of two),
+ *             or 0 to write the messages synchronously again
+ * \param flush_thread Non-zero to flush the ring from a helper thread
+ *                     every 100 milliseconds
+ * \retval 0 on success otherwise a negative error code
+ *
+ * In the deferred mode, the default error handler and the debug message
+ * handler do not write to \c stderr; the message is formatted into a
+ * lock-free ring and written later by snd_lib_error_flush() or the flush
+ * thread, so that errors reported on a realtime thread, for example on
+ * an xrun, cannot block it.  Messages which do not fit into the ring are
+ * dropped and counted, see snd_lib_error_dropped().  A handler installed
+ * by snd_lib_error_set_handler() or snd_lib_error_set_local() is still
+ * called directly.
+ *
+ * The mode should be switched while no other thread uses the library;
+ * the queued messages are written out when it is turned off.
+ */
+int snd_lib_error_set_deferred(unsigned int size, int flush_thread)
+{
+	struct error_ring *ring = NULL, *old;
+	unsigned int n, i;
+
+#ifndef HAVE_LIBPTHREAD
+	if (flush_thread)
+		return -ENOSYS;
+#endif
+	if (size > 0) {
+		if (size > 65536)
+			return -EINVAL;
+		for (n = 1; n < size; n <<= 1)
+			;
+		ring = calloc(1, sizeof(*ring) + n * sizeof(ring->slots[0]));
+		if (ring == NULL)
+			return -ENOMEM;
+		ring->mask = n - 1;
+		for (i = 0; i < n; i++)
+			ring->slots[i].seq = i;
+	}
+	error_flush_thread_stop();
+	error_flush_lock();
+	old = error_ring;
+	__atomic_store_n(&error_ring, ring, __ATOMIC_RELEASE);
+	if (old) {
+		error_ring_flush(old);
+		error_dropped += old->dropped;
+		free(old);
+	}
+	error_flush_unlock();
+#ifdef HAVE_LIBPTHREAD
+	if (ring && flush_thread) {
+		int err = pthread_create(&error_flush_thread, NULL,
+					 error_flush_thread_func, NULL);
+		if (err)
+			return -err;
+		error_flush_running = 1;
+	}
+#endif
+	return 0;
+}
+
+/**
+ * \brief Writes the deferred error messages
+ * \retval The count of written messages
+ *
+ * Call it from a non realtime thread when snd_lib_error_set_deferred()
+ * was used without the flush thread, and before the program exits.
+ */
+int snd_lib_error_flush(void)
+{
+	int count = 0;
+
+	error_flush_lock();
+	if (error_ring)
+		count = error_ring_flush(error_ring);
+	error_flush_unlock();
+	return count;
+}
+
+/**
+ * \brief Returns the count of deferred error messages dropped so far
+ * \return The count of messages which found the ring full
+ */
+unsigned long long snd_lib_error_dropped(void)
+{
+	struct error_ring *ring;
+	unsigned long long dropped;
+
+	error_flush_lock();
+	ring = error_ring;
+	dropped = error_dropped;
+	if (ring)
+		dropped += __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+	error_flush_unlock();
+	return dropped;
+}
+
 /**
  * \brief Install local error handler
  * \param func The local error handler function
@@ -93,7 +339,8 @@ snd_local_error_handler_t snd_lib_error_set_local(snd_local_error_handler_t func
  *
  * If a local error function has been installed for the current thread by
  * \ref snd_lib_error_set_local, it is called. Otherwise, prints the error
- * message including location to \c stderr.
+ * message including location to \c stderr, or queues it in the deferred
+ * mode, see \ref snd_lib_error_set_deferred.
  */
 static void snd_lib_error_default(const char *file, int line, const char *function, int err, const char *fmt, ...)
 {
@@ -104,6 +351,10 @@ static void snd_lib_error_default(const char *file, int line, const char *functi
 		va_end(arg);
 		return;
 	}
+	if (error_defer(file, line, function, err, fmt, arg) == 0) {
+		va_end(arg);
+		return;
+	}
 	fprintf(stderr, "ALSA lib %s:%i:(%s) ", file, line, function);
 	vfprintf(stderr, fmt, arg);
 	if (err)
@@ -158,11 +409,13 @@ static void snd_err_msg_default(const char *file, int line, const char *function
 	if (! verbose || ! *verbose)
 		return;
 	va_start(arg, fmt);
-	fprintf(stderr, "ALSA lib %s:%i:(%s) ", file, line, function);
-	vfprintf(stderr, fmt, arg);
-	if (err)
-		fprintf(stderr, ": %s", snd_strerror(err));
-	putc('\n', stderr);
+	if (error_defer(file, line, function, err, fmt, arg) < 0) {
+		fprintf(stderr, "ALSA lib %s:%i:(%s) ", file, line, function);
+		vfprintf(stderr, fmt, arg);
+		if (err)
+			fprintf(stderr, ": %s", snd_strerror(err));
+		putc('\n', stderr);
+	}
 	va_end(arg);
 #ifdef ALSA_DEBUG_ASSERT
 	verbose = getenv("LIBASOUND_DEBUG_ASSERT");
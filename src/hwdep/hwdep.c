@@ -33,9 +33,15 @@
 #include <unistd.h>
 #include <string.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "hwdep_local.h"
 
+/* default chunk of the bulk transfers */
+#define HWDEP_BULK_CHUNK	(256 * 1024)
+
 static int snd_hwdep_open_conf(snd_hwdep_t **hwdep,
 			       const char *name, snd_config_t *hwdep_root,
 			       snd_config_t *hwdep_conf, int mode)
@@ -519,6 +525,253 @@ int snd_hwdep_dsp_load(snd_hwdep_t *hwdep, snd_hwdep_dsp_image_t *block)
 	return hwdep->ops->ioctl(hwdep, SNDRV_HWDEP_IOCTL_DSP_LOAD, (void*)block);
 }
 
+/* map the rest of the file from offset, NULL when it cannot be mapped */
+static void *hwdep_map_file(int fd, off_t offset, size_t *size, void **base, size_t *mapped)
+{
+	struct stat st;
+	long page = sysconf(_SC_PAGESIZE);
+	off_t start;
+	void *ptr;
+
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= offset)
+		return NULL;
+	if ((unsigned long long)(st.st_size - offset) > SIZE_MAX)
+		return NULL;
+	start = offset & ~((off_t)page - 1);
+	*size = st.st_size - offset;
+	*mapped = st.st_size - start;
+	ptr = mmap(NULL, *mapped, PROT_READ, MAP_SHARED, fd, start);
+	if (ptr == MAP_FAILED)
+		return NULL;
+	madvise(ptr, *mapped, MADV_SEQUENTIAL);
+	*base = ptr;
+	return (char *)ptr + (offset - start);
+}
+
+static ssize_t hwdep_write_all(snd_hwdep_t *hwdep, const char *buffer, size_t size)
+{
+	struct pollfd pfd;
+	size_t done = 0;
+	ssize_t res;
+
+	while (done < size) {
+		res = hwdep->ops->write(hwdep, buffer + done, size - done);
+		if (res == -EINTR)
+			continue;
+		if (res == -EAGAIN) {
+			pfd.fd = hwdep->poll_fd;
+			pfd.events = POLLOUT;
+			if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+				return -errno;
+			continue;
+		}
+		if (res < 0)
+			return res;
+		if (res == 0)
+			return -EIO;
+		done += res;
+	}
+	return done;
+}
+
+/**
+ * \brief write a memory region in chunks
+ * \param hwdep HwDep handle
+ * \param buffer region to write, usually a mapped file
+ * \param size region size in bytes
+ * \param chunk bytes per write, 0 for the default (256KiB)
+ * \param progress called after each chunk, may be NULL
+ * \param private_data value passed to \p progress
+ * \return the number of written bytes or a negative error code
+ *
+ * While a chunk is written, the next one is prefetched, so a region
+ * mapped from a file is read from the storage in parallel with the
+ * transfer to the device.  Short writes are continued, and a non-blocking
+ * handle waits for the device.  A negative value returned by \p progress
+ * aborts the transfer with that error.
+ *
+ * This function is added in version 1.2.8.
+ */
+ssize_t snd_hwdep_write_area(snd_hwdep_t *hwdep, const void *buffer, size_t size,
+			     size_t chunk, snd_hwdep_progress_t progress,
+			     void *private_data)
+{
+	unsigned long page = sysconf(_SC_PAGESIZE);
+	const char *ptr = buffer;
+	size_t done = 0, len;
+	ssize_t res;
+
+	assert(hwdep);
+	assert(((hwdep->mode & O_ACCMODE) == O_WRONLY) || ((hwdep->mode & O_ACCMODE) == O_RDWR));
+	assert(buffer || size == 0);
+	if (chunk == 0)
+		chunk = HWDEP_BULK_CHUNK;
+	while (done < size) {
+		len = size - done < chunk ? size - done : chunk;
+		if (done + len < size) {
+			unsigned long next = (unsigned long)(ptr + done + len);
+			size_t ahead = size - done - len < chunk ? size - done - len : chunk;
+			/* best effort, fails harmlessly on anonymous memory */
+			madvise((void *)(next & ~(page - 1)), ahead + (next & (page - 1)),
+				MADV_WILLNEED);
+		}
+		res = hwdep_write_all(hwdep, ptr + done, len);
+		if (res < 0)
+			return res;
+		done += len;
+		if (progress) {
+			int err = progress(done, size, private_data);
+			if (err < 0)
+				return err;
+		}
+	}
+	return done;
+}
+
+/**
+ * \brief write a file in chunks
+ * \param hwdep HwDep handle
+ * \param fd file descriptor to read from its current position to the end
+ * \param chunk bytes per write, 0 for the default (256KiB)
+ * \param progress called after each chunk, may be NULL
+ * \param private_data value passed to \p progress
+ * \return the number of written bytes or a negative error code
+ *
+ * A regular file is mapped and written with #snd_hwdep_write_area,
+ * without a copy in the application; the file position is advanced
+ * past the written bytes.  Other descriptors (pipes, sockets) are read
+ * through a buffer of one chunk, and \p progress gets zero as the total.
+ *
+ * This function is added in version 1.2.8.
+ */
+ssize_t snd_hwdep_write_file(snd_hwdep_t *hwdep, int fd, size_t chunk,
+			     snd_hwdep_progress_t progress, void *private_data)
+{
+	void *base, *ptr;
+	size_t size, mapped, done = 0;
+	off_t offset;
+	ssize_t res;
+	char *buf;
+
+	assert(hwdep);
+	assert(fd >= 0);
+	if (chunk == 0)
+		chunk = HWDEP_BULK_CHUNK;
+	offset = lseek(fd, 0, SEEK_CUR);
+	ptr = offset < 0 ? NULL : hwdep_map_file(fd, offset, &size, &base, &mapped);
+	if (ptr) {
+		res = snd_hwdep_write_area(hwdep, ptr, size, chunk, progress, private_data);
+		munmap(base, mapped);
+		if (res > 0)
+			lseek(fd, offset + res, SEEK_SET);
+		return res;
+	}
+	buf = malloc(chunk);
+	if (buf == NULL)
+		return -ENOMEM;
+	for (;;) {
+		res = read(fd, buf, chunk);
+		if (res < 0 && errno == EINTR)
+			continue;
+		if (res < 0) {
+			res = -errno;
+			break;
+		}
+		if (res == 0) {
+			res = done;
+			break;
+		}
+		res = hwdep_write_all(hwdep, buf, res);
+		if (res < 0)
+			break;
+		done += res;
+		if (progress) {
+			int err = progress(done, 0, private_data);
+			if (err < 0) {
+				res = err;
+				break;
+			}
+		}
+	}
+	free(buf);
+	return res;
+}
+
+/**
+ * \brief load the DSP block from a file
+ * \param hwdep HwDep handle
+ * \param index the DSP block index
+ * \param name the name of the DSP block, may be NULL
+ * \param fd file descriptor of the whole image
+ * \param progress called before and after the load, may be NULL
+ * \param private_data value passed to \p progress
+ * \return 0 on success otherwise a negative error code
+ *
+ * The driver takes the block in one request, so a regular file is
+ * mapped and handed over directly; the driver copies it from the page
+ * cache and there is no copy in the application.  Other descriptors are
+ * read into a temporary buffer first.
+ *
+ * This function is added in version 1.2.8.
+ */
+int snd_hwdep_dsp_load_file(snd_hwdep_t *hwdep, unsigned int index, const char *name,
+			    int fd, snd_hwdep_progress_t progress, void *private_data)
+{
+	snd_hwdep_dsp_image_t block;
+	void *base = NULL, *ptr;
+	size_t size = 0, mapped = 0, alloc;
+	ssize_t res;
+	int err;
+
+	assert(hwdep);
+	assert(fd >= 0);
+	ptr = hwdep_map_file(fd, 0, &size, &base, &mapped);
+	if (ptr == NULL) {
+		alloc = HWDEP_BULK_CHUNK;
+		ptr = malloc(alloc);
+		if (ptr == NULL)
+			return -ENOMEM;
+		for (;;) {
+			if (size == alloc) {
+				void *nptr = realloc(ptr, alloc * 2);
+				if (nptr == NULL) {
+					free(ptr);
+					return -ENOMEM;
+				}
+				ptr = nptr;
+				alloc *= 2;
+			}
+			res = read(fd, (char *)ptr + size, alloc - size);
+			if (res < 0 && errno == EINTR)
+				continue;
+			if (res < 0) {
+				err = -errno;
+				free(ptr);
+				return err;
+			}
+			if (res == 0)
+				break;
+			size += res;
+		}
+	}
+	memset(&block, 0, sizeof(block));
+	block.index = index;
+	if (name)
+		snd_hwdep_dsp_image_set_name(&block, name);
+	block.image = ptr;
+	block.length = size;
+	err = progress ? progress(0, size, private_data) : 0;
+	if (err >= 0)
+		err = snd_hwdep_dsp_load(hwdep, &block);
+	if (err >= 0 && progress)
+		err = progress(size, size, private_data);
+	if (base)
+		munmap(base, mapped);
+	else
+		free(ptr);
+	return err < 0 ? err : 0;
+}
+
 /**
  * \brief get size of the snd_hwdep_dsp_status_t structure in bytes
  * \return size of the snd_hwdep_dsp_status_t structure in bytes
@@ -31,6 +31,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "local.h"
 
 #ifndef DOC_HIDDEN
@@ -226,12 +229,16 @@ typedef struct _snd_input_buffer {
 	unsigned char *buf;
 	unsigned char *ptr;
 	size_t size;
+	size_t map_size;	/* non-zero when buf is a file mapping */
 } snd_input_buffer_t;
 
 static int snd_input_buffer_close(snd_input_t *input)
 {
 	snd_input_buffer_t *buffer = input->private_data;
-	free(buffer->buf);
+	if (buffer->map_size)
+		munmap(buffer->buf, buffer->map_size);
+	else
+		free(buffer->buf);
 	free(buffer);
 	return 0;
 }
@@ -334,4 +341,69 @@ int snd_input_buffer_open(snd_input_t **inputp, const char *buf, ssize_t size)
 	*inputp = input;
 	return 0;
 }
+
+#ifndef DOC_HIDDEN
+/*
+ * Opens a regular file as a read-only mapping, which backs a buffer input.
+ * Other and empty files are opened through stdio.
+ */
+int snd_input_mmap_open(snd_input_t **inputp, const char *file)
+{
+	snd_input_t *input;
+	snd_input_buffer_t *buffer;
+	struct stat st;
+	void *map;
+	int fd;
+
+	fd = open(file, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+	    (unsigned long long)st.st_size > SIZE_MAX) {
+		close(fd);
+		return snd_input_stdio_open(inputp, file, "r");
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return snd_input_stdio_open(inputp, file, "r");
+	buffer = calloc(1, sizeof(*buffer));
+	input = calloc(1, sizeof(*input));
+	if (!buffer || !input) {
+		free(buffer);
+		free(input);
+		munmap(map, st.st_size);
+		return -ENOMEM;
+	}
+	buffer->buf = buffer->ptr = map;
+	buffer->size = buffer->map_size = st.st_size;
+	input->type = SND_INPUT_BUFFER;
+	input->ops = &snd_input_buffer_ops;
+	input->private_data = buffer;
+	*inputp = input;
+	return 0;
+}
+
+/* returns the unread part of a buffer input, -EINVAL for other inputs */
+int snd_input_buffer_peek(snd_input_t *input, const char **buf, size_t *size)
+{
+	snd_input_buffer_t *buffer = input->private_data;
+
+	if (input->ops != &snd_input_buffer_ops)
+		return -EINVAL;
+	*buf = (const char *)buffer->ptr;
+	*size = buffer->size;
+	return 0;
+}
+
+/* consumes size bytes of what snd_input_buffer_peek() returned */
+void snd_input_buffer_skip(snd_input_t *input, size_t size)
+{
+	snd_input_buffer_t *buffer = input->private_data;
+
+	assert(input->ops == &snd_input_buffer_ops && size <= buffer->size);
+	buffer->ptr += size;
+	buffer->size -= size;
+}
+#endif
 	
@@ -21,45 +21,79 @@
 
 #include "mixer_local.h"
 
+void bag_init(bag_t *bag)
+{
+	bag->count = 0;
+	bag->alloc = 0;
+}
+
+void bag_fini(bag_t *bag)
+{
+	if (bag->alloc)
+		free(bag->u.ext);
+	bag_init(bag);
+}
+
 int bag_new(bag_t **bag)
 {
 	bag_t *b = malloc(sizeof(*b));
 	if (!b)
 		return -ENOMEM;
-	INIT_LIST_HEAD(b);
+	bag_init(b);
 	*bag = b;
 	return 0;
 }
 
 void bag_free(bag_t *bag)
 {
-	assert(list_empty(bag));
+	assert(bag->count == 0);
+	bag_fini(bag);
 	free(bag);
 }
 
 int bag_empty(bag_t *bag)
 {
-	return list_empty(bag);
+	return bag->count == 0;
 }
 
 int bag_add(bag_t *bag, void *ptr)
 {
-	bag1_t *b = malloc(sizeof(*b));
-	if (!b)
-		return -ENOMEM;
-	b->ptr = ptr;
-	list_add_tail(&b->list, bag);
+	void **p;
+	unsigned int alloc;
+
+	if (bag->count < BAG_INLINE && !bag->alloc) {
+		bag->u.inl[bag->count++] = ptr;
+		return 0;
+	}
+	if (bag->count == bag->alloc || !bag->alloc) {
+		alloc = bag->alloc ? bag->alloc * 2 : BAG_INLINE * 2;
+		if (bag->alloc) {
+			p = realloc(bag->u.ext, alloc * sizeof(*p));
+			if (!p)
+				return -ENOMEM;
+		} else {
+			p = malloc(alloc * sizeof(*p));
+			if (!p)
+				return -ENOMEM;
+			memcpy(p, bag->u.inl, bag->count * sizeof(*p));
+		}
+		bag->u.ext = p;
+		bag->alloc = alloc;
+	}
+	bag->u.ext[bag->count++] = ptr;
 	return 0;
 }
 
 int bag_del(bag_t *bag, void *ptr)
 {
-	struct list_head *pos;
-	list_for_each(pos, bag) {
-		bag1_t *b = list_entry(pos, bag1_t, list);
-		if (b->ptr == ptr) {
-			list_del(&b->list);
-			free(b);
+	void **p = bag_ptrs(bag);
+	unsigned int k;
+
+	for (k = 0; k < bag->count; k++) {
+		if (p[k] == ptr) {
+			/* keep the order, the events are delivered in it */
+			bag->count--;
+			memmove(p + k, p + k + 1, (bag->count - k) * sizeof(*p));
 			return 0;
 		}
 	}
@@ -68,6 +102,5 @@ int bag_del(bag_t *bag, void *ptr)
 
 void bag_del_all(bag_t *bag)
 {
-	while (!list_empty(bag))
-		list_del(bag->next);
+	bag->count = 0;
 }
@@ -46,6 +46,7 @@ This is an abstraction layer over the hcontrol layer.
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include "mixer_local.h"
+#include "mixer_simple.h"
 
 #ifndef DOC_HIDDEN
 typedef struct _snd_mixer_slave {
@@ -57,6 +58,9 @@ typedef struct _snd_mixer_slave {
 
 static int snd_mixer_compare_default(const snd_mixer_elem_t *c1,
 				     const snd_mixer_elem_t *c2);
+static int snd_mixer_sort(snd_mixer_t *mixer);
+
+#define MIXER_HASH_MIN	64
 
 
 /**
@@ -76,6 +80,12 @@ int snd_mixer_open(snd_mixer_t **mixerp, int mode ATTRIBUTE_UNUSED)
 	INIT_LIST_HEAD(&mixer->classes);
 	INIT_LIST_HEAD(&mixer->elems);
 	mixer->compare = snd_mixer_compare_default;
+	mixer->hash = calloc(MIXER_HASH_MIN, sizeof(*mixer->hash));
+	if (mixer->hash == NULL) {
+		free(mixer);
+		return -ENOMEM;
+	}
+	mixer->hash_size = MIXER_HASH_MIN;
 	*mixerp = mixer;
 	return 0;
 }
@@ -140,16 +150,115 @@ int snd_mixer_elem_empty(snd_mixer_elem_t *melem)
 	return bag_empty(&melem->helems);
 }
 
+/*
+ * Between snd_mixer_begin() and snd_mixer_commit() the values written by
+ * the simple classes are kept in the mixer, one per hcontrol element,
+ * and written at the commit.  The reads see the kept values.
+ */
+static int mixer_pending_find(snd_mixer_t *mixer, snd_hctl_elem_t *helem)
+{
+	unsigned int k;
+
+	/* the elements of a selem are usually written one after another */
+	for (k = mixer->pending_count; k-- > 0; )
+		if (mixer->pending_elems[k] == helem)
+			return k;
+	return -1;
+}
+
+static void mixer_pending_del(snd_mixer_t *mixer, unsigned int idx)
+{
+	unsigned int m = --mixer->pending_count - idx;
+
+	memmove(mixer->pending_elems + idx, mixer->pending_elems + idx + 1,
+		m * sizeof(*mixer->pending_elems));
+	memmove(mixer->pending_values + idx, mixer->pending_values + idx + 1,
+		m * sizeof(*mixer->pending_values));
+}
+
+/* drop the writes to the elements of hctl, or to helem only */
+static void mixer_pending_drop(snd_mixer_t *mixer, snd_hctl_t *hctl,
+			       snd_hctl_elem_t *helem)
+{
+	unsigned int k;
+
+	for (k = mixer->pending_count; k-- > 0; ) {
+		if (mixer->pending_elems[k] == helem ||
+		    (hctl && snd_hctl_elem_get_hctl(mixer->pending_elems[k]) == hctl))
+			mixer_pending_del(mixer, k);
+	}
+}
+
+static void mixer_pending_free(snd_mixer_t *mixer)
+{
+	free(mixer->pending_elems);
+	free(mixer->pending_values);
+	mixer->pending_elems = NULL;
+	mixer->pending_values = NULL;
+	mixer->pending_count = 0;
+	mixer->pending_alloc = 0;
+}
+
+/* used by the simple classes instead of snd_hctl_elem_read() */
+int mixer_helem_read(snd_hctl_elem_t *helem, snd_ctl_elem_value_t *value)
+{
+	snd_mixer_t *mixer = snd_hctl_get_callback_private(snd_hctl_elem_get_hctl(helem));
+	int idx;
+
+	if (mixer->pending_count) {
+		idx = mixer_pending_find(mixer, helem);
+		if (idx >= 0) {
+			*value = mixer->pending_values[idx];
+			return 0;
+		}
+	}
+	return snd_hctl_elem_read(helem, value);
+}
+
+/* used by the simple classes instead of snd_hctl_elem_write() */
+int mixer_helem_write(snd_hctl_elem_t *helem, snd_ctl_elem_value_t *value)
+{
+	snd_mixer_t *mixer = snd_hctl_get_callback_private(snd_hctl_elem_get_hctl(helem));
+	int idx;
+
+	if (!mixer->txn)
+		return snd_hctl_elem_write(helem, value);
+	idx = mixer_pending_find(mixer, helem);
+	if (idx < 0) {
+		if (mixer->pending_count == mixer->pending_alloc) {
+			unsigned int alloc = mixer->pending_alloc + 32;
+			snd_hctl_elem_t **e;
+			snd_ctl_elem_value_t *v;
+			e = realloc(mixer->pending_elems, alloc * sizeof(*e));
+			if (!e)
+				return -ENOMEM;
+			mixer->pending_elems = e;
+			v = realloc(mixer->pending_values, alloc * sizeof(*v));
+			if (!v)
+				return -ENOMEM;
+			mixer->pending_values = v;
+			mixer->pending_alloc = alloc;
+		}
+		idx = mixer->pending_count++;
+		mixer->pending_elems[idx] = helem;
+	}
+	mixer->pending_values[idx] = *value;
+	return 0;
+}
+
 static int hctl_elem_event_handler(snd_hctl_elem_t *helem,
 				   unsigned int mask)
 {
 	bag_t *bag = snd_hctl_elem_get_callback_private(helem);
 	if (mask == SND_CTL_EVENT_MASK_REMOVE) {
+		snd_mixer_t *mixer = snd_hctl_get_callback_private(snd_hctl_elem_get_hctl(helem));
 		int res = 0;
 		int err;
-		bag_iterator_t i, n;
-		bag_for_each_safe(i, n, bag) {
-			snd_mixer_elem_t *melem = bag_iterator_entry(i);
+		if (mixer->pending_count)
+			mixer_pending_drop(mixer, NULL, helem);
+		bag_iterator_t i;
+		snd_mixer_elem_t *melem;
+		bag_for_each_safe(i, melem, bag) {
 			snd_mixer_class_t *class = melem->class;
 			err = class->event(class, mask, helem, melem);
 			if (err < 0)
@@ -164,9 +273,9 @@ static int hctl_elem_event_handler(snd_hctl_elem_t *helem,
 	}
 	if (mask & (SND_CTL_EVENT_MASK_VALUE | SND_CTL_EVENT_MASK_INFO)) {
 		int err = 0;
-		bag_iterator_t i, n;
-		bag_for_each_safe(i, n, bag) {
-			snd_mixer_elem_t *melem = bag_iterator_entry(i);
+		bag_iterator_t i;
+		snd_mixer_elem_t *melem;
+		bag_for_each_safe(i, melem, bag) {
 			snd_mixer_class_t *class = melem->class;
 			err = class->event(class, mask, helem, melem);
 			if (err < 0)
@@ -290,6 +399,7 @@ int snd_mixer_detach_hctl(snd_mixer_t *mixer, snd_hctl_t *hctl)
 		snd_mixer_slave_t *s;
 		s = list_entry(pos, snd_mixer_slave_t, list);
 		if (hctl == s->hctl) {
+			mixer_pending_drop(mixer, hctl, NULL);
 			list_del(pos);
 			free(s);
 			return 0;
@@ -336,6 +446,110 @@ static int snd_mixer_elem_throw_event(snd_mixer_elem_t *elem, unsigned int mask)
 	return 0;
 }
 
+/*
+ * The simple elements are also hashed by their id, so the classes find
+ * the element for a new hctl element without walking the whole list.
+ * The chains keep the insertion order.
+ */
+static unsigned int mixer_selem_hash(const char *name, unsigned int index)
+{
+	unsigned int h = 2166136261U;
+
+	while (*name)
+		h = (h ^ (unsigned char)*name++) * 16777619U;
+	return (h ^ index) * 16777619U;
+}
+
+static void mixer_hash_link(snd_mixer_elem_t **hash, unsigned int size,
+			    snd_mixer_elem_t *elem)
+{
+	const snd_mixer_selem_id_t *id = sm_selem(elem)->id;
+	snd_mixer_elem_t **pos;
+
+	pos = &hash[mixer_selem_hash(id->name, id->index) & (size - 1)];
+	while (*pos)
+		pos = &(*pos)->hash_next;
+	elem->hash_next = NULL;
+	*pos = elem;
+}
+
+static void mixer_hash_add(snd_mixer_t *mixer, snd_mixer_elem_t *elem)
+{
+	snd_mixer_elem_t **hash, *e, *next;
+	unsigned int k, size;
+
+	if (elem->type != SND_MIXER_ELEM_SIMPLE)
+		return;
+	if (mixer->hash_count >= mixer->hash_size) {
+		/* on failure the chains just get longer */
+		size = mixer->hash_size * 2;
+		hash = calloc(size, sizeof(*hash));
+		if (hash) {
+			for (k = 0; k < mixer->hash_size; k++) {
+				for (e = mixer->hash[k]; e; e = next) {
+					next = e->hash_next;
+					mixer_hash_link(hash, size, e);
+				}
+			}
+			free(mixer->hash);
+			mixer->hash = hash;
+			mixer->hash_size = size;
+		}
+	}
+	mixer_hash_link(mixer->hash, mixer->hash_size, elem);
+	mixer->hash_count++;
+}
+
+static void mixer_hash_del(snd_mixer_t *mixer, snd_mixer_elem_t *elem)
+{
+	const snd_mixer_selem_id_t *id;
+	snd_mixer_elem_t **pos;
+
+	if (elem->type != SND_MIXER_ELEM_SIMPLE)
+		return;
+	id = sm_selem(elem)->id;
+	pos = &mixer->hash[mixer_selem_hash(id->name, id->index) & (mixer->hash_size - 1)];
+	for (; *pos; pos = &(*pos)->hash_next) {
+		if (*pos == elem) {
+			*pos = elem->hash_next;
+			mixer->hash_count--;
+			return;
+		}
+	}
+}
+
+/* used by snd_mixer_find_selem() */
+snd_mixer_elem_t *mixer_find_selem(snd_mixer_t *mixer, const char *name,
+				   unsigned int index)
+{
+	snd_mixer_elem_t *e;
+	const snd_mixer_selem_id_t *id;
+
+	e = mixer->hash[mixer_selem_hash(name, index) & (mixer->hash_size - 1)];
+	for (; e; e = e->hash_next) {
+		id = sm_selem(e)->id;
+		if (id->index == index && !strcmp(id->name, name))
+			return e;
+	}
+	return NULL;
+}
+
+/*
+ * While the classes add the elements for all hctl elements at once (load
+ * or class registration), the new elements are appended and the array is
+ * sorted once at the end instead of an insertion per element.
+ */
+static void mixer_bulk_begin(snd_mixer_t *mixer)
+{
+	mixer->bulk++;
+}
+
+static void mixer_bulk_end(snd_mixer_t *mixer)
+{
+	if (--mixer->bulk == 0 && mixer->unsorted)
+		snd_mixer_sort(mixer);
+}
+
 static int _snd_mixer_find_elem(snd_mixer_t *mixer, snd_mixer_elem_t *elem, int *dir)
 {
 	unsigned int l, u;
@@ -395,7 +609,7 @@ int snd_mixer_elem_new(snd_mixer_elem_t **elem,
 	melem->compare_weight = compare_weight;
 	melem->private_data = private_data;
 	melem->private_free = private_free;
-	INIT_LIST_HEAD(&melem->helems);
+	bag_init(&melem->helems);
 	*elem = melem;
 	return 0;
 }
@@ -424,7 +638,12 @@ int snd_mixer_elem_add(snd_mixer_elem_t *elem, snd_mixer_class_t *class)
 		}
 		mixer->pelems = m;
 	}
-	if (mixer->count == 0) {
+	mixer_hash_add(mixer, elem);
+	if (mixer->bulk) {
+		list_add_tail(&elem->list, &mixer->elems);
+		mixer->pelems[mixer->count] = elem;
+		mixer->unsorted = 1;
+	} else if (mixer->count == 0) {
 		list_add_tail(&elem->list, &mixer->elems);
 		mixer->pelems[0] = elem;
 	} else {
@@ -455,18 +674,20 @@ int snd_mixer_elem_add(snd_mixer_elem_t *elem, snd_mixer_class_t *class)
 int snd_mixer_elem_remove(snd_mixer_elem_t *elem)
 {
 	snd_mixer_t *mixer = elem->class->mixer;
-	bag_iterator_t i, n;
+	bag_iterator_t i;
+	snd_hctl_elem_t *helem;
 	int err, idx, dir;
 	unsigned int m;
 	assert(elem);
 	assert(mixer->count);
+	if (mixer->unsorted)
+		snd_mixer_sort(mixer);
 	idx = _snd_mixer_find_elem(mixer, elem, &dir);
 	if (dir != 0)
 		return -EINVAL;
-	bag_for_each_safe(i, n, &elem->helems) {
-		snd_hctl_elem_t *helem = bag_iterator_entry(i);
+	mixer_hash_del(mixer, elem);
+	bag_for_each_safe(i, helem, &elem->helems)
 		snd_mixer_elem_detach(elem, helem);
-	}
 	err = snd_mixer_elem_throw_event(elem, SND_CTL_EVENT_MASK_REMOVE);
 	list_del(&elem->list);
 	snd_mixer_elem_free(elem);
@@ -490,6 +711,7 @@ void snd_mixer_elem_free(snd_mixer_elem_t *elem)
 {
 	if (elem->private_free)
 		elem->private_free(elem);
+	bag_fini(&elem->helems);
 	free(elem);
 }
 
@@ -532,6 +754,7 @@ int snd_mixer_class_register(snd_mixer_class_t *class, snd_mixer_t *mixer)
 	list_add_tail(&class->list, &mixer->classes);
 	if (!class->event)
 		return 0;
+	mixer_bulk_begin(mixer);
 	list_for_each(pos, &mixer->slaves) {
 		int err;
 		snd_mixer_slave_t *slave;
@@ -540,11 +763,14 @@ int snd_mixer_class_register(snd_mixer_class_t *class, snd_mixer_t *mixer)
 		elem = snd_hctl_first_elem(slave->hctl);
 		while (elem) {
 			err = class->event(class, SND_CTL_EVENT_MASK_ADD, elem, NULL);
-			if (err < 0)
+			if (err < 0) {
+				mixer_bulk_end(mixer);
 				return err;
+			}
 			elem = snd_hctl_elem_next(elem);
 		}
 	}
+	mixer_bulk_end(mixer);
 	return 0;
 }
 
@@ -580,15 +806,18 @@ int snd_mixer_class_unregister(snd_mixer_class_t *class)
 int snd_mixer_load(snd_mixer_t *mixer)
 {
 	struct list_head *pos;
+	int err = 0;
+
+	mixer_bulk_begin(mixer);
 	list_for_each(pos, &mixer->slaves) {
-		int err;
 		snd_mixer_slave_t *s;
 		s = list_entry(pos, snd_mixer_slave_t, list);
 		err = snd_hctl_load(s->hctl);
 		if (err < 0)
-			return err;
+			break;
 	}
-	return 0;
+	mixer_bulk_end(mixer);
+	return err < 0 ? err : 0;
 }
 
 /**
@@ -623,6 +852,8 @@ int snd_mixer_close(snd_mixer_t *mixer)
 	assert(mixer->count == 0);
 	free(mixer->pelems);
 	mixer->pelems = NULL;
+	free(mixer->hash);
+	mixer_pending_free(mixer);
 	while (!list_empty(&mixer->slaves)) {
 		int err;
 		snd_mixer_slave_t *s;
@@ -666,6 +897,7 @@ static int snd_mixer_sort(snd_mixer_t *mixer)
 	qsort(mixer->pelems, mixer->count, sizeof(snd_mixer_elem_t *), mixer_compare);
 	for (k = 0; k < mixer->count; k++)
 		list_add_tail(&mixer->pelems[k]->list, &mixer->elems);
+	mixer->unsorted = 0;
 	return 0;
 }
 
@@ -865,6 +1097,77 @@ int snd_mixer_handle_events(snd_mixer_t *mixer)
 	return mixer->events;
 }
 
+/**
+ * \brief Start a transaction of mixer element writes
+ * \param mixer Mixer handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * Until #snd_mixer_commit() the simple mixer elements keep the values of
+ * the controls they write in the mixer.  Several writes to one control
+ * are merged.  At the commit, each changed control is written once and
+ * the writes go to the driver in as few calls as it allows.  The
+ * transactions nest, only the outermost commit writes.
+ */
+int snd_mixer_begin(snd_mixer_t *mixer)
+{
+	assert(mixer);
+	mixer->txn++;
+	return 0;
+}
+
+/**
+ * \brief Finish a transaction of mixer element writes
+ * \param mixer Mixer handle
+ * \return 0 on success, or the error of the first control write failed
+ *
+ * See #snd_mixer_begin().  All kept writes are tried even if one fails.
+ */
+int snd_mixer_commit(snd_mixer_t *mixer)
+{
+	snd_hctl_elem_t **elems;
+	snd_ctl_elem_value_t **values;
+	snd_hctl_t *hctl;
+	unsigned int k, n, count;
+	int err, res = 0;
+
+	assert(mixer);
+	assert(mixer->txn);
+	if (--mixer->txn || !mixer->pending_count)
+		return 0;
+	count = mixer->pending_count;
+	elems = malloc(count * (sizeof(*elems) + sizeof(*values)));
+	if (!elems) {
+		res = -ENOMEM;
+		goto out;
+	}
+	values = (snd_ctl_elem_value_t **)(elems + count);
+	while (mixer->pending_count) {
+		/* one batch for each hcontrol handle */
+		hctl = snd_hctl_elem_get_hctl(mixer->pending_elems[0]);
+		for (k = n = 0; k < mixer->pending_count; k++) {
+			if (snd_hctl_elem_get_hctl(mixer->pending_elems[k]) != hctl)
+				continue;
+			elems[n] = mixer->pending_elems[k];
+			values[n++] = &mixer->pending_values[k];
+		}
+		for (k = 0; k < n; ) {
+			err = snd_hctl_elem_write_multi(elems + k, values + k, n - k);
+			if (err <= 0) {
+				/* skip the element failed */
+				if (err < 0 && !res)
+					res = err;
+				err = 1;
+			}
+			k += err;
+		}
+		mixer_pending_drop(mixer, hctl, NULL);
+	}
+	free(elems);
+ out:
+	mixer_pending_free(mixer);
+	return res;
+}
+
 /**
  * \brief Set callback function for a mixer
  * \param obj mixer handle
@@ -22,13 +22,20 @@
 
 #include "local.h"
 
-typedef struct _bag1 {
-	void *ptr;
-	struct list_head list;
-} bag1_t;
+#define BAG_INLINE	4
 
-typedef struct list_head bag_t;
+/* small vector of pointers, the first BAG_INLINE are stored inline */
+typedef struct _bag {
+	unsigned int count;
+	unsigned int alloc;		/* zero while the inline storage is used */
+	union {
+		void *inl[BAG_INLINE];
+		void **ext;
+	} u;
+} bag_t;
 
+void bag_init(bag_t *bag);
+void bag_fini(bag_t *bag);
 int bag_new(bag_t **bag);
 void bag_free(bag_t *bag);
 int bag_add(bag_t *bag, void *ptr);
@@ -36,11 +43,15 @@ int bag_del(bag_t *bag, void *ptr);
 int bag_empty(bag_t *bag);
 void bag_del_all(bag_t *bag);
 
-typedef struct list_head *bag_iterator_t;
+typedef unsigned int bag_iterator_t;
 
-#define bag_iterator_entry(i) (list_entry((i), bag1_t, list)->ptr)
-#define bag_for_each(pos, bag) list_for_each(pos, bag)
-#define bag_for_each_safe(pos, next, bag) list_for_each_safe(pos, next, bag)
+#define bag_ptrs(bag) ((bag)->alloc ? (bag)->u.ext : (bag)->u.inl)
+#define bag_for_each(pos, ptr, bag) \
+	for ((pos) = 0; (pos) < (bag)->count && ((ptr) = bag_ptrs(bag)[(pos)], 1); (pos)++)
+/* the current entry may be deleted from the loop body */
+#define bag_for_each_safe(pos, ptr, bag) \
+	for ((pos) = 0; (pos) < (bag)->count && ((ptr) = bag_ptrs(bag)[(pos)], 1); \
+	     (pos) += (pos) < (bag)->count && bag_ptrs(bag)[(pos)] == (void *)(ptr))
 
 struct _snd_mixer_class {
 	struct list_head list;
@@ -61,6 +72,7 @@ struct _snd_mixer_elem {
 	void *callback_private;
 	bag_t helems;
 	int compare_weight;		/* compare weight (reversed) */
+	snd_mixer_elem_t *hash_next;	/* next simple element in the bucket */
 };
 
 struct _snd_mixer {
@@ -74,9 +86,24 @@ struct _snd_mixer {
 	snd_mixer_callback_t callback;
 	void *callback_private;
 	snd_mixer_compare_t compare;
+	snd_mixer_elem_t **hash;	/* simple elements hashed by id */
+	unsigned int hash_size;		/* zero or a power of two */
+	unsigned int hash_count;
+	unsigned int bulk;		/* adding without keeping pelems sorted */
+	int unsorted;			/* pelems must be sorted before a search */
+	unsigned int txn;		/* nesting of snd_mixer_begin() */
+	snd_hctl_elem_t **pending_elems; /* writes kept until the commit */
+	snd_ctl_elem_value_t *pending_values;
+	unsigned int pending_count;
+	unsigned int pending_alloc;
 };
 
 struct _snd_mixer_selem_id {
 	char name[60];
 	unsigned int index;
 };
+
+snd_mixer_elem_t *mixer_find_selem(snd_mixer_t *mixer, const char *name,
+				   unsigned int index);
+int mixer_helem_read(snd_hctl_elem_t *helem, snd_ctl_elem_value_t *value);
+int mixer_helem_write(snd_hctl_elem_t *helem, snd_ctl_elem_value_t *value);
@@ -133,19 +133,7 @@ int snd_mixer_selem_compare(const snd_mixer_elem_t *c1, const snd_mixer_elem_t *
 snd_mixer_elem_t *snd_mixer_find_selem(snd_mixer_t *mixer,
 				       const snd_mixer_selem_id_t *id)
 {
-	struct list_head *list;
-	snd_mixer_elem_t *e;
-	sm_selem_t *s;
-
-	list_for_each(list, &mixer->elems) {
-		e = list_entry(list, snd_mixer_elem_t, list);
-		if (e->type != SND_MIXER_ELEM_SIMPLE)
-			continue;
-		s = e->private_data;
-		if (!strcmp(s->id->name, id->name) && s->id->index == id->index)
-			return e;
-	}
-	return NULL;
+	return mixer_find_selem(mixer, id->name, id->index);
 }
 
 /**
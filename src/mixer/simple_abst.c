@@ -35,8 +35,12 @@
 #include <sys/ioctl.h>
 #include <math.h>
 #include <dlfcn.h>
+#include <sys/stat.h>
 #include "mixer_local.h"
 #include "mixer_simple.h"
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #ifndef DOC_HIDDEN
 
@@ -58,8 +62,58 @@ typedef int (*snd_mixer_sfbasic_init_t)(snd_mixer_class_t *class,
 					snd_mixer_t *mixer,
 					const char *device);
 
+/*
+ * The digest of smixer.conf and the module chosen for each card are
+ * shared by all opens in the process, so that a mixer opened again on
+ * the same card does not parse the file and match the components again.
+ * The digest is rebuilt when the file changes.
+ */
+struct smixer_module {
+	char *lib;
+	char *searchl;
+};
+
+struct smixer_card {
+	struct smixer_card *next;
+	char *components;
+	int module;		/* index of the matching module, -1 = none */
+};
+
+struct smixer_conf {
+	char *file;
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	time_t mtime;
+	int full_err;		/* result of the _full lookup */
+	char *full;
+	int modules_err;	/* error after the parsed modules */
+	unsigned int count;
+	struct smixer_module *modules;
+	struct smixer_card *cards;
+};
+
 #endif /* !DOC_HIDDEN */
 
+static struct smixer_conf *smixer_cache;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t smixer_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline void smixer_cache_lock(void)
+{
+	pthread_mutex_lock(&smixer_cache_mutex);
+}
+
+static inline void smixer_cache_unlock(void)
+{
+	pthread_mutex_unlock(&smixer_cache_mutex);
+}
+#else
+static inline void smixer_cache_lock(void) {}
+static inline void smixer_cache_unlock(void) {}
+#endif
+
 static int try_open(snd_mixer_class_t *class, const char *lib)
 {
 	class_priv_t *priv = snd_mixer_class_get_private(class);
@@ -154,17 +208,13 @@ static int try_open_full(snd_mixer_class_t *class, snd_mixer_t *mixer,
 	return 1;
 }
 
-static int match(snd_mixer_class_t *class, const char *lib, const char *searchl)
+static int match(const char *components, const char *searchl)
 {
-	class_priv_t *priv = snd_mixer_class_get_private(class);
-	const char *components;
-
 	if (searchl == NULL)
-		return try_open(class, lib);
-	components = snd_ctl_card_info_get_components(priv->info);
+		return 1;
 	while (*components != '\0') {
 		if (!strncmp(components, searchl, strlen(searchl)))
-			return try_open(class, lib);
+			return 1;
 		while (*components != ' ' && *components != '\0')
 			components++;
 		while (*components == ' ' && *components != '\0')
@@ -173,12 +223,40 @@ static int match(snd_mixer_class_t *class, const char *lib, const char *searchl)
 	return 0;
 }
 
-static int find_full(snd_mixer_class_t *class, snd_mixer_t *mixer,
-		     snd_config_t *top, const char *device)
+static void smixer_conf_free(struct smixer_conf *conf)
+{
+	struct smixer_card *card;
+	unsigned int idx;
+
+	if (conf == NULL)
+		return;
+	while ((card = conf->cards) != NULL) {
+		conf->cards = card->next;
+		free(card->components);
+		free(card);
+	}
+	for (idx = 0; idx < conf->count; idx++) {
+		free(conf->modules[idx].lib);
+		free(conf->modules[idx].searchl);
+	}
+	free(conf->modules);
+	free(conf->full);
+	free(conf->file);
+	free(conf);
+}
+
+static int smixer_strdup(char **dst, const char *src)
+{
+	if (src == NULL)
+		return 0;
+	*dst = strdup(src);
+	return *dst ? 0 : -ENOMEM;
+}
+
+static int find_full(struct smixer_conf *conf, snd_config_t *top)
 {
 	snd_config_iterator_t i, next;
-	char *lib;
-	const char *id;
+	const char *id, *lib;
 	int err;
 
 	snd_config_for_each(i, next, top) {
@@ -187,25 +265,28 @@ static int find_full(snd_mixer_class_t *class, snd_mixer_t *mixer,
 			continue;
 		if (strcmp(id, "_full"))
 			continue;
-		err = snd_config_get_string(n, (const char **)&lib);
-		if (err < 0)
-			return err;
-		err = try_open_full(class, mixer, lib, device);
+		err = snd_config_get_string(n, &lib);
 		if (err < 0)
 			return err;
-		return 0;
+		return smixer_strdup(&conf->full, lib);
 	}
 	return -ENOENT;
 }
 
-static int find_module(snd_mixer_class_t *class, snd_config_t *top)
+static int find_modules(struct smixer_conf *conf, snd_config_t *top)
 {
 	snd_config_iterator_t i, next;
 	snd_config_iterator_t j, jnext;
-	char *lib, *searchl;
-	const char *id;
+	struct smixer_module *m;
+	const char *id, *lib, *searchl;
+	unsigned int count = 0;
 	int err;
 
+	snd_config_for_each(i, next, top)
+		count++;
+	conf->modules = calloc(count ? count : 1, sizeof(*conf->modules));
+	if (conf->modules == NULL)
+		return -ENOMEM;
 	snd_config_for_each(i, next, top) {
 		snd_config_t *n = snd_config_iterator_entry(i);
 		if (snd_config_get_id(n, &id) < 0)
@@ -215,29 +296,173 @@ static int find_module(snd_mixer_class_t *class, snd_config_t *top)
 		searchl = NULL;
 		lib = NULL;
 		snd_config_for_each(j, jnext, n) {
-			snd_config_t *m = snd_config_iterator_entry(j);
-			if (snd_config_get_id(m, &id) < 0)
+			snd_config_t *c = snd_config_iterator_entry(j);
+			if (snd_config_get_id(c, &id) < 0)
 				continue;
 			if (!strcmp(id, "searchl")) {
-				err = snd_config_get_string(m, (const char **)&searchl);
+				err = snd_config_get_string(c, &searchl);
 				if (err < 0)
 					return err;
 				continue;
 			}
 			if (!strcmp(id, "lib")) {
-				err = snd_config_get_string(m, (const char **)&lib);
+				err = snd_config_get_string(c, &lib);
 				if (err < 0)
 					return err;
 				continue;
 			}
 		}
-		err = match(class, lib, searchl);
-		if (err == 1)
-			return 0;
-		if (err < 0)
-			return err;
+		m = &conf->modules[conf->count++];
+		if (smixer_strdup(&m->lib, lib) < 0 ||
+		    smixer_strdup(&m->searchl, searchl) < 0)
+			return -ENOMEM;
 	}
-	return -ENOENT;
+	return 0;
+}
+
+static int smixer_conf_load(struct smixer_conf **confp, const char *file,
+			    const struct stat *st)
+{
+	struct smixer_conf *conf;
+	snd_input_t *input;
+	snd_config_t *top;
+	int err;
+
+	conf = calloc(1, sizeof(*conf));
+	if (conf == NULL)
+		return -ENOMEM;
+	conf->file = strdup(file);
+	if (conf->file == NULL) {
+		free(conf);
+		return -ENOMEM;
+	}
+	conf->dev = st->st_dev;
+	conf->ino = st->st_ino;
+	conf->size = st->st_size;
+	conf->mtime = st->st_mtime;
+	err = snd_config_top(&top);
+	if (err < 0)
+		goto __error;
+	err = snd_input_stdio_open(&input, file, "r");
+	if (err < 0) {
+		SNDERR("unable to open simple mixer configuration file '%s'", file);
+		goto __error;
+	}
+	err = snd_config_load(top, input);
+	snd_input_close(input);
+	if (err < 0) {
+		SNDERR("%s may be old or corrupted: consider to remove or fix it", file);
+		goto __error;
+	}
+	conf->full_err = find_full(conf, top);
+	conf->modules_err = find_modules(conf, top);
+	snd_config_delete(top);
+	if (conf->full_err == -ENOMEM || conf->modules_err == -ENOMEM) {
+		smixer_conf_free(conf);
+		return -ENOMEM;
+	}
+	*confp = conf;
+	return 0;
+
+      __error:
+	snd_config_delete(top);
+	smixer_conf_free(conf);
+	return err;
+}
+
+/* return the digest of file, caller must hold the cache lock */
+static int smixer_conf_get(struct smixer_conf **confp, const char *file)
+{
+	struct smixer_conf *conf = smixer_cache;
+	struct stat st;
+	int err;
+
+	if (stat(file, &st) < 0) {
+		SNDERR("unable to open simple mixer configuration file '%s'", file);
+		return -errno;
+	}
+	if (conf && !strcmp(conf->file, file) &&
+	    conf->dev == st.st_dev && conf->ino == st.st_ino &&
+	    conf->size == st.st_size && conf->mtime == st.st_mtime) {
+		*confp = conf;
+		return 0;
+	}
+	err = smixer_conf_load(&conf, file, &st);
+	if (err < 0)
+		return err;
+	smixer_conf_free(smixer_cache);
+	smixer_cache = conf;
+	*confp = conf;
+	return 0;
+}
+
+/* lookup the _full module, returns 1 and the library name when found */
+static int find_full_lib(const char *file, char **lib)
+{
+	struct smixer_conf *conf;
+	int err;
+
+	*lib = NULL;
+	smixer_cache_lock();
+	err = smixer_conf_get(&conf, file);
+	if (err >= 0) {
+		err = conf->full_err;
+		if (err >= 0)
+			err = smixer_strdup(lib, conf->full);
+		if (err >= 0)
+			err = 1;
+	}
+	smixer_cache_unlock();
+	return err;
+}
+
+/* lookup the module matching the card components */
+static int find_module_lib(const char *file, const char *components,
+			   char **lib)
+{
+	struct smixer_conf *conf;
+	struct smixer_card *card;
+	unsigned int idx;
+	int err;
+
+	*lib = NULL;
+	smixer_cache_lock();
+	err = smixer_conf_get(&conf, file);
+	if (err < 0)
+		goto __unlock;
+	for (card = conf->cards; card; card = card->next)
+		if (!strcmp(card->components, components))
+			break;
+	if (card == NULL) {
+		card = calloc(1, sizeof(*card));
+		if (card == NULL) {
+			err = -ENOMEM;
+			goto __unlock;
+		}
+		card->components = strdup(components);
+		if (card->components == NULL) {
+			free(card);
+			err = -ENOMEM;
+			goto __unlock;
+		}
+		card->module = -1;
+		for (idx = 0; idx < conf->count; idx++) {
+			if (match(components, conf->modules[idx].searchl)) {
+				card->module = idx;
+				break;
+			}
+		}
+		card->next = conf->cards;
+		conf->cards = card;
+	}
+	if (card->module < 0) {
+		err = conf->modules_err < 0 ? conf->modules_err : -ENOENT;
+		goto __unlock;
+	}
+	err = smixer_strdup(lib, conf->modules[card->module].lib);
+      __unlock:
+	smixer_cache_unlock();
+	return err;
 }
 
 static void private_free(snd_mixer_class_t *class)
@@ -274,8 +499,7 @@ int snd_mixer_simple_basic_register(snd_mixer_t *mixer,
 	snd_mixer_class_t *class;
 	class_priv_t *priv = calloc(1, sizeof(*priv));
 	const char *file;
-	snd_input_t *input;
-	snd_config_t *top = NULL;
+	char *lib;
 	int err;
 
 	if (priv == NULL)
@@ -304,41 +528,33 @@ int snd_mixer_simple_basic_register(snd_mixer_t *mixer,
 		sprintf(s, "%s/smixer.conf", topdir);
 		file = s;
 	}
-	err = snd_config_top(&top);
-	if (err >= 0) {
-		err = snd_input_stdio_open(&input, file, "r");
-		if (err < 0) {
-			SNDERR("unable to open simple mixer configuration file '%s'", file);
-			goto __error;
-		}
-		err = snd_config_load(top, input);
-		snd_input_close(input);
-		if (err < 0) {
-			SNDERR("%s may be old or corrupted: consider to remove or fix it", file);
-			goto __error;
-		}
-		err = find_full(class, mixer, top, priv->device);
-		if (err >= 0)
-			goto __full;
+	err = find_full_lib(file, &lib);
+	if (err < 0 && err != -ENOENT)
+		goto __error;
+	if (err > 0) {
+		err = try_open_full(class, mixer, lib, priv->device);
+		free(lib);
+		goto __full;
 	}
+	err = snd_ctl_open(&priv->ctl, priv->device, 0);
+	if (err < 0) {
+		SNDERR("unable to open control device '%s': %s", priv->device, snd_strerror(err));
+		goto __error;
+	}
+	err = snd_hctl_open_ctl(&priv->hctl, priv->ctl);
+	if (err < 0)
+		goto __error;
+	err = snd_ctl_card_info_malloc(&priv->info);
+	if (err < 0)
+		goto __error;
+	err = snd_ctl_card_info(priv->ctl, priv->info);
+	if (err < 0)
+		goto __error;
+	err = find_module_lib(file, snd_ctl_card_info_get_components(priv->info), &lib);
 	if (err >= 0) {
-		err = snd_ctl_open(&priv->ctl, priv->device, 0);
-		if (err < 0) {
-			SNDERR("unable to open control device '%s': %s", priv->device, snd_strerror(err));
-			goto __error;
-		}
-		err = snd_hctl_open_ctl(&priv->hctl, priv->ctl);
-		if (err < 0)
-			goto __error;
-		err = snd_ctl_card_info_malloc(&priv->info);
-		if (err < 0)
-			goto __error;
-		err = snd_ctl_card_info(priv->ctl, priv->info);
-		if (err < 0)
-			goto __error;
+		err = try_open(class, lib);
+		free(lib);
 	}
-	if (err >= 0)
-		err = find_module(class, top);
 	if (err >= 0)
 		err = snd_mixer_attach_hctl(mixer, priv->hctl);
 	if (err >= 0) {
@@ -348,14 +564,10 @@ int snd_mixer_simple_basic_register(snd_mixer_t *mixer,
       __full:
 	if (err < 0) {
 	      __error:
-		if (top)
-			snd_config_delete(top);
 	      	if (class)
 			snd_mixer_class_free(class);
 		return err;
 	}
-	if (top)
-		snd_config_delete(top);
 	if (classp)
 		*classp = class;
 	return 0;
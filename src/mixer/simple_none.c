@@ -40,6 +40,7 @@
 #include <limits.h>
 #include "local.h"
 #include "config.h"
+#include "mixer_local.h"
 #include "mixer_simple.h"
 
 #ifndef DOC_HIDDEN
@@ -238,7 +239,7 @@ static int elem_read_volume(selem_none_t *s, int dir, selem_ctl_type_t type)
 	unsigned int idx;
 	int err;
 	selem_ctl_t *c = &s->ctls[type];
-	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
+	if ((err = mixer_helem_read(c->elem, &ctl)) < 0)
 		return err;
 	for (idx = 0; idx < s->str[dir].channels; idx++) {
 		unsigned int idx1 = idx;
@@ -257,7 +258,7 @@ static int elem_read_switch(selem_none_t *s, int dir, selem_ctl_type_t type)
 	unsigned int idx;
 	int err;
 	selem_ctl_t *c = &s->ctls[type];
-	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
+	if ((err = mixer_helem_read(c->elem, &ctl)) < 0)
 		return err;
 	for (idx = 0; idx < s->str[dir].channels; idx++) {
 		unsigned int idx1 = idx;
@@ -275,7 +276,7 @@ static int elem_read_route(selem_none_t *s, int dir, selem_ctl_type_t type)
 	unsigned int idx;
 	int err;
 	selem_ctl_t *c = &s->ctls[type];
-	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
+	if ((err = mixer_helem_read(c->elem, &ctl)) < 0)
 		return err;
 	for (idx = 0; idx < s->str[dir].channels; idx++) {
 		unsigned int idx1 = idx;
@@ -304,7 +305,7 @@ static int elem_read_enum(selem_none_t *s)
 	else if (s->selem.caps & SM_CAP_CENUM)
 		type = CTL_CAPTURE_ENUM;
 	c = &s->ctls[type];
-	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
+	if ((err = mixer_helem_read(c->elem, &ctl)) < 0)
 		return err;
 	for (idx = 0; idx < s->str[0].channels; idx++) {
 		unsigned int idx1 = idx;
@@ -443,7 +444,7 @@ static int selem_read(snd_mixer_elem_t *elem)
 	if (s->ctls[CTL_CAPTURE_SOURCE].elem) {
 		snd_ctl_elem_value_t ctl = {0};
 		selem_ctl_t *c = &s->ctls[CTL_CAPTURE_SOURCE];
-		err = snd_hctl_elem_read(c->elem, &ctl);
+		err = mixer_helem_read(c->elem, &ctl);
 		if (err < 0)
 			return err;
 		for (idx = 0; idx < s->str[SM_CAPT].channels; idx++) {
@@ -471,12 +472,12 @@ static int elem_write_volume(selem_none_t *s, int dir, selem_ctl_type_t type)
 	unsigned int idx;
 	int err;
 	selem_ctl_t *c = &s->ctls[type];
-	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
+	if ((err = mixer_helem_read(c->elem, &ctl)) < 0)
 		return err;
 	for (idx = 0; idx < c->values; idx++)
 		snd_ctl_elem_value_set_integer(&ctl, idx,
 				from_user(s, dir, c, s->str[dir].vol[idx]));
-	if ((err = snd_hctl_elem_write(c->elem, &ctl)) < 0)
+	if ((err = mixer_helem_write(c->elem, &ctl)) < 0)
 		return err;
 	return 0;
 }
@@ -487,12 +488,12 @@ static int elem_write_switch(selem_none_t *s, int dir, selem_ctl_type_t type)
 	unsigned int idx;
 	int err;
 	selem_ctl_t *c = &s->ctls[type];
-	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
+	if ((err = mixer_helem_read(c->elem, &ctl)) < 0)
 		return err;
 	for (idx = 0; idx < c->values; idx++)
 		snd_ctl_elem_value_set_integer(&ctl, idx,
 					!!(s->str[dir].sw & (1 << idx)));
-	if ((err = snd_hctl_elem_write(c->elem, &ctl)) < 0)
+	if ((err = mixer_helem_write(c->elem, &ctl)) < 0)
 		return err;
 	return 0;
 }
@@ -503,11 +504,11 @@ static int elem_write_switch_constant(selem_none_t *s, selem_ctl_type_t type, in
 	unsigned int idx;
 	int err;
 	selem_ctl_t *c = &s->ctls[type];
-	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
+	if ((err = mixer_helem_read(c->elem, &ctl)) < 0)
 		return err;
 	for (idx = 0; idx < c->values; idx++)
 		snd_ctl_elem_value_set_integer(&ctl, idx, !!val);
-	if ((err = snd_hctl_elem_write(c->elem, &ctl)) < 0)
+	if ((err = mixer_helem_write(c->elem, &ctl)) < 0)
 		return err;
 	return 0;
 }
@@ -518,14 +519,14 @@ static int elem_write_route(selem_none_t *s, int dir, selem_ctl_type_t type)
 	unsigned int idx;
 	int err;
 	selem_ctl_t *c = &s->ctls[type];
-	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
+	if ((err = mixer_helem_read(c->elem, &ctl)) < 0)
 		return err;
 	for (idx = 0; idx < c->values * c->values; idx++)
 		snd_ctl_elem_value_set_integer(&ctl, idx, 0);
 	for (idx = 0; idx < c->values; idx++)
 		snd_ctl_elem_value_set_integer(&ctl, idx * c->values + idx,
 					       !!(s->str[dir].sw & (1 << idx)));
-	if ((err = snd_hctl_elem_write(c->elem, &ctl)) < 0)
+	if ((err = mixer_helem_write(c->elem, &ctl)) < 0)
 		return err;
 	return 0;
 }
@@ -546,12 +547,12 @@ static int elem_write_enum(selem_none_t *s)
 	else if (s->selem.caps & SM_CAP_CENUM)
 		type = CTL_CAPTURE_ENUM;
 	c = &s->ctls[type];
-	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
+	if ((err = mixer_helem_read(c->elem, &ctl)) < 0)
 		return err;
 	for (idx = 0; idx < c->values; idx++)
 		snd_ctl_elem_value_set_enumerated(&ctl, idx,
 					(unsigned int)s->str[0].vol[idx]);
-	if ((err = snd_hctl_elem_write(c->elem, &ctl)) < 0)
+	if ((err = mixer_helem_write(c->elem, &ctl)) < 0)
 		return err;
 	return 0;
 }
@@ -630,14 +631,14 @@ static int selem_write_main(snd_mixer_elem_t *elem)
 	if (s->ctls[CTL_CAPTURE_SOURCE].elem) {
 		snd_ctl_elem_value_t ctl = {0};
 		selem_ctl_t *c = &s->ctls[CTL_CAPTURE_SOURCE];
-		if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
+		if ((err = mixer_helem_read(c->elem, &ctl)) < 0)
 			return err;
 		for (idx = 0; idx < c->values; idx++) {
 			if (s->str[SM_CAPT].sw & (1 << idx))
 				snd_ctl_elem_value_set_enumerated(&ctl,
 							idx, s->capture_item);
 		}
-		if ((err = snd_hctl_elem_write(c->elem, &ctl)) < 0)
+		if ((err = mixer_helem_write(c->elem, &ctl)) < 0)
 			return err;
 		/* update the element, don't remove */
 		err = selem_read(elem);
@@ -1096,10 +1097,18 @@ static int get_volume_ops(snd_mixer_elem_t *elem, int dir,
 
 static int init_db_range(snd_hctl_elem_t *ctl, struct selem_str *rec);
 
-static int convert_to_dB(snd_hctl_elem_t *ctl, struct selem_str *rec,
+/* the hcontrol element keeps the dB TLV for its own raw range */
+static inline int use_hctl_db(selem_ctl_t *c, struct selem_str *rec)
+{
+	return rec->min == c->min && rec->max == c->max;
+}
+
+static int convert_to_dB(selem_ctl_t *c, struct selem_str *rec,
 			 long volume, long *db_gain)
 {
-	if (init_db_range(ctl, rec) < 0)
+	if (use_hctl_db(c, rec))
+		return snd_hctl_elem_convert_to_dB(c->elem, volume, db_gain);
+	if (init_db_range(c->elem, rec) < 0)
 		return -EINVAL;
 	return snd_tlv_convert_to_dB(rec->db_info, rec->min, rec->max,
 				     volume, db_gain);
@@ -1166,10 +1175,12 @@ static selem_ctl_t *get_selem_ctl(selem_none_t *s, int dir)
 	return c;
 }
 
-static int get_dB_range(snd_hctl_elem_t *ctl, struct selem_str *rec,
+static int get_dB_range(selem_ctl_t *c, struct selem_str *rec,
 			long *min, long *max)
 {
-	if (init_db_range(ctl, rec) < 0)
+	if (use_hctl_db(c, rec))
+		return snd_hctl_elem_get_dB_range(c->elem, min, max);
+	if (init_db_range(c->elem, rec) < 0)
 		return -EINVAL;
 
 	return snd_tlv_get_dB_range(rec->db_info, rec->min, rec->max, min, max);
@@ -1186,13 +1197,16 @@ static int get_dB_range_ops(snd_mixer_elem_t *elem, int dir,
 	c = get_selem_ctl(s, dir);
 	if (! c)
 		return -EINVAL;
-	return get_dB_range(c->elem, &s->str[dir], min, max);
+	return get_dB_range(c, &s->str[dir], min, max);
 }
 
-static int convert_from_dB(snd_hctl_elem_t *ctl, struct selem_str *rec,
+static int convert_from_dB(selem_ctl_t *c, struct selem_str *rec,
 			   long db_gain, long *value, int xdir)
 {
-	if (init_db_range(ctl, rec) < 0)
+	if (use_hctl_db(c, rec))
+		return snd_hctl_elem_convert_from_dB(c->elem, db_gain, value,
+						     xdir);
+	if (init_db_range(c->elem, rec) < 0)
 		return -EINVAL;
 
 	return snd_tlv_convert_from_dB(rec->db_info, rec->min, rec->max,
@@ -1210,7 +1224,7 @@ static int ask_vol_dB_ops(snd_mixer_elem_t *elem,
 	c = get_selem_ctl(s, dir);
 	if (! c)
 		return -EINVAL;
-	int res = convert_to_dB(c->elem, &s->str[dir], value, dBvalue);
+	int res = convert_to_dB(c, &s->str[dir], value, dBvalue);
 	return res;
 }
 
@@ -1231,7 +1245,7 @@ static int get_dB_ops(snd_mixer_elem_t *elem,
 		return -EINVAL;
 	if ((err = get_volume_ops(elem, dir, channel, &volume)) < 0)
 		goto _err;
-	if ((err = convert_to_dB(c->elem, &s->str[dir], volume, &db_gain)) < 0)
+	if ((err = convert_to_dB(c, &s->str[dir], volume, &db_gain)) < 0)
 		goto _err;
 	err = 0;
 	*value = db_gain;
@@ -1274,7 +1288,7 @@ static int ask_dB_vol_ops(snd_mixer_elem_t *elem, int dir,
 	c = get_selem_ctl(s, dir);
 	if (! c)
 		return -EINVAL;
-	return convert_from_dB(c->elem, &s->str[dir], dbValue, value, xdir);
+	return convert_from_dB(c, &s->str[dir], dbValue, value, xdir);
 }
 
 static int set_dB_ops(snd_mixer_elem_t *elem, int dir,
@@ -1291,7 +1305,7 @@ static int set_dB_ops(snd_mixer_elem_t *elem, int dir,
 	c = get_selem_ctl(s, dir);
 	if (! c)
 		return -EINVAL;
-	err = convert_from_dB(c->elem, &s->str[dir], db_gain, &value, xdir);
+	err = convert_from_dB(c, &s->str[dir], db_gain, &value, xdir);
 	if (err < 0)
 		return err;
 	return set_volume_ops(elem, dir, channel, value);
@@ -1363,7 +1377,7 @@ static int get_enum_item_ops(snd_mixer_elem_t *elem,
 	if (!helem) helem = s->ctls[CTL_PLAYBACK_ENUM].elem;
 	if (!helem) helem = s->ctls[CTL_CAPTURE_ENUM].elem;
 	assert(helem);
-	err = snd_hctl_elem_read(helem, &ctl);
+	err = mixer_helem_read(helem, &ctl);
 	if (! err)
 		*itemp = snd_ctl_elem_value_get_enumerated(&ctl, channel);
 	return err;
@@ -1396,12 +1410,12 @@ static int set_enum_item_ops(snd_mixer_elem_t *elem,
 	if (item >= (unsigned int)s->ctls[type].max) {
 		return -EINVAL;
 	}
-	err = snd_hctl_elem_read(helem, &ctl);
+	err = mixer_helem_read(helem, &ctl);
 	if (err < 0) {
 		return err;
 	}
 	snd_ctl_elem_value_set_enumerated(&ctl, channel, item);
-	return snd_hctl_elem_write(helem, &ctl);
+	return mixer_helem_write(helem, &ctl);
 }
 
 static struct sm_elem_ops simple_none_ops = {
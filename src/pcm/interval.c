@@ -57,18 +57,23 @@ static inline unsigned int div_up(unsigned int a, unsigned int b)
 	if (b == 0)
 		return UINT_MAX;
 	q = div32(a, b, &r);
-	if (r)
-		++q;
-	return q;
+	return q + (r != 0);
 }
 
 static inline unsigned int mul(unsigned int a, unsigned int b)
 {
+#if defined(__GNUC__) && (defined(__clang__) || __GNUC__ >= 5)
+	unsigned int c;
+
+	/* saturate without the division of the portable check */
+	return __builtin_mul_overflow(a, b, &c) ? UINT_MAX : c;
+#else
 	if (a == 0)
 		return 0;
 	if (div_down(UINT_MAX, a) < b)
 		return UINT_MAX;
 	return a * b;
+#endif
 }
 
 static inline unsigned int add(unsigned int a, unsigned int b)
@@ -30,6 +30,22 @@
 #define MASK_OFS(i)	((i) >> 5)
 #define MASK_BIT(i)	(1U << ((i) & 31))
 
+#if defined(__GNUC__)
+MASK_INLINE unsigned int ld2(uint32_t v)
+{
+	return v ? 31 - __builtin_clz(v) : 0;
+}
+
+MASK_INLINE unsigned int hweight32(uint32_t v)
+{
+	return __builtin_popcount(v);
+}
+
+MASK_INLINE unsigned int lowbit32(uint32_t v)
+{
+	return __builtin_ctz(v);
+}
+#else
 MASK_INLINE unsigned int ld2(uint32_t v)
 {
         unsigned r = 0;
@@ -64,6 +80,22 @@ MASK_INLINE unsigned int hweight32(uint32_t v)
         return (v & 0x0000FFFF) + ((v >> 16) & 0x0000FFFF);
 }
 
+MASK_INLINE unsigned int lowbit32(uint32_t v)
+{
+	return ffs(v) - 1;
+}
+#endif
+
+/* the bits of the given word which fall into from..to (inclusive) */
+MASK_INLINE uint32_t snd_mask_word_range(unsigned int word,
+					 unsigned int from, unsigned int to)
+{
+	unsigned int lo = MASK_OFS(from) == word ? from & 31 : 0;
+	unsigned int hi = MASK_OFS(to) == word ? to & 31 : 31;
+
+	return (0xffffffffU << lo) & (0xffffffffU >> (31 - hi));
+}
+
 MASK_INLINE size_t snd_mask_sizeof(void)
 {
 	return sizeof(snd_mask_t);
@@ -111,7 +143,7 @@ MASK_INLINE unsigned int snd_mask_min(const snd_mask_t *mask)
 	assert(!snd_mask_empty(mask));
 	for (i = 0; i < MASK_SIZE; i++) {
 		if (mask->bits[i])
-			return ffs(mask->bits[i]) - 1 + (i << 5);
+			return lowbit32(mask->bits[i]) + (i << 5);
 	}
 	return 0;
 }
@@ -143,16 +175,16 @@ MASK_INLINE void snd_mask_set_range(snd_mask_t *mask, unsigned int from, unsigne
 {
 	unsigned int i;
 	assert(to <= SND_MASK_MAX && from <= to);
-	for (i = from; i <= to; i++)
-		mask->bits[MASK_OFS(i)] |= MASK_BIT(i);
+	for (i = MASK_OFS(from); i <= MASK_OFS(to); i++)
+		mask->bits[i] |= snd_mask_word_range(i, from, to);
 }
 
 MASK_INLINE void snd_mask_reset_range(snd_mask_t *mask, unsigned int from, unsigned int to)
 {
 	unsigned int i;
 	assert(to <= SND_MASK_MAX && from <= to);
-	for (i = from; i <= to; i++)
-		mask->bits[MASK_OFS(i)] &= ~MASK_BIT(i);
+	for (i = MASK_OFS(from); i <= MASK_OFS(to); i++)
+		mask->bits[i] &= ~snd_mask_word_range(i, from, to);
 }
 
 MASK_INLINE void snd_mask_leave(snd_mask_t *mask, unsigned int val)
@@ -196,18 +228,8 @@ MASK_INLINE int snd_mask_test(const snd_mask_t *mask, unsigned int val)
 
 MASK_INLINE int snd_mask_single(const snd_mask_t *mask)
 {
-	int i, c = 0;
 	assert(!snd_mask_empty(mask));
-	for (i = 0; i < MASK_SIZE; i++) {
-		if (! mask->bits[i])
-			continue;
-		if (mask->bits[i] & (mask->bits[i] - 1))
-			return 0;
-		if (c)
-			return 0;
-		c++;
-	}
-	return 1;
+	return snd_mask_count(mask) == 1;
 }
 
 MASK_INLINE int snd_mask_refine(snd_mask_t *mask, const snd_mask_t *v)
@@ -515,6 +515,37 @@ LIBASOUND_THREAD_SAFE=0 aplay foo.wav
 \endcode
 for making the debugging easier.
 
+When the value is \c pi, the locks are priority-inheritance mutexes
+instead: a non-RT thread holding the lock of a PCM (e.g. a monitoring
+thread calling #snd_pcm_avail_update()) is boosted to the priority of an
+RT thread waiting for it, so it cannot cause a priority inversion.
+\code
+LIBASOUND_THREAD_SAFE=pi jackd ...
+\endcode
+
+\section pcm_trace Open path tracing
+
+To see where the time goes while a PCM is opened and set up, the environment
+variable LIBASOUND_TRACE can name a file ("%p" is replaced with the process
+id, "-" means stderr).  The configuration update, the hooks, the definition
+searches, the plugin library loading, every plugin open, the parameter
+refinement and the hw ioctls are then recorded there as events in the Trace
+Event Format, which chrome://tracing or Perfetto can show directly, e.g.
+\code
+LIBASOUND_TRACE=/tmp/alsa-%p.json aplay -D plughw:0 foo.wav
+\endcode
+
+\section pcm_cpu CPU specific code
+
+The mixing of dmix, the interleaving of the plugin buffers and the
+linear, polyphase and ADPCM converters have vector variants, which are
+chosen at run time from the features of the CPU.  The environment
+variable LIBASOUND_CPU caps them at a level, one of generic, mmx, sse2,
+sse4.1, avx2 or neon, to compare the variants or to rule one out, e.g.
+\code
+LIBASOUND_CPU=generic aplay -D plug:dmix foo.wav
+\endcode
+
 \section pcm_dev_names PCM naming conventions
 
 The ALSA library uses a generic string representation for names of devices.
@@ -668,6 +699,7 @@ playback devices.
 #include <sys/mman.h>
 #include <limits.h>
 #include "pcm_local.h"
+#include "pcm_area_ops.h"
 
 #ifndef DOC_HIDDEN
 /* return specific error codes for known bad PCM states */
@@ -937,12 +969,13 @@ int snd_pcm_hw_params_current(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
  */
 int snd_pcm_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 {
+	unsigned long long trace = snd_trace_begin();
 	int err;
 	assert(pcm && params);
 	err = _snd_pcm_hw_params_internal(pcm, params);
-	if (err < 0)
-		return err;
-	err = snd_pcm_prepare(pcm);
+	if (err >= 0)
+		err = snd_pcm_prepare(pcm);
+	snd_trace_end(trace, "pcm", "snd_pcm_hw_params", pcm->name);
 	return err;
 }
 
@@ -967,11 +1000,33 @@ int snd_pcm_hw_free(snd_pcm_t *pcm)
 	else
 		err = -ENOSYS;
 	pcm->setup = 0;
+	snd_pcm_wait_invalidate(pcm);
 	if (err < 0)
 		return err;
 	return 0;
 }
 
+/* fill params from the PCM, called inside the PCM lock */
+static void sw_params_current(snd_pcm_t *pcm, snd_pcm_sw_params_t *params)
+{
+	params->proto = SNDRV_PCM_VERSION;
+	params->tstamp_mode = pcm->tstamp_mode;
+	params->tstamp_type = pcm->tstamp_type;
+	params->period_step = pcm->period_step;
+	params->sleep_min = 0;
+	/* the adaptive mode reports the requested threshold */
+	params->avail_min = pcm->avail_min_adaptive ?
+			    pcm->avail_min_floor : pcm->avail_min;
+	sw_set_period_event(params, pcm->period_event);
+	sw_set_avail_min_adaptive(params, pcm->avail_min_adaptive);
+	params->xfer_align = 1;
+	params->start_threshold = pcm->start_threshold;
+	params->stop_threshold = pcm->stop_threshold;
+	params->silence_threshold = pcm->silence_threshold;
+	params->silence_size = pcm->silence_size;
+	params->boundary = pcm->boundary;
+}
+
 /** \brief Install PCM software configuration defined by params
  * \param pcm PCM handle
  * \param params Configuration container
@@ -1019,11 +1074,16 @@ int snd_pcm_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t *params)
 	pcm->period_step = params->period_step;
 	pcm->avail_min = params->avail_min;
 	pcm->period_event = sw_get_period_event(params);
+	pcm->avail_min_adaptive = sw_get_avail_min_adaptive(params);
+	pcm->avail_min_floor = params->avail_min;
+	/* assume one period of lateness until wakeups are observed */
+	pcm->wake_late = pcm->period_size;
 	pcm->start_threshold = params->start_threshold;
 	pcm->stop_threshold = params->stop_threshold;
 	pcm->silence_threshold = params->silence_threshold;
 	pcm->silence_size = params->silence_size;
 	pcm->boundary = params->boundary;
+	snd_pcm_wait_invalidate(pcm);
 	__snd_pcm_unlock(pcm->op_arg);
 	return 0;
 }
@@ -1051,6 +1111,100 @@ int snd_pcm_status(snd_pcm_t *pcm, snd_pcm_status_t *status)
 	return err;
 }
 
+/* the fields snd_pcm_status_mask() reads without the status op */
+#define STATUS_MASK_LIGHT	(SND_PCM_STATUS_STATE | SND_PCM_STATUS_AVAIL | \
+				 SND_PCM_STATUS_DELAY | SND_PCM_STATUS_TSTAMP | \
+				 SND_PCM_STATUS_NOSYNC)
+
+/**
+ * \brief Obtain selected fields of the status information
+ * \param pcm PCM handle
+ * \param status Status container
+ * \param mask Fields to fill, \c SND_PCM_STATUS_* flags
+ * \return 0 on success otherwise a negative error code
+ *
+ * Each plugin of the chain fills the whole status in #snd_pcm_status(),
+ * from its slave's status.  When only the state, avail, delay and the
+ * pointer update timestamp are requested, this function reads them
+ * instead with the position operations, which each layer forwards
+ * without building a status.  A hw stream then needs a single
+ * synchronization ioctl (the delay query when \c SND_PCM_STATUS_DELAY
+ * is given) and reads the rest from the mmapped status page.  With
+ * \c SND_PCM_STATUS_NOSYNC the synchronization is skipped, and the
+ * positions are those of the last period update; a hw stream with the
+ * mmapped status page then needs no system call for the state, avail
+ * and timestamp (the delay is still an ioctl).  The fields
+ * not requested are zero.  Any other flag (including
+ * \c SND_PCM_STATUS_ALL) makes it identical to #snd_pcm_status().
+ *
+ * Unlike #snd_pcm_status(), the avail value is that of #snd_pcm_avail(),
+ * and avail_max is not reset.  With \c SND_PCM_STATUS_STATE, an xrun or
+ * a suspend is not an error: only the state is filled.
+ *
+ * The function is thread-safe when built with the proper option.
+ *
+ * This function is added in version 1.2.8.
+ */
+int snd_pcm_status_mask(snd_pcm_t *pcm, snd_pcm_status_t *status, unsigned int mask)
+{
+	snd_pcm_uframes_t avail;
+	snd_pcm_sframes_t sf;
+	int err = 0, delay = 0;
+
+	assert(pcm && status);
+	if ((mask & ~STATUS_MASK_LIGHT) || !pcm->setup)
+		return snd_pcm_status(pcm, status);
+	memset(status, 0, sizeof(*status));
+	snd_pcm_lock(pcm->fast_op_arg);
+	if (mask & SND_PCM_STATUS_NOSYNC) {
+		delay = !!(mask & SND_PCM_STATUS_DELAY);
+	} else if (mask & SND_PCM_STATUS_DELAY) {
+		/* the delay ioctl of hw synchronizes the pointer as well */
+		err = snd_pcm_hw_delay_hwsync(pcm, &status->delay);
+		if (err == -ENOSYS) {
+			err = __snd_pcm_hwsync(pcm);
+			delay = 1;
+		}
+	} else if (mask & (SND_PCM_STATUS_AVAIL | SND_PCM_STATUS_TSTAMP)) {
+		err = __snd_pcm_hwsync(pcm);
+	}
+	if (err < 0)
+		goto unlock;
+	if (delay) {
+		err = __snd_pcm_delay(pcm, &status->delay);
+		if (err < 0)
+			goto unlock;
+	}
+	if ((mask & SND_PCM_STATUS_TSTAMP) && pcm->fast_ops->htimestamp) {
+		/* updates avail on the way, in sync with the timestamp */
+		err = pcm->fast_ops->htimestamp(pcm->fast_op_arg, &avail,
+						&status->tstamp);
+		if (err < 0)
+			goto unlock;
+		if (mask & SND_PCM_STATUS_AVAIL)
+			status->avail = avail;
+	} else if (mask & SND_PCM_STATUS_AVAIL) {
+		sf = __snd_pcm_avail_update(pcm);
+		if (sf < 0) {
+			err = sf;
+			goto unlock;
+		}
+		status->avail = sf;
+	}
+	err = 0;
+ unlock:
+	/* like snd_pcm_status(), an xrun or a suspend is reported in the state */
+	if ((mask & SND_PCM_STATUS_STATE) &&
+	    (err >= 0 || err == -EPIPE || err == -ESTRPIPE)) {
+		if (err < 0)
+			memset(status, 0, sizeof(*status));
+		status->state = __snd_pcm_state(pcm);
+		err = 0;
+	}
+	snd_pcm_unlock(pcm->fast_op_arg);
+	return err;
+}
+
 /**
  * \brief Return PCM state
  * \param pcm PCM handle
@@ -1210,11 +1364,185 @@ int snd_pcm_htimestamp(snd_pcm_t *pcm, snd_pcm_uframes_t *avail, snd_htimestamp_
 	return err;
 }
 
+#ifndef DOC_HIDDEN
+struct snd_pcm_tstamp_ring {
+	unsigned int size;
+	unsigned int head;		/* next entry to write */
+	unsigned int count;
+	unsigned int busy: 1;		/* recording, the status op may recurse */
+	snd_pcm_uframes_t last_period;	/* period of the newest entry */
+	unsigned int audio_tstamp_data;	/* packed snd_pcm_audio_tstamp_config_t */
+#ifdef THREAD_SAFE_API
+	pthread_mutex_t mutex;		/* the reader holds the PCM lock only to find the ring */
+#endif
+	snd_pcm_tstamp_entry_t entries[];
+};
+
+#ifdef THREAD_SAFE_API
+#define tstamp_ring_lock(ring)		pthread_mutex_lock(&(ring)->mutex)
+#define tstamp_ring_unlock(ring)	pthread_mutex_unlock(&(ring)->mutex)
+#else
+#define tstamp_ring_lock(ring)		do {} while (0)
+#define tstamp_ring_unlock(ring)	do {} while (0)
+#endif
+
+static void tstamp_ring_free(struct snd_pcm_tstamp_ring *ring)
+{
+#ifdef THREAD_SAFE_API
+	pthread_mutex_destroy(&ring->mutex);
+#endif
+	free(ring);
+}
+
+/*
+ * called after each avail update of the PCM, records an entry when the
+ * hw pointer has moved to another period
+ */
+void snd_pcm_tstamp_ring_update(snd_pcm_t *pcm)
+{
+	struct snd_pcm_tstamp_ring *ring = pcm->tstamp_ring;
+	snd_pcm_tstamp_entry_t *entry;
+	snd_pcm_status_t status;
+
+	if (ring->busy || !pcm->setup || !pcm->hw.ptr || !pcm->fast_ops->status)
+		return;
+	if (ring->count && *pcm->hw.ptr / pcm->period_size == ring->last_period)
+		return;
+	ring->busy = 1;
+	memset(&status, 0, sizeof(status));
+	status.audio_tstamp_data = ring->audio_tstamp_data;
+	if (pcm->fast_ops->status(pcm->fast_op_arg, &status) >= 0 &&
+	    (status.state == SND_PCM_STATE_RUNNING ||
+	     status.state == SND_PCM_STATE_DRAINING) &&
+	    (!ring->count || status.hw_ptr / pcm->period_size != ring->last_period)) {
+		tstamp_ring_lock(ring);
+		entry = &ring->entries[ring->head];
+		entry->hw_ptr = status.hw_ptr;
+		entry->tstamp = status.tstamp;
+		entry->audio_tstamp = status.audio_tstamp;
+		ring->head = (ring->head + 1) % ring->size;
+		if (ring->count < ring->size)
+			ring->count++;
+		ring->last_period = status.hw_ptr / pcm->period_size;
+		tstamp_ring_unlock(ring);
+	}
+	ring->busy = 0;
+}
+#endif
+
+/**
+ * \brief Record the timestamps of each period update
+ * \param pcm PCM handle
+ * \param entries Ring size in entries, 0 to stop recording
+ * \param config Requested audio timestamp type, NULL for the default
+ * \return 0 on success otherwise a negative error code
+ *
+ * Once enabled, the library records the hw pointer with the system and
+ * the audio timestamps of its update, as #snd_pcm_status() reports them,
+ * once for every period the pointer enters while the stream runs.  The
+ * entries are taken when the library updates the pointer anyway (the
+ * transfer functions, #snd_pcm_avail_update(), #snd_pcm_avail() and
+ * friends, also after a wakeup in #snd_pcm_wait()), so an application
+ * reading or writing the stream gets the timestamps of each period
+ * without a query per transfer, and fetches them in bulk with
+ * #snd_pcm_tstamp_ring_read().  The recording queries the status once per
+ * period, which resets its avail_max and overrange fields.  When the ring
+ * is full the oldest entries are overwritten.
+ *
+ * The positions are those of \p pcm, in its frames.  The ring is emptied
+ * by each call.
+ *
+ * This function is added in version 1.2.8.
+ */
+int snd_pcm_tstamp_ring_enable(snd_pcm_t *pcm, unsigned int entries,
+			       const snd_pcm_audio_tstamp_config_t *config)
+{
+	struct snd_pcm_tstamp_ring *ring = NULL, *old;
+	snd_pcm_audio_tstamp_config_t def;
+
+	assert(pcm);
+	if (entries) {
+		ring = calloc(1, sizeof(*ring) + entries * sizeof(ring->entries[0]));
+		if (ring == NULL)
+			return -ENOMEM;
+		ring->size = entries;
+		if (config == NULL) {
+			memset(&def, 0, sizeof(def));
+			def.type_requested = SND_PCM_AUDIO_TSTAMP_TYPE_DEFAULT;
+			config = &def;
+		}
+		snd_pcm_pack_audio_tstamp_config(&ring->audio_tstamp_data,
+						 (snd_pcm_audio_tstamp_config_t *)config);
+#ifdef THREAD_SAFE_API
+		pthread_mutex_init(&ring->mutex, NULL);
+#endif
+	}
+	__snd_pcm_lock(pcm->fast_op_arg); /* forced lock, see the reader */
+	old = pcm->tstamp_ring;
+	pcm->tstamp_ring = ring;
+	__snd_pcm_unlock(pcm->fast_op_arg);
+	if (old) {
+		/* a reader that found the old ring holds its mutex */
+		tstamp_ring_lock(old);
+		tstamp_ring_unlock(old);
+		tstamp_ring_free(old);
+	}
+	return 0;
+}
+
+/**
+ * \brief Fetch the recorded period timestamps
+ * \param pcm PCM handle
+ * \param entries Returned entries, the oldest first
+ * \param count Maximum number of entries
+ * \return the number of returned entries, otherwise a negative error code
+ *
+ * The returned entries are removed from the ring, see
+ * #snd_pcm_tstamp_ring_enable().
+ *
+ * The function is thread-safe when built with the proper option.
+ *
+ * This function is added in version 1.2.8.
+ */
+int snd_pcm_tstamp_ring_read(snd_pcm_t *pcm, snd_pcm_tstamp_entry_t *entries,
+			     unsigned int count)
+{
+	struct snd_pcm_tstamp_ring *ring;
+	unsigned int i, tail;
+
+	assert(pcm && (entries || count == 0));
+	/* the ring is locked before the PCM is released, so that
+	 * snd_pcm_tstamp_ring_enable() cannot free it under us
+	 */
+	__snd_pcm_lock(pcm->fast_op_arg);
+	ring = pcm->tstamp_ring;
+	if (ring == NULL) {
+		__snd_pcm_unlock(pcm->fast_op_arg);
+		return -EINVAL;
+	}
+	tstamp_ring_lock(ring);
+	__snd_pcm_unlock(pcm->fast_op_arg);
+	if (count > ring->count)
+		count = ring->count;
+	tail = (ring->head + ring->size - ring->count) % ring->size;
+	for (i = 0; i < count; i++)
+		entries[i] = ring->entries[(tail + i) % ring->size];
+	ring->count -= count;
+	tstamp_ring_unlock(ring);
+	return count;
+}
+
 /**
  * \brief Prepare PCM for use
  * \param pcm PCM handle
  * \return 0 on success otherwise a negative error code
  *
+ * When the PCM was opened with #SND_PCM_MLOCK_AREAS, the mmapped areas
+ * of the whole plugin chain are locked into the memory here, so the
+ * transfers of the following run do not take page faults.  If any of
+ * them cannot be locked (e.g. beyond RLIMIT_MEMLOCK), the error of
+ * mlock() is returned.
+ *
  * The function is thread-safe when built with the proper option.
  */
 int snd_pcm_prepare(snd_pcm_t *pcm)
@@ -1230,10 +1558,56 @@ int snd_pcm_prepare(snd_pcm_t *pcm)
 	if (err < 0)
 		return err;
 	snd_pcm_lock(pcm->fast_op_arg);
+	snd_pcm_wait_invalidate(pcm);
 	if (pcm->fast_ops->prepare)
 		err = pcm->fast_ops->prepare(pcm->fast_op_arg);
 	else
 		err = -ENOSYS;
+	if (err >= 0 && (pcm->mode & SND_PCM_MLOCK_AREAS))
+		err = snd_pcm_mmap_lock_areas(pcm);
+	snd_pcm_unlock(pcm->fast_op_arg);
+	return err;
+}
+
+/**
+ * \brief Prepare PCM for use again after an xrun, keeping the plugin state
+ * \param pcm PCM handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * Like #snd_pcm_prepare(), but the layers that support it only realign
+ * their pointers to the layer below: the rate converter history, the
+ * LADSPA and external filter state and the dmix/dshare/dsnoop client
+ * timers are kept, and a direct plugin whose slave is still running
+ * does not touch the slave at all.  The layers without support are
+ * prepared as usual, the hardware PCM always is.
+ *
+ * Use it in place of #snd_pcm_prepare() when recovering from -EPIPE to
+ * avoid the discontinuity of a converter restart.  With
+ * LIBASOUND_PLUGIN_PROFILE set, the time spent is accounted in the
+ * plugin profile, see #snd_pcm_plugin_profile_get().
+ *
+ * This function is added in version 1.2.8.
+ */
+int snd_pcm_resync(snd_pcm_t *pcm)
+{
+	int err;
+
+	assert(pcm);
+	if (CHECK_SANITY(! pcm->setup)) {
+		SNDMSG("PCM not set up");
+		return -EIO;
+	}
+	err = bad_pcm_state(pcm, ~P_STATE(DISCONNECTED), 0);
+	if (err < 0)
+		return err;
+	snd_pcm_lock(pcm->fast_op_arg);
+	snd_pcm_wait_invalidate(pcm);
+	if (pcm->fast_ops->resync)
+		err = pcm->fast_ops->resync(pcm->fast_op_arg);
+	else if (pcm->fast_ops->prepare)
+		err = pcm->fast_ops->prepare(pcm->fast_op_arg);
+	else
+		err = -ENOSYS;
 	snd_pcm_unlock(pcm->fast_op_arg);
 	return err;
 }
@@ -1290,6 +1664,127 @@ int snd_pcm_start(snd_pcm_t *pcm)
 	return err;
 }
 
+#ifndef DOC_HIDDEN
+/* the last stretch before a scheduled start is spun, not slept */
+#define START_AT_SPIN_NS	200000LL
+
+static long long start_at_now(snd_pcm_tstamp_type_t type)
+{
+	snd_htimestamp_t ts;
+
+	gettimestamp(&ts, type);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+#endif
+
+/**
+ * \brief Start several PCMs at a given time
+ * \param pcms PCM handles, all in the PREPARED state
+ * \param count Number of handles
+ * \param tstamp Start time, in the timestamp clock of the PCMs
+ *               (see #snd_pcm_sw_params_set_tstamp_type)
+ * \param skew Returned start error per handle in nanoseconds (may be NULL)
+ * \return 0 on success otherwise the first negative error code
+ *
+ * For streams that cannot be linked, e.g. on independent cards.  The
+ * calling thread sleeps until shortly before \p tstamp, spins on the
+ * clock for the rest and starts the handles back to back, so they are
+ * triggered within microseconds of each other instead of the skew of
+ * separate wakeups.  Playback handles must be prefilled, with a start
+ * threshold above the prefill so that no write starts them earlier.
+ *
+ * The residual skew of each handle is measured afterwards: the trigger
+ * timestamp of its status minus \p tstamp, or, when the PCM does not
+ * report a trigger timestamp, the middle of its start call.  A handle
+ * that failed gets zero.  A \p tstamp in the past starts at once.
+ *
+ * All handles must use the same timestamp type.
+ *
+ * This function is added in version 1.2.8.
+ */
+int snd_pcm_start_at_multi(snd_pcm_t **pcms, unsigned int count,
+			   const snd_htimestamp_t *tstamp, long long *skew)
+{
+	snd_pcm_tstamp_type_t type;
+	snd_pcm_status_t status;
+	snd_htimestamp_t trigger;
+	long long target, delta, before, after;
+	struct timespec req;
+	unsigned int i;
+	int err, res = 0;
+
+	assert(pcms && tstamp);
+	if (count == 0)
+		return 0;
+	type = pcms[0]->tstamp_type;
+	for (i = 0; i < count; i++) {
+		if (CHECK_SANITY(! pcms[i]->setup)) {
+			SNDMSG("PCM not set up");
+			return -EIO;
+		}
+		if (pcms[i]->tstamp_type != type)
+			return -EINVAL;
+		err = bad_pcm_state(pcms[i], P_STATE(PREPARED), 0);
+		if (err < 0)
+			return err;
+	}
+	target = tstamp->tv_sec * 1000000000LL + tstamp->tv_nsec;
+	delta = target - start_at_now(type) - START_AT_SPIN_NS;
+	while (delta > 0) {
+		req.tv_sec = delta / 1000000000LL;
+		req.tv_nsec = delta % 1000000000LL;
+		if (nanosleep(&req, NULL) == 0 || errno != EINTR)
+			break;
+		delta = target - start_at_now(type) - START_AT_SPIN_NS;
+	}
+	while (start_at_now(type) < target)
+		;
+	for (i = 0; i < count; i++) {
+		snd_pcm_t *pcm = pcms[i];
+
+		before = start_at_now(type);
+		snd_pcm_lock(pcm->fast_op_arg);
+		err = __snd_pcm_start(pcm);
+		snd_pcm_unlock(pcm->fast_op_arg);
+		after = start_at_now(type);
+		if (skew)
+			skew[i] = err < 0 ? 0 : (before + after) / 2 - target;
+		if (err < 0 && !res)
+			res = err;
+	}
+	if (!skew)
+		return res;
+	for (i = 0; i < count; i++) {
+		snd_pcm_t *pcm = pcms[i];
+
+		if (!skew[i] || !pcm->fast_ops->status)
+			continue;
+		memset(&status, 0, sizeof(status));
+		snd_pcm_lock(pcm->fast_op_arg);
+		err = pcm->fast_ops->status(pcm->fast_op_arg, &status);
+		snd_pcm_unlock(pcm->fast_op_arg);
+		trigger = status.trigger_tstamp;
+		if (err >= 0 && (trigger.tv_sec || trigger.tv_nsec))
+			skew[i] = trigger.tv_sec * 1000000000LL + trigger.tv_nsec - target;
+	}
+	return res;
+}
+
+/**
+ * \brief Start a PCM at a given time
+ * \param pcm PCM handle
+ * \param tstamp Start time, in the timestamp clock of the PCM
+ * \return 0 on success otherwise a negative error code
+ *
+ * See #snd_pcm_start_at_multi.
+ *
+ * This function is added in version 1.2.8.
+ */
+int snd_pcm_start_at(snd_pcm_t *pcm, const snd_htimestamp_t *tstamp)
+{
+	return snd_pcm_start_at_multi(&pcm, 1, tstamp, NULL);
+}
+
 /**
  * \brief Stop a PCM dropping pending frames
  * \param pcm PCM handle
@@ -1688,6 +2183,91 @@ snd_pcm_sframes_t snd_pcm_readn(snd_pcm_t *pcm, void **bufs, snd_pcm_uframes_t s
 	return _snd_pcm_readn(pcm, bufs, size);
 }
 
+/* transfer the segments one after another, up to the first short one */
+static snd_pcm_sframes_t pcm_xferv(snd_pcm_t *pcm, const snd_pcm_segment_t *segs,
+				   unsigned int count, int write)
+{
+	snd_pcm_uframes_t xfer = 0;
+	snd_pcm_sframes_t frames;
+	unsigned int k;
+	int err;
+
+	assert(pcm);
+	assert(count == 0 || segs);
+	if (CHECK_SANITY(! pcm->setup)) {
+		SNDMSG("PCM not set up");
+		return -EIO;
+	}
+	if (pcm->access != SND_PCM_ACCESS_RW_INTERLEAVED) {
+		SNDMSG("invalid access type %s", snd_pcm_access_name(pcm->access));
+		return -EINVAL;
+	}
+	err = bad_pcm_state(pcm, P_STATE_RUNNABLE, 0);
+	if (err < 0)
+		return err;
+	for (k = 0; k < count; k++) {
+		if (segs[k].frames == 0)
+			continue;
+		assert(segs[k].addr);
+		if (write)
+			frames = _snd_pcm_writei(pcm, segs[k].addr, segs[k].frames);
+		else
+			frames = _snd_pcm_readi(pcm, segs[k].addr, segs[k].frames);
+		if (frames < 0)
+			return xfer > 0 ? (snd_pcm_sframes_t)xfer : frames;
+		xfer += frames;
+		if ((snd_pcm_uframes_t)frames < segs[k].frames)
+			break;
+	}
+	return xfer;
+}
+
+/**
+ * \brief Write interleaved frames from scattered buffers to a PCM
+ * \param pcm PCM handle
+ * \param segs the segments of frames, in the order to be written
+ * \param count number of segments
+ * \return a positive number of frames actually written otherwise a
+ * negative error code
+ * \retval -EBADFD PCM is not in the right state (#SND_PCM_STATE_PREPARED or #SND_PCM_STATE_RUNNING)
+ * \retval -EPIPE an underrun occurred
+ * \retval -ESTRPIPE a suspend event occurred (stream is suspended and waiting for an application recovery)
+ *
+ * Works like #snd_pcm_writei() on the concatenation of the segments,
+ * without it: each segment is copied by the PCM from where it is, so
+ * packets of frames need no staging buffer.  The transfer stops at the
+ * first segment that is not written completely; an error after some
+ * frames were written returns their count, the error is returned by
+ * the next call.
+ *
+ * The function is thread-safe when built with the proper option.
+ */
+snd_pcm_sframes_t snd_pcm_writev(snd_pcm_t *pcm, const snd_pcm_segment_t *segs, unsigned int count)
+{
+	return pcm_xferv(pcm, segs, count, 1);
+}
+
+/**
+ * \brief Read interleaved frames from a PCM into scattered buffers
+ * \param pcm PCM handle
+ * \param segs the segments to fill, in order
+ * \param count number of segments
+ * \return a positive number of frames actually read otherwise a
+ * negative error code
+ * \retval -EBADFD PCM is not in the right state (#SND_PCM_STATE_PREPARED or #SND_PCM_STATE_RUNNING)
+ * \retval -EPIPE an overrun occurred
+ * \retval -ESTRPIPE a suspend event occurred (stream is suspended and waiting for an application recovery)
+ *
+ * Works like #snd_pcm_readi() on the concatenation of the segments; see
+ * #snd_pcm_writev().
+ *
+ * The function is thread-safe when built with the proper option.
+ */
+snd_pcm_sframes_t snd_pcm_readv(snd_pcm_t *pcm, const snd_pcm_segment_t *segs, unsigned int count)
+{
+	return pcm_xferv(pcm, segs, count, 0);
+}
+
 /**
  * \brief Link two PCMs
  * \param pcm1 first PCM handle
@@ -2469,7 +3049,7 @@ int snd_async_add_pcm_handler(snd_async_handler_t **handler, snd_pcm_t *pcm,
 	h->u.pcm = pcm;
 	was_empty = list_empty(&pcm->async_handlers);
 	list_add_tail(&h->hlist, &pcm->async_handlers);
-	if (was_empty) {
+	if (was_empty && snd_async_get_delivery() == SND_ASYNC_SIGNAL) {
 		err = snd_pcm_async(pcm, snd_async_handler_get_signo(h), getpid());
 		if (err < 0) {
 			snd_async_del_handler(h);
@@ -2501,6 +3081,13 @@ static const char *const build_in_pcms[] = {
 	NULL
 };
 
+/* resolve the open functions of all PCM definitions (defaults.prelink) */
+int snd_pcm_open_prelink(snd_config_t *top)
+{
+	return snd_dlobj_cache_prelink(top, "pcm", build_in_pcms,
+			SND_DLSYM_VERSION(SND_PCM_DLSYM_VERSION));
+}
+
 static int snd_pcm_open_conf(snd_pcm_t **pcmp, const char *name,
 			     snd_config_t *pcm_root, snd_config_t *pcm_conf,
 			     snd_pcm_stream_t stream, int mode)
@@ -2610,13 +3197,22 @@ static int snd_pcm_open_conf(snd_pcm_t **pcmp, const char *name,
 	open_func = snd_dlobj_cache_get(lib, open_name,
 			SND_DLSYM_VERSION(SND_PCM_DLSYM_VERSION), 1);
 	if (open_func) {
+		unsigned long long trace = snd_trace_begin();
 		err = open_func(pcmp, name, pcm_root, pcm_conf, stream, mode);
+		snd_trace_end(trace, "pcm", str, name);
 		if (err >= 0) {
 			if ((*pcmp)->open_func) {
 				/* only init plugin (like empty, asym) */
 				snd_dlobj_cache_put(open_func);
 			} else {
 				(*pcmp)->open_func = open_func;
+				/* the slave keeps the policy of its own definition */
+				err = snd_pcm_mem_parse(pcm_root, pcm_conf, &(*pcmp)->mem);
+				if (err < 0) {
+					snd_pcm_close(*pcmp);
+					*pcmp = NULL;
+					goto _err;
+				}
 			}
 			err = 0;
 		} else {
@@ -2659,7 +3255,7 @@ static int snd_pcm_open_noupdate(snd_pcm_t **pcmp, snd_config_t *root,
 	snd_config_t *pcm_conf;
 	const char *str;
 
-	err = snd_config_search_definition(root, "pcm", name, &pcm_conf);
+	err = _snd_config_search_definition(root, "pcm", name, &pcm_conf, 1);
 	if (err < 0) {
 		SNDERR("Unknown PCM %s", name);
 		return err;
@@ -2668,13 +3264,117 @@ static int snd_pcm_open_noupdate(snd_pcm_t **pcmp, snd_config_t *root,
 		err = snd_pcm_open_noupdate(pcmp, root, str, stream, mode,
 					    hop + 1);
 	else {
-		snd_config_set_hop(pcm_conf, hop);
+		hop = snd_config_enter_hop(hop);
 		err = snd_pcm_open_conf(pcmp, name, root, pcm_conf, stream, mode);
+		snd_config_leave_hop(hop);
 	}
 	snd_config_delete(pcm_conf);
 	return err;
 }
 
+/*
+ * "hw:CARD,DEV[,SUBDEV]" with positional arguments is common enough for
+ * a shortcut: the card is resolved directly and the hw plugin is opened
+ * from a small compound with the same fields as the pcm.hw definition,
+ * so that the search, the argument parsing and the expansion of the
+ * @func defaults are skipped.  It is used only while pcm.hw has nothing
+ * but the fields of the stock definition and defaults.pcm.hw_fast_open
+ * is not off.  Returns 1 when the name must go through the full path.
+ */
+static int snd_pcm_open_hw_fast(snd_pcm_t **pcmp, snd_config_t *root,
+				const char *name, snd_pcm_stream_t stream,
+				int mode)
+{
+	static const char *const hw_fields[] = {
+		"type", "card", "device", "subdevice", "hint", NULL
+	};
+	snd_config_t *conf, *n;
+	snd_config_iterator_t i, next;
+	const char *args, *str;
+	char card_id[32], *end;
+	long device, subdevice = -1;
+	size_t len;
+	int card, err;
+
+	if (strncmp(name, "hw:", 3))
+		return 1;
+	args = name + 3;
+	len = strcspn(args, ",");
+	if (len == 0 || len >= sizeof(card_id) || args[len] != ',')
+		return 1;
+	memcpy(card_id, args, len);
+	card_id[len] = '\0';
+	for (str = card_id; *str; str++)
+		if (!isalnum((unsigned char)*str) && *str != '_' && *str != '-')
+			return 1;
+	args += len + 1;
+	if (!isdigit((unsigned char)*args))
+		return 1;
+	device = strtol(args, &end, 10);
+	if (*end == ',') {
+		args = end + 1;
+		if (!isdigit((unsigned char)*args) && *args != '-')
+			return 1;
+		subdevice = strtol(args, &end, 10);
+	} else if (snd_config_search(root, "defaults.pcm.subdevice", &n) >= 0 &&
+		   snd_config_get_integer(n, &subdevice) < 0)
+		return 1;
+	if (*end)
+		return 1;
+
+	if (snd_config_search(root, "defaults.pcm.hw_fast_open", &n) >= 0 &&
+	    snd_config_get_bool(n) <= 0)
+		return 1;
+	/* a local pcm.hw definition with other fields wins */
+	if (snd_config_search(root, "pcm.hw", &conf) < 0)
+		return 1;
+	if (snd_config_search(conf, "type", &n) < 0 ||
+	    snd_config_get_string(n, &str) < 0 || strcmp(str, "hw"))
+		return 1;
+	snd_config_for_each(i, next, conf) {
+		const char *id;
+		int k;
+		n = snd_config_iterator_entry(i);
+		if (snd_config_get_id(n, &id) < 0)
+			return 1;
+		if (strncmp(id, "@args", 5) == 0)
+			continue;
+		for (k = 0; hw_fields[k]; k++)
+			if (strcmp(id, hw_fields[k]) == 0)
+				break;
+		if (hw_fields[k] == NULL)
+			return 1;
+	}
+
+	card = snd_card_get_index(card_id);
+	if (card < 0) {
+		SNDERR("Cannot get card index for %s", card_id);
+		return card;
+	}
+	err = snd_config_make_compound(&conf, NULL, 0);
+	if (err < 0)
+		return err;
+	err = snd_config_imake_string(&n, "type", "hw");
+	if (err >= 0)
+		err = snd_config_add(conf, n);
+	if (err >= 0)
+		err = snd_config_imake_integer(&n, "card", card);
+	if (err >= 0)
+		err = snd_config_add(conf, n);
+	if (err >= 0)
+		err = snd_config_imake_integer(&n, "device", device);
+	if (err >= 0)
+		err = snd_config_add(conf, n);
+	if (err >= 0)
+		err = snd_config_imake_integer(&n, "subdevice", subdevice);
+	if (err >= 0)
+		err = snd_config_add(conf, n);
+	if (err >= 0)
+		err = snd_pcm_open_conf(pcmp, name, root, conf, stream, mode);
+	snd_config_delete(conf);
+	return err;
+}
+
 /**
  * \brief Opens a PCM
  * \param pcmp Returned PCM handle
@@ -2686,21 +3386,32 @@ static int snd_pcm_open_noupdate(snd_pcm_t **pcmp, snd_config_t *root,
 int snd_pcm_open(snd_pcm_t **pcmp, const char *name, 
 		 snd_pcm_stream_t stream, int mode)
 {
+	unsigned long long trace = snd_trace_begin();
+	const char *open_name = name;
 	snd_config_t *top;
 	int err;
 
 	assert(pcmp && name);
 	if (_snd_is_ucm_device(name)) {
 		name = uc_mgr_alibcfg_by_device(&top, name);
-		if (name == NULL)
-			return -ENODEV;
+		if (name == NULL) {
+			err = -ENODEV;
+			goto __trace;
+		}
 	} else {
 		err = snd_config_update_ref(&top);
 		if (err < 0)
-			return err;
+			goto __trace;
+		err = snd_pcm_open_hw_fast(pcmp, top, name, stream, mode);
+		if (err <= 0) {
+			snd_config_unref(top);
+			goto __trace;
+		}
 	}
 	err = snd_pcm_open_noupdate(pcmp, top, name, stream, mode, 0);
 	snd_config_unref(top);
+ __trace:
+	snd_trace_end(trace, "pcm", "snd_pcm_open", open_name);
 	return err;
 }
 
@@ -2751,6 +3462,8 @@ int snd_pcm_new(snd_pcm_t **pcmp, snd_pcm_type_t type, const char *name,
 {
 	snd_pcm_t *pcm;
 #ifdef THREAD_SAFE_API
+	static int do_lock_enable = -1; /* uninitialized */
+	static int do_lock_pi;
 	pthread_mutexattr_t attr;
 #endif
 
@@ -2764,13 +3477,27 @@ int snd_pcm_new(snd_pcm_t **pcmp, snd_pcm_type_t type, const char *name,
 	pcm->mode = mode;
 	pcm->poll_fd_count = 1;
 	pcm->poll_fd = -1;
+	pcm->mem.node = -1;
 	pcm->op_arg = pcm;
 	pcm->fast_op_arg = pcm;
 	INIT_LIST_HEAD(&pcm->async_handlers);
 #ifdef THREAD_SAFE_API
+	/* set lock_enabled field depending on $LIBASOUND_THREAD_SAFE;
+	 * evaluate env var only once at the first open for consistency
+	 */
+	if (do_lock_enable == -1) {
+		char *p = getenv("LIBASOUND_THREAD_SAFE");
+		do_lock_enable = !p || *p != '0';
+		do_lock_pi = p && strcmp(p, "pi") == 0;
+	}
 	pthread_mutexattr_init(&attr);
 #ifdef HAVE_PTHREAD_MUTEX_RECURSIVE
 	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+#endif
+#if defined(_POSIX_THREAD_PRIO_INHERIT) && _POSIX_THREAD_PRIO_INHERIT > 0
+	/* a low priority thread holding the lock gets boosted by the waiter */
+	if (do_lock_pi)
+		pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
 #endif
 	pthread_mutex_init(&pcm->lock, &attr);
 	pthread_mutexattr_destroy(&attr);
@@ -2782,14 +3509,6 @@ int snd_pcm_new(snd_pcm_t **pcmp, snd_pcm_type_t type, const char *name,
 		/* async handler may lead to a deadlock; suppose no MT */
 		pcm->lock_enabled = 0;
 	} else {
-		/* set lock_enabled field depending on $LIBASOUND_THREAD_SAFE */
-		static int do_lock_enable = -1; /* uninitialized */
-
-		/* evaluate env var only once at the first open for consistency */
-		if (do_lock_enable == -1) {
-			char *p = getenv("LIBASOUND_THREAD_SAFE");
-			do_lock_enable = !p || *p != '0';
-		}
 		pcm->lock_enabled = do_lock_enable;
 	}
 #endif
@@ -2801,8 +3520,12 @@ int snd_pcm_free(snd_pcm_t *pcm)
 {
 	assert(pcm);
 	free(pcm->name);
+	free(pcm->wait_pfds);
 	free(pcm->hw.link_dst);
 	free(pcm->appl.link_dst);
+	/* the lock of fast_op_arg may be gone already */
+	if (pcm->tstamp_ring)
+		tstamp_ring_free(pcm->tstamp_ring);
 	snd_dlobj_cache_put(pcm->open_func);
 #ifdef THREAD_SAFE_API
 	pthread_mutex_destroy(&pcm->lock);
@@ -2819,7 +3542,7 @@ int snd_pcm_open_named_slave(snd_pcm_t **pcmp, const char *name,
 	const char *str;
 	int hop;
 
-	if ((hop = snd_config_check_hop(parent_conf)) < 0)
+	if ((hop = snd_config_open_hop()) < 0)
 		return hop;
 	if (snd_config_get_string(conf, &str) >= 0)
 		return snd_pcm_open_noupdate(pcmp, root, str, stream, mode,
@@ -2867,33 +3590,110 @@ int __snd_pcm_wait_in_lock(snd_pcm_t *pcm, int timeout)
 	return snd_pcm_wait_nocheck(pcm, timeout);
 }
 
-/* 
- * like snd_pcm_wait() but doesn't check mmap_avail before calling poll()
- *
- * used in drain code in some plugins
+/*
+ * return the descriptors to wait on, cached in pcm->wait_pfds
  *
- * This function is called inside pcm lock.
+ * The plugin chain is asked only on the first wait after prepare, hw_params,
+ * hw_free or sw_params; the descriptors do not change in between.  Plugins
+ * which report a bad state from their poll_descriptors callback (the direct
+ * plugins do so for xrun) are covered by checking the state when the cached
+ * set is used.
  */
-int snd_pcm_wait_nocheck(snd_pcm_t *pcm, int timeout)
+static int snd_pcm_wait_descriptors(snd_pcm_t *pcm)
 {
-	struct pollfd *pfd;
-	unsigned short revents = 0;
-	int npfds, err, err_poll;
-	
+	int npfds, err;
+
+	if (pcm->wait_npfds > 0) {
+		err = pcm_state_to_error(__snd_pcm_state(pcm));
+		return err < 0 ? err : pcm->wait_npfds;
+	}
 	npfds = __snd_pcm_poll_descriptors_count(pcm);
 	if (npfds <= 0 || npfds >= 16) {
 		SNDERR("Invalid poll_fds %d\n", npfds);
 		return -EIO;
 	}
-	pfd = alloca(sizeof(*pfd) * npfds);
-	err = __snd_pcm_poll_descriptors(pcm, pfd, npfds);
+	if (!pcm->wait_pfds) {
+		pcm->wait_pfds = malloc(16 * sizeof(*pcm->wait_pfds));
+		if (!pcm->wait_pfds)
+			return -ENOMEM;
+	}
+	err = __snd_pcm_poll_descriptors(pcm, pcm->wait_pfds, npfds);
 	if (err < 0)
 		return err;
 	if (err != npfds) {
 		SNDMSG("invalid poll descriptors %d\n", err);
 		return -EIO;
 	}
+	pcm->wait_npfds = npfds;
+	return npfds;
+}
+
+/*
+ * adaptive avail_min: raise the threshold as far as the buffer allows,
+ * keeping one period and twice the observed lateness as the margin
+ */
+static void snd_pcm_avail_min_adapt(snd_pcm_t *pcm)
+{
+	snd_pcm_sw_params_t params;
+	snd_pcm_uframes_t limit, margin, target;
+
+	limit = pcm->buffer_size;
+	if (pcm->stop_threshold < limit)
+		limit = pcm->stop_threshold;
+	margin = pcm->period_size + 2 * pcm->wake_late;
+	target = limit > margin ? limit - margin : 0;
+	if (target < pcm->avail_min_floor)
+		target = pcm->avail_min_floor;
+	if (target == pcm->avail_min)
+		return;
+	/* raise in steps, changing the sw_params may cost a syscall */
+	if (target > pcm->avail_min &&
+	    target - pcm->avail_min < pcm->period_size / 4)
+		return;
+	memset(&params, 0, sizeof(params));
+	sw_params_current(pcm, &params);
+	params.avail_min = target;
+	if (pcm->ops->sw_params &&
+	    pcm->ops->sw_params(pcm->op_arg, &params) >= 0)
+		pcm->avail_min = target;
+}
+
+/* track how far past avail_min the wakeup came */
+static void snd_pcm_avail_min_observe(snd_pcm_t *pcm)
+{
+	snd_pcm_sframes_t avail = __snd_pcm_avail_update(pcm);
+	snd_pcm_uframes_t late;
+
+	if (avail < 0)
+		return;
+	late = (snd_pcm_uframes_t)avail > pcm->avail_min ?
+	       (snd_pcm_uframes_t)avail - pcm->avail_min : 0;
+	if (late > pcm->wake_late)
+		pcm->wake_late = late;
+	else
+		pcm->wake_late -= (pcm->wake_late + 15) / 16;
+}
+
+/* 
+ * like snd_pcm_wait() but doesn't check mmap_avail before calling poll()
+ *
+ * used in drain code in some plugins
+ *
+ * This function is called inside pcm lock.
+ */
+int snd_pcm_wait_nocheck(snd_pcm_t *pcm, int timeout)
+{
+	struct pollfd pfd[16];
+	unsigned short revents = 0;
+	int npfds, err, err_poll;
+
+	npfds = snd_pcm_wait_descriptors(pcm);
+	if (npfds < 0)
+		return npfds;
+	if (pcm->avail_min_adaptive)
+		snd_pcm_avail_min_adapt(pcm);
 	do {
+		memcpy(pfd, pcm->wait_pfds, sizeof(*pfd) * npfds);
 		__snd_pcm_unlock(pcm->fast_op_arg);
 		err_poll = poll(pfd, npfds, timeout);
 		__snd_pcm_lock(pcm->fast_op_arg);
@@ -2913,6 +3713,8 @@ int snd_pcm_wait_nocheck(snd_pcm_t *pcm, int timeout)
 			return err < 0 ? err : -EIO;
 		}
 	} while (!(revents & (POLLIN | POLLOUT)));
+	if (err_poll > 0 && pcm->avail_min_adaptive)
+		snd_pcm_avail_min_observe(pcm);
 #if 0 /* very useful code to test poll related problems */
 	{
 		snd_pcm_sframes_t avail_update;
@@ -3037,6 +3839,228 @@ int snd_pcm_avail_delay(snd_pcm_t *pcm,
 	return err;
 }
 
+/**
+ * \brief Combine snd_pcm_avail_delay() and snd_pcm_htimestamp() for several PCMs
+ * \param pcms PCM handles
+ * \param count Number of handles
+ * \param availp Returned available frames per handle, or its negative error code
+ * \param delayp Returned delays per handle
+ * \param tstamps Returned timestamps of the last pointer update (may be NULL)
+ * \return 0 on success otherwise the first negative error code
+ *
+ * The hardware pointers of all handles are synchronized first and the
+ * values are read afterwards, so the snapshot is as coherent as the
+ * per-stream kernel interface allows.  For hw streams with the mmapped
+ * status page the pointer is synchronized by the delay query itself and
+ * avail and timestamp are read without another system call, i.e. one
+ * ioctl per stream instead of the three needed by separate
+ * snd_pcm_avail(), snd_pcm_delay() and snd_pcm_status() calls.
+ *
+ * The function is thread-safe when built with the proper option.
+ */
+int snd_pcm_avail_delay_multi(snd_pcm_t **pcms, unsigned int count,
+			      snd_pcm_sframes_t *availp,
+			      snd_pcm_sframes_t *delayp,
+			      snd_htimestamp_t *tstamps)
+{
+	unsigned int i;
+	int err, res = 0;
+
+	assert(pcms && availp && delayp);
+	/* pass 1: bring all hw pointers up to date */
+	for (i = 0; i < count; i++) {
+		snd_pcm_t *pcm = pcms[i];
+
+		if (CHECK_SANITY(! pcm->setup)) {
+			SNDMSG("PCM not set up");
+			availp[i] = -EIO;
+			continue;
+		}
+		snd_pcm_lock(pcm->fast_op_arg);
+		err = snd_pcm_hw_delay_hwsync(pcm, &delayp[i]);
+		if (err == -ENOSYS) {
+			err = __snd_pcm_hwsync(pcm);
+			/* the delay is read in the second pass */
+			if (err >= 0)
+				err = 1;
+		}
+		snd_pcm_unlock(pcm->fast_op_arg);
+		availp[i] = err;
+	}
+	/* pass 2: read back */
+	for (i = 0; i < count; i++) {
+		snd_pcm_t *pcm = pcms[i];
+		snd_pcm_uframes_t avail;
+		snd_pcm_sframes_t sf = 0;
+
+		if (availp[i] < 0) {
+			if (!res)
+				res = availp[i];
+			continue;
+		}
+		snd_pcm_lock(pcm->fast_op_arg);
+		err = 0;
+		if (availp[i] > 0)
+			err = __snd_pcm_delay(pcm, &delayp[i]);
+		if (err >= 0 && tstamps && pcm->fast_ops->htimestamp) {
+			err = pcm->fast_ops->htimestamp(pcm->fast_op_arg, &avail,
+							&tstamps[i]);
+			sf = avail;
+		} else if (err >= 0) {
+			if (tstamps)
+				memset(&tstamps[i], 0, sizeof(tstamps[i]));
+			sf = __snd_pcm_avail_update(pcm);
+			if (sf < 0)
+				err = sf;
+		}
+		snd_pcm_unlock(pcm->fast_op_arg);
+		availp[i] = err < 0 ? err : sf;
+		if (err < 0 && !res)
+			res = err;
+	}
+	return res;
+}
+
+#ifndef DOC_HIDDEN
+/* the first sample of the area is aligned for a whole sample access */
+static int snd_pcm_area_aligned(const snd_pcm_channel_area_t *area,
+				unsigned int width)
+{
+	return area->addr && area->first % width == 0 &&
+	       area->step % width == 0 &&
+	       (width == 24 ||
+		((uintptr_t)area->addr + area->first / 8) % (width / 8) == 0);
+}
+
+/* leading areas forming one interleaved group, at most AREA_GROUP_MAX */
+static unsigned int snd_pcm_areas_interleaved(const snd_pcm_channel_area_t *areas,
+					      unsigned int channels,
+					      unsigned int width)
+{
+	unsigned int n;
+
+	if (!snd_pcm_area_aligned(areas, width) || areas->step < 2 * width)
+		return 0;
+	for (n = 1; n < channels && n < AREA_GROUP_MAX &&
+		    (n + 1) * width <= areas->step; n++) {
+		if (areas[n].addr != areas->addr ||
+		    areas[n].step != areas->step ||
+		    areas[n].first != areas[n - 1].first + width)
+			break;
+	}
+	return n;
+}
+
+/* leading areas which are contiguous arrays, at most max */
+static unsigned int snd_pcm_areas_planar(const snd_pcm_channel_area_t *areas,
+					 unsigned int channels,
+					 unsigned int width, unsigned int max)
+{
+	unsigned int n;
+
+	for (n = 0; n < channels && n < max; n++) {
+		if (areas[n].step != width ||
+		    !snd_pcm_area_aligned(&areas[n], width))
+			break;
+	}
+	return n;
+}
+
+static const snd_pcm_area_ops_t *snd_pcm_area_ops(unsigned int width)
+{
+	if (width == 16)
+		return area_ops_16;
+	if (width == 24)
+		return area_ops_24;
+	if (width == 32)
+		return area_ops_32;
+	return NULL;
+}
+
+/*
+ * Copies the leading channels in one pass when they form an interleaved
+ * group on at least one side; returns the number of channels copied or
+ * 0 when the per-channel copy has to be used.
+ */
+static unsigned int snd_pcm_areas_copy_group(const snd_pcm_channel_area_t *dst_areas,
+					     snd_pcm_uframes_t dst_offset,
+					     const snd_pcm_channel_area_t *src_areas,
+					     snd_pcm_uframes_t src_offset,
+					     unsigned int channels,
+					     snd_pcm_uframes_t frames,
+					     unsigned int width)
+{
+	const snd_pcm_area_ops_t *ops = snd_pcm_area_ops(width);
+	void *ptrs[AREA_GROUP_MAX];
+	unsigned int si, di, n, c;
+
+	if (!ops || channels < 2)
+		return 0;
+	si = snd_pcm_areas_interleaved(src_areas, channels, width);
+	di = snd_pcm_areas_interleaved(dst_areas, channels, width);
+	if (si >= 2 && di >= 2) {
+		n = si < di ? si : di;
+		if (dst_areas->addr == src_areas->addr)
+			return 0;
+		ops[n].repack(snd_pcm_channel_area_addr(dst_areas, dst_offset),
+			      dst_areas->step / width,
+			      snd_pcm_channel_area_addr(src_areas, src_offset),
+			      src_areas->step / width, frames);
+		return n;
+	}
+	if (si >= 2) {
+		n = snd_pcm_areas_planar(dst_areas, channels, width, si);
+		if (n < 2)
+			return 0;
+		for (c = 0; c < n; c++) {
+			if (dst_areas[c].addr == src_areas->addr)
+				return 0;
+			ptrs[c] = snd_pcm_channel_area_addr(&dst_areas[c], dst_offset);
+		}
+		ops[n].gather(ptrs, snd_pcm_channel_area_addr(src_areas, src_offset),
+			      src_areas->step / width, frames);
+		return n;
+	}
+	if (di >= 2) {
+		n = snd_pcm_areas_planar(src_areas, channels, width, di);
+		if (n < 2)
+			return 0;
+		for (c = 0; c < n; c++) {
+			if (src_areas[c].addr == dst_areas->addr)
+				return 0;
+			ptrs[c] = snd_pcm_channel_area_addr(&src_areas[c], src_offset);
+		}
+		ops[n].scatter(snd_pcm_channel_area_addr(dst_areas, dst_offset),
+			       (const void *const *)ptrs,
+			       dst_areas->step / width, frames);
+		return n;
+	}
+	return 0;
+}
+
+/* silences the leading interleaved group in one pass, see above */
+static unsigned int snd_pcm_areas_silence_group(const snd_pcm_channel_area_t *dst_areas,
+						snd_pcm_uframes_t dst_offset,
+						unsigned int channels,
+						snd_pcm_uframes_t frames,
+						snd_pcm_format_t format)
+{
+	unsigned int width = snd_pcm_format_physical_width(format);
+	const snd_pcm_area_ops_t *ops = snd_pcm_area_ops(width);
+	unsigned int n;
+
+	if (!ops || channels < 2)
+		return 0;
+	n = snd_pcm_areas_interleaved(dst_areas, channels, width);
+	if (n < 2)
+		return 0;
+	ops[n].fill(snd_pcm_channel_area_addr(dst_areas, dst_offset),
+		    dst_areas->step / width, snd_pcm_format_silence_64(format),
+		    frames);
+	return n;
+}
+#endif /* DOC_HIDDEN */
+
 /**
  * \brief Silence an area
  * \param dst_area area specification
@@ -3189,6 +4213,12 @@ int snd_pcm_areas_silence(const snd_pcm_channel_area_t *dst_areas, snd_pcm_ufram
 			d.step = width;
 			err = snd_pcm_area_silence(&d, dst_offset * chns, frames * chns, format);
 			channels -= chns;
+		} else if ((chns = snd_pcm_areas_silence_group(begin, dst_offset,
+							       channels, frames,
+							       format)) > 0) {
+			dst_areas = begin + chns;
+			channels -= chns;
+			err = 0;
 		} else {
 			err = snd_pcm_area_silence(begin, dst_offset, frames, format);
 			dst_areas = begin + 1;
@@ -3385,6 +4415,13 @@ int snd_pcm_areas_copy(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_
 						  frames * chns, format);
 			}
 			channels -= chns;
+		} else if ((chns = snd_pcm_areas_copy_group(dst_start, dst_offset,
+							    src_start, src_offset,
+							    channels, frames,
+							    width)) > 0) {
+			src_areas = src_start + chns;
+			dst_areas = dst_start + chns;
+			channels -= chns;
 		} else {
 			snd_pcm_area_copy(dst_start, dst_offset,
 					  src_start, src_offset,
@@ -6181,19 +7218,7 @@ int snd_pcm_sw_params_current(snd_pcm_t *pcm, snd_pcm_sw_params_t *params)
 		return -EIO;
 	}
 	__snd_pcm_lock(pcm); /* forced lock due to pcm field changes */
-	params->proto = SNDRV_PCM_VERSION;
-	params->tstamp_mode = pcm->tstamp_mode;
-	params->tstamp_type = pcm->tstamp_type;
-	params->period_step = pcm->period_step;
-	params->sleep_min = 0;
-	params->avail_min = pcm->avail_min;
-	sw_set_period_event(params, pcm->period_event);
-	params->xfer_align = 1;
-	params->start_threshold = pcm->start_threshold;
-	params->stop_threshold = pcm->stop_threshold;
-	params->silence_threshold = pcm->silence_threshold;
-	params->silence_size = pcm->silence_size;
-	params->boundary = pcm->boundary;
+	sw_params_current(pcm, params);
 	__snd_pcm_unlock(pcm);
 	return 0;
 }
@@ -6548,6 +7573,43 @@ int snd_pcm_sw_params_get_period_event(const snd_pcm_sw_params_t *params, int *v
 	return 0;
 }
 
+/**
+ * \brief Set adaptive avail_min mode inside a software configuration container
+ * \param pcm PCM handle
+ * \param params Software configuration container
+ * \param val 0 = fixed avail_min, 1 = adaptive avail_min
+ * \return 0 otherwise a negative error code
+ *
+ * In the adaptive mode the avail_min value becomes the lowest wakeup
+ * threshold.  While waiting (#snd_pcm_wait, blocking read and write) the
+ * library raises the threshold up to the buffer size less one period and
+ * twice the observed wakeup lateness, so the application is woken as
+ * rarely as the buffer allows.  The lateness is measured at every wakeup
+ * and decays slowly, a late wakeup lowers the threshold at once.
+ *
+ * The threshold is changed with the software parameters of the PCM, the
+ * direct plugins coalesce their timer wakeups accordingly.
+ */
+int snd_pcm_sw_params_set_avail_min_adaptive(snd_pcm_t *pcm, snd_pcm_sw_params_t *params, int val)
+{
+	assert(pcm && params);
+	sw_set_avail_min_adaptive(params, val ? 1 : 0);
+	return 0;
+}
+
+/**
+ * \brief Get adaptive avail_min mode from a software configuration container
+ * \param params Software configuration container
+ * \param val returned adaptive avail_min state
+ * \return 0 otherwise a negative error code
+ */
+int snd_pcm_sw_params_get_avail_min_adaptive(const snd_pcm_sw_params_t *params, int *val)
+{
+	assert(params && val);
+	*val = sw_get_avail_min_adaptive(params);
+	return 0;
+}
+
 /**
  * \brief (DEPRECATED) Set xfer align inside a software configuration container
  * \param pcm PCM handle
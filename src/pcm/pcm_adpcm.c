@@ -61,6 +61,7 @@ IMA compatibility project proceedings, Vol 2, Issue 2, May 1992.
 #include "pcm_plugin.h"
 
 #include "plugin_ops.h"
+#include "plugin_block_ops.h"
 
 #ifndef PIC
 /* entry for static linking */
@@ -211,6 +212,329 @@ static int adpcm_decoder(unsigned char code, snd_pcm_adpcm_state_t * state)
 	return (state->pred_val);
 }
 
+/*
+ * Lockstep coders: one frame of a run of channels at a time.  The channel
+ * states are independent, so the loop over the channels carries no
+ * dependency and the channels go through the SIMD lanes (four at a time
+ * with SSE2, the scalar loop again for the rest) with the branches of the
+ * serial coders turned into masks.  The short arithmetic of the serial
+ * coders above (diff and pred_diff wrap around) is reproduced, so codes
+ * and samples are bit-identical.  The states are kept as separate
+ * pred_val and step_idx arrays during a run.
+ */
+
+/* channels per lockstep run */
+#define ADPCM_LANES_MAX	64
+
+/* lanes of a run for the vector coders, none at the generic CPU level */
+static inline unsigned int adpcm_vec_lanes(unsigned int lanes)
+{
+#ifdef __SSE2__
+	if (snd_cpu_has(SND_CPU_SSE2))
+		return lanes;
+#endif
+	return 0;
+}
+
+static inline int adpcm_clamp(int val, int min, int max)
+{
+	val = val < min ? min : val;
+	return val > max ? max : val;
+}
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+
+static inline __m128i adpcm_sext16(__m128i v)
+{
+	return _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+}
+
+static inline __m128i adpcm_vclamp(__m128i v, int min, int max)
+{
+	__m128i vmin = _mm_set1_epi32(min), vmax = _mm_set1_epi32(max);
+	__m128i m = _mm_cmplt_epi32(v, vmin);
+	v = _mm_or_si128(_mm_andnot_si128(m, v), _mm_and_si128(m, vmin));
+	m = _mm_cmpgt_epi32(v, vmax);
+	return _mm_or_si128(_mm_andnot_si128(m, v), _mm_and_si128(m, vmax));
+}
+
+static inline __m128i adpcm_vstep(const int *idx)
+{
+	return _mm_setr_epi32(StepSize[idx[0]], StepSize[idx[1]],
+			      StepSize[idx[2]], StepSize[idx[3]]);
+}
+
+/* IndexAdjust[code & 7] */
+static inline __m128i adpcm_vadjust(__m128i code)
+{
+	__m128i m = _mm_cmpgt_epi32(code, _mm_set1_epi32(3));
+	__m128i up = _mm_sub_epi32(_mm_add_epi32(code, code), _mm_set1_epi32(6));
+	return _mm_or_si128(_mm_and_si128(m, up),
+			    _mm_andnot_si128(m, _mm_set1_epi32(-1)));
+}
+
+static inline void adpcm_encode_sse2(unsigned char *codes, const int16_t *src,
+				     int *pred, int *idx)
+{
+	__m128i s = _mm_loadl_epi64((const __m128i *)src);
+	__m128i p = _mm_loadu_si128((const __m128i *)pred);
+	__m128i step = adpcm_vstep(idx);
+	__m128i diff, neg, pred_diff, lt, code;
+	int k;
+
+	s = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+	diff = adpcm_sext16(_mm_sub_epi32(s, p));
+	neg = _mm_cmplt_epi32(diff, _mm_setzero_si128());
+	diff = adpcm_sext16(_mm_sub_epi32(_mm_xor_si128(diff, neg), neg));
+	pred_diff = _mm_srai_epi32(step, 3);
+	code = _mm_and_si128(neg, _mm_set1_epi32(0x8));
+	for (k = 2; k >= 0; k--) {
+		__m128i take;
+		lt = _mm_cmplt_epi32(diff, step);
+		take = _mm_andnot_si128(lt, step);
+		diff = _mm_sub_epi32(diff, take);
+		pred_diff = _mm_add_epi32(pred_diff, take);
+		code = _mm_or_si128(code, _mm_andnot_si128(lt, _mm_set1_epi32(1 << k)));
+		step = _mm_srai_epi32(step, 1);
+	}
+	pred_diff = adpcm_sext16(pred_diff);
+	pred_diff = _mm_sub_epi32(_mm_xor_si128(pred_diff, neg), neg);
+	p = adpcm_vclamp(_mm_add_epi32(p, pred_diff), -32768, 32767);
+	_mm_storeu_si128((__m128i *)pred, p);
+	step = _mm_loadu_si128((const __m128i *)idx);
+	step = _mm_add_epi32(step, adpcm_vadjust(_mm_and_si128(code, _mm_set1_epi32(7))));
+	_mm_storeu_si128((__m128i *)idx, adpcm_vclamp(step, 0, 88));
+	code = _mm_packs_epi32(code, code);
+	*(uint32_t *)codes = _mm_cvtsi128_si32(_mm_packus_epi16(code, code));
+}
+
+static inline void adpcm_decode_sse2(int16_t *dst, const unsigned char *codes,
+				     int *pred, int *idx)
+{
+	__m128i code = _mm_cvtsi32_si128(*(const uint32_t *)codes);
+	__m128i p = _mm_loadu_si128((const __m128i *)pred);
+	__m128i step = adpcm_vstep(idx);
+	__m128i zero = _mm_setzero_si128();
+	__m128i pred_diff, neg, mag;
+	int k;
+
+	code = _mm_unpacklo_epi16(_mm_unpacklo_epi8(code, zero), zero);
+	mag = _mm_and_si128(code, _mm_set1_epi32(7));
+	neg = _mm_cmpgt_epi32(_mm_and_si128(code, _mm_set1_epi32(0x8)), zero);
+	pred_diff = _mm_srai_epi32(step, 3);
+	for (k = 2; k >= 0; k--) {
+		__m128i bit = _mm_set1_epi32(1 << k);
+		__m128i m = _mm_cmpeq_epi32(_mm_and_si128(mag, bit), bit);
+		pred_diff = _mm_add_epi32(pred_diff, _mm_and_si128(m, step));
+		step = _mm_srai_epi32(step, 1);
+	}
+	pred_diff = adpcm_sext16(pred_diff);
+	pred_diff = _mm_sub_epi32(_mm_xor_si128(pred_diff, neg), neg);
+	p = adpcm_vclamp(_mm_add_epi32(p, pred_diff), -32768, 32767);
+	_mm_storeu_si128((__m128i *)pred, p);
+	step = _mm_loadu_si128((const __m128i *)idx);
+	step = _mm_add_epi32(step, adpcm_vadjust(mag));
+	_mm_storeu_si128((__m128i *)idx, adpcm_vclamp(step, 0, 88));
+	_mm_storel_epi64((__m128i *)dst, _mm_packs_epi32(p, p));
+}
+#endif
+
+static void adpcm_encode_lanes(unsigned char *codes, const int16_t *src,
+			       int *pred, int *idx, unsigned int lanes,
+			       unsigned int vec_lanes)
+{
+	unsigned int c = 0;
+
+#ifdef __SSE2__
+	for (; c + 4 <= vec_lanes; c += 4)
+		adpcm_encode_sse2(codes + c, src + c, pred + c, idx + c);
+#else
+	(void)vec_lanes;
+#endif
+	for (; c < lanes; c++) {
+		int step = StepSize[idx[c]];
+		int diff = (int16_t)(src[c] - pred[c]);
+		int sign = diff < 0 ? 0x8 : 0;
+		int pred_diff = step >> 3;
+		int code = 0, bit;
+
+		diff = (int16_t)(sign ? -diff : diff);
+		for (bit = 0x4; bit; bit >>= 1, step >>= 1) {
+			int take = diff >= step ? step : 0;
+			diff -= take;
+			pred_diff += take;
+			code |= take ? bit : 0;
+		}
+		pred_diff = (int16_t)pred_diff;
+		pred[c] = adpcm_clamp(pred[c] + (sign ? -pred_diff : pred_diff),
+				      -32768, 32767);
+		idx[c] = adpcm_clamp(idx[c] + IndexAdjust[code], 0, 88);
+		codes[c] = sign | code;
+	}
+}
+
+static void adpcm_decode_lanes(int16_t *dst, const unsigned char *codes,
+			       int *pred, int *idx, unsigned int lanes,
+			       unsigned int vec_lanes)
+{
+	unsigned int c = 0;
+
+#ifdef __SSE2__
+	for (; c + 4 <= vec_lanes; c += 4)
+		adpcm_decode_sse2(dst + c, codes + c, pred + c, idx + c);
+#else
+	(void)vec_lanes;
+#endif
+	for (; c < lanes; c++) {
+		int step = StepSize[idx[c]];
+		int code = codes[c] & 0x7;
+		int pred_diff = step >> 3;
+
+		pred_diff += (code & 0x4) ? step : 0;
+		pred_diff += (code & 0x2) ? step >> 1 : 0;
+		pred_diff += (code & 0x1) ? step >> 2 : 0;
+		pred_diff = (int16_t)pred_diff;
+		pred[c] = adpcm_clamp(pred[c] + ((codes[c] & 0x8) ? -pred_diff : pred_diff),
+				      -32768, 32767);
+		idx[c] = adpcm_clamp(idx[c] + IndexAdjust[code], 0, 88);
+		dst[c] = pred[c];
+	}
+}
+
+/*
+ * returns the nibble index of the first sample relative to the area
+ * address for an interleaved ADPCM buffer, or -1 for other layouts
+ */
+static long adpcm_interleaved_nibble(const snd_pcm_channel_area_t *areas,
+				     snd_pcm_uframes_t offset,
+				     unsigned int channels)
+{
+	if (!snd_pcm_block_areas_addr(areas, 0, channels, 4))
+		return -1;
+	return (areas[0].first + areas[0].step * offset) / 4;
+}
+
+static int adpcm_s16_index(unsigned int getputidx, int put)
+{
+	if (put)
+		return getputidx == (unsigned int)snd_pcm_linear_put_index(SND_PCM_FORMAT_S16,
+									  SND_PCM_FORMAT_S16);
+	return getputidx == (unsigned int)snd_pcm_linear_get_index(SND_PCM_FORMAT_S16,
+								  SND_PCM_FORMAT_S16);
+}
+
+static void adpcm_states_get(int *pred, int *idx,
+			     const snd_pcm_adpcm_state_t *states, unsigned int lanes)
+{
+	unsigned int c;
+
+	for (c = 0; c < lanes; c++) {
+		pred[c] = states[c].pred_val;
+		idx[c] = states[c].step_idx;
+	}
+}
+
+static void adpcm_states_put(snd_pcm_adpcm_state_t *states,
+			     const int *pred, const int *idx, unsigned int lanes)
+{
+	unsigned int c;
+
+	for (c = 0; c < lanes; c++) {
+		states[c].pred_val = pred[c];
+		states[c].step_idx = idx[c];
+	}
+}
+
+/* interleaved ADPCM to interleaved native S16; returns 0 for other layouts */
+static int adpcm_decode_interleaved(const snd_pcm_channel_area_t *dst_areas,
+				    snd_pcm_uframes_t dst_offset,
+				    const snd_pcm_channel_area_t *src_areas,
+				    snd_pcm_uframes_t src_offset,
+				    unsigned int channels, snd_pcm_uframes_t frames,
+				    unsigned int putidx,
+				    snd_pcm_adpcm_state_t *states)
+{
+	unsigned char codes[ADPCM_LANES_MAX];
+	int pred[ADPCM_LANES_MAX], idx[ADPCM_LANES_MAX];
+	const unsigned char *src;
+	int16_t *dst;
+	unsigned int c0, lanes, vec_lanes, c;
+	snd_pcm_uframes_t f;
+	long nibble;
+
+	if (!adpcm_s16_index(putidx, 1))
+		return 0;
+	dst = (int16_t *)snd_pcm_block_areas_addr(dst_areas, dst_offset, channels, 16);
+	nibble = adpcm_interleaved_nibble(src_areas, src_offset, channels);
+	if (!dst || nibble < 0)
+		return 0;
+	src = src_areas[0].addr;
+	for (c0 = 0; c0 < channels; c0 += lanes) {
+		lanes = channels - c0;
+		if (lanes > ADPCM_LANES_MAX)
+			lanes = ADPCM_LANES_MAX;
+		vec_lanes = adpcm_vec_lanes(lanes);
+		adpcm_states_get(pred, idx, states + c0, lanes);
+		for (f = 0; f < frames; f++) {
+			long n = nibble + f * channels + c0;
+			for (c = 0; c < lanes; c++, n++)
+				codes[c] = (n & 1) ? src[n >> 1] & 0x0f : src[n >> 1] >> 4;
+			adpcm_decode_lanes(dst + f * channels + c0, codes,
+					   pred, idx, lanes, vec_lanes);
+		}
+		adpcm_states_put(states + c0, pred, idx, lanes);
+	}
+	return 1;
+}
+
+/* interleaved native S16 to interleaved ADPCM; returns 0 for other layouts */
+static int adpcm_encode_interleaved(const snd_pcm_channel_area_t *dst_areas,
+				    snd_pcm_uframes_t dst_offset,
+				    const snd_pcm_channel_area_t *src_areas,
+				    snd_pcm_uframes_t src_offset,
+				    unsigned int channels, snd_pcm_uframes_t frames,
+				    unsigned int getidx,
+				    snd_pcm_adpcm_state_t *states)
+{
+	unsigned char codes[ADPCM_LANES_MAX];
+	int pred[ADPCM_LANES_MAX], idx[ADPCM_LANES_MAX];
+	const int16_t *src;
+	unsigned char *dst;
+	unsigned int c0, lanes, vec_lanes, c;
+	snd_pcm_uframes_t f;
+	long nibble;
+
+	if (!adpcm_s16_index(getidx, 0))
+		return 0;
+	src = (const int16_t *)snd_pcm_block_areas_addr(src_areas, src_offset, channels, 16);
+	nibble = adpcm_interleaved_nibble(dst_areas, dst_offset, channels);
+	if (!src || nibble < 0)
+		return 0;
+	dst = dst_areas[0].addr;
+	for (c0 = 0; c0 < channels; c0 += lanes) {
+		lanes = channels - c0;
+		if (lanes > ADPCM_LANES_MAX)
+			lanes = ADPCM_LANES_MAX;
+		vec_lanes = adpcm_vec_lanes(lanes);
+		adpcm_states_get(pred, idx, states + c0, lanes);
+		for (f = 0; f < frames; f++) {
+			long n = nibble + f * channels + c0;
+			adpcm_encode_lanes(codes, src + f * channels + c0,
+					   pred, idx, lanes, vec_lanes);
+			for (c = 0; c < lanes; c++, n++) {
+				unsigned char *d = dst + (n >> 1);
+				if (n & 1)
+					*d = (*d & 0xf0) | codes[c];
+				else
+					*d = (*d & 0x0f) | (codes[c] << 4);
+			}
+		}
+		adpcm_states_put(states + c0, pred, idx, lanes);
+	}
+	return 1;
+}
+
 #ifndef DOC_HIDDEN
 
 void snd_pcm_adpcm_decode(const snd_pcm_channel_area_t *dst_areas,
@@ -226,6 +550,10 @@ void snd_pcm_adpcm_decode(const snd_pcm_channel_area_t *dst_areas,
 #undef PUT16_LABELS
 	void *put = put16_labels[putidx];
 	unsigned int channel;
+
+	if (adpcm_decode_interleaved(dst_areas, dst_offset, src_areas, src_offset,
+				     channels, frames, putidx, states))
+		return;
 	for (channel = 0; channel < channels; ++channel, ++states) {
 		const char *src;
 		int srcbit;
@@ -280,6 +608,10 @@ void snd_pcm_adpcm_encode(const snd_pcm_channel_area_t *dst_areas,
 	void *get = get16_labels[getidx];
 	unsigned int channel;
 	int16_t sample = 0;
+
+	if (adpcm_encode_interleaved(dst_areas, dst_offset, src_areas, src_offset,
+				     channels, frames, getidx, states))
+		return;
 	for (channel = 0; channel < channels; ++channel, ++states) {
 		const char *src;
 		char *dst;
@@ -514,6 +846,7 @@ static void snd_pcm_adpcm_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
 	}
+	snd_pcm_plugin_dump_profile(pcm, out);
 	snd_output_printf(out, "Slave: ");
 	snd_pcm_dump(adpcm->plug.gen.slave, out);
 }
@@ -31,6 +31,7 @@
 #include "pcm_plugin.h"
 
 #include "plugin_ops.h"
+#include "plugin_block_ops.h"
 
 #ifndef PIC
 /* entry for static linking */
@@ -139,6 +140,53 @@ static int alaw_to_s16(unsigned char a_val)
 	return ((a_val & 0x80) ? t : -t);
 }
 
+/*
+ * Lookup tables built from the functions above: the decoder maps all 256
+ * codes, the encoder is indexed by the sample magnitude without the four
+ * low bits (which A-law always drops), the sign only selects the XOR
+ * mask.  The last entry covers the magnitude of -32768.
+ */
+static int16_t alaw_decode_table[256];
+static unsigned char alaw_encode_table[0x8000 / 16 + 1];
+
+static void alaw_init_tables(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < 256; i++)
+		alaw_decode_table[i] = alaw_to_s16(i);
+	for (i = 0; i < 0x8000 / 16; i++)
+		alaw_encode_table[i] = s16_to_alaw(i << 4) ^ 0xd5;
+	alaw_encode_table[i] = alaw_encode_table[i - 1];
+}
+
+#ifdef THREAD_SAFE_API
+static pthread_once_t alaw_tables_once = PTHREAD_ONCE_INIT;
+
+static inline void alaw_tables(void)
+{
+	pthread_once(&alaw_tables_once, alaw_init_tables);
+}
+#else
+static int alaw_tables_ready;
+
+static inline void alaw_tables(void)
+{
+	if (!alaw_tables_ready) {
+		alaw_init_tables();
+		alaw_tables_ready = 1;
+	}
+}
+#endif
+
+static inline unsigned char alaw_encode_sample(int16_t sample)
+{
+	int sign = sample >> 15;
+	unsigned int mag = (sample ^ sign) - sign;
+
+	return alaw_encode_table[mag >> 4] ^ (0xd5 ^ (sign & 0x80));
+}
+
 #ifndef DOC_HIDDEN
 
 void snd_pcm_alaw_decode(const snd_pcm_channel_area_t *dst_areas,
@@ -153,6 +201,24 @@ void snd_pcm_alaw_decode(const snd_pcm_channel_area_t *dst_areas,
 #undef PUT16_LABELS
 	void *put = put16_labels[putidx];
 	unsigned int channel;
+
+	alaw_tables();
+	/* interleaved to native S16: one run over frames * channels samples */
+	if (putidx == (unsigned int)snd_pcm_linear_put_index(SND_PCM_FORMAT_S16,
+							     SND_PCM_FORMAT_S16)) {
+		const unsigned char *src;
+		int16_t *dst;
+		src = (const unsigned char *)snd_pcm_block_areas_addr(src_areas, src_offset,
+								       channels, 8);
+		dst = (int16_t *)snd_pcm_block_areas_addr(dst_areas, dst_offset,
+							  channels, 16);
+		if (src && dst) {
+			size_t i, samples = (size_t)frames * channels;
+			for (i = 0; i < samples; i++)
+				dst[i] = alaw_decode_table[src[i]];
+			return;
+		}
+	}
 	for (channel = 0; channel < channels; ++channel) {
 		const unsigned char *src;
 		char *dst;
@@ -166,7 +232,7 @@ void snd_pcm_alaw_decode(const snd_pcm_channel_area_t *dst_areas,
 		dst_step = snd_pcm_channel_area_step(dst_area);
 		frames1 = frames;
 		while (frames1-- > 0) {
-			int16_t sample = alaw_to_s16(*src);
+			int16_t sample = alaw_decode_table[*src];
 			goto *put;
 #define PUT16_END after
 #include "plugin_ops.h"
@@ -191,6 +257,24 @@ void snd_pcm_alaw_encode(const snd_pcm_channel_area_t *dst_areas,
 	void *get = get16_labels[getidx];
 	unsigned int channel;
 	int16_t sample = 0;
+
+	alaw_tables();
+	/* native S16 interleaved: one run over frames * channels samples */
+	if (getidx == (unsigned int)snd_pcm_linear_get_index(SND_PCM_FORMAT_S16,
+							     SND_PCM_FORMAT_S16)) {
+		const int16_t *src;
+		unsigned char *dst;
+		src = (const int16_t *)snd_pcm_block_areas_addr(src_areas, src_offset,
+								channels, 16);
+		dst = (unsigned char *)snd_pcm_block_areas_addr(dst_areas, dst_offset,
+								 channels, 8);
+		if (src && dst) {
+			size_t i, samples = (size_t)frames * channels;
+			for (i = 0; i < samples; i++)
+				dst[i] = alaw_encode_sample(src[i]);
+			return;
+		}
+	}
 	for (channel = 0; channel < channels; ++channel) {
 		const char *src;
 		char *dst;
@@ -209,7 +293,7 @@ void snd_pcm_alaw_encode(const snd_pcm_channel_area_t *dst_areas,
 #include "plugin_ops.h"
 #undef GET16_END
 		after:
-			*dst = s16_to_alaw(sample);
+			*dst = alaw_encode_sample(sample);
 			src += src_step;
 			dst += dst_step;
 		}
@@ -387,6 +471,7 @@ static void snd_pcm_alaw_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
 	}
+	snd_pcm_plugin_dump_profile(pcm, out);
 	snd_output_printf(out, "Slave: ");
 	snd_pcm_dump(alaw->plug.gen.slave, out);
 }
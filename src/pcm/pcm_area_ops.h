@@ -0,0 +1,449 @@
+/*
+ *  PCM channel area copy and silence kernels
+ *
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * snd_pcm_area_copy() and snd_pcm_area_silence() walk one channel at a
+ * time, so converting between interleaved and non-interleaved buffers or
+ * touching a few channels of a wide interleaved buffer passes over the
+ * whole interleaved buffer once per channel.  The kernels below handle a
+ * group of up to AREA_GROUP_MAX channels in a single pass:
+ *  - gather:  interleaved group -> one contiguous array per channel,
+ *  - scatter: one contiguous array per channel -> interleaved group,
+ *  - repack:  interleaved group -> interleaved group of another stride,
+ *  - fill:    silence an interleaved group.
+ * Groups are transposed in registers with SSE2 (x86-64) or NEON as
+ * groups of N = 2, 4 or 8 channels: one vector of samples per channel is
+ * unzipped (gather) or zipped (scatter) in log2(N) rounds.  Fully
+ * interleaved groups of any size but 3 x 16 bit qualify, and so do the
+ * 8 x 16 bit and 4 or 8 x 32 bit groups of wider frames (16 or 32 channel
+ * buffers are handled as groups of 8).  Everything else, and the packed
+ * 24 bit samples, use straight scalar loops with the channel count known
+ * at compile time.
+ */
+
+#ifndef __PCM_AREA_OPS_H
+#define __PCM_AREA_OPS_H
+
+#define AREA_GROUP_MAX	8
+
+#if defined(__SSE2__)
+#define AREA_SIMD
+#define AREA_SIMD_CPU	SND_CPU_SSE2
+#include <emmintrin.h>
+
+typedef __m128i area_vec_t;
+
+#define area_vload(p)		_mm_loadu_si128((const __m128i *)(p))
+#define area_vstore(p, v)	_mm_storeu_si128((__m128i *)(p), (v))
+
+/* even and odd samples of a followed by those of b */
+static inline void area_uzp_16(area_vec_t a, area_vec_t b,
+			       area_vec_t *even, area_vec_t *odd)
+{
+	*even = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16),
+				_mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+	*odd = _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+}
+
+static inline void area_uzp_32(area_vec_t a, area_vec_t b,
+			       area_vec_t *even, area_vec_t *odd)
+{
+	__m128 fa = _mm_castsi128_ps(a), fb = _mm_castsi128_ps(b);
+	*even = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(2, 0, 2, 0)));
+	*odd = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(3, 1, 3, 1)));
+}
+
+/* inverse of area_uzp_*() */
+static inline void area_zip_16(area_vec_t even, area_vec_t odd,
+			       area_vec_t *a, area_vec_t *b)
+{
+	*a = _mm_unpacklo_epi16(even, odd);
+	*b = _mm_unpackhi_epi16(even, odd);
+}
+
+static inline void area_zip_32(area_vec_t even, area_vec_t odd,
+			       area_vec_t *a, area_vec_t *b)
+{
+	*a = _mm_unpacklo_epi32(even, odd);
+	*b = _mm_unpackhi_epi32(even, odd);
+}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define AREA_SIMD
+#define AREA_SIMD_CPU	SND_CPU_NEON
+#include <arm_neon.h>
+
+typedef uint32x4_t area_vec_t;
+
+#define area_vload(p)		vld1q_u32((const uint32_t *)(p))
+#define area_vstore(p, v)	vst1q_u32((uint32_t *)(p), (v))
+
+static inline void area_uzp_16(area_vec_t a, area_vec_t b,
+			       area_vec_t *even, area_vec_t *odd)
+{
+	uint16x8x2_t r = vuzpq_u16(vreinterpretq_u16_u32(a),
+				   vreinterpretq_u16_u32(b));
+	*even = vreinterpretq_u32_u16(r.val[0]);
+	*odd = vreinterpretq_u32_u16(r.val[1]);
+}
+
+static inline void area_uzp_32(area_vec_t a, area_vec_t b,
+			       area_vec_t *even, area_vec_t *odd)
+{
+	uint32x4x2_t r = vuzpq_u32(a, b);
+	*even = r.val[0];
+	*odd = r.val[1];
+}
+
+static inline void area_zip_16(area_vec_t even, area_vec_t odd,
+			       area_vec_t *a, area_vec_t *b)
+{
+	uint16x8x2_t r = vzipq_u16(vreinterpretq_u16_u32(even),
+				   vreinterpretq_u16_u32(odd));
+	*a = vreinterpretq_u32_u16(r.val[0]);
+	*b = vreinterpretq_u32_u16(r.val[1]);
+}
+
+static inline void area_zip_32(area_vec_t even, area_vec_t odd,
+			       area_vec_t *a, area_vec_t *b)
+{
+	uint32x4x2_t r = vzipq_u32(even, odd);
+	*a = r.val[0];
+	*b = r.val[1];
+}
+#endif
+
+/* straight line code for every channel of a group */
+#define AREA_REP2(M)	M(0) M(1)
+#define AREA_REP3(M)	AREA_REP2(M) M(2)
+#define AREA_REP4(M)	AREA_REP3(M) M(3)
+#define AREA_REP5(M)	AREA_REP4(M) M(4)
+#define AREA_REP6(M)	AREA_REP5(M) M(5)
+#define AREA_REP7(M)	AREA_REP6(M) M(6)
+#define AREA_REP8(M)	AREA_REP7(M) M(7)
+
+#ifdef AREA_SIMD
+/*
+ * v[] holds n vectors of interleaved frames; after the rounds v[c] holds
+ * the samples of channel c.  Every round unzips the pairs v[2j], v[2j+1]
+ * into t[j] and t[j + n/2]; the zip rounds do the inverse.
+ */
+#define AREA_COPY_T(c)		v[c] = t[c];
+#define AREA_SIMD_ROUNDS(bits) \
+static inline void area_uzp2_##bits(area_vec_t *v) \
+{ \
+	area_uzp_##bits(v[0], v[1], &v[0], &v[1]); \
+} \
+static inline void area_uzp4_##bits(area_vec_t *v) \
+{ \
+	area_vec_t t[4]; \
+	area_uzp_##bits(v[0], v[1], &t[0], &t[2]); \
+	area_uzp_##bits(v[2], v[3], &t[1], &t[3]); \
+	area_uzp_##bits(t[0], t[1], &v[0], &v[2]); \
+	area_uzp_##bits(t[2], t[3], &v[1], &v[3]); \
+} \
+static inline void area_uzp8_##bits(area_vec_t *v) \
+{ \
+	area_vec_t t[8]; \
+	area_uzp_##bits(v[0], v[1], &t[0], &t[4]); \
+	area_uzp_##bits(v[2], v[3], &t[1], &t[5]); \
+	area_uzp_##bits(v[4], v[5], &t[2], &t[6]); \
+	area_uzp_##bits(v[6], v[7], &t[3], &t[7]); \
+	area_uzp_##bits(t[0], t[1], &v[0], &v[4]); \
+	area_uzp_##bits(t[2], t[3], &v[1], &v[5]); \
+	area_uzp_##bits(t[4], t[5], &v[2], &v[6]); \
+	area_uzp_##bits(t[6], t[7], &v[3], &v[7]); \
+	area_uzp_##bits(v[0], v[1], &t[0], &t[4]); \
+	area_uzp_##bits(v[2], v[3], &t[1], &t[5]); \
+	area_uzp_##bits(v[4], v[5], &t[2], &t[6]); \
+	area_uzp_##bits(v[6], v[7], &t[3], &t[7]); \
+	AREA_REP8(AREA_COPY_T) \
+} \
+static inline void area_zip2_##bits(area_vec_t *v) \
+{ \
+	area_zip_##bits(v[0], v[1], &v[0], &v[1]); \
+} \
+static inline void area_zip4_##bits(area_vec_t *v) \
+{ \
+	area_vec_t t[4]; \
+	area_zip_##bits(v[0], v[2], &t[0], &t[1]); \
+	area_zip_##bits(v[1], v[3], &t[2], &t[3]); \
+	area_zip_##bits(t[0], t[2], &v[0], &v[1]); \
+	area_zip_##bits(t[1], t[3], &v[2], &v[3]); \
+} \
+static inline void area_zip8_##bits(area_vec_t *v) \
+{ \
+	area_vec_t t[8]; \
+	area_zip_##bits(v[0], v[4], &t[0], &t[1]); \
+	area_zip_##bits(v[1], v[5], &t[2], &t[3]); \
+	area_zip_##bits(v[2], v[6], &t[4], &t[5]); \
+	area_zip_##bits(v[3], v[7], &t[6], &t[7]); \
+	area_zip_##bits(t[0], t[4], &v[0], &v[1]); \
+	area_zip_##bits(t[1], t[5], &v[2], &v[3]); \
+	area_zip_##bits(t[2], t[6], &v[4], &v[5]); \
+	area_zip_##bits(t[3], t[7], &v[6], &v[7]); \
+	area_zip_##bits(v[0], v[4], &t[0], &t[1]); \
+	area_zip_##bits(v[1], v[5], &t[2], &t[3]); \
+	area_zip_##bits(v[2], v[6], &t[4], &t[5]); \
+	area_zip_##bits(v[3], v[7], &t[6], &t[7]); \
+	AREA_REP8(AREA_COPY_T) \
+}
+
+AREA_SIMD_ROUNDS(16)
+AREA_SIMD_ROUNDS(32)
+#undef AREA_SIMD_ROUNDS
+#undef AREA_COPY_T
+
+/* frames per vector */
+#define AREA_VEC(bits)		(128 / (bits))
+/* a frame of an N channel group fills whole vectors */
+#define AREA_WIDE(bits, N)	((N) * (bits) >= 128)
+
+#define AREA_UZP(N, bits)	AREA_UZP_(N, bits)
+#define AREA_UZP_(N, bits)	area_uzp##N##_##bits
+#define AREA_ZIP(N, bits)	AREA_ZIP_(N, bits)
+#define AREA_ZIP_(N, bits)	area_zip##N##_##bits
+
+/*
+ * Vector c of a block: either the c-th vector of a fully interleaved
+ * group, or part c % vpf of frame c / vpf when the frames are wide.
+ */
+#define AREA_BLOCK_POS(c)	((c) / vpf * fstride + (c) % vpf * vec)
+#define AREA_SIMD_DST(c)	q[c] = c < chn ? (area_t *)dst[c] : NULL;
+#define AREA_SIMD_SRC(c)	p[c] = src[c < chn ? c : 0];
+#define AREA_VLOAD_FRAMES(c)	v[c] = area_vload(s + AREA_BLOCK_POS(c));
+#define AREA_VSTORE_CHANNEL(c)	if (c < chn) area_vstore(q[c] + i, v[c]);
+#define AREA_VLOAD_CHANNEL(c)	v[c] = area_vload(p[c] + i);
+#define AREA_VSTORE_FRAMES(c)	area_vstore(d + AREA_BLOCK_POS(c), v[c]);
+
+/*
+ * The group of n channels is transposed as one of N = 2, 4 or 8.  With
+ * n < N every frame vector carries N - n padding samples: the gather
+ * reads them from the following frame (so one more frame must exist) and
+ * drops them, the scatter stores them ahead of the following frame,
+ * which is rewritten right after, so it needs stride == n.
+ */
+#define AREA_SIMD_SETUP(bits, N) \
+		const unsigned int vec = AREA_VEC(bits); \
+		const unsigned int vpf = AREA_WIDE(bits, N) ? (N) * (bits) / 128 : 1; \
+		const size_t fstride = AREA_WIDE(bits, N) ? stride : vec;
+
+#define AREA_GATHER_SIMD(bits, n, N) \
+	if (snd_cpu_has(AREA_SIMD_CPU) && \
+	    (AREA_WIDE(bits, N) || n == N) && \
+	    (AREA_WIDE(bits, N) || stride == n)) { \
+		AREA_SIMD_SETUP(bits, N) \
+		area_t *q[N]; \
+		AREA_REP##N(AREA_SIMD_DST) \
+		for (; i + vec + (n != N) <= frames; i += vec) { \
+			const area_t *s = src + i * stride; \
+			area_vec_t v[N]; \
+			AREA_REP##N(AREA_VLOAD_FRAMES) \
+			AREA_UZP(N, bits)(v); \
+			AREA_REP##N(AREA_VSTORE_CHANNEL) \
+		} \
+	}
+#define AREA_SCATTER_SIMD(bits, n, N) \
+	if (snd_cpu_has(AREA_SIMD_CPU) && \
+	    (AREA_WIDE(bits, N) || n == N) && \
+	    (n == N ? AREA_WIDE(bits, N) || stride == n : stride == n)) { \
+		AREA_SIMD_SETUP(bits, N) \
+		const area_t *p[N]; \
+		AREA_REP##N(AREA_SIMD_SRC) \
+		for (; i + vec + (n != N) <= frames; i += vec) { \
+			area_t *d = dst + i * stride; \
+			area_vec_t v[N]; \
+			AREA_REP##N(AREA_VLOAD_CHANNEL) \
+			AREA_ZIP(N, bits)(v); \
+			AREA_REP##N(AREA_VSTORE_FRAMES) \
+		} \
+	}
+
+#define AREA_SIMD_16(code)	code
+#define AREA_SIMD_32(code)	code
+#else
+#define AREA_SIMD_16(code)
+#define AREA_SIMD_32(code)
+#endif
+#define AREA_SIMD_24(code)
+
+/* transpose size for a group of n channels */
+#define AREA_POW2_2		2
+#define AREA_POW2_3		4
+#define AREA_POW2_4		4
+#define AREA_POW2_5		8
+#define AREA_POW2_6		8
+#define AREA_POW2_7		8
+#define AREA_POW2_8		8
+
+/* packed 24 bit samples */
+typedef struct {
+	uint8_t b[3];
+} area_s24_t;
+
+static inline area_s24_t area_silence_24(uint64_t silence)
+{
+	area_s24_t s;
+#ifdef SNDRV_LITTLE_ENDIAN
+	s.b[0] = silence >> 0;
+	s.b[1] = silence >> 8;
+	s.b[2] = silence >> 16;
+#else
+	s.b[2] = silence >> 0;
+	s.b[1] = silence >> 8;
+	s.b[0] = silence >> 16;
+#endif
+	return s;
+}
+
+#define AREA_SILENCE_16(silence)	((uint16_t)(silence))
+#define AREA_SILENCE_24(silence)	area_silence_24(silence)
+#define AREA_SILENCE_32(silence)	((uint32_t)(silence))
+
+#define AREA_DST_CHANNEL(c)	area_t *d##c = dst[c];
+#define AREA_SRC_CHANNEL(c)	const area_t *s##c = src[c];
+#define AREA_GATHER_ONE(c)	d##c[i] = s[c];
+#define AREA_SCATTER_ONE(c)	d[c] = s##c[i];
+#define AREA_COPY_ONE(c)	d[c] = s[c];
+#define AREA_FILL_ONE(c)	d[c] = sil;
+
+#define AREA_GATHER(bits, type, n, N) \
+static void area_gather_##bits##_##n(void *const *dst, const void *src_, \
+				     size_t stride, snd_pcm_uframes_t frames) \
+{ \
+	typedef type area_t; \
+	const unsigned int chn = n; \
+	const area_t *src = src_, *s; \
+	snd_pcm_uframes_t i = 0; \
+	AREA_REP##n(AREA_DST_CHANNEL) \
+	AREA_SIMD_##bits(AREA_GATHER_SIMD(bits, n, N)) \
+	(void)chn; \
+	for (s = src + i * stride; i < frames; i++, s += stride) { \
+		AREA_REP##n(AREA_GATHER_ONE) \
+	} \
+}
+
+#define AREA_SCATTER(bits, type, n, N) \
+static void area_scatter_##bits##_##n(void *dst_, const void *const *src, \
+				      size_t stride, snd_pcm_uframes_t frames) \
+{ \
+	typedef type area_t; \
+	const unsigned int chn = n; \
+	area_t *dst = dst_, *d; \
+	snd_pcm_uframes_t i = 0; \
+	AREA_REP##n(AREA_SRC_CHANNEL) \
+	AREA_SIMD_##bits(AREA_SCATTER_SIMD(bits, n, N)) \
+	(void)chn; \
+	for (d = dst + i * stride; i < frames; i++, d += stride) { \
+		AREA_REP##n(AREA_SCATTER_ONE) \
+	} \
+}
+
+#define AREA_REPACK(bits, type, n) \
+static SND_VECTORIZE void area_repack_##bits##_##n(void *dst_, size_t dst_stride, \
+						   const void *src_, size_t src_stride, \
+						   snd_pcm_uframes_t frames) \
+{ \
+	type *__restrict d = dst_; \
+	const type *__restrict s = src_; \
+	snd_pcm_uframes_t i; \
+	for (i = 0; i < frames; i++, s += src_stride, d += dst_stride) { \
+		AREA_REP##n(AREA_COPY_ONE) \
+	} \
+}
+
+#define AREA_FILL(bits, type, n) \
+static SND_VECTORIZE void area_fill_##bits##_##n(void *dst_, size_t stride, \
+						 uint64_t silence, snd_pcm_uframes_t frames) \
+{ \
+	type *d = dst_; \
+	type sil = AREA_SILENCE_##bits(silence); \
+	snd_pcm_uframes_t i; \
+	for (i = 0; i < frames; i++, d += stride) { \
+		AREA_REP##n(AREA_FILL_ONE) \
+	} \
+}
+
+#define AREA_KERNELS(bits, type) \
+	AREA_KERNELS1(bits, type, 2) AREA_KERNELS1(bits, type, 3) \
+	AREA_KERNELS1(bits, type, 4) AREA_KERNELS1(bits, type, 5) \
+	AREA_KERNELS1(bits, type, 6) AREA_KERNELS1(bits, type, 7) \
+	AREA_KERNELS1(bits, type, 8)
+#define AREA_KERNELS1(bits, type, n) \
+	AREA_KERNELS2(bits, type, n, AREA_POW2_##n)
+#define AREA_KERNELS2(bits, type, n, N) \
+	AREA_GATHER(bits, type, n, N) AREA_SCATTER(bits, type, n, N) \
+	AREA_REPACK(bits, type, n) AREA_FILL(bits, type, n)
+
+AREA_KERNELS(16, uint16_t)
+AREA_KERNELS(24, area_s24_t)
+AREA_KERNELS(32, uint32_t)
+
+#undef AREA_KERNELS
+#undef AREA_KERNELS1
+#undef AREA_KERNELS2
+#undef AREA_GATHER
+#undef AREA_SCATTER
+#undef AREA_REPACK
+#undef AREA_FILL
+#undef AREA_GATHER_ONE
+#undef AREA_SCATTER_ONE
+#undef AREA_COPY_ONE
+#undef AREA_FILL_ONE
+#undef AREA_DST_CHANNEL
+#undef AREA_SRC_CHANNEL
+
+typedef struct {
+	void (*gather)(void *const *dst, const void *src, size_t stride,
+		       snd_pcm_uframes_t frames);
+	void (*scatter)(void *dst, const void *const *src, size_t stride,
+			snd_pcm_uframes_t frames);
+	void (*repack)(void *dst, size_t dst_stride, const void *src,
+		       size_t src_stride, snd_pcm_uframes_t frames);
+	void (*fill)(void *dst, size_t stride, uint64_t silence,
+		     snd_pcm_uframes_t frames);
+} snd_pcm_area_ops_t;
+
+#define AREA_OPS(bits, n) \
+	{ area_gather_##bits##_##n, area_scatter_##bits##_##n, \
+	  area_repack_##bits##_##n, area_fill_##bits##_##n }
+
+/* indexed by the group size, 0 and 1 are handled by the scalar code */
+static const snd_pcm_area_ops_t area_ops_16[AREA_GROUP_MAX + 1] = {
+	[2] = AREA_OPS(16, 2), [3] = AREA_OPS(16, 3), [4] = AREA_OPS(16, 4),
+	[5] = AREA_OPS(16, 5), [6] = AREA_OPS(16, 6), [7] = AREA_OPS(16, 7),
+	[8] = AREA_OPS(16, 8),
+};
+
+static const snd_pcm_area_ops_t area_ops_24[AREA_GROUP_MAX + 1] = {
+	[2] = AREA_OPS(24, 2), [3] = AREA_OPS(24, 3), [4] = AREA_OPS(24, 4),
+	[5] = AREA_OPS(24, 5), [6] = AREA_OPS(24, 6), [7] = AREA_OPS(24, 7),
+	[8] = AREA_OPS(24, 8),
+};
+
+static const snd_pcm_area_ops_t area_ops_32[AREA_GROUP_MAX + 1] = {
+	[2] = AREA_OPS(32, 2), [3] = AREA_OPS(32, 3), [4] = AREA_OPS(32, 4),
+	[5] = AREA_OPS(32, 5), [6] = AREA_OPS(32, 6), [7] = AREA_OPS(32, 7),
+	[8] = AREA_OPS(32, 8),
+};
+
+#undef AREA_OPS
+
+#endif /* __PCM_AREA_OPS_H */
@@ -148,6 +148,7 @@ static void snd_pcm_copy_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
 	}
+	snd_pcm_plugin_dump_profile(pcm, out);
 	snd_output_printf(out, "Slave: ");
 	snd_pcm_dump(copy->plug.gen.slave, out);
 }
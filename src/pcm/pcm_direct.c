@@ -39,6 +39,9 @@
 #include <sys/un.h>
 #include <sys/mman.h>
 #include "pcm_direct.h"
+#ifdef HAVE_SYS_TIMERFD_H
+#include <sys/timerfd.h>
+#endif
 
 /*
  *
@@ -51,11 +54,6 @@ union semun {
 	struct seminfo  *__buf;  /* Buffer for IPC_INFO (Linux specific) */
 };
  
-/*
- * FIXME:
- *  add possibility to use futexes here
- */
-
 int snd_pcm_direct_semaphore_create_or_connect(snd_pcm_direct_t *dmix)
 {
 	union semun s;
@@ -82,12 +80,95 @@ int snd_pcm_direct_semaphore_create_or_connect(snd_pcm_direct_t *dmix)
 	return 0;
 }
 
+/*
+ * mix_lock "mutex": the dmix mixing lock is a robust process shared
+ * mutex in the shm instead of the client semaphore.  An uncontended
+ * lock and unlock is a compare-and-swap on the futex word without a
+ * syscall.  When the owner dies with the mutex held, the next client
+ * gets EOWNERDEAD and takes the lock over, as SEM_UNDO does for the
+ * semaphore.  The semaphore still serializes open, close and the slave
+ * recovery, since it guards the creation and removal of the shm itself.
+ */
+int snd_pcm_direct_mix_mutex_setup(snd_pcm_direct_t *dmix, int first_instance)
+{
+#ifdef THREAD_SAFE_API
+	pthread_mutex_t *lock = &dmix->shmptr->mix_mutex.lock;
+	pthread_mutexattr_t attr;
+	int err;
+
+	if (!dmix->u.dmix.use_mutex)
+		return 0;
+	if (first_instance) {
+		err = pthread_mutexattr_init(&attr);
+		if (err)
+			return -err;
+		err = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+		if (!err)
+			err = pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+		if (!err)
+			err = pthread_mutex_init(lock, &attr);
+		pthread_mutexattr_destroy(&attr);
+		if (err)
+			return -err;
+		dmix->shmptr->mix_mutex.enabled = 1;
+	} else if (!dmix->shmptr->mix_mutex.enabled)
+		return -EINVAL;
+	dmix->u.dmix.mix_mutex = lock;
+	return 0;
+#else
+	if (!dmix->u.dmix.use_mutex)
+		return 0;
+	SNDERR("mix_lock mutex needs the thread-safe API");
+	return -ENOSYS;
+#endif
+}
+
+#ifdef THREAD_SAFE_API
+int snd_pcm_direct_mix_mutex_lock(snd_pcm_direct_t *dmix)
+{
+	unsigned long long start = 0;
+	int err;
+
+	if (snd_pcm_direct_stats_enabled(dmix))
+		start = snd_pcm_direct_stats_now();
+	err = pthread_mutex_lock(dmix->u.dmix.mix_mutex);
+	if (err == EOWNERDEAD) {
+		/* whatever the dead client has mixed so far stays in the
+		 * sum, like with a semaphore released by SEM_UNDO
+		 */
+		SNDERR("dmix client died while mixing, recovering the lock");
+		err = pthread_mutex_consistent(dmix->u.dmix.mix_mutex);
+		if (err)
+			pthread_mutex_unlock(dmix->u.dmix.mix_mutex);
+	}
+	if (err)
+		return -err;
+	if (start)
+		snd_pcm_direct_stats_sem_wait(dmix,
+			snd_pcm_direct_stats_now() - start);
+	return 0;
+}
+
+void snd_pcm_direct_mix_mutex_unlock(snd_pcm_direct_t *dmix)
+{
+	pthread_mutex_unlock(dmix->u.dmix.mix_mutex);
+}
+#endif
+
 static unsigned int snd_pcm_direct_magic(snd_pcm_direct_t *dmix)
 {
+	unsigned int magic;
+
+	if (dmix->type == SND_PCM_TYPE_DMIX && dmix->u.dmix.staging)
+		return 0xc15ad300 + sizeof(snd_pcm_direct_share_t);
 	if (!dmix->direct_memory_access)
-		return 0xa15ad300 + sizeof(snd_pcm_direct_share_t);
+		magic = 0xa15ad300 + sizeof(snd_pcm_direct_share_t);
 	else
-		return 0xb15ad300 + sizeof(snd_pcm_direct_share_t);
+		magic = 0xb15ad300 + sizeof(snd_pcm_direct_share_t);
+	/* clients with a different mixing lock must not share the shm */
+	if (dmix->type == SND_PCM_TYPE_DMIX && dmix->u.dmix.use_mutex)
+		magic ^= 0x01000000;
+	return magic;
 }
 
 /*
@@ -156,6 +237,18 @@ retryget:
  * server should have statically linked functions.
  * (e.g. Novell bugzilla #105772)
  */
+static void snd_pcm_direct_stats_release(snd_pcm_direct_t *dmix)
+{
+	int pid = getpid();
+
+	if (dmix->stats_slot < 0 || dmix->shmptr == (void *) -1)
+		return;
+	/* a forked server carries a copy of the slot index; leave it alone */
+	__atomic_compare_exchange_n(&dmix->shmptr->stats.client[dmix->stats_slot].pid,
+				    &pid, 0, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+	dmix->stats_slot = -1;
+}
+
 static int _snd_pcm_direct_shm_discard(snd_pcm_direct_t *dmix)
 {
 	struct shmid_ds buf;
@@ -163,6 +256,7 @@ static int _snd_pcm_direct_shm_discard(snd_pcm_direct_t *dmix)
 
 	if (dmix->shmid < 0)
 		return -EINVAL;
+	snd_pcm_direct_stats_release(dmix);
 	if (dmix->shmptr != (void *) -1 && shmdt(dmix->shmptr) < 0)
 		return -errno;
 	dmix->shmptr = (void *) -1;
@@ -183,6 +277,165 @@ int snd_pcm_direct_shm_discard(snd_pcm_direct_t *dmix)
 	return _snd_pcm_direct_shm_discard(dmix);
 }
 
+/*
+ *  statistics in the shm area
+ */
+
+/* takes a free (or stale) per-client entry in the stats block */
+static void snd_pcm_direct_stats_claim(snd_pcm_direct_t *dmix)
+{
+	snd_pcm_direct_stats_t *stats = &dmix->shmptr->stats;
+	int pid = getpid();
+	unsigned int i;
+
+	for (i = 0; i < SND_PCM_DIRECT_STATS_CLIENTS; i++) {
+		int owner = __atomic_load_n(&stats->client[i].pid, __ATOMIC_ACQUIRE);
+		if (owner && (kill(owner, 0) == 0 || errno != ESRCH))
+			continue;
+		if (__atomic_compare_exchange_n(&stats->client[i].pid, &owner, pid,
+						0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+			__atomic_store_n(&stats->client[i].frames, 0, __ATOMIC_RELAXED);
+			dmix->stats_slot = i;
+			return;
+		}
+	}
+}
+
+void snd_pcm_direct_stats_sem_wait(snd_pcm_direct_t *dmix, unsigned long long ns)
+{
+	snd_pcm_direct_stats_t *stats = &dmix->shmptr->stats;
+	unsigned long long limit = 1000;
+	unsigned int bucket = 0;
+
+	while (bucket < SND_PCM_DIRECT_STATS_HIST - 1 && ns >= limit) {
+		bucket++;
+		limit *= 10;
+	}
+	__atomic_add_fetch(&stats->sem_waits, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&stats->sem_wait_ns, ns, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&stats->sem_wait_hist[bucket], 1, __ATOMIC_RELAXED);
+}
+
+void snd_pcm_direct_stats_mix(snd_pcm_direct_t *dmix, unsigned long long ns,
+			      snd_pcm_uframes_t frames)
+{
+	snd_pcm_direct_stats_t *stats = &dmix->shmptr->stats;
+
+	if (!frames)
+		return;
+	__atomic_add_fetch(&stats->mix_calls, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&stats->mix_ns, ns, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&stats->mix_frames, frames, __ATOMIC_RELAXED);
+	if (dmix->stats_slot >= 0)
+		__atomic_add_fetch(&stats->client[dmix->stats_slot].frames, frames,
+				   __ATOMIC_RELAXED);
+}
+
+void snd_pcm_direct_stats_rewind(snd_pcm_direct_t *dmix, unsigned long long ns,
+				 snd_pcm_uframes_t frames)
+{
+	snd_pcm_direct_stats_t *stats = &dmix->shmptr->stats;
+
+	if (!frames)
+		return;
+	__atomic_add_fetch(&stats->rewinds, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&stats->rewind_ns, ns, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&stats->rewind_frames, frames, __ATOMIC_RELAXED);
+}
+
+static void snd_pcm_direct_stats_dump_shm(const snd_pcm_direct_share_t *shm,
+					  snd_output_t *out)
+{
+	static const char *const hist_names[SND_PCM_DIRECT_STATS_HIST] = {
+		"<1us", "<10us", "<100us", "<1ms", "<10ms", "<100ms", ">=100ms"
+	};
+	const snd_pcm_direct_stats_t *stats = &shm->stats;
+	unsigned long long waits, mix_calls, mix_frames, rewinds;
+	unsigned int i;
+
+	if (!stats->enabled) {
+		snd_output_printf(out, "Statistics: disabled\n");
+		return;
+	}
+	waits = __atomic_load_n(&stats->sem_waits, __ATOMIC_RELAXED);
+	mix_calls = __atomic_load_n(&stats->mix_calls, __ATOMIC_RELAXED);
+	mix_frames = __atomic_load_n(&stats->mix_frames, __ATOMIC_RELAXED);
+	snd_output_printf(out, "Statistics:\n");
+	snd_output_printf(out, "  sem waits  : %llu (avg %.1f us)\n", waits,
+			  waits ? __atomic_load_n(&stats->sem_wait_ns, __ATOMIC_RELAXED) /
+				  1000.0 / waits : 0.0);
+	snd_output_printf(out, "  sem hist   :");
+	for (i = 0; i < SND_PCM_DIRECT_STATS_HIST; i++)
+		snd_output_printf(out, " %s=%llu", hist_names[i],
+				  __atomic_load_n(&stats->sem_wait_hist[i], __ATOMIC_RELAXED));
+	snd_output_printf(out, "\n");
+	snd_output_printf(out, "  mix        : %llu calls, %llu frames",
+			  mix_calls, mix_frames);
+	if (mix_calls && shm->s.period_size)
+		snd_output_printf(out, ", %.1f us/call, %.1f us/period",
+				  __atomic_load_n(&stats->mix_ns, __ATOMIC_RELAXED) / 1000.0 / mix_calls,
+				  __atomic_load_n(&stats->mix_ns, __ATOMIC_RELAXED) / 1000.0 *
+				  shm->s.period_size / mix_frames);
+	snd_output_printf(out, "\n");
+	snd_output_printf(out, "  xruns      : %llu\n",
+			  __atomic_load_n(&stats->xruns, __ATOMIC_RELAXED));
+	snd_output_printf(out, "  recoveries : %llu\n",
+			  __atomic_load_n(&stats->recoveries, __ATOMIC_RELAXED));
+	rewinds = __atomic_load_n(&stats->rewinds, __ATOMIC_RELAXED);
+	snd_output_printf(out, "  rewinds    : %llu calls, %llu frames", rewinds,
+			  __atomic_load_n(&stats->rewind_frames, __ATOMIC_RELAXED));
+	if (rewinds)
+		snd_output_printf(out, ", %.1f us/call",
+				  __atomic_load_n(&stats->rewind_ns, __ATOMIC_RELAXED) /
+				  1000.0 / rewinds);
+	snd_output_printf(out, "\n");
+	for (i = 0; i < SND_PCM_DIRECT_STATS_CLIENTS; i++) {
+		int pid = __atomic_load_n(&stats->client[i].pid, __ATOMIC_RELAXED);
+		if (!pid)
+			continue;
+		snd_output_printf(out, "  client %-4u: pid %d, %llu frames\n", i, pid,
+				  __atomic_load_n(&stats->client[i].frames, __ATOMIC_RELAXED));
+	}
+}
+
+void snd_pcm_direct_stats_dump_local(snd_pcm_direct_t *dmix, snd_output_t *out)
+{
+	if (snd_pcm_direct_stats_enabled(dmix))
+		snd_pcm_direct_stats_dump_shm(dmix->shmptr, out);
+}
+
+/**
+ * \\brief Dump the statistics of a dmix, dsnoop or dshare instance
+ * \\param ipc_key IPC key of the instance (the ipc_key configuration field,
+ *                including any per-uid or per-device offset)
+ * \\param out Output handle
+ * \\return 0 on success otherwise a negative error code
+ *
+ * The shared memory area of the instance is attached read-only, so the
+ * caller does not join the mix.  The counters are present only when the
+ * instance was opened with the \\c stats option.
+ */
+int snd_pcm_direct_stats_dump(int ipc_key, snd_output_t *out)
+{
+	const snd_pcm_direct_share_t *shm;
+	unsigned int magic;
+	int shmid, err = 0;
+
+	shmid = shmget(ipc_key, 0, 0);
+	if (shmid < 0)
+		return -errno;
+	shm = shmat(shmid, NULL, SHM_RDONLY);
+	if (shm == (void *) -1)
+		return -errno;
+	magic = shm->magic - sizeof(snd_pcm_direct_share_t);
+	if (magic != 0xa15ad300 && magic != 0xb15ad300 && magic != 0xc15ad300)
+		err = -EINVAL;
+	else
+		snd_pcm_direct_stats_dump_shm(shm, out);
+	shmdt(shm);
+	return err;
+}
+
 /*
  *  server side
  */
@@ -293,7 +546,7 @@ static int _snd_send_fd(int sock, void *data, size_t len, int fd)
 	struct msghdr msghdr;
 	struct iovec vec;
 
-	vec.iov_base = (void *)&data;
+	vec.iov_base = data;
 	vec.iov_len = len;
 
 	cmsg->cmsg_len = cmsg_len;
@@ -334,7 +587,8 @@ static void server_job(snd_pcm_direct_t *dmix)
 #else
 	while (--i >= 0) {
 #endif
-		if (i != dmix->server_fd && i != dmix->hw_fd)
+		if (i != dmix->server_fd && i != dmix->hw_fd &&
+		    !(dmix->type == SND_PCM_TYPE_DMIX && i == dmix->u.dmix.sum_fd))
 			close(i);
 	}
 	
@@ -363,7 +617,10 @@ static void server_job(snd_pcm_direct_t *dmix)
 				continue;
 			}
 			server_printf("DIRECT SERVER: nattch = %i\n", (int)buf.shm_nattch);
-			if (buf.shm_nattch == 1)	/* server is the last user, exit */
+			/* server is the last user, exit unless it holds the
+			 * slave for the next clients
+			 */
+			if (buf.shm_nattch == 1 && !dmix->shmptr->persist)
 				break;
 			snd_pcm_direct_semaphore_up(dmix, DIRECT_IPC_SEM_CLIENT);
 			continue;
@@ -380,6 +637,11 @@ static void server_job(snd_pcm_direct_t *dmix)
 					pfds[current+1].fd = sck;
 					pfds[current+1].events = POLLIN | POLLERR | POLLHUP;
 					_snd_send_fd(sck, &buf, 1, dmix->hw_fd);
+					if (dmix->type == SND_PCM_TYPE_DMIX &&
+					    dmix->u.dmix.sum_fd >= 0) {
+						buf = 'S';
+						_snd_send_fd(sck, &buf, 1, dmix->u.dmix.sum_fd);
+					}
 					server_printf("DIRECT SERVER: fd sent ok\n");
 					current++;
 				}
@@ -419,6 +681,9 @@ static void server_job(snd_pcm_direct_t *dmix)
 
 int snd_pcm_direct_server_create(snd_pcm_direct_t *dmix)
 {
+#ifdef HAVE_LIBPTHREAD
+	snd_thread_sched_t *sched;
+#endif
 	int ret;
 
 	dmix->server_fd = -1;
@@ -438,18 +703,33 @@ int snd_pcm_direct_server_create(snd_pcm_direct_t *dmix)
 		return ret;
 	}
 	
+#ifdef HAVE_LIBPTHREAD
+	/* resolved here, the configuration is not usable after fork() */
+	sched = snd_thread_sched_get("pcm_direct_server");
+#endif
 	ret = fork();
 	if (ret < 0) {
+#ifdef HAVE_LIBPTHREAD
+		free(sched);
+#endif
 		close(dmix->server_fd);
 		return ret;
 	} else if (ret == 0) {
 		ret = fork();
-		if (ret == 0)
+		if (ret == 0) {
+#ifdef HAVE_LIBPTHREAD
+			snd_thread_sched_apply(pthread_self(), sched,
+					       "pcm_direct_server");
+#endif
 			server_job(dmix);
+		}
 		_exit(EXIT_SUCCESS);
 	} else {
 		waitpid(ret, NULL, 0);
 	}
+#ifdef HAVE_LIBPTHREAD
+	free(sched);
+#endif
 	dmix->server_pid = ret;
 	dmix->server = 1;
 	return 0;
@@ -490,6 +770,16 @@ int snd_pcm_direct_client_connect(snd_pcm_direct_t *dmix)
 		dmix->comm_fd = -1;
 		return ret;
 	}
+	/* the sum buffer follows when it is not a SysV segment */
+	if (dmix->type == SND_PCM_TYPE_DMIX && dmix->shmptr->sum_memfd) {
+		ret = snd_receive_fd(dmix->comm_fd, &buf, 1, &dmix->u.dmix.sum_fd);
+		if (ret < 1 || dmix->u.dmix.sum_fd < 0) {
+			close(dmix->hw_fd);
+			close(dmix->comm_fd);
+			dmix->comm_fd = -1;
+			return ret < 0 ? ret : -EIO;
+		}
+	}
 
 	dmix->client = 1;
 	return 0;
@@ -517,13 +807,95 @@ int snd_pcm_direct_nonblock(snd_pcm_t *pcm ATTRIBUTE_UNUSED, int nonblock ATTRIB
 int snd_pcm_direct_async(snd_pcm_t *pcm, int sig, pid_t pid)
 {
 	snd_pcm_direct_t *dmix = pcm->private_data;
+	if (dmix->timerfd >= 0)
+		return -ENOSYS;
 	return snd_timer_async(dmix->timer, sig, pid);
 }
 
+#ifdef HAVE_SYS_TIMERFD_H
+static void direct_timerfd_ns(struct timespec *ts, unsigned long long ns)
+{
+	ts->tv_sec += ns / 1000000000ULL;
+	ts->tv_nsec += ns % 1000000000ULL;
+	if (ts->tv_nsec >= 1000000000L) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000L;
+	}
+}
+
+/*
+ * Arm the timerfd to expire when the slave hw_ptr moved by at least
+ * frames, rounded up to a slave period boundary (most drivers update
+ * the pointer only from the period interrupt), then once per period
+ * like the slave timer.
+ *
+ * The base time is the slave htimestamp of the last pointer update
+ * when it is on CLOCK_MONOTONIC, otherwise the current time.
+ */
+static int direct_timerfd_arm(snd_pcm_direct_t *dmix, snd_pcm_uframes_t frames)
+{
+	struct itimerspec its;
+	snd_pcm_uframes_t period = dmix->slave_period_size;
+	snd_pcm_uframes_t avail, ofs, wait;
+	unsigned int rate = dmix->shmptr->s.rate;
+	snd_htimestamp_t tstamp;
+	int flags = 0;
+
+	if (!period || !rate)
+		return -EINVAL;
+	ofs = *dmix->spcm->hw.ptr % period;
+	wait = (ofs + frames + period - 1) / period * period - ofs;
+	if (wait == 0)
+		wait = period;
+
+	memset(&its, 0, sizeof(its));
+	direct_timerfd_ns(&its.it_interval,
+			  (unsigned long long)period * dmix->timer_ticks *
+			  1000000000ULL / rate);
+	if (dmix->spcm->tstamp_type == SND_PCM_TSTAMP_TYPE_MONOTONIC &&
+	    snd_pcm_htimestamp(dmix->spcm, &avail, &tstamp) == 0 &&
+	    (tstamp.tv_sec || tstamp.tv_nsec)) {
+		its.it_value = tstamp;
+		flags = TFD_TIMER_ABSTIME;
+	}
+	direct_timerfd_ns(&its.it_value,
+			  (unsigned long long)wait * 1000000000ULL / rate);
+	if (timerfd_settime(dmix->timerfd, flags, &its, NULL) < 0)
+		return -errno;
+	return 0;
+}
+#endif
+
+int snd_pcm_direct_timer_start(snd_pcm_direct_t *dmix)
+{
+#ifdef HAVE_SYS_TIMERFD_H
+	if (dmix->timerfd >= 0)
+		return direct_timerfd_arm(dmix, dmix->slave_period_size * dmix->timer_ticks);
+#endif
+	return snd_timer_start(dmix->timer);
+}
+
+void snd_pcm_direct_timer_close(snd_pcm_direct_t *dmix)
+{
+	if (dmix->timer)
+		snd_timer_close(dmix->timer);
+	dmix->timer = NULL;
+	if (dmix->timerfd >= 0)
+		close(dmix->timerfd);
+	dmix->timerfd = -1;
+}
+
 /* empty the timer read queue */
 int snd_pcm_direct_clear_timer_queue(snd_pcm_direct_t *dmix)
 {
 	int changed = 0;
+	if (dmix->timerfd >= 0) {
+		/* one read returns all expirations */
+		unsigned long long expirations;
+		if (read(dmix->timerfd, &expirations, sizeof(expirations)) > 0)
+			changed = 1;
+		return changed;
+	}
 	if (dmix->timer_need_poll) {
 		while (poll(&dmix->timer_fd, 1, 0) > 0) {
 			changed++;
@@ -556,6 +928,15 @@ int snd_pcm_direct_clear_timer_queue(snd_pcm_direct_t *dmix)
 
 int snd_pcm_direct_timer_stop(snd_pcm_direct_t *dmix)
 {
+#ifdef HAVE_SYS_TIMERFD_H
+	if (dmix->timerfd >= 0) {
+		struct itimerspec its;
+
+		memset(&its, 0, sizeof(its));
+		timerfd_settime(dmix->timerfd, 0, &its, NULL);
+		return 0;
+	}
+#endif
 	snd_timer_stop(dmix->timer);
 	return 0;
 }
@@ -570,6 +951,55 @@ int snd_pcm_direct_timer_stop(snd_pcm_direct_t *dmix)
  * The first client recovers slave pcm.
  * Each client needs to execute sw xrun handling afterwards
  */
+/*
+ * dshare clients write disjoint channels, so in the lockfree mode only
+ * bringing the slave back up has to be serialized.  It is claimed with
+ * compare-and-swap of the owner pid in the shm instead of a semop; a
+ * claim left behind by a dead process is taken over.
+ * Returns 1 when the caller owns the recovery, 0 when another client
+ * is doing it, or a negative error code.
+ */
+static int snd_pcm_direct_recover_lock(snd_pcm_direct_t *direct)
+{
+	int err;
+
+	if (direct->type == SND_PCM_TYPE_DSHARE &&
+	    direct->shmptr->u.dshare.lockfree) {
+		pid_t *owner = &direct->shmptr->u.dshare.recover_owner;
+		pid_t self = getpid(), cur = 0;
+
+		if (__atomic_compare_exchange_n(owner, &cur, self, 0,
+						__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			return 1;
+		if (cur == self || kill(cur, 0) == 0 || errno != ESRCH)
+			return 0;
+		return __atomic_compare_exchange_n(owner, &cur, self, 0,
+						   __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+	}
+	err = snd_pcm_direct_semaphore_down(direct, DIRECT_IPC_SEM_CLIENT);
+	if (err < 0) {
+		SNDERR("SEMDOWN FAILED with err %d", err);
+		return err;
+	}
+	return 1;
+}
+
+static int snd_pcm_direct_recover_unlock(snd_pcm_direct_t *direct)
+{
+	int err;
+
+	if (direct->type == SND_PCM_TYPE_DSHARE &&
+	    direct->shmptr->u.dshare.lockfree) {
+		__atomic_store_n(&direct->shmptr->u.dshare.recover_owner, 0,
+				 __ATOMIC_RELEASE);
+		return 0;
+	}
+	err = snd_pcm_direct_semaphore_up(direct, DIRECT_IPC_SEM_CLIENT);
+	if (err < 0)
+		SNDERR("SEMUP FAILED with err %d", err);
+	return err;
+}
+
 int snd_pcm_direct_slave_recover(snd_pcm_direct_t *direct)
 {
 	unsigned int recoveries;
@@ -577,22 +1007,16 @@ int snd_pcm_direct_slave_recover(snd_pcm_direct_t *direct)
 	int ret;
 	int semerr;
 
-	semerr = snd_pcm_direct_semaphore_down(direct,
-						   DIRECT_IPC_SEM_CLIENT);
-	if (semerr < 0) {
-		SNDERR("SEMDOWN FAILED with err %d", semerr);
+	semerr = snd_pcm_direct_recover_lock(direct);
+	if (semerr <= 0)
 		return semerr;
-	}
 
 	state = snd_pcm_state(direct->spcm);
 	if (state != SND_PCM_STATE_XRUN && state != SND_PCM_STATE_SUSPENDED) {
 		/* ignore... someone else already did recovery */
-		semerr = snd_pcm_direct_semaphore_up(direct,
-						     DIRECT_IPC_SEM_CLIENT);
-		if (semerr < 0) {
-			SNDERR("SEMUP FAILED with err %d", semerr);
+		semerr = snd_pcm_direct_recover_unlock(direct);
+		if (semerr < 0)
 			return semerr;
-		}
 		return 0;
 	}
 
@@ -600,7 +1024,11 @@ int snd_pcm_direct_slave_recover(snd_pcm_direct_t *direct)
 	recoveries = (recoveries + 1) & RECOVERIES_MASK;
 	if (state == SND_PCM_STATE_SUSPENDED)
 		recoveries |= RECOVERIES_FLAG_SUSPENDED;
-	direct->shmptr->s.recoveries = recoveries;
+	__atomic_store_n(&direct->shmptr->s.recoveries, recoveries,
+			 __ATOMIC_RELEASE);
+	if (snd_pcm_direct_stats_enabled(direct))
+		__atomic_add_fetch(&direct->shmptr->stats.recoveries, 1,
+				   __ATOMIC_RELAXED);
 
 	/* some buggy drivers require the device resumed before prepared;
 	 * when a device has RESUME flag and is in SUSPENDED state, resume
@@ -617,12 +1045,9 @@ int snd_pcm_direct_slave_recover(snd_pcm_direct_t *direct)
 	ret = snd_pcm_prepare(direct->spcm);
 	if (ret < 0) {
 		SNDERR("recover: unable to prepare slave");
-		semerr = snd_pcm_direct_semaphore_up(direct,
-						     DIRECT_IPC_SEM_CLIENT);
-		if (semerr < 0) {
-			SNDERR("SEMUP FAILED with err %d", semerr);
+		semerr = snd_pcm_direct_recover_unlock(direct);
+		if (semerr < 0)
 			return semerr;
-		}
 		return ret;
 	}
 
@@ -637,20 +1062,14 @@ int snd_pcm_direct_slave_recover(snd_pcm_direct_t *direct)
 	ret = snd_pcm_start(direct->spcm);
 	if (ret < 0) {
 		SNDERR("recover: unable to start slave");
-		semerr = snd_pcm_direct_semaphore_up(direct,
-						     DIRECT_IPC_SEM_CLIENT);
-		if (semerr < 0) {
-			SNDERR("SEMUP FAILED with err %d", semerr);
+		semerr = snd_pcm_direct_recover_unlock(direct);
+		if (semerr < 0)
 			return semerr;
-		}
 		return ret;
 	}
-	semerr = snd_pcm_direct_semaphore_up(direct,
-						 DIRECT_IPC_SEM_CLIENT);
-	if (semerr < 0) {
-		SNDERR("SEMUP FAILED with err %d", semerr);
+	semerr = snd_pcm_direct_recover_unlock(direct);
+	if (semerr < 0)
 		return semerr;
-	}
 	return 0;
 }
 
@@ -684,6 +1103,9 @@ int snd_pcm_direct_check_xrun(snd_pcm_direct_t *direct, snd_pcm_t *pcm)
 		 * so don't increment but just update to actual counter
 		 */
 		direct->recoveries = direct->shmptr->s.recoveries;
+		if (snd_pcm_direct_stats_enabled(direct))
+			__atomic_add_fetch(&direct->shmptr->stats.xruns, 1,
+					   __ATOMIC_RELAXED);
 		pcm->fast_ops->drop(pcm);
 		/* trigger_tstamp update is missing in drop callbacks */
 		gettimestamp(&direct->trigger_tstamp, pcm->tstamp_type);
@@ -702,6 +1124,78 @@ int snd_pcm_direct_check_xrun(snd_pcm_direct_t *direct, snd_pcm_t *pcm)
 	return 0;
 }
 
+/*
+ * slave hw_ptr for the sync_ptr callbacks
+ *
+ * With slowptr each call asks the driver with an hwsync, unless
+ * ptr_refresh is set.  Then the client finding the shared estimate older
+ * than that refreshes it (all clients share the slave substream and its
+ * status page), and the others read the status page and, with
+ * extrapolate, move on from the estimate at the slave rate: by no more
+ * than a period past the status page and never back by less than one.
+ */
+snd_pcm_uframes_t snd_pcm_direct_slave_hw_ptr(snd_pcm_direct_t *direct, int extrapolate)
+{
+	snd_pcm_direct_share_t *shm = direct->shmptr;
+	snd_pcm_uframes_t hw_ptr, base, frames, diff;
+	unsigned long long now, tstamp;
+	unsigned int seq, recoveries;
+
+	if (!direct->slowptr)
+		return *direct->spcm->hw.ptr;
+	if (!direct->ptr_refresh_ns) {
+		snd_pcm_hwsync(direct->spcm);
+		return *direct->spcm->hw.ptr;
+	}
+	now = snd_pcm_direct_stats_now();
+	seq = __atomic_load_n(&shm->ptr_est.seq, __ATOMIC_ACQUIRE);
+	if (!(seq & 1)) {
+		tstamp = __atomic_load_n(&shm->ptr_est.tstamp, __ATOMIC_RELAXED);
+		base = __atomic_load_n(&shm->ptr_est.hw_ptr, __ATOMIC_RELAXED);
+		recoveries = __atomic_load_n(&shm->ptr_est.recoveries, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&shm->ptr_est.seq, __ATOMIC_RELAXED) == seq &&
+		    tstamp && now - tstamp < direct->ptr_refresh_ns &&
+		    recoveries == shm->s.recoveries &&
+		    snd_pcm_state(direct->spcm) == SND_PCM_STATE_RUNNING) {
+			hw_ptr = *direct->spcm->hw.ptr;
+			diff = pcm_frame_diff(hw_ptr, base, direct->slave_boundary);
+			if (diff < direct->slave_buffer_size) {
+				if (!extrapolate)
+					return hw_ptr;
+				frames = (now - tstamp) * shm->s.rate / 1000000000ULL;
+				if (frames > diff + direct->slave_period_size)
+					frames = diff + direct->slave_period_size;
+				if (frames > diff)
+					hw_ptr = (base + frames) % direct->slave_boundary;
+				goto _monotonic;
+			}
+		}
+	}
+	/* whoever turns seq odd refreshes, a crash there only disables sharing */
+	if (!(seq & 1) &&
+	    __atomic_compare_exchange_n(&shm->ptr_est.seq, &seq, seq + 1, 0,
+					__ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+		snd_pcm_hwsync(direct->spcm);
+		hw_ptr = *direct->spcm->hw.ptr;
+		__atomic_store_n(&shm->ptr_est.tstamp, snd_pcm_direct_stats_now(),
+				 __ATOMIC_RELAXED);
+		__atomic_store_n(&shm->ptr_est.hw_ptr, hw_ptr, __ATOMIC_RELAXED);
+		__atomic_store_n(&shm->ptr_est.recoveries, shm->s.recoveries,
+				 __ATOMIC_RELAXED);
+		__atomic_store_n(&shm->ptr_est.seq, seq + 2, __ATOMIC_RELEASE);
+	} else {
+		snd_pcm_hwsync(direct->spcm);
+		hw_ptr = *direct->spcm->hw.ptr;
+	}
+ _monotonic:
+	/* a refresh may land just behind the last estimate */
+	diff = pcm_frame_diff(direct->slave_hw_ptr, hw_ptr, direct->slave_boundary);
+	if (diff > 0 && diff < direct->slave_period_size)
+		hw_ptr = direct->slave_hw_ptr;
+	return hw_ptr;
+}
+
 /*
  * This is the only operation guaranteed to be called before entering poll().
  * Direct plugins use fd of snd_timer to poll on, these timers do NOT check
@@ -781,6 +1275,16 @@ timer_changed:
 			 */
 			if (snd_pcm_direct_clear_timer_queue(dmix))
 				goto timer_changed;
+#ifdef HAVE_SYS_TIMERFD_H
+			/* woken too early, wait exactly until avail_min */
+			if (dmix->timerfd >= 0 && dmix->state == SND_PCM_STATE_RUNNING) {
+				snd_pcm_uframes_t avail = pcm->stream == SND_PCM_STREAM_PLAYBACK ?
+					snd_pcm_mmap_playback_avail(pcm) :
+					snd_pcm_mmap_capture_avail(pcm);
+				if (avail < pcm->avail_min)
+					direct_timerfd_arm(dmix, pcm->avail_min - avail);
+			}
+#endif
 			events &= ~(POLLOUT|POLLIN);
 			/* additional check */
 			switch (__snd_pcm_state(pcm)) {
@@ -963,12 +1467,16 @@ int snd_pcm_direct_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 		snd_interval_t period_time = dshare->shmptr->hw.period_time;
 		int changed;
 		unsigned int max_periods = dshare->max_periods;
+		snd_pcm_uframes_t min_buffer_size = 2 * dshare->slave_period_size;
 		if (max_periods < 2)
 			max_periods = dshare->slave_buffer_size / dshare->slave_period_size;
 
+		/* a zerocopy dsnoop client reads the slave ring itself */
+		if (dshare->type == SND_PCM_TYPE_DSNOOP && dshare->u.dsnoop.zerocopy)
+			min_buffer_size = dshare->slave_buffer_size;
 		/* make sure buffer size does not exceed slave buffer size */
 		err = hw_param_interval_refine_minmax(params, SND_PCM_HW_PARAM_BUFFER_SIZE,
-					2 * dshare->slave_period_size, dshare->slave_buffer_size);
+					min_buffer_size, dshare->slave_buffer_size);
 		if (err < 0)
 			return err;
 		if (dshare->var_periodsize) {
@@ -1027,6 +1535,8 @@ int snd_pcm_direct_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 
 	params->info = dmix->shmptr->s.info;
 	params->rate_num = dmix->shmptr->s.rate;
+	if (dmix->type == SND_PCM_TYPE_DSNOOP && dmix->u.dsnoop.rate_factor)
+		params->rate_num /= dmix->u.dsnoop.rate_factor;
 	params->rate_den = 1;
 	params->fifo_size = 0;
 	params->msbits = dmix->shmptr->s.msbits;
@@ -1041,9 +1551,27 @@ int snd_pcm_direct_hw_free(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
 
 int snd_pcm_direct_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t *params)
 {
+	snd_pcm_direct_t *dmix = pcm->private_data;
+	snd_pcm_uframes_t wakeup = pcm->period_size;
+
 	if (params->tstamp_type != pcm->tstamp_type)
 		return -EINVAL;
 
+	/* adaptive avail_min: coalesce the timer wakeups up to avail_min;
+	 * the timerfd takes the interval at the next arm, the ALSA timer
+	 * at the next prepare (its params ioctl stops a running timer)
+	 */
+	if (sw_get_avail_min_adaptive(params) && params->avail_min > wakeup)
+		wakeup = params->avail_min;
+	if (dmix->slave_period_size) {
+		/* a dsnoop client_rate client counts in its own frames */
+		if (dmix->type == SND_PCM_TYPE_DSNOOP && dmix->u.dsnoop.rate_factor)
+			wakeup *= dmix->u.dsnoop.rate_factor;
+		dmix->timer_ticks = wakeup / dmix->slave_period_size;
+		if (!dmix->timer_ticks)
+			dmix->timer_ticks = 1;
+	}
+
 	/* values are cached in the pcm structure */
 	return 0;
 }
@@ -1117,6 +1645,20 @@ int snd_pcm_direct_prepare(snd_pcm_t *pcm)
 	case SND_PCM_STATE_SETUP:
 	case SND_PCM_STATE_XRUN:
 	case SND_PCM_STATE_SUSPENDED:
+		if (dmix->type == SND_PCM_TYPE_DSHARE &&
+		    dmix->shmptr->u.dshare.lockfree) {
+			/* another client may be bringing the slave up */
+			err = snd_pcm_direct_recover_lock(dmix);
+			if (err <= 0)
+				break;
+			err = snd_pcm_prepare(dmix->spcm);
+			if (err >= 0)
+				snd_pcm_start(dmix->spcm);
+			snd_pcm_direct_recover_unlock(dmix);
+			if (err < 0)
+				return err;
+			break;
+		}
 		err = snd_pcm_prepare(dmix->spcm);
 		if (err < 0)
 			return err;
@@ -1128,6 +1670,17 @@ int snd_pcm_direct_prepare(snd_pcm_t *pcm)
 	default:
 		break;
 	}
+	if (pcm->mode & SND_PCM_MLOCK_AREAS) {
+		/* another client may have prepared the slave, lock it here too */
+		err = snd_pcm_mmap_lock_areas(dmix->spcm);
+		if (err < 0)
+			return err;
+		if (mlock(dmix->shmptr, sizeof(snd_pcm_direct_share_t)) < 0) {
+			err = -errno;
+			SYSERR("mlock failed");
+			return err;
+		}
+	}
 	snd_pcm_direct_check_interleave(dmix, pcm);
 	dmix->state = SND_PCM_STATE_PREPARED;
 	dmix->appl_ptr = dmix->last_appl_ptr = 0;
@@ -1135,6 +1688,38 @@ int snd_pcm_direct_prepare(snd_pcm_t *pcm)
 	return snd_pcm_direct_set_timer_params(dmix);
 }
 
+/*
+ * Client side of snd_pcm_resync(): when only this client ran out, the
+ * slave keeps running and is left alone, without the recovery semaphore
+ * and without setting up the timer again.  A slave in xrun is recovered
+ * as in the transfer path, the setup and the not yet started cases go
+ * the full prepare way.
+ */
+int snd_pcm_direct_resync(snd_pcm_t *pcm)
+{
+	snd_pcm_direct_t *dmix = pcm->private_data;
+	int err;
+
+	switch (snd_pcm_state(dmix->spcm)) {
+	case SND_PCM_STATE_RUNNING:
+		break;
+	case SND_PCM_STATE_XRUN:
+	case SND_PCM_STATE_SUSPENDED:
+		err = snd_pcm_direct_slave_recover(dmix);
+		if (err < 0)
+			return err;
+		break;
+	default:
+		return snd_pcm_direct_prepare(pcm);
+	}
+	/* this client has recovered already, do not report it again */
+	dmix->recoveries = dmix->shmptr->s.recoveries;
+	dmix->state = SND_PCM_STATE_PREPARED;
+	dmix->appl_ptr = dmix->last_appl_ptr = 0;
+	dmix->hw_ptr = 0;
+	return 0;
+}
+
 int snd_pcm_direct_resume(snd_pcm_t *pcm)
 {
 	snd_pcm_direct_t *dmix = pcm->private_data;
@@ -1471,6 +2056,21 @@ int snd_pcm_direct_initialize_poll_fd(snd_pcm_direct_t *dmix)
 	dmix->tread = 1;
 	dmix->timer_need_poll = 0;
 	dmix->timer_ticks = 1;
+	if (dmix->wakeup == SND_PCM_DIRECT_WAKEUP_TIMERFD) {
+#ifdef HAVE_SYS_TIMERFD_H
+		dmix->timerfd = timerfd_create(CLOCK_MONOTONIC,
+					       TFD_NONBLOCK | TFD_CLOEXEC);
+		if (dmix->timerfd >= 0) {
+			dmix->timer_fd.fd = dmix->timerfd;
+			dmix->timer_fd.events = POLLIN;
+			dmix->poll_fd = dmix->timerfd;
+			return 0;
+		}
+		SYSMSG("timerfd_create failed, using the slave timer");
+#else
+		SNDMSG("timerfd is not available, using the slave timer");
+#endif
+	}
 	ret = snd_pcm_info(dmix->spcm, &info);
 	if (ret < 0) {
 		SNDERR("unable to info for slave pcm");
@@ -1580,6 +2180,11 @@ static void copy_slave_setting(snd_pcm_direct_t *dmix, snd_pcm_t *spcm)
 
 	spcm->info &= ~SND_PCM_INFO_PAUSE;
 	spcm->boundary = recalc_boundary_size(dmix->shmptr->s.boundary, spcm->buffer_size);
+	/* the slave runs with the boundary as stop threshold, which does
+	 * not fit in the shm record; a truncated value makes the hw plugin
+	 * report an xrun from avail_update / htimestamp
+	 */
+	spcm->stop_threshold = spcm->boundary;
 }
 
 #undef COPY_SLAVE
@@ -1652,6 +2257,9 @@ int snd_pcm_direct_set_timer_params(snd_pcm_direct_t *dmix)
 	unsigned int filter;
 	int ret;
 
+	/* the timerfd period is set when the timer is started */
+	if (dmix->timerfd >= 0)
+		return 0;
 	snd_timer_params_set_auto_start(&params, 1);
 	if (dmix->type != SND_PCM_TYPE_DSNOOP)
 		snd_timer_params_set_early_event(&params, 1);
@@ -1927,6 +2535,7 @@ int snd_pcm_direct_parse_open_conf(snd_config_t *root, snd_config_t *conf,
 	rec->ipc_perm = 0600;
 	rec->ipc_gid = -1;
 	rec->slowptr = 1;
+	rec->ptr_refresh = 0;
 	rec->max_periods = 0;
 	rec->var_periodsize = 0;
 #ifdef LOCKLESS_DMIX_DEFAULT
@@ -1934,8 +2543,26 @@ int snd_pcm_direct_parse_open_conf(snd_config_t *root, snd_config_t *conf,
 #else
 	rec->direct_memory_access = 0;
 #endif
+	rec->mix_mode = SND_PCM_DIRECT_MIX_AUTO;
+	rec->mix_lock = SND_PCM_DIRECT_MIX_LOCK_SEMAPHORE;
+	rec->stage_slots = 16;
+	rec->stage_periods = 2;
 	rec->hw_ptr_alignment = SND_PCM_HW_PTR_ALIGNMENT_AUTO;
 	rec->tstamp_type = -1;
+	rec->wakeup = SND_PCM_DIRECT_WAKEUP_TIMER;
+	rec->stats = 0;
+	rec->zerocopy = 0;
+	rec->lockfree = 0;
+	rec->persist = 0;
+	rec->memfd = 0;
+	rec->history = 0;
+	rec->commit_frames = 0;
+	rec->gain = 0.0;
+	rec->volume = NULL;
+	rec->client_rate = 0;
+	err = snd_pcm_mem_parse(root, conf, &rec->mem);
+	if (err < 0)
+		return err;
 
 	/* read defaults */
 	if (snd_config_search(root, "defaults.pcm.dmix_max_periods", &n) >= 0) {
@@ -2020,6 +2647,23 @@ int snd_pcm_direct_parse_open_conf(snd_config_t *root, snd_config_t *conf,
 			}
 			continue;
 		}
+		if (strcmp(id, "wakeup") == 0) {
+			const char *str;
+			err = snd_config_get_string(n, &str);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				return -EINVAL;
+			}
+			if (strcmp(str, "timer") == 0)
+				rec->wakeup = SND_PCM_DIRECT_WAKEUP_TIMER;
+			else if (strcmp(str, "timerfd") == 0)
+				rec->wakeup = SND_PCM_DIRECT_WAKEUP_TIMERFD;
+			else {
+				SNDERR("The field wakeup is invalid : %s", str);
+				return -EINVAL;
+			}
+			continue;
+		}
 		if (strcmp(id, "ipc_gid") == 0) {
 			char *group;
 			char *endp;
@@ -2077,6 +2721,18 @@ int snd_pcm_direct_parse_open_conf(snd_config_t *root, snd_config_t *conf,
 			rec->slowptr = err;
 			continue;
 		}
+		if (strcmp(id, "ptr_refresh") == 0) {
+			long val;
+			err = snd_config_get_integer(n, &val);
+			if (err < 0)
+				return err;
+			if (val < 0) {
+				SNDERR("The field ptr_refresh must not be negative");
+				return -EINVAL;
+			}
+			rec->ptr_refresh = val;
+			continue;
+		}
 		if (strcmp(id, "max_periods") == 0) {
 			long val;
 			err = snd_config_get_integer(n, &val);
@@ -2099,6 +2755,156 @@ int snd_pcm_direct_parse_open_conf(snd_config_t *root, snd_config_t *conf,
 			rec->direct_memory_access = err;
 			continue;
 		}
+		if (strcmp(id, "mix_mode") == 0) {
+			const char *str;
+			err = snd_config_get_string(n, &str);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				return -EINVAL;
+			}
+			if (strcmp(str, "auto") == 0)
+				rec->mix_mode = SND_PCM_DIRECT_MIX_AUTO;
+			else if (strcmp(str, "semaphore") == 0)
+				rec->mix_mode = SND_PCM_DIRECT_MIX_SEMAPHORE;
+			else if (strcmp(str, "lockfree") == 0)
+				rec->mix_mode = SND_PCM_DIRECT_MIX_LOCKFREE;
+			else if (strcmp(str, "staging") == 0)
+				rec->mix_mode = SND_PCM_DIRECT_MIX_STAGING;
+			else {
+				SNDERR("The field mix_mode is invalid : %s", str);
+				return -EINVAL;
+			}
+			continue;
+		}
+		if (strcmp(id, "mix_lock") == 0) {
+			const char *str;
+			err = snd_config_get_string(n, &str);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				return -EINVAL;
+			}
+			if (strcmp(str, "semaphore") == 0)
+				rec->mix_lock = SND_PCM_DIRECT_MIX_LOCK_SEMAPHORE;
+			else if (strcmp(str, "mutex") == 0)
+				rec->mix_lock = SND_PCM_DIRECT_MIX_LOCK_MUTEX;
+			else {
+				SNDERR("The field mix_lock is invalid : %s", str);
+				return -EINVAL;
+			}
+			continue;
+		}
+		if (strcmp(id, "stage_slots") == 0) {
+			long val;
+			err = snd_config_get_integer(n, &val);
+			if (err < 0)
+				return err;
+			if (val < 1 || val > 256) {
+				SNDERR("The field stage_slots must be in range 1-256");
+				return -EINVAL;
+			}
+			rec->stage_slots = val;
+			continue;
+		}
+		if (strcmp(id, "stage_periods") == 0) {
+			long val;
+			err = snd_config_get_integer(n, &val);
+			if (err < 0)
+				return err;
+			if (val < 1) {
+				SNDERR("The field stage_periods must be positive");
+				return -EINVAL;
+			}
+			rec->stage_periods = val;
+			continue;
+		}
+		if (strcmp(id, "stats") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->stats = err;
+			continue;
+		}
+		if (strcmp(id, "zerocopy") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->zerocopy = err;
+			continue;
+		}
+		if (strcmp(id, "lockfree") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->lockfree = err;
+			continue;
+		}
+		if (strcmp(id, "memfd") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->memfd = err;
+			continue;
+		}
+		if (strcmp(id, "persist") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->persist = err;
+			continue;
+		}
+		if (strcmp(id, "history") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->history = err;
+			continue;
+		}
+		if (strcmp(id, "commit_frames") == 0) {
+			long val;
+			err = snd_config_get_integer(n, &val);
+			if (err < 0)
+				return err;
+			if (val < 0) {
+				SNDERR("The field commit_frames must not be negative");
+				return -EINVAL;
+			}
+			rec->commit_frames = val;
+			continue;
+		}
+		if (strcmp(id, "client_rate") == 0) {
+			long val;
+			err = snd_config_get_integer(n, &val);
+			if (err < 0)
+				return err;
+			if (val < 0) {
+				SNDERR("The field client_rate must not be negative");
+				return -EINVAL;
+			}
+			rec->client_rate = val;
+			continue;
+		}
+		if (strcmp(id, "gain") == 0) {
+			err = snd_config_get_ireal(n, &rec->gain);
+			if (err < 0) {
+				SNDERR("Invalid gain value");
+				return err;
+			}
+			if (rec->gain > 24.0) {
+				SNDERR("The field gain must not be above 24 dB");
+				return -EINVAL;
+			}
+			continue;
+		}
+#ifdef BUILD_PCM_PLUGIN_SOFTVOL
+		if (strcmp(id, "volume") == 0) {
+			if (snd_config_get_type(n) != SND_CONFIG_TYPE_COMPOUND) {
+				SNDERR("Invalid type for %s", id);
+				return -EINVAL;
+			}
+			rec->volume = n;
+			continue;
+		}
+#endif
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -2110,6 +2916,14 @@ int snd_pcm_direct_parse_open_conf(snd_config_t *root, snd_config_t *conf,
 		SNDERR("Unique IPC key is not defined");
 		return -EINVAL;
 	}
+	/* the gain is applied by the semaphore protected mixing code */
+	if (rec->mix_mode == SND_PCM_DIRECT_MIX_AUTO &&
+	    (rec->gain != 0.0 || rec->volume))
+		rec->mix_mode = SND_PCM_DIRECT_MIX_SEMAPHORE;
+	if (rec->mix_mode == SND_PCM_DIRECT_MIX_SEMAPHORE)
+		rec->direct_memory_access = 0;
+	else if (rec->mix_mode == SND_PCM_DIRECT_MIX_LOCKFREE)
+		rec->direct_memory_access = 1;
 	if (ipc_key_add_uid)
 		rec->ipc_key += getuid();
 	err = snd_pcm_direct_get_slave_ipc_offset(root, conf, stream);
@@ -2160,10 +2974,26 @@ int _snd_pcm_direct_new(snd_pcm_t **pcmp, snd_pcm_direct_t **_dmix, int type,
 	dmix->ipc_perm = opts->ipc_perm;
 	dmix->ipc_gid = opts->ipc_gid;
 	dmix->tstamp_type = opts->tstamp_type;
+	dmix->wakeup = opts->wakeup;
+	dmix->timerfd = -1;
 	dmix->semid = -1;
 	dmix->shmid = -1;
 	dmix->shmptr = (void *) -1;
+	dmix->stats_slot = -1;
+	dmix->mem = opts->mem;
+	dmix->ptr_refresh_ns = opts->ptr_refresh * 1000ULL;
 	dmix->type = type;
+	if (type == SND_PCM_TYPE_DMIX) {
+		/* must be known before the magic of the shm is checked */
+		dmix->u.dmix.staging = opts->mix_mode == SND_PCM_DIRECT_MIX_STAGING;
+		dmix->u.dmix.stage_slots = opts->stage_slots;
+		dmix->u.dmix.stage_periods = opts->stage_periods;
+		dmix->u.dmix.commit_frames = opts->commit_frames;
+		dmix->u.dmix.gain_unity = 1;
+		dmix->u.dmix.stage_slot = -1;
+		dmix->u.dmix.sum_fd = -1;
+		dmix->u.dmix.use_mutex = opts->mix_lock == SND_PCM_DIRECT_MIX_LOCK_MUTEX;
+	}
 
 	ret = snd_pcm_new(pcmp, type, name, stream, mode);
 	if (ret < 0)
@@ -2191,6 +3021,18 @@ int _snd_pcm_direct_new(snd_pcm_t **pcmp, snd_pcm_direct_t **_dmix, int type,
 		snd_pcm_direct_semaphore_up(dmix, DIRECT_IPC_SEM_CLIENT);
 		goto _err_nosem_free;
 	} else {
+		int err = snd_pcm_direct_mix_mutex_setup(dmix, ret);
+		if (err < 0) {
+			SNDERR("unable to initialize the mix mutex");
+			snd_pcm_direct_shm_discard(dmix);
+			snd_pcm_direct_semaphore_up(dmix, DIRECT_IPC_SEM_CLIENT);
+			ret = err;
+			goto _err_nosem_free;
+		}
+		if (opts->stats)
+			dmix->shmptr->stats.enabled = 1;
+		if (dmix->shmptr->stats.enabled)
+			snd_pcm_direct_stats_claim(dmix);
 		*_dmix = dmix;
 	}
 
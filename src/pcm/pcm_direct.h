@@ -55,6 +55,11 @@ typedef void (mix_areas_u8_t)(unsigned int size,
 			      volatile signed int *sum, size_t dst_step,
 			      size_t src_step, size_t sum_step);
 
+typedef void (mix_areas_float_t)(unsigned int size,
+				 volatile float *dst, float *src,
+				 volatile float *sum, size_t dst_step,
+				 size_t src_step, size_t sum_step);
+
 typedef enum snd_pcm_direct_hw_ptr_alignment {
 	SND_PCM_HW_PTR_ALIGNMENT_NO = 0,	/* use the hw_ptr as is and do no rounding */
 	SND_PCM_HW_PTR_ALIGNMENT_ROUNDUP = 1,	/* round the slave_appl_ptr up to slave_period */
@@ -62,6 +67,25 @@ typedef enum snd_pcm_direct_hw_ptr_alignment {
 	SND_PCM_HW_PTR_ALIGNMENT_AUTO = 3	/* automatic selection */
 } snd_pcm_direct_hw_ptr_alignment_t;
 
+typedef enum snd_pcm_direct_mix_mode {
+	SND_PCM_DIRECT_MIX_AUTO = 0,		/* selected by direct_memory_access */
+	SND_PCM_DIRECT_MIX_SEMAPHORE = 1,	/* mix into the slave buffer under the client semaphore */
+	SND_PCM_DIRECT_MIX_LOCKFREE = 2,	/* mix into the slave buffer with atomic operations */
+	SND_PCM_DIRECT_MIX_STAGING = 3		/* per-client staging slabs summed by a single reducer */
+} snd_pcm_direct_mix_mode_t;
+
+typedef enum snd_pcm_direct_mix_lock {
+	SND_PCM_DIRECT_MIX_LOCK_SEMAPHORE = 0,	/* the client semaphore (semop) */
+	SND_PCM_DIRECT_MIX_LOCK_MUTEX = 1	/* a robust process shared mutex in the shm */
+} snd_pcm_direct_mix_lock_t;
+
+typedef enum snd_pcm_direct_wakeup {
+	SND_PCM_DIRECT_WAKEUP_TIMER = 0,	/* slave PCM timer (timer_hw) */
+	SND_PCM_DIRECT_WAKEUP_TIMERFD = 1	/* timerfd on CLOCK_MONOTONIC */
+} snd_pcm_direct_wakeup_t;
+
+typedef struct snd_pcm_dmix_stage snd_pcm_dmix_stage_t;
+
 struct slave_params {
 	snd_pcm_format_t format;
 	int rate;
@@ -73,12 +97,42 @@ struct slave_params {
 	unsigned int periods;
 };
 
+#define SND_PCM_DIRECT_STATS_HIST	7	/* sem wait buckets: <1us, <10us ... >=100ms */
+#define SND_PCM_DIRECT_STATS_CLIENTS	16
+
+/*
+ * increment-only counters kept in the shm area when "stats" is enabled;
+ * updated with atomic adds, so that a monitor can read them at any time
+ */
+typedef struct {
+	unsigned int enabled;
+	unsigned int pad;
+	unsigned long long sem_waits;		/* client semaphore acquisitions */
+	unsigned long long sem_wait_ns;		/* total time spent waiting */
+	unsigned long long sem_wait_hist[SND_PCM_DIRECT_STATS_HIST];
+	unsigned long long mix_calls;		/* ring buffer syncs which moved data */
+	unsigned long long mix_ns;		/* total time spent in them */
+	unsigned long long mix_frames;		/* frames mixed/copied by them */
+	unsigned long long xruns;		/* xruns reported to the clients */
+	unsigned long long recoveries;		/* slave recoveries executed */
+	unsigned long long rewinds;		/* rewinds which remixed frames */
+	unsigned long long rewind_ns;		/* total time spent in them */
+	unsigned long long rewind_frames;	/* frames taken out of the mix */
+	struct {
+		int pid;			/* 0 = free slot */
+		unsigned int pad;
+		unsigned long long frames;
+	} client[SND_PCM_DIRECT_STATS_CLIENTS];
+} snd_pcm_direct_stats_t;
+
 /* shared among direct plugin clients - be careful to be 32/64bit compatible! */
 typedef struct {
 	unsigned int magic;			/* magic number */
 	char socket_name[256];			/* name of communication socket */
 	snd_pcm_type_t type;			/* PCM type (currently only hw) */
 	int use_server;
+	int persist;				/* server keeps the slave without clients */
+	int sum_memfd;				/* dmix sum buffer is a memfd sent by the server */
 	struct {
 		unsigned int format;
 		snd_interval_t rate;
@@ -123,11 +177,27 @@ typedef struct {
 	union {
 		struct {
 			unsigned long long chn_mask;
+			unsigned int lockfree;	/* slave recovery without the semaphore */
+			pid_t recover_owner;	/* client recovering the slave, 0 = none */
 		} dshare;
 	} u;
+	struct {
+		unsigned int seq;		/* odd while a client refreshes it */
+		unsigned int recoveries;	/* s.recoveries at the refresh */
+		unsigned long long tstamp;	/* CLOCK_MONOTONIC ns, 0 = none */
+		unsigned long long hw_ptr;	/* slave hw_ptr at tstamp */
+	} ptr_est;
+#ifdef THREAD_SAFE_API
+	struct {
+		unsigned int enabled;	/* mixing is serialized by the lock below */
+		pthread_mutex_t lock;	/* PTHREAD_PROCESS_SHARED, PTHREAD_MUTEX_ROBUST */
+	} mix_mutex;
+#endif
+	snd_pcm_direct_stats_t stats;
 } snd_pcm_direct_share_t;
 
 typedef struct snd_pcm_direct snd_pcm_direct_t;
+typedef struct snd_pcm_dsnoop_rate snd_pcm_dsnoop_rate_t;
 
 struct snd_pcm_direct {
 	snd_pcm_type_t type;		/* type (dmix, dsnoop, dshare) */
@@ -164,8 +234,11 @@ struct snd_pcm_direct {
 	int server_fd;
 	pid_t server_pid;
 	snd_timer_t *timer; 		/* timer used as poll_fd */
+	snd_pcm_direct_wakeup_t wakeup;	/* source of poll wakeups */
+	int timerfd;			/* timerfd used as poll_fd, -1 = none */
 	int interleaved;	 	/* we have interleaved buffer */
 	int slowptr;			/* use slow but more precise ptr updates */
+	unsigned long long ptr_refresh_ns; /* shared slowptr refresh interval, 0 = each call */
 	int max_periods;		/* max periods (-1 = fixed periods, 0 = max buffer size) */
 	int var_periodsize;		/* allow variable period size if max_periods is != -1*/
 	unsigned int channels;		/* client's channels */
@@ -174,9 +247,13 @@ struct snd_pcm_direct {
 	int direct_memory_access;	/* use arch-optimized buffer RW */
 	snd_pcm_direct_hw_ptr_alignment_t hw_ptr_alignment;
 	int tstamp_type;		/* cached from conf, can be -1(default) on top of real types */
+	int stats_slot;			/* own entry in shmptr->stats.client, -1 = none */
+	snd_pcm_mem_policy_t mem;	/* placement of the sum buffer */
 	union {
 		struct {
 			int shmid_sum;			/* IPC global sum ring buffer memory identification */
+			int sum_fd;			/* memfd of the sum buffer, -1 = SysV shm */
+			size_t sum_size;		/* mapped size of the memfd */
 			signed int *sum_buffer;		/* shared sum buffer */
 			mix_areas_16_t *mix_areas_16;
 			mix_areas_32_t *mix_areas_32;
@@ -186,11 +263,41 @@ struct snd_pcm_direct {
 			mix_areas_32_t *remix_areas_32;
 			mix_areas_24_t *remix_areas_24;
 			mix_areas_u8_t *remix_areas_u8;
+			mix_areas_float_t *mix_areas_float;
+			mix_areas_float_t *remix_areas_float;
 			unsigned int use_sem;
+			unsigned int use_mutex;		/* SND_PCM_DIRECT_MIX_LOCK_MUTEX is used */
+#ifdef THREAD_SAFE_API
+			pthread_mutex_t *mix_mutex;	/* lock in the shm, NULL = semaphore */
+#endif
+			unsigned int staging;		/* SND_PCM_DIRECT_MIX_STAGING is used */
+			unsigned int stage_slots;	/* number of client slabs */
+			unsigned int stage_periods;	/* slave periods mixed ahead of hw_ptr */
+			int stage_slot;			/* own slab index, -1 = none */
+			snd_pcm_dmix_stage_t *stage;	/* staging header (in the sum shm) */
+			void *stage_snap;		/* local copy of the slot states */
+			signed int *history;		/* own contributions, sum buffer layout */
+			unsigned int commit_frames;	/* commits below this are not mixed at once */
+			unsigned int gain_fixed;	/* option "gain", 16.16 fixed point */
+			struct snd_pcm_softvol_gain *volume; /* option "volume", NULL = none */
+			unsigned int *gain;		/* 16.16 gain per client channel, NULL = none */
+			unsigned int gain_unity;	/* all of gain[] are at unity */
 		} dmix;
 		struct {
 			unsigned long long chn_mask;
 		} dshare;
+		struct {
+			unsigned int zerocopy;		/* read the slave ring in place */
+			unsigned int shared;		/* zerocopy is in effect for this setup */
+			void *ring;			/* private read-only mapping of the slave ring */
+			size_t ring_size;
+			unsigned int rate_factor;	/* slave frames per client frame, 0 = same rate */
+			int shmid_rate;			/* shared converter segment, -1 = none */
+			snd_pcm_dsnoop_rate_t *rate;	/* its header */
+			int rate_slot;			/* own converter */
+			float *rate_coef;		/* decimation filter */
+			float *rate_scratch;		/* input frames of one channel */
+		} dsnoop;
 	} u;
 	void (*server_free)(snd_pcm_direct_t *direct);
 };
@@ -248,8 +355,14 @@ struct snd_pcm_direct {
 	snd1_pcm_direct_prepare
 #define snd_pcm_direct_resume \
 	snd1_pcm_direct_resume
+#define snd_pcm_direct_resync \
+	snd1_pcm_direct_resync
+#define snd_pcm_direct_timer_start \
+	snd1_pcm_direct_timer_start
 #define snd_pcm_direct_timer_stop \
 	snd1_pcm_direct_timer_stop
+#define snd_pcm_direct_timer_close \
+	snd1_pcm_direct_timer_close
 #define snd_pcm_direct_clear_timer_queue \
 	snd1_pcm_direct_clear_timer_queue
 #define snd_pcm_direct_set_timer_params \
@@ -270,8 +383,48 @@ struct snd_pcm_direct {
 	snd1_pcm_direct_check_xrun
 #define snd_pcm_direct_slave_recover \
 	snd1_pcm_direct_slave_recover
+#define snd_pcm_direct_slave_hw_ptr \
+	snd1_pcm_direct_slave_hw_ptr
+#define snd_pcm_direct_mix_mutex_setup \
+	snd1_pcm_direct_mix_mutex_setup
+#define snd_pcm_direct_mix_mutex_lock \
+	snd1_pcm_direct_mix_mutex_lock
+#define snd_pcm_direct_mix_mutex_unlock \
+	snd1_pcm_direct_mix_mutex_unlock
+#define snd_pcm_direct_stats_sem_wait \
+	snd1_pcm_direct_stats_sem_wait
+#define snd_pcm_direct_stats_mix \
+	snd1_pcm_direct_stats_mix
+#define snd_pcm_direct_stats_rewind \
+	snd1_pcm_direct_stats_rewind
+#define snd_pcm_direct_stats_dump_local \
+	snd1_pcm_direct_stats_dump_local
+
+static inline int snd_pcm_direct_stats_enabled(snd_pcm_direct_t *dmix)
+{
+	return dmix->shmptr != (void *) -1 && dmix->shmptr &&
+		dmix->shmptr->stats.enabled;
+}
+
+static inline unsigned long long snd_pcm_direct_stats_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void snd_pcm_direct_stats_sem_wait(snd_pcm_direct_t *dmix, unsigned long long ns);
+void snd_pcm_direct_stats_mix(snd_pcm_direct_t *dmix, unsigned long long ns,
+			      snd_pcm_uframes_t frames);
+void snd_pcm_direct_stats_rewind(snd_pcm_direct_t *dmix, unsigned long long ns,
+				 snd_pcm_uframes_t frames);
+void snd_pcm_direct_stats_dump_local(snd_pcm_direct_t *dmix, snd_output_t *out);
 
 int snd_pcm_direct_semaphore_create_or_connect(snd_pcm_direct_t *dmix);
+int snd_pcm_direct_mix_mutex_setup(snd_pcm_direct_t *dmix, int first_instance);
+int snd_pcm_direct_mix_mutex_lock(snd_pcm_direct_t *dmix);
+void snd_pcm_direct_mix_mutex_unlock(snd_pcm_direct_t *dmix);
 
 static inline int snd_pcm_direct_semaphore_discard(snd_pcm_direct_t *dmix)
 {
@@ -286,10 +439,18 @@ static inline int snd_pcm_direct_semaphore_discard(snd_pcm_direct_t *dmix)
 static inline int snd_pcm_direct_semaphore_down(snd_pcm_direct_t *dmix, int sem_num)
 {
 	struct sembuf op[2] = { { sem_num, 0, 0 }, { sem_num, 1, SEM_UNDO } };
-	int err = semop(dmix->semid, op, 2);
-	if (err == 0)
+	unsigned long long start = 0;
+	int err;
+
+	if (snd_pcm_direct_stats_enabled(dmix))
+		start = snd_pcm_direct_stats_now();
+	err = semop(dmix->semid, op, 2);
+	if (err == 0) {
 		dmix->locked[sem_num]++;
-	else if (err == -1)
+		if (start)
+			snd_pcm_direct_stats_sem_wait(dmix,
+				snd_pcm_direct_stats_now() - start);
+	} else if (err == -1)
 		err = -errno;
 	return err;
 }
@@ -342,7 +503,10 @@ int snd_pcm_direct_mmap(snd_pcm_t *pcm);
 int snd_pcm_direct_munmap(snd_pcm_t *pcm);
 int snd_pcm_direct_prepare(snd_pcm_t *pcm);
 int snd_pcm_direct_resume(snd_pcm_t *pcm);
+int snd_pcm_direct_resync(snd_pcm_t *pcm);
+int snd_pcm_direct_timer_start(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_timer_stop(snd_pcm_direct_t *dmix);
+void snd_pcm_direct_timer_close(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_clear_timer_queue(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_set_timer_params(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_open_secondary_client(snd_pcm_t **spcmp, snd_pcm_direct_t *dmix, const char *client_name);
@@ -352,6 +516,7 @@ snd_pcm_chmap_t *snd_pcm_direct_get_chmap(snd_pcm_t *pcm);
 int snd_pcm_direct_set_chmap(snd_pcm_t *pcm, const snd_pcm_chmap_t *map);
 int snd_pcm_direct_slave_recover(snd_pcm_direct_t *direct);
 int snd_pcm_direct_check_xrun(snd_pcm_direct_t *direct, snd_pcm_t *pcm);
+snd_pcm_uframes_t snd_pcm_direct_slave_hw_ptr(snd_pcm_direct_t *direct, int extrapolate);
 int snd_timer_async(snd_timer_t *timer, int sig, pid_t pid);
 struct timespec snd_pcm_hw_fast_tstamp(snd_pcm_t *pcm);
 void snd_pcm_direct_reset_slave_ptr(snd_pcm_t *pcm, snd_pcm_direct_t *dmix, snd_pcm_uframes_t hw_ptr);
@@ -361,11 +526,28 @@ struct snd_pcm_direct_open_conf {
 	mode_t ipc_perm;
 	int ipc_gid;
 	int slowptr;
+	unsigned int ptr_refresh;
 	int max_periods;
 	int var_periodsize;
 	int direct_memory_access;
+	snd_pcm_direct_mix_mode_t mix_mode;
+	snd_pcm_direct_mix_lock_t mix_lock;
+	unsigned int stage_slots;
+	unsigned int stage_periods;
 	snd_pcm_direct_hw_ptr_alignment_t hw_ptr_alignment;
 	int tstamp_type;
+	snd_pcm_direct_wakeup_t wakeup;
+	int stats;
+	int zerocopy;
+	int lockfree;
+	int persist;
+	int memfd;
+	int history;
+	unsigned int commit_frames;
+	double gain;
+	snd_config_t *volume;
+	unsigned int client_rate;
+	snd_pcm_mem_policy_t mem;
 	snd_config_t *slave;
 	snd_config_t *bindings;
 };
@@ -26,6 +26,7 @@
  *
  */
   
+#include "config.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
@@ -42,8 +43,9 @@
 #include <sys/wait.h>
 #include <sys/socket.h>
 #include <sys/un.h>
-#include <sys/mman.h>
+#include <sys/stat.h>
 #include "pcm_direct.h"
+#include "pcm_plugin.h"
 
 #ifndef PIC
 /* entry for static linking */
@@ -53,14 +55,90 @@ const char *_snd_module_pcm_dmix = "";
 #ifndef DOC_HIDDEN
 /* start is pending - this state happens when rate plugin does a delayed commit */
 #define STATE_RUN_PENDING	1024
+
+/* client gain (options "gain" and "volume"), 16.16 fixed point */
+#define DMIX_GAIN_SHIFT		16
+#define DMIX_GAIN_UNITY		(1U << DMIX_GAIN_SHIFT)
 #endif
 
+static inline unsigned int dmix_gain(snd_pcm_direct_t *dmix, unsigned int chn)
+{
+	return dmix->u.dmix.gain_unity ? DMIX_GAIN_UNITY : dmix->u.dmix.gain[chn];
+}
+
 /*
  *
  */
 
 static int shm_sum_discard(snd_pcm_direct_t *dmix);
 
+#include "pcm_dmix_stage.c"
+
+#ifdef MFD_ALLOW_SEALING
+#define MEMFD_SUM_HUGEPAGE	(2UL * 1024 * 1024)
+
+/*
+ * memfd sum buffer (memfd option): created by the first client before
+ * it forks the server, the others get the fd from the server socket.
+ * It goes away with the last fd and mapping, also after a crash, and
+ * is not limited by kernel.shmmax.  The size is sealed, so that no
+ * client can truncate it under the mappings of the others.
+ */
+static int memfd_sum_map(snd_pcm_direct_t *dmix, size_t size)
+{
+	struct stat st;
+	void *ptr;
+	int fd = dmix->u.dmix.sum_fd;
+	int err;
+
+	if (fd < 0) {
+		size_t alloc = size;
+#ifdef MFD_HUGETLB
+		if (dmix->mem.hugepages) {
+			fd = memfd_create("alsa-dmix-sum", MFD_CLOEXEC |
+					  MFD_ALLOW_SEALING | MFD_HUGETLB);
+			alloc = (size + MEMFD_SUM_HUGEPAGE - 1) & ~(MEMFD_SUM_HUGEPAGE - 1);
+			if (fd >= 0 && ftruncate(fd, alloc) < 0) {
+				close(fd);
+				fd = -1;
+			}
+		}
+#endif
+		if (fd < 0) {
+			fd = memfd_create("alsa-dmix-sum", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+			if (fd < 0)
+				return -errno;
+			alloc = size;
+			if (ftruncate(fd, alloc) < 0) {
+				err = -errno;
+				close(fd);
+				return err;
+			}
+		}
+		/* not fatal, e.g. hugetlbfs of old kernels has no seals */
+		fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+		dmix->u.dmix.sum_fd = fd;
+	}
+	if (fstat(fd, &st) < 0)
+		return -errno;
+	if ((size_t)st.st_size < size) {
+		SNDERR("the sum buffer memfd is too small");
+		return -EINVAL;
+	}
+	ptr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (ptr == MAP_FAILED)
+		return -errno;
+#ifdef MADV_HUGEPAGE
+	/* transparent huge pages as fallback, if shmem allows them */
+	if (dmix->mem.hugepages)
+		madvise(ptr, st.st_size, MADV_HUGEPAGE);
+#endif
+	dmix->u.dmix.sum_buffer = ptr;
+	dmix->u.dmix.sum_size = st.st_size;
+	return 0;
+}
+#endif
+
 /*
  *  sum ring buffer shared memory area 
  */
@@ -73,9 +151,31 @@ static int shm_sum_create_or_connect(snd_pcm_direct_t *dmix)
 	size = dmix->shmptr->s.channels *
 	       dmix->shmptr->s.buffer_size *
 	       sizeof(signed int);	
+	if (dmix->u.dmix.staging)
+		size = stage_sum_size(dmix) + stage_shm_size(dmix);
+	if (dmix->shmptr->sum_memfd) {
+#ifdef MFD_ALLOW_SEALING
+		dmix->u.dmix.shmid_sum = -1;
+		err = memfd_sum_map(dmix, size);
+		if (err < 0) {
+			shm_sum_discard(dmix);
+			return err;
+		}
+		goto __mapped;
+#else
+		return -ENOSYS;
+#endif
+	}
 retryshm:
-	dmix->u.dmix.shmid_sum = shmget(dmix->ipc_key + 1, size,
-					IPC_CREAT | dmix->ipc_perm);
+	dmix->u.dmix.shmid_sum = -1;
+#ifdef SHM_HUGETLB
+	if (dmix->mem.hugepages)
+		dmix->u.dmix.shmid_sum = shmget(dmix->ipc_key + 1, size,
+						IPC_CREAT | SHM_HUGETLB | dmix->ipc_perm);
+#endif
+	if (dmix->u.dmix.shmid_sum < 0)
+		dmix->u.dmix.shmid_sum = shmget(dmix->ipc_key + 1, size,
+						IPC_CREAT | dmix->ipc_perm);
 	err = -errno;
 	if (dmix->u.dmix.shmid_sum < 0) {
 		if (errno == EINVAL)
@@ -102,7 +202,17 @@ retryshm:
 		shm_sum_discard(dmix);
 		return err;
 	}
+ __mapped:
+	if (dmix->mem.node >= 0)
+		snd_pcm_mem_bind(&dmix->mem, dmix->u.dmix.sum_buffer, size);
 	mlock(dmix->u.dmix.sum_buffer, size);
+	if (dmix->u.dmix.staging) {
+		err = stage_attach(dmix);
+		if (err < 0) {
+			shm_sum_discard(dmix);
+			return err;
+		}
+	}
 	return 0;
 }
 
@@ -111,6 +221,15 @@ static int shm_sum_discard(snd_pcm_direct_t *dmix)
 	struct shmid_ds buf;
 	int ret = 0;
 
+	if (dmix->u.dmix.sum_fd >= 0) {
+		if (dmix->u.dmix.sum_buffer != (void *) -1 &&
+		    dmix->u.dmix.sum_buffer != NULL)
+			munmap(dmix->u.dmix.sum_buffer, dmix->u.dmix.sum_size);
+		dmix->u.dmix.sum_buffer = (void *) -1;
+		close(dmix->u.dmix.sum_fd);
+		dmix->u.dmix.sum_fd = -1;
+		return 0;
+	}
 	if (dmix->u.dmix.shmid_sum < 0)
 		return -EINVAL;
 	if (dmix->u.dmix.sum_buffer != (void *) -1 && shmdt(dmix->u.dmix.sum_buffer) < 0)
@@ -130,7 +249,8 @@ static int shm_sum_discard(snd_pcm_direct_t *dmix)
 static void dmix_server_free(snd_pcm_direct_t *dmix)
 {
 	/* remove the memory region */
-	shm_sum_create_or_connect(dmix);
+	if (dmix->u.dmix.sum_fd < 0)
+		shm_sum_create_or_connect(dmix);
 	shm_sum_discard(dmix);
 }
 
@@ -151,6 +271,267 @@ static void dmix_server_free(snd_pcm_direct_t *dmix)
 #endif
 #endif
 
+/*
+ * client gain: the samples are scaled while they are added to the sum,
+ * so no softvol pass into a bounce buffer is needed in front of dmix.
+ * The kernels work like the generic ones and need the semaphore.  One
+ * inline body is instantiated per format; the unity gain keeps using
+ * the usual kernels.
+ */
+static inline __attribute__((always_inline))
+signed int gain_read(snd_pcm_format_t format, const unsigned char *src)
+{
+	switch (format) {
+	case SND_PCM_FORMAT_S16_LE:
+	case SND_PCM_FORMAT_S16_BE: {
+		signed short v = *(const signed short *)src;
+		return format == SND_PCM_FORMAT_S16 ? v : (signed short)bswap_16(v);
+	}
+	case SND_PCM_FORMAT_S32_LE:
+	case SND_PCM_FORMAT_S32_BE: {
+		signed int v = *(const signed int *)src;
+		return (format == SND_PCM_FORMAT_S32 ? v : (signed int)bswap_32(v)) >> 8;
+	}
+	case SND_PCM_FORMAT_U8:
+		return *src - 0x80;
+	default:	/* S24_LE, S24_3LE */
+		return src[0] | (src[1] << 8) | (((signed char *)src)[2] << 16);
+	}
+}
+
+/* the slave sample was cleared after playback: restart the sum */
+static inline __attribute__((always_inline))
+int gain_silent(snd_pcm_format_t format, const unsigned char *dst)
+{
+	switch (format) {
+	case SND_PCM_FORMAT_S16_LE:
+	case SND_PCM_FORMAT_S16_BE:
+		return !*(const signed short *)dst;
+	case SND_PCM_FORMAT_S32_LE:
+	case SND_PCM_FORMAT_S32_BE:
+		return !*(const signed int *)dst;
+	case SND_PCM_FORMAT_U8:
+		return *dst == 0x80;
+	default:
+		return !(dst[0] | dst[1] | dst[2]);
+	}
+}
+
+static inline __attribute__((always_inline))
+void gain_write(snd_pcm_format_t format, unsigned char *dst, signed int sample)
+{
+	switch (format) {
+	case SND_PCM_FORMAT_S16_LE:
+	case SND_PCM_FORMAT_S16_BE:
+		if (sample > 0x7fff)
+			sample = 0x7fff;
+		else if (sample < -0x8000)
+			sample = -0x8000;
+		*(signed short *)dst = format == SND_PCM_FORMAT_S16 ?
+			sample : (signed short)bswap_16(sample);
+		break;
+	case SND_PCM_FORMAT_S32_LE:
+	case SND_PCM_FORMAT_S32_BE:
+		if (sample > 0x7fffff)
+			sample = 0x7fffffff;
+		else if (sample < -0x800000)
+			sample = -0x80000000;
+		else
+			sample *= 256;
+		*(signed int *)dst = format == SND_PCM_FORMAT_S32 ?
+			sample : (signed int)bswap_32(sample);
+		break;
+	case SND_PCM_FORMAT_U8:
+		if (sample > 0x7f)
+			sample = 0x7f;
+		else if (sample < -0x80)
+			sample = -0x80;
+		*dst = sample + 0x80;
+		break;
+	default:
+		if (sample > 0x7fffff)
+			sample = 0x7fffff;
+		else if (sample < -0x800000)
+			sample = -0x800000;
+		dst[0] = sample;
+		dst[1] = sample >> 8;
+		dst[2] = sample >> 16;
+		break;
+	}
+}
+
+/* gain is negative for the remix */
+static inline __attribute__((always_inline))
+void gain_mix(snd_pcm_format_t format, unsigned int size,
+	      unsigned char *dst, const unsigned char *src, signed int *sum,
+	      size_t dst_step, size_t src_step, size_t sum_step,
+	      long long gain)
+{
+	signed int sample;
+
+	for (; size--; dst += dst_step, src += src_step,
+	     sum = (signed int *)((char *)sum + sum_step)) {
+		sample = (gain_read(format, src) * gain) >> DMIX_GAIN_SHIFT;
+		if (!gain_silent(format, dst))
+			sample += *sum;
+		*sum = sample;
+		gain_write(format, dst, sample);
+	}
+}
+
+static void gain_mix_float(unsigned int size, float *dst, const float *src,
+			   float *sum, size_t dst_step, size_t src_step,
+			   size_t sum_step, float gain)
+{
+	float sample;
+
+	for (; size--; dst = (float *)((char *)dst + dst_step),
+	     src = (const float *)((const char *)src + src_step),
+	     sum = (float *)((char *)sum + sum_step)) {
+		sample = *src * gain;
+		if (*dst != 0.0f)
+			sample += *sum;
+		*sum = sample;
+		*dst = dmix_float_limit(sample);
+	}
+}
+
+static void gain_mix1(snd_pcm_direct_t *dmix, unsigned int size,
+		      unsigned char *dst, const unsigned char *src,
+		      signed int *sum, size_t dst_step, size_t src_step,
+		      size_t sum_step, long long gain)
+{
+	switch (dmix->shmptr->s.format) {
+	case SND_PCM_FORMAT_S16_LE:
+		gain_mix(SND_PCM_FORMAT_S16_LE, size, dst, src, sum,
+			 dst_step, src_step, sum_step, gain);
+		break;
+	case SND_PCM_FORMAT_S16_BE:
+		gain_mix(SND_PCM_FORMAT_S16_BE, size, dst, src, sum,
+			 dst_step, src_step, sum_step, gain);
+		break;
+	case SND_PCM_FORMAT_S32_LE:
+		gain_mix(SND_PCM_FORMAT_S32_LE, size, dst, src, sum,
+			 dst_step, src_step, sum_step, gain);
+		break;
+	case SND_PCM_FORMAT_S32_BE:
+		gain_mix(SND_PCM_FORMAT_S32_BE, size, dst, src, sum,
+			 dst_step, src_step, sum_step, gain);
+		break;
+	case SND_PCM_FORMAT_S24_LE:
+	case SND_PCM_FORMAT_S24_3LE:
+		gain_mix(SND_PCM_FORMAT_S24_3LE, size, dst, src, sum,
+			 dst_step, src_step, sum_step, gain);
+		break;
+	case SND_PCM_FORMAT_U8:
+		gain_mix(SND_PCM_FORMAT_U8, size, dst, src, sum,
+			 dst_step, src_step, sum_step, gain);
+		break;
+	case SND_PCM_FORMAT_FLOAT:
+		gain_mix_float(size, (float *)dst, (const float *)src,
+			       (float *)sum, dst_step, src_step, sum_step,
+			       (float)gain / DMIX_GAIN_UNITY);
+		break;
+	default:
+		break;
+	}
+}
+
+/* like mix_areas() below, one channel at a time as the gains may differ */
+static void gain_mix_areas(snd_pcm_direct_t *dmix,
+			   const snd_pcm_channel_area_t *src_areas,
+			   const snd_pcm_channel_area_t *dst_areas,
+			   snd_pcm_uframes_t src_ofs,
+			   snd_pcm_uframes_t dst_ofs,
+			   snd_pcm_uframes_t size,
+			   int remix)
+{
+	unsigned int src_step, dst_step;
+	unsigned int chn, dchn;
+	long long gain;
+
+	for (chn = 0; chn < dmix->channels; chn++) {
+		dchn = dmix->bindings ? dmix->bindings[chn] : chn;
+		if (dchn >= dmix->shmptr->s.channels)
+			continue;
+		gain = dmix->u.dmix.gain[chn];
+		src_step = src_areas[chn].step / 8;
+		dst_step = dst_areas[dchn].step / 8;
+		gain_mix1(dmix, size,
+			  ((unsigned char *)dst_areas[dchn].addr + dst_areas[dchn].first / 8) + dst_ofs * dst_step,
+			  ((unsigned char *)src_areas[chn].addr + src_areas[chn].first / 8) + src_ofs * src_step,
+			  dmix->u.dmix.sum_buffer + dmix->shmptr->s.channels * dst_ofs + dchn,
+			  dst_step,
+			  src_step,
+			  dmix->shmptr->s.channels * sizeof(signed int),
+			  remix ? -gain : gain);
+	}
+}
+
+/*
+ * refresh the gains from the volume control (if any), combined with the
+ * fixed gain
+ */
+static void gain_update(snd_pcm_direct_t *dmix)
+{
+	unsigned int *gain = dmix->u.dmix.gain;
+	unsigned int chn, unity = 1;
+
+	for (chn = 0; chn < dmix->channels; chn++)
+		gain[chn] = DMIX_GAIN_UNITY;
+#ifdef BUILD_PCM_PLUGIN_SOFTVOL
+	if (dmix->u.dmix.volume)
+		snd_pcm_softvol_gain_scales(dmix->u.dmix.volume, gain,
+					    dmix->channels);
+#endif
+	for (chn = 0; chn < dmix->channels; chn++) {
+		if (dmix->u.dmix.gain_fixed != DMIX_GAIN_UNITY)
+			gain[chn] = ((unsigned long long)gain[chn] *
+				     dmix->u.dmix.gain_fixed) >> DMIX_GAIN_SHIFT;
+		if (gain[chn] != DMIX_GAIN_UNITY)
+			unity = 0;
+	}
+	dmix->u.dmix.gain_unity = unity;
+}
+
+static int gain_open(snd_pcm_direct_t *dmix,
+		     struct snd_pcm_direct_open_conf *opts)
+{
+#ifdef BUILD_PCM_PLUGIN_SOFTVOL
+	int err;
+#endif
+
+	dmix->u.dmix.gain_fixed = pow(10.0, opts->gain / 20.0) *
+				  DMIX_GAIN_UNITY + 0.5;
+#ifdef BUILD_PCM_PLUGIN_SOFTVOL
+	if (opts->volume) {
+		err = snd_pcm_softvol_gain_open(&dmix->u.dmix.volume,
+						dmix->spcm, opts->volume);
+		if (err < 0)
+			return err;
+	}
+#endif
+	if (dmix->u.dmix.gain_fixed == DMIX_GAIN_UNITY && !dmix->u.dmix.volume)
+		return 0;
+	if (!dmix->u.dmix.staging && !dmix->u.dmix.use_sem) {
+		SNDERR("gain and volume need the semaphore mix_mode");
+		return -EINVAL;
+	}
+	dmix->u.dmix.gain = malloc(dmix->channels * sizeof(unsigned int));
+	if (dmix->u.dmix.gain == NULL)
+		return -ENOMEM;
+	gain_update(dmix);
+	return 0;
+}
+
+static void gain_close(snd_pcm_direct_t *dmix)
+{
+#ifdef BUILD_PCM_PLUGIN_SOFTVOL
+	snd_pcm_softvol_gain_close(dmix->u.dmix.volume);
+#endif
+	free(dmix->u.dmix.gain);
+}
+
 static void mix_areas(snd_pcm_direct_t *dmix,
 		      const snd_pcm_channel_area_t *src_areas,
 		      const snd_pcm_channel_area_t *dst_areas,
@@ -162,6 +543,10 @@ static void mix_areas(snd_pcm_direct_t *dmix,
 	unsigned int chn, dchn, channels, sample_size;
 	mix_areas_t *do_mix_areas;
 	
+	if (!dmix->u.dmix.gain_unity) {
+		gain_mix_areas(dmix, src_areas, dst_areas, src_ofs, dst_ofs, size, 0);
+		return;
+	}
 	channels = dmix->channels;
 	switch (dmix->shmptr->s.format) {
 	case SND_PCM_FORMAT_S16_LE:
@@ -186,6 +571,10 @@ static void mix_areas(snd_pcm_direct_t *dmix,
 		sample_size = 1;
 		do_mix_areas = (mix_areas_t *)dmix->u.dmix.mix_areas_u8;
 		break;
+	case SND_PCM_FORMAT_FLOAT:
+		sample_size = 4;
+		do_mix_areas = (mix_areas_t *)dmix->u.dmix.mix_areas_float;
+		break;
 	default:
 		return;
 	}
@@ -230,6 +619,10 @@ static void remix_areas(snd_pcm_direct_t *dmix,
 	unsigned int chn, dchn, channels, sample_size;
 	mix_areas_t *do_remix_areas;
 	
+	if (!dmix->u.dmix.gain_unity) {
+		gain_mix_areas(dmix, src_areas, dst_areas, src_ofs, dst_ofs, size, 1);
+		return;
+	}
 	channels = dmix->channels;
 	switch (dmix->shmptr->s.format) {
 	case SND_PCM_FORMAT_S16_LE:
@@ -254,6 +647,10 @@ static void remix_areas(snd_pcm_direct_t *dmix,
 		sample_size = 1;
 		do_remix_areas = (mix_areas_t *)dmix->u.dmix.remix_areas_u8;
 		break;
+	case SND_PCM_FORMAT_FLOAT:
+		sample_size = 4;
+		do_remix_areas = (mix_areas_t *)dmix->u.dmix.remix_areas_float;
+		break;
 	default:
 		return;
 	}
@@ -287,33 +684,117 @@ static void remix_areas(snd_pcm_direct_t *dmix,
 	}
 }
 
+/*
+ * contribution history (option "history"): the frames mixed by this
+ * client are also kept in the layout of the sum buffer, so a rewind
+ * subtracts them from the sum in one pass over whole slave frames
+ * instead of reading and converting the client buffer again
+ */
+static void history_store(snd_pcm_direct_t *dmix,
+			  const snd_pcm_channel_area_t *src_areas,
+			  snd_pcm_uframes_t src_ofs,
+			  snd_pcm_uframes_t dst_ofs,
+			  snd_pcm_uframes_t size)
+{
+	unsigned int chn, dchn, schannels = dmix->shmptr->s.channels;
+	signed int *hist = dmix->u.dmix.history + dst_ofs * schannels;
+	const snd_pcm_channel_area_t *area;
+
+	if (dmix->interleaved && dmix->u.dmix.gain_unity) {
+		unsigned int width = snd_pcm_format_physical_width(dmix->shmptr->s.format) / 8;
+		stage_decode(dmix, hist,
+			     (const unsigned char *)src_areas[0].addr +
+			     width * src_ofs * dmix->channels,
+			     width, 1, size * dmix->channels, DMIX_GAIN_UNITY);
+		return;
+	}
+	for (chn = 0; chn < dmix->channels; chn++) {
+		dchn = dmix->bindings ? dmix->bindings[chn] : chn;
+		if (dchn >= schannels)
+			continue;
+		area = &src_areas[chn];
+		stage_decode(dmix, hist + dchn,
+			     (const unsigned char *)area->addr + area->first / 8 +
+			     src_ofs * (area->step / 8),
+			     area->step / 8, schannels, size,
+			     dmix_gain(dmix, chn));
+	}
+}
+
+static void history_remix(snd_pcm_direct_t *dmix,
+			  const snd_pcm_channel_area_t *dst_areas,
+			  snd_pcm_uframes_t dst_ofs,
+			  snd_pcm_uframes_t size)
+{
+	unsigned int chn, dchn, schannels = dmix->shmptr->s.channels;
+	signed int *sum = dmix->u.dmix.sum_buffer + dst_ofs * schannels;
+	const signed int *hist = dmix->u.dmix.history + dst_ofs * schannels;
+	const snd_pcm_channel_area_t *area;
+	size_t k, n = size * schannels;
+
+	/* channels not written by this client have a zero history */
+	for (k = 0; k < n; k++)
+		sum[k] -= hist[k];
+	/* only the own channels: the sum of the others may be stale */
+	for (chn = 0; chn < dmix->channels; chn++) {
+		dchn = dmix->bindings ? dmix->bindings[chn] : chn;
+		if (dchn >= schannels)
+			continue;
+		area = &dst_areas[dchn];
+		stage_encode(dmix, (unsigned char *)area->addr + area->first / 8 +
+			     dst_ofs * (area->step / 8),
+			     sum + dchn, area->step / 8, schannels, size);
+	}
+}
+
 /*
  * if no concurrent access is allowed in the mixing routines, we need to protect
  * the area via semaphore
  */
 #ifndef DOC_HIDDEN
-static void dmix_down_sem(snd_pcm_direct_t *dmix)
+static int dmix_down_sem(snd_pcm_direct_t *dmix)
 {
-	if (dmix->u.dmix.use_sem)
-		snd_pcm_direct_semaphore_down(dmix, DIRECT_IPC_SEM_CLIENT);
+	if (!dmix->u.dmix.use_sem)
+		return 0;
+#ifdef THREAD_SAFE_API
+	if (dmix->u.dmix.mix_mutex) {
+		int err = snd_pcm_direct_mix_mutex_lock(dmix);
+		if (err != -ENOTRECOVERABLE)
+			return err;
+		/* the mutex fails for every client from now on, so all of
+		 * them end up here and the semaphore takes over the mixing
+		 */
+		SNDERR("dmix mixing lock is not recoverable, using the semaphore");
+		dmix->u.dmix.mix_mutex = NULL;
+	}
+#endif
+	return snd_pcm_direct_semaphore_down(dmix, DIRECT_IPC_SEM_CLIENT);
 }
 
 static void dmix_up_sem(snd_pcm_direct_t *dmix)
 {
-	if (dmix->u.dmix.use_sem)
-		snd_pcm_direct_semaphore_up(dmix, DIRECT_IPC_SEM_CLIENT);
+	if (!dmix->u.dmix.use_sem)
+		return;
+#ifdef THREAD_SAFE_API
+	if (dmix->u.dmix.mix_mutex) {
+		snd_pcm_direct_mix_mutex_unlock(dmix);
+		return;
+	}
+#endif
+	snd_pcm_direct_semaphore_up(dmix, DIRECT_IPC_SEM_CLIENT);
 }
 #endif
 
 /*
  *  synchronize shm ring buffer with hardware
  */
-static void snd_pcm_dmix_sync_area(snd_pcm_t *pcm)
+static int snd_pcm_dmix_sync_area0(snd_pcm_t *pcm)
 {
 	snd_pcm_direct_t *dmix = pcm->private_data;
 	snd_pcm_uframes_t slave_hw_ptr, slave_appl_ptr, slave_size;
-	snd_pcm_uframes_t appl_ptr, size, transfer;
+	snd_pcm_uframes_t appl_ptr, size, transfer, slave_begin;
 	const snd_pcm_channel_area_t *src_areas, *dst_areas;
+	int err;
 	
 	/* calculate the size to transfer */
 	/* check the available size in the local buffer
@@ -321,7 +802,7 @@ static void snd_pcm_dmix_sync_area(snd_pcm_t *pcm)
 	 */
 	size = pcm_frame_diff2(dmix->appl_ptr, dmix->last_appl_ptr, pcm->boundary);
 	if (! size)
-		return;
+		return 0;
 
 	/* the slave_app_ptr can be far behind the slave_hw_ptr */
 	/* reduce mixing and errors here - just skip not catched writes */
@@ -336,7 +817,7 @@ static void snd_pcm_dmix_sync_area(snd_pcm_t *pcm)
 		dmix->slave_appl_ptr %= dmix->slave_boundary;
 		size = pcm_frame_diff2(dmix->appl_ptr, dmix->last_appl_ptr, pcm->boundary);
 		if (! size)
-			return;
+			return 0;
 	}
 
 	/* check the available size in the slave PCM buffer */
@@ -352,25 +833,38 @@ static void snd_pcm_dmix_sync_area(snd_pcm_t *pcm)
 	if (slave_size < size)
 		size = slave_size;
 	if (! size)
-		return;
+		return 0;
 
+	if (dmix->u.dmix.volume)
+		gain_update(dmix);
+	/* nothing is taken from the client buffer without the lock */
+	if (!dmix->u.dmix.staging) {
+		err = dmix_down_sem(dmix);
+		if (err < 0)
+			return err;
+	}
 	/* add sample areas here */
 	src_areas = snd_pcm_mmap_areas(pcm);
 	dst_areas = snd_pcm_mmap_areas(dmix->spcm);
 	appl_ptr = dmix->last_appl_ptr % pcm->buffer_size;
 	dmix->last_appl_ptr += size;
 	dmix->last_appl_ptr %= pcm->boundary;
+	slave_begin = dmix->slave_appl_ptr;
 	slave_appl_ptr = dmix->slave_appl_ptr % dmix->slave_buffer_size;
 	dmix->slave_appl_ptr += size;
 	dmix->slave_appl_ptr %= dmix->slave_boundary;
-	dmix_down_sem(dmix);
 	for (;;) {
 		transfer = size;
 		if (appl_ptr + transfer > pcm->buffer_size)
 			transfer = pcm->buffer_size - appl_ptr;
 		if (slave_appl_ptr + transfer > dmix->slave_buffer_size)
 			transfer = dmix->slave_buffer_size - slave_appl_ptr;
-		mix_areas(dmix, src_areas, dst_areas, appl_ptr, slave_appl_ptr, transfer);
+		if (dmix->u.dmix.staging)
+			stage_copy_areas(dmix, src_areas, appl_ptr, slave_appl_ptr, transfer);
+		else
+			mix_areas(dmix, src_areas, dst_areas, appl_ptr, slave_appl_ptr, transfer);
+		if (dmix->u.dmix.history)
+			history_store(dmix, src_areas, appl_ptr, slave_appl_ptr, transfer);
 		size -= transfer;
 		if (! size)
 			break;
@@ -379,7 +873,35 @@ static void snd_pcm_dmix_sync_area(snd_pcm_t *pcm)
 		appl_ptr += transfer;
 		appl_ptr %= pcm->buffer_size;
 	}
-	dmix_up_sem(dmix);
+	if (dmix->u.dmix.staging) {
+		stage_mark_dirty(dmix, slave_begin, dmix->slave_appl_ptr);
+		stage_commit(dmix, slave_begin, dmix->slave_appl_ptr);
+	} else
+		dmix_up_sem(dmix);
+	return 0;
+}
+
+static int snd_pcm_dmix_sync_area(snd_pcm_t *pcm)
+{
+	snd_pcm_direct_t *dmix = pcm->private_data;
+	snd_pcm_uframes_t last_appl_ptr = dmix->last_appl_ptr;
+	unsigned long long start = 0;
+	int stats = snd_pcm_direct_stats_enabled(dmix);
+	int err;
+
+	if (stats)
+		start = snd_pcm_direct_stats_now();
+	err = snd_pcm_dmix_sync_area0(pcm);
+	if (err < 0)
+		return err;
+	/* the slabs are mixed also when there's nothing new to write */
+	if (dmix->u.dmix.staging)
+		stage_mix(dmix);
+	if (stats)
+		snd_pcm_direct_stats_mix(dmix, snd_pcm_direct_stats_now() - start,
+					 pcm_frame_diff(dmix->last_appl_ptr, last_appl_ptr,
+							pcm->boundary));
+	return 0;
 }
 
 /*
@@ -408,7 +930,7 @@ static int snd_pcm_dmix_sync_ptr0(snd_pcm_t *pcm, snd_pcm_uframes_t slave_hw_ptr
 	if (avail > dmix->avail_max)
 		dmix->avail_max = avail;
 	if (avail >= pcm->stop_threshold) {
-		snd_timer_stop(dmix->timer);
+		snd_pcm_direct_timer_stop(dmix);
 		gettimestamp(&dmix->trigger_tstamp, pcm->tstamp_type);
 		if (dmix->state == SND_PCM_STATE_RUNNING) {
 			dmix->state = SND_PCM_STATE_XRUN;
@@ -427,9 +949,7 @@ static int snd_pcm_dmix_sync_ptr(snd_pcm_t *pcm)
 	snd_pcm_uframes_t slave_hw_ptr;
 	int err;
 
-	if (dmix->slowptr)
-		snd_pcm_hwsync(dmix->spcm);
-	slave_hw_ptr = *dmix->spcm->hw.ptr;
+	slave_hw_ptr = snd_pcm_direct_slave_hw_ptr(dmix, 1);
 	err = snd_pcm_direct_check_xrun(dmix, pcm);
 	if (err < 0)
 		return err;
@@ -541,7 +1061,7 @@ static int snd_pcm_dmix_start_timer(snd_pcm_t *pcm, snd_pcm_direct_t *dmix)
 
 	snd_pcm_hwsync(dmix->spcm);
 	snd_pcm_direct_reset_slave_ptr(pcm, dmix, *dmix->spcm->hw.ptr);
-	err = snd_timer_start(dmix->timer);
+	err = snd_pcm_direct_timer_start(dmix);
 	if (err < 0)
 		return err;
 	dmix->state = SND_PCM_STATE_RUNNING;
@@ -564,7 +1084,8 @@ static int snd_pcm_dmix_start(snd_pcm_t *pcm)
 	else {
 		if ((err = snd_pcm_dmix_start_timer(pcm, dmix)) < 0)
 			return err;
-		snd_pcm_dmix_sync_area(pcm);
+		if ((err = snd_pcm_dmix_sync_area(pcm)) < 0)
+			return err;
 	}
 	gettimestamp(&dmix->trigger_tstamp, pcm->tstamp_type);
 	return 0;
@@ -621,7 +1142,11 @@ static int __snd_pcm_dmix_drain(snd_pcm_t *pcm)
 			goto done;
 		}
 		if (dmix->state == SND_PCM_STATE_DRAINING) {
-			snd_pcm_dmix_sync_area(pcm);
+			err = snd_pcm_dmix_sync_area(pcm);
+			if (err < 0) {
+				snd_pcm_dmix_drop(pcm);
+				goto done;
+			}
 			if ((pcm->mode & SND_PCM_NONBLOCK) == 0) {
 				snd_pcm_wait_nocheck(pcm, -1);
 				snd_pcm_direct_clear_timer_queue(dmix); /* force poll to wait */
@@ -672,7 +1197,9 @@ static snd_pcm_sframes_t snd_pcm_dmix_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t f
 	snd_pcm_direct_t *dmix = pcm->private_data;
 	snd_pcm_uframes_t slave_appl_ptr, slave_size;
 	snd_pcm_uframes_t appl_ptr, size, transfer, result, frames_to_remix;
-	int err;
+	snd_pcm_uframes_t slave_end;
+	unsigned long long start = 0;
+	int err, stats;
 	const snd_pcm_channel_area_t *src_areas, *dst_areas;
 
 	if (dmix->state == SND_PCM_STATE_RUNNING ||
@@ -712,6 +1239,16 @@ static snd_pcm_sframes_t snd_pcm_dmix_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t f
 	 * to also backward the appl pointer on success
 	 */
 	frames_to_remix = size;
+	stats = snd_pcm_direct_stats_enabled(dmix);
+	if (stats)
+		start = snd_pcm_direct_stats_now();
+
+	/* the pointers stay where they are when the lock fails */
+	if (!dmix->u.dmix.staging) {
+		err = dmix_down_sem(dmix);
+		if (err < 0)
+			return result > 0 ? result : err;
+	}
 
 	/* add sample areas here */
 	src_areas = snd_pcm_mmap_areas(pcm);
@@ -719,17 +1256,26 @@ static snd_pcm_sframes_t snd_pcm_dmix_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t f
 	dmix->last_appl_ptr -= size;
 	dmix->last_appl_ptr %= pcm->boundary;
 	appl_ptr = dmix->last_appl_ptr % pcm->buffer_size;
+	slave_end = dmix->slave_appl_ptr;
 	dmix->slave_appl_ptr -= size;
 	dmix->slave_appl_ptr %= dmix->slave_boundary;
 	slave_appl_ptr = dmix->slave_appl_ptr % dmix->slave_buffer_size;
-	dmix_down_sem(dmix);
+	if (dmix->u.dmix.staging) {
+		/* the slab contents are simply left out of the mix */
+		stage_rewind(dmix, dmix->slave_appl_ptr, slave_end);
+		stage_mix(dmix);
+		goto remixed;
+	}
 	for (;;) {
 		transfer = size;
 		if (appl_ptr + transfer > pcm->buffer_size)
 			transfer = pcm->buffer_size - appl_ptr;
 		if (slave_appl_ptr + transfer > dmix->slave_buffer_size)
 			transfer = dmix->slave_buffer_size - slave_appl_ptr;
-		remix_areas(dmix, src_areas, dst_areas, appl_ptr, slave_appl_ptr, transfer);
+		if (dmix->u.dmix.history)
+			history_remix(dmix, dst_areas, slave_appl_ptr, transfer);
+		else
+			remix_areas(dmix, src_areas, dst_areas, appl_ptr, slave_appl_ptr, transfer);
 		size -= transfer;
 		if (! size)
 			break;
@@ -740,6 +1286,10 @@ static snd_pcm_sframes_t snd_pcm_dmix_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t f
 	}
 	dmix_up_sem(dmix);
 
+ remixed:
+	if (stats)
+		snd_pcm_direct_stats_rewind(dmix, snd_pcm_direct_stats_now() - start,
+					    frames_to_remix);
 	snd_pcm_mmap_appl_backward(pcm, frames_to_remix);
 	result += frames_to_remix;
 	/* At this point last_appl_ptr and appl_ptr has to indicate the
@@ -779,26 +1329,53 @@ static int snd_pcm_dmix_close(snd_pcm_t *pcm)
 {
 	snd_pcm_direct_t *dmix = pcm->private_data;
 
-	if (dmix->timer)
-		snd_timer_close(dmix->timer);
+	snd_pcm_direct_timer_close(dmix);
 	snd_pcm_direct_semaphore_down(dmix, DIRECT_IPC_SEM_CLIENT);
 	snd_pcm_close(dmix->spcm);
  	if (dmix->server)
  		snd_pcm_direct_server_discard(dmix);
  	if (dmix->client)
  		snd_pcm_direct_client_discard(dmix);
+	if (dmix->u.dmix.staging)
+		stage_release_slot(dmix);
  	shm_sum_discard(dmix);
 	if (snd_pcm_direct_shm_discard(dmix)) {
 		if (snd_pcm_direct_semaphore_discard(dmix))
 			snd_pcm_direct_semaphore_final(dmix, DIRECT_IPC_SEM_CLIENT);
 	} else
 		snd_pcm_direct_semaphore_final(dmix, DIRECT_IPC_SEM_CLIENT);
+	gain_close(dmix);
+	free(dmix->u.dmix.history);
 	free(dmix->bindings);
 	pcm->private_data = NULL;
 	free(dmix);
 	return 0;
 }
 
+/*
+ * commit coalescing (option "commit_frames"): a small commit stays in
+ * the client buffer until commit_frames are pending or less than a
+ * slave period plus commit_frames is mixed ahead of the slave hw_ptr;
+ * poll_revents(), drain and rewind pick up what is left
+ */
+static int dmix_commit_deferred(snd_pcm_t *pcm, snd_pcm_direct_t *dmix)
+{
+	snd_pcm_uframes_t frames = dmix->u.dmix.commit_frames;
+	snd_pcm_uframes_t pending, queued;
+
+	if (!frames || dmix->u.dmix.staging ||
+	    dmix->state != SND_PCM_STATE_RUNNING)
+		return 0;
+	if (frames > dmix->slave_period_size)
+		frames = dmix->slave_period_size;
+	pending = pcm_frame_diff2(dmix->appl_ptr, dmix->last_appl_ptr, pcm->boundary);
+	if (pending >= frames)
+		return 0;
+	queued = pcm_frame_diff(dmix->slave_appl_ptr, dmix->slave_hw_ptr, dmix->slave_boundary);
+	return queued <= dmix->slave_buffer_size &&
+	       queued >= dmix->slave_period_size + frames;
+}
+
 static snd_pcm_sframes_t snd_pcm_dmix_mmap_commit(snd_pcm_t *pcm,
 						  snd_pcm_uframes_t offset ATTRIBUTE_UNUSED,
 						  snd_pcm_uframes_t size)
@@ -824,7 +1401,11 @@ static snd_pcm_sframes_t snd_pcm_dmix_mmap_commit(snd_pcm_t *pcm,
 	    dmix->state == SND_PCM_STATE_DRAINING) {
 		/* ok, we commit the changes after the validation of area */
 		/* it's intended, although the result might be crappy */
-		snd_pcm_dmix_sync_area(pcm);
+		if (!dmix_commit_deferred(pcm, dmix)) {
+			err = snd_pcm_dmix_sync_area(pcm);
+			if (err < 0)
+				return err;
+		}
 		/* clear timer queue to avoid a bogus return from poll */
 		if (snd_pcm_mmap_playback_avail(pcm) < pcm->avail_min)
 			snd_pcm_direct_clear_timer_queue(dmix);
@@ -873,8 +1454,13 @@ static int snd_pcm_dmix_htimestamp(snd_pcm_t *pcm,
 static int snd_pcm_dmix_poll_revents(snd_pcm_t *pcm, struct pollfd *pfds, unsigned int nfds, unsigned short *revents)
 {
 	snd_pcm_direct_t *dmix = pcm->private_data;
-	if (dmix->state == SND_PCM_STATE_RUNNING)
-		snd_pcm_dmix_sync_area(pcm);
+	int err;
+
+	if (dmix->state == SND_PCM_STATE_RUNNING) {
+		err = snd_pcm_dmix_sync_area(pcm);
+		if (err < 0)
+			return err;
+	}
 	return snd_pcm_direct_poll_revents(pcm, pfds, nfds, revents);
 }
 
@@ -888,6 +1474,15 @@ static void snd_pcm_dmix_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
 	}
+	snd_pcm_direct_stats_dump_local(dmix, out);
+	if (dmix->u.dmix.gain_fixed != DMIX_GAIN_UNITY)
+		snd_output_printf(out, "  Gain: %g dB\n",
+				  20.0 * log10((double)dmix->u.dmix.gain_fixed /
+					       DMIX_GAIN_UNITY));
+#ifdef BUILD_PCM_PLUGIN_SOFTVOL
+	if (dmix->u.dmix.volume)
+		snd_pcm_softvol_gain_dump(dmix->u.dmix.volume, out);
+#endif
 	if (dmix->spcm)
 		snd_pcm_dump(dmix->spcm, out);
 }
@@ -916,6 +1511,7 @@ static const snd_pcm_fast_ops_t snd_pcm_dmix_fast_ops = {
 	.hwsync = snd_pcm_dmix_hwsync,
 	.delay = snd_pcm_dmix_delay,
 	.prepare = snd_pcm_direct_prepare,
+	.resync = snd_pcm_direct_resync,
 	.reset = snd_pcm_dmix_reset,
 	.start = snd_pcm_dmix_start,
 	.drop = snd_pcm_dmix_drop,
@@ -1014,9 +1610,27 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 
 		dmix->spcm = spcm;
 
+		if (opts->persist) {
+			/* the server process keeps the slave running */
+			dmix->shmptr->use_server = 1;
+			dmix->shmptr->persist = 1;
+		}
+		if (opts->memfd) {
+			/* the server hands the sum buffer fd to the clients */
+			dmix->shmptr->use_server = 1;
+			dmix->shmptr->sum_memfd = 1;
+		}
 		if (dmix->shmptr->use_server) {
 			dmix->server_free = dmix_server_free;
-		
+
+			/* the server must inherit the memfd */
+			if (dmix->shmptr->sum_memfd) {
+				ret = shm_sum_create_or_connect(dmix);
+				if (ret < 0) {
+					SNDERR("unable to initialize sum ring buffer");
+					goto _err;
+				}
+			}
 			ret = snd_pcm_direct_server_create(dmix);
 			if (ret < 0) {
 				SNDERR("unable to create server");
@@ -1072,12 +1686,27 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 		dmix->spcm = spcm;
 	}
 
-	ret = shm_sum_create_or_connect(dmix);
-	if (ret < 0) {
-		SNDERR("unable to initialize sum ring buffer");
+	if (!dmix->u.dmix.sum_size) {	/* not mapped before the server fork */
+		ret = shm_sum_create_or_connect(dmix);
+		if (ret < 0) {
+			SNDERR("unable to initialize sum ring buffer");
+			goto _err;
+		}
+	}
+
+	if (dmix->u.dmix.staging &&
+	    dmix->shmptr->s.format == SND_PCM_FORMAT_FLOAT) {
+		SNDERR("staging mix_mode does not support float formats");
+		ret = -EINVAL;
 		goto _err;
 	}
 
+	if (dmix->u.dmix.staging) {
+		ret = stage_claim_slot(dmix);
+		if (ret < 0)
+			goto _err;
+	}
+
 	ret = snd_pcm_direct_initialize_poll_fd(dmix);
 	if (ret < 0) {
 		SNDERR("unable to initialize poll_fd");
@@ -1085,6 +1714,18 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 	}
 
 	mix_select_callbacks(dmix);
+
+	/* the history is subtracted without atomic operations */
+	if (opts->history && !dmix->u.dmix.staging && dmix->u.dmix.use_sem &&
+	    dmix->shmptr->s.format != SND_PCM_FORMAT_FLOAT) {
+		dmix->u.dmix.history = calloc(dmix->shmptr->s.channels *
+					      dmix->shmptr->s.buffer_size,
+					      sizeof(signed int));
+		if (dmix->u.dmix.history == NULL) {
+			ret = -ENOMEM;
+			goto _err;
+		}
+	}
 		
 	pcm->poll_fd = dmix->poll_fd;
 	pcm->poll_events = POLLIN;	/* it's different than other plugins */
@@ -1096,21 +1737,26 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 	if (dmix->channels == UINT_MAX)
 		dmix->channels = dmix->shmptr->s.channels;
 
+	ret = gain_open(dmix, opts);
+	if (ret < 0)
+		goto _err;
+
 	snd_pcm_direct_semaphore_up(dmix, DIRECT_IPC_SEM_CLIENT);
 
 	*pcmp = pcm;
 	return 0;
 	
  _err:
-	if (dmix->timer)
-		snd_timer_close(dmix->timer);
+	snd_pcm_direct_timer_close(dmix);
 	if (dmix->server)
 		snd_pcm_direct_server_discard(dmix);
 	if (dmix->client)
 		snd_pcm_direct_client_discard(dmix);
 	if (spcm)
 		snd_pcm_close(spcm);
-	if (dmix->u.dmix.shmid_sum >= 0)
+	if (dmix->u.dmix.staging)
+		stage_release_slot(dmix);
+	if (dmix->u.dmix.shmid_sum >= 0 || dmix->u.dmix.sum_fd >= 0)
 		shm_sum_discard(dmix);
 	if ((dmix->shmid >= 0) && (snd_pcm_direct_shm_discard(dmix))) {
 		if (snd_pcm_direct_semaphore_discard(dmix))
@@ -1118,6 +1764,8 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 	} else
 		snd_pcm_direct_semaphore_up(dmix, DIRECT_IPC_SEM_CLIENT);
  _err_nosem:
+	gain_close(dmix);
+	free(dmix->u.dmix.history);
 	free(dmix->bindings);
 	free(dmix);
 	snd_pcm_free(pcm);
@@ -1147,6 +1795,9 @@ pcm.name {
 	tstamp_type STR		# timestamp type
 				# STR can be one of the below strings :
 				# default, gettimeofday, monotonic, monotonic_raw
+	wakeup STR		# source of poll() wakeups
+				# STR can be one of the below strings :
+				# timer (default), timerfd
 	slave STR
 	# or
 	slave {			# Slave definition
@@ -1168,9 +1819,98 @@ pcm.name {
 		N INT		# maps slave channel to client channel N
 	}
 	slowptr BOOL		# slow but more precise pointer updates
+	ptr_refresh INT		# share the slowptr updates, in us (default 0 = each call)
+	mix_mode STR		# mixing method
+				# STR can be one of the below strings :
+				# auto (default)
+				# semaphore
+				# lockfree
+				# staging
+	mix_lock STR		# lock for the semaphore mix_mode
+				# semaphore (default)
+				# mutex
+	stage_slots INT		# max. number of clients for staging (default 16)
+	stage_periods INT	# slave periods mixed ahead for staging (default 2)
+	stats BOOL		# collect statistics in the shared memory (default false)
+	persist BOOL		# keep the slave set up after the last client (default false)
+	memfd BOOL		# sum buffer in a memfd instead of SysV shm (default false)
+	history BOOL		# keep the own mixed frames for rewinds (default false)
+	commit_frames INT	# mix commits only from this many frames (default 0 = each commit)
+	gain REAL		# client gain in dB, at most 24.0 (default 0.0)
+	volume {		# client volume control, as for the plug plugin
+		control {	# control element id as for the softvol plugin
+			name STR
+			...
+		}
+		[min_dB REAL]	# minimal dB value (default: -51.0)
+		[max_dB REAL]	# maximal dB value (default: 0.0)
+		[resolution INT] # resolution (default: 256)
+		[watch_ctl BOOL] # follow the control from a shared
+				# thread (default: no)
+	}
 }
 \endcode
 
+<code>persist</code> makes the first client start the dmix server
+process (as used for old kernels) and tells the server not to exit
+when the last client is gone.  The server keeps the slave configured
+and running with the shared memory in place, so a later open only
+connects to the shared memory and the server socket, receives the
+device fd and maps the buffer; the slave is not opened, set up or
+started again.  This is meant for short lived clients like event
+sounds.  The server stays until it gets SIGTERM (or SIGHUP/SIGQUIT),
+which releases the slave and the IPC resources.
+
+<code>memfd</code> puts the sum buffer into a sealed memfd instead of a
+SysV shared memory segment, so that it is not limited by
+kernel.shmmax and is freed with the last client even after a crash.
+With <code>memory.hugepages</code> set the memfd is created on
+huge pages (rounded up to 2 MiB), which reduces the TLB
+misses of large multichannel sum buffers.  The fd is passed to the
+clients over the server socket, so the first client starts the dmix
+server as with <code>persist</code>.  The small control segment stays
+in SysV shared memory, since it is found by <code>ipc_key</code>.
+
+<code>history</code> keeps a copy of the frames mixed by the client
+in the layout of the sum buffer (one int32 per slave sample).  A rewind
+then subtracts the cached values from the sum in a single pass instead
+of converting the client buffer again, which helps clients that rewind
+often, like timer based sound servers.  It is ignored for the staging
+mode, for float slaves and with the lockfree (atomic) mixing code.
+With <code>stats</code> the rewind count and cost are shown next to
+the mixing cost.
+
+<code>commit_frames</code> coalesces small writes: a commit of fewer
+frames is left in the client buffer and mixed together with the
+following ones once <code>commit_frames</code> frames are pending, or
+earlier when less than one slave period plus
+<code>commit_frames</code> is left mixed ahead of the hardware.
+Clients writing 32 or 64 frames at a time into a large buffer then
+take the mix lock once per batch instead of once per write.  The value
+is limited to the slave period size and ignored for the staging mode.
+Waking up in poll(), draining and rewinding mix the pending frames
+as before.
+
+<code>gain</code> and <code>volume</code> scale the samples of this
+client while they are added to the sum buffer, so a per-client
+softvol (and the plug plugin with its bounce buffer in front of it)
+is not needed.  The volume control is created on the card of the slave
+unless another card is given, and its changes are picked up before
+each mix.  Both are combined when given together.  The gained mixing
+runs under the semaphore, so the <code>auto</code> mix_mode selects
+"semaphore" and "lockfree" is refused.  All clients sharing the slave
+must then use the semaphore, e.g. by setting <code>mix_mode</code>
+explicitly.
+A rewind subtracts the samples with the current gain, or with the
+stored ones when <code>history</code> is enabled.
+
+<code>ptr_refresh</code> (microseconds) lets the clients share the
+slowptr updates: the first one to find the last update older than this
+asks the driver and stores the pointer with its time in the shared
+memory, while the others extrapolate from it at the slave rate, by no
+more than a slave period.  With many clients most of the hwsync calls
+go away.
+
 <code>ipc_key</code> specfies the unique IPC key in integer.
 This number must be unique for each different dmix definition,
 since the shared memory is created with this key number.
@@ -1179,6 +1919,13 @@ added to the value set in <code>ipc_key</code>.  This will
 avoid the confliction of the same IPC key with different users
 concurrently.
 
+<code>wakeup</code> selects what wakes up poll() and snd_pcm_wait().
+"timer" uses the PCM timer of the slave device.  "timerfd" uses a
+high resolution timerfd on CLOCK_MONOTONIC which is programmed from the
+slave period and htimestamp (it needs the monotonic tstamp_type for the
+phase) and avoids reading the kernel timer queue.  Asynchronous
+notification is not available with "timerfd".
+
 <code>hw_ptr_alignment</code> specifies slave application and hw
 pointer alignment type. By default hw_ptr_alignment is auto. Below are
 the possible configurations:
@@ -1200,6 +1947,49 @@ the possible configurations:
   case of a dependency to another sound device (e.g. forwarding of
   microphone to speaker). Else "no" will be chosen.
 
+<code>mix_mode</code> selects how the clients are mixed together:
+- auto: "lockfree" when <code>direct_memory_access</code> is set and
+  the architecture has atomic mixing code, "semaphore" otherwise.
+- semaphore: each client adds its samples to the sum buffer while
+  it holds the IPC semaphore.
+- lockfree: each client adds its samples with atomic operations
+  (x86 only, other architectures fall back to "semaphore").
+- staging: each client writes into its own staging slab without any
+  locking.  A single client at a time (the reducer) sums all slabs into
+  the slave buffer, one pass per slave period as the hardware pointer
+  advances.  <code>stage_periods</code> defines how many slave periods
+  are mixed ahead of the hardware pointer; frames written later than
+  that are mixed immediately.  The mix-ahead window should cover the
+  longest wakeup interval of the clients.  Up to <code>stage_slots</code>
+  clients can be attached.  Only the slave channels which received
+  client data in a period are summed and written back, the others keep
+  the silence of the driver.
+All clients sharing the same <code>ipc_key</code> must use the same mode.
+
+<code>mix_lock</code> selects the lock which the clients hold while
+they add their samples in the semaphore mode (also the float mix):
+- semaphore: the SysV IPC semaphore, two semop() calls per lock.
+- mutex: a robust process shared pthread mutex in the shared memory.
+  Taking a free mutex costs no system call.  When a client dies with
+  the mutex held, the next client takes it over.
+The IPC semaphore is used for opening and closing in either case.
+All clients sharing the same <code>ipc_key</code> must use the same
+<code>mix_lock</code>.
+
+<code>stats</code> enables the statistics block in the shared memory
+area: semaphore wait times, mixing cost, xruns and the frames passed
+by each client.  It is switched on for the whole instance by the first
+client which sets it.  The counters are shown by snd_pcm_dump() and can
+be read from any process with snd_pcm_direct_stats_dump().
+
+With a native endian \c FLOAT slave the clients are mixed in float:
+the sum buffer holds the float sum without any clipping, so the mix
+has the full headroom while clients are added and removed.  Only the
+samples written to the slave pass a soft limiter, which leaves the
+signal untouched up to -1 dBFS and bends it smoothly towards full
+scale above.  The float mix always uses the semaphore; the staging
+<code>mix_mode</code> is not available for it.
+
 Note that the dmix plugin itself supports only a single configuration.
 That is, it supports only the fixed rate (default 48000), format
 (\c S16), channels (2), and period_time (125000).
@@ -122,8 +122,9 @@ static void mix_select_callbacks(snd_pcm_direct_t *dmix)
 	((1ULL << SND_PCM_FORMAT_S16_LE) | (1ULL << SND_PCM_FORMAT_S32_LE) |\
 	 (1ULL << SND_PCM_FORMAT_S16_BE) | (1ULL << SND_PCM_FORMAT_S32_BE) |\
 	 (1ULL << SND_PCM_FORMAT_S24_LE) | (1ULL << SND_PCM_FORMAT_S24_3LE) | \
-	 (1ULL << SND_PCM_FORMAT_U8))
+	 (1ULL << SND_PCM_FORMAT_U8) | (1ULL << SND_PCM_FORMAT_FLOAT))
 
+#include <math.h>
 #include "bswap.h"
 
 static void generic_mix_areas_16_native(unsigned int size,
@@ -511,14 +512,141 @@ static void generic_remix_areas_u8(unsigned int size,
 	}
 }
 
+/*
+ * native float: the sum buffer holds the unclipped float sum, so any
+ * number of full scale clients can be added and removed again without
+ * losing precision (headroom).  Only the value written to the slave
+ * passes the soft limiter: unity gain up to the knee (-1 dBFS), above
+ * it a rational curve with slope 1 at the knee which approaches full
+ * scale asymptotically.  The limiter is branchless, so the contiguous
+ * loops below are vectorized by the compiler.
+ */
+#define DMIX_FLOAT_KNEE		0.8912509f
+#define DMIX_FLOAT_RANGE	(1.0f - DMIX_FLOAT_KNEE)
+
+static inline float dmix_float_limit(float sample)
+{
+	float a = fabsf(sample);
+	float over = a > DMIX_FLOAT_KNEE ? a - DMIX_FLOAT_KNEE : 0.0f;
+
+	a -= over;
+	a += DMIX_FLOAT_RANGE * over / (over + DMIX_FLOAT_RANGE);
+	return copysignf(a, sample);
+}
+
+static void generic_mix_areas_float(unsigned int size,
+				    volatile float *dst,
+				    float *src,
+				    volatile float *sum,
+				    size_t dst_step,
+				    size_t src_step,
+				    size_t sum_step)
+{
+	register float sample;
+
+	if (dst_step == sizeof(float) && src_step == sizeof(float) &&
+	    sum_step == sizeof(float)) {
+		/* protected by the semaphore, volatile is not needed here */
+		float *d = (float *)dst, *m = (float *)sum;
+		unsigned int i;
+
+		for (i = 0; i < size; i++) {
+			sample = d[i] != 0.0f ? m[i] + src[i] : src[i];
+			m[i] = sample;
+			d[i] = dmix_float_limit(sample);
+		}
+		return;
+	}
+	for (;;) {
+		sample = *src;
+		if (*dst == 0.0f) {
+			*sum = sample;
+		} else {
+			sample += *sum;
+			*sum = sample;
+		}
+		*dst = dmix_float_limit(sample);
+		if (!--size)
+			return;
+		src = (float *) ((char *)src + src_step);
+		dst = (float *) ((char *)dst + dst_step);
+		sum = (float *) ((char *)sum + sum_step);
+	}
+}
+
+static void generic_remix_areas_float(unsigned int size,
+				      volatile float *dst,
+				      float *src,
+				      volatile float *sum,
+				      size_t dst_step,
+				      size_t src_step,
+				      size_t sum_step)
+{
+	register float sample;
+
+	if (dst_step == sizeof(float) && src_step == sizeof(float) &&
+	    sum_step == sizeof(float)) {
+		float *d = (float *)dst, *m = (float *)sum;
+		unsigned int i;
+
+		for (i = 0; i < size; i++) {
+			sample = d[i] != 0.0f ? m[i] - src[i] : -src[i];
+			m[i] = sample;
+			d[i] = dmix_float_limit(sample);
+		}
+		return;
+	}
+	for (;;) {
+		sample = *src;
+		if (*dst == 0.0f)
+			sample = -sample;
+		else
+			sample = *sum - sample;
+		*sum = sample;
+		*dst = dmix_float_limit(sample);
+		if (!--size)
+			return;
+		src = (float *) ((char *)src + src_step);
+		dst = (float *) ((char *)dst + dst_step);
+		sum = (float *) ((char *)sum + sum_step);
+	}
+}
+
+#include "pcm_dmix_simd.h"
+
+/*
+ * the native 16/32-bit routines, the vector ones first; all of them
+ * need the semaphore protection
+ */
+struct generic_mix_kernels {
+	unsigned int cpu;
+	mix_areas_16_t *mix_areas_16;
+	mix_areas_32_t *mix_areas_32;
+	mix_areas_16_t *remix_areas_16;
+	mix_areas_32_t *remix_areas_32;
+};
+
+static const struct generic_mix_kernels generic_mix_native[] = {
+#if defined(DMIX_SIMD_AVX2)
+	{ SND_CPU_AVX2, avx2_mix_areas_16, avx2_mix_areas_32,
+	  avx2_remix_areas_16, avx2_remix_areas_32 },
+#elif defined(DMIX_SIMD_NEON)
+	{ SND_CPU_NEON, neon_mix_areas_16, neon_mix_areas_32,
+	  neon_remix_areas_16, neon_remix_areas_32 },
+#endif
+	{ 0, generic_mix_areas_16_native, generic_mix_areas_32_native,
+	  generic_remix_areas_16_native, generic_remix_areas_32_native },
+};
 
 static void generic_mix_select_callbacks(snd_pcm_direct_t *dmix)
 {
 	if (snd_pcm_format_cpu_endian(dmix->shmptr->s.format)) {
-		dmix->u.dmix.mix_areas_16 = generic_mix_areas_16_native;
-		dmix->u.dmix.mix_areas_32 = generic_mix_areas_32_native;
-		dmix->u.dmix.remix_areas_16 = generic_remix_areas_16_native;
-		dmix->u.dmix.remix_areas_32 = generic_remix_areas_32_native;
+		const struct generic_mix_kernels *k =
+			snd_cpu_select(generic_mix_native, sizeof(*k));
+		dmix->u.dmix.mix_areas_16 = k->mix_areas_16;
+		dmix->u.dmix.mix_areas_32 = k->mix_areas_32;
+		dmix->u.dmix.remix_areas_16 = k->remix_areas_16;
+		dmix->u.dmix.remix_areas_32 = k->remix_areas_32;
 	} else {
 		dmix->u.dmix.mix_areas_16 = generic_mix_areas_16_swap;
 		dmix->u.dmix.mix_areas_32 = generic_mix_areas_32_swap;
@@ -529,6 +657,8 @@ static void generic_mix_select_callbacks(snd_pcm_direct_t *dmix)
 	dmix->u.dmix.mix_areas_u8 = generic_mix_areas_u8;
 	dmix->u.dmix.remix_areas_24 = generic_remix_areas_24;
 	dmix->u.dmix.remix_areas_u8 = generic_remix_areas_u8;
+	dmix->u.dmix.mix_areas_float = generic_mix_areas_float;
+	dmix->u.dmix.remix_areas_float = generic_remix_areas_float;
 	dmix->u.dmix.use_sem = 1;
 }
 
@@ -85,7 +85,9 @@
 
 static void mix_select_callbacks(snd_pcm_direct_t *dmix)
 {
-	static int smp = 0, mmx = 0, cmov = 0;
+	static int smp = 0;
+	int mmx = snd_cpu_has(SND_CPU_MMX);
+	int cmov = snd_cpu_has(SND_CPU_CMOV);
 
 	if (!dmix->direct_memory_access) {
 		generic_mix_select_callbacks(dmix);
@@ -101,18 +103,12 @@ static void mix_select_callbacks(snd_pcm_direct_t *dmix)
 		FILE *in;
 		char line[255];
 	
-		/* try to determine the capabilities of the CPU */
+		/* count the processors, the lock prefix is needed with SMP */
 		in = fopen("/proc/cpuinfo", "r");
 		if (in) {
 			while (!feof(in) && (fgets(line, sizeof(line), in) != NULL)) {
 				if (!strncmp(line, "processor", 9))
 					smp++;
-				else if (!strncmp(line, "flags", 5)) {
-					if (strstr(line, " mmx"))
-						mmx = 1;
-					if (strstr(line, " cmov"))
-						cmov = 1;
-				}
 			}
 			fclose(in);
 		}
@@ -0,0 +1,285 @@
+/**
+ * \file pcm/pcm_dmix_simd.h
+ * \ingroup PCM_Plugins
+ * \brief PCM Direct Stream Mixing (dmix) Plugin Interface - SIMD (AVX2/NEON) code
+ * \date 2026
+ */
+/*
+ *  PCM - Direct Stream Mixing
+ *
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * These kernels are the vector counterparts of the generic native-endian
+ * mix/remix routines.  They are not concurrent (no atomic operations), so
+ * they must only be used while the sum buffer is protected by the client
+ * semaphore (use_sem = 1), exactly like the generic code.
+ *
+ * Contiguous runs are processed one sum_buffer cache line (16 samples)
+ * per iteration; the unaligned head, the tail and strided (non-interleaved)
+ * areas are passed to the generic scalar routines, which must be defined
+ * before this file is included:
+ *
+ *   generic_mix_areas_16_native, generic_remix_areas_16_native,
+ *   generic_mix_areas_32_native, generic_remix_areas_32_native
+ */
+
+#if defined(__x86_64__) && defined(__GNUC__) && \
+    (defined(__clang__) || __GNUC__ >= 5)
+#define DMIX_SIMD_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define DMIX_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(DMIX_SIMD_AVX2) || defined(DMIX_SIMD_NEON)
+#define DMIX_SIMD
+
+#define DMIX_SIMD_LINE		64	/* sum_buffer bytes per iteration */
+#define DMIX_SIMD_BLOCK		(DMIX_SIMD_LINE / sizeof(signed int))
+#define DMIX_SIMD_MAX24		0x7fffff
+#define DMIX_SIMD_MIN24		(-0x800000)
+
+/* samples to process in scalar code until sum reaches a cache line boundary */
+static inline unsigned int dmix_simd_head(volatile signed int *sum,
+					  unsigned int size)
+{
+	unsigned int head;
+
+	head = ((DMIX_SIMD_LINE - ((unsigned long)sum & (DMIX_SIMD_LINE - 1))) &
+		(DMIX_SIMD_LINE - 1)) / sizeof(signed int);
+	return head < size ? head : size;
+}
+
+/*
+ * Build a full mix routine from a one cache line block kernel.
+ */
+#define DMIX_SIMD_MIX_AREAS(name, type, target, block, fallback)	\
+static target void name(unsigned int size,				\
+			volatile type *dst, type *src,			\
+			volatile signed int *sum, size_t dst_step,	\
+			size_t src_step, size_t sum_step)		\
+{									\
+	unsigned int head;						\
+									\
+	if (!size)							\
+		return;							\
+	if (dst_step != sizeof(type) || src_step != sizeof(type) ||	\
+	    sum_step != sizeof(signed int)) {				\
+		fallback(size, dst, src, sum, dst_step, src_step, sum_step); \
+		return;							\
+	}								\
+	head = dmix_simd_head(sum, size);				\
+	if (head) {							\
+		fallback(head, dst, src, sum, dst_step, src_step, sum_step); \
+		dst += head;						\
+		src += head;						\
+		sum += head;						\
+		size -= head;						\
+	}								\
+	for (; size >= DMIX_SIMD_BLOCK; size -= DMIX_SIMD_BLOCK) {	\
+		block(dst, src, sum);					\
+		dst += DMIX_SIMD_BLOCK;					\
+		src += DMIX_SIMD_BLOCK;					\
+		sum += DMIX_SIMD_BLOCK;					\
+	}								\
+	if (size)							\
+		fallback(size, dst, src, sum, dst_step, src_step, sum_step); \
+}
+
+#ifdef DMIX_SIMD_AVX2
+
+#define DMIX_AVX2_TARGET	__attribute__((target("avx2")))
+
+static inline DMIX_AVX2_TARGET
+void avx2_mix_block_16(volatile signed short *dst, const signed short *src,
+		       volatile signed int *sum, int remix)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i s, d, m, slo, shi, mlo, mhi, sumlo, sumhi, out;
+
+	s = _mm256_loadu_si256((const __m256i *)src);
+	d = _mm256_loadu_si256((const __m256i *)dst);
+	/* zero in the slave buffer means the sample was already played */
+	m = _mm256_cmpeq_epi16(d, zero);
+	slo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(s));
+	shi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(s, 1));
+	mlo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(m));
+	mhi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(m, 1));
+	sumlo = _mm256_andnot_si256(mlo, _mm256_load_si256((const __m256i *)sum));
+	sumhi = _mm256_andnot_si256(mhi, _mm256_load_si256((const __m256i *)(sum + 8)));
+	if (remix) {
+		sumlo = _mm256_sub_epi32(sumlo, slo);
+		sumhi = _mm256_sub_epi32(sumhi, shi);
+	} else {
+		sumlo = _mm256_add_epi32(sumlo, slo);
+		sumhi = _mm256_add_epi32(sumhi, shi);
+	}
+	_mm256_store_si256((__m256i *)sum, sumlo);
+	_mm256_store_si256((__m256i *)(sum + 8), sumhi);
+	/* packs works per 128-bit lane, restore the sample order */
+	out = _mm256_permute4x64_epi64(_mm256_packs_epi32(sumlo, sumhi), 0xd8);
+	if (remix)
+		out = _mm256_blendv_epi8(out, _mm256_sub_epi16(zero, s), m);
+	_mm256_storeu_si256((__m256i *)dst, out);
+}
+
+static inline DMIX_AVX2_TARGET
+void avx2_mix_8_32(volatile signed int *dst, const signed int *src,
+		   volatile signed int *sum, int remix)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i s, m, v, acc, out;
+
+	s = _mm256_loadu_si256((const __m256i *)src);
+	m = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)dst), zero);
+	v = _mm256_srai_epi32(s, 8);
+	acc = _mm256_andnot_si256(m, _mm256_load_si256((const __m256i *)sum));
+	acc = remix ? _mm256_sub_epi32(acc, v) : _mm256_add_epi32(acc, v);
+	_mm256_store_si256((__m256i *)sum, acc);
+	out = _mm256_max_epi32(acc, _mm256_set1_epi32(DMIX_SIMD_MIN24));
+	out = _mm256_min_epi32(out, _mm256_set1_epi32(DMIX_SIMD_MAX24));
+	out = _mm256_slli_epi32(out, 8);
+	/* positive clipping saturates to 0x7fffffff, not 0x7fffff00 */
+	out = _mm256_or_si256(out,
+		_mm256_and_si256(_mm256_cmpgt_epi32(acc, _mm256_set1_epi32(DMIX_SIMD_MAX24)),
+				 _mm256_set1_epi32(0xff)));
+	out = _mm256_blendv_epi8(out, remix ? _mm256_sub_epi32(zero, s) : s, m);
+	_mm256_storeu_si256((__m256i *)dst, out);
+}
+
+static inline DMIX_AVX2_TARGET
+void avx2_mix_block_32(volatile signed int *dst, const signed int *src,
+		       volatile signed int *sum, int remix)
+{
+	avx2_mix_8_32(dst, src, sum, remix);
+	avx2_mix_8_32(dst + 8, src + 8, sum + 8, remix);
+}
+
+#define avx2_mix_16(d, s, m)	avx2_mix_block_16(d, s, m, 0)
+#define avx2_remix_16(d, s, m)	avx2_mix_block_16(d, s, m, 1)
+#define avx2_mix_32(d, s, m)	avx2_mix_block_32(d, s, m, 0)
+#define avx2_remix_32(d, s, m)	avx2_mix_block_32(d, s, m, 1)
+
+DMIX_SIMD_MIX_AREAS(avx2_mix_areas_16, signed short, DMIX_AVX2_TARGET,
+		    avx2_mix_16, generic_mix_areas_16_native)
+DMIX_SIMD_MIX_AREAS(avx2_remix_areas_16, signed short, DMIX_AVX2_TARGET,
+		    avx2_remix_16, generic_remix_areas_16_native)
+DMIX_SIMD_MIX_AREAS(avx2_mix_areas_32, signed int, DMIX_AVX2_TARGET,
+		    avx2_mix_32, generic_mix_areas_32_native)
+DMIX_SIMD_MIX_AREAS(avx2_remix_areas_32, signed int, DMIX_AVX2_TARGET,
+		    avx2_remix_32, generic_remix_areas_32_native)
+
+#endif /* DMIX_SIMD_AVX2 */
+
+#ifdef DMIX_SIMD_NEON
+
+static inline void neon_mix_8_16(volatile signed short *dst,
+				 const signed short *src,
+				 volatile signed int *sum, int remix)
+{
+	int16x8_t s, out;
+	uint16x8_t m;
+	int32x4_t slo, shi, mlo, mhi, sumlo, sumhi;
+
+	s = vld1q_s16(src);
+	/* zero in the slave buffer means the sample was already played */
+	m = vceqq_s16(vld1q_s16((const int16_t *)dst), vdupq_n_s16(0));
+	slo = vmovl_s16(vget_low_s16(s));
+	shi = vmovl_s16(vget_high_s16(s));
+	mlo = vmovl_s16(vget_low_s16(vreinterpretq_s16_u16(m)));
+	mhi = vmovl_s16(vget_high_s16(vreinterpretq_s16_u16(m)));
+	sumlo = vbicq_s32(vld1q_s32((const int32_t *)sum), mlo);
+	sumhi = vbicq_s32(vld1q_s32((const int32_t *)(sum + 4)), mhi);
+	if (remix) {
+		sumlo = vsubq_s32(sumlo, slo);
+		sumhi = vsubq_s32(sumhi, shi);
+	} else {
+		sumlo = vaddq_s32(sumlo, slo);
+		sumhi = vaddq_s32(sumhi, shi);
+	}
+	vst1q_s32((int32_t *)sum, sumlo);
+	vst1q_s32((int32_t *)(sum + 4), sumhi);
+	out = vcombine_s16(vqmovn_s32(sumlo), vqmovn_s32(sumhi));
+	if (remix)
+		out = vbslq_s16(m, vnegq_s16(s), out);
+	vst1q_s16((int16_t *)dst, out);
+}
+
+static inline void neon_mix_block_16(volatile signed short *dst,
+				     const signed short *src,
+				     volatile signed int *sum, int remix)
+{
+	neon_mix_8_16(dst, src, sum, remix);
+	neon_mix_8_16(dst + 8, src + 8, sum + 8, remix);
+}
+
+static inline void neon_mix_4_32(volatile signed int *dst,
+				 const signed int *src,
+				 volatile signed int *sum, int remix)
+{
+	int32x4_t s, v, acc, out;
+	uint32x4_t m, over;
+
+	s = vld1q_s32(src);
+	m = vceqq_s32(vld1q_s32((const int32_t *)dst), vdupq_n_s32(0));
+	v = vshrq_n_s32(s, 8);
+	acc = vbicq_s32(vld1q_s32((const int32_t *)sum), vreinterpretq_s32_u32(m));
+	acc = remix ? vsubq_s32(acc, v) : vaddq_s32(acc, v);
+	vst1q_s32((int32_t *)sum, acc);
+	over = vcgtq_s32(acc, vdupq_n_s32(DMIX_SIMD_MAX24));
+	out = vmaxq_s32(acc, vdupq_n_s32(DMIX_SIMD_MIN24));
+	out = vminq_s32(out, vdupq_n_s32(DMIX_SIMD_MAX24));
+	out = vshlq_n_s32(out, 8);
+	/* positive clipping saturates to 0x7fffffff, not 0x7fffff00 */
+	out = vorrq_s32(out, vandq_s32(vreinterpretq_s32_u32(over),
+				       vdupq_n_s32(0xff)));
+	out = vbslq_s32(m, remix ? vnegq_s32(s) : s, out);
+	vst1q_s32((int32_t *)dst, out);
+}
+
+static inline void neon_mix_block_32(volatile signed int *dst,
+				     const signed int *src,
+				     volatile signed int *sum, int remix)
+{
+	unsigned int i;
+
+	for (i = 0; i < DMIX_SIMD_BLOCK; i += 4)
+		neon_mix_4_32(dst + i, src + i, sum + i, remix);
+}
+
+#define neon_mix_16(d, s, m)	neon_mix_block_16(d, s, m, 0)
+#define neon_remix_16(d, s, m)	neon_mix_block_16(d, s, m, 1)
+#define neon_mix_32(d, s, m)	neon_mix_block_32(d, s, m, 0)
+#define neon_remix_32(d, s, m)	neon_mix_block_32(d, s, m, 1)
+
+DMIX_SIMD_MIX_AREAS(neon_mix_areas_16, signed short, ,
+		    neon_mix_16, generic_mix_areas_16_native)
+DMIX_SIMD_MIX_AREAS(neon_remix_areas_16, signed short, ,
+		    neon_remix_16, generic_remix_areas_16_native)
+DMIX_SIMD_MIX_AREAS(neon_mix_areas_32, signed int, ,
+		    neon_mix_32, generic_mix_areas_32_native)
+DMIX_SIMD_MIX_AREAS(neon_remix_areas_32, signed int, ,
+		    neon_remix_32, generic_remix_areas_32_native)
+
+#endif /* DMIX_SIMD_NEON */
+
+#endif /* DMIX_SIMD_AVX2 || DMIX_SIMD_NEON */
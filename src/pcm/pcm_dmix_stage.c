@@ -0,0 +1,678 @@
+/*
+ *  staging mix mode (mix_mode "staging")
+ *
+ *  Each client converts its samples into its own slab (one int32 per slave
+ *  sample, same ring layout as the slave buffer) without any locking.
+ *  The slabs and the clients' positions live in the sum shm after the sum
+ *  buffer.  Whoever gets the reducer role sums all slabs into the slave
+ *  buffer: the periods which come into the mix-ahead window as the slave
+ *  hw_ptr advances, and the ranges rewritten by clients which were late.
+ *
+ *  Slot positions are absolute slave frames.  They are updated by the owner
+ *  under a sequence counter (odd = update in progress), the slab data are
+ *  only written outside of the published [start, end) range.
+ *
+ *  The clients also mark the slave channels they write, per ring period
+ *  and per parity of the buffer wrap, in a bitmap after the slots.  The
+ *  reducer clears, sums and writes back only the marked channels of a
+ *  period; the others still hold the silence the driver filled in after
+ *  playback.  The bits of a period are dropped once it was played, which
+ *  cannot race with new marks: the next frames with the same bits are
+ *  two buffers later.
+ */
+
+#include "bswap.h"
+
+struct snd_pcm_dmix_stage_slot {
+	int pid;				/* owner, 0 = free */
+	unsigned int seq;			/* bumped by the owner, odd = busy */
+	unsigned int reduced_seq;		/* last seq handled by the reducer */
+	unsigned int pad;
+	unsigned long long start;		/* first valid frame in the slab */
+	unsigned long long end;			/* frame after the last written one */
+	unsigned long long dirty_begin;		/* range changed since reduced_seq */
+	unsigned long long dirty_end;
+};
+
+struct snd_pcm_dmix_stage {
+	int reducer;				/* pid of the reducer, 0 = none */
+	unsigned int pending;			/* bumped after each slot update */
+	unsigned int slots;			/* number of slots */
+	unsigned int pad;
+	unsigned long long clean_end;		/* frames before are mixed */
+	unsigned int periods;			/* ring periods in the dirty map */
+	unsigned int dirty_words;		/* words per period */
+	unsigned long long dirty_expired;	/* dirty bits before are dropped */
+	struct snd_pcm_dmix_stage_slot slot[];
+};
+
+#define STAGE_ALIGN(x)		(((x) + 63) & ~(size_t)63)
+
+static inline size_t stage_sum_size(snd_pcm_direct_t *dmix)
+{
+	return STAGE_ALIGN(dmix->shmptr->s.channels *
+			   dmix->shmptr->s.buffer_size * sizeof(signed int));
+}
+
+static inline unsigned int stage_ring_periods(snd_pcm_direct_t *dmix)
+{
+	return (dmix->shmptr->s.buffer_size + dmix->shmptr->s.period_size - 1) /
+	       dmix->shmptr->s.period_size;
+}
+
+static inline unsigned int stage_dirty_words(snd_pcm_direct_t *dmix)
+{
+	return (dmix->shmptr->s.channels + 31) / 32;
+}
+
+static inline size_t stage_header_size(snd_pcm_direct_t *dmix, unsigned int slots)
+{
+	return STAGE_ALIGN(sizeof(struct snd_pcm_dmix_stage) +
+			   slots * sizeof(struct snd_pcm_dmix_stage_slot) +
+			   2 * stage_ring_periods(dmix) * stage_dirty_words(dmix) *
+			   sizeof(unsigned int));
+}
+
+static inline size_t stage_slab_samples(snd_pcm_direct_t *dmix)
+{
+	return dmix->shmptr->s.channels * dmix->shmptr->s.buffer_size;
+}
+
+/* size of the staging area behind the sum buffer */
+static size_t stage_shm_size(snd_pcm_direct_t *dmix)
+{
+	unsigned int slots = dmix->u.dmix.stage_slots;
+
+	return stage_header_size(dmix, slots) +
+	       slots * STAGE_ALIGN(stage_slab_samples(dmix) * sizeof(signed int));
+}
+
+static inline signed int *stage_slab(snd_pcm_direct_t *dmix, unsigned int idx)
+{
+	snd_pcm_dmix_stage_t *stage = dmix->u.dmix.stage;
+
+	return (signed int *)((char *)stage + stage_header_size(dmix, stage->slots) +
+			      idx * STAGE_ALIGN(stage_slab_samples(dmix) * sizeof(signed int)));
+}
+
+/* signed distance a - b on the slave boundary */
+static inline snd_pcm_sframes_t stage_diff(snd_pcm_direct_t *dmix,
+					   unsigned long long a,
+					   unsigned long long b)
+{
+	snd_pcm_sframes_t d = pcm_frame_diff(a, b, dmix->slave_boundary);
+
+	if ((snd_pcm_uframes_t)d >= dmix->slave_boundary / 2)
+		d -= dmix->slave_boundary;
+	return d;
+}
+
+static inline unsigned long long stage_pos(snd_pcm_direct_t *dmix,
+					   snd_pcm_uframes_t base,
+					   snd_pcm_sframes_t ofs)
+{
+	if (ofs < 0)
+		ofs += dmix->slave_boundary;
+	return (base + ofs) % dmix->slave_boundary;
+}
+
+/* dirty bits of the ring period holding the absolute frame pos */
+static inline unsigned int *stage_dirty(snd_pcm_direct_t *dmix,
+					unsigned long long pos)
+{
+	snd_pcm_dmix_stage_t *stage = dmix->u.dmix.stage;
+	unsigned int wrap = (pos / dmix->slave_buffer_size) & 1;
+	unsigned int period = (pos % dmix->slave_buffer_size) / dmix->slave_period_size;
+
+	return (unsigned int *)&stage->slot[stage->slots] +
+		(wrap * stage->periods + period) * stage->dirty_words;
+}
+
+/* frames after pos up to the end of its ring period */
+static inline snd_pcm_uframes_t stage_period_left(snd_pcm_direct_t *dmix,
+						  unsigned long long pos)
+{
+	snd_pcm_uframes_t ofs = pos % dmix->slave_buffer_size;
+	snd_pcm_uframes_t left = dmix->slave_period_size - ofs % dmix->slave_period_size;
+
+	if (ofs + left > dmix->slave_buffer_size)
+		left = dmix->slave_buffer_size - ofs;
+	return left;
+}
+
+/* the own channels were written in the frames [begin, end) */
+static void stage_mark_dirty(snd_pcm_direct_t *dmix, unsigned long long begin,
+			     unsigned long long end)
+{
+	unsigned int chn, dchn, schannels = dmix->shmptr->s.channels;
+	snd_pcm_sframes_t size = stage_diff(dmix, end, begin);
+	snd_pcm_uframes_t left;
+	unsigned int *dirty;
+
+	while (size > 0) {
+		dirty = stage_dirty(dmix, begin);
+		for (chn = 0; chn < dmix->channels; chn++) {
+			dchn = dmix->bindings ? dmix->bindings[chn] : chn;
+			if (dchn >= schannels)
+				continue;
+			/* no atomic operation on the shared line when already set */
+			if (!(__atomic_load_n(&dirty[dchn / 32], __ATOMIC_RELAXED) &
+			      (1U << (dchn % 32))))
+				__atomic_fetch_or(&dirty[dchn / 32], 1U << (dchn % 32),
+						  __ATOMIC_RELAXED);
+		}
+		left = stage_period_left(dmix, begin);
+		size -= left;
+		begin = stage_pos(dmix, begin, left);
+	}
+}
+
+/* drop the dirty bits of the periods played before base */
+static void stage_dirty_expire(snd_pcm_direct_t *dmix, snd_pcm_uframes_t base)
+{
+	snd_pcm_dmix_stage_t *stage = dmix->u.dmix.stage;
+	unsigned long long pos = stage->dirty_expired;
+	snd_pcm_sframes_t ahead = stage_diff(dmix, base, pos);
+	snd_pcm_uframes_t left;
+
+	if (ahead < 0 || ahead > (snd_pcm_sframes_t)dmix->slave_buffer_size) {
+		/* restarted or idle for long: only the last buffer matters */
+		pos = stage_pos(dmix, base, -(snd_pcm_sframes_t)dmix->slave_buffer_size);
+		pos = stage_pos(dmix, pos, stage_period_left(dmix, pos) %
+				dmix->slave_period_size);
+	}
+	for (;;) {
+		left = stage_period_left(dmix, pos);
+		if (stage_diff(dmix, base, pos) < (snd_pcm_sframes_t)left)
+			break;
+		memset(stage_dirty(dmix, pos), 0,
+		       stage->dirty_words * sizeof(unsigned int));
+		pos = stage_pos(dmix, pos, left);
+	}
+	stage->dirty_expired = pos;
+}
+
+static int stage_attach(snd_pcm_direct_t *dmix)
+{
+	snd_pcm_dmix_stage_t *stage;
+
+	stage = (snd_pcm_dmix_stage_t *)((char *)dmix->u.dmix.sum_buffer +
+					 stage_sum_size(dmix));
+	if (!stage->slots)
+		stage->slots = dmix->u.dmix.stage_slots;
+	if (stage->slots != dmix->u.dmix.stage_slots) {
+		SNDERR("dmix stage_slots mismatch (%u != %u)",
+		       dmix->u.dmix.stage_slots, stage->slots);
+		return -EINVAL;
+	}
+	if (!stage->periods) {
+		stage->periods = stage_ring_periods(dmix);
+		stage->dirty_words = stage_dirty_words(dmix);
+	}
+	dmix->u.dmix.stage = stage;
+	return 0;
+}
+
+/* called with the client semaphore held */
+static int stage_claim_slot(snd_pcm_direct_t *dmix)
+{
+	snd_pcm_dmix_stage_t *stage = dmix->u.dmix.stage;
+	struct snd_pcm_dmix_stage_slot *slot;
+	unsigned int i;
+
+	for (i = 0; i < stage->slots; i++) {
+		slot = &stage->slot[i];
+		if (!slot->pid)
+			break;
+		/* slot of a crashed client */
+		if (kill(slot->pid, 0) < 0 && errno == ESRCH)
+			break;
+	}
+	if (i >= stage->slots) {
+		SNDERR("all %u dmix staging slots are in use", stage->slots);
+		return -EBUSY;
+	}
+	dmix->u.dmix.stage_snap = calloc(stage->slots, sizeof(*slot));
+	if (!dmix->u.dmix.stage_snap)
+		return -ENOMEM;
+	memset(stage_slab(dmix, i), 0,
+	       stage_slab_samples(dmix) * sizeof(signed int));
+	slot->start = slot->end = 0;
+	slot->dirty_begin = slot->dirty_end = 0;
+	slot->reduced_seq = slot->seq & ~1U;
+	__atomic_store_n(&slot->seq, slot->reduced_seq, __ATOMIC_RELEASE);
+	__atomic_store_n(&slot->pid, getpid(), __ATOMIC_RELEASE);
+	dmix->u.dmix.stage_slot = i;
+	return 0;
+}
+
+/* called with the client semaphore held */
+static void stage_release_slot(snd_pcm_direct_t *dmix)
+{
+	if (dmix->u.dmix.stage_slot >= 0) {
+		__atomic_store_n(&dmix->u.dmix.stage->slot[dmix->u.dmix.stage_slot].pid,
+				 0, __ATOMIC_RELEASE);
+		dmix->u.dmix.stage_slot = -1;
+	}
+	free(dmix->u.dmix.stage_snap);
+	dmix->u.dmix.stage_snap = NULL;
+}
+
+/*
+ * conversion between the slave format and the slab values
+ */
+static void stage_decode(snd_pcm_direct_t *dmix, signed int *dst,
+			 const unsigned char *src, size_t src_step,
+			 size_t dst_step, snd_pcm_uframes_t size,
+			 unsigned int gain)
+{
+	snd_pcm_format_t format = dmix->shmptr->s.format;
+	int swap = !snd_pcm_format_cpu_endian(format);
+	signed int *start = dst;
+	snd_pcm_uframes_t count = size;
+
+	switch (format) {
+	case SND_PCM_FORMAT_S16_LE:
+	case SND_PCM_FORMAT_S16_BE:
+		for (; size--; src += src_step, dst += dst_step) {
+			signed short v = *(const signed short *)src;
+			*dst = swap ? (signed short)bswap_16(v) : v;
+		}
+		break;
+	case SND_PCM_FORMAT_S32_LE:
+	case SND_PCM_FORMAT_S32_BE:
+		for (; size--; src += src_step, dst += dst_step) {
+			signed int v = *(const signed int *)src;
+			*dst = (swap ? (signed int)bswap_32(v) : v) >> 8;
+		}
+		break;
+	case SND_PCM_FORMAT_S24_LE:
+	case SND_PCM_FORMAT_S24_3LE:
+		for (; size--; src += src_step, dst += dst_step)
+			*dst = src[0] | (src[1] << 8) | (((signed char *)src)[2] << 16);
+		break;
+	case SND_PCM_FORMAT_U8:
+		for (; size--; src += src_step, dst += dst_step)
+			*dst = *src - 0x80;
+		break;
+	default:
+		break;
+	}
+	/* the client gain, while the decoded samples are still in the cache */
+	if (gain != DMIX_GAIN_UNITY)
+		for (; count--; start += dst_step)
+			*start = ((long long)*start * gain) >> DMIX_GAIN_SHIFT;
+}
+
+static void stage_encode(snd_pcm_direct_t *dmix, unsigned char *dst,
+			 const signed int *src, size_t dst_step,
+			 size_t src_step, snd_pcm_uframes_t size)
+{
+	snd_pcm_format_t format = dmix->shmptr->s.format;
+	int swap = !snd_pcm_format_cpu_endian(format);
+	signed int sample;
+
+	switch (format) {
+	case SND_PCM_FORMAT_S16_LE:
+	case SND_PCM_FORMAT_S16_BE:
+		for (; size--; src += src_step, dst += dst_step) {
+			sample = *src;
+			if (sample > 0x7fff)
+				sample = 0x7fff;
+			else if (sample < -0x8000)
+				sample = -0x8000;
+			*(signed short *)dst = swap ? (signed short)bswap_16(sample) : sample;
+		}
+		break;
+	case SND_PCM_FORMAT_S32_LE:
+	case SND_PCM_FORMAT_S32_BE:
+		for (; size--; src += src_step, dst += dst_step) {
+			sample = *src;
+			if (sample > 0x7fffff)
+				sample = 0x7fffffff;
+			else if (sample < -0x800000)
+				sample = -0x80000000;
+			else
+				sample *= 256;
+			*(signed int *)dst = swap ? (signed int)bswap_32(sample) : sample;
+		}
+		break;
+	case SND_PCM_FORMAT_S24_LE:
+	case SND_PCM_FORMAT_S24_3LE:
+		for (; size--; src += src_step, dst += dst_step) {
+			sample = *src;
+			if (sample > 0x7fffff)
+				sample = 0x7fffff;
+			else if (sample < -0x800000)
+				sample = -0x800000;
+			dst[0] = sample;
+			dst[1] = sample >> 8;
+			dst[2] = sample >> 16;
+		}
+		break;
+	case SND_PCM_FORMAT_U8:
+		for (; size--; src += src_step, dst += dst_step) {
+			sample = *src;
+			if (sample > 0x7f)
+				sample = 0x7f;
+			else if (sample < -0x80)
+				sample = -0x80;
+			*dst = sample + 0x80;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * client side: copy frames into the own slab (no locking)
+ */
+static void stage_copy_areas(snd_pcm_direct_t *dmix,
+			     const snd_pcm_channel_area_t *src_areas,
+			     snd_pcm_uframes_t src_ofs,
+			     snd_pcm_uframes_t dst_ofs,
+			     snd_pcm_uframes_t size)
+{
+	unsigned int chn, dchn, schannels = dmix->shmptr->s.channels;
+	signed int *slab = stage_slab(dmix, dmix->u.dmix.stage_slot);
+	const snd_pcm_channel_area_t *area;
+
+	for (chn = 0; chn < dmix->channels; chn++) {
+		dchn = dmix->bindings ? dmix->bindings[chn] : chn;
+		if (dchn >= schannels)
+			continue;
+		area = &src_areas[chn];
+		stage_decode(dmix, slab + dst_ofs * schannels + dchn,
+			     (const unsigned char *)area->addr + area->first / 8 +
+			     src_ofs * (area->step / 8),
+			     area->step / 8, schannels, size,
+			     dmix_gain(dmix, chn));
+	}
+}
+
+static inline unsigned long long stage_min(snd_pcm_direct_t *dmix,
+					   unsigned long long a,
+					   unsigned long long b)
+{
+	return stage_diff(dmix, a, b) < 0 ? a : b;
+}
+
+static inline unsigned long long stage_max(snd_pcm_direct_t *dmix,
+					   unsigned long long a,
+					   unsigned long long b)
+{
+	return stage_diff(dmix, a, b) > 0 ? a : b;
+}
+
+/*
+ * publish the new valid range [start, end) and the changed range
+ * [begin, stop) of the own slab
+ */
+static void stage_publish(snd_pcm_direct_t *dmix, unsigned long long start,
+			  unsigned long long end, unsigned long long begin,
+			  unsigned long long stop)
+{
+	snd_pcm_dmix_stage_t *stage = dmix->u.dmix.stage;
+	struct snd_pcm_dmix_stage_slot *slot = &stage->slot[dmix->u.dmix.stage_slot];
+	unsigned int seq = slot->seq;
+
+	__atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	/* the slab keeps only the last buffer_size frames */
+	if (stage_diff(dmix, end, start) > (snd_pcm_sframes_t)dmix->slave_buffer_size)
+		start = stage_pos(dmix, end, -(snd_pcm_sframes_t)dmix->slave_buffer_size);
+	slot->start = start;
+	slot->end = end;
+	if (__atomic_load_n(&slot->reduced_seq, __ATOMIC_RELAXED) != seq) {
+		/* the previous change was not handled yet, merge it */
+		begin = stage_min(dmix, begin, slot->dirty_begin);
+		stop = stage_max(dmix, stop, slot->dirty_end);
+	}
+	slot->dirty_begin = begin;
+	slot->dirty_end = stop;
+	__atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+	__atomic_add_fetch(&stage->pending, 1, __ATOMIC_SEQ_CST);
+}
+
+/* frames [begin, end) were written to the own slab */
+static void stage_commit(snd_pcm_direct_t *dmix, unsigned long long begin,
+			 unsigned long long end)
+{
+	struct snd_pcm_dmix_stage_slot *slot =
+		&dmix->u.dmix.stage->slot[dmix->u.dmix.stage_slot];
+	unsigned long long start = slot->start;
+
+	/* a gap (skipped frames, restart) invalidates the old contents */
+	if (slot->end != begin || slot->start == slot->end)
+		start = begin;
+	stage_publish(dmix, start, end, begin, end);
+}
+
+/* the own slab was rewound from old_end to end */
+static void stage_rewind(snd_pcm_direct_t *dmix, unsigned long long end,
+			 unsigned long long old_end)
+{
+	struct snd_pcm_dmix_stage_slot *slot =
+		&dmix->u.dmix.stage->slot[dmix->u.dmix.stage_slot];
+	unsigned long long start = slot->start;
+
+	if (stage_diff(dmix, start, end) > 0)
+		start = end;
+	stage_publish(dmix, start, end, end, old_end);
+}
+
+/* consistent copy of a slot, returns -EAGAIN if it's being updated */
+static int stage_snapshot(struct snd_pcm_dmix_stage_slot *slot,
+			  struct snd_pcm_dmix_stage_slot *snap)
+{
+	unsigned int seq, tries;
+
+	for (tries = 0; tries < 64; tries++) {
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+		snap->pid = __atomic_load_n(&slot->pid, __ATOMIC_RELAXED);
+		snap->reduced_seq = slot->reduced_seq;
+		snap->start = slot->start;
+		snap->end = slot->end;
+		snap->dirty_begin = slot->dirty_begin;
+		snap->dirty_end = slot->dirty_end;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq) {
+			snap->seq = seq;
+			return 0;
+		}
+	}
+	return -EAGAIN;
+}
+
+/* sum one channel of all slabs for frames base + [from, to) */
+static void stage_reduce_chn(snd_pcm_direct_t *dmix, unsigned int chn,
+			     snd_pcm_uframes_t base, snd_pcm_uframes_t ofs,
+			     snd_pcm_sframes_t from, snd_pcm_uframes_t frames)
+{
+	snd_pcm_dmix_stage_t *stage = dmix->u.dmix.stage;
+	struct snd_pcm_dmix_stage_slot *snap = dmix->u.dmix.stage_snap;
+	const snd_pcm_channel_area_t *area = &snd_pcm_mmap_areas(dmix->spcm)[chn];
+	unsigned int schannels = dmix->shmptr->s.channels;
+	signed int *acc = dmix->u.dmix.sum_buffer + ofs * schannels + chn;
+	const signed int *slab;
+	snd_pcm_sframes_t s, e;
+	unsigned int i;
+	size_t k;
+
+	for (k = 0; k < frames; k++)
+		acc[k * schannels] = 0;
+	for (i = 0; i < stage->slots; i++) {
+		if (!snap[i].pid)
+			continue;
+		s = stage_diff(dmix, snap[i].start, base);
+		e = stage_diff(dmix, snap[i].end, base);
+		if (s < from)
+			s = from;
+		if (e > from + (snd_pcm_sframes_t)frames)
+			e = from + frames;
+		if (s >= e)
+			continue;
+		slab = stage_slab(dmix, i) + (ofs + (s - from)) * schannels + chn;
+		for (k = 0; k < (size_t)(e - s); k++)
+			acc[((s - from) + k) * schannels] += slab[k * schannels];
+	}
+	stage_encode(dmix, (unsigned char *)area->addr +
+		     area->first / 8 + ofs * (area->step / 8),
+		     acc, area->step / 8, schannels, frames);
+}
+
+/* sum all slabs for frames base + [from, to) into the slave buffer */
+static void stage_reduce_range(snd_pcm_direct_t *dmix,
+			       snd_pcm_uframes_t base,
+			       snd_pcm_sframes_t from, snd_pcm_sframes_t to)
+{
+	snd_pcm_dmix_stage_t *stage = dmix->u.dmix.stage;
+	struct snd_pcm_dmix_stage_slot *snap = dmix->u.dmix.stage_snap;
+	const snd_pcm_channel_area_t *dst_areas = snd_pcm_mmap_areas(dmix->spcm);
+	unsigned int schannels = dmix->shmptr->s.channels;
+	snd_pcm_uframes_t ofs, frames;
+	snd_pcm_sframes_t s, e;
+	signed int *acc, *slab;
+	unsigned int i, chn, dirty, *map;
+	unsigned long long pos;
+	size_t k, n;
+
+	while (from < to) {
+		pos = stage_pos(dmix, base, from);
+		ofs = pos % dmix->slave_buffer_size;
+		frames = stage_period_left(dmix, pos);
+		if ((snd_pcm_sframes_t)frames > to - from)
+			frames = to - from;
+		map = stage_dirty(dmix, pos);
+		dirty = 0;
+		for (k = 0; k < stage->dirty_words; k++)
+			dirty += __builtin_popcount(__atomic_load_n(&map[k], __ATOMIC_RELAXED));
+		if (dirty < schannels) {
+			/* the unmarked channels keep the driver silence */
+			for (chn = 0; chn < schannels; chn++)
+				if (map[chn / 32] & (1U << (chn % 32)))
+					stage_reduce_chn(dmix, chn, base, ofs, from, frames);
+			from += frames;
+			continue;
+		}
+		acc = dmix->u.dmix.sum_buffer + ofs * schannels;
+		memset(acc, 0, frames * schannels * sizeof(*acc));
+		for (i = 0; i < stage->slots; i++) {
+			if (!snap[i].pid)
+				continue;
+			s = stage_diff(dmix, snap[i].start, base);
+			e = stage_diff(dmix, snap[i].end, base);
+			if (s < from)
+				s = from;
+			if (e > from + (snd_pcm_sframes_t)frames)
+				e = from + frames;
+			if (s >= e)
+				continue;
+			slab = stage_slab(dmix, i) + (ofs + (s - from)) * schannels;
+			n = (e - s) * schannels;
+			for (k = 0; k < n; k++)
+				acc[(s - from) * schannels + k] += slab[k];
+		}
+		for (chn = 0; chn < schannels; chn++) {
+			const snd_pcm_channel_area_t *area = &dst_areas[chn];
+			stage_encode(dmix, (unsigned char *)area->addr +
+				     area->first / 8 + ofs * (area->step / 8),
+				     acc + chn, area->step / 8, schannels, frames);
+		}
+		from += frames;
+	}
+}
+
+/* one reducer pass, called with the reducer role held */
+static int stage_reduce(snd_pcm_direct_t *dmix)
+{
+	snd_pcm_dmix_stage_t *stage = dmix->u.dmix.stage;
+	struct snd_pcm_dmix_stage_slot *snap = dmix->u.dmix.stage_snap;
+	snd_pcm_uframes_t base, period = dmix->slave_period_size;
+	snd_pcm_sframes_t limit, target, clean, lo, hi, b, e;
+	unsigned int i;
+
+	base = *dmix->spcm->hw.ptr;
+	stage_dirty_expire(dmix, base);
+	/* never touch the area which wraps to the playing period */
+	limit = dmix->slave_buffer_size - base % period;
+	target = (dmix->u.dmix.stage_periods + 1) * period - base % period;
+	if (target > limit)
+		target = limit;
+	clean = stage_diff(dmix, stage->clean_end, base);
+	if (clean < 0 || clean > limit)
+		clean = 0;
+
+	lo = limit;
+	hi = 0;
+	for (i = 0; i < stage->slots; i++) {
+		if (stage_snapshot(&stage->slot[i], &snap[i]) < 0)
+			return -EAGAIN;
+		if (!snap[i].pid || snap[i].seq == snap[i].reduced_seq)
+			continue;
+		/* late updates of already mixed frames */
+		b = stage_diff(dmix, snap[i].dirty_begin, base);
+		e = stage_diff(dmix, snap[i].dirty_end, base);
+		if (b < 0)
+			b = 0;
+		if (e > clean)
+			e = clean;
+		if (b < e) {
+			if (b < lo)
+				lo = b;
+			if (e > hi)
+				hi = e;
+		}
+	}
+
+	if (lo < hi)
+		stage_reduce_range(dmix, base, lo, hi);
+	/* periods coming into the mix-ahead window */
+	if (clean < target) {
+		stage_reduce_range(dmix, base, clean, target);
+		clean = target;
+	}
+
+	for (i = 0; i < stage->slots; i++) {
+		if (snap[i].pid)
+			stage->slot[i].reduced_seq = snap[i].seq;
+	}
+	stage->clean_end = stage_pos(dmix, base, clean);
+	return 0;
+}
+
+static int stage_trylock(snd_pcm_dmix_stage_t *stage)
+{
+	int pid = getpid(), owner = 0;
+
+	if (__atomic_compare_exchange_n(&stage->reducer, &owner, pid, 0,
+					__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return 1;
+	/* take over from a crashed reducer */
+	if (owner != pid && kill(owner, 0) < 0 && errno == ESRCH)
+		return __atomic_compare_exchange_n(&stage->reducer, &owner, pid, 0,
+						   __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+	return 0;
+}
+
+/*
+ * mix the slabs if the reducer role is free; when it's busy, the
+ * current reducer notices the bumped pending counter and repeats
+ */
+static void stage_mix(snd_pcm_direct_t *dmix)
+{
+	snd_pcm_dmix_stage_t *stage = dmix->u.dmix.stage;
+	unsigned int pending;
+
+	do {
+		if (!stage_trylock(stage))
+			return;
+		pending = __atomic_load_n(&stage->pending, __ATOMIC_ACQUIRE);
+		/* on -EAGAIN, the owner of the busy slot bumps pending when done */
+		stage_reduce(dmix);
+		__atomic_store_n(&stage->reducer, 0, __ATOMIC_RELEASE);
+	} while (__atomic_load_n(&stage->pending, __ATOMIC_ACQUIRE) != pending);
+}
@@ -104,7 +104,7 @@ static void share_areas(snd_pcm_direct_t *dshare,
 /*
  *  synchronize shm ring buffer with hardware
  */
-static void snd_pcm_dshare_sync_area(snd_pcm_t *pcm)
+static void snd_pcm_dshare_sync_area0(snd_pcm_t *pcm)
 {
 	snd_pcm_direct_t *dshare = pcm->private_data;
 	snd_pcm_uframes_t slave_hw_ptr, slave_appl_ptr, slave_size;
@@ -155,6 +155,23 @@ static void snd_pcm_dshare_sync_area(snd_pcm_t *pcm)
 	}
 }
 
+static void snd_pcm_dshare_sync_area(snd_pcm_t *pcm)
+{
+	snd_pcm_direct_t *dshare = pcm->private_data;
+	snd_pcm_uframes_t last_appl_ptr = dshare->last_appl_ptr;
+	unsigned long long start;
+
+	if (!snd_pcm_direct_stats_enabled(dshare)) {
+		snd_pcm_dshare_sync_area0(pcm);
+		return;
+	}
+	start = snd_pcm_direct_stats_now();
+	snd_pcm_dshare_sync_area0(pcm);
+	snd_pcm_direct_stats_mix(dshare, snd_pcm_direct_stats_now() - start,
+				 pcm_frame_diff(dshare->last_appl_ptr, last_appl_ptr,
+						pcm->boundary));
+}
+
 /*
  *  synchronize hardware pointer (hw_ptr) with ours
  */
@@ -182,7 +199,7 @@ static int snd_pcm_dshare_sync_ptr0(snd_pcm_t *pcm, snd_pcm_uframes_t slave_hw_p
 	if (avail > dshare->avail_max)
 		dshare->avail_max = avail;
 	if (avail >= pcm->stop_threshold) {
-		snd_timer_stop(dshare->timer);
+		snd_pcm_direct_timer_stop(dshare);
 		do_silence(pcm);
 		gettimestamp(&dshare->trigger_tstamp, pcm->tstamp_type);
 		if (dshare->state == SND_PCM_STATE_RUNNING) {
@@ -202,9 +219,7 @@ static int snd_pcm_dshare_sync_ptr(snd_pcm_t *pcm)
 	snd_pcm_uframes_t slave_hw_ptr;
 	int err;
 
-	if (dshare->slowptr)
-		snd_pcm_hwsync(dshare->spcm);
-	slave_hw_ptr = *dshare->spcm->hw.ptr;
+	slave_hw_ptr = snd_pcm_direct_slave_hw_ptr(dshare, 1);
 	err = snd_pcm_direct_check_xrun(dshare, pcm);
 	if (err < 0)
 		return err;
@@ -315,7 +330,7 @@ static int snd_pcm_dshare_start_timer(snd_pcm_t *pcm, snd_pcm_direct_t *dshare)
 
 	snd_pcm_hwsync(dshare->spcm);
 	snd_pcm_direct_reset_slave_ptr(pcm, dshare, *dshare->spcm->hw.ptr);
-	err = snd_timer_start(dshare->timer);
+	err = snd_pcm_direct_timer_start(dshare);
 	if (err < 0)
 		return err;
 	dshare->state = SND_PCM_STATE_RUNNING;
@@ -476,8 +491,7 @@ static int snd_pcm_dshare_close(snd_pcm_t *pcm)
 {
 	snd_pcm_direct_t *dshare = pcm->private_data;
 
-	if (dshare->timer)
-		snd_timer_close(dshare->timer);
+	snd_pcm_direct_timer_close(dshare);
 	if (dshare->bindings)
 		do_silence(pcm);
 	snd_pcm_direct_semaphore_down(dshare, DIRECT_IPC_SEM_CLIENT);
@@ -579,6 +593,7 @@ static void snd_pcm_dshare_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
 	}
+	snd_pcm_direct_stats_dump_local(dshare, out);
 	if (dshare->spcm)
 		snd_pcm_dump(dshare->spcm, out);
 }
@@ -612,6 +627,7 @@ static const snd_pcm_fast_ops_t snd_pcm_dshare_fast_ops = {
 	.hwsync = snd_pcm_dshare_hwsync,
 	.delay = snd_pcm_dshare_delay,
 	.prepare = snd_pcm_direct_prepare,
+	.resync = snd_pcm_direct_resync,
 	.reset = snd_pcm_dshare_reset,
 	.start = snd_pcm_dshare_start,
 	.drop = snd_pcm_dshare_drop,
@@ -713,6 +729,7 @@ int snd_pcm_dshare_open(snd_pcm_t **pcmp, const char *name,
 		}
 
 		dshare->spcm = spcm;
+		dshare->shmptr->u.dshare.lockfree = opts->lockfree;
 		
 		if (dshare->shmptr->use_server) {
 			ret = snd_pcm_direct_server_create(dshare);
@@ -805,8 +822,7 @@ int snd_pcm_dshare_open(snd_pcm_t **pcmp, const char *name,
  _err:
 	if (dshare->shmptr != (void *) -1)
 		dshare->shmptr->u.dshare.chn_mask &= ~dshare->u.dshare.chn_mask;
-	if (dshare->timer)
-		snd_timer_close(dshare->timer);
+	snd_pcm_direct_timer_close(dshare);
 	if (dshare->server)
 		snd_pcm_direct_server_discard(dshare);
 	if (dshare->client)
@@ -851,6 +867,9 @@ pcm.name {
 	tstamp_type STR		# timestamp type
 				# STR can be one of the below strings :
 				# default, gettimeofday, monotonic, monotonic_raw
+	wakeup STR		# source of poll() wakeups
+				# STR can be one of the below strings :
+				# timer (default), timerfd
 	slave STR
 	# or
 	slave {			# Slave definition
@@ -872,9 +891,36 @@ pcm.name {
 		N INT		# maps slave channel to client channel N
 	}
 	slowptr BOOL		# slow but more precise pointer updates
+	ptr_refresh INT		# share the slowptr updates, in us (default 0 = each call)
+	stats BOOL		# collect statistics in the shared memory (default false)
+	lockfree BOOL		# recover the slave without the semaphore (default false)
 }
 \endcode
 
+<code>lockfree</code> drops the IPC semaphore from the running stream.
+The clients own disjoint channels and never touch each other's data,
+so only restarting the slave after an xrun or suspend has to be
+serialized; the recovering client is elected by an atomic
+compare-and-swap in the shared memory and the others just go on until
+they notice the new recovery count.  The mode is fixed by the first
+client opening the instance.
+
+<code>ptr_refresh</code> (microseconds) lets the clients share the
+slowptr updates, see the dmix plugin.
+
+<code>stats</code> enables the statistics block in the shared memory
+area: semaphore wait times, mixing cost, xruns and the frames passed
+by each client.  It is switched on for the whole instance by the first
+client which sets it.  The counters are shown by snd_pcm_dump() and can
+be read from any process with snd_pcm_direct_stats_dump().
+
+<code>wakeup</code> selects what wakes up poll() and snd_pcm_wait().
+"timer" uses the PCM timer of the slave device.  "timerfd" uses a
+high resolution timerfd on CLOCK_MONOTONIC which is programmed from the
+slave period and htimestamp (it needs the monotonic tstamp_type for the
+phase) and avoids reading the kernel timer queue.  Asynchronous
+notification is not available with "timerfd".
+
 <code>hw_ptr_alignment</code> specifies slave application and hw
 pointer alignment type. By default hw_ptr_alignment is auto. Below are
 the possible configurations:
@@ -43,6 +43,7 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <sys/mman.h>
+#include <math.h>
 #include "pcm_direct.h"
 
 #ifndef PIC
@@ -96,6 +97,392 @@ static void snoop_areas(snd_pcm_direct_t *dsnoop,
 	}
 }
 
+/*
+ *  shared rate conversion (client_rate)
+ *
+ *  The clients capturing at the same lower rate share one decimator.  It
+ *  runs on the slave ring under the client semaphore, by whichever
+ *  client first sees new frames, and writes into a ring in the shm
+ *  segment at ipc_key + 1; each client then copies from there into its
+ *  own buffer as it does from the slave ring otherwise.  The converters
+ *  are keyed by the integer ratio of the slave rate to the client rate,
+ *  their output keeps the slave format and channels, and output frame n
+ *  ends with slave frame (n + 1) * factor - 1, so all clients agree on
+ *  the positions.
+ */
+#define DSNOOP_RATE_SLOTS	4	/* converters, one per client rate */
+#define DSNOOP_RATE_TAPS	16	/* filter taps per slave frame of a step */
+#define DSNOOP_RATE_CHUNK	256	/* output frames per filter pass */
+
+struct snd_pcm_dsnoop_rate_slot {
+	unsigned int factor;		/* 0 = free */
+	unsigned int recoveries;	/* s.recoveries seen at pos */
+	unsigned long long pos;		/* output frames before pos are converted */
+};
+
+struct snd_pcm_dsnoop_rate {
+	unsigned int ring_frames;	/* capacity of each ring */
+	unsigned int frame_bytes;
+	struct snd_pcm_dsnoop_rate_slot slot[DSNOOP_RATE_SLOTS];
+};
+
+#define DSNOOP_RATE_HEADER	((sizeof(snd_pcm_dsnoop_rate_t) + 63) & ~(size_t)63)
+
+static inline unsigned int rate_taps(snd_pcm_direct_t *dsnoop)
+{
+	return DSNOOP_RATE_TAPS * dsnoop->u.dsnoop.rate_factor;
+}
+
+/* output frames of the ring, and their boundary */
+static inline snd_pcm_uframes_t rate_ring_size(snd_pcm_direct_t *dsnoop)
+{
+	return dsnoop->slave_buffer_size / dsnoop->u.dsnoop.rate_factor;
+}
+
+static inline snd_pcm_uframes_t rate_boundary(snd_pcm_direct_t *dsnoop)
+{
+	return dsnoop->slave_boundary / dsnoop->u.dsnoop.rate_factor;
+}
+
+static inline unsigned char *rate_ring(snd_pcm_direct_t *dsnoop)
+{
+	snd_pcm_dsnoop_rate_t *rate = dsnoop->u.dsnoop.rate;
+
+	return (unsigned char *)rate + DSNOOP_RATE_HEADER +
+		(size_t)dsnoop->u.dsnoop.rate_slot * rate->ring_frames * rate->frame_bytes;
+}
+
+static inline float rate_read(snd_pcm_format_t format, const void *p)
+{
+	switch (format) {
+	case SND_PCM_FORMAT_S16:
+		return *(const int16_t *)p;
+	case SND_PCM_FORMAT_S32:
+		return *(const int32_t *)p;
+	default:
+		return *(const float *)p;
+	}
+}
+
+static inline void rate_write(snd_pcm_format_t format, void *p, float v)
+{
+	switch (format) {
+	case SND_PCM_FORMAT_S16:
+		if (v >= 32767.0f)
+			*(int16_t *)p = 0x7fff;
+		else if (v <= -32768.0f)
+			*(int16_t *)p = -0x8000;
+		else
+			*(int16_t *)p = lrintf(v);
+		break;
+	case SND_PCM_FORMAT_S32:
+		/* 2^31 - 1 is not a float */
+		if (v >= 2147483520.0f)
+			*(int32_t *)p = 0x7fffffff;
+		else if (v <= -2147483648.0f)
+			*(int32_t *)p = -0x7fffffff - 1;
+		else
+			*(int32_t *)p = lrintf(v);
+		break;
+	default:
+		*(float *)p = v;
+		break;
+	}
+}
+
+/* convert the output frames [pos, pos + frames) of one slave channel */
+static void rate_convert_chn(snd_pcm_direct_t *dsnoop,
+			     const snd_pcm_channel_area_t *area, unsigned int chn,
+			     snd_pcm_uframes_t pos, snd_pcm_uframes_t frames)
+{
+	snd_pcm_format_t format = dsnoop->shmptr->s.format;
+	unsigned int factor = dsnoop->u.dsnoop.rate_factor;
+	unsigned int taps = rate_taps(dsnoop);
+	unsigned int frame_bytes = dsnoop->u.dsnoop.rate->frame_bytes;
+	unsigned int sample_bytes = snd_pcm_format_physical_width(format) / 8;
+	snd_pcm_uframes_t sbuf = dsnoop->slave_buffer_size;
+	snd_pcm_uframes_t ring_size = rate_ring_size(dsnoop);
+	snd_pcm_uframes_t src, dst, k, n;
+	const float *coef = dsnoop->u.dsnoop.rate_coef;
+	float *x = dsnoop->u.dsnoop.rate_scratch;
+	unsigned char *ring = rate_ring(dsnoop) + chn * sample_bytes;
+	unsigned int j;
+	float acc;
+
+	/* gather the input: the frames of the first output and taps - factor before */
+	n = (frames - 1) * factor + taps;
+	src = (pos * factor) % sbuf;
+	src = (src + sbuf - (taps - factor)) % sbuf;
+	for (k = 0; k < n; k++) {
+		x[k] = rate_read(format, snd_pcm_channel_area_addr(area, src));
+		if (++src == sbuf)
+			src = 0;
+	}
+	dst = pos % ring_size;
+	for (k = 0; k < frames; k++, x += factor) {
+		acc = 0;
+		for (j = 0; j < taps; j++)
+			acc += coef[j] * x[j];
+		rate_write(format, ring + dst * frame_bytes, acc);
+		if (++dst == ring_size)
+			dst = 0;
+	}
+}
+
+/*
+ *  bring the converter up to the output frame target; called with
+ *  DIRECT_IPC_SEM_CLIENT held
+ */
+static void rate_convert(snd_pcm_direct_t *dsnoop, snd_pcm_uframes_t target)
+{
+	struct snd_pcm_dsnoop_rate_slot *slot =
+		&dsnoop->u.dsnoop.rate->slot[dsnoop->u.dsnoop.rate_slot];
+	const snd_pcm_channel_area_t *areas = snd_pcm_mmap_areas(dsnoop->spcm);
+	snd_pcm_uframes_t boundary = rate_boundary(dsnoop);
+	snd_pcm_uframes_t pos = slot->pos, n, max, frames;
+	unsigned int chn;
+
+	if (slot->recoveries != dsnoop->shmptr->s.recoveries) {
+		/* the slave pointers were restarted */
+		slot->recoveries = dsnoop->shmptr->s.recoveries;
+		pos = target;
+	}
+	n = pcm_frame_diff(target, pos, boundary);
+	/* another client is ahead of us by at most one ring */
+	if (n == 0 || n > boundary - rate_ring_size(dsnoop))
+		goto __end;
+	/* frames the hardware may be overwriting are lost anyway */
+	max = (dsnoop->slave_buffer_size - dsnoop->slave_period_size -
+	       rate_taps(dsnoop)) / dsnoop->u.dsnoop.rate_factor;
+	if (n > max) {
+		pos = (target + boundary - max) % boundary;
+		n = max;
+	}
+	while (n > 0) {
+		frames = n > DSNOOP_RATE_CHUNK ? DSNOOP_RATE_CHUNK : n;
+		for (chn = 0; chn < dsnoop->shmptr->s.channels; chn++)
+			rate_convert_chn(dsnoop, &areas[chn], chn, pos, frames);
+		pos = (pos + frames) % boundary;
+		n -= frames;
+	}
+ __end:
+	slot->pos = pos;
+}
+
+/*
+ *  synchronize the client buffer with the shared converter
+ */
+static snd_pcm_uframes_t snd_pcm_dsnoop_rate_sync_area(snd_pcm_t *pcm,
+					snd_pcm_uframes_t old_slave_hw_ptr,
+					snd_pcm_uframes_t slave_hw_ptr)
+{
+	snd_pcm_direct_t *dsnoop = pcm->private_data;
+	unsigned int factor = dsnoop->u.dsnoop.rate_factor;
+	snd_pcm_uframes_t ring_size = rate_ring_size(dsnoop);
+	snd_pcm_uframes_t from = old_slave_hw_ptr / factor;
+	snd_pcm_uframes_t to = slave_hw_ptr / factor;
+	snd_pcm_uframes_t hw_ptr, size, frames, transfer;
+	snd_pcm_format_t format = dsnoop->shmptr->s.format;
+	unsigned int schannels = dsnoop->shmptr->s.channels;
+	unsigned int chn, schn, bits;
+	const snd_pcm_channel_area_t *dst_areas;
+	snd_pcm_channel_area_t src_area;
+	unsigned long long start = 0;
+	int stats = snd_pcm_direct_stats_enabled(dsnoop);
+
+	frames = size = pcm_frame_diff(to, from, rate_boundary(dsnoop));
+	if (size == 0)
+		return 0;
+	if (stats)
+		start = snd_pcm_direct_stats_now();
+	snd_pcm_direct_semaphore_down(dsnoop, DIRECT_IPC_SEM_CLIENT);
+	rate_convert(dsnoop, to);
+	snd_pcm_direct_semaphore_up(dsnoop, DIRECT_IPC_SEM_CLIENT);
+	/* the ring frames stay valid for a slave buffer minus a period */
+	dst_areas = snd_pcm_mmap_areas(pcm);
+	bits = snd_pcm_format_physical_width(format);
+	src_area.addr = rate_ring(dsnoop);
+	src_area.step = schannels * bits;
+	hw_ptr = dsnoop->hw_ptr % pcm->buffer_size;
+	from %= ring_size;
+	while (size > 0) {
+		transfer = hw_ptr + size > pcm->buffer_size ? pcm->buffer_size - hw_ptr : size;
+		transfer = from + transfer > ring_size ? ring_size - from : transfer;
+		for (chn = 0; chn < dsnoop->channels; chn++) {
+			schn = dsnoop->bindings ? dsnoop->bindings[chn] : chn;
+			if (schn >= schannels)
+				continue;
+			src_area.first = schn * bits;
+			snd_pcm_area_copy(&dst_areas[chn], hw_ptr, &src_area, from,
+					  transfer, format);
+		}
+		size -= transfer;
+		from = (from + transfer) % ring_size;
+		hw_ptr = (hw_ptr + transfer) % pcm->buffer_size;
+	}
+	if (stats)
+		snd_pcm_direct_stats_mix(dsnoop, snd_pcm_direct_stats_now() - start,
+					 frames);
+	return frames;
+}
+
+static int rate_filter_init(snd_pcm_direct_t *dsnoop)
+{
+	unsigned int factor = dsnoop->u.dsnoop.rate_factor;
+	unsigned int taps = rate_taps(dsnoop), j;
+	double fc = 0.45 / factor, sum = 0, x, w, *h;
+
+	dsnoop->u.dsnoop.rate_coef = malloc(taps * sizeof(float));
+	dsnoop->u.dsnoop.rate_scratch =
+		malloc((DSNOOP_RATE_CHUNK * factor + taps) * sizeof(float));
+	h = malloc(taps * sizeof(*h));
+	if (!dsnoop->u.dsnoop.rate_coef || !dsnoop->u.dsnoop.rate_scratch || !h) {
+		free(h);
+		return -ENOMEM;
+	}
+	/* blackman windowed sinc, unity gain at DC */
+	for (j = 0; j < taps; j++) {
+		x = j - (taps - 1) / 2.0;
+		w = 0.42 - 0.5 * cos(2 * M_PI * j / (taps - 1)) +
+		    0.08 * cos(4 * M_PI * j / (taps - 1));
+		h[j] = w * (x == 0 ? 2 * fc : sin(2 * M_PI * fc * x) / (M_PI * x));
+		sum += h[j];
+	}
+	for (j = 0; j < taps; j++)
+		dsnoop->u.dsnoop.rate_coef[j] = h[j] / sum;
+	free(h);
+	return 0;
+}
+
+static void rate_discard(snd_pcm_direct_t *dsnoop)
+{
+	struct shmid_ds buf;
+
+	if (dsnoop->u.dsnoop.rate)
+		shmdt(dsnoop->u.dsnoop.rate);
+	dsnoop->u.dsnoop.rate = NULL;
+	if (dsnoop->u.dsnoop.shmid_rate >= 0 &&
+	    !shmctl(dsnoop->u.dsnoop.shmid_rate, IPC_STAT, &buf) &&
+	    !buf.shm_nattch)
+		shmctl(dsnoop->u.dsnoop.shmid_rate, IPC_RMID, NULL);
+	dsnoop->u.dsnoop.shmid_rate = -1;
+	free(dsnoop->u.dsnoop.rate_coef);
+	dsnoop->u.dsnoop.rate_coef = NULL;
+	free(dsnoop->u.dsnoop.rate_scratch);
+	dsnoop->u.dsnoop.rate_scratch = NULL;
+}
+
+/*
+ *  set up the client_rate conversion; called with DIRECT_IPC_SEM_CLIENT
+ *  held after the slave setup
+ */
+static int rate_open(snd_pcm_direct_t *dsnoop, unsigned int client_rate)
+{
+	snd_pcm_format_t format = dsnoop->shmptr->s.format;
+	unsigned int srate = dsnoop->shmptr->s.rate, factor;
+	unsigned int frame_bytes, ring_frames, i;
+	struct snd_pcm_dsnoop_rate_slot *slot;
+	snd_pcm_dsnoop_rate_t *rate;
+	struct shmid_ds buf;
+	size_t size;
+	int tmpid, err;
+
+#ifdef HAVE_SOFT_FLOAT
+	SNDERR("client_rate is not available without floating point");
+	return -ENXIO;
+#endif
+	if (client_rate == srate)
+		return 0;
+	factor = client_rate ? srate / client_rate : 0;
+	if (factor < 2 || factor * client_rate != srate) {
+		SNDERR("client_rate %u must divide the slave rate %u", client_rate, srate);
+		return -EINVAL;
+	}
+	if (format != SND_PCM_FORMAT_S16 && format != SND_PCM_FORMAT_S32 &&
+	    format != SND_PCM_FORMAT_FLOAT) {
+		SNDERR("client_rate needs a native S16, S32 or FLOAT slave format");
+		return -EINVAL;
+	}
+	if (dsnoop->slave_period_size % factor || dsnoop->slave_buffer_size % factor ||
+	    dsnoop->slave_buffer_size < dsnoop->slave_period_size +
+					DSNOOP_RATE_TAPS * factor + factor) {
+		SNDERR("slave buffer and period size must be multiples of %u", factor);
+		return -EINVAL;
+	}
+	dsnoop->u.dsnoop.rate_factor = factor;
+	dsnoop->u.dsnoop.zerocopy = 0;
+	err = rate_filter_init(dsnoop);
+	if (err < 0)
+		goto __error;
+
+	frame_bytes = snd_pcm_format_physical_width(format) / 8 *
+		      dsnoop->shmptr->s.channels;
+	ring_frames = dsnoop->slave_buffer_size / 2;
+	size = DSNOOP_RATE_HEADER +
+	       (size_t)DSNOOP_RATE_SLOTS * ring_frames * frame_bytes;
+retryshm:
+	dsnoop->u.dsnoop.shmid_rate = shmget(dsnoop->ipc_key + 1, size,
+					     IPC_CREAT | dsnoop->ipc_perm);
+	err = -errno;
+	if (dsnoop->u.dsnoop.shmid_rate < 0) {
+		if (errno == EINVAL)
+		if ((tmpid = shmget(dsnoop->ipc_key + 1, 0, dsnoop->ipc_perm)) != -1)
+		if (!shmctl(tmpid, IPC_STAT, &buf))
+		if (!buf.shm_nattch)
+		/* no users so destroy the segment */
+		if (!shmctl(tmpid, IPC_RMID, NULL))
+			goto retryshm;
+		goto __error;
+	}
+	if (shmctl(dsnoop->u.dsnoop.shmid_rate, IPC_STAT, &buf) < 0) {
+		err = -errno;
+		goto __error;
+	}
+	if (dsnoop->ipc_gid >= 0) {
+		buf.shm_perm.gid = dsnoop->ipc_gid;
+		shmctl(dsnoop->u.dsnoop.shmid_rate, IPC_SET, &buf);
+	}
+	rate = shmat(dsnoop->u.dsnoop.shmid_rate, 0, 0);
+	if (rate == (void *) -1) {
+		err = -errno;
+		goto __error;
+	}
+	dsnoop->u.dsnoop.rate = rate;
+	if (buf.shm_nattch == 0) {
+		memset(rate, 0, sizeof(*rate));
+		rate->ring_frames = ring_frames;
+		rate->frame_bytes = frame_bytes;
+	} else if (rate->ring_frames != ring_frames || rate->frame_bytes != frame_bytes) {
+		SNDERR("client_rate segment set up for another slave");
+		err = -EINVAL;
+		goto __error;
+	}
+	for (i = 0; i < DSNOOP_RATE_SLOTS; i++)
+		if (rate->slot[i].factor == factor)
+			break;
+	if (i == DSNOOP_RATE_SLOTS) {
+		for (i = 0; i < DSNOOP_RATE_SLOTS; i++)
+			if (!rate->slot[i].factor)
+				break;
+		if (i == DSNOOP_RATE_SLOTS) {
+			SNDERR("too many different client rates");
+			err = -EBUSY;
+			goto __error;
+		}
+		slot = &rate->slot[i];
+		slot->factor = factor;
+		slot->recoveries = dsnoop->shmptr->s.recoveries;
+		slot->pos = *dsnoop->spcm->hw.ptr / factor;
+	}
+	dsnoop->u.dsnoop.rate_slot = i;
+	return 0;
+
+ __error:
+	rate_discard(dsnoop);
+	dsnoop->u.dsnoop.rate_factor = 0;
+	return err;
+}
+
 /*
  *  synchronize shm ring buffer with hardware
  */
@@ -103,9 +490,19 @@ static void snd_pcm_dsnoop_sync_area(snd_pcm_t *pcm, snd_pcm_uframes_t slave_hw_
 {
 	snd_pcm_direct_t *dsnoop = pcm->private_data;
 	snd_pcm_uframes_t hw_ptr = dsnoop->hw_ptr;
-	snd_pcm_uframes_t transfer;
+	snd_pcm_uframes_t transfer, frames = size;
 	const snd_pcm_channel_area_t *src_areas, *dst_areas;
-	
+	unsigned long long start = 0;
+	int stats = snd_pcm_direct_stats_enabled(dsnoop);
+
+	if (dsnoop->u.dsnoop.shared) {
+		/* zerocopy: the client reads the slave ring in place */
+		if (stats)
+			snd_pcm_direct_stats_mix(dsnoop, 0, frames);
+		return;
+	}
+	if (stats)
+		start = snd_pcm_direct_stats_now();
 	/* add sample areas here */
 	dst_areas = snd_pcm_mmap_areas(pcm);
 	src_areas = snd_pcm_mmap_areas(dsnoop->spcm);
@@ -122,6 +519,9 @@ static void snd_pcm_dsnoop_sync_area(snd_pcm_t *pcm, snd_pcm_uframes_t slave_hw_
 		hw_ptr += transfer;
 		hw_ptr %= pcm->buffer_size;
 	}
+	if (stats)
+		snd_pcm_direct_stats_mix(dsnoop, snd_pcm_direct_stats_now() - start,
+					 frames);
 }
 
 /*
@@ -134,18 +534,25 @@ static int snd_pcm_dsnoop_sync_ptr(snd_pcm_t *pcm)
 	snd_pcm_sframes_t diff;
 	int err;
 
-	if (dsnoop->slowptr)
-		snd_pcm_hwsync(dsnoop->spcm);
+	/* no estimate: frames past the real hw_ptr are not captured yet */
+	snd_pcm_direct_slave_hw_ptr(dsnoop, 0);
 	old_slave_hw_ptr = dsnoop->slave_hw_ptr;
 	snoop_timestamp(pcm);
 	slave_hw_ptr = dsnoop->slave_hw_ptr;
 	err = snd_pcm_direct_check_xrun(dsnoop, pcm);
 	if (err < 0)
 		return err;
+	if (dsnoop->u.dsnoop.rate_factor) {
+		diff = snd_pcm_dsnoop_rate_sync_area(pcm, old_slave_hw_ptr, slave_hw_ptr);
+		if (diff == 0)
+			return 0;
+		goto __forward;
+	}
 	diff = pcm_frame_diff(slave_hw_ptr, old_slave_hw_ptr, dsnoop->slave_boundary);
 	if (diff == 0)		/* fast path */
 		return 0;
 	snd_pcm_dsnoop_sync_area(pcm, old_slave_hw_ptr, diff);
+ __forward:
 	dsnoop->hw_ptr += diff;
 	dsnoop->hw_ptr %= pcm->boundary;
 	// printf("sync ptr diff = %li\n", diff);
@@ -162,6 +569,20 @@ static int snd_pcm_dsnoop_sync_ptr(snd_pcm_t *pcm)
 	return 0;
 }
 
+/*
+ *  zerocopy: the client areas are the slave ring, so the client hw_ptr
+ *  must stay in phase with the slave hw_ptr
+ */
+static void snd_pcm_dsnoop_align_ptr(snd_pcm_t *pcm)
+{
+	snd_pcm_direct_t *dsnoop = pcm->private_data;
+
+	if (!dsnoop->u.dsnoop.shared)
+		return;
+	dsnoop->hw_ptr = dsnoop->slave_hw_ptr % pcm->buffer_size;
+	dsnoop->appl_ptr = dsnoop->hw_ptr;
+}
+
 /*
  *  plugin implementation
  */
@@ -252,6 +673,7 @@ static int snd_pcm_dsnoop_reset(snd_pcm_t *pcm)
 	dsnoop->hw_ptr %= pcm->period_size;
 	dsnoop->appl_ptr = dsnoop->hw_ptr;
 	snd_pcm_direct_reset_slave_ptr(pcm, dsnoop, dsnoop->slave_hw_ptr);
+	snd_pcm_dsnoop_align_ptr(pcm);
 	return 0;
 }
 
@@ -265,7 +687,8 @@ static int snd_pcm_dsnoop_start(snd_pcm_t *pcm)
 	snd_pcm_hwsync(dsnoop->spcm);
 	snoop_timestamp(pcm);
 	snd_pcm_direct_reset_slave_ptr(pcm, dsnoop, dsnoop->slave_hw_ptr);
-	err = snd_timer_start(dsnoop->timer);
+	snd_pcm_dsnoop_align_ptr(pcm);
+	err = snd_pcm_direct_timer_start(dsnoop);
 	if (err < 0)
 		return err;
 	dsnoop->state = SND_PCM_STATE_RUNNING;
@@ -279,7 +702,7 @@ static int snd_pcm_dsnoop_drop(snd_pcm_t *pcm)
 	if (dsnoop->state == SND_PCM_STATE_OPEN)
 		return -EBADFD;
 	dsnoop->state = SND_PCM_STATE_SETUP;
-	snd_timer_stop(dsnoop->timer);
+	snd_pcm_direct_timer_stop(dsnoop);
 	return 0;
 }
 
@@ -364,13 +787,202 @@ static snd_pcm_sframes_t snd_pcm_dsnoop_writen(snd_pcm_t *pcm ATTRIBUTE_UNUSED,
 	return -ENODEV;
 }
 
+/*
+ *  zerocopy: can the client use the slave areas as its own buffer?
+ */
+static int snd_pcm_dsnoop_zerocopy_layout(snd_pcm_t *pcm)
+{
+	snd_pcm_direct_t *dsnoop = pcm->private_data;
+	const snd_pcm_channel_area_t *sareas = snd_pcm_mmap_areas(dsnoop->spcm);
+	const snd_pcm_channel_area_t *a, *a0;
+	unsigned int chn;
+
+	if (!sareas || !dsnoop->spcm->mmap_channels ||
+	    pcm->buffer_size != dsnoop->slave_buffer_size)
+		return 0;
+	a0 = &sareas[dsnoop->bindings ? dsnoop->bindings[0] : 0];
+	for (chn = 0; chn < pcm->channels; chn++) {
+		a = &sareas[dsnoop->bindings ? dsnoop->bindings[chn] : chn];
+		switch (pcm->access) {
+		case SND_PCM_ACCESS_MMAP_INTERLEAVED:
+			/* the application may assume the usual frame layout */
+			if (a->addr != a0->addr ||
+			    a->first != a0->first + chn * pcm->sample_bits ||
+			    a->step != pcm->frame_bits)
+				return 0;
+			break;
+		case SND_PCM_ACCESS_MMAP_NONINTERLEAVED:
+			if (a->step != pcm->sample_bits)
+				return 0;
+			break;
+		default:
+			/* read through snd_pcm_mmap_readi/readn, any layout */
+			break;
+		}
+	}
+	return 1;
+}
+
+/*
+ *  map the slave ring once more, read-only, for this client; returns
+ *  NULL if the slave buffer is not a single device mapping, as the
+ *  slave areas are shared writable by all clients
+ */
+static void *snd_pcm_dsnoop_map_ring(snd_pcm_direct_t *dsnoop, size_t *sizep)
+{
+	snd_pcm_t *spcm = dsnoop->spcm;
+	const snd_pcm_channel_info_t *i0 = &spcm->mmap_channels[0];
+	size_t size = 0;
+	unsigned int chn;
+	void *ptr;
+
+	for (chn = 0; chn < spcm->channels; chn++) {
+		const snd_pcm_channel_info_t *i = &spcm->mmap_channels[chn];
+		size_t s;
+		if (i->type != SND_PCM_AREA_MMAP || i0->type != SND_PCM_AREA_MMAP ||
+		    i->addr != i0->addr || i->u.mmap.fd != i0->u.mmap.fd ||
+		    i->u.mmap.offset != i0->u.mmap.offset)
+			return NULL;
+		s = i->first + i->step * (spcm->buffer_size - 1) + spcm->sample_bits;
+		if (s > size)
+			size = s;
+	}
+	size = page_align((size + 7) / 8);
+	ptr = mmap(NULL, size, PROT_READ, MAP_FILE|MAP_SHARED,
+		   i0->u.mmap.fd, i0->u.mmap.offset);
+	if (ptr == MAP_FAILED)
+		return NULL;
+	*sizep = size;
+	return ptr;
+}
+
+static int snd_pcm_dsnoop_munmap(snd_pcm_t *pcm)
+{
+	snd_pcm_direct_t *dsnoop = pcm->private_data;
+
+	if (!dsnoop->u.dsnoop.shared)
+		return 0;
+	if (dsnoop->u.dsnoop.ring)
+		munmap(dsnoop->u.dsnoop.ring, dsnoop->u.dsnoop.ring_size);
+	dsnoop->u.dsnoop.ring = NULL;
+	free(pcm->mmap_channels);
+	free(pcm->running_areas);
+	pcm->mmap_channels = NULL;
+	pcm->running_areas = NULL;
+	pcm->mmap_locked = 0;
+	pcm->mmap_shadow = 0;
+	dsnoop->u.dsnoop.shared = 0;
+	return 0;
+}
+
+/*
+ *  In zerocopy mode the client areas point into a read-only mapping of
+ *  the slave ring instead of a private buffer, so
+ *  snd_pcm_dsnoop_sync_area() has nothing to copy.  Otherwise
+ *  snd_pcm_mmap() allocates the private buffer, also when a layer above
+ *  changes the samples in place (mmap_inplace) or the ring cannot be
+ *  mapped read-only.
+ */
+static int snd_pcm_dsnoop_mmap(snd_pcm_t *pcm)
+{
+	snd_pcm_direct_t *dsnoop = pcm->private_data;
+	snd_pcm_t *spcm = dsnoop->spcm;
+	unsigned int chn;
+
+	pcm->mmap_shadow = 0;
+	if (!dsnoop->u.dsnoop.zerocopy || pcm->mmap_inplace ||
+	    !snd_pcm_dsnoop_zerocopy_layout(pcm))
+		return 0;
+	dsnoop->u.dsnoop.ring = snd_pcm_dsnoop_map_ring(dsnoop,
+							&dsnoop->u.dsnoop.ring_size);
+	if (!dsnoop->u.dsnoop.ring)
+		return 0;
+	pcm->mmap_channels = calloc(pcm->channels, sizeof(pcm->mmap_channels[0]));
+	pcm->running_areas = calloc(pcm->channels, sizeof(pcm->running_areas[0]));
+	if (!pcm->mmap_channels || !pcm->running_areas) {
+		free(pcm->mmap_channels);
+		free(pcm->running_areas);
+		pcm->mmap_channels = NULL;
+		pcm->running_areas = NULL;
+		munmap(dsnoop->u.dsnoop.ring, dsnoop->u.dsnoop.ring_size);
+		dsnoop->u.dsnoop.ring = NULL;
+		return -ENOMEM;
+	}
+	for (chn = 0; chn < pcm->channels; chn++) {
+		unsigned int schn = dsnoop->bindings ? dsnoop->bindings[chn] : chn;
+		snd_pcm_channel_info_t *i = &pcm->mmap_channels[chn];
+		snd_pcm_channel_area_t *a = &pcm->running_areas[chn];
+
+		*i = spcm->mmap_channels[schn];
+		i->channel = chn;
+		i->addr = dsnoop->u.dsnoop.ring;
+		a->addr = i->addr;
+		a->first = spcm->running_areas[schn].first;
+		a->step = spcm->running_areas[schn].step;
+	}
+	dsnoop->u.dsnoop.shared = 1;
+	pcm->mmap_shadow = 1;
+	return 0;
+}
+
+/*
+ *  client_rate: the client sees the slave format and channels at its own
+ *  rate, with the period of the slave scaled down
+ */
+static int snd_pcm_dsnoop_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
+{
+	snd_pcm_direct_t *dsnoop = pcm->private_data;
+	unsigned int factor = dsnoop->u.dsnoop.rate_factor;
+	snd_pcm_uframes_t period_size;
+	static const snd_mask_t access = { .bits = {
+					(1<<SNDRV_PCM_ACCESS_MMAP_INTERLEAVED) |
+					(1<<SNDRV_PCM_ACCESS_MMAP_NONINTERLEAVED) |
+					(1<<SNDRV_PCM_ACCESS_RW_INTERLEAVED) |
+					(1<<SNDRV_PCM_ACCESS_RW_NONINTERLEAVED),
+					0, 0, 0 } };
+	int err;
+
+	if (!factor)
+		return snd_pcm_direct_hw_refine(pcm, params);
+	period_size = dsnoop->slave_period_size / factor;
+	err = _snd_pcm_hw_param_set_mask(params, SND_PCM_HW_PARAM_ACCESS, &access);
+	if (err < 0)
+		return err;
+	err = _snd_pcm_hw_params_set_format(params, dsnoop->shmptr->s.format);
+	if (err < 0)
+		return err;
+	err = _snd_pcm_hw_param_set(params, SND_PCM_HW_PARAM_CHANNELS,
+				    dsnoop->channels, 0);
+	if (err < 0)
+		return err;
+	err = _snd_pcm_hw_param_set(params, SND_PCM_HW_PARAM_RATE,
+				    dsnoop->shmptr->s.rate / factor, 0);
+	if (err < 0)
+		return err;
+	err = _snd_pcm_hw_param_set(params, SND_PCM_HW_PARAM_PERIOD_SIZE,
+				    period_size, 0);
+	if (err < 0)
+		return err;
+	err = _snd_pcm_hw_param_set_minmax(params, SND_PCM_HW_PARAM_BUFFER_SIZE,
+					   2 * period_size, 0,
+					   rate_ring_size(dsnoop), 0);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_refine_soft(pcm, params);
+	if (err < 0)
+		return err;
+	dsnoop->timer_ticks = 1;
+	params->info = dsnoop->shmptr->s.info;
+	return 0;
+}
+
 static int snd_pcm_dsnoop_close(snd_pcm_t *pcm)
 {
 	snd_pcm_direct_t *dsnoop = pcm->private_data;
 
-	if (dsnoop->timer)
-		snd_timer_close(dsnoop->timer);
+	snd_pcm_direct_timer_close(dsnoop);
 	snd_pcm_direct_semaphore_down(dsnoop, DIRECT_IPC_SEM_CLIENT);
+	rate_discard(dsnoop);
 	snd_pcm_close(dsnoop->spcm);
  	if (dsnoop->server)
  		snd_pcm_direct_server_discard(dsnoop);
@@ -456,6 +1068,13 @@ static void snd_pcm_dsnoop_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
 	}
+	if (dsnoop->u.dsnoop.shared)
+		snd_output_printf(out, "Zerocopy: slave ring mapped %s\n",
+				  dsnoop->u.dsnoop.ring ? "read-only" : "shared");
+	if (dsnoop->u.dsnoop.rate_factor)
+		snd_output_printf(out, "Client rate: 1/%u of the slave, shared converter %i\n",
+				  dsnoop->u.dsnoop.rate_factor, dsnoop->u.dsnoop.rate_slot);
+	snd_pcm_direct_stats_dump_local(dsnoop, out);
 	if (dsnoop->spcm)
 		snd_pcm_dump(dsnoop->spcm, out);
 }
@@ -463,7 +1082,7 @@ static void snd_pcm_dsnoop_dump(snd_pcm_t *pcm, snd_output_t *out)
 static const snd_pcm_ops_t snd_pcm_dsnoop_ops = {
 	.close = snd_pcm_dsnoop_close,
 	.info = snd_pcm_direct_info,
-	.hw_refine = snd_pcm_direct_hw_refine,
+	.hw_refine = snd_pcm_dsnoop_hw_refine,
 	.hw_params = snd_pcm_direct_hw_params,
 	.hw_free = snd_pcm_direct_hw_free,
 	.sw_params = snd_pcm_direct_sw_params,
@@ -471,8 +1090,8 @@ static const snd_pcm_ops_t snd_pcm_dsnoop_ops = {
 	.dump = snd_pcm_dsnoop_dump,
 	.nonblock = snd_pcm_direct_nonblock,
 	.async = snd_pcm_direct_async,
-	.mmap = snd_pcm_direct_mmap,
-	.munmap = snd_pcm_direct_munmap,
+	.mmap = snd_pcm_dsnoop_mmap,
+	.munmap = snd_pcm_dsnoop_munmap,
 	.query_chmaps = snd_pcm_direct_query_chmaps,
 	.get_chmap = snd_pcm_direct_get_chmap,
 	.set_chmap = snd_pcm_direct_set_chmap,
@@ -484,6 +1103,7 @@ static const snd_pcm_fast_ops_t snd_pcm_dsnoop_fast_ops = {
 	.hwsync = snd_pcm_dsnoop_hwsync,
 	.delay = snd_pcm_dsnoop_delay,
 	.prepare = snd_pcm_direct_prepare,
+	.resync = snd_pcm_direct_resync,
 	.reset = snd_pcm_dsnoop_reset,
 	.start = snd_pcm_dsnoop_start,
 	.drop = snd_pcm_dsnoop_drop,
@@ -555,6 +1175,8 @@ int snd_pcm_dsnoop_open(snd_pcm_t **pcmp, const char *name,
 	dsnoop->var_periodsize = opts->var_periodsize;
 	dsnoop->sync_ptr = snd_pcm_dsnoop_sync_ptr;
 	dsnoop->hw_ptr_alignment = opts->hw_ptr_alignment;
+	dsnoop->u.dsnoop.zerocopy = opts->zerocopy;
+	dsnoop->u.dsnoop.shmid_rate = -1;
 
  retry:
 	if (first_instance) {
@@ -652,6 +1274,12 @@ int snd_pcm_dsnoop_open(snd_pcm_t **pcmp, const char *name,
 	
 	if (dsnoop->channels == UINT_MAX)
 		dsnoop->channels = dsnoop->shmptr->s.channels;
+
+	if (opts->client_rate) {
+		ret = rate_open(dsnoop, opts->client_rate);
+		if (ret < 0)
+			goto _err;
+	}
 	
 	snd_pcm_direct_semaphore_up(dsnoop, DIRECT_IPC_SEM_CLIENT);
 
@@ -659,8 +1287,8 @@ int snd_pcm_dsnoop_open(snd_pcm_t **pcmp, const char *name,
 	return 0;
 	
  _err:
- 	if (dsnoop->timer)
-		snd_timer_close(dsnoop->timer);
+ 	snd_pcm_direct_timer_close(dsnoop);
+	rate_discard(dsnoop);
 	if (dsnoop->server)
 		snd_pcm_direct_server_discard(dsnoop);
 	if (dsnoop->client)
@@ -705,6 +1333,9 @@ pcm.name {
 	tstamp_type STR		# timestamp type
 				# STR can be one of the below strings :
 				# default, gettimeofday, monotonic, monotonic_raw
+	wakeup STR		# source of poll() wakeups
+				# STR can be one of the below strings :
+				# timer (default), timerfd
 	slave STR
 	# or
 	slave {			# Slave definition
@@ -726,9 +1357,56 @@ pcm.name {
 		N INT		# maps slave channel to client channel N
 	}
 	slowptr BOOL		# slow but more precise pointer updates
+	ptr_refresh INT		# share the slowptr updates, in us (default 0 = each call)
+	stats BOOL		# collect statistics in the shared memory (default false)
+	zerocopy BOOL		# read the slave ring in place (default false)
+	client_rate INT		# capture at slave rate / N, converted once for all
 }
 \endcode
 
+<code>zerocopy</code> lets the clients read the captured data directly
+from the slave ring buffer instead of copying it into a private buffer
+at every pointer update.  Each client gets its own read-only mapping of
+the ring and its hw_ptr is kept in phase with the slave; only the
+application pointer is private.  The client buffer size is fixed to the
+slave buffer size.  With mmap access the bound slave channels must form
+the layout of the requested access type, otherwise the plugin silently
+falls back to the private buffer.  The shared ring is read-only: the
+plugin also keeps the private buffer below a plugin that changes the
+captured samples in place (an extplug with the process callback, a file
+plugin with an infile), or when the slave buffer is not a single device
+mapping.  An application using mmap access must not write to the
+areas.  As the hardware keeps writing into
+the shared ring, a client should not let more than buffer size minus
+one period frames pile up.
+
+<code>client_rate</code> gives the client a rate which divides the
+slave rate by an integer N.  The decimation (a windowed-sinc low-pass
+filter on the slave frames) runs once for all clients of the same
+client_rate: whoever updates its pointer first converts the new frames
+into a ring in the shared memory, the others only copy them.  Format and
+channels stay those of the slave, the period is the slave period divided
+by N, so the slave period and buffer sizes must be multiples of N.  The
+slave format must be S16, S32 or FLOAT.  Up to four different client
+rates can share one slave; zerocopy is not used with client_rate.
+
+<code>ptr_refresh</code> (microseconds) lets the clients share the
+slowptr updates, see the dmix plugin.  The capture pointer is not
+extrapolated, only refreshed less often.
+
+<code>stats</code> enables the statistics block in the shared memory
+area: semaphore wait times, mixing cost, xruns and the frames passed
+by each client.  It is switched on for the whole instance by the first
+client which sets it.  The counters are shown by snd_pcm_dump() and can
+be read from any process with snd_pcm_direct_stats_dump().
+
+<code>wakeup</code> selects what wakes up poll() and snd_pcm_wait().
+"timer" uses the PCM timer of the slave device.  "timerfd" uses a
+high resolution timerfd on CLOCK_MONOTONIC which is programmed from the
+slave period and htimestamp (it needs the monotonic tstamp_type for the
+phase) and avoids reading the kernel timer queue.  Asynchronous
+notification is not available with "timerfd".
+
 <code>hw_ptr_alignment</code> specifies slave application and hw
 pointer alignment type. By default hw_ptr_alignment is auto. Below are
 the possible configurations:
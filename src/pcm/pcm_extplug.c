@@ -43,6 +43,9 @@ typedef struct snd_pcm_extplug_priv {
 	snd_pcm_extplug_t *data;
 	struct snd_ext_parm params[SND_PCM_EXTPLUG_HW_PARAMS];
 	struct snd_ext_parm sparams[SND_PCM_EXTPLUG_HW_PARAMS];
+	int layout;		/* SND_PCM_EXTPLUG_LAYOUT_* of the slave */
+	unsigned int align;	/* required alignment of the slave areas */
+	int inplace;		/* process callback is used, set at hw_params */
 } extplug_priv_t;
 
 static const int hw_params_type[SND_PCM_EXTPLUG_HW_PARAMS] = {
@@ -225,6 +228,14 @@ static int snd_pcm_extplug_hw_refine_sprepare(snd_pcm_t *pcm,
 {
 	extplug_priv_t *ext = pcm->private_data;
 	snd_pcm_access_mask_t saccess_mask = { SND_PCM_ACCBIT_MMAP };
+
+	if (ext->layout == SND_PCM_EXTPLUG_LAYOUT_INTERLEAVED) {
+		snd_pcm_access_mask_none(&saccess_mask);
+		snd_pcm_access_mask_set(&saccess_mask, SND_PCM_ACCESS_MMAP_INTERLEAVED);
+	} else if (ext->layout == SND_PCM_EXTPLUG_LAYOUT_PLANAR) {
+		snd_pcm_access_mask_none(&saccess_mask);
+		snd_pcm_access_mask_set(&saccess_mask, SND_PCM_ACCESS_MMAP_NONINTERLEAVED);
+	}
 	_snd_pcm_hw_params_any(sparams);
 	_snd_pcm_hw_param_set_mask(sparams, SND_PCM_HW_PARAM_ACCESS,
 				   &saccess_mask);
@@ -286,6 +297,21 @@ static int snd_pcm_extplug_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params
 	return err;
 }
 
+/*
+ * the process callback may work in place on the slave areas, tell the
+ * slave before it maps its buffer
+ */
+static int snd_pcm_extplug_slave_hw_params(snd_pcm_t *pcm,
+					   snd_pcm_hw_params_t *params)
+{
+	extplug_priv_t *ext = pcm->private_data;
+	snd_pcm_t *slave = ext->plug.gen.slave;
+
+	slave->mmap_inplace = ext->data->version >= 0x010003 &&
+		ext->data->callback->process;
+	return _snd_pcm_hw_params_internal(slave, params);
+}
+
 /*
  * hw_params callback
  */
@@ -298,7 +324,7 @@ static int snd_pcm_extplug_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params
 					  snd_pcm_extplug_hw_refine_cchange,
 					  snd_pcm_extplug_hw_refine_sprepare,
 					  snd_pcm_extplug_hw_refine_schange,
-					  snd_pcm_generic_hw_params);
+					  snd_pcm_extplug_slave_hw_params);
 	if (err < 0)
 		return err;
 	ext->data->slave_format = slave->format;
@@ -308,6 +334,11 @@ static int snd_pcm_extplug_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params
 	INTERNAL(snd_pcm_hw_params_get_format)(params, &ext->data->format);
 	INTERNAL(snd_pcm_hw_params_get_subformat)(params, &ext->data->subformat);
 	INTERNAL(snd_pcm_hw_params_get_channels)(params, &ext->data->channels);
+	ext->inplace = ext->data->version >= 0x010003 &&
+		ext->data->callback->process &&
+		ext->data->format == ext->data->slave_format &&
+		ext->data->subformat == ext->data->slave_subformat &&
+		ext->data->channels == ext->data->slave_channels;
 
 	if (ext->data->callback->hw_params) {
 		err = ext->data->callback->hw_params(ext->data, params);
@@ -330,8 +361,34 @@ static int snd_pcm_extplug_hw_free(snd_pcm_t *pcm)
 	return 0;
 }
 
+/*
+ * check whether the process callback can work on the slave areas at offset
+ */
+static int extplug_can_process(extplug_priv_t *ext, snd_pcm_t *pcm,
+			       const snd_pcm_channel_area_t *slave_areas,
+			       snd_pcm_uframes_t slave_offset)
+{
+	unsigned int chn;
+
+	if (!ext->inplace)
+		return 0;
+	if (ext->align <= 1)
+		return 1;
+	for (chn = 0; chn < pcm->channels; chn++) {
+		const snd_pcm_channel_area_t *a = &slave_areas[chn];
+		unsigned long addr = (unsigned long)a->addr +
+			(a->first + slave_offset * a->step) / 8;
+		if (addr % ext->align)
+			return 0;
+	}
+	return 1;
+}
+
 /*
  * write_areas skeleton - call transfer callback
+ *
+ * With the process callback, the samples are copied once into the slave
+ * area and processed there, sparing the plugin its own bounce buffer.
  */
 static snd_pcm_uframes_t
 snd_pcm_extplug_write_areas(snd_pcm_t *pcm,
@@ -346,8 +403,14 @@ snd_pcm_extplug_write_areas(snd_pcm_t *pcm,
 
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	size = ext->data->callback->transfer(ext->data, slave_areas, slave_offset,
-					     areas, offset, size);
+	if (extplug_can_process(ext, pcm, slave_areas, slave_offset)) {
+		snd_pcm_areas_copy(slave_areas, slave_offset, areas, offset,
+				   pcm->channels, size, pcm->format);
+		size = ext->data->callback->process(ext->data, slave_areas,
+						    slave_offset, size);
+	} else
+		size = ext->data->callback->transfer(ext->data, slave_areas, slave_offset,
+						     areas, offset, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -368,8 +431,15 @@ snd_pcm_extplug_read_areas(snd_pcm_t *pcm,
 
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	size = ext->data->callback->transfer(ext->data, areas, offset,
-					     slave_areas, slave_offset, size);
+	if (extplug_can_process(ext, pcm, slave_areas, slave_offset)) {
+		size = ext->data->callback->process(ext->data, slave_areas,
+						    slave_offset, size);
+		if ((snd_pcm_sframes_t)size > 0)
+			snd_pcm_areas_copy(areas, offset, slave_areas, slave_offset,
+					   pcm->channels, size, pcm->format);
+	} else
+		size = ext->data->callback->transfer(ext->data, areas, offset,
+						     slave_areas, slave_offset, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -402,6 +472,7 @@ static void snd_pcm_extplug_dump(snd_pcm_t *pcm, snd_output_t *out)
 			snd_pcm_dump_setup(pcm, out);
 		}
 	}
+	snd_pcm_plugin_dump_profile(pcm, out);
 	snd_output_printf(out, "Slave: ");
 	snd_pcm_dump(ext->plug.gen.slave, out);
 }
@@ -653,6 +724,15 @@ snd_pcm_extplug_set_param_*() and afterwards
 #snd_pcm_extplug_set_param_link(ext, SND_PCM_EXTPLUG_HW_FORMAT, 1) and
 #snd_pcm_extplug_set_param_link(ext, SND_PCM_EXTPLUG_HW_CHANNELS, 1) should be
 called to keep the client and slave parameters the same.
+
+Since version 1.0.3, a plugin can provide the process callback in addition
+to transfer.  When the client and slave formats and channels are the same
+(typically both kept linked), alsa-lib copies the samples once into the
+slave mmap area and the process callback works on them in place, instead
+of passing separate source and destination areas to transfer.  With
+#snd_pcm_extplug_set_slave_layout() the plugin chooses whether the slave
+area is interleaved or planar and which alignment it needs, so it can run
+its DSP code on the slave buffer directly without a bounce buffer of its own.
 */
 
 /**
@@ -884,3 +964,35 @@ int snd_pcm_extplug_set_param_link(snd_pcm_extplug_t *extplug, int type,
 	ext->sparams[type].keep_link = keep_link ? 1 : 0;
 	return 0;
 }
+
+/**
+ * @brief Request a slave buffer layout for the process callback
+ * @param extplug the extplug handle
+ * @param layout SND_PCM_EXTPLUG_LAYOUT_* value
+ * @param align required byte alignment of the channel areas, 0 for none
+ * @return 0 if successful, or a negative error code
+ *
+ * Restricts the access type of the slave PCM so that the process callback
+ * sees the areas in the requested layout.  Combine it with the slave format
+ * constraint, e.g. #SND_PCM_FORMAT_FLOAT, to get planar or interleaved float
+ * buffers.  Periods whose areas do not meet the alignment go through the
+ * transfer callback instead.
+ */
+int snd_pcm_extplug_set_slave_layout(snd_pcm_extplug_t *extplug, int layout,
+				     unsigned int align)
+{
+	extplug_priv_t *ext = extplug->pcm->private_data;
+
+	if (layout < SND_PCM_EXTPLUG_LAYOUT_ANY ||
+	    layout > SND_PCM_EXTPLUG_LAYOUT_PLANAR) {
+		SNDERR("EXTPLUG: invalid layout %d", layout);
+		return -EINVAL;
+	}
+	if (align & (align - 1)) {
+		SNDERR("EXTPLUG: alignment %u is not a power of two", align);
+		return -EINVAL;
+	}
+	ext->layout = layout;
+	ext->align = align;
+	return 0;
+}
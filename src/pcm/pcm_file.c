@@ -29,8 +29,11 @@
 #include "bswap.h"
 #include <ctype.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "pcm_local.h"
 #include "pcm_plugin.h"
+#include "pcm_file_encoder.h"
 
 #ifndef PIC
 /* entry for static linking */
@@ -49,6 +52,9 @@ const char *_snd_module_pcm_file = "";
 /* maximum length of a value */
 #define VALUE_MAXLEN	64
 
+/* read-ahead window of the mapped infile */
+#define IFMAP_AHEAD	(1024 * 1024)
+
 typedef enum _snd_pcm_file_format {
 	SND_PCM_FILE_FORMAT_RAW,
 	SND_PCM_FILE_FORMAT_WAV
@@ -74,6 +80,11 @@ typedef struct {
 	FILE *pipe;
 	char *ifname;
 	int ifd;
+	int ifloop;			/* restart the infile at its end */
+	char *ifmap;			/* mapped infile, NULL = read() */
+	size_t ifmap_size;
+	size_t ifmap_pos;
+	size_t ifmap_ahead;		/* end of the region already advised */
 	int format;
 	snd_pcm_uframes_t appl_ptr;
 	snd_pcm_uframes_t file_ptr_bytes;
@@ -90,8 +101,37 @@ typedef struct {
 	struct wav_fmt wav_header;
 	size_t filelen;
 	char ifmmap_overwritten;
+	unsigned int async_depth;	/* writer ring in slave buffers, 0 = synchronous */
+	struct snd_pcm_file_async *async;
+	char *enc_name;			/* encoder, NULL = raw or wav */
+	void *enc_obj;
+	snd_pcm_file_encoder_ops_t enc_ops;
+	void *enc_open_func;
+	int enc_started;
 } snd_pcm_file_t;
 
+#ifdef THREAD_SAFE_API
+/*
+ * Background writer: the transfer path copies the finished bytes into a
+ * single-producer single-consumer ring and never blocks; the writer thread
+ * empties it to the file.  head and tail only grow, their difference is
+ * the filled part of the ring.
+ */
+typedef struct snd_pcm_file_async {
+	snd_pcm_t *pcm;
+	pthread_t thread;
+	int wake[2];			/* pipe waking up the writer */
+	char *ring;
+	size_t size;
+	size_t head;			/* advanced by the transfer path */
+	size_t tail;			/* advanced by the writer */
+	int quit;
+	int error;			/* the writer has failed, drop everything */
+	unsigned long long overflows;	/* chunks dropped because the ring was full */
+	unsigned long long dropped;	/* bytes dropped */
+} snd_pcm_file_async_t;
+#endif
+
 #if __BYTE_ORDER == __LITTLE_ENDIAN
 #define TO_LE32(x)	(x)
 #define TO_LE16(x)	(x)
@@ -286,6 +326,95 @@ static int snd_pcm_file_open_output_file(snd_pcm_file_t *file)
 	return 0;
 }
 
+static int snd_pcm_file_map_infile(snd_pcm_file_t *file)
+{
+	struct stat st;
+	off_t pos;
+	void *map;
+	int err;
+
+	if (file->ifd < 0)
+		return 0;
+	if (fstat(file->ifd, &st) < 0) {
+		err = -errno;
+		SYSERR("stat of the infile failed");
+		return err;
+	}
+	if (!S_ISREG(st.st_mode)) {
+		SNDERR("infile_mmap needs a regular input file");
+		return -EINVAL;
+	}
+	if (st.st_size == 0)
+		return 0;
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, file->ifd, 0);
+	if (map == MAP_FAILED) {
+		err = -errno;
+		SYSERR("mmap of the infile failed");
+		return err;
+	}
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+	/* an inherited descriptor keeps its position */
+	pos = lseek(file->ifd, 0, SEEK_CUR);
+	file->ifmap = map;
+	file->ifmap_size = st.st_size;
+	file->ifmap_pos = pos > 0 && pos < st.st_size ? (size_t)pos : 0;
+	file->ifmap_ahead = 0;
+	return 0;
+}
+
+/* asks for the next window of the mapping once half of the last one is used */
+static void snd_pcm_file_map_ahead(snd_pcm_file_t *file)
+{
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t start, len;
+
+	if (file->ifmap_pos + IFMAP_AHEAD / 2 < file->ifmap_ahead)
+		return;
+	start = file->ifmap_ahead > file->ifmap_pos ?
+		file->ifmap_ahead : file->ifmap_pos;
+	start &= ~(page - 1);
+	if (start >= file->ifmap_size)
+		return;
+	len = file->ifmap_size - start;
+	if (len > IFMAP_AHEAD)
+		len = IFMAP_AHEAD;
+	madvise(file->ifmap + start, len, MADV_WILLNEED);
+	file->ifmap_ahead = start + len;
+}
+
+/* copies from the mapped infile straight into areas, return bytes red */
+static int snd_pcm_file_areas_map_infile(snd_pcm_t *pcm,
+					 const snd_pcm_channel_area_t *areas,
+					 snd_pcm_uframes_t offset,
+					 snd_pcm_uframes_t frames)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+	snd_pcm_channel_area_t areas_if[pcm->channels];
+	size_t frame_bytes = snd_pcm_frames_to_bytes(pcm, 1);
+	size_t end = file->ifmap_size - file->ifmap_size % frame_bytes;
+	snd_pcm_uframes_t done = 0;
+
+	while (done < frames) {
+		snd_pcm_uframes_t n = frames - done, avail;
+		if (file->ifmap_pos >= end) {
+			if (!file->ifloop || !end)
+				break;
+			file->ifmap_pos = 0;
+			file->ifmap_ahead = 0;
+		}
+		avail = (end - file->ifmap_pos) / frame_bytes;
+		if (n > avail)
+			n = avail;
+		snd_pcm_file_map_ahead(file);
+		snd_pcm_areas_from_buf(pcm, areas_if, file->ifmap + file->ifmap_pos);
+		snd_pcm_areas_copy(areas, offset + done, areas_if, 0,
+				   pcm->channels, n, pcm->format);
+		file->ifmap_pos += n * frame_bytes;
+		done += n;
+	}
+	return snd_pcm_frames_to_bytes(pcm, done);
+}
+
 /* fill areas with data from input file, return bytes red */
 static int snd_pcm_file_areas_read_infile(snd_pcm_t *pcm,
 					  const snd_pcm_channel_area_t *areas,
@@ -294,11 +423,14 @@ static int snd_pcm_file_areas_read_infile(snd_pcm_t *pcm,
 {
 	snd_pcm_file_t *file = pcm->private_data;
 	snd_pcm_channel_area_t areas_if[pcm->channels];
-	ssize_t bytes;
+	ssize_t bytes, want, r;
 
 	if (file->ifd < 0)
 		return -EBADF;
 
+	if (file->ifmap)
+		return snd_pcm_file_areas_map_infile(pcm, areas, offset, frames);
+
 	if (file->rbuf == NULL)
 		return -ENOMEM;
 
@@ -310,11 +442,23 @@ static int snd_pcm_file_areas_read_infile(snd_pcm_t *pcm,
 	bytes = snd_pcm_frames_to_bytes(pcm, frames);
 	if (bytes < 0)
 		return bytes;
-	bytes = read(file->ifd, file->rbuf, bytes);
+	want = bytes;
+	bytes = read(file->ifd, file->rbuf, want);
 	if (bytes < 0) {
 		SYSERR("read from file failed, error: %d", bytes);
 		return bytes;
 	}
+	/* wrap around, an empty file ends the loop */
+	while (file->ifloop && bytes < want) {
+		/* a partial frame at the end of the file is skipped */
+		bytes -= bytes % snd_pcm_frames_to_bytes(pcm, 1);
+		if (lseek(file->ifd, 0, SEEK_SET) < 0)
+			break;
+		r = read(file->ifd, file->rbuf + bytes, want - bytes);
+		if (r <= 0)
+			break;
+		bytes += r;
+	}
 
 	snd_pcm_areas_from_buf(pcm, areas_if, file->rbuf);
 	snd_pcm_areas_copy(areas, offset, areas_if, 0, pcm->channels, snd_pcm_bytes_to_frames(pcm, bytes), pcm->format);
@@ -410,10 +554,243 @@ static void fixup_wav_header(snd_pcm_t *pcm)
 			return;
 	}
 }
+
+static int snd_pcm_file_encoder_write(void *priv, const void *buf, size_t size)
+{
+	snd_pcm_file_t *file = priv;
+	const char *p = buf;
+	ssize_t r;
+
+	while (size > 0) {
+		r = safe_write(file->fd, p, size);
+		if (r < 0)
+			return r;
+		if (r == 0)
+			return -EIO;
+		p += r;
+		size -= r;
+		file->filelen += r;
+	}
+	return 0;
+}
+
+static int snd_pcm_file_encoder_start(snd_pcm_t *pcm)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+	snd_pcm_t *slave = file->gen.slave;
+	snd_pcm_file_encoder_info_t info;
+	int err;
+
+	/* called from hw_params, the own setup is not there yet */
+	if (!file->enc_obj || file->enc_started)
+		return 0;
+	info.format = slave->format;
+	info.channels = slave->channels;
+	info.rate = slave->rate;
+	err = file->enc_ops.start(file->enc_obj, &info,
+				  snd_pcm_file_encoder_write, file);
+	if (err < 0) {
+		SNDERR("%s: unable to start the %s encoder", file->fname,
+		       file->enc_name);
+		return err;
+	}
+	file->enc_started = 1;
+	return 0;
+}
+
+/* flushes the pending frames of the encoder and ends its stream */
+static void snd_pcm_file_encoder_stop(snd_pcm_file_t *file)
+{
+	if (!file->enc_started)
+		return;
+	if (file->enc_ops.stop(file->enc_obj) < 0)
+		SYSERR("%s: flushing the encoder failed", file->fname);
+	file->enc_started = 0;
+}
+
+/*
+ * writes whole frames to the output file, through the encoder if any,
+ * returns the bytes taken
+ */
+static ssize_t snd_pcm_file_output(snd_pcm_t *pcm, const char *buf, size_t bytes)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+	ssize_t err;
+
+	if (file->enc_obj) {
+		err = file->enc_ops.encode(file->enc_obj, buf,
+					   snd_pcm_bytes_to_frames(pcm, bytes));
+		return err < 0 ? err : (ssize_t)bytes;
+	}
+	err = safe_write(file->fd, buf, bytes);
+	if (err > 0)
+		file->filelen += err;
+	return err;
+}
 #endif /* DOC_HIDDEN */
 
 
 
+#ifdef THREAD_SAFE_API
+static void *snd_pcm_file_async_thread(void *arg)
+{
+	snd_pcm_file_async_t *a = arg;
+	snd_pcm_t *pcm = a->pcm;
+	snd_pcm_file_t *file = pcm->private_data;
+	size_t head, tail = a->tail;
+	char buf[64];
+	ssize_t err;
+
+	for (;;) {
+		head = __atomic_load_n(&a->head, __ATOMIC_ACQUIRE);
+		if (head == tail) {
+			if (__atomic_load_n(&a->quit, __ATOMIC_ACQUIRE))
+				break;
+			if (read(a->wake[0], buf, sizeof(buf)) < 0 && errno != EINTR)
+				break;
+			continue;
+		}
+		if (a->error) {
+			tail = head;
+		} else {
+			size_t n = head - tail;
+			size_t cont = a->size - tail % a->size;
+			if (n > cont)
+				n = cont;
+			err = 0;
+			if (file->format == SND_PCM_FILE_FORMAT_WAV &&
+			    !file->wav_header.fmt)
+				err = write_wav_header(pcm);
+			if (err >= 0)
+				err = snd_pcm_file_output(pcm, a->ring + tail % a->size, n);
+			if (err < 0) {
+				SYSERR("%s write failed, dropping the rest of the stream",
+				       file->fname);
+				__atomic_store_n(&a->error, 1, __ATOMIC_RELEASE);
+				tail = head;
+			} else {
+				tail += err;
+			}
+		}
+		__atomic_store_n(&a->tail, tail, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+static void snd_pcm_file_async_wake(snd_pcm_file_async_t *a)
+{
+	char c = 0;
+
+	/* the pipe is non-blocking; a full pipe means it is awake anyway */
+	if (write(a->wake[1], &c, 1) < 0 && errno != EAGAIN)
+		SYSMSG("file writer wakeup failed");
+}
+
+static int snd_pcm_file_async_start(snd_pcm_t *pcm)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+	snd_pcm_file_async_t *a;
+	int err;
+
+	a = calloc(1, sizeof(*a));
+	if (a == NULL)
+		return -ENOMEM;
+	a->pcm = pcm;
+	a->size = file->buffer_bytes * file->async_depth;
+	a->ring = malloc(a->size);
+	if (a->ring == NULL) {
+		free(a);
+		return -ENOMEM;
+	}
+	if (pipe(a->wake) < 0) {
+		err = -errno;
+		free(a->ring);
+		free(a);
+		return err;
+	}
+	fcntl(a->wake[1], F_SETFL, O_NONBLOCK);
+	err = snd_thread_create(&a->thread, "pcm_file", snd_pcm_file_async_thread, a);
+	if (err) {
+		close(a->wake[0]);
+		close(a->wake[1]);
+		free(a->ring);
+		free(a);
+		return -err;
+	}
+	file->async = a;
+	return 0;
+}
+
+/* lets the writer flush what it has got, then stops it */
+static void snd_pcm_file_async_stop(snd_pcm_file_t *file)
+{
+	snd_pcm_file_async_t *a = file->async;
+
+	if (a == NULL)
+		return;
+	__atomic_store_n(&a->quit, 1, __ATOMIC_RELEASE);
+	snd_pcm_file_async_wake(a);
+	pthread_join(a->thread, NULL);
+	close(a->wake[0]);
+	close(a->wake[1]);
+	free(a->ring);
+	free(a);
+	file->async = NULL;
+}
+
+/* waits until the writer has emptied the ring */
+static void snd_pcm_file_async_flush(snd_pcm_file_t *file)
+{
+	snd_pcm_file_async_t *a = file->async;
+
+	while (__atomic_load_n(&a->tail, __ATOMIC_ACQUIRE) != a->head &&
+	       !__atomic_load_n(&a->error, __ATOMIC_ACQUIRE))
+		usleep(1000);
+}
+
+/* moves bytes from wbuf to the writer ring, dropping them when it is full */
+static int snd_pcm_file_async_push(snd_pcm_t *pcm, size_t bytes)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+	snd_pcm_file_async_t *a = file->async;
+	size_t head = a->head;
+	size_t space = a->size - (head - __atomic_load_n(&a->tail, __ATOMIC_ACQUIRE));
+	int drop = bytes > space || __atomic_load_n(&a->error, __ATOMIC_ACQUIRE);
+
+	if (drop) {
+		a->overflows++;
+		a->dropped += bytes;
+	}
+	while (bytes > 0) {
+		size_t n = bytes;
+		size_t cont = file->wbuf_size_bytes - file->file_ptr_bytes;
+		if (n > cont)
+			n = cont;
+		if (!drop) {
+			size_t off = head % a->size;
+			size_t rcont = a->size - off;
+			if (rcont > n)
+				rcont = n;
+			memcpy(a->ring + off, file->wbuf + file->file_ptr_bytes, rcont);
+			memcpy(a->ring, file->wbuf + file->file_ptr_bytes + rcont, n - rcont);
+			head += n;
+		}
+		bytes -= n;
+		file->wbuf_used_bytes -= n;
+		file->file_ptr_bytes += n;
+		if (file->file_ptr_bytes == file->wbuf_size_bytes)
+			file->file_ptr_bytes = 0;
+	}
+	if (!drop) {
+		__atomic_store_n(&a->head, head, __ATOMIC_RELEASE);
+		snd_pcm_file_async_wake(a);
+	}
+	return 0;
+}
+#else
+#define snd_pcm_file_async_stop(file)	do { } while (0)
+#endif
+
 /* return error code in case write failed */
 static int snd_pcm_file_write_bytes(snd_pcm_t *pcm, size_t bytes)
 {
@@ -421,6 +798,11 @@ static int snd_pcm_file_write_bytes(snd_pcm_t *pcm, size_t bytes)
 	snd_pcm_sframes_t err = 0;
 	assert(bytes <= file->wbuf_used_bytes);
 
+#ifdef THREAD_SAFE_API
+	if (file->async)
+		return snd_pcm_file_async_push(pcm, bytes);
+#endif
+
 	if (file->format == SND_PCM_FILE_FORMAT_WAV &&
 	    !file->wav_header.fmt) {
 		err = write_wav_header(pcm);
@@ -436,7 +818,7 @@ static int snd_pcm_file_write_bytes(snd_pcm_t *pcm, size_t bytes)
 		size_t cont = file->wbuf_size_bytes - file->file_ptr_bytes;
 		if (n > cont)
 			n = cont;
-		err = safe_write(file->fd, file->wbuf + file->file_ptr_bytes, n);
+		err = snd_pcm_file_output(pcm, file->wbuf + file->file_ptr_bytes, n);
 		if (err < 0) {
 			file->wbuf_used_bytes = 0;
 			file->file_ptr_bytes = 0;
@@ -448,7 +830,6 @@ static int snd_pcm_file_write_bytes(snd_pcm_t *pcm, size_t bytes)
 		file->file_ptr_bytes += err;
 		if (file->file_ptr_bytes == file->wbuf_size_bytes)
 			file->file_ptr_bytes = 0;
-		file->filelen += err;
 		if ((snd_pcm_uframes_t)err != n)
 			break;
 	}
@@ -492,6 +873,14 @@ static int snd_pcm_file_add_frames(snd_pcm_t *pcm,
 static int snd_pcm_file_close(snd_pcm_t *pcm)
 {
 	snd_pcm_file_t *file = pcm->private_data;
+
+	snd_pcm_file_async_stop(file);
+	snd_pcm_file_encoder_stop(file);
+	if (file->enc_obj)
+		file->enc_ops.close(file->enc_obj);
+	if (file->enc_open_func)
+		snd_dlobj_cache_put(file->enc_open_func);
+	free(file->enc_name);
 	if (file->fname) {
 		if (file->wav_header.fmt)
 			fixup_wav_header(pcm);
@@ -502,6 +891,8 @@ static int snd_pcm_file_close(snd_pcm_t *pcm)
 			close(file->fd);
 		}
 	}
+	if (file->ifmap)
+		munmap(file->ifmap, file->ifmap_size);
 	if (file->ifname) {
 		free((void *)file->ifname);
 		close(file->ifd);
@@ -543,6 +934,10 @@ static int snd_pcm_file_drain(snd_pcm_t *pcm)
 		snd_pcm_file_write_bytes(pcm, file->wbuf_used_bytes);
 		assert(file->wbuf_used_bytes == 0);
 		__snd_pcm_unlock(pcm);
+#ifdef THREAD_SAFE_API
+		if (file->async)
+			snd_pcm_file_async_flush(file);
+#endif
 	}
 	return err;
 }
@@ -737,6 +1132,8 @@ static int snd_pcm_file_mmap_begin(snd_pcm_t *pcm, const snd_pcm_channel_area_t
 static int snd_pcm_file_hw_free(snd_pcm_t *pcm)
 {
 	snd_pcm_file_t *file = pcm->private_data;
+	snd_pcm_file_async_stop(file);
+	snd_pcm_file_encoder_stop(file);
 	free(file->wbuf);
 	free(file->wbuf_areas);
 	free(file->final_fname);
@@ -753,7 +1150,12 @@ static int snd_pcm_file_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 	snd_pcm_file_t *file = pcm->private_data;
 	unsigned int channel;
 	snd_pcm_t *slave = file->gen.slave;
-	int err = _snd_pcm_hw_params_internal(slave, params);
+	int err;
+
+	/* the infile data overwrites the captured samples of the slave */
+	slave->mmap_inplace = pcm->mmap_inplace ||
+		(pcm->stream == SND_PCM_STREAM_CAPTURE && file->ifd >= 0);
+	err = _snd_pcm_hw_params_internal(slave, params);
 	if (err < 0)
 		return err;
 	file->buffer_bytes = snd_pcm_frames_to_bytes(slave, slave->buffer_size);
@@ -795,6 +1197,21 @@ static int snd_pcm_file_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 			return err;
 		}
 	}
+	err = snd_pcm_file_encoder_start(pcm);
+	if (err < 0) {
+		snd_pcm_file_hw_free(pcm);
+		return err;
+	}
+#ifdef THREAD_SAFE_API
+	if (file->async_depth > 0 && !file->async) {
+		err = snd_pcm_file_async_start(pcm);
+		if (err < 0) {
+			SNDERR("unable to start the file writer thread");
+			snd_pcm_file_hw_free(pcm);
+			return err;
+		}
+	}
+#endif
 
 	/* pointer may have changed - e.g if plug is used. */
 	snd_pcm_unlink_hw_ptr(pcm, file->gen.slave);
@@ -816,6 +1233,19 @@ static void snd_pcm_file_dump(snd_pcm_t *pcm, snd_output_t *out)
 	if (file->final_fname)
 		snd_output_printf(out, "Final file PCM (file=%s)\n",
 				file->final_fname);
+	if (file->enc_obj) {
+		snd_output_printf(out, "Encoder: %s\n", file->enc_name);
+		if (file->enc_ops.dump)
+			file->enc_ops.dump(file->enc_obj, out);
+	}
+#ifdef THREAD_SAFE_API
+	if (file->async)
+		snd_output_printf(out, "Writer thread: ring %zu bytes, "
+				  "%llu overflows, %llu bytes dropped%s\n",
+				  file->async->size, file->async->overflows,
+				  file->async->dropped,
+				  file->async->error ? ", write error" : "");
+#endif
 
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
@@ -849,6 +1279,7 @@ static const snd_pcm_fast_ops_t snd_pcm_file_fast_ops = {
 	.hwsync = snd_pcm_generic_hwsync,
 	.delay = snd_pcm_generic_delay,
 	.prepare = snd_pcm_generic_prepare,
+	.resync = snd_pcm_generic_resync,
 	.reset = snd_pcm_file_reset,
 	.start = snd_pcm_generic_start,
 	.drop = snd_pcm_file_drop,
@@ -970,6 +1401,90 @@ int snd_pcm_file_open(snd_pcm_t **pcmp, const char *name,
 	return 0;
 }
 
+#ifndef DOC_HIDDEN
+#ifdef PIC
+static int is_builtin_encoder(const char *type)
+{
+	return strcmp(type, "rice") == 0;
+}
+#endif
+
+/* opens the encoder given by a name or by a compound with a name field */
+static int snd_pcm_file_open_encoder(snd_pcm_file_t *file, snd_config_t *conf)
+{
+	snd_pcm_file_encoder_open_func_t open_func;
+	const snd_config_t *enc_conf = NULL;
+	const char *type = NULL;
+	int err;
+#ifdef PIC
+	char open_name[64], lib_name[64], *lib = NULL;
+#else
+	extern int SND_PCM_FILE_ENCODER_ENTRY(rice) (unsigned int version, void **objp,
+						     snd_pcm_file_encoder_ops_t *ops,
+						     const snd_config_t *conf);
+#endif
+
+	if (snd_config_get_string(conf, &type) < 0) {
+		snd_config_t *n;
+		if (snd_config_get_type(conf) != SND_CONFIG_TYPE_COMPOUND ||
+		    snd_config_search(conf, "name", &n) < 0 ||
+		    snd_config_get_string(n, &type) < 0) {
+			SNDERR("No name given for the file encoder");
+			return -EINVAL;
+		}
+		enc_conf = conf;
+	}
+#ifdef PIC
+	snprintf(open_name, sizeof(open_name), "_snd_pcm_file_encoder_%s_open", type);
+	if (!is_builtin_encoder(type)) {
+		snprintf(lib_name, sizeof(lib_name),
+			 "libasound_module_file_encoder_%s.so", type);
+		lib = lib_name;
+	}
+	open_func = snd_dlobj_cache_get(lib, open_name, NULL, 1);
+	if (!open_func) {
+		SNDERR("Cannot find the file encoder %s", type);
+		return -ENOENT;
+	}
+#else
+	if (strcmp(type, "rice") != 0) {
+		SNDERR("Cannot find the file encoder %s", type);
+		return -ENOENT;
+	}
+	open_func = SND_PCM_FILE_ENCODER_ENTRY(rice);
+#endif
+	err = open_func(SND_PCM_FILE_ENCODER_VERSION, &file->enc_obj,
+			&file->enc_ops, enc_conf);
+	if (err < 0)
+		goto error;
+	if (!file->enc_ops.start || !file->enc_ops.encode ||
+	    !file->enc_ops.stop || !file->enc_ops.close) {
+		SNDERR("Improper file encoder %s initialization", type);
+		if (file->enc_ops.close)
+			file->enc_ops.close(file->enc_obj);
+		err = -EINVAL;
+		goto error;
+	}
+	file->enc_name = strdup(type);
+	if (!file->enc_name) {
+		file->enc_ops.close(file->enc_obj);
+		err = -ENOMEM;
+		goto error;
+	}
+#ifdef PIC
+	file->enc_open_func = open_func;
+#endif
+	return 0;
+
+ error:
+	file->enc_obj = NULL;
+#ifdef PIC
+	snd_dlobj_cache_put(open_func);
+#endif
+	return err;
+}
+#endif /* DOC_HIDDEN */
+
 /*! \page pcm_plugins
 
 \section pcm_plugins_file Plugin: File
@@ -1004,11 +1519,43 @@ pcm.name {
 	infile STR		# Input filename - only raw format
 	or
 	infile INT		# Input file descriptor number
+	[infile_mmap BOOL]	# Map the input file instead of reading it
+	[infile_loop BOOL]	# Restart the input file at its end
 	[format STR]		# File format ("raw" or "wav")
 	[perm INT]		# Output file permission (octal, def. 0600)
+	[async INT]		# Ring depth of the writer thread in buffer
+				# sizes, 0 = write synchronously (default)
+	[encoder STR]		# Encoder of the output stream
+	or
+	[encoder {		# Encoder definition
+		name STR	# Encoder name
+		...		# Encoder specific options
+	}]
 }
 \endcode
 
+With infile_mmap, a regular input file is mapped into memory and the
+capture transfers copy straight from the mapping into the client areas,
+with read-ahead hints for the next part of the file.  This saves a
+system call and a copy per transfer when replaying long files fast.
+
+With an encoder, the stream is compressed before it is written, instead
+of being stored as raw or wav data.  Encoders are loaded from
+libasound_module_file_encoder_NAME.so, see pcm_file_encoder.h.  The
+built-in "rice" encoder is lossless: it predicts every channel with a
+fixed polynomial and Rice codes the residuals in self-contained blocks,
+taking the option "block INT" for the frames per block (4096 by
+default).  Only the significant bits are kept, the padding bits of
+formats like S24_LE are dropped.  With async set, the encoding runs in the writer thread.  Each
+setup of hw_params starts a new encoded stream in the file.
+
+With async set, the output is written by a background thread.  The
+transfer functions only copy the data into a ring of the given depth,
+so a slow disk cannot stall the stream.  When the ring is full, the data
+is dropped instead.  The overflows and dropped bytes are shown by
+snd_pcm_dump() and returned by snd_pcm_file_async_stats().  Drain waits
+until the ring is written.
+
 \subsection pcm_plugins_file_funcref Function reference
 
 <UL>
@@ -1038,11 +1585,12 @@ int _snd_pcm_file_open(snd_pcm_t **pcmp, const char *name,
 	snd_config_iterator_t i, next;
 	int err;
 	snd_pcm_t *spcm;
-	snd_config_t *slave = NULL, *sconf;
+	snd_config_t *slave = NULL, *sconf, *encoder = NULL;
 	const char *fname = NULL, *ifname = NULL;
 	const char *format = NULL;
 	long fd = -1, ifd = -1, trunc = 1;
-	long perm = 0600;
+	long perm = 0600, async = 0;
+	int ifmmap = 0, ifloop = 0;
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
 		const char *id;
@@ -1084,6 +1632,20 @@ int _snd_pcm_file_open(snd_pcm_t **pcmp, const char *name,
 			}
 			continue;
 		}
+		if (strcmp(id, "infile_mmap") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return -EINVAL;
+			ifmmap = err;
+			continue;
+		}
+		if (strcmp(id, "infile_loop") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return -EINVAL;
+			ifloop = err;
+			continue;
+		}
 		if (strcmp(id, "perm") == 0) {
 			err = snd_config_get_integer(n, &perm);
 			if (err < 0) {
@@ -1103,10 +1665,30 @@ int _snd_pcm_file_open(snd_pcm_t **pcmp, const char *name,
 			trunc = err;
 			continue;
 		}
+		if (strcmp(id, "async") == 0) {
+			err = snd_config_get_integer(n, &async);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				return -EINVAL;
+			}
+			if (async < 0 || async > 1024) {
+				SNDERR("The field async must be between 0 and 1024");
+				return -EINVAL;
+			}
+			continue;
+		}
+		if (strcmp(id, "encoder") == 0) {
+			encoder = n;
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
-	if (!format) {
+	if (encoder && format && strcmp(format, "raw") != 0) {
+		SNDERR("The field encoder cannot be combined with format %s", format);
+		return -EINVAL;
+	}
+	if (!format && !encoder) {
 		snd_config_t *n;
 		/* read defaults */
 		if (snd_config_search(root, "defaults.pcm.file_format", &n) >= 0) {
@@ -1135,10 +1717,54 @@ int _snd_pcm_file_open(snd_pcm_t **pcmp, const char *name,
 		return err;
 	err = snd_pcm_file_open(pcmp, name, fname, fd, ifname, ifd,
 				trunc, format, perm, spcm, 1, stream);
-	if (err < 0)
+	if (err < 0) {
 		snd_pcm_close(spcm);
-	return err;
+		return err;
+	}
+	((snd_pcm_file_t *)(*pcmp)->private_data)->async_depth = async;
+	((snd_pcm_file_t *)(*pcmp)->private_data)->ifloop = ifloop;
+	if (ifmmap) {
+		err = snd_pcm_file_map_infile((*pcmp)->private_data);
+		if (err < 0) {
+			snd_pcm_close(*pcmp);
+			return err;
+		}
+	}
+	if (encoder) {
+		err = snd_pcm_file_open_encoder((*pcmp)->private_data, encoder);
+		if (err < 0) {
+			snd_pcm_close(*pcmp);
+			return err;
+		}
+	}
+	return 0;
 }
 #ifndef DOC_HIDDEN
 SND_DLSYM_BUILD_VERSION(_snd_pcm_file_open, SND_PCM_DLSYM_VERSION);
 #endif
+
+/**
+ * \brief Get the counters of the background writer of a File PCM
+ * \param pcm File PCM handle
+ * \param overflows Returns the number of chunks dropped because the ring was full
+ * \param dropped Returns the number of bytes dropped
+ * \retval zero on success, -EINVAL if pcm is not a File PCM with the async option
+ */
+int snd_pcm_file_async_stats(snd_pcm_t *pcm, unsigned long long *overflows,
+			     unsigned long long *dropped)
+{
+#ifdef THREAD_SAFE_API
+	snd_pcm_file_t *file;
+
+	if (pcm->type != SND_PCM_TYPE_FILE)
+		return -EINVAL;
+	file = pcm->private_data;
+	if (!file->async)
+		return -EINVAL;
+	*overflows = file->async->overflows;
+	*dropped = file->async->dropped;
+	return 0;
+#else
+	return -EINVAL;
+#endif
+}
@@ -0,0 +1,402 @@
+/*
+ *  Lossless block encoder for the file plugin
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * The samples are cut into blocks, each channel of a block is predicted
+ * with the best of the fixed polynomial predictors of order 0 to 3 (as in
+ * FLAC) and the residuals are Rice coded.  Channels which do not shrink
+ * are stored verbatim.  Every block is framed on its own, so a truncated
+ * file stays readable up to its last complete block.
+ *
+ * All the fields are little endian:
+ *
+ *	stream header, 16 bytes:
+ *		"ALSR", u8 version (1), u8 snd_pcm_format_t, u16 channels,
+ *		u32 rate, u32 frames per block
+ *	block header, 12 bytes:
+ *		"ALSB", u32 frames, u32 bytes following the header
+ *	per channel:
+ *		u8 order (0-3, or 0xff = verbatim), u8 rice parameter k,
+ *		order warm-up samples (verbatim: all samples) of the physical
+ *		sample width, then the residuals as a bit stream, MSB first,
+ *		padded to a byte
+ *
+ * A residual r is mapped to u = r >= 0 ? 2r : -2r - 1 and is written as
+ * q = u >> k one bits, a zero bit and the k low bits of u.  When q is 31
+ * or more, 31 one bits are followed by u in 64 bits instead.  The samples
+ * are sign extended to 32 bits (unsigned formats are biased to signed
+ * first), padding bits of the sample container are not kept.
+ */
+
+#include <inttypes.h>
+#include "pcm_local.h"
+#include "pcm_plugin.h"
+#include "pcm_file_encoder.h"
+
+#ifndef DOC_HIDDEN
+
+#define RICE_DEFAULT_BLOCK	4096
+#define RICE_MIN_BLOCK		16
+#define RICE_MAX_BLOCK		65535
+#define RICE_MAX_ORDER		3
+#define RICE_ESCAPE		31
+#define RICE_VERBATIM		0xff
+
+struct rice_enc {
+	unsigned int block;		/* frames per block */
+	snd_pcm_file_encoder_info_t info;
+	snd_pcm_file_encoder_write_t write;
+	void *priv;
+	unsigned int phys;		/* bytes per sample */
+	unsigned int width;		/* significant bits */
+	int big_endian;
+	int is_unsigned;
+	int32_t *samples;		/* block frames per channel */
+	snd_pcm_uframes_t fill;
+	unsigned char *out;
+	unsigned long long in_bytes;
+	unsigned long long out_bytes;
+	unsigned long long blocks;
+};
+
+struct rice_bits {
+	unsigned char *p;
+	uint64_t acc;
+	unsigned int n;
+};
+
+static inline void put_le16(unsigned char *p, unsigned int v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+static inline void put_le32(unsigned char *p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+/* bits <= 32 */
+static inline void bits_put(struct rice_bits *w, uint32_t v, unsigned int bits)
+{
+	if (!bits)
+		return;
+	w->acc = (w->acc << bits) | (v & (uint32_t)((1ULL << bits) - 1));
+	w->n += bits;
+	while (w->n >= 8) {
+		w->n -= 8;
+		*w->p++ = w->acc >> w->n;
+	}
+}
+
+static inline void bits_put64(struct rice_bits *w, uint64_t v, unsigned int bits)
+{
+	if (bits > 32) {
+		bits_put(w, v >> 32, bits - 32);
+		bits = 32;
+	}
+	bits_put(w, v, bits);
+}
+
+static inline void bits_flush(struct rice_bits *w)
+{
+	if (w->n)
+		bits_put(w, 0, 8 - w->n);
+}
+
+static inline uint64_t zigzag(int64_t r)
+{
+	return r >= 0 ? (uint64_t)r << 1 : ((uint64_t)(-(r + 1)) << 1) | 1;
+}
+
+static inline int64_t residual(const int32_t *x, unsigned int i, unsigned int order)
+{
+	switch (order) {
+	case 0:
+		return x[i];
+	case 1:
+		return (int64_t)x[i] - x[i - 1];
+	case 2:
+		return (int64_t)x[i] - 2 * (int64_t)x[i - 1] + x[i - 2];
+	default:
+		return (int64_t)x[i] - 3 * (int64_t)x[i - 1] +
+			3 * (int64_t)x[i - 2] - x[i - 3];
+	}
+}
+
+static void rice_put_sample(struct rice_enc *enc, unsigned char **pp, int32_t v)
+{
+	unsigned char *p = *pp;
+	unsigned int i;
+
+	for (i = 0; i < enc->phys; i++)
+		*p++ = (uint32_t)v >> (i * 8);
+	*pp = p;
+}
+
+/* encodes one channel of the block, returns the end of the output */
+static unsigned char *rice_encode_channel(struct rice_enc *enc, unsigned char *p,
+					  const int32_t *x, unsigned int frames)
+{
+	uint64_t sum[RICE_MAX_ORDER + 1] = { 0 };
+	uint64_t best_sum = UINT64_MAX, bits, cnt;
+	unsigned int order, best = 0, k = 0, i;
+	struct rice_bits w;
+
+	for (order = 0; order <= RICE_MAX_ORDER && order < frames; order++) {
+		for (i = order; i < frames; i++)
+			sum[order] += zigzag(residual(x, i, order));
+		if (sum[order] < best_sum) {
+			best_sum = sum[order];
+			best = order;
+		}
+	}
+	order = best;
+	cnt = frames - order;
+	while (k < 40 && (cnt << (k + 1)) <= best_sum)
+		k++;
+
+	/* exact size, to decide against the verbatim storage */
+	bits = (uint64_t)order * enc->phys * 8;
+	for (i = order; i < frames; i++) {
+		uint64_t q = zigzag(residual(x, i, order)) >> k;
+		bits += q < RICE_ESCAPE ? q + 1 + k : RICE_ESCAPE + 64;
+	}
+	if (bits >= (uint64_t)frames * enc->phys * 8) {
+		*p++ = RICE_VERBATIM;
+		*p++ = 0;
+		for (i = 0; i < frames; i++)
+			rice_put_sample(enc, &p, x[i]);
+		return p;
+	}
+
+	*p++ = order;
+	*p++ = k;
+	for (i = 0; i < order; i++)
+		rice_put_sample(enc, &p, x[i]);
+	w.p = p;
+	w.acc = 0;
+	w.n = 0;
+	for (i = order; i < frames; i++) {
+		uint64_t u = zigzag(residual(x, i, order));
+		uint64_t q = u >> k;
+		if (q < RICE_ESCAPE) {
+			/* q one bits and the terminating zero */
+			bits_put(&w, ((1U << (q + 1)) - 2), q + 1);
+			bits_put64(&w, u, k);
+		} else {
+			bits_put(&w, (1U << RICE_ESCAPE) - 1, RICE_ESCAPE);
+			bits_put64(&w, u, 64);
+		}
+	}
+	bits_flush(&w);
+	return w.p;
+}
+
+static int rice_flush_block(struct rice_enc *enc)
+{
+	unsigned int frames = enc->fill, c;
+	unsigned char *p = enc->out + 12;
+	size_t size;
+	int err;
+
+	if (!frames)
+		return 0;
+	for (c = 0; c < enc->info.channels; c++)
+		p = rice_encode_channel(enc, p, enc->samples + c * enc->block, frames);
+	size = p - enc->out;
+	memcpy(enc->out, "ALSB", 4);
+	put_le32(enc->out + 4, frames);
+	put_le32(enc->out + 8, size - 12);
+	enc->fill = 0;
+	enc->blocks++;
+	err = enc->write(enc->priv, enc->out, size);
+	if (err < 0)
+		return err;
+	enc->out_bytes += size;
+	return 0;
+}
+
+static int32_t rice_get_sample(const struct rice_enc *enc, const unsigned char *p)
+{
+	uint32_t u = 0;
+	unsigned int i, shift = 32 - enc->width;
+
+	if (enc->big_endian) {
+		for (i = 0; i < enc->phys; i++)
+			u = (u << 8) | p[i];
+	} else {
+		for (i = enc->phys; i > 0; i--)
+			u = (u << 8) | p[i - 1];
+	}
+	if (enc->is_unsigned)
+		u ^= 1U << (enc->width - 1);
+	return (int32_t)(u << shift) >> shift;
+}
+
+static int rice_start(void *obj, const snd_pcm_file_encoder_info_t *info,
+		      snd_pcm_file_encoder_write_t write, void *priv)
+{
+	struct rice_enc *enc = obj;
+	unsigned char hdr[16];
+	int width, phys;
+
+	if (snd_pcm_format_linear(info->format) != 1 ||
+	    snd_pcm_format_float(info->format) == 1) {
+		SNDERR("rice encoder: format %s is not supported",
+		       snd_pcm_format_name(info->format));
+		return -EINVAL;
+	}
+	width = snd_pcm_format_width(info->format);
+	phys = snd_pcm_format_physical_width(info->format);
+	if (width <= 0 || width > 32 || phys % 8 || phys > 32 ||
+	    info->channels == 0 || info->channels > 0xffff)
+		return -EINVAL;
+	free(enc->samples);
+	free(enc->out);
+	enc->samples = malloc(sizeof(*enc->samples) * enc->block * info->channels);
+	/* a channel never exceeds its verbatim size */
+	enc->out = malloc(12 + info->channels * (2 + enc->block * (phys / 8)));
+	if (!enc->samples || !enc->out)
+		return -ENOMEM;
+	enc->info = *info;
+	enc->write = write;
+	enc->priv = priv;
+	enc->phys = phys / 8;
+	enc->width = width;
+	enc->big_endian = snd_pcm_format_big_endian(info->format) == 1;
+	enc->is_unsigned = snd_pcm_format_unsigned(info->format) == 1;
+	enc->fill = 0;
+
+	memcpy(hdr, "ALSR", 4);
+	hdr[4] = 1;
+	hdr[5] = info->format;
+	put_le16(hdr + 6, info->channels);
+	put_le32(hdr + 8, info->rate);
+	put_le32(hdr + 12, enc->block);
+	enc->out_bytes += sizeof(hdr);
+	return write(priv, hdr, sizeof(hdr));
+}
+
+static int rice_encode(void *obj, const void *buf, snd_pcm_uframes_t frames)
+{
+	struct rice_enc *enc = obj;
+	const unsigned char *p = buf;
+	unsigned int channels = enc->info.channels, c;
+	int err;
+
+	enc->in_bytes += (unsigned long long)frames * channels * enc->phys;
+	while (frames > 0) {
+		snd_pcm_uframes_t n = enc->block - enc->fill, i;
+		if (n > frames)
+			n = frames;
+		for (i = 0; i < n; i++) {
+			for (c = 0; c < channels; c++) {
+				enc->samples[c * enc->block + enc->fill + i] =
+					rice_get_sample(enc, p);
+				p += enc->phys;
+			}
+		}
+		enc->fill += n;
+		frames -= n;
+		if (enc->fill == enc->block) {
+			err = rice_flush_block(enc);
+			if (err < 0)
+				return err;
+		}
+	}
+	return 0;
+}
+
+static int rice_stop(void *obj)
+{
+	return rice_flush_block(obj);
+}
+
+static void rice_dump(void *obj, snd_output_t *out)
+{
+	struct rice_enc *enc = obj;
+
+	snd_output_printf(out, "  block %u frames, %llu blocks, %llu -> %llu bytes\n",
+			  enc->block, enc->blocks, enc->in_bytes, enc->out_bytes);
+}
+
+static void rice_close(void *obj)
+{
+	struct rice_enc *enc = obj;
+
+	free(enc->samples);
+	free(enc->out);
+	free(enc);
+}
+
+static const snd_pcm_file_encoder_ops_t rice_ops = {
+	.start = rice_start,
+	.encode = rice_encode,
+	.stop = rice_stop,
+	.dump = rice_dump,
+	.close = rice_close,
+};
+
+#endif /* DOC_HIDDEN */
+
+int SND_PCM_FILE_ENCODER_ENTRY(rice) (ATTRIBUTE_UNUSED unsigned int version,
+				      void **objp, snd_pcm_file_encoder_ops_t *ops,
+				      const snd_config_t *conf)
+{
+	snd_config_iterator_t i, next;
+	struct rice_enc *enc;
+	long block = RICE_DEFAULT_BLOCK;
+	int err;
+
+	if (conf) {
+		snd_config_for_each(i, next, conf) {
+			snd_config_t *n = snd_config_iterator_entry(i);
+			const char *id;
+			if (snd_config_get_id(n, &id) < 0)
+				continue;
+			if (strcmp(id, "name") == 0)
+				continue;
+			if (strcmp(id, "block") == 0) {
+				err = snd_config_get_integer(n, &block);
+				if (err < 0) {
+					SNDERR("Invalid type for %s", id);
+					return -EINVAL;
+				}
+				if (block < RICE_MIN_BLOCK || block > RICE_MAX_BLOCK) {
+					SNDERR("The field block must be between %d and %d",
+					       RICE_MIN_BLOCK, RICE_MAX_BLOCK);
+					return -EINVAL;
+				}
+				continue;
+			}
+			SNDERR("Unknown field %s", id);
+			return -EINVAL;
+		}
+	}
+	enc = calloc(1, sizeof(*enc));
+	if (!enc)
+		return -ENOMEM;
+	enc->block = block;
+	*objp = enc;
+	*ops = rice_ops;
+	return 0;
+}
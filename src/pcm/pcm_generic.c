@@ -85,6 +85,21 @@ int snd_pcm_generic_hw_free(snd_pcm_t *pcm)
 	return snd_pcm_hw_free(generic->slave);
 }
 
+/*
+ * For a layer whose fast ops would only forward to the slave: let the
+ * callers reach the slave fast ops, with its fast op argument (and so its
+ * lock), directly.  The slave did the same for its own slave if it is such
+ * a layer, so a chain of them costs one call.  A slave may change its fast
+ * ops in hw_params and hw_free, so the layer redoes this there.
+ */
+void snd_pcm_generic_bypass(snd_pcm_t *pcm)
+{
+	snd_pcm_generic_t *generic = pcm->private_data;
+
+	pcm->fast_ops = generic->slave->fast_ops;
+	pcm->fast_op_arg = generic->slave->fast_op_arg;
+}
+
 int snd_pcm_generic_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t *params)
 {
 	snd_pcm_generic_t *generic = pcm->private_data;
@@ -100,6 +115,8 @@ int snd_pcm_generic_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 int snd_pcm_generic_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 {
 	snd_pcm_generic_t *generic = pcm->private_data;
+	if (pcm->mmap_shadow)
+		generic->slave->mmap_inplace = pcm->mmap_inplace;
 	return _snd_pcm_hw_params_internal(generic->slave, params);
 }
 
@@ -109,6 +126,12 @@ int snd_pcm_generic_prepare(snd_pcm_t *pcm)
 	return snd_pcm_prepare(generic->slave);
 }
 
+int snd_pcm_generic_resync(snd_pcm_t *pcm)
+{
+	snd_pcm_generic_t *generic = pcm->private_data;
+	return snd_pcm_resync(generic->slave);
+}
+
 int snd_pcm_generic_channel_info(snd_pcm_t *pcm, snd_pcm_channel_info_t *info)
 {
 	snd_pcm_generic_t *generic = pcm->private_data;
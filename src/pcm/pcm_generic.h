@@ -41,6 +41,8 @@ typedef struct {
 	snd1_pcm_generic_info
 #define snd_pcm_generic_hw_free \
 	snd1_pcm_generic_hw_free
+#define snd_pcm_generic_bypass \
+	snd1_pcm_generic_bypass
 #define snd_pcm_generic_sw_params \
 	snd1_pcm_generic_sw_params
 #define snd_pcm_generic_hw_refine \
@@ -57,6 +59,8 @@ typedef struct {
 	snd1_pcm_generic_state
 #define snd_pcm_generic_prepare \
 	snd1_pcm_generic_prepare
+#define snd_pcm_generic_resync \
+	snd1_pcm_generic_resync
 #define snd_pcm_generic_hwsync \
 	snd1_pcm_generic_hwsync
 #define snd_pcm_generic_reset \
@@ -120,6 +124,7 @@ int snd_pcm_generic_poll_descriptors(snd_pcm_t *pcm, struct pollfd *pfds, unsign
 int snd_pcm_generic_poll_revents(snd_pcm_t *pcm, struct pollfd *pfds, unsigned int nfds, unsigned short *revents);
 int snd_pcm_generic_info(snd_pcm_t *pcm, snd_pcm_info_t * info);
 int snd_pcm_generic_hw_free(snd_pcm_t *pcm);
+void snd_pcm_generic_bypass(snd_pcm_t *pcm);
 int snd_pcm_generic_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t *params);
 int snd_pcm_generic_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
 int snd_pcm_generic_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
@@ -128,6 +133,7 @@ int snd_pcm_generic_channel_info_no_buffer(snd_pcm_t *pcm, snd_pcm_channel_info_
 int snd_pcm_generic_status(snd_pcm_t *pcm, snd_pcm_status_t * status);
 snd_pcm_state_t snd_pcm_generic_state(snd_pcm_t *pcm);
 int snd_pcm_generic_prepare(snd_pcm_t *pcm);
+int snd_pcm_generic_resync(snd_pcm_t *pcm);
 int snd_pcm_generic_hwsync(snd_pcm_t *pcm);
 int snd_pcm_generic_reset(snd_pcm_t *pcm);
 int snd_pcm_generic_start(snd_pcm_t *pcm);
@@ -113,6 +113,7 @@ static int snd_pcm_hooks_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	snd_pcm_hooks_t *h = pcm->private_data;
 	struct list_head *pos, *next;
 	int err = snd_pcm_generic_hw_params(pcm, params);
+	snd_pcm_generic_bypass(pcm);
 	if (err < 0)
 		return err;
 	list_for_each_safe(pos, next, &h->hooks[SND_PCM_HOOK_TYPE_HW_PARAMS]) {
@@ -129,6 +130,7 @@ static int snd_pcm_hooks_hw_free(snd_pcm_t *pcm)
 	snd_pcm_hooks_t *h = pcm->private_data;
 	struct list_head *pos, *next;
 	int err = snd_pcm_generic_hw_free(pcm);
+	snd_pcm_generic_bypass(pcm);
 	if (err < 0)
 		return err;
 	list_for_each_safe(pos, next, &h->hooks[SND_PCM_HOOK_TYPE_HW_FREE]) {
@@ -170,38 +172,6 @@ static const snd_pcm_ops_t snd_pcm_hooks_ops = {
 	.set_chmap = snd_pcm_generic_set_chmap,
 };
 
-static const snd_pcm_fast_ops_t snd_pcm_hooks_fast_ops = {
-	.status = snd_pcm_generic_status,
-	.state = snd_pcm_generic_state,
-	.hwsync = snd_pcm_generic_hwsync,
-	.delay = snd_pcm_generic_delay,
-	.prepare = snd_pcm_generic_prepare,
-	.reset = snd_pcm_generic_reset,
-	.start = snd_pcm_generic_start,
-	.drop = snd_pcm_generic_drop,
-	.drain = snd_pcm_generic_drain,
-	.pause = snd_pcm_generic_pause,
-	.rewindable = snd_pcm_generic_rewindable,
-	.rewind = snd_pcm_generic_rewind,
-	.forwardable = snd_pcm_generic_forwardable,
-	.forward = snd_pcm_generic_forward,
-	.resume = snd_pcm_generic_resume,
-	.link = snd_pcm_generic_link,
-	.link_slaves = snd_pcm_generic_link_slaves,
-	.unlink = snd_pcm_generic_unlink,
-	.writei = snd_pcm_generic_writei,
-	.writen = snd_pcm_generic_writen,
-	.readi = snd_pcm_generic_readi,
-	.readn = snd_pcm_generic_readn,
-	.avail_update = snd_pcm_generic_avail_update,
-	.mmap_commit = snd_pcm_generic_mmap_commit,
-	.htimestamp = snd_pcm_generic_htimestamp,
-	.poll_descriptors_count = snd_pcm_generic_poll_descriptors_count,
-	.poll_descriptors = snd_pcm_generic_poll_descriptors,
-	.poll_revents = snd_pcm_generic_poll_revents,
-	.may_wait_for_avail_min = snd_pcm_generic_may_wait_for_avail_min,
-};
-
 /**
  * \brief Creates a new hooks PCM
  * \param pcmp Returns created PCM handle
@@ -235,8 +205,9 @@ int snd_pcm_hooks_open(snd_pcm_t **pcmp, const char *name, snd_pcm_t *slave, int
 		return err;
 	}
 	pcm->ops = &snd_pcm_hooks_ops;
-	pcm->fast_ops = &snd_pcm_hooks_fast_ops;
 	pcm->private_data = h;
+	/* the hooks are called only from the ops */
+	snd_pcm_generic_bypass(pcm);
 	pcm->poll_fd = slave->poll_fd;
 	pcm->poll_events = slave->poll_events;
 	pcm->mmap_shadow = 1;
@@ -87,6 +87,19 @@ static const snd_pcm_fast_ops_t snd_pcm_hw_fast_ops_timer;
  *
  */
 
+/* refine results kept for the refine_snapshot option; entry 0 is the
+ * full constraint space of the device, taken at open */
+#define HW_SNAPSHOT_ENTRIES	8
+
+typedef struct {
+	unsigned int used;
+	unsigned int next;		/* next entry to replace, never 0 */
+	struct {
+		snd_pcm_hw_params_t in;
+		snd_pcm_hw_params_t out;
+	} entry[HW_SNAPSHOT_ENTRIES];
+} snd_pcm_hw_snapshot_t;
+
 typedef struct {
 	int version;
 	int fd;
@@ -112,6 +125,10 @@ typedef struct {
 	/* for chmap */
 	unsigned int chmap_caps;
 	snd_pcm_chmap_query_t **chmap_override;
+	snd_ctl_t *chmap_ctl;		/* opened on the first chmap call */
+	snd_pcm_chmap_query_t **chmap_query;	/* cached TLV maps */
+	snd_pcm_chmap_t *chmap_cur;	/* cached current map */
+	snd_pcm_hw_snapshot_t *snapshot;
 } snd_pcm_hw_t;
 
 #define SNDRV_FILE_PCM_STREAM_PLAYBACK		ALSA_DEVICE_DIRECTORY "pcmC%iD%ip"
@@ -124,6 +141,43 @@ typedef struct {
 #define FAST_PCM_TSTAMP(hw) \
 	((hw)->mmap_status->tstamp)
 
+/* a coherent copy of the fields of the status page */
+typedef struct {
+	snd_pcm_uframes_t hw_ptr;
+	snd_pcm_state_t state;
+	struct timespec tstamp;
+} snd_pcm_hw_snap_t;
+
+/*
+ * The kernel rewrites the status page without a sequence counter, the
+ * pointer first and the timestamp after it.  The fields are read in the
+ * reverse order and again until both passes agree, so a snapshot never
+ * holds a torn timestamp or a pointer and a state of different updates;
+ * no lock or system call is needed when the page is mmapped.  A pointer
+ * whose timestamp is being written may still come with the previous
+ * timestamp, as for any reader of the page.
+ */
+static void snd_pcm_hw_read_status(snd_pcm_hw_t *hw, snd_pcm_hw_snap_t *snap)
+{
+	volatile struct snd_pcm_mmap_status *status = hw->mmap_status;
+
+	for (;;) {
+		snap->tstamp.tv_sec = status->tstamp.tv_sec;
+		snap->tstamp.tv_nsec = status->tstamp.tv_nsec;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		snap->hw_ptr = status->hw_ptr;
+		snap->state = (snd_pcm_state_t) status->state;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (status->hw_ptr == snap->hw_ptr &&
+		    (snd_pcm_state_t) status->state == snap->state &&
+		    status->tstamp.tv_nsec == snap->tstamp.tv_nsec &&
+		    status->tstamp.tv_sec == snap->tstamp.tv_sec)
+			break;
+	}
+	if (SNDRV_PROTOCOL_VERSION(2, 0, 5) > hw->version)
+		snap->tstamp.tv_nsec *= 1000L;
+}
+
 struct timespec snd_pcm_hw_fast_tstamp(snd_pcm_t *pcm)
 {
 	struct timespec res;
@@ -331,16 +385,148 @@ static int snd_pcm_hw_info(snd_pcm_t *pcm, snd_pcm_info_t * info)
 
 static inline int hw_refine_call(snd_pcm_hw_t *pcm_hw, snd_pcm_hw_params_t *params)
 {
+	unsigned long long trace = snd_trace_begin();
+	int err;
+
 	/* check for new hw_params structure; it's available from 2.0.2 version of PCM API */
 	if (SNDRV_PROTOCOL_VERSION(2, 0, 2) <= pcm_hw->version)
-		return ioctl(pcm_hw->fd, SNDRV_PCM_IOCTL_HW_REFINE, params);
-	return use_old_hw_params_ioctl(pcm_hw->fd, SND_PCM_IOCTL_HW_REFINE_OLD, params);
+		err = ioctl(pcm_hw->fd, SNDRV_PCM_IOCTL_HW_REFINE, params);
+	else
+		err = use_old_hw_params_ioctl(pcm_hw->fd, SND_PCM_IOCTL_HW_REFINE_OLD, params);
+	snd_trace_end(trace, "ioctl", "HW_REFINE", NULL);
+	return err;
+}
+
+#define HW_SNAPSHOT_MASKS \
+	(SND_PCM_HW_PARAM_LAST_MASK - SND_PCM_HW_PARAM_FIRST_MASK + 1)
+#define HW_SNAPSHOT_INTERVALS \
+	(SND_PCM_HW_PARAM_LAST_INTERVAL - SND_PCM_HW_PARAM_FIRST_INTERVAL + 1)
+#define HW_SNAPSHOT_RMASK \
+	((((1U << HW_SNAPSHOT_MASKS) - 1) << SND_PCM_HW_PARAM_FIRST_MASK) | \
+	 (((1U << HW_SNAPSHOT_INTERVALS) - 1) << SND_PCM_HW_PARAM_FIRST_INTERVAL))
+
+/* true if the interval b lies within a */
+static int hw_interval_within(const snd_interval_t *a, const snd_interval_t *b)
+{
+	if (a->empty || b->empty)
+		return 0;
+	if (b->min < a->min || (b->min == a->min && a->openmin && !b->openmin))
+		return 0;
+	if (b->max > a->max || (b->max == a->max && a->openmax && !b->openmax))
+		return 0;
+	return !a->integer || b->integer;
+}
+
+static int hw_interval_disjoint(const snd_interval_t *a, const snd_interval_t *b)
+{
+	if (a->max < b->min || (a->max == b->min && (a->openmax || b->openmin)))
+		return 1;
+	return b->max < a->min || (b->max == a->min && (b->openmax || a->openmin));
+}
+
+/* true if the configuration space b lies within a */
+static int hw_params_within(const snd_pcm_hw_params_t *a,
+			    const snd_pcm_hw_params_t *b)
+{
+	unsigned int i, k;
+
+	if (a->flags != b->flags)
+		return 0;
+	for (i = 0; i < HW_SNAPSHOT_MASKS; i++)
+		for (k = 0; k < sizeof(a->masks[i].bits) / sizeof(a->masks[i].bits[0]); k++)
+			if (b->masks[i].bits[k] & ~a->masks[i].bits[k])
+				return 0;
+	for (i = 0; i < HW_SNAPSHOT_INTERVALS; i++)
+		if (!hw_interval_within(&a->intervals[i], &b->intervals[i]))
+			return 0;
+	return 1;
+}
+
+/* true if no configuration of the device is left in params */
+static int hw_snapshot_excludes(const snd_pcm_hw_params_t *space,
+				const snd_pcm_hw_params_t *params)
+{
+	unsigned int i, k, any;
+
+	for (i = 0; i < HW_SNAPSHOT_MASKS; i++) {
+		any = 0;
+		for (k = 0; k < sizeof(space->masks[i].bits) / sizeof(space->masks[i].bits[0]); k++)
+			any |= params->masks[i].bits[k] & space->masks[i].bits[k];
+		if (!any)
+			return 1;
+	}
+	for (i = 0; i < HW_SNAPSHOT_INTERVALS; i++)
+		if (hw_interval_disjoint(&space->intervals[i], &params->intervals[i]))
+			return 1;
+	return 0;
+}
+
+/*
+ * The refinement is a narrowing to the largest consistent space below
+ * the input, so a result out computed for the input in is also the
+ * result for every space between the two.
+ * Returns 0 if params was refined from the snapshot, 1 if the kernel
+ * has to be asked, or a negative error code.
+ */
+static int hw_snapshot_refine(snd_pcm_hw_snapshot_t *snap,
+			      snd_pcm_hw_params_t *params)
+{
+	const snd_pcm_hw_params_t *out;
+	unsigned int i, cmask = 0;
+
+	if (!snap->used)
+		return 1;
+	if (params->flags == snap->entry[0].in.flags &&
+	    hw_snapshot_excludes(&snap->entry[0].out, params))
+		return -EINVAL;
+	for (i = 0; i < snap->used; i++) {
+		if (hw_params_within(&snap->entry[i].in, params) &&
+		    hw_params_within(params, &snap->entry[i].out))
+			break;
+	}
+	if (i >= snap->used)
+		return 1;
+	out = &snap->entry[i].out;
+	for (i = 0; i < HW_SNAPSHOT_MASKS; i++)
+		if (memcmp(&params->masks[i], &out->masks[i], sizeof(out->masks[i])))
+			cmask |= 1U << (SND_PCM_HW_PARAM_FIRST_MASK + i);
+	for (i = 0; i < HW_SNAPSHOT_INTERVALS; i++)
+		if (memcmp(&params->intervals[i], &out->intervals[i], sizeof(out->intervals[i])))
+			cmask |= 1U << (SND_PCM_HW_PARAM_FIRST_INTERVAL + i);
+	memcpy(params->masks, out->masks, sizeof(params->masks));
+	memcpy(params->intervals, out->intervals, sizeof(params->intervals));
+	params->rmask = 0;
+	params->cmask |= cmask;
+	params->info = out->info;
+	params->msbits = out->msbits;
+	params->rate_num = out->rate_num;
+	params->rate_den = out->rate_den;
+	params->fifo_size = out->fifo_size;
+	return 0;
+}
+
+static void hw_snapshot_store(snd_pcm_hw_snapshot_t *snap,
+			      const snd_pcm_hw_params_t *in,
+			      const snd_pcm_hw_params_t *out)
+{
+	unsigned int i;
+
+	if (snap->used < HW_SNAPSHOT_ENTRIES) {
+		i = snap->used++;
+	} else {
+		i = snap->next;
+		if (++snap->next >= HW_SNAPSHOT_ENTRIES)
+			snap->next = 1;
+	}
+	snap->entry[i].in = *in;
+	snap->entry[i].out = *out;
 }
 
 static int snd_pcm_hw_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
-	int err;
+	snd_pcm_hw_params_t in;
+	int err, full = 0;
 
 	if (hw->format != SND_PCM_FORMAT_UNKNOWN) {
 		err = _snd_pcm_hw_params_set_format(params, hw->format);
@@ -356,8 +542,20 @@ static int snd_pcm_hw_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	if (hw->rates.min > 0) {
 		err = _snd_pcm_hw_param_set_minmax(params, SND_PCM_HW_PARAM_RATE,
 						   hw->rates.min, 0, hw->rates.max + 1, -1);
+		if (err < 0)
+			return err;
+	}
 
+	if (hw->snapshot) {
+		err = hw_snapshot_refine(hw->snapshot, params);
+		if (err < 0)
 			return err;
+		if (err == 0)
+			goto __refined;
+		/* only results of a complete pass are stored */
+		full = (params->rmask & HW_SNAPSHOT_RMASK) == HW_SNAPSHOT_RMASK;
+		if (full)
+			in = *params;
 	}
 
 	if (hw_refine_call(hw, params) < 0) {
@@ -365,6 +563,10 @@ static int snd_pcm_hw_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 		// SYSMSG("SNDRV_PCM_IOCTL_HW_REFINE failed");
 		return err;
 	}
+	if (full)
+		hw_snapshot_store(hw->snapshot, &in, params);
+
+ __refined:
 
 	if (params->info != ~0U) {
 		params->info &= ~0xf0000000;
@@ -377,16 +579,30 @@ static int snd_pcm_hw_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 
 static inline int hw_params_call(snd_pcm_hw_t *pcm_hw, snd_pcm_hw_params_t *params)
 {
+	unsigned long long trace = snd_trace_begin();
+	int err;
+
 	/* check for new hw_params structure; it's available from 2.0.2 version of PCM API */
 	if (SNDRV_PROTOCOL_VERSION(2, 0, 2) <= pcm_hw->version)
-		return ioctl(pcm_hw->fd, SNDRV_PCM_IOCTL_HW_PARAMS, params);
-	return use_old_hw_params_ioctl(pcm_hw->fd, SND_PCM_IOCTL_HW_PARAMS_OLD, params);
+		err = ioctl(pcm_hw->fd, SNDRV_PCM_IOCTL_HW_PARAMS, params);
+	else
+		err = use_old_hw_params_ioctl(pcm_hw->fd, SND_PCM_IOCTL_HW_PARAMS_OLD, params);
+	snd_trace_end(trace, "ioctl", "HW_PARAMS", NULL);
+	return err;
+}
+
+/* the current map follows the setup of the stream */
+static void chmap_cur_drop(snd_pcm_hw_t *hw)
+{
+	free(hw->chmap_cur);
+	hw->chmap_cur = NULL;
 }
 
 static int snd_pcm_hw_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int err;
+	chmap_cur_drop(hw);
 	if (hw_params_call(hw, params) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_HW_PARAMS failed (%i)", err);
@@ -491,6 +707,7 @@ static int snd_pcm_hw_hw_free(snd_pcm_t *pcm)
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int fd = hw->fd, err;
 	snd_pcm_hw_change_timer(pcm, 0);
+	chmap_cur_drop(hw);
 	if (ioctl(fd, SNDRV_PCM_IOCTL_HW_FREE) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_HW_FREE failed (%i)", err);
@@ -661,11 +878,20 @@ static int snd_pcm_hw_prepare(snd_pcm_t *pcm)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int fd = hw->fd, err;
+	chmap_cur_drop(hw);
 	if (ioctl(fd, SNDRV_PCM_IOCTL_PREPARE) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_PREPARE failed (%i)", err);
 		return err;
 	}
+	if (pcm->mode & SND_PCM_MLOCK_AREAS) {
+		if (mlock((void *)hw->mmap_status, sizeof(*hw->mmap_status)) < 0 ||
+		    mlock(hw->mmap_control, sizeof(*hw->mmap_control)) < 0) {
+			err = -errno;
+			SYSMSG("mlock failed (%i)", err);
+			return err;
+		}
+	}
 	return query_status_and_control_data(hw);
 }
 
@@ -939,6 +1165,40 @@ static snd_pcm_sframes_t snd_pcm_hw_readn(snd_pcm_t *pcm, void **bufs, snd_pcm_u
 	return xfern.result;
 }
 
+/*
+ * DELAY ioctl which also updates the mmapped hw_ptr;
+ * -ENOSYS when a separate hwsync is required
+ */
+int snd_pcm_hw_delay_hwsync(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
+{
+	snd_pcm_hw_t *hw;
+
+	if (pcm->type != SND_PCM_TYPE_HW)
+		return -ENOSYS;
+	hw = pcm->private_data;
+	if (hw->mmap_status_fallbacked ||
+	    SNDRV_PROTOCOL_VERSION(2, 0, 3) > hw->version)
+		return -ENOSYS;
+	return snd_pcm_hw_delay(pcm, delayp);
+}
+
+/* file descriptor for read/write transfers queued by pcm_hw_uring.c */
+int snd_pcm_hw_uring_fd(snd_pcm_t *pcm)
+{
+	snd_pcm_hw_t *hw;
+
+	if (pcm->type != SND_PCM_TYPE_HW)
+		return -EINVAL;
+	hw = pcm->private_data;
+	return hw->fd;
+}
+
+/* refresh the pointers after a completed read/write transfer */
+int snd_pcm_hw_uring_sync(snd_pcm_t *pcm)
+{
+	return query_status_and_control_data(pcm->private_data);
+}
+
 static bool map_status_data(snd_pcm_hw_t *hw, struct snd_pcm_sync_ptr *sync_ptr,
 			    bool force_fallback)
 {
@@ -1098,6 +1358,11 @@ static int snd_pcm_hw_close(snd_pcm_t *pcm)
 
 	unmap_status_and_control_data(hw);
 
+	if (hw->chmap_ctl)
+		snd_ctl_close(hw->chmap_ctl);
+	snd_pcm_free_chmaps(hw->chmap_query);
+	free(hw->chmap_cur);
+	free(hw->snapshot);
 	free(hw);
 	return err;
 }
@@ -1116,14 +1381,14 @@ static snd_pcm_sframes_t snd_pcm_hw_mmap_commit(snd_pcm_t *pcm,
 	return size;
 }
 
-static snd_pcm_sframes_t snd_pcm_hw_avail_update(snd_pcm_t *pcm)
+static snd_pcm_sframes_t snd_pcm_hw_snap_avail(snd_pcm_t *pcm,
+						const snd_pcm_hw_snap_t *snap)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	snd_pcm_uframes_t avail;
 
-	query_status_data(hw);
-	avail = snd_pcm_mmap_avail(pcm);
-	switch (FAST_PCM_STATE(hw)) {
+	avail = __snd_pcm_avail(pcm, snap->hw_ptr, *pcm->appl.ptr);
+	switch (snap->state) {
 	case SNDRV_PCM_STATE_RUNNING:
 		if (avail >= pcm->stop_threshold) {
 			/* SNDRV_PCM_IOCTL_XRUN ioctl has been implemented since PCM kernel API 2.0.1 */
@@ -1143,23 +1408,31 @@ static snd_pcm_sframes_t snd_pcm_hw_avail_update(snd_pcm_t *pcm)
 	return avail;
 }
 
+static snd_pcm_sframes_t snd_pcm_hw_avail_update(snd_pcm_t *pcm)
+{
+	snd_pcm_hw_t *hw = pcm->private_data;
+	snd_pcm_hw_snap_t snap;
+
+	query_status_data(hw);
+	snd_pcm_hw_read_status(hw, &snap);
+	return snd_pcm_hw_snap_avail(pcm, &snap);
+}
+
 static int snd_pcm_hw_htimestamp(snd_pcm_t *pcm, snd_pcm_uframes_t *avail,
 				 snd_htimestamp_t *tstamp)
 {
+	snd_pcm_hw_t *hw = pcm->private_data;
+	snd_pcm_hw_snap_t snap;
 	snd_pcm_sframes_t avail1;
-	int ok = 0;
-
-	/* unfortunately, loop is necessary to ensure valid timestamp */
-	while (1) {
-		avail1 = snd_pcm_hw_avail_update(pcm);
-		if (avail1 < 0)
-			return avail1;
-		if (ok && (snd_pcm_uframes_t)avail1 == *avail)
-			break;
-		*avail = avail1;
-		*tstamp = snd_pcm_hw_fast_tstamp(pcm);
-		ok = 1;
-	}
+
+	/* one sync_ptr at most, the snapshot keeps avail and tstamp in step */
+	query_status_data(hw);
+	snd_pcm_hw_read_status(hw, &snap);
+	avail1 = snd_pcm_hw_snap_avail(pcm, &snap);
+	if (avail1 < 0)
+		return avail1;
+	*avail = avail1;
+	*tstamp = snap.tstamp;
 	return 0;
 }
 
@@ -1187,42 +1460,19 @@ static int is_chmap_type(int type)
 		type <= SND_CTL_TLVT_CHMAP_PAIRED);
 }
 
-/**
- * \!brief Query the available channel maps
- * \param card the card number
- * \param dev the PCM device number
- * \param subdev the PCM substream index
- * \param stream the direction of PCM stream
- * \return the NULL-terminated array of integer pointers, or NULL at error.
- *
- * This function works like snd_pcm_query_chmaps() but it takes the card,
- * device, substream and stream numbers instead of the already opened
- * snd_pcm_t instance, so that you can query available channel maps of
- * a PCM before actually opening it.
- *
- * As the parameters stand, the query is performed only to the hw PCM
- * devices, not the abstracted PCM object in alsa-lib.
- */
-snd_pcm_chmap_query_t **
-snd_pcm_query_chmaps_from_hw(int card, int dev, int subdev,
-			     snd_pcm_stream_t stream)
+/* read and parse the chmap TLV of the PCM substream */
+static snd_pcm_chmap_query_t **
+query_chmaps_from_ctl(snd_ctl_t *ctl, int dev, int subdev,
+		      snd_pcm_stream_t stream)
 {
-	snd_ctl_t *ctl;
 	snd_ctl_elem_id_t id = {0};
 	unsigned int tlv[2048], *start;
 	unsigned int type;
 	snd_pcm_chmap_query_t **map;
 	int i, ret, nums;
 
-	ret = snd_ctl_hw_open(&ctl, NULL, card, 0);
-	if (ret < 0) {
-		SYSMSG("Cannot open the associated CTL\n");
-		return NULL;
-	}
-
 	__fill_chmap_ctl_id(&id, dev, subdev, stream);
 	ret = snd_ctl_elem_tlv_read(ctl, &id, tlv, sizeof(tlv));
-	snd_ctl_close(ctl);
 	if (ret < 0) {
 		SYSMSG("Cannot read Channel Map TLV\n");
 		return NULL;
@@ -1276,6 +1526,41 @@ snd_pcm_query_chmaps_from_hw(int card, int dev, int subdev,
 	return map;
 }
 
+/**
+ * \!brief Query the available channel maps
+ * \param card the card number
+ * \param dev the PCM device number
+ * \param subdev the PCM substream index
+ * \param stream the direction of PCM stream
+ * \return the NULL-terminated array of integer pointers, or NULL at error.
+ *
+ * This function works like snd_pcm_query_chmaps() but it takes the card,
+ * device, substream and stream numbers instead of the already opened
+ * snd_pcm_t instance, so that you can query available channel maps of
+ * a PCM before actually opening it.
+ *
+ * As the parameters stand, the query is performed only to the hw PCM
+ * devices, not the abstracted PCM object in alsa-lib.
+ */
+snd_pcm_chmap_query_t **
+snd_pcm_query_chmaps_from_hw(int card, int dev, int subdev,
+			     snd_pcm_stream_t stream)
+{
+	snd_ctl_t *ctl;
+	snd_pcm_chmap_query_t **map;
+	int ret;
+
+	ret = snd_ctl_hw_open(&ctl, NULL, card, 0);
+	if (ret < 0) {
+		SYSMSG("Cannot open the associated CTL\n");
+		return NULL;
+	}
+
+	map = query_chmaps_from_ctl(ctl, dev, subdev, stream);
+	snd_ctl_close(ctl);
+	return map;
+}
+
 enum { CHMAP_CTL_QUERY, CHMAP_CTL_GET, CHMAP_CTL_SET };
 
 static int chmap_caps(snd_pcm_hw_t *hw, int type)
@@ -1297,10 +1582,55 @@ static void chmap_caps_set_error(snd_pcm_hw_t *hw, int type)
 	hw->chmap_caps |= (1 << (type + 8));
 }
 
+static void chmap_cache_drop(snd_pcm_hw_t *hw)
+{
+	snd_pcm_free_chmaps(hw->chmap_query);
+	hw->chmap_query = NULL;
+	chmap_cur_drop(hw);
+}
+
+/*
+ * The ctl of the card stays open for the chmap calls, subscribed to the
+ * events.  Any event on a PCM element of this device may change the
+ * maps (also "ELD" of HDMI on a hotplug), so it drops the cached ones.
+ */
+static int chmap_ctl_get(snd_pcm_hw_t *hw, snd_ctl_t **ctlp)
+{
+	snd_ctl_t *ctl = hw->chmap_ctl;
+	snd_ctl_event_t event;
+	int err;
+
+	if (!ctl) {
+		err = snd_ctl_hw_open(&ctl, NULL, hw->card, SND_CTL_NONBLOCK);
+		if (err < 0)
+			return err;
+		err = snd_ctl_subscribe_events(ctl, 1);
+		if (err < 0) {
+			snd_ctl_close(ctl);
+			return err;
+		}
+		hw->chmap_ctl = ctl;
+		*ctlp = ctl;
+		return 0;
+	}
+
+	while ((err = snd_ctl_read(hw->chmap_ctl, &event)) > 0) {
+		if (snd_ctl_event_get_type(&event) != SND_CTL_EVENT_ELEM)
+			continue;
+		if (snd_ctl_event_elem_get_interface(&event) == SND_CTL_ELEM_IFACE_PCM &&
+		    (int)snd_ctl_event_elem_get_device(&event) == hw->device)
+			chmap_cache_drop(hw);
+	}
+	if (err < 0 && err != -EAGAIN)
+		chmap_cache_drop(hw);
+	*ctlp = ctl;
+	return 0;
+}
+
 static snd_pcm_chmap_query_t **snd_pcm_hw_query_chmaps(snd_pcm_t *pcm)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
-	snd_pcm_chmap_query_t **map;
+	snd_ctl_t *ctl;
 
 	if (hw->chmap_override)
 		return _snd_pcm_copy_chmap_query(hw->chmap_override);
@@ -1308,13 +1638,22 @@ static snd_pcm_chmap_query_t **snd_pcm_hw_query_chmaps(snd_pcm_t *pcm)
 	if (!chmap_caps(hw, CHMAP_CTL_QUERY))
 		return NULL;
 
-	map = snd_pcm_query_chmaps_from_hw(hw->card, hw->device,
-					   hw->subdevice, pcm->stream);
-	if (map)
-		chmap_caps_set_ok(hw, CHMAP_CTL_QUERY);
-	else
+	if (chmap_ctl_get(hw, &ctl) < 0) {
+		SYSMSG("Cannot open the associated CTL\n");
 		chmap_caps_set_error(hw, CHMAP_CTL_QUERY);
-	return map;
+		return NULL;
+	}
+	if (!hw->chmap_query) {
+		hw->chmap_query = query_chmaps_from_ctl(ctl, hw->device,
+							hw->subdevice,
+							pcm->stream);
+		if (!hw->chmap_query) {
+			chmap_caps_set_error(hw, CHMAP_CTL_QUERY);
+			return NULL;
+		}
+	}
+	chmap_caps_set_ok(hw, CHMAP_CTL_QUERY);
+	return _snd_pcm_copy_chmap_query(hw->chmap_query);
 }
 
 static snd_pcm_chmap_t *snd_pcm_hw_get_chmap(snd_pcm_t *pcm)
@@ -1325,6 +1664,7 @@ static snd_pcm_chmap_t *snd_pcm_hw_get_chmap(snd_pcm_t *pcm)
 	snd_ctl_elem_id_t id = {0};
 	snd_ctl_elem_value_t val = {0};
 	unsigned int i;
+	size_t size;
 	int ret;
 
 	if (hw->chmap_override)
@@ -1346,21 +1686,23 @@ static snd_pcm_chmap_t *snd_pcm_hw_get_chmap(snd_pcm_t *pcm)
 		       snd_pcm_state_name(FAST_PCM_STATE(hw)));
 		return NULL;
 	}
-	map = malloc(pcm->channels * sizeof(map->pos[0]) + sizeof(*map));
-	if (!map)
-		return NULL;
-	map->channels = pcm->channels;
-	ret = snd_ctl_hw_open(&ctl, NULL, hw->card, 0);
-	if (ret < 0) {
-		free(map);
+	if (chmap_ctl_get(hw, &ctl) < 0) {
 		SYSMSG("Cannot open the associated CTL\n");
 		chmap_caps_set_error(hw, CHMAP_CTL_GET);
 		return NULL;
 	}
+	size = pcm->channels * sizeof(map->pos[0]) + sizeof(*map);
+	map = malloc(size);
+	if (!map)
+		return NULL;
+	if (hw->chmap_cur && hw->chmap_cur->channels == pcm->channels) {
+		memcpy(map, hw->chmap_cur, size);
+		return map;
+	}
+	map->channels = pcm->channels;
 	fill_chmap_ctl_id(pcm, &id);
 	snd_ctl_elem_value_set_id(&val, &id);
 	ret = snd_ctl_elem_read(ctl, &val);
-	snd_ctl_close(ctl);
 	if (ret < 0) {
 		free(map);
 		SYSMSG("Cannot read Channel Map ctl\n");
@@ -1370,6 +1712,10 @@ static snd_pcm_chmap_t *snd_pcm_hw_get_chmap(snd_pcm_t *pcm)
 	for (i = 0; i < pcm->channels; i++)
 		map->pos[i] = snd_ctl_elem_value_get_integer(&val, i);
 	chmap_caps_set_ok(hw, CHMAP_CTL_GET);
+	free(hw->chmap_cur);
+	hw->chmap_cur = malloc(size);
+	if (hw->chmap_cur)
+		memcpy(hw->chmap_cur, map, size);
 	return map;
 }
 
@@ -1397,7 +1743,7 @@ static int snd_pcm_hw_set_chmap(snd_pcm_t *pcm, const snd_pcm_chmap_t *map)
 		       snd_pcm_state_name(FAST_PCM_STATE(hw)));
 		return -EBADFD;
 	}
-	ret = snd_ctl_hw_open(&ctl, NULL, hw->card, 0);
+	ret = chmap_ctl_get(hw, &ctl);
 	if (ret < 0) {
 		SYSMSG("Cannot open the associated CTL\n");
 		chmap_caps_set_error(hw, CHMAP_CTL_SET);
@@ -1408,8 +1754,8 @@ static int snd_pcm_hw_set_chmap(snd_pcm_t *pcm, const snd_pcm_chmap_t *map)
 	snd_ctl_elem_value_set_id(&val, &id);
 	for (i = 0; i < map->channels; i++)
 		snd_ctl_elem_value_set_integer(&val, i, map->pos[i]);
+	chmap_cur_drop(hw);
 	ret = snd_ctl_elem_write(ctl, &val);
-	snd_ctl_close(ctl);
 	if (ret >= 0)
 		chmap_caps_set_ok(hw, CHMAP_CTL_SET);
 	else if (ret == -ENOENT || ret == -EPERM || ret == -ENXIO) {
@@ -1681,6 +2027,7 @@ int snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 	int attempt = 0;
 	snd_pcm_info_t info;
 	int fmode;
+	unsigned long long trace;
 	snd_ctl_t *ctl;
 
 	assert(pcmp);
@@ -1716,7 +2063,9 @@ int snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 		fmode |= O_ASYNC;
 	if (mode & SND_PCM_APPEND)
 		fmode |= O_APPEND;
+	trace = snd_trace_begin();
 	fd = snd_open_device(filename, fmode);
+	snd_trace_end(trace, "ioctl", "open", filename);
 	if (fd < 0) {
 		ret = -errno;
 		SYSMSG("open '%s' failed (%i)", filename, ret);
@@ -1771,9 +2120,20 @@ pcm.name {
 	[rate INT]		# Restrict only to the given rate
 	  or [rate [INT INT]]	# Restrict only to the given rate range (min max)
 	[chmap MAP]		# Override channel maps; MAP is a string array
+	[refine_snapshot BOOL]	# Refine from a snapshot of the constraints (default false)
 }
 \endcode
 
+With <code>refine_snapshot</code> the constraint space of the device is
+read once at open and the results of complete refinements are kept.
+A refinement whose input lies between an earlier input and its result
+is answered from them without the SNDRV_PCM_IOCTL_HW_REFINE ioctl, and
+an input which excludes every configuration of the device is rejected
+directly.  snd_pcm_hw_params() is always validated by the kernel.  The
+option must not be used for devices whose constraints change while the
+PCM is open, for example when another stream of the same card fixes the
+shared clock.
+
 \subsection pcm_plugins_hw_funcref Function reference
 
 <UL>
@@ -1807,6 +2167,7 @@ int _snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 	snd_pcm_format_t format = SND_PCM_FORMAT_UNKNOWN;
 	snd_config_t *n;
 	int nonblock = 1; /* non-block per default */
+	int refine_snapshot = 0;
 	snd_pcm_chmap_query_t **chmap = NULL;
 	snd_pcm_hw_t *hw;
 
@@ -1853,6 +2214,13 @@ int _snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 			sync_ptr_ioctl = err;
 			continue;
 		}
+		if (strcmp(id, "refine_snapshot") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				goto fail;
+			refine_snapshot = err;
+			continue;
+		}
 		if (strcmp(id, "nonblock") == 0) {
 			err = snd_config_get_bool(n);
 			if (err < 0)
@@ -1986,6 +2354,20 @@ int _snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 	}
 	if (chmap)
 		hw->chmap_override = chmap;
+	if (refine_snapshot) {
+		snd_pcm_hw_params_t params;
+
+		/* the full space, with the restrictions above applied */
+		hw->snapshot = calloc(1, sizeof(*hw->snapshot));
+		if (hw->snapshot) {
+			hw->snapshot->next = 1;
+			_snd_pcm_hw_params_any(&params);
+			if (snd_pcm_hw_hw_refine(*pcmp, &params) < 0) {
+				free(hw->snapshot);
+				hw->snapshot = NULL;
+			}
+		}
+	}
 
 	return 0;
 
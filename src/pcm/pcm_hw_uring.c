@@ -0,0 +1,414 @@
+/**
+ * \file pcm/pcm_hw_uring.c
+ * \ingroup PCM_Plugins
+ * \brief PCM HW Plugin - batched transfers through io_uring
+ */
+/*
+ *  PCM - Hardware - io_uring transfers
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * The PCM character device implements read() and write() for the
+ * RW_INTERLEAVED access, so the interleaved transfers of many hw
+ * streams can be queued into one io_uring and submitted with a single
+ * io_uring_enter() call.  The hardware and application pointers come
+ * from the mmapped status/control pages; SYNC_PTR is issued only for
+ * streams where the kernel refused to map them.
+ */
+
+#include "pcm_local.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup) && \
+    defined(__NR_io_uring_enter)
+#define BUILD_HW_URING
+#include <linux/io_uring.h>
+#endif
+
+#ifndef DOC_HIDDEN
+
+#ifdef BUILD_HW_URING
+
+typedef struct {
+	snd_pcm_t *pcm;
+	void *private_data;
+	int next_free;
+} snd_pcm_hw_uring_req_t;
+
+struct _snd_pcm_hw_uring {
+	int fd;
+	/* submission queue */
+	void *sq_ring;
+	size_t sq_ring_size;
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int sq_mask;
+	unsigned int sq_entries;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+	unsigned int sq_pending;	/* queued, not yet passed to the kernel */
+	/* completion queue */
+	void *cq_ring;
+	size_t cq_ring_size;
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int cq_mask;
+	struct io_uring_cqe *cqes;
+	/* in-flight requests, bounded by the completion queue size */
+	snd_pcm_hw_uring_req_t *reqs;
+	int free_req;
+};
+
+static void hw_uring_unmap(snd_pcm_hw_uring_t *ring)
+{
+	if (ring->sqes && ring->sqes != MAP_FAILED)
+		munmap(ring->sqes, ring->sqes_size);
+	if (ring->cq_ring && ring->cq_ring != MAP_FAILED &&
+	    ring->cq_ring != ring->sq_ring)
+		munmap(ring->cq_ring, ring->cq_ring_size);
+	if (ring->sq_ring && ring->sq_ring != MAP_FAILED)
+		munmap(ring->sq_ring, ring->sq_ring_size);
+}
+
+static int hw_uring_map(snd_pcm_hw_uring_t *ring, struct io_uring_params *p)
+{
+	unsigned int *array, i;
+
+	ring->sq_ring_size = p->sq_off.array + p->sq_entries * sizeof(unsigned int);
+	ring->cq_ring_size = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+	if (p->features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_ring_size > ring->sq_ring_size)
+			ring->sq_ring_size = ring->cq_ring_size;
+		ring->cq_ring_size = ring->sq_ring_size;
+	}
+	ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+			     MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ring->sq_ring == MAP_FAILED)
+		return -errno;
+	if (p->features & IORING_FEAT_SINGLE_MMAP) {
+		ring->cq_ring = ring->sq_ring;
+	} else {
+		ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+				     MAP_SHARED | MAP_POPULATE, ring->fd,
+				     IORING_OFF_CQ_RING);
+		if (ring->cq_ring == MAP_FAILED)
+			return -errno;
+	}
+	ring->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+		return -errno;
+
+	ring->sq_head = (unsigned int *)((char *)ring->sq_ring + p->sq_off.head);
+	ring->sq_tail = (unsigned int *)((char *)ring->sq_ring + p->sq_off.tail);
+	ring->sq_mask = *(unsigned int *)((char *)ring->sq_ring + p->sq_off.ring_mask);
+	ring->sq_entries = p->sq_entries;
+	/* sqe slots are used in order, the index array is an identity map */
+	array = (unsigned int *)((char *)ring->sq_ring + p->sq_off.array);
+	for (i = 0; i < p->sq_entries; i++)
+		array[i] = i;
+	ring->cq_head = (unsigned int *)((char *)ring->cq_ring + p->cq_off.head);
+	ring->cq_tail = (unsigned int *)((char *)ring->cq_ring + p->cq_off.tail);
+	ring->cq_mask = *(unsigned int *)((char *)ring->cq_ring + p->cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)((char *)ring->cq_ring + p->cq_off.cqes);
+	return 0;
+}
+
+static int hw_uring_enter(snd_pcm_hw_uring_t *ring, unsigned int to_submit,
+			  unsigned int min_complete, unsigned int flags)
+{
+	int ret;
+
+	do {
+		ret = syscall(__NR_io_uring_enter, ring->fd, to_submit,
+			      min_complete, flags, NULL, 0);
+	} while (ret < 0 && errno == EINTR && !to_submit);
+	return ret < 0 ? -errno : ret;
+}
+
+static int hw_uring_queue(snd_pcm_hw_uring_t *ring, snd_pcm_t *pcm,
+			  int opcode, void *buffer, snd_pcm_uframes_t size,
+			  void *private_data)
+{
+	struct io_uring_sqe *sqe;
+	unsigned int tail;
+	int fd, idx;
+
+	if (!pcm->setup)
+		return -EBADFD;
+	if (pcm->access != SND_PCM_ACCESS_RW_INTERLEAVED)
+		return -EINVAL;
+	fd = snd_pcm_hw_uring_fd(pcm);
+	if (fd < 0)
+		return fd;
+	if (ring->free_req < 0)
+		return -EBUSY;
+	tail = *ring->sq_tail + ring->sq_pending;
+	if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries)
+		return -EAGAIN;
+
+	idx = ring->free_req;
+	ring->free_req = ring->reqs[idx].next_free;
+	ring->reqs[idx].pcm = pcm;
+	ring->reqs[idx].private_data = private_data;
+
+	sqe = &ring->sqes[tail & ring->sq_mask];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->addr = (unsigned long)buffer;
+	sqe->len = snd_pcm_frames_to_bytes(pcm, size);
+	/* character devices ignore the position, -1 means "current" */
+	sqe->off = (__u64)-1;
+	sqe->user_data = idx;
+	ring->sq_pending++;
+	return 0;
+}
+
+#endif /* BUILD_HW_URING */
+
+#endif /* DOC_HIDDEN */
+
+/**
+ * \brief Create an io_uring context for batched hw PCM transfers
+ * \param ringp Returned context
+ * \param entries Number of transfers which can be queued between two
+ *                snd_pcm_hw_uring_submit() calls
+ * \return 0 on success otherwise a negative error code
+ *
+ * One context can drive any number of hw PCM handles.  The transfers
+ * of all of them are passed to the kernel with a single system call.
+ */
+int snd_pcm_hw_uring_open(snd_pcm_hw_uring_t **ringp, unsigned int entries)
+{
+#ifdef BUILD_HW_URING
+	snd_pcm_hw_uring_t *ring;
+	struct io_uring_params p;
+	unsigned int i;
+	int err;
+
+	assert(ringp);
+	if (!entries)
+		return -EINVAL;
+	ring = calloc(1, sizeof(*ring));
+	if (!ring)
+		return -ENOMEM;
+	memset(&p, 0, sizeof(p));
+	ring->fd = syscall(__NR_io_uring_setup, entries, &p);
+	if (ring->fd < 0) {
+		err = -errno;
+		SYSMSG("io_uring_setup failed (%i)", err);
+		free(ring);
+		return err;
+	}
+	err = hw_uring_map(ring, &p);
+	if (err < 0)
+		goto _err;
+	ring->reqs = calloc(p.cq_entries, sizeof(*ring->reqs));
+	if (!ring->reqs) {
+		err = -ENOMEM;
+		goto _err;
+	}
+	for (i = 0; i < p.cq_entries; i++)
+		ring->reqs[i].next_free = i + 1 < p.cq_entries ? (int)i + 1 : -1;
+	ring->free_req = 0;
+	*ringp = ring;
+	return 0;
+
+ _err:
+	hw_uring_unmap(ring);
+	close(ring->fd);
+	free(ring);
+	return err;
+#else
+	assert(ringp);
+	*ringp = NULL;
+	(void)entries;
+	return -ENOSYS;
+#endif
+}
+
+/**
+ * \brief Release an io_uring context
+ * \param ring Context
+ * \return 0 on success otherwise a negative error code
+ *
+ * Transfers still in flight are cancelled by the kernel; the PCM
+ * handles themselves are not touched.
+ */
+int snd_pcm_hw_uring_close(snd_pcm_hw_uring_t *ring)
+{
+#ifdef BUILD_HW_URING
+	if (!ring)
+		return 0;
+	hw_uring_unmap(ring);
+	close(ring->fd);
+	free(ring->reqs);
+	free(ring);
+	return 0;
+#else
+	(void)ring;
+	return -ENOSYS;
+#endif
+}
+
+/**
+ * \brief Queue an interleaved write to a hw PCM
+ * \param ring Context
+ * \param pcm hw PCM handle set up with #SND_PCM_ACCESS_RW_INTERLEAVED
+ * \param buffer Frames containing buffer, must stay valid until completion
+ * \param size Frames to be written
+ * \param private_data Value returned with the completion
+ * \return 0 on success, -EAGAIN when the submission queue is full,
+ *         -EBUSY when too many transfers are in flight, otherwise
+ *         a negative error code
+ *
+ * The transfer is passed to the kernel by the next
+ * snd_pcm_hw_uring_submit() call.  Like snd_pcm_writei(), it blocks in
+ * the kernel (not in the caller) unless the PCM is in nonblocking mode.
+ */
+int snd_pcm_hw_uring_writei(snd_pcm_hw_uring_t *ring, snd_pcm_t *pcm,
+			    const void *buffer, snd_pcm_uframes_t size,
+			    void *private_data)
+{
+#ifdef BUILD_HW_URING
+	assert(ring && pcm);
+	if (pcm->stream != SND_PCM_STREAM_PLAYBACK)
+		return -EINVAL;
+	return hw_uring_queue(ring, pcm, IORING_OP_WRITE, (void *)buffer, size,
+			      private_data);
+#else
+	(void)ring; (void)pcm; (void)buffer; (void)size; (void)private_data;
+	return -ENOSYS;
+#endif
+}
+
+/**
+ * \brief Queue an interleaved read from a hw PCM
+ * \param ring Context
+ * \param pcm hw PCM handle set up with #SND_PCM_ACCESS_RW_INTERLEAVED
+ * \param buffer Frames containing buffer, must stay valid until completion
+ * \param size Frames to be read
+ * \param private_data Value returned with the completion
+ * \return 0 on success otherwise a negative error code
+ *
+ * See snd_pcm_hw_uring_writei() for the error codes.
+ */
+int snd_pcm_hw_uring_readi(snd_pcm_hw_uring_t *ring, snd_pcm_t *pcm,
+			   void *buffer, snd_pcm_uframes_t size,
+			   void *private_data)
+{
+#ifdef BUILD_HW_URING
+	assert(ring && pcm);
+	if (pcm->stream != SND_PCM_STREAM_CAPTURE)
+		return -EINVAL;
+	return hw_uring_queue(ring, pcm, IORING_OP_READ, buffer, size,
+			      private_data);
+#else
+	(void)ring; (void)pcm; (void)buffer; (void)size; (void)private_data;
+	return -ENOSYS;
+#endif
+}
+
+/**
+ * \brief Pass the queued transfers to the kernel
+ * \param ring Context
+ * \param wait_nr Number of completions to wait for (0 = do not wait)
+ * \return number of submitted transfers otherwise a negative error code
+ */
+int snd_pcm_hw_uring_submit(snd_pcm_hw_uring_t *ring, unsigned int wait_nr)
+{
+#ifdef BUILD_HW_URING
+	unsigned int tail, pending;
+	int ret;
+
+	assert(ring);
+	tail = *ring->sq_tail + ring->sq_pending;
+	if (ring->sq_pending) {
+		__atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+		ring->sq_pending = 0;
+	}
+	/* includes entries left over by a failed call */
+	pending = tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+	if (!pending && !wait_nr)
+		return 0;
+	ret = hw_uring_enter(ring, pending, wait_nr,
+			     wait_nr ? IORING_ENTER_GETEVENTS : 0);
+	if (ret < 0)
+		SYSMSG("io_uring_enter failed (%i)", ret);
+	return ret;
+#else
+	(void)ring; (void)wait_nr;
+	return -ENOSYS;
+#endif
+}
+
+/**
+ * \brief Fetch one finished transfer
+ * \param ring Context
+ * \param pcmp Returned PCM handle of the transfer
+ * \param result Returned frames transferred or a negative error code
+ *               (-EPIPE for xrun, -ESTRPIPE for suspend like snd_pcm_writei())
+ * \param private_data Returned value passed when the transfer was queued
+ * \return 1 when a completion was returned, 0 when none is ready,
+ *         otherwise a negative error code
+ */
+int snd_pcm_hw_uring_complete(snd_pcm_hw_uring_t *ring, snd_pcm_t **pcmp,
+			      snd_pcm_sframes_t *result, void **private_data)
+{
+#ifdef BUILD_HW_URING
+	struct io_uring_cqe *cqe;
+	snd_pcm_hw_uring_req_t *req;
+	unsigned int head;
+	snd_pcm_t *pcm;
+	int res, err;
+
+	assert(ring && pcmp && result);
+	head = *ring->cq_head;
+	if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+		return 0;
+	cqe = &ring->cqes[head & ring->cq_mask];
+	req = &ring->reqs[cqe->user_data];
+	res = cqe->res;
+	__atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+	pcm = req->pcm;
+	*pcmp = pcm;
+	if (private_data)
+		*private_data = req->private_data;
+	req->next_free = ring->free_req;
+	ring->free_req = req - ring->reqs;
+
+	if (res >= 0) {
+		err = snd_pcm_hw_uring_sync(pcm);
+		if (err < 0)
+			res = err;
+	}
+	*result = res < 0 ? snd_pcm_check_error(pcm, res) :
+			    snd_pcm_bytes_to_frames(pcm, res);
+	return 1;
+#else
+	(void)ring; (void)pcmp; (void)result; (void)private_data;
+	return -ENOSYS;
+#endif
+}
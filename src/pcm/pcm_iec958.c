@@ -31,6 +31,7 @@
 #include "pcm_plugin.h"
 
 #include "plugin_ops.h"
+#include "plugin_block_ops.h"
 
 #ifndef PIC
 /* entry for static linking */
@@ -62,6 +63,9 @@ struct snd_pcm_iec958 {
 	unsigned char status[24];
 	unsigned int byteswap;
 	unsigned char preamble[3];	/* B/M/W or Z/X/Y */
+	/* status bit, its parity and the preamble per counter value,
+	 * [0] for channel 0 and [1] for the other channels */
+	uint32_t subframe_bits[2][192];
 	snd_pcm_fast_ops_t fops;
 	int hdmi_mode;
 };
@@ -74,20 +78,36 @@ enum { PREAMBLE_Z, PREAMBLE_X, PREAMBLE_Y };
  * Determine parity for time slots 4 upto 30
  * to be sure that bit 4 upt 31 will carry
  * an even number of ones and zeros.
+ * The word is folded down to a nibble whose parity
+ * is looked up in the 16 bit table 0x6996.
  */
-static unsigned int iec958_parity(unsigned int data)
+static inline unsigned int iec958_parity(unsigned int data)
 {
-	unsigned int parity;
-	int bit;
-
-	data >>= 4;     /* start from bit 4 */
-	parity = 0;
-	for (bit = 4; bit <= 30; bit++) {
-		if (data & 1)
-			parity++;
-		data >>= 1;
+	data &= 0x7ffffff0;	/* bit 4-30 */
+	data ^= data >> 16;
+	data ^= data >> 8;
+	data ^= data >> 4;
+	return (0x6996 >> (data & 0xf)) & 1;
+}
+
+/*
+ * The channel status bit and the preamble of a subframe depend only
+ * on the position in the 192 frame block and on the channel, so they
+ * are composed once per setup.  The parity of the status bit is folded
+ * into bit 31 so that a subframe is completed with a single xor.
+ */
+static void iec958_build_subframe_bits(snd_pcm_iec958_t *iec)
+{
+	unsigned int counter;
+
+	for (counter = 0; counter < 192; counter++) {
+		uint32_t bits = 0;
+		if (iec->status[counter >> 3] & (1 << (counter & 7)))
+			bits = 0xc0000000;	/* status and parity bit */
+		iec->subframe_bits[0][counter] = bits |
+			iec->preamble[counter ? PREAMBLE_X : PREAMBLE_Z];
+		iec->subframe_bits[1][counter] = bits | iec->preamble[PREAMBLE_Y];
 	}
-	return (parity & 1);
 }
 
 /*
@@ -103,29 +123,17 @@ static unsigned int iec958_parity(unsigned int data)
  *     31   = parity
  */
 
-static inline uint32_t iec958_subframe(snd_pcm_iec958_t *iec, uint32_t data, int channel)
+static inline uint32_t iec958_subframe_data(const snd_pcm_iec958_t *iec,
+					    uint32_t data, unsigned int counter,
+					    int channel)
 {
-	unsigned int byte = iec->counter >> 3;
-	unsigned int mask = 1 << (iec->counter - (byte << 3));
-
 	/* bit 4-27 */
 	data >>= 4;
 	data &= ~0xf;
 
-	/* set IEC status bits (up to 192 bits) */
-	if (iec->status[byte] & mask)
-		data |= 0x40000000;
-
-	if (iec958_parity(data))	/* parity bit 4-30 */
-		data |= 0x80000000;
-
-	/* Preamble */
-	if (channel)
-		data |= iec->preamble[PREAMBLE_Y];	/* odd sub frame, 'Y' */
-	else if (! iec->counter)
-		data |= iec->preamble[PREAMBLE_Z];	/* Block start, 'Z' */
-	else
-		data |= iec->preamble[PREAMBLE_X];	/* even sub frame, 'X' */
+	/* parity bit 4-30, status bit (up to 192 bits) and preamble */
+	data |= iec958_parity(data) << 31;
+	data ^= iec->subframe_bits[channel != 0][counter];
 
 	if (iec->byteswap)
 		data = bswap_32(data);
@@ -133,6 +141,11 @@ static inline uint32_t iec958_subframe(snd_pcm_iec958_t *iec, uint32_t data, int
 	return data;
 }
 
+static inline uint32_t iec958_subframe(snd_pcm_iec958_t *iec, uint32_t data, int channel)
+{
+	return iec958_subframe_data(iec, data, iec->counter, channel);
+}
+
 static inline int32_t iec958_to_s32(snd_pcm_iec958_t *iec, uint32_t data)
 {
 	if (iec->byteswap)
@@ -180,6 +193,79 @@ static void snd_pcm_iec958_decode(snd_pcm_iec958_t *iec,
 	}
 }
 
+/*
+ * Encode a contiguous interleaved run of native S16 or S32 samples into
+ * interleaved subframes, frame by frame.  In the HDMI single stream mode
+ * channel pair p of a frame carries block position counter + p.
+ */
+static inline void iec958_encode_block(snd_pcm_iec958_t *iec, uint32_t *dst,
+				       const void *src, unsigned int width,
+				       unsigned int channels,
+				       snd_pcm_uframes_t frames,
+				       int single_stream)
+{
+	const uint16_t *s16 = src;
+	const uint32_t *s32 = src;
+	unsigned int counter = iec->counter;
+	unsigned int counter_step = single_stream ? ((channels + 1) >> 1) : 1;
+	unsigned int channel;
+
+	while (frames-- > 0) {
+		for (channel = 0; channel < channels; channel++) {
+			unsigned int n = counter;
+			uint32_t sample;
+			if (single_stream) {
+				n += channel >> 1;
+				if (n >= 192)
+					n -= 192;
+			}
+			if (width == 16)
+				sample = (uint32_t)*s16++ << 16;
+			else
+				sample = *s32++;
+			*dst++ = iec958_subframe_data(iec, sample, n, channel);
+		}
+		counter += counter_step;
+		if (counter >= 192)
+			counter -= 192;
+	}
+	iec->counter = counter;
+}
+
+/* interleaved native S16 or S32 input; returns 0 for other layouts */
+static int iec958_encode_interleaved(snd_pcm_iec958_t *iec,
+				     const snd_pcm_channel_area_t *dst_areas,
+				     snd_pcm_uframes_t dst_offset,
+				     const snd_pcm_channel_area_t *src_areas,
+				     snd_pcm_uframes_t src_offset,
+				     unsigned int channels, snd_pcm_uframes_t frames,
+				     int single_stream)
+{
+	unsigned int width;
+	const char *src;
+	uint32_t *dst;
+
+	if (iec->getput_idx == (unsigned int)snd_pcm_linear_get_index(SND_PCM_FORMAT_S16,
+									SND_PCM_FORMAT_S32))
+		width = 16;
+	else if (iec->getput_idx == (unsigned int)snd_pcm_linear_get_index(SND_PCM_FORMAT_S32,
+									     SND_PCM_FORMAT_S32))
+		width = 32;
+	else
+		return 0;
+	src = snd_pcm_block_areas_addr(src_areas, src_offset, channels, width);
+	if (!src || ((uintptr_t)src & (width / 8 - 1)))
+		return 0;
+	dst = (uint32_t *)snd_pcm_block_areas_addr(dst_areas, dst_offset, channels, 32);
+	if (!dst || ((uintptr_t)dst & 3))
+		return 0;
+	if (width == 16)
+		iec958_encode_block(iec, dst, src, 16, channels, frames, single_stream);
+	else
+		iec958_encode_block(iec, dst, src, 32, channels, frames, single_stream);
+	return 1;
+}
+
 static void snd_pcm_iec958_encode(snd_pcm_iec958_t *iec,
 				  const snd_pcm_channel_area_t *dst_areas,
 				  snd_pcm_uframes_t dst_offset,
@@ -198,6 +284,11 @@ static void snd_pcm_iec958_encode(snd_pcm_iec958_t *iec,
 			    (iec->status[0] & IEC958_AES0_NONAUDIO) &&
 			    (channels == 8);
 	int counter_step = single_stream ? ((channels + 1) >> 1) : 1;
+
+	if (iec958_encode_interleaved(iec, dst_areas, dst_offset,
+				      src_areas, src_offset,
+				      channels, frames, single_stream))
+		return;
 	for (channel = 0; channel < channels; ++channel) {
 		const char *src;
 		uint32_t *dst;
@@ -439,6 +530,7 @@ static int snd_pcm_iec958_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params
 			iec->status[4] |= ws;
 		}
 	}
+	iec958_build_subframe_bits(iec);
 	return 0;
 }
 
@@ -496,6 +588,7 @@ static void snd_pcm_iec958_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
 	}
+	snd_pcm_plugin_dump_profile(pcm, out);
 	snd_output_printf(out, "Slave: ");
 	snd_pcm_dump(iec->plug.gen.slave, out);
 }
@@ -45,6 +45,11 @@ typedef struct snd_pcm_ioplug_priv {
 	snd_pcm_uframes_t last_hw;
 	snd_pcm_uframes_t avail_max;
 	snd_htimestamp_t trigger_tstamp;
+	/* hw pointer extrapolation (SND_PCM_IOPLUG_FLAG_PTR_EXTRAPOLATE) */
+	snd_pcm_uframes_t resync;	/* max. frames between pointer calls */
+	snd_pcm_uframes_t ext_frames;	/* frames hw.ptr runs ahead of the plugin */
+	snd_htimestamp_t sync_tstamp;	/* time of the last pointer call */
+	int synced;
 } ioplug_priv_t;
 
 static int snd_pcm_ioplug_drop(snd_pcm_t *pcm);
@@ -72,7 +77,21 @@ static void snd_pcm_ioplug_hw_ptr_update(snd_pcm_t *pcm)
 					pcm->boundary : pcm->buffer_size;
 			delta = wrap_point + hw - io->last_hw;
 		}
+		/* the extrapolated part was already applied to hw.ptr */
+		if (io->ext_frames) {
+			if (delta >= io->ext_frames) {
+				delta -= io->ext_frames;
+				io->ext_frames = 0;
+			} else {
+				io->ext_frames -= delta;
+				delta = 0;
+			}
+		}
 		snd_pcm_mmap_hw_forward(io->data->pcm, delta);
+		if (io->data->flags & SND_PCM_IOPLUG_FLAG_PTR_EXTRAPOLATE) {
+			gettimestamp(&io->sync_tstamp, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+			io->synced = 1;
+		}
 		/* stop the stream if all samples are drained */
 		if (io->data->state == SND_PCM_STATE_DRAINING) {
 			avail = snd_pcm_mmap_avail(pcm);
@@ -88,6 +107,60 @@ static void snd_pcm_ioplug_hw_ptr_update(snd_pcm_t *pcm)
 	}
 }
 
+/* invalidate the extrapolation base; the next update calls the plugin */
+static inline void snd_pcm_ioplug_ptr_unsync(ioplug_priv_t *io)
+{
+	io->synced = 0;
+}
+
+/* drop any extrapolated frames, e.g. when hw.ptr is reset */
+static inline void snd_pcm_ioplug_ptr_clear(ioplug_priv_t *io)
+{
+	io->synced = 0;
+	io->ext_frames = 0;
+}
+
+/* update the hw pointer, extrapolating from the last pointer call
+ * if allowed; falls back to the pointer callback once the resync
+ * threshold is reached or the estimate would exceed the queued frames
+ */
+/* called in lock */
+static void snd_pcm_ioplug_hw_ptr_update_cached(snd_pcm_t *pcm)
+{
+	ioplug_priv_t *io = pcm->private_data;
+	snd_htimestamp_t now;
+	snd_pcm_uframes_t elapsed, limit, resync;
+	long long nsec;
+
+	if (!(io->data->flags & SND_PCM_IOPLUG_FLAG_PTR_EXTRAPOLATE) ||
+	    io->data->state != SND_PCM_STATE_RUNNING || !io->synced ||
+	    !pcm->rate)
+		goto resync;
+
+	gettimestamp(&now, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+	nsec = (long long)(now.tv_sec - io->sync_tstamp.tv_sec) * 1000000000LL +
+		(now.tv_nsec - io->sync_tstamp.tv_nsec);
+	if (nsec < 0)
+		goto resync;
+	elapsed = (snd_pcm_uframes_t)(nsec * pcm->rate / 1000000000LL);
+	resync = io->resync ? io->resync : pcm->period_size;
+	if (elapsed >= resync)
+		goto resync;
+	if (elapsed <= io->ext_frames)
+		return;
+	elapsed -= io->ext_frames;
+	limit = snd_pcm_mmap_hw_rewindable(pcm);
+	/* possible underrun/overrun: let the plugin tell the truth */
+	if (elapsed >= limit)
+		goto resync;
+	snd_pcm_mmap_hw_forward(pcm, elapsed);
+	io->ext_frames += elapsed;
+	return;
+
+ resync:
+	snd_pcm_ioplug_hw_ptr_update(pcm);
+}
+
 static int snd_pcm_ioplug_info(snd_pcm_t *pcm, snd_pcm_info_t *info)
 {
 	memset(info, 0, sizeof(*info));
@@ -149,7 +222,7 @@ static snd_pcm_state_t snd_pcm_ioplug_state(snd_pcm_t *pcm)
 
 static int snd_pcm_ioplug_hwsync(snd_pcm_t *pcm)
 {
-	snd_pcm_ioplug_hw_ptr_update(pcm);
+	snd_pcm_ioplug_hw_ptr_update_cached(pcm);
 	return 0;
 }
 
@@ -161,6 +234,7 @@ static int snd_pcm_ioplug_reset(snd_pcm_t *pcm)
 	io->data->hw_ptr = 0;
 	io->last_hw = 0;
 	io->avail_max = 0;
+	snd_pcm_ioplug_ptr_clear(io);
 	return 0;
 }
 
@@ -492,6 +566,7 @@ static int snd_pcm_ioplug_start(snd_pcm_t *pcm)
 
 	gettimestamp(&io->trigger_tstamp, pcm->tstamp_type);
 	io->data->state = SND_PCM_STATE_RUNNING;
+	snd_pcm_ioplug_ptr_clear(io);
 
 	return 0;
 }
@@ -507,6 +582,7 @@ static int snd_pcm_ioplug_drop(snd_pcm_t *pcm)
 
 	gettimestamp(&io->trigger_tstamp, pcm->tstamp_type);
 	io->data->state = SND_PCM_STATE_SETUP;
+	snd_pcm_ioplug_ptr_unsync(io);
 
 	return 0;
 }
@@ -522,6 +598,23 @@ static int ioplug_drain_via_poll(snd_pcm_t *pcm)
 		/* in non-blocking mode, let application to poll() by itself */
 		if (io->data->nonblock)
 			return -EAGAIN;
+		if (io->data->flags & SND_PCM_IOPLUG_FLAG_PTR_EXTRAPOLATE) {
+			/* sleep until the queued data (at most a period)
+			 * is played instead of spinning on poll()
+			 */
+			snd_pcm_uframes_t frames;
+
+			frames = snd_pcm_mmap_hw_rewindable(pcm);
+			if (frames > pcm->period_size)
+				frames = pcm->period_size;
+			if (!frames)
+				frames = 1;
+			snd_pcm_unlock(pcm);
+			usleep((useconds_t)((unsigned long long)frames *
+					    1000000ULL / pcm->rate) + 1);
+			snd_pcm_lock(pcm);
+			continue;
+		}
 		if (snd_pcm_wait_nocheck(pcm, -1) < 0)
 			break;
 	}
@@ -594,6 +687,7 @@ static int snd_pcm_ioplug_pause(snd_pcm_t *pcm, int enable)
 			return err;
 	}
 	io->data->state = states[enable];
+	snd_pcm_ioplug_ptr_unsync(io);
 	return 0;
 }
 
@@ -626,24 +720,81 @@ static int snd_pcm_ioplug_resume(snd_pcm_t *pcm)
 
 	if (io->data->callback->resume)
 		io->data->callback->resume(io->data);
+	snd_pcm_ioplug_ptr_unsync(io);
 	return 0;
 }
 
+/* describe the areas as byte vectors: one for interleaved data,
+ * one per channel for non-interleaved data; 0 if not representable
+ */
+static int ioplug_areas_to_iov(snd_pcm_t *pcm,
+			       const snd_pcm_channel_area_t *areas,
+			       snd_pcm_uframes_t offset,
+			       snd_pcm_uframes_t size,
+			       struct iovec *iov)
+{
+	unsigned int c;
+
+	if (pcm->sample_bits % 8 || areas[0].first % 8)
+		return 0;
+	if (areas[0].step == pcm->frame_bits) {
+		for (c = 0; c < pcm->channels; c++) {
+			if (areas[c].addr != areas[0].addr ||
+			    areas[c].step != pcm->frame_bits ||
+			    areas[c].first != areas[0].first + c * pcm->sample_bits)
+				goto noninterleaved;
+		}
+		iov[0].iov_base = (char *)areas[0].addr + areas[0].first / 8 +
+			offset * (pcm->frame_bits / 8);
+		iov[0].iov_len = size * (pcm->frame_bits / 8);
+		return 1;
+	}
+ noninterleaved:
+	for (c = 0; c < pcm->channels; c++) {
+		if (areas[c].step != pcm->sample_bits || areas[c].first % 8)
+			return 0;
+		iov[c].iov_base = (char *)areas[c].addr + areas[c].first / 8 +
+			offset * (pcm->sample_bits / 8);
+		iov[c].iov_len = size * (pcm->sample_bits / 8);
+	}
+	return pcm->channels;
+}
+
+/* call transfer_iov or transfer callback */
+/* called in lock */
+static snd_pcm_sframes_t ioplug_call_transfer(snd_pcm_t *pcm,
+					      const snd_pcm_channel_area_t *areas,
+					      snd_pcm_uframes_t offset,
+					      snd_pcm_uframes_t size)
+{
+	ioplug_priv_t *io = pcm->private_data;
+
+	if (io->data->version >= 0x010003 &&
+	    io->data->callback->transfer_iov) {
+		struct iovec iov[pcm->channels];
+		int iovcnt;
+
+		iovcnt = ioplug_areas_to_iov(pcm, areas, offset, size, iov);
+		if (iovcnt > 0)
+			return io->data->callback->transfer_iov(io->data, iov,
+								iovcnt, size);
+	}
+	if (io->data->callback->transfer)
+		return io->data->callback->transfer(io->data, areas, offset, size);
+	return size;
+}
+
 /* called in lock */
 static snd_pcm_sframes_t ioplug_priv_transfer_areas(snd_pcm_t *pcm,
 						       const snd_pcm_channel_area_t *areas,
 						       snd_pcm_uframes_t offset,
 						       snd_pcm_uframes_t size)
 {
-	ioplug_priv_t *io = pcm->private_data;
 	snd_pcm_sframes_t result;
 		
 	if (! size)
 		return 0;
-	if (io->data->callback->transfer)
-		result = io->data->callback->transfer(io->data, areas, offset, size);
-	else
-		result = size;
+	result = ioplug_call_transfer(pcm, areas, offset, size);
 	if (result > 0)
 		snd_pcm_mmap_appl_forward(pcm, result);
 	return result;
@@ -709,11 +860,13 @@ static int snd_pcm_ioplug_mmap_begin_capture(snd_pcm_t *pcm,
 	if (err < 0)
 		return err;
 
-	if (io->data->callback->transfer &&
+	if ((io->data->callback->transfer ||
+	     (io->data->version >= 0x010003 &&
+	      io->data->callback->transfer_iov)) &&
 	    pcm->access != SND_PCM_ACCESS_RW_INTERLEAVED &&
 	    pcm->access != SND_PCM_ACCESS_RW_NONINTERLEAVED) {
 		snd_pcm_sframes_t result;
-		result = io->data->callback->transfer(io->data, *areas, *offset, *frames);
+		result = ioplug_call_transfer(pcm, *areas, *offset, *frames);
 		if (result < 0)
 			return result;
 	}
@@ -754,7 +907,7 @@ static snd_pcm_sframes_t snd_pcm_ioplug_avail_update(snd_pcm_t *pcm)
 	ioplug_priv_t *io = pcm->private_data;
 	snd_pcm_uframes_t avail;
 
-	snd_pcm_ioplug_hw_ptr_update(pcm);
+	snd_pcm_ioplug_hw_ptr_update_cached(pcm);
 	if (io->data->state == SND_PCM_STATE_XRUN)
 		return -EPIPE;
 
@@ -1021,6 +1174,14 @@ The transfer callback is called when any data transfer happens.  It
 receives the area array, offset and the size to transfer.  The area
 array contains the array of snd_pcm_channel_area_t with the elements
 of number of channels.
+For RW access without mmap_rw, the area array describes the
+application buffer itself, so the data can be sent or received without
+an intermediate copy.  Alternatively, the transfer_iov callback (since
+protocol 1.0.3) receives the same data as struct iovec vectors, one for
+interleaved and one per channel for non-interleaved layouts, which can
+be handed directly to writev(), sendmsg() or vmsplice().  When set, it
+is used instead of transfer whenever the areas are byte-addressable;
+complex layouts still go through transfer.
 
 When the PCM is closed, close callback is called.  If the driver
 allocates any internal buffers, they should be released in this
@@ -1040,6 +1201,21 @@ callback.
 
 Finally, the dump callback is used to print the status of the plugin.
 
+The pointer callback is usually called at each #snd_pcm_avail_update()
+call, which is expensive when the position has to be queried from a
+remote or out-of-process backend.  When #SND_PCM_IOPLUG_FLAG_PTR_EXTRAPOLATE
+is set in flags, the running stream advances the hw pointer from the
+monotonic time elapsed since the last pointer callback at the nominal
+rate, and calls the pointer callback again once per period (or after
+the interval given via #snd_pcm_ioplug_set_pointer_resync()), or when
+the estimate would reach the end of the queued data.  The frames
+estimated ahead are deducted when the real position arrives, so the hw
+pointer never moves backwards.  The same applies to #snd_pcm_hwsync(),
+which is issued by each read/write call, while #snd_pcm_status() and
+#snd_pcm_delay() always call the pointer callback.  With this flag,
+the generic drain (without drain callback) sleeps for the remaining
+queued time instead of waiting on the poll descriptors.
+
 Note that some callbacks (start, stop, pointer, transfer and pause)
 may be called inside the internal pthread mutex, and they shouldn't
 call the PCM functions again unnecessarily from the callback itself;
@@ -1205,6 +1381,7 @@ int snd_pcm_ioplug_reinit_status(snd_pcm_ioplug_t *ioplug)
 {
 	ioplug->pcm->poll_fd = ioplug->poll_fd;
 	ioplug->pcm->poll_events = ioplug->poll_events;
+	snd_pcm_wait_invalidate(ioplug->pcm);
 	if (ioplug->flags & SND_PCM_IOPLUG_FLAG_MONOTONIC)
 		ioplug->pcm->tstamp_type = SND_PCM_TSTAMP_TYPE_MONOTONIC;
 	else
@@ -1241,6 +1418,29 @@ const snd_pcm_channel_area_t *snd_pcm_ioplug_mmap_areas(snd_pcm_ioplug_t *ioplug
 int snd_pcm_ioplug_set_state(snd_pcm_ioplug_t *ioplug, snd_pcm_state_t state)
 {
 	ioplug->state = state;
+	snd_pcm_ioplug_ptr_unsync(ioplug->pcm->private_data);
+	return 0;
+}
+
+/**
+ * \brief Set the hw pointer resync interval for pointer extrapolation
+ * \param ioplug the ioplug handle
+ * \param frames the max. number of frames between two pointer callbacks,
+ * or 0 for one period
+ * \return zero if successful or a negative error code
+ *
+ * Only effective when #SND_PCM_IOPLUG_FLAG_PTR_EXTRAPOLATE is set.
+ * While the stream is running, #snd_pcm_avail_update() estimates the
+ * hw pointer from the time elapsed since the last pointer callback and
+ * calls the pointer callback again only after the given number of frames.
+ */
+int snd_pcm_ioplug_set_pointer_resync(snd_pcm_ioplug_t *ioplug,
+				      snd_pcm_uframes_t frames)
+{
+	ioplug_priv_t *io = ioplug->pcm->private_data;
+
+	io->resync = frames;
+	snd_pcm_ioplug_ptr_unsync(io);
 	return 0;
 }
 
@@ -34,8 +34,10 @@
   
 #include "config.h"
 #include <dirent.h>
+#include <limits.h>
 #include <locale.h>
 #include <math.h>
+#include <sys/stat.h>
 #include "pcm_local.h"
 #include "pcm_plugin.h"
 
@@ -50,6 +52,9 @@ const char *_snd_module_pcm_ladspa = "";
 
 #define NO_ASSIGN	0xffffffff
 
+#define SND_PCM_LADSPA_MAX_THREADS	32
+#define SND_PCM_LADSPA_SPIN		4096	/* barrier spins before sleeping */
+
 typedef enum _snd_pcm_ladspa_policy {
 	SND_PCM_LADSPA_POLICY_NONE,		/* use bindings only */
 	SND_PCM_LADSPA_POLICY_DUPLICATE		/* duplicate bindings for all channels */
@@ -64,6 +69,10 @@ typedef struct {
 	unsigned int channels;			/* forced input channels, 0 = auto */
 	unsigned int allocated;			/* count of allocated samples */
 	LADSPA_Data *zero[2];			/* zero input or dummy output */
+	LADSPA_Data **buffers;			/* intermediate buffers of the chain */
+	unsigned int buffers_count;
+	unsigned int threads;			/* worker threads for duplicated instances */
+	struct snd_pcm_ladspa_pool *pool;
 } snd_pcm_ladspa_t;
  
 typedef struct {
@@ -74,7 +83,6 @@ typedef struct {
 typedef struct {
         snd_pcm_ladspa_array_t channels;
         snd_pcm_ladspa_array_t ports;
-	LADSPA_Data **m_data;
         LADSPA_Data **data;
 } snd_pcm_ladspa_eps_t;
 
@@ -107,10 +115,172 @@ typedef struct {
 	snd_pcm_ladspa_plugin_io_t input;
 	snd_pcm_ladspa_plugin_io_t output;
 	struct list_head instances;		/* one LADSPA plugin might be used multiple times */
+	snd_pcm_ladspa_instance_t **run;	/* instances run by the pool */
+	unsigned int run_count;
 } snd_pcm_ladspa_plugin_t;
 
+#ifdef THREAD_SAFE_API
+/*
+ * The instances of a duplicated plugin work on separate channels, so
+ * they can be run concurrently.  The caller and the workers claim the
+ * instances through a counter tagged with the job generation, thus a
+ * worker waking up late cannot claim an instance of a newer job.
+ */
+typedef struct snd_pcm_ladspa_pool {
+	pthread_mutex_t mutex;
+	pthread_cond_t start;
+	pthread_cond_t done;
+	unsigned int nthreads;
+	pthread_t *threads;
+	int quit;
+	unsigned int generation;		/* current job */
+	snd_pcm_ladspa_instance_t **instances;
+	unsigned int count;
+	unsigned long frames;
+	unsigned long long next;		/* generation << 32 | next instance */
+	unsigned int pending;			/* instances still running */
+} snd_pcm_ladspa_pool_t;
+#endif
+
 #endif /* DOC_HIDDEN */
 
+#ifdef THREAD_SAFE_API
+static void snd_pcm_ladspa_pool_work(snd_pcm_ladspa_pool_t *pool, unsigned int generation,
+				     snd_pcm_ladspa_instance_t **instances,
+				     unsigned int count, unsigned long frames)
+{
+	unsigned long long tag = (unsigned long long)generation << 32;
+	unsigned long long v;
+	snd_pcm_ladspa_instance_t *instance;
+
+	v = __atomic_load_n(&pool->next, __ATOMIC_ACQUIRE);
+	while ((v & ~0xffffffffULL) == tag && (v & 0xffffffffULL) < count) {
+		if (!__atomic_compare_exchange_n(&pool->next, &v, v + 1, 0,
+						 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			continue;
+		instance = instances[v & 0xffffffffULL];
+		instance->desc->run(instance->handle, frames);
+		if (__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+			pthread_mutex_lock(&pool->mutex);
+			pthread_cond_signal(&pool->done);
+			pthread_mutex_unlock(&pool->mutex);
+		}
+		v = __atomic_load_n(&pool->next, __ATOMIC_ACQUIRE);
+	}
+}
+
+static void *snd_pcm_ladspa_pool_thread(void *arg)
+{
+	snd_pcm_ladspa_pool_t *pool = arg;
+	snd_pcm_ladspa_instance_t **instances;
+	unsigned int generation, count;
+	unsigned long frames;
+
+	pthread_mutex_lock(&pool->mutex);
+	generation = pool->generation;
+	for (;;) {
+		while (!pool->quit && pool->generation == generation)
+			pthread_cond_wait(&pool->start, &pool->mutex);
+		if (pool->quit)
+			break;
+		generation = pool->generation;
+		instances = pool->instances;
+		count = pool->count;
+		frames = pool->frames;
+		pthread_mutex_unlock(&pool->mutex);
+		snd_pcm_ladspa_pool_work(pool, generation, instances, count, frames);
+		pthread_mutex_lock(&pool->mutex);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+static void snd_pcm_ladspa_pool_free(snd_pcm_ladspa_t *ladspa)
+{
+	snd_pcm_ladspa_pool_t *pool = ladspa->pool;
+	unsigned int idx;
+
+	if (!pool)
+		return;
+	pthread_mutex_lock(&pool->mutex);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->mutex);
+	for (idx = 0; idx < pool->nthreads; idx++)
+		pthread_join(pool->threads[idx], NULL);
+	pthread_cond_destroy(&pool->start);
+	pthread_cond_destroy(&pool->done);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool->threads);
+	free(pool);
+	ladspa->pool = NULL;
+}
+
+/* the workers inherit the scheduling policy of the thread calling hw_params */
+static int snd_pcm_ladspa_pool_new(snd_pcm_ladspa_t *ladspa)
+{
+	snd_pcm_ladspa_pool_t *pool;
+	int err;
+
+	pool = calloc(1, sizeof(*pool));
+	if (pool == NULL)
+		return -ENOMEM;
+	pool->threads = calloc(ladspa->threads, sizeof(pthread_t));
+	if (pool->threads == NULL) {
+		free(pool);
+		return -ENOMEM;
+	}
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	ladspa->pool = pool;
+	while (pool->nthreads < ladspa->threads) {
+		err = snd_thread_create(&pool->threads[pool->nthreads], "pcm_ladspa",
+					snd_pcm_ladspa_pool_thread, pool);
+		if (err) {
+			SNDERR("Unable to create LADSPA worker thread");
+			snd_pcm_ladspa_pool_free(ladspa);
+			return -err;
+		}
+		pool->nthreads++;
+	}
+	return 0;
+}
+
+/*
+ * Runs all instances and waits for them.  The caller takes its share of
+ * the work, then spins a bounded time for the workers before sleeping.
+ */
+static void snd_pcm_ladspa_pool_run(snd_pcm_ladspa_pool_t *pool,
+				    snd_pcm_ladspa_instance_t **instances,
+				    unsigned int count, unsigned long frames)
+{
+	unsigned int generation, spin;
+
+	pthread_mutex_lock(&pool->mutex);
+	generation = ++pool->generation;
+	pool->instances = instances;
+	pool->count = count;
+	pool->frames = frames;
+	__atomic_store_n(&pool->pending, count, __ATOMIC_RELAXED);
+	__atomic_store_n(&pool->next, (unsigned long long)generation << 32, __ATOMIC_RELEASE);
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->mutex);
+	snd_pcm_ladspa_pool_work(pool, generation, instances, count, frames);
+	for (spin = 0; spin < SND_PCM_LADSPA_SPIN; spin++) {
+		if (__atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE) == 0)
+			return;
+	}
+	pthread_mutex_lock(&pool->mutex);
+	while (__atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE))
+		pthread_cond_wait(&pool->done, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+}
+#else
+#define snd_pcm_ladspa_pool_free(ladspa)	do { } while (0)
+#define snd_pcm_ladspa_pool_run(pool, instances, count, frames) do { } while (0)
+#endif
+
 static unsigned int snd_pcm_ladspa_count_ports(snd_pcm_ladspa_plugin_t *lplug,
                                                LADSPA_PortDescriptor pdesc)
 {
@@ -197,10 +367,11 @@ static void snd_pcm_ladspa_free(snd_pcm_ladspa_t *ladspa)
 {
         unsigned int idx;
 
+	snd_pcm_ladspa_pool_free(ladspa);
 	snd_pcm_ladspa_free_plugins(&ladspa->pplugins);
 	snd_pcm_ladspa_free_plugins(&ladspa->cplugins);
 	for (idx = 0; idx < 2; idx++) {
-		free(ladspa->zero[idx]);
+		snd_pcm_mem_free(ladspa->zero[idx]);
                 ladspa->zero[idx] = NULL;
         }
         ladspa->allocated = 0;
@@ -332,16 +503,6 @@ static void snd_pcm_ladspa_free_instances(snd_pcm_t *pcm, snd_pcm_ladspa_t *lads
 			if (cleanup) {
 				if (plugin->desc->cleanup)
 					plugin->desc->cleanup(instance->handle);
-				if (instance->input.m_data) {
-				        for (idx = 0; idx < instance->input.channels.size; idx++)
-						free(instance->input.m_data[idx]);
-					free(instance->input.m_data);
-                                }
-				if (instance->output.m_data) {
-				        for (idx = 0; idx < instance->output.channels.size; idx++)
-						free(instance->output.m_data[idx]);
-					free(instance->output.m_data);
-                                }
                                 free(instance->input.data);
                                 free(instance->output.data);
 				list_del(&(instance->list));
@@ -355,8 +516,18 @@ static void snd_pcm_ladspa_free_instances(snd_pcm_t *pcm, snd_pcm_ladspa_t *lads
 		}
 		if (cleanup) {
 			assert(list_empty(&plugin->instances));
+			free(plugin->run);
+			plugin->run = NULL;
+			plugin->run_count = 0;
 		}
 	}
+	if (cleanup) {
+		for (idx = 0; idx < ladspa->buffers_count; idx++)
+			snd_pcm_mem_free(ladspa->buffers[idx]);
+		free(ladspa->buffers);
+		ladspa->buffers = NULL;
+		ladspa->buffers_count = 0;
+	}
 }
 
 static int snd_pcm_ladspa_add_to_carray(snd_pcm_ladspa_array_t *array,
@@ -677,21 +848,56 @@ static int snd_pcm_ladspa_allocate_instances(snd_pcm_t *pcm, snd_pcm_ladspa_t *l
 	return 0;
 }
 
-static LADSPA_Data *snd_pcm_ladspa_allocate_zero(snd_pcm_ladspa_t *ladspa, unsigned int idx)
+static LADSPA_Data *snd_pcm_ladspa_allocate_zero(snd_pcm_t *pcm, snd_pcm_ladspa_t *ladspa, unsigned int idx)
 {
         if (ladspa->zero[idx] == NULL)
-                ladspa->zero[idx] = calloc(ladspa->allocated, sizeof(LADSPA_Data));
+                ladspa->zero[idx] = snd_pcm_mem_alloc(pcm, ladspa->allocated * sizeof(LADSPA_Data));
         return ladspa->zero[idx];
 }
 
+static LADSPA_Data *snd_pcm_ladspa_allocate_buffer(snd_pcm_t *pcm, snd_pcm_ladspa_t *ladspa)
+{
+	LADSPA_Data **nbuffers, *buf;
+
+	nbuffers = realloc(ladspa->buffers, (ladspa->buffers_count + 1) * sizeof(*nbuffers));
+	if (nbuffers == NULL)
+		return NULL;
+	ladspa->buffers = nbuffers;
+	buf = snd_pcm_mem_alloc(pcm, ladspa->allocated * sizeof(LADSPA_Data));
+	if (buf)
+		ladspa->buffers[ladspa->buffers_count++] = buf;
+	return buf;
+}
+
+static int snd_pcm_ladspa_eps_has_channel(snd_pcm_ladspa_eps_t *eps, unsigned int chn)
+{
+	unsigned int idx;
+
+	for (idx = 0; idx < eps->channels.size; idx++)
+		if (eps->channels.array[idx] == chn)
+			return 1;
+	return 0;
+}
+
+/*
+ * The intermediate buffers are assigned by a liveness scan over the chain.
+ * Each channel has one current buffer; a plugin writing the channel
+ * replaces it, and the replaced buffer is dead once the plugin has run,
+ * so the next plugins can take it over.  A plugin without
+ * LADSPA_PROPERTY_INPLACE_BROKEN writes the channel into the very buffer
+ * it reads it from.  The last write of a channel not read afterwards goes
+ * straight to the ALSA area.  Thus a chain of in-place plugins needs one
+ * buffer per channel and any other chain at most two.
+ */
 static int snd_pcm_ladspa_allocate_memory(snd_pcm_t *pcm, snd_pcm_ladspa_t *ladspa)
 {
 	struct list_head *list, *pos, *pos1;
 	snd_pcm_ladspa_instance_t *instance;
-	unsigned int channels = 16, nchannels;
-	unsigned int ichannels, ochannels;
-	void **pchannels, **npchannels;
-	unsigned int idx, chn;
+	unsigned int channels = 0, ichannels, ochannels;
+	LADSPA_Data **cur = NULL, **next = NULL, **freed = NULL;
+	int *last_write = NULL, *last_read = NULL;
+	unsigned int nfreed = 0, idx, chn;
+	int depth, inplace, err = -ENOMEM;
 	
         ladspa->allocated = 2048;
         if (pcm->buffer_size > ladspa->allocated)
@@ -703,106 +909,118 @@ static int snd_pcm_ladspa_allocate_memory(snd_pcm_t *pcm, snd_pcm_ladspa_t *lads
                 ichannels = ladspa->plug.gen.slave->channels;
                 ochannels = pcm->channels;
         }
-	pchannels = calloc(1, sizeof(void *) * channels);
-	if (pchannels == NULL)
-	        return -ENOMEM;
 	list = pcm->stream == SND_PCM_STREAM_PLAYBACK ? &ladspa->pplugins : &ladspa->cplugins;
 	list_for_each(pos, list) {
 		snd_pcm_ladspa_plugin_t *plugin = list_entry(pos, snd_pcm_ladspa_plugin_t, list);
 		list_for_each(pos1, &plugin->instances) {
 			instance = list_entry(pos1, snd_pcm_ladspa_instance_t, list);
-			nchannels = channels;
 			for (idx = 0; idx < instance->input.channels.size; idx++) {
 			        chn = instance->input.channels.array[idx];
 			        assert(instance->input.ports.array[idx] != NO_ASSIGN);
-        			if (chn >= nchannels)
-        			        nchannels = chn + 1;
+        			if (chn >= channels)
+        			        channels = chn + 1;
                         }
 			for (idx = 0; idx < instance->output.channels.size; idx++) {
 			        chn = instance->output.channels.array[idx];
 			        assert(instance->output.ports.array[idx] != NO_ASSIGN);
-        			if (chn >= nchannels)
-        			        nchannels = chn + 1;
-                        }
-                        if (nchannels != channels) {
-                                npchannels = realloc(pchannels, nchannels * sizeof(void *));
-                                if (npchannels == NULL) {
-                                        free(pchannels);
-                                        return -ENOMEM;
-                                }
-                                for (idx = channels; idx < nchannels; idx++)
-                                        npchannels[idx] = NULL;
-                                pchannels = npchannels;
+        			if (chn >= channels)
+        			        channels = chn + 1;
                         }
                         assert(instance->input.data == NULL);
-                        assert(instance->input.m_data == NULL);
                         assert(instance->output.data == NULL);
-                        assert(instance->output.m_data == NULL);
                         instance->input.data = calloc(instance->input.channels.size, sizeof(void *));
-                        instance->input.m_data = calloc(instance->input.channels.size, sizeof(void *));
                         instance->output.data = calloc(instance->output.channels.size, sizeof(void *));
-                        instance->output.m_data = calloc(instance->output.channels.size, sizeof(void *));
                         if (instance->input.data == NULL ||
-                            instance->input.m_data == NULL ||
-                            instance->output.data == NULL ||
-                            instance->output.m_data == NULL) {
-                                free(pchannels);
+                            instance->output.data == NULL)
                                 return -ENOMEM;
-                        }
+		}
+	}
+	if (channels == 0)
+		return 0;
+	cur = calloc(channels, sizeof(*cur));
+	next = calloc(channels, sizeof(*next));
+	freed = calloc(2 * channels, sizeof(*freed));	/* live + replaced */
+	last_write = malloc(channels * sizeof(*last_write));
+	last_read = malloc(channels * sizeof(*last_read));
+	if (!cur || !next || !freed || !last_write || !last_read)
+		goto _end;
+	for (chn = 0; chn < channels; chn++)
+		last_write[chn] = last_read[chn] = -1;
+	/* liveness: the last plugin writing and reading each channel */
+	depth = 0;
+	list_for_each(pos, list) {
+		snd_pcm_ladspa_plugin_t *plugin = list_entry(pos, snd_pcm_ladspa_plugin_t, list);
+		list_for_each(pos1, &plugin->instances) {
+			instance = list_entry(pos1, snd_pcm_ladspa_instance_t, list);
+			for (idx = 0; idx < instance->input.channels.size; idx++)
+				last_read[instance->input.channels.array[idx]] = depth;
+			for (idx = 0; idx < instance->output.channels.size; idx++)
+				last_write[instance->output.channels.array[idx]] = depth;
+		}
+		depth++;
+	}
+	depth = 0;
+	list_for_each(pos, list) {
+		snd_pcm_ladspa_plugin_t *plugin = list_entry(pos, snd_pcm_ladspa_plugin_t, list);
+		inplace = !LADSPA_IS_INPLACE_BROKEN(plugin->desc->Properties);
+		list_for_each(pos1, &plugin->instances) {
+			instance = list_entry(pos1, snd_pcm_ladspa_instance_t, list);
 			for (idx = 0; idx < instance->input.channels.size; idx++) {
 			        chn = instance->input.channels.array[idx];
-			        if (pchannels[chn] == NULL && chn < ichannels) {
+			        if (cur[chn] == NULL && chn < ichannels) {
 			                instance->input.data[idx] = NULL;
 			                continue;
                                 }
-			        instance->input.data[idx] = pchannels[chn];
+			        instance->input.data[idx] = cur[chn];
 			        if (instance->input.data[idx] == NULL) {
-                                        instance->input.data[idx] = snd_pcm_ladspa_allocate_zero(ladspa, 0);
-                                        if (instance->input.data[idx] == NULL) {
-                                                free(pchannels);
-                                                return -ENOMEM;
-                                        }
+                                        instance->input.data[idx] = snd_pcm_ladspa_allocate_zero(pcm, ladspa, 0);
+                                        if (instance->input.data[idx] == NULL)
+                                                goto _end;
                                 }
                         }
+		}
+		/* the inputs are bound, now place the outputs of this plugin */
+		list_for_each(pos1, &plugin->instances) {
+			instance = list_entry(pos1, snd_pcm_ladspa_instance_t, list);
                         for (idx = 0; idx < instance->output.channels.size; idx++) {
+			        LADSPA_Data *data;
+
 			        chn = instance->output.channels.array[idx];
-                                /* FIXME/OPTIMIZE: check if we can remove double alloc */
-                                /* if LADSPA plugin has no broken inplace */
-                                instance->output.data[idx] = malloc(sizeof(LADSPA_Data) * ladspa->allocated);
-                                if (instance->output.data[idx] == NULL) {
-                                        free(pchannels);
-                                        return -ENOMEM;
-                                }
-                                pchannels[chn] = instance->output.m_data[idx] = instance->output.data[idx];
+			        if (last_write[chn] == depth && last_read[chn] <= depth) {
+			                if (chn < ochannels) {
+			                        data = NULL;
+			                } else {
+			                        data = snd_pcm_ladspa_allocate_zero(pcm, ladspa, 1);
+			                        if (data == NULL)
+			                                goto _end;
+			                }
+			        } else if (inplace && cur[chn] && cur[chn] != ladspa->zero[0] &&
+			                   snd_pcm_ladspa_eps_has_channel(&instance->input, chn)) {
+			                data = cur[chn];
+			        } else if (nfreed > 0) {
+			                data = freed[--nfreed];
+			        } else {
+			                data = snd_pcm_ladspa_allocate_buffer(pcm, ladspa);
+			                if (data == NULL)
+			                        goto _end;
+			        }
+			        instance->output.data[idx] = data;
+			        next[chn] = data;
                         }
 		}
-	}
-	/* OPTIMIZE: we have already allocated areas for ALSA output channels */
-	/* next loop deallocates the last output LADSPA areas and connects */
-	/* them to ALSA areas (NULL) or dummy area ladpsa->free[1] ; */
-	/* this algorithm might be optimized to not allocate the last LADSPA outputs */
-	list_for_each(pos, list) {
-		snd_pcm_ladspa_plugin_t *plugin = list_entry(pos, snd_pcm_ladspa_plugin_t, list);
+		/* buffers replaced by this plugin are free for the next ones */
 		list_for_each(pos1, &plugin->instances) {
 			instance = list_entry(pos1, snd_pcm_ladspa_instance_t, list);
                         for (idx = 0; idx < instance->output.channels.size; idx++) {
-        			chn = instance->output.channels.array[idx];
-                                if (instance->output.data[idx] == pchannels[chn]) {
-					free(instance->output.m_data[idx]);
-					instance->output.m_data[idx] = NULL;
-                                        if (chn < ochannels) {
-                                                instance->output.data[idx] = NULL;
-                                        } else {
-                                                instance->output.data[idx] = snd_pcm_ladspa_allocate_zero(ladspa, 1);
-                                                if (instance->output.data[idx] == NULL) {
-                                                        free(pchannels);
-                                                        return -ENOMEM;
-                                                }
-                                        }
-                                }
+			        chn = instance->output.channels.array[idx];
+			        if (cur[chn] && cur[chn] != next[chn] &&
+			            cur[chn] != ladspa->zero[0] && cur[chn] != ladspa->zero[1])
+			                freed[nfreed++] = cur[chn];
+			        cur[chn] = next[chn];
                         }
-                }
-        }
+		}
+		depth++;
+	}
 #if 0
         printf("zero[0] = %p\n", ladspa->zero[0]);
         printf("zero[1] = %p\n", ladspa->zero[1]);
@@ -811,13 +1029,53 @@ static int snd_pcm_ladspa_allocate_memory(snd_pcm_t *pcm, snd_pcm_ladspa_t *lads
 		list_for_each(pos1, &plugin->instances) {
 			instance = list_entry(pos1, snd_pcm_ladspa_instance_t, list);
                         for (idx = 0; idx < instance->input.channels.size; idx++)
-                                printf("%i:alloc-input%i:  data = %p, m_data = %p\n", instance->depth, idx, instance->input.data[idx], instance->input.m_data[idx]);
+                                printf("%i:alloc-input%i:  data = %p\n", instance->depth, idx, instance->input.data[idx]);
                         for (idx = 0; idx < instance->output.channels.size; idx++)
-                                printf("%i:alloc-output%i:  data = %p, m_data = %p\n", instance->depth, idx, instance->output.data[idx], instance->output.m_data[idx]);
+                                printf("%i:alloc-output%i:  data = %p\n", instance->depth, idx, instance->output.data[idx]);
 		}
 	}
+        printf("buffers = %u\n", ladspa->buffers_count);
+#endif
+	err = 0;
+ _end:
+	free(cur);
+	free(next);
+	free(freed);
+	free(last_write);
+	free(last_read);
+	return err;
+}
+
+/* collects the instances of the duplicated plugins for the worker pool */
+static int snd_pcm_ladspa_allocate_pool(snd_pcm_t *pcm, snd_pcm_ladspa_t *ladspa)
+{
+#ifdef THREAD_SAFE_API
+	struct list_head *list, *pos, *pos1;
+	int parallel = 0;
+
+	if (ladspa->threads == 0)
+		return 0;
+	list = pcm->stream == SND_PCM_STREAM_PLAYBACK ? &ladspa->pplugins : &ladspa->cplugins;
+	list_for_each(pos, list) {
+		snd_pcm_ladspa_plugin_t *plugin = list_entry(pos, snd_pcm_ladspa_plugin_t, list);
+		unsigned int count = 0;
+
+		if (plugin->policy != SND_PCM_LADSPA_POLICY_DUPLICATE)
+			continue;
+		list_for_each(pos1, &plugin->instances)
+			count++;
+		if (count < 2)
+			continue;
+		plugin->run = calloc(count, sizeof(*plugin->run));
+		if (plugin->run == NULL)
+			return -ENOMEM;
+		list_for_each(pos1, &plugin->instances)
+			plugin->run[plugin->run_count++] = list_entry(pos1, snd_pcm_ladspa_instance_t, list);
+		parallel = 1;
+	}
+	if (parallel && ladspa->pool == NULL)
+		return snd_pcm_ladspa_pool_new(ladspa);
 #endif
-	free(pchannels);
 	return 0;
 }
 
@@ -837,6 +1095,11 @@ static int snd_pcm_ladspa_init(snd_pcm_t *pcm)
 		snd_pcm_ladspa_free_instances(pcm, ladspa, 1);
 		return err;
 	}
+	err = snd_pcm_ladspa_allocate_pool(pcm, ladspa);
+	if (err < 0) {
+		snd_pcm_ladspa_free_instances(pcm, ladspa, 1);
+		return err;
+	}
 	return 0;
 }
 
@@ -844,6 +1107,7 @@ static int snd_pcm_ladspa_hw_free(snd_pcm_t *pcm)
 {
 	snd_pcm_ladspa_t *ladspa = pcm->private_data;
 
+	snd_pcm_ladspa_pool_free(ladspa);
 	snd_pcm_ladspa_free_instances(pcm, ladspa, 1);
 	return snd_pcm_generic_hw_free(pcm);
 }
@@ -897,8 +1161,12 @@ snd_pcm_ladspa_write_areas(snd_pcm_t *pcm,
                                         }
 					instance->desc->connect_port(instance->handle, instance->output.ports.array[idx], data);
         			}
-        			instance->desc->run(instance->handle, size1);
+        			if (plugin->run == NULL)
+        				instance->desc->run(instance->handle, size1);
         		}
+        		if (plugin->run)
+        			snd_pcm_ladspa_pool_run(ladspa->pool, plugin->run,
+        						plugin->run_count, size1);
         	}
         	offset += size1;
         	slave_offset += size1;
@@ -958,8 +1226,12 @@ snd_pcm_ladspa_read_areas(snd_pcm_t *pcm,
                                         }
         		        	instance->desc->connect_port(instance->handle, instance->output.ports.array[idx], data);
         			}
-        			instance->desc->run(instance->handle, size1);
+        			if (plugin->run == NULL)
+        				instance->desc->run(instance->handle, size1);
         		}
+        		if (plugin->run)
+        			snd_pcm_ladspa_pool_run(ladspa->pool, plugin->run,
+        						plugin->run_count, size1);
         	}
         	offset += size1;
         	slave_offset += size1;
@@ -1054,6 +1326,8 @@ static void snd_pcm_ladspa_dump(snd_pcm_t *pcm, snd_output_t *out)
 	snd_pcm_ladspa_t *ladspa = pcm->private_data;
 
 	snd_output_printf(out, "LADSPA PCM\n");
+	if (ladspa->threads)
+		snd_output_printf(out, "  Threads: %u\n", ladspa->threads);
 	snd_output_printf(out, "  Playback:\n");
 	snd_pcm_ladspa_plugins_dump(&ladspa->pplugins, out);
 	snd_output_printf(out, "  Capture:\n");
@@ -1062,6 +1336,7 @@ static void snd_pcm_ladspa_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
 	}
+	snd_pcm_plugin_dump_profile(pcm, out);
 	snd_output_printf(out, "Slave: ");
 	snd_pcm_dump(ladspa->plug.gen.slave, out);
 }
@@ -1142,53 +1417,388 @@ static int snd_pcm_ladspa_check_file(snd_pcm_ladspa_plugin_t * const plugin,
 	return -ENOENT;
 }
 
+/*
+ * Plugin index
+ *
+ * Finding a plugin by label or id means to dlopen the libraries of the
+ * path directories until one has a matching descriptor, which is slow
+ * with large plugin collections.  The index keeps the (id, label, file)
+ * triples of every scanned directory together with the directory mtime,
+ * in memory and in the file ladspa.index of the cache directory
+ * ($ALSA_CONFIG_CACHE, or $XDG_CACHE_HOME/alsa-lib, or ~/.cache/alsa-lib),
+ * so an open dlopens only the library with the plugin.  A directory is
+ * scanned again when its mtime changes, or when the indexed file does
+ * not have the plugin any more.
+ */
+
+#define LADSPA_INDEX_MAGIC	"alsa-lib ladspa index 1"
+
+typedef struct {
+	unsigned long id;
+	char *label;
+	char *file;
+} ladspa_index_plugin_t;
+
+typedef struct {
+	struct list_head list;
+	char *path;
+	long long mtime_sec;
+	long mtime_nsec;
+	unsigned int count;
+	unsigned int alloc;
+	ladspa_index_plugin_t *plugins;
+} ladspa_index_dir_t;
+
+static LIST_HEAD(ladspa_index);
+static int ladspa_index_loaded;
+
+#ifdef THREAD_SAFE_API
+static pthread_mutex_t ladspa_index_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline void ladspa_index_lock(void)
+{
+	pthread_mutex_lock(&ladspa_index_mutex);
+}
+
+static inline void ladspa_index_unlock(void)
+{
+	pthread_mutex_unlock(&ladspa_index_mutex);
+}
+#else
+static inline void ladspa_index_lock(void) {}
+static inline void ladspa_index_unlock(void) {}
+#endif
+
+/* the persistent file, returns zero when there is none */
+static int ladspa_index_file(char *buf, size_t size)
+{
+	const char *dir;
+
+	if (getuid() != geteuid())
+		return 0;
+	dir = getenv("ALSA_CONFIG_CACHE");
+	if (dir && *dir == '/')
+		return snprintf(buf, size, "%s/ladspa.index", dir) < (int)size;
+	dir = getenv("XDG_CACHE_HOME");
+	if (dir && *dir == '/')
+		return snprintf(buf, size, "%s/alsa-lib/ladspa.index", dir) < (int)size;
+	dir = getenv("HOME");
+	if (dir && *dir == '/')
+		return snprintf(buf, size, "%s/.cache/alsa-lib/ladspa.index", dir) < (int)size;
+	return 0;
+}
+
+static void ladspa_index_dir_free(ladspa_index_dir_t *d)
+{
+	unsigned int i;
+
+	for (i = 0; i < d->count; i++) {
+		free(d->plugins[i].label);
+		free(d->plugins[i].file);
+	}
+	free(d->plugins);
+	free(d->path);
+	free(d);
+}
+
+static ladspa_index_dir_t *ladspa_index_dir_new(const char *path,
+						long long mtime_sec,
+						long mtime_nsec)
+{
+	ladspa_index_dir_t *d = calloc(1, sizeof(*d));
+
+	if (!d)
+		return NULL;
+	d->path = strdup(path);
+	if (!d->path) {
+		free(d);
+		return NULL;
+	}
+	d->mtime_sec = mtime_sec;
+	d->mtime_nsec = mtime_nsec;
+	return d;
+}
+
+static int ladspa_index_dir_add(ladspa_index_dir_t *d, unsigned long id,
+				const char *label, const char *file)
+{
+	ladspa_index_plugin_t *p;
+
+	if (d->count == d->alloc) {
+		unsigned int alloc = d->alloc ? d->alloc * 2 : 16;
+		p = realloc(d->plugins, alloc * sizeof(*p));
+		if (!p)
+			return -ENOMEM;
+		d->plugins = p;
+		d->alloc = alloc;
+	}
+	p = &d->plugins[d->count];
+	p->id = id;
+	p->label = strdup(label);
+	p->file = strdup(file);
+	if (!p->label || !p->file) {
+		free(p->label);
+		free(p->file);
+		return -ENOMEM;
+	}
+	d->count++;
+	return 0;
+}
+
+/*
+ * the file is a line with the magic, then for every directory
+ * "D <mtime sec> <mtime nsec> <path>" followed by its plugins
+ * "P <id> <label>\t<file>"
+ */
+static void ladspa_index_load(void)
+{
+	char path[PATH_MAX];
+	ladspa_index_dir_t *d = NULL;
+	char *line = NULL;
+	size_t line_size = 0;
+	ssize_t len;
+	FILE *fp;
+
+	ladspa_index_loaded = 1;
+	if (!ladspa_index_file(path, sizeof(path)))
+		return;
+	fp = fopen(path, "re");
+	if (!fp)
+		return;
+	len = getline(&line, &line_size, fp);
+	if (len <= 0 || strncmp(line, LADSPA_INDEX_MAGIC "\n", len))
+		goto __end;
+	while ((len = getline(&line, &line_size, fp)) > 0) {
+		long long sec;
+		long nsec;
+		unsigned long id;
+		int pos;
+		char *tab;
+
+		if (line[len - 1] != '\n')
+			break;
+		line[len - 1] = '\0';
+		if (sscanf(line, "D %lld %ld %n", &sec, &nsec, &pos) == 2) {
+			d = ladspa_index_dir_new(line + pos, sec, nsec);
+			if (!d)
+				break;
+			list_add_tail(&d->list, &ladspa_index);
+			continue;
+		}
+		if (d && sscanf(line, "P %lu %n", &id, &pos) == 1 &&
+		    (tab = strchr(line + pos, '\t')) != NULL) {
+			*tab = '\0';
+			if (ladspa_index_dir_add(d, id, line + pos, tab + 1) < 0)
+				break;
+			continue;
+		}
+		break;
+	}
+ __end:
+	free(line);
+	fclose(fp);
+}
+
+static void ladspa_index_save(void)
+{
+	char path[PATH_MAX], tmp[PATH_MAX + 8], *slash;
+	struct list_head *pos;
+	unsigned int i;
+	FILE *fp;
+	int fd;
+
+	if (!ladspa_index_file(path, sizeof(path)))
+		return;
+	/* create the cache directory, and its parent for ~/.cache */
+	slash = strrchr(path, '/');
+	*slash = '\0';
+	if (mkdir(path, 0755) < 0 && errno == ENOENT) {
+		char *up = strrchr(path, '/');
+		if (up && up != path) {
+			*up = '\0';
+			mkdir(path, 0755);
+			*up = '/';
+			mkdir(path, 0755);
+		}
+	}
+	*slash = '/';
+	snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path);
+	fd = mkstemp(tmp);
+	if (fd < 0)
+		return;
+	fp = fdopen(fd, "w");
+	if (!fp) {
+		close(fd);
+		unlink(tmp);
+		return;
+	}
+	fputs(LADSPA_INDEX_MAGIC "\n", fp);
+	list_for_each(pos, &ladspa_index) {
+		ladspa_index_dir_t *d = list_entry(pos, ladspa_index_dir_t, list);
+		fprintf(fp, "D %lld %ld %s\n", d->mtime_sec, d->mtime_nsec, d->path);
+		for (i = 0; i < d->count; i++)
+			fprintf(fp, "P %lu %s\t%s\n", d->plugins[i].id,
+				d->plugins[i].label, d->plugins[i].file);
+	}
+	if (fclose(fp) != 0 || rename(tmp, path) < 0)
+		unlink(tmp);
+}
+
+/* dlopen every library of the directory and note its descriptors */
+static ladspa_index_dir_t *ladspa_index_scan(const char *path,
+					     const struct stat64 *st)
+{
+	ladspa_index_dir_t *d;
+	struct dirent64 *dirent;
+	DIR *dir;
+	int len = strlen(path);
+	int need_slash = len > 0 && path[len - 1] != '/';
+
+	dir = opendir(path);
+	if (!dir)
+		return NULL;
+	d = ladspa_index_dir_new(path, st->st_mtim.tv_sec, st->st_mtim.tv_nsec);
+	if (!d) {
+		closedir(dir);
+		return NULL;
+	}
+	while ((dirent = readdir64(dir)) != NULL) {
+		LADSPA_Descriptor_Function fcn;
+		const LADSPA_Descriptor *desc;
+		char filename[len + strlen(dirent->d_name) + 2];
+		void *handle;
+		long idx;
+
+		if (dirent->d_name[0] == '.')
+			continue;
+		sprintf(filename, "%s%s%s", path, need_slash ? "/" : "", dirent->d_name);
+		handle = dlopen(filename, RTLD_LAZY);
+		if (!handle)
+			continue;
+		fcn = (LADSPA_Descriptor_Function)dlsym(handle, "ladspa_descriptor");
+		for (idx = 0; fcn && (desc = fcn(idx)) != NULL; idx++) {
+			if (!desc->Label || strpbrk(desc->Label, "\t\n"))
+				continue;
+			if (ladspa_index_dir_add(d, desc->UniqueID, desc->Label, filename) < 0)
+				break;
+		}
+		dlclose(handle);
+	}
+	closedir(dir);
+	return d;
+}
+
+/*
+ * returns the valid index of the directory, scanning it when needed,
+ * or NULL when it cannot be read; *changed is set after a scan
+ */
+static ladspa_index_dir_t *ladspa_index_get(const char *path, int rescan,
+					    int *changed)
+{
+	ladspa_index_dir_t *d = NULL;
+	struct list_head *pos;
+	struct stat64 st;
+
+	if (!ladspa_index_loaded)
+		ladspa_index_load();
+	list_for_each(pos, &ladspa_index) {
+		ladspa_index_dir_t *e = list_entry(pos, ladspa_index_dir_t, list);
+		if (strcmp(e->path, path) == 0) {
+			d = e;
+			break;
+		}
+	}
+	if (stat64(path, &st) < 0) {
+		st.st_mtim.tv_sec = -1;
+		st.st_mtim.tv_nsec = 0;
+	}
+	if (d && !rescan && d->mtime_sec == st.st_mtim.tv_sec &&
+	    d->mtime_nsec == st.st_mtim.tv_nsec)
+		return d;
+	if (d) {
+		list_del(&d->list);
+		ladspa_index_dir_free(d);
+		*changed = 1;
+	}
+	if (st.st_mtim.tv_sec == -1)
+		return NULL;
+	d = ladspa_index_scan(path, &st);
+	if (!d)
+		return NULL;
+	list_add_tail(&d->list, &ladspa_index);
+	*changed = 1;
+	return d;
+}
+
+/* the same label comparison as snd_pcm_ladspa_check_file() */
+static int ladspa_label_match(const char *label, const char *dlabel)
+{
+	char *labellocale, *dot;
+	int match;
+
+	if (label == NULL || strcmp(label, dlabel) == 0)
+		return 1;
+	labellocale = strdup(label);
+	if (labellocale == NULL)
+		return 0;
+	dot = strrchr(labellocale, '.');
+	if (dot)
+		*dot = *localeconv()->decimal_point;
+	match = strcmp(labellocale, dlabel) == 0;
+	free(labellocale);
+	return match;
+}
+
+/* the file of the plugin in the directory or NULL, with the index locked */
+static char *ladspa_index_find(const char *path, const char *label,
+			       const unsigned long ladspa_id, int rescan,
+			       int *changed, int *err)
+{
+	ladspa_index_dir_t *d;
+	unsigned int i;
+
+	*err = 0;
+	d = ladspa_index_get(path, rescan, changed);
+	if (!d) {
+		*err = -ENOENT;
+		return NULL;
+	}
+	for (i = 0; i < d->count; i++) {
+		if (ladspa_id > 0 && d->plugins[i].id != ladspa_id)
+			continue;
+		if (!ladspa_label_match(label, d->plugins[i].label))
+			continue;
+		return strdup(d->plugins[i].file);
+	}
+	return NULL;
+}
+
 static int snd_pcm_ladspa_check_dir(snd_pcm_ladspa_plugin_t * const plugin,
 				    const char *path,
 				    const char *label,
 				    const unsigned long ladspa_id)
 {
-	DIR *dir;
-	struct dirent64 * dirent;
-	int len = strlen(path), err;
-	int need_slash;
 	char *filename;
-	
-	if (len < 1)
+	int changed = 0, rescan, err;
+
+	if (*path == '\0')
 		return 0;
-	need_slash = path[len - 1] != '/';
-	
-	dir = opendir(path);
-	if (!dir)
-		return -ENOENT;
-		
-	while (1) {
-		dirent = readdir64(dir);
-		if (!dirent) {
-			closedir(dir);
-			return 0;
-		}
-		
-		filename = malloc(len + strlen(dirent->d_name) + 1 + need_slash);
-		if (filename == NULL) {
-			closedir(dir);
-			return -ENOMEM;
-		}
-		strcpy(filename, path);
-		if (need_slash)
-			strcat(filename, "/");
-		strcat(filename, dirent->d_name);
+	for (rescan = 0; rescan < 2; rescan++) {
+		ladspa_index_lock();
+		filename = ladspa_index_find(path, label, ladspa_id, rescan,
+					     &changed, &err);
+		if (changed)
+			ladspa_index_save();
+		ladspa_index_unlock();
+		if (!filename)
+			return err;
 		err = snd_pcm_ladspa_check_file(plugin, filename, label, ladspa_id);
 		free(filename);
-		if (err < 0 && err != -ENOENT) {
-			closedir(dir);
+		if (err != -ENOENT)
 			return err;
-		}
-		if (err > 0) {
-			closedir(dir);
-			return 1;
-		}
+		/* the library changed in place, look again */
+		changed = 0;
 	}
-	/* never reached */
 	return 0;
 }
 
@@ -1663,6 +2273,14 @@ channel zero. This definition is automatically duplicated for all channels.
 If the LADSPA plugin has multiple audio inputs or outputs the policy duplicate
 is automatically switched to policy none.
 
+The instances of a duplicated plugin process separate channels.  With the
+threads option set, they are run concurrently by a pool of that many worker
+threads plus the calling thread; the next plugin in the chain starts only
+when all instances finished the period.  The workers are created at
+hw_params time and inherit the scheduling policy of the calling thread.
+The option has no effect when the library is built without the thread-safe
+API.
+
 The plugin serialization works as expected. You can eventually use more
 channels (inputs / outputs) inside the LADPSA plugin chain than processed
 in the ALSA plugin chain. If ALSA channel does not exist for given LADSPA
@@ -1673,6 +2291,12 @@ connected to a dummy sample area.
 
 Instances of LADSPA plugins are created dynamically.
 
+A plugin given by label or id is looked up in the directories of path.
+The labels and ids of the libraries in each directory are kept in an index
+(ladspa.index in $ALSA_CONFIG_CACHE, $XDG_CACHE_HOME/alsa-lib or
+~/.cache/alsa-lib) which is refreshed when the directory modification time
+changes, so only the library with the plugin is loaded at open.
+
 \code
 pcm.name {
         type ladspa             # ALSA<->LADSPA PCM
@@ -1684,6 +2308,7 @@ pcm.name {
                 pcm { }         # Slave PCM definition
         }
         [channels INT]		# count input channels (input to LADSPA plugin chain)
+	[threads INT]		# worker threads for duplicated plugins (default 0)
 	[path STR]		# Path (directory) with LADSPA plugins
 	plugins |		# Definition for both directions
         playback_plugins |	# Definition for playback direction
@@ -1740,7 +2365,7 @@ int _snd_pcm_ladspa_open(snd_pcm_t **pcmp, const char *name,
 	snd_pcm_t *spcm;
 	snd_config_t *slave = NULL, *sconf;
 	const char *path = NULL;
-	long channels = 0;
+	long channels = 0, threads = 0;
 	snd_config_t *plugins = NULL, *pplugins = NULL, *cplugins = NULL;
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
@@ -1765,6 +2390,18 @@ int _snd_pcm_ladspa_open(snd_pcm_t **pcmp, const char *name,
                                 channels = 0;
 			continue;
 		}
+		if (strcmp(id, "threads") == 0) {
+			err = snd_config_get_integer(n, &threads);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				return -EINVAL;
+			}
+			if (threads > SND_PCM_LADSPA_MAX_THREADS)
+				threads = SND_PCM_LADSPA_MAX_THREADS;
+			if (threads < 0)
+				threads = 0;
+			continue;
+		}
 		if (strcmp(id, "plugins") == 0) {
 			plugins = n;
 			continue;
@@ -1800,9 +2437,12 @@ int _snd_pcm_ladspa_open(snd_pcm_t **pcmp, const char *name,
 	if (err < 0)
 		return err;
 	err = snd_pcm_ladspa_open(pcmp, name, path, channels, pplugins, cplugins, spcm, 1);
-	if (err < 0)
+	if (err < 0) {
 		snd_pcm_close(spcm);
-	return err;
+		return err;
+	}
+	((snd_pcm_ladspa_t *)(*pcmp)->private_data)->threads = threads;
+	return 0;
 }
 #ifndef DOC_HIDDEN
 SND_DLSYM_BUILD_VERSION(_snd_pcm_ladspa_open, SND_PCM_DLSYM_VERSION);
@@ -31,6 +31,7 @@
 #include "pcm_plugin.h"
 
 #include "plugin_ops.h"
+#include "plugin_block_ops.h"
 
 #ifndef DOC_HIDDEN
 
@@ -52,6 +53,7 @@ typedef struct {
 	unsigned int int32_idx;
 	unsigned int float32_idx;
 	snd_pcm_format_t sformat;
+	const snd_pcm_block_conv_t *block_conv;
 	void (*func)(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
 		     const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
 		     unsigned int channels, snd_pcm_uframes_t frames,
@@ -294,6 +296,7 @@ static int snd_pcm_lfloat_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 		lfloat->float32_idx = snd_pcm_lfloat_get_s32_index(src_format);
 		lfloat->func = snd_pcm_lfloat_convert_float_integer;
 	}
+	lfloat->block_conv = snd_pcm_block_conv_find(src_format, dst_format);
 	return 0;
 }
 
@@ -309,10 +312,12 @@ snd_pcm_lfloat_write_areas(snd_pcm_t *pcm,
 	snd_pcm_lfloat_t *lfloat = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	lfloat->func(slave_areas, slave_offset,
-		     areas, offset, 
-		     pcm->channels, size,
-		     lfloat->int32_idx, lfloat->float32_idx);
+	if (!snd_pcm_block_convert(lfloat->block_conv, slave_areas, slave_offset,
+				   areas, offset, pcm->channels, size))
+		lfloat->func(slave_areas, slave_offset,
+			     areas, offset, 
+			     pcm->channels, size,
+			     lfloat->int32_idx, lfloat->float32_idx);
 	*slave_sizep = size;
 	return size;
 }
@@ -329,10 +334,12 @@ snd_pcm_lfloat_read_areas(snd_pcm_t *pcm,
 	snd_pcm_lfloat_t *lfloat = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	lfloat->func(areas, offset, 
-		     slave_areas, slave_offset,
-		     pcm->channels, size,
-		     lfloat->int32_idx, lfloat->float32_idx);
+	if (!snd_pcm_block_convert(lfloat->block_conv, areas, offset,
+				   slave_areas, slave_offset, pcm->channels, size))
+		lfloat->func(areas, offset, 
+			     slave_areas, slave_offset,
+			     pcm->channels, size,
+			     lfloat->int32_idx, lfloat->float32_idx);
 	*slave_sizep = size;
 	return size;
 }
@@ -346,6 +353,7 @@ static void snd_pcm_lfloat_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
 	}
+	snd_pcm_plugin_dump_profile(pcm, out);
 	snd_output_printf(out, "Slave: ");
 	snd_pcm_dump(lfloat->plug.gen.slave, out);
 }
@@ -31,6 +31,7 @@
 #include "pcm_plugin.h"
 
 #include "plugin_ops.h"
+#include "plugin_block_ops.h"
 
 #ifndef PIC
 /* entry for static linking */
@@ -44,6 +45,7 @@ typedef struct {
 	unsigned int use_getput;
 	unsigned int conv_idx;
 	unsigned int get_idx, put_idx;
+	const snd_pcm_block_conv_t *block_conv;
 	snd_pcm_format_t sformat;
 } snd_pcm_linear_t;
 #endif
@@ -328,9 +330,35 @@ static int snd_pcm_linear_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 			linear->conv_idx = snd_pcm_linear_convert_index(linear->sformat,
 									format);
 	}
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
+		linear->block_conv = snd_pcm_block_conv_find(format, linear->sformat);
+	else
+		linear->block_conv = snd_pcm_block_conv_find(linear->sformat, format);
+	linear->plug.passthrough = format == linear->sformat;
 	return 0;
 }
 
+static void snd_pcm_linear_areas(snd_pcm_linear_t *linear,
+				 const snd_pcm_channel_area_t *dst_areas,
+				 snd_pcm_uframes_t dst_offset,
+				 const snd_pcm_channel_area_t *src_areas,
+				 snd_pcm_uframes_t src_offset,
+				 unsigned int channels, snd_pcm_uframes_t frames)
+{
+	if (snd_pcm_block_convert(linear->block_conv, dst_areas, dst_offset,
+				  src_areas, src_offset, channels, frames))
+		return;
+	if (linear->use_getput)
+		snd_pcm_linear_getput(dst_areas, dst_offset,
+				      src_areas, src_offset,
+				      channels, frames,
+				      linear->get_idx, linear->put_idx);
+	else
+		snd_pcm_linear_convert(dst_areas, dst_offset,
+				       src_areas, src_offset,
+				       channels, frames, linear->conv_idx);
+}
+
 static snd_pcm_uframes_t
 snd_pcm_linear_write_areas(snd_pcm_t *pcm,
 			   const snd_pcm_channel_area_t *areas,
@@ -343,15 +371,8 @@ snd_pcm_linear_write_areas(snd_pcm_t *pcm,
 	snd_pcm_linear_t *linear = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	if (linear->use_getput)
-		snd_pcm_linear_getput(slave_areas, slave_offset,
-				      areas, offset, 
-				      pcm->channels, size,
-				      linear->get_idx, linear->put_idx);
-	else
-		snd_pcm_linear_convert(slave_areas, slave_offset,
-				       areas, offset, 
-				       pcm->channels, size, linear->conv_idx);
+	snd_pcm_linear_areas(linear, slave_areas, slave_offset,
+			     areas, offset, pcm->channels, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -368,15 +389,8 @@ snd_pcm_linear_read_areas(snd_pcm_t *pcm,
 	snd_pcm_linear_t *linear = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	if (linear->use_getput)
-		snd_pcm_linear_getput(areas, offset, 
-				      slave_areas, slave_offset,
-				      pcm->channels, size,
-				      linear->get_idx, linear->put_idx);
-	else
-		snd_pcm_linear_convert(areas, offset, 
-				       slave_areas, slave_offset,
-				       pcm->channels, size, linear->conv_idx);
+	snd_pcm_linear_areas(linear, areas, offset,
+			     slave_areas, slave_offset, pcm->channels, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -390,6 +404,7 @@ static void snd_pcm_linear_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
 	}
+	snd_pcm_plugin_dump_profile(pcm, out);
 	snd_output_printf(out, "Slave: ");
 	snd_pcm_dump(linear->plug.gen.slave, out);
 }
@@ -187,8 +187,16 @@ typedef struct {
 	int (*poll_revents)(snd_pcm_t *pcm, struct pollfd *pfds, unsigned int nfds, unsigned short *revents); /* locked */
 	int (*may_wait_for_avail_min)(snd_pcm_t *pcm, snd_pcm_uframes_t avail);
 	int (*mmap_begin)(snd_pcm_t *pcm, const snd_pcm_channel_area_t **areas, snd_pcm_uframes_t *offset, snd_pcm_uframes_t *frames); /* locked */
+	int (*resync)(snd_pcm_t *pcm); /* locked, NULL = prepare */
 } snd_pcm_fast_ops_t;
 
+/* placement of plugin internal buffers, see pcm_mem.c */
+typedef struct {
+	unsigned int hugepages: 1;	/* back the buffers with huge pages */
+	unsigned int mlock: 1;		/* lock (and so pre-fault) the buffers */
+	int node;			/* NUMA node to bind to, -1 = any */
+} snd_pcm_mem_policy_t;
+
 struct _snd_pcm {
 	void *open_func;
 	char *name;
@@ -214,6 +222,9 @@ struct _snd_pcm {
 	unsigned int period_step;
 	snd_pcm_uframes_t avail_min;	/* min avail frames for wakeup */
 	int period_event;
+	int avail_min_adaptive;		/* avail_min follows the wakeup lateness */
+	snd_pcm_uframes_t avail_min_floor;	/* avail_min set by sw_params */
+	snd_pcm_uframes_t wake_late;	/* decaying peak of frames past avail_min at wakeup */
 	snd_pcm_uframes_t start_threshold;
 	snd_pcm_uframes_t stop_threshold;
 	snd_pcm_uframes_t silence_threshold;	/* Silence filling happens when
@@ -237,8 +248,13 @@ struct _snd_pcm {
 	unsigned int mmap_shadow: 1;	/* don't call actual mmap,
 					 * use the mmaped buffer of the slave
 					 */
+	unsigned int mmap_inplace: 1;	/* a layer above changes the samples
+					 * in the mmaped buffer, set before
+					 * hw_params
+					 */
 	unsigned int donot_close: 1;	/* don't close this PCM */
 	unsigned int own_state_check:1; /* plugin has own PCM state check */
+	unsigned int mmap_locked:1;	/* mmapped areas are mlocked */
 	snd_pcm_channel_info_t *mmap_channels;
 	snd_pcm_channel_area_t *running_areas;
 	snd_pcm_channel_area_t *stopped_areas;
@@ -248,6 +264,12 @@ struct _snd_pcm {
 	snd_pcm_t *fast_op_arg;
 	void *private_data;
 	struct list_head async_handlers;
+	snd_pcm_mem_policy_t mem;	/* internal buffer placement */
+	struct pollfd *wait_pfds;	/* descriptors cached by snd_pcm_wait(),
+					 * allocated on the first wait */
+	int wait_npfds;			/* 0 = to be queried on the next wait */
+	unsigned int wait_serial;	/* bumped when the descriptors may change */
+	struct snd_pcm_tstamp_ring *tstamp_ring;	/* see snd_pcm_tstamp_ring_enable() */
 #ifdef THREAD_SAFE_API
 	int need_lock;		/* true = this PCM (plugin) is thread-unsafe,
 				 * thus it needs a lock.
@@ -259,6 +281,13 @@ struct _snd_pcm {
 #endif
 };
 
+/* the poll descriptors may change: drop the cached wait set */
+static inline void snd_pcm_wait_invalidate(snd_pcm_t *pcm)
+{
+	pcm->wait_npfds = 0;
+	pcm->wait_serial++;
+}
+
 /* make local functions really local */
 /* Grrr, these cannot be local - a bad aserver uses them!
 #define snd_pcm_async \
@@ -272,6 +301,8 @@ struct _snd_pcm {
 */
 #define snd_pcm_new \
 	snd1_pcm_new
+#define snd_pcm_tstamp_ring_update \
+	snd1_pcm_tstamp_ring_update
 #define snd_pcm_free \
 	snd1_pcm_free
 #define snd_pcm_areas_from_buf \
@@ -282,6 +313,26 @@ struct _snd_pcm {
 	snd1_pcm_open_named_slave
 #define snd_pcm_hw_open_fd \
 	snd1_pcm_hw_open_fd
+#define snd_pcm_mmap_lock_areas \
+	snd1_pcm_mmap_lock_areas
+#define snd_pcm_mem_alloc \
+	snd1_pcm_mem_alloc
+#define snd_pcm_mem_free \
+	snd1_pcm_mem_free
+#define snd_pcm_mem_bind \
+	snd1_pcm_mem_bind
+#define snd_pcm_mem_parse \
+	snd1_pcm_mem_parse
+#define snd_pcm_table_get \
+	snd1_pcm_table_get
+#define snd_pcm_table_put \
+	snd1_pcm_table_put
+#define snd_pcm_hw_delay_hwsync \
+	snd1_pcm_hw_delay_hwsync
+#define snd_pcm_hw_uring_fd \
+	snd1_pcm_hw_uring_fd
+#define snd_pcm_hw_uring_sync \
+	snd1_pcm_hw_uring_sync
 #define snd_pcm_wait_nocheck \
 	snd1_pcm_wait_nocheck
 #define snd_pcm_rate_get_default_converter \
@@ -431,11 +482,18 @@ snd_pcm_sframes_t __snd_pcm_mmap_commit(snd_pcm_t *pcm,
 					snd_pcm_uframes_t frames);
 int __snd_pcm_wait_in_lock(snd_pcm_t *pcm, int timeout);
 
+void snd_pcm_tstamp_ring_update(snd_pcm_t *pcm);
+
 static inline snd_pcm_sframes_t __snd_pcm_avail_update(snd_pcm_t *pcm)
 {
+	snd_pcm_sframes_t avail;
+
 	if (!pcm->fast_ops->avail_update)
 		return -ENOSYS;
-	return pcm->fast_ops->avail_update(pcm->fast_op_arg);
+	avail = pcm->fast_ops->avail_update(pcm->fast_op_arg);
+	if (pcm->tstamp_ring && avail >= 0)
+		snd_pcm_tstamp_ring_update(pcm);
+	return avail;
 }
 
 static inline int __snd_pcm_start(snd_pcm_t *pcm)
@@ -998,10 +1056,27 @@ snd_pcm_open_slave(snd_pcm_t **pcmp, snd_config_t *root,
 					mode, parent_conf);
 }
 
-#define snd_pcm_conf_generic_id(id) _snd_conf_generic_id(id)
+#define snd_pcm_conf_generic_id(id) \
+	(_snd_conf_generic_id(id) || strcmp(id, "memory") == 0)
+
+int snd_pcm_mmap_lock_areas(snd_pcm_t *pcm);
+void *snd_pcm_mem_alloc(snd_pcm_t *pcm, size_t size);
+void snd_pcm_mem_free(void *ptr);
+void snd_pcm_mem_bind(const snd_pcm_mem_policy_t *policy, void *addr, size_t size);
+int snd_pcm_mem_parse(snd_config_t *root, snd_config_t *conf,
+		      snd_pcm_mem_policy_t *policy);
+
+/* shared read-only tables, see pcm_table.c */
+typedef int (*snd_pcm_table_build_t)(void *table, const void *key);
+const void *snd_pcm_table_get(const char *type, const void *key, size_t key_size,
+			      size_t size, snd_pcm_table_build_t build);
+void snd_pcm_table_put(const void *table);
 
 int snd_pcm_hw_open_fd(snd_pcm_t **pcmp, const char *name, int fd,
 		       int sync_ptr_ioctl);
+int snd_pcm_hw_delay_hwsync(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp);
+int snd_pcm_hw_uring_fd(snd_pcm_t *pcm);
+int snd_pcm_hw_uring_sync(snd_pcm_t *pcm);
 int __snd_pcm_mmap_emul_open(snd_pcm_t **pcmp, const char *name,
 			     snd_pcm_t *slave, int close_slave);
 
@@ -1159,6 +1234,17 @@ static inline void sw_set_period_event(snd_pcm_sw_params_t *params, int val)
 	params->reserved[sizeof(params->reserved) / sizeof(params->reserved[0]) - 1] = val;
 }
 
+/* the same hack for the adaptive avail_min mode */
+static inline int sw_get_avail_min_adaptive(const snd_pcm_sw_params_t *params)
+{
+	return params->reserved[sizeof(params->reserved) / sizeof(params->reserved[0]) - 2];
+}
+
+static inline void sw_set_avail_min_adaptive(snd_pcm_sw_params_t *params, int val)
+{
+	params->reserved[sizeof(params->reserved) / sizeof(params->reserved[0]) - 2] = val;
+}
+
 #define PCMINABORT(pcm) (((pcm)->mode & SND_PCM_ABORT) != 0)
 
 static inline snd_pcm_sframes_t pcm_frame_diff(snd_pcm_uframes_t ptr1,
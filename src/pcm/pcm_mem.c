@@ -0,0 +1,210 @@
+/*
+ *  PCM - plugin internal buffer allocation
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * The intermediate buffers of the plugins (mmap bounce buffers, rate and
+ * ladspa work areas) are allocated here, following the "memory" policy of
+ * the PCM definition:
+ *
+ *	memory {
+ *		hugepages BOOL	# huge pages, transparent ones as fallback
+ *		mlock BOOL	# lock the pages into the memory
+ *		node INT	# bind to the given NUMA node
+ *	}
+ *
+ * Without a policy the buffers come from calloc() as before.  Otherwise
+ * they are anonymous mappings, bound to the node before the first touch.
+ * In both cases a small header in front of the buffer keeps the details
+ * needed by snd_pcm_mem_free().
+ */
+
+#include "pcm_local.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#ifndef DOC_HIDDEN
+
+#define MEM_HDR_SIZE	64		/* keeps the buffer cache line aligned */
+#define MEM_HUGE_SIZE	(2 * 1024 * 1024)
+
+#ifndef MPOL_BIND
+#define MPOL_BIND	2
+#endif
+
+struct mem_hdr {
+	size_t len;			/* mapping length, 0 = calloc'ed */
+};
+
+static int mem_policy_empty(const snd_pcm_mem_policy_t *policy)
+{
+	return !policy->hugepages && !policy->mlock && policy->node < 0;
+}
+
+static void mem_bind_node(void *addr, size_t size, int node)
+{
+#ifdef __NR_mbind
+	unsigned long mask[4];
+	unsigned long bits = sizeof(unsigned long) * 8;
+
+	if ((size_t)node >= sizeof(mask) * 8)
+		return;
+	memset(mask, 0, sizeof(mask));
+	mask[node / bits] = 1UL << (node % bits);
+	if (syscall(__NR_mbind, addr, size, MPOL_BIND, mask,
+		    sizeof(mask) * 8, 0) < 0)
+		SYSMSG("mbind to node %d failed", node);
+#endif
+}
+
+/* applies the node binding and locking to an existing page aligned region */
+void snd_pcm_mem_bind(const snd_pcm_mem_policy_t *policy, void *addr, size_t size)
+{
+	if (policy->node >= 0)
+		mem_bind_node(addr, size, policy->node);
+	if (policy->mlock && mlock(addr, size) < 0)
+		SYSMSG("mlock failed");
+}
+
+/* returns a zeroed buffer placed according to the policy of pcm */
+void *snd_pcm_mem_alloc(snd_pcm_t *pcm, size_t size)
+{
+	const snd_pcm_mem_policy_t *policy = &pcm->mem;
+	snd_pcm_mem_policy_t locked;
+	size_t page = sysconf(_SC_PAGESIZE);
+	struct mem_hdr *hdr;
+	void *base = MAP_FAILED;
+	size_t len;
+
+	if (pcm->mode & SND_PCM_MLOCK_AREAS) {
+		locked = *policy;
+		locked.mlock = 1;
+		policy = &locked;
+	}
+	if (mem_policy_empty(policy)) {
+		hdr = calloc(1, MEM_HDR_SIZE + size);
+		if (!hdr)
+			return NULL;
+		hdr->len = 0;
+		return (char *)hdr + MEM_HDR_SIZE;
+	}
+#ifdef MAP_HUGETLB
+	if (policy->hugepages) {
+		len = (MEM_HDR_SIZE + size + MEM_HUGE_SIZE - 1) & ~(size_t)(MEM_HUGE_SIZE - 1);
+		base = mmap(NULL, len, PROT_READ | PROT_WRITE,
+			    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	}
+#endif
+	if (base == MAP_FAILED) {
+		len = (MEM_HDR_SIZE + size + page - 1) & ~(page - 1);
+		base = mmap(NULL, len, PROT_READ | PROT_WRITE,
+			    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (base == MAP_FAILED)
+			return NULL;
+#ifdef MADV_HUGEPAGE
+		if (policy->hugepages)
+			madvise(base, len, MADV_HUGEPAGE);
+#endif
+	}
+	/* bind before the header write faults in the first page */
+	snd_pcm_mem_bind(policy, base, len);
+	hdr = base;
+	hdr->len = len;
+	return (char *)base + MEM_HDR_SIZE;
+}
+
+void snd_pcm_mem_free(void *ptr)
+{
+	struct mem_hdr *hdr;
+
+	if (!ptr)
+		return;
+	hdr = (struct mem_hdr *)((char *)ptr - MEM_HDR_SIZE);
+	if (hdr->len)
+		munmap(hdr, hdr->len);
+	else
+		free(hdr);
+}
+
+static int mem_parse_compound(snd_config_t *conf, snd_pcm_mem_policy_t *policy)
+{
+	snd_config_iterator_t i, next;
+	long node;
+	int err;
+
+	if (snd_config_get_type(conf) != SND_CONFIG_TYPE_COMPOUND) {
+		SNDERR("Invalid type for memory");
+		return -EINVAL;
+	}
+	snd_config_for_each(i, next, conf) {
+		snd_config_t *n = snd_config_iterator_entry(i);
+		const char *id;
+		if (snd_config_get_id(n, &id) < 0)
+			continue;
+		if (strcmp(id, "hugepages") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			policy->hugepages = err;
+			continue;
+		}
+		if (strcmp(id, "mlock") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			policy->mlock = err;
+			continue;
+		}
+		if (strcmp(id, "node") == 0) {
+			err = snd_config_get_integer(n, &node);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				return err;
+			}
+			policy->node = node < 0 ? -1 : node;
+			continue;
+		}
+		SNDERR("Unknown field memory.%s", id);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+/*
+ * reads the "memory" field of the PCM definition, falling back to
+ * defaults.pcm.memory from the configuration tree
+ */
+int snd_pcm_mem_parse(snd_config_t *root, snd_config_t *conf,
+		      snd_pcm_mem_policy_t *policy)
+{
+	snd_config_t *n;
+
+	policy->hugepages = 0;
+	policy->mlock = 0;
+	policy->node = -1;
+	if (conf && snd_config_search(conf, "memory", &n) >= 0)
+		return mem_parse_compound(n, policy);
+	if (root && snd_config_search(root, "defaults.pcm.memory", &n) >= 0)
+		return mem_parse_compound(n, policy);
+	return 0;
+}
+
+#endif /* DOC_HIDDEN */
@@ -29,8 +29,11 @@
 
 #include "bswap.h"
 #include <time.h>
+#include <math.h>
 #include <pthread.h>
 #include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include "pcm_local.h"
 #include "pcm_plugin.h"
 
@@ -45,6 +48,15 @@ const char *_snd_module_pcm_meter = "";
 
 #ifndef DOC_HIDDEN
 #define FREQUENCY 50
+/* frames summarized by one level block */
+#define LEVEL_FRAMES 128
+
+/* internal level block, the mean square is kept to merge blocks */
+typedef struct {
+	unsigned int peak;
+	unsigned int ms;
+	unsigned int clips;
+} snd_pcm_meter_block_t;
 
 struct _snd_pcm_scope {
 	int enabled;
@@ -56,23 +68,206 @@ struct _snd_pcm_scope {
 
 typedef struct _snd_pcm_meter {
 	snd_pcm_generic_t gen;
+	snd_pcm_t *pcm;
 	snd_pcm_uframes_t rptr;
 	snd_pcm_uframes_t buf_size;
 	snd_pcm_channel_area_t *buf_areas;
 	snd_pcm_uframes_t now;
 	unsigned char *buf;
 	struct list_head scopes;
-	int closed;
+	int enabled;			/* scopes enabled by the service */
 	int running;
 	int reset;
-	pthread_t thread;
+	struct list_head service_list;	/* in the meter service */
+	struct timespec due;		/* next service of this meter */
 	pthread_mutex_t update_mutex;
-	pthread_mutex_t running_mutex;
-	pthread_cond_t running_cond;
 	struct timespec delay;
 	void *dl_handle;
+	/* level blocks computed in the transfer path */
+	snd_pcm_meter_block_t *levels;	/* channels * levels_size */
+	unsigned int levels_size;
+	unsigned int *level_peak;	/* per channel, block being filled */
+	unsigned long long *level_sum;
+	unsigned int *level_clips;
+	snd_pcm_uframes_t level_frames;	/* frames in the block being filled */
+	snd_pcm_uframes_t level_start;	/* frame pointer of the first block */
+	unsigned long long level_count;	/* blocks completed */
 } snd_pcm_meter_t;
 
+/*
+ * One thread serves all the meter PCMs in the process.  It sleeps
+ * until the earliest due meter, or until a meter is started when none
+ * is running.  The mutex is released while a meter is served, so that
+ * a slow scope doesn't block the other meters; that meter stays busy
+ * and cannot be removed meanwhile.
+ */
+typedef struct {
+	pthread_mutex_t lock;		/* serializes adding and removing */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	pthread_cond_t idle;		/* signaled when busy is cleared */
+	snd_pcm_meter_t *busy;		/* served without the mutex */
+	int initialized;
+	struct list_head meters;
+	unsigned int count;
+	pthread_t thread;
+	int quit;
+} snd_pcm_meter_service_t;
+
+static snd_pcm_meter_service_t meter_service = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.meters = { &meter_service.meters, &meter_service.meters },
+};
+
+/* samples at these magnitudes count as clipped */
+#define LEVEL_CLIP 32767
+
+static inline void meter_level_s16(const int16_t *src, snd_pcm_uframes_t n,
+				   unsigned int *peakp, unsigned long long *sump,
+				   unsigned int *clipsp)
+{
+	unsigned int peak = *peakp, clips = 0;
+	unsigned long long sum = 0;
+	snd_pcm_uframes_t i;
+
+	/* branchless, so the compiler turns it into vector code */
+	for (i = 0; i < n; i++) {
+		int v = src[i];
+		unsigned int a = v < 0 ? -v : v;
+		peak = a > peak ? a : peak;
+		sum += (unsigned int)(v * v);
+		clips += a >= LEVEL_CLIP;
+	}
+	*peakp = peak;
+	*sump += sum;
+	*clipsp += clips;
+}
+
+static inline void meter_level_s32(const int32_t *src, snd_pcm_uframes_t n,
+				   unsigned int shift,
+				   unsigned int *peakp, unsigned long long *sump,
+				   unsigned int *clipsp)
+{
+	unsigned int peak = *peakp, clips = 0;
+	unsigned long long sum = 0;
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i < n; i++) {
+		int v = src[i] >> shift;
+		unsigned int a = v < 0 ? -v : v;
+		peak = a > peak ? a : peak;
+		sum += (unsigned int)(v * v);
+		clips += a >= LEVEL_CLIP;
+	}
+	*peakp = peak;
+	*sump += sum;
+	*clipsp += clips;
+}
+
+static inline void meter_level_float(const float *src, snd_pcm_uframes_t n,
+				     unsigned int *peakp, unsigned long long *sump,
+				     unsigned int *clipsp)
+{
+	unsigned int peak = *peakp, clips = 0;
+	float sum = 0;
+	snd_pcm_uframes_t i;
+
+	for (i = 0; i < n; i++) {
+		float v = src[i] * 32768.0f;
+		float a = fabsf(v);
+		a = a < 32768.0f ? a : 32768.0f;
+		peak = (unsigned int)a > peak ? (unsigned int)a : peak;
+		sum += a * a;
+		clips += a >= LEVEL_CLIP;
+	}
+	*peakp = peak;
+	*sump += (unsigned long long)sum;
+	*clipsp += clips;
+}
+
+/* returns the right shift to 16 bit, or -1 if levels are not computed */
+static int snd_pcm_meter_level_shift(snd_pcm_format_t format)
+{
+	switch (format) {
+	case SND_PCM_FORMAT_S16:
+		return 0;
+	case SND_PCM_FORMAT_S24:
+		return 8;
+	case SND_PCM_FORMAT_S32:
+		return 16;
+	case SND_PCM_FORMAT_FLOAT:
+		return 0;
+	default:
+		return -1;
+	}
+}
+
+/* summarizes frames just copied into the meter buffer */
+static void snd_pcm_meter_add_levels(snd_pcm_t *pcm, snd_pcm_uframes_t offset,
+				     snd_pcm_uframes_t frames)
+{
+	snd_pcm_meter_t *meter = pcm->private_data;
+	int shift = snd_pcm_meter_level_shift(pcm->format);
+	unsigned int c, idx;
+
+	if (!meter->levels || shift < 0)
+		return;
+	while (frames > 0) {
+		snd_pcm_uframes_t n = LEVEL_FRAMES - meter->level_frames;
+		if (n > frames)
+			n = frames;
+		for (c = 0; c < pcm->channels; c++) {
+			const void *src = snd_pcm_channel_area_addr(&meter->buf_areas[c], offset);
+			if (pcm->format == SND_PCM_FORMAT_S16)
+				meter_level_s16(src, n, &meter->level_peak[c],
+						&meter->level_sum[c],
+						&meter->level_clips[c]);
+			else if (pcm->format == SND_PCM_FORMAT_FLOAT)
+				meter_level_float(src, n, &meter->level_peak[c],
+						  &meter->level_sum[c],
+						  &meter->level_clips[c]);
+			else
+				meter_level_s32(src, n, shift, &meter->level_peak[c],
+						&meter->level_sum[c],
+						&meter->level_clips[c]);
+		}
+		meter->level_frames += n;
+		offset += n;
+		frames -= n;
+		if (meter->level_frames < LEVEL_FRAMES)
+			continue;
+		idx = meter->level_count % meter->levels_size;
+		for (c = 0; c < pcm->channels; c++) {
+			snd_pcm_meter_block_t *b = &meter->levels[c * meter->levels_size + idx];
+			b->peak = meter->level_peak[c];
+			b->ms = meter->level_sum[c] / LEVEL_FRAMES;
+			b->clips = meter->level_clips[c];
+			meter->level_peak[c] = 0;
+			meter->level_sum[c] = 0;
+			meter->level_clips[c] = 0;
+		}
+		meter->level_frames = 0;
+		__atomic_store_n(&meter->level_count, meter->level_count + 1,
+				 __ATOMIC_RELEASE);
+	}
+}
+
+/* restarts the level blocks at the given frame pointer */
+static void snd_pcm_meter_reset_levels(snd_pcm_t *pcm, snd_pcm_uframes_t ptr)
+{
+	snd_pcm_meter_t *meter = pcm->private_data;
+
+	if (!meter->levels)
+		return;
+	memset(meter->level_peak, 0, pcm->channels * sizeof(*meter->level_peak));
+	memset(meter->level_sum, 0, pcm->channels * sizeof(*meter->level_sum));
+	memset(meter->level_clips, 0, pcm->channels * sizeof(*meter->level_clips));
+	meter->level_frames = 0;
+	meter->level_start = ptr;
+	__atomic_store_n(&meter->level_count, 0, __ATOMIC_RELEASE);
+}
+
 static void snd_pcm_meter_add_frames(snd_pcm_t *pcm,
 				     const snd_pcm_channel_area_t *areas,
 				     snd_pcm_uframes_t ptr,
@@ -94,6 +289,7 @@ static void snd_pcm_meter_add_frames(snd_pcm_t *pcm,
 		snd_pcm_areas_copy(meter->buf_areas, dst_offset, 
 				   areas, src_offset,
 				   pcm->channels, n, pcm->format);
+		snd_pcm_meter_add_levels(pcm, dst_offset, n);
 		frames -= n;
 		ptr += n;
 		if (ptr == pcm->boundary)
@@ -182,99 +378,226 @@ static int snd_pcm_scope_disable(snd_pcm_scope_t *scope)
 	return 0;
 }
 
-static void *snd_pcm_meter_thread(void *data)
+static void snd_pcm_meter_enable_scopes(snd_pcm_meter_t *meter, int enable)
+{
+	struct list_head *pos;
+	snd_pcm_scope_t *scope;
+	list_for_each(pos, &meter->scopes) {
+		scope = list_entry(pos, snd_pcm_scope_t, list);
+		if (enable)
+			snd_pcm_scope_enable(scope);
+		else if (scope->enabled)
+			snd_pcm_scope_disable(scope);
+	}
+	meter->enabled = enable;
+}
+
+/* updates the scopes of a meter; returns 0 when it is not running */
+static int snd_pcm_meter_service_one(snd_pcm_t *pcm)
 {
-	snd_pcm_t *pcm = data;
 	snd_pcm_meter_t *meter = pcm->private_data;
 	snd_pcm_t *spcm = meter->gen.slave;
 	struct list_head *pos;
 	snd_pcm_scope_t *scope;
+	snd_pcm_sframes_t now;
+	snd_pcm_status_t status;
 	int reset;
-	list_for_each(pos, &meter->scopes) {
-		scope = list_entry(pos, snd_pcm_scope_t, list);
-		snd_pcm_scope_enable(scope);
-	}
-	while (!meter->closed) {
-		snd_pcm_sframes_t now;
-		snd_pcm_status_t status;
-		int err;
-		pthread_mutex_lock(&meter->running_mutex);
-		err = snd_pcm_status(spcm, &status);
-		assert(err >= 0);
-		if (status.state != SND_PCM_STATE_RUNNING &&
-		    (status.state != SND_PCM_STATE_DRAINING ||
-		     spcm->stream != SND_PCM_STREAM_PLAYBACK)) {
-			if (meter->running) {
-				list_for_each(pos, &meter->scopes) {
-					scope = list_entry(pos, snd_pcm_scope_t, list);
-					scope->ops->stop(scope);
-				}
-				meter->running = 0;
-			}
-			pthread_cond_wait(&meter->running_cond,
-					  &meter->running_mutex);
-			pthread_mutex_unlock(&meter->running_mutex);
-			continue;
-		}
-		pthread_mutex_unlock(&meter->running_mutex);
-		if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
-			now = status.appl_ptr - status.delay;
-			if (now < 0)
-				now += pcm->boundary;
-		} else {
-			now = status.appl_ptr + status.delay;
-			if ((snd_pcm_uframes_t) now >= pcm->boundary)
-				now -= pcm->boundary;
-		}
-		meter->now = now;
-		if (pcm->stream == SND_PCM_STREAM_CAPTURE)
-			reset = snd_pcm_meter_update_scope(pcm);
-		else {
-			reset = 0;
-			while (atomic_read(&meter->reset)) {
-				reset = 1;
-				atomic_dec(&meter->reset);
-			}
-		}
-		if (reset) {
+
+	if (!meter->enabled)
+		snd_pcm_meter_enable_scopes(meter, 1);
+	if (snd_pcm_status(spcm, &status) < 0 ||
+	    (status.state != SND_PCM_STATE_RUNNING &&
+	     (status.state != SND_PCM_STATE_DRAINING ||
+	      spcm->stream != SND_PCM_STREAM_PLAYBACK))) {
+		if (meter->running) {
 			list_for_each(pos, &meter->scopes) {
 				scope = list_entry(pos, snd_pcm_scope_t, list);
-				if (scope->enabled)
-					scope->ops->reset(scope);
+				scope->ops->stop(scope);
 			}
-			continue;
+			meter->running = 0;
 		}
-		if (!meter->running) {
-			list_for_each(pos, &meter->scopes) {
-				scope = list_entry(pos, snd_pcm_scope_t, list);
-				if (scope->enabled)
-					scope->ops->start(scope);
-			}
-			meter->running = 1;
+		return 0;
+	}
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+		now = status.appl_ptr - status.delay;
+		if (now < 0)
+			now += pcm->boundary;
+	} else {
+		now = status.appl_ptr + status.delay;
+		if ((snd_pcm_uframes_t) now >= pcm->boundary)
+			now -= pcm->boundary;
+	}
+	meter->now = now;
+	if (pcm->stream == SND_PCM_STREAM_CAPTURE)
+		reset = snd_pcm_meter_update_scope(pcm);
+	else {
+		reset = 0;
+		while (atomic_read(&meter->reset)) {
+			reset = 1;
+			atomic_dec(&meter->reset);
+		}
+	}
+	if (reset) {
+		list_for_each(pos, &meter->scopes) {
+			scope = list_entry(pos, snd_pcm_scope_t, list);
+			if (scope->enabled)
+				scope->ops->reset(scope);
 		}
+		return 1;
+	}
+	if (!meter->running) {
 		list_for_each(pos, &meter->scopes) {
 			scope = list_entry(pos, snd_pcm_scope_t, list);
 			if (scope->enabled)
-				scope->ops->update(scope);
+				scope->ops->start(scope);
 		}
-	        nanosleep(&meter->delay, NULL);
+		meter->running = 1;
 	}
 	list_for_each(pos, &meter->scopes) {
 		scope = list_entry(pos, snd_pcm_scope_t, list);
 		if (scope->enabled)
-			snd_pcm_scope_disable(scope);
+			scope->ops->update(scope);
+	}
+	return 1;
+}
+
+static int timespec_before(const struct timespec *a, const struct timespec *b)
+{
+	return a->tv_sec < b->tv_sec ||
+	       (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+static void timespec_add(struct timespec *ts, const struct timespec *delay)
+{
+	ts->tv_sec += delay->tv_sec;
+	ts->tv_nsec += delay->tv_nsec;
+	if (ts->tv_nsec >= 1000000000) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000;
 	}
+}
+
+static void *snd_pcm_meter_service_thread(void *data ATTRIBUTE_UNUSED)
+{
+	snd_pcm_meter_service_t *svc = &meter_service;
+	struct list_head *pos;
+	struct timespec now, next;
+	int running;
+
+	pthread_mutex_lock(&svc->mutex);
+	while (!svc->quit) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		running = 0;
+		list_for_each(pos, &svc->meters) {
+			snd_pcm_meter_t *meter = list_entry(pos, snd_pcm_meter_t, service_list);
+			if (!timespec_before(&now, &meter->due)) {
+				int served;
+
+				svc->busy = meter;
+				pthread_mutex_unlock(&svc->mutex);
+				served = snd_pcm_meter_service_one(meter->pcm);
+				pthread_mutex_lock(&svc->mutex);
+				svc->busy = NULL;
+				pthread_cond_broadcast(&svc->idle);
+				if (!served)
+					continue;
+				meter->due = now;
+				timespec_add(&meter->due, &meter->delay);
+			} else if (!meter->running)
+				continue;
+			if (!running || timespec_before(&meter->due, &next))
+				next = meter->due;
+			running = 1;
+		}
+		if (running)
+			pthread_cond_timedwait(&svc->cond, &svc->mutex, &next);
+		else
+			pthread_cond_wait(&svc->cond, &svc->mutex);
+	}
+	pthread_mutex_unlock(&svc->mutex);
 	return NULL;
 }
 
+static int snd_pcm_meter_service_add(snd_pcm_t *pcm)
+{
+	snd_pcm_meter_service_t *svc = &meter_service;
+	snd_pcm_meter_t *meter = pcm->private_data;
+	pthread_condattr_t attr;
+	int err = 0;
+
+	pthread_mutex_lock(&svc->lock);
+	pthread_mutex_lock(&svc->mutex);
+	if (!svc->initialized) {
+		pthread_condattr_init(&attr);
+		pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+		pthread_cond_init(&svc->cond, &attr);
+		pthread_condattr_destroy(&attr);
+		pthread_cond_init(&svc->idle, NULL);
+		svc->initialized = 1;
+	}
+	if (!svc->count) {
+		svc->quit = 0;
+		err = snd_thread_create(&svc->thread, "pcm_meter",
+					snd_pcm_meter_service_thread, NULL);
+		if (err) {
+			pthread_mutex_unlock(&svc->mutex);
+			pthread_mutex_unlock(&svc->lock);
+			SNDERR("Unable to create meter thread");
+			return -err;
+		}
+	}
+	svc->count++;
+	meter->enabled = 0;
+	meter->due.tv_sec = meter->due.tv_nsec = 0;
+	list_add_tail(&meter->service_list, &svc->meters);
+	pthread_cond_signal(&svc->cond);
+	pthread_mutex_unlock(&svc->mutex);
+	pthread_mutex_unlock(&svc->lock);
+	return 0;
+}
+
+static void snd_pcm_meter_service_remove(snd_pcm_t *pcm)
+{
+	snd_pcm_meter_service_t *svc = &meter_service;
+	snd_pcm_meter_t *meter = pcm->private_data;
+	pthread_t thread;
+	int quit;
+
+	pthread_mutex_lock(&svc->lock);
+	pthread_mutex_lock(&svc->mutex);
+	while (svc->busy == meter)
+		pthread_cond_wait(&svc->idle, &svc->mutex);
+	list_del(&meter->service_list);
+	if (meter->enabled)
+		snd_pcm_meter_enable_scopes(meter, 0);
+	quit = !--svc->count;
+	thread = svc->thread;
+	if (quit) {
+		svc->quit = 1;
+		pthread_cond_signal(&svc->cond);
+	}
+	pthread_mutex_unlock(&svc->mutex);
+	if (quit)
+		pthread_join(thread, NULL);
+	pthread_mutex_unlock(&svc->lock);
+}
+
+/* wakes the service sleeping without a running meter */
+static void snd_pcm_meter_service_wake(void)
+{
+	snd_pcm_meter_service_t *svc = &meter_service;
+
+	pthread_mutex_lock(&svc->mutex);
+	pthread_cond_signal(&svc->cond);
+	pthread_mutex_unlock(&svc->mutex);
+}
+
 static int snd_pcm_meter_close(snd_pcm_t *pcm)
 {
 	snd_pcm_meter_t *meter = pcm->private_data;
 	struct list_head *pos, *npos;
 	int err = 0;
 	pthread_mutex_destroy(&meter->update_mutex);
-	pthread_mutex_destroy(&meter->running_mutex);
-	pthread_cond_destroy(&meter->running_cond);
 	if (meter->gen.close_slave)
 		err = snd_pcm_close(meter->gen.slave);
 	list_for_each_safe(pos, npos, &meter->scopes) {
@@ -299,6 +622,7 @@ static int snd_pcm_meter_prepare(snd_pcm_t *pcm)
 			meter->rptr = *pcm->appl.ptr;
 		else
 			meter->rptr = *pcm->hw.ptr;
+		snd_pcm_meter_reset_levels(pcm, meter->rptr);
 	}
 	return err;
 }
@@ -308,8 +632,10 @@ static int snd_pcm_meter_reset(snd_pcm_t *pcm)
 	snd_pcm_meter_t *meter = pcm->private_data;
 	int err = snd_pcm_reset(meter->gen.slave);
 	if (err >= 0) {
-		if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
+		if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
 			meter->rptr = *pcm->appl.ptr;
+			snd_pcm_meter_reset_levels(pcm, meter->rptr);
+		}
 	}
 	return err;
 }
@@ -318,11 +644,9 @@ static int snd_pcm_meter_start(snd_pcm_t *pcm)
 {
 	snd_pcm_meter_t *meter = pcm->private_data;
 	int err;
-	pthread_mutex_lock(&meter->running_mutex);
 	err = snd_pcm_start(meter->gen.slave);
 	if (err >= 0)
-		pthread_cond_signal(&meter->running_cond);
-	pthread_mutex_unlock(&meter->running_mutex);
+		snd_pcm_meter_service_wake();
 	return err;
 }
 
@@ -330,8 +654,10 @@ static snd_pcm_sframes_t snd_pcm_meter_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t
 {
 	snd_pcm_meter_t *meter = pcm->private_data;
 	snd_pcm_sframes_t err = snd_pcm_rewind(meter->gen.slave, frames);
-	if (err > 0 && pcm->stream == SND_PCM_STREAM_PLAYBACK)
+	if (err > 0 && pcm->stream == SND_PCM_STREAM_PLAYBACK) {
 		meter->rptr = *pcm->appl.ptr;
+		snd_pcm_meter_reset_levels(pcm, meter->rptr);
+	}
 	return err;
 }
 
@@ -339,8 +665,10 @@ static snd_pcm_sframes_t snd_pcm_meter_forward(snd_pcm_t *pcm, snd_pcm_uframes_t
 {
 	snd_pcm_meter_t *meter = pcm->private_data;
 	snd_pcm_sframes_t err = INTERNAL(snd_pcm_forward)(meter->gen.slave, frames);
-	if (err > 0 && pcm->stream == SND_PCM_STREAM_PLAYBACK)
+	if (err > 0 && pcm->stream == SND_PCM_STREAM_PLAYBACK) {
 		meter->rptr = *pcm->appl.ptr;
+		snd_pcm_meter_reset_levels(pcm, meter->rptr);
+	}
 	return err;
 }
 
@@ -436,6 +764,19 @@ static int snd_pcm_meter_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 				       snd_pcm_meter_hw_refine_slave);
 }
 
+static void snd_pcm_meter_free_levels(snd_pcm_meter_t *meter)
+{
+	free(meter->levels);
+	free(meter->level_peak);
+	free(meter->level_sum);
+	free(meter->level_clips);
+	meter->levels = NULL;
+	meter->level_peak = NULL;
+	meter->level_sum = NULL;
+	meter->level_clips = NULL;
+	meter->levels_size = 0;
+}
+
 static int snd_pcm_meter_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 {
 	snd_pcm_meter_t *meter = pcm->private_data;
@@ -470,22 +811,41 @@ static int snd_pcm_meter_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 		a->first = 0;
 		a->step = slave->sample_bits;
 	}
-	meter->closed = 0;
-	err = pthread_create(&meter->thread, NULL, snd_pcm_meter_thread, pcm);
-	assert(err == 0);
+	if (snd_pcm_meter_level_shift(slave->format) >= 0) {
+		meter->levels_size = meter->buf_size / LEVEL_FRAMES;
+		meter->levels = calloc(slave->channels * meter->levels_size,
+				       sizeof(*meter->levels));
+		meter->level_peak = calloc(slave->channels, sizeof(*meter->level_peak));
+		meter->level_sum = calloc(slave->channels, sizeof(*meter->level_sum));
+		meter->level_clips = calloc(slave->channels, sizeof(*meter->level_clips));
+		if (!meter->levels || !meter->level_peak || !meter->level_sum ||
+		    !meter->level_clips) {
+			snd_pcm_meter_free_levels(meter);
+			free(meter->buf);
+			free(meter->buf_areas);
+			meter->buf = NULL;
+			meter->buf_areas = NULL;
+			return -ENOMEM;
+		}
+	}
+	err = snd_pcm_meter_service_add(pcm);
+	if (err < 0) {
+		snd_pcm_meter_free_levels(meter);
+		free(meter->buf);
+		free(meter->buf_areas);
+		meter->buf = NULL;
+		meter->buf_areas = NULL;
+		return err;
+	}
 	return 0;
 }
 
 static int snd_pcm_meter_hw_free(snd_pcm_t *pcm)
 {
 	snd_pcm_meter_t *meter = pcm->private_data;
-	int err;
-	meter->closed = 1;
-	pthread_mutex_lock(&meter->running_mutex);
-	pthread_cond_signal(&meter->running_cond);
-	pthread_mutex_unlock(&meter->running_mutex);
-	err = pthread_join(meter->thread, 0);
-	assert(err == 0);
+	snd_pcm_meter_service_remove(pcm);
+	meter->running = 0;
+	snd_pcm_meter_free_levels(meter);
 	free(meter->buf);
 	free(meter->buf_areas);
 	meter->buf = NULL;
@@ -595,11 +955,10 @@ int snd_pcm_meter_open(snd_pcm_t **pcmp, const char *name, unsigned int frequenc
 	pcm->tstamp_type = slave->tstamp_type;
 	snd_pcm_link_hw_ptr(pcm, slave);
 	snd_pcm_link_appl_ptr(pcm, slave);
+	meter->pcm = pcm;
 	*pcmp = pcm;
 
 	pthread_mutex_init(&meter->update_mutex, NULL);
-	pthread_mutex_init(&meter->running_mutex, NULL);
-	pthread_cond_init(&meter->running_cond, NULL);
 	return 0;
 }
 
@@ -731,6 +1090,25 @@ pcm.name {
 }
 \endcode
 
+A single thread updates the scopes of all the meter PCMs in the process,
+each at its own frequency, and it sleeps while none of them is running.
+For S16, S24, S32 and FLOAT in the native endian, the peak and the RMS
+of every block of 128 frames are computed while the frames are copied
+to the meter buffer; scopes read them with snd_pcm_meter_get_levels()
+instead of walking the samples.
+
+The scope type \c shm, built in, publishes these levels with a count of
+the clipped samples in a POSIX shared memory object, so that monitoring
+processes can read them without talking to the audio process (see
+snd_pcm_scope_shm_open()):
+
+\code
+pcm_scope.NAME {
+	type shm
+	path STR		# Shared memory object name, e.g. "/alsa-levels"
+}
+\endcode
+
 \subsection pcm_plugins_meter_funcref Function reference
 
 <UL>
@@ -943,6 +1321,58 @@ snd_pcm_uframes_t snd_pcm_meter_get_boundary(snd_pcm_t *pcm)
 	return meter->gen.slave->boundary;
 }
 
+/**
+ * \brief Get the levels of a channel from a #SND_PCM_TYPE_METER PCM
+ * \param pcm PCM handle
+ * \param channel Channel
+ * \param pos Position of the caller in the level blocks, 0 at first
+ * \param level Returns the levels of the blocks heard since pos
+ * \return number of blocks merged into level, otherwise a negative error code
+ *
+ * The blocks up to the "now" frame pointer are merged, pos is advanced
+ * past them.  -ENXIO is returned for formats without computed levels.
+ */
+int snd_pcm_meter_get_levels(snd_pcm_t *pcm, unsigned int channel,
+			     unsigned long long *pos,
+			     snd_pcm_meter_level_t *level)
+{
+	snd_pcm_meter_t *meter;
+	const snd_pcm_meter_block_t *b;
+	unsigned long long count, ready, sum = 0;
+	snd_pcm_sframes_t frames;
+	unsigned int peak = 0, clips = 0, n = 0;
+	assert(pcm->type == SND_PCM_TYPE_METER);
+	meter = pcm->private_data;
+	assert(meter->gen.slave->setup);
+	if (!meter->levels)
+		return -ENXIO;
+	assert(channel < meter->gen.slave->channels);
+	count = __atomic_load_n(&meter->level_count, __ATOMIC_ACQUIRE);
+	/* playback levels are computed ahead of what is heard */
+	frames = meter->now - meter->level_start;
+	if (frames < 0)
+		frames += meter->gen.slave->boundary;
+	ready = frames / LEVEL_FRAMES;
+	if (count > ready)
+		count = ready;
+	if (*pos > count)
+		*pos = 0;
+	if (count - *pos > meter->levels_size)
+		*pos = count - meter->levels_size;
+	for (; *pos < count; (*pos)++, n++) {
+		b = &meter->levels[channel * meter->levels_size +
+				   *pos % meter->levels_size];
+		if (b->peak > peak)
+			peak = b->peak;
+		sum += b->ms;
+		clips += b->clips;
+	}
+	level->peak = peak;
+	level->clips = clips;
+	level->rms = n ? (unsigned int)sqrt((double)sum / n) : 0;
+	return n;
+}
+
 /**
  * \brief Set name of a #SND_PCM_TYPE_METER PCM scope
  * \param scope PCM meter scope
@@ -1222,6 +1652,228 @@ int16_t *snd_pcm_scope_s16_get_channel_buffer(snd_pcm_scope_t *scope,
 	return s16->buf_areas[channel].addr;
 }
 
+#ifndef DOC_HIDDEN
+typedef struct _snd_pcm_scope_shm {
+	snd_pcm_t *pcm;
+	char *path;
+	int fd;
+	size_t size;
+	snd_pcm_scope_shm_header_t *hdr;
+	snd_pcm_scope_shm_channel_t *channels;
+	unsigned long long *pos;	/* per channel, in the level blocks */
+} snd_pcm_scope_shm_t;
+
+/* writes the levels under the seqlock; zero levels unless update is set */
+static void shm_publish(snd_pcm_scope_shm_t *shm, int running, int update)
+{
+	snd_pcm_scope_shm_header_t *hdr = shm->hdr;
+	snd_pcm_meter_level_t level;
+	unsigned int c, seq = hdr->seq;
+
+	__atomic_store_n(&hdr->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	for (c = 0; c < hdr->channels; c++) {
+		snd_pcm_scope_shm_channel_t *ch = &shm->channels[c];
+		if (update &&
+		    snd_pcm_meter_get_levels(shm->pcm, c, &shm->pos[c], &level) > 0) {
+			ch->peak = level.peak;
+			ch->rms = level.rms;
+			ch->clips += level.clips;
+		} else if (!update) {
+			ch->peak = 0;
+			ch->rms = 0;
+		}
+	}
+	hdr->running = running;
+	hdr->updates++;
+	__atomic_store_n(&hdr->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static int shm_enable(snd_pcm_scope_t *scope)
+{
+	snd_pcm_scope_shm_t *shm = scope->private_data;
+	snd_pcm_meter_t *meter = shm->pcm->private_data;
+	snd_pcm_t *spcm = meter->gen.slave;
+	snd_pcm_meter_level_t level;
+	unsigned long long pos = 0;
+	int err;
+
+	/* the levels come from the meter, fail if it has none */
+	err = snd_pcm_meter_get_levels(shm->pcm, 0, &pos, &level);
+	if (err < 0)
+		return err;
+	shm->pos = calloc(spcm->channels, sizeof(*shm->pos));
+	if (!shm->pos)
+		return -ENOMEM;
+	shm->fd = shm_open(shm->path, O_RDWR | O_CREAT, 0644);
+	if (shm->fd < 0) {
+		err = -errno;
+		SYSERR("shm_open %s failed", shm->path);
+		goto _free;
+	}
+	shm->size = sizeof(*shm->hdr) + spcm->channels * sizeof(*shm->channels);
+	if (ftruncate(shm->fd, shm->size) < 0) {
+		err = -errno;
+		SYSERR("ftruncate %s failed", shm->path);
+		goto _close;
+	}
+	shm->hdr = mmap(NULL, shm->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			shm->fd, 0);
+	if (shm->hdr == MAP_FAILED) {
+		err = -errno;
+		SYSERR("mmap %s failed", shm->path);
+		goto _close;
+	}
+	memset(shm->hdr, 0, shm->size);
+	shm->channels = (snd_pcm_scope_shm_channel_t *)(shm->hdr + 1);
+	shm->hdr->version = SND_PCM_SCOPE_SHM_VERSION;
+	shm->hdr->channels = spcm->channels;
+	shm->hdr->rate = spcm->rate;
+	__atomic_store_n(&shm->hdr->magic, SND_PCM_SCOPE_SHM_MAGIC, __ATOMIC_RELEASE);
+	return 0;
+
+ _close:
+	close(shm->fd);
+	shm_unlink(shm->path);
+ _free:
+	free(shm->pos);
+	shm->pos = NULL;
+	return err;
+}
+
+static void shm_disable(snd_pcm_scope_t *scope)
+{
+	snd_pcm_scope_shm_t *shm = scope->private_data;
+	munmap(shm->hdr, shm->size);
+	close(shm->fd);
+	shm_unlink(shm->path);
+	free(shm->pos);
+	shm->hdr = NULL;
+	shm->pos = NULL;
+}
+
+static void shm_close(snd_pcm_scope_t *scope)
+{
+	snd_pcm_scope_shm_t *shm = scope->private_data;
+	free(shm->path);
+	free(shm);
+}
+
+static void shm_start(snd_pcm_scope_t *scope)
+{
+	shm_publish(scope->private_data, 1, 0);
+}
+
+static void shm_stop(snd_pcm_scope_t *scope)
+{
+	shm_publish(scope->private_data, 0, 0);
+}
+
+static void shm_update(snd_pcm_scope_t *scope)
+{
+	shm_publish(scope->private_data, 1, 1);
+}
+
+static void shm_reset(snd_pcm_scope_t *scope)
+{
+	shm_publish(scope->private_data, 1, 0);
+}
+
+static const snd_pcm_scope_ops_t shm_ops = {
+	.enable = shm_enable,
+	.disable = shm_disable,
+	.close = shm_close,
+	.start = shm_start,
+	.stop = shm_stop,
+	.update = shm_update,
+	.reset = shm_reset,
+};
+#endif
+
+/**
+ * \brief Add a scope publishing the levels in shared memory to a #SND_PCM_TYPE_METER PCM
+ * \param pcm The pcm handle
+ * \param name Scope name
+ * \param path Name of the POSIX shared memory object, e.g. "/alsa-levels"
+ * \param scopep Pointer to newly created and added scope
+ * \return 0 on success otherwise a negative error code
+ *
+ * While the PCM is set up, the object holds a #snd_pcm_scope_shm_header_t
+ * followed by the per channel levels, refreshed at the meter frequency.
+ * Other processes map it read-only and use the seqlock described with
+ * the header; the object is removed when the PCM is freed.
+ */
+int snd_pcm_scope_shm_open(snd_pcm_t *pcm, const char *name,
+			   const char *path, snd_pcm_scope_t **scopep)
+{
+	snd_pcm_meter_t *meter;
+	snd_pcm_scope_t *scope;
+	snd_pcm_scope_shm_t *shm;
+	assert(pcm->type == SND_PCM_TYPE_METER);
+	assert(path);
+	meter = pcm->private_data;
+	scope = calloc(1, sizeof(*scope));
+	if (!scope)
+		return -ENOMEM;
+	shm = calloc(1, sizeof(*shm));
+	if (!shm) {
+		free(scope);
+		return -ENOMEM;
+	}
+	shm->path = strdup(path);
+	if (!shm->path) {
+		free(shm);
+		free(scope);
+		return -ENOMEM;
+	}
+	if (name)
+		scope->name = strdup(name);
+	shm->pcm = pcm;
+	shm->fd = -1;
+	scope->ops = &shm_ops;
+	scope->private_data = shm;
+	list_add_tail(&scope->list, &meter->scopes);
+	*scopep = scope;
+	return 0;
+}
+
+#ifndef DOC_HIDDEN
+int _snd_pcm_scope_shm_open(snd_pcm_t *pcm, const char *name,
+			    snd_config_t *root ATTRIBUTE_UNUSED,
+			    snd_config_t *conf)
+{
+	snd_config_iterator_t i, next;
+	snd_pcm_scope_t *scope;
+	const char *path = NULL;
+	int err;
+	snd_config_for_each(i, next, conf) {
+		snd_config_t *n = snd_config_iterator_entry(i);
+		const char *id;
+		if (snd_config_get_id(n, &id) < 0)
+			continue;
+		if (strcmp(id, "comment") == 0)
+			continue;
+		if (strcmp(id, "type") == 0)
+			continue;
+		if (strcmp(id, "path") == 0) {
+			err = snd_config_get_string(n, &path);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				return -EINVAL;
+			}
+			continue;
+		}
+		SNDERR("Unknown field %s", id);
+		return -EINVAL;
+	}
+	if (!path) {
+		SNDERR("path is not defined");
+		return -EINVAL;
+	}
+	return snd_pcm_scope_shm_open(pcm, name, path, &scope);
+}
+#endif
+
 /**
  * \brief allocate an invalid #snd_pcm_scope_t using standard malloc
  * \param ptr returned pointer
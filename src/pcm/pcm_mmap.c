@@ -397,7 +397,7 @@ int snd_pcm_mmap(snd_pcm_t *pcm)
 			return -ENOSYS;
 #endif
 		case SND_PCM_AREA_LOCAL:
-			ptr = malloc(size);
+			ptr = snd_pcm_mem_alloc(pcm, size);
 			if (ptr == NULL) {
 				SYSERR("malloc failed");
 				return -errno;
@@ -438,6 +438,48 @@ int snd_pcm_mmap(snd_pcm_t *pcm)
 	return 0;
 }
 
+/* locks (and so faults in) the mmapped areas of pcm, once per mmap */
+int snd_pcm_mmap_lock_areas(snd_pcm_t *pcm)
+{
+	size_t page = sysconf(_SC_PAGESIZE);
+	unsigned int c, c1;
+
+	if (!pcm->mmap_channels || pcm->mmap_locked)
+		return 0;
+	for (c = 0; c < pcm->channels; ++c) {
+		snd_pcm_channel_info_t *i = &pcm->mmap_channels[c];
+		size_t size, ofs;
+		char *addr;
+
+		if (!i->addr)
+			continue;
+		for (c1 = 0; c1 < c; ++c1)
+			if (pcm->mmap_channels[c1].addr == i->addr)
+				break;
+		if (c1 < c)
+			continue;
+		size = i->first + i->step * (pcm->buffer_size - 1) + pcm->sample_bits;
+		for (c1 = c + 1; c1 < pcm->channels; ++c1) {
+			snd_pcm_channel_info_t *i1 = &pcm->mmap_channels[c1];
+			size_t s;
+			if (i1->addr != i->addr)
+				continue;
+			s = i1->first + i1->step * (pcm->buffer_size - 1) + pcm->sample_bits;
+			if (s > size)
+				size = s;
+		}
+		size = (size + 7) / 8;
+		ofs = (unsigned long)i->addr % page;
+		addr = (char *)i->addr - ofs;
+		if (mlock(addr, size + ofs) < 0) {
+			SYSERR("mlock failed");
+			return -errno;
+		}
+	}
+	pcm->mmap_locked = 1;
+	return 0;
+}
+
 int snd_pcm_munmap(snd_pcm_t *pcm)
 {
 	int err;
@@ -503,7 +545,7 @@ int snd_pcm_munmap(snd_pcm_t *pcm)
 			return -ENOSYS;
 #endif
 		case SND_PCM_AREA_LOCAL:
-			free(i->addr);
+			snd_pcm_mem_free(i->addr);
 			break;
 		default:
 			assert(0);
@@ -520,6 +562,7 @@ int snd_pcm_munmap(snd_pcm_t *pcm)
 	free(pcm->running_areas);
 	pcm->mmap_channels = NULL;
 	pcm->running_areas = NULL;
+	pcm->mmap_locked = 0;
 	return 0;
 }
 
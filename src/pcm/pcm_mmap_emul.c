@@ -42,6 +42,7 @@ const char *_snd_module_pcm_mmap_emul = "";
 typedef struct {
 	snd_pcm_generic_t gen;
 	unsigned int mmap_emul :1;
+	unsigned int bypass :1;
 	snd_pcm_uframes_t hw_ptr;
 	snd_pcm_uframes_t appl_ptr;
 	snd_pcm_uframes_t start_threshold;
@@ -139,6 +140,35 @@ static int snd_pcm_mmap_emul_hw_refine(snd_pcm_t *pcm,
 	return 0;
 }
 
+static const snd_pcm_fast_ops_t snd_pcm_mmap_emul_fast_ops;
+
+/*
+ * Without the emulation the fast ops would only forward to the slave:
+ * share its pointers and let the callers reach its fast ops directly.
+ */
+static void mmap_emul_bypass(snd_pcm_t *pcm, int bypass)
+{
+	mmap_emul_t *map = pcm->private_data;
+	snd_pcm_t *slave = map->gen.slave;
+
+	if (bypass && !map->bypass) {
+		snd_pcm_link_hw_ptr(pcm, slave);
+		snd_pcm_link_appl_ptr(pcm, slave);
+	} else if (!bypass && map->bypass) {
+		snd_pcm_unlink_hw_ptr(pcm, slave);
+		snd_pcm_unlink_appl_ptr(pcm, slave);
+		snd_pcm_set_hw_ptr(pcm, &map->hw_ptr, -1, 0);
+		snd_pcm_set_appl_ptr(pcm, &map->appl_ptr, -1, 0);
+	}
+	map->bypass = bypass;
+	if (bypass) {
+		snd_pcm_generic_bypass(pcm);
+	} else {
+		pcm->fast_ops = &snd_pcm_mmap_emul_fast_ops;
+		pcm->fast_op_arg = pcm;
+	}
+}
+
 /*
  * hw_params needs a similar hack like hw_refine, but it's much simpler
  * because now snd_pcm_hw_params_t takes only one choice for each item.
@@ -149,6 +179,10 @@ static int snd_pcm_mmap_emul_hw_refine(snd_pcm_t *pcm,
  * In mmap_emul mode, the appl_ptr and hw_ptr are handled individually
  * from the layering slave PCM, and they are sync'ed appropriately in
  * each read/write or avail_update/commit call.
+ *
+ * A slave doing RW over its own mmapped buffer (mmap_rw) doesn't need
+ * the emulation: its buffer is shared and committed to directly, as for
+ * a slave supporting mmap access.  In both cases this PCM is bypassed.
  */
 static int snd_pcm_mmap_emul_hw_params(snd_pcm_t *pcm,
 				       snd_pcm_hw_params_t *params)
@@ -160,9 +194,13 @@ static int snd_pcm_mmap_emul_hw_params(snd_pcm_t *pcm,
 	snd_pcm_access_mask_t *pmask;
 	int err;
 
+	mmap_emul_bypass(pcm, 0);
 	err = _snd_pcm_hw_params_internal(map->gen.slave, params);
 	if (err >= 0) {
+		/* the slave mmaps: share its buffer */
 		map->mmap_emul = 0;
+		pcm->mmap_shadow = 1;
+		mmap_emul_bypass(pcm, 1);
 		return err;
 	}
 
@@ -193,10 +231,22 @@ static int snd_pcm_mmap_emul_hw_params(snd_pcm_t *pcm,
 	/* need to back the access type to relieve apps */
 	*pmask = oldmask;
 
-	/* OK, we do fake */
-	map->mmap_emul = 1;
 	map->appl_ptr = 0;
 	map->hw_ptr = 0;
+	if (map->gen.slave->mmap_rw && map->gen.slave->running_areas) {
+		/* the slave implements RW on its own mmapped buffer (ioplug
+		 * with mmap_rw, for example): use that buffer as ours and
+		 * commit to it, saving the copy through our buffer
+		 */
+		map->mmap_emul = 0;
+		pcm->mmap_shadow = 1;
+		mmap_emul_bypass(pcm, 1);
+		return 0;
+	}
+
+	/* OK, we do fake */
+	map->mmap_emul = 1;
+	pcm->mmap_shadow = 0;
 	snd_pcm_set_hw_ptr(pcm, &map->hw_ptr, -1, 0);
 	snd_pcm_set_appl_ptr(pcm, &map->appl_ptr, -1, 0);
 	return 0;
@@ -206,6 +256,14 @@ static int snd_pcm_mmap_emul_hw_params(snd_pcm_t *pcm,
 	return err;
 }
 
+static int snd_pcm_mmap_emul_hw_free(snd_pcm_t *pcm)
+{
+	int err = snd_pcm_generic_hw_free(pcm);
+
+	mmap_emul_bypass(pcm, 0);
+	return err;
+}
+
 static int snd_pcm_mmap_emul_sw_params(snd_pcm_t *pcm,
 				       snd_pcm_sw_params_t *params)
 {
@@ -317,12 +375,7 @@ static snd_pcm_sframes_t
 snd_pcm_mmap_emul_mmap_commit(snd_pcm_t *pcm, snd_pcm_uframes_t offset,
 			      snd_pcm_uframes_t size)
 {
-	mmap_emul_t *map = pcm->private_data;
-	snd_pcm_t *slave = map->gen.slave;
-
 	snd_pcm_mmap_appl_forward(pcm, size);
-	if (!map->mmap_emul)
-		return snd_pcm_mmap_commit(slave, offset, size);
 	if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
 		sync_slave_write(pcm);
 	return size;
@@ -333,7 +386,7 @@ static snd_pcm_sframes_t snd_pcm_mmap_emul_avail_update(snd_pcm_t *pcm)
 	mmap_emul_t *map = pcm->private_data;
 	snd_pcm_t *slave = map->gen.slave;
 
-	if (!map->mmap_emul || pcm->stream == SND_PCM_STREAM_PLAYBACK)
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
 		map->hw_ptr = *slave->hw.ptr;
 	else
 		sync_slave_read(pcm);
@@ -358,7 +411,7 @@ static const snd_pcm_ops_t snd_pcm_mmap_emul_ops = {
 	.info = snd_pcm_generic_info,
 	.hw_refine = snd_pcm_mmap_emul_hw_refine,
 	.hw_params = snd_pcm_mmap_emul_hw_params,
-	.hw_free = snd_pcm_generic_hw_free,
+	.hw_free = snd_pcm_mmap_emul_hw_free,
 	.sw_params = snd_pcm_mmap_emul_sw_params,
 	.channel_info = snd_pcm_generic_channel_info,
 	.dump = snd_pcm_mmap_emul_dump,
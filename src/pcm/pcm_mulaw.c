@@ -31,6 +31,7 @@
 #include "pcm_plugin.h"
 
 #include "plugin_ops.h"
+#include "plugin_block_ops.h"
 
 #ifndef PIC
 /* entry for static linking */
@@ -156,6 +157,54 @@ static int ulaw_to_s16(unsigned char u_val)
 	return ((u_val & 0x80) ? (0x84 - t) : (t - 0x84));
 }
 
+/*
+ * Lookup tables built from the functions above: the decoder maps all 256
+ * codes, the encoder is indexed by the sample magnitude without the two
+ * low bits (which never change the code, the bias being a multiple of
+ * four), the sign only selects the XOR mask.  The last entry covers the
+ * magnitude of -32768.
+ */
+static int16_t mulaw_decode_table[256];
+static unsigned char mulaw_encode_table[0x8000 / 4 + 1];
+
+static void mulaw_init_tables(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < 256; i++)
+		mulaw_decode_table[i] = ulaw_to_s16(i);
+	for (i = 0; i < 0x8000 / 4; i++)
+		mulaw_encode_table[i] = s16_to_ulaw(i << 2) ^ 0xff;
+	mulaw_encode_table[i] = mulaw_encode_table[i - 1];
+}
+
+#ifdef THREAD_SAFE_API
+static pthread_once_t mulaw_tables_once = PTHREAD_ONCE_INIT;
+
+static inline void mulaw_tables(void)
+{
+	pthread_once(&mulaw_tables_once, mulaw_init_tables);
+}
+#else
+static int mulaw_tables_ready;
+
+static inline void mulaw_tables(void)
+{
+	if (!mulaw_tables_ready) {
+		mulaw_init_tables();
+		mulaw_tables_ready = 1;
+	}
+}
+#endif
+
+static inline unsigned char mulaw_encode_sample(int16_t sample)
+{
+	int sign = sample >> 15;
+	unsigned int mag = (sample ^ sign) - sign;
+
+	return mulaw_encode_table[mag >> 2] ^ (0xff ^ (sign & 0x80));
+}
+
 #ifndef DOC_HIDDEN
 
 void snd_pcm_mulaw_decode(const snd_pcm_channel_area_t *dst_areas,
@@ -170,6 +219,24 @@ void snd_pcm_mulaw_decode(const snd_pcm_channel_area_t *dst_areas,
 #undef PUT16_LABELS
 	void *put = put16_labels[putidx];
 	unsigned int channel;
+
+	mulaw_tables();
+	/* interleaved to native S16: one run over frames * channels samples */
+	if (putidx == (unsigned int)snd_pcm_linear_put_index(SND_PCM_FORMAT_S16,
+							     SND_PCM_FORMAT_S16)) {
+		const unsigned char *src;
+		int16_t *dst;
+		src = (const unsigned char *)snd_pcm_block_areas_addr(src_areas, src_offset,
+								       channels, 8);
+		dst = (int16_t *)snd_pcm_block_areas_addr(dst_areas, dst_offset,
+							  channels, 16);
+		if (src && dst) {
+			size_t i, samples = (size_t)frames * channels;
+			for (i = 0; i < samples; i++)
+				dst[i] = mulaw_decode_table[src[i]];
+			return;
+		}
+	}
 	for (channel = 0; channel < channels; ++channel) {
 		const unsigned char *src;
 		char *dst;
@@ -183,7 +250,7 @@ void snd_pcm_mulaw_decode(const snd_pcm_channel_area_t *dst_areas,
 		dst_step = snd_pcm_channel_area_step(dst_area);
 		frames1 = frames;
 		while (frames1-- > 0) {
-			int16_t sample = ulaw_to_s16(*src);
+			int16_t sample = mulaw_decode_table[*src];
 			goto *put;
 #define PUT16_END after
 #include "plugin_ops.h"
@@ -208,6 +275,24 @@ void snd_pcm_mulaw_encode(const snd_pcm_channel_area_t *dst_areas,
 	void *get = get16_labels[getidx];
 	unsigned int channel;
 	int16_t sample = 0;
+
+	mulaw_tables();
+	/* native S16 interleaved: one run over frames * channels samples */
+	if (getidx == (unsigned int)snd_pcm_linear_get_index(SND_PCM_FORMAT_S16,
+							     SND_PCM_FORMAT_S16)) {
+		const int16_t *src;
+		unsigned char *dst;
+		src = (const int16_t *)snd_pcm_block_areas_addr(src_areas, src_offset,
+								channels, 16);
+		dst = (unsigned char *)snd_pcm_block_areas_addr(dst_areas, dst_offset,
+								 channels, 8);
+		if (src && dst) {
+			size_t i, samples = (size_t)frames * channels;
+			for (i = 0; i < samples; i++)
+				dst[i] = mulaw_encode_sample(src[i]);
+			return;
+		}
+	}
 	for (channel = 0; channel < channels; ++channel) {
 		const char *src;
 		char *dst;
@@ -226,7 +311,7 @@ void snd_pcm_mulaw_encode(const snd_pcm_channel_area_t *dst_areas,
 #include "plugin_ops.h"
 #undef GET16_END
 		after:
-			*dst = s16_to_ulaw(sample);
+			*dst = mulaw_encode_sample(sample);
 			src += src_step;
 			dst += dst_step;
 		}
@@ -402,6 +487,7 @@ static void snd_pcm_mulaw_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
 	}
+	snd_pcm_plugin_dump_profile(pcm, out);
 	snd_output_printf(out, "Slave: ");
 	snd_pcm_dump(mulaw->plug.gen.slave, out);
 }
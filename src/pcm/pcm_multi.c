@@ -33,6 +33,7 @@
 #include <math.h>
 #include "pcm_local.h"
 #include "pcm_generic.h"
+#include "pcm_rate.h"
 
 #ifndef PIC
 /* entry for static linking */
@@ -41,11 +42,57 @@ const char *_snd_module_pcm_multi = "";
 
 #ifndef DOC_HIDDEN
 
+/* spins of the caller waiting for the workers before it sleeps */
+#define SND_PCM_MULTI_SPIN	4096
+
+/* drift compensation: nsecs between two clock estimates */
+#define SND_PCM_MULTI_DRIFT_INTERVAL	500000000LL
+/* largest clock mismatch believed, beyond it the estimate is dropped */
+#define SND_PCM_MULTI_DRIFT_MAX		0.002
+/* weight of the previous ratio estimate */
+#define SND_PCM_MULTI_DRIFT_SMOOTH	8
+/* seconds spent absorbing a latency mismatch to the master */
+#define SND_PCM_MULTI_DRIFT_SETTLE	4
+
+/*
+ * A slave not running from the master clock gets the bound channels
+ * from a ring of its own instead of sharing the buffer.  The committed
+ * frames are resampled into the slave a block at a time, each block
+ * becoming block - 1, block or block + 1 frames as the clock ratio
+ * estimated from the timestamps requires.
+ */
+typedef struct {
+	snd_pcm_channel_area_t *ring;	/* slave channels, buffer_size frames */
+	snd_pcm_channel_area_t *in;	/* a block of the ring, unwrapped */
+	snd_pcm_channel_area_t *out;	/* a resampled block */
+	void *buf;
+	snd_pcm_uframes_t block;
+	snd_pcm_uframes_t ring_ptr;	/* next ring frame to resample */
+	snd_pcm_uframes_t queued;	/* committed frames not resampled yet */
+	unsigned long long fed;		/* frames written to the slave */
+	void *obj;			/* linear converter of the rate plugin */
+	snd_pcm_rate_ops_t ops;
+	snd_pcm_rate_info_t info;
+	int dir;			/* direction the converter is set up for */
+	int step;			/* block size difference it is set up for */
+	double ratio;			/* slave clock / master clock */
+	double q;			/* ratio corrected for the latency offset */
+	double acc;			/* fraction of an output frame owed */
+	int tstamp_valid;
+	unsigned long long spos, mpos;	/* frames played at the last estimate */
+	snd_htimestamp_t sts, mts;
+} snd_pcm_multi_drift_t;
+
 typedef struct {
 	snd_pcm_t *pcm;
 	unsigned int channels_count;
 	int close_slave;
 	snd_pcm_t *linked;
+	snd_pcm_sframes_t result;	/* of the last job run by the workers */
+	unsigned long long calls;	/* service timing with threads set */
+	unsigned long long nsecs;
+	unsigned long long max_nsecs;
+	snd_pcm_multi_drift_t *drift;	/* with drift set, for all but the master */
 } snd_pcm_multi_slave_t;
 
 typedef struct {
@@ -60,8 +107,497 @@ typedef struct {
 	snd_pcm_multi_slave_t *slaves;
 	unsigned int channels_count;
 	snd_pcm_multi_channel_t *channels;
+	int threads;			/* service each slave from its own thread */
+	struct snd_pcm_multi_pool *pool;
+	int drift;			/* compensate the slave clock drift */
+	unsigned long long committed;	/* frames committed since prepare */
+	struct timespec drift_ts;	/* time of the last clock estimate */
 } snd_pcm_multi_t;
 
+enum {
+	SND_PCM_MULTI_JOB_COMMIT,
+	SND_PCM_MULTI_JOB_AVAIL,
+};
+
+#ifdef THREAD_SAFE_API
+typedef struct snd_pcm_multi_worker {
+	pthread_t thread;
+	snd_pcm_multi_t *multi;
+	unsigned int idx;		/* slave serviced by this worker */
+} snd_pcm_multi_worker_t;
+
+/*
+ * Slave 0 is serviced by the caller, every other slave has a worker.
+ * A job is started by bumping the generation; the caller waits until
+ * pending drops to zero.
+ */
+typedef struct snd_pcm_multi_pool {
+	pthread_mutex_t mutex;
+	pthread_cond_t start;
+	pthread_cond_t done;
+	unsigned int nworkers;
+	snd_pcm_multi_worker_t *workers;
+	int quit;
+	unsigned int generation;	/* current job */
+	int op;
+	snd_pcm_uframes_t offset;
+	snd_pcm_uframes_t size;
+	unsigned int pending;		/* workers still running */
+} snd_pcm_multi_pool_t;
+#endif
+
+#endif
+
+static void snd_pcm_multi_drift_free(snd_pcm_multi_slave_t *slave)
+{
+	snd_pcm_multi_drift_t *drift = slave->drift;
+
+	if (!drift)
+		return;
+	if (drift->obj) {
+		if (drift->dir && drift->ops.free)
+			drift->ops.free(drift->obj);
+		if (drift->ops.close)
+			drift->ops.close(drift->obj);
+	}
+	free(drift->ring);
+	free(drift->buf);
+	free(drift);
+	slave->drift = NULL;
+}
+
+static void snd_pcm_multi_drift_reset(snd_pcm_multi_drift_t *drift)
+{
+	drift->ring_ptr = 0;
+	drift->queued = 0;
+	drift->fed = 0;
+	drift->acc = 0;
+	drift->tstamp_valid = 0;
+	if (drift->dir && drift->ops.reset)
+		drift->ops.reset(drift->obj);
+}
+
+/* called from hw_params, when the slave is set up but pcm is not yet */
+static int snd_pcm_multi_drift_new(snd_pcm_multi_slave_t *slave)
+{
+#ifdef BUILD_PCM_PLUGIN_RATE
+	extern int SND_PCM_RATE_PLUGIN_ENTRY(linear) (unsigned int version, void **objp, snd_pcm_rate_ops_t *ops);
+	snd_pcm_t *spcm = slave->pcm;
+	snd_pcm_multi_drift_t *drift;
+	unsigned int c, channels = spcm->channels;
+	unsigned int width = snd_pcm_format_physical_width(spcm->format);
+	size_t bytes;
+	char *p;
+	int err;
+
+	if (snd_pcm_format_linear(spcm->format) != 1) {
+		SNDERR("drift compensation needs a linear format");
+		return -EINVAL;
+	}
+	drift = calloc(1, sizeof(*drift));
+	if (!drift)
+		return -ENOMEM;
+	slave->drift = drift;
+	drift->block = spcm->period_size;
+	drift->ratio = drift->q = 1.0;
+	drift->ring = calloc(3 * channels, sizeof(*drift->ring));
+	bytes = (size_t)(spcm->buffer_size + 2 * drift->block + 1) * width / 8;
+	drift->buf = malloc(bytes * channels);
+	if (!drift->ring || !drift->buf) {
+		snd_pcm_multi_drift_free(slave);
+		return -ENOMEM;
+	}
+	drift->in = drift->ring + channels;
+	drift->out = drift->in + channels;
+	/* each channel keeps its ring, one input and one output block */
+	for (c = 0, p = drift->buf; c < channels; c++, p += bytes) {
+		drift->ring[c].addr = p;
+		drift->ring[c].first = 0;
+		drift->ring[c].step = width;
+		drift->in[c] = drift->ring[c];
+		drift->in[c].addr = p + spcm->buffer_size * width / 8;
+		drift->out[c] = drift->in[c];
+		drift->out[c].addr = (char *)drift->in[c].addr + drift->block * width / 8;
+	}
+	snd_pcm_areas_silence(drift->ring, 0, channels, spcm->buffer_size, spcm->format);
+	err = SND_PCM_RATE_PLUGIN_ENTRY(linear)(SND_PCM_RATE_PLUGIN_VERSION,
+						&drift->obj, &drift->ops);
+	if (err < 0) {
+		drift->obj = NULL;
+		snd_pcm_multi_drift_free(slave);
+		return err;
+	}
+	drift->info.in.format = drift->info.out.format = spcm->format;
+	drift->info.in.buffer_size = drift->info.out.buffer_size = spcm->buffer_size;
+	drift->info.channels = channels;
+	return 0;
+#else
+	SNDERR("drift compensation needs the rate plugin");
+	return -ENOSYS;
+#endif
+}
+
+/*
+ * Sets the converter up for turning a block into block + step frames.
+ * It is only initialized once the direction of the drift is known, so
+ * streams on a common clock are copied as they are.
+ */
+static int snd_pcm_multi_drift_pitch(snd_pcm_multi_drift_t *drift,
+				     snd_pcm_t *spcm, int step)
+{
+	int err;
+
+	if (step && step != drift->dir) {
+		if (drift->dir && drift->ops.free)
+			drift->ops.free(drift->obj);
+		drift->dir = 0;
+		/* the rates only pick expanding or shrinking */
+		drift->info.in.rate = spcm->rate;
+		drift->info.out.rate = spcm->rate + step;
+		drift->info.in.period_size = drift->block;
+		drift->info.out.period_size = drift->block + step;
+		err = drift->ops.init(drift->obj, &drift->info);
+		if (err < 0)
+			return err;
+		if (drift->ops.reset)
+			drift->ops.reset(drift->obj);
+		drift->dir = step;
+		drift->step = INT_MAX;
+	}
+	if (drift->dir && step != drift->step) {
+		drift->info.out.period_size = drift->block + step;
+		err = drift->ops.adjust_pitch(drift->obj, &drift->info);
+		if (err < 0)
+			return err;
+		drift->step = step;
+	}
+	return 0;
+}
+
+/* resamples the complete blocks the slave has room for */
+static int snd_pcm_multi_drift_feed(snd_pcm_multi_slave_t *slave, int flush)
+{
+	snd_pcm_multi_drift_t *drift = slave->drift;
+	snd_pcm_t *spcm = slave->pcm;
+	const snd_pcm_channel_area_t *src, *areas;
+	snd_pcm_uframes_t block, out, src_ofs, xfer, offset, frames;
+	snd_pcm_sframes_t avail, result;
+	double acc;
+	int step, err;
+
+	while (drift->queued >= drift->block || (flush && drift->queued)) {
+		block = drift->block;
+		acc = drift->acc + block * (drift->q - 1.0);
+		step = acc >= 0.5 ? 1 : acc <= -0.5 ? -1 : 0;
+		if (drift->queued < block) {
+			/* the tail of a drain goes unchanged */
+			block = drift->queued;
+			step = 0;
+		}
+		out = block + step;
+		avail = snd_pcm_avail_update(spcm);
+		if (avail < 0)
+			return avail;
+		if ((snd_pcm_uframes_t)avail < out)
+			break;
+		src = drift->ring;
+		src_ofs = drift->ring_ptr;
+		if (src_ofs + block > spcm->buffer_size) {
+			snd_pcm_areas_copy_wrap(drift->in, 0, block, drift->ring,
+						src_ofs, spcm->buffer_size,
+						spcm->channels, block, spcm->format);
+			src = drift->in;
+			src_ofs = 0;
+		}
+		err = snd_pcm_multi_drift_pitch(drift, spcm, step);
+		if (err < 0)
+			return err;
+		if (drift->dir && block == drift->block) {
+			drift->ops.convert(drift->obj, drift->out, 0, out,
+					   src, src_ofs, block);
+			src = drift->out;
+			src_ofs = 0;
+		}
+		for (xfer = 0; xfer < out; xfer += frames) {
+			frames = out - xfer;
+			err = snd_pcm_mmap_begin(spcm, &areas, &offset, &frames);
+			if (err < 0)
+				return err;
+			snd_pcm_areas_copy(areas, offset, src, src_ofs + xfer,
+					   spcm->channels, frames, spcm->format);
+			result = snd_pcm_mmap_commit(spcm, offset, frames);
+			if (result < 0)
+				return result;
+			if ((snd_pcm_uframes_t)result != frames)
+				return -EIO;
+		}
+		acc -= step;
+		drift->acc = acc > 1.0 ? 1.0 : acc < -1.0 ? -1.0 : acc;
+		drift->ring_ptr = (drift->ring_ptr + block) % spcm->buffer_size;
+		drift->queued -= block;
+		drift->fed += out;
+	}
+	return 0;
+}
+
+static long long snd_pcm_multi_drift_nsecs(const snd_htimestamp_t *a,
+					   const snd_htimestamp_t *b)
+{
+	return (b->tv_sec - a->tv_sec) * 1000000000LL + b->tv_nsec - a->tv_nsec;
+}
+
+/*
+ * Compares how fast each slave plays to the master from the timestamps
+ * of their last pointer updates, and how far behind or ahead of it the
+ * slave has got.  Both make the ratio the blocks get resampled with.
+ */
+static void snd_pcm_multi_drift_estimate(snd_pcm_t *pcm)
+{
+	snd_pcm_multi_t *multi = pcm->private_data;
+	snd_pcm_t *master = multi->slaves[multi->master_slave].pcm;
+	snd_pcm_uframes_t mavail, savail;
+	snd_htimestamp_t now, mts, sts;
+	unsigned long long mpos, spos;
+	long long mdt, sdt;
+	double ratio, err;
+	unsigned int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (snd_pcm_multi_drift_nsecs(&multi->drift_ts, &now) < SND_PCM_MULTI_DRIFT_INTERVAL)
+		return;
+	multi->drift_ts = now;
+	if (snd_pcm_state(master) != SND_PCM_STATE_RUNNING)
+		return;
+	if (snd_pcm_htimestamp(master, &mavail, &mts) < 0)
+		return;
+	if (mavail > master->buffer_size)
+		return;
+	mpos = multi->committed - (master->buffer_size - mavail);
+	for (i = 0; i < multi->slaves_count; ++i) {
+		snd_pcm_multi_drift_t *drift = multi->slaves[i].drift;
+		snd_pcm_t *spcm = multi->slaves[i].pcm;
+		if (!drift)
+			continue;
+		if (snd_pcm_htimestamp(spcm, &savail, &sts) < 0 ||
+		    savail > spcm->buffer_size)
+			continue;
+		spos = drift->fed - (spcm->buffer_size - savail);
+		if (drift->tstamp_valid) {
+			mdt = snd_pcm_multi_drift_nsecs(&drift->mts, &mts);
+			sdt = snd_pcm_multi_drift_nsecs(&drift->sts, &sts);
+			if (mdt <= 0 || sdt <= 0 ||
+			    mpos <= drift->mpos || spos <= drift->spos)
+				goto next;
+			ratio = ((double)(spos - drift->spos) / sdt) /
+				((double)(mpos - drift->mpos) / mdt);
+			if (fabs(ratio - 1.0) <= SND_PCM_MULTI_DRIFT_MAX)
+				drift->ratio += (ratio - drift->ratio) / SND_PCM_MULTI_DRIFT_SMOOTH;
+			/* frames the slave lags the master by, in master frames */
+			err = drift->queued +
+			      (spcm->buffer_size - savail) / drift->ratio -
+			      (master->buffer_size - mavail);
+			err /= (double)master->rate * SND_PCM_MULTI_DRIFT_SETTLE;
+			if (err > SND_PCM_MULTI_DRIFT_MAX)
+				err = SND_PCM_MULTI_DRIFT_MAX;
+			else if (err < -SND_PCM_MULTI_DRIFT_MAX)
+				err = -SND_PCM_MULTI_DRIFT_MAX;
+			drift->q = drift->ratio * (1.0 - err);
+		}
+	next:
+		drift->tstamp_valid = 1;
+		drift->mpos = mpos;
+		drift->spos = spos;
+		drift->mts = mts;
+		drift->sts = sts;
+	}
+}
+
+static void snd_pcm_multi_drift_restart(snd_pcm_multi_t *multi)
+{
+	unsigned int i;
+
+	multi->committed = 0;
+	for (i = 0; i < multi->slaves_count; ++i) {
+		if (multi->slaves[i].drift)
+			snd_pcm_multi_drift_reset(multi->slaves[i].drift);
+	}
+}
+
+static snd_pcm_sframes_t snd_pcm_multi_slave_commit(snd_pcm_multi_t *multi, unsigned int idx,
+						    snd_pcm_uframes_t offset,
+						    snd_pcm_uframes_t size)
+{
+	snd_pcm_multi_slave_t *slave = &multi->slaves[idx];
+	snd_pcm_sframes_t result;
+
+	if (slave->drift) {
+		slave->drift->queued += size;
+		result = snd_pcm_multi_drift_feed(slave, 0);
+		return result < 0 ? result : (snd_pcm_sframes_t)size;
+	}
+	result = snd_pcm_mmap_commit(slave->pcm, offset, size);
+	if (result >= 0 && (snd_pcm_uframes_t)result != size)
+		return -EIO;
+	return result;
+}
+
+static snd_pcm_sframes_t snd_pcm_multi_slave_avail(snd_pcm_multi_t *multi, unsigned int idx)
+{
+	snd_pcm_multi_slave_t *slave = &multi->slaves[idx];
+	int err;
+
+	if (slave->drift) {
+		/* the room in the ring bounds what the application may write */
+		err = snd_pcm_multi_drift_feed(slave, 0);
+		if (err < 0)
+			return err;
+		return slave->pcm->buffer_size - slave->drift->queued;
+	}
+	return snd_pcm_avail_update(slave->pcm);
+}
+
+#ifdef THREAD_SAFE_API
+/* runs one job on a slave, recording its duration with threads set */
+static void snd_pcm_multi_service(snd_pcm_multi_t *multi, unsigned int idx, int op,
+				  snd_pcm_uframes_t offset, snd_pcm_uframes_t size)
+{
+	snd_pcm_multi_slave_t *slave = &multi->slaves[idx];
+	struct timespec t0, t1;
+	unsigned long long ns;
+	snd_pcm_sframes_t result;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	if (op == SND_PCM_MULTI_JOB_COMMIT)
+		result = snd_pcm_multi_slave_commit(multi, idx, offset, size);
+	else
+		result = snd_pcm_multi_slave_avail(multi, idx);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	ns = (t1.tv_sec - t0.tv_sec) * 1000000000ULL + t1.tv_nsec - t0.tv_nsec;
+	slave->result = result;
+	slave->calls++;
+	slave->nsecs += ns;
+	if (ns > slave->max_nsecs)
+		slave->max_nsecs = ns;
+}
+
+static void *snd_pcm_multi_worker_thread(void *arg)
+{
+	snd_pcm_multi_worker_t *worker = arg;
+	snd_pcm_multi_pool_t *pool = worker->multi->pool;
+	unsigned int generation = 0;	/* a job may be posted before we run */
+	snd_pcm_uframes_t offset, size;
+	int op;
+
+	pthread_mutex_lock(&pool->mutex);
+	for (;;) {
+		while (!pool->quit && pool->generation == generation)
+			pthread_cond_wait(&pool->start, &pool->mutex);
+		if (pool->quit)
+			break;
+		generation = pool->generation;
+		op = pool->op;
+		offset = pool->offset;
+		size = pool->size;
+		pthread_mutex_unlock(&pool->mutex);
+		snd_pcm_multi_service(worker->multi, worker->idx, op, offset, size);
+		if (__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+			pthread_mutex_lock(&pool->mutex);
+			pthread_cond_signal(&pool->done);
+			pthread_mutex_unlock(&pool->mutex);
+		}
+		pthread_mutex_lock(&pool->mutex);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+static void snd_pcm_multi_pool_free(snd_pcm_multi_t *multi)
+{
+	snd_pcm_multi_pool_t *pool = multi->pool;
+	unsigned int idx;
+
+	if (!pool)
+		return;
+	pthread_mutex_lock(&pool->mutex);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->mutex);
+	for (idx = 0; idx < pool->nworkers; idx++)
+		pthread_join(pool->workers[idx].thread, NULL);
+	pthread_cond_destroy(&pool->start);
+	pthread_cond_destroy(&pool->done);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool->workers);
+	free(pool);
+	multi->pool = NULL;
+}
+
+/* the workers inherit the scheduling policy of the thread calling hw_params */
+static int snd_pcm_multi_pool_new(snd_pcm_multi_t *multi)
+{
+	snd_pcm_multi_pool_t *pool;
+	snd_pcm_multi_worker_t *worker;
+	int err;
+
+	pool = calloc(1, sizeof(*pool));
+	if (pool == NULL)
+		return -ENOMEM;
+	pool->workers = calloc(multi->slaves_count - 1, sizeof(*pool->workers));
+	if (pool->workers == NULL) {
+		free(pool);
+		return -ENOMEM;
+	}
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	multi->pool = pool;
+	while (pool->nworkers < multi->slaves_count - 1) {
+		worker = &pool->workers[pool->nworkers];
+		worker->multi = multi;
+		worker->idx = pool->nworkers + 1;
+		err = snd_thread_create(&worker->thread, "pcm_multi",
+					snd_pcm_multi_worker_thread, worker);
+		if (err) {
+			SNDERR("Unable to create multi worker thread");
+			snd_pcm_multi_pool_free(multi);
+			return -err;
+		}
+		pool->nworkers++;
+	}
+	return 0;
+}
+
+/*
+ * Runs the job on all slaves at once and waits for them.  The caller
+ * services slave 0, then spins a bounded time before sleeping.
+ */
+static void snd_pcm_multi_pool_run(snd_pcm_multi_t *multi, int op,
+				   snd_pcm_uframes_t offset, snd_pcm_uframes_t size)
+{
+	snd_pcm_multi_pool_t *pool = multi->pool;
+	unsigned int spin;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->generation++;
+	pool->op = op;
+	pool->offset = offset;
+	pool->size = size;
+	__atomic_store_n(&pool->pending, pool->nworkers, __ATOMIC_RELEASE);
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->mutex);
+	snd_pcm_multi_service(multi, 0, op, offset, size);
+	for (spin = 0; spin < SND_PCM_MULTI_SPIN; spin++) {
+		if (__atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE) == 0)
+			return;
+	}
+	pthread_mutex_lock(&pool->mutex);
+	while (__atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE))
+		pthread_cond_wait(&pool->done, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+}
+#else
+#define snd_pcm_multi_pool_free(multi)	do { } while (0)
+#define snd_pcm_multi_pool_run(multi, op, offset, size) do { } while (0)
 #endif
 
 static int snd_pcm_multi_close(snd_pcm_t *pcm)
@@ -69,8 +605,10 @@ static int snd_pcm_multi_close(snd_pcm_t *pcm)
 	snd_pcm_multi_t *multi = pcm->private_data;
 	unsigned int i;
 	int ret = 0;
+	snd_pcm_multi_pool_free(multi);
 	for (i = 0; i < multi->slaves_count; ++i) {
 		snd_pcm_multi_slave_t *slave = &multi->slaves[i];
+		snd_pcm_multi_drift_free(slave);
 		if (slave->close_slave) {
 			int err = snd_pcm_close(slave->pcm);
 			if (err < 0)
@@ -351,6 +889,20 @@ static int snd_pcm_multi_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 		}
 	}
 	reset_links(multi);
+	for (i = 0; multi->drift && i < multi->slaves_count; ++i) {
+		if (i == multi->master_slave || multi->slaves[i].drift)
+			continue;
+		err = snd_pcm_multi_drift_new(&multi->slaves[i]);
+		if (err < 0)
+			return err;
+	}
+#ifdef THREAD_SAFE_API
+	if (multi->threads && multi->slaves_count > 1 && !multi->pool) {
+		err = snd_pcm_multi_pool_new(multi);
+		if (err < 0)
+			return err;
+	}
+#endif
 	return 0;
 }
 
@@ -359,9 +911,12 @@ static int snd_pcm_multi_hw_free(snd_pcm_t *pcm)
 	snd_pcm_multi_t *multi = pcm->private_data;
 	unsigned int i;
 	int err = 0;
+	snd_pcm_multi_pool_free(multi);
 	for (i = 0; i < multi->slaves_count; ++i) {
 		snd_pcm_t *slave = multi->slaves[i].pcm;
-		int e = snd_pcm_hw_free(slave);
+		int e;
+		snd_pcm_multi_drift_free(&multi->slaves[i]);
+		e = snd_pcm_hw_free(slave);
 		if (e < 0)
 			err = e;
 		if (!multi->slaves[i].linked)
@@ -421,7 +976,13 @@ static void snd_pcm_multi_hwptr_update(snd_pcm_t *pcm)
 	if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
 		last_avail = 0;
 		for (i = 0; i < multi->slaves_count; ++i) {
-			slave_hw_ptr = *multi->slaves[i].pcm->hw.ptr;
+			snd_pcm_multi_drift_t *drift = multi->slaves[i].drift;
+			/* a resampled slave has consumed up to its ring pointer */
+			if (drift)
+				slave_hw_ptr = (multi->appl_ptr + pcm->boundary - drift->queued) %
+					       pcm->boundary;
+			else
+				slave_hw_ptr = *multi->slaves[i].pcm->hw.ptr;
 			avail = __snd_pcm_playback_avail(pcm, multi->hw_ptr, slave_hw_ptr);
 			if (avail > last_avail) {
 				hw_ptr = slave_hw_ptr;
@@ -466,6 +1027,8 @@ static int snd_pcm_multi_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
 		err = snd_pcm_delay(multi->slaves[i].pcm, &d);
 		if (err < 0)
 			return err;
+		if (multi->slaves[i].drift)
+			d += multi->slaves[i].drift->queued;
 		if (dr < d)
 			dr = d;
 	}
@@ -478,15 +1041,30 @@ static snd_pcm_sframes_t snd_pcm_multi_avail_update(snd_pcm_t *pcm)
 	snd_pcm_multi_t *multi = pcm->private_data;
 	snd_pcm_sframes_t ret = LONG_MAX;
 	unsigned int i;
+	if (multi->pool) {
+		snd_pcm_multi_pool_run(multi, SND_PCM_MULTI_JOB_AVAIL, 0, 0);
+		for (i = 0; i < multi->slaves_count; ++i) {
+			if (multi->slaves[i].result < 0)
+				return multi->slaves[i].result;
+			if (ret > multi->slaves[i].result)
+				ret = multi->slaves[i].result;
+		}
+		snd_pcm_multi_hwptr_update(pcm);
+		if (multi->drift)
+			snd_pcm_multi_drift_estimate(pcm);
+		return ret;
+	}
 	for (i = 0; i < multi->slaves_count; ++i) {
 		snd_pcm_sframes_t avail;
-		avail = snd_pcm_avail_update(multi->slaves[i].pcm);
+		avail = snd_pcm_multi_slave_avail(multi, i);
 		if (avail < 0)
 			return avail;
 		if (ret > avail)
 			ret = avail;
 	}
 	snd_pcm_multi_hwptr_update(pcm);
+	if (multi->drift)
+		snd_pcm_multi_drift_estimate(pcm);
 	return ret;
 }
 
@@ -512,6 +1090,7 @@ static int snd_pcm_multi_prepare(snd_pcm_t *pcm)
 			result = err;
 	}
 	multi->hw_ptr = multi->appl_ptr = 0;
+	snd_pcm_multi_drift_restart(multi);
 	return result;
 }
 
@@ -527,6 +1106,7 @@ static int snd_pcm_multi_reset(snd_pcm_t *pcm)
 			result = err;
 	}
 	multi->hw_ptr = multi->appl_ptr = 0;
+	snd_pcm_multi_drift_restart(multi);
 	return result;
 }
 
@@ -573,6 +1153,22 @@ static int snd_pcm_multi_drain(snd_pcm_t *pcm)
 	snd_pcm_multi_t *multi = pcm->private_data;
 	int err = 0;
 	unsigned int i;
+	/* hand what is left in the rings to the slaves first */
+	for (i = 0; i < multi->slaves_count; ++i) {
+		snd_pcm_multi_slave_t *slave = &multi->slaves[i];
+		if (!slave->drift)
+			continue;
+		while (slave->drift->queued) {
+			err = snd_pcm_multi_drift_feed(slave, 1);
+			if (err < 0)
+				return err;
+			if (slave->drift->queued) {
+				err = snd_pcm_wait(slave->pcm, -1);
+				if (err < 0)
+					return err;
+			}
+		}
+	}
 	if (multi->slaves[0].linked)
 		return snd_pcm_drain(multi->slaves[0].linked);
 	for (i = 0; i < multi->slaves_count; ++i) {
@@ -610,6 +1206,15 @@ static int snd_pcm_multi_channel_info(snd_pcm_t *pcm, snd_pcm_channel_info_t *in
 	int err;
 	if (c->slave_idx < 0)
 		return -ENXIO;
+	if (multi->slaves[c->slave_idx].drift) {
+		const snd_pcm_channel_area_t *ring =
+			&multi->slaves[c->slave_idx].drift->ring[c->slave_channel];
+		info->addr = ring->addr;
+		info->first = 0;
+		info->step = ring->step;
+		info->type = SND_PCM_AREA_LOCAL;
+		return 0;
+	}
 	info->channel = c->slave_channel;
 	err = snd_pcm_channel_info(multi->slaves[c->slave_idx].pcm, info);
 	info->channel = channel;
@@ -622,6 +1227,9 @@ static snd_pcm_sframes_t snd_pcm_multi_rewindable(snd_pcm_t *pcm)
 	unsigned int i;
 	snd_pcm_sframes_t frames = LONG_MAX;
 
+	/* resampled frames cannot be taken back */
+	if (multi->drift)
+		return 0;
 	for (i = 0; i < multi->slaves_count; ++i) {
 		snd_pcm_sframes_t f = snd_pcm_rewindable(multi->slaves[i].pcm);
 		if (f <= 0)
@@ -640,6 +1248,8 @@ static snd_pcm_sframes_t snd_pcm_multi_forwardable(snd_pcm_t *pcm)
 	unsigned int i;
 	snd_pcm_sframes_t frames = LONG_MAX;
 
+	if (multi->drift)
+		return 0;
 	for (i = 0; i < multi->slaves_count; ++i) {
 		snd_pcm_sframes_t f = snd_pcm_forwardable(multi->slaves[i].pcm);
 		if (f <= 0)
@@ -657,6 +1267,8 @@ static snd_pcm_sframes_t snd_pcm_multi_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t
 	snd_pcm_multi_t *multi = pcm->private_data;
 	unsigned int i;
 	snd_pcm_uframes_t pos[multi->slaves_count];
+	if (multi->drift)
+		return 0;
 	memset(pos, 0, sizeof(pos));
 	for (i = 0; i < multi->slaves_count; ++i) {
 		snd_pcm_t *slave_i = multi->slaves[i].pcm;
@@ -688,6 +1300,8 @@ static snd_pcm_sframes_t snd_pcm_multi_forward(snd_pcm_t *pcm, snd_pcm_uframes_t
 	snd_pcm_multi_t *multi = pcm->private_data;
 	unsigned int i;
 	snd_pcm_uframes_t pos[multi->slaves_count];
+	if (multi->drift)
+		return 0;
 	memset(pos, 0, sizeof(pos));
 	for (i = 0; i < multi->slaves_count; ++i) {
 		snd_pcm_t *slave_i = multi->slaves[i].pcm;
@@ -782,18 +1396,25 @@ static snd_pcm_sframes_t snd_pcm_multi_mmap_commit(snd_pcm_t *pcm,
 						   snd_pcm_uframes_t size)
 {
 	snd_pcm_multi_t *multi = pcm->private_data;
-	snd_pcm_t *slave;
 	unsigned int i;
 	snd_pcm_sframes_t result;
 
+	if (multi->pool) {
+		snd_pcm_multi_pool_run(multi, SND_PCM_MULTI_JOB_COMMIT, offset, size);
+		for (i = 0; i < multi->slaves_count; ++i) {
+			if (multi->slaves[i].result < 0)
+				return multi->slaves[i].result;
+		}
+		multi->committed += size;
+		snd_pcm_mmap_appl_forward(pcm, size);
+		return size;
+	}
 	for (i = 0; i < multi->slaves_count; ++i) {
-		slave = multi->slaves[i].pcm;
-		result = snd_pcm_mmap_commit(slave, offset, size);
+		result = snd_pcm_multi_slave_commit(multi, i, offset, size);
 		if (result < 0)
 			return result;
-		if ((snd_pcm_uframes_t)result != size)
-			return -EIO;
 	}
+	multi->committed += size;
 	snd_pcm_mmap_appl_forward(pcm, size);
 	return size;
 }
@@ -824,11 +1445,23 @@ static int snd_pcm_multi_mmap(snd_pcm_t *pcm)
 	/* Copy the slave mmapped buffer data */
 	for (c = 0; c < pcm->channels; c++) {
 		snd_pcm_multi_channel_t *chan = &multi->channels[c];
+		snd_pcm_multi_drift_t *drift;
 		snd_pcm_t *slave;
 		if (chan->slave_idx < 0) {
 			snd_pcm_multi_munmap(pcm);
 			return -ENXIO;
 		}
+		drift = multi->slaves[chan->slave_idx].drift;
+		if (drift) {
+			snd_pcm_channel_info_t *info = &pcm->mmap_channels[c];
+			info->channel = c;
+			info->addr = drift->ring[chan->slave_channel].addr;
+			info->first = 0;
+			info->step = drift->ring[chan->slave_channel].step;
+			info->type = SND_PCM_AREA_LOCAL;
+			pcm->running_areas[c] = drift->ring[chan->slave_channel];
+			continue;
+		}
 		slave = multi->slaves[chan->slave_idx].pcm;
 		pcm->mmap_channels[c] =
 			slave->mmap_channels[chan->slave_channel];
@@ -1000,8 +1633,16 @@ static void snd_pcm_multi_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_pcm_dump_setup(pcm, out);
 	}
 	for (k = 0; k < multi->slaves_count; ++k) {
+		snd_pcm_multi_slave_t *slave = &multi->slaves[k];
 		snd_output_printf(out, "Slave #%d: ", k);
-		snd_pcm_dump(multi->slaves[k].pcm, out);
+		if (slave->calls)
+			snd_output_printf(out, "(serviced %llu times, avg %llu ns, max %llu ns) ",
+					  slave->calls, slave->nsecs / slave->calls,
+					  slave->max_nsecs);
+		if (slave->drift)
+			snd_output_printf(out, "(drift %+.1f ppm) ",
+					  (slave->drift->ratio - 1.0) * 1e6);
+		snd_pcm_dump(slave->pcm, out);
 	}
 }
 
@@ -1177,9 +1818,28 @@ pcm.name {
 		}
 	}
 	[master INT]		# Define the master slave
+	[threads BOOL]		# Service each slave from its own thread
+	[drift BOOL]		# Compensate the clock drift of the slaves
 }
 \endcode
 
+With threads set, the commits and the avail updates of the slaves run
+concurrently, one worker thread per slave besides the first one, which
+is serviced by the calling thread.  The call returns when all slaves are
+done, so a slow slave no longer delays the others.  snd_pcm_dump() shows
+how long each slave took to be serviced, to find the bottleneck.
+
+With drift set, the slaves other than the master are assumed to run
+from clocks of their own, e.g. separate USB devices.  Their channels are
+then kept in a ring of the plugin and resampled into the slave with the
+linear converter of the \ref pcm_plugins_rate "rate" plugin, a period at
+a time.  The ratio follows the rate at which the slave plays compared to
+the master, measured from the snd_pcm_htimestamp() of both, and slowly
+pulls the slave latency towards the master one, so the aggregate runs
+indefinitely without xruns from the drift.  This is supported for
+playback only; the resampled streams cannot be rewound and their
+samples are interpolated at 16 bit precision.
+
 For example, to bind two PCM streams with two-channel stereo (hw:0,0 and
 hw:0,1) as one 4-channel stereo PCM stream, define like this:
 \code
@@ -1257,6 +1917,8 @@ int _snd_pcm_multi_open(snd_pcm_t **pcmp, const char *name,
 	unsigned int slaves_count = 0;
 	long master_slave = 0;
 	unsigned int channels_count = 0;
+	int threads = 0;
+	int drift = 0;
 	snd_config_for_each(i, inext, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
 		const char *id;
@@ -1287,6 +1949,20 @@ int _snd_pcm_multi_open(snd_pcm_t **pcmp, const char *name,
 			}
 			continue;
 		}
+		if (strcmp(id, "threads") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return -EINVAL;
+			threads = err;
+			continue;
+		}
+		if (strcmp(id, "drift") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return -EINVAL;
+			drift = err;
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -1305,6 +1981,10 @@ int _snd_pcm_multi_open(snd_pcm_t **pcmp, const char *name,
 		SNDERR("Master slave is out of range (0-%u)\n", slaves_count-1);
 		return -EINVAL;
 	}
+	if (drift && stream != SND_PCM_STREAM_PLAYBACK) {
+		SNDERR("drift compensation is supported for playback only");
+		return -EINVAL;
+	}
 	snd_config_for_each(i, inext, bindings) {
 		long cchannel;
 		snd_config_t *m = snd_config_iterator_entry(i);
@@ -1435,6 +2115,10 @@ int _snd_pcm_multi_open(snd_pcm_t **pcmp, const char *name,
 				 channels_count,
 				 channels_sidx, channels_schannel,
 				 1);
+	if (err >= 0) {
+		((snd_pcm_multi_t *)(*pcmp)->private_data)->threads = threads;
+		((snd_pcm_multi_t *)(*pcmp)->private_data)->drift = drift;
+	}
 _free:
 	if (err < 0) {
 		for (idx = 0; idx < slaves_count; ++idx) {
@@ -28,8 +28,12 @@
   
 #include "bswap.h"
 #include <limits.h>
+#include <time.h>
 #include "pcm_local.h"
 #include "pcm_plugin.h"
+#ifdef HAVE_SYS_TIMERFD_H
+#include <sys/timerfd.h>
+#endif
 
 #ifndef PIC
 /* entry for static linking */
@@ -44,9 +48,130 @@ typedef struct {
 	snd_pcm_uframes_t hw_ptr;
 	int poll_fd;
 	snd_pcm_chmap_query_t **chmap;
+	/* timed mode: poll_fd is a timerfd, hw_ptr follows CLOCK_MONOTONIC */
+	int timed;
+	unsigned long long start_ns;	/* time of hw_ptr position 0 of this run */
+	unsigned long long pause_ns;	/* running time when paused */
+	unsigned long long xrun_ns;	/* injected xrun interval, 0 = none */
+	snd_pcm_uframes_t frames_done;	/* hw_ptr advance since start_ns */
 } snd_pcm_null_t;
 #endif
 
+static unsigned long long null_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * timed mode: move hw_ptr to the position the clock is at now and detect
+ * the xruns, both the real ones (stop_threshold) and the injected ones
+ */
+static void null_timed_update(snd_pcm_t *pcm)
+{
+	snd_pcm_null_t *null = pcm->private_data;
+	unsigned long long elapsed;
+	snd_pcm_uframes_t frames;
+
+	if (!null->timed || null->state != SND_PCM_STATE_RUNNING)
+		return;
+	elapsed = null_now_ns() - null->start_ns;
+	frames = elapsed * pcm->rate / 1000000000ULL;
+	if (frames != null->frames_done) {
+		snd_pcm_mmap_hw_forward(pcm, frames - null->frames_done);
+		null->frames_done = frames;
+	}
+	if ((null->xrun_ns && elapsed >= null->xrun_ns) ||
+	    snd_pcm_mmap_avail(pcm) >= pcm->stop_threshold) {
+		null->state = SND_PCM_STATE_XRUN;
+		gettimestamp(&null->trigger_tstamp, pcm->tstamp_type);
+	}
+}
+
+/*
+ * timed mode: make the timerfd readable when avail_min is reached (or
+ * at once when it is already, or on an error state); a timerfd which
+ * was not read stays readable, so the poll is level triggered
+ */
+static void null_timer_arm(snd_pcm_t *pcm)
+{
+#ifdef HAVE_SYS_TIMERFD_H
+	snd_pcm_null_t *null = pcm->private_data;
+	struct itimerspec its;
+	unsigned long long ns = 1;
+	snd_pcm_uframes_t avail;
+
+	if (!null->timed)
+		return;
+	switch (null->state) {
+	case SND_PCM_STATE_PREPARED:
+	case SND_PCM_STATE_RUNNING:
+		avail = snd_pcm_mmap_avail(pcm);
+		if (avail >= pcm->avail_min)
+			break;
+		if (null->state == SND_PCM_STATE_PREPARED) {
+			ns = 0;		/* nothing happens until the start */
+			break;
+		}
+		ns = ((pcm->avail_min - avail) * 1000000000ULL + pcm->rate - 1) / pcm->rate;
+		if (null->xrun_ns) {
+			unsigned long long elapsed = null_now_ns() - null->start_ns;
+			if (elapsed >= null->xrun_ns)
+				ns = 1;
+			else if (null->xrun_ns - elapsed < ns)
+				ns = null->xrun_ns - elapsed;
+		}
+		break;
+	case SND_PCM_STATE_PAUSED:
+		ns = 0;
+		break;
+	default:
+		break;
+	}
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_sec = ns / 1000000000ULL;
+	its.it_value.tv_nsec = ns % 1000000000ULL;
+	timerfd_settime(null->poll_fd, 0, &its, NULL);
+#endif
+}
+
+static int snd_pcm_null_poll_revents(snd_pcm_t *pcm, struct pollfd *pfds,
+				     unsigned int nfds, unsigned short *revents)
+{
+	snd_pcm_null_t *null = pcm->private_data;
+	unsigned short events;
+
+	if (nfds != 1)
+		return -EINVAL;
+	events = pfds[0].revents;
+	if (!null->timed) {
+		*revents = events;
+		return 0;
+	}
+	if (events & POLLIN) {
+		null_timed_update(pcm);
+		switch (null->state) {
+		case SND_PCM_STATE_XRUN:
+		case SND_PCM_STATE_SETUP:
+			events = POLLERR;
+			break;
+		default:
+			if (snd_pcm_mmap_avail(pcm) < pcm->avail_min) {
+				/* woken a bit early, the timer is rearmed */
+				null_timer_arm(pcm);
+				events = 0;
+			} else if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+				events = POLLOUT;
+			}
+			break;
+		}
+	}
+	*revents = events;
+	return 0;
+}
+
 static int snd_pcm_null_close(snd_pcm_t *pcm)
 {
 	snd_pcm_null_t *null = pcm->private_data;
@@ -82,6 +207,12 @@ static int snd_pcm_null_info(snd_pcm_t *pcm, snd_pcm_info_t * info)
 static snd_pcm_sframes_t snd_pcm_null_avail_update(snd_pcm_t *pcm)
 {
 	snd_pcm_null_t *null = pcm->private_data;
+	if (null->timed) {
+		null_timed_update(pcm);
+		if (null->state == SND_PCM_STATE_XRUN)
+			return -EPIPE;
+		return snd_pcm_mmap_avail(pcm);
+	}
         if (null->state == SND_PCM_STATE_PREPARED) {
                 /* it is required to return the correct avail count for */
                 /* the prepared stream, otherwise the start is not called */
@@ -93,13 +224,15 @@ static snd_pcm_sframes_t snd_pcm_null_avail_update(snd_pcm_t *pcm)
 static int snd_pcm_null_status(snd_pcm_t *pcm, snd_pcm_status_t * status)
 {
 	snd_pcm_null_t *null = pcm->private_data;
+	null_timed_update(pcm);
 	memset(status, 0, sizeof(*status));
 	status->state = null->state;
 	status->trigger_tstamp = null->trigger_tstamp;
 	status->appl_ptr = *pcm->appl.ptr;
 	status->hw_ptr = *pcm->hw.ptr;
 	gettimestamp(&status->tstamp, pcm->tstamp_type);
-	status->avail = snd_pcm_null_avail_update(pcm);
+	status->avail = null->timed ? snd_pcm_mmap_avail(pcm) :
+		snd_pcm_null_avail_update(pcm);
 	status->avail_max = pcm->buffer_size;
 	return 0;
 }
@@ -110,13 +243,23 @@ static snd_pcm_state_t snd_pcm_null_state(snd_pcm_t *pcm)
 	return null->state;
 }
 
-static int snd_pcm_null_hwsync(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
+static int snd_pcm_null_hwsync(snd_pcm_t *pcm)
 {
-	return 0;
+	snd_pcm_null_t *null = pcm->private_data;
+	null_timed_update(pcm);
+	return null->state == SND_PCM_STATE_XRUN ? -EPIPE : 0;
 }
 
-static int snd_pcm_null_delay(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_sframes_t *delayp)
+static int snd_pcm_null_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
 {
+	snd_pcm_null_t *null = pcm->private_data;
+	if (null->timed) {
+		null_timed_update(pcm);
+		if (null->state == SND_PCM_STATE_XRUN)
+			return -EPIPE;
+		*delayp = snd_pcm_mmap_delay(pcm);
+		return 0;
+	}
 	*delayp = 0;
 	return 0;
 }
@@ -132,7 +275,9 @@ static int snd_pcm_null_prepare(snd_pcm_t *pcm)
 {
 	snd_pcm_null_t *null = pcm->private_data;
 	null->state = SND_PCM_STATE_PREPARED;
-	return snd_pcm_null_reset(pcm);
+	snd_pcm_null_reset(pcm);
+	null_timer_arm(pcm);
+	return 0;
 }
 
 static int snd_pcm_null_start(snd_pcm_t *pcm)
@@ -140,6 +285,15 @@ static int snd_pcm_null_start(snd_pcm_t *pcm)
 	snd_pcm_null_t *null = pcm->private_data;
 	assert(null->state == SND_PCM_STATE_PREPARED);
 	null->state = SND_PCM_STATE_RUNNING;
+	if (null->timed) {
+		/* the queued playback frames are consumed from now on */
+		if (pcm->stream == SND_PCM_STREAM_CAPTURE)
+			*pcm->hw.ptr = *pcm->appl.ptr;
+		null->start_ns = null_now_ns();
+		null->frames_done = 0;
+		null_timer_arm(pcm);
+		return 0;
+	}
 	if (pcm->stream == SND_PCM_STREAM_CAPTURE)
 		*pcm->hw.ptr = *pcm->appl.ptr + pcm->buffer_size;
 	else
@@ -152,6 +306,7 @@ static int snd_pcm_null_drop(snd_pcm_t *pcm)
 	snd_pcm_null_t *null = pcm->private_data;
 	assert(null->state != SND_PCM_STATE_OPEN);
 	null->state = SND_PCM_STATE_SETUP;
+	null_timer_arm(pcm);
 	return 0;
 }
 
@@ -159,7 +314,22 @@ static int snd_pcm_null_drain(snd_pcm_t *pcm)
 {
 	snd_pcm_null_t *null = pcm->private_data;
 	assert(null->state != SND_PCM_STATE_OPEN);
+	/* timed mode: wait until the queued playback frames are consumed */
+	while (null->timed && pcm->stream == SND_PCM_STREAM_PLAYBACK &&
+	       null->state == SND_PCM_STATE_RUNNING) {
+		snd_pcm_sframes_t frames = snd_pcm_mmap_playback_hw_avail(pcm);
+		struct timespec ts;
+		unsigned long long ns;
+		if (frames <= 0)
+			break;
+		ns = (frames * 1000000000ULL + pcm->rate - 1) / pcm->rate;
+		ts.tv_sec = ns / 1000000000ULL;
+		ts.tv_nsec = ns % 1000000000ULL;
+		nanosleep(&ts, NULL);
+		null_timed_update(pcm);
+	}
 	null->state = SND_PCM_STATE_SETUP;
+	null_timer_arm(pcm);
 	return 0;
 }
 
@@ -167,24 +337,39 @@ static int snd_pcm_null_pause(snd_pcm_t *pcm, int enable)
 {
 	snd_pcm_null_t *null = pcm->private_data;
 	if (enable) {
+		null_timed_update(pcm);
 		if (null->state != SND_PCM_STATE_RUNNING)
 			return -EBADFD;
 		null->state = SND_PCM_STATE_PAUSED;
+		null->pause_ns = null_now_ns() - null->start_ns;
 	} else {
 		if (null->state != SND_PCM_STATE_PAUSED)
 			return -EBADFD;
 		null->state = SND_PCM_STATE_RUNNING;
+		/* the clock does not count the paused time */
+		null->start_ns = null_now_ns() - null->pause_ns;
 	}
+	null_timer_arm(pcm);
 	return 0;
 }
 
 static snd_pcm_sframes_t snd_pcm_null_rewindable(snd_pcm_t *pcm)
 {
+	snd_pcm_null_t *null = pcm->private_data;
+	if (null->timed) {
+		null_timed_update(pcm);
+		return snd_pcm_mmap_hw_rewindable(pcm);
+	}
 	return pcm->buffer_size;
 }
 
-static snd_pcm_sframes_t snd_pcm_null_forwardable(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
+static snd_pcm_sframes_t snd_pcm_null_forwardable(snd_pcm_t *pcm)
 {
+	snd_pcm_null_t *null = pcm->private_data;
+	if (null->timed) {
+		null_timed_update(pcm);
+		return snd_pcm_mmap_avail(pcm);
+	}
 	return 0;
 }
 
@@ -192,6 +377,20 @@ static snd_pcm_sframes_t snd_pcm_null_forwardable(snd_pcm_t *pcm ATTRIBUTE_UNUSE
 static snd_pcm_sframes_t snd_pcm_null_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
 {
 	snd_pcm_null_t *null = pcm->private_data;
+	if (null->timed) {
+		/* only the application pointer moves, hw_ptr is the clock */
+		snd_pcm_sframes_t max = snd_pcm_null_rewindable(pcm);
+		if (null->state == SND_PCM_STATE_XRUN)
+			return -EPIPE;
+		if (null->state != SND_PCM_STATE_RUNNING &&
+		    null->state != SND_PCM_STATE_PREPARED)
+			return -EBADFD;
+		if ((snd_pcm_uframes_t)max < frames)
+			frames = max;
+		snd_pcm_mmap_appl_backward(pcm, frames);
+		null_timer_arm(pcm);
+		return frames;
+	}
 	switch (null->state) {
 	case SND_PCM_STATE_RUNNING:
 		snd_pcm_mmap_hw_backward(pcm, frames);
@@ -207,6 +406,19 @@ static snd_pcm_sframes_t snd_pcm_null_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t f
 static snd_pcm_sframes_t snd_pcm_null_forward(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
 {
 	snd_pcm_null_t *null = pcm->private_data;
+	if (null->timed) {
+		snd_pcm_sframes_t max = snd_pcm_null_forwardable(pcm);
+		if (null->state == SND_PCM_STATE_XRUN)
+			return -EPIPE;
+		if (null->state != SND_PCM_STATE_RUNNING &&
+		    null->state != SND_PCM_STATE_PREPARED)
+			return -EBADFD;
+		if ((snd_pcm_uframes_t)max < frames)
+			frames = max;
+		snd_pcm_mmap_appl_forward(pcm, frames);
+		null_timer_arm(pcm);
+		return frames;
+	}
 	switch (null->state) {
 	case SND_PCM_STATE_RUNNING:
 		snd_pcm_mmap_hw_forward(pcm, frames);
@@ -229,8 +441,12 @@ static snd_pcm_sframes_t snd_pcm_null_xfer_areas(snd_pcm_t *pcm,
 						 snd_pcm_uframes_t offset ATTRIBUTE_UNUSED,
 						 snd_pcm_uframes_t size)
 {
+	snd_pcm_null_t *null = pcm->private_data;
 	snd_pcm_mmap_appl_forward(pcm, size);
-	snd_pcm_mmap_hw_forward(pcm, size);
+	if (null->timed)
+		null_timer_arm(pcm);
+	else
+		snd_pcm_mmap_hw_forward(pcm, size);
 	return size;
 }
 
@@ -363,6 +579,7 @@ static const snd_pcm_fast_ops_t snd_pcm_null_fast_ops = {
 	.avail_update = snd_pcm_null_avail_update,
 	.mmap_commit = snd_pcm_null_mmap_commit,
 	.htimestamp = snd_pcm_generic_real_htimestamp,
+	.poll_revents = snd_pcm_null_poll_revents,
 };
 
 /**
@@ -436,9 +653,21 @@ and /dev/full (capture, must be readable).
 pcm.name {
         type null               # Null PCM
 	[chmap MAP]		# Provide channel maps; MAP is a string array
+	[timed BOOL]		# Consume/produce frames in real time (default no)
+	[xrun_interval INT]	# Timed mode: force an xrun every INT ms of running
 }
 \endcode
 
+By default the stream never blocks: the written frames are consumed at once
+and a capture buffer is always full.  With \c timed, hw_ptr advances with
+CLOCK_MONOTONIC at the configured rate from the start of the stream, the
+poll descriptor is a timerfd which wakes the application when avail_min is
+reached, and the stream goes to the XRUN state when avail reaches the stop
+threshold, like a real device.  The plugin chains and applications on top
+of it can then be measured for their wakeups and CPU use without hardware.
+\c xrun_interval additionally injects an xrun after every given running
+time (counted again from each start) to exercise the recovery paths.
+
 \subsection pcm_plugins_null_funcref Function reference
 
 <UL>
@@ -468,6 +697,8 @@ int _snd_pcm_null_open(snd_pcm_t **pcmp, const char *name,
 	snd_config_iterator_t i, next;
 	snd_pcm_null_t *null;
 	snd_pcm_chmap_query_t **chmap = NULL;
+	long xrun_interval = 0;
+	int timed = 0;
 	int err;
 
 	snd_config_for_each(i, next, conf) {
@@ -486,19 +717,67 @@ int _snd_pcm_null_open(snd_pcm_t **pcmp, const char *name,
 			}
 			continue;
 		}
+		if (strcmp(id, "timed") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				goto _err;
+			timed = err;
+			continue;
+		}
+		if (strcmp(id, "xrun_interval") == 0) {
+			err = snd_config_get_integer(n, &xrun_interval);
+			if (err < 0 || xrun_interval < 0) {
+				SNDERR("Invalid value for %s", id);
+				err = -EINVAL;
+				goto _err;
+			}
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
-		snd_pcm_free_chmaps(chmap);
-		return -EINVAL;
+		err = -EINVAL;
+		goto _err;
 	}
-	err = snd_pcm_null_open(pcmp, name, stream, mode);
-	if (err < 0) {
-		snd_pcm_free_chmaps(chmap);
-		return err;
+	if (xrun_interval && !timed) {
+		SNDERR("xrun_interval needs the timed mode");
+		err = -EINVAL;
+		goto _err;
 	}
+#ifndef HAVE_SYS_TIMERFD_H
+	if (timed) {
+		SNDERR("timed mode is not available (no timerfd)");
+		err = -ENOSYS;
+		goto _err;
+	}
+#endif
+	err = snd_pcm_null_open(pcmp, name, stream, mode);
+	if (err < 0)
+		goto _err;
 
 	null = (*pcmp)->private_data;
 	null->chmap = chmap;
+#ifdef HAVE_SYS_TIMERFD_H
+	if (timed) {
+		int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+		if (fd < 0) {
+			err = -errno;
+			SYSERR("timerfd_create failed");
+			snd_pcm_close(*pcmp);
+			*pcmp = NULL;
+			return err;
+		}
+		close(null->poll_fd);
+		null->poll_fd = fd;
+		null->timed = 1;
+		null->xrun_ns = xrun_interval * 1000000ULL;
+		(*pcmp)->poll_fd = fd;
+		(*pcmp)->poll_events = POLLIN;
+	}
+#endif
 	return 0;
+
+ _err:
+	snd_pcm_free_chmaps(chmap);
+	return err;
 }
 #ifndef DOC_HIDDEN
 SND_DLSYM_BUILD_VERSION(_snd_pcm_null_open, SND_PCM_DLSYM_VERSION);
@@ -2194,6 +2194,18 @@ int _snd_pcm_hw_params_refine(snd_pcm_hw_params_t *params,
 	return err;
 }
 
+/*
+ * true if both describe the same configuration space; the masks set by
+ * the refine code (rmask, cmask) and the returned setup fields are ignored
+ */
+static int snd_pcm_hw_params_same_space(const snd_pcm_hw_params_t *a,
+					const snd_pcm_hw_params_t *b)
+{
+	return a->flags == b->flags && a->info == b->info &&
+	       memcmp(a->masks, b->masks, sizeof(a->masks)) == 0 &&
+	       memcmp(a->intervals, b->intervals, sizeof(a->intervals)) == 0;
+}
+
 int snd_pcm_hw_refine_slave(snd_pcm_t *pcm, snd_pcm_hw_params_t *params,
 			    int (*cprepare)(snd_pcm_t *pcm,
 					    snd_pcm_hw_params_t *params),
@@ -2212,8 +2224,8 @@ int snd_pcm_hw_refine_slave(snd_pcm_t *pcm, snd_pcm_hw_params_t *params,
 #ifdef RULES_DEBUG
 	snd_output_t *log;
 #endif
-	snd_pcm_hw_params_t sparams;
-	int err;
+	snd_pcm_hw_params_t sparams, srefined;
+	int err, srefined_valid = 0;
 	unsigned int cmask, changed;
 #ifdef RULES_DEBUG
 	snd_output_stdio_attach(&log, stderr, 0);
@@ -2239,7 +2251,14 @@ int snd_pcm_hw_refine_slave(snd_pcm_t *pcm, snd_pcm_hw_params_t *params,
 		snd_pcm_hw_params_dump(&sparams, log);
 #endif
 		err = schange(pcm, params, &sparams);
-		if (err >= 0) {
+		if (err >= 0 && srefined_valid &&
+		    snd_pcm_hw_params_same_space(&sparams, &srefined)) {
+			/* none of the parameters linked to the slave has
+			 * changed since the last pass, the slave chain is
+			 * already refined for this space
+			 */
+			sparams = srefined;
+		} else if (err >= 0) {
 #ifdef RULES_DEBUG
 			snd_output_printf(log, "srefine '%s' (client)\n", pcm->name);
 			snd_pcm_hw_params_dump(params, log);
@@ -2257,6 +2276,8 @@ int snd_pcm_hw_refine_slave(snd_pcm_t *pcm, snd_pcm_hw_params_t *params,
 				cchange(pcm, params, &sparams);
 				return err;
 			}
+			srefined = sparams;
+			srefined_valid = 1;
 		} else {
 #ifdef RULES_DEBUG
 			snd_output_printf(log, "schange '%s', err < 0 (%i) (client)\n", pcm->name, err);
@@ -2346,6 +2367,7 @@ static int snd_pcm_sw_params_default(snd_pcm_t *pcm, snd_pcm_sw_params_t *params
 
 int snd_pcm_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 {
+	unsigned long long trace = snd_trace_begin();
 	int res;
 #ifdef REFINE_DEBUG
 	snd_output_t *log;
@@ -2360,6 +2382,7 @@ int snd_pcm_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 		res = pcm->ops->hw_refine(pcm->op_arg, params);
 	else
 		res = -ENOSYS;
+	snd_trace_end(trace, "refine", "refine", snd_pcm_type_name(pcm->type));
 #ifdef REFINE_DEBUG
 	snd_output_printf(log, "refine done - result = %i\n", res);
 	snd_pcm_hw_params_dump(params, log);
@@ -2382,13 +2405,16 @@ int snd_pcm_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 */
 int _snd_pcm_hw_params_internal(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 {
+	unsigned long long trace;
 	int err;
 	snd_pcm_sw_params_t sw;
 	int fb, min_align;
 	err = snd_pcm_hw_refine(pcm, params);
 	if (err < 0)
 		return err;
+	trace = snd_trace_begin();
 	snd_pcm_hw_params_choose(pcm, params);
+	snd_trace_end(trace, "refine", "choose", snd_pcm_type_name(pcm->type));
 	if (pcm->setup) {
 		err = snd_pcm_hw_free(pcm);
 		if (err < 0)
@@ -2398,6 +2424,7 @@ int _snd_pcm_hw_params_internal(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 		err = pcm->ops->hw_params(pcm->op_arg, params);
 	else
 		err = -ENOSYS;
+	snd_pcm_wait_invalidate(pcm);
 	if (err < 0)
 		return err;
 
@@ -55,8 +55,24 @@ typedef struct {
 	snd_pcm_route_ttable_entry_t *ttable;
 	int ttable_ok;
 	unsigned int tt_ssize, tt_cused, tt_sused;
+	snd_pcm_softvol_gain_t *gain;	/* soft volume fused into the route */
+	int gain_ok;
+	unsigned int plan;		/* PLUG_PLAN_* of the conversion chain */
+	unsigned int plan_cost;		/* its estimated cost per frame */
+	char plan_desc[256];
 } snd_pcm_plug_t;
 
+#if defined(BUILD_PCM_PLUGIN_ROUTE) && defined(BUILD_PCM_PLUGIN_SOFTVOL)
+#define BUILD_PCM_PLUG_GAIN
+#endif
+
+/* the ttable or the fused gain still needs a route plugin */
+static inline int snd_pcm_plug_route_pending(snd_pcm_plug_t *plug)
+{
+	return (plug->ttable && !plug->ttable_ok) ||
+	       (plug->gain && !plug->gain_ok);
+}
+
 #endif
 
 static int snd_pcm_plug_close(snd_pcm_t *pcm)
@@ -64,6 +80,9 @@ static int snd_pcm_plug_close(snd_pcm_t *pcm)
 	snd_pcm_plug_t *plug = pcm->private_data;
 	int err, result = 0;
 	free(plug->ttable);
+#ifdef BUILD_PCM_PLUG_GAIN
+	snd_pcm_softvol_gain_close(plug->gain);
+#endif
 	if (plug->rate_converter) {
 		snd_config_delete(plug->rate_converter);
 		plug->rate_converter = NULL;
@@ -353,9 +372,10 @@ static void snd_pcm_plug_clear(snd_pcm_t *pcm)
 		snd_pcm_unlink_appl_ptr(pcm, plug->gen.slave);
 		snd_pcm_close(plug->gen.slave);
 		plug->gen.slave = slave;
-		pcm->fast_ops = slave->fast_ops;
-		pcm->fast_op_arg = slave->fast_op_arg;
+		snd_pcm_generic_bypass(pcm);
 	}
+	plug->plan_desc[0] = '\0';
+	plug->plan_cost = 0;
 }
 
 #ifndef DOC_HIDDEN
@@ -365,6 +385,17 @@ typedef struct {
 	unsigned int channels;
 	unsigned int rate;
 } snd_pcm_plug_params_t;
+
+/*
+ * Placement of the conversions in the chain (the default is the fixed
+ * heuristic): route next to the slave or outside the rate plugin,
+ * format conversion next to the slave (rate and route work in the
+ * client format) or outside them (they keep the slave format).
+ */
+#define PLUG_PLAN_ROUTE_INNER	(1 << 0)
+#define PLUG_PLAN_ROUTE_OUTER	(1 << 1)
+#define PLUG_PLAN_FORMAT_INNER	(1 << 2)
+#define PLUG_PLAN_FORMAT_OUTER	(1 << 3)
 #endif
 
 #ifdef BUILD_PCM_PLUGIN_RATE
@@ -375,13 +406,16 @@ static int snd_pcm_plug_change_rate(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm_plu
 	if (clt->rate == slv->rate)
 		return 0;
 	assert(snd_pcm_format_linear(slv->format));
-	err = snd_pcm_rate_open(new, NULL, slv->format, slv->rate, plug->rate_converter,
-				plug->gen.slave, plug->gen.slave != plug->req_slave);
-	if (err < 0)
-		return err;
+	if (new) {
+		err = snd_pcm_rate_open(new, NULL, slv->format, slv->rate, plug->rate_converter,
+					plug->gen.slave, plug->gen.slave != plug->req_slave);
+		if (err < 0)
+			return err;
+	}
 	slv->access = clt->access;
 	slv->rate = clt->rate;
-	if (snd_pcm_format_linear(clt->format))
+	if (snd_pcm_format_linear(clt->format) &&
+	    !(plug->plan & PLUG_PLAN_FORMAT_OUTER))
 		slv->format = clt->format;
 	return 1;
 }
@@ -395,11 +429,16 @@ static int snd_pcm_plug_change_channels(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm
 	snd_pcm_route_ttable_entry_t *ttable;
 	int err;
 	if (clt->channels == slv->channels &&
-	    (!plug->ttable || plug->ttable_ok))
-		return 0;
-	if (clt->rate != slv->rate &&
-	    clt->channels > slv->channels)
+	    !snd_pcm_plug_route_pending(plug))
 		return 0;
+	if (clt->rate != slv->rate) {
+		/* resample the smaller number of channels */
+		if (plug->plan & PLUG_PLAN_ROUTE_OUTER)
+			return 0;
+		if (!(plug->plan & PLUG_PLAN_ROUTE_INNER) &&
+		    clt->channels > slv->channels)
+			return 0;
+	}
 	assert(snd_pcm_format_linear(slv->format));
 	tt_ssize = slv->channels;
 	tt_cused = clt->channels;
@@ -479,12 +518,20 @@ static int snd_pcm_plug_change_channels(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm
 			break;
 		}
 	}
-	err = snd_pcm_route_open(new, NULL, slv->format, (int) slv->channels, ttable, tt_ssize, tt_cused, tt_sused, plug->gen.slave, plug->gen.slave != plug->req_slave);
-	if (err < 0)
-		return err;
+	if (new) {
+		err = snd_pcm_route_open(new, NULL, slv->format, (int) slv->channels, ttable, tt_ssize, tt_cused, tt_sused, plug->gen.slave, plug->gen.slave != plug->req_slave);
+		if (err < 0)
+			return err;
+#ifdef BUILD_PCM_PLUG_GAIN
+		if (plug->gain)
+			snd_pcm_route_set_gain(*new, plug->gain);
+#endif
+	}
+	plug->gain_ok = 1;
 	slv->channels = clt->channels;
 	slv->access = clt->access;
-	if (snd_pcm_format_linear(clt->format))
+	if (snd_pcm_format_linear(clt->format) &&
+	    !(plug->plan & PLUG_PLAN_FORMAT_OUTER))
 		slv->format = clt->format;
 	return 1;
 }
@@ -501,14 +548,16 @@ static int snd_pcm_plug_change_format(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm_p
 	if (clt->format == slv->format &&
 	    clt->rate == slv->rate &&
 	    clt->channels == slv->channels &&
-	    (!plug->ttable || plug->ttable_ok))
+	    !snd_pcm_plug_route_pending(plug))
 		return 0;
 
 	if (snd_pcm_format_linear(slv->format)) {
 		/* Conversion is done in another plugin */
-		if (clt->rate != slv->rate ||
-		    clt->channels != slv->channels ||
-		    (plug->ttable && !plug->ttable_ok))
+		if ((clt->rate != slv->rate ||
+		     clt->channels != slv->channels ||
+		     snd_pcm_plug_route_pending(plug)) &&
+		    !((plug->plan & PLUG_PLAN_FORMAT_INNER) &&
+		      snd_pcm_format_linear(clt->format)))
 			return 0;
 		cfmt = clt->format;
 		switch (clt->format) {
@@ -543,7 +592,7 @@ static int snd_pcm_plug_change_format(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm_p
 			cfmt = clt->format;
 			f = snd_pcm_lfloat_open;
 		} else if (clt->rate != slv->rate || clt->channels != slv->channels ||
-			   (plug->ttable && !plug->ttable_ok)) {
+			   snd_pcm_plug_route_pending(plug)) {
 			cfmt = SND_PCM_FORMAT_S16;
 			f = snd_pcm_lfloat_open;
 		} else
@@ -576,9 +625,11 @@ static int snd_pcm_plug_change_format(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm_p
 			cfmt = SND_PCM_FORMAT_S16;
 #endif /* NONLINEAR */
 	}
-	err = f(new, NULL, slv->format, plug->gen.slave, plug->gen.slave != plug->req_slave);
-	if (err < 0)
-		return err;
+	if (new) {
+		err = f(new, NULL, slv->format, plug->gen.slave, plug->gen.slave != plug->req_slave);
+		if (err < 0)
+			return err;
+	}
 	slv->format = cfmt;
 	slv->access = clt->access;
 	return 1;
@@ -590,9 +641,11 @@ static int snd_pcm_plug_change_access(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm_p
 	int err;
 	if (clt->access == slv->access)
 		return 0;
-	err = snd_pcm_copy_open(new, NULL, plug->gen.slave, plug->gen.slave != plug->req_slave);
-	if (err < 0)
-		return err;
+	if (new) {
+		err = snd_pcm_copy_open(new, NULL, plug->gen.slave, plug->gen.slave != plug->req_slave);
+		if (err < 0)
+			return err;
+	}
 	slv->access = clt->access;
 	return 1;
 }
@@ -617,10 +670,12 @@ static int snd_pcm_plug_change_mmap(snd_pcm_t *pcm, snd_pcm_t **new,
 		break;
 	}
 
-	err = __snd_pcm_mmap_emul_open(new, NULL, plug->gen.slave,
-				       plug->gen.slave != plug->req_slave);
-	if (err < 0)
-		return err;
+	if (new) {
+		err = __snd_pcm_mmap_emul_open(new, NULL, plug->gen.slave,
+					       plug->gen.slave != plug->req_slave);
+		if (err < 0)
+			return err;
+	}
 	switch (slv->access) {
 	case SND_PCM_ACCESS_RW_INTERLEAVED:
 		slv->access = SND_PCM_ACCESS_MMAP_INTERLEAVED;
@@ -635,55 +690,185 @@ static int snd_pcm_plug_change_mmap(snd_pcm_t *pcm, snd_pcm_t **new,
 }
 #endif
 
-static int snd_pcm_plug_insert_plugins(snd_pcm_t *pcm,
-				       snd_pcm_plug_params_t *client,
-				       snd_pcm_plug_params_t *slave)
-{
-	snd_pcm_plug_t *plug = pcm->private_data;
-	static int (*const funcs[])(snd_pcm_t *_pcm, snd_pcm_t **new, snd_pcm_plug_params_t *s, snd_pcm_plug_params_t *d) = {
+/* cost of the converters per frame, channel and sample byte */
+#define PLUG_COST_COPY		1
+#define PLUG_COST_FORMAT	1
+#define PLUG_COST_ROUTE		2
+#define PLUG_COST_RATE		8
+#define PLUG_COST_RATE_PACKED	32	/* rate on a 3-byte format, see below */
+
+typedef int (*snd_pcm_plug_change_t)(snd_pcm_t *pcm, snd_pcm_t **new,
+				     snd_pcm_plug_params_t *clt,
+				     snd_pcm_plug_params_t *slv);
+
+/* the steps from the slave outwards; each may insert one plugin */
+static const struct {
+	snd_pcm_plug_change_t func;
+	const char *name;
+	unsigned int cost;
+} snd_pcm_plug_steps[] = {
 #ifdef BUILD_PCM_PLUGIN_MMAP_EMUL
-		snd_pcm_plug_change_mmap,
+	{ snd_pcm_plug_change_mmap, "mmap_emul", PLUG_COST_COPY },
 #endif
-		snd_pcm_plug_change_format,
+	{ snd_pcm_plug_change_format, "format", PLUG_COST_FORMAT },
 #ifdef BUILD_PCM_PLUGIN_ROUTE
-		snd_pcm_plug_change_channels,
+	{ snd_pcm_plug_change_channels, "route", PLUG_COST_ROUTE },
 #endif
 #ifdef BUILD_PCM_PLUGIN_RATE
-		snd_pcm_plug_change_rate,
+	{ snd_pcm_plug_change_rate, "rate", PLUG_COST_RATE },
 #endif
 #ifdef BUILD_PCM_PLUGIN_ROUTE
-		snd_pcm_plug_change_channels,
+	{ snd_pcm_plug_change_channels, "route", PLUG_COST_ROUTE },
 #endif
-		snd_pcm_plug_change_format,
-		snd_pcm_plug_change_access
-	};
-	snd_pcm_plug_params_t p = *slave;
+	{ snd_pcm_plug_change_format, "format", PLUG_COST_FORMAT },
+	{ snd_pcm_plug_change_access, "copy", PLUG_COST_COPY },
+};
+
+/* the candidates, the fixed heuristic first so that it wins the ties */
+static const unsigned int snd_pcm_plug_plans[] = {
+	0,
+	PLUG_PLAN_ROUTE_INNER,
+	PLUG_PLAN_ROUTE_OUTER,
+	PLUG_PLAN_FORMAT_INNER,
+	PLUG_PLAN_FORMAT_OUTER,
+	PLUG_PLAN_ROUTE_INNER | PLUG_PLAN_FORMAT_INNER,
+	PLUG_PLAN_ROUTE_INNER | PLUG_PLAN_FORMAT_OUTER,
+	PLUG_PLAN_ROUTE_OUTER | PLUG_PLAN_FORMAT_INNER,
+	PLUG_PLAN_ROUTE_OUTER | PLUG_PLAN_FORMAT_OUTER,
+};
+
+static unsigned int snd_pcm_plug_step_cost(unsigned int cost,
+					   const snd_pcm_plug_params_t *a,
+					   const snd_pcm_plug_params_t *b)
+{
+	int wa = snd_pcm_format_physical_width(a->format);
+	int wb = snd_pcm_format_physical_width(b->format);
+	unsigned int channels = a->channels > b->channels ? a->channels : b->channels;
+	int width = wa > wb ? wa : wb;
+
+	if (width < 8)
+		width = 8;
+	return cost * channels * (width / 8);
+}
+
+/* describe the inserted plugin, the client side parameters first */
+static void snd_pcm_plug_step_desc(char *buf, size_t size, const char *name,
+				   const snd_pcm_plug_params_t *c,
+				   const snd_pcm_plug_params_t *s)
+{
+	int n;
+
+	n = snprintf(buf, size, "%s", name);
+	if (c->channels != s->channels && n < (int)size)
+		n += snprintf(buf + n, size - n, " %u->%uch", c->channels, s->channels);
+	else if (n < (int)size)
+		n += snprintf(buf + n, size - n, " %uch", c->channels);
+	if (c->rate != s->rate && n < (int)size)
+		n += snprintf(buf + n, size - n, " %u->%uHz", c->rate, s->rate);
+	if (c->format != s->format && n < (int)size)
+		n += snprintf(buf + n, size - n, " %s->%s",
+			      snd_pcm_format_name(c->format),
+			      snd_pcm_format_name(s->format));
+	else if (n < (int)size)
+		snprintf(buf + n, size - n, " %s", snd_pcm_format_name(c->format));
+}
+
+/*
+ * Walk the steps with the current plug->plan. With open set the plugins
+ * are inserted, otherwise only the parameters are followed to estimate
+ * the cost. Returns -EINVAL when the plan does not reach the client.
+ */
+static int snd_pcm_plug_run_plan(snd_pcm_t *pcm,
+				 snd_pcm_plug_params_t *client,
+				 snd_pcm_plug_params_t *slave,
+				 int open, unsigned int *cost)
+{
+	snd_pcm_plug_t *plug = pcm->private_data;
+	snd_pcm_plug_params_t p = *slave, prev;
 	unsigned int k = 0;
+	char desc[256], item[96], tmp[256];
+
+	*cost = 0;
+	desc[0] = '\0';
 	plug->ttable_ok = 0;
+	plug->gain_ok = 0;
 	while (client->format != p.format ||
 	       client->channels != p.channels ||
 	       client->rate != p.rate ||
 	       client->access != p.access ||
-	       (plug->ttable && !plug->ttable_ok)) {
-		snd_pcm_t *new;
+	       snd_pcm_plug_route_pending(plug)) {
+		snd_pcm_t *new = NULL;
 		int err;
-		if (k >= sizeof(funcs)/sizeof(*funcs)) {
-			snd_pcm_plug_clear(pcm);
+		if (k >= sizeof(snd_pcm_plug_steps)/sizeof(*snd_pcm_plug_steps)) {
+			if (open)
+				snd_pcm_plug_clear(pcm);
 			return -EINVAL;
 		}
-		err = funcs[k](pcm, &new, client, &p);
+		prev = p;
+		err = snd_pcm_plug_steps[k].func(pcm, open ? &new : NULL, client, &p);
 		if (err < 0) {
-			snd_pcm_plug_clear(pcm);
+			if (open)
+				snd_pcm_plug_clear(pcm);
 			return err;
 		}
 		if (err) {
+			unsigned int c = snd_pcm_plug_steps[k].cost;
+#ifdef BUILD_PCM_PLUGIN_RATE
+			/* the rate converters work on S16 or S32, a packed
+			 * format is unpacked and packed again around them */
+			if (snd_pcm_plug_steps[k].func == snd_pcm_plug_change_rate &&
+			    snd_pcm_format_physical_width(prev.format) == 24)
+				c = PLUG_COST_RATE_PACKED;
+#endif
+			*cost += snd_pcm_plug_step_cost(c, &p, &prev);
+			snd_pcm_plug_step_desc(item, sizeof(item),
+					       snd_pcm_plug_steps[k].name, &p, &prev);
+			/* the outer plugins are listed first */
+			if (desc[0])
+				snprintf(tmp, sizeof(tmp), "%s | %s", item, desc);
+			else
+				snprintf(tmp, sizeof(tmp), "%s", item);
+			strcpy(desc, tmp);
+		}
+		if (err && open) {
+			/* converters inserted by plug follow its buffer policy */
+			new->mem = pcm->mem;
 			plug->gen.slave = new;
 		}
 		k++;
 	}
+	if (open)
+		snprintf(plug->plan_desc, sizeof(plug->plan_desc), "%s", desc);
 	return 0;
 }
 
+/*
+ * Estimate every candidate placement of the conversions and build the
+ * cheapest chain.
+ */
+static int snd_pcm_plug_insert_plugins(snd_pcm_t *pcm,
+				       snd_pcm_plug_params_t *client,
+				       snd_pcm_plug_params_t *slave)
+{
+	snd_pcm_plug_t *plug = pcm->private_data;
+	unsigned int k, cost, best_cost = 0, best = 0;
+	int found = 0;
+
+	for (k = 0; k < sizeof(snd_pcm_plug_plans)/sizeof(*snd_pcm_plug_plans); k++) {
+		plug->plan = snd_pcm_plug_plans[k];
+		if (snd_pcm_plug_run_plan(pcm, client, slave, 0, &cost) < 0)
+			continue;
+		if (!found || cost < best_cost) {
+			best = plug->plan;
+			best_cost = cost;
+			found = 1;
+		}
+	}
+	plug->plan = best;
+	plug->plan_cost = best_cost;
+	return snd_pcm_plug_run_plan(pcm, client, slave, 1, &cost);
+}
+
 static int snd_pcm_plug_hw_refine_cprepare(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_hw_params_t *params)
 {
 	unsigned int rate_min, channels_max;
@@ -1032,7 +1217,7 @@ static int snd_pcm_plug_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	if (!(clt_params.format == slv_params.format &&
 	      clt_params.channels == slv_params.channels &&
 	      clt_params.rate == slv_params.rate &&
-	      !plug->ttable &&
+	      !plug->ttable && !plug->gain &&
 	      snd_pcm_hw_params_test_access(slave, &sparams,
 					    clt_params.access) >= 0)) {
 		INTERNAL(snd_pcm_hw_params_set_access_first)(slave, &sparams, &slv_params.access);
@@ -1041,6 +1226,7 @@ static int snd_pcm_plug_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 			return err;
 	}
 	slave = plug->gen.slave;
+	slave->mmap_inplace = pcm->mmap_inplace;
 	err = _snd_pcm_hw_params_internal(slave, params);
 	if (err < 0) {
 		snd_pcm_plug_clear(pcm);
@@ -1049,8 +1235,7 @@ static int snd_pcm_plug_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	snd_pcm_unlink_hw_ptr(pcm, plug->req_slave);
 	snd_pcm_unlink_appl_ptr(pcm, plug->req_slave);
 
-	pcm->fast_ops = slave->fast_ops;
-	pcm->fast_op_arg = slave->fast_op_arg;
+	snd_pcm_generic_bypass(pcm);
 	snd_pcm_link_hw_ptr(pcm, slave);
 	snd_pcm_link_appl_ptr(pcm, slave);
 	return 0;
@@ -1070,6 +1255,9 @@ static void snd_pcm_plug_dump(snd_pcm_t *pcm, snd_output_t *out)
 	snd_pcm_plug_t *plug = pcm->private_data;
 	snd_output_printf(out, "Plug PCM: ");
 	snd_pcm_dump(plug->gen.slave, out);
+	if (plug->plan_desc[0])
+		snd_output_printf(out, "Plug plan: %s (estimated cost %u per frame)\n",
+				  plug->plan_desc, plug->plan_cost);
 }
 
 static const snd_pcm_ops_t snd_pcm_plug_ops = {
@@ -1165,6 +1353,14 @@ int snd_pcm_plug_open(snd_pcm_t **pcmp,
 \section pcm_plugins_plug Automatic conversion plugin
 
 This plugin converts channels, rate and format on request.
+The order of the inserted converters is chosen by estimating the cost
+per frame (channels, sample width and conversion type) of the possible
+chains; #snd_pcm_dump() shows the chosen chain and its estimated cost.
+A rate converter on a packed 3-byte format costs four times as much,
+as it has to unpack and pack the samples around the conversion.
+With a volume definition the soft volume is applied by the route
+converter in the same pass as the format and channel conversion,
+instead of a separate softvol plugin.
 
 \code
 pcm.name {
@@ -1195,6 +1391,17 @@ pcm.name {
 	rate_converter [ STR1 STR2 ... ]
 				# type of rate converter
 				# default value is taken from defaults.pcm.rate_converter
+	volume {		# Soft volume applied by the route converter
+		control {	# control element id as for the softvol plugin
+			name STR
+			...
+		}
+		[min_dB REAL]	# minimal dB value (default: -51.0)
+		[max_dB REAL]	# maximal dB value (default: 0.0)
+		[resolution INT] # resolution (default: 256)
+		[watch_ctl BOOL] # follow the control from a shared
+				# thread (default: no)
+	}
 }
 \endcode
 
@@ -1236,6 +1443,7 @@ int _snd_pcm_plug_open(snd_pcm_t **pcmp, const char *name,
 	snd_pcm_format_t sformat = SND_PCM_FORMAT_UNKNOWN;
 	int schannels = -1, srate = -1;
 	const snd_config_t *rate_converter = NULL;
+	snd_config_t *volume = NULL;
 
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
@@ -1282,6 +1490,12 @@ int _snd_pcm_plug_open(snd_pcm_t **pcmp, const char *name,
 			rate_converter = n;
 			continue;
 		}
+#endif
+#ifdef BUILD_PCM_PLUG_GAIN
+		if (strcmp(id, "volume") == 0) {
+			volume = n;
+			continue;
+		}
 #endif
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
@@ -1327,8 +1541,18 @@ int _snd_pcm_plug_open(snd_pcm_t **pcmp, const char *name,
 		return err;
 	err = snd_pcm_plug_open(pcmp, name, sformat, schannels, srate, rate_converter,
 				route_policy, ttable, ssize, cused, sused, spcm, 1);
-	if (err < 0)
+	if (err < 0) {
 		snd_pcm_close(spcm);
+		return err;
+	}
+#ifdef BUILD_PCM_PLUG_GAIN
+	if (volume && !(mode & SND_PCM_NO_SOFTVOL)) {
+		snd_pcm_plug_t *plug = (*pcmp)->private_data;
+		err = snd_pcm_softvol_gain_open(&plug->gain, spcm, volume);
+		if (err < 0)
+			snd_pcm_close(*pcmp);
+	}
+#endif
 	return err;
 }
 #ifndef DOC_HIDDEN
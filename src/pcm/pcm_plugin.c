@@ -80,6 +80,38 @@ pcm.rate44100Hz {
 }
 \endcode
 
+\section pcm_plugins_memory Buffer placement
+
+Every PCM definition accepts a <code>memory</code> compound which tells
+where the internal buffers of the plugin (mmap bounce buffers, rate and
+LADSPA work areas, the dmix sum buffer) are allocated.  Without it,
+<code>defaults.pcm.memory</code> is used when defined.  Converters
+inserted by the plug plugin follow the policy of the plug definition.
+
+\code
+pcm.NAME {
+	...
+	memory {
+		hugepages BOOL	# use huge pages (default false)
+		mlock BOOL	# lock the buffers in memory (default false)
+		node INT	# bind the buffers to this NUMA node (default -1 = any)
+	}
+}
+\endcode
+
+\section pcm_plugins_profile Transfer profiling
+
+When the environment variable <code>LIBASOUND_PLUGIN_PROFILE</code> is set
+to a non-zero value while a PCM is opened, the conversion plugins (linear,
+route, softvol, ladspa, extplug and the others built on the common plugin
+code) account the time spent in their transfer callbacks.  The counters
+are printed by #snd_pcm_dump() and can be read with
+#snd_pcm_plugin_profile_get().
+
+\code
+LIBASOUND_PLUGIN_PROFILE=1 aplay -v -D plug:softvol foo.wav
+\endcode
+
 */
   
 #include <limits.h>
@@ -128,11 +160,140 @@ snd_pcm_plugin_undo_write_generic(snd_pcm_t *pcm ATTRIBUTE_UNUSED,
 	return slave_undo_size;
 }
 
+/*
+ * A plugin sets passthrough from its hw_params callback when the
+ * configured transfer would hand the samples on unchanged (same format
+ * and channel layout on both sides, unity gain).  The per-sample
+ * transfer callback is then bypassed and the areas are copied straight
+ * into (or out of) the slave buffer; snd_pcm_areas_copy collapses
+ * interleaved runs into a single memcpy.
+ */
+static snd_pcm_uframes_t
+snd_pcm_plugin_passthrough_write(snd_pcm_t *pcm,
+				 const snd_pcm_channel_area_t *areas,
+				 snd_pcm_uframes_t offset,
+				 snd_pcm_uframes_t size,
+				 const snd_pcm_channel_area_t *slave_areas,
+				 snd_pcm_uframes_t slave_offset,
+				 snd_pcm_uframes_t *slave_sizep)
+{
+	if (size > *slave_sizep)
+		size = *slave_sizep;
+	snd_pcm_areas_copy(slave_areas, slave_offset, areas, offset,
+			   pcm->channels, size, pcm->format);
+	*slave_sizep = size;
+	return size;
+}
+
+static snd_pcm_uframes_t
+snd_pcm_plugin_passthrough_read(snd_pcm_t *pcm,
+				const snd_pcm_channel_area_t *areas,
+				snd_pcm_uframes_t offset,
+				snd_pcm_uframes_t size,
+				const snd_pcm_channel_area_t *slave_areas,
+				snd_pcm_uframes_t slave_offset,
+				snd_pcm_uframes_t *slave_sizep)
+{
+	if (size > *slave_sizep)
+		size = *slave_sizep;
+	snd_pcm_areas_copy(areas, offset, slave_areas, slave_offset,
+			   pcm->channels, size, pcm->format);
+	*slave_sizep = size;
+	return size;
+}
+
+static inline snd_pcm_slave_xfer_areas_func_t
+snd_pcm_plugin_write_func(const snd_pcm_plugin_t *plugin)
+{
+	return plugin->passthrough ? snd_pcm_plugin_passthrough_write : plugin->write;
+}
+
+static inline snd_pcm_slave_xfer_areas_func_t
+snd_pcm_plugin_read_func(const snd_pcm_plugin_t *plugin)
+{
+	return plugin->passthrough ? snd_pcm_plugin_passthrough_read : plugin->read;
+}
+
+static inline unsigned long long snd_pcm_plugin_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Calls the transfer callback, accounting the time spent in it when
+ * profiling is enabled.  Only the conversion of this layer is measured,
+ * the commit to the slave is not.
+ */
+static snd_pcm_uframes_t
+snd_pcm_plugin_xfer(snd_pcm_t *pcm, snd_pcm_slave_xfer_areas_func_t func,
+		    const snd_pcm_channel_area_t *areas,
+		    snd_pcm_uframes_t offset,
+		    snd_pcm_uframes_t size,
+		    const snd_pcm_channel_area_t *slave_areas,
+		    snd_pcm_uframes_t slave_offset,
+		    snd_pcm_uframes_t *slave_sizep)
+{
+	snd_pcm_plugin_t *plugin = pcm->private_data;
+	snd_pcm_plugin_prof_t *prof = &plugin->prof;
+	struct timespec t0, t1;
+	unsigned long long c0, ns;
+	snd_pcm_uframes_t frames;
+
+	if (!plugin->profile)
+		return func(pcm, areas, offset, size,
+			    slave_areas, slave_offset, slave_sizep);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	c0 = snd_pcm_plugin_cycles();
+	frames = func(pcm, areas, offset, size,
+		      slave_areas, slave_offset, slave_sizep);
+	prof->cycles += snd_pcm_plugin_cycles() - c0;
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	ns = (t1.tv_sec - t0.tv_sec) * 1000000000ULL + t1.tv_nsec - t0.tv_nsec;
+	prof->calls++;
+	prof->frames += frames;
+	prof->nsecs += ns;
+	if (ns > prof->max_nsecs)
+		prof->max_nsecs = ns;
+	return frames;
+}
+
 void snd_pcm_plugin_init(snd_pcm_plugin_t *plugin)
 {
+	const char *p;
+
 	memset(plugin, 0, sizeof(snd_pcm_plugin_t));
 	plugin->undo_read = snd_pcm_plugin_undo_read;
 	plugin->undo_write = snd_pcm_plugin_undo_write;
+	p = getenv("LIBASOUND_PLUGIN_PROFILE");
+	plugin->profile = p && *p && *p != '0';
+}
+
+void snd_pcm_plugin_dump_profile(snd_pcm_t *pcm, snd_output_t *out)
+{
+	snd_pcm_plugin_t *plugin = pcm->private_data;
+	const snd_pcm_plugin_prof_t *prof = &plugin->prof;
+
+	if (!plugin->profile)
+		return;
+	snd_output_printf(out, "Profile: calls %llu, frames %llu",
+			  prof->calls, prof->frames);
+	if (prof->frames) {
+		if (prof->cycles)
+			snd_output_printf(out, ", %.1f cycles/frame",
+					  (double)prof->cycles / prof->frames);
+		snd_output_printf(out, ", %.1f ns/frame",
+				  (double)prof->nsecs / prof->frames);
+	}
+	snd_output_printf(out, ", max %llu ns", prof->max_nsecs);
+	if (prof->resyncs)
+		snd_output_printf(out, ", resyncs %llu, %.1f us each",
+				  prof->resyncs,
+				  prof->resync_nsecs / 1000.0 / prof->resyncs);
+	snd_output_putc(out, '\n');
 }
 
 static int snd_pcm_plugin_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
@@ -172,6 +333,33 @@ static int snd_pcm_plugin_prepare(snd_pcm_t *pcm)
 	return snd_pcm_plugin_call_init_cb(pcm, plugin);
 }
 
+/*
+ * Realign to the slave without calling the init callback, so that the
+ * converter state (ADPCM predictor, LADSPA and extplug filters) stays.
+ */
+static int snd_pcm_plugin_resync(snd_pcm_t *pcm)
+{
+	snd_pcm_plugin_t *plugin = pcm->private_data;
+	snd_pcm_t *slave = plugin->gen.slave;
+	struct timespec t0, t1;
+	int err;
+
+	if (plugin->profile)
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+	err = snd_pcm_resync(slave);
+	if (err < 0)
+		return err;
+	*pcm->hw.ptr = *slave->hw.ptr;
+	*pcm->appl.ptr = *slave->appl.ptr;
+	if (plugin->profile) {
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		plugin->prof.resyncs++;
+		plugin->prof.resync_nsecs += (t1.tv_sec - t0.tv_sec) * 1000000000ULL +
+					     t1.tv_nsec - t0.tv_nsec;
+	}
+	return 0;
+}
+
 static int snd_pcm_plugin_reset(snd_pcm_t *pcm)
 {
 	snd_pcm_plugin_t *plugin = pcm->private_data;
@@ -254,8 +442,9 @@ static snd_pcm_sframes_t snd_pcm_plugin_write_areas(snd_pcm_t *pcm,
 		}
 		if (slave_frames == 0)
 			break;
-		frames = plugin->write(pcm, areas, offset, frames,
-				       slave_areas, slave_offset, &slave_frames);
+		frames = snd_pcm_plugin_xfer(pcm, snd_pcm_plugin_write_func(plugin),
+					     areas, offset, frames,
+					     slave_areas, slave_offset, &slave_frames);
 		if (CHECK_SANITY(slave_frames > snd_pcm_mmap_playback_avail(slave))) {
 			SNDMSG("write overflow %ld > %ld", slave_frames,
 			       snd_pcm_mmap_playback_avail(slave));
@@ -311,8 +500,9 @@ static snd_pcm_sframes_t snd_pcm_plugin_read_areas(snd_pcm_t *pcm,
 		}
 		if (slave_frames == 0)
 			break;
-		frames = (plugin->read)(pcm, areas, offset, frames,
-				      slave_areas, slave_offset, &slave_frames);
+		frames = snd_pcm_plugin_xfer(pcm, snd_pcm_plugin_read_func(plugin),
+					     areas, offset, frames,
+					     slave_areas, slave_offset, &slave_frames);
 		if (CHECK_SANITY(slave_frames > snd_pcm_mmap_capture_avail(slave))) {
 			SNDMSG("read overflow %ld > %ld", slave_frames,
 			       snd_pcm_mmap_playback_avail(slave));
@@ -420,8 +610,9 @@ snd_pcm_plugin_mmap_commit(snd_pcm_t *pcm,
 		}
 		if (frames > cont)
 			frames = cont;
-		frames = plugin->write(pcm, areas, appl_offset, frames,
-				       slave_areas, slave_offset, &slave_frames);
+		frames = snd_pcm_plugin_xfer(pcm, snd_pcm_plugin_write_func(plugin),
+					     areas, appl_offset, frames,
+					     slave_areas, slave_offset, &slave_frames);
 		result = snd_pcm_mmap_commit(slave, slave_offset, slave_frames);
 		if (result > 0 && (snd_pcm_uframes_t)result != slave_frames) {
 			snd_pcm_sframes_t res;
@@ -492,8 +683,9 @@ snd_pcm_plugin_sync_hw_ptr_capture(snd_pcm_t *pcm,
 		}
 		if (frames > cont)
 			frames = cont;
-		frames = (plugin->read)(pcm, areas, hw_offset, frames,
-					slave_areas, slave_offset, &slave_frames);
+		frames = snd_pcm_plugin_xfer(pcm, snd_pcm_plugin_read_func(plugin),
+					     areas, hw_offset, frames,
+					     slave_areas, slave_offset, &slave_frames);
 		result = snd_pcm_mmap_commit(slave, slave_offset, slave_frames);
 		if (result > 0 && (snd_pcm_uframes_t)result != slave_frames) {
 			snd_pcm_sframes_t res;
@@ -659,6 +851,7 @@ const snd_pcm_fast_ops_t snd_pcm_plugin_fast_ops = {
 	.delay = snd_pcm_plugin_delay,
 	.prepare = snd_pcm_plugin_prepare,
 	.reset = snd_pcm_plugin_reset,
+	.resync = snd_pcm_plugin_resync,
 	.start = snd_pcm_generic_start,
 	.drop = snd_pcm_generic_drop,
 	.drain = snd_pcm_generic_drain,
@@ -685,3 +878,65 @@ const snd_pcm_fast_ops_t snd_pcm_plugin_fast_ops = {
 };
 
 #endif
+
+/**
+ * \brief Get the transfer profile of a plugin in a PCM chain
+ * \param pcm PCM handle
+ * \param index index of the profiled plugin, 0 is the nearest to \p pcm
+ * \param prof Returned counters
+ * \return 0 on success, -ENOENT if there is no such plugin
+ *
+ * The chain is walked from \p pcm towards the hardware and only the
+ * layers built on the common plugin code (linear, route, softvol, ...)
+ * are counted.  Profiling is enabled by setting the environment variable
+ * LIBASOUND_PLUGIN_PROFILE before the PCM is opened, see
+ * \ref pcm_plugins_profile.  The counters are read without locking.
+ */
+int snd_pcm_plugin_profile_get(snd_pcm_t *pcm, unsigned int index,
+			       snd_pcm_plugin_profile_t *prof)
+{
+	assert(pcm && prof);
+	while (pcm) {
+		snd_pcm_plugin_t *plugin;
+
+		switch (pcm->type) {
+		case SND_PCM_TYPE_COPY:
+		case SND_PCM_TYPE_LINEAR:
+		case SND_PCM_TYPE_ALAW:
+		case SND_PCM_TYPE_MULAW:
+		case SND_PCM_TYPE_ADPCM:
+		case SND_PCM_TYPE_ROUTE:
+		case SND_PCM_TYPE_LINEAR_FLOAT:
+		case SND_PCM_TYPE_LADSPA:
+		case SND_PCM_TYPE_IEC958:
+		case SND_PCM_TYPE_SOFTVOL:
+		case SND_PCM_TYPE_EXTPLUG:
+			plugin = pcm->private_data;
+			if (plugin->profile && index-- == 0) {
+				prof->type = pcm->type;
+				prof->name = pcm->name;
+				prof->calls = plugin->prof.calls;
+				prof->frames = plugin->prof.frames;
+				prof->cycles = plugin->prof.cycles;
+				prof->nsecs = plugin->prof.nsecs;
+				prof->max_nsecs = plugin->prof.max_nsecs;
+				prof->resyncs = plugin->prof.resyncs;
+				prof->resync_nsecs = plugin->prof.resync_nsecs;
+				return 0;
+			}
+			pcm = plugin->gen.slave;
+			break;
+		case SND_PCM_TYPE_HOOKS:
+		case SND_PCM_TYPE_FILE:
+		case SND_PCM_TYPE_PLUG:
+		case SND_PCM_TYPE_RATE:
+		case SND_PCM_TYPE_METER:
+		case SND_PCM_TYPE_MMAP_EMUL:
+			pcm = ((snd_pcm_generic_t *)pcm->private_data)->slave;
+			break;
+		default:
+			return -ENOENT;
+		}
+	}
+	return -ENOENT;
+}
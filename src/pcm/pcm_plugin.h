@@ -37,6 +37,16 @@ typedef snd_pcm_sframes_t (*snd_pcm_slave_xfer_areas_undo_func_t)
       snd_pcm_uframes_t res_size,		/* size of result areas */
       snd_pcm_uframes_t slave_undo_size);
 
+typedef struct {
+	unsigned long long calls;	/* transfer callback invocations */
+	unsigned long long frames;	/* frames handed to the callback */
+	unsigned long long cycles;	/* TSC cycles, 0 without a TSC */
+	unsigned long long nsecs;	/* total time in the callback */
+	unsigned long long max_nsecs;	/* slowest single call */
+	unsigned long long resyncs;	/* snd_pcm_resync() calls */
+	unsigned long long resync_nsecs; /* time in them, with the slave */
+} snd_pcm_plugin_prof_t;
+
 typedef struct {
 	snd_pcm_generic_t gen;
 	snd_pcm_slave_xfer_areas_func_t read;
@@ -44,7 +54,10 @@ typedef struct {
 	snd_pcm_slave_xfer_areas_undo_func_t undo_read;
 	snd_pcm_slave_xfer_areas_undo_func_t undo_write;
 	int (*init)(snd_pcm_t *pcm);
+	int passthrough;	/* set at hw_params when the transfer is an identity */
 	snd_pcm_uframes_t appl_ptr, hw_ptr;
+	int profile;		/* $LIBASOUND_PLUGIN_PROFILE was set at open */
+	snd_pcm_plugin_prof_t prof;
 } snd_pcm_plugin_t;	
 
 /* make local functions really local */
@@ -64,6 +77,8 @@ typedef struct {
 	snd1_pcm_plugin_rewind
 #define snd_pcm_plugin_forward \
 	snd1_pcm_plugin_forward
+#define snd_pcm_plugin_dump_profile \
+	snd1_pcm_plugin_dump_profile
 
 void snd_pcm_plugin_init(snd_pcm_plugin_t *plugin);
 snd_pcm_sframes_t snd_pcm_plugin_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t frames);
@@ -71,6 +86,7 @@ snd_pcm_sframes_t snd_pcm_plugin_forward(snd_pcm_t *pcm, snd_pcm_uframes_t frame
 int snd_pcm_plugin_may_wait_for_avail_min_conv(snd_pcm_t *pcm, snd_pcm_uframes_t avail,
 					       snd_pcm_uframes_t (*conv)(snd_pcm_t *, snd_pcm_uframes_t));
 int snd_pcm_plugin_may_wait_for_avail_min(snd_pcm_t *pcm, snd_pcm_uframes_t avail);
+void snd_pcm_plugin_dump_profile(snd_pcm_t *pcm, snd_output_t *out);
 
 extern const snd_pcm_fast_ops_t snd_pcm_plugin_fast_ops;
 
@@ -100,6 +116,11 @@ snd_pcm_sframes_t snd_pcm_plugin_undo_write_generic
 #define snd_pcm_mulaw_encode	snd1_pcm_mulaw_encode
 #define snd_pcm_adpcm_decode	snd1_pcm_adpcm_decode
 #define snd_pcm_adpcm_encode	snd1_pcm_adpcm_encode
+#define snd_pcm_softvol_gain_open	snd1_pcm_softvol_gain_open
+#define snd_pcm_softvol_gain_close	snd1_pcm_softvol_gain_close
+#define snd_pcm_softvol_gain_scales	snd1_pcm_softvol_gain_scales
+#define snd_pcm_softvol_gain_dump	snd1_pcm_softvol_gain_dump
+#define snd_pcm_route_set_gain	snd1_pcm_route_set_gain
 
 int snd_pcm_linear_get_index(snd_pcm_format_t src_format, snd_pcm_format_t dst_format);
 int snd_pcm_linear_put_index(snd_pcm_format_t src_format, snd_pcm_format_t dst_format);
@@ -157,3 +178,15 @@ void snd_pcm_adpcm_encode(const snd_pcm_channel_area_t *dst_areas,
 			  unsigned int channels, snd_pcm_uframes_t frames,
 			  unsigned int getidx,
 			  snd_pcm_adpcm_state_t *states);
+
+/* soft volume applied inside the route stage of the plug plugin */
+typedef struct snd_pcm_softvol_gain snd_pcm_softvol_gain_t;
+
+int snd_pcm_softvol_gain_open(snd_pcm_softvol_gain_t **gainp,
+			      snd_pcm_t *pcm, snd_config_t *conf);
+void snd_pcm_softvol_gain_close(snd_pcm_softvol_gain_t *gain);
+int snd_pcm_softvol_gain_scales(snd_pcm_softvol_gain_t *gain,
+				unsigned int *scales, unsigned int channels);
+void snd_pcm_softvol_gain_dump(snd_pcm_softvol_gain_t *gain,
+			       snd_output_t *out);
+int snd_pcm_route_set_gain(snd_pcm_t *pcm, snd_pcm_softvol_gain_t *gain);
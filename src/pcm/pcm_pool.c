@@ -0,0 +1,369 @@
+/**
+ * \file pcm/pcm_pool.c
+ * \ingroup PCM_Pool
+ * \brief PCM Handle Pool
+ * \date 2026
+ */
+/*
+ *  PCM - pool of configured handles
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * A handle returned to the pool is dropped and prepared again, and kept
+ * with the key it was opened with: the name, the stream, the open mode
+ * and the hw_params container the application asked for.  The next
+ * request with the same key gets it back without the configuration
+ * lookup, the plugin open, the hw_params negotiation and, for the
+ * direct plugins, the shm attach.  There is no thread: the idle
+ * handles are expired when the pool is used.
+ */
+
+#include "pcm_local.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef DOC_HIDDEN
+struct pool_entry {
+	struct list_head list;
+	snd_pcm_t *pcm;
+	char *name;
+	snd_pcm_stream_t stream;
+	int mode;
+	int has_params;
+	snd_pcm_hw_params_t params;	/* as requested, not as refined */
+	long long idle_since;		/* ms, monotonic */
+};
+
+struct _snd_pcm_pool {
+	struct list_head idle;		/* most recently returned first */
+	struct list_head busy;		/* handed out by the pool */
+	unsigned int nidle;
+	unsigned int max_idle;
+	unsigned int timeout;		/* ms, 0 = forever */
+#ifdef THREAD_SAFE_API
+	pthread_mutex_t mutex;
+#endif
+};
+
+#ifdef THREAD_SAFE_API
+#define pool_lock(pool)		pthread_mutex_lock(&(pool)->mutex)
+#define pool_unlock(pool)	pthread_mutex_unlock(&(pool)->mutex)
+#else
+#define pool_lock(pool)		do {} while (0)
+#define pool_unlock(pool)	do {} while (0)
+#endif
+#endif
+
+static long long pool_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static void pool_entry_free(struct pool_entry *entry)
+{
+	if (entry->pcm)
+		snd_pcm_close(entry->pcm);
+	free(entry->name);
+	free(entry);
+}
+
+/* unlink the expired idle entries, call with the lock held */
+static void pool_expire(snd_pcm_pool_t *pool, struct list_head *dead)
+{
+	struct list_head *pos, *npos;
+	long long now;
+
+	if (pool->timeout == 0)
+		return;
+	now = pool_now();
+	list_for_each_safe(pos, npos, &pool->idle) {
+		struct pool_entry *entry = list_entry(pos, struct pool_entry, list);
+		if (now - entry->idle_since < pool->timeout)
+			continue;
+		list_del(&entry->list);
+		list_add_tail(&entry->list, dead);
+		pool->nidle--;
+	}
+}
+
+/* close the unlinked entries, without the lock */
+static void pool_reap(struct list_head *dead)
+{
+	while (!list_empty(dead)) {
+		struct pool_entry *entry = list_entry(dead->next, struct pool_entry, list);
+		list_del(&entry->list);
+		pool_entry_free(entry);
+	}
+}
+
+/**
+ * \brief Create a pool of configured PCM handles
+ * \param poolp Returned pool
+ * \param max_idle Maximum number of idle handles kept
+ * \param timeout Idle handles older than this are closed, in ms (0 = never)
+ * \return 0 on success otherwise a negative error code
+ *
+ * This function is added in version 1.2.8.
+ */
+int snd_pcm_pool_open(snd_pcm_pool_t **poolp, unsigned int max_idle,
+		      unsigned int timeout)
+{
+	snd_pcm_pool_t *pool;
+
+	assert(poolp);
+	pool = calloc(1, sizeof(*pool));
+	if (pool == NULL)
+		return -ENOMEM;
+	INIT_LIST_HEAD(&pool->idle);
+	INIT_LIST_HEAD(&pool->busy);
+	pool->max_idle = max_idle;
+	pool->timeout = timeout;
+#ifdef THREAD_SAFE_API
+	pthread_mutex_init(&pool->mutex, NULL);
+#endif
+	*poolp = pool;
+	return 0;
+}
+
+/**
+ * \brief Close a pool
+ * \param pool Pool handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * The idle handles are closed.  The handles still in use are not: they
+ * belong to the application from now on, which must close them with
+ * #snd_pcm_close.  They must not be passed to #snd_pcm_pool_put, the
+ * pool no longer exists.
+ *
+ * This function is added in version 1.2.8.
+ */
+int snd_pcm_pool_close(snd_pcm_pool_t *pool)
+{
+	struct list_head *pos, *npos;
+
+	assert(pool);
+	pool_reap(&pool->idle);
+	/* forget the busy handles, they belong to the application now */
+	list_for_each_safe(pos, npos, &pool->busy) {
+		struct pool_entry *entry = list_entry(pos, struct pool_entry, list);
+		list_del(&entry->list);
+		entry->pcm = NULL;
+		pool_entry_free(entry);
+	}
+#ifdef THREAD_SAFE_API
+	pthread_mutex_destroy(&pool->mutex);
+#endif
+	free(pool);
+	return 0;
+}
+
+static int pool_match(const struct pool_entry *entry, const char *name,
+		      snd_pcm_stream_t stream, int mode,
+		      const snd_pcm_hw_params_t *params)
+{
+	if (entry->stream != stream || entry->mode != mode ||
+	    strcmp(entry->name, name))
+		return 0;
+	if (params == NULL)
+		return !entry->has_params;
+	return entry->has_params &&
+	       memcmp(&entry->params, params, sizeof(*params)) == 0;
+}
+
+/**
+ * \brief Get a configured PCM handle from a pool
+ * \param pool Pool handle
+ * \param pcmp Returned PCM handle
+ * \param name PCM name, as for #snd_pcm_open
+ * \param stream Stream direction
+ * \param mode Open mode
+ * \param params Hardware parameters to install, NULL to leave the handle
+ *               unconfigured
+ * \param swparams Software parameters to install (may be NULL)
+ * \return 1 when the handle was reused, 0 when it was opened, otherwise
+ *         a negative error code
+ *
+ * An idle handle opened with the same name, stream, mode and the same
+ * \p params container (compared byte by byte, so build it the same way
+ * each time) is returned in the PREPARED state.  Otherwise a new handle
+ * is opened, and \p params is installed from a copy.  \p swparams is
+ * installed in both cases.
+ *
+ * Return the handle with #snd_pcm_pool_put instead of closing it.
+ *
+ * This function is added in version 1.2.8.
+ */
+int snd_pcm_pool_get(snd_pcm_pool_t *pool, snd_pcm_t **pcmp, const char *name,
+		     snd_pcm_stream_t stream, int mode,
+		     const snd_pcm_hw_params_t *params,
+		     const snd_pcm_sw_params_t *swparams)
+{
+	struct pool_entry *entry = NULL;
+	struct list_head *pos, dead;
+	snd_pcm_hw_params_t hw;
+	int err, reused = 0;
+
+	assert(pool && pcmp && name);
+	INIT_LIST_HEAD(&dead);
+	pool_lock(pool);
+	pool_expire(pool, &dead);
+	list_for_each(pos, &pool->idle) {
+		struct pool_entry *e = list_entry(pos, struct pool_entry, list);
+		if (pool_match(e, name, stream, mode, params)) {
+			entry = e;
+			list_del(&entry->list);
+			pool->nidle--;
+			break;
+		}
+	}
+	pool_unlock(pool);
+	pool_reap(&dead);
+
+	if (entry) {
+		reused = 1;
+		if (snd_pcm_state(entry->pcm) != SND_PCM_STATE_PREPARED) {
+			err = snd_pcm_prepare(entry->pcm);
+			if (err < 0)
+				goto _err;
+		}
+	} else {
+		entry = calloc(1, sizeof(*entry));
+		if (entry == NULL)
+			return -ENOMEM;
+		entry->name = strdup(name);
+		if (entry->name == NULL) {
+			err = -ENOMEM;
+			goto _err;
+		}
+		entry->stream = stream;
+		entry->mode = mode;
+		err = snd_pcm_open(&entry->pcm, name, stream, mode);
+		if (err < 0)
+			goto _err;
+		if (params) {
+			entry->has_params = 1;
+			entry->params = *params;
+			hw = *params;
+			err = snd_pcm_hw_params(entry->pcm, &hw);
+			if (err < 0)
+				goto _err;
+		}
+	}
+	if (swparams) {
+		err = snd_pcm_sw_params(entry->pcm, (snd_pcm_sw_params_t *)swparams);
+		if (err < 0)
+			goto _err;
+	}
+	pool_lock(pool);
+	list_add(&entry->list, &pool->busy);
+	pool_unlock(pool);
+	*pcmp = entry->pcm;
+	return reused;
+
+ _err:
+	pool_entry_free(entry);
+	return err;
+}
+
+/**
+ * \brief Return a PCM handle to a pool
+ * \param pool Pool handle
+ * \param pcm PCM handle from #snd_pcm_pool_get
+ * \return 0 on success otherwise a negative error code
+ *
+ * The stream is dropped and prepared again, and the handle is kept for
+ * the next matching #snd_pcm_pool_get.  When the pool holds \p max_idle
+ * handles already, the least recently returned one is closed.  A handle
+ * the pool cannot prepare again is closed, and a handle that does not
+ * come from the pool is closed as well (-EINVAL).
+ *
+ * This function is added in version 1.2.8.
+ */
+int snd_pcm_pool_put(snd_pcm_pool_t *pool, snd_pcm_t *pcm)
+{
+	struct pool_entry *entry = NULL;
+	struct list_head *pos, dead;
+	int err;
+
+	assert(pool && pcm);
+	INIT_LIST_HEAD(&dead);
+	pool_lock(pool);
+	list_for_each(pos, &pool->busy) {
+		struct pool_entry *e = list_entry(pos, struct pool_entry, list);
+		if (e->pcm == pcm) {
+			entry = e;
+			list_del(&entry->list);
+			break;
+		}
+	}
+	pool_unlock(pool);
+	if (entry == NULL) {
+		snd_pcm_close(pcm);
+		return -EINVAL;
+	}
+	snd_pcm_drop(pcm);
+	err = pcm->setup ? snd_pcm_prepare(pcm) : 0;
+	if (err < 0 || pool->max_idle == 0) {
+		pool_entry_free(entry);
+		return err < 0 ? err : 0;
+	}
+	entry->idle_since = pool_now();
+	pool_lock(pool);
+	list_add(&entry->list, &pool->idle);
+	pool->nidle++;
+	while (pool->nidle > pool->max_idle) {
+		struct pool_entry *e = list_entry(pool->idle.prev, struct pool_entry, list);
+		list_del(&e->list);
+		list_add_tail(&e->list, &dead);
+		pool->nidle--;
+	}
+	pool_expire(pool, &dead);
+	pool_unlock(pool);
+	pool_reap(&dead);
+	return 0;
+}
+
+/**
+ * \brief Close the idle handles of a pool that timed out
+ * \param pool Pool handle
+ * \return the number of idle handles left
+ *
+ * #snd_pcm_pool_get and #snd_pcm_pool_put expire the idle handles
+ * already; call it from a timer to release them when the pool is not
+ * used for a while.
+ *
+ * This function is added in version 1.2.8.
+ */
+int snd_pcm_pool_expire(snd_pcm_pool_t *pool)
+{
+	struct list_head dead;
+	int left;
+
+	assert(pool);
+	INIT_LIST_HEAD(&dead);
+	pool_lock(pool);
+	pool_expire(pool, &dead);
+	left = pool->nidle;
+	pool_unlock(pool);
+	pool_reap(&dead);
+	return left;
+}
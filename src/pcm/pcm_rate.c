@@ -53,7 +53,7 @@ struct _snd_pcm_rate {
 	snd_pcm_uframes_t appl_ptr, hw_ptr, last_slave_hw_ptr;
 	snd_pcm_uframes_t last_commit_ptr;
 	snd_pcm_uframes_t orig_avail_min;
-	snd_pcm_sw_params_t sw_params;
+	snd_pcm_sw_params_t *sw_params;	/* of the slave, from the first sw_params */
 	snd_pcm_format_t sformat;
 	unsigned int srate;
 	snd_pcm_channel_area_t *pareas;	/* areas for splitted period (rate pcm) */
@@ -64,6 +64,10 @@ struct _snd_pcm_rate {
 	snd_pcm_rate_ops_t ops;
 	unsigned int src_conv_idx;
 	unsigned int dst_conv_idx;
+	unsigned int src_put_idx;	/* with src_getput, conv_idx is get_idx */
+	unsigned int dst_put_idx;
+	int src_getput;
+	int dst_getput;
 	snd_pcm_channel_area_t *src_buf;
 	snd_pcm_channel_area_t *dst_buf;
 	int start_pending; /* start is triggered but not commited to slave */
@@ -75,14 +79,92 @@ struct _snd_pcm_rate {
 	uint64_t in_formats;
 	uint64_t out_formats;
 	unsigned int format_flags;
+	unsigned int subperiods;	/* requested conversion units per period */
+	snd_pcm_uframes_t chunk;	/* conversion unit, client frames */
+	snd_pcm_uframes_t schunk;	/* conversion unit, slave frames */
+	int pipeline;			/* convert on a worker thread (playback) */
+	struct snd_pcm_rate_pipeline *pipe;
 };
 
+#ifdef THREAD_SAFE_API
+/*
+ * Pipelined playback: the worker converts the committed client units into
+ * a ring of slots holding one period in the slave format, and the transfer
+ * path only moves the finished slots to the slave.  All fields below are
+ * protected by mutex; the converter itself is only run by the worker while
+ * it is busy, and drain waits for it to go idle before converting the last
+ * fraction in the caller.
+ */
+typedef struct snd_pcm_rate_pipeline {
+	snd_pcm_t *pcm;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;		/* any state change, both directions */
+	snd_pcm_channel_area_t *slots;	/* converted units, slave format */
+	snd_pcm_channel_area_t *wrap;	/* a client unit wrapping at the buffer end */
+	unsigned int nslots;
+	unsigned int head;		/* oldest converted slot */
+	unsigned int count;		/* converted slots not committed yet */
+	snd_pcm_uframes_t conv_ptr;	/* next client frame to convert */
+	snd_pcm_uframes_t appl_ptr;	/* end of the committed client data */
+	unsigned int gen;		/* bumped by a flush to drop the unit in work */
+	int busy;
+	int quit;
+} snd_pcm_rate_pipeline_t;
+#endif
+
 #define SND_PCM_RATE_PLUGIN_VERSION_OLD	0x010001	/* old rate plugin */
 #endif /* DOC_HIDDEN */
 
+#ifdef THREAD_SAFE_API
+static int snd_pcm_rate_pipeline_start(snd_pcm_t *pcm, unsigned int nslots);
+static void snd_pcm_rate_pipeline_stop(snd_pcm_rate_t *rate);
+static void snd_pcm_rate_pipeline_flush(snd_pcm_rate_t *rate);
+#else
+#define snd_pcm_rate_pipeline_stop(rate)	do { } while (0)
+#define snd_pcm_rate_pipeline_flush(rate)	do { } while (0)
+#endif
+
+/*
+ * the index of the conversion between src and dst; the packed and 20-bit
+ * formats go through the get/put labels as in the linear plugin, the
+ * convert labels access them with 4-byte loads and stores
+ */
+static int rate_conv_index(snd_pcm_format_t src, snd_pcm_format_t dst,
+			   unsigned int *get_idx, unsigned int *put_idx)
+{
+	if (snd_pcm_format_physical_width(src) == 24 ||
+	    snd_pcm_format_physical_width(dst) == 24 ||
+	    snd_pcm_format_width(src) == 20 ||
+	    snd_pcm_format_width(dst) == 20) {
+		*get_idx = snd_pcm_linear_get_index(src, SND_PCM_FORMAT_S32);
+		*put_idx = snd_pcm_linear_put_index(SND_PCM_FORMAT_S32, dst);
+		return 1;
+	}
+	*get_idx = snd_pcm_linear_convert_index(src, dst);
+	return 0;
+}
+
+static void rate_convert(const snd_pcm_channel_area_t *dst_areas,
+			 snd_pcm_uframes_t dst_offset,
+			 const snd_pcm_channel_area_t *src_areas,
+			 snd_pcm_uframes_t src_offset,
+			 unsigned int channels, snd_pcm_uframes_t frames,
+			 int getput, unsigned int idx, unsigned int put_idx)
+{
+	if (getput)
+		snd_pcm_linear_getput(dst_areas, dst_offset,
+				      src_areas, src_offset,
+				      channels, frames, idx, put_idx);
+	else
+		snd_pcm_linear_convert(dst_areas, dst_offset,
+				       src_areas, src_offset,
+				       channels, frames, idx);
+}
+
 /* allocate a channel area and a temporary buffer for the given size */
 static snd_pcm_channel_area_t *
-rate_alloc_tmp_buf(snd_pcm_format_t format,
+rate_alloc_tmp_buf(snd_pcm_t *pcm, snd_pcm_format_t format,
 		   unsigned int channels, unsigned int frames)
 {
 	snd_pcm_channel_area_t *ap;
@@ -92,7 +174,7 @@ rate_alloc_tmp_buf(snd_pcm_format_t format,
 	ap = malloc(sizeof(*ap) * channels);
 	if (!ap)
 		return NULL;
-	ap->addr = malloc(frames * channels * width / 8);
+	ap->addr = snd_pcm_mem_alloc(pcm, frames * channels * width / 8);
 	if (!ap->addr) {
 		free(ap);
 		return NULL;
@@ -113,7 +195,7 @@ static void rate_free_tmp_buf(snd_pcm_channel_area_t **ptr)
 	snd_pcm_channel_area_t *c = *ptr;
 
 	if (c) {
-		free(c->addr);
+		snd_pcm_mem_free(c->addr);
 		free(c);
 		*ptr = NULL;
 	}
@@ -354,7 +436,7 @@ static int snd_pcm_rate_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 	snd_pcm_rate_t *rate = pcm->private_data;
 	snd_pcm_t *slave = rate->gen.slave;
 	snd_pcm_rate_side_info_t *sinfo, *cinfo;
-	unsigned int channels, acc;
+	unsigned int channels, acc, units;
 	int need_src_buf, need_dst_buf;
 	int err = snd_pcm_hw_params_slave(pcm, params,
 					  snd_pcm_rate_hw_refine_cchange,
@@ -396,14 +478,39 @@ static int snd_pcm_rate_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 	sinfo->buffer_size = slave->buffer_size;
 	sinfo->period_size = slave->period_size;
 
+	/*
+	 * Split the periods into the largest count of conversion units up
+	 * to subperiods which divides both periods, so that every unit has
+	 * the exact period ratio.  The converter sees the units as periods.
+	 */
+	{
+		snd_pcm_uframes_t a = cinfo->period_size, b = sinfo->period_size;
+		unsigned int k;
+		while (b) {
+			snd_pcm_uframes_t t = a % b;
+			a = b;
+			b = t;
+		}
+		for (k = rate->subperiods; k > 1; k--)
+			if (a % k == 0)
+				break;
+		if (k < 1)
+			k = 1;
+		units = k;
+		rate->chunk = cinfo->period_size / k;
+		rate->schunk = sinfo->period_size / k;
+		cinfo->period_size = rate->chunk;
+		sinfo->period_size = rate->schunk;
+	}
+
 	if (CHECK_SANITY(rate->pareas)) {
 		SNDMSG("rate plugin already in use");
 		return -EBUSY;
 	}
 
-	rate->pareas = rate_alloc_tmp_buf(cinfo->format, channels,
+	rate->pareas = rate_alloc_tmp_buf(pcm, cinfo->format, channels,
 					  cinfo->period_size);
-	rate->sareas = rate_alloc_tmp_buf(sinfo->format, channels,
+	rate->sareas = rate_alloc_tmp_buf(pcm, sinfo->format, channels,
 					  sinfo->period_size);
 	if (!rate->pareas || !rate->sareas) {
 		err = -ENOMEM;
@@ -439,10 +546,11 @@ static int snd_pcm_rate_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 	}
 
 	if (need_src_buf) {
-		rate->src_conv_idx =
-			snd_pcm_linear_convert_index(rate->orig_in_format,
-						     rate->info.in.format);
-		rate->src_buf = rate_alloc_tmp_buf(rate->info.in.format,
+		rate->src_getput =
+			rate_conv_index(rate->orig_in_format,
+					rate->info.in.format,
+					&rate->src_conv_idx, &rate->src_put_idx);
+		rate->src_buf = rate_alloc_tmp_buf(pcm, rate->info.in.format,
 						   channels, rate->info.in.period_size);
 		if (!rate->src_buf) {
 			err = -ENOMEM;
@@ -451,10 +559,11 @@ static int snd_pcm_rate_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 	}
 
 	if (need_dst_buf) {
-		rate->dst_conv_idx =
-			snd_pcm_linear_convert_index(rate->info.out.format,
-						     rate->orig_out_format);
-		rate->dst_buf = rate_alloc_tmp_buf(rate->info.out.format,
+		rate->dst_getput =
+			rate_conv_index(rate->info.out.format,
+					rate->orig_out_format,
+					&rate->dst_conv_idx, &rate->dst_put_idx);
+		rate->dst_buf = rate_alloc_tmp_buf(pcm, rate->info.out.format,
 						   channels, rate->info.out.period_size);
 		if (!rate->dst_buf) {
 			err = -ENOMEM;
@@ -462,6 +571,18 @@ static int snd_pcm_rate_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 		}
 	}
 
+#ifdef THREAD_SAFE_API
+	/* the worker converts up to one period ahead of the slave */
+	if (rate->pipeline && pcm->stream == SND_PCM_STREAM_PLAYBACK &&
+	    !rate->pipe) {
+		err = snd_pcm_rate_pipeline_start(pcm, units);
+		if (err < 0) {
+			SNDERR("unable to start the rate conversion thread");
+			goto error;
+		}
+	}
+#endif
+
 	return 0;
 
  error:
@@ -480,12 +601,15 @@ static int snd_pcm_rate_hw_free(snd_pcm_t *pcm)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
 
+	snd_pcm_rate_pipeline_stop(rate);
 	rate_free_tmp_buf(&rate->pareas);
 	rate_free_tmp_buf(&rate->sareas);
 	if (rate->ops.free)
 		rate->ops.free(rate->obj);
 	rate_free_tmp_buf(&rate->src_buf);
 	rate_free_tmp_buf(&rate->dst_buf);
+	free(rate->sw_params);
+	rate->sw_params = NULL;
 	return snd_pcm_hw_free(rate->gen.slave);
 }
 
@@ -514,7 +638,12 @@ static int snd_pcm_rate_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t * params)
 	snd_pcm_uframes_t boundary1, boundary2, sboundary;
 	int err;
 
-	sparams = &rate->sw_params;
+	if (!rate->sw_params) {
+		rate->sw_params = malloc(sizeof(*rate->sw_params));
+		if (!rate->sw_params)
+			return -ENOMEM;
+	}
+	sparams = rate->sw_params;
 	err = snd_pcm_sw_params_current(slave, sparams);
 	if (err < 0)
 		return err;
@@ -559,6 +688,7 @@ static int snd_pcm_rate_init(snd_pcm_t *pcm)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
 
+	snd_pcm_rate_pipeline_flush(rate);
 	if (rate->ops.reset)
 		rate->ops.reset(rate->obj);
 	rate->last_commit_ptr = 0;
@@ -585,10 +715,9 @@ static void do_convert(const snd_pcm_channel_area_t *dst_areas,
 	}
 
 	if (rate->src_buf) {
-		snd_pcm_linear_convert(rate->src_buf, 0,
-				       src_areas, src_offset,
-				       channels, src_frames,
-				       rate->src_conv_idx);
+		rate_convert(rate->src_buf, 0, src_areas, src_offset,
+			     channels, src_frames, rate->src_getput,
+			     rate->src_conv_idx, rate->src_put_idx);
 		src_areas = rate->src_buf;
 		src_offset = 0;
 	}
@@ -603,10 +732,9 @@ static void do_convert(const snd_pcm_channel_area_t *dst_areas,
 				      snd_pcm_channel_area_addr(src_areas, src_offset),
 				      src_frames);
 	if (rate->dst_buf)
-		snd_pcm_linear_convert(dst_areas, dst_offset,
-				       rate->dst_buf, 0,
-				       channels, dst_frames,
-				       rate->dst_conv_idx);
+		rate_convert(dst_areas, dst_offset, rate->dst_buf, 0,
+			     channels, dst_frames, rate->dst_getput,
+			     rate->dst_conv_idx, rate->dst_put_idx);
 }
 
 static inline void
@@ -617,8 +745,8 @@ snd_pcm_rate_write_areas1(snd_pcm_t *pcm,
 			 snd_pcm_uframes_t slave_offset)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
-	do_convert(slave_areas, slave_offset, rate->gen.slave->period_size,
-		   areas, offset, pcm->period_size,
+	do_convert(slave_areas, slave_offset, rate->schunk,
+		   areas, offset, rate->chunk,
 		   pcm->channels, rate);
 }
 
@@ -630,8 +758,8 @@ snd_pcm_rate_read_areas1(snd_pcm_t *pcm,
 			 snd_pcm_uframes_t slave_offset)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
-	do_convert(areas, offset, pcm->period_size,
-		   slave_areas, slave_offset, rate->gen.slave->period_size,
+	do_convert(areas, offset, rate->chunk,
+		   slave_areas, slave_offset, rate->schunk,
 		   pcm->channels, rate);
 }
 
@@ -648,7 +776,7 @@ static inline void snd_pcm_rate_sync_hwptr0(snd_pcm_t *pcm, snd_pcm_uframes_t sl
 	slave_hw_ptr_diff = pcm_frame_diff(slave_hw_ptr, rate->last_slave_hw_ptr, rate->gen.slave->boundary);
 	if (slave_hw_ptr_diff == 0)
 		return;
-	last_slave_hw_ptr_frac = rate->last_slave_hw_ptr % rate->gen.slave->period_size;
+	last_slave_hw_ptr_frac = rate->last_slave_hw_ptr % rate->schunk;
 	/* While handling fraction part fo slave period, rounded value will be
 	 * introduced by input_frames().
 	 * To eliminate rounding issue on rate->hw_ptr, subtract last rounded
@@ -659,9 +787,9 @@ static inline void snd_pcm_rate_sync_hwptr0(snd_pcm_t *pcm, snd_pcm_uframes_t sl
 	 * 	fractional part of updated slave hw ptr's rounded value ]
 	 */
 	rate->hw_ptr += (
-			(((last_slave_hw_ptr_frac + slave_hw_ptr_diff) / rate->gen.slave->period_size) * pcm->period_size) -
+			(((last_slave_hw_ptr_frac + slave_hw_ptr_diff) / rate->schunk) * rate->chunk) -
 			rate->ops.input_frames(rate->obj, last_slave_hw_ptr_frac) +
-			rate->ops.input_frames(rate->obj, (last_slave_hw_ptr_frac + slave_hw_ptr_diff) % rate->gen.slave->period_size));
+			rate->ops.input_frames(rate->obj, (last_slave_hw_ptr_frac + slave_hw_ptr_diff) % rate->schunk));
 	rate->last_slave_hw_ptr = slave_hw_ptr;
 
 	rate->hw_ptr %= pcm->boundary;
@@ -730,6 +858,24 @@ static int snd_pcm_rate_prepare(snd_pcm_t *pcm)
 	return 0;
 }
 
+/* as prepare, but the converter keeps its filter history */
+static int snd_pcm_rate_resync(snd_pcm_t *pcm)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+	int err;
+
+	err = snd_pcm_resync(rate->gen.slave);
+	if (err < 0)
+		return err;
+	*pcm->hw.ptr = 0;
+	*pcm->appl.ptr = 0;
+	rate->last_slave_hw_ptr = 0;
+	snd_pcm_rate_pipeline_flush(rate);
+	rate->last_commit_ptr = 0;
+	rate->start_pending = 0;
+	return 0;
+}
+
 static int snd_pcm_rate_reset(snd_pcm_t *pcm)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
@@ -768,6 +914,84 @@ static snd_pcm_sframes_t snd_pcm_rate_forward(snd_pcm_t *pcm ATTRIBUTE_UNUSED,
         return 0;
 }
 
+static inline void snd_pcm_rate_start_pending(snd_pcm_rate_t *rate)
+{
+	if (rate->start_pending) {
+		/* we have pending start-trigger.  let's issue it now */
+		snd_pcm_start(rate->gen.slave);
+		rate->start_pending = 0;
+	}
+}
+
+/*
+ * copy slave_size converted frames to the slave buffer, in two fragments
+ * when it wraps; returns 1 when all of them were committed and 0 when the
+ * slave took less
+ */
+static int snd_pcm_rate_commit_sareas(snd_pcm_t *pcm,
+				      const snd_pcm_channel_area_t *areas,
+				      snd_pcm_uframes_t offset,
+				      snd_pcm_uframes_t slave_size)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+	const snd_pcm_channel_area_t *slave_areas;
+	snd_pcm_uframes_t slave_offset, cont, xfer;
+	snd_pcm_uframes_t slave_frames = ULONG_MAX;
+	snd_pcm_sframes_t result;
+
+	/* ok, commit first fragment */
+	result = snd_pcm_mmap_begin(rate->gen.slave, &slave_areas, &slave_offset, &slave_frames);
+	if (result < 0)
+		return result;
+	cont = slave_frames;
+	if (cont > slave_size)
+		cont = slave_size;
+	snd_pcm_areas_copy(slave_areas, slave_offset,
+			   areas, offset,
+			   pcm->channels, cont,
+			   rate->gen.slave->format);
+	result = snd_pcm_mmap_commit(rate->gen.slave, slave_offset, cont);
+	if (result < (snd_pcm_sframes_t)cont) {
+		if (result < 0)
+			return result;
+		result = snd_pcm_rewind(rate->gen.slave, result);
+		if (result < 0)
+			return result;
+		return 0;
+	}
+	xfer = cont;
+
+	if (xfer == slave_size)
+		return 1;
+
+	/* commit second fragment */
+	cont = slave_size - cont;
+	slave_frames = cont;
+	result = snd_pcm_mmap_begin(rate->gen.slave, &slave_areas, &slave_offset, &slave_frames);
+	if (result < 0)
+		return result;
+#if 0
+	if (slave_offset) {
+		SNDERR("non-zero slave_offset %ld", slave_offset);
+		return -EIO;
+	}
+#endif
+	snd_pcm_areas_copy(slave_areas, slave_offset,
+			   areas, offset + xfer,
+			   pcm->channels, cont,
+			   rate->gen.slave->format);
+	result = snd_pcm_mmap_commit(rate->gen.slave, slave_offset, cont);
+	if (result < (snd_pcm_sframes_t)cont) {
+		if (result < 0)
+			return result;
+		result = snd_pcm_rewind(rate->gen.slave, result + xfer);
+		if (result < 0)
+			return result;
+		return 0;
+	}
+	return 1;
+}
+
 static int snd_pcm_rate_commit_area(snd_pcm_t *pcm, snd_pcm_rate_t *rate,
 				    snd_pcm_uframes_t appl_offset,
 				    snd_pcm_uframes_t size,
@@ -776,24 +1000,24 @@ static int snd_pcm_rate_commit_area(snd_pcm_t *pcm, snd_pcm_rate_t *rate,
 	snd_pcm_uframes_t cont = pcm->buffer_size - appl_offset;
 	const snd_pcm_channel_area_t *areas;
 	const snd_pcm_channel_area_t *slave_areas;
-	snd_pcm_uframes_t slave_offset, xfer;
+	snd_pcm_uframes_t slave_offset;
 	snd_pcm_uframes_t slave_frames = ULONG_MAX;
 	snd_pcm_sframes_t result;
 
 	areas = snd_pcm_mmap_areas(pcm);
 	/*
-	 * Because snd_pcm_rate_write_areas1() below will convert a full source period
-	 * then there had better be a full period available in the current buffer.
+	 * Because snd_pcm_rate_write_areas1() below will convert a full source unit
+	 * then there had better be a full unit available in the current buffer.
 	 */
-	if (cont >= pcm->period_size) {
+	if (cont >= rate->chunk) {
 		result = snd_pcm_mmap_begin(rate->gen.slave, &slave_areas, &slave_offset, &slave_frames);
 		if (result < 0)
 			return result;
 		/*
-		 * Because snd_pcm_rate_write_areas1() below will convert to a full slave period
-		 * then there had better be a full slave period available in the slave buffer.
+		 * Because snd_pcm_rate_write_areas1() below will convert to a full slave unit
+		 * then there had better be a full slave unit available in the slave buffer.
 		 */
-		if (slave_frames < rate->gen.slave->period_size) {
+		if (slave_frames < rate->schunk) {
 			snd_pcm_rate_write_areas1(pcm, areas, appl_offset, rate->sareas, 0);
 			goto __partial;
 		}
@@ -821,65 +1045,13 @@ static int snd_pcm_rate_commit_area(snd_pcm_t *pcm, snd_pcm_rate_t *rate,
 
 		snd_pcm_rate_write_areas1(pcm, rate->pareas, 0, rate->sareas, 0);
 
-		/* ok, commit first fragment */
-		result = snd_pcm_mmap_begin(rate->gen.slave, &slave_areas, &slave_offset, &slave_frames);
-		if (result < 0)
-			return result;
 	      __partial:
-		cont = slave_frames;
-		if (cont > slave_size)
-			cont = slave_size;
-		snd_pcm_areas_copy(slave_areas, slave_offset,
-				   rate->sareas, 0,
-				   pcm->channels, cont,
-				   rate->gen.slave->format);
-		result = snd_pcm_mmap_commit(rate->gen.slave, slave_offset, cont);
-		if (result < (snd_pcm_sframes_t)cont) {
-			if (result < 0)
-				return result;
-			result = snd_pcm_rewind(rate->gen.slave, result);
-			if (result < 0)
-				return result;
-			return 0;
-		}
-		xfer = cont;
-
-		if (xfer == slave_size)
-			goto commit_done;
-		
-		/* commit second fragment */
-		cont = slave_size - cont;
-		slave_frames = cont;
-		result = snd_pcm_mmap_begin(rate->gen.slave, &slave_areas, &slave_offset, &slave_frames);
-		if (result < 0)
+		result = snd_pcm_rate_commit_sareas(pcm, rate->sareas, 0, slave_size);
+		if (result <= 0)
 			return result;
-#if 0
-		if (slave_offset) {
-			SNDERR("non-zero slave_offset %ld", slave_offset);
-			return -EIO;
-		}
-#endif
-		snd_pcm_areas_copy(slave_areas, slave_offset,
-				   rate->sareas, xfer,
-				   pcm->channels, cont,
-				   rate->gen.slave->format);
-		result = snd_pcm_mmap_commit(rate->gen.slave, slave_offset, cont);
-		if (result < (snd_pcm_sframes_t)cont) {
-			if (result < 0)
-				return result;
-			result = snd_pcm_rewind(rate->gen.slave, result + xfer);
-			if (result < 0)
-				return result;
-			return 0;
-		}
 	}
 
- commit_done:
-	if (rate->start_pending) {
-		/* we have pending start-trigger.  let's issue it now */
-		snd_pcm_start(rate->gen.slave);
-		rate->start_pending = 0;
-	}
+	snd_pcm_rate_start_pending(rate);
 	return 1;
 }
 
@@ -887,8 +1059,7 @@ static int snd_pcm_rate_commit_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t app
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
 
-	return snd_pcm_rate_commit_area(pcm, rate, appl_offset, pcm->period_size,
-					rate->gen.slave->period_size);
+	return snd_pcm_rate_commit_area(pcm, rate, appl_offset, rate->chunk, rate->schunk);
 }
 
 static int snd_pcm_rate_grab_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t hw_offset)
@@ -902,16 +1073,16 @@ static int snd_pcm_rate_grab_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t hw_of
 	snd_pcm_sframes_t result;
 
 	areas = snd_pcm_mmap_areas(pcm);
-	if (cont >= pcm->period_size) {
+	if (cont >= rate->chunk) {
 		result = snd_pcm_mmap_begin(rate->gen.slave, &slave_areas, &slave_offset, &slave_frames);
 		if (result < 0)
 			return result;
-		if (slave_frames < rate->gen.slave->period_size)
+		if (slave_frames < rate->schunk)
 			goto __partial;
 		snd_pcm_rate_read_areas1(pcm, areas, hw_offset,
 					 slave_areas, slave_offset);
-		result = snd_pcm_mmap_commit(rate->gen.slave, slave_offset, rate->gen.slave->period_size);
-		if (result < (snd_pcm_sframes_t)rate->gen.slave->period_size) {
+		result = snd_pcm_mmap_commit(rate->gen.slave, slave_offset, rate->schunk);
+		if (result < (snd_pcm_sframes_t)rate->schunk) {
 			if (result < 0)
 				return result;
 			result = snd_pcm_rewind(rate->gen.slave, result);
@@ -926,8 +1097,8 @@ static int snd_pcm_rate_grab_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t hw_of
 			return result;
 	      __partial:
 		cont = slave_frames;
-		if (cont > rate->gen.slave->period_size)
-			cont = rate->gen.slave->period_size;
+		if (cont > rate->schunk)
+			cont = rate->schunk;
 		snd_pcm_areas_copy(rate->sareas, 0,
 				   slave_areas, slave_offset,
 				   pcm->channels, cont,
@@ -943,11 +1114,11 @@ static int snd_pcm_rate_grab_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t hw_of
 		}
 		xfer = cont;
 
-		if (xfer == rate->gen.slave->period_size)
+		if (xfer == rate->schunk)
 			goto __transfer;
 
 		/* grab second fragment */
-		cont = rate->gen.slave->period_size - cont;
+		cont = rate->schunk - cont;
 		slave_frames = cont;
 		result = snd_pcm_mmap_begin(rate->gen.slave, &slave_areas, &slave_offset, &slave_frames);
 		if (result < 0)
@@ -974,7 +1145,7 @@ static int snd_pcm_rate_grab_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t hw_of
 
 	      __transfer:
 		cont = pcm->buffer_size - hw_offset;
-		if (cont >= pcm->period_size) {
+		if (cont >= rate->chunk) {
 			snd_pcm_rate_read_areas1(pcm, areas, hw_offset,
 						 rate->sareas, 0);
 		} else {
@@ -987,13 +1158,210 @@ static int snd_pcm_rate_grab_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t hw_of
 					   pcm->format);
 			snd_pcm_areas_copy(areas, 0,
 					   rate->pareas, cont,
-					   pcm->channels, pcm->period_size - cont,
+					   pcm->channels, rate->chunk - cont,
 					   pcm->format);
 		}
 	}
 	return 1;
 }
 
+#ifdef THREAD_SAFE_API
+/* a full unit is committed but not taken by the worker yet */
+static inline int snd_pcm_rate_pipeline_pending(snd_pcm_t *pcm,
+						snd_pcm_rate_pipeline_t *p)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+
+	return pcm_frame_diff(p->appl_ptr, p->conv_ptr, pcm->boundary) >= rate->chunk;
+}
+
+static void *snd_pcm_rate_pipeline_thread(void *arg)
+{
+	snd_pcm_rate_pipeline_t *p = arg;
+	snd_pcm_t *pcm = p->pcm;
+	snd_pcm_rate_t *rate = pcm->private_data;
+
+	pthread_mutex_lock(&p->mutex);
+	while (!p->quit) {
+		const snd_pcm_channel_area_t *areas;
+		snd_pcm_uframes_t ofs, cont;
+		unsigned int slot, gen;
+
+		if (p->count == p->nslots ||
+		    !snd_pcm_rate_pipeline_pending(pcm, p)) {
+			pthread_cond_wait(&p->cond, &p->mutex);
+			continue;
+		}
+		slot = (p->head + p->count) % p->nslots;
+		ofs = p->conv_ptr % pcm->buffer_size;
+		gen = p->gen;
+		p->busy = 1;
+		pthread_mutex_unlock(&p->mutex);
+
+		/* the client cannot overwrite the unit, hw_ptr is behind it */
+		areas = snd_pcm_mmap_areas(pcm);
+		cont = pcm->buffer_size - ofs;
+		if (cont < rate->chunk) {
+			snd_pcm_areas_copy(p->wrap, 0, areas, ofs,
+					   pcm->channels, cont, pcm->format);
+			snd_pcm_areas_copy(p->wrap, cont, areas, 0,
+					   pcm->channels, rate->chunk - cont,
+					   pcm->format);
+			areas = p->wrap;
+			ofs = 0;
+		}
+		do_convert(p->slots, slot * rate->schunk, rate->schunk,
+			   areas, ofs, rate->chunk, pcm->channels, rate);
+
+		pthread_mutex_lock(&p->mutex);
+		p->busy = 0;
+		if (gen == p->gen) {
+			p->count++;
+			p->conv_ptr += rate->chunk;
+			if (p->conv_ptr >= pcm->boundary)
+				p->conv_ptr = 0;
+		}
+		pthread_cond_broadcast(&p->cond);
+	}
+	pthread_mutex_unlock(&p->mutex);
+	return NULL;
+}
+
+static int snd_pcm_rate_pipeline_start(snd_pcm_t *pcm, unsigned int nslots)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+	snd_pcm_rate_pipeline_t *p;
+	int err;
+
+	p = calloc(1, sizeof(*p));
+	if (p == NULL)
+		return -ENOMEM;
+	p->pcm = pcm;
+	p->nslots = nslots;
+	/* called from hw_params, the setup of pcm itself is not there yet */
+	p->slots = rate_alloc_tmp_buf(pcm, rate->gen.slave->format,
+				      rate->info.channels, rate->schunk * nslots);
+	p->wrap = rate_alloc_tmp_buf(pcm, rate->orig_in_format,
+				     rate->info.channels, rate->chunk);
+	if (!p->slots || !p->wrap) {
+		err = -ENOMEM;
+		goto error;
+	}
+	pthread_mutex_init(&p->mutex, NULL);
+	pthread_cond_init(&p->cond, NULL);
+	err = snd_thread_create(&p->thread, "pcm_rate", snd_pcm_rate_pipeline_thread, p);
+	if (err) {
+		pthread_cond_destroy(&p->cond);
+		pthread_mutex_destroy(&p->mutex);
+		err = -err;
+		goto error;
+	}
+	rate->pipe = p;
+	return 0;
+
+ error:
+	rate_free_tmp_buf(&p->slots);
+	rate_free_tmp_buf(&p->wrap);
+	free(p);
+	return err;
+}
+
+static void snd_pcm_rate_pipeline_stop(snd_pcm_rate_t *rate)
+{
+	snd_pcm_rate_pipeline_t *p = rate->pipe;
+
+	if (p == NULL)
+		return;
+	pthread_mutex_lock(&p->mutex);
+	p->quit = 1;
+	pthread_cond_broadcast(&p->cond);
+	pthread_mutex_unlock(&p->mutex);
+	pthread_join(p->thread, NULL);
+	pthread_cond_destroy(&p->cond);
+	pthread_mutex_destroy(&p->mutex);
+	rate_free_tmp_buf(&p->slots);
+	rate_free_tmp_buf(&p->wrap);
+	free(p);
+	rate->pipe = NULL;
+}
+
+/* drops the queued and the converting units, the stream starts again at 0 */
+static void snd_pcm_rate_pipeline_flush(snd_pcm_rate_t *rate)
+{
+	snd_pcm_rate_pipeline_t *p = rate->pipe;
+
+	if (p == NULL)
+		return;
+	pthread_mutex_lock(&p->mutex);
+	p->gen++;
+	while (p->busy)
+		pthread_cond_wait(&p->cond, &p->mutex);
+	p->head = p->count = 0;
+	p->conv_ptr = p->appl_ptr = 0;
+	pthread_mutex_unlock(&p->mutex);
+}
+
+/*
+ * hands the committed client data to the worker, then waits until a unit
+ * is converted if the worker is still at it; returns 1 when the worker has
+ * nothing left to do
+ */
+static int snd_pcm_rate_pipeline_wait(snd_pcm_t *pcm)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+	snd_pcm_rate_pipeline_t *p = rate->pipe;
+	int idle;
+
+	if (p == NULL)
+		return 1;
+	pthread_mutex_lock(&p->mutex);
+	if (p->appl_ptr != rate->appl_ptr) {
+		p->appl_ptr = rate->appl_ptr;
+		pthread_cond_broadcast(&p->cond);
+	}
+	while (p->count == 0 &&
+	       (p->busy || snd_pcm_rate_pipeline_pending(pcm, p)))
+		pthread_cond_wait(&p->cond, &p->mutex);
+	idle = p->count == 0;
+	pthread_mutex_unlock(&p->mutex);
+	return idle;
+}
+
+/* the pipelined variant of snd_pcm_rate_sync_playback_area() */
+static int snd_pcm_rate_pipeline_sync(snd_pcm_t *pcm, snd_pcm_uframes_t appl_ptr,
+				      snd_pcm_uframes_t slave_size)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+	snd_pcm_rate_pipeline_t *p = rate->pipe;
+	int err = 0;
+
+	pthread_mutex_lock(&p->mutex);
+	if (p->appl_ptr != appl_ptr) {
+		p->appl_ptr = appl_ptr;
+		pthread_cond_broadcast(&p->cond);
+	}
+	while (p->count > 0 && slave_size >= rate->schunk) {
+		err = snd_pcm_rate_commit_sareas(pcm, p->slots,
+						 p->head * rate->schunk,
+						 rate->schunk);
+		if (err <= 0)
+			break;
+		snd_pcm_rate_start_pending(rate);
+		p->head = (p->head + 1) % p->nslots;
+		p->count--;
+		pthread_cond_broadcast(&p->cond);
+		slave_size -= rate->schunk;
+		rate->last_commit_ptr += rate->chunk;
+		if (rate->last_commit_ptr >= pcm->boundary)
+			rate->last_commit_ptr = 0;
+	}
+	pthread_mutex_unlock(&p->mutex);
+	return err < 0 ? err : 0;
+}
+#else
+#define snd_pcm_rate_pipeline_wait(pcm)		1
+#endif
+
 static int snd_pcm_rate_sync_playback_area(snd_pcm_t *pcm, snd_pcm_uframes_t appl_ptr)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
@@ -1006,17 +1374,22 @@ static int snd_pcm_rate_sync_playback_area(snd_pcm_t *pcm, snd_pcm_uframes_t app
 	if (slave_size < 0)
 		return slave_size;
 
+#ifdef THREAD_SAFE_API
+	if (rate->pipe)
+		return snd_pcm_rate_pipeline_sync(pcm, appl_ptr, slave_size);
+#endif
+
 	xfer = pcm_frame_diff(appl_ptr, rate->last_commit_ptr, pcm->boundary);
-	while (xfer >= pcm->period_size &&
-	       (snd_pcm_uframes_t)slave_size >= rate->gen.slave->period_size) {
+	while (xfer >= rate->chunk &&
+	       (snd_pcm_uframes_t)slave_size >= rate->schunk) {
 		err = snd_pcm_rate_commit_next_period(pcm, rate->last_commit_ptr % pcm->buffer_size);
 		if (err == 0)
 			break;
 		if (err < 0)
 			return err;
-		xfer -= pcm->period_size;
-		slave_size -= rate->gen.slave->period_size;
-		rate->last_commit_ptr += pcm->period_size;
+		xfer -= rate->chunk;
+		slave_size -= rate->schunk;
+		rate->last_commit_ptr += rate->chunk;
 		if (rate->last_commit_ptr >= pcm->boundary)
 			rate->last_commit_ptr = 0;
 	}
@@ -1045,25 +1418,24 @@ static snd_pcm_sframes_t snd_pcm_rate_avail_update_capture(snd_pcm_t *pcm,
 							   snd_pcm_sframes_t slave_size)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
-	snd_pcm_t *slave = rate->gen.slave;
 	snd_pcm_uframes_t xfer, hw_offset, size;
 	
 	xfer = snd_pcm_mmap_capture_avail(pcm);
 	size = pcm->buffer_size - xfer;
 	hw_offset = snd_pcm_mmap_hw_offset(pcm);
-	while (size >= pcm->period_size &&
-	       (snd_pcm_uframes_t)slave_size >= slave->period_size) {
+	while (size >= rate->chunk &&
+	       (snd_pcm_uframes_t)slave_size >= rate->schunk) {
 		int err = snd_pcm_rate_grab_next_period(pcm, hw_offset);
 		if (err < 0)
 			return err;
 		if (err == 0)
 			return (snd_pcm_sframes_t)xfer;
-		xfer += pcm->period_size;
-		size -= pcm->period_size;
-		slave_size -= slave->period_size;
-		hw_offset += pcm->period_size;
+		xfer += rate->chunk;
+		size -= rate->chunk;
+		slave_size -= rate->schunk;
+		hw_offset += rate->chunk;
 		hw_offset %= pcm->buffer_size;
-		snd_pcm_mmap_hw_forward(pcm, pcm->period_size);
+		snd_pcm_mmap_hw_forward(pcm, rate->chunk);
 	}
 	return (snd_pcm_sframes_t)xfer;
 }
@@ -1117,11 +1489,34 @@ static int snd_pcm_rate_poll_revents(snd_pcm_t *pcm, struct pollfd *pfds, unsign
 	if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
 		/* Try to sync as much as possible */
 		snd_pcm_rate_hwsync(pcm);
+		/* the caller waits anyway, let the unit in work be done */
+		snd_pcm_rate_pipeline_wait(pcm);
 		snd_pcm_rate_sync_playback_area(pcm, rate->appl_ptr);
 	}
 	return snd_pcm_poll_descriptors_revents(rate->gen.slave, pfds, nfds, revents);
 }
 
+#ifdef THREAD_SAFE_API
+/* commits the units of the worker until it has nothing left, under lock */
+static int snd_pcm_rate_pipeline_drain(snd_pcm_t *pcm)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+	int err;
+
+	for (;;) {
+		int idle = snd_pcm_rate_pipeline_wait(pcm);
+		err = snd_pcm_rate_sync_playback_area(pcm, rate->appl_ptr);
+		if (idle || err < 0)
+			return err;
+		err = __snd_pcm_wait_in_lock(rate->gen.slave, -1);
+		if (err < 0)
+			return err;
+	}
+}
+#else
+#define snd_pcm_rate_pipeline_drain(pcm)	0
+#endif
+
 /* locking */
 static int snd_pcm_rate_drain(snd_pcm_t *pcm)
 {
@@ -1134,13 +1529,22 @@ static int snd_pcm_rate_drain(snd_pcm_t *pcm)
 		int commit_err = 0;
 
 		__snd_pcm_lock(pcm);
-		/* temporarily set avail_min to one */
-		sw_params = rate->sw_params;
+		sw_params = *rate->sw_params;
 		saved_avail_min = sw_params.avail_min;
+		if (rate->pipe) {
+			/* the worker converts all whole units first */
+			sw_params.avail_min = rate->schunk;
+			snd_pcm_sw_params(rate->gen.slave, &sw_params);
+			commit_err = snd_pcm_rate_pipeline_drain(pcm);
+		}
+		/* temporarily set avail_min to one */
 		sw_params.avail_min = 1;
 		snd_pcm_sw_params(rate->gen.slave, &sw_params);
 
-		size = pcm_frame_diff(rate->appl_ptr, rate->last_commit_ptr, pcm->boundary);
+		if (commit_err < 0)
+			size = 0;
+		else
+			size = pcm_frame_diff(rate->appl_ptr, rate->last_commit_ptr, pcm->boundary);
 		ofs = rate->last_commit_ptr % pcm->buffer_size;
 		while (size > 0) {
 			snd_pcm_uframes_t psize, spsize;
@@ -1149,9 +1553,9 @@ static int snd_pcm_rate_drain(snd_pcm_t *pcm)
 			err = __snd_pcm_wait_in_lock(rate->gen.slave, -1);
 			if (err < 0)
 				break;
-			if (size > pcm->period_size) {
-				psize = pcm->period_size;
-				spsize = rate->gen.slave->period_size;
+			if (size > rate->chunk) {
+				psize = rate->chunk;
+				spsize = rate->schunk;
 			} else {
 				psize = size;
 				spsize = rate->ops.output_frames(rate->obj, size);
@@ -1263,6 +1667,11 @@ static void snd_pcm_rate_dump(snd_pcm_t *pcm, snd_output_t *out)
 	if (rate->ops.dump)
 		rate->ops.dump(rate->obj, out);
 	snd_output_printf(out, "Protocol version: %x\n", rate->plugin_version);
+#ifdef THREAD_SAFE_API
+	if (rate->pipe)
+		snd_output_printf(out, "Pipelined conversion: %u units ahead\n",
+				  rate->pipe->nslots);
+#endif
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
@@ -1275,10 +1684,12 @@ static int snd_pcm_rate_close(snd_pcm_t *pcm)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
 
+	snd_pcm_rate_pipeline_stop(rate);
 	if (rate->ops.close)
 		rate->ops.close(rate->obj);
 	if (rate->open_func)
 		snd_dlobj_cache_put(rate->open_func);
+	free(rate->sw_params);
 	return snd_pcm_generic_close(pcm);
 }
 
@@ -1304,6 +1715,16 @@ static snd_pcm_uframes_t snd_pcm_rate_slave_frames(snd_pcm_t *pcm, snd_pcm_ufram
 static int snd_pcm_rate_may_wait_for_avail_min(snd_pcm_t *pcm,
 					       snd_pcm_uframes_t avail)
 {
+	snd_pcm_rate_t *rate = pcm->private_data;
+
+	/*
+	 * the units held by the worker are neither in the slave nor free
+	 * for the client, let them go to the slave before it is checked
+	 */
+	if (rate->pipe) {
+		snd_pcm_rate_pipeline_wait(pcm);
+		snd_pcm_rate_sync_playback_area(pcm, rate->appl_ptr);
+	}
 	return snd_pcm_plugin_may_wait_for_avail_min_conv(pcm, avail,
 							  snd_pcm_rate_slave_frames);
 }
@@ -1315,6 +1736,7 @@ static const snd_pcm_fast_ops_t snd_pcm_rate_fast_ops = {
 	.delay = snd_pcm_rate_delay,
 	.prepare = snd_pcm_rate_prepare,
 	.reset = snd_pcm_rate_reset,
+	.resync = snd_pcm_rate_resync,
 	.start = snd_pcm_rate_start,
 	.drop = snd_pcm_generic_drop,
 	.drain = snd_pcm_rate_drain,
@@ -1396,11 +1818,14 @@ static void rate_initial_setup(snd_pcm_rate_t *rate)
 #ifdef PIC
 static int is_builtin_plugin(const char *type)
 {
-	return strcmp(type, "linear") == 0;
+	return strcmp(type, "linear") == 0 ||
+	       strcmp(type, "polyphase") == 0 ||
+	       strcmp(type, "polyphase_fast") == 0 ||
+	       strcmp(type, "polyphase_best") == 0;
 }
 
 static const char *const default_rate_plugins[] = {
-	"speexrate", "linear", NULL
+	"polyphase", "linear", NULL
 };
 
 static int rate_open_func(snd_pcm_rate_t *rate, const char *type, const snd_config_t *converter_conf, int verbose)
@@ -1647,9 +2072,34 @@ pcm.name {
 		name STR	# Convertor type
 		xxx yyy		# optional convertor-specific configuration
 	}
+	[subperiods INT]	# Conversion units per period (default 1)
+	[pipeline BOOL]		# Convert on a worker thread (playback)
 }
 \endcode
 
+The plugin converts whole periods: a client period is passed to the slave
+only when it is complete, which adds up to a period of latency.  With
+\c subperiods, both periods are split into up to INT equal units (the
+largest count which divides both period sizes, so that each unit keeps the
+exact rate ratio), and every complete unit is converted and committed at
+once.  Small buffers with few periods then get most of the latency back.
+
+With \c pipeline, the playback conversion runs on a worker thread
+instead of inside the write and commit calls, which then only hand the
+units over and move the converted ones to the slave.  This keeps heavy
+converters off the application thread at the price of up to one more
+period of latency: a unit goes out at the next call after it was written.
+snd_pcm_delay() counts the frames held by the worker, so with a two
+period buffer only one period is left in the slave; use three or more.
+The option is ignored for capture and when the library is built without
+thread support.
+
+The converters \c linear (linear interpolation) and \c polyphase
+(windowed-sinc FIR) are built into the library; \c polyphase_fast and
+\c polyphase_best select a shorter or a longer filter.  Without a
+configured converter, \c polyphase is used.  Other types such as
+\c speexrate or \c samplerate are loaded from external plugins.
+
 \subsection pcm_plugins_rate_funcref Function reference
 
 <UL>
@@ -1683,6 +2133,8 @@ int _snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 	snd_pcm_format_t sformat = SND_PCM_FORMAT_UNKNOWN;
 	int srate = -1;
 	const snd_config_t *converter = NULL;
+	long subperiods = 1;
+	int pipeline = 0;
 
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
@@ -1699,6 +2151,21 @@ int _snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 			converter = n;
 			continue;
 		}
+		if (strcmp(id, "subperiods") == 0) {
+			err = snd_config_get_integer(n, &subperiods);
+			if (err < 0 || subperiods < 1 || subperiods > 64) {
+				SNDERR("Invalid subperiods value");
+				return -EINVAL;
+			}
+			continue;
+		}
+		if (strcmp(id, "pipeline") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return -EINVAL;
+			pipeline = err;
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -1724,9 +2191,13 @@ int _snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 		return err;
 	err = snd_pcm_rate_open(pcmp, name, sformat, (unsigned int) srate,
 				converter, spcm, 1);
-	if (err < 0)
+	if (err < 0) {
 		snd_pcm_close(spcm);
-	return err;
+		return err;
+	}
+	((snd_pcm_rate_t *)(*pcmp)->private_data)->subperiods = subperiods;
+	((snd_pcm_rate_t *)(*pcmp)->private_data)->pipeline = pipeline;
+	return 0;
 }
 #ifndef DOC_HIDDEN
 SND_DLSYM_BUILD_VERSION(_snd_pcm_rate_open, SND_PCM_DLSYM_VERSION);
@@ -40,6 +40,8 @@ struct rate_linear {
 	unsigned int pitch_shift;	/* for expand interpolation */
 	unsigned int channels;
 	int16_t *old_sample;
+	int32_t *frame_old, *frame_new;	/* per frame state of the interleaved kernels */
+	unsigned int vec_channels;	/* channels for the vector code, 0 = generic */
 	void (*func)(struct rate_linear *rate,
 		     const snd_pcm_channel_area_t *dst_areas,
 		     snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
@@ -308,6 +310,150 @@ static void linear_shrink_s16(struct rate_linear *rate,
 	}
 }
 
+/*
+ * Interleaved S16 kernels: the phase only depends on the frame position,
+ * so it is computed once per frame and all channels of the frame are
+ * interpolated together.  The results are the same as of the per-channel
+ * loops above, which remain for the other layouts.
+ */
+
+static int linear_areas_interleaved(const snd_pcm_channel_area_t *areas,
+				    unsigned int channels)
+{
+	unsigned int c;
+
+	if (areas[0].first % 16 || areas[0].step != channels * 16 ||
+	    ((uintptr_t)areas[0].addr & 1))
+		return 0;
+	for (c = 1; c < channels; c++) {
+		if (areas[c].addr != areas[0].addr ||
+		    areas[c].step != areas[0].step ||
+		    areas[c].first != areas[0].first + c * 16)
+			return 0;
+	}
+	return 1;
+}
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define LINEAR_VEC_CPU	SND_CPU_SSE2
+#elif defined(__GNUC__) && defined(__ARM_NEON)
+#define LINEAR_VEC_CPU	SND_CPU_NEON
+#endif
+
+/* dst[c] = (a[c] * old_weight + b[c] * new_weight) >> 16 for a frame */
+static inline void linear_mix_frame(int16_t *dst, const int32_t *a,
+				    const int32_t *b, int old_weight,
+				    int new_weight, unsigned int channels,
+				    unsigned int vec_channels)
+{
+	unsigned int c = 0;
+#ifdef LINEAR_VEC_CPU
+	typedef int32_t linear_v4si __attribute__((vector_size(16)));
+	const linear_v4si ow = { old_weight, old_weight, old_weight, old_weight };
+	const linear_v4si nw = { new_weight, new_weight, new_weight, new_weight };
+
+	for (; c + 4 <= vec_channels; c += 4) {
+		linear_v4si x, y, v;
+		memcpy(&x, a + c, sizeof(x));
+		memcpy(&y, b + c, sizeof(y));
+		v = (x * ow + y * nw) >> 16;
+		dst[c] = v[0];
+		dst[c + 1] = v[1];
+		dst[c + 2] = v[2];
+		dst[c + 3] = v[3];
+	}
+#else
+	(void)vec_channels;
+#endif
+	for (; c < channels; c++)
+		dst[c] = (a[c] * old_weight + b[c] * new_weight) >> 16;
+}
+
+static void linear_expand_s16_interleaved(struct rate_linear *rate,
+					  int16_t *dst, unsigned int dst_frames,
+					  const int16_t *src, unsigned int src_frames)
+{
+	unsigned int channels = rate->channels;
+	unsigned int get_threshold = rate->pitch;
+	unsigned int src_frames1 = 0;
+	unsigned int dst_frames1;
+	int32_t *old = rate->frame_old;
+	int32_t *new = rate->frame_new;
+	unsigned int pos = get_threshold;
+	unsigned int c;
+
+	for (c = 0; c < channels; c++)
+		new[c] = rate->old_sample[c];
+	for (dst_frames1 = 0; dst_frames1 < dst_frames; dst_frames1++) {
+		int old_weight, new_weight;
+		if (pos >= get_threshold) {
+			int32_t *tmp = old;
+			pos -= get_threshold;
+			/* the old sample is the previous new one */
+			old = new;
+			new = tmp;
+			if (src_frames1 < src_frames) {
+				for (c = 0; c < channels; c++)
+					new[c] = src[c];
+			} else {
+				memcpy(new, old, channels * sizeof(*new));
+			}
+		}
+		new_weight = (pos << (16 - rate->pitch_shift)) / (get_threshold >> rate->pitch_shift);
+		old_weight = 0x10000 - new_weight;
+		linear_mix_frame(dst, old, new, old_weight, new_weight, channels,
+				 rate->vec_channels);
+		dst += channels;
+		pos += LINEAR_DIV;
+		if (pos >= get_threshold) {
+			src += channels;
+			src_frames1++;
+		}
+	}
+	for (c = 0; c < channels; c++)
+		rate->old_sample[c] = new[c];
+}
+
+static void linear_shrink_s16_interleaved(struct rate_linear *rate,
+					  int16_t *dst, unsigned int dst_frames,
+					  const int16_t *src, unsigned int src_frames)
+{
+	unsigned int channels = rate->channels;
+	unsigned int get_increment = rate->pitch;
+	unsigned int src_frames1;
+	unsigned int dst_frames1 = 0;
+	int32_t *old = rate->frame_old;
+	int32_t *new = rate->frame_new;
+	unsigned int pos = LINEAR_DIV - get_increment; /* Force first sample to be copied */
+	unsigned int c;
+
+	memset(old, 0, channels * sizeof(*old));
+	for (src_frames1 = 0; src_frames1 < src_frames; src_frames1++) {
+		int32_t *tmp;
+		for (c = 0; c < channels; c++)
+			new[c] = src[c];
+		src += channels;
+		pos += get_increment;
+		if (pos >= LINEAR_DIV) {
+			int old_weight, new_weight;
+			pos -= LINEAR_DIV;
+			old_weight = (pos << (32 - LINEAR_DIV_SHIFT)) / (get_increment >> (LINEAR_DIV_SHIFT - 16));
+			new_weight = 0x10000 - old_weight;
+			linear_mix_frame(dst, old, new, old_weight, new_weight, channels,
+					 rate->vec_channels);
+			dst += channels;
+			dst_frames1++;
+			if (CHECK_SANITY(dst_frames1 > dst_frames)) {
+				SNDERR("dst_frames overflow");
+				break;
+			}
+		}
+		tmp = old;
+		old = new;
+		new = tmp;
+	}
+}
+
 static void linear_convert(void *obj, 
 			   const snd_pcm_channel_area_t *dst_areas,
 			   snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
@@ -315,6 +461,20 @@ static void linear_convert(void *obj,
 			   snd_pcm_uframes_t src_offset, unsigned int src_frames)
 {
 	struct rate_linear *rate = obj;
+
+	if ((rate->func == linear_expand_s16 || rate->func == linear_shrink_s16) &&
+	    linear_areas_interleaved(src_areas, rate->channels) &&
+	    linear_areas_interleaved(dst_areas, rate->channels)) {
+		int16_t *dst = snd_pcm_channel_area_addr(dst_areas, dst_offset);
+		const int16_t *src = snd_pcm_channel_area_addr(src_areas, src_offset);
+		if (rate->func == linear_expand_s16)
+			linear_expand_s16_interleaved(rate, dst, dst_frames,
+						      src, src_frames);
+		else
+			linear_shrink_s16_interleaved(rate, dst, dst_frames,
+						      src, src_frames);
+		return;
+	}
 	rate->func(rate, dst_areas, dst_offset, dst_frames,
 		   src_areas, src_offset, src_frames);
 }
@@ -325,6 +485,9 @@ static void linear_free(void *obj)
 
 	free(rate->old_sample);
 	rate->old_sample = NULL;
+	free(rate->frame_old);
+	rate->frame_old = NULL;
+	rate->frame_new = NULL;
 }
 
 static int linear_init(void *obj, snd_pcm_rate_info_t *info)
@@ -349,11 +512,22 @@ static int linear_init(void *obj, snd_pcm_rate_info_t *info)
 	rate->pitch = (((uint64_t)info->out.rate * LINEAR_DIV) +
 		       (info->in.rate / 2)) / info->in.rate;
 	rate->channels = info->channels;
+#ifdef LINEAR_VEC_CPU
+	rate->vec_channels = snd_cpu_has(LINEAR_VEC_CPU) ? rate->channels : 0;
+#endif
 
 	free(rate->old_sample);
 	rate->old_sample = malloc(sizeof(*rate->old_sample) * rate->channels);
 	if (! rate->old_sample)
 		return -ENOMEM;
+	free(rate->frame_old);
+	rate->frame_old = malloc(sizeof(*rate->frame_old) * rate->channels * 2);
+	if (!rate->frame_old) {
+		free(rate->old_sample);
+		rate->old_sample = NULL;
+		return -ENOMEM;
+	}
+	rate->frame_new = rate->frame_old + rate->channels;
 
 	return 0;
 }
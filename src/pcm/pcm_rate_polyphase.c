@@ -0,0 +1,567 @@
+/*
+ *  Polyphase windowed-sinc rate converter plugin
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Each full period of in_period source frames is converted into
+ * out_period destination frames (the rate core always hands over whole
+ * periods, or whole sub-periods with the same ratio).  The output frame
+ * k of a period sits at the source position k * m / l, where m / l is
+ * in_period / out_period in lowest terms, so there are exactly l
+ * distinct filter phases.  When l is small - which is the case for
+ * 44.1k <-> 48k and 48k <-> 96k with matching periods - one coefficient
+ * set per phase is precomputed and the output is a single dot product.
+ * Otherwise a fixed number of phases is tabulated and the two
+ * neighbouring phases are interpolated linearly.
+ *
+ * The filter is a Kaiser-windowed sinc; the tap count grows with the
+ * decimation factor so that the transition band stays constant.  The
+ * converter adds a delay of taps / 2 source frames.
+ */
+
+#include <inttypes.h>
+#include <math.h>
+#include "pcm_local.h"
+#include "pcm_plugin.h"
+#include "pcm_rate.h"
+
+#define POLYPHASE_MAX_EXACT	512	/* max phases for an exact table */
+#define POLYPHASE_MAX_TAPS	512
+
+struct polyphase_quality {
+	const char *name;
+	unsigned int taps;		/* taps at unity ratio, multiple of 4 */
+	unsigned int phases;		/* phases of the interpolated table */
+	float cutoff;			/* relative to the lower nyquist */
+	float beta;			/* kaiser window parameter */
+};
+
+static const struct polyphase_quality polyphase_qualities[] = {
+	{ "fast",   16,  32, 0.85f,  6.0f },
+	{ "medium", 32, 128, 0.90f,  8.0f },
+	{ "best",   64, 256, 0.94f, 10.0f },
+};
+
+struct rate_polyphase {
+	const struct polyphase_quality *quality;
+	unsigned int channels;
+	unsigned int in_period;
+	unsigned int out_period;
+	snd_pcm_format_t in_format;
+	snd_pcm_format_t out_format;
+	unsigned int step_int;		/* m / l */
+	unsigned int step_rem;		/* m % l */
+	unsigned int l;
+	unsigned int taps;
+	unsigned int phases;
+	unsigned int exact;
+	const float *coefs;		/* (phases + 1) * taps, shared */
+	float *work;			/* channels * (taps + in_period) */
+	const struct polyphase_kernel *kernel;
+};
+
+/*
+ * Dot products of the filter, one convert routine is built around each
+ * and the widest usable one is taken at open.  The float sums are done
+ * in different orders, so the kernels differ in the last bits.
+ */
+#if defined(__GNUC__)
+#define POLYPHASE_INLINE	inline __attribute__((always_inline))
+#else
+#define POLYPHASE_INLINE	inline
+#endif
+
+static POLYPHASE_INLINE float polyphase_dot_generic(const float *x, const float *h,
+						    unsigned int taps)
+{
+	float acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+	unsigned int i;
+
+	for (i = 0; i < taps; i += 4) {
+		acc0 += x[i] * h[i];
+		acc1 += x[i + 1] * h[i + 1];
+		acc2 += x[i + 2] * h[i + 2];
+		acc3 += x[i + 3] * h[i + 3];
+	}
+	return (acc0 + acc1) + (acc2 + acc3);
+}
+
+#if defined(__GNUC__) && defined(__SSE__)
+#define POLYPHASE_V4_CPU	SND_CPU_SSE
+#elif defined(__GNUC__) && defined(__ARM_NEON)
+#define POLYPHASE_V4_CPU	SND_CPU_NEON
+#endif
+
+#ifdef POLYPHASE_V4_CPU
+typedef float polyphase_v4sf __attribute__((vector_size(16), aligned(4)));
+
+static POLYPHASE_INLINE float polyphase_dot_v4(const float *x, const float *h,
+					       unsigned int taps)
+{
+	polyphase_v4sf acc0 = { 0, 0, 0, 0 }, acc1 = { 0, 0, 0, 0 };
+	unsigned int i;
+
+	for (i = 0; i + 8 <= taps; i += 8) {
+		acc0 += *(const polyphase_v4sf *)(x + i) * *(const polyphase_v4sf *)(h + i);
+		acc1 += *(const polyphase_v4sf *)(x + i + 4) * *(const polyphase_v4sf *)(h + i + 4);
+	}
+	if (i < taps)
+		acc0 += *(const polyphase_v4sf *)(x + i) * *(const polyphase_v4sf *)(h + i);
+	acc0 += acc1;
+	return acc0[0] + acc0[1] + acc0[2] + acc0[3];
+}
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__) && \
+    (defined(__clang__) || __GNUC__ >= 5)
+#define POLYPHASE_AVX2_TARGET	__attribute__((target("avx2,fma")))
+typedef float polyphase_v8sf __attribute__((vector_size(32), aligned(4)));
+
+static POLYPHASE_INLINE POLYPHASE_AVX2_TARGET
+float polyphase_dot_avx2(const float *x, const float *h, unsigned int taps)
+{
+	polyphase_v8sf acc0 = { 0 }, acc1 = { 0 };
+	unsigned int i;
+	float sum;
+
+	for (i = 0; i + 16 <= taps; i += 16) {
+		acc0 += *(const polyphase_v8sf *)(x + i) * *(const polyphase_v8sf *)(h + i);
+		acc1 += *(const polyphase_v8sf *)(x + i + 8) * *(const polyphase_v8sf *)(h + i + 8);
+	}
+	if (i + 8 <= taps) {
+		acc0 += *(const polyphase_v8sf *)(x + i) * *(const polyphase_v8sf *)(h + i);
+		i += 8;
+	}
+	acc0 += acc1;
+	sum = ((acc0[0] + acc0[4]) + (acc0[1] + acc0[5])) +
+	      ((acc0[2] + acc0[6]) + (acc0[3] + acc0[7]));
+	for (; i < taps; i++)
+		sum += x[i] * h[i];
+	return sum;
+}
+#endif
+
+/* zeroth order modified bessel function, for the kaiser window */
+static double bessel_i0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	unsigned int k;
+
+	for (k = 1; k < 64; k++) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+		if (term < sum * 1e-12)
+			break;
+	}
+	return sum;
+}
+
+static void polyphase_make_phase(const struct polyphase_quality *quality,
+				 unsigned int taps, float *h,
+				 double frac, double fc)
+{
+	double half = taps / 2.0;
+	double i0_beta = bessel_i0(quality->beta);
+	double sum = 0.0;
+	unsigned int j;
+
+	for (j = 0; j < taps; j++) {
+		double x = j + 1.0 - half - frac;
+		double r = x / half;
+		double v, w;
+		if (fabs(x) < 1e-9)
+			v = fc;
+		else
+			v = sin(M_PI * fc * x) / (M_PI * x);
+		w = r * r < 1.0 ? bessel_i0(quality->beta * sqrt(1.0 - r * r)) / i0_beta : 0.0;
+		h[j] = v * w;
+		sum += h[j];
+	}
+	/* unity gain at DC for every phase */
+	for (j = 0; j < taps; j++)
+		h[j] /= sum;
+}
+
+static unsigned int gcd(unsigned int a, unsigned int b)
+{
+	while (b) {
+		unsigned int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/* the filter for the ratio m / l, returns the number of taps */
+static unsigned int polyphase_filter(const struct polyphase_quality *quality,
+				     unsigned int m, unsigned int l,
+				     unsigned int *phases, double *fc)
+{
+	unsigned int taps;
+
+	/* widen the filter when decimating to keep the transition band */
+	taps = quality->taps;
+	*fc = quality->cutoff;
+	if (m > l) {
+		taps = ((uint64_t)taps * m + l - 1) / l;
+		*fc = *fc * l / m;
+	}
+	taps = (taps + 3) & ~3U;
+	if (taps > POLYPHASE_MAX_TAPS)
+		taps = POLYPHASE_MAX_TAPS;
+	*phases = l <= POLYPHASE_MAX_EXACT ? l : quality->phases;
+	return taps;
+}
+
+/* the coefficients depend only on these, so the instances share them */
+struct polyphase_table_key {
+	unsigned int quality;		/* index in polyphase_qualities */
+	unsigned int m, l;
+};
+
+static int polyphase_build_table(void *table, const void *data)
+{
+	const struct polyphase_table_key *key = data;
+	const struct polyphase_quality *quality = &polyphase_qualities[key->quality];
+	unsigned int p, phases, taps;
+	float *coefs = table;
+	double fc;
+
+	taps = polyphase_filter(quality, key->m, key->l, &phases, &fc);
+	for (p = 0; p <= phases; p++)
+		polyphase_make_phase(quality, taps, coefs + p * taps,
+				     (double)p / phases, fc);
+	return 0;
+}
+
+static int polyphase_setup(struct rate_polyphase *rate)
+{
+	struct polyphase_table_key key;
+	const float *coefs;
+	unsigned int g, m, taps;
+	double fc;
+
+	g = gcd(rate->in_period, rate->out_period);
+	m = rate->in_period / g;
+	rate->l = rate->out_period / g;
+	rate->step_int = m / rate->l;
+	rate->step_rem = m % rate->l;
+
+	taps = polyphase_filter(rate->quality, m, rate->l, &rate->phases, &fc);
+	rate->taps = taps;
+	rate->exact = rate->l <= POLYPHASE_MAX_EXACT;
+
+	memset(&key, 0, sizeof(key));
+	key.quality = rate->quality - polyphase_qualities;
+	key.m = m;
+	key.l = rate->l;
+	coefs = snd_pcm_table_get("polyphase", &key, sizeof(key),
+				  sizeof(float) * (rate->phases + 1) * taps,
+				  polyphase_build_table);
+	if (!coefs)
+		return -ENOMEM;
+	/* taken first, so that a setup with the same ratio keeps the table */
+	snd_pcm_table_put(rate->coefs);
+	rate->coefs = coefs;
+
+	free(rate->work);
+	rate->work = calloc(rate->channels * (taps + rate->in_period), sizeof(float));
+	if (!rate->work)
+		return -ENOMEM;
+	return 0;
+}
+
+static snd_pcm_uframes_t input_frames(void *obj, snd_pcm_uframes_t frames)
+{
+	struct rate_polyphase *rate = obj;
+	if (frames == 0)
+		return 0;
+	return muldiv_near(frames, rate->in_period, rate->out_period);
+}
+
+static snd_pcm_uframes_t output_frames(void *obj, snd_pcm_uframes_t frames)
+{
+	struct rate_polyphase *rate = obj;
+	if (frames == 0)
+		return 0;
+	return muldiv_near(frames, rate->out_period, rate->in_period);
+}
+
+static inline void polyphase_load(struct rate_polyphase *rate, float *dst,
+				  const snd_pcm_channel_area_t *area,
+				  snd_pcm_uframes_t offset, unsigned int frames)
+{
+	const char *src = snd_pcm_channel_area_addr(area, offset);
+	int step = snd_pcm_channel_area_step(area);
+	unsigned int i;
+
+	if (rate->in_format == SND_PCM_FORMAT_S16) {
+		for (i = 0; i < frames; i++, src += step)
+			dst[i] = *(const int16_t *)src;
+	} else {
+		for (i = 0; i < frames; i++, src += step)
+			dst[i] = *(const int32_t *)src;
+	}
+}
+
+static inline void polyphase_store(struct rate_polyphase *rate, char *dst, float v)
+{
+	if (rate->out_format == SND_PCM_FORMAT_S16) {
+		if (v >= 32767.0f)
+			*(int16_t *)dst = 0x7fff;
+		else if (v <= -32768.0f)
+			*(int16_t *)dst = -0x8000;
+		else
+			*(int16_t *)dst = lrintf(v);
+	} else {
+		if (v >= 2147483647.0f)
+			*(int32_t *)dst = 0x7fffffff;
+		else if (v <= -2147483648.0f)
+			*(int32_t *)dst = (int32_t)0x80000000;
+		else
+			*(int32_t *)dst = lrintf(v);
+	}
+}
+
+#define POLYPHASE_CONVERT_ARGS \
+	void *obj, \
+	const snd_pcm_channel_area_t *dst_areas, \
+	snd_pcm_uframes_t dst_offset, unsigned int dst_frames, \
+	const snd_pcm_channel_area_t *src_areas, \
+	snd_pcm_uframes_t src_offset, unsigned int src_frames
+#define POLYPHASE_CONVERT_PASS \
+	obj, dst_areas, dst_offset, dst_frames, src_areas, src_offset, src_frames
+
+typedef float (polyphase_dot_t)(const float *x, const float *h, unsigned int taps);
+
+/* the convert routine, inlined into one function per dot product */
+static POLYPHASE_INLINE void polyphase_convert_with(POLYPHASE_CONVERT_ARGS,
+						   polyphase_dot_t *dot)
+{
+	struct rate_polyphase *rate = obj;
+	unsigned int taps = rate->taps;
+	unsigned int channel;
+
+	if (!rate->coefs || !rate->work)
+		return;
+	if (CHECK_SANITY(src_frames != rate->in_period ||
+			 dst_frames != rate->out_period)) {
+		SNDERR("unexpected period size %u -> %u", src_frames, dst_frames);
+		return;
+	}
+
+	for (channel = 0; channel < rate->channels; ++channel) {
+		float *buf = rate->work + channel * (taps + rate->in_period);
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		char *dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		int dst_step = snd_pcm_channel_area_step(dst_area);
+		unsigned int base = 0, rem = 0, k;
+
+		/* buf[0..taps) holds the tail of the previous period */
+		polyphase_load(rate, buf + taps, &src_areas[channel],
+			       src_offset, src_frames);
+
+		for (k = 0; k < dst_frames; k++, dst += dst_step) {
+			const float *x = buf + base + 1;
+			float v;
+
+			if (rate->exact) {
+				v = dot(x, rate->coefs + rem * taps, taps);
+			} else {
+				uint64_t acc = (uint64_t)rem * rate->phases;
+				unsigned int p = acc / rate->l;
+				float frac = (float)(acc % rate->l) / rate->l;
+				float v0 = dot(x, rate->coefs + p * taps, taps);
+				float v1 = dot(x, rate->coefs + (p + 1) * taps, taps);
+				v = v0 + frac * (v1 - v0);
+			}
+			polyphase_store(rate, dst, v);
+
+			base += rate->step_int;
+			rem += rate->step_rem;
+			if (rem >= rate->l) {
+				rem -= rate->l;
+				base++;
+			}
+		}
+		memmove(buf, buf + src_frames, taps * sizeof(float));
+	}
+}
+
+static void polyphase_convert_generic(POLYPHASE_CONVERT_ARGS)
+{
+	polyphase_convert_with(POLYPHASE_CONVERT_PASS, polyphase_dot_generic);
+}
+
+#ifdef POLYPHASE_V4_CPU
+static void polyphase_convert_v4(POLYPHASE_CONVERT_ARGS)
+{
+	polyphase_convert_with(POLYPHASE_CONVERT_PASS, polyphase_dot_v4);
+}
+#endif
+
+#ifdef POLYPHASE_AVX2_TARGET
+static POLYPHASE_AVX2_TARGET void polyphase_convert_avx2(POLYPHASE_CONVERT_ARGS)
+{
+	polyphase_convert_with(POLYPHASE_CONVERT_PASS, polyphase_dot_avx2);
+}
+#endif
+
+static const struct polyphase_kernel {
+	unsigned int cpu;
+	const char *name;
+	void (*convert)(POLYPHASE_CONVERT_ARGS);
+} polyphase_kernels[] = {
+#ifdef POLYPHASE_AVX2_TARGET
+	{ SND_CPU_AVX2 | SND_CPU_FMA, "avx2", polyphase_convert_avx2 },
+#endif
+#ifdef POLYPHASE_V4_CPU
+	{ POLYPHASE_V4_CPU, "vector", polyphase_convert_v4 },
+#endif
+	{ 0, "generic", polyphase_convert_generic },
+};
+
+static void polyphase_free(void *obj)
+{
+	struct rate_polyphase *rate = obj;
+
+	snd_pcm_table_put(rate->coefs);
+	rate->coefs = NULL;
+	free(rate->work);
+	rate->work = NULL;
+}
+
+static int polyphase_init(void *obj, snd_pcm_rate_info_t *info)
+{
+	struct rate_polyphase *rate = obj;
+
+	rate->channels = info->channels;
+	rate->in_format = info->in.format;
+	rate->out_format = info->out.format;
+	rate->in_period = info->in.period_size;
+	rate->out_period = info->out.period_size;
+	return polyphase_setup(rate);
+}
+
+static int polyphase_adjust_pitch(void *obj, snd_pcm_rate_info_t *info)
+{
+	struct rate_polyphase *rate = obj;
+
+	if (rate->in_period == info->in.period_size &&
+	    rate->out_period == info->out.period_size)
+		return 0;
+	rate->in_period = info->in.period_size;
+	rate->out_period = info->out.period_size;
+	return polyphase_setup(rate);
+}
+
+static void polyphase_reset(void *obj)
+{
+	struct rate_polyphase *rate = obj;
+
+	if (rate->work)
+		memset(rate->work, 0, sizeof(float) * rate->channels *
+		       (rate->taps + rate->in_period));
+}
+
+static void polyphase_close(void *obj)
+{
+	polyphase_free(obj);
+	free(obj);
+}
+
+static int get_supported_rates(ATTRIBUTE_UNUSED void *rate,
+			       unsigned int *rate_min, unsigned int *rate_max)
+{
+	*rate_min = SND_PCM_PLUGIN_RATE_MIN;
+	*rate_max = SND_PCM_PLUGIN_RATE_MAX;
+	return 0;
+}
+
+static int get_supported_formats(ATTRIBUTE_UNUSED void *rate,
+				 uint64_t *in_formats, uint64_t *out_formats,
+				 unsigned int *flags)
+{
+	*in_formats = *out_formats = (1ULL << SND_PCM_FORMAT_S16) |
+				     (1ULL << SND_PCM_FORMAT_S32);
+	*flags = 0;
+	return 0;
+}
+
+static void polyphase_dump(void *obj, snd_output_t *out)
+{
+	struct rate_polyphase *rate = obj;
+
+	snd_output_printf(out, "Converter: polyphase (%s, %s)\n",
+			  rate->quality->name, rate->kernel->name);
+	if (rate->coefs)
+		snd_output_printf(out, "  taps: %u, phases: %u%s\n", rate->taps,
+				  rate->phases, rate->exact ? " (exact)" : "");
+}
+
+static const snd_pcm_rate_ops_t polyphase_ops = {
+	.close = polyphase_close,
+	.init = polyphase_init,
+	.free = polyphase_free,
+	.reset = polyphase_reset,
+	.adjust_pitch = polyphase_adjust_pitch,
+	.input_frames = input_frames,
+	.output_frames = output_frames,
+	.version = SND_PCM_RATE_PLUGIN_VERSION,
+	.get_supported_rates = get_supported_rates,
+	.dump = polyphase_dump,
+	.get_supported_formats = get_supported_formats,
+};
+
+static int polyphase_open(unsigned int version, void **objp,
+			  snd_pcm_rate_ops_t *ops,
+			  const struct polyphase_quality *quality)
+{
+	struct rate_polyphase *rate;
+
+	/* the format negotiation needs protocol 0x010003 */
+	if (version < 0x010003)
+		return -EINVAL;
+	rate = calloc(1, sizeof(*rate));
+	if (! rate)
+		return -ENOMEM;
+	rate->quality = quality;
+	rate->kernel = snd_cpu_select(polyphase_kernels, sizeof(*rate->kernel));
+
+	*objp = rate;
+	*ops = polyphase_ops;
+	ops->convert = rate->kernel->convert;
+	return 0;
+}
+
+int SND_PCM_RATE_PLUGIN_ENTRY(polyphase_fast) (unsigned int version,
+					       void **objp, snd_pcm_rate_ops_t *ops)
+{
+	return polyphase_open(version, objp, ops, &polyphase_qualities[0]);
+}
+
+int SND_PCM_RATE_PLUGIN_ENTRY(polyphase) (unsigned int version,
+					  void **objp, snd_pcm_rate_ops_t *ops)
+{
+	return polyphase_open(version, objp, ops, &polyphase_qualities[1]);
+}
+
+int SND_PCM_RATE_PLUGIN_ENTRY(polyphase_best) (unsigned int version,
+					       void **objp, snd_pcm_rate_ops_t *ops)
+{
+	return polyphase_open(version, objp, ops, &polyphase_qualities[2]);
+}
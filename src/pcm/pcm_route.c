@@ -58,6 +58,7 @@ typedef struct {
 } snd_pcm_route_ttable_src_t;
 
 typedef struct snd_pcm_route_ttable_dst snd_pcm_route_ttable_dst_t;
+typedef struct snd_pcm_route_plan snd_pcm_route_plan_t;
 
 typedef struct {
 	enum {UINT64, FLOAT} sum_idx;
@@ -70,6 +71,8 @@ typedef struct {
 	unsigned int nsrcs;
 	unsigned int ndsts;
 	snd_pcm_route_ttable_dst_t *dsts;
+	snd_pcm_route_plan_t *plan;
+	unsigned int *gain;		/* 16.16 per destination, fused gain only */
 } snd_pcm_route_params_t;
 
 
@@ -105,8 +108,21 @@ typedef struct {
 	snd_pcm_route_params_t params;
 	snd_pcm_chmap_t *chmap;
 	snd_pcm_chmap_query_t **chmap_override;
+	snd_pcm_softvol_gain_t *gain;	/* fused soft volume, owned by plug */
 } snd_pcm_route_t;
 
+/* applies a 16.16 gain factor to a normalized sample */
+static inline int32_t route_gain_apply(int32_t sample, unsigned int scale)
+{
+	int64_t v = ((int64_t)sample * scale) >> 16;
+
+	if (v > (int64_t)0x7fffffff)
+		return 0x7fffffff;
+	if (v < -(int64_t)0x80000000)
+		return 0x80000000;
+	return v;
+}
+
 #endif /* DOC_HIDDEN */
 
 static void snd_pcm_route_convert1_zero(const snd_pcm_channel_area_t *dst_area,
@@ -262,6 +278,7 @@ static void snd_pcm_route_convert1_many(const snd_pcm_channel_area_t *dst_area,
 #endif
 	};
 	void *zero, *get32, *add, *norm, *put32;
+	unsigned int scale = 0;
 	int nsrcs = ttable->nsrcs;
 	char *dst;
 	int dst_step;
@@ -288,7 +305,8 @@ static void snd_pcm_route_convert1_many(const snd_pcm_channel_area_t *dst_area,
 					    src_channels,
 					    frames, ttable, params);
 		return;
-	} else if (nsrcs == 1 && src_tt[0].as_int == SND_PCM_PLUGIN_ROUTE_RESOLUTION) {
+	} else if (nsrcs == 1 && src_tt[0].as_int == SND_PCM_PLUGIN_ROUTE_RESOLUTION &&
+		   !params->gain) {
 		if (params->use_getput)
 			snd_pcm_route_convert1_one_getput(dst_area, dst_offset,
 							  src_areas, src_offset,
@@ -309,6 +327,8 @@ static void snd_pcm_route_convert1_many(const snd_pcm_channel_area_t *dst_area,
 	put32 = put32_labels[params->put_idx];
 	dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
 	dst_step = snd_pcm_channel_area_step(dst_area);
+	if (params->gain)
+		scale = params->gain[ttable - params->dsts];
 
 	while (frames-- > 0) {
 		snd_pcm_route_ttable_src_t *ttp = src_tt;
@@ -384,6 +404,8 @@ static void snd_pcm_route_convert1_many(const snd_pcm_channel_area_t *dst_area,
 		goto after_norm;
 #endif
 	after_norm:
+		if (params->gain)
+			sample = route_gain_apply(sample, scale);
 		
 		/* Put sample */
 		goto *put32;
@@ -396,6 +418,374 @@ static void snd_pcm_route_convert1_many(const snd_pcm_channel_area_t *dst_area,
 	}
 }
 
+/*
+ * Compiled routing plan
+ *
+ * The generic path above walks the ttable per destination and jumps
+ * through the get/add/put labels for every sample.  For large, mostly
+ * empty matrices on plain S16/S32 streams the table is compiled at
+ * hw_params into three lists instead:
+ *  - destinations without any source, which are just silenced,
+ *  - destinations fed by exactly one source at full level, which are
+ *    copied (and widened or narrowed) by straight strided loops,
+ *  - the remaining weighted rows, stored CSR-like (row offsets into one
+ *    array of source channels and gains) and mixed a block of frames at
+ *    a time, one source after the other, into an accumulator.
+ * The arithmetic is done in the same order and precision as in
+ * snd_pcm_route_convert1_many(), so the results are identical.  With a
+ * fused gain every fed destination is a mix row, and the gain is applied
+ * to the normalized sum while the block is stored.
+ */
+
+#define ROUTE_PLAN_BLOCK	256	/* frames mixed per accumulator pass */
+
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+typedef float route_acc_t;
+#else
+typedef int64_t route_acc_t;
+#endif
+
+struct snd_pcm_route_plan {
+	unsigned int src_width;		/* bytes per sample, 2 or 4 */
+	unsigned int dst_width;
+	unsigned int src_channels;
+	unsigned int dst_channels;
+	unsigned int nzero;
+	unsigned int ncopy;
+	unsigned int nmix;
+	unsigned int *zero_dst;
+	unsigned int *copy_dst;
+	unsigned int *copy_src;
+	unsigned int *mix_dst;
+	unsigned int *mix_att;
+	unsigned int *mix_row;		/* nmix + 1 offsets into mix_src/mix_gain */
+	unsigned int *mix_src;
+	route_acc_t *mix_gain;
+};
+
+#define ROUTE_PLAN_COPY(name, stype, dtype, expr) \
+static SND_VECTORIZE void route_plan_copy_##name(char *dst, int dst_step, \
+						  const char *src, int src_step, \
+						  unsigned int frames) \
+{ \
+	unsigned int i; \
+	if (dst_step == sizeof(dtype) && src_step == sizeof(stype)) { \
+		dtype *__restrict d = (dtype *)dst; \
+		const stype *__restrict s = (const stype *)src; \
+		for (i = 0; i < frames; i++) { \
+			stype v = s[i]; \
+			d[i] = (expr); \
+		} \
+		return; \
+	} \
+	for (i = 0; i < frames; i++) { \
+		stype v = *(const stype *)src; \
+		*(dtype *)dst = (expr); \
+		src += src_step; \
+		dst += dst_step; \
+	} \
+}
+
+ROUTE_PLAN_COPY(16_16, uint16_t, uint16_t, v)
+ROUTE_PLAN_COPY(16_32, uint16_t, uint32_t, (uint32_t)v << 16)
+ROUTE_PLAN_COPY(32_16, uint32_t, uint16_t, v >> 16)
+ROUTE_PLAN_COPY(32_32, uint32_t, uint32_t, v)
+
+#define ROUTE_PLAN_MAC(name, stype, get) \
+static SND_VECTORIZE void route_plan_mac_##name(route_acc_t *__restrict acc, \
+						 const char *src, int src_step, \
+						 route_acc_t gain, int first, \
+						 unsigned int frames) \
+{ \
+	unsigned int i; \
+	if (src_step == sizeof(stype)) { \
+		const stype *__restrict s = (const stype *)src; \
+		if (first) \
+			for (i = 0; i < frames; i++) \
+				acc[i] = (route_acc_t)get(s[i]) * gain; \
+		else \
+			for (i = 0; i < frames; i++) \
+				acc[i] += (route_acc_t)get(s[i]) * gain; \
+		return; \
+	} \
+	if (first) \
+		for (i = 0; i < frames; i++, src += src_step) \
+			acc[i] = (route_acc_t)get(*(const stype *)src) * gain; \
+	else \
+		for (i = 0; i < frames; i++, src += src_step) \
+			acc[i] += (route_acc_t)get(*(const stype *)src) * gain; \
+}
+
+#define route_get16(v)	((int32_t)((uint32_t)(v) << 16))
+#define route_get32(v)	((int32_t)(v))
+ROUTE_PLAN_MAC(16, uint16_t, route_get16)
+ROUTE_PLAN_MAC(32, uint32_t, route_get32)
+#undef route_get16
+#undef route_get32
+
+static inline int32_t route_plan_norm(route_acc_t sum, int att)
+{
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+	(void)att;
+	sum = rintf(sum);
+	if (sum > (int64_t)0x7fffffff)
+		return 0x7fffffff;
+	if (sum < -(int64_t)0x80000000)
+		return 0x80000000;
+	return sum;
+#else
+	if (att)
+		div(sum);
+	if (sum > (int64_t)0x7fffffff)
+		return 0x7fffffff;
+	if (sum < -(int64_t)0x80000000)
+		return 0x80000000;
+	return sum;
+#endif
+}
+
+#define ROUTE_PLAN_PUT(name, dtype, shift) \
+static SND_VECTORIZE void route_plan_put_##name(char *dst, int dst_step, \
+						 const route_acc_t *acc, int att, \
+						 unsigned int frames) \
+{ \
+	unsigned int i; \
+	for (i = 0; i < frames; i++, dst += dst_step) \
+		*(dtype *)dst = (uint32_t)route_plan_norm(acc[i], att) >> (shift); \
+} \
+static SND_VECTORIZE void route_plan_put_gain_##name(char *dst, int dst_step, \
+						      const route_acc_t *acc, int att, \
+						      unsigned int scale, \
+						      unsigned int frames) \
+{ \
+	unsigned int i; \
+	for (i = 0; i < frames; i++, dst += dst_step) \
+		*(dtype *)dst = (uint32_t)route_gain_apply(route_plan_norm(acc[i], att), \
+							   scale) >> (shift); \
+}
+
+ROUTE_PLAN_PUT(16, uint16_t, 16)
+ROUTE_PLAN_PUT(32, uint32_t, 0)
+
+#undef ROUTE_PLAN_COPY
+#undef ROUTE_PLAN_MAC
+#undef ROUTE_PLAN_PUT
+
+static void snd_pcm_route_plan_free(snd_pcm_route_params_t *params)
+{
+	snd_pcm_route_plan_t *plan = params->plan;
+
+	if (!plan)
+		return;
+	free(plan->zero_dst);
+	free(plan->copy_dst);
+	free(plan->copy_src);
+	free(plan->mix_dst);
+	free(plan->mix_att);
+	free(plan->mix_row);
+	free(plan->mix_src);
+	free(plan->mix_gain);
+	free(plan);
+	params->plan = NULL;
+}
+
+static int snd_pcm_route_plan_width(snd_pcm_format_t format)
+{
+	if (format == SND_PCM_FORMAT_S16)
+		return 2;
+	if (format == SND_PCM_FORMAT_S32)
+		return 4;
+	return 0;
+}
+
+/*
+ * (re)builds the plan for the given formats and channel counts;
+ * leaves params->plan NULL when the generic path has to be used
+ */
+static int snd_pcm_route_plan_compile(snd_pcm_route_params_t *params,
+				      snd_pcm_format_t src_format,
+				      snd_pcm_format_t dst_format,
+				      unsigned int src_channels,
+				      unsigned int dst_channels)
+{
+	snd_pcm_route_plan_t *plan;
+	unsigned int dst, nnz = 0;
+
+	snd_pcm_route_plan_free(params);
+	if (!snd_pcm_route_plan_width(src_format) ||
+	    !snd_pcm_route_plan_width(dst_format))
+		return 0;
+	for (dst = 0; dst < params->ndsts && dst < dst_channels; dst++)
+		nnz += params->dsts[dst].nsrcs;
+
+	plan = calloc(1, sizeof(*plan));
+	if (!plan)
+		return -ENOMEM;
+	params->plan = plan;
+	plan->src_width = snd_pcm_route_plan_width(src_format);
+	plan->dst_width = snd_pcm_route_plan_width(dst_format);
+	plan->src_channels = src_channels;
+	plan->dst_channels = dst_channels;
+	plan->zero_dst = calloc(dst_channels, sizeof(*plan->zero_dst));
+	plan->copy_dst = calloc(dst_channels, sizeof(*plan->copy_dst));
+	plan->copy_src = calloc(dst_channels, sizeof(*plan->copy_src));
+	plan->mix_dst = calloc(dst_channels, sizeof(*plan->mix_dst));
+	plan->mix_att = calloc(dst_channels, sizeof(*plan->mix_att));
+	plan->mix_row = calloc(dst_channels + 1, sizeof(*plan->mix_row));
+	plan->mix_src = calloc(nnz + 1, sizeof(*plan->mix_src));
+	plan->mix_gain = calloc(nnz + 1, sizeof(*plan->mix_gain));
+	if (!plan->zero_dst || !plan->copy_dst || !plan->copy_src ||
+	    !plan->mix_dst || !plan->mix_att || !plan->mix_row ||
+	    !plan->mix_src || !plan->mix_gain) {
+		snd_pcm_route_plan_free(params);
+		return -ENOMEM;
+	}
+
+	nnz = 0;
+	for (dst = 0; dst < dst_channels; dst++) {
+		const snd_pcm_route_ttable_dst_t *d;
+		const snd_pcm_route_ttable_src_t *one = NULL;
+		unsigned int srcidx, first = nnz;
+
+		if (dst >= params->ndsts) {
+			plan->zero_dst[plan->nzero++] = dst;
+			continue;
+		}
+		d = &params->dsts[dst];
+		for (srcidx = 0; srcidx < d->nsrcs; srcidx++) {
+			const snd_pcm_route_ttable_src_t *src = &d->srcs[srcidx];
+			if ((unsigned int)src->channel >= src_channels)
+				continue;
+			if (!one)
+				one = src;
+			plan->mix_src[nnz] = src->channel;
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+			plan->mix_gain[nnz] = src->as_float;
+#else
+			plan->mix_gain[nnz] = d->att ? src->as_int : 1;
+#endif
+			nnz++;
+		}
+		if (nnz == first) {
+			plan->zero_dst[plan->nzero++] = dst;
+		} else if (nnz == first + 1 && !params->gain &&
+			   one->as_int == SND_PCM_PLUGIN_ROUTE_RESOLUTION) {
+			plan->copy_dst[plan->ncopy] = dst;
+			plan->copy_src[plan->ncopy++] = plan->mix_src[first];
+			nnz = first;
+		} else {
+			plan->mix_dst[plan->nmix] = dst;
+			plan->mix_att[plan->nmix] = d->att;
+			plan->mix_row[plan->nmix++] = first;
+		}
+	}
+	plan->mix_row[plan->nmix] = nnz;
+	return 0;
+}
+
+/* the kernels address whole samples only */
+static int snd_pcm_route_plan_areas_ok(const snd_pcm_channel_area_t *areas,
+				       unsigned int channels)
+{
+	unsigned int channel;
+
+	for (channel = 0; channel < channels; channel++) {
+		if (!areas[channel].addr ||
+		    areas[channel].first % 8 || areas[channel].step % 8)
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * runs the compiled plan; returns 0 if it cannot be used for these
+ * areas and the caller has to take the generic path
+ */
+static int snd_pcm_route_convert_plan(const snd_pcm_channel_area_t *dst_areas,
+				      snd_pcm_uframes_t dst_offset,
+				      const snd_pcm_channel_area_t *src_areas,
+				      snd_pcm_uframes_t src_offset,
+				      unsigned int src_channels,
+				      unsigned int dst_channels,
+				      snd_pcm_uframes_t frames,
+				      const snd_pcm_route_params_t *params)
+{
+	const snd_pcm_route_plan_t *plan = params->plan;
+	route_acc_t acc[ROUTE_PLAN_BLOCK];
+	unsigned int i;
+
+	if (!plan || plan->src_channels != src_channels ||
+	    plan->dst_channels != dst_channels ||
+	    !snd_pcm_route_plan_areas_ok(src_areas, src_channels) ||
+	    !snd_pcm_route_plan_areas_ok(dst_areas, dst_channels))
+		return 0;
+
+	for (i = 0; i < plan->nzero; i++)
+		snd_pcm_area_silence(&dst_areas[plan->zero_dst[i]], dst_offset,
+				     frames, params->dst_sfmt);
+
+	for (i = 0; i < plan->ncopy; i++) {
+		const snd_pcm_channel_area_t *src_area = &src_areas[plan->copy_src[i]];
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[plan->copy_dst[i]];
+		const char *src = snd_pcm_channel_area_addr(src_area, src_offset);
+		char *dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		int src_step = snd_pcm_channel_area_step(src_area);
+		int dst_step = snd_pcm_channel_area_step(dst_area);
+
+		if (plan->src_width == 2) {
+			if (plan->dst_width == 2)
+				route_plan_copy_16_16(dst, dst_step, src, src_step, frames);
+			else
+				route_plan_copy_16_32(dst, dst_step, src, src_step, frames);
+		} else {
+			if (plan->dst_width == 2)
+				route_plan_copy_32_16(dst, dst_step, src, src_step, frames);
+			else
+				route_plan_copy_32_32(dst, dst_step, src, src_step, frames);
+		}
+	}
+
+	for (i = 0; i < plan->nmix; i++) {
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[plan->mix_dst[i]];
+		int dst_step = snd_pcm_channel_area_step(dst_area);
+		snd_pcm_uframes_t done = 0;
+
+		while (done < frames) {
+			unsigned int n = ROUTE_PLAN_BLOCK, k;
+			char *dst;
+
+			if (frames - done < n)
+				n = frames - done;
+			for (k = plan->mix_row[i]; k < plan->mix_row[i + 1]; k++) {
+				const snd_pcm_channel_area_t *src_area = &src_areas[plan->mix_src[k]];
+				const char *src = snd_pcm_channel_area_addr(src_area, src_offset + done);
+				int src_step = snd_pcm_channel_area_step(src_area);
+				int first = k == plan->mix_row[i];
+
+				if (plan->src_width == 2)
+					route_plan_mac_16(acc, src, src_step, plan->mix_gain[k], first, n);
+				else
+					route_plan_mac_32(acc, src, src_step, plan->mix_gain[k], first, n);
+			}
+			dst = snd_pcm_channel_area_addr(dst_area, dst_offset + done);
+			if (params->gain) {
+				unsigned int scale = params->gain[plan->mix_dst[i]];
+				if (plan->dst_width == 2)
+					route_plan_put_gain_16(dst, dst_step, acc,
+							       plan->mix_att[i], scale, n);
+				else
+					route_plan_put_gain_32(dst, dst_step, acc,
+							       plan->mix_att[i], scale, n);
+			} else if (plan->dst_width == 2)
+				route_plan_put_16(dst, dst_step, acc, plan->mix_att[i], n);
+			else
+				route_plan_put_32(dst, dst_step, acc, plan->mix_att[i], n);
+			done += n;
+		}
+	}
+	return 1;
+}
+
 #endif /* DOC_HIDDEN */
 
 static void snd_pcm_route_convert(const snd_pcm_channel_area_t *dst_areas,
@@ -405,12 +795,21 @@ static void snd_pcm_route_convert(const snd_pcm_channel_area_t *dst_areas,
 				  unsigned int src_channels,
 				  unsigned int dst_channels,
 				  snd_pcm_uframes_t frames,
-				  snd_pcm_route_params_t *params)
+				  snd_pcm_route_params_t *params,
+				  snd_pcm_softvol_gain_t *gain)
 {
 	unsigned int dst_channel;
 	snd_pcm_route_ttable_dst_t *dstp;
 	const snd_pcm_channel_area_t *dst_area;
 
+	if (gain)
+		snd_pcm_softvol_gain_scales(gain, params->gain, dst_channels);
+	if (snd_pcm_route_convert_plan(dst_areas, dst_offset,
+				       src_areas, src_offset,
+				       src_channels, dst_channels,
+				       frames, params))
+		return;
+
 	dstp = params->dsts;
 	dst_area = dst_areas;
 	for (dst_channel = 0; dst_channel < dst_channels; ++dst_channel) {
@@ -441,6 +840,8 @@ static int snd_pcm_route_close(snd_pcm_t *pcm)
 		}
 		free(params->dsts);
 	}
+	snd_pcm_route_plan_free(params);
+	free(params->gain);
 	free(route->chmap);
 	snd_pcm_free_chmaps(route->chmap_override);
 	return snd_pcm_generic_close(pcm);
@@ -545,11 +946,31 @@ static int snd_pcm_route_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 				       snd_pcm_generic_hw_refine);
 }
 
+/* every destination takes exactly its own source channel at unity gain */
+static int snd_pcm_route_is_identity(const snd_pcm_route_params_t *params,
+				     unsigned int channels,
+				     unsigned int schannels)
+{
+	unsigned int dst;
+
+	if (channels != schannels ||
+	    params->nsrcs != channels ||
+	    params->ndsts != channels)
+		return 0;
+	for (dst = 0; dst < params->ndsts; dst++) {
+		const snd_pcm_route_ttable_dst_t *d = &params->dsts[dst];
+		if (d->att || d->nsrcs != 1 || d->srcs[0].channel != (int)dst)
+			return 0;
+	}
+	return 1;
+}
+
 static int snd_pcm_route_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 {
 	snd_pcm_route_t *route = pcm->private_data;
 	snd_pcm_t *slave = route->plug.gen.slave;
 	snd_pcm_format_t src_format, dst_format;
+	unsigned int channels;
 	int err = snd_pcm_hw_params_slave(pcm, params,
 					  snd_pcm_route_hw_refine_cchange,
 					  snd_pcm_route_hw_refine_sprepare,
@@ -583,6 +1004,31 @@ static int snd_pcm_route_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 #else
 	route->params.sum_idx = UINT64;
 #endif
+	err = INTERNAL(snd_pcm_hw_params_get_channels)(params, &channels);
+	if (err < 0)
+		return err;
+	free(route->params.gain);
+	route->params.gain = NULL;
+	if (route->gain) {
+		route->params.gain = calloc(pcm->stream == SND_PCM_STREAM_PLAYBACK ?
+					    slave->channels : channels,
+					    sizeof(*route->params.gain));
+		if (!route->params.gain)
+			return -ENOMEM;
+	}
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
+		err = snd_pcm_route_plan_compile(&route->params, src_format,
+						 dst_format, channels,
+						 slave->channels);
+	else
+		err = snd_pcm_route_plan_compile(&route->params, src_format,
+						 dst_format, slave->channels,
+						 channels);
+	if (err < 0)
+		return err;
+	route->plug.passthrough = src_format == dst_format && !route->gain &&
+		snd_pcm_route_is_identity(&route->params, channels,
+					  slave->channels);
 	return 0;
 }
 
@@ -603,7 +1049,7 @@ snd_pcm_route_write_areas(snd_pcm_t *pcm,
 			      areas, offset, 
 			      pcm->channels,
 			      slave->channels,
-			      size, &route->params);
+			      size, &route->params, route->gain);
 	*slave_sizep = size;
 	return size;
 }
@@ -625,7 +1071,7 @@ snd_pcm_route_read_areas(snd_pcm_t *pcm,
 			      slave_areas, slave_offset,
 			      slave->channels,
 			      pcm->channels,
-			      size, &route->params);
+			      size, &route->params, route->gain);
 	*slave_sizep = size;
 	return size;
 }
@@ -716,10 +1162,13 @@ static void snd_pcm_route_dump(snd_pcm_t *pcm, snd_output_t *out)
 		}
 		snd_output_putc(out, '\n');
 	}
+	if (route->gain)
+		snd_pcm_softvol_gain_dump(route->gain, out);
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
 	}
+	snd_pcm_plugin_dump_profile(pcm, out);
 	snd_output_printf(out, "Slave: ");
 	snd_pcm_dump(route->plug.gen.slave, out);
 }
@@ -1065,6 +1514,23 @@ int snd_pcm_route_open(snd_pcm_t **pcmp, const char *name,
 	return 0;
 }
 
+#ifndef DOC_HIDDEN
+/*
+ * Makes the route stage apply the soft volume of the plug plugin to its
+ * destination channels; to be called before hw_params.
+ */
+int snd_pcm_route_set_gain(snd_pcm_t *pcm, snd_pcm_softvol_gain_t *gain)
+{
+	snd_pcm_route_t *route;
+
+	if (pcm->type != SND_PCM_TYPE_ROUTE)
+		return -EINVAL;
+	route = pcm->private_data;
+	route->gain = gain;
+	return 0;
+}
+#endif
+
 static int _snd_pcm_route_determine_ttable(snd_config_t *tt,
 					   unsigned int *tt_csize,
 					   unsigned int *tt_ssize,
@@ -88,6 +88,7 @@ typedef struct {
 	snd_pcm_uframes_t silence_frames;
 	snd_pcm_sw_params_t sw_params;
 	snd_pcm_uframes_t hw_ptr;
+	int dirty;			/* clients have deferred commits */
 	int poll[2];
 	int polling;
 	pthread_t thread;
@@ -107,8 +108,9 @@ typedef struct {
 	int drain_silenced;
 	snd_htimestamp_t trigger_tstamp;
 	snd_pcm_state_t state;
-	snd_pcm_uframes_t hw_ptr;
+	snd_pcm_uframes_t hw_ptr;	/* see _snd_pcm_share_avail() */
 	snd_pcm_uframes_t appl_ptr;
+	snd_pcm_uframes_t deferred;	/* committed, not yet passed to the slave */
 	int ready;
 	int client_socket;
 	int slave_socket;
@@ -117,6 +119,26 @@ typedef struct {
 #endif /* DOC_HIDDEN */
 
 static void _snd_pcm_share_stop(snd_pcm_t *pcm, snd_pcm_state_t state);
+static void _snd_pcm_share_run_deferred(snd_pcm_share_slave_t *slave);
+static void snd_pcm_share_slave_unlock(snd_pcm_share_slave_t *slave);
+
+/*
+ * A client moves its hw_ptr and appl_ptr without the slave mutex when
+ * another one holds it (see snd_pcm_share_avail_update() and
+ * snd_pcm_share_mmap_commit()), so the holder reads the pointers of the
+ * clients with atomic loads.
+ */
+static snd_pcm_uframes_t _snd_pcm_share_appl_ptr(snd_pcm_share_t *share)
+{
+	return __atomic_load_n(&share->appl_ptr, __ATOMIC_ACQUIRE);
+}
+
+static snd_pcm_uframes_t _snd_pcm_share_avail(snd_pcm_t *pcm)
+{
+	snd_pcm_share_t *share = pcm->private_data;
+	return __snd_pcm_avail(pcm, __atomic_load_n(&share->hw_ptr, __ATOMIC_ACQUIRE),
+			       _snd_pcm_share_appl_ptr(share));
+}
 
 static snd_pcm_uframes_t snd_pcm_share_slave_avail(snd_pcm_share_slave_t *slave)
 {
@@ -159,7 +181,7 @@ static snd_pcm_uframes_t _snd_pcm_share_slave_forward(snd_pcm_share_slave_t *sla
 		default:
 			continue;
 		}
-		avail = snd_pcm_mmap_avail(pcm);
+		avail = _snd_pcm_share_avail(pcm);
 		frames = slave_avail - avail;
 		if (frames > max_frames)
 			max_frames = frames;
@@ -217,8 +239,8 @@ static snd_pcm_uframes_t _snd_pcm_share_missing(snd_pcm_t *pcm)
 	default:
 		return INT_MAX;
 	}
-	share->hw_ptr = slave->hw_ptr;
-	avail = snd_pcm_mmap_avail(pcm);
+	__atomic_store_n(&share->hw_ptr, slave->hw_ptr, __ATOMIC_RELEASE);
+	avail = _snd_pcm_share_avail(pcm);
 	if (avail >= pcm->stop_threshold) {
 		_snd_pcm_share_stop(pcm, share->state == SND_PCM_STATE_DRAINING ? SND_PCM_STATE_SETUP : SND_PCM_STATE_XRUN);
 		goto update_poll;
@@ -317,7 +339,7 @@ static snd_pcm_uframes_t _snd_pcm_share_missing(snd_pcm_t *pcm)
 	    !share->drain_silenced) {
 		/* drain silencing */
 		if (avail >= slave->silence_frames) {
-			snd_pcm_uframes_t offset = share->appl_ptr % buffer_size;
+			snd_pcm_uframes_t offset = _snd_pcm_share_appl_ptr(share) % buffer_size;
 			snd_pcm_uframes_t xfer = 0;
 			snd_pcm_uframes_t size = slave->silence_frames;
 			while (xfer < size) {
@@ -348,7 +370,7 @@ static snd_pcm_uframes_t _snd_pcm_share_slave_missing(snd_pcm_share_slave_t *sla
 	snd_pcm_uframes_t missing = INT_MAX;
 	struct list_head *i;
 	/* snd_pcm_sframes_t avail = */ snd_pcm_avail_update(slave->pcm);
-	slave->hw_ptr = *slave->pcm->hw.ptr;
+	__atomic_store_n(&slave->hw_ptr, *slave->pcm->hw.ptr, __ATOMIC_RELEASE);
 	list_for_each(i, &slave->clients) {
 		snd_pcm_share_t *share = list_entry(i, snd_pcm_share_t, list);
 		snd_pcm_t *pcm = share->pcm;
@@ -409,7 +431,7 @@ static void *snd_pcm_share_thread(void *data)
 				}
 			}
 			slave->polling = 1;
-			Pthread_mutex_unlock(&slave->mutex);
+			snd_pcm_share_slave_unlock(slave);
 			err = poll(pfd, 2, -1);
 			Pthread_mutex_lock(&slave->mutex);
 			if (pfd[0].revents & POLLIN) {
@@ -418,6 +440,7 @@ static void *snd_pcm_share_thread(void *data)
 			}
 		} else {
 			slave->polling = 0;
+			_snd_pcm_share_run_deferred(slave);
 			pthread_cond_wait(&slave->poll_cond, &slave->mutex);
 		}
 	}
@@ -432,7 +455,7 @@ static void _snd_pcm_share_update(snd_pcm_t *pcm)
 	snd_pcm_t *spcm = slave->pcm;
 	snd_pcm_uframes_t missing;
 	/* snd_pcm_sframes_t avail = */ snd_pcm_avail_update(spcm);
-	slave->hw_ptr = *slave->pcm->hw.ptr;
+	__atomic_store_n(&slave->hw_ptr, *slave->pcm->hw.ptr, __ATOMIC_RELEASE);
 	missing = _snd_pcm_share_missing(pcm);
 	// printf("missing %ld\n", missing);
 	if (!slave->polling) {
@@ -672,7 +695,7 @@ static int snd_pcm_share_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	share->state = SND_PCM_STATE_SETUP;
 	slave->setup_count++;
  _end:
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
 	return err;
 }
 
@@ -686,7 +709,7 @@ static int snd_pcm_share_hw_free(snd_pcm_t *pcm)
 	if (slave->setup_count == 0)
 		err = snd_pcm_hw_free(slave->pcm);
 	share->state = SND_PCM_STATE_OPEN;
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
 	return err;
 }
 
@@ -724,7 +747,7 @@ static int snd_pcm_share_status(snd_pcm_t *pcm, snd_pcm_status_t *status)
 	status->hw_ptr = *pcm->hw.ptr;
 	status->trigger_tstamp = share->trigger_tstamp;
  _end:
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
 	return err;
 }
 
@@ -754,7 +777,7 @@ static int snd_pcm_share_hwsync(snd_pcm_t *pcm)
 	int err;
 	Pthread_mutex_lock(&slave->mutex);
 	err = _snd_pcm_share_hwsync(pcm);
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
 	return err;
 }
 
@@ -784,7 +807,7 @@ static int snd_pcm_share_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
 	int err;
 	Pthread_mutex_lock(&slave->mutex);
 	err = _snd_pcm_share_delay(pcm, delayp);
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
 	return err;
 }
 
@@ -793,16 +816,25 @@ static snd_pcm_sframes_t snd_pcm_share_avail_update(snd_pcm_t *pcm)
 	snd_pcm_share_t *share = pcm->private_data;
 	snd_pcm_share_slave_t *slave = share->slave;
 	snd_pcm_sframes_t avail;
-	Pthread_mutex_lock(&slave->mutex);
+	if (pthread_mutex_trylock(&slave->mutex) != 0) {
+		/* take the position the holder of the mutex has published */
+		if (__atomic_load_n(&share->state, __ATOMIC_ACQUIRE) == SND_PCM_STATE_RUNNING)
+			__atomic_store_n(&share->hw_ptr,
+					 __atomic_load_n(&slave->hw_ptr, __ATOMIC_ACQUIRE),
+					 __ATOMIC_RELEASE);
+		goto _avail;
+	}
 	if (share->state == SND_PCM_STATE_RUNNING) {
 		avail = snd_pcm_avail_update(slave->pcm);
 		if (avail < 0) {
-			Pthread_mutex_unlock(&slave->mutex);
+			snd_pcm_share_slave_unlock(slave);
 			return avail;
 		}
 		share->hw_ptr = *slave->pcm->hw.ptr;
+		__atomic_store_n(&slave->hw_ptr, share->hw_ptr, __ATOMIC_RELEASE);
 	}
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
+ _avail:
 	avail = snd_pcm_mmap_avail(pcm);
 	if ((snd_pcm_uframes_t)avail > pcm->buffer_size)
 		return -EPIPE;
@@ -817,23 +849,24 @@ static int snd_pcm_share_htimestamp(snd_pcm_t *pcm, snd_pcm_uframes_t *avail,
 	int err;
 	Pthread_mutex_lock(&slave->mutex);
 	err = snd_pcm_htimestamp(slave->pcm, avail, tstamp);
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
 	return err;
 }
 
-/* Call it with mutex held */
-static snd_pcm_sframes_t _snd_pcm_share_mmap_commit(snd_pcm_t *pcm,
-						    snd_pcm_uframes_t offset ATTRIBUTE_UNUSED,
-						    snd_pcm_uframes_t size)
+/*
+ * Call it with mutex held.
+ * Rewinds the slave back to the client position appl_ptr when the client
+ * came late and the slave is already ahead of it.
+ */
+static int _snd_pcm_share_latecomer(snd_pcm_t *pcm, snd_pcm_uframes_t appl_ptr)
 {
 	snd_pcm_share_t *share = pcm->private_data;
-	snd_pcm_share_slave_t *slave = share->slave;
-	snd_pcm_t *spcm = slave->pcm;
+	snd_pcm_t *spcm = share->slave->pcm;
 	snd_pcm_sframes_t ret;
 	snd_pcm_sframes_t frames;
 	if (pcm->stream == SND_PCM_STREAM_PLAYBACK &&
 	    share->state == SND_PCM_STATE_RUNNING) {
-		frames = *spcm->appl.ptr - share->appl_ptr;
+		frames = *spcm->appl.ptr - appl_ptr;
 		if (frames > (snd_pcm_sframes_t)pcm->buffer_size)
 			frames -= pcm->boundary;
 		else if (frames < -(snd_pcm_sframes_t)pcm->buffer_size)
@@ -845,7 +878,16 @@ static snd_pcm_sframes_t _snd_pcm_share_mmap_commit(snd_pcm_t *pcm,
 				return ret;
 		}
 	}
-	snd_pcm_mmap_appl_forward(pcm, size);
+	return 0;
+}
+
+/* Call it with mutex held: commits the slave after the client has moved */
+static int _snd_pcm_share_slave_commit(snd_pcm_t *pcm)
+{
+	snd_pcm_share_t *share = pcm->private_data;
+	snd_pcm_share_slave_t *slave = share->slave;
+	snd_pcm_t *spcm = slave->pcm;
+	snd_pcm_sframes_t frames;
 	if (share->state == SND_PCM_STATE_RUNNING) {
 		frames = _snd_pcm_share_slave_forward(slave);
 		if (frames > 0) {
@@ -862,19 +904,96 @@ static snd_pcm_sframes_t _snd_pcm_share_mmap_commit(snd_pcm_t *pcm,
 		}
 		_snd_pcm_share_update(pcm);
 	}
+	return 0;
+}
+
+/* Call it with mutex held */
+static snd_pcm_sframes_t _snd_pcm_share_mmap_commit(snd_pcm_t *pcm,
+						    snd_pcm_uframes_t offset ATTRIBUTE_UNUSED,
+						    snd_pcm_uframes_t size)
+{
+	snd_pcm_share_t *share = pcm->private_data;
+	int err;
+
+	err = _snd_pcm_share_latecomer(pcm, share->appl_ptr);
+	if (err < 0)
+		return err;
+	snd_pcm_mmap_appl_forward(pcm, size);
+	err = _snd_pcm_share_slave_commit(pcm);
+	if (err < 0)
+		return err;
 	return size;
 }
 
+/* Call it with mutex held: passes on what the clients committed meanwhile */
+static void _snd_pcm_share_run_deferred(snd_pcm_share_slave_t *slave)
+{
+	struct list_head *i;
+
+	while (__atomic_exchange_n(&slave->dirty, 0, __ATOMIC_ACQ_REL)) {
+		list_for_each(i, &slave->clients) {
+			snd_pcm_share_t *share = list_entry(i, snd_pcm_share_t, list);
+			snd_pcm_uframes_t frames;
+			frames = __atomic_exchange_n(&share->deferred, 0, __ATOMIC_ACQ_REL);
+			if (!frames)
+				continue;
+			/*
+			 * the slave may have been committed up to the new
+			 * position already, so compare with that one
+			 */
+			if (_snd_pcm_share_latecomer(share->pcm,
+						     _snd_pcm_share_appl_ptr(share)) >= 0)
+				_snd_pcm_share_slave_commit(share->pcm);
+		}
+	}
+}
+
+/*
+ * Drops the slave mutex.  Commits deferred while it was held are run
+ * first; one arriving right before the unlock is picked up by retrying.
+ */
+static void snd_pcm_share_slave_unlock(snd_pcm_share_slave_t *slave)
+{
+	for (;;) {
+		_snd_pcm_share_run_deferred(slave);
+		Pthread_mutex_unlock(&slave->mutex);
+		if (!__atomic_load_n(&slave->dirty, __ATOMIC_ACQUIRE) ||
+		    pthread_mutex_trylock(&slave->mutex) != 0)
+			break;
+	}
+}
+
+/*
+ * With the slave mutex taken by the thread or another client, a running
+ * client does not wait: it publishes its new appl_ptr and leaves the
+ * slave commit to the holder of the mutex.
+ */
 static snd_pcm_sframes_t snd_pcm_share_mmap_commit(snd_pcm_t *pcm,
 						   snd_pcm_uframes_t offset,
 						   snd_pcm_uframes_t size)
 {
 	snd_pcm_share_t *share = pcm->private_data;
 	snd_pcm_share_slave_t *slave = share->slave;
+	snd_pcm_uframes_t appl_ptr;
 	snd_pcm_sframes_t ret;
-	Pthread_mutex_lock(&slave->mutex);
+
+	if (pthread_mutex_trylock(&slave->mutex) != 0) {
+		if (__atomic_load_n(&share->state, __ATOMIC_ACQUIRE) == SND_PCM_STATE_RUNNING) {
+			appl_ptr = share->appl_ptr + size;
+			if (appl_ptr >= pcm->boundary)
+				appl_ptr -= pcm->boundary;
+			__atomic_store_n(&share->appl_ptr, appl_ptr, __ATOMIC_RELEASE);
+			__atomic_add_fetch(&share->deferred, size, __ATOMIC_RELEASE);
+			__atomic_store_n(&slave->dirty, 1, __ATOMIC_RELEASE);
+			/* the holder may have been leaving already */
+			if (pthread_mutex_trylock(&slave->mutex) == 0)
+				snd_pcm_share_slave_unlock(slave);
+			return size;
+		}
+		Pthread_mutex_lock(&slave->mutex);
+	}
 	ret = _snd_pcm_share_mmap_commit(pcm, offset, size);
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
 	return ret;
 }
 
@@ -907,7 +1026,7 @@ static int snd_pcm_share_prepare(snd_pcm_t *pcm)
 	share->appl_ptr = 0;
 	share->state = SND_PCM_STATE_PREPARED;
  _end:
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
 	return err;
 }
 
@@ -921,7 +1040,7 @@ static int snd_pcm_share_reset(snd_pcm_t *pcm)
 	snd_pcm_areas_silence(pcm->running_areas, 0, pcm->channels, pcm->buffer_size, pcm->format);
 	share->hw_ptr = *slave->pcm->hw.ptr;
 	share->appl_ptr = share->hw_ptr;
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
 	return err;
 }
 
@@ -987,7 +1106,7 @@ static int snd_pcm_share_start(snd_pcm_t *pcm)
 	_snd_pcm_share_update(pcm);
 	gettimestamp(&share->trigger_tstamp, pcm->tstamp_type);
  _end:
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
 	return err;
 }
 
@@ -1057,7 +1176,7 @@ static snd_pcm_sframes_t snd_pcm_share_rewindable(snd_pcm_t *pcm)
 	snd_pcm_sframes_t ret;
 	Pthread_mutex_lock(&slave->mutex);
 	ret = snd_pcm_rewindable(slave->pcm);
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
 	return ret;
 }
 
@@ -1068,7 +1187,7 @@ static snd_pcm_sframes_t snd_pcm_share_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t
 	snd_pcm_sframes_t ret;
 	Pthread_mutex_lock(&slave->mutex);
 	ret = _snd_pcm_share_rewind(pcm, frames);
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
 	return ret;
 }
 
@@ -1114,7 +1233,7 @@ static snd_pcm_sframes_t snd_pcm_share_forwardable(snd_pcm_t *pcm)
 	snd_pcm_sframes_t ret;
 	Pthread_mutex_lock(&slave->mutex);
 	ret = snd_pcm_forwardable(slave->pcm);
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
 	return ret;
 }
 
@@ -1125,7 +1244,7 @@ static snd_pcm_sframes_t snd_pcm_share_forward(snd_pcm_t *pcm, snd_pcm_uframes_t
 	snd_pcm_sframes_t ret;
 	Pthread_mutex_lock(&slave->mutex);
 	ret = _snd_pcm_share_forward(pcm, frames);
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
 	return ret;
 }
 
@@ -1192,7 +1311,7 @@ static int snd_pcm_share_drain(snd_pcm_t *pcm)
 		case SND_PCM_STATE_RUNNING:
 			share->state = SND_PCM_STATE_DRAINING;
 			_snd_pcm_share_update(pcm);
-			Pthread_mutex_unlock(&slave->mutex);
+			snd_pcm_share_slave_unlock(slave);
 			if (!(pcm->mode & SND_PCM_NONBLOCK))
 				snd_pcm_wait(pcm, -1);
 			return 0;
@@ -1219,7 +1338,7 @@ static int snd_pcm_share_drain(snd_pcm_t *pcm)
 		}
 	}
  _end:
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
 	return err;
 }
 
@@ -1256,7 +1375,7 @@ static int snd_pcm_share_drop(snd_pcm_t *pcm)
 	
 	share->appl_ptr = share->hw_ptr = 0;
  _end:
-	Pthread_mutex_unlock(&slave->mutex);
+	snd_pcm_share_slave_unlock(slave);
 	return err;
 }
 
@@ -1282,7 +1401,7 @@ static int snd_pcm_share_close(snd_pcm_t *pcm)
 		list_del(&share->list);
 	} else {
 		list_del(&share->list);
-		Pthread_mutex_unlock(&slave->mutex);
+		snd_pcm_share_slave_unlock(slave);
 	}
 	Pthread_mutex_unlock(&snd_pcm_share_slaves_mutex);
 	close(share->client_socket);
@@ -1506,7 +1625,7 @@ int snd_pcm_share_open(snd_pcm_t **pcmp, const char *name, const char *sname,
 		pthread_cond_init(&slave->poll_cond, NULL);
 		list_add_tail(&slave->list, &snd_pcm_share_slaves);
 		Pthread_mutex_lock(&slave->mutex);
-		err = pthread_create(&slave->thread, NULL, snd_pcm_share_thread, slave);
+		err = snd_thread_create(&slave->thread, "pcm_share", snd_pcm_share_thread, slave);
 		assert(err == 0);
 		Pthread_mutex_unlock(&snd_pcm_share_slaves_mutex);
 	} else {
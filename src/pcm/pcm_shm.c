@@ -54,9 +54,51 @@ const char *_snd_module_pcm_shm = "";
 typedef struct {
 	int socket;
 	volatile snd_pcm_shm_ctrl_t *ctrl;
+	volatile snd_pcm_uframes_t *appl_ptr;	/* shared with the server */
+	snd_pcm_uframes_t appl_shadow;		/* including queued commits */
+	int direct;				/* read state and avail from shm */
 } snd_pcm_shm_t;
 #endif
 
+/*
+ * With the command ring the application pointer seen by the client runs
+ * ahead of the shared one by the queued commits, so the client keeps its
+ * own copy and resynchronizes it after every synchronous command.
+ */
+static void snd_pcm_shm_set_appl_ptr(snd_pcm_t *pcm, snd_pcm_shm_t *shm,
+				     volatile snd_pcm_uframes_t *ptr,
+				     int fd, off_t offset)
+{
+	shm->appl_ptr = ptr;
+	if (!shm->ctrl->ring.enabled) {
+		snd_pcm_set_appl_ptr(pcm, ptr, fd, offset);
+		return;
+	}
+	shm->appl_shadow = *ptr;
+	snd_pcm_set_appl_ptr(pcm, &shm->appl_shadow, -1, 0);
+}
+
+static inline void snd_pcm_shm_sync_appl_ptr(snd_pcm_shm_t *shm)
+{
+	if (shm->appl_ptr && shm->ctrl->ring.enabled)
+		shm->appl_shadow = *shm->appl_ptr;
+}
+
+/*
+ * In the direct mode the state published by the server is used as long
+ * as it was taken after all queued commits were executed.
+ */
+static int snd_pcm_shm_direct_state(snd_pcm_shm_t *shm, snd_pcm_state_t *state)
+{
+	volatile snd_pcm_shm_ring_t *ring = &shm->ctrl->ring;
+
+	if (!shm->direct || !ring->enabled || ring->state_tail != ring->head)
+		return 0;
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	*state = ring->state;
+	return 1;
+}
+
 static long snd_pcm_shm_action_fd0(snd_pcm_t *pcm, int *fd)
 {
 	snd_pcm_shm_t *shm = pcm->private_data;
@@ -84,7 +126,7 @@ static int snd_pcm_shm_new_rbptr(snd_pcm_t *pcm, snd_pcm_shm_t *shm,
 		if (&pcm->hw == rbptr)
 			snd_pcm_set_hw_ptr(pcm, &shm_rbptr->ptr, -1, 0);
 		else
-			snd_pcm_set_appl_ptr(pcm, &shm_rbptr->ptr, -1, 0);
+			snd_pcm_shm_set_appl_ptr(pcm, shm, &shm_rbptr->ptr, -1, 0);
 	} else {
 		void *ptr;
 		size_t mmap_size, mmap_offset, offset;
@@ -104,7 +146,7 @@ static int snd_pcm_shm_new_rbptr(snd_pcm_t *pcm, snd_pcm_shm_t *shm,
 		if (&pcm->hw == rbptr)
 			snd_pcm_set_hw_ptr(pcm, (snd_pcm_uframes_t *)((char *)ptr + offset), fd, shm_rbptr->offset);
 		else
-			snd_pcm_set_appl_ptr(pcm, (snd_pcm_uframes_t *)((char *)ptr + offset), fd, shm_rbptr->offset);
+			snd_pcm_shm_set_appl_ptr(pcm, shm, (snd_pcm_uframes_t *)((char *)ptr + offset), fd, shm_rbptr->offset);
 	}
 	return 0;
 }
@@ -141,6 +183,7 @@ static long snd_pcm_shm_action(snd_pcm_t *pcm)
 			return err;
 		ctrl->appl.changed = 0;
 	}
+	snd_pcm_shm_sync_appl_ptr(shm);
 	return result;
 }
 
@@ -175,6 +218,7 @@ static long snd_pcm_shm_action_fd(snd_pcm_t *pcm, int *fd)
 			return err;
 		ctrl->appl.changed = 0;
 	}
+	snd_pcm_shm_sync_appl_ptr(shm);
 	return ctrl->result;
 }
 
@@ -404,6 +448,9 @@ static snd_pcm_state_t snd_pcm_shm_state(snd_pcm_t *pcm)
 {
 	snd_pcm_shm_t *shm = pcm->private_data;
 	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
+	snd_pcm_state_t state;
+	if (snd_pcm_shm_direct_state(shm, &state))
+		return state;
 	ctrl->cmd = SND_PCM_IOCTL_STATE;
 	return snd_pcm_shm_action(pcm);
 }
@@ -433,7 +480,20 @@ static snd_pcm_sframes_t snd_pcm_shm_avail_update(snd_pcm_t *pcm)
 {
 	snd_pcm_shm_t *shm = pcm->private_data;
 	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
+	snd_pcm_state_t state;
+	snd_pcm_uframes_t avail;
 	int err;
+	/*
+	 * The pointers only move forward behind our back, so the local avail
+	 * is a lower bound; ask the server only when it is not enough.
+	 */
+	if (snd_pcm_shm_direct_state(shm, &state) &&
+	    (state == SND_PCM_STATE_RUNNING ||
+	     state == SND_PCM_STATE_PREPARED)) {
+		avail = snd_pcm_mmap_avail(pcm);
+		if (avail >= pcm->avail_min && avail <= pcm->buffer_size)
+			return avail;
+	}
 	ctrl->cmd = SND_PCM_IOCTL_AVAIL_UPDATE;
 	err = snd_pcm_shm_action(pcm);
 	if (err < 0)
@@ -545,11 +605,37 @@ static int snd_pcm_shm_resume(snd_pcm_t *pcm)
 }
 
 static snd_pcm_sframes_t snd_pcm_shm_mmap_commit(snd_pcm_t *pcm,
-						 snd_pcm_uframes_t offset ATTRIBUTE_UNUSED,
+						 snd_pcm_uframes_t offset,
 						 snd_pcm_uframes_t size)
 {
 	snd_pcm_shm_t *shm = pcm->private_data;
 	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
+	volatile snd_pcm_shm_ring_t *ring = &ctrl->ring;
+	char buf[1] = { SND_PCM_SHM_RING_KICK };
+	unsigned int head;
+	long err;
+
+	if (ring->enabled) {
+		err = ring->error;
+		if (err < 0) {
+			ring->error = 0;
+			return err;
+		}
+		head = ring->head;
+		if (head - ring->tail < PCM_SHM_RING_SIZE) {
+			ring->cmd[head % PCM_SHM_RING_SIZE].offset = offset;
+			ring->cmd[head % PCM_SHM_RING_SIZE].frames = size;
+			__atomic_thread_fence(__ATOMIC_SEQ_CST);
+			ring->head = head + 1;
+			__atomic_thread_fence(__ATOMIC_SEQ_CST);
+			snd_pcm_mmap_appl_forward(pcm, size);
+			/* kick the server only when it may have gone idle */
+			if (ring->tail == head && write(shm->socket, buf, 1) != 1)
+				return -EBADFD;
+			return size;
+		}
+		/* the ring is full, the synchronous commit drains it */
+	}
 	ctrl->cmd = SND_PCM_IOCTL_MMAP_COMMIT;
 	ctrl->u.mmap_commit.offset = offset;
 	ctrl->u.mmap_commit.frames = size;
@@ -584,7 +670,11 @@ static int snd_pcm_shm_close(snd_pcm_t *pcm)
 
 static void snd_pcm_shm_dump(snd_pcm_t *pcm, snd_output_t *out)
 {
+	snd_pcm_shm_t *shm = pcm->private_data;
 	snd_output_printf(out, "Shm PCM\n");
+	snd_output_printf(out, "  command ring: %s, direct: %s\n",
+			  shm->ctrl->ring.enabled ? "yes" : "no",
+			  shm->direct ? "yes" : "no");
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
@@ -758,7 +848,7 @@ int snd_pcm_shm_open(snd_pcm_t **pcmp, const char *name,
 	pcm->poll_fd = err;
 	pcm->poll_events = stream == SND_PCM_STREAM_PLAYBACK ? POLLOUT : POLLIN;
 	snd_pcm_set_hw_ptr(pcm, &ctrl->hw.ptr, -1, 0);
-	snd_pcm_set_appl_ptr(pcm, &ctrl->appl.ptr, -1, 0);
+	snd_pcm_shm_set_appl_ptr(pcm, shm, &ctrl->appl.ptr, -1, 0);
 	*pcmp = pcm;
 	return 0;
 
@@ -783,9 +873,26 @@ pcm.name {
         type shm                # Shared memory PCM
 	server STR		# Server name
 	pcm STR			# PCM name
+	[direct BOOL]		# Read state and avail from the shared area
+	[nodelay BOOL]		# TCP_NODELAY for the TCP transport (default yes)
 }
 \endcode
 
+When the server definition has a \c port (and an optional \c host,
+"localhost" by default) but no \c socket, the TCP transport is used:
+the ring buffer is kept in the client, the frames are streamed to or
+from aserver in blocks of a period, and the hardware pointer follows the
+updates the server pushes as the slave PCM progresses, so only the
+state changing operations wait for the server. Rewinding is not
+supported with this transport.
+
+Commits are queued in a command ring in the shared area when the server
+supports it, so they do not wait for the server. With \c direct enabled
+the state and the available frames are also taken from the shared area
+and the server is asked only when the local view does not allow the
+application to proceed; the state may then lag behind the server by the
+commits it has not executed yet.
+
 \subsection pcm_plugins_shm_funcref Function reference
 
 <UL>
@@ -816,7 +923,10 @@ int _snd_pcm_shm_open(snd_pcm_t **pcmp, const char *name,
 	const char *pcm_name = NULL;
 	snd_config_t *sconfig;
 	const char *sockname = NULL;
+	const char *host = NULL;
 	long port = -1;
+	int direct = 0;
+	int nodelay = 1;
 	int err;
 
 	snd_config_for_each(i, next, conf) {
@@ -842,6 +952,20 @@ int _snd_pcm_shm_open(snd_pcm_t **pcmp, const char *name,
 			}
 			continue;
 		}
+		if (strcmp(id, "direct") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			direct = err;
+			continue;
+		}
+		if (strcmp(id, "nodelay") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			nodelay = err;
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -869,8 +993,14 @@ int _snd_pcm_shm_open(snd_pcm_t **pcmp, const char *name,
 			continue;
 		if (strcmp(id, "comment") == 0)
 			continue;
-		if (strcmp(id, "host") == 0)
+		if (strcmp(id, "host") == 0) {
+			err = snd_config_get_string(n, &host);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				goto _err;
+			}
 			continue;
+		}
 		if (strcmp(id, "socket") == 0) {
 			err = snd_config_get_string(n, &sockname);
 			if (err < 0) {
@@ -893,11 +1023,18 @@ int _snd_pcm_shm_open(snd_pcm_t **pcmp, const char *name,
 		goto __error;
 	}
 
+	if (!sockname && port >= 0) {
+		err = snd_pcm_shm_tcp_open(pcmp, name, host ? host : "localhost",
+					   port, pcm_name, stream, mode, nodelay);
+		goto __error;
+	}
 	if (!sockname) {
 		SNDERR("socket is not defined");
 		goto _err;
 	}
 	err = snd_pcm_shm_open(pcmp, name, sockname, pcm_name, stream, mode);
+	if (err >= 0)
+		((snd_pcm_shm_t *)(*pcmp)->private_data)->direct = direct;
       __error:
 	snd_config_delete(sconfig);
 	return err;
@@ -0,0 +1,798 @@
+/**
+ * \file pcm/pcm_shm_tcp.c
+ * \ingroup PCM_Plugins
+ * \brief PCM Shared Memory Plugin Interface - TCP transport
+ */
+/*
+ *  PCM - Shared Memory Client over TCP
+ *
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include "aserver.h"
+
+#ifndef DOC_HIDDEN
+/*
+ * The ring buffer lives in the client. The pointers are local too: the
+ * application pointer is sent to the server in blocks of a period (with
+ * the frames for playback) and the hardware pointer follows the updates
+ * the server pushes on the second connection (with the frames for
+ * capture). Updates from before the last pointer reset (epoch) are
+ * dropped, the state of updates sent before the answer to the last
+ * command (seq) is stale and ignored.
+ */
+typedef struct {
+	int ctrl_fd;			/* commands and playback frames */
+	int poll_fd;			/* pointer updates and capture frames */
+	snd_pcm_shm_ctrl_t ctrl;	/* command arguments and results */
+	snd_pcm_uframes_t hw_ptr;
+	snd_pcm_uframes_t appl_ptr;
+	snd_pcm_uframes_t appl_sent;	/* appl_ptr known to the server */
+	snd_pcm_state_t state;
+	unsigned int epoch;
+	unsigned int seq;
+	char *buf;			/* interleaved frames on the wire */
+	size_t buf_size;
+	int nodelay;
+} snd_pcm_shm_tcp_t;
+#endif
+
+static int tcp_read_full(int fd, void *buf, size_t len)
+{
+	char *p = buf;
+	ssize_t n;
+
+	while (len > 0) {
+		n = read(fd, p, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -EBADFD;
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int tcp_send(int fd, snd_pcm_tcp_msg_t *msg, const void *data)
+{
+	struct iovec iov[2];
+	int cnt = 1;
+	ssize_t n;
+
+	iov[0].iov_base = msg;
+	iov[0].iov_len = sizeof(*msg);
+	if (msg->len) {
+		iov[1].iov_base = (void *)data;
+		iov[1].iov_len = msg->len;
+		cnt = 2;
+	}
+	while (cnt > 0) {
+		n = writev(fd, iov, cnt);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -EBADFD;
+		while (cnt > 0 && (size_t) n >= iov[0].iov_len) {
+			n -= iov[0].iov_len;
+			iov[0] = iov[1];
+			cnt--;
+		}
+		if (cnt > 0) {
+			iov[0].iov_base = (char *)iov[0].iov_base + n;
+			iov[0].iov_len -= n;
+		}
+	}
+	return 0;
+}
+
+/* the interleaved layout of the wire buffer */
+static void snd_pcm_shm_tcp_wire_areas(snd_pcm_t *pcm, snd_pcm_shm_tcp_t *tcp,
+				       snd_pcm_channel_area_t *areas)
+{
+	unsigned int ch;
+
+	for (ch = 0; ch < pcm->channels; ch++) {
+		areas[ch].addr = tcp->buf;
+		areas[ch].first = ch * pcm->sample_bits;
+		areas[ch].step = pcm->frame_bits;
+	}
+}
+
+static snd_pcm_uframes_t snd_pcm_shm_tcp_pending(snd_pcm_t *pcm)
+{
+	snd_pcm_shm_tcp_t *tcp = pcm->private_data;
+	snd_pcm_sframes_t pending = tcp->appl_ptr - tcp->appl_sent;
+
+	if (pending < 0)
+		pending += pcm->boundary;
+	return pending;
+}
+
+/*
+ * Send the committed frames (playback) or the new application pointer
+ * (capture) to the server.
+ */
+static int snd_pcm_shm_tcp_flush(snd_pcm_t *pcm)
+{
+	snd_pcm_shm_tcp_t *tcp = pcm->private_data;
+	snd_pcm_uframes_t pending;
+	snd_pcm_tcp_msg_t msg;
+
+	if (!pcm->setup || !tcp->buf)
+		return 0;
+	pending = snd_pcm_shm_tcp_pending(pcm);
+	if (!pending)
+		return 0;
+	memset(&msg, 0, sizeof(msg));
+	msg.epoch = tcp->epoch;
+	msg.appl_ptr = tcp->appl_ptr;
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+		snd_pcm_channel_area_t areas[pcm->channels];
+		snd_pcm_shm_tcp_wire_areas(pcm, tcp, areas);
+		snd_pcm_areas_copy_wrap(areas, 0, pcm->buffer_size,
+					snd_pcm_mmap_areas(pcm),
+					tcp->appl_sent % pcm->buffer_size,
+					pcm->buffer_size, pcm->channels,
+					pending, pcm->format);
+		msg.cmd = SND_PCM_TCP_WRITE;
+		msg.len = snd_pcm_frames_to_bytes(pcm, pending);
+	} else {
+		msg.cmd = SND_PCM_TCP_CONSUMED;
+	}
+	tcp->appl_sent = tcp->appl_ptr;
+	return tcp_send(tcp->ctrl_fd, &msg, tcp->buf);
+}
+
+static void snd_pcm_shm_tcp_set_hw_ptr(snd_pcm_t *pcm, snd_pcm_uframes_t hw_ptr)
+{
+	snd_pcm_shm_tcp_t *tcp = pcm->private_data;
+	snd_pcm_sframes_t diff = hw_ptr - tcp->hw_ptr;
+
+	if (!pcm->setup) {
+		tcp->hw_ptr = hw_ptr;
+		return;
+	}
+	if (diff < 0)
+		diff += pcm->boundary;
+	/* late updates of the same epoch never move the pointer back */
+	if ((snd_pcm_uframes_t) diff <= pcm->buffer_size)
+		tcp->hw_ptr = hw_ptr;
+}
+
+/*
+ * Process the pointer updates (and the capture frames) queued on the
+ * second connection without blocking.
+ */
+static int snd_pcm_shm_tcp_receive(snd_pcm_t *pcm)
+{
+	snd_pcm_shm_tcp_t *tcp = pcm->private_data;
+	snd_pcm_tcp_msg_t msg;
+	snd_pcm_uframes_t frames;
+	ssize_t n;
+	int err;
+
+	while (1) {
+		n = recv(tcp->poll_fd, &msg, sizeof(msg), MSG_DONTWAIT);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			return -errno;
+		}
+		if (n == 0)
+			return -EBADFD;
+		if ((size_t) n < sizeof(msg)) {
+			err = tcp_read_full(tcp->poll_fd, (char *)&msg + n, sizeof(msg) - n);
+			if (err < 0)
+				return err;
+		}
+		if (msg.len > tcp->buf_size)
+			return -EBADFD;
+		err = tcp_read_full(tcp->poll_fd, tcp->buf, msg.len);
+		if (err < 0)
+			return err;
+		if (msg.epoch != tcp->epoch)
+			continue;
+		if (msg.seq == tcp->seq)
+			tcp->state = msg.state;
+		if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+			snd_pcm_shm_tcp_set_hw_ptr(pcm, msg.hw_ptr);
+			continue;
+		}
+		frames = snd_pcm_bytes_to_frames(pcm, msg.len);
+		if (frames > 0) {
+			snd_pcm_channel_area_t areas[pcm->channels];
+			snd_pcm_shm_tcp_wire_areas(pcm, tcp, areas);
+			snd_pcm_areas_copy_wrap(snd_pcm_mmap_areas(pcm),
+						tcp->hw_ptr % pcm->buffer_size,
+						pcm->buffer_size, areas, 0,
+						pcm->buffer_size, pcm->channels,
+						frames, pcm->format);
+		}
+		tcp->hw_ptr = msg.hw_ptr;
+	}
+}
+
+static long snd_pcm_shm_tcp_action(snd_pcm_t *pcm, int cmd)
+{
+	snd_pcm_shm_tcp_t *tcp = pcm->private_data;
+	snd_pcm_tcp_msg_t msg;
+	size_t size = snd_pcm_tcp_cmd_size(cmd);
+	int err;
+
+	err = snd_pcm_shm_tcp_flush(pcm);
+	if (err < 0)
+		return err;
+	memset(&msg, 0, sizeof(msg));
+	msg.cmd = cmd;
+	msg.epoch = tcp->epoch;
+	msg.len = size;
+	err = tcp_send(tcp->ctrl_fd, &msg, &tcp->ctrl.u);
+	if (err < 0)
+		return err;
+	err = tcp_read_full(tcp->ctrl_fd, &msg, sizeof(msg));
+	if (err < 0)
+		return err;
+	if (msg.cmd != cmd || msg.len != size) {
+		SNDERR("Server has not done the cmd");
+		return -EBADFD;
+	}
+	err = tcp_read_full(tcp->ctrl_fd, &tcp->ctrl.u, size);
+	if (err < 0)
+		return err;
+	tcp->state = msg.state;
+	tcp->seq = msg.seq;
+	if (msg.epoch != tcp->epoch) {
+		tcp->epoch = msg.epoch;
+		tcp->hw_ptr = msg.hw_ptr;
+		tcp->appl_ptr = tcp->appl_sent = msg.appl_ptr;
+	} else if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+		snd_pcm_shm_tcp_set_hw_ptr(pcm, msg.hw_ptr);
+	}
+	return msg.result;
+}
+
+static int snd_pcm_shm_tcp_nonblock(snd_pcm_t *pcm ATTRIBUTE_UNUSED, int nonblock ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static int snd_pcm_shm_tcp_async(snd_pcm_t *pcm ATTRIBUTE_UNUSED,
+				 int sig ATTRIBUTE_UNUSED, pid_t pid ATTRIBUTE_UNUSED)
+{
+	return -ENOSYS;
+}
+
+static int snd_pcm_shm_tcp_info(snd_pcm_t *pcm, snd_pcm_info_t *info)
+{
+	snd_pcm_shm_tcp_t *tcp = pcm->private_data;
+	int err;
+	err = snd_pcm_shm_tcp_action(pcm, SNDRV_PCM_IOCTL_INFO);
+	if (err < 0)
+		return err;
+	*info = tcp->ctrl.u.info;
+	return err;
+}
+
+static int snd_pcm_shm_tcp_hw_refine_cprepare(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_hw_params_t *params)
+{
+	int err;
+	snd_pcm_access_mask_t access_mask = { SND_PCM_ACCBIT_SHM };
+	err = _snd_pcm_hw_param_set_mask(params, SND_PCM_HW_PARAM_ACCESS,
+					 &access_mask);
+	if (err < 0)
+		return err;
+	params->info &= ~(SND_PCM_INFO_MMAP | SND_PCM_INFO_MMAP_VALID);
+	return 0;
+}
+
+static int snd_pcm_shm_tcp_hw_refine_sprepare(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_hw_params_t *sparams)
+{
+	snd_pcm_access_mask_t saccess_mask = { { 1U << SND_PCM_ACCESS_RW_INTERLEAVED } };
+	_snd_pcm_hw_params_any(sparams);
+	_snd_pcm_hw_param_set_mask(sparams, SND_PCM_HW_PARAM_ACCESS,
+				   &saccess_mask);
+	return 0;
+}
+
+static int snd_pcm_shm_tcp_hw_refine_schange(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_hw_params_t *params,
+					     snd_pcm_hw_params_t *sparams)
+{
+	unsigned int links = ~SND_PCM_HW_PARBIT_ACCESS;
+	return _snd_pcm_hw_params_refine(sparams, links, params);
+}
+
+static int snd_pcm_shm_tcp_hw_refine_cchange(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_hw_params_t *params,
+					     snd_pcm_hw_params_t *sparams)
+{
+	unsigned int links = ~SND_PCM_HW_PARBIT_ACCESS;
+	return _snd_pcm_hw_params_refine(params, links, sparams);
+}
+
+static int snd_pcm_shm_tcp_hw_refine_slave(snd_pcm_t *pcm,
+					   snd_pcm_hw_params_t *params)
+{
+	snd_pcm_shm_tcp_t *tcp = pcm->private_data;
+	int err;
+	tcp->ctrl.u.hw_refine = *params;
+	err = snd_pcm_shm_tcp_action(pcm, SNDRV_PCM_IOCTL_HW_REFINE);
+	*params = tcp->ctrl.u.hw_refine;
+	return err;
+}
+
+static int snd_pcm_shm_tcp_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
+{
+	return snd_pcm_hw_refine_slave(pcm, params,
+				       snd_pcm_shm_tcp_hw_refine_cprepare,
+				       snd_pcm_shm_tcp_hw_refine_cchange,
+				       snd_pcm_shm_tcp_hw_refine_sprepare,
+				       snd_pcm_shm_tcp_hw_refine_schange,
+				       snd_pcm_shm_tcp_hw_refine_slave);
+}
+
+static int snd_pcm_shm_tcp_hw_params_slave(snd_pcm_t *pcm,
+					   snd_pcm_hw_params_t *params)
+{
+	snd_pcm_shm_tcp_t *tcp = pcm->private_data;
+	snd_pcm_format_t format;
+	snd_pcm_uframes_t size;
+	unsigned int channels;
+	int err;
+
+	tcp->ctrl.u.hw_params = *params;
+	err = snd_pcm_shm_tcp_action(pcm, SNDRV_PCM_IOCTL_HW_PARAMS);
+	*params = tcp->ctrl.u.hw_params;
+	if (err < 0)
+		return err;
+	INTERNAL(snd_pcm_hw_params_get_format)(params, &format);
+	INTERNAL(snd_pcm_hw_params_get_channels)(params, &channels);
+	INTERNAL(snd_pcm_hw_params_get_buffer_size)(params, &size);
+	free(tcp->buf);
+	tcp->buf_size = size * channels * snd_pcm_format_physical_width(format) / 8;
+	tcp->buf = malloc(tcp->buf_size);
+	if (!tcp->buf) {
+		tcp->buf_size = 0;
+		return -ENOMEM;
+	}
+	return err;
+}
+
+static int snd_pcm_shm_tcp_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
+{
+	return snd_pcm_hw_params_slave(pcm, params,
+				       snd_pcm_shm_tcp_hw_refine_cchange,
+				       snd_pcm_shm_tcp_hw_refine_sprepare,
+				       snd_pcm_shm_tcp_hw_refine_schange,
+				       snd_pcm_shm_tcp_hw_params_slave);
+}
+
+static int snd_pcm_shm_tcp_hw_free(snd_pcm_t *pcm)
+{
+	return snd_pcm_shm_tcp_action(pcm, SNDRV_PCM_IOCTL_HW_FREE);
+}
+
+static int snd_pcm_shm_tcp_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t *params)
+{
+	snd_pcm_shm_tcp_t *tcp = pcm->private_data;
+	int err;
+	tcp->ctrl.u.sw_params = *params;
+	err = snd_pcm_shm_tcp_action(pcm, SNDRV_PCM_IOCTL_SW_PARAMS);
+	*params = tcp->ctrl.u.sw_params;
+	return err;
+}
+
+static int snd_pcm_shm_tcp_mmap(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static int snd_pcm_shm_tcp_munmap(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static int snd_pcm_shm_tcp_channel_info(snd_pcm_t *pcm, snd_pcm_channel_info_t *info)
+{
+	return snd_pcm_channel_info_shm(pcm, info, -1);
+}
+
+static int snd_pcm_shm_tcp_status(snd_pcm_t *pcm, snd_pcm_status_t *status)
+{
+	snd_pcm_shm_tcp_t *tcp = pcm->private_data;
+	int err;
+	err = snd_pcm_shm_tcp_action(pcm, SNDRV_PCM_IOCTL_STATUS);
+	if (err < 0)
+		return err;
+	*status = tcp->ctrl.u.status;
+	return err;
+}
+
+/* the state comes with the pointer updates */
+static snd_pcm_state_t snd_pcm_shm_tcp_state(snd_pcm_t *pcm)
+{
+	snd_pcm_shm_tcp_t *tcp = pcm->private_data;
+	int err;
+	err = snd_pcm_shm_tcp_receive(pcm);
+	if (err < 0)
+		return SND_PCM_STATE_DISCONNECTED;
+	return tcp->state;
+}
+
+/* the pointer updates are pipelined, no round trip */
+static int snd_pcm_shm_tcp_hwsync(snd_pcm_t *pcm)
+{
+	return snd_pcm_shm_tcp_receive(pcm);
+}
+
+static int snd_pcm_shm_tcp_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
+{
+	snd_pcm_shm_tcp_t *tcp = pcm->private_data;
+	int err;
+	err = snd_pcm_shm_tcp_action(pcm, SNDRV_PCM_IOCTL_DELAY);
+	if (err < 0)
+		return err;
+	*delayp = tcp->ctrl.u.delay.frames;
+	return err;
+}
+
+static snd_pcm_sframes_t snd_pcm_shm_tcp_avail_update(snd_pcm_t *pcm)
+{
+	snd_pcm_shm_tcp_t *tcp = pcm->private_data;
+	snd_pcm_uframes_t avail;
+	int err;
+
+	err = snd_pcm_shm_tcp_receive(pcm);
+	if (err < 0)
+		return err;
+	switch (tcp->state) {
+	case SND_PCM_STATE_XRUN:
+		return -EPIPE;
+	case SND_PCM_STATE_SUSPENDED:
+		return -ESTRPIPE;
+	case SND_PCM_STATE_DISCONNECTED:
+		return -ENODEV;
+	default:
+		break;
+	}
+	avail = snd_pcm_mmap_avail(pcm);
+	/* the application is going to wait, let the server see everything */
+	if (avail < pcm->avail_min) {
+		err = snd_pcm_shm_tcp_flush(pcm);
+		if (err < 0)
+			return err;
+	}
+	return avail;
+}
+
+static int snd_pcm_shm_tcp_htimestamp(snd_pcm_t *pcm ATTRIBUTE_UNUSED,
+				      snd_pcm_uframes_t *avail ATTRIBUTE_UNUSED,
+				      snd_htimestamp_t *tstamp ATTRIBUTE_UNUSED)
+{
+	return -EIO;	/* not implemented yet */
+}
+
+static int snd_pcm_shm_tcp_prepare(snd_pcm_t *pcm)
+{
+	return snd_pcm_shm_tcp_action(pcm, SNDRV_PCM_IOCTL_PREPARE);
+}
+
+static int snd_pcm_shm_tcp_reset(snd_pcm_t *pcm)
+{
+	return snd_pcm_shm_tcp_action(pcm, SNDRV_PCM_IOCTL_RESET);
+}
+
+static int snd_pcm_shm_tcp_start(snd_pcm_t *pcm)
+{
+	return snd_pcm_shm_tcp_action(pcm, SNDRV_PCM_IOCTL_START);
+}
+
+static int snd_pcm_shm_tcp_drop(snd_pcm_t *pcm)
+{
+	return snd_pcm_shm_tcp_action(pcm, SNDRV_PCM_IOCTL_DROP);
+}
+
+static int snd_pcm_shm_tcp_drain(snd_pcm_t *pcm)
+{
+	int err;
+	do {
+		err = snd_pcm_shm_tcp_action(pcm, SNDRV_PCM_IOCTL_DRAIN);
+		if (err != -EAGAIN)
+			break;
+		usleep(10000);
+	} while (1);
+	return err;
+}
+
+static int snd_pcm_shm_tcp_pause(snd_pcm_t *pcm, int enable)
+{
+	snd_pcm_shm_tcp_t *tcp = pcm->private_data;
+	tcp->ctrl.u.pause.enable = enable;
+	return snd_pcm_shm_tcp_action(pcm, SNDRV_PCM_IOCTL_PAUSE);
+}
+
+static snd_pcm_sframes_t snd_pcm_shm_tcp_rewindable(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static snd_pcm_sframes_t snd_pcm_shm_tcp_rewind(snd_pcm_t *pcm ATTRIBUTE_UNUSED,
+						snd_pcm_uframes_t frames ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static snd_pcm_sframes_t snd_pcm_shm_tcp_forwardable(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static snd_pcm_sframes_t snd_pcm_shm_tcp_forward(snd_pcm_t *pcm ATTRIBUTE_UNUSED,
+						 snd_pcm_uframes_t frames ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+static int snd_pcm_shm_tcp_resume(snd_pcm_t *pcm)
+{
+	return snd_pcm_shm_tcp_action(pcm, SNDRV_PCM_IOCTL_RESUME);
+}
+
+static snd_pcm_sframes_t snd_pcm_shm_tcp_mmap_commit(snd_pcm_t *pcm,
+						     snd_pcm_uframes_t offset ATTRIBUTE_UNUSED,
+						     snd_pcm_uframes_t size)
+{
+	int err;
+
+	snd_pcm_mmap_appl_forward(pcm, size);
+	if (snd_pcm_shm_tcp_pending(pcm) >= pcm->period_size) {
+		err = snd_pcm_shm_tcp_flush(pcm);
+		if (err < 0)
+			return err;
+	}
+	return size;
+}
+
+static int snd_pcm_shm_tcp_poll_revents(snd_pcm_t *pcm,
+					struct pollfd *pfds ATTRIBUTE_UNUSED,
+					unsigned int nfds ATTRIBUTE_UNUSED,
+					unsigned short *revents)
+{
+	snd_pcm_sframes_t avail;
+
+	avail = snd_pcm_shm_tcp_avail_update(pcm);
+	if (avail < 0)
+		*revents = POLLERR;
+	else if ((snd_pcm_uframes_t) avail >= pcm->avail_min)
+		*revents = pcm->stream == SND_PCM_STREAM_PLAYBACK ? POLLOUT : POLLIN;
+	else
+		*revents = 0;
+	return 0;
+}
+
+static int snd_pcm_shm_tcp_close(snd_pcm_t *pcm)
+{
+	snd_pcm_shm_tcp_t *tcp = pcm->private_data;
+	int result;
+	result = snd_pcm_shm_tcp_action(pcm, SND_PCM_IOCTL_CLOSE);
+	close(tcp->ctrl_fd);
+	close(tcp->poll_fd);
+	free(tcp->buf);
+	free(tcp);
+	return result;
+}
+
+static void snd_pcm_shm_tcp_dump(snd_pcm_t *pcm, snd_output_t *out)
+{
+	snd_pcm_shm_tcp_t *tcp = pcm->private_data;
+	snd_output_printf(out, "Shm PCM (TCP transport, nodelay: %s)\n",
+			  tcp->nodelay ? "yes" : "no");
+	if (pcm->setup) {
+		snd_output_printf(out, "Its setup is:\n");
+		snd_pcm_dump_setup(pcm, out);
+	}
+}
+
+static const snd_pcm_ops_t snd_pcm_shm_tcp_ops = {
+	.close = snd_pcm_shm_tcp_close,
+	.info = snd_pcm_shm_tcp_info,
+	.hw_refine = snd_pcm_shm_tcp_hw_refine,
+	.hw_params = snd_pcm_shm_tcp_hw_params,
+	.hw_free = snd_pcm_shm_tcp_hw_free,
+	.sw_params = snd_pcm_shm_tcp_sw_params,
+	.channel_info = snd_pcm_shm_tcp_channel_info,
+	.dump = snd_pcm_shm_tcp_dump,
+	.nonblock = snd_pcm_shm_tcp_nonblock,
+	.async = snd_pcm_shm_tcp_async,
+	.mmap = snd_pcm_shm_tcp_mmap,
+	.munmap = snd_pcm_shm_tcp_munmap,
+};
+
+static const snd_pcm_fast_ops_t snd_pcm_shm_tcp_fast_ops = {
+	.status = snd_pcm_shm_tcp_status,
+	.state = snd_pcm_shm_tcp_state,
+	.hwsync = snd_pcm_shm_tcp_hwsync,
+	.delay = snd_pcm_shm_tcp_delay,
+	.prepare = snd_pcm_shm_tcp_prepare,
+	.reset = snd_pcm_shm_tcp_reset,
+	.start = snd_pcm_shm_tcp_start,
+	.drop = snd_pcm_shm_tcp_drop,
+	.drain = snd_pcm_shm_tcp_drain,
+	.pause = snd_pcm_shm_tcp_pause,
+	.rewindable = snd_pcm_shm_tcp_rewindable,
+	.rewind = snd_pcm_shm_tcp_rewind,
+	.forwardable = snd_pcm_shm_tcp_forwardable,
+	.forward = snd_pcm_shm_tcp_forward,
+	.resume = snd_pcm_shm_tcp_resume,
+	.writei = snd_pcm_mmap_writei,
+	.writen = snd_pcm_mmap_writen,
+	.readi = snd_pcm_mmap_readi,
+	.readn = snd_pcm_mmap_readn,
+	.avail_update = snd_pcm_shm_tcp_avail_update,
+	.mmap_commit = snd_pcm_shm_tcp_mmap_commit,
+	.htimestamp = snd_pcm_shm_tcp_htimestamp,
+	.poll_revents = snd_pcm_shm_tcp_poll_revents,
+};
+
+/*
+ * Connect to the server and pair the connection by the cookie.
+ */
+static int make_inet_socket(const char *host, int port, uint32_t cookie,
+			    int nodelay)
+{
+	struct addrinfo hints, *res, *ai;
+	char service[16];
+	uint32_t echo;
+	int sock = -1, err;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	snprintf(service, sizeof(service), "%d", port);
+	err = getaddrinfo(host, service, &hints, &res);
+	if (err) {
+		SNDERR("cannot resolve %s: %s", host, gai_strerror(err));
+		return -ENOENT;
+	}
+	for (ai = res; ai; ai = ai->ai_next) {
+		sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (sock < 0)
+			continue;
+		if (connect(sock, ai->ai_addr, ai->ai_addrlen) == 0)
+			break;
+		close(sock);
+		sock = -1;
+	}
+	freeaddrinfo(res);
+	if (sock < 0) {
+		SYSERR("connect failed");
+		return -errno;
+	}
+	if (nodelay)
+		setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+	if (write(sock, &cookie, sizeof(cookie)) != sizeof(cookie) ||
+	    tcp_read_full(sock, &echo, sizeof(echo)) < 0 || echo != cookie) {
+		SNDERR("server handshake failed");
+		close(sock);
+		return -EBADFD;
+	}
+	return sock;
+}
+
+/**
+ * \brief Creates a new shared memory PCM using the TCP transport
+ * \param pcmp Returns created PCM handle
+ * \param name Name of PCM
+ * \param host Server host name
+ * \param port Server port
+ * \param sname Server PCM name
+ * \param stream PCM Stream
+ * \param mode PCM Mode
+ * \param nodelay Use TCP_NODELAY on the connections
+ * \retval zero on success otherwise a negative error code
+ */
+int snd_pcm_shm_tcp_open(snd_pcm_t **pcmp, const char *name,
+			 const char *host, int port, const char *sname,
+			 snd_pcm_stream_t stream, int mode, int nodelay)
+{
+	snd_pcm_t *pcm;
+	snd_pcm_shm_tcp_t *tcp;
+	snd_client_open_request_t *req;
+	snd_client_open_answer_t ans;
+	size_t snamelen, reqlen;
+	uint32_t cookie;
+	int err;
+
+	snamelen = strlen(sname);
+	if (snamelen > 255)
+		return -EINVAL;
+	tcp = calloc(1, sizeof(*tcp));
+	if (!tcp)
+		return -ENOMEM;
+	tcp->ctrl_fd = tcp->poll_fd = -1;
+	tcp->nodelay = nodelay;
+
+	cookie = ((uint32_t)getpid() << 16) ^ (uint32_t)time(NULL) ^
+		 (uint32_t)(uintptr_t)tcp;
+	if (cookie == 0)
+		cookie = 1;
+	/* the server pairs the first connection as the poll one */
+	err = make_inet_socket(host, port, cookie, nodelay);
+	if (err < 0)
+		goto _err;
+	tcp->poll_fd = err;
+	err = make_inet_socket(host, port, cookie, nodelay);
+	if (err < 0)
+		goto _err;
+	tcp->ctrl_fd = err;
+
+	reqlen = sizeof(*req) + snamelen;
+	req = alloca(reqlen);
+	memcpy(req->name, sname, snamelen);
+	req->dev_type = SND_DEV_TYPE_PCM;
+	req->transport_type = SND_TRANSPORT_TYPE_TCP;
+	req->stream = stream;
+	req->mode = mode;
+	req->namelen = snamelen;
+	if (write(tcp->ctrl_fd, req, reqlen) != (ssize_t) reqlen) {
+		SYSERR("write error");
+		err = -EBADFD;
+		goto _err;
+	}
+	err = tcp_read_full(tcp->ctrl_fd, &ans, sizeof(ans));
+	if (err < 0) {
+		SNDERR("read error");
+		goto _err;
+	}
+	err = ans.result;
+	if (err < 0)
+		goto _err;
+
+	err = snd_pcm_new(&pcm, SND_PCM_TYPE_SHM, name, stream, mode);
+	if (err < 0)
+		goto _err;
+	pcm->mmap_rw = 1;
+	pcm->ops = &snd_pcm_shm_tcp_ops;
+	pcm->fast_ops = &snd_pcm_shm_tcp_fast_ops;
+	pcm->private_data = tcp;
+	pcm->poll_fd = tcp->poll_fd;
+	pcm->poll_events = POLLIN;
+	snd_pcm_set_hw_ptr(pcm, &tcp->hw_ptr, -1, 0);
+	snd_pcm_set_appl_ptr(pcm, &tcp->appl_ptr, -1, 0);
+	*pcmp = pcm;
+	return 0;
+
+ _err:
+	if (tcp->ctrl_fd >= 0)
+		close(tcp->ctrl_fd);
+	if (tcp->poll_fd >= 0)
+		close(tcp->poll_fd);
+	free(tcp);
+	return err;
+}
@@ -28,6 +28,11 @@
 
 #include "bswap.h"
 #include <math.h>
+#include <poll.h>
+#include <unistd.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 #include "pcm_local.h"
 #include "pcm_plugin.h"
 
@@ -40,6 +45,8 @@ const char *_snd_module_pcm_softvol = "";
 
 #ifndef DOC_HIDDEN
 
+typedef struct softvol_watch softvol_watch_t;
+
 typedef struct {
 	/* This field need to be the first */
 	snd_pcm_plugin_t plug;
@@ -52,7 +59,15 @@ typedef struct {
 	unsigned int zero_dB_val; /* index at 0 dB */
 	double min_dB;
 	double max_dB;
-	unsigned int *dB_value;
+	const unsigned int *dB_value;	/* preset or shared, see pcm_table.c */
+	unsigned int vol_valid: 1;	/* cur_vol holds the control value */
+	unsigned int ramp: 1;		/* ramp the gain over a period on changes */
+	unsigned int prev_valid: 1;
+	unsigned int prev_vol[2];	/* volume applied to the previous period */
+	int ctl_card;
+	softvol_watch_t *watch;		/* shared per-card event watcher */
+	struct list_head watch_list;	/* entry in watch->clients */
+	int watch_changed;		/* set by the watcher, cleared on read */
 } snd_pcm_softvol_t;
 
 #define VOL_SCALE_SHIFT		16
@@ -174,12 +189,62 @@ static inline short MULTI_DIV_short(short a, unsigned int b, int swap)
 	return swap ? (short)bswap_16((short)fraction) : (short)fraction;
 }
 
+/*
+ * Kernels for the host-endian S16, S32 and S24_LE cases without boost
+ * (gain below 0 dB).  They compute exactly what MULTI_DIV_short(),
+ * MULTI_DIV_int() and MULTI_DIV_24() return for such scales, but in a
+ * plain arithmetic form the compiler can vectorize when the samples are
+ * contiguous.  Boosted scales still go through the MULTI_DIV_*()
+ * helpers.  src and dst may be the same buffer.
+ */
+/* (a * b) >> 16 for 32bit a and 16bit b, same as MULTI_DIV_32x16() */
+#define softvol_mul32(a, b) \
+	((int)(((unsigned int)((a) & 0xffff) * (b)) >> 16) + ((a) >> 16) * (int)(b))
+
+#define SOFTVOL_KERNEL(name, TYPE, expr, boost) \
+static SND_VECTORIZE void softvol_kernel_##name(TYPE *dst, int dst_step, \
+						    const TYPE *src, int src_step, \
+						    unsigned int frames, \
+						    unsigned int vol_scale) \
+{ \
+	unsigned int i; \
+	if (vol_scale >> VOL_SCALE_SHIFT) { \
+		for (i = 0; i < frames; i++) { \
+			*dst = boost; \
+			src += src_step; \
+			dst += dst_step; \
+		} \
+		return; \
+	} \
+	if (src_step == 1 && dst_step == 1) { \
+		for (i = 0; i < frames; i++) { \
+			TYPE a = src[i]; \
+			dst[i] = (expr); \
+		} \
+		return; \
+	} \
+	for (i = 0; i < frames; i++) { \
+		TYPE a = *src; \
+		*dst = (expr); \
+		src += src_step; \
+		dst += dst_step; \
+	} \
+}
+
+SOFTVOL_KERNEL(short, short, (short)(((int)a * (int)vol_scale) >> VOL_SCALE_SHIFT),
+	       MULTI_DIV_short(*src, vol_scale, 0))
+SOFTVOL_KERNEL(int, int, softvol_mul32(a, vol_scale),
+	       MULTI_DIV_int(*src, vol_scale, 0))
+SOFTVOL_KERNEL(s24, int, softvol_mul32((int)((unsigned int)a << 8) >> 8, vol_scale),
+	       MULTI_DIV_24((int)((unsigned int)*src << 8) >> 8, vol_scale))
+
+#undef softvol_mul32
+#undef SOFTVOL_KERNEL
+
 #endif /* DOC_HIDDEN */
 
 /*
  * apply volumue attenuation
- *
- * TODO: use SIMD operations
  */
 
 #ifndef DOC_HIDDEN
@@ -206,6 +271,9 @@ static inline short MULTI_DIV_short(short a, unsigned int b, int swap)
 				src += src_step; \
 				dst += dst_step; \
 			} \
+		} else if (!swap) { \
+			softvol_kernel_##TYPE(dst, dst_step, src, src_step, \
+					      fr, vol_scale); \
 		} else { \
 			while (fr--) { \
 				*dst = (TYPE) MULTI_DIV_##TYPE(*src, vol_scale, swap); \
@@ -261,7 +329,6 @@ static inline short MULTI_DIV_short(short a, unsigned int b, int swap)
 #define CONVERT_AREA_S24_LE() do {					\
 	unsigned int ch, fr;						\
 	int *src, *dst;							\
-	int tmp;							\
 	for (ch = 0; ch < channels; ch++) {				\
 		src_area = &src_areas[ch];				\
 		dst_area = &dst_areas[ch];				\
@@ -285,13 +352,8 @@ static inline short MULTI_DIV_short(short a, unsigned int b, int swap)
 				dst += src_step;			\
 			}						\
 		} else {						\
-			while (fr--) {					\
-				tmp = *src << 8;			\
-				tmp = (signed int) tmp >> 8;		\
-				*dst = MULTI_DIV_24(tmp, vol_scale);	\
-				src += dst_step;			\
-				dst += src_step;			\
-			}						\
+			softvol_kernel_s24(dst, dst_step, src, src_step, \
+					   fr, vol_scale);		\
 		}							\
 	}								\
 } while (0)
@@ -313,6 +375,32 @@ static inline short MULTI_DIV_short(short a, unsigned int b, int swap)
 
 #endif /* DOC_HIDDEN */
 
+/*
+ * describes the interleaved run of frames * channels samples in areas
+ * as a single channel, so that a uniform gain is applied in one pass;
+ * returns 0 if the channels are not packed back to back
+ */
+static int softvol_flatten_areas(const snd_pcm_channel_area_t *areas,
+				 snd_pcm_uframes_t offset,
+				 unsigned int channels, unsigned int width,
+				 snd_pcm_channel_area_t *flat)
+{
+	unsigned int ch;
+
+	if (areas[0].first % 8)
+		return 0;
+	for (ch = 0; ch < channels; ch++) {
+		if (areas[ch].addr != areas[0].addr ||
+		    areas[ch].first != areas[0].first + ch * width ||
+		    areas[ch].step != channels * width)
+			return 0;
+	}
+	flat->addr = snd_pcm_channel_area_addr(&areas[0], offset);
+	flat->first = 0;
+	flat->step = width;
+	return 1;
+}
+
 /* 2-channel stereo control */
 static void softvol_convert_stereo_vol(snd_pcm_softvol_t *svol,
 				       const snd_pcm_channel_area_t *dst_areas,
@@ -323,6 +411,7 @@ static void softvol_convert_stereo_vol(snd_pcm_softvol_t *svol,
 				       snd_pcm_uframes_t frames)
 {
 	const snd_pcm_channel_area_t *dst_area, *src_area;
+	snd_pcm_channel_area_t dst_flat, src_flat;
 	unsigned int src_step, dst_step;
 	unsigned int vol_scale, vol[2], vol_c;
 
@@ -346,6 +435,19 @@ static void softvol_convert_stereo_vol(snd_pcm_softvol_t *svol,
 		vol[1] = svol->dB_value[svol->cur_vol[1]];
 		vol_c = svol->dB_value[(svol->cur_vol[0] + svol->cur_vol[1]) / 2];
 	}
+	if (channels > 1 && vol[0] == vol[1] && vol[0] == vol_c) {
+		unsigned int width = snd_pcm_format_physical_width(svol->sformat);
+		if (softvol_flatten_areas(dst_areas, dst_offset, channels, width,
+					  &dst_flat) &&
+		    softvol_flatten_areas(src_areas, src_offset, channels, width,
+					  &src_flat)) {
+			dst_areas = &dst_flat;
+			src_areas = &src_flat;
+			dst_offset = src_offset = 0;
+			frames *= channels;
+			channels = 1;
+		}
+	}
 	switch (svol->sformat) {
 	case SND_PCM_FORMAT_S16_LE:
 	case SND_PCM_FORMAT_S16_BE:
@@ -384,6 +486,7 @@ static void softvol_convert_mono_vol(snd_pcm_softvol_t *svol,
 				     snd_pcm_uframes_t frames)
 {
 	const snd_pcm_channel_area_t *dst_area, *src_area;
+	snd_pcm_channel_area_t dst_flat, src_flat;
 	unsigned int src_step, dst_step;
 	unsigned int vol_scale;
 
@@ -401,6 +504,19 @@ static void softvol_convert_mono_vol(snd_pcm_softvol_t *svol,
 		vol_scale = svol->cur_vol[0] ? 0xffff : 0;
 	else
 		vol_scale = svol->dB_value[svol->cur_vol[0]];
+	if (channels > 1) {
+		unsigned int width = snd_pcm_format_physical_width(svol->sformat);
+		if (softvol_flatten_areas(dst_areas, dst_offset, channels, width,
+					  &dst_flat) &&
+		    softvol_flatten_areas(src_areas, src_offset, channels, width,
+					  &src_flat)) {
+			dst_areas = &dst_flat;
+			src_areas = &src_flat;
+			dst_offset = src_offset = 0;
+			frames *= channels;
+			channels = 1;
+		}
+	}
 	switch (svol->sformat) {
 	case SND_PCM_FORMAT_S16_LE:
 	case SND_PCM_FORMAT_S16_BE:
@@ -426,9 +542,340 @@ static void softvol_convert_mono_vol(snd_pcm_softvol_t *svol,
 	}
 }
 
+/* scale factor for a control value */
+static unsigned int softvol_vol_scale(snd_pcm_softvol_t *svol, unsigned int val)
+{
+	if (svol->max_val == 1)
+		return val ? 0xffff : 0;
+	return svol->dB_value[val];
+}
+
+/* scale factor of a channel, following the GET_VOL_SCALE layout */
+static unsigned int softvol_channel_scale(snd_pcm_softvol_t *svol,
+					  const unsigned int *vol,
+					  unsigned int ch, unsigned int channels)
+{
+	if (svol->cchannels == 1)
+		return softvol_vol_scale(svol, vol[0]);
+	switch (ch) {
+	case 0:
+	case 2:
+		if (channels != ch + 1)
+			return softvol_vol_scale(svol, vol[0]);
+		break;
+	case 4:
+	case 5:
+		break;
+	default:
+		return softvol_vol_scale(svol, vol[ch & 1]);
+	}
+	if (svol->max_val == 1)
+		return (vol[0] | vol[1]) ? 0xffff : 0;
+	return svol->dB_value[(vol[0] + vol[1]) / 2];
+}
+
+#ifndef DOC_HIDDEN
+#define RAMP_AREA(TYPE, CONV) do { \
+	TYPE *src = snd_pcm_channel_area_addr(src_area, src_offset); \
+	TYPE *dst = snd_pcm_channel_area_addr(dst_area, dst_offset); \
+	int src_step = snd_pcm_channel_area_step(src_area) / sizeof(TYPE); \
+	int dst_step = snd_pcm_channel_area_step(dst_area) / sizeof(TYPE); \
+	for (fr = 0; fr < frames; fr++) { \
+		unsigned int vol_scale = pos >> VOL_SCALE_SHIFT; \
+		CONV; \
+		src += src_step; \
+		dst += dst_step; \
+		pos += inc; \
+	} \
+} while (0)
+#endif /* DOC_HIDDEN */
+
+/*
+ * apply a gain moving linearly from the previous volume to the current
+ * one over the given frames, used for the first period after a change
+ */
+static void softvol_convert_ramp(snd_pcm_softvol_t *svol,
+				 const snd_pcm_channel_area_t *dst_areas,
+				 snd_pcm_uframes_t dst_offset,
+				 const snd_pcm_channel_area_t *src_areas,
+				 snd_pcm_uframes_t src_offset,
+				 unsigned int channels,
+				 snd_pcm_uframes_t frames)
+{
+	int swap = !snd_pcm_format_cpu_endian(svol->sformat);
+	unsigned int ch;
+
+	for (ch = 0; ch < channels; ch++) {
+		const snd_pcm_channel_area_t *src_area = &src_areas[ch];
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[ch];
+		long long from = softvol_channel_scale(svol, svol->prev_vol, ch, channels);
+		long long to = softvol_channel_scale(svol, svol->cur_vol, ch, channels);
+		long long pos = from << VOL_SCALE_SHIFT;
+		long long inc = ((to - from) << VOL_SCALE_SHIFT) / (long long)frames;
+		snd_pcm_uframes_t fr;
+		int tmp;
+
+		switch (svol->sformat) {
+		case SND_PCM_FORMAT_S16_LE:
+		case SND_PCM_FORMAT_S16_BE:
+			RAMP_AREA(short, *dst = MULTI_DIV_short(*src, vol_scale, swap));
+			break;
+		case SND_PCM_FORMAT_S32_LE:
+		case SND_PCM_FORMAT_S32_BE:
+			RAMP_AREA(int, *dst = MULTI_DIV_int(*src, vol_scale, swap));
+			break;
+		case SND_PCM_FORMAT_S24_LE:
+			RAMP_AREA(int,
+				  tmp = (int)((unsigned int)*src << 8) >> 8;
+				  *dst = MULTI_DIV_24(tmp, vol_scale));
+			break;
+		case SND_PCM_FORMAT_S24_3LE:
+			RAMP_AREA(unsigned char,
+				  tmp = src[0] | (src[1] << 8) |
+					(((signed char *) src)[2] << 16);
+				  tmp = MULTI_DIV_24(tmp, vol_scale);
+				  dst[0] = tmp;
+				  dst[1] = tmp >> 8;
+				  dst[2] = tmp >> 16);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+#undef RAMP_AREA
+
+static void softvol_convert(snd_pcm_softvol_t *svol,
+			    const snd_pcm_channel_area_t *dst_areas,
+			    snd_pcm_uframes_t dst_offset,
+			    const snd_pcm_channel_area_t *src_areas,
+			    snd_pcm_uframes_t src_offset,
+			    unsigned int channels,
+			    snd_pcm_uframes_t frames)
+{
+	if (svol->ramp && svol->prev_valid && frames > 0 &&
+	    (svol->prev_vol[0] != svol->cur_vol[0] ||
+	     (svol->cchannels > 1 && svol->prev_vol[1] != svol->cur_vol[1])))
+		softvol_convert_ramp(svol, dst_areas, dst_offset,
+				     src_areas, src_offset, channels, frames);
+	else if (svol->cchannels == 1)
+		softvol_convert_mono_vol(svol, dst_areas, dst_offset,
+					 src_areas, src_offset, channels, frames);
+	else
+		softvol_convert_stereo_vol(svol, dst_areas, dst_offset,
+					   src_areas, src_offset, channels, frames);
+	svol->prev_vol[0] = svol->cur_vol[0];
+	svol->prev_vol[1] = svol->cur_vol[1];
+	svol->prev_valid = 1;
+}
+
+/*
+ * Shared ctl watcher
+ *
+ * With "watch_ctl" set, the softvol instances of a process that live on
+ * the same card share one ctl handle subscribed to the change events,
+ * served by a background thread.  The thread only flags the instances
+ * whose control was touched; the transfer path then re-reads the
+ * control on the next period and does no syscall at all as long as the
+ * volume stays unchanged.
+ */
+
+#ifdef HAVE_LIBPTHREAD
+
+struct softvol_watch {
+	struct list_head list;		/* entry in softvol_watches */
+	struct list_head clients;	/* snd_pcm_softvol_t instances */
+	int card;
+	snd_ctl_t *ctl;
+	int wake[2];			/* pipe to stop the thread */
+	pthread_t thread;
+	int failed;			/* the thread gave up on the ctl */
+};
+
+static LIST_HEAD(softvol_watches);
+static pthread_mutex_t softvol_watches_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void softvol_watch_notify(softvol_watch_t *watch,
+				 const snd_ctl_elem_id_t *id)
+{
+	struct list_head *pos;
+
+	pthread_mutex_lock(&softvol_watches_mutex);
+	list_for_each(pos, &watch->clients) {
+		snd_pcm_softvol_t *svol = list_entry(pos, snd_pcm_softvol_t,
+						     watch_list);
+		if (!id || !snd_ctl_elem_id_compare_set(id, &svol->elem.id))
+			__atomic_store_n(&svol->watch_changed, 1,
+					 __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&softvol_watches_mutex);
+}
+
+static void *softvol_watch_thread(void *arg)
+{
+	softvol_watch_t *watch = arg;
+	struct pollfd pfd[2];
+	snd_ctl_event_t event;
+	int err;
+
+	pfd[0].fd = watch->wake[0];
+	pfd[0].events = POLLIN;
+	if (snd_ctl_poll_descriptors(watch->ctl, &pfd[1], 1) != 1)
+		goto _failed;
+	for (;;) {
+		if (poll(pfd, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			goto _failed;
+		}
+		if (pfd[0].revents)
+			return NULL;
+		if (pfd[1].revents & (POLLERR | POLLHUP | POLLNVAL))
+			goto _failed;
+		while ((err = snd_ctl_read(watch->ctl, &event)) > 0) {
+			if (snd_ctl_event_get_type(&event) == SND_CTL_EVENT_ELEM)
+				softvol_watch_notify(watch, &event.data.elem.id);
+		}
+		if (err < 0 && err != -EAGAIN)
+			goto _failed;
+	}
+
+ _failed:
+	/* let the clients fall back to reading the control each period */
+	__atomic_store_n(&watch->failed, 1, __ATOMIC_RELEASE);
+	softvol_watch_notify(watch, NULL);
+	return NULL;
+}
+
+static void softvol_watch_destroy(softvol_watch_t *watch)
+{
+	if (watch->wake[1] >= 0) {
+		if (write(watch->wake[1], "", 1) == 1)
+			pthread_join(watch->thread, NULL);
+		close(watch->wake[0]);
+		close(watch->wake[1]);
+	}
+	if (watch->ctl)
+		snd_ctl_close(watch->ctl);
+	free(watch);
+}
+
+static softvol_watch_t *softvol_watch_create(int card)
+{
+	softvol_watch_t *watch;
+	char name[16];
+
+	watch = calloc(1, sizeof(*watch));
+	if (!watch)
+		return NULL;
+	INIT_LIST_HEAD(&watch->clients);
+	watch->card = card;
+	watch->wake[0] = watch->wake[1] = -1;
+	sprintf(name, "hw:%d", card);
+	if (snd_ctl_open(&watch->ctl, name, SND_CTL_NONBLOCK) < 0) {
+		watch->ctl = NULL;
+		goto _err;
+	}
+	if (snd_ctl_subscribe_events(watch->ctl, 1) < 0)
+		goto _err;
+	if (pipe(watch->wake) < 0) {
+		watch->wake[0] = watch->wake[1] = -1;
+		goto _err;
+	}
+	if (snd_thread_create(&watch->thread, "pcm_softvol",
+			      softvol_watch_thread, watch)) {
+		close(watch->wake[0]);
+		close(watch->wake[1]);
+		watch->wake[0] = watch->wake[1] = -1;
+		goto _err;
+	}
+	return watch;
+
+ _err:
+	softvol_watch_destroy(watch);
+	return NULL;
+}
+
+static int softvol_watch_attach(snd_pcm_softvol_t *svol)
+{
+	softvol_watch_t *watch = NULL;
+	struct list_head *pos;
+
+	pthread_mutex_lock(&softvol_watches_mutex);
+	list_for_each(pos, &softvol_watches) {
+		softvol_watch_t *w = list_entry(pos, softvol_watch_t, list);
+		if (w->card == svol->ctl_card &&
+		    !__atomic_load_n(&w->failed, __ATOMIC_ACQUIRE)) {
+			watch = w;
+			break;
+		}
+	}
+	if (!watch) {
+		watch = softvol_watch_create(svol->ctl_card);
+		if (!watch) {
+			pthread_mutex_unlock(&softvol_watches_mutex);
+			return -ENOMEM;
+		}
+		list_add_tail(&watch->list, &softvol_watches);
+	}
+	svol->watch = watch;
+	svol->watch_changed = 1;
+	list_add_tail(&svol->watch_list, &watch->clients);
+	pthread_mutex_unlock(&softvol_watches_mutex);
+	return 0;
+}
+
+static void softvol_watch_detach(snd_pcm_softvol_t *svol)
+{
+	softvol_watch_t *watch = svol->watch;
+
+	if (!watch)
+		return;
+	pthread_mutex_lock(&softvol_watches_mutex);
+	list_del(&svol->watch_list);
+	if (list_empty(&watch->clients))
+		list_del(&watch->list);
+	else
+		watch = NULL;
+	pthread_mutex_unlock(&softvol_watches_mutex);
+	svol->watch = NULL;
+	if (watch)
+		softvol_watch_destroy(watch);
+}
+
+/* returns 1 if the control has to be read again */
+static int softvol_watch_changed(snd_pcm_softvol_t *svol)
+{
+	if (__atomic_load_n(&svol->watch->failed, __ATOMIC_ACQUIRE))
+		return 1;
+	return __atomic_exchange_n(&svol->watch_changed, 0, __ATOMIC_ACQ_REL);
+}
+
+#else /* HAVE_LIBPTHREAD */
+
+static int softvol_watch_attach(snd_pcm_softvol_t *svol ATTRIBUTE_UNUSED)
+{
+	return -ENOSYS;
+}
+
+static void softvol_watch_detach(snd_pcm_softvol_t *svol ATTRIBUTE_UNUSED)
+{
+}
+
+static int softvol_watch_changed(snd_pcm_softvol_t *svol ATTRIBUTE_UNUSED)
+{
+	return 1;
+}
+
+#endif /* HAVE_LIBPTHREAD */
+
 /*
  * get the current volume value from driver
  *
+ * With the shared watcher the control is re-read only after a change
+ * notification, otherwise it is read on each call.
+ *
  * TODO: mmap support?
  */
 static void get_current_volume(snd_pcm_softvol_t *svol)
@@ -436,6 +883,8 @@ static void get_current_volume(snd_pcm_softvol_t *svol)
 	unsigned int val;
 	unsigned int i;
 
+	if (svol->vol_valid && svol->watch && !softvol_watch_changed(svol))
+		return;
 	if (snd_ctl_elem_read(svol->ctl, &svol->elem) < 0)
 		return;
 	for (i = 0; i < svol->cchannels; i++) {
@@ -444,16 +893,18 @@ static void get_current_volume(snd_pcm_softvol_t *svol)
 			val = svol->max_val;
 		svol->cur_vol[i] = val;
 	}
+	svol->vol_valid = 1;
 }
 
 static void softvol_free(snd_pcm_softvol_t *svol)
 {
+	softvol_watch_detach(svol);
 	if (svol->plug.gen.close_slave)
 		snd_pcm_close(svol->plug.gen.slave);
 	if (svol->ctl)
 		snd_ctl_close(svol->ctl);
-	if (svol->dB_value && svol->dB_value != preset_dB_value)
-		free(svol->dB_value);
+	if (svol->dB_value != preset_dB_value)
+		snd_pcm_table_put(svol->dB_value);
 	free(svol);
 }
 
@@ -654,12 +1105,8 @@ snd_pcm_softvol_write_areas(snd_pcm_t *pcm,
 	if (size > *slave_sizep)
 		size = *slave_sizep;
 	get_current_volume(svol);
-	if (svol->cchannels == 1)
-		softvol_convert_mono_vol(svol, slave_areas, slave_offset,
-					 areas, offset, pcm->channels, size);
-	else
-		softvol_convert_stereo_vol(svol, slave_areas, slave_offset,
-					   areas, offset, pcm->channels, size);
+	softvol_convert(svol, slave_areas, slave_offset,
+			areas, offset, pcm->channels, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -677,12 +1124,8 @@ snd_pcm_softvol_read_areas(snd_pcm_t *pcm,
 	if (size > *slave_sizep)
 		size = *slave_sizep;
 	get_current_volume(svol);
-	if (svol->cchannels == 1)
-		softvol_convert_mono_vol(svol, areas, offset, slave_areas,
-					 slave_offset, pcm->channels, size);
-	else
-		softvol_convert_stereo_vol(svol, areas, offset, slave_areas,
-					   slave_offset, pcm->channels, size);
+	softvol_convert(svol, areas, offset, slave_areas,
+			slave_offset, pcm->channels, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -703,19 +1146,26 @@ static void snd_pcm_softvol_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
 	}
+	snd_pcm_plugin_dump_profile(pcm, out);
 	snd_output_printf(out, "Slave: ");
 	snd_pcm_dump(svol->plug.gen.slave, out);
 }
 
-static int add_tlv_info(snd_pcm_softvol_t *svol, snd_ctl_elem_info_t *cinfo,
-			unsigned int *old_tlv, size_t old_tlv_size)
+static void set_tlv_info(snd_pcm_softvol_t *svol, unsigned int *tlv)
 {
-	unsigned int tlv[4];
 	tlv[SNDRV_CTL_TLVO_TYPE] = SND_CTL_TLVT_DB_SCALE;
 	tlv[SNDRV_CTL_TLVO_LEN] = 2 * sizeof(int);
 	tlv[SNDRV_CTL_TLVO_DB_SCALE_MIN] = (int)(svol->min_dB * 100);
 	tlv[SNDRV_CTL_TLVO_DB_SCALE_MUTE_AND_STEP] =
 		(int)((svol->max_dB - svol->min_dB) * 100 / svol->max_val);
+}
+
+static int add_tlv_info(snd_pcm_softvol_t *svol, snd_ctl_elem_info_t *cinfo,
+			unsigned int *old_tlv, size_t old_tlv_size)
+{
+	unsigned int tlv[4];
+
+	set_tlv_info(svol, tlv);
 	if (sizeof(tlv) <= old_tlv_size && memcmp(tlv, old_tlv, sizeof(tlv)) == 0)
 		return 0;
 	return snd_ctl_elem_tlv_write(svol->ctl, &cinfo->id, tlv);
@@ -724,31 +1174,62 @@ static int add_tlv_info(snd_pcm_softvol_t *svol, snd_ctl_elem_info_t *cinfo,
 static int add_user_ctl(snd_pcm_softvol_t *svol, snd_ctl_elem_info_t *cinfo,
 			int count)
 {
-	int err;
+	snd_ctl_elem_set_desc_t desc = {0};
+	unsigned int tlv[4];
 	int i;
 	unsigned int def_val;
 	
+	desc.info = cinfo;
+	desc.element_count = 1;
+	desc.member_count = count;
 	if (svol->max_val == 1) {
 		snd_ctl_elem_info_set_read_write(cinfo, 1, 1);
-		err = snd_ctl_add_boolean_elem_set(svol->ctl, cinfo, 1, count);
-	} else {
-		err = snd_ctl_add_integer_elem_set(svol->ctl, cinfo, 1, count,
-						   0, svol->max_val, 0);
-	}
-	if (err < 0)
-		return err;
-	if (svol->max_val == 1)
+		desc.type = SND_CTL_ELEM_TYPE_BOOLEAN;
 		def_val = 1;
-	else {
-		add_tlv_info(svol, cinfo, NULL, 0);
+	} else {
+		desc.type = SND_CTL_ELEM_TYPE_INTEGER;
+		desc.max = svol->max_val;
+		set_tlv_info(svol, tlv);
+		desc.tlv = tlv;
 		/* set zero dB value as default, or max_val if
 		   there is no 0 dB setting */
 		def_val = svol->zero_dB_val ? svol->zero_dB_val : svol->max_val;
 	}
 	for (i = 0; i < count; i++)
 		svol->elem.value.integer.value[i] = def_val;
-	return snd_ctl_elem_write(svol->ctl, &svol->elem);
+	/* created, described and set in one go */
+	desc.value = &svol->elem;
+	snd_ctl_add_elem_sets(svol->ctl, &desc, 1);
+	return desc.result;
+}
+
+#ifndef HAVE_SOFT_FLOAT
+/* the parameters of a dB table, shared by all the instances using them */
+struct softvol_table_key {
+	double min_dB;
+	double max_dB;
+	unsigned int max_val;
+	unsigned int zero_dB_val;
+};
+
+static int softvol_build_dB_table(void *table, const void *data)
+{
+	const struct softvol_table_key *key = data;
+	unsigned int *dB_value = table;
+	unsigned int i;
+
+	for (i = 0; i <= key->max_val; i++) {
+		double db = key->min_dB +
+			(i * (key->max_dB - key->min_dB)) / key->max_val;
+		double v = (pow(10.0, db / 20.0) *
+				(double)(1 << VOL_SCALE_SHIFT));
+		dB_value[i] = (unsigned int)v;
+	}
+	if (key->zero_dB_val)
+		dB_value[key->zero_dB_val] = 65535;
+	return 0;
 }
+#endif
 
 /*
  * load and set up user-control
@@ -765,7 +1246,6 @@ static int softvol_load_control(snd_pcm_t *pcm, snd_pcm_softvol_t *svol,
 	snd_pcm_info_t info = {0};
 	snd_ctl_elem_info_t cinfo = {0};
 	int err;
-	unsigned int i;
 
 	if (ctl_card < 0) {
 		err = snd_pcm_info(pcm, &info);
@@ -777,6 +1257,7 @@ static int softvol_load_control(snd_pcm_t *pcm, snd_pcm_softvol_t *svol,
 			return -EINVAL;
 		}
 	}
+	svol->ctl_card = ctl_card;
 	sprintf(tmp_name, "hw:%d", ctl_card);
 	err = snd_ctl_open(&svol->ctl, tmp_name, 0);
 	if (err < 0) {
@@ -848,26 +1329,25 @@ static int softvol_load_control(snd_pcm_t *pcm, snd_pcm_softvol_t *svol,
 	/* set up dB table */
 	if (min_dB == PRESET_MIN_DB && max_dB == ZERO_DB &&
 						resolution == PRESET_RESOLUTION)
-		svol->dB_value = (unsigned int*)preset_dB_value;
+		svol->dB_value = preset_dB_value;
 	else {
 #ifndef HAVE_SOFT_FLOAT
-		svol->dB_value = calloc(resolution, sizeof(unsigned int));
+		struct softvol_table_key key;
+
+		memset(&key, 0, sizeof(key));
+		key.min_dB = min_dB;
+		key.max_dB = max_dB;
+		key.max_val = svol->max_val;
+		key.zero_dB_val = svol->zero_dB_val;
+		svol->dB_value = snd_pcm_table_get("softvol_dB", &key, sizeof(key),
+						   resolution * sizeof(unsigned int),
+						   softvol_build_dB_table);
 		if (! svol->dB_value) {
 			SNDERR("cannot allocate dB table");
 			return -ENOMEM;
 		}
 		svol->min_dB = min_dB;
 		svol->max_dB = max_dB;
-		for (i = 0; i <= svol->max_val; i++) {
-			double db = svol->min_dB +
-				(i * (svol->max_dB - svol->min_dB)) /
-					svol->max_val;
-			double v = (pow(10.0, db / 20.0) *
-					(double)(1 << VOL_SCALE_SHIFT));
-			svol->dB_value[i] = (unsigned int)v;
-		}
-		if (svol->zero_dB_val)
-			svol->dB_value[svol->zero_dB_val] = 65535;
 #else
 		SNDERR("Cannot handle the given dB range and resolution");
 		return -EINVAL;
@@ -983,6 +1463,24 @@ int snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 	return 0;
 }
 
+static int softvol_check_range(double min_dB, double max_dB, int resolution)
+{
+	if (min_dB >= 0) {
+		SNDERR("min_dB must be a negative value");
+		return -EINVAL;
+	}
+	if (max_dB <= min_dB || max_dB > MAX_DB_UPPER_LIMIT) {
+		SNDERR("max_dB must be larger than min_dB and less than %d dB",
+		       MAX_DB_UPPER_LIMIT);
+		return -EINVAL;
+	}
+	if (resolution <= 1 || resolution > 1024) {
+		SNDERR("Invalid resolution value %d", resolution);
+		return -EINVAL;
+	}
+	return 0;
+}
+
 static int _snd_pcm_parse_control_id(snd_config_t *conf, snd_ctl_elem_id_t *ctl_id,
 				     int *cardp, int *cchannels)
 {
@@ -1123,9 +1621,21 @@ pcm.name {
 	[max_dB REAL]           # maximal dB value (default:   0.0)
 	[resolution INT]        # resolution (default: 256)
 				# resolution = 2 means a mute switch
+	[ramp BOOL]             # ramp the gain over one period after
+				# a volume change (default: no)
+	[watch_ctl BOOL]        # follow the control from a background
+				# thread shared per card (default: no)
 }
 \endcode
 
+The control value is read on each transfer.  With \c watch_ctl, all
+softvol PCMs of the process on the same card share one background
+thread watching the control events, and the control is re-read only
+after a change, so the transfer path does no ctl syscall while the
+volume is unchanged.  With \c ramp enabled, a change is applied as a
+linear gain ramp over the following period instead of a step, which
+avoids clicks.
+
 \subsection pcm_plugins_softvol_funcref Function reference
 
 <UL>
@@ -1163,6 +1673,7 @@ int _snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 	double min_dB = PRESET_MIN_DB;
 	double max_dB = ZERO_DB;
 	int card = -1, cchannels = 2;
+	int ramp = 0, watch_ctl = 0;
 
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
@@ -1205,6 +1716,24 @@ int _snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 			}
 			continue;
 		}
+		if (strcmp(id, "ramp") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0) {
+				SNDERR("Invalid ramp value");
+				return err;
+			}
+			ramp = err;
+			continue;
+		}
+		if (strcmp(id, "watch_ctl") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0) {
+				SNDERR("Invalid watch_ctl value");
+				return err;
+			}
+			watch_ctl = err;
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -1216,19 +1745,9 @@ int _snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 		SNDERR("control is not defined");
 		return -EINVAL;
 	}
-	if (min_dB >= 0) {
-		SNDERR("min_dB must be a negative value");
-		return -EINVAL;
-	}
-	if (max_dB <= min_dB || max_dB > MAX_DB_UPPER_LIMIT) {
-		SNDERR("max_dB must be larger than min_dB and less than %d dB",
-		       MAX_DB_UPPER_LIMIT);
-		return -EINVAL;
-	}
-	if (resolution <= 1 || resolution > 1024) {
-		SNDERR("Invalid resolution value %d", resolution);
-		return -EINVAL;
-	}
+	err = softvol_check_range(min_dB, max_dB, resolution);
+	if (err < 0)
+		return err;
 	if (mode & SND_PCM_NO_SOFTVOL) {
 		err = snd_pcm_slave_conf(root, slave, &sconf, 0);
 		if (err < 0)
@@ -1266,9 +1785,175 @@ int _snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 					   resolution, spcm, 1);
 		if (err < 0)
 			snd_pcm_close(spcm);
+		else if ((*pcmp)->type == SND_PCM_TYPE_SOFTVOL) {
+			snd_pcm_softvol_t *svol = (*pcmp)->private_data;
+			svol->ramp = ramp;
+			if (watch_ctl)
+				softvol_watch_attach(svol);
+		}
 	}
 	return err;
 }
 #ifndef DOC_HIDDEN
 SND_DLSYM_BUILD_VERSION(_snd_pcm_softvol_open, SND_PCM_DLSYM_VERSION);
 #endif
+
+#ifndef DOC_HIDDEN
+/*
+ * Standalone gain source
+ *
+ * The plug plugin can apply the soft volume inside its route stage
+ * instead of stacking a softvol PCM on top of the chain.  The gain object
+ * owns the control exactly like the softvol PCM does; the route plugin
+ * only asks it for the per-channel scale factors once per transfer.
+ */
+struct snd_pcm_softvol_gain {
+	snd_pcm_softvol_t svol;
+};
+
+/*
+ * Creates the gain from a "volume" compound (control, min_dB, max_dB,
+ * resolution and watch_ctl as for the softvol PCM); the card of the control
+ * defaults to the card of pcm.  Sets *gainp to NULL when the control
+ * exists as a hardware one, so that no gain is needed.
+ */
+int snd_pcm_softvol_gain_open(snd_pcm_softvol_gain_t **gainp,
+			      snd_pcm_t *pcm, snd_config_t *conf)
+{
+	snd_config_iterator_t i, next;
+	snd_config_t *control = NULL;
+	snd_ctl_elem_id_t ctl_id = {0};
+	snd_pcm_softvol_gain_t *gain;
+	int resolution = PRESET_RESOLUTION;
+	double min_dB = PRESET_MIN_DB;
+	double max_dB = ZERO_DB;
+	int card = -1, cchannels = 2;
+	int watch_ctl = 0;
+	int err;
+
+	*gainp = NULL;
+	if (snd_config_get_type(conf) != SND_CONFIG_TYPE_COMPOUND) {
+		SNDERR("Invalid type for volume");
+		return -EINVAL;
+	}
+	snd_config_for_each(i, next, conf) {
+		snd_config_t *n = snd_config_iterator_entry(i);
+		const char *id;
+		if (snd_config_get_id(n, &id) < 0)
+			continue;
+		if (strcmp(id, "comment") == 0)
+			continue;
+		if (strcmp(id, "control") == 0) {
+			control = n;
+			continue;
+		}
+		if (strcmp(id, "resolution") == 0) {
+			long v;
+			err = snd_config_get_integer(n, &v);
+			if (err < 0) {
+				SNDERR("Invalid resolution value");
+				return err;
+			}
+			resolution = v;
+			continue;
+		}
+		if (strcmp(id, "min_dB") == 0) {
+			err = snd_config_get_real(n, &min_dB);
+			if (err < 0) {
+				SNDERR("Invalid min_dB value");
+				return err;
+			}
+			continue;
+		}
+		if (strcmp(id, "max_dB") == 0) {
+			err = snd_config_get_real(n, &max_dB);
+			if (err < 0) {
+				SNDERR("Invalid max_dB value");
+				return err;
+			}
+			continue;
+		}
+		if (strcmp(id, "watch_ctl") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0) {
+				SNDERR("Invalid watch_ctl value");
+				return err;
+			}
+			watch_ctl = err;
+			continue;
+		}
+		SNDERR("Unknown field %s", id);
+		return -EINVAL;
+	}
+	if (!control) {
+		SNDERR("control is not defined");
+		return -EINVAL;
+	}
+	err = softvol_check_range(min_dB, max_dB, resolution);
+	if (err < 0)
+		return err;
+	err = _snd_pcm_parse_control_id(control, &ctl_id, &card, &cchannels);
+	if (err < 0)
+		return err;
+
+	gain = calloc(1, sizeof(*gain));
+	if (!gain)
+		return -ENOMEM;
+	gain->svol.cchannels = cchannels;
+	err = softvol_load_control(pcm, &gain->svol, card, &ctl_id, cchannels,
+				   min_dB, max_dB, resolution);
+	if (err != 0) {
+		softvol_free(&gain->svol);
+		return err < 0 ? err : 0;
+	}
+	if (watch_ctl)
+		softvol_watch_attach(&gain->svol);
+	*gainp = gain;
+	return 0;
+}
+
+void snd_pcm_softvol_gain_close(snd_pcm_softvol_gain_t *gain)
+{
+	if (gain)
+		softvol_free(&gain->svol);
+}
+
+/*
+ * Fills the 16.16 scale factors of the given channels from the current
+ * control value (unity is exactly 0x10000); returns 1 when all of them
+ * are at unity.
+ */
+int snd_pcm_softvol_gain_scales(snd_pcm_softvol_gain_t *gain,
+				unsigned int *scales, unsigned int channels)
+{
+	snd_pcm_softvol_t *svol = &gain->svol;
+	unsigned int ch;
+	int unity = 1;
+
+	get_current_volume(svol);
+	for (ch = 0; ch < channels; ch++) {
+		unsigned int scale = softvol_channel_scale(svol, svol->cur_vol,
+							   ch, channels);
+		if (scale == 0xffff)
+			scale = 1 << VOL_SCALE_SHIFT;
+		else
+			unity = 0;
+		scales[ch] = scale;
+	}
+	return unity;
+}
+
+void snd_pcm_softvol_gain_dump(snd_pcm_softvol_gain_t *gain,
+			       snd_output_t *out)
+{
+	snd_pcm_softvol_t *svol = &gain->svol;
+
+	snd_output_printf(out, "  Gain control: %s", svol->elem.id.name);
+	if (svol->max_val == 1)
+		snd_output_printf(out, " (boolean)\n");
+	else
+		snd_output_printf(out, " (%g..%g dB, resolution %d)\n",
+				  svol->min_dB, svol->max_dB,
+				  svol->max_val + 1);
+}
+#endif /* DOC_HIDDEN */
@@ -0,0 +1,129 @@
+/*
+ *  PCM - shared read-only plugin tables
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Tables which depend only on the plugin parameters (the softvol dB
+ * curve, the polyphase filter bank) are computed once per process and
+ * shared by all the instances with the same parameters.  A table is
+ * looked up by its type and a key, a plain structure that holds the
+ * parameters and is compared byte by byte, so the callers clear it
+ * before filling it in.  The build callback runs once, under the
+ * registry lock, and the table is read-only from then on.  The last
+ * snd_pcm_table_put() frees it.
+ */
+
+#include "pcm_local.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+
+struct pcm_table {
+	struct list_head list;
+	const char *type;
+	void *key;
+	size_t key_size;
+	unsigned int refs;
+	void *data;
+};
+
+static LIST_HEAD(pcm_tables);
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t pcm_tables_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline void pcm_tables_lock(void)
+{
+	pthread_mutex_lock(&pcm_tables_mutex);
+}
+
+static inline void pcm_tables_unlock(void)
+{
+	pthread_mutex_unlock(&pcm_tables_mutex);
+}
+#else
+static inline void pcm_tables_lock(void) {}
+static inline void pcm_tables_unlock(void) {}
+#endif
+
+/*
+ * get a shared table of the given size, built by build() on the first
+ * use; the type string must stay valid, returns NULL on error
+ */
+const void *snd_pcm_table_get(const char *type, const void *key, size_t key_size,
+			      size_t size, snd_pcm_table_build_t build)
+{
+	struct list_head *pos;
+	struct pcm_table *t;
+	void *data = NULL;
+
+	pcm_tables_lock();
+	list_for_each(pos, &pcm_tables) {
+		t = list_entry(pos, struct pcm_table, list);
+		if (t->key_size == key_size && strcmp(t->type, type) == 0 &&
+		    memcmp(t->key, key, key_size) == 0) {
+			t->refs++;
+			data = t->data;
+			goto unlock;
+		}
+	}
+	t = calloc(1, sizeof(*t) + key_size);
+	if (!t)
+		goto unlock;
+	t->key = t + 1;
+	memcpy(t->key, key, key_size);
+	t->key_size = key_size;
+	t->type = type;
+	t->data = malloc(size);
+	if (!t->data || build(t->data, key) < 0) {
+		free(t->data);
+		free(t);
+		goto unlock;
+	}
+	t->refs = 1;
+	list_add(&t->list, &pcm_tables);
+	data = t->data;
+ unlock:
+	pcm_tables_unlock();
+	return data;
+}
+
+/* release a table from snd_pcm_table_get() */
+void snd_pcm_table_put(const void *data)
+{
+	struct list_head *pos;
+	struct pcm_table *t;
+
+	if (!data)
+		return;
+	pcm_tables_lock();
+	list_for_each(pos, &pcm_tables) {
+		t = list_entry(pos, struct pcm_table, list);
+		if (t->data != data)
+			continue;
+		if (--t->refs == 0) {
+			list_del(&t->list);
+			free(t->data);
+			free(t);
+		}
+		break;
+	}
+	pcm_tables_unlock();
+}
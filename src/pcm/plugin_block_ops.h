@@ -0,0 +1,234 @@
+/*
+ *  Plugin sample operators for contiguous interleaved blocks
+ *
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * The label tables in plugin_ops.h convert one sample per jump, walking
+ * each channel separately.  For the common case where both sides are
+ * plain interleaved buffers, the whole run of frames * channels samples
+ * is one contiguous array; the kernels below convert such a run in a
+ * single straight loop which the compiler turns into SIMD code (SSE2 on
+ * x86-64, NEON on aarch64).  The results are bit-exact with the label
+ * tables; everything else (non-interleaved areas, odd formats) still
+ * goes through plugin_ops.h.
+ */
+
+#ifndef __PLUGIN_BLOCK_OPS_H
+#define __PLUGIN_BLOCK_OPS_H
+
+#include "bswap.h"
+
+typedef void (*snd_pcm_block_conv_func_t)(void *dst, const void *src, size_t samples);
+
+typedef struct {
+	snd_pcm_format_t src_format;
+	snd_pcm_format_t dst_format;
+	unsigned int src_width;		/* physical width in bits */
+	unsigned int dst_width;
+	snd_pcm_block_conv_func_t func;
+} snd_pcm_block_conv_t;
+
+#define BLOCK_CONV(name, stype, dtype, expr) \
+static SND_VECTORIZE void block_conv_##name(void *dst, const void *src, size_t samples) \
+{ \
+	const stype *__restrict s = src; \
+	dtype *__restrict d = dst; \
+	size_t i; \
+	for (i = 0; i < samples; i++) { \
+		stype v = s[i]; \
+		d[i] = (expr); \
+	} \
+}
+
+/* h = host endian, s = swapped */
+BLOCK_CONV(16h_32h, uint16_t, uint32_t, (uint32_t)v << 16)
+BLOCK_CONV(16s_32h, uint16_t, uint32_t, (uint32_t)bswap_16(v) << 16)
+BLOCK_CONV(16h_32s, uint16_t, uint32_t, bswap_32((uint32_t)v << 16))
+BLOCK_CONV(32h_16h, uint32_t, uint16_t, v >> 16)
+BLOCK_CONV(32s_16h, uint32_t, uint16_t, bswap_32(v) >> 16)
+BLOCK_CONV(32h_16s, uint32_t, uint16_t, bswap_16(v >> 16))
+BLOCK_CONV(16h_16s, uint16_t, uint16_t, bswap_16(v))
+BLOCK_CONV(32h_32s, uint32_t, uint32_t, bswap_32(v))
+
+/* integer -> float, same scaling as put32f in plugin_ops.h */
+BLOCK_CONV(32h_fh, int32_t, float, (float)v / (float)0x80000000UL)
+BLOCK_CONV(16h_fh, uint16_t, float,
+	   (float)(int32_t)((uint32_t)v << 16) / (float)0x80000000UL)
+
+/* float -> integer, same clipping as get32f in plugin_ops.h */
+#define block_float_s32(f) \
+	((f) >= 1.0f ? (int32_t)0x7fffffff : \
+	 (f) <= -1.0f ? (int32_t)0x80000000 : \
+	 (int32_t)((f) * (float)0x80000000UL))
+BLOCK_CONV(fh_32h, float, int32_t, block_float_s32(v))
+BLOCK_CONV(fh_16h, float, uint16_t, (uint32_t)block_float_s32(v) >> 16)
+
+/* packed 24-bit, three bytes per sample */
+static SND_VECTORIZE void block_conv_24le_32h(void *dst, const void *src, size_t samples)
+{
+	const uint8_t *__restrict s = src;
+	uint32_t *__restrict d = dst;
+	size_t i;
+	for (i = 0; i < samples; i++, s += 3)
+		d[i] = ((uint32_t)s[0] << 8) | ((uint32_t)s[1] << 16) |
+		       ((uint32_t)s[2] << 24);
+}
+
+static SND_VECTORIZE void block_conv_24be_32h(void *dst, const void *src, size_t samples)
+{
+	const uint8_t *__restrict s = src;
+	uint32_t *__restrict d = dst;
+	size_t i;
+	for (i = 0; i < samples; i++, s += 3)
+		d[i] = ((uint32_t)s[2] << 8) | ((uint32_t)s[1] << 16) |
+		       ((uint32_t)s[0] << 24);
+}
+
+static SND_VECTORIZE void block_conv_32h_24le(void *dst, const void *src, size_t samples)
+{
+	const uint32_t *__restrict s = src;
+	uint8_t *__restrict d = dst;
+	size_t i;
+	for (i = 0; i < samples; i++, d += 3) {
+		uint32_t v = s[i];
+		d[0] = v >> 8;
+		d[1] = v >> 16;
+		d[2] = v >> 24;
+	}
+}
+
+static SND_VECTORIZE void block_conv_32h_24be(void *dst, const void *src, size_t samples)
+{
+	const uint32_t *__restrict s = src;
+	uint8_t *__restrict d = dst;
+	size_t i;
+	for (i = 0; i < samples; i++, d += 3) {
+		uint32_t v = s[i];
+		d[0] = v >> 24;
+		d[1] = v >> 16;
+		d[2] = v >> 8;
+	}
+}
+
+#undef block_float_s32
+#undef BLOCK_CONV
+
+#ifdef SND_LITTLE_ENDIAN
+#define BLOCK_S16S	SND_PCM_FORMAT_S16_BE
+#define BLOCK_S32S	SND_PCM_FORMAT_S32_BE
+#else
+#define BLOCK_S16S	SND_PCM_FORMAT_S16_LE
+#define BLOCK_S32S	SND_PCM_FORMAT_S32_LE
+#endif
+
+static const snd_pcm_block_conv_t snd_pcm_block_convs[] = {
+	{ SND_PCM_FORMAT_S16, SND_PCM_FORMAT_S32, 16, 32, block_conv_16h_32h },
+	{ BLOCK_S16S, SND_PCM_FORMAT_S32, 16, 32, block_conv_16s_32h },
+	{ SND_PCM_FORMAT_S16, BLOCK_S32S, 16, 32, block_conv_16h_32s },
+	{ SND_PCM_FORMAT_S32, SND_PCM_FORMAT_S16, 32, 16, block_conv_32h_16h },
+	{ BLOCK_S32S, SND_PCM_FORMAT_S16, 32, 16, block_conv_32s_16h },
+	{ SND_PCM_FORMAT_S32, BLOCK_S16S, 32, 16, block_conv_32h_16s },
+	{ SND_PCM_FORMAT_S16, BLOCK_S16S, 16, 16, block_conv_16h_16s },
+	{ BLOCK_S16S, SND_PCM_FORMAT_S16, 16, 16, block_conv_16h_16s },
+	{ SND_PCM_FORMAT_S32, BLOCK_S32S, 32, 32, block_conv_32h_32s },
+	{ BLOCK_S32S, SND_PCM_FORMAT_S32, 32, 32, block_conv_32h_32s },
+	{ SND_PCM_FORMAT_S24_3LE, SND_PCM_FORMAT_S32, 24, 32, block_conv_24le_32h },
+	{ SND_PCM_FORMAT_S24_3BE, SND_PCM_FORMAT_S32, 24, 32, block_conv_24be_32h },
+	{ SND_PCM_FORMAT_S32, SND_PCM_FORMAT_S24_3LE, 32, 24, block_conv_32h_24le },
+	{ SND_PCM_FORMAT_S32, SND_PCM_FORMAT_S24_3BE, 32, 24, block_conv_32h_24be },
+	{ SND_PCM_FORMAT_S32, SND_PCM_FORMAT_FLOAT, 32, 32, block_conv_32h_fh },
+	{ SND_PCM_FORMAT_S16, SND_PCM_FORMAT_FLOAT, 16, 32, block_conv_16h_fh },
+	{ SND_PCM_FORMAT_FLOAT, SND_PCM_FORMAT_S32, 32, 32, block_conv_fh_32h },
+	{ SND_PCM_FORMAT_FLOAT, SND_PCM_FORMAT_S16, 32, 16, block_conv_fh_16h },
+};
+
+#undef BLOCK_S16S
+#undef BLOCK_S32S
+
+/* returns the block converter for the given format pair, or NULL */
+static inline const snd_pcm_block_conv_t *
+snd_pcm_block_conv_find(snd_pcm_format_t src_format, snd_pcm_format_t dst_format)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(snd_pcm_block_convs) / sizeof(snd_pcm_block_convs[0]); i++) {
+		const snd_pcm_block_conv_t *conv = &snd_pcm_block_convs[i];
+		if (conv->src_format == src_format && conv->dst_format == dst_format)
+			return conv;
+	}
+	return NULL;
+}
+
+/*
+ * returns the start of the interleaved run described by areas,
+ * or NULL if the channels are not packed back to back in one buffer
+ */
+static inline char *snd_pcm_block_areas_addr(const snd_pcm_channel_area_t *areas,
+					     snd_pcm_uframes_t offset,
+					     unsigned int channels,
+					     unsigned int width)
+{
+	unsigned int channel;
+
+	if (areas[0].first % 8)
+		return NULL;
+	for (channel = 0; channel < channels; channel++) {
+		const snd_pcm_channel_area_t *area = &areas[channel];
+		if (area->addr != areas[0].addr ||
+		    area->first != areas[0].first + channel * width ||
+		    area->step != channels * width)
+			return NULL;
+	}
+	return snd_pcm_channel_area_addr(&areas[0], offset);
+}
+
+/*
+ * converts frames from src_areas to dst_areas in one pass;
+ * returns 0 if the layout is not suitable and the caller
+ * has to fall back to the per-channel label tables
+ */
+static inline int snd_pcm_block_convert(const snd_pcm_block_conv_t *conv,
+					const snd_pcm_channel_area_t *dst_areas,
+					snd_pcm_uframes_t dst_offset,
+					const snd_pcm_channel_area_t *src_areas,
+					snd_pcm_uframes_t src_offset,
+					unsigned int channels,
+					snd_pcm_uframes_t frames)
+{
+	const char *src;
+	char *dst;
+	size_t samples = (size_t)frames * channels;
+
+	if (!conv)
+		return 0;
+	src = snd_pcm_block_areas_addr(src_areas, src_offset, channels, conv->src_width);
+	if (!src)
+		return 0;
+	dst = snd_pcm_block_areas_addr(dst_areas, dst_offset, channels, conv->dst_width);
+	if (!dst)
+		return 0;
+	/* the kernels assume the two runs do not overlap */
+	if (dst < src + samples * conv->src_width / 8 &&
+	    src < dst + samples * conv->dst_width / 8)
+		return 0;
+	conv->func(dst, src, samples);
+	return 1;
+}
+
+#endif /* __PLUGIN_BLOCK_OPS_H */
@@ -32,6 +32,7 @@ typedef struct _snd_pcm_scope_level_channel {
 	int16_t level;
 	int16_t peak;
 	unsigned int peak_age;
+	unsigned long long pos;		/* in the meter level blocks */
 } snd_pcm_scope_level_channel_t;
 
 typedef struct _snd_pcm_scope_level {
@@ -120,8 +121,14 @@ static void level_update(snd_pcm_scope_t *scope)
 		int s, lev = 0;
 		snd_pcm_uframes_t n;
 		snd_pcm_scope_level_channel_t *l;
+		snd_pcm_meter_level_t mlev;
 		unsigned int lev_pos, peak_pos;
 		l = &level->channels[c];
+		/* use the levels kept by the meter when it has them */
+		if (snd_pcm_meter_get_levels(pcm, c, &l->pos, &mlev) >= 0) {
+			lev = mlev.peak > 32767 ? 32767 : mlev.peak;
+			goto _level;
+		}
 		ptr = snd_pcm_scope_s16_get_channel_buffer(level->s16, c) + offset;
 		for (n = size1; n > 0; n--) {
 			s = *ptr;
@@ -140,6 +147,7 @@ static void level_update(snd_pcm_scope_t *scope)
 				lev = s;
 			ptr++;
 		}
+	_level:
 		l->level = lev;
 		l->peak_age += ms;
 		if (l->peak_age >= level->peak_ms ||
@@ -125,6 +125,12 @@ the kernel implementation (linux kernel 5.14+) and exports
 the \link ::snd_rawmidi_tread() \endlink  function which returns the
 midi bytes marked with the identical timestamp in one iteration.
 
+When the input is dense, \link ::snd_rawmidi_tread_frames() \endlink
+returns many timestamped frames parsed from a single read from the kernel.
+Applications which read the raw frame buffer using
+\link ::snd_rawmidi_read() \endlink can walk it with
+\link ::snd_rawmidi_tframe_next() \endlink.
+
 The timestamping is available only on input streams.
 
 \section rawmidi_examples Examples
@@ -431,7 +437,10 @@ int snd_rawmidi_poll_descriptors(snd_rawmidi_t *rawmidi, struct pollfd *pfds, un
 	assert(rawmidi);
 	if (space >= 1) {
 		pfds->fd = rawmidi->poll_fd;
-		pfds->events = rawmidi->stream == SND_RAWMIDI_STREAM_OUTPUT ? (POLLOUT|POLLERR|POLLNVAL) : (POLLIN|POLLERR|POLLNVAL);
+		if (rawmidi->poll_events)
+			pfds->events = rawmidi->poll_events | POLLERR | POLLNVAL;
+		else
+			pfds->events = rawmidi->stream == SND_RAWMIDI_STREAM_OUTPUT ? (POLLOUT|POLLERR|POLLNVAL) : (POLLIN|POLLERR|POLLNVAL);
 		return 1;
 	}
 	return 0;
@@ -450,6 +459,13 @@ int snd_rawmidi_poll_descriptors_revents(snd_rawmidi_t *rawmidi, struct pollfd *
         assert(rawmidi && pfds && revents);
         if (nfds == 1) {
                 *revents = pfds->revents;
+		/* plugins signalling output space with POLLIN */
+		if (rawmidi->poll_events && rawmidi->stream == SND_RAWMIDI_STREAM_OUTPUT &&
+		    (*revents & POLLIN))
+			*revents = (*revents & ~POLLIN) | POLLOUT;
+		/* bytes already read ahead from the device */
+		if (rawmidi->read_ahead && rawmidi->ops->buffered(rawmidi) > 0)
+			*revents |= POLLIN;
                 return 0;
         }
         return -EINVAL;
@@ -910,6 +926,51 @@ snd_rawmidi_clock_t snd_rawmidi_params_get_clock_type(const snd_rawmidi_params_t
 	return (params->mode & SNDRV_RAWMIDI_MODE_CLOCK_MASK) >> SNDRV_RAWMIDI_MODE_CLOCK_SHIFT;
 }
 
+/**
+ * \brief set the read ahead buffer size for the standard read mode
+ * \param rawmidi RawMidi handle
+ * \param params pointer to snd_rawmidi_params_t structure
+ * \param val buffer size in bytes, 0 = no read ahead (default)
+ * \return 0 on success, otherwise a negative error code.
+ *
+ * With a read ahead buffer, #snd_rawmidi_read() calls smaller than it
+ * fill it with one system call and take the following bytes from memory,
+ * so that a parser reading one message at a time does not do one read
+ * per message. poll() cannot see the bytes already taken from the
+ * device: #snd_rawmidi_poll_descriptors_revents() and
+ * #snd_rawmidi_status() count them, but the application should read
+ * until -EAGAIN (or a short read) before it waits in poll() again.
+ *
+ * Notable error codes:
+ * -EINVAL - "val" is too large
+ * -ENOTSUP - not an input stream or the plugin does not buffer
+ *
+ */
+int snd_rawmidi_params_set_read_ahead(const snd_rawmidi_t *rawmidi, snd_rawmidi_params_t *params, size_t val)
+{
+	unsigned int size = val;
+
+	assert(rawmidi && params);
+	if (size != val)
+		return -EINVAL;
+	if (val && (rawmidi->stream != SND_RAWMIDI_STREAM_INPUT ||
+		    rawmidi->ops->buffered == NULL))
+		return -ENOTSUP;
+	memcpy(params->reserved, &size, sizeof(size));
+	return 0;
+}
+
+/**
+ * \brief get the read ahead buffer size
+ * \param params pointer to snd_rawmidi_params_t structure
+ * \return the buffer size in bytes, 0 = no read ahead
+ */
+size_t snd_rawmidi_params_get_read_ahead(const snd_rawmidi_params_t *params)
+{
+	assert(params);
+	return snd_rawmidi_params_read_ahead(params);
+}
+
 
 /**
  * \brief set parameters about rawmidi stream
@@ -929,6 +990,7 @@ int snd_rawmidi_params(snd_rawmidi_t *rawmidi, snd_rawmidi_params_t * params)
 	rawmidi->avail_min = params->avail_min;
 	rawmidi->no_active_sensing = params->no_active_sensing;
 	rawmidi->params_mode = rawmidi->version < SNDRV_PROTOCOL_VERSION(2, 0, 2) ? 0 : params->mode;
+	rawmidi->read_ahead = rawmidi->ops->buffered ? snd_rawmidi_params_read_ahead(params) : 0;
 	return 0;
 }
 
@@ -946,6 +1008,7 @@ int snd_rawmidi_params_current(snd_rawmidi_t *rawmidi, snd_rawmidi_params_t *par
 	params->avail_min = rawmidi->avail_min;
 	params->no_active_sensing = rawmidi->no_active_sensing;
 	params->mode = rawmidi->params_mode;
+	snd_rawmidi_params_set_read_ahead(rawmidi, params, rawmidi->read_ahead);
 	return 0;
 }
 
@@ -1120,3 +1183,62 @@ ssize_t snd_rawmidi_tread(snd_rawmidi_t *rawmidi, struct timespec *tstamp, void
 		return -ENOTSUP;
 	return (rawmidi->ops->tread)(rawmidi, tstamp, buffer, size);
 }
+
+/**
+ * \brief read timestamped MIDI frames from MIDI stream
+ * \param rawmidi RawMidi handle
+ * \param frames array to store the frames
+ * \param count count of entries in the frames array
+ * \retval count of returned frames otherwise a negative error code
+ *
+ * All frames come from one read of the kernel buffer, so a burst of
+ * input is returned with a single system call. Frames already buffered
+ * by a previous call (or by #snd_rawmidi_tread()) are returned first
+ * without reading again. Consecutive frames may carry the same timestamp.
+ */
+ssize_t snd_rawmidi_tread_frames(snd_rawmidi_t *rawmidi, snd_rawmidi_tframe_t *frames, size_t count)
+{
+	assert(rawmidi);
+	assert(rawmidi->stream == SND_RAWMIDI_STREAM_INPUT);
+	assert(frames || count == 0);
+	if ((rawmidi->params_mode & SNDRV_RAWMIDI_MODE_FRAMING_MASK) != SNDRV_RAWMIDI_MODE_FRAMING_TSTAMP)
+		return -EINVAL;
+	if (rawmidi->ops->tread_frames == NULL)
+		return -ENOTSUP;
+	return (rawmidi->ops->tread_frames)(rawmidi, frames, count);
+}
+
+/**
+ * \brief get the next MIDI frame from a timestamp framing buffer
+ * \param buffer frame buffer filled by #snd_rawmidi_read() in #SND_RAWMIDI_READ_TSTAMP mode
+ * \param size size of the buffer in bytes
+ * \param[in,out] pos offset of the next frame in bytes, start with 0
+ * \param[out] frame returned frame
+ * \retval 1 a frame is returned
+ * \retval 0 no more frames
+ * \retval -EINVAL corrupted frame, \p pos is moved past it
+ *
+ * Frames of unknown types are skipped.
+ */
+int snd_rawmidi_tframe_next(const void *buffer, size_t size, size_t *pos, snd_rawmidi_tframe_t *frame)
+{
+	const struct snd_rawmidi_framing_tstamp *f;
+
+	assert(buffer || size == 0);
+	assert(pos && frame);
+	while (*pos + sizeof(*f) <= size) {
+		f = (const struct snd_rawmidi_framing_tstamp *)((const char *)buffer + *pos);
+		*pos += sizeof(*f);
+		/* skip other frames */
+		if (f->frame_type != 0)
+			continue;
+		if (f->length == 0 || f->length > SNDRV_RAWMIDI_FRAMING_DATA_LENGTH)
+			return -EINVAL;
+		frame->tstamp.tv_sec = f->tv_sec;
+		frame->tstamp.tv_nsec = f->tv_nsec;
+		frame->length = f->length;
+		memcpy(frame->data, f->data, f->length);
+		return 1;
+	}
+	return 0;
+}
@@ -47,6 +47,7 @@ typedef struct {
 	size_t buf_fill;	/* filled buffer size in bytes */
 	size_t buf_pos;		/* offset to frame in the read buffer (bytes) */
 	size_t buf_fpos;	/* offset to the frame data array (bytes 0-16) */
+	int read_ahead;		/* buf holds plain bytes read ahead */
 } snd_rawmidi_hw_t;
 #endif
 
@@ -108,25 +109,37 @@ static int snd_rawmidi_hw_info(snd_rawmidi_t *rmidi, snd_rawmidi_info_t * info)
 static int snd_rawmidi_hw_params(snd_rawmidi_t *rmidi, snd_rawmidi_params_t * params)
 {
 	snd_rawmidi_hw_t *hw = rmidi->private_data;
+	snd_rawmidi_params_t kparams = *params;
+	size_t read_ahead;
 	int tstamp;
-	params->stream = rmidi->stream;
-	if (ioctl(hw->fd, SNDRV_RAWMIDI_IOCTL_PARAMS, params) < 0) {
+	kparams.stream = rmidi->stream;
+	memset(kparams.reserved, 0, sizeof(kparams.reserved));
+	if (ioctl(hw->fd, SNDRV_RAWMIDI_IOCTL_PARAMS, &kparams) < 0) {
 		SYSERR("SNDRV_RAWMIDI_IOCTL_PARAMS failed");
 		return -errno;
 	}
+	params->stream = rmidi->stream;
+	if (rmidi->stream != SND_RAWMIDI_STREAM_INPUT)
+		return 0;	/* the buffer is for the input side only */
 	buf_reset(hw);
 	tstamp = (params->mode & SNDRV_RAWMIDI_MODE_FRAMING_MASK) == SNDRV_RAWMIDI_MODE_FRAMING_TSTAMP;
-	if (hw->buf && !tstamp) {
+	read_ahead = tstamp ? 0 : snd_rawmidi_params_read_ahead(params);
+	hw->read_ahead = read_ahead > 0;
+	if (hw->buf && !tstamp && !read_ahead) {
 		free(hw->buf);
 		hw->buf = NULL;
 		hw->buf_size = 0;
-	} else if (tstamp) {
+	} else if (tstamp || read_ahead) {
 		size_t alloc_size;
 		void *buf;
 
-		alloc_size = page_size();
-		if (params->buffer_size > alloc_size)
-			alloc_size = params->buffer_size;
+		if (read_ahead) {
+			alloc_size = read_ahead;
+		} else {
+			alloc_size = page_size();
+			if (params->buffer_size > alloc_size)
+				alloc_size = params->buffer_size;
+		}
 		if (alloc_size != hw->buf_size) {
 			buf = realloc(hw->buf, alloc_size);
 			if (buf == NULL)
@@ -146,6 +159,8 @@ static int snd_rawmidi_hw_status(snd_rawmidi_t *rmidi, snd_rawmidi_status_t * st
 		SYSERR("SNDRV_RAWMIDI_IOCTL_STATUS failed");
 		return -errno;
 	}
+	if (hw->read_ahead && rmidi->stream == SND_RAWMIDI_STREAM_INPUT)
+		status->avail += hw->buf_fill;
 	return 0;
 }
 
@@ -186,12 +201,35 @@ static ssize_t snd_rawmidi_hw_read(snd_rawmidi_t *rmidi, void *buffer, size_t si
 {
 	snd_rawmidi_hw_t *hw = rmidi->private_data;
 	ssize_t result;
+
+	/* read ahead: reads smaller than the buffer go through it */
+	if (hw->read_ahead && (hw->buf_fill > 0 || size < hw->buf_size)) {
+		if (hw->buf_fill == 0) {
+			buf_reset(hw);
+			result = read(hw->fd, hw->buf, hw->buf_size);
+			if (result < 0)
+				return -errno;
+			hw->buf_fill = result;
+		}
+		result = size < hw->buf_fill ? size : hw->buf_fill;
+		memcpy(buffer, hw->buf + hw->buf_pos, result);
+		hw->buf_pos += result;
+		hw->buf_fill -= result;
+		return result;
+	}
 	result = read(hw->fd, buffer, size);
 	if (result < 0)
 		return -errno;
 	return result;
 }
 
+static size_t snd_rawmidi_hw_buffered(snd_rawmidi_t *rmidi)
+{
+	snd_rawmidi_hw_t *hw = rmidi->private_data;
+
+	return hw->read_ahead ? hw->buf_fill : 0;
+}
+
 static ssize_t read_from_ts_buf(snd_rawmidi_hw_t *hw, struct timespec *tstamp,
 				void *buffer, size_t size)
 {
@@ -272,6 +310,56 @@ static ssize_t snd_rawmidi_hw_tread(snd_rawmidi_t *rmidi, struct timespec *tstam
 	return ret + result;
 }
 
+static ssize_t snd_rawmidi_hw_tread_frames(snd_rawmidi_t *rmidi,
+					   snd_rawmidi_tframe_t *frames,
+					   size_t count)
+{
+	snd_rawmidi_hw_t *hw = rmidi->private_data;
+	snd_rawmidi_tframe_t *frame;
+	size_t pos, last, end, n = 0;
+	ssize_t ret;
+	int err = 0;
+
+	if (count == 0)
+		return 0;
+
+	/* refill only when no complete frame is buffered */
+	if (hw->buf_fill < sizeof(struct snd_rawmidi_framing_tstamp)) {
+		buf_reset(hw);
+		ret = read(hw->fd, hw->buf, hw->buf_size);
+		if (ret < 0)
+			return -errno;
+		if (ret < (ssize_t)sizeof(struct snd_rawmidi_framing_tstamp))
+			return 0;
+		hw->buf_fill = ret;
+	}
+
+	pos = last = hw->buf_pos;
+	end = hw->buf_pos + hw->buf_fill;
+	while (n < count) {
+		frame = &frames[n];
+		last = pos;
+		err = snd_rawmidi_tframe_next(hw->buf, end, &pos, frame);
+		if (err <= 0)
+			break;
+		if (hw->buf_fpos > 0) {
+			/* rest of a frame partially returned by tread */
+			frame->length -= hw->buf_fpos;
+			memmove(frame->data, frame->data + hw->buf_fpos, frame->length);
+			hw->buf_fpos = 0;
+		}
+		n++;
+	}
+	/* report a corrupted frame on the next call */
+	if (err < 0 && n > 0)
+		pos = last;
+	hw->buf_fill -= pos - hw->buf_pos;
+	hw->buf_pos = pos;
+	if (err < 0 && n == 0)
+		return err;
+	return n;
+}
+
 static const snd_rawmidi_ops_t snd_rawmidi_hw_ops = {
 	.close = snd_rawmidi_hw_close,
 	.nonblock = snd_rawmidi_hw_nonblock,
@@ -282,7 +370,9 @@ static const snd_rawmidi_ops_t snd_rawmidi_hw_ops = {
 	.drain = snd_rawmidi_hw_drain,
 	.write = snd_rawmidi_hw_write,
 	.read = snd_rawmidi_hw_read,
-	.tread = snd_rawmidi_hw_tread
+	.tread = snd_rawmidi_hw_tread,
+	.tread_frames = snd_rawmidi_hw_tread_frames,
+	.buffered = snd_rawmidi_hw_buffered
 };
 
 
@@ -35,6 +35,8 @@ typedef struct {
 	ssize_t (*write)(snd_rawmidi_t *rawmidi, const void *buffer, size_t size);
 	ssize_t (*read)(snd_rawmidi_t *rawmidi, void *buffer, size_t size);
 	ssize_t (*tread)(snd_rawmidi_t *rawmidi, struct timespec *tstamp, void *buffer, size_t size);
+	ssize_t (*tread_frames)(snd_rawmidi_t *rawmidi, snd_rawmidi_tframe_t *frames, size_t count);
+	size_t (*buffered)(snd_rawmidi_t *rawmidi);	/* input read ahead, optional */
 } snd_rawmidi_ops_t;
 
 struct _snd_rawmidi {
@@ -45,14 +47,28 @@ struct _snd_rawmidi {
 	int mode;
 	int version;
 	int poll_fd;
+	short poll_events;		/* events polled on poll_fd, 0 = default */
 	const snd_rawmidi_ops_t *ops;
 	void *private_data;
 	size_t buffer_size;
 	size_t avail_min;
 	unsigned int no_active_sensing: 1;
 	int params_mode;
+	size_t read_ahead;
 };
 
+/*
+ * the read ahead size is a library parameter: it is kept in the reserved
+ * bytes of snd_rawmidi_params_t, cleared before they go to the kernel
+ */
+static inline unsigned int snd_rawmidi_params_read_ahead(const snd_rawmidi_params_t *params)
+{
+	unsigned int val;
+
+	memcpy(&val, params->reserved, sizeof(val));
+	return val;
+}
+
 int snd_rawmidi_hw_open(snd_rawmidi_t **input, snd_rawmidi_t **output,
 			const char *name, int card, int device, int subdevice,
 			int mode);
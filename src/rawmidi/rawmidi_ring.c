@@ -0,0 +1,624 @@
+/*
+ *  RawMIDI - Ring buffer (in-process or shared memory loopback)
+ *
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "rawmidi_local.h"
+
+#ifndef PIC
+/* entry for static linking */
+const char *_snd_module_rawmidi_ring = "";
+#endif
+
+#define RING_MAGIC		0x524d5247	/* "RMRG" */
+#define RING_DEFAULT_SIZE	4096
+#define RING_MAX_SIZE		(1024 * 1024)
+
+#ifndef DOC_HIDDEN
+/*
+ * Single producer, single consumer byte ring.  head and tail are free
+ * running counters; only the writer stores head and only the reader
+ * stores tail, so no lock is needed.
+ *
+ * The doorbells only exist for poll() and blocking calls.  The writer
+ * rings data_bell when it finds it clear, the reader clears it (and
+ * drains the pipe) only after seeing an empty ring, so a busy stream
+ * costs no system calls.  space_bell works the same way the other
+ * direction.
+ */
+typedef struct {
+	unsigned int magic;
+	unsigned int size;		/* ring size in bytes (power of two) */
+	unsigned int head;		/* bytes written */
+	unsigned int tail;		/* bytes read */
+	unsigned int data_bell;		/* data_fd was signalled */
+	unsigned int space_bell;	/* space_fd was signalled */
+	unsigned int reserved[2];
+	unsigned char data[];
+} snd_rawmidi_ring_shm_t;
+
+typedef struct {
+	int open;
+	snd_rawmidi_ring_shm_t *shm;
+	size_t shm_size;
+	int shared;			/* shm is a mapped file */
+	int data_fd[2];			/* doorbell writer -> reader */
+	int space_fd[2];		/* doorbell reader -> writer */
+	int nonblock[2];		/* per stream */
+} snd_rawmidi_ring_t;
+#endif
+
+static inline unsigned int ring_load(unsigned int *p)
+{
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline void ring_store(unsigned int *p, unsigned int val)
+{
+	__atomic_store_n(p, val, __ATOMIC_RELEASE);
+}
+
+static void ring_bell_write(int fd)
+{
+	static const char c;
+
+	/* the pipe is never full, at most a few bytes are queued */
+	if (write(fd, &c, 1) < 0 && errno != EAGAIN)
+		SYSERR("ring doorbell write failed");
+}
+
+/*
+ * The fence orders the head/tail store of the caller before the bell
+ * load; against the fence in ring_bell_clear() either the peer sees the
+ * new index after clearing or the bell is seen clear here.
+ */
+static void ring_bell(unsigned int *bell, int fd)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(bell, __ATOMIC_SEQ_CST) ||
+	    __atomic_exchange_n(bell, 1, __ATOMIC_SEQ_CST))
+		return;
+	ring_bell_write(fd);
+}
+
+static void ring_bell_clear(unsigned int *bell, int fd)
+{
+	char buf[64];
+
+	while (read(fd, buf, sizeof(buf)) > 0)
+		;
+	__atomic_store_n(bell, 0, __ATOMIC_SEQ_CST);
+	/* the caller checks the index again after this */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static int ring_wait(int fd)
+{
+	struct pollfd pfd;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, -1) < 0)
+		return -errno;
+	return 0;
+}
+
+static void ring_close_fds(snd_rawmidi_ring_t *ring)
+{
+	if (ring->data_fd[0] >= 0)
+		close(ring->data_fd[0]);
+	if (ring->data_fd[1] >= 0 && ring->data_fd[1] != ring->data_fd[0])
+		close(ring->data_fd[1]);
+	if (ring->space_fd[0] >= 0)
+		close(ring->space_fd[0]);
+	if (ring->space_fd[1] >= 0 && ring->space_fd[1] != ring->space_fd[0])
+		close(ring->space_fd[1]);
+}
+
+static void ring_free(snd_rawmidi_ring_t *ring)
+{
+	ring_close_fds(ring);
+	if (ring->shm) {
+		if (ring->shared)
+			munmap(ring->shm, ring->shm_size);
+		else
+			free(ring->shm);
+	}
+	free(ring);
+}
+
+static int snd_rawmidi_ring_close(snd_rawmidi_t *rmidi)
+{
+	snd_rawmidi_ring_t *ring = rmidi->private_data;
+
+	ring->open--;
+	if (ring->open)
+		return 0;
+	ring_free(ring);
+	return 0;
+}
+
+static int snd_rawmidi_ring_nonblock(snd_rawmidi_t *rmidi, int nonblock)
+{
+	snd_rawmidi_ring_t *ring = rmidi->private_data;
+
+	ring->nonblock[rmidi->stream] = nonblock;
+	return 0;
+}
+
+static int snd_rawmidi_ring_info(snd_rawmidi_t *rmidi, snd_rawmidi_info_t *info)
+{
+	info->stream = rmidi->stream;
+	info->card = 0;
+	info->device = 0;
+	info->subdevice = 0;
+	info->flags = 0;
+	strcpy((char *)info->id, "Ring");
+	strcpy((char *)info->name, "Ring RawMIDI");
+	strcpy((char *)info->subname, "Ring RawMIDI");
+	info->subdevices_count = 1;
+	info->subdevices_avail = 0;
+	return 0;
+}
+
+static int snd_rawmidi_ring_params(snd_rawmidi_t *rmidi, snd_rawmidi_params_t *params)
+{
+	snd_rawmidi_ring_t *ring = rmidi->private_data;
+
+	params->stream = rmidi->stream;
+	/* the ring size is fixed when the ring is created */
+	params->buffer_size = ring->shm->size;
+	return 0;
+}
+
+static int snd_rawmidi_ring_status(snd_rawmidi_t *rmidi, snd_rawmidi_status_t *status)
+{
+	snd_rawmidi_ring_t *ring = rmidi->private_data;
+	snd_rawmidi_ring_shm_t *shm = ring->shm;
+	unsigned int used;
+
+	memset(status, 0, sizeof(*status));
+	status->stream = rmidi->stream;
+	used = ring_load(&shm->head) - ring_load(&shm->tail);
+	if (rmidi->stream == SND_RAWMIDI_STREAM_INPUT)
+		status->avail = used;
+	else
+		status->avail = shm->size - used;
+	return 0;
+}
+
+static int snd_rawmidi_ring_drop(snd_rawmidi_t *rmidi)
+{
+	snd_rawmidi_ring_t *ring = rmidi->private_data;
+	snd_rawmidi_ring_shm_t *shm = ring->shm;
+
+	/* only the reader may move the tail */
+	if (rmidi->stream == SND_RAWMIDI_STREAM_INPUT) {
+		ring_store(&shm->tail, ring_load(&shm->head));
+		ring_bell(&shm->space_bell, ring->space_fd[1]);
+	}
+	return 0;
+}
+
+static int snd_rawmidi_ring_drain(snd_rawmidi_t *rmidi)
+{
+	snd_rawmidi_ring_t *ring = rmidi->private_data;
+	snd_rawmidi_ring_shm_t *shm = ring->shm;
+	int err;
+
+	if (rmidi->stream == SND_RAWMIDI_STREAM_INPUT)
+		return snd_rawmidi_ring_drop(rmidi);
+	for (;;) {
+		if (ring_load(&shm->tail) == shm->head)
+			return 0;
+		ring_bell_clear(&shm->space_bell, ring->space_fd[0]);
+		if (ring_load(&shm->tail) == shm->head)
+			return 0;
+		err = ring_wait(ring->space_fd[0]);
+		if (err < 0)
+			return err;
+	}
+}
+
+static ssize_t snd_rawmidi_ring_write(snd_rawmidi_t *rmidi, const void *buffer, size_t size)
+{
+	snd_rawmidi_ring_t *ring = rmidi->private_data;
+	snd_rawmidi_ring_shm_t *shm = ring->shm;
+	unsigned int mask = shm->size - 1;
+	unsigned int head = shm->head;
+	size_t space, len, ofs;
+	ssize_t result = 0;
+	int err;
+
+	while (size > 0) {
+		space = shm->size - (head - ring_load(&shm->tail));
+		if (space == 0) {
+			if (result > 0 && ring->nonblock[rmidi->stream])
+				break;
+			ring_bell_clear(&shm->space_bell, ring->space_fd[0]);
+			if (shm->size - (head - ring_load(&shm->tail)) > 0)
+				continue;
+			if (ring->nonblock[rmidi->stream])
+				return -EAGAIN;
+			err = ring_wait(ring->space_fd[0]);
+			if (err < 0)
+				return result > 0 ? result : err;
+			continue;
+		}
+		len = size < space ? size : space;
+		ofs = head & mask;
+		if (ofs + len > shm->size) {
+			memcpy(shm->data + ofs, buffer, shm->size - ofs);
+			memcpy(shm->data, (const char *)buffer + shm->size - ofs,
+			       len - (shm->size - ofs));
+		} else {
+			memcpy(shm->data + ofs, buffer, len);
+		}
+		head += len;
+		ring_store(&shm->head, head);
+		ring_bell(&shm->data_bell, ring->data_fd[1]);
+		buffer = (const char *)buffer + len;
+		size -= len;
+		result += len;
+	}
+	return result;
+}
+
+static ssize_t snd_rawmidi_ring_read(snd_rawmidi_t *rmidi, void *buffer, size_t size)
+{
+	snd_rawmidi_ring_t *ring = rmidi->private_data;
+	snd_rawmidi_ring_shm_t *shm = ring->shm;
+	unsigned int mask = shm->size - 1;
+	unsigned int tail = shm->tail;
+	size_t avail, ofs;
+	int err;
+
+	if (size == 0)
+		return 0;
+	for (;;) {
+		avail = ring_load(&shm->head) - tail;
+		if (avail > 0)
+			break;
+		ring_bell_clear(&shm->data_bell, ring->data_fd[0]);
+		if (ring_load(&shm->head) != tail)
+			continue;
+		if (ring->nonblock[rmidi->stream])
+			return -EAGAIN;
+		err = ring_wait(ring->data_fd[0]);
+		if (err < 0)
+			return err;
+	}
+	if (size > avail)
+		size = avail;
+	ofs = tail & mask;
+	if (ofs + size > shm->size) {
+		memcpy(buffer, shm->data + ofs, shm->size - ofs);
+		memcpy((char *)buffer + shm->size - ofs, shm->data,
+		       size - (shm->size - ofs));
+	} else {
+		memcpy(buffer, shm->data + ofs, size);
+	}
+	ring_store(&shm->tail, tail + size);
+	ring_bell(&shm->space_bell, ring->space_fd[1]);
+	return size;
+}
+
+static const snd_rawmidi_ops_t snd_rawmidi_ring_ops = {
+	.close = snd_rawmidi_ring_close,
+	.nonblock = snd_rawmidi_ring_nonblock,
+	.info = snd_rawmidi_ring_info,
+	.params = snd_rawmidi_ring_params,
+	.status = snd_rawmidi_ring_status,
+	.drop = snd_rawmidi_ring_drop,
+	.drain = snd_rawmidi_ring_drain,
+	.write = snd_rawmidi_ring_write,
+	.read = snd_rawmidi_ring_read,
+};
+
+static int ring_open_fifo(const char *path, const char *suffix)
+{
+	char name[PATH_MAX];
+	int fd;
+
+	if (snprintf(name, sizeof(name), "%s.%s", path, suffix) >= (int)sizeof(name))
+		return -ENAMETOOLONG;
+	if (mkfifo(name, 0600) < 0 && errno != EEXIST) {
+		SYSERR("mkfifo %s failed", name);
+		return -errno;
+	}
+	/* O_RDWR never blocks in open() and keeps the FIFO alive */
+	fd = open(name, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0) {
+		SYSERR("open %s failed", name);
+		return -errno;
+	}
+	return fd;
+}
+
+static int ring_attach_file(snd_rawmidi_ring_t *ring, const char *path,
+			    unsigned int size)
+{
+	snd_rawmidi_ring_shm_t *shm;
+	struct stat st;
+	size_t shm_size;
+	int fd, err;
+
+	fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		SYSERR("open %s failed", path);
+		return -errno;
+	}
+	/* serialize the initialization between the peers */
+	if (flock(fd, LOCK_EX) < 0) {
+		err = -errno;
+		goto _err;
+	}
+	if (fstat(fd, &st) < 0) {
+		err = -errno;
+		goto _err;
+	}
+	if (st.st_size == 0) {
+		shm_size = sizeof(*shm) + size;
+		if (ftruncate(fd, shm_size) < 0) {
+			err = -errno;
+			goto _err;
+		}
+	} else {
+		shm_size = st.st_size;
+		if (shm_size <= sizeof(*shm)) {
+			err = -EINVAL;
+			goto _err;
+		}
+	}
+	shm = mmap(NULL, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (shm == MAP_FAILED) {
+		err = -errno;
+		goto _err;
+	}
+	if (st.st_size == 0) {
+		shm->size = size;
+		ring_store(&shm->magic, RING_MAGIC);
+	} else if (shm->magic != RING_MAGIC ||
+		   shm->size + sizeof(*shm) != shm_size) {
+		SNDERR("%s is not a rawmidi ring", path);
+		munmap(shm, shm_size);
+		err = -EINVAL;
+		goto _err;
+	}
+	flock(fd, LOCK_UN);
+	close(fd);
+	ring->shm = shm;
+	ring->shm_size = shm_size;
+	ring->shared = 1;
+
+	err = ring_open_fifo(path, "data");
+	if (err < 0)
+		return err;
+	ring->data_fd[0] = ring->data_fd[1] = err;
+	err = ring_open_fifo(path, "space");
+	if (err < 0)
+		return err;
+	ring->space_fd[0] = ring->space_fd[1] = err;
+	/*
+	 * FIFO contents are lost when the last peer closes while the bell
+	 * flags stay in the file; re-arm both bells (a spurious wakeup is
+	 * harmless)
+	 */
+	__atomic_store_n(&shm->data_bell, 1, __ATOMIC_SEQ_CST);
+	ring_bell_write(ring->data_fd[1]);
+	__atomic_store_n(&shm->space_bell, 1, __ATOMIC_SEQ_CST);
+	ring_bell_write(ring->space_fd[1]);
+	return 0;
+
+ _err:
+	close(fd);
+	return err;
+}
+
+static int ring_pipe(int fd[2])
+{
+	int i;
+
+	if (pipe(fd) < 0)
+		return -1;
+	for (i = 0; i < 2; i++) {
+		if (fcntl(fd[i], F_SETFL, O_NONBLOCK) < 0 ||
+		    fcntl(fd[i], F_SETFD, FD_CLOEXEC) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+static int ring_attach_local(snd_rawmidi_ring_t *ring, unsigned int size)
+{
+	ring->shm = calloc(1, sizeof(*ring->shm) + size);
+	if (ring->shm == NULL)
+		return -ENOMEM;
+	ring->shm->magic = RING_MAGIC;
+	ring->shm->size = size;
+	ring->shm_size = sizeof(*ring->shm) + size;
+	if (ring_pipe(ring->data_fd) < 0 || ring_pipe(ring->space_fd) < 0) {
+		SYSERR("pipe failed");
+		return -errno;
+	}
+	/* an empty ring is writable */
+	ring->shm->space_bell = 1;
+	ring_bell_write(ring->space_fd[1]);
+	return 0;
+}
+
+static snd_rawmidi_t *ring_new_handle(snd_rawmidi_ring_t *ring, const char *name,
+				      snd_rawmidi_stream_t stream, int mode)
+{
+	snd_rawmidi_t *rmidi;
+
+	rmidi = calloc(1, sizeof(*rmidi));
+	if (rmidi == NULL)
+		return NULL;
+	if (name)
+		rmidi->name = strdup(name);
+	rmidi->type = SND_RAWMIDI_TYPE_RING;
+	rmidi->stream = stream;
+	rmidi->mode = mode;
+	/* both doorbells signal readiness with POLLIN */
+	if (stream == SND_RAWMIDI_STREAM_INPUT) {
+		rmidi->poll_fd = ring->data_fd[0];
+	} else {
+		rmidi->poll_fd = ring->space_fd[0];
+		rmidi->poll_events = POLLIN;
+	}
+	rmidi->ops = &snd_rawmidi_ring_ops;
+	rmidi->private_data = ring;
+	ring->nonblock[stream] = !!(mode & SND_RAWMIDI_NONBLOCK);
+	ring->open++;
+	return rmidi;
+}
+
+/*! \page rawmidi RawMidi interface
+
+\section rawmidi_ring Ring RawMidi interface
+
+The "ring" plugin passes MIDI bytes through a lock-free ring buffer
+without a kernel round trip and without conversion to sequencer events.
+
+When both streams are opened in one call, the two handles form an
+in-process loopback pair which can be used from two threads:
+
+\code
+snd_rawmidi_t *in, *out;
+snd_rawmidi_open(&in, &out, "ring", 0);
+\endcode
+
+With the \c path option the ring is a shared file mapping, so it can
+be opened by different processes (or separate opens in one process).
+One side writes, the other side reads; each ring has a single writer
+and a single reader.
+
+\code
+rawmidi.loop {
+	type ring
+	path "/dev/shm/midi-loop"	# optional, share through this file
+	size 4096			# ring size in bytes (power of two)
+}
+\endcode
+
+Two FIFOs named after the file with \c .data and \c .space suffixes
+are used for poll() and blocking calls.
+*/
+
+int _snd_rawmidi_ring_open(snd_rawmidi_t **inputp, snd_rawmidi_t **outputp,
+			   char *name, snd_config_t *root ATTRIBUTE_UNUSED,
+			   snd_config_t *conf, int mode)
+{
+	snd_config_iterator_t i, next;
+	snd_rawmidi_ring_t *ring;
+	snd_rawmidi_t *in = NULL, *out = NULL;
+	const char *path = NULL;
+	long size = RING_DEFAULT_SIZE;
+	int err;
+
+	snd_config_for_each(i, next, conf) {
+		snd_config_t *n = snd_config_iterator_entry(i);
+		const char *id;
+		if (snd_config_get_id(n, &id) < 0)
+			continue;
+		if (snd_rawmidi_conf_generic_id(id))
+			continue;
+		if (strcmp(id, "path") == 0) {
+			err = snd_config_get_string(n, &path);
+			if (err < 0)
+				return err;
+			continue;
+		}
+		if (strcmp(id, "size") == 0) {
+			err = snd_config_get_integer(n, &size);
+			if (err < 0)
+				return err;
+			continue;
+		}
+		SNDERR("Unknown field %s", id);
+		return -EINVAL;
+	}
+	if (!inputp && !outputp)
+		return -EINVAL;
+	if (path && !*path)
+		path = NULL;
+	if (size < 16 || size > RING_MAX_SIZE || (size & (size - 1))) {
+		SNDERR("Invalid ring size %ld", size);
+		return -EINVAL;
+	}
+	if (!path && !(inputp && outputp)) {
+		SNDERR("ring without path needs both streams");
+		return -EINVAL;
+	}
+
+	ring = calloc(1, sizeof(*ring));
+	if (ring == NULL)
+		return -ENOMEM;
+	ring->data_fd[0] = ring->data_fd[1] = -1;
+	ring->space_fd[0] = ring->space_fd[1] = -1;
+	if (path)
+		err = ring_attach_file(ring, path, size);
+	else
+		err = ring_attach_local(ring, size);
+	if (err < 0)
+		goto _err;
+
+	if (inputp) {
+		in = ring_new_handle(ring, name, SND_RAWMIDI_STREAM_INPUT, mode);
+		if (in == NULL) {
+			err = -ENOMEM;
+			goto _err;
+		}
+		/* start with an empty buffer like a kernel device */
+		snd_rawmidi_ring_drop(in);
+	}
+	if (outputp) {
+		out = ring_new_handle(ring, name, SND_RAWMIDI_STREAM_OUTPUT, mode);
+		if (out == NULL) {
+			err = -ENOMEM;
+			goto _err;
+		}
+	}
+	if (inputp)
+		*inputp = in;
+	if (outputp)
+		*outputp = out;
+	return 0;
+
+ _err:
+	if (in) {
+		free(in->name);
+		free(in);
+	}
+	ring_free(ring);
+	return err;
+}
+
+#ifndef DOC_HIDDEN
+SND_DLSYM_BUILD_VERSION(_snd_rawmidi_ring_open, SND_RAWMIDI_DLSYM_VERSION);
+#endif
@@ -21,12 +21,14 @@
 #ifndef PIC
 
 extern const char *_snd_module_rawmidi_hw;
+extern const char *_snd_module_rawmidi_ring;
 #ifdef BUILD_SEQ
 extern const char *_snd_module_rawmidi_virt;
 #endif
 
 static const char **snd_rawmidi_open_objects[] = {
 	&_snd_module_rawmidi_hw,
+	&_snd_module_rawmidi_ring,
 #ifdef BUILD_SEQ
 	&_snd_module_rawmidi_virt
 #endif
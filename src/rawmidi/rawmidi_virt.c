@@ -36,6 +36,8 @@ const char *_snd_module_rawmidi_virt = "";
 
 
 #ifndef DOC_HIDDEN
+#define VIRT_IN_EVENTS	64	/* events taken by one input call */
+
 typedef struct {
 	int open;
 
@@ -45,6 +47,9 @@ typedef struct {
 	snd_midi_event_t *midi_event;
 
 	snd_seq_event_t *in_event;
+	snd_seq_event_t *in_ev[VIRT_IN_EVENTS];
+	unsigned int in_ev_pos;
+	unsigned int in_ev_count;
 	int in_buf_size;
 	int in_buf_ofs;
 	char *in_buf_ptr;
@@ -166,6 +171,7 @@ static int snd_rawmidi_virtual_drop(snd_rawmidi_t *rmidi)
 		snd_seq_drop_input(virt->handle);
 		snd_midi_event_reset_decode(virt->midi_event);
 		virt->in_buf_ofs = 0;
+		virt->in_ev_pos = virt->in_ev_count = 0;
 	}
 	return 0;
 }
@@ -237,18 +243,41 @@ static ssize_t snd_rawmidi_virtual_read(snd_rawmidi_t *rmidi, void *buffer, size
 {
 	snd_rawmidi_virtual_t *virt = rmidi->private_data;
 	ssize_t result = 0;
+	unsigned int n;
+	long len;
 	int size1, err;
 
 	while (size > 0) {
 		if (! virt->in_buf_ofs) {
-			err = snd_seq_event_input_pending(virt->handle, 1);
-			if (err <= 0 && result > 0)
-				return result;
-			err = snd_seq_event_input(virt->handle, &virt->in_event);
-			if (err < 0)
-				return result > 0 ? result : err;
+			if (virt->in_ev_pos == virt->in_ev_count) {
+				err = snd_seq_event_input_pending(virt->handle, 1);
+				if (err <= 0 && result > 0)
+					return result;
+				err = snd_seq_event_input_batch(virt->handle, virt->in_ev,
+								VIRT_IN_EVENTS);
+				if (err < 0)
+					return result > 0 ? result : err;
+				virt->in_ev_pos = 0;
+				virt->in_ev_count = err;
+			}
+
+			/* the whole messages go straight to the caller's buffer */
+			n = virt->in_ev_count - virt->in_ev_pos;
+			len = snd_midi_event_decode_multi(virt->midi_event, buffer, size,
+							  virt->in_ev + virt->in_ev_pos, &n);
+			virt->in_ev_pos += n;
+			if (len > 0) {
+				size -= len;
+				result += len;
+				buffer += len;
+			}
+			if (virt->in_ev_pos == virt->in_ev_count || size == 0)
+				continue;
 
+			/* the next one does not fit, pass it in pieces */
+			virt->in_event = virt->in_ev[virt->in_ev_pos++];
 			if (virt->in_event->type == SND_SEQ_EVENT_SYSEX) {
+				snd_midi_event_reset_decode(virt->midi_event);
 				virt->in_buf_ptr = virt->in_event->data.ext.ptr;
 				virt->in_buf_size = virt->in_event->data.ext.len;
 			} else {
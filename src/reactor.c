@@ -0,0 +1,631 @@
+/**
+ * \file reactor.c
+ * \brief Servicing many handles from one thread
+ * \date 2026
+ */
+/*
+ *  Reactor servicing many PCM, control and sequencer handles
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "pcm/pcm_local.h"
+#include "control/control_local.h"
+#include <sys/epoll.h>
+
+#ifndef DOC_HIDDEN
+typedef enum {
+	SND_REACTOR_FD,
+	SND_REACTOR_PCM,
+	SND_REACTOR_CTL,
+	SND_REACTOR_SEQ,
+} snd_reactor_type_t;
+
+/* one registered descriptor, the epoll data points here */
+struct reactor_slot {
+	snd_reactor_handle_t *handle;
+	int fd;			/* registered descriptor */
+	unsigned int dup: 1;	/* fd is our own dup of a shared descriptor */
+	unsigned int always: 1;	/* refused by epoll (regular file): always ready */
+};
+
+struct _snd_reactor_handle {
+	snd_reactor_t *reactor;
+	struct list_head list;		/* reactor->handles */
+	struct list_head ready;		/* reactor->ready while pending */
+	snd_reactor_type_t type;
+	union {
+		int fd;
+#ifdef BUILD_PCM
+		snd_pcm_t *pcm;
+#endif
+		snd_ctl_t *ctl;
+#ifdef BUILD_SEQ
+		snd_seq_t *seq;
+#endif
+	} u;
+	unsigned short events;		/* fd and seq handles */
+	unsigned int serial;		/* pcm->wait_serial of the registered set */
+	unsigned int npfds;
+	struct pollfd *pfds;
+	struct reactor_slot *slots;
+	unsigned int nalways;
+	unsigned int failed: 1;		/* descriptors could not be queried */
+	snd_reactor_callback_t callback;
+	void *private_data;
+};
+
+struct _snd_reactor {
+	int epfd;
+	struct list_head handles;
+	struct list_head ready;
+	struct epoll_event *events;
+	unsigned int events_size;
+	unsigned int nslots;
+	unsigned int nalways;
+};
+#endif
+
+/**
+ * \brief Creates a reactor.
+ * \param reactor The function puts the pointer to the new reactor
+ *                at the address specified by \p reactor.
+ * \result Zero if successful, otherwise a negative error code.
+ *
+ * A reactor owns one epoll instance.  PCM, control, sequencer handles and
+ * plain file descriptors are registered once with #snd_reactor_add_pcm,
+ * #snd_reactor_add_ctl, #snd_reactor_add_seq and #snd_reactor_add_fd;
+ * #snd_reactor_dispatch then waits for all of them and calls the callbacks
+ * of the ready ones.  This replaces merging the descriptors of many handles
+ * into one poll() set and mapping the revents back in the application.
+ *
+ * A reactor is not thread-safe: register, delete and dispatch from one
+ * thread.
+ */
+int snd_reactor_open(snd_reactor_t **reactor)
+{
+	snd_reactor_t *r;
+
+	assert(reactor);
+	r = calloc(1, sizeof(*r));
+	if (!r)
+		return -ENOMEM;
+	r->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (r->epfd < 0) {
+		int err = -errno;
+		SYSERR("epoll_create1");
+		free(r);
+		return err;
+	}
+	INIT_LIST_HEAD(&r->handles);
+	INIT_LIST_HEAD(&r->ready);
+	*reactor = r;
+	return 0;
+}
+
+/**
+ * \brief Deletes a reactor.
+ * \param reactor Handle of the reactor to delete.
+ * \result Zero if successful, otherwise a negative error code.
+ *
+ * All the handles still registered are deleted; the PCM, control and
+ * sequencer handles themselves are not closed.
+ */
+int snd_reactor_close(snd_reactor_t *reactor)
+{
+	assert(reactor);
+	while (!list_empty(&reactor->handles))
+		snd_reactor_del(list_entry(reactor->handles.next,
+					   snd_reactor_handle_t, list));
+	close(reactor->epfd);
+	free(reactor->events);
+	free(reactor);
+	return 0;
+}
+
+static void reactor_unregister(snd_reactor_handle_t *h)
+{
+	snd_reactor_t *r = h->reactor;
+	unsigned int i;
+
+	for (i = 0; i < h->npfds; i++) {
+		struct reactor_slot *slot = &h->slots[i];
+		if (slot->always) {
+			r->nalways--;
+			continue;
+		}
+		/* a closed descriptor is already gone from the epoll set */
+		epoll_ctl(r->epfd, EPOLL_CTL_DEL, slot->fd, NULL);
+		if (slot->dup)
+			close(slot->fd);
+	}
+	r->nslots -= h->npfds;
+	h->nalways = 0;
+	h->npfds = 0;
+}
+
+static int reactor_register(snd_reactor_handle_t *h)
+{
+	snd_reactor_t *r = h->reactor;
+	unsigned int i;
+	int err;
+
+	for (i = 0; i < h->npfds; i++) {
+		struct reactor_slot *slot = &h->slots[i];
+		struct epoll_event ev;
+
+		memset(slot, 0, sizeof(*slot));
+		slot->handle = h;
+		slot->fd = h->pfds[i].fd;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = h->pfds[i].events;	/* POLL* and EPOLL* bits are the same */
+		ev.data.ptr = slot;
+		if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, slot->fd, &ev) == 0)
+			continue;
+		if (errno == EEXIST) {
+			/* another handle polls the same file: register a dup */
+			int fd = dup(slot->fd);
+			if (fd >= 0 &&
+			    epoll_ctl(r->epfd, EPOLL_CTL_ADD, fd, &ev) == 0) {
+				slot->fd = fd;
+				slot->dup = 1;
+				continue;
+			}
+			if (fd >= 0)
+				close(fd);
+		} else if (errno == EPERM) {
+			/* poll() reports regular files always ready */
+			slot->always = 1;
+			h->nalways++;
+			r->nalways++;
+			continue;
+		}
+		err = -errno;
+		SYSERR("epoll_ctl EPOLL_CTL_ADD failed");
+		h->npfds = i;
+		r->nslots += i;
+		reactor_unregister(h);
+		return err;
+	}
+	r->nslots += h->npfds;
+	if (r->nslots > r->events_size) {
+		struct epoll_event *events;
+		events = realloc(r->events, r->nslots * sizeof(*events));
+		if (!events) {
+			reactor_unregister(h);
+			return -ENOMEM;
+		}
+		r->events = events;
+		r->events_size = r->nslots;
+	}
+	return 0;
+}
+
+/* gather the current descriptors of the handle */
+static int reactor_query(snd_reactor_handle_t *h, struct pollfd **pfds)
+{
+	int count, err;
+
+	switch (h->type) {
+#ifdef BUILD_PCM
+	case SND_REACTOR_PCM:
+		h->serial = h->u.pcm->wait_serial;
+		count = snd_pcm_poll_descriptors_count(h->u.pcm);
+		break;
+#endif
+	case SND_REACTOR_CTL:
+		count = snd_ctl_poll_descriptors_count(h->u.ctl);
+		break;
+#ifdef BUILD_SEQ
+	case SND_REACTOR_SEQ:
+		count = snd_seq_poll_descriptors_count(h->u.seq, h->events);
+		break;
+#endif
+	default:
+		count = 1;
+		break;
+	}
+	if (count <= 0)
+		return count < 0 ? count : -EIO;
+	*pfds = calloc(count, sizeof(**pfds));
+	if (!*pfds)
+		return -ENOMEM;
+	switch (h->type) {
+#ifdef BUILD_PCM
+	case SND_REACTOR_PCM:
+		err = snd_pcm_poll_descriptors(h->u.pcm, *pfds, count);
+		break;
+#endif
+	case SND_REACTOR_CTL:
+		err = snd_ctl_poll_descriptors(h->u.ctl, *pfds, count);
+		break;
+#ifdef BUILD_SEQ
+	case SND_REACTOR_SEQ:
+		err = snd_seq_poll_descriptors(h->u.seq, *pfds, count, h->events);
+		break;
+#endif
+	default:
+		(*pfds)->fd = h->u.fd;
+		(*pfds)->events = h->events;
+		err = 1;
+		break;
+	}
+	if (err >= 0 && err != count)
+		err = -EIO;
+	if (err < 0) {
+		free(*pfds);
+		*pfds = NULL;
+		return err;
+	}
+	return count;
+}
+
+/* (re)register the current descriptors of the handle */
+static int reactor_refresh(snd_reactor_handle_t *h)
+{
+	struct pollfd *pfds;
+	struct reactor_slot *slots;
+	int count;
+
+	reactor_unregister(h);
+	count = reactor_query(h, &pfds);
+	if (count < 0)
+		return count;
+	slots = calloc(count, sizeof(*slots));
+	if (!slots) {
+		free(pfds);
+		return -ENOMEM;
+	}
+	free(h->pfds);
+	free(h->slots);
+	h->pfds = pfds;
+	h->slots = slots;
+	h->npfds = count;
+	return reactor_register(h);
+}
+
+static int reactor_add(snd_reactor_t *reactor, snd_reactor_handle_t **handle,
+		       snd_reactor_handle_t *h)
+{
+	int err;
+
+	assert(reactor && handle && h->callback);
+	h->reactor = reactor;
+	INIT_LIST_HEAD(&h->ready);
+	err = reactor_refresh(h);
+	if (err < 0) {
+		free(h->pfds);
+		free(h->slots);
+		free(h);
+		return err;
+	}
+	list_add_tail(&h->list, &reactor->handles);
+	*handle = h;
+	return 0;
+}
+
+static snd_reactor_handle_t *reactor_handle_new(snd_reactor_type_t type,
+						snd_reactor_callback_t callback,
+						void *private_data)
+{
+	snd_reactor_handle_t *h = calloc(1, sizeof(*h));
+
+	if (!h)
+		return NULL;
+	h->type = type;
+	h->callback = callback;
+	h->private_data = private_data;
+	return h;
+}
+
+/**
+ * \brief Registers a file descriptor to a reactor.
+ * \param reactor Reactor handle.
+ * \param handle The function puts the pointer to the new reactor handle
+ *               at the address specified by \p handle.
+ * \param fd The file descriptor to wait for.
+ * \param events The poll events to wait for (POLLIN, POLLOUT...).
+ * \param callback The function called when \p fd is ready.
+ * \param private_data Private data for the callback function.
+ * \result Zero if successful, otherwise a negative error code.
+ *
+ * The callback receives the poll revents of \p fd.
+ */
+int snd_reactor_add_fd(snd_reactor_t *reactor, snd_reactor_handle_t **handle,
+		       int fd, unsigned short events,
+		       snd_reactor_callback_t callback, void *private_data)
+{
+	snd_reactor_handle_t *h;
+
+	h = reactor_handle_new(SND_REACTOR_FD, callback, private_data);
+	if (!h)
+		return -ENOMEM;
+	h->u.fd = fd;
+	h->events = events;
+	return reactor_add(reactor, handle, h);
+}
+
+#ifdef BUILD_PCM
+/**
+ * \brief Registers a PCM handle to a reactor.
+ * \param reactor Reactor handle.
+ * \param handle The function puts the pointer to the new reactor handle
+ *               at the address specified by \p handle.
+ * \param pcm The PCM handle.
+ * \param callback The function called when \p pcm is ready.
+ * \param private_data Private data for the callback function.
+ * \result Zero if successful, otherwise a negative error code.
+ *
+ * The callback receives the revents demangled by
+ * #snd_pcm_poll_descriptors_revents.  POLLOUT (playback) or POLLIN
+ * (capture) is reported only when at least avail_min frames are available,
+ * as #snd_pcm_wait does; wakeups below avail_min are swallowed.  POLLERR
+ * means the PCM needs attention (xrun, suspend, ...).
+ *
+ * The descriptors are queried again after the PCM was prepared or its
+ * hardware or software parameters changed, so the handle may be registered
+ * before #snd_pcm_hw_params.  The PCM must stay open while registered.
+ */
+int snd_reactor_add_pcm(snd_reactor_t *reactor, snd_reactor_handle_t **handle,
+			snd_pcm_t *pcm, snd_reactor_callback_t callback,
+			void *private_data)
+{
+	snd_reactor_handle_t *h;
+
+	assert(pcm);
+	h = reactor_handle_new(SND_REACTOR_PCM, callback, private_data);
+	if (!h)
+		return -ENOMEM;
+	h->u.pcm = pcm;
+	return reactor_add(reactor, handle, h);
+}
+#endif
+
+/**
+ * \brief Registers a control handle to a reactor.
+ * \param reactor Reactor handle.
+ * \param handle The function puts the pointer to the new reactor handle
+ *               at the address specified by \p handle.
+ * \param ctl The control handle.
+ * \param callback The function called when \p ctl has events to read.
+ * \param private_data Private data for the callback function.
+ * \result Zero if successful, otherwise a negative error code.
+ *
+ * The callback receives the revents demangled by
+ * #snd_ctl_poll_descriptors_revents.
+ */
+int snd_reactor_add_ctl(snd_reactor_t *reactor, snd_reactor_handle_t **handle,
+			snd_ctl_t *ctl, snd_reactor_callback_t callback,
+			void *private_data)
+{
+	snd_reactor_handle_t *h;
+
+	assert(ctl);
+	h = reactor_handle_new(SND_REACTOR_CTL, callback, private_data);
+	if (!h)
+		return -ENOMEM;
+	h->u.ctl = ctl;
+	return reactor_add(reactor, handle, h);
+}
+
+#ifdef BUILD_SEQ
+/**
+ * \brief Registers a sequencer handle to a reactor.
+ * \param reactor Reactor handle.
+ * \param handle The function puts the pointer to the new reactor handle
+ *               at the address specified by \p handle.
+ * \param seq The sequencer handle.
+ * \param events The poll events to wait for (POLLIN, POLLOUT or both).
+ * \param callback The function called when \p seq is ready.
+ * \param private_data Private data for the callback function.
+ * \result Zero if successful, otherwise a negative error code.
+ *
+ * The callback receives the revents demangled by
+ * #snd_seq_poll_descriptors_revents.
+ */
+int snd_reactor_add_seq(snd_reactor_t *reactor, snd_reactor_handle_t **handle,
+			snd_seq_t *seq, short events,
+			snd_reactor_callback_t callback, void *private_data)
+{
+	snd_reactor_handle_t *h;
+
+	assert(seq);
+	h = reactor_handle_new(SND_REACTOR_SEQ, callback, private_data);
+	if (!h)
+		return -ENOMEM;
+	h->u.seq = seq;
+	h->events = events;
+	return reactor_add(reactor, handle, h);
+}
+#endif
+
+/**
+ * \brief Deletes a handle from its reactor.
+ * \param handle Reactor handle to delete.
+ * \result Zero if successful, otherwise a negative error code.
+ *
+ * It may be called from a callback, also for another handle.
+ */
+int snd_reactor_del(snd_reactor_handle_t *handle)
+{
+	assert(handle);
+	reactor_unregister(handle);
+	list_del(&handle->list);
+	if (!list_empty(&handle->ready))
+		list_del(&handle->ready);
+	free(handle->pfds);
+	free(handle->slots);
+	free(handle);
+	return 0;
+}
+
+/**
+ * \brief Returns the private data assigned to a reactor handle.
+ * \param handle Reactor handle.
+ * \result The \p private_data value registered with the handle.
+ */
+void *snd_reactor_handle_get_callback_private(snd_reactor_handle_t *handle)
+{
+	assert(handle);
+	return handle->private_data;
+}
+
+static void reactor_pending(snd_reactor_handle_t *h)
+{
+	if (list_empty(&h->ready))
+		list_add_tail(&h->ready, &h->reactor->ready);
+}
+
+#ifdef BUILD_PCM
+/* report the PCM ready only when avail_min is reached, like snd_pcm_wait() */
+static unsigned short reactor_pcm_revents(snd_pcm_t *pcm, unsigned short revents)
+{
+	snd_pcm_sframes_t avail;
+
+	if ((revents & (POLLERR | POLLNVAL)) || !(revents & (POLLIN | POLLOUT)))
+		return revents;
+	/* NOTE: avail_min check can be skipped during draining */
+	if (snd_pcm_state(pcm) == SND_PCM_STATE_DRAINING)
+		return revents;
+	avail = snd_pcm_avail_update(pcm);
+	if (avail < 0)
+		return revents | POLLERR;
+	if ((snd_pcm_uframes_t)avail < pcm->avail_min)
+		revents &= ~(POLLIN | POLLOUT);
+	return revents;
+}
+#endif
+
+static unsigned short reactor_revents(snd_reactor_handle_t *h)
+{
+	unsigned short revents = 0;
+	unsigned int i;
+	int err;
+
+	if (h->failed) {
+		h->failed = 0;
+		return POLLERR;
+	}
+	switch (h->type) {
+#ifdef BUILD_PCM
+	case SND_REACTOR_PCM:
+		err = snd_pcm_poll_descriptors_revents(h->u.pcm, h->pfds,
+						       h->npfds, &revents);
+		revents = err < 0 ? POLLERR :
+			  reactor_pcm_revents(h->u.pcm, revents);
+		break;
+#endif
+	case SND_REACTOR_CTL:
+		err = snd_ctl_poll_descriptors_revents(h->u.ctl, h->pfds,
+						       h->npfds, &revents);
+		if (err < 0)
+			revents = POLLERR;
+		break;
+#ifdef BUILD_SEQ
+	case SND_REACTOR_SEQ:
+		err = snd_seq_poll_descriptors_revents(h->u.seq, h->pfds,
+						       h->npfds, &revents);
+		if (err < 0)
+			revents = POLLERR;
+		break;
+#endif
+	default:
+		revents = h->pfds[0].revents;
+		break;
+	}
+	for (i = 0; i < h->npfds; i++)
+		h->pfds[i].revents = 0;
+	return revents;
+}
+
+/**
+ * \brief Waits for the registered handles and dispatches the ready ones.
+ * \param reactor Reactor handle.
+ * \param timeout Maximum time in milliseconds to wait, a negative value
+ *                means infinity.
+ * \result The number of callbacks called (0 on timeout), otherwise a
+ *         negative error code.
+ *
+ * Waits once on the epoll instance and calls the callback of every ready
+ * handle with its demangled revents; a handle is dispatched at most once
+ * per call.  Call it in a loop from the servicing thread.
+ */
+int snd_reactor_dispatch(snd_reactor_t *reactor, int timeout)
+{
+	struct list_head *pos;
+	int i, n, count = 0;
+
+	assert(reactor);
+#ifdef BUILD_PCM
+	/* PCMs prepared or set up again since the last pass */
+	list_for_each(pos, &reactor->handles) {
+		snd_reactor_handle_t *h = list_entry(pos, snd_reactor_handle_t, list);
+		if (h->type != SND_REACTOR_PCM ||
+		    h->serial == h->u.pcm->wait_serial)
+			continue;
+		if (reactor_refresh(h) < 0) {
+			h->failed = 1;
+			reactor_pending(h);
+		}
+	}
+#endif
+	if (reactor->nalways || !list_empty(&reactor->ready))
+		timeout = 0;
+	n = 0;
+	if (reactor->nslots > reactor->nalways) {
+		n = epoll_wait(reactor->epfd, reactor->events,
+			       reactor->events_size, timeout);
+		if (n < 0)
+			return -errno;
+	} else if (timeout != 0) {
+		n = poll(NULL, 0, timeout);
+		if (n < 0)
+			return -errno;
+	}
+	for (i = 0; i < n; i++) {
+		struct reactor_slot *slot = reactor->events[i].data.ptr;
+		snd_reactor_handle_t *h = slot->handle;
+		h->pfds[slot - h->slots].revents = reactor->events[i].events;
+		reactor_pending(h);
+	}
+	if (reactor->nalways) {
+		list_for_each(pos, &reactor->handles) {
+			snd_reactor_handle_t *h = list_entry(pos, snd_reactor_handle_t, list);
+			unsigned int k;
+			if (!h->nalways)
+				continue;
+			for (k = 0; k < h->npfds; k++) {
+				if (h->slots[k].always)
+					h->pfds[k].revents = h->pfds[k].events;
+			}
+			reactor_pending(h);
+		}
+	}
+	/* callbacks may delete any handle: always take the list head */
+	while (!list_empty(&reactor->ready)) {
+		snd_reactor_handle_t *h = list_entry(reactor->ready.next,
+						     snd_reactor_handle_t, ready);
+		unsigned short revents;
+		list_del(&h->ready);
+		INIT_LIST_HEAD(&h->ready);
+		revents = reactor_revents(h);
+		if (!revents)
+			continue;
+		h->callback(h, revents);
+		count++;
+	}
+	return count;
+}
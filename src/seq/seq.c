@@ -120,6 +120,11 @@ record.  There are helper functions, #snd_seq_set_client_pool_output(),
 for setting the total output-pool size, the output-room size and the input-pool
 size, respectively.
 
+Clients with bursty traffic can leave the sizes to the library instead:
+after #snd_seq_set_autotune() the pools and the user-space buffers grow
+when they run full and shrink when they stay mostly unused, within the
+given limits, and #snd_seq_autotune_stats() reports what was done.
+
 \section seq_subs Subscription
 
 One of the new features in ALSA sequencer system is <i>subscription</i> of ports.
@@ -1050,6 +1055,7 @@ int snd_seq_close(snd_seq_t *seq)
 	free(seq->obuf);
 	free(seq->ibuf);
 	free(seq->tmpbuf);
+	free(seq->autotune);
 	free(seq->name);
 	free(seq);
 	return err;
@@ -1245,6 +1251,8 @@ int snd_seq_set_output_buffer_size(snd_seq_t *seq, size_t size)
 		free(seq->obuf);
 		seq->obuf = newbuf;
 		seq->obufsize = size;
+		if (seq->autotune)
+			seq->autotune->stats.output_buffer = size;
 	}
 	return 0;
 }
@@ -1273,7 +1281,257 @@ int snd_seq_set_input_buffer_size(snd_seq_t *seq, size_t size)
 		free(seq->ibuf);
 		seq->ibuf = newbuf;
 		seq->ibufsize = size;
+		if (seq->autotune) {
+			seq->autotune->stats.input_buffer = size * sizeof(snd_seq_event_t);
+			seq->autotune->ibuf_want = 0;
+		}
+	}
+	return 0;
+}
+
+/*
+ * automatic buffer and pool sizing
+ *
+ * The output side grows when a drain stops at a full output pool: the
+ * local buffer at once, so that snd_seq_event_output() takes the event
+ * instead of returning -EAGAIN, and the kernel pool when it is idle
+ * again, since the sequencer refuses to resize a pool in use.  The input
+ * side grows the local buffer after a read which filled it, and the
+ * input pool after an overrun.  Every SEQ_AUTOTUNE_WINDOW drains or reads
+ * the peak use is checked and a buffer used below a quarter is halved, as
+ * is an output pool without stalls, down to the sizes at the start.  The
+ * input pool is never shrunk: resizing it drops the queued events.
+ */
+#define SEQ_AUTOTUNE_WINDOW	256
+
+static void autotune_set_pool(snd_seq_t *seq, unsigned int output, unsigned int input)
+{
+	snd_seq_autotune_t *at = seq->autotune;
+	snd_seq_client_pool_t pool;
+
+	if (snd_seq_get_client_pool(seq, &pool) < 0)
+		return;
+	if (output) {
+		/* the pool must be idle, try again after the next drain */
+		if (pool.output_free != pool.output_pool)
+			return;
+		at->opool_want = 0;
+		if ((unsigned int)pool.output_pool == output)
+			return;
+		pool.output_pool = output;
+	}
+	if (input) {
+		if ((unsigned int)pool.input_pool == input)
+			return;
+		pool.input_pool = input;
+	}
+	if (snd_seq_set_client_pool(seq, &pool) < 0 ||
+	    snd_seq_get_client_pool(seq, &pool) < 0 ||
+	    (output && (unsigned int)pool.output_pool != output) ||
+	    (input && (unsigned int)pool.input_pool != input)) {
+		at->stats.pool_refused++;
+		return;
 	}
+	if (output) {
+		if (output > at->stats.output_pool)
+			at->stats.pool_grows++;
+		else
+			at->stats.pool_shrinks++;
+		at->stats.output_pool = output;
+	}
+	if (input) {
+		at->stats.pool_grows++;
+		at->stats.input_pool = input;
+	}
+}
+
+static int autotune_resize_obuf(snd_seq_t *seq, size_t size)
+{
+	char *buf;
+
+	buf = realloc(seq->obuf, size);
+	if (buf == NULL)
+		return -ENOMEM;
+	if (size > seq->obufsize)
+		seq->autotune->stats.buffer_grows++;
+	else
+		seq->autotune->stats.buffer_shrinks++;
+	seq->obuf = buf;
+	seq->obufsize = size;
+	seq->autotune->stats.output_buffer = size;
+	return 0;
+}
+
+/* a drain met a full output pool */
+static void autotune_output_stall(snd_seq_t *seq)
+{
+	snd_seq_autotune_t *at = seq->autotune;
+	unsigned int want;
+
+	at->stats.output_stalls++;
+	at->stalls++;
+	want = at->stats.output_pool * 2;
+	if (want > at->max_pool)
+		want = at->max_pool;
+	if (want > at->stats.output_pool)
+		at->opool_want = want;
+}
+
+/* room for an event of len bytes on top of the pending ones */
+static int autotune_grow_output(snd_seq_t *seq, size_t len)
+{
+	size_t size = seq->obufsize;
+
+	while (size < seq->obufused + len && size < seq->autotune->max_buffer)
+		size *= 2;
+	if (size > seq->autotune->max_buffer)
+		size = seq->autotune->max_buffer;
+	if (size < seq->obufused + len)
+		return -EAGAIN;
+	return autotune_resize_obuf(seq, size);
+}
+
+/* a drain emptied the output buffer, which held used bytes */
+static void autotune_output_drained(snd_seq_t *seq, size_t used)
+{
+	snd_seq_autotune_t *at = seq->autotune;
+
+	if (used > at->opeak)
+		at->opeak = used;
+	if (at->opool_want)
+		autotune_set_pool(seq, at->opool_want, 0);
+	if (++at->drains < SEQ_AUTOTUNE_WINDOW)
+		return;
+	if (at->opeak < seq->obufsize / 4 && seq->obufsize / 2 >= at->obuf_min)
+		autotune_resize_obuf(seq, seq->obufsize / 2);
+	if (!at->stalls && at->stats.output_pool / 2 >= at->opool_min)
+		autotune_set_pool(seq, at->stats.output_pool / 2, 0);
+	at->drains = 0;
+	at->stalls = 0;
+	at->opeak = 0;
+}
+
+/* the input buffer is empty: apply the size chosen after the last read */
+static void autotune_input_prepare(snd_seq_t *seq)
+{
+	snd_seq_autotune_t *at = seq->autotune;
+	snd_seq_event_t *buf;
+
+	if (!at->ibuf_want)
+		return;
+	buf = calloc(at->ibuf_want, sizeof(snd_seq_event_t));
+	if (buf == NULL)
+		return;
+	if (at->ibuf_want > seq->ibufsize)
+		at->stats.buffer_grows++;
+	else
+		at->stats.buffer_shrinks++;
+	free(seq->ibuf);
+	seq->ibuf = buf;
+	seq->ibufsize = at->ibuf_want;
+	at->stats.input_buffer = seq->ibufsize * sizeof(snd_seq_event_t);
+	at->ibuf_want = 0;
+}
+
+/* a read returned len bytes or an error */
+static void autotune_input_done(snd_seq_t *seq, ssize_t len)
+{
+	snd_seq_autotune_t *at = seq->autotune;
+	size_t max = at->max_buffer / sizeof(snd_seq_event_t);
+	unsigned int want;
+
+	if (len == -ENOSPC) {
+		at->stats.input_overruns++;
+		want = at->stats.input_pool * 2;
+		if (want > at->max_pool)
+			want = at->max_pool;
+		if (want > at->stats.input_pool)
+			autotune_set_pool(seq, 0, want);
+		return;
+	}
+	if (len < 0)
+		return;
+	len /= sizeof(snd_seq_event_t);
+	if ((size_t)len > at->ipeak)
+		at->ipeak = len;
+	if ((size_t)len == seq->ibufsize && seq->ibufsize < max) {
+		at->ibuf_want = seq->ibufsize * 2 < max ? seq->ibufsize * 2 : max;
+		return;
+	}
+	if (++at->reads < SEQ_AUTOTUNE_WINDOW)
+		return;
+	if (at->ipeak < seq->ibufsize / 4 && seq->ibufsize / 2 >= at->ibuf_min)
+		at->ibuf_want = seq->ibufsize / 2;
+	at->reads = 0;
+	at->ipeak = 0;
+}
+
+/**
+ * \brief Let the library size the buffers and pools
+ * \param seq sequencer handle
+ * \param max_buffer limit of the output and input buffers in bytes,
+ *        0 turns the automatic sizing off
+ * \param max_pool limit of the output and input pools in events
+ * \return 0 on success otherwise a negative error code
+ *
+ * Instead of returning \c -EAGAIN when the output pool is full,
+ * #snd_seq_event_output() then enlarges the output buffer, and the output
+ * pool is enlarged once it is idle again.  The input buffer grows when
+ * a read fills it and the input pool after an overrun.  The buffers and
+ * the output pool shrink again, but not below the sizes they have when
+ * this function is called, if their use stays low for a while.  The
+ * decisions are counted by #snd_seq_autotune_stats().
+ *
+ * \sa snd_seq_set_output_buffer_size(), snd_seq_set_client_pool()
+ */
+int snd_seq_set_autotune(snd_seq_t *seq, size_t max_buffer, unsigned int max_pool)
+{
+	snd_seq_autotune_t *at;
+	snd_seq_client_pool_t pool;
+	int err;
+
+	assert(seq);
+	if (max_buffer == 0) {
+		free(seq->autotune);
+		seq->autotune = NULL;
+		return 0;
+	}
+	err = snd_seq_get_client_pool(seq, &pool);
+	if (err < 0)
+		return err;
+	at = seq->autotune;
+	if (at == NULL) {
+		at = calloc(1, sizeof(*at));
+		if (at == NULL)
+			return -ENOMEM;
+		at->obuf_min = seq->obufsize;
+		at->ibuf_min = seq->ibufsize;
+		at->opool_min = pool.output_pool;
+		seq->autotune = at;
+	}
+	at->max_buffer = max_buffer;
+	at->max_pool = max_pool;
+	at->stats.output_buffer = seq->obufsize;
+	at->stats.input_buffer = seq->ibufsize * sizeof(snd_seq_event_t);
+	at->stats.output_pool = pool.output_pool;
+	at->stats.input_pool = pool.input_pool;
+	return 0;
+}
+
+/**
+ * \brief Get the statistics of the automatic sizing
+ * \param seq sequencer handle
+ * \param stats returned statistics
+ * \return 0 on success, -EINVAL when the automatic sizing is off
+ *
+ * \sa snd_seq_set_autotune()
+ */
+int snd_seq_autotune_stats(snd_seq_t *seq, snd_seq_autotune_stats_t *stats)
+{
+	assert(seq && stats);
+	if (seq->autotune == NULL)
+		return -EINVAL;
+	*stats = seq->autotune->stats;
 	return 0;
 }
 
@@ -3910,9 +4168,12 @@ int snd_seq_event_output(snd_seq_t *seq, snd_seq_event_t *ev)
 	result = snd_seq_event_output_buffer(seq, ev);
 	if (result == -EAGAIN) {
 		result = snd_seq_drain_output(seq);
-		if (result < 0)
+		if (result < 0 && !(result == -EAGAIN && seq->autotune))
 			return result;
-		return snd_seq_event_output_buffer(seq, ev);
+		result = snd_seq_event_output_buffer(seq, ev);
+		if (result == -EAGAIN && seq->autotune &&
+		    autotune_grow_output(seq, snd_seq_event_length(ev)) == 0)
+			result = snd_seq_event_output_buffer(seq, ev);
 	}
 	return result;
 }
@@ -4003,6 +4264,112 @@ int snd_seq_event_output_direct(snd_seq_t *seq, snd_seq_event_t *ev)
 	return seq->ops->write(seq, buf, (size_t) len);
 }
 
+#define SEQ_OUTPUT_IOV		64
+
+static ssize_t seq_output_iov(snd_seq_t *seq, const struct iovec *vec, int count)
+{
+	ssize_t result, done = 0;
+	int k;
+
+	if (seq->ops->writev)
+		return seq->ops->writev(seq, vec, count);
+	for (k = 0; k < count; k++) {
+		result = seq->ops->write(seq, vec[k].iov_base, vec[k].iov_len);
+		if (result < 0)
+			return done ? done : result;
+		done += result;
+		if ((size_t)result < vec[k].iov_len)
+			break;
+	}
+	return done;
+}
+
+/**
+ * \brief output several events directly to the sequencer
+ * \param seq sequencer handle
+ * \param ev array of the events to be output
+ * \param count the number of the events
+ * \return the number of the events sent, or a negative error code when
+ *         none was sent
+ *
+ * The events still on the output buffer are drained first, so the order
+ * is kept; when they cannot be drained completely, \c -EAGAIN is returned.
+ * Then the events are sent in one system call per up to 64 runs of them,
+ * the fixed length events straight from \p ev.  A variable length event
+ * is copied together with its data into a temporary buffer, because the
+ * sequencer takes the data right after the event.
+ *
+ * \sa snd_seq_event_output_direct()
+ */
+int snd_seq_event_output_multi(snd_seq_t *seq, snd_seq_event_t *ev, unsigned int count)
+{
+	struct iovec vec[SEQ_OUTPUT_IOV];
+	unsigned int k, end, done = 0;
+	size_t vlen, len;
+	ssize_t result;
+	char *tmp;
+	int n;
+
+	assert(seq && (ev || !count));
+	if (seq->obufused > 0) {
+		result = snd_seq_drain_output(seq);
+		if (result < 0)
+			return result;
+		if (result > 0)
+			return -EAGAIN;
+	}
+	while (done < count) {
+		/* the runs sent by the next call and their variable data */
+		vlen = 0;
+		for (k = done, n = 0; k < count && n < SEQ_OUTPUT_IOV; n++) {
+			if (snd_seq_ev_is_variable(&ev[k])) {
+				vlen += snd_seq_event_length(&ev[k]);
+				k++;
+				continue;
+			}
+			while (k < count && !snd_seq_ev_is_variable(&ev[k]))
+				k++;
+		}
+		end = k;
+		if (vlen > 0 && alloc_tmpbuf(seq, vlen) < 0)
+			return done ? (int)done : -ENOMEM;
+		tmp = (char *)seq->tmpbuf;
+		len = 0;
+		for (k = done, n = 0; k < end; n++) {
+			if (snd_seq_ev_is_variable(&ev[k])) {
+				vec[n].iov_base = tmp;
+				vec[n].iov_len = snd_seq_event_length(&ev[k]);
+				memcpy(tmp, &ev[k], sizeof(*ev));
+				memcpy(tmp + sizeof(*ev), ev[k].data.ext.ptr,
+				       ev[k].data.ext.len);
+				tmp += vec[n].iov_len;
+				k++;
+			} else {
+				vec[n].iov_base = &ev[k];
+				while (k < end && !snd_seq_ev_is_variable(&ev[k]))
+					k++;
+				vec[n].iov_len = (char *)&ev[k] - (char *)vec[n].iov_base;
+			}
+			len += vec[n].iov_len;
+		}
+		result = seq_output_iov(seq, vec, n);
+		if (result < 0)
+			return done ? (int)done : (int)result;
+		if ((size_t)result < len) {
+			/* count the events sent completely */
+			for (; done < end; done++) {
+				len = snd_seq_event_length(&ev[done]);
+				if ((size_t)result < len)
+					break;
+				result -= len;
+			}
+			return done;
+		}
+		done = end;
+	}
+	return done;
+}
+
 /**
  * \brief return the size of pending events on output buffer
  * \param seq sequencer handle
@@ -4034,10 +4401,14 @@ int snd_seq_event_output_pending(snd_seq_t *seq)
 int snd_seq_drain_output(snd_seq_t *seq)
 {
 	ssize_t result, processed = 0;
+	size_t used;
 	assert(seq);
+	used = seq->obufused;
 	while (seq->obufused > 0) {
 		result = seq->ops->write(seq, seq->obuf, seq->obufused);
 		if (result < 0) {
+			if (result == -EAGAIN && seq->autotune)
+				autotune_output_stall(seq);
 			if (result == -EAGAIN && processed)
 				return seq->obufused;
 			return result;
@@ -4046,9 +4417,97 @@ int snd_seq_drain_output(snd_seq_t *seq)
 			memmove(seq->obuf, seq->obuf + result, seq->obufused - result);
 		seq->obufused -= result;
 	}
+	if (seq->autotune && used)
+		autotune_output_drained(seq, used);
 	return 0;
 }
 
+/*
+ * number of the pool cells taken by an event: the variable length data is
+ * copied into cells of the event size
+ */
+static size_t seq_event_cells(const snd_seq_event_t *ev)
+{
+	if (!snd_seq_ev_is_variable(ev))
+		return 1;
+	return 1 + (ev->data.ext.len + sizeof(*ev) - 1) / sizeof(*ev);
+}
+
+/**
+ * \brief drain the output buffer as far as possible without blocking
+ * \param seq sequencer handle
+ * \param bytes the number of the bytes sent is stored here, may be NULL
+ * \param events the number of the events sent is stored here, may be NULL
+ * \return 0 when the output buffer is empty, the byte size of the events
+ *         remaining on the buffer, or a negative error code
+ *
+ * Unlike #snd_seq_drain_output(), this function writes to the sequencer
+ * once and does not wait for room on the output pool.  In blocking mode
+ * only as many leading events are written as fit the free cells reported
+ * by #snd_seq_get_client_pool(), so the write does not block either.
+ *
+ * When events remain, the caller can poll the descriptors returned by
+ * #snd_seq_poll_descriptors() with \c POLLOUT, which is reported when the
+ * pool has the output room again, and then call this function again.
+ *
+ * \sa snd_seq_drain_output(), snd_seq_client_pool_get_output_free()
+ */
+int snd_seq_drain_output_partial(snd_seq_t *seq, size_t *bytes, unsigned int *events)
+{
+	snd_seq_client_pool_t pool;
+	snd_seq_event_t ev;
+	size_t off, len, limit, cells;
+	unsigned int count;
+	ssize_t result;
+	int err;
+
+	assert(seq);
+	if (bytes)
+		*bytes = 0;
+	if (events)
+		*events = 0;
+	if (seq->obufused == 0)
+		return 0;
+	limit = seq->obufused;
+	if (!(seq->mode & SND_SEQ_NONBLOCK)) {
+		err = snd_seq_get_client_pool(seq, &pool);
+		if (err < 0)
+			return err;
+		for (off = 0, cells = 0; off < seq->obufused; off += len) {
+			memcpy(&ev, seq->obuf + off, sizeof(ev));
+			len = snd_seq_event_length(&ev);
+			cells += seq_event_cells(&ev);
+			if (cells > pool.output_free)
+				break;
+		}
+		limit = off;
+		if (limit == 0)
+			return seq->obufused;
+	}
+	result = seq->ops->write(seq, seq->obuf, limit);
+	if (result < 0) {
+		if (result == -EAGAIN) {
+			if (seq->autotune)
+				autotune_output_stall(seq);
+			return seq->obufused;
+		}
+		return result;
+	}
+	/* the sequencer takes only the whole events */
+	for (off = 0, count = 0; off < (size_t)result; off += len, count++) {
+		memcpy(&ev, seq->obuf + off, sizeof(ev));
+		len = snd_seq_event_length(&ev);
+	}
+	if ((size_t)result < seq->obufused)
+		memmove(seq->obuf, seq->obuf + result, seq->obufused - result);
+	seq->obufused -= result;
+	if (bytes)
+		*bytes = result;
+	if (events)
+		*events = count;
+	return seq->obufused;
+}
+
 /**
  * \brief extract the first event in output buffer
  * \param seq sequencer handle
@@ -4095,7 +4554,11 @@ int snd_seq_extract_output(snd_seq_t *seq, snd_seq_event_t **ev_res)
 static ssize_t snd_seq_event_read_buffer(snd_seq_t *seq)
 {
 	ssize_t len;
+	if (seq->autotune)
+		autotune_input_prepare(seq);
 	len = (seq->ops->read)(seq, seq->ibuf, seq->ibufsize * sizeof(snd_seq_event_t));
+	if (seq->autotune)
+		autotune_input_done(seq, len);
 	if (len < 0)
 		return len;
 	seq->ibuflen = len / sizeof(snd_seq_event_t);
@@ -4168,6 +4631,47 @@ int snd_seq_event_input(snd_seq_t *seq, snd_seq_event_t **ev)
 	return snd_seq_event_retrieve_buffer(seq, ev);
 }
 
+/**
+ * \brief retrieve several events from sequencer
+ * \param seq sequencer handle
+ * \param ev array to store the event pointers
+ * \param max the size of \p ev
+ * \return the number of the events stored, or a negative error code
+ *
+ * Like snd_seq_event_input(), but stores up to \p max events.  When the
+ * input buffer is empty, it is filled by one read from the sequencer,
+ * so the number of events obtained by one system call is limited by the
+ * input buffer size; see snd_seq_set_input_buffer_size().  No further
+ * read is done for the remaining space of \p ev.
+ *
+ * The events point to the input buffer and are valid until the next
+ * input from the sequencer.  When a broken variable length event is met
+ * after other events, these are returned and the error is dropped with
+ * the rest of the buffer.
+ *
+ * \sa snd_seq_event_input()
+ */
+int snd_seq_event_input_batch(snd_seq_t *seq, snd_seq_event_t **ev, unsigned int max)
+{
+	unsigned int count = 0;
+	int err;
+
+	assert(seq && (ev || !max));
+	if (max == 0)
+		return 0;
+	if (seq->ibuflen <= 0) {
+		if ((err = snd_seq_event_read_buffer(seq)) < 0)
+			return err;
+	}
+	while (count < max && seq->ibuflen > 0) {
+		err = snd_seq_event_retrieve_buffer(seq, &ev[count]);
+		if (err < 0)
+			return count ? (int)count : err;
+		count++;
+	}
+	return count;
+}
+
 /*
  * read input data from sequencer if available
  */
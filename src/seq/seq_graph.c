@@ -0,0 +1,504 @@
+/*
+ *  Sequencer Interface - graph snapshot
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * The snapshot keeps the clients sorted by the client number, the ports of
+ * each client sorted by the port number, and the connections in one array.
+ * It is queried once with snd_seq_graph_open() and then patched from the
+ * announce events: a client or port start or change queries just that
+ * client or port, an exit removes it together with its connections, and
+ * the (un)subscribe announces add or remove one connection.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "seq_local.h"
+
+typedef struct {
+	snd_seq_client_info_t info;
+	unsigned int nports;
+	unsigned int aports;
+	snd_seq_port_info_t *ports;
+} graph_client_t;
+
+struct _snd_seq_graph {
+	snd_seq_t *seq;
+	unsigned int version;
+	unsigned int nclients;
+	unsigned int aclients;
+	graph_client_t *clients;
+	unsigned int nconns;
+	unsigned int aconns;
+	snd_seq_port_subscribe_t *conns;
+};
+
+static int grow(void **array, unsigned int *alloc, unsigned int used, size_t size)
+{
+	unsigned int nalloc;
+	void *p;
+
+	if (used < *alloc)
+		return 0;
+	nalloc = *alloc ? *alloc * 2 : 16;
+	p = realloc(*array, nalloc * size);
+	if (p == NULL)
+		return -ENOMEM;
+	*array = p;
+	*alloc = nalloc;
+	return 0;
+}
+
+/* index of the client, or of the insert position when not found */
+static unsigned int graph_client_index(snd_seq_graph_t *graph, int client, int *found)
+{
+	unsigned int lo = 0, hi = graph->nclients, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (graph->clients[mid].info.client < client)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	*found = lo < graph->nclients && graph->clients[lo].info.client == client;
+	return lo;
+}
+
+static unsigned int graph_port_index(graph_client_t *gc, int port, int *found)
+{
+	unsigned int lo = 0, hi = gc->nports, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (gc->ports[mid].addr.port < port)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	*found = lo < gc->nports && gc->ports[lo].addr.port == port;
+	return lo;
+}
+
+static int addr_match(const struct snd_seq_addr *addr, int client, int port)
+{
+	return addr->client == client && (port < 0 || addr->port == port);
+}
+
+static int graph_find_conn(snd_seq_graph_t *graph, const struct snd_seq_addr *sender,
+			   const struct snd_seq_addr *dest)
+{
+	unsigned int i;
+
+	for (i = 0; i < graph->nconns; i++) {
+		if (addr_match(&graph->conns[i].sender, sender->client, sender->port) &&
+		    addr_match(&graph->conns[i].dest, dest->client, dest->port))
+			return i;
+	}
+	return -1;
+}
+
+static int graph_add_conn(snd_seq_graph_t *graph, const snd_seq_port_subscribe_t *sub)
+{
+	int idx, err;
+
+	idx = graph_find_conn(graph, &sub->sender, &sub->dest);
+	if (idx >= 0) {
+		graph->conns[idx] = *sub;
+		return 0;
+	}
+	err = grow((void **)&graph->conns, &graph->aconns, graph->nconns,
+		   sizeof(*graph->conns));
+	if (err < 0)
+		return err;
+	graph->conns[graph->nconns++] = *sub;
+	return 0;
+}
+
+/* drop the connections from or to the client (port < 0) or the port */
+static void graph_remove_conns(snd_seq_graph_t *graph, int client, int port)
+{
+	unsigned int i, j;
+
+	for (i = j = 0; i < graph->nconns; i++) {
+		if (addr_match(&graph->conns[i].sender, client, port) ||
+		    addr_match(&graph->conns[i].dest, client, port))
+			continue;
+		graph->conns[j++] = graph->conns[i];
+	}
+	graph->nconns = j;
+}
+
+/* the connections in which the port is the sender */
+static int graph_query_conns(snd_seq_graph_t *graph, const struct snd_seq_addr *addr)
+{
+	snd_seq_query_subscribe_t query;
+	snd_seq_port_subscribe_t sub;
+	int err;
+
+	memset(&query, 0, sizeof(query));
+	query.root = *addr;
+	query.type = SND_SEQ_QUERY_SUBS_READ;
+	for (query.index = 0; ; query.index++) {
+		if (snd_seq_query_port_subscribers(graph->seq, &query) < 0)
+			break;
+		memset(&sub, 0, sizeof(sub));
+		sub.sender = *addr;
+		sub.dest = query.addr;
+		sub.queue = query.queue;
+		sub.flags = query.flags;
+		err = graph_add_conn(graph, &sub);
+		if (err < 0)
+			return err;
+	}
+	return 0;
+}
+
+static int graph_put_port(snd_seq_graph_t *graph, graph_client_t *gc,
+			  const snd_seq_port_info_t *info)
+{
+	unsigned int idx;
+	int found, err;
+
+	idx = graph_port_index(gc, info->addr.port, &found);
+	if (found) {
+		gc->ports[idx] = *info;
+		return 0;
+	}
+	err = grow((void **)&gc->ports, &gc->aports, gc->nports, sizeof(*gc->ports));
+	if (err < 0)
+		return err;
+	memmove(gc->ports + idx + 1, gc->ports + idx,
+		(gc->nports - idx) * sizeof(*gc->ports));
+	gc->ports[idx] = *info;
+	gc->nports++;
+	return graph_query_conns(graph, &info->addr);
+}
+
+/* query the client and all its ports */
+static int graph_query_client(snd_seq_graph_t *graph, const snd_seq_client_info_t *cinfo)
+{
+	snd_seq_port_info_t pinfo;
+	graph_client_t *gc;
+	unsigned int idx;
+	int found, err;
+
+	idx = graph_client_index(graph, cinfo->client, &found);
+	if (!found) {
+		err = grow((void **)&graph->clients, &graph->aclients,
+			   graph->nclients, sizeof(*graph->clients));
+		if (err < 0)
+			return err;
+		memmove(graph->clients + idx + 1, graph->clients + idx,
+			(graph->nclients - idx) * sizeof(*graph->clients));
+		memset(&graph->clients[idx], 0, sizeof(*graph->clients));
+		graph->nclients++;
+	}
+	gc = &graph->clients[idx];
+	gc->info = *cinfo;
+	memset(&pinfo, 0, sizeof(pinfo));
+	pinfo.addr.client = cinfo->client;
+	pinfo.addr.port = (unsigned char)-1;
+	while (snd_seq_query_next_port(graph->seq, &pinfo) >= 0) {
+		err = graph_put_port(graph, gc, &pinfo);
+		if (err < 0)
+			return err;
+	}
+	return 0;
+}
+
+static void graph_remove_client(snd_seq_graph_t *graph, int client)
+{
+	unsigned int idx;
+	int found;
+
+	idx = graph_client_index(graph, client, &found);
+	if (!found)
+		return;
+	free(graph->clients[idx].ports);
+	memmove(graph->clients + idx, graph->clients + idx + 1,
+		(graph->nclients - idx - 1) * sizeof(*graph->clients));
+	graph->nclients--;
+	graph_remove_conns(graph, client, -1);
+}
+
+static void graph_clear(snd_seq_graph_t *graph)
+{
+	unsigned int i;
+
+	for (i = 0; i < graph->nclients; i++)
+		free(graph->clients[i].ports);
+	graph->nclients = 0;
+	graph->nconns = 0;
+}
+
+/**
+ * \brief query the whole graph again
+ * \param graph graph snapshot
+ * \return 0 on success otherwise a negative error code
+ *
+ * Needed when the announce events may have been lost, e.g. after the input
+ * returned \c -ENOSPC.
+ */
+int snd_seq_graph_rebuild(snd_seq_graph_t *graph)
+{
+	snd_seq_client_info_t cinfo;
+	int err;
+
+	assert(graph);
+	graph_clear(graph);
+	graph->version++;
+	memset(&cinfo, 0, sizeof(cinfo));
+	cinfo.client = -1;
+	while (snd_seq_query_next_client(graph->seq, &cinfo) >= 0) {
+		err = graph_query_client(graph, &cinfo);
+		if (err < 0)
+			return err;
+	}
+	return 0;
+}
+
+/**
+ * \brief create a snapshot of the clients, ports and connections
+ * \param graphp the new graph snapshot is stored here
+ * \param seq sequencer handle used for the queries
+ * \return 0 on success otherwise a negative error code
+ *
+ * The snapshot is kept up to date by passing the events received from the
+ * system announce port to #snd_seq_graph_update().  The application has to
+ * subscribe to that port itself, e.g. with
+ * snd_seq_connect_from(seq, port, SND_SEQ_CLIENT_SYSTEM, SND_SEQ_PORT_SYSTEM_ANNOUNCE).
+ */
+int snd_seq_graph_open(snd_seq_graph_t **graphp, snd_seq_t *seq)
+{
+	snd_seq_graph_t *graph;
+	int err;
+
+	assert(graphp && seq);
+	graph = calloc(1, sizeof(*graph));
+	if (graph == NULL)
+		return -ENOMEM;
+	graph->seq = seq;
+	err = snd_seq_graph_rebuild(graph);
+	if (err < 0) {
+		snd_seq_graph_close(graph);
+		return err;
+	}
+	*graphp = graph;
+	return 0;
+}
+
+/**
+ * \brief free a graph snapshot
+ * \param graph graph snapshot
+ */
+void snd_seq_graph_close(snd_seq_graph_t *graph)
+{
+	if (graph == NULL)
+		return;
+	graph_clear(graph);
+	free(graph->clients);
+	free(graph->conns);
+	free(graph);
+}
+
+/**
+ * \brief apply an announce event to the snapshot
+ * \param graph graph snapshot
+ * \param ev event received from the sequencer
+ * \return 1 when the snapshot changed, 0 when the event is ignored,
+ *         otherwise a negative error code
+ *
+ * The client and port start and change events, the client and port exit
+ * events and the port (un)subscribe events sent by the system client are
+ * taken, all other events are ignored.  A client or port which is gone
+ * already when it is queried is skipped; its exit event follows.
+ */
+int snd_seq_graph_update(snd_seq_graph_t *graph, const snd_seq_event_t *ev)
+{
+	snd_seq_client_info_t cinfo;
+	snd_seq_port_info_t pinfo;
+	snd_seq_port_subscribe_t sub;
+	unsigned int idx;
+	int found, err, i;
+
+	assert(graph && ev);
+	if (ev->source.client != SND_SEQ_CLIENT_SYSTEM)
+		return 0;
+	switch (ev->type) {
+	case SND_SEQ_EVENT_CLIENT_START:
+	case SND_SEQ_EVENT_CLIENT_CHANGE:
+		err = snd_seq_get_any_client_info(graph->seq, ev->data.addr.client, &cinfo);
+		if (err < 0)
+			return err == -ENOENT ? 0 : err;
+		err = graph_query_client(graph, &cinfo);
+		break;
+	case SND_SEQ_EVENT_CLIENT_EXIT:
+		graph_remove_client(graph, ev->data.addr.client);
+		err = 0;
+		break;
+	case SND_SEQ_EVENT_PORT_START:
+	case SND_SEQ_EVENT_PORT_CHANGE:
+		err = snd_seq_get_any_port_info(graph->seq, ev->data.addr.client,
+						ev->data.addr.port, &pinfo);
+		if (err < 0)
+			return err == -ENOENT ? 0 : err;
+		idx = graph_client_index(graph, ev->data.addr.client, &found);
+		if (!found) {
+			err = snd_seq_get_any_client_info(graph->seq, ev->data.addr.client, &cinfo);
+			if (err < 0)
+				return err == -ENOENT ? 0 : err;
+			err = graph_query_client(graph, &cinfo);
+			break;
+		}
+		err = graph_put_port(graph, &graph->clients[idx], &pinfo);
+		break;
+	case SND_SEQ_EVENT_PORT_EXIT:
+		idx = graph_client_index(graph, ev->data.addr.client, &found);
+		if (found) {
+			graph_client_t *gc = &graph->clients[idx];
+			idx = graph_port_index(gc, ev->data.addr.port, &found);
+			if (found) {
+				memmove(gc->ports + idx, gc->ports + idx + 1,
+					(gc->nports - idx - 1) * sizeof(*gc->ports));
+				gc->nports--;
+			}
+		}
+		graph_remove_conns(graph, ev->data.addr.client, ev->data.addr.port);
+		err = 0;
+		break;
+	case SND_SEQ_EVENT_PORT_SUBSCRIBED:
+		memset(&sub, 0, sizeof(sub));
+		memcpy(&sub.sender, &ev->data.connect.sender, sizeof(sub.sender));
+		memcpy(&sub.dest, &ev->data.connect.dest, sizeof(sub.dest));
+		/* the queue and the flags are not in the announce */
+		err = snd_seq_get_port_subscription(graph->seq, &sub);
+		if (err < 0)
+			return err == -ENOENT ? 0 : err;
+		err = graph_add_conn(graph, &sub);
+		break;
+	case SND_SEQ_EVENT_PORT_UNSUBSCRIBED:
+		i = graph_find_conn(graph,
+				    (const struct snd_seq_addr *)&ev->data.connect.sender,
+				    (const struct snd_seq_addr *)&ev->data.connect.dest);
+		if (i < 0)
+			return 0;
+		memmove(graph->conns + i, graph->conns + i + 1,
+			(graph->nconns - i - 1) * sizeof(*graph->conns));
+		graph->nconns--;
+		err = 0;
+		break;
+	default:
+		return 0;
+	}
+	if (err < 0)
+		return err;
+	graph->version++;
+	return 1;
+}
+
+/**
+ * \brief get the version of the snapshot
+ * \param graph graph snapshot
+ * \return the version, which changes with every update of the snapshot
+ *
+ * A reader can keep the version it has shown and skip the walk over the
+ * snapshot while it stays the same.
+ */
+unsigned int snd_seq_graph_get_version(const snd_seq_graph_t *graph)
+{
+	assert(graph);
+	return graph->version;
+}
+
+/**
+ * \brief get the number of the clients in the snapshot
+ * \param graph graph snapshot
+ * \return the number of the clients
+ */
+unsigned int snd_seq_graph_get_clients(const snd_seq_graph_t *graph)
+{
+	assert(graph);
+	return graph->nclients;
+}
+
+/**
+ * \brief get a client of the snapshot
+ * \param graph graph snapshot
+ * \param idx client index, 0 .. #snd_seq_graph_get_clients() - 1, in the
+ *        order of the client numbers
+ * \return the client information, valid until the next update
+ */
+const snd_seq_client_info_t *snd_seq_graph_get_client(const snd_seq_graph_t *graph,
+						      unsigned int idx)
+{
+	assert(graph && idx < graph->nclients);
+	return &graph->clients[idx].info;
+}
+
+/**
+ * \brief get the number of the ports of a client in the snapshot
+ * \param graph graph snapshot
+ * \param idx client index
+ * \return the number of the ports
+ */
+unsigned int snd_seq_graph_get_ports(const snd_seq_graph_t *graph, unsigned int idx)
+{
+	assert(graph && idx < graph->nclients);
+	return graph->clients[idx].nports;
+}
+
+/**
+ * \brief get a port of the snapshot
+ * \param graph graph snapshot
+ * \param idx client index
+ * \param port port index, 0 .. #snd_seq_graph_get_ports() - 1, in the
+ *        order of the port numbers
+ * \return the port information, valid until the next update
+ */
+const snd_seq_port_info_t *snd_seq_graph_get_port(const snd_seq_graph_t *graph,
+						  unsigned int idx, unsigned int port)
+{
+	assert(graph && idx < graph->nclients);
+	assert(port < graph->clients[idx].nports);
+	return &graph->clients[idx].ports[port];
+}
+
+/**
+ * \brief get the number of the connections in the snapshot
+ * \param graph graph snapshot
+ * \return the number of the connections
+ */
+unsigned int snd_seq_graph_get_connections(const snd_seq_graph_t *graph)
+{
+	assert(graph);
+	return graph->nconns;
+}
+
+/**
+ * \brief get a connection of the snapshot
+ * \param graph graph snapshot
+ * \param idx connection index, 0 .. #snd_seq_graph_get_connections() - 1
+ * \return the subscription, valid until the next update
+ */
+const snd_seq_port_subscribe_t *snd_seq_graph_get_connection(const snd_seq_graph_t *graph,
+							     unsigned int idx)
+{
+	assert(graph && idx < graph->nconns);
+	return &graph->conns[idx];
+}
@@ -327,6 +327,15 @@ static ssize_t snd_seq_hw_write(snd_seq_t *seq, void *buf, size_t len)
 	return result;
 }
 
+static ssize_t snd_seq_hw_writev(snd_seq_t *seq, const struct iovec *vec, int count)
+{
+	snd_seq_hw_t *hw = seq->private_data;
+	ssize_t result = writev(hw->fd, vec, count);
+	if (result < 0)
+		return -errno;
+	return result;
+}
+
 static ssize_t snd_seq_hw_read(snd_seq_t *seq, void *buf, size_t len)
 {
 	snd_seq_hw_t *hw = seq->private_data;
@@ -417,6 +426,7 @@ static const snd_seq_ops_t snd_seq_hw_ops = {
 	.set_queue_info = snd_seq_hw_set_queue_info,
 	.get_named_queue = snd_seq_hw_get_named_queue,
 	.write = snd_seq_hw_write,
+	.writev = snd_seq_hw_writev,
 	.read = snd_seq_hw_read,
 	.remove_events = snd_seq_hw_remove_events,
 	.get_client_pool = snd_seq_hw_get_client_pool,
@@ -551,6 +561,9 @@ int _snd_seq_hw_open(snd_seq_t **handlep, char *name,
 		     int streams, int mode)
 {
 	snd_config_iterator_t i, next;
+	long ibufsize = 0, obufsize = 0;
+	int err;
+
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
 		const char *id;
@@ -558,8 +571,36 @@ int _snd_seq_hw_open(snd_seq_t **handlep, char *name,
 			continue;
 		if (_snd_conf_generic_id(id))
 			continue;
+		/* buffer sizes in bytes, instead of the defaults */
+		if (strcmp(id, "input_buffer_size") == 0) {
+			if (snd_config_get_integer(n, &ibufsize) < 0 ||
+			    ibufsize < (long)sizeof(snd_seq_event_t)) {
+				SNDERR("Invalid input_buffer_size");
+				return -EINVAL;
+			}
+			continue;
+		}
+		if (strcmp(id, "output_buffer_size") == 0) {
+			if (snd_config_get_integer(n, &obufsize) < 0 ||
+			    obufsize < (long)sizeof(snd_seq_event_t)) {
+				SNDERR("Invalid output_buffer_size");
+				return -EINVAL;
+			}
+			continue;
+		}
 		return -EINVAL;
 	}
-	return snd_seq_hw_open(handlep, name, streams, mode);
+	err = snd_seq_hw_open(handlep, name, streams, mode);
+	if (err < 0)
+		return err;
+	if (ibufsize && (streams & SND_SEQ_OPEN_INPUT))
+		err = snd_seq_set_input_buffer_size(*handlep, ibufsize);
+	if (err >= 0 && obufsize && (streams & SND_SEQ_OPEN_OUTPUT))
+		err = snd_seq_set_output_buffer_size(*handlep, obufsize);
+	if (err < 0) {
+		snd_seq_close(*handlep);
+		*handlep = NULL;
+	}
+	return err;
 }
 SND_DLSYM_BUILD_VERSION(_snd_seq_hw_open, SND_SEQ_DLSYM_VERSION);
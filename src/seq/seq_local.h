@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <sys/uio.h>
 #include "local.h"
 
 #define SND_SEQ_OBUF_SIZE	(16*1024)	/* default size */
@@ -62,6 +63,7 @@ typedef struct {
 	int (*set_queue_info)(snd_seq_t *seq, snd_seq_queue_info_t *info);
 	int (*get_named_queue)(snd_seq_t *seq, snd_seq_queue_info_t *info);
 	ssize_t (*write)(snd_seq_t *seq, void *buf, size_t len);
+	ssize_t (*writev)(snd_seq_t *seq, const struct iovec *vec, int count);
 	ssize_t (*read)(snd_seq_t *seq, void *buf, size_t len);
 	int (*remove_events)(snd_seq_t *seq, snd_seq_remove_events_t *rmp);
 	int (*get_client_pool)(snd_seq_t *seq, snd_seq_client_pool_t *info);
@@ -70,6 +72,23 @@ typedef struct {
 	int (*query_next_port)(snd_seq_t *seq, snd_seq_port_info_t *info);
 } snd_seq_ops_t;
 
+/* automatic buffer and pool sizing, see snd_seq_set_autotune() */
+typedef struct {
+	size_t max_buffer;		/* limit of the local buffers in bytes */
+	unsigned int max_pool;		/* limit of the kernel pools in events */
+	size_t obuf_min;		/* sizes at the start, the shrink floors */
+	size_t ibuf_min;		/* in events */
+	unsigned int opool_min;
+	unsigned int opool_want;	/* output pool to set once idle, 0 = none */
+	size_t ibuf_want;		/* input buffer to set before the next read, 0 = none */
+	size_t opeak;			/* largest output buffer use in the window */
+	size_t ipeak;			/* largest read in the window, in events */
+	unsigned int drains;		/* completed drains in the window */
+	unsigned int reads;		/* reads in the window */
+	unsigned int stalls;		/* output stalls in the window */
+	snd_seq_autotune_stats_t stats;
+} snd_seq_autotune_t;
+
 struct _snd_seq {
 	char *name;
 	snd_seq_type_t type;
@@ -90,6 +109,7 @@ struct _snd_seq {
 	size_t ibufsize;		/* input buffer size */
 	snd_seq_event_t *tmpbuf;	/* temporary event for extracted event */
 	size_t tmpbufsize;		/* size of errbuf */
+	snd_seq_autotune_t *autotune;	/* NULL = fixed sizes */
 };
 
 int snd_seq_hw_open(snd_seq_t **handle, const char *name, int streams, int mode);
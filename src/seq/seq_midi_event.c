@@ -460,6 +460,109 @@ int snd_midi_event_encode_byte(snd_midi_event_t *dev, int c, snd_seq_event_t *ev
 	return rc;
 }
 
+/* complete channel message with the status byte in dev->buf[0] */
+static inline void encode_channel_message(snd_midi_event_t *dev,
+					  const unsigned char *data, int qlen,
+					  snd_seq_event_t *ev)
+{
+	const struct status_event_list_t *st = &status_event[dev->type];
+
+	dev->buf[1] = data[0];
+	if (qlen > 1)
+		dev->buf[2] = data[1];
+	dev->read = qlen + 1;
+	dev->qlen = 0;
+	ev->type = st->event;
+	ev->flags &= ~SND_SEQ_EVENT_LENGTH_MASK;
+	ev->flags |= SND_SEQ_EVENT_LENGTH_FIXED;
+	st->encode(dev, ev);
+}
+
+/**
+ * \brief Encodes bytes to several sequencer events.
+ * \param[in] dev MIDI event parser.
+ * \param[in] buf Buffer containing bytes of a raw MIDI stream.
+ * \param[in] count Number of bytes in \a buf.
+ * \param[out] ev Array of sequencer events.
+ * \param[in,out] events The size of \a ev; on return, the number of
+ *                       events stored in \a ev.
+ * \return The number of bytes consumed, or a negative error code.
+ *
+ * This function works like calling #snd_midi_event_encode repeatedly on the
+ * rest of the buffer and collecting the events completed, until \a count
+ * bytes are consumed or the array is full.  The parser state afterwards is
+ * the same.  Only the type, the length flags and the data of the events are
+ * set.
+ *
+ * Complete channel messages, with or without running status, and real-time
+ * messages are encoded straight from \a buf; the other bytes go through
+ * #snd_midi_event_encode_byte.
+ *
+ * As the data of a System Exclusive event points into the parser's buffer,
+ * the function stops after such an event, so it is always the last one
+ * stored.
+ *
+ * \sa snd_midi_event_encode
+ */
+long snd_midi_event_encode_multi(snd_midi_event_t *dev, const unsigned char *buf,
+				 long count, snd_seq_event_t *ev,
+				 unsigned int *events)
+{
+	unsigned int n = 0, max = *events;
+	long pos = 0;
+	int c, qlen, rc;
+
+	while (pos < count && n < max) {
+		c = buf[pos];
+		if (dev->bufsize < 3)
+			goto slow;
+		if (c >= MIDI_CMD_COMMON_CLOCK) {
+			/* real-time event */
+			pos++;
+			ev[n].type = status_event[ST_SPECIAL + c - 0xf0].event;
+			if (ev[n].type == SND_SEQ_EVENT_NONE)
+				continue;
+			ev[n].flags &= ~SND_SEQ_EVENT_LENGTH_MASK;
+			ev[n].flags |= SND_SEQ_EVENT_LENGTH_FIXED;
+			n++;
+			continue;
+		}
+		if (c >= 0x80 && c < 0xf0) {
+			/* channel message with its status byte */
+			qlen = status_event[(c >> 4) & 0x07].qlen;
+			if (count - pos <= qlen || (buf[pos + 1] & 0x80) ||
+			    (qlen > 1 && (buf[pos + 2] & 0x80)))
+				goto slow;
+			dev->buf[0] = c;
+			dev->type = (c >> 4) & 0x07;
+			encode_channel_message(dev, buf + pos + 1, qlen, &ev[n++]);
+			pos += qlen + 1;
+			continue;
+		}
+		if (c < 0x80 && dev->qlen == 0 && dev->type < ST_INVALID) {
+			/* channel message with running status */
+			qlen = status_event[dev->type].qlen;
+			if (count - pos < qlen ||
+			    (qlen > 1 && (buf[pos + 1] & 0x80)))
+				goto slow;
+			encode_channel_message(dev, buf + pos, qlen, &ev[n++]);
+			pos += qlen;
+			continue;
+		}
+	slow:
+		rc = snd_midi_event_encode_byte(dev, c, &ev[n]);
+		pos++;
+		if (rc < 0) {
+			*events = n;
+			return n ? pos - 1 : rc;
+		}
+		if (rc > 0 && ev[n++].type == SND_SEQ_EVENT_SYSEX)
+			break;
+	}
+	*events = n;
+	return pos;
+}
+
 /* encode note event */
 static void note_event(snd_midi_event_t *dev, snd_seq_event_t *ev)
 {
@@ -616,6 +719,89 @@ long snd_midi_event_decode(snd_midi_event_t *dev, unsigned char *buf, long count
 }
 
 
+/* status_event index of a channel message event, -1 for the others */
+static inline int channel_event_type(int type)
+{
+	switch (type) {
+	case SND_SEQ_EVENT_NOTEOFF:	return 0;
+	case SND_SEQ_EVENT_NOTEON:	return 1;
+	case SND_SEQ_EVENT_KEYPRESS:	return 2;
+	case SND_SEQ_EVENT_CONTROLLER:	return 3;
+	case SND_SEQ_EVENT_PGMCHANGE:	return 4;
+	case SND_SEQ_EVENT_CHANPRESS:	return 5;
+	case SND_SEQ_EVENT_PITCHBEND:	return 6;
+	default:			return -1;
+	}
+}
+
+/**
+ * \brief Decodes several sequencer events into MIDI bytes.
+ * \param[in] dev MIDI event parser.
+ * \param[out] buf Buffer for the MIDI bytes.
+ * \param[in] count Size of \a buf in bytes.
+ * \param[in] ev Array of the sequencer events, as returned by
+ *               #snd_seq_event_input_batch.
+ * \param[in,out] events Number of the events in \a ev; on return, the
+ *                       number of the events consumed.
+ * \return Number of the bytes stored in \a buf, or a negative error code
+ *         when the first event fails.
+ *
+ * This function works like calling #snd_midi_event_decode for each event
+ * and appending the results, with the running status applied across the
+ * events.  It stops before the first event whose MIDI message(s) do not fit
+ * the rest of \a buf, and after an error met after other events; the events
+ * which do not correspond to MIDI messages are consumed silently.  The state
+ * of the parser is not changed by the event that stops the decoding.
+ *
+ * The channel messages are decoded inline, the other events through
+ * #snd_midi_event_decode.
+ *
+ * \sa snd_midi_event_decode
+ */
+long snd_midi_event_decode_multi(snd_midi_event_t *dev, unsigned char *buf,
+				 long count, snd_seq_event_t **ev,
+				 unsigned int *events)
+{
+	unsigned int n, max = *events;
+	unsigned char lastcmd;
+	long pos = 0, rc;
+	int type, cmd, qlen;
+
+	for (n = 0; n < max; n++) {
+		type = channel_event_type(ev[n]->type);
+		if (type >= 0) {
+			/* data.note.channel and data.control.channel is identical */
+			cmd = 0x80 | (type << 4) | (ev[n]->data.note.channel & 0x0f);
+			qlen = status_event[type].qlen;
+			if (dev->lastcmd != cmd || dev->nostat) {
+				if (count - pos < qlen + 1)
+					break;
+				dev->lastcmd = cmd;
+				buf[pos++] = cmd;
+			} else if (count - pos < qlen) {
+				break;
+			}
+			status_event[type].decode(ev[n], buf + pos);
+			pos += qlen;
+			continue;
+		}
+		lastcmd = dev->lastcmd;
+		rc = snd_midi_event_decode(dev, buf + pos, count - pos, ev[n]);
+		if (rc == -ENOENT)
+			continue;
+		if (rc < 0) {
+			dev->lastcmd = lastcmd;
+			if (n > 0)
+				break;
+			*events = 0;
+			return rc;
+		}
+		pos += rc;
+	}
+	*events = n;
+	return pos;
+}
+
 /* decode note event */
 static void note_decode(const snd_seq_event_t *ev, unsigned char *buf)
 {
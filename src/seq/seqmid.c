@@ -213,6 +213,75 @@ int snd_seq_disconnect_to(snd_seq_t *seq, int myport, int dest_client, int dest_
 	return snd_seq_unsubscribe_port(seq, &subs);
 }
 
+static int seq_connect_multi(snd_seq_t *seq, snd_seq_connect_entry_t *conns,
+			     unsigned int count, int subscribe)
+{
+	snd_seq_port_subscribe_t subs;
+	unsigned int k;
+	int done = 0;
+
+	assert(seq && (conns || !count));
+	for (k = 0; k < count; k++) {
+		memset(&subs, 0, sizeof(subs));
+		subs.sender.client = conns[k].sender.client;
+		subs.sender.port = conns[k].sender.port;
+		subs.dest.client = conns[k].dest.client;
+		subs.dest.port = conns[k].dest.port;
+		subs.queue = conns[k].queue;
+		if (conns[k].flags & SND_SEQ_CONNECT_EXCLUSIVE)
+			subs.flags |= SNDRV_SEQ_PORT_SUBS_EXCLUSIVE;
+		if (conns[k].flags & SND_SEQ_CONNECT_TIME_UPDATE)
+			subs.flags |= SNDRV_SEQ_PORT_SUBS_TIMESTAMP;
+		if (conns[k].flags & SND_SEQ_CONNECT_TIME_REAL)
+			subs.flags |= SNDRV_SEQ_PORT_SUBS_TIME_REAL;
+		if (subscribe)
+			conns[k].result = snd_seq_subscribe_port(seq, &subs);
+		else
+			conns[k].result = snd_seq_unsubscribe_port(seq, &subs);
+		if (conns[k].result >= 0)
+			done++;
+	}
+	return done;
+}
+
+/**
+ * \brief subscribe several connections at once
+ * \param seq sequencer handle
+ * \param conns array of the connections
+ * \param count the number of the connections
+ * \return the number of the connections made
+ *
+ * Each entry is subscribed regardless of the result of the previous ones,
+ * and the result of each one, 0 or a negative error code, is stored to its
+ * \a result field.  The senders and the destinations need not belong to the
+ * current client.  The flags are #SND_SEQ_CONNECT_EXCLUSIVE,
+ * #SND_SEQ_CONNECT_TIME_UPDATE and #SND_SEQ_CONNECT_TIME_REAL; the queue is
+ * used for the time stamps only.
+ *
+ * \sa snd_seq_disconnect_multi(), snd_seq_subscribe_port()
+ */
+int snd_seq_connect_multi(snd_seq_t *seq, snd_seq_connect_entry_t *conns, unsigned int count)
+{
+	return seq_connect_multi(seq, conns, count, 1);
+}
+
+/**
+ * \brief remove several connections at once
+ * \param seq sequencer handle
+ * \param conns array of the connections
+ * \param count the number of the connections
+ * \return the number of the connections removed
+ *
+ * The counterpart of #snd_seq_connect_multi(); the flags and the queue are
+ * not used.
+ *
+ * \sa snd_seq_connect_multi(), snd_seq_unsubscribe_port()
+ */
+int snd_seq_disconnect_multi(snd_seq_t *seq, snd_seq_connect_entry_t *conns, unsigned int count)
+{
+	return seq_connect_multi(seq, conns, count, 0);
+}
+
 /*
  * set client information
  */
@@ -0,0 +1,425 @@
+/**
+ * \file thread.c
+ * \brief Scheduling of the threads of the library
+ * \date 2026
+ */
+/*
+ *  Creation and scheduling of the library threads
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Every thread of the library has a role: pcm_share, pcm_meter,
+ * pcm_rate, pcm_file, pcm_multi, pcm_ladspa, pcm_softvol, ctl_mirror
+ * and async, and pcm_direct_server for the forked dmix/dsnoop/dshare
+ * server process.  The scheduling of a role comes from
+ * snd_thread_set_sched() / snd_thread_set_affinity(), or else from the
+ * configuration:
+ *
+ *	defaults.thread.pcm_share {
+ *		policy fifo		# other, fifo, rr, batch or idle
+ *		priority 70
+ *		cpus "2-3"		# list of CPUs, as for taskset -c
+ *	}
+ *
+ * The role "default" covers the roles without their own setting.  The
+ * policy and the CPUs are looked up separately, in the order: the API
+ * for the role, the configuration for the role, the API default, the
+ * configuration default.  Without any setting a thread inherits the
+ * scheduling of the thread that opened the handle, as before.
+ */
+
+#include "local.h"
+#include <ctype.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifdef HAVE_LIBPTHREAD
+
+#ifndef DOC_HIDDEN
+#define THREAD_CPUS_MAX		CPU_SETSIZE
+
+struct _snd_thread_sched {
+	unsigned int has_policy: 1;
+	unsigned int has_cpus: 1;
+	int policy;
+	int priority;
+	cpu_set_t cpus;
+};
+
+/* settings given by the application */
+struct thread_role {
+	struct list_head list;
+	struct _snd_thread_sched sched;
+	char role[];
+};
+
+static LIST_HEAD(thread_roles);
+static snd_thread_factory_t thread_factory;
+static void *thread_factory_private;
+static pthread_mutex_t thread_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const struct {
+	const char *name;
+	int policy;
+} thread_policies[] = {
+	{ "other", SCHED_OTHER },
+	{ "fifo", SCHED_FIFO },
+	{ "rr", SCHED_RR },
+#ifdef SCHED_BATCH
+	{ "batch", SCHED_BATCH },
+#endif
+#ifdef SCHED_IDLE
+	{ "idle", SCHED_IDLE },
+#endif
+};
+#endif /* DOC_HIDDEN */
+
+/* parse a CPU list like "0-1,4" */
+static int thread_parse_cpus(const char *str, cpu_set_t *cpus)
+{
+	const char *p = str;
+	char *end;
+	long first, last;
+
+	CPU_ZERO(cpus);
+	while (*p) {
+		while (isspace((unsigned char)*p))
+			p++;
+		first = strtol(p, &end, 10);
+		if (end == p || first < 0)
+			return -EINVAL;
+		last = first;
+		p = end;
+		if (*p == '-') {
+			p++;
+			last = strtol(p, &end, 10);
+			if (end == p || last < first)
+				return -EINVAL;
+			p = end;
+		}
+		if (last >= THREAD_CPUS_MAX)
+			return -EINVAL;
+		for (; first <= last; first++)
+			CPU_SET(first, cpus);
+		while (isspace((unsigned char)*p))
+			p++;
+		if (*p == ',')
+			p++;
+		else if (*p)
+			return -EINVAL;
+	}
+	return CPU_COUNT(cpus) ? 0 : -EINVAL;
+}
+
+static struct thread_role *thread_role_find(const char *role)
+{
+	struct list_head *pos;
+
+	list_for_each(pos, &thread_roles) {
+		struct thread_role *r = list_entry(pos, struct thread_role, list);
+		if (strcmp(r->role, role) == 0)
+			return r;
+	}
+	return NULL;
+}
+
+/* called with thread_mutex */
+static struct thread_role *thread_role_get(const char *role)
+{
+	struct thread_role *r = thread_role_find(role);
+
+	if (r)
+		return r;
+	r = calloc(1, sizeof(*r) + strlen(role) + 1);
+	if (!r)
+		return NULL;
+	strcpy(r->role, role);
+	list_add_tail(&r->list, &thread_roles);
+	return r;
+}
+
+/* fill the fields of sched not set yet from the definition of a role */
+static void thread_sched_config(snd_config_t *top, const char *role,
+				struct _snd_thread_sched *sched)
+{
+	char key[64];
+	snd_config_t *conf, *n;
+	const char *str;
+	long val;
+	unsigned int i;
+
+	snprintf(key, sizeof(key), "defaults.thread.%s", role);
+	if (snd_config_search(top, key, &conf) < 0)
+		return;
+	if (!sched->has_policy &&
+	    snd_config_search(conf, "policy", &n) >= 0) {
+		if (snd_config_get_string(n, &str) < 0)
+			goto _policy;
+		for (i = 0; i < ARRAY_SIZE(thread_policies); i++)
+			if (strcmp(str, thread_policies[i].name) == 0)
+				break;
+		if (i >= ARRAY_SIZE(thread_policies)) {
+ _policy:
+			SNDERR("Invalid policy for the %s threads", role);
+		} else {
+			sched->has_policy = 1;
+			sched->policy = thread_policies[i].policy;
+			sched->priority = 0;
+			if (snd_config_search(conf, "priority", &n) >= 0 &&
+			    snd_config_get_integer(n, &val) >= 0)
+				sched->priority = val;
+		}
+	}
+	if (!sched->has_cpus &&
+	    snd_config_search(conf, "cpus", &n) >= 0) {
+		if (snd_config_get_string(n, &str) < 0 ||
+		    thread_parse_cpus(str, &sched->cpus) < 0)
+			SNDERR("Invalid cpus for the %s threads", role);
+		else
+			sched->has_cpus = 1;
+	}
+}
+
+/* fill the fields of sched not set yet from the API settings of a role */
+static void thread_sched_api(const char *role, struct _snd_thread_sched *sched)
+{
+	struct thread_role *r = thread_role_find(role);
+
+	if (!r)
+		return;
+	if (!sched->has_policy && r->sched.has_policy) {
+		sched->has_policy = 1;
+		sched->policy = r->sched.policy;
+		sched->priority = r->sched.priority;
+	}
+	if (!sched->has_cpus && r->sched.has_cpus) {
+		sched->has_cpus = 1;
+		sched->cpus = r->sched.cpus;
+	}
+}
+
+/*
+ * resolve the scheduling of a role; returns NULL when nothing is set
+ * (or without memory), the result is freed with free()
+ */
+snd_thread_sched_t *snd_thread_sched_get(const char *role)
+{
+	struct _snd_thread_sched *sched;
+	snd_config_t *top = NULL;
+
+	sched = calloc(1, sizeof(*sched));
+	if (!sched)
+		return NULL;
+	if (snd_config_update_ref(&top) < 0)
+		top = NULL;
+	pthread_mutex_lock(&thread_mutex);
+	thread_sched_api(role, sched);
+	if (top)
+		thread_sched_config(top, role, sched);
+	thread_sched_api("default", sched);
+	if (top)
+		thread_sched_config(top, "default", sched);
+	pthread_mutex_unlock(&thread_mutex);
+	if (top)
+		snd_config_unref(top);
+	if (!sched->has_policy && !sched->has_cpus) {
+		free(sched);
+		return NULL;
+	}
+	return sched;
+}
+
+/*
+ * apply a resolved scheduling to a thread; the failures are reported
+ * but the thread keeps running with the scheduling it has
+ */
+int snd_thread_sched_apply(pthread_t thread, const snd_thread_sched_t *sched,
+			   const char *role)
+{
+	int err, ret = 0;
+
+	if (!sched)
+		return 0;
+	if (sched->has_policy) {
+		struct sched_param param;
+
+		memset(&param, 0, sizeof(param));
+		param.sched_priority = sched->priority;
+		err = pthread_setschedparam(thread, sched->policy, &param);
+		if (err) {
+			SNDERR("Unable to set the scheduling of the %s thread: %s",
+			       role, strerror(err));
+			ret = -err;
+		}
+	}
+	if (sched->has_cpus) {
+		err = pthread_setaffinity_np(thread, sizeof(sched->cpus),
+					     &sched->cpus);
+		if (err) {
+			SNDERR("Unable to set the CPUs of the %s thread: %s",
+			       role, strerror(err));
+			if (!ret)
+				ret = -err;
+		}
+	}
+	return ret;
+}
+
+/*
+ * pthread_create() for the library threads: the thread comes from the
+ * factory of the application, if any, and gets the scheduling of its
+ * role; returns like pthread_create()
+ */
+int snd_thread_create(pthread_t *thread, const char *role,
+		      void *(*start)(void *), void *arg)
+{
+	snd_thread_sched_t *sched = snd_thread_sched_get(role);
+	snd_thread_factory_t factory;
+	void *private_data;
+	int err;
+
+	pthread_mutex_lock(&thread_mutex);
+	factory = thread_factory;
+	private_data = thread_factory_private;
+	pthread_mutex_unlock(&thread_mutex);
+	if (factory) {
+		err = factory(thread, role, start, arg, private_data);
+		err = err < 0 ? -err : err;
+	} else {
+		err = pthread_create(thread, NULL, start, arg);
+	}
+	if (!err)
+		snd_thread_sched_apply(*thread, sched, role);
+	free(sched);
+	return err;
+}
+
+#endif /* HAVE_LIBPTHREAD */
+
+/**
+ * \brief Sets the function creating the threads of the library.
+ * \param factory The factory, NULL for pthread_create().
+ * \param private_data Passed to the factory.
+ * \return Zero if successful, otherwise a negative error code.
+ *
+ * The factory is called for every thread the library starts, with the
+ * role of the thread (e.g. "pcm_share", see #snd_thread_set_sched),
+ * and must start \p start with \p arg in a new joinable thread and store
+ * its id in \p thread, which points to a \c pthread_t.  It returns zero or a negative error code.  This
+ * lets an application keep the library threads in its own thread pool
+ * or give them its own scheduling attributes; the settings of
+ * #snd_thread_set_sched and #snd_thread_set_affinity or of the
+ * configuration are applied on top when the factory returns.
+ *
+ * The factory is not used for the threads started before it is set.
+ *
+ * This function is added in version 1.2.8.
+ */
+int snd_thread_set_factory(snd_thread_factory_t factory, void *private_data)
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock(&thread_mutex);
+	thread_factory = factory;
+	thread_factory_private = private_data;
+	pthread_mutex_unlock(&thread_mutex);
+	return 0;
+#else
+	return -ENOSYS;
+#endif
+}
+
+/**
+ * \brief Sets the scheduling policy of the threads of the library.
+ * \param role The role of the threads, NULL or "default" for all.
+ * \param policy SCHED_OTHER, SCHED_FIFO, SCHED_RR, ... or -1 to clear.
+ * \param priority The static priority for SCHED_FIFO and SCHED_RR.
+ * \return Zero if successful, otherwise a negative error code.
+ *
+ * The roles are pcm_share, pcm_meter, pcm_rate, pcm_file, pcm_multi,
+ * pcm_ladspa, pcm_softvol, ctl_mirror, async and pcm_direct_server (the
+ * server process of the dmix, dsnoop and dshare plugins).  A setting
+ * overrides the \c defaults.thread.ROLE.policy and \c priority keys of
+ * the configuration and applies to the threads started afterwards.
+ *
+ * This function is added in version 1.2.8.
+ */
+int snd_thread_set_sched(const char *role, int policy, int priority)
+{
+#ifdef HAVE_LIBPTHREAD
+	struct thread_role *r;
+
+	if (!role)
+		role = "default";
+	if (policy >= 0 && (priority < sched_get_priority_min(policy) ||
+			    priority > sched_get_priority_max(policy)))
+		return -EINVAL;
+	pthread_mutex_lock(&thread_mutex);
+	r = thread_role_get(role);
+	if (r) {
+		r->sched.has_policy = policy >= 0;
+		r->sched.policy = policy;
+		r->sched.priority = priority;
+	}
+	pthread_mutex_unlock(&thread_mutex);
+	return r ? 0 : -ENOMEM;
+#else
+	return -ENOSYS;
+#endif
+}
+
+/**
+ * \brief Sets the CPUs of the threads of the library.
+ * \param role The role of the threads, NULL or "default" for all.
+ * \param cpus A list of CPUs like "2-3,6", NULL to clear.
+ * \return Zero if successful, otherwise a negative error code.
+ *
+ * The roles are those of #snd_thread_set_sched.  A setting overrides
+ * the \c defaults.thread.ROLE.cpus key of the configuration and applies
+ * to the threads started afterwards.
+ *
+ * This function is added in version 1.2.8.
+ */
+int snd_thread_set_affinity(const char *role, const char *cpus)
+{
+#ifdef HAVE_LIBPTHREAD
+	struct thread_role *r;
+	cpu_set_t set;
+	int err;
+
+	if (!role)
+		role = "default";
+	if (cpus) {
+		err = thread_parse_cpus(cpus, &set);
+		if (err < 0)
+			return err;
+	}
+	pthread_mutex_lock(&thread_mutex);
+	r = thread_role_get(role);
+	if (r) {
+		r->sched.has_cpus = cpus != NULL;
+		if (cpus)
+			r->sched.cpus = set;
+	}
+	pthread_mutex_unlock(&thread_mutex);
+	return r ? 0 : -ENOMEM;
+#else
+	return -ENOSYS;
+#endif
+}
@@ -51,6 +51,14 @@ device until resources are not free.
 
 Events are read via snd_timer_read() function.
 
+For handles opened with #SND_TIMER_OPEN_TREAD, snd_timer_read_events()
+fills an array of #snd_timer_tread_t records with one read.
+snd_timer_tread_next() returns the records one by one from a buffer in
+the handle which is refilled with a single read when it runs empty, so
+a high rate consumer scans all queued events with one system call per
+wakeup.  The kernel timer device cannot be mmapped, so this buffer takes
+the place of a shared event ring.
+
 \section timer_examples Examples
 
 The full featured examples with cross-links:
@@ -257,6 +265,7 @@ int snd_timer_close(snd_timer_t *timer)
 	if (timer->dl_handle)
 		snd_dlclose(timer->dl_handle);
 	free(timer->name);
+	free(timer->tbuf);
 	free(timer);
 	return err;
 }
@@ -312,7 +321,7 @@ int snd_async_add_timer_handler(snd_async_handler_t **handler, snd_timer_t *time
 	h->u.timer = timer;
 	was_empty = list_empty(&timer->async_handlers);
 	list_add_tail(&h->hlist, &timer->async_handlers);
-	if (was_empty) {
+	if (was_empty && snd_async_get_delivery() == SND_ASYNC_SIGNAL) {
 		err = snd_timer_async(timer, snd_async_handler_get_signo(h), getpid());
 		if (err < 0) {
 			snd_async_del_handler(h);
@@ -949,6 +958,95 @@ ssize_t snd_timer_read(snd_timer_t *timer, void *buffer, size_t size)
 	return (timer->ops->read)(timer, buffer, size);
 }
 
+/**
+ * \brief read timestamped timer events
+ * \param timer timer handle opened with #SND_TIMER_OPEN_TREAD
+ * \param events array to store the events
+ * \param count count of entries in the events array
+ * \return count of returned events otherwise a negative error code
+ *
+ * Events still buffered for snd_timer_tread_next() are returned first,
+ * only an empty buffer results in one read from the device.
+ */
+ssize_t snd_timer_read_events(snd_timer_t *timer, snd_timer_tread_t *events, size_t count)
+{
+	unsigned int avail;
+	ssize_t result;
+
+	assert(timer);
+	assert(events || count == 0);
+	if (!timer->tread)
+		return -EINVAL;
+	if (count == 0)
+		return 0;
+	avail = timer->tbuf_count - timer->tbuf_pos;
+	if (avail > 0) {
+		if (count > avail)
+			count = avail;
+		memcpy(events, timer->tbuf + timer->tbuf_pos, count * sizeof(*events));
+		timer->tbuf_pos += count;
+		return count;
+	}
+	result = snd_timer_read(timer, events, count * sizeof(*events));
+	if (result < 0)
+		return result;
+	return result / sizeof(*events);
+}
+
+/**
+ * \brief get the next timestamped timer event
+ * \param timer timer handle opened with #SND_TIMER_OPEN_TREAD
+ * \param[out] event pointer to the event, valid until the next call
+ * \retval 1 an event is returned
+ * \retval 0 no event, the handle is in the non-blocking mode
+ * \retval <0 a negative error code
+ *
+ * When the buffer in the handle is empty, it is refilled with all the
+ * queued events by one read; otherwise no system call is made.
+ */
+int snd_timer_tread_next(snd_timer_t *timer, const snd_timer_tread_t **event)
+{
+	ssize_t result;
+
+	assert(timer && event);
+	if (!timer->tread)
+		return -EINVAL;
+	if (timer->tbuf_pos >= timer->tbuf_count) {
+		if (!timer->tbuf) {
+			timer->tbuf_size = 64;
+			timer->tbuf = malloc(timer->tbuf_size * sizeof(*timer->tbuf));
+			if (!timer->tbuf)
+				return -ENOMEM;
+		}
+		timer->tbuf_pos = timer->tbuf_count = 0;
+		result = snd_timer_read(timer, timer->tbuf,
+					timer->tbuf_size * sizeof(*timer->tbuf));
+		if (result == -EAGAIN)
+			return 0;
+		if (result < 0)
+			return result;
+		timer->tbuf_count = result / sizeof(*timer->tbuf);
+		if (timer->tbuf_count == 0)
+			return 0;
+	}
+	*event = &timer->tbuf[timer->tbuf_pos++];
+	return 1;
+}
+
+/**
+ * \brief count of buffered timer events
+ * \param timer timer handle
+ * \return count of events buffered for snd_timer_tread_next()
+ *
+ * No system call is made; check the poll descriptor for new events
+ * when this returns zero.
+ */
+unsigned int snd_timer_tread_pending(snd_timer_t *timer)
+{
+	assert(timer);
+	return timer->tbuf_count - timer->tbuf_pos;
+}
+
 /**
  * \brief (DEPRECATED) get maximum timer ticks
  * \param info pointer to #snd_timer_info_t structure
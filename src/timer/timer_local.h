@@ -43,10 +43,15 @@ struct _snd_timer {
 	char *name;
 	snd_timer_type_t type;
 	int mode;
+	int tread;			/* opened with SND_TIMER_OPEN_TREAD */
 	int poll_fd;
 	const snd_timer_ops_t *ops;
 	void *private_data;
 	struct list_head async_handlers;
+	snd_timer_tread_t *tbuf;	/* buffered tread records */
+	unsigned int tbuf_size;		/* allocated records */
+	unsigned int tbuf_count;	/* records in tbuf */
+	unsigned int tbuf_pos;		/* next record to return */
 };
 
 typedef struct {
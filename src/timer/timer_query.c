@@ -27,6 +27,10 @@
  */
 
 #include "timer_local.h"
+#include <sys/stat.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 static int snd_timer_query_open_conf(snd_timer_query_t **timer,
 				     const char *name, snd_config_t *timer_root,
@@ -225,6 +229,179 @@ int snd_timer_query_next_device(snd_timer_query_t *timer, snd_timer_id_t *tid)
 	return timer->ops->next_device(timer, tid);
 }
 
+/*
+ * The timer catalog: the hw timers with their global information, read
+ * with one query handle the first time it is needed and kept for the
+ * process.  Cards coming and going create and remove their nodes in the
+ * device directory, so a change of it rebuilds the catalog.
+ */
+static snd_timer_ginfo_t *timer_catalog;
+static unsigned int timer_catalog_count;
+static int timer_catalog_valid;
+static struct {
+	dev_t dev;
+	ino_t ino;
+	struct timespec mtime;
+} timer_catalog_devdir;
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t timer_catalog_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define timer_catalog_lock()	pthread_mutex_lock(&timer_catalog_mutex)
+#define timer_catalog_unlock()	pthread_mutex_unlock(&timer_catalog_mutex)
+#else
+#define timer_catalog_lock()	do { } while (0)
+#define timer_catalog_unlock()	do { } while (0)
+#endif
+
+static int timer_catalog_build(void)
+{
+	snd_timer_query_t *query;
+	snd_timer_ginfo_t *list = NULL, *nlist;
+	snd_timer_id_t tid;
+	unsigned int count = 0, alloc = 0;
+	int err;
+
+	err = snd_timer_query_hw_open(&query, "hw", 0);
+	if (err < 0)
+		return err;
+	memset(&tid, 0, sizeof(tid));
+	tid.dev_class = SND_TIMER_CLASS_NONE;
+	while ((err = snd_timer_query_next_device(query, &tid)) >= 0 &&
+	       tid.dev_class != SND_TIMER_CLASS_NONE) {
+		if (count == alloc) {
+			alloc = alloc ? alloc * 2 : 16;
+			nlist = realloc(list, alloc * sizeof(*list));
+			if (nlist == NULL) {
+				err = -ENOMEM;
+				break;
+			}
+			list = nlist;
+		}
+		memset(&list[count], 0, sizeof(list[count]));
+		list[count].tid = tid;
+		/* a timer going away meanwhile is left out */
+		if (INTERNAL(snd_timer_query_info)(query, &list[count]) >= 0)
+			count++;
+	}
+	snd_timer_query_close(query);
+	if (err < 0) {
+		free(list);
+		return err;
+	}
+	free(timer_catalog);
+	timer_catalog = list;
+	timer_catalog_count = count;
+	return 0;
+}
+
+static int timer_catalog_update(void)
+{
+	struct stat st;
+	int err;
+
+	if (stat(ALSA_DEVICE_DIRECTORY, &st) < 0)
+		return -errno;
+	if (timer_catalog_valid &&
+	    timer_catalog_devdir.dev == st.st_dev &&
+	    timer_catalog_devdir.ino == st.st_ino &&
+	    timer_catalog_devdir.mtime.tv_sec == st.st_mtim.tv_sec &&
+	    timer_catalog_devdir.mtime.tv_nsec == st.st_mtim.tv_nsec)
+		return 0;
+	timer_catalog_valid = 0;
+	err = timer_catalog_build();
+	if (err < 0)
+		return err;
+	timer_catalog_devdir.dev = st.st_dev;
+	timer_catalog_devdir.ino = st.st_ino;
+	timer_catalog_devdir.mtime = st.st_mtim;
+	timer_catalog_valid = 1;
+	return 0;
+}
+
+/* the order of SNDRV_TIMER_IOCTL_NEXT_DEVICE */
+static int timer_id_cmp(const snd_timer_id_t *a, const snd_timer_id_t *b)
+{
+	if (a->dev_class != b->dev_class)
+		return a->dev_class < b->dev_class ? -1 : 1;
+	if (a->card != b->card)
+		return a->card < b->card ? -1 : 1;
+	if (a->device != b->device)
+		return a->device < b->device ? -1 : 1;
+	if (a->subdevice != b->subdevice)
+		return a->subdevice < b->subdevice ? -1 : 1;
+	return 0;
+}
+
+/**
+ * \brief obtain the next timer identification from the timer catalog
+ * \param tid timer identification
+ * \return 0 on success otherwise a negative error code
+ *
+ * Works like #snd_timer_query_next_device() on a "hw" query handle, but
+ * without one: the timers are enumerated once per process and again
+ * only after a card was added or removed.
+ *
+ * if tid->dev_class is -1, then the first device is returned
+ * if result tid->dev_class is -1, no more devices are left
+ */
+int snd_timer_catalog_next(snd_timer_id_t *tid)
+{
+	unsigned int k;
+	int err;
+
+	assert(tid);
+	timer_catalog_lock();
+	err = timer_catalog_update();
+	if (err >= 0) {
+		for (k = 0; k < timer_catalog_count; k++) {
+			if (tid->dev_class == SND_TIMER_CLASS_NONE ||
+			    timer_id_cmp(&timer_catalog[k].tid, tid) > 0)
+				break;
+		}
+		if (k < timer_catalog_count) {
+			*tid = timer_catalog[k].tid;
+		} else {
+			memset(tid, 0, sizeof(*tid));
+			tid->dev_class = SND_TIMER_CLASS_NONE;
+		}
+	}
+	timer_catalog_unlock();
+	return err;
+}
+
+/**
+ * \brief obtain the global information of a timer from the timer catalog
+ * \param info timer information, with the timer identification set
+ * \return 0 on success otherwise a negative error code, -ENOENT when
+ *         no such timer is present
+ *
+ * The resolutions are those read when the catalog was built; the count
+ * of clients in particular may be out of date.
+ *
+ * \sa snd_timer_catalog_next(), snd_timer_query_info()
+ */
+int snd_timer_catalog_info(snd_timer_ginfo_t *info)
+{
+	unsigned int k;
+	int err;
+
+	assert(info);
+	timer_catalog_lock();
+	err = timer_catalog_update();
+	if (err >= 0) {
+		err = -ENOENT;
+		for (k = 0; k < timer_catalog_count; k++) {
+			if (timer_id_cmp(&timer_catalog[k].tid, &info->tid) == 0 &&
+			    timer_catalog[k].tid.dev_sclass == info->tid.dev_sclass) {
+				*info = timer_catalog[k];
+				err = 0;
+				break;
+			}
+		}
+	}
+	timer_catalog_unlock();
+	return err;
+}
+
 /**
  * \brief get size of the snd_timer_ginfo_t structure in bytes
  * \return size of the snd_timer_ginfo_t structure in bytes
@@ -20,11 +20,71 @@
 #include "list.h"
 #include "tplg_local.h"
 
+/* staging buffer size for streaming output */
+#define TPLG_OUT_BUF_SIZE	(64 * 1024)
+
+/* flush the staging buffer to the output fd */
+static ssize_t tflush(snd_tplg_t *tplg)
+{
+	size_t pos = 0;
+	ssize_t r;
+
+	while (pos < tplg->out_fill) {
+		r = write(tplg->out_fd, tplg->bin + pos, tplg->out_fill - pos);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			r = -errno;
+			SNDERR("write error: %s", strerror(errno));
+			return r;
+		}
+		tplg->stats.writes++;
+		pos += r;
+	}
+	tplg->out_fill = 0;
+	return 0;
+}
+
+/* write a block to the output fd, small blocks are coalesced */
+static ssize_t twrite_fd(snd_tplg_t *tplg, void *data, size_t data_size)
+{
+	ssize_t r;
+
+	if (tplg->out_fill + data_size > TPLG_OUT_BUF_SIZE) {
+		r = tflush(tplg);
+		if (r < 0)
+			return r;
+	}
+	if (data_size >= TPLG_OUT_BUF_SIZE) {
+		size_t pos = 0;
+
+		while (pos < data_size) {
+			r = write(tplg->out_fd, (char *)data + pos, data_size - pos);
+			if (r < 0) {
+				if (errno == EINTR)
+					continue;
+				r = -errno;
+				SNDERR("write error: %s", strerror(errno));
+				return r;
+			}
+			tplg->stats.writes++;
+			pos += r;
+		}
+	} else {
+		memcpy(tplg->bin + tplg->out_fill, data, data_size);
+		tplg->out_fill += data_size;
+	}
+	tplg->bin_pos += data_size;
+	return data_size;
+}
+
 /* write a block, track the position */
 static ssize_t twrite(snd_tplg_t *tplg, void *data, size_t data_size)
 {
 	if (tplg->bin_pos + data_size > tplg->bin_size)
 		return -EIO;
+	if (tplg->out_fd >= 0)
+		return twrite_fd(tplg, data, data_size);
 	memcpy(tplg->bin + tplg->bin_pos, data, data_size);
 	tplg->bin_pos += data_size;
 	return data_size;
@@ -66,6 +126,7 @@ static ssize_t write_block_header(snd_tplg_t *tplg, unsigned int type,
 		 vendor_type, version);
 
 	tplg->next_hdr_pos += hdr.payload_size + sizeof(hdr);
+	tplg->stats.blocks++;
 
 	return twrite(tplg, &hdr, sizeof(hdr));
 }
@@ -121,9 +182,10 @@ static int write_elem_block(snd_tplg_t *tplg,
 
 				wsize = twrite(tplg, elem->obj, elem->size);
 				if (wsize < 0)
-					return size;
+					return wsize;
 
 				total_size += wsize;
+				tplg->stats.elems++;
 				/* get to the end of sub list */
 				if (sub_pos == pos)
 					break;
@@ -153,11 +215,14 @@ static size_t calc_manifest_size(snd_tplg_t *tplg)
 	       tplg->manifest.priv.size;
 }
 
-static size_t calc_real_size(struct list_head *base)
+/* calculate the payload size and the size including block headers
+ * for all elems in this list in one pass
+ */
+static size_t calc_list_size(struct list_head *base, size_t *block_size)
 {
 	struct list_head *pos;
 	struct tplg_elem *elem, *elem_next;
-	size_t size = 0;
+	size_t size = 0, bsize = 0;
 
 	list_for_each(pos, base) {
 
@@ -167,6 +232,8 @@ static size_t calc_real_size(struct list_head *base)
 		if (elem->compound_elem)
 			continue;
 
+		bsize += elem->size;
+
 		if (elem->size <= 0)
 			continue;
 
@@ -178,26 +245,7 @@ static size_t calc_real_size(struct list_head *base)
 			size += sizeof(struct snd_soc_tplg_hdr);
 	}
 
-	return size;
-}
-
-static size_t calc_block_size(struct list_head *base)
-{
-	struct list_head *pos;
-	struct tplg_elem *elem;
-	size_t size = 0;
-
-	list_for_each(pos, base) {
-
-		elem = list_entry(pos, struct tplg_elem, list);
-
-		/* compound elems have already been copied to other elems */
-		if (elem->compound_elem)
-			continue;
-
-		size += elem->size;
-	}
-
+	*block_size = bsize;
 	return size;
 }
 
@@ -227,34 +275,51 @@ static ssize_t write_manifest_data(snd_tplg_t *tplg)
 	return ret;
 }
 
-int tplg_write_data(snd_tplg_t *tplg)
+static unsigned long long tplg_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/* compute the total image size and the block size of each table item */
+static size_t tplg_layout(snd_tplg_t *tplg, size_t *block_sizes)
 {
 	struct tplg_table *tptr;
 	struct list_head *list;
-	ssize_t ret;
-	size_t total_size, size;
+	unsigned long long t0 = tplg_usec();
+	size_t total_size;
 	unsigned int index;
 
-	/* calculate total size */
 	total_size = calc_manifest_size(tplg);
 	for (index = 0; index < tplg_table_items; index++) {
 		tptr = &tplg_table[index];
+		block_sizes[index] = 0;
 		if (!tptr->build)
 			continue;
 		list = (struct list_head *)((void *)tplg + tptr->loff);
-		size = calc_real_size(list);
-		total_size += size;
+		total_size += calc_list_size(list, &block_sizes[index]);
 	}
 
-	/* allocate new binary output */
-	free(tplg->bin);
-	tplg->bin = malloc(total_size);
+	tplg->stats.size = total_size;
+	tplg->stats.layout_usec = tplg_usec() - t0;
+	return total_size;
+}
+
+/* write the manifest and all blocks to the prepared output */
+static int tplg_write_blocks(snd_tplg_t *tplg, const size_t *block_sizes,
+			     size_t total_size)
+{
+	struct tplg_table *tptr;
+	struct list_head *list;
+	unsigned long long t0 = tplg_usec();
+	ssize_t ret;
+	size_t size;
+	unsigned int index;
+
 	tplg->bin_pos = 0;
 	tplg->bin_size = total_size;
-	if (tplg->bin == NULL) {
-		tplg->bin_size = 0;
-		return -ENOMEM;
-	}
 
 	/* write manifest */
 	ret = write_manifest_data(tplg);
@@ -269,8 +334,8 @@ int tplg_write_data(snd_tplg_t *tplg)
 		if (!tptr->build)
 			continue;
 		list = (struct list_head *)((void *)tplg + tptr->loff);
-		/* calculate the block size in bytes for all elems in this list */
-		size = calc_block_size(list);
+		/* the block size in bytes for all elems in this list */
+		size = block_sizes[index];
 		if (size == 0)
 			continue;
 		tplg_log(tplg, 'B', tplg->bin_pos,
@@ -286,6 +351,12 @@ int tplg_write_data(snd_tplg_t *tplg)
 		}
 	}
 
+	if (tplg->out_fd >= 0) {
+		ret = tflush(tplg);
+		if (ret < 0)
+			return ret;
+	}
+
 	tplg_log(tplg, 'B', tplg->bin_pos, "total size is 0x%zx/%zd",
 		 tplg->bin_pos, tplg->bin_pos);
 
@@ -295,5 +366,197 @@ int tplg_write_data(snd_tplg_t *tplg)
 		return -EINVAL;
 	}
 
+	tplg->stats.write_usec = tplg_usec() - t0;
 	return 0;
 }
+
+static void tplg_stats_reset(snd_tplg_t *tplg)
+{
+	unsigned long integ_usec = tplg->stats.integ_usec;
+
+	memset(&tplg->stats, 0, sizeof(tplg->stats));
+	tplg->stats.integ_usec = integ_usec;
+	tplg->next_hdr_pos = 0;
+}
+
+/* build the image into a malloc'ed buffer (tplg->bin) */
+int tplg_write_data(snd_tplg_t *tplg)
+{
+	size_t block_sizes[tplg_table_items];
+	size_t total_size;
+
+	tplg_stats_reset(tplg);
+	total_size = tplg_layout(tplg, block_sizes);
+
+	/* allocate new binary output */
+	free(tplg->bin);
+	tplg->bin = malloc(total_size);
+	tplg->bin_pos = 0;
+	tplg->bin_size = total_size;
+	if (tplg->bin == NULL) {
+		tplg->bin_size = 0;
+		return -ENOMEM;
+	}
+
+	return tplg_write_blocks(tplg, block_sizes, total_size);
+}
+
+/* stream the image to fd through a small staging buffer */
+int tplg_write_fd(snd_tplg_t *tplg, int fd)
+{
+	size_t block_sizes[tplg_table_items];
+	size_t total_size;
+	int err;
+
+	tplg_stats_reset(tplg);
+	total_size = tplg_layout(tplg, block_sizes);
+
+	free(tplg->bin);
+	tplg->bin = malloc(TPLG_OUT_BUF_SIZE);
+	if (tplg->bin == NULL)
+		return -ENOMEM;
+	tplg->out_fd = fd;
+	tplg->out_fill = 0;
+	err = tplg_write_blocks(tplg, block_sizes, total_size);
+	tplg->out_fd = -1;
+	free(tplg->bin);
+	tplg->bin = NULL;
+	tplg->bin_size = tplg->bin_pos = 0;
+	return err;
+}
+
+/* write the image into a caller provided buffer */
+int tplg_write_mem(snd_tplg_t *tplg, void *buf, size_t size, size_t *used)
+{
+	size_t block_sizes[tplg_table_items];
+	size_t total_size;
+	int err;
+
+	tplg_stats_reset(tplg);
+	total_size = tplg_layout(tplg, block_sizes);
+	if (used)
+		*used = total_size;
+	if (size < total_size)
+		return -ENOSPC;
+
+	free(tplg->bin);
+	tplg->bin = buf;
+	err = tplg_write_blocks(tplg, block_sizes, total_size);
+	tplg->bin = NULL;
+	tplg->bin_size = tplg->bin_pos = 0;
+	return err;
+}
+
+/* the output file is still the one written by the last incremental build */
+static bool inc_out_valid(snd_tplg_t *tplg, const struct stat *st)
+{
+	return tplg->inc_bin &&
+	       st->st_dev == tplg->inc_out.st_dev &&
+	       st->st_ino == tplg->inc_out.st_ino &&
+	       st->st_size == tplg->inc_out.st_size &&
+	       st->st_mtim.tv_sec == tplg->inc_out.st_mtim.tv_sec &&
+	       st->st_mtim.tv_nsec == tplg->inc_out.st_mtim.tv_nsec;
+}
+
+static int pwrite_all(snd_tplg_t *tplg, int fd, const void *data,
+		      size_t size, off_t offset)
+{
+	size_t pos = 0;
+	ssize_t r;
+
+	while (pos < size) {
+		r = pwrite(fd, (const char *)data + pos, size - pos,
+			   offset + pos);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			r = -errno;
+			SNDERR("write error: %s", strerror(errno));
+			return r;
+		}
+		tplg->stats.writes++;
+		pos += r;
+	}
+	return 0;
+}
+
+/*
+ * Build the image in memory and write only the blocks that differ from
+ * the image of the previous build at the same offset.  Nothing is
+ * written when neither the source nor the output file changed.
+ */
+int tplg_write_file_incremental(snd_tplg_t *tplg, const char *outfile)
+{
+	struct snd_soc_tplg_hdr *hdr;
+	struct stat st;
+	size_t pos, size;
+	bool valid;
+	int fd, err;
+
+	fd = open(outfile, O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		SNDERR("failed to open %s err %d", outfile, -errno);
+		return -errno;
+	}
+	if (fstat(fd, &st) < 0) {
+		err = -errno;
+		goto out;
+	}
+	valid = inc_out_valid(tplg, &st);
+
+	if (valid && tplg->inc_clean && tplg->version == tplg->inc_version) {
+		tplg_stats_reset(tplg);
+		tplg->stats.size = tplg->inc_bin_size;
+		tplg->stats.blocks = tplg->inc_blocks;
+		tplg->stats.reused = tplg->inc_blocks;
+		err = 0;
+		goto out;
+	}
+
+	err = tplg_write_data(tplg);
+	if (err < 0)
+		goto out;
+	tplg->stats.writes = 0;
+
+	for (pos = 0; pos < tplg->bin_size; pos += size) {
+		hdr = (struct snd_soc_tplg_hdr *)(tplg->bin + pos);
+		size = hdr->size + hdr->payload_size;
+		if (valid && pos + size <= tplg->inc_bin_size &&
+		    memcmp(tplg->inc_bin + pos, tplg->bin + pos, size) == 0) {
+			tplg->stats.reused++;
+			continue;
+		}
+		err = pwrite_all(tplg, fd, tplg->bin + pos, size, pos);
+		if (err < 0)
+			goto fail;
+	}
+	if ((size_t)st.st_size != tplg->bin_size &&
+	    ftruncate(fd, tplg->bin_size) < 0) {
+		err = -errno;
+		SNDERR("failed to truncate %s: %s", outfile, strerror(errno));
+		goto fail;
+	}
+	if (fstat(fd, &tplg->inc_out) < 0) {
+		err = -errno;
+		goto fail;
+	}
+
+	/* keep the image to compare the next build with */
+	free(tplg->inc_bin);
+	tplg->inc_bin = tplg->bin;
+	tplg->inc_bin_size = tplg->bin_size;
+	tplg->inc_blocks = tplg->stats.blocks;
+	tplg->inc_version = tplg->version;
+	tplg->bin = NULL;
+	tplg->bin_size = tplg->bin_pos = 0;
+	goto out;
+
+fail:
+	/* the file is in an unknown state, the next build rewrites it */
+	free(tplg->inc_bin);
+	tplg->inc_bin = NULL;
+	tplg->inc_bin_size = 0;
+out:
+	close(fd);
+	return err;
+}
@@ -128,7 +128,7 @@ static int tplg_build_widget(snd_tplg_t *tplg, struct tplg_elem *elem)
 		switch (ref->type) {
 		case SND_TPLG_TYPE_MIXER:
 			if (!ref->elem)
-				ref->elem = tplg_elem_lookup(&tplg->mixer_list,
+				ref->elem = tplg_elem_lookup(tplg, &tplg->mixer_list,
 				ref->id, SND_TPLG_TYPE_MIXER, elem->index);
 			if (ref->elem)
 				err = copy_dapm_control(elem, ref->elem);
@@ -136,7 +136,7 @@ static int tplg_build_widget(snd_tplg_t *tplg, struct tplg_elem *elem)
 
 		case SND_TPLG_TYPE_ENUM:
 			if (!ref->elem)
-				ref->elem = tplg_elem_lookup(&tplg->enum_list,
+				ref->elem = tplg_elem_lookup(tplg, &tplg->enum_list,
 				ref->id, SND_TPLG_TYPE_ENUM, elem->index);
 			if (ref->elem)
 				err = copy_dapm_control(elem, ref->elem);
@@ -144,7 +144,7 @@ static int tplg_build_widget(snd_tplg_t *tplg, struct tplg_elem *elem)
 
 		case SND_TPLG_TYPE_BYTES:
 			if (!ref->elem)
-				ref->elem = tplg_elem_lookup(&tplg->bytes_ext_list,
+				ref->elem = tplg_elem_lookup(tplg, &tplg->bytes_ext_list,
 				ref->id, SND_TPLG_TYPE_BYTES, elem->index);
 			if (ref->elem)
 				err = copy_dapm_control(elem, ref->elem);
@@ -220,16 +220,16 @@ int tplg_build_routes(snd_tplg_t *tplg)
 			return -EINVAL;
 
 		}
-		if (!tplg_elem_lookup(&tplg->widget_list, route->sink,
+		if (!tplg_elem_lookup(tplg, &tplg->widget_list, route->sink,
 			SND_TPLG_TYPE_DAPM_WIDGET, SND_TPLG_INDEX_ALL)) {
 			SNDERR("undefined sink widget/stream '%s'", route->sink);
 		}
 
 		/* validate control name */
 		if (strlen(route->control)) {
-			if (!tplg_elem_lookup(&tplg->mixer_list, route->control,
+			if (!tplg_elem_lookup(tplg, &tplg->mixer_list, route->control,
 					SND_TPLG_TYPE_MIXER, elem->index) &&
-			!tplg_elem_lookup(&tplg->enum_list, route->control,
+			!tplg_elem_lookup(tplg, &tplg->enum_list, route->control,
 					SND_TPLG_TYPE_ENUM, elem->index)) {
 				SNDERR("undefined mixer/enum control '%s'",
 				       route->control);
@@ -242,7 +242,7 @@ int tplg_build_routes(snd_tplg_t *tplg)
 			return -EINVAL;
 
 		}
-		if (!tplg_elem_lookup(&tplg->widget_list, route->source,
+		if (!tplg_elem_lookup(tplg, &tplg->widget_list, route->source,
 			SND_TPLG_TYPE_DAPM_WIDGET, SND_TPLG_INDEX_ALL)) {
 			SNDERR("undefined source widget/stream '%s'",
 			       route->source);
@@ -20,6 +20,10 @@
 #include "list.h"
 #include "tplg_local.h"
 #include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define UUID_FORMAT "\
 %02x:%02x:%02x:%02x:%02x:%02x:%02x:%02x:\
@@ -159,39 +163,107 @@ int tplg_save_refs(snd_tplg_t *tplg ATTRIBUTE_UNUSED,
 	return tplg_save_printf(dst, pfx, "]\n");
 }
 
+/*
+ * Map a data file behind the private data header: the file pages follow
+ * an anonymous page whose tail holds the header, so elem->data stays one
+ * contiguous block and the file contents are only copied by the builder,
+ * when merged into the referencing element.  Returns 0 when the file was
+ * mapped, 1 when it should be read instead.
+ */
+static int tplg_map_data_file(int fd, size_t size, struct tplg_elem *elem)
+{
+	struct snd_soc_tplg_private *priv;
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t map_size = page + size;
+	char *map;
+
+	if (size < page)
+		return 1;	/* not worth a mapping */
+
+	map = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED)
+		return 1;
+	if (mmap(map + page, size, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		munmap(map, map_size);
+		return 1;
+	}
+
+	priv = (struct snd_soc_tplg_private *)(map + page - sizeof(*priv));
+	priv->size = size;
+	elem->data = priv;
+	elem->size = sizeof(*priv) + size;
+	elem->map = map;
+	elem->map_size = map_size;
+	return 0;
+}
+
+/* Move mapped private data to the heap before it is resized. */
+int tplg_data_unmap(struct tplg_elem *elem)
+{
+	struct snd_soc_tplg_private *priv;
+
+	if (!elem->map)
+		return 0;
+
+	priv = malloc(elem->size);
+	if (!priv)
+		return -ENOMEM;
+
+	memcpy(priv, elem->data, elem->size);
+	munmap(elem->map, elem->map_size);
+	elem->map = NULL;
+	elem->map_size = 0;
+	elem->data = priv;
+	return 0;
+}
+
+/* Path of a data file, relative to ALSA_CONFIG_TPLG or the topology
+ * config directory.
+ */
+void tplg_data_file_path(const char *name, char *path, size_t size)
+{
+	char *env = getenv(ALSA_CONFIG_TPLG_VAR);
+
+	/* prepend alsa config directory to path */
+	if (env)
+		snprintf(path, size, "%s/%s", env, name);
+	else
+		snprintf(path, size, "%s/topology/%s",
+			 snd_config_topdir(), name);
+}
+
 /* Get Private data from a file. */
 static int tplg_parse_data_file(snd_config_t *cfg, struct tplg_elem *elem)
 {
 	struct snd_soc_tplg_private *priv = NULL;
 	const char *value = NULL;
 	char filename[PATH_MAX];
-	char *env = getenv(ALSA_CONFIG_TPLG_VAR);
-	FILE *fp;
-	size_t size, bytes_read;
-	int ret = 0;
+	struct stat st;
+	size_t size, pos;
+	ssize_t bytes_read;
+	int fd, ret = 0;
 
 	tplg_dbg("data DataFile: %s", elem->id);
 
 	if (snd_config_get_string(cfg, &value) < 0)
 		return -EINVAL;
 
-	/* prepend alsa config directory to path */
-	if (env)
-		snprintf(filename, sizeof(filename), "%s/%s", env, value);
-	else
-		snprintf(filename, sizeof(filename), "%s/topology/%s",
-			 snd_config_topdir(), value);
+	tplg_data_file_path(value, filename, sizeof(filename));
 
-	fp = fopen(filename, "r");
-	if (fp == NULL) {
+	fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
 		SNDERR("invalid data file path '%s'", filename);
 		return -errno;
 	}
 
-	fseek(fp, 0L, SEEK_END);
-	size = ftell(fp);
-	fseek(fp, 0L, SEEK_SET);
-	if (size <= 0) {
+	if (fstat(fd, &st) < 0) {
+		ret = -errno;
+		goto err;
+	}
+	size = st.st_size;
+	if (!S_ISREG(st.st_mode) || size <= 0) {
 		SNDERR("invalid data file size %zu", size);
 		ret = -EINVAL;
 		goto err;
@@ -202,30 +274,50 @@ static int tplg_parse_data_file(snd_config_t *cfg, struct tplg_elem *elem)
 		goto err;
 	}
 
+	/* the file replaces any data given before it */
+	if (elem->map) {
+		munmap(elem->map, elem->map_size);
+		elem->map = NULL;
+		elem->map_size = 0;
+	} else {
+		free(elem->data);
+	}
+	elem->data = NULL;
+
+	if (tplg_map_data_file(fd, size, elem) == 0)
+		goto out;
+
 	priv = calloc(1, sizeof(*priv) + size);
 	if (!priv) {
 		ret = -ENOMEM;
 		goto err;
 	}
 
-	bytes_read = fread(&priv->data, 1, size, fp);
-	if (bytes_read != size) {
-		ret = -errno;
-		goto err;
+	for (pos = 0; pos < size; pos += bytes_read) {
+		bytes_read = read(fd, priv->data + pos, size - pos);
+		if (bytes_read < 0 && errno == EINTR) {
+			bytes_read = 0;
+			continue;
+		}
+		if (bytes_read <= 0) {
+			ret = bytes_read < 0 ? -errno : -EIO;
+			goto err;
+		}
 	}
 
 	elem->data = priv;
 	priv->size = size;
 	elem->size = sizeof(*priv) + size;
 
-	if (fclose(fp) == EOF) {
+out:
+	if (close(fd) < 0) {
 		SNDERR("Cannot close data file.");
 		return -errno;
 	}
 	return 0;
 
 err:
-	fclose(fp);
+	close(fd);
 	if (priv)
 		free(priv);
 	return ret;
@@ -481,6 +573,9 @@ static int tplg_parse_data_hex(snd_config_t *cfg, struct tplg_elem *elem,
 	}
 
 	size = num * width;
+	ret = tplg_data_unmap(elem);
+	if (ret < 0)
+		return ret;
 	priv = elem->data;
 
 	if (size > TPLG_MAX_PRIV_SIZE) {
@@ -541,7 +636,7 @@ static struct tplg_elem *get_tokens(snd_tplg_t *tplg, struct tplg_elem *elem)
 			continue;
 
 		if (!ref->elem) {
-			ref->elem = tplg_elem_lookup(&tplg->token_list,
+			ref->elem = tplg_elem_lookup(tplg, &tplg->token_list,
 				ref->id, SND_TPLG_TYPE_TOKEN, elem->index);
 		}
 
@@ -600,6 +695,9 @@ static int copy_tuples(struct tplg_elem *elem,
 	unsigned int i, j;
 	int token_val;
 
+	if (tplg_data_unmap(elem) < 0)
+		return -ENOMEM;
+	priv = elem->data;
 	size = priv ? priv->size : 0; /* original private data size */
 
 	/* scan each tuples set (one set per type) */
@@ -690,7 +788,7 @@ static int build_tuples(snd_tplg_t *tplg, struct tplg_elem *elem)
 		tplg_dbg("tuples '%s' used by data '%s'", ref->id, elem->id);
 
 		if (!ref->elem)
-			ref->elem = tplg_elem_lookup(&tplg->tuple_list,
+			ref->elem = tplg_elem_lookup(tplg, &tplg->tuple_list,
 				ref->id, SND_TPLG_TYPE_TUPLE, elem->index);
 		tuples = ref->elem;
 		if (!tuples) {
@@ -1504,7 +1602,7 @@ int tplg_copy_data(snd_tplg_t *tplg, struct tplg_elem *elem,
 	int priv_data_size, old_priv_data_size;
 	void *obj;
 
-	ref_elem = tplg_elem_lookup(&tplg->pdata_list,
+	ref_elem = tplg_elem_lookup(tplg, &tplg->pdata_list,
 				     ref->id, SND_TPLG_TYPE_DATA, elem->index);
 	if (!ref_elem) {
 		SNDERR("cannot find data '%s' referenced by"
@@ -1538,7 +1636,8 @@ int tplg_copy_data(snd_tplg_t *tplg, struct tplg_elem *elem,
 	/* merge the new data block */
 	elem->size += priv_data_size;
 	priv->size = priv_data_size + old_priv_data_size;
-	ref_elem->compound_elem = 1;
+	/* the data block may be merged by concurrent build chains */
+	__atomic_store_n(&ref_elem->compound_elem, 1, __ATOMIC_RELAXED);
 	memcpy(priv->data + old_priv_data_size,
 	       ref_elem->data->data, priv_data_size);
 
@@ -1624,7 +1723,7 @@ int tplg_add_token(snd_tplg_t *tplg, struct tplg_elem *parent,
 	unsigned int i;
 	size_t size;
 
-	elem = tplg_elem_lookup(&tplg->token_list, parent->id,
+	elem = tplg_elem_lookup(tplg, &tplg->token_list, parent->id,
 				SND_TPLG_TYPE_TOKEN, parent->index);
 	if (elem == NULL) {
 		elem = tplg_elem_new_common(tplg, NULL, parent->id,
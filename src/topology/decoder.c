@@ -41,82 +41,128 @@ int tplg_decode_template(snd_tplg_t *tplg,
 	return 0;
 }
 
-int snd_tplg_decode(snd_tplg_t *tplg, void *bin, size_t size, int dflags)
+static struct tplg_table *tplg_table_soc_lookup(unsigned int asoc_type)
+{
+	unsigned int index;
+
+	for (index = 0; index < tplg_table_items; index++)
+		if (tplg_table[index].tsoc == (int)asoc_type)
+			return &tplg_table[index];
+	return NULL;
+}
+
+int snd_tplg_block_next(const void *bin, size_t size, size_t *pos,
+			snd_tplg_block_t *blk)
+{
+	const struct snd_soc_tplg_hdr *hdr;
+	struct tplg_table *tptr;
+
+	if (bin == NULL || pos == NULL || blk == NULL || *pos > size)
+		return -EINVAL;
+	if (size == *pos)
+		return 0;
+	if (size - *pos < sizeof(*hdr)) {
+		SNDERR("incomplete header data to decode");
+		return -EINVAL;
+	}
+	hdr = bin + *pos;
+	if (hdr->magic != SND_SOC_TPLG_MAGIC) {
+		SNDERR("bad block magic %08x", hdr->magic);
+		return -EINVAL;
+	}
+	if (hdr->abi != SND_SOC_TPLG_ABI_VERSION) {
+		SNDERR("unsupported ABI version %d", hdr->abi);
+		return -EINVAL;
+	}
+	if (hdr->size != sizeof(*hdr)) {
+		SNDERR("header size mismatch");
+		return -EINVAL;
+	}
+	if (size - *pos - hdr->size < hdr->payload_size) {
+		SNDERR("incomplete payload data to decode");
+		return -EINVAL;
+	}
+	if (hdr->payload_size < 8) {
+		SNDERR("wrong payload size %d", hdr->payload_size);
+		return -EINVAL;
+	}
+	/* first block must be manifest */
+	if (*pos == 0 && hdr->type != SND_SOC_TPLG_TYPE_MANIFEST) {
+		SNDERR("first block must be manifest (value %d)", hdr->type);
+		return -EINVAL;
+	}
+
+	tptr = tplg_table_soc_lookup(hdr->type);
+	blk->type = tptr ? tptr->type : -1;
+	blk->asoc_type = hdr->type;
+	blk->index = hdr->index;
+	blk->version = hdr->version;
+	blk->vendor_type = hdr->vendor_type;
+	blk->count = hdr->count;
+	blk->offset = *pos;
+	blk->payload = bin + *pos + hdr->size;
+	blk->payload_size = hdr->payload_size;
+	*pos += hdr->size + hdr->payload_size;
+	return 1;
+}
+
+int snd_tplg_decode_block(snd_tplg_t *tplg, const void *bin,
+			  const snd_tplg_block_t *blk, int dflags)
 {
 	struct snd_soc_tplg_hdr *hdr;
 	struct tplg_table *tptr;
 	size_t pos;
-	void *b = bin;
-	unsigned int index;
 	int err;
 
 	if (dflags != 0)
 		return -EINVAL;
-	if (tplg == NULL || bin == NULL)
+	if (tplg == NULL || bin == NULL || blk == NULL)
 		return -EINVAL;
-	while (1) {
-		pos = b - bin;
-		if (size == pos) {
-			tplg_log(tplg, 'D', pos, "block: success (total %zd)", size);
-			return 0;
-		}
-		if (size - pos < sizeof(*hdr)) {
-			tplg_log(tplg, 'D', pos, "block: small size");
-			SNDERR("incomplete header data to decode");
-			return -EINVAL;
-		}
-		hdr = b;
-		if (hdr->magic != SND_SOC_TPLG_MAGIC) {
-			SNDERR("bad block magic %08x", hdr->magic);
-			return -EINVAL;
-		}
 
-		tplg_log(tplg, 'D', pos, "block: abi %d size %d payload size %d",
-			 hdr->abi, hdr->size, hdr->payload_size);
-		if (hdr->abi != SND_SOC_TPLG_ABI_VERSION) {
-			SNDERR("unsupported ABI version %d", hdr->abi);
-			return -EINVAL;
-		}
-		if (hdr->size != sizeof(*hdr)) {
-			SNDERR("header size mismatch");
-			return -EINVAL;
-		}
-
-		if (size - pos < hdr->size + hdr->payload_size) {
-			SNDERR("incomplete payload data to decode");
-			return -EINVAL;
-		}
+	hdr = (struct snd_soc_tplg_hdr *)(bin + blk->offset);
+	pos = blk->offset;
+	tplg_log(tplg, 'D', pos, "block: abi %d size %d payload size %d",
+		 hdr->abi, hdr->size, hdr->payload_size);
+	if (hdr->type == SND_SOC_TPLG_TYPE_MANIFEST) {
+		err = snd_tplg_set_version(tplg, hdr->version);
+		if (err < 0)
+			return err;
+	}
 
-		if (hdr->payload_size < 8) {
-			SNDERR("wrong payload size %d", hdr->payload_size);
-			return -EINVAL;
-		}
+	pos += hdr->size;
+	tptr = tplg_table_soc_lookup(hdr->type);
+	if (tptr == NULL || tptr->decod == NULL) {
+		SNDERR("unknown block type %d", hdr->type);
+		return -EINVAL;
+	}
+	tplg_log(tplg, 'D', pos, "block: type %d - %s", hdr->type, tptr->name);
+	/* the decoders only read the payload */
+	return tptr->decod(tplg, pos, hdr, (void *)blk->payload,
+			   blk->payload_size);
+}
 
-		/* first block must be manifest */
-		if (b == bin) {
-			if (hdr->type != SND_SOC_TPLG_TYPE_MANIFEST) {
-				SNDERR("first block must be manifest (value %d)", hdr->type);
-				return -EINVAL;
-			}
-			err = snd_tplg_set_version(tplg, hdr->version);
-			if (err < 0)
-				return err;
-		}
+int snd_tplg_decode(snd_tplg_t *tplg, void *bin, size_t size, int dflags)
+{
+	snd_tplg_block_t blk;
+	size_t pos = 0;
+	int err;
 
-		pos += hdr->size;
-		for (index = 0; index < tplg_table_items; index++) {
-			tptr = &tplg_table[index];
-			if (tptr->tsoc == (int)hdr->type)
-				break;
+	if (dflags != 0)
+		return -EINVAL;
+	if (tplg == NULL || bin == NULL)
+		return -EINVAL;
+	while (1) {
+		err = snd_tplg_block_next(bin, size, &pos, &blk);
+		if (err < 0) {
+			tplg_log(tplg, 'D', pos, "block: invalid");
+			return err;
 		}
-		if (index >= tplg_table_items || tptr->decod == NULL) {
-			SNDERR("unknown block type %d", hdr->type);
-			return -EINVAL;
+		if (err == 0) {
+			tplg_log(tplg, 'D', pos, "block: success (total %zd)", size);
+			return 0;
 		}
-		tplg_log(tplg, 'D', pos, "block: type %d - %s", hdr->type, tptr->name);
-		err = tptr->decod(tplg, pos, hdr, b + hdr->size, hdr->payload_size);
+		err = snd_tplg_decode_block(tplg, bin, &blk, 0);
 		if (err < 0)
 			return err;
-		b += hdr->size + hdr->payload_size;
 	}
 }
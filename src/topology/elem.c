@@ -19,6 +19,7 @@
 
 #include "list.h"
 #include "tplg_local.h"
+#include <sys/mman.h>
 
 struct tplg_table tplg_table[] = {
 	{
@@ -299,9 +300,22 @@ struct tplg_elem *tplg_elem_new(void)
 	return elem;
 }
 
+/* unlink from the (type, id) hash */
+static void tplg_elem_hash_del(struct tplg_elem *elem)
+{
+	if (!elem->hpprev)
+		return;
+	*elem->hpprev = elem->hnext;
+	if (elem->hnext)
+		elem->hnext->hpprev = elem->hpprev;
+	elem->hnext = NULL;
+	elem->hpprev = NULL;
+}
+
 void tplg_elem_free(struct tplg_elem *elem)
 {
 	list_del(&elem->list);
+	tplg_elem_hash_del(elem);
 
 	tplg_ref_free_list(&elem->ref_list);
 
@@ -312,7 +326,10 @@ void tplg_elem_free(struct tplg_elem *elem)
 		if (elem->free)
 			elem->free(elem->obj);
 
-		free(elem->obj);
+		if (elem->map)
+			munmap(elem->map, elem->map_size);
+		else
+			free(elem->obj);
 	}
 
 	free(elem);
@@ -329,28 +346,108 @@ void tplg_elem_free_list(struct list_head *base)
 	}
 }
 
-struct tplg_elem *tplg_elem_lookup(struct list_head *base, const char* id,
-				   unsigned int type, int index)
+static unsigned int tplg_elem_hash_key(const char *id, unsigned int type)
 {
-	struct list_head *pos;
-	struct tplg_elem *elem;
+	const unsigned char *p = (const unsigned char *)id;
+	unsigned int h = 2166136261U ^ type;
 
-	if (!base || !id)
-		return NULL;
+	while (*p)
+		h = (h ^ *p++) * 16777619U;
+	return h;
+}
 
-	list_for_each(pos, base) {
+static void tplg_elem_hash_link(struct tplg_elem **head, struct tplg_elem *elem)
+{
+	elem->hnext = *head;
+	if (*head)
+		(*head)->hpprev = &elem->hnext;
+	*head = elem;
+	elem->hpprev = head;
+}
 
-		elem = list_entry(pos, struct tplg_elem, list);
+static int tplg_elem_hash_resize(snd_tplg_t *tplg, unsigned int size)
+{
+	struct tplg_elem **table, *elem, *next;
+	unsigned int i;
 
-		if (!strcmp(elem->id, id) && elem->type == type)
-			return elem;
-		/* SND_TPLG_INDEX_ALL is the default value "0" and applicable
-		   for all use cases */
-		if ((index != SND_TPLG_INDEX_ALL)
-			&& (elem->index > index))
-			break;
+	table = calloc(size, sizeof(*table));
+	if (!table)
+		return -ENOMEM;
+	for (i = 0; i < tplg->elem_hash_size; i++) {
+		for (elem = tplg->elem_hash[i]; elem; elem = next) {
+			next = elem->hnext;
+			tplg_elem_hash_link(&table[elem->hkey & (size - 1)], elem);
+		}
 	}
+	free(tplg->elem_hash);
+	tplg->elem_hash = table;
+	tplg->elem_hash_size = size;
+	return 0;
+}
 
+/* add a listed element to the (type, id) hash */
+static int tplg_elem_hash_add(snd_tplg_t *tplg, struct tplg_elem *elem)
+{
+	struct tplg_elem **head;
+	int err;
+
+	if (tplg->elem_hash_count >= tplg->elem_hash_size) {
+		err = tplg_elem_hash_resize(tplg, tplg->elem_hash_size ?
+					    tplg->elem_hash_size * 2 : 64);
+		if (err < 0)
+			return err;
+	}
+	elem->hkey = tplg_elem_hash_key(elem->id, elem->type);
+	elem->seq = tplg->elem_seq++;
+	head = &tplg->elem_hash[elem->hkey & (tplg->elem_hash_size - 1)];
+	tplg_elem_hash_link(head, elem);
+	tplg->elem_hash_count++;
+	return 0;
+}
+
+void tplg_elem_hash_free(snd_tplg_t *tplg)
+{
+	free(tplg->elem_hash);
+	tplg->elem_hash = NULL;
+	tplg->elem_hash_size = tplg->elem_hash_count = 0;
+}
+
+/* same result as walking the index-sorted list: the first matching
+ * element in list order, where the walk stops after the first element
+ * with a larger index than requested
+ */
+struct tplg_elem *tplg_elem_lookup(snd_tplg_t *tplg, struct list_head *base,
+				   const char* id, unsigned int type, int index)
+{
+	struct tplg_elem *elem, *found = NULL, *prev;
+	unsigned int key;
+
+	if (!base || !id || !tplg->elem_hash_size)
+		return NULL;
+
+	key = tplg_elem_hash_key(id, type);
+	for (elem = tplg->elem_hash[key & (tplg->elem_hash_size - 1)];
+	     elem; elem = elem->hnext) {
+		if (elem->hkey != key || elem->type != type ||
+		    strcmp(elem->id, id))
+			continue;
+		if (!found || elem->index < found->index ||
+		    (elem->index == found->index && elem->seq < found->seq))
+			found = elem;
+	}
+	if (!found)
+		return NULL;
+
+	/* SND_TPLG_INDEX_ALL is the default value "0" and applicable
+	   for all use cases */
+	if (index == SND_TPLG_INDEX_ALL || found->index <= index)
+		return found;
+	/* the list walk also returned the first elem past the index */
+	if (found->list.prev == base)
+		return found;
+	prev = list_entry(found->list.prev, struct tplg_elem, list);
+	if (prev->index <= index)
+		return found;
 	return NULL;
 }
 
@@ -384,19 +481,22 @@ struct tplg_elem *tplg_elem_type_lookup(snd_tplg_t *tplg,
 	return NULL;
 }
 
-/* insert a new element into list in the ascending order of index value */
+/* insert a new element into list in the ascending order of index value,
+ * after all elements with the same index; scan from the tail since
+ * elements are mostly added in index order
+ */
 void tplg_elem_insert(struct tplg_elem *elem_p, struct list_head *list)
 {
 	struct list_head *pos, *p = &(elem_p->list);
 	struct tplg_elem *elem;
 
-	list_for_each(pos, list) {
+	for (pos = list->prev; pos != list; pos = pos->prev) {
 		elem = list_entry(pos, struct tplg_elem, list);
-		if (elem_p->index < elem->index)
+		if (elem->index <= elem_p->index)
 			break;
 	}
-	/* insert item before pos */
-	list_insert(p, pos->prev, pos);
+	/* insert item after pos */
+	list_insert(p, pos, pos->next);
 }
 
 /* create a new common element and object */
@@ -479,6 +579,10 @@ struct tplg_elem* tplg_elem_new_common(snd_tplg_t *tplg,
 	}
 
 	elem->type = type;
+	if (tplg_elem_hash_add(tplg, elem) < 0) {
+		tplg_elem_free(elem);
+		return NULL;
+	}
 	return elem;
 }
 
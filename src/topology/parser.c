@@ -20,6 +20,9 @@
 #include <sys/stat.h>
 #include "list.h"
 #include "tplg_local.h"
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 /*
  * Get integer value
@@ -190,9 +193,116 @@ static int tplg_parse_config(snd_tplg_t *tplg, snd_config_t *cfg)
 	return 0;
 }
 
+static uint64_t tplg_hash_bytes(uint64_t h, const void *data, size_t size)
+{
+	const unsigned char *p = data;
+
+	while (size--) {
+		h ^= *p++;
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+/* FNV-1a over the ids, types and values of the tree; data files are
+ * represented by their file status, so editing one changes the hash too
+ */
+static uint64_t tplg_hash_config(uint64_t h, snd_config_t *cfg)
+{
+	snd_config_iterator_t i, next;
+	snd_config_t *n;
+	snd_config_type_t type;
+	const char *id, *str;
+	char path[PATH_MAX];
+	struct stat st;
+	long lval;
+	long long llval;
+	double dval;
+
+	snd_config_for_each(i, next, cfg) {
+		n = snd_config_iterator_entry(i);
+		if (snd_config_get_id(n, &id) < 0)
+			continue;
+		type = snd_config_get_type(n);
+		h = tplg_hash_bytes(h, id, strlen(id) + 1);
+		h = tplg_hash_bytes(h, &type, sizeof(type));
+		switch (type) {
+		case SND_CONFIG_TYPE_INTEGER:
+			snd_config_get_integer(n, &lval);
+			h = tplg_hash_bytes(h, &lval, sizeof(lval));
+			break;
+		case SND_CONFIG_TYPE_INTEGER64:
+			snd_config_get_integer64(n, &llval);
+			h = tplg_hash_bytes(h, &llval, sizeof(llval));
+			break;
+		case SND_CONFIG_TYPE_REAL:
+			snd_config_get_real(n, &dval);
+			h = tplg_hash_bytes(h, &dval, sizeof(dval));
+			break;
+		case SND_CONFIG_TYPE_STRING:
+			snd_config_get_string(n, &str);
+			h = tplg_hash_bytes(h, str, strlen(str) + 1);
+			if (strcmp(id, "file") != 0)
+				break;
+			tplg_data_file_path(str, path, sizeof(path));
+			if (stat(path, &st) < 0)
+				break;
+			h = tplg_hash_bytes(h, &st.st_ino, sizeof(st.st_ino));
+			h = tplg_hash_bytes(h, &st.st_size, sizeof(st.st_size));
+			h = tplg_hash_bytes(h, &st.st_mtim, sizeof(st.st_mtim));
+			break;
+		case SND_CONFIG_TYPE_COMPOUND:
+			h = tplg_hash_config(h, n);
+			h = tplg_hash_bytes(h, "}", 1);
+			break;
+		default:
+			break;
+		}
+	}
+	return h;
+}
+
+static void tplg_free_elems(snd_tplg_t *tplg)
+{
+	tplg_elem_free_list(&tplg->tlv_list);
+	tplg_elem_free_list(&tplg->widget_list);
+	tplg_elem_free_list(&tplg->pcm_list);
+	tplg_elem_free_list(&tplg->dai_list);
+	tplg_elem_free_list(&tplg->be_list);
+	tplg_elem_free_list(&tplg->cc_list);
+	tplg_elem_free_list(&tplg->route_list);
+	tplg_elem_free_list(&tplg->pdata_list);
+	tplg_elem_free_list(&tplg->manifest_list);
+	tplg_elem_free_list(&tplg->text_list);
+	tplg_elem_free_list(&tplg->pcm_config_list);
+	tplg_elem_free_list(&tplg->pcm_caps_list);
+	tplg_elem_free_list(&tplg->mixer_list);
+	tplg_elem_free_list(&tplg->enum_list);
+	tplg_elem_free_list(&tplg->bytes_ext_list);
+	tplg_elem_free_list(&tplg->token_list);
+	tplg_elem_free_list(&tplg->tuple_list);
+	tplg_elem_free_list(&tplg->hw_cfg_list);
+	tplg_elem_hash_free(tplg);
+}
+
+/* drop the objects of the previous source before an incremental reload */
+static void tplg_reset(snd_tplg_t *tplg)
+{
+	tplg_free_elems(tplg);
+	free(tplg->manifest_pdata);
+	tplg->manifest_pdata = NULL;
+	memset(&tplg->manifest, 0, sizeof(tplg->manifest));
+	tplg->manifest.size = sizeof(struct snd_soc_tplg_manifest);
+	tplg->integ_done = 0;
+	tplg->elem_seq = 0;
+	tplg->index = 0;
+	tplg->channel_idx = 0;
+}
+
 static int tplg_load_config(snd_tplg_t *tplg, snd_input_t *in)
 {
 	snd_config_t *top;
+	uint64_t hash;
 	int ret;
 
 	ret = snd_config_top(&top);
@@ -206,57 +316,151 @@ static int tplg_load_config(snd_tplg_t *tplg, snd_input_t *in)
 		return ret;
 	}
 
+	if (tplg->incremental) {
+		hash = tplg_hash_config(0xcbf29ce484222325ULL, top);
+		tplg->inc_clean = tplg->integ_done && hash == tplg->inc_hash;
+		if (tplg->inc_clean) {
+			snd_config_delete(top);
+			return 0;
+		}
+		tplg_reset(tplg);
+		tplg->inc_hash = hash;
+	}
+
 	ret = tplg_parse_config(tplg, top);
 	snd_config_delete(top);
 	if (ret < 0) {
 		SNDERR("failed to parse topology");
+		tplg->inc_hash = 0;
 		return ret;
 	}
 
 	return 0;
 }
 
-static int tplg_build_integ(snd_tplg_t *tplg)
+static int build_controls_widgets(snd_tplg_t *tplg)
 {
 	int err;
 
-	err = tplg_build_data(tplg);
-	if (err <  0)
-		return err;
-
-	err = tplg_build_manifest_data(tplg);
-	if (err <  0)
-		return err;
-
 	err = tplg_build_controls(tplg);
 	if (err <  0)
 		return err;
 
-	err = tplg_build_widgets(tplg);
-	if (err <  0)
-		return err;
+	/* widgets embed the built controls */
+	return tplg_build_widgets(tplg);
+}
 
-	err = tplg_build_pcms(tplg, SND_TPLG_TYPE_PCM);
-	if (err <  0)
-		return err;
+static int build_pcms(snd_tplg_t *tplg)
+{
+	return tplg_build_pcms(tplg, SND_TPLG_TYPE_PCM);
+}
 
-	err = tplg_build_dais(tplg, SND_TPLG_TYPE_DAI);
-	if (err <  0)
-		return err;
+static int build_dais(snd_tplg_t *tplg)
+{
+	return tplg_build_dais(tplg, SND_TPLG_TYPE_DAI);
+}
+
+static int build_links(snd_tplg_t *tplg)
+{
+	int err;
 
 	err = tplg_build_links(tplg, SND_TPLG_TYPE_BE);
 	if (err <  0)
 		return err;
 
-	err = tplg_build_links(tplg, SND_TPLG_TYPE_CC);
-	if (err <  0)
-		return err;
+	return tplg_build_links(tplg, SND_TPLG_TYPE_CC);
+}
+
+/*
+ * Once the tuples are in the data elements, these chains only read the
+ * shared objects and each merges into elements of its own types, so
+ * they can run at the same time.  In this order they are the serial
+ * build, which also decides which error is returned.
+ */
+static int (*const tplg_build_chains[])(snd_tplg_t *tplg) = {
+	tplg_build_manifest_data,
+	build_controls_widgets,
+	build_pcms,
+	build_dais,
+	build_links,
+	tplg_build_routes,
+};
+
+#define TPLG_BUILD_CHAINS	ARRAY_SIZE(tplg_build_chains)
+
+/* fewer elements are built faster than the threads are started */
+#define TPLG_PARALLEL_MIN_ELEMS	512
+
+#ifdef HAVE_LIBPTHREAD
+struct tplg_build_job {
+	snd_tplg_t *tplg;
+	int (*build)(snd_tplg_t *tplg);
+	pthread_t thread;
+	int started;
+	int err;
+};
+
+static void *tplg_build_thread(void *arg)
+{
+	struct tplg_build_job *job = arg;
+
+	job->err = job->build(job->tplg);
+	return NULL;
+}
 
-	err = tplg_build_routes(tplg);
+static int tplg_build_parallel(snd_tplg_t *tplg)
+{
+	struct tplg_build_job jobs[TPLG_BUILD_CHAINS];
+	unsigned int i;
+
+	for (i = 0; i < TPLG_BUILD_CHAINS; i++) {
+		jobs[i].tplg = tplg;
+		jobs[i].build = tplg_build_chains[i];
+		jobs[i].started = 0;
+	}
+
+	/* the first chain runs here, or all of them if no thread starts */
+	for (i = 1; i < TPLG_BUILD_CHAINS; i++)
+		jobs[i].started = pthread_create(&jobs[i].thread, NULL,
+						 tplg_build_thread, &jobs[i]) == 0;
+	for (i = 0; i < TPLG_BUILD_CHAINS; i++) {
+		if (!jobs[i].started)
+			tplg_build_thread(&jobs[i]);
+	}
+
+	for (i = 1; i < TPLG_BUILD_CHAINS; i++) {
+		if (jobs[i].started)
+			pthread_join(jobs[i].thread, NULL);
+	}
+	for (i = 0; i < TPLG_BUILD_CHAINS; i++) {
+		if (jobs[i].err < 0)
+			return jobs[i].err;
+	}
+	return 0;
+}
+#endif
+
+static int tplg_build_integ(snd_tplg_t *tplg)
+{
+	unsigned int i;
+	int err;
+
+	err = tplg_build_data(tplg);
 	if (err <  0)
 		return err;
 
-	return err;
+#ifdef HAVE_LIBPTHREAD
+	if (tplg->elem_hash_count >= TPLG_PARALLEL_MIN_ELEMS &&
+	    sysconf(_SC_NPROCESSORS_ONLN) > 1)
+		return tplg_build_parallel(tplg);
+#endif
+
+	for (i = 0; i < TPLG_BUILD_CHAINS; i++) {
+		err = tplg_build_chains[i](tplg);
+		if (err < 0)
+			return err;
+	}
+	return 0;
 }
 
 int snd_tplg_load(snd_tplg_t *tplg, const char *buf, size_t size)
@@ -275,15 +479,37 @@ int snd_tplg_load(snd_tplg_t *tplg, const char *buf, size_t size)
 	return err;
 }
 
-static int tplg_build(snd_tplg_t *tplg)
+/* resolve references and build the objects; done only once since the
+ * object data is merged in place
+ */
+static int tplg_build_objects(snd_tplg_t *tplg)
 {
+	struct timespec t0, t1;
 	int err;
 
+	if (tplg->integ_done)
+		return 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
 	err = tplg_build_integ(tplg);
 	if (err < 0) {
 		SNDERR("failed to check topology integrity");
 		return err;
 	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	tplg->stats.integ_usec = (t1.tv_sec - t0.tv_sec) * 1000000UL +
+				 (t1.tv_nsec - t0.tv_nsec) / 1000;
+	tplg->integ_done = 1;
+	return 0;
+}
+
+static int tplg_build(snd_tplg_t *tplg)
+{
+	int err;
+
+	err = tplg_build_objects(tplg);
+	if (err < 0)
+		return err;
 
 	err = tplg_write_data(tplg);
 	if (err < 0) {
@@ -352,28 +578,60 @@ int snd_tplg_add_object(snd_tplg_t *tplg, snd_tplg_obj_template_t *t)
 int snd_tplg_build(snd_tplg_t *tplg, const char *outfile)
 {
 	int fd, err;
-	ssize_t r;
 
-	err = tplg_build(tplg);
+	err = tplg_build_objects(tplg);
 	if (err < 0)
 		return err;
 
+	if (tplg->incremental)
+		return tplg_write_file_incremental(tplg, outfile);
+
 	fd = open(outfile, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
 	if (fd < 0) {
 		SNDERR("failed to open %s err %d", outfile, -errno);
 		return -errno;
 	}
-	r = write(fd, tplg->bin, tplg->bin_size);
+	err = tplg_write_fd(tplg, fd);
 	close(fd);
-	if (r < 0) {
-		err = -errno;
-		SNDERR("write error: %s", strerror(errno));
+	if (err < 0)
+		SNDERR("failed to write data %d", err);
+	return err;
+}
+
+int snd_tplg_build_fd(snd_tplg_t *tplg, int fd)
+{
+	int err;
+
+	err = tplg_build_objects(tplg);
+	if (err < 0)
 		return err;
-	}
-	if ((size_t)r != tplg->bin_size) {
-		SNDERR("partial write (%zd != %zd)", r, tplg->bin_size);
-		return -EIO;
-	}
+
+	err = tplg_write_fd(tplg, fd);
+	if (err < 0)
+		SNDERR("failed to write data %d", err);
+	return err;
+}
+
+int snd_tplg_build_mem(snd_tplg_t *tplg, void *buf, size_t size,
+		       size_t *used)
+{
+	int err;
+
+	err = tplg_build_objects(tplg);
+	if (err < 0)
+		return err;
+
+	err = tplg_write_mem(tplg, buf, size, used);
+	if (err < 0 && err != -ENOSPC)
+		SNDERR("failed to write data %d", err);
+	return err;
+}
+
+int snd_tplg_build_stats(snd_tplg_t *tplg, snd_tplg_build_stats_t *stats)
+{
+	if (!tplg || !stats)
+		return -EINVAL;
+	*stats = tplg->stats;
 	return 0;
 }
 
@@ -447,6 +705,8 @@ snd_tplg_t *snd_tplg_create(int flags)
 
 	tplg->verbose = !!(flags & SND_TPLG_CREATE_VERBOSE);
 	tplg->dapm_sort = (flags & SND_TPLG_CREATE_DAPM_NOSORT) == 0;
+	tplg->incremental = !!(flags & SND_TPLG_CREATE_INCREMENTAL);
+	tplg->out_fd = -1;
 
 	tplg->manifest.size = sizeof(struct snd_soc_tplg_manifest);
 
@@ -481,25 +741,9 @@ void snd_tplg_free(snd_tplg_t *tplg)
 {
 	free(tplg->bin);
 	free(tplg->manifest_pdata);
+	free(tplg->inc_bin);
 
-	tplg_elem_free_list(&tplg->tlv_list);
-	tplg_elem_free_list(&tplg->widget_list);
-	tplg_elem_free_list(&tplg->pcm_list);
-	tplg_elem_free_list(&tplg->dai_list);
-	tplg_elem_free_list(&tplg->be_list);
-	tplg_elem_free_list(&tplg->cc_list);
-	tplg_elem_free_list(&tplg->route_list);
-	tplg_elem_free_list(&tplg->pdata_list);
-	tplg_elem_free_list(&tplg->manifest_list);
-	tplg_elem_free_list(&tplg->text_list);
-	tplg_elem_free_list(&tplg->pcm_config_list);
-	tplg_elem_free_list(&tplg->pcm_caps_list);
-	tplg_elem_free_list(&tplg->mixer_list);
-	tplg_elem_free_list(&tplg->enum_list);
-	tplg_elem_free_list(&tplg->bytes_ext_list);
-	tplg_elem_free_list(&tplg->token_list);
-	tplg_elem_free_list(&tplg->tuple_list);
-	tplg_elem_free_list(&tplg->hw_cfg_list);
+	tplg_free_elems(tplg);
 
 	free(tplg);
 }
@@ -83,7 +83,7 @@ static int tplg_build_stream_caps(snd_tplg_t *tplg,
 	unsigned int i;
 
 	for (i = 0; i < 2; i++) {
-		ref_elem = tplg_elem_lookup(&tplg->pcm_caps_list,
+		ref_elem = tplg_elem_lookup(tplg, &tplg->pcm_caps_list,
 			caps[i].name, SND_TPLG_TYPE_STREAM_CAPS, index);
 
 		if (ref_elem != NULL)
@@ -218,7 +218,7 @@ static int tplg_build_stream_cfg(snd_tplg_t *tplg,
 
 	for (i = 0; i < num_streams; i++) {
 		strm = stream + i;
-		ref_elem = tplg_elem_lookup(&tplg->pcm_config_list,
+		ref_elem = tplg_elem_lookup(tplg, &tplg->pcm_config_list,
 			strm->name, SND_TPLG_TYPE_STREAM_CONFIG, index);
 
 		if (ref_elem && ref_elem->stream_cfg)
@@ -248,7 +248,7 @@ static int build_link(snd_tplg_t *tplg, struct tplg_elem *elem)
 
 		switch (ref->type) {
 		case SND_TPLG_TYPE_HW_CONFIG:
-			ref->elem = tplg_elem_lookup(&tplg->hw_cfg_list,
+			ref->elem = tplg_elem_lookup(tplg, &tplg->hw_cfg_list,
 				ref->id, SND_TPLG_TYPE_HW_CONFIG, elem->index);
 			if (!ref->elem) {
 				SNDERR("cannot find HW config '%s'"
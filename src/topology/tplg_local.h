@@ -13,6 +13,7 @@
 #include <limits.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <sys/stat.h>
 
 #include "local.h"
 #include "list.h"
@@ -64,9 +65,16 @@ struct snd_tplg {
 	unsigned char *bin;
 	size_t bin_pos;
 	size_t bin_size;
+	/* streaming output */
+	int out_fd;
+	size_t out_fill;
+	snd_tplg_build_stats_t stats;
 
 	int verbose;
 	unsigned int dapm_sort: 1;
+	unsigned int integ_done: 1;
+	unsigned int incremental: 1;
+	unsigned int inc_clean: 1;	/* source unchanged since the last build */
 	unsigned int version;
 
 	/* runtime state */
@@ -99,6 +107,20 @@ struct snd_tplg {
 	struct list_head mixer_list;
 	struct list_head enum_list;
 	struct list_head bytes_ext_list;
+
+	/* elements hashed by (type, id) for tplg_elem_lookup() */
+	struct tplg_elem **elem_hash;
+	unsigned int elem_hash_size;	/* power of two */
+	unsigned int elem_hash_count;	/* resize hint, not decremented */
+	unsigned int elem_seq;
+
+	/* incremental builds: the last source and the image written from it */
+	uint64_t inc_hash;
+	unsigned char *inc_bin;
+	size_t inc_bin_size;
+	unsigned int inc_blocks;
+	unsigned int inc_version;
+	struct stat inc_out;
 };
 
 /* object text references */
@@ -193,6 +215,16 @@ struct tplg_elem {
 	struct list_head ref_list;
 	struct list_head list; /* list of all elements with same type */
 
+	/* (type, id) hash chain */
+	struct tplg_elem *hnext;
+	struct tplg_elem **hpprev;
+	unsigned int hkey;
+	unsigned int seq; /* insertion order within the same index */
+
+	/* data file mapping holding obj, unmapped instead of freed */
+	void *map;
+	size_t map_size;
+
 	void (*free)(void *obj);
 };
 
@@ -270,6 +302,9 @@ int tplg_parse_compound(snd_tplg_t *tplg, snd_config_t *cfg,
 	void *private);
 
 int tplg_write_data(snd_tplg_t *tplg);
+int tplg_write_file_incremental(snd_tplg_t *tplg, const char *outfile);
+int tplg_write_fd(snd_tplg_t *tplg, int fd);
+int tplg_write_mem(snd_tplg_t *tplg, void *buf, size_t size, size_t *used);
 
 int tplg_parse_tlv(snd_tplg_t *tplg, snd_config_t *cfg, void *priv);
 int tplg_parse_text(snd_tplg_t *tplg, snd_config_t *cfg, void *priv);
@@ -299,6 +334,8 @@ int tplg_build_widgets(snd_tplg_t *tplg);
 int tplg_build_routes(snd_tplg_t *tplg);
 int tplg_build_pcm_dai(snd_tplg_t *tplg, unsigned int type);
 
+void tplg_data_file_path(const char *name, char *path, size_t size);
+int tplg_data_unmap(struct tplg_elem *elem);
 int tplg_copy_data(snd_tplg_t *tplg, struct tplg_elem *elem,
 		   struct tplg_ref *ref);
 
@@ -312,7 +349,9 @@ struct tplg_elem *tplg_elem_new(void);
 void tplg_elem_free(struct tplg_elem *elem);
 void tplg_elem_free_list(struct list_head *base);
 void tplg_elem_insert(struct tplg_elem *elem_p, struct list_head *list);
-struct tplg_elem *tplg_elem_lookup(struct list_head *base,
+void tplg_elem_hash_free(snd_tplg_t *tplg);
+struct tplg_elem *tplg_elem_lookup(snd_tplg_t *tplg,
+				struct list_head *base,
 				const char* id,
 				unsigned int type,
 				int index);
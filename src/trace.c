@@ -0,0 +1,165 @@
+/*
+ *  Open path tracing
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * With LIBASOUND_TRACE set, the configuration update, the definition
+ * search, the hooks, the plugin loading and opening, the parameter
+ * refinement and the hw ioctls on the way are written as "complete"
+ * events of the Trace Event Format, which chrome://tracing and Perfetto
+ * load directly.  The value is the output file ("%p" is replaced with
+ * the pid) or "-" for stderr.  The file is opened for appending and
+ * the JSON array is left open, as the format allows, so that the events
+ * of a crashed process are kept.
+ *
+ *	LIBASOUND_TRACE=/tmp/alsa-%p.json aplay -D plughw:0 foo.wav
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "local.h"
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+
+static int trace_state;		/* 0 = not checked yet, 1 = on, -1 = off */
+static FILE *trace_fp;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline void trace_lock(void)
+{
+	pthread_mutex_lock(&trace_mutex);
+}
+
+static inline void trace_unlock(void)
+{
+	pthread_mutex_unlock(&trace_mutex);
+}
+#else
+static inline void trace_lock(void) {}
+static inline void trace_unlock(void) {}
+#endif
+
+static unsigned long long trace_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static FILE *trace_open(const char *path)
+{
+	char name[PATH_MAX];
+	const char *p;
+	size_t len = 0;
+	FILE *fp;
+
+	if (strcmp(path, "-") == 0)
+		return stderr;
+	for (p = path; *p && len < sizeof(name) - 16; p++) {
+		if (p[0] == '%' && p[1] == 'p') {
+			len += snprintf(name + len, sizeof(name) - len, "%d", (int)getpid());
+			p++;
+			continue;
+		}
+		name[len++] = *p;
+	}
+	name[len] = '\0';
+	fp = fopen(name, "a");
+	if (fp == NULL)
+		return NULL;
+	setvbuf(fp, NULL, _IOLBF, 0);
+	fseek(fp, 0, SEEK_END);
+	if (ftell(fp) == 0)
+		fputs("[\n", fp);
+	return fp;
+}
+
+static int trace_init(void)
+{
+	const char *env;
+
+	trace_lock();
+	if (trace_state == 0) {
+		env = getenv("LIBASOUND_TRACE");
+		if (env && *env)
+			trace_fp = trace_open(env);
+		trace_state = trace_fp ? 1 : -1;
+	}
+	trace_unlock();
+	return trace_state;
+}
+
+/* write a JSON string body */
+static void trace_puts(const char *s)
+{
+	for (; *s; s++) {
+		unsigned char c = *s;
+		if (c == '"' || c == '\\')
+			fprintf(trace_fp, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(trace_fp, "\\u%04x", c);
+		else
+			putc(c, trace_fp);
+	}
+}
+
+/* start a span, returns zero when tracing is off */
+unsigned long long snd_trace_begin(void)
+{
+	if (trace_state < 0)
+		return 0;
+	if (trace_state == 0 && trace_init() < 0)
+		return 0;
+	return trace_now();
+}
+
+/*
+ * emit the span started by snd_trace_begin(); cat is one of conf, dl,
+ * pcm, refine or ioctl, detail may be NULL
+ */
+void snd_trace_end(unsigned long long start, const char *cat,
+		   const char *name, const char *detail)
+{
+	unsigned long long end;
+
+	if (!start)
+		return;
+	end = trace_now();
+	trace_lock();
+	fprintf(trace_fp, "{\"name\":\"");
+	trace_puts(name);
+	fprintf(trace_fp, "\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+		"\"pid\":%d,\"tid\":%d", cat, start / 1000.0, (end - start) / 1000.0,
+		(int)getpid(), (int)syscall(SYS_gettid));
+	if (detail) {
+		fprintf(trace_fp, ",\"args\":{\"detail\":\"");
+		trace_puts(detail);
+		fprintf(trace_fp, "\"}");
+	}
+	fprintf(trace_fp, "},\n");
+	trace_unlock();
+}
@@ -399,10 +399,11 @@ er:
 	return -EINVAL;
 }
 
-static int execute_cset(snd_ctl_t *ctl, const char *cset, unsigned int type)
+static int execute_cset(struct ctl_list *ctl_list, const char *cset, unsigned int type)
 {
+	snd_ctl_t *ctl = ctl_list->ctl;
 	const char *pos;
-	int err;
+	int err, retry = 1;
 	snd_ctl_elem_id_t *id;
 	snd_ctl_elem_value_t *value;
 	snd_ctl_elem_info_t *info, *info2 = NULL;
@@ -412,6 +413,24 @@ static int execute_cset(snd_ctl_t *ctl, const char *cset, unsigned int type)
 	snd_ctl_elem_value_malloc(&value);
 	snd_ctl_elem_info_malloc(&info);
 
+	if (type != SEQUENCE_ELEMENT_TYPE_CSET_NEW &&
+	    type != SEQUENCE_ELEMENT_TYPE_CTL_REMOVE) {
+		/* resolved once per control device, then written by numid */
+      __lookup:
+		err = uc_mgr_ctl_elem_lookup(ctl_list, cset, info, &pos);
+		if (err < 0)
+			goto __fail;
+		while (*pos && isspace(*pos))
+			pos++;
+		if (!*pos) {
+			uc_error("undefined value for cset >%s<", cset);
+			err = -EINVAL;
+			goto __fail;
+		}
+		snd_ctl_elem_info_get_id(info, id);
+		goto __write;
+	}
+
 	err = __snd_ctl_ascii_elem_id_parse(id, cset, &pos);
 	if (err < 0)
 		goto __fail;
@@ -441,30 +460,30 @@ static int execute_cset(snd_ctl_t *ctl, const char *cset, unsigned int type)
 		goto __fail;
 	}
 
+	/* the element set changes, the resolved ids may go stale */
+	uc_mgr_ctl_elem_flush(ctl_list);
 	snd_ctl_elem_info_set_id(info, id);
 	err = snd_ctl_elem_info(ctl, info);
-	if (type == SEQUENCE_ELEMENT_TYPE_CSET_NEW ||
-	    type == SEQUENCE_ELEMENT_TYPE_CTL_REMOVE) {
-		if (err >= 0) {
-			err = snd_ctl_elem_remove(ctl, id);
-			if (err < 0) {
-				uc_error("unable to remove control");
-				err = -EINVAL;
-				goto __fail;
-			}
-		}
-		if (type == SEQUENCE_ELEMENT_TYPE_CTL_REMOVE)
-			goto __ok;
-		err = __snd_ctl_add_elem_set(ctl, info2, info2->owner, info2->count);
+	if (err >= 0) {
+		err = snd_ctl_elem_remove(ctl, id);
 		if (err < 0) {
-			uc_error("unable to create new control");
+			uc_error("unable to remove control");
+			err = -EINVAL;
 			goto __fail;
 		}
-		/* new id copy */
-		snd_ctl_elem_info_get_id(info2, id);
-		snd_ctl_elem_info_set_id(info, id);
-	} else if (err < 0)
+	}
+	if (type == SEQUENCE_ELEMENT_TYPE_CTL_REMOVE)
+		goto __ok;
+	err = __snd_ctl_add_elem_set(ctl, info2, info2->owner, info2->count);
+	if (err < 0) {
+		uc_error("unable to create new control");
 		goto __fail;
+	}
+	/* new id copy */
+	snd_ctl_elem_info_get_id(info2, id);
+	snd_ctl_elem_info_set_id(info, id);
+
+      __write:
 	if (type == SEQUENCE_ELEMENT_TYPE_CSET_TLV) {
 		if (!snd_ctl_elem_info_is_tlv_writable(info)) {
 			err = -EINVAL;
@@ -475,12 +494,12 @@ static int execute_cset(snd_ctl_t *ctl, const char *cset, unsigned int type)
 			goto __fail;
 		err = snd_ctl_elem_tlv_write(ctl, id, res);
 		if (err < 0)
-			goto __fail;
+			goto __stale;
 	} else {
 		snd_ctl_elem_value_set_id(value, id);
 		err = snd_ctl_elem_read(ctl, value);
 		if (err < 0)
-			goto __fail;
+			goto __stale;
 		if (type == SEQUENCE_ELEMENT_TYPE_CSET_BIN_FILE)
 			err = binary_file_parse(value, info, pos);
 		else
@@ -514,6 +533,154 @@ static int execute_cset(snd_ctl_t *ctl, const char *cset, unsigned int type)
 	free(res);
 
 	return err;
+
+      __stale:
+	/* the element was removed and maybe recreated under a new numid */
+	if (err == -ENOENT && retry && info2 == NULL) {
+		uc_mgr_ctl_elem_forget(ctl_list, cset);
+		free(res);
+		res = NULL;
+		retry = 0;
+		goto __lookup;
+	}
+	goto __fail;
+}
+
+/*
+ * Diffed cset writes: while uc_mgr->cset_batch is set, the plain cset
+ * steps update a per-element pending value instead of the device.
+ * The original value is read once, so the flush writes only the
+ * elements whose final value differs from the current one.
+ */
+struct cset_pending {
+	struct list_head list;
+	snd_ctl_t *ctl;
+	snd_ctl_elem_value_t orig;
+	snd_ctl_elem_value_t value;
+};
+
+static int execute_cset_batch(snd_use_case_mgr_t *uc_mgr, struct ctl_list *ctl_list,
+			      const char *cset)
+{
+	snd_ctl_t *ctl = ctl_list->ctl;
+	struct list_head *pos;
+	struct cset_pending *p;
+	const char *vpos;
+	snd_ctl_elem_info_t info;
+	int err, retry = 1;
+
+      __lookup:
+	err = uc_mgr_ctl_elem_lookup(ctl_list, cset, &info, &vpos);
+	if (err < 0)
+		return err;
+	while (*vpos && isspace(*vpos))
+		vpos++;
+	if (!*vpos) {
+		uc_error("undefined value for cset >%s<", cset);
+		return -EINVAL;
+	}
+
+	p = NULL;
+	list_for_each(pos, &uc_mgr->cset_pending) {
+		p = list_entry(pos, struct cset_pending, list);
+		if (p->ctl == ctl &&
+		    (p->value.id.numid && info.id.numid ?
+		     p->value.id.numid == info.id.numid :
+		     snd_ctl_elem_id_compare_set(&p->value.id, &info.id) == 0))
+			break;
+		p = NULL;
+	}
+	if (p == NULL) {
+		p = calloc(1, sizeof(*p));
+		if (p == NULL)
+			return -ENOMEM;
+		p->ctl = ctl;
+		snd_ctl_elem_value_set_id(&p->orig, &info.id);
+		err = snd_ctl_elem_read(ctl, &p->orig);
+		if (err < 0) {
+			free(p);
+			if (err == -ENOENT && retry) {
+				/* stale numid, resolve the id again */
+				uc_mgr_ctl_elem_forget(ctl_list, cset);
+				retry = 0;
+				goto __lookup;
+			}
+			return err;
+		}
+		p->value = p->orig;
+		list_add_tail(&p->list, &uc_mgr->cset_pending);
+	}
+	return snd_ctl_ascii_value_parse(ctl, &p->value, &info, vpos);
+}
+
+static void cset_pending_free(snd_use_case_mgr_t *uc_mgr)
+{
+	struct list_head *pos, *npos;
+	struct cset_pending *p;
+
+	list_for_each_safe(pos, npos, &uc_mgr->cset_pending) {
+		p = list_entry(pos, struct cset_pending, list);
+		list_del(&p->list);
+		free(p);
+	}
+}
+
+/*
+ * Write the changed pending values, one bulk write per control device
+ * in the order of the first touch of each element.
+ */
+static int cset_pending_flush(snd_use_case_mgr_t *uc_mgr)
+{
+	struct list_head *pos, *npos;
+	struct cset_pending *p, *first;
+	snd_ctl_elem_value_t **vals;
+	snd_ctl_t *ctl;
+	unsigned int count, total;
+	int err = 0;
+
+	total = 0;
+	list_for_each(pos, &uc_mgr->cset_pending)
+		total++;
+	if (total == 0)
+		return 0;
+	vals = malloc(total * sizeof(*vals));
+	if (vals == NULL) {
+		err = -ENOMEM;
+		goto __end;
+	}
+	while (err == 0 && !list_empty(&uc_mgr->cset_pending)) {
+		first = list_entry(uc_mgr->cset_pending.next, struct cset_pending, list);
+		count = 0;
+		list_for_each(pos, &uc_mgr->cset_pending) {
+			p = list_entry(pos, struct cset_pending, list);
+			if (p->ctl != first->ctl)
+				continue;
+			if (memcmp(&p->value.value, &p->orig.value,
+				   sizeof(p->value.value)) != 0)
+				vals[count++] = &p->value;
+		}
+		if (count > 0) {
+			err = snd_ctl_elem_write_multi(first->ctl, vals, count);
+			if (err >= 0 && (unsigned int)err < count)
+				err = -EIO;
+			if (err < 0)
+				uc_error("unable to write %u pending control values", count);
+			else
+				err = 0;
+		}
+		ctl = first->ctl;
+		list_for_each_safe(pos, npos, &uc_mgr->cset_pending) {
+			p = list_entry(pos, struct cset_pending, list);
+			if (p->ctl == ctl) {
+				list_del(&p->list);
+				free(p);
+			}
+		}
+	}
+	free(vals);
+      __end:
+	cset_pending_free(uc_mgr);
+	return err;
 }
 
 static int execute_sysw(const char *sysw)
@@ -719,6 +886,62 @@ static int run_device_all_sequence(snd_use_case_mgr_t *uc_mgr, struct use_case_v
 	return 0;
 }
 
+/*
+ * exec-bg commands of one sequence, collected by exec-join or at the end
+ */
+#define EXEC_JOBS_MAX	16
+
+struct exec_jobs {
+	unsigned int count;
+	struct {
+		pid_t pid;
+		const char *cmd;
+	} job[EXEC_JOBS_MAX];
+};
+
+static int exec_join(struct exec_jobs *jobs)
+{
+	unsigned int i;
+	bool ignore_error;
+	int err, ret = 0;
+
+	for (i = 0; i < jobs->count; i++) {
+		err = uc_mgr_exec_wait(jobs->job[i].pid);
+		ignore_error = jobs->job[i].cmd[0] == '-';
+		if (ignore_error == false && err != 0) {
+			uc_error("exec '%s' failed (exit code %d)", jobs->job[i].cmd, err);
+			if (ret == 0)
+				ret = err < 0 ? err : -EINVAL;
+		}
+	}
+	jobs->count = 0;
+	return ret;
+}
+
+static int exec_background(struct exec_jobs *jobs, const char *cmd)
+{
+	bool ignore_error = cmd[0] == '-';
+	pid_t pid;
+	int err;
+
+	if (jobs->count == EXEC_JOBS_MAX) {
+		err = exec_join(jobs);
+		if (err < 0)
+			return err;
+	}
+	err = uc_mgr_exec_start(cmd + (ignore_error ? 1 : 0), &pid);
+	if (err < 0) {
+		if (ignore_error)
+			return 0;
+		uc_error("exec '%s' failed (%d)", cmd, err);
+		return err;
+	}
+	jobs->job[jobs->count].pid = pid;
+	jobs->job[jobs->count].cmd = cmd;
+	jobs->count++;
+	return 0;
+}
+
 /**
  * \brief Execute the sequence
  * \param uc_mgr Use case manager
@@ -736,10 +959,12 @@ static int execute_sequence(snd_use_case_mgr_t *uc_mgr,
 	struct sequence_element *s;
 	char *cdev = NULL;
 	snd_ctl_t *ctl = NULL;
-	struct ctl_list *ctl_list;
+	struct ctl_list *ctl_list = NULL;
+	struct exec_jobs jobs;
 	bool ignore_error;
 	int err = 0;
 
+	jobs.count = 0;
 	if (uc_mgr->sequence_hops > 100) {
 		uc_error("error: too many inner sequences!");
 		return -EINVAL;
@@ -821,23 +1046,45 @@ static int execute_sequence(snd_use_case_mgr_t *uc_mgr,
 				}
 				ctl = ctl_list->ctl;
 			}
-			err = execute_cset(ctl, s->data.cset, s->type);
+			if (uc_mgr->cset_batch &&
+			    s->type == SEQUENCE_ELEMENT_TYPE_CSET) {
+				err = execute_cset_batch(uc_mgr, ctl_list, s->data.cset);
+			} else {
+				err = cset_pending_flush(uc_mgr);
+				if (err >= 0)
+					err = execute_cset(ctl_list, s->data.cset, s->type);
+			}
 			if (err < 0) {
 				uc_error("unable to execute cset '%s'", s->data.cset);
 				goto __fail;
 			}
+			if (s->type != SEQUENCE_ELEMENT_TYPE_CSET_TLV &&
+			    s->type != SEQUENCE_ELEMENT_TYPE_CTL_REMOVE) {
+				err = uc_mgr_state_note(uc_mgr, cdev, s->data.cset);
+				if (err < 0)
+					goto __fail;
+			}
 			break;
 		case SEQUENCE_ELEMENT_TYPE_SYSSET:
+			err = cset_pending_flush(uc_mgr);
+			if (err < 0)
+				goto __fail;
 			err = execute_sysw(s->data.sysw);
 			if (err < 0)
 				goto __fail;
 			break;
 		case SEQUENCE_ELEMENT_TYPE_SLEEP:
+			err = cset_pending_flush(uc_mgr);
+			if (err < 0)
+				goto __fail;
 			usleep(s->data.sleep);
 			break;
 		case SEQUENCE_ELEMENT_TYPE_EXEC:
 			if (s->data.exec == NULL)
 				break;
+			err = cset_pending_flush(uc_mgr);
+			if (err < 0)
+				goto __fail;
 			ignore_error = s->data.exec[0] == '-';
 			err = uc_mgr_exec(s->data.exec + (ignore_error ? 1 : 0));
 			if (ignore_error == false && err != 0) {
@@ -845,9 +1092,27 @@ static int execute_sequence(snd_use_case_mgr_t *uc_mgr,
 				goto __fail;
 			}
 			break;
+		case SEQUENCE_ELEMENT_TYPE_EXEC_BG:
+			if (s->data.exec == NULL)
+				break;
+			err = cset_pending_flush(uc_mgr);
+			if (err < 0)
+				goto __fail;
+			err = exec_background(&jobs, s->data.exec);
+			if (err < 0)
+				goto __fail;
+			break;
+		case SEQUENCE_ELEMENT_TYPE_EXEC_JOIN:
+			err = exec_join(&jobs);
+			if (err < 0)
+				goto __fail;
+			break;
 		case SEQUENCE_ELEMENT_TYPE_SHELL:
 			if (s->data.exec == NULL)
 				break;
+			err = cset_pending_flush(uc_mgr);
+			if (err < 0)
+				goto __fail;
 			ignore_error = s->data.exec[0] == '-';
 shell_retry:
 			err = system(s->data.exec + (ignore_error ? 1 : 0));
@@ -880,6 +1145,9 @@ shell_retry:
 				goto __fail;
 			break;
 		case SEQUENCE_ELEMENT_TYPE_CFGSAVE:
+			err = cset_pending_flush(uc_mgr);
+			if (err < 0)
+				goto __fail;
 			err = execute_cfgsave(uc_mgr, s->data.cfgsave);
 			if (err < 0)
 				goto __fail;
@@ -901,12 +1169,16 @@ shell_retry:
 			break;
 		}
 	}
+	err = exec_join(&jobs);
+	if (err < 0)
+		goto __fail;
 	free(cdev);
 	uc_mgr->sequence_hops--;
 	return 0;
       __fail_nomem:
 	err = -ENOMEM;
       __fail:
+	exec_join(&jobs);
 	free(cdev);
 	uc_mgr->sequence_hops--;
 	return err;
@@ -966,7 +1238,9 @@ static int add_auto_value(snd_use_case_mgr_t *uc_mgr, const char *key, char *val
 		s = strdup(value);
 		if (s == NULL)
 			return -ENOMEM;
-		return uc_mgr_add_value(&uc_mgr->value_list, key, s);
+		err = uc_mgr_add_value(&uc_mgr->value_list, key, s);
+		uc_mgr_index_invalidate(uc_mgr);
+		return err;
 	} else if (err < 0) {
 		return err;
 	}
@@ -1026,6 +1300,7 @@ static int import_master_config(snd_use_case_mgr_t *uc_mgr)
 	int err;
 	
 	err = uc_mgr_import_master_config(uc_mgr);
+	uc_mgr_index_invalidate(uc_mgr);
 	if (err < 0)
 		return err;
 	return add_auto_values(uc_mgr);
@@ -1202,9 +1477,23 @@ static int get_list20(struct list_head *list,
 static inline struct use_case_verb *find_verb(snd_use_case_mgr_t *uc_mgr,
 					      const char *verb_name)
 {
-	return find(&uc_mgr->verb_list,
-		    struct use_case_verb, list, name,
-		    verb_name);
+	struct use_case_verb *verb;
+	unsigned int pos = 0;
+	void *obj;
+	int err;
+
+	err = uc_mgr_index_lookup(uc_mgr, &uc_mgr->verb_list, verb_name,
+				  &pos, &obj);
+	if (err >= 0)
+		verb = err > 0 ? obj : NULL;
+	else
+		verb = find(&uc_mgr->verb_list,
+			    struct use_case_verb, list, name,
+			    verb_name);
+	/* parse the verb file on first use (lazy loading) */
+	if (verb && uc_mgr_verb_load(uc_mgr, verb) < 0)
+		return NULL;
+	return verb;
 }
 
 static int is_devlist_supported(snd_use_case_mgr_t *uc_mgr, 
@@ -1227,6 +1516,9 @@ static int is_devlist_supported(snd_use_case_mgr_t *uc_mgr,
 		break;
 	}
 
+	if (list_empty(&uc_mgr->active_devices))
+		return 1 - found_ret;
+
 	list_for_each(pos, &dev_list->list) {
 		device = list_entry(pos, struct dev_list_node, list);
 
@@ -1264,6 +1556,18 @@ static inline struct use_case_device *
 {
 	struct use_case_device *device;
 	struct list_head *pos;
+	unsigned int ipos = 0;
+	void *obj;
+	int err;
+
+	while ((err = uc_mgr_index_lookup(uc_mgr, &verb->device_list,
+					  device_name, &ipos, &obj)) > 0) {
+		device = obj;
+		if (!check_supported || is_device_supported(uc_mgr, device))
+			return device;
+	}
+	if (err == 0)
+		return NULL;
 
 	list_for_each(pos, &verb->device_list) {
 		device = list_entry(pos, struct use_case_device, list);
@@ -1292,6 +1596,18 @@ static struct use_case_modifier *
 {
 	struct use_case_modifier *modifier;
 	struct list_head *pos;
+	unsigned int ipos = 0;
+	void *obj;
+	int err;
+
+	while ((err = uc_mgr_index_lookup(uc_mgr, &verb->modifier_list,
+					  modifier_name, &ipos, &obj)) > 0) {
+		modifier = obj;
+		if (!check_supported || is_modifier_supported(uc_mgr, modifier))
+			return modifier;
+	}
+	if (err == 0)
+		return NULL;
 
 	list_for_each(pos, &verb->modifier_list) {
 		modifier = list_entry(pos, struct use_case_modifier, list);
@@ -1511,6 +1827,11 @@ int snd_use_case_mgr_open(snd_use_case_mgr_t **uc_mgr,
 	INIT_LIST_HEAD(&mgr->active_devices);
 	INIT_LIST_HEAD(&mgr->ctl_list);
 	INIT_LIST_HEAD(&mgr->variable_list);
+	INIT_LIST_HEAD(&mgr->regex_cache);
+	INIT_LIST_HEAD(&mgr->subs_cache);
+	INIT_LIST_HEAD(&mgr->cset_pending);
+	INIT_LIST_HEAD(&mgr->state_elems);
+	mgr->value_gen = 1;
 	pthread_mutex_init(&mgr->mutex, NULL);
 
 	if (card_name && *card_name == '-') {
@@ -1521,6 +1842,11 @@ int snd_use_case_mgr_open(snd_use_case_mgr_t **uc_mgr,
 	if (card_name && card_name[0] == '<' && card_name[1] == '<' && card_name[2] == '<')
 		card_name = parse_open_variables(mgr, card_name);
 
+	if (card_name && strncmp(card_name, "lazy:", 5) == 0) {
+		card_name += 5;
+		mgr->lazy_verbs = 1;
+	}
+
 	err = uc_mgr_card_open(mgr);
 	if (err < 0) {
 		uc_mgr_free(mgr);
@@ -1570,6 +1896,7 @@ int snd_use_case_mgr_reload(snd_use_case_mgr_t *uc_mgr)
 	pthread_mutex_lock(&uc_mgr->mutex);
 
 	uc_mgr_free_verb(uc_mgr);
+	uc_mgr_subs_cache_free(uc_mgr);
 
 	uc_mgr->default_list_executed = 0;
 
@@ -2135,30 +2462,67 @@ int snd_use_case_get_list(snd_use_case_mgr_t *uc_mgr,
 	return err;
 }
 
+/*
+ * The substituted and rewritten value, cached in val until the next
+ * change of the configuration or of a variable.  Values reading the
+ * environment are resolved every time.
+ */
+static int get_value_data(snd_use_case_mgr_t *uc_mgr, char **value,
+			  struct ucm_value *val)
+{
+	int err;
+
+	if (uc_mgr->conf_format < 2) {
+		*value = strdup(val->data);
+		if (*value == NULL)
+			return -ENOMEM;
+		return 0;
+	}
+	if (val->cache && val->cache_gen == uc_mgr->value_gen)
+		goto __cached;
+	err = uc_mgr_get_substituted_value(uc_mgr, value, val->data);
+	if (err < 0)
+		return err;
+	err = rewrite_device_value(uc_mgr, val->name, value);
+	if (err < 0 || *value == NULL || strstr(val->data, "${env:"))
+		return err;
+	free(val->cache);
+	val->cache = *value;
+	val->cache_gen = uc_mgr->value_gen;
+      __cached:
+	*value = strdup(val->cache);
+	if (*value == NULL)
+		return -ENOMEM;
+	return 0;
+}
+
 static int get_value1(snd_use_case_mgr_t *uc_mgr, char **value,
 		      struct list_head *value_list, const char *identifier)
 {
 	struct ucm_value *val;
 	struct list_head *pos;
+	unsigned int ipos = 0;
+	void *obj;
 	int err;
 
 	if (!value_list)
 		return -ENOENT;
 
+	/* identifiers with a '/' suffix match by prefix, search those */
+	if (strchr(identifier, '/') == NULL &&
+	    uc_mgr_index_has_values(uc_mgr, value_list)) {
+		err = uc_mgr_index_lookup(uc_mgr, value_list, identifier,
+					  &ipos, &obj);
+		if (err > 0)
+			return get_value_data(uc_mgr, value, obj);
+		if (err == 0)
+			return -ENOENT;
+	}
+
 	list_for_each(pos, value_list) {
 		val = list_entry(pos, struct ucm_value, list);
-		if (check_identifier(identifier, val->name)) {
-			if (uc_mgr->conf_format < 2) {
-				*value = strdup(val->data);
-				if (*value == NULL)
-					return -ENOMEM;
-				return 0;
-			}
-			err = uc_mgr_get_substituted_value(uc_mgr, value, val->data);
-			if (err < 0)
-				return err;
-			return rewrite_device_value(uc_mgr, val->name, value);
-		}
+		if (check_identifier(identifier, val->name))
+			return get_value_data(uc_mgr, value, val);
 	}
 	return -ENOENT;
 }
@@ -2606,9 +2970,107 @@ static int set_modifier_user(snd_use_case_mgr_t *uc_mgr,
 	return set_modifier(uc_mgr, modifier, enable);
 }
 
+/*
+ * Restore the state saved by _stsave. When all saved controls still hold
+ * their values, only the verb, devices and modifiers are marked active;
+ * otherwise the sequences are executed as usual.
+ */
+static int restore_state_user(snd_use_case_mgr_t *uc_mgr,
+			      const char *filename)
+{
+	snd_config_iterator_t i, next;
+	snd_config_t *cfg, *n, *d;
+	struct use_case_verb *verb;
+	struct use_case_device *device;
+	struct use_case_modifier *modifier;
+	const char *name;
+	int err;
+
+	if (filename == NULL || *filename == '\0')
+		return -EINVAL;
+	if (uc_mgr->active_verb) {
+		uc_error("error: _strestore requires an inactive manager");
+		return -EBUSY;
+	}
+	err = uc_mgr_state_load(filename, &cfg);
+	if (err < 0)
+		return err;
+	if (snd_config_search(cfg, "Verb", &n) < 0 ||
+	    snd_config_get_string(n, &name) < 0) {
+		uc_error("error: no verb in state file '%s'", filename);
+		err = -EINVAL;
+		goto __end;
+	}
+	verb = find_verb(uc_mgr, name);
+	if (verb == NULL) {
+		err = -ENOENT;
+		goto __end;
+	}
+
+	err = uc_mgr_state_verify(uc_mgr, cfg);
+	if (err < 0)
+		goto __end;
+	if (err == 0) {
+		/* diverged, replay the sequences */
+		err = set_verb_user(uc_mgr, name);
+		if (err < 0)
+			goto __end;
+		if (snd_config_search(cfg, "Devices", &d) >= 0) {
+			snd_config_for_each(i, next, d) {
+				n = snd_config_iterator_entry(i);
+				if (snd_config_get_string(n, &name) < 0)
+					continue;
+				err = set_device_user(uc_mgr, name, 1);
+				if (err < 0)
+					goto __end;
+			}
+		}
+		if (snd_config_search(cfg, "Modifiers", &d) >= 0) {
+			snd_config_for_each(i, next, d) {
+				n = snd_config_iterator_entry(i);
+				if (snd_config_get_string(n, &name) < 0)
+					continue;
+				err = set_modifier_user(uc_mgr, name, 1);
+				if (err < 0)
+					goto __end;
+			}
+		}
+		err = 0;
+		goto __end;
+	}
+
+	uc_mgr->default_list_executed = 1;
+	uc_mgr->active_verb = verb;
+	if (snd_config_search(cfg, "Devices", &d) >= 0) {
+		snd_config_for_each(i, next, d) {
+			n = snd_config_iterator_entry(i);
+			if (snd_config_get_string(n, &name) < 0)
+				continue;
+			device = find_device(uc_mgr, verb, name, 0);
+			if (device && !device_status(uc_mgr, device->name))
+				list_add_tail(&device->active_list, &uc_mgr->active_devices);
+		}
+	}
+	if (snd_config_search(cfg, "Modifiers", &d) >= 0) {
+		snd_config_for_each(i, next, d) {
+			n = snd_config_iterator_entry(i);
+			if (snd_config_get_string(n, &name) < 0)
+				continue;
+			modifier = find_modifier(uc_mgr, verb, name, 0);
+			if (modifier && !modifier_status(uc_mgr, modifier->name))
+				list_add_tail(&modifier->active_list, &uc_mgr->active_modifiers);
+		}
+	}
+	err = 0;
+__end:
+	snd_config_delete(cfg);
+	return err;
+}
+
 static int switch_device(snd_use_case_mgr_t *uc_mgr,
 			 const char *old_device,
-			 const char *new_device)
+			 const char *new_device,
+			 bool diff)
 {
 	struct use_case_device *xold, *xnew;
 	struct transition_sequence *trans;
@@ -2633,6 +3095,16 @@ static int switch_device(snd_use_case_mgr_t *uc_mgr,
 	list_add_tail(&xold->active_list, &uc_mgr->active_devices);
 	if (xnew == NULL)
 		return -ENOENT;
+	if (diff) {
+		uc_mgr->cset_batch = 1;
+		err = switch_device(uc_mgr, old_device, new_device, false);
+		uc_mgr->cset_batch = 0;
+		if (err < 0) {
+			cset_pending_free(uc_mgr);
+			return err;
+		}
+		return cset_pending_flush(uc_mgr);
+	}
 	err = 0;
 	list_for_each(pos, &xold->transition_list) {
 		trans = list_entry(pos, struct transition_sequence, list);
@@ -2745,6 +3217,10 @@ int snd_use_case_set(snd_use_case_mgr_t *uc_mgr,
 		err = set_modifier_user(uc_mgr, value, 1);
 	else if (strcmp(identifier, "_dismod") == 0)
 		err = set_modifier_user(uc_mgr, value, 0);
+	else if (strcmp(identifier, "_stsave") == 0)
+		err = uc_mgr_state_save(uc_mgr, value);
+	else if (strcmp(identifier, "_strestore") == 0)
+		err = restore_state_user(uc_mgr, value);
 	else {
 		str1 = strchr(identifier, '/');
 		if (str1) {
@@ -2758,7 +3234,9 @@ int snd_use_case_set(snd_use_case_mgr_t *uc_mgr,
 			goto __end;
 		}
 		if (check_identifier(identifier, "_swdev"))
-			err = switch_device(uc_mgr, str, value);
+			err = switch_device(uc_mgr, str, value, false);
+		else if (check_identifier(identifier, "_swdiff"))
+			err = switch_device(uc_mgr, str, value, true);
 		else if (check_identifier(identifier, "_swmod"))
 			err = switch_modifier(uc_mgr, str, value);
 		else
@@ -944,6 +944,9 @@ struct use_case_device *find_component_dev(snd_use_case_mgr_t *uc_mgr,
 	list_for_each(pos, &uc_mgr->verb_list) {
 		verb = list_entry(pos, struct use_case_verb, list);
 
+		if (uc_mgr_verb_load(uc_mgr, verb) < 0)
+			continue;
+
 		/* search in the component device list */
 		list_for_each(posdev, &verb->cmpt_device_list) {
 			dev = list_entry(posdev, struct use_case_device, list);
@@ -1178,6 +1181,16 @@ exec:
 			goto exec;
 		}
 
+		if (strcmp(cmd, "exec-bg") == 0) {
+			curr->type = SEQUENCE_ELEMENT_TYPE_EXEC_BG;
+			goto exec;
+		}
+
+		if (strcmp(cmd, "exec-join") == 0) {
+			curr->type = SEQUENCE_ELEMENT_TYPE_EXEC_JOIN;
+			continue;
+		}
+
 		if (strcmp(cmd, "cfg-save") == 0) {
 			curr->type = SEQUENCE_ELEMENT_TYPE_CFGSAVE;
 			err = parse_string_substitute3(uc_mgr, n, &curr->data.cfgsave);
@@ -1921,16 +1934,16 @@ static int parse_verb(snd_use_case_mgr_t *uc_mgr,
  *  o Optional PCM device ID for verb and modifiers
  *  o Alias kcontrols IDs for master and volumes and mutes.
  */
+static int parse_verb_config(snd_use_case_mgr_t *uc_mgr,
+			     struct use_case_verb *verb,
+			     const char *file);
+
 static int parse_verb_file(snd_use_case_mgr_t *uc_mgr,
 			   const char *use_case_name,
 			   const char *comment,
 			   const char *file)
 {
-	snd_config_iterator_t i, next;
-	snd_config_t *n;
 	struct use_case_verb *verb;
-	snd_config_t *cfg;
-	int err;
 
 	/* allocate verb */
 	verb = calloc(1, sizeof(struct use_case_verb));
@@ -1958,6 +1971,63 @@ static int parse_verb_file(snd_use_case_mgr_t *uc_mgr,
 			return -ENOMEM;
 	}
 
+	/* defer the file parsing to the first use of this verb */
+	if (uc_mgr->lazy_verbs) {
+		verb->file = strdup(file);
+		if (verb->file == NULL)
+			return -ENOMEM;
+		if (uc_mgr->parse_variant) {
+			verb->variant = strdup(uc_mgr->parse_variant);
+			if (verb->variant == NULL)
+				return -ENOMEM;
+		}
+		return 0;
+	}
+
+	return parse_verb_config(uc_mgr, verb, file);
+}
+
+/*
+ * Parse the deferred verb file (lazy verb loading).
+ */
+int uc_mgr_verb_load(snd_use_case_mgr_t *uc_mgr, struct use_case_verb *verb)
+{
+	const char *variant;
+	int err;
+
+	if (verb->load_err < 0)
+		return verb->load_err;
+	if (verb->file == NULL || verb->loading)
+		return 0;
+
+	variant = uc_mgr->parse_variant;
+	uc_mgr->parse_variant = verb->variant;
+	verb->loading = 1;
+	err = parse_verb_config(uc_mgr, verb, verb->file);
+	uc_mgr_index_invalidate(uc_mgr);
+	verb->loading = 0;
+	uc_mgr->parse_variant = variant;
+	free(verb->file);
+	verb->file = NULL;
+	if (err < 0) {
+		uc_error("error: failed to load verb '%s'", verb->name);
+		verb->load_err = err;
+	}
+	return err;
+}
+
+/*
+ * Parse the verb file contents into the verb.
+ */
+static int parse_verb_config(snd_use_case_mgr_t *uc_mgr,
+			     struct use_case_verb *verb,
+			     const char *file)
+{
+	snd_config_iterator_t i, next;
+	snd_config_t *n;
+	snd_config_t *cfg;
+	int err;
+
 	/* open Verb file for reading */
 	err = uc_mgr_config_load_file(uc_mgr, file, &cfg);
 	if (err < 0)
@@ -2833,7 +2903,8 @@ int uc_mgr_import_master_config(snd_use_case_mgr_t *uc_mgr)
 		goto __error;
 
 	err = parse_master_file(uc_mgr, cfg);
-	if (uc_mgr->macros) {
+	/* lazily loaded verbs may still use the macros */
+	if (uc_mgr->macros && (err < 0 || !uc_mgr->lazy_verbs)) {
 		snd_config_delete(uc_mgr->macros);
 		uc_mgr->macros = NULL;
 	}
@@ -138,10 +138,7 @@ static int if_eval_string(snd_use_case_mgr_t *uc_mgr, snd_config_t *eval)
 static int if_eval_regex_match(snd_use_case_mgr_t *uc_mgr, snd_config_t *eval)
 {
 	const char *string, *regex_string;
-	char *s;
-	regex_t re;
-	int options = REG_EXTENDED | REG_ICASE;
-	regmatch_t match[1];
+	char *s, *r;
 	int err;
 
 	err = get_string(eval, "String", &string);
@@ -156,26 +153,18 @@ static int if_eval_regex_match(snd_use_case_mgr_t *uc_mgr, snd_config_t *eval)
 		return -EINVAL;
 	}
 
-	err = uc_mgr_get_substituted_value(uc_mgr, &s, regex_string);
+	err = uc_mgr_get_substituted_value(uc_mgr, &r, regex_string);
 	if (err < 0)
 		return err;
-	err = regcomp(&re, s, options);
-	if (err) {
-		uc_error("Regex '%s' compilation failed (code %d)", s, err);
-		free(s);
-		return -EINVAL;
-	}
-	free(s);
-
 	err = uc_mgr_get_substituted_value(uc_mgr, &s, string);
 	if (err < 0) {
-		regfree(&re);
+		free(r);
 		return err;
 	}
-	err = regexec(&re, s, ARRAY_SIZE(match), match, 0);
+	err = uc_mgr_regex_match(uc_mgr, r, REG_EXTENDED | REG_ICASE, s);
 	free(s);
-	regfree(&re);
-	return err == 0;
+	free(r);
+	return err;
 }
 
 static int if_eval_control_exists(snd_use_case_mgr_t *uc_mgr, snd_config_t *eval)
@@ -186,7 +175,7 @@ static int if_eval_control_exists(snd_use_case_mgr_t *uc_mgr, snd_config_t *eval
 	snd_ctl_elem_id_t *elem_id;
 	snd_ctl_elem_info_t *elem_info;
 	snd_ctl_elem_type_t type;
-	char *s;
+	char *s, *name_s;
 	int err, i, items;
 
 	snd_ctl_elem_id_alloca(&elem_id);
@@ -214,31 +203,36 @@ static int if_eval_control_exists(snd_use_case_mgr_t *uc_mgr, snd_config_t *eval
 	if (err < 0)
 		return err;
 	err = snd_ctl_ascii_elem_id_parse(elem_id, s);
-	free(s);
 	if (err < 0) {
+		free(s);
 		uc_error("unable to parse element identificator (%s)", ctldef);
 		return -EINVAL;
 	}
 
 	if (device == NULL) {
-		ctl = uc_mgr_get_ctl(uc_mgr);
-		if (ctl == NULL) {
+		ctl_list = uc_mgr_get_master_ctl(uc_mgr);
+		if (ctl_list == NULL) {
+			free(s);
 			uc_error("cannot determine control device");
 			return -EINVAL;
 		}
 	} else {
-		err = uc_mgr_get_substituted_value(uc_mgr, &s, device);
-		if (err < 0)
+		err = uc_mgr_get_substituted_value(uc_mgr, &name_s, device);
+		if (err < 0) {
+			free(s);
 			return err;
-		err = uc_mgr_open_ctl(uc_mgr, &ctl_list, s, 1);
-		free(s);
-		if (err < 0)
+		}
+		err = uc_mgr_open_ctl(uc_mgr, &ctl_list, name_s, 1);
+		free(name_s);
+		if (err < 0) {
+			free(s);
 			return err;
-		ctl = ctl_list->ctl;
+		}
 	}
+	ctl = ctl_list->ctl;
 
-	snd_ctl_elem_info_set_id(elem_info, elem_id);
-	err = snd_ctl_elem_info(ctl, elem_info);
+	err = uc_mgr_ctl_elem_lookup(ctl_list, s, elem_info, NULL);
+	free(s);
 	if (err < 0)
 		return 0;
 
@@ -234,6 +234,8 @@ usleep ARG     | sleep for specified amount of microseconds
 msleep ARG     | sleep for specified amount of milliseconds
 exec ARG       | execute a specific command (without shell - *man execv*)
 shell ARG      | execute a specific command (using shell - *man system*)
+exec-bg ARG    | start a specific command like exec, without waiting for it
+exec-join ""   | wait for the commands started by exec-bg
 cfg-save ARG   | save LibraryConfig to a file
 
 ~~~{.html}
@@ -246,9 +248,17 @@ sysw "-/class/sound/ctl-led/speaker/card${CardNumber}/attach:Speaker Channel Swi
 usleep 10
 exec "/bin/echo hello"
 shell "set"
+exec-bg "/usr/bin/amp-init left"
+exec-bg "/usr/bin/amp-init right"
+exec-join ""
 cfg-save "/tmp/test.conf:+pcm"
 ~~~
 
+The commands started by *exec-bg* run in parallel with each other and with
+the following sequence commands up to *exec-join*, which waits for all of
+them and fails when one failed (the '-' prefix ignores the exit code as for
+*exec*). The end of the sequence is an implicit *exec-join*.
+
 ### Naming (devices, verbs)
 
 See the SND_USE_CASE_VERB constains like #SND_USE_CASE_VERB_HIFI for the full list of known verbs.
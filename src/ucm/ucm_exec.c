@@ -32,55 +32,153 @@
 #include <sys/wait.h>
 #include <limits.h>
 #include <dirent.h>
+#include <spawn.h>
 
-static pthread_mutex_t fork_lock = PTHREAD_MUTEX_INITIALIZER;
+/*
+ * The resolved PATH entries of the exec names, valid while PATH stays
+ * the same and the binary is still there.
+ */
+#define EXEC_CACHE_MAX	32
+
+struct exec_cache {
+	struct exec_cache *next;
+	char *name;
+	char *path;
+};
+
+static pthread_mutex_t exec_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct exec_cache *exec_cache;
+static unsigned int exec_cache_count;
+static char *exec_cache_env;		/* PATH of the cached entries */
+
+static int is_exec(const char *path)
+{
+	struct stat64 st;
+
+	if (lstat64(path, &st))
+		return 0;
+	return S_ISREG(st.st_mode) && (st.st_mode & S_IEXEC);
+}
 
 /*
  * Search PATH for executable
  */
-static int find_exec(const char *name, char *out, size_t len)
+static int find_exec_path(const char *name, const char *env,
+			  char *out, size_t len)
 {
-	int ret = 0;
 	char bin[PATH_MAX];
 	char *path, *tmp, *tmp2 = NULL;
 	DIR *dir;
 	struct dirent64 *de;
-	struct stat64 st;
+
+	path = alloca(strlen(env) + 1);
+	if (!path)
+		return 0;
+	/* the exact name first, it saves reading the directories */
+	strcpy(path, env);
+	for (tmp = strtok_r(path, ":", &tmp2); tmp;
+	     tmp = strtok_r(NULL, ":", &tmp2)) {
+		snprintf(bin, sizeof(bin), "%s/%s", tmp, name);
+		if (is_exec(bin)) {
+			snd_strlcpy(out, bin, len);
+			return 1;
+		}
+	}
+	strcpy(path, env);
+	for (tmp = strtok_r(path, ":", &tmp2); tmp;
+	     tmp = strtok_r(NULL, ":", &tmp2)) {
+		if (!(dir = opendir(tmp)))
+			continue;
+		while ((de = readdir64(dir))) {
+			if (strstr(de->d_name, name) != de->d_name)
+				continue;
+			snprintf(bin, sizeof(bin), "%s/%s", tmp,
+				 de->d_name);
+			if (!is_exec(bin))
+				continue;
+			snd_strlcpy(out, bin, len);
+			closedir(dir);
+			return 1;
+		}
+		closedir(dir);
+	}
+	return 0;
+}
+
+static void exec_cache_flush(void)
+{
+	struct exec_cache *c;
+
+	while ((c = exec_cache) != NULL) {
+		exec_cache = c->next;
+		free(c->name);
+		free(c->path);
+		free(c);
+	}
+	exec_cache_count = 0;
+	free(exec_cache_env);
+	exec_cache_env = NULL;
+}
+
+static void exec_cache_add(const char *name, const char *path, const char *env)
+{
+	struct exec_cache *c;
+
+	if (exec_cache_env == NULL) {
+		exec_cache_env = strdup(env);
+		if (exec_cache_env == NULL)
+			return;
+	}
+	if (exec_cache_count >= EXEC_CACHE_MAX)
+		return;
+	c = calloc(1, sizeof(*c));
+	if (c == NULL)
+		return;
+	c->name = strdup(name);
+	c->path = strdup(path);
+	if (c->name == NULL || c->path == NULL) {
+		free(c->name);
+		free(c->path);
+		free(c);
+		return;
+	}
+	c->next = exec_cache;
+	exec_cache = c;
+	exec_cache_count++;
+}
+
+static int find_exec(const char *name, char *out, size_t len)
+{
+	struct exec_cache *c;
+	const char *env;
+	int ret;
+
 	if (name[0] == '/') {
-		if (lstat64(name, &st))
-			return 0;
-		if (!S_ISREG(st.st_mode) || !(st.st_mode & S_IEXEC))
+		if (!is_exec(name))
 			return 0;
 		snd_strlcpy(out, name, len);
 		return 1;
 	}
-	if (!(tmp = getenv("PATH")))
-		return 0;
-	path = alloca(strlen(tmp) + 1);
-	if (!path)
+	if (!(env = getenv("PATH")))
 		return 0;
-	strcpy(path, tmp);
-	tmp = strtok_r(path, ":", &tmp2);
-	while (tmp && !ret) {
-		if ((dir = opendir(tmp))) {
-			while ((de = readdir64(dir))) {
-				if (strstr(de->d_name, name) != de->d_name)
-					continue;
-				snprintf(bin, sizeof(bin), "%s/%s", tmp,
-					 de->d_name);
-				if (lstat64(bin, &st))
-					continue;
-				if (!S_ISREG(st.st_mode)
-				    || !(st.st_mode & S_IEXEC))
-					continue;
-				snd_strlcpy(out, bin, len);
-				closedir(dir);
-				return 1;
-			}
-			closedir(dir);
+	pthread_mutex_lock(&exec_cache_lock);
+	if (exec_cache_env && strcmp(exec_cache_env, env))
+		exec_cache_flush();
+	for (c = exec_cache; c; c = c->next) {
+		if (strcmp(c->name, name))
+			continue;
+		if (is_exec(c->path)) {
+			snd_strlcpy(out, c->path, len);
+			pthread_mutex_unlock(&exec_cache_lock);
+			return 1;
 		}
-		tmp = strtok_r(NULL, ":", &tmp2);
+		exec_cache_flush();
+		break;
 	}
+	ret = find_exec_path(name, env, out, len);
+	if (ret)
+		exec_cache_add(name, out, env);
+	pthread_mutex_unlock(&exec_cache_lock);
 	return ret;
 }
 
@@ -168,35 +266,65 @@ static int parse_args(char ***argv, int argc, const char *cmd)
 	return 0;
 }
 
+#ifdef HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCLOSEFROM_NP
 /*
- * execute a binary file
- *
+ * posix_spawn() runs the child in the address space of the caller until
+ * the exec (vfork), which saves copying the page tables of a large
+ * client process.  The actions give the same child as the fork below.
  */
-int uc_mgr_exec(const char *prog)
+static int exec_spawn(const char *prog, char **argv, pid_t *pid)
+{
+	posix_spawn_file_actions_t fa;
+	posix_spawnattr_t attr;
+	sigset_t sigs;
+	int err;
+
+	err = posix_spawn_file_actions_init(&fa);
+	if (err)
+		return -err;
+	err = posix_spawnattr_init(&attr);
+	if (err) {
+		posix_spawn_file_actions_destroy(&fa);
+		return -err;
+	}
+	err = posix_spawn_file_actions_addopen(&fa, 0, "/dev/null", O_RDWR, 0);
+	if (!err)
+		err = posix_spawn_file_actions_adddup2(&fa, 0, 1);
+	if (!err)
+		err = posix_spawn_file_actions_adddup2(&fa, 0, 2);
+	if (!err)
+		err = posix_spawn_file_actions_addclosefrom_np(&fa, 3);
+	/* default SIGINT and SIGQUIT handlers, own process group */
+	sigemptyset(&sigs);
+	sigaddset(&sigs, SIGINT);
+	sigaddset(&sigs, SIGQUIT);
+	if (!err)
+		err = posix_spawnattr_setsigdefault(&attr, &sigs);
+	if (!err)
+		err = posix_spawnattr_setpgroup(&attr, 0);
+	if (!err)
+		err = posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF |
+						      POSIX_SPAWN_SETPGROUP);
+	if (!err)
+		err = posix_spawn(pid, prog, &fa, &attr, argv, environ);
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&fa);
+	if (err) {
+		uc_error("Unable to spawn \"%s\" -- %s", prog, strerror(err));
+		return -err;
+	}
+	return 0;
+}
+#else
+static pthread_mutex_t fork_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int exec_spawn(const char *prog, char **argv, pid_t *pid)
 {
 	pid_t p, f, maxfd;
-	int err = 0, status;
-	char bin[PATH_MAX];
+	int err;
 	struct sigaction sa;
 	struct sigaction intr, quit;
 	sigset_t omask;
-	char **argv;
-
-	if (parse_args(&argv, 32, prog))
-		return -EINVAL;
-
-	prog = argv[0];
-	if (prog == NULL) {
-		err = -EINVAL;
-		goto __error;
-	}
-	if (prog[0] != '/' && prog[0] != '.') {
-		if (!find_exec(argv[0], bin, sizeof(bin))) {
-			err = -ENOEXEC;
-			goto __error;
-		}
-		prog = bin;
-	}
 
 	maxfd = sysconf(_SC_OPEN_MAX);
 
@@ -224,7 +352,7 @@ int uc_mgr_exec(const char *prog)
 		pthread_mutex_unlock(&fork_lock);
 		uc_error("Unable to fork() for \"%s\" -- %s", prog,
 			 strerror(errno));
-		goto __error;
+		return err;
 	}
 
 	if (p == 0) {
@@ -267,25 +395,76 @@ int uc_mgr_exec(const char *prog)
 	   might have been spawned */
 	setpgid(p, p);
 
-	while (1) {
-		f = waitpid(p, &status, 0);
-		if (f == -1) {
-			if (errno == EAGAIN)
-				continue;
-			err = -errno;
+	*pid = p;
+	return 0;
+}
+#endif
+
+/*
+ * start a binary file, the caller collects it with uc_mgr_exec_wait()
+ */
+int uc_mgr_exec_start(const char *prog, pid_t *pid)
+{
+	char bin[PATH_MAX];
+	char **argv;
+	int err;
+
+	if (parse_args(&argv, 32, prog))
+		return -EINVAL;
+
+	prog = argv[0];
+	if (prog == NULL) {
+		err = -EINVAL;
+		goto __error;
+	}
+	if (prog[0] != '/' && prog[0] != '.') {
+		if (!find_exec(argv[0], bin, sizeof(bin))) {
+			err = -ENOEXEC;
 			goto __error;
 		}
-		if (WIFSIGNALED(status)) {
-			err = -EINTR;
-			break;
-		}
-		if (WIFEXITED(status)) {
-			err = WEXITSTATUS(status);
-			break;
-		}
+		prog = bin;
 	}
 
+	err = exec_spawn(prog, argv, pid);
+
  __error:
 	free_args(argv);
 	return err;
 }
+
+/*
+ * wait for a started binary, returns its exit code
+ */
+int uc_mgr_exec_wait(pid_t pid)
+{
+	pid_t f;
+	int status;
+
+	while (1) {
+		f = waitpid(pid, &status, 0);
+		if (f == -1) {
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (WIFSIGNALED(status))
+			return -EINTR;
+		if (WIFEXITED(status))
+			return WEXITSTATUS(status);
+	}
+}
+
+/*
+ * execute a binary file
+ *
+ */
+int uc_mgr_exec(const char *prog)
+{
+	pid_t pid;
+	int err;
+
+	err = uc_mgr_exec_start(prog, &pid);
+	if (err < 0)
+		return err;
+	return uc_mgr_exec_wait(pid);
+}
@@ -0,0 +1,218 @@
+/*
+ *  Use case manager - hashed lookups by name
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "ucm_local.h"
+
+/*
+ * One open addressing table maps (list, name) to the verbs, devices,
+ * modifiers and values of the parsed configuration.  It is built on the
+ * first lookup and dropped by uc_mgr_index_invalidate() whenever the
+ * lists change (parsing, lazy verb loading, auto values), so the
+ * parser itself never sees it.  Entries of equal keys follow each other
+ * on the probe sequence in list order, which keeps the first match
+ * semantics of the linear searches.  Each value list also gets a marker
+ * slot, so a caller holding some other list knows to search it itself.
+ */
+struct ucm_index_slot {
+	const struct list_head *list;	/* the list the object is on */
+	const char *name;
+	void *object;
+};
+
+struct ucm_index {
+	unsigned int mask;
+	struct ucm_index_slot slots[];
+};
+
+/* name of the marker slots, compared by address */
+static const char index_list_mark[] = "";
+
+static unsigned int index_hash(const struct list_head *list, const char *name)
+{
+	unsigned int h = 2166136261U ^ (unsigned int)((unsigned long)list >> 4);
+
+	for (; *name; name++) {
+		h ^= (unsigned char)*name;
+		h *= 16777619U;
+	}
+	return h;
+}
+
+static void index_insert(struct ucm_index *index, const struct list_head *list,
+			 const char *name, void *object)
+{
+	unsigned int k;
+
+	if (name == NULL)
+		return;
+	k = index_hash(list, name) & index->mask;
+	while (index->slots[k].object)
+		k = (k + 1) & index->mask;
+	index->slots[k].list = list;
+	index->slots[k].name = name;
+	index->slots[k].object = object;
+}
+
+static unsigned int index_count_values(struct list_head *list)
+{
+	struct list_head *pos;
+	unsigned int count = 0;
+
+	list_for_each(pos, list)
+		count++;
+	return count + 1;	/* and the marker */
+}
+
+static void index_add_values(struct ucm_index *index, struct list_head *list)
+{
+	struct list_head *pos;
+	struct ucm_value *val;
+
+	index_insert(index, list, index_list_mark, list);
+	list_for_each(pos, list) {
+		val = list_entry(pos, struct ucm_value, list);
+		index_insert(index, list, val->name, val);
+	}
+}
+
+/* walk all indexed objects: count them, or insert them */
+static unsigned int index_walk(snd_use_case_mgr_t *uc_mgr, struct ucm_index *index)
+{
+	struct list_head *pos, *pos1;
+	struct use_case_verb *verb;
+	struct use_case_device *dev;
+	struct use_case_modifier *mod;
+	unsigned int count;
+
+	count = index_count_values(&uc_mgr->value_list);
+	if (index)
+		index_add_values(index, &uc_mgr->value_list);
+	list_for_each(pos, &uc_mgr->verb_list) {
+		verb = list_entry(pos, struct use_case_verb, list);
+		count += 1 + index_count_values(&verb->value_list);
+		if (index) {
+			index_insert(index, &uc_mgr->verb_list, verb->name, verb);
+			index_add_values(index, &verb->value_list);
+		}
+		list_for_each(pos1, &verb->device_list) {
+			dev = list_entry(pos1, struct use_case_device, list);
+			count += 1 + index_count_values(&dev->value_list);
+			if (index) {
+				index_insert(index, &verb->device_list, dev->name, dev);
+				index_add_values(index, &dev->value_list);
+			}
+		}
+		list_for_each(pos1, &verb->modifier_list) {
+			mod = list_entry(pos1, struct use_case_modifier, list);
+			count += 1 + index_count_values(&mod->value_list);
+			if (index) {
+				index_insert(index, &verb->modifier_list, mod->name, mod);
+				index_add_values(index, &mod->value_list);
+			}
+		}
+	}
+	return count;
+}
+
+static struct ucm_index *index_get(snd_use_case_mgr_t *uc_mgr)
+{
+	struct ucm_index *index = uc_mgr->index;
+	unsigned int size = 64, count;
+
+	if (index)
+		return index;
+	count = index_walk(uc_mgr, NULL);
+	while (size < count * 2)
+		size *= 2;
+	index = calloc(1, sizeof(*index) + size * sizeof(index->slots[0]));
+	if (index == NULL)
+		return NULL;
+	index->mask = size - 1;
+	index_walk(uc_mgr, index);
+	uc_mgr->index = index;
+	return index;
+}
+
+/**
+ * \brief Look up an object by name in a list of the configuration
+ * \param uc_mgr Use case manager
+ * \param list The verb, device, modifier or value list
+ * \param name The name to look up
+ * \param pos Iterator, 0 for the first match
+ * \param object Returned object (the structure holding the list entry)
+ * \return 1 when found, 0 when not, -ENOMEM when no index can be built
+ *
+ * Call again with the same \p pos for the following objects of the same
+ * name, in list order.
+ */
+int uc_mgr_index_lookup(snd_use_case_mgr_t *uc_mgr, const struct list_head *list,
+			const char *name, unsigned int *pos, void **object)
+{
+	struct ucm_index *index = index_get(uc_mgr);
+	struct ucm_index_slot *slot;
+	unsigned int k;
+
+	if (index == NULL)
+		return -ENOMEM;
+	if (*pos == 0)
+		k = index_hash(list, name) & index->mask;
+	else
+		k = *pos & index->mask;	/* the slot after the last match */
+	for (; (slot = &index->slots[k])->object; k = (k + 1) & index->mask) {
+		if (slot->list == list && slot->name != index_list_mark &&
+		    strcmp(slot->name, name) == 0) {
+			*pos = k + 1;
+			*object = slot->object;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * \brief Check that a value list is in the index
+ * \param uc_mgr Use case manager
+ * \param list The value list
+ * \return 1 when uc_mgr_index_lookup() covers the list, otherwise 0
+ */
+int uc_mgr_index_has_values(snd_use_case_mgr_t *uc_mgr, const struct list_head *list)
+{
+	struct ucm_index *index = index_get(uc_mgr);
+	struct ucm_index_slot *slot;
+	unsigned int k;
+
+	if (index == NULL)
+		return 0;
+	k = index_hash(list, index_list_mark) & index->mask;
+	for (; (slot = &index->slots[k])->object; k = (k + 1) & index->mask) {
+		if (slot->list == list && slot->name == index_list_mark)
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * \brief Drop the index and the cached values after a change
+ * \param uc_mgr Use case manager
+ */
+void uc_mgr_index_invalidate(snd_use_case_mgr_t *uc_mgr)
+{
+	free(uc_mgr->index);
+	uc_mgr->index = NULL;
+	uc_mgr->value_gen++;
+}
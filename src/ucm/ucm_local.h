@@ -38,6 +38,7 @@
 
 #include "local.h"
 #include <pthread.h>
+#include <regex.h>
 #include "use-case.h"
 
 #define SYNTAX_VERSION_MAX	6
@@ -60,11 +61,15 @@
 #define SEQUENCE_ELEMENT_TYPE_DEV_ENABLE_SEQ	13
 #define SEQUENCE_ELEMENT_TYPE_DEV_DISABLE_SEQ	14
 #define SEQUENCE_ELEMENT_TYPE_DEV_DISABLE_ALL	15
+#define SEQUENCE_ELEMENT_TYPE_EXEC_BG		16
+#define SEQUENCE_ELEMENT_TYPE_EXEC_JOIN		17
 
 struct ucm_value {
         struct list_head list;
         char *name;
         char *data;
+        char *cache;		/* substituted data, valid for cache_gen */
+        unsigned int cache_gen;
 };
 
 /* sequence of a component device */
@@ -128,6 +133,8 @@ struct ctl_list {
 	snd_ctl_card_info_t *ctl_info;
 	int slave;
 	int ucm_group;
+	/* resolved element ids of the csets (uc_mgr_ctl_elem_lookup) */
+	struct list_head *elem_hash;
 };
 
 struct ucm_dev_name {
@@ -219,6 +226,12 @@ struct use_case_verb {
 	/* temporary modifications lists */
 	struct list_head rename_list;
 	struct list_head remove_list;
+
+	/* lazy loading: verb file not parsed yet */
+	char *file;
+	char *variant;
+	int load_err;
+	unsigned int loading: 1;
 };
 
 /*
@@ -232,6 +245,7 @@ struct snd_use_case_mgr {
 	int conf_format;
 	unsigned int ucm_card_number;
 	int suppress_nodev_errors;
+	int lazy_verbs;
 	const char *parse_variant;
 	int parse_master_section;
 	int sequence_hops;
@@ -269,6 +283,17 @@ struct snd_use_case_mgr {
 	/* list of opened control devices */
 	struct list_head ctl_list;
 
+	/* compiled regex cache (ucm_regex.c) */
+	struct list_head regex_cache;
+	unsigned int regex_cache_count;
+
+	/* cached results of the probing substitutions (ucm_subs.c) */
+	struct list_head subs_cache;
+
+	/* hashed lookups (ucm_index.c), value_gen ages the value caches */
+	struct ucm_index *index;
+	unsigned int value_gen;
+
 	/* tree with macros */
 	snd_config_t *macros;
 	int macro_hops;
@@ -283,6 +308,13 @@ struct snd_use_case_mgr {
 	 */
 	int in_component_domain;
 	char *cdev;
+
+	/* control elements written by the sequences (ucm_state.c) */
+	struct list_head state_elems;
+
+	/* pending cset writes of a diffed device switch (_swdiff) */
+	int cset_batch;
+	struct list_head cset_pending;
 };
 
 #define uc_error SNDERR
@@ -313,6 +345,7 @@ void uc_mgr_free_dev_name_list(struct list_head *base);
 void uc_mgr_free_sequence_element(struct sequence_element *seq);
 void uc_mgr_free_transition_element(struct transition_sequence *seq);
 void uc_mgr_free_verb(snd_use_case_mgr_t *uc_mgr);
+int uc_mgr_verb_load(snd_use_case_mgr_t *uc_mgr, struct use_case_verb *verb);
 void uc_mgr_free(snd_use_case_mgr_t *uc_mgr);
 
 static inline int uc_mgr_has_local_config(snd_use_case_mgr_t *uc_mgr)
@@ -334,6 +367,10 @@ struct ctl_list *uc_mgr_get_ctl_by_card(snd_use_case_mgr_t *uc_mgr, int card);
 struct ctl_list *uc_mgr_get_ctl_by_name(snd_use_case_mgr_t *uc_mgr,
 					const char *name, int idx);
 snd_ctl_t *uc_mgr_get_ctl(snd_use_case_mgr_t *uc_mgr);
+int uc_mgr_ctl_elem_lookup(struct ctl_list *ctl_list, const char *key,
+			   snd_ctl_elem_info_t *info, const char **rest);
+void uc_mgr_ctl_elem_forget(struct ctl_list *ctl_list, const char *key);
+void uc_mgr_ctl_elem_flush(struct ctl_list *ctl_list);
 void uc_mgr_free_ctl_list(snd_use_case_mgr_t *uc_mgr);
 
 int uc_mgr_add_value(struct list_head *base, const char *key, char *val);
@@ -351,6 +388,19 @@ int uc_mgr_get_substituted_value(snd_use_case_mgr_t *uc_mgr,
 				 char **_rvalue,
 				 const char *value);
 
+void uc_mgr_subs_cache_free(snd_use_case_mgr_t *uc_mgr);
+
+int uc_mgr_index_lookup(snd_use_case_mgr_t *uc_mgr, const struct list_head *list,
+			const char *name, unsigned int *pos, void **object);
+int uc_mgr_index_has_values(snd_use_case_mgr_t *uc_mgr, const struct list_head *list);
+void uc_mgr_index_invalidate(snd_use_case_mgr_t *uc_mgr);
+
+int uc_mgr_state_note(snd_use_case_mgr_t *uc_mgr, const char *cdev,
+		      const char *cset);
+void uc_mgr_state_free(snd_use_case_mgr_t *uc_mgr);
+int uc_mgr_state_save(snd_use_case_mgr_t *uc_mgr, const char *filename);
+int uc_mgr_state_load(const char *filename, snd_config_t **cfg);
+int uc_mgr_state_verify(snd_use_case_mgr_t *uc_mgr, snd_config_t *cfg);
 int uc_mgr_substitute_tree(snd_use_case_mgr_t *uc_mgr,
 			   snd_config_t *node);
 
@@ -369,11 +419,18 @@ int uc_mgr_evaluate_condition(snd_use_case_mgr_t *uc_mgr,
 			      snd_config_t *parent,
 			      snd_config_t *cond);
 
+int uc_mgr_regex_compile(snd_use_case_mgr_t *uc_mgr, const char *pattern,
+			 int options, const regex_t **re);
+int uc_mgr_regex_match(snd_use_case_mgr_t *uc_mgr, const char *pattern,
+		       int options, const char *string);
+void uc_mgr_regex_cache_free(snd_use_case_mgr_t *uc_mgr);
 int uc_mgr_define_regex(snd_use_case_mgr_t *uc_mgr,
 			const char *name,
 			snd_config_t *eval);
 
 int uc_mgr_exec(const char *prog);
+int uc_mgr_exec_start(const char *prog, pid_t *pid);
+int uc_mgr_exec_wait(pid_t pid);
 
 /** The name of the environment variable containing the UCM directory */
 #define ALSA_CONFIG_UCM_VAR "ALSA_CONFIG_UCM"
@@ -39,6 +39,112 @@ static int get_string(snd_config_t *compound, const char *key, const char **str)
 	return snd_config_get_string(node, str);
 }
 
+/* max. number of cached compiled regexes per manager */
+#define REGEX_CACHE_MAX		64
+
+struct ucm_regex {
+	struct list_head list;
+	char *pattern;
+	int options;
+	regex_t re;
+	/* memoized result of the last uc_mgr_regex_match() */
+	char *last_string;
+	int last_result;
+};
+
+static void regex_entry_free(struct ucm_regex *r)
+{
+	list_del(&r->list);
+	regfree(&r->re);
+	free(r->pattern);
+	free(r->last_string);
+	free(r);
+}
+
+/*
+ * Compile the pattern or return the cached compiled regex (owned by the
+ * cache, valid until the manager is freed). Returns a regcomp() error code.
+ */
+int uc_mgr_regex_compile(snd_use_case_mgr_t *uc_mgr, const char *pattern,
+			 int options, const regex_t **re)
+{
+	struct list_head *pos;
+	struct ucm_regex *r;
+	int err;
+
+	list_for_each(pos, &uc_mgr->regex_cache) {
+		r = list_entry(pos, struct ucm_regex, list);
+		if (r->options == options && strcmp(r->pattern, pattern) == 0) {
+			/* keep the most recently used first */
+			list_del(&r->list);
+			list_add(&r->list, &uc_mgr->regex_cache);
+			*re = &r->re;
+			return 0;
+		}
+	}
+
+	r = calloc(1, sizeof(*r));
+	if (r == NULL)
+		return REG_ESPACE;
+	r->pattern = strdup(pattern);
+	if (r->pattern == NULL) {
+		free(r);
+		return REG_ESPACE;
+	}
+	err = regcomp(&r->re, pattern, options);
+	if (err) {
+		free(r->pattern);
+		free(r);
+		return err;
+	}
+	r->options = options;
+	list_add(&r->list, &uc_mgr->regex_cache);
+	if (++uc_mgr->regex_cache_count > REGEX_CACHE_MAX) {
+		regex_entry_free(list_entry(uc_mgr->regex_cache.prev,
+					    struct ucm_regex, list));
+		uc_mgr->regex_cache_count--;
+	}
+	*re = &r->re;
+	return 0;
+}
+
+/*
+ * Match the string against the pattern (no captures). The result for
+ * the last string is remembered per pattern, the match is pure.
+ * Returns 1 on match, 0 on no match or a negative error code.
+ */
+int uc_mgr_regex_match(snd_use_case_mgr_t *uc_mgr, const char *pattern,
+		       int options, const char *string)
+{
+	const regex_t *re;
+	struct ucm_regex *r;
+	regmatch_t match[1];
+	int err;
+
+	err = uc_mgr_regex_compile(uc_mgr, pattern, options, &re);
+	if (err) {
+		uc_error("Regex '%s' compilation failed (code %d)", pattern, err);
+		return -EINVAL;
+	}
+	r = list_entry(uc_mgr->regex_cache.next, struct ucm_regex, list);
+	if (r->last_string && strcmp(r->last_string, string) == 0)
+		return r->last_result;
+	err = regexec(re, string, ARRAY_SIZE(match), match, 0) == 0;
+	free(r->last_string);
+	r->last_string = strdup(string);
+	r->last_result = err;
+	return err;
+}
+
+void uc_mgr_regex_cache_free(snd_use_case_mgr_t *uc_mgr)
+{
+	struct list_head *pos, *npos;
+
+	list_for_each_safe(pos, npos, &uc_mgr->regex_cache)
+		regex_entry_free(list_entry(pos, struct ucm_regex, list));
+	uc_mgr->regex_cache_count = 0;
+}
+
 static char *extract_substring(const char *data, regmatch_t *match)
 {
 	char *s;
@@ -92,7 +198,7 @@ int uc_mgr_define_regex(snd_use_case_mgr_t *uc_mgr, const char *name,
 {
 	const char *string, *regex_string, *flags_string;
 	char *s;
-	regex_t re;
+	const regex_t *re;
 	int options = 0;
 	regmatch_t match[20];
 	int err;
@@ -151,19 +257,18 @@ int uc_mgr_define_regex(snd_use_case_mgr_t *uc_mgr, const char *name,
 	err = uc_mgr_get_substituted_value(uc_mgr, &s, regex_string);
 	if (err < 0)
 		return err;
-	err = regcomp(&re, s, options);
-	free(s);
+	err = uc_mgr_regex_compile(uc_mgr, s, options, &re);
 	if (err) {
-		uc_error("Regex '%s' compilation failed (code %d)", err);
+		uc_error("Regex '%s' compilation failed (code %d)", s, err);
+		free(s);
 		return -EINVAL;
 	}
+	free(s);
 
 	err = uc_mgr_get_substituted_value(uc_mgr, &s, string);
-	if (err < 0) {
-		regfree(&re);
+	if (err < 0)
 		return err;
-	}
-	err = regexec(&re, s, ARRAY_SIZE(match), match, 0);
+	err = regexec(re, s, ARRAY_SIZE(match), match, 0);
 	if (err < 0)
 		err = -errno;
 	else if (err == REG_NOMATCH)
@@ -171,6 +276,5 @@ int uc_mgr_define_regex(snd_use_case_mgr_t *uc_mgr, const char *name,
 	else
 		err = set_variables(uc_mgr, s, ARRAY_SIZE(match), match, name);
 	free(s);
-	regfree(&re);
 	return err;
 }
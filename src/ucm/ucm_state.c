@@ -0,0 +1,368 @@
+/*
+ *  Use case manager - control state snapshot
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "ucm_local.h"
+#include "../control/control_local.h"
+#include <stdbool.h>
+
+/*
+ * The snapshot records the active verb, devices and modifiers and the
+ * final values of the control elements written by the executed cset
+ * steps. It is saved in the configuration syntax:
+ *
+ *   Verb "HiFi"
+ *   Devices [ "Speaker" ]
+ *   Modifiers [ ]
+ *   Controls [
+ *     { Cdev "hw:0" Id "iface=MIXER,name='PCM Volume'" Value "32,32" }
+ *   ]
+ */
+
+struct ucm_state_elem {
+	struct list_head list;
+	char *cdev;
+	snd_ctl_elem_id_t id;
+};
+
+static int state_note_id(snd_use_case_mgr_t *uc_mgr, const char *cdev,
+			 const snd_ctl_elem_id_t *id)
+{
+	struct list_head *pos;
+	struct ucm_state_elem *e;
+
+	list_for_each(pos, &uc_mgr->state_elems) {
+		e = list_entry(pos, struct ucm_state_elem, list);
+		if (strcmp(e->cdev, cdev) == 0 &&
+		    snd_ctl_elem_id_compare_set(&e->id, id) == 0)
+			return 0;
+	}
+	e = calloc(1, sizeof(*e));
+	if (e == NULL)
+		return -ENOMEM;
+	e->cdev = strdup(cdev);
+	if (e->cdev == NULL) {
+		free(e);
+		return -ENOMEM;
+	}
+	e->id = *id;
+	e->id.numid = 0;
+	list_add_tail(&e->list, &uc_mgr->state_elems);
+	return 0;
+}
+
+/*
+ * Remember the element written by a cset step for the snapshot.
+ */
+int uc_mgr_state_note(snd_use_case_mgr_t *uc_mgr, const char *cdev,
+		      const char *cset)
+{
+	snd_ctl_elem_id_t id;
+	const char *pos;
+	int err;
+
+	memset(&id, 0, sizeof(id));
+	err = __snd_ctl_ascii_elem_id_parse(&id, cset, &pos);
+	if (err < 0)
+		return err;
+	return state_note_id(uc_mgr, cdev, &id);
+}
+
+void uc_mgr_state_free(snd_use_case_mgr_t *uc_mgr)
+{
+	struct list_head *pos, *npos;
+	struct ucm_state_elem *e;
+
+	list_for_each_safe(pos, npos, &uc_mgr->state_elems) {
+		e = list_entry(pos, struct ucm_state_elem, list);
+		list_del(&e->list);
+		free(e->cdev);
+		free(e);
+	}
+}
+
+/*
+ * Read the element and print its value as a comma separated list.
+ */
+static int state_read_value(snd_use_case_mgr_t *uc_mgr, const char *cdev,
+			    snd_ctl_elem_id_t *id, char **res)
+{
+	struct ctl_list *ctl_list;
+	snd_ctl_elem_info_t info;
+	snd_ctl_elem_value_t value;
+	unsigned int idx, count;
+	size_t size, pos;
+	char *buf;
+	int err;
+
+	err = uc_mgr_open_ctl(uc_mgr, &ctl_list, cdev, 1);
+	if (err < 0)
+		return err;
+	memset(&info, 0, sizeof(info));
+	snd_ctl_elem_info_set_id(&info, id);
+	err = snd_ctl_elem_info(ctl_list->ctl, &info);
+	if (err < 0)
+		return err;
+	memset(&value, 0, sizeof(value));
+	snd_ctl_elem_value_set_id(&value, &info.id);
+	err = snd_ctl_elem_read(ctl_list->ctl, &value);
+	if (err < 0)
+		return err;
+
+	count = snd_ctl_elem_info_get_count(&info);
+	size = count * 21 + 1;
+	buf = malloc(size);
+	if (buf == NULL)
+		return -ENOMEM;
+	buf[0] = '\0';
+	for (idx = 0, pos = 0; idx < count; idx++) {
+		if (idx > 0)
+			buf[pos++] = ',';
+		switch (snd_ctl_elem_info_get_type(&info)) {
+		case SND_CTL_ELEM_TYPE_BOOLEAN:
+		case SND_CTL_ELEM_TYPE_INTEGER:
+			pos += snprintf(buf + pos, size - pos, "%ld",
+					value.value.integer.value[idx]);
+			break;
+		case SND_CTL_ELEM_TYPE_INTEGER64:
+			pos += snprintf(buf + pos, size - pos, "%lld",
+					value.value.integer64.value[idx]);
+			break;
+		case SND_CTL_ELEM_TYPE_ENUMERATED:
+			pos += snprintf(buf + pos, size - pos, "%u",
+					value.value.enumerated.item[idx]);
+			break;
+		case SND_CTL_ELEM_TYPE_BYTES:
+			pos += snprintf(buf + pos, size - pos, "%u",
+					value.value.bytes.data[idx]);
+			break;
+		default:
+			free(buf);
+			return -EINVAL;
+		}
+	}
+	*res = buf;
+	return 0;
+}
+
+static int state_add_string(snd_config_t *parent, const char *id,
+			    const char *str)
+{
+	snd_config_t *n;
+	int err;
+
+	err = snd_config_imake_string(&n, id, str);
+	if (err < 0)
+		return err;
+	err = snd_config_add(parent, n);
+	if (err < 0)
+		snd_config_delete(n);
+	return err;
+}
+
+static int state_add_list(snd_config_t *top, const char *id,
+			  struct list_head *list, bool modifiers)
+{
+	struct list_head *pos;
+	snd_config_t *n;
+	const char *name;
+	char nid[16];
+	int err, idx = 0;
+
+	err = snd_config_make_compound(&n, id, 0);
+	if (err < 0)
+		return err;
+	err = snd_config_add(top, n);
+	if (err < 0) {
+		snd_config_delete(n);
+		return err;
+	}
+	list_for_each(pos, list) {
+		if (modifiers)
+			name = list_entry(pos, struct use_case_modifier, active_list)->name;
+		else
+			name = list_entry(pos, struct use_case_device, active_list)->name;
+		snprintf(nid, sizeof(nid), "%d", idx++);
+		err = state_add_string(n, nid, name);
+		if (err < 0)
+			return err;
+	}
+	return 0;
+}
+
+/*
+ * Save the snapshot of the current state to the file.
+ */
+int uc_mgr_state_save(snd_use_case_mgr_t *uc_mgr, const char *filename)
+{
+	struct list_head *pos;
+	struct ucm_state_elem *e;
+	snd_config_t *top, *controls, *n;
+	snd_output_t *out;
+	char nid[16], *s;
+	int err, idx = 0;
+
+	if (uc_mgr->active_verb == NULL) {
+		uc_error("error: no active verb to save");
+		return -EINVAL;
+	}
+	err = snd_config_top(&top);
+	if (err < 0)
+		return err;
+	err = state_add_string(top, "Verb", uc_mgr->active_verb->name);
+	if (err < 0)
+		goto __end;
+	err = state_add_list(top, "Devices", &uc_mgr->active_devices, false);
+	if (err < 0)
+		goto __end;
+	err = state_add_list(top, "Modifiers", &uc_mgr->active_modifiers, true);
+	if (err < 0)
+		goto __end;
+	err = snd_config_make_compound(&controls, "Controls", 0);
+	if (err < 0)
+		goto __end;
+	err = snd_config_add(top, controls);
+	if (err < 0) {
+		snd_config_delete(controls);
+		goto __end;
+	}
+	list_for_each(pos, &uc_mgr->state_elems) {
+		e = list_entry(pos, struct ucm_state_elem, list);
+		snprintf(nid, sizeof(nid), "%d", idx++);
+		err = snd_config_make_compound(&n, nid, 0);
+		if (err < 0)
+			goto __end;
+		err = snd_config_add(controls, n);
+		if (err < 0) {
+			snd_config_delete(n);
+			goto __end;
+		}
+		err = state_add_string(n, "Cdev", e->cdev);
+		if (err < 0)
+			goto __end;
+		s = snd_ctl_ascii_elem_id_get(&e->id);
+		if (s == NULL) {
+			err = -ENOMEM;
+			goto __end;
+		}
+		err = state_add_string(n, "Id", s);
+		free(s);
+		if (err < 0)
+			goto __end;
+		err = state_read_value(uc_mgr, e->cdev, &e->id, &s);
+		if (err < 0) {
+			uc_error("unable to read control for the snapshot (%s)",
+				 snd_strerror(err));
+			goto __end;
+		}
+		err = state_add_string(n, "Value", s);
+		free(s);
+		if (err < 0)
+			goto __end;
+	}
+
+	err = snd_output_stdio_open(&out, filename, "w");
+	if (err < 0) {
+		uc_error("unable to open file '%s': %s", filename, snd_strerror(err));
+		goto __end;
+	}
+	err = snd_config_save(top, out);
+	snd_output_close(out);
+	if (err < 0)
+		uc_error("unable to save state: %s", snd_strerror(err));
+__end:
+	snd_config_delete(top);
+	return err;
+}
+
+/*
+ * Load the snapshot file.
+ */
+int uc_mgr_state_load(const char *filename, snd_config_t **cfg)
+{
+	snd_config_t *top;
+	snd_input_t *in;
+	int err;
+
+	err = snd_input_stdio_open(&in, filename, "r");
+	if (err < 0)
+		return err;
+	err = snd_config_top(&top);
+	if (err < 0) {
+		snd_input_close(in);
+		return err;
+	}
+	err = snd_config_load(top, in);
+	snd_input_close(in);
+	if (err < 0) {
+		uc_error("unable to load state file '%s': %s", filename, snd_strerror(err));
+		snd_config_delete(top);
+		return err;
+	}
+	*cfg = top;
+	return 0;
+}
+
+/*
+ * Compare the snapshot controls with the hardware (one read per element).
+ * Returns 1 when all values match (the elements are remembered for the
+ * next snapshot), 0 when the state diverges.
+ */
+int uc_mgr_state_verify(snd_use_case_mgr_t *uc_mgr, snd_config_t *cfg)
+{
+	snd_config_iterator_t i, next;
+	snd_config_t *controls, *n, *d;
+	const char *cdev, *sid, *val;
+	snd_ctl_elem_id_t id;
+	char *s;
+	int err, match;
+
+	if (snd_config_search(cfg, "Controls", &controls) < 0)
+		return 0;
+	snd_config_for_each(i, next, controls) {
+		n = snd_config_iterator_entry(i);
+		if (snd_config_search(n, "Cdev", &d) < 0 ||
+		    snd_config_get_string(d, &cdev) < 0 ||
+		    snd_config_search(n, "Id", &d) < 0 ||
+		    snd_config_get_string(d, &sid) < 0 ||
+		    snd_config_search(n, "Value", &d) < 0 ||
+		    snd_config_get_string(d, &val) < 0)
+			return 0;
+		memset(&id, 0, sizeof(id));
+		if (snd_ctl_ascii_elem_id_parse(&id, sid) < 0)
+			return 0;
+		if (state_read_value(uc_mgr, cdev, &id, &s) < 0)
+			return 0;
+		match = strcmp(s, val) == 0;
+		free(s);
+		if (!match)
+			return 0;
+	}
+	snd_config_for_each(i, next, controls) {
+		n = snd_config_iterator_entry(i);
+		snd_config_search(n, "Cdev", &d);
+		snd_config_get_string(d, &cdev);
+		snd_config_search(n, "Id", &d);
+		snd_config_get_string(d, &sid);
+		memset(&id, 0, sizeof(id));
+		snd_ctl_ascii_elem_id_parse(&id, sid);
+		err = state_note_id(uc_mgr, cdev, &id);
+		if (err < 0)
+			return err;
+	}
+	return 1;
+}
@@ -223,7 +223,7 @@ static char *rval_lookup_main(snd_use_case_mgr_t *uc_mgr,
 	const char *s;
 	char *result;
 	regmatch_t match[1];
-	regex_t re;
+	const regex_t *re;
 	int err;
 
 	if (uc_mgr->conf_format < 4) {
@@ -260,7 +260,7 @@ static char *rval_lookup_main(snd_use_case_mgr_t *uc_mgr,
 	}
 	if (snd_config_get_string(d, &s))
 		goto null;
-	err = regcomp(&re, s, REG_EXTENDED | REG_ICASE);
+	err = uc_mgr_regex_compile(uc_mgr, s, REG_EXTENDED | REG_ICASE, &re);
 	if (err) {
 		uc_error("Regex '%s' compilation failed (code %d)", s, err);
 		goto null;
@@ -271,12 +271,11 @@ static char *rval_lookup_main(snd_use_case_mgr_t *uc_mgr,
 		s = curr->fcn(iter->info);
 		if (s == NULL)
 			continue;
-		if (regexec(&re, s, ARRAY_SIZE(match), match, 0) == 0) {
+		if (regexec(re, s, ARRAY_SIZE(match), match, 0) == 0) {
 			result = curr->retfcn(iter, config);
 			break;
 		}
 	}
-	regfree(&re);
 fin:
 	snd_config_delete(config);
 	if (iter->done)
@@ -641,6 +640,66 @@ static int rval_evali(snd_use_case_mgr_t *uc_mgr, snd_config_t *node, const char
 	return snd_config_substitute(node, dst);
 }
 
+/*
+ * The sysfs and card / device lookups probe the hardware, so the results
+ * (including the failed ones) are remembered for the manager's lifetime
+ * and every probe is done only once per configuration parse.
+ */
+struct subs_cache {
+	struct list_head list;
+	char *(*fcn)(snd_use_case_mgr_t *, const char *id);
+	char *id;
+	char *value;
+};
+
+static char *subs_cache_call(snd_use_case_mgr_t *uc_mgr,
+			     char *(*fcn)(snd_use_case_mgr_t *, const char *id),
+			     const char *id)
+{
+	struct list_head *pos;
+	struct subs_cache *c;
+	char *rval;
+
+	list_for_each(pos, &uc_mgr->subs_cache) {
+		c = list_entry(pos, struct subs_cache, list);
+		if (c->fcn == fcn && strcmp(c->id, id) == 0) {
+			if (c->value == NULL)
+				return NULL;
+			return strdup(c->value);
+		}
+	}
+	rval = fcn(uc_mgr, id);
+	c = calloc(1, sizeof(*c));
+	if (c == NULL)
+		return rval;
+	c->fcn = fcn;
+	c->id = strdup(id);
+	if (rval)
+		c->value = strdup(rval);
+	if (c->id == NULL || (rval && c->value == NULL)) {
+		free(c->id);
+		free(c->value);
+		free(c);
+		return rval;
+	}
+	list_add(&c->list, &uc_mgr->subs_cache);
+	return rval;
+}
+
+void uc_mgr_subs_cache_free(snd_use_case_mgr_t *uc_mgr)
+{
+	struct list_head *pos, *npos;
+	struct subs_cache *c;
+
+	list_for_each_safe(pos, npos, &uc_mgr->subs_cache) {
+		c = list_entry(pos, struct subs_cache, list);
+		list_del(&c->list);
+		free(c->id);
+		free(c->value);
+		free(c);
+	}
+}
+
 #define MATCH_VARIABLE(name, id, fcn, empty_ok)				\
 	if (strncmp((name), (id), sizeof(id) - 1) == 0) { 		\
 		rval = fcn(uc_mgr);					\
@@ -649,11 +708,12 @@ static int rval_evali(snd_use_case_mgr_t *uc_mgr, snd_config_t *node, const char
 		goto __rval;						\
 	}
 
-#define MATCH_VARIABLE2(name, id, fcn, empty_ok)			\
+#define MATCH_VARIABLE2(name, id, fcn, empty_ok, cache_ok)		\
 	if (strncmp((name), (id), sizeof(id) - 1) == 0) {		\
 		idsize = sizeof(id) - 1;				\
 		allow_empty = (empty_ok);				\
 		fcn2 = (fcn);						\
+		cached = (cache_ok);					\
 		goto __match2;						\
 	}
 
@@ -703,7 +763,7 @@ int uc_mgr_get_substituted_value(snd_use_case_mgr_t *uc_mgr,
 	size_t size, nsize, idsize, rvalsize, dpos = 0;
 	const char *tmp;
 	char *r, *nr, *rval, v2[128];
-	bool ignore_error, allow_empty;
+	bool ignore_error, allow_empty, cached;
 	char *(*fcn2)(snd_use_case_mgr_t *, const char *id);
 	int err;
 
@@ -741,14 +801,14 @@ __std:
 		MATCH_VARIABLE(value, "${CardName}", rval_card_name, false);
 		MATCH_VARIABLE(value, "${CardLongName}", rval_card_longname, false);
 		MATCH_VARIABLE(value, "${CardComponents}", rval_card_components, true);
-		MATCH_VARIABLE2(value, "${env:", rval_env, false);
-		MATCH_VARIABLE2(value, "${sys:", rval_sysfs, false);
-		MATCH_VARIABLE2(value, "${var:", rval_var, true);
-		MATCH_VARIABLE2(value, "${eval:", rval_eval, false);
-		MATCH_VARIABLE2(value, "${find-card:", rval_card_lookup, false);
-		MATCH_VARIABLE2(value, "${find-device:", rval_device_lookup, false);
-		MATCH_VARIABLE2(value, "${CardNumberByName:", rval_card_number_by_name, false);
-		MATCH_VARIABLE2(value, "${CardIdByName:", rval_card_id_by_name, false);
+		MATCH_VARIABLE2(value, "${env:", rval_env, false, false);
+		MATCH_VARIABLE2(value, "${sys:", rval_sysfs, false, true);
+		MATCH_VARIABLE2(value, "${var:", rval_var, true, false);
+		MATCH_VARIABLE2(value, "${eval:", rval_eval, false, false);
+		MATCH_VARIABLE2(value, "${find-card:", rval_card_lookup, false, true);
+		MATCH_VARIABLE2(value, "${find-device:", rval_device_lookup, false, true);
+		MATCH_VARIABLE2(value, "${CardNumberByName:", rval_card_number_by_name, false, true);
+		MATCH_VARIABLE2(value, "${CardIdByName:", rval_card_id_by_name, false, true);
 __merr:
 		err = -EINVAL;
 		tmp = strchr(value, '}');
@@ -777,9 +837,13 @@ __match2:
 				if (tmp == NULL) {
 					uc_error("define '%s' is not reachable in this context!", v2 + 1);
 					rval = NULL;
+				} else if (cached) {
+					rval = subs_cache_call(uc_mgr, fcn2, tmp);
 				} else {
 					rval = fcn2(uc_mgr, tmp);
 				}
+			} else if (cached) {
+				rval = subs_cache_call(uc_mgr, fcn2, v2);
 			} else {
 __direct_fcn2:
 				rval = fcn2(uc_mgr, v2);
@@ -31,6 +31,7 @@
  */
 
 #include "ucm_local.h"
+#include "../control/control_local.h"
 
 void uc_mgr_error(const char *fmt,...)
 {
@@ -142,6 +143,142 @@ snd_ctl_t *uc_mgr_get_ctl(snd_use_case_mgr_t *uc_mgr)
 	return NULL;
 }
 
+/*
+ * The csets and control conditions name elements in the ascii id form.
+ * Each control device keeps the element info resolved for such a string
+ * (with the numid), so repeated sequences skip the id parsing and the
+ * info query.  The entries are dropped when the sequences add or remove
+ * elements, or when a write with the cached numid fails.
+ */
+#define CTL_ELEM_HASH	64
+
+struct ctl_elem_cache {
+	struct list_head list;
+	char *key;
+	unsigned int rest;		/* offset of the text after the id */
+	snd_ctl_elem_info_t info;
+};
+
+static unsigned int ctl_elem_hash(const char *key)
+{
+	unsigned int h = 0;
+
+	while (*key)
+		h = h * 31 + (unsigned char)*key++;
+	return h % CTL_ELEM_HASH;
+}
+
+static struct ctl_elem_cache *ctl_elem_find(struct ctl_list *ctl_list,
+					    const char *key)
+{
+	struct list_head *pos;
+	struct ctl_elem_cache *e;
+
+	if (ctl_list->elem_hash == NULL)
+		return NULL;
+	list_for_each(pos, &ctl_list->elem_hash[ctl_elem_hash(key)]) {
+		e = list_entry(pos, struct ctl_elem_cache, list);
+		if (strcmp(e->key, key) == 0)
+			return e;
+	}
+	return NULL;
+}
+
+static void ctl_elem_add(struct ctl_list *ctl_list, const char *key,
+			 unsigned int rest, const snd_ctl_elem_info_t *info)
+{
+	struct ctl_elem_cache *e;
+	unsigned int i;
+
+	if (ctl_list->elem_hash == NULL) {
+		ctl_list->elem_hash = malloc(CTL_ELEM_HASH * sizeof(struct list_head));
+		if (ctl_list->elem_hash == NULL)
+			return;
+		for (i = 0; i < CTL_ELEM_HASH; i++)
+			INIT_LIST_HEAD(&ctl_list->elem_hash[i]);
+	}
+	e = malloc(sizeof(*e));
+	if (e == NULL)
+		return;
+	e->key = strdup(key);
+	if (e->key == NULL) {
+		free(e);
+		return;
+	}
+	e->rest = rest;
+	e->info = *info;
+	list_add_tail(&e->list, &ctl_list->elem_hash[ctl_elem_hash(key)]);
+}
+
+static void ctl_elem_free(struct ctl_elem_cache *e)
+{
+	list_del(&e->list);
+	free(e->key);
+	free(e);
+}
+
+/**
+ * \brief Resolve the element named by an ascii id
+ * \param ctl_list Control device
+ * \param key The id, optionally followed by a value (cset)
+ * \param info Returned element info, the id includes the numid
+ * \param rest Returned text after the id, or NULL
+ * \return zero on success, otherwise a negative error code
+ */
+int uc_mgr_ctl_elem_lookup(struct ctl_list *ctl_list, const char *key,
+			   snd_ctl_elem_info_t *info, const char **rest)
+{
+	struct ctl_elem_cache *e;
+	snd_ctl_elem_id_t id;
+	const char *pos;
+	int err;
+
+	e = ctl_elem_find(ctl_list, key);
+	if (e) {
+		*info = e->info;
+		if (rest)
+			*rest = key + e->rest;
+		return 0;
+	}
+	memset(&id, 0, sizeof(id));
+	err = __snd_ctl_ascii_elem_id_parse(&id, key, &pos);
+	if (err < 0)
+		return err;
+	memset(info, 0, sizeof(*info));
+	snd_ctl_elem_info_set_id(info, &id);
+	err = snd_ctl_elem_info(ctl_list->ctl, info);
+	if (err < 0)
+		return err;
+	ctl_elem_add(ctl_list, key, pos - key, info);
+	if (rest)
+		*rest = pos;
+	return 0;
+}
+
+/* drop a stale entry, the next lookup resolves the id again */
+void uc_mgr_ctl_elem_forget(struct ctl_list *ctl_list, const char *key)
+{
+	struct ctl_elem_cache *e = ctl_elem_find(ctl_list, key);
+
+	if (e)
+		ctl_elem_free(e);
+}
+
+void uc_mgr_ctl_elem_flush(struct ctl_list *ctl_list)
+{
+	struct list_head *pos, *npos;
+	unsigned int i;
+
+	if (ctl_list->elem_hash == NULL)
+		return;
+	for (i = 0; i < CTL_ELEM_HASH; i++) {
+		list_for_each_safe(pos, npos, &ctl_list->elem_hash[i])
+			ctl_elem_free(list_entry(pos, struct ctl_elem_cache, list));
+	}
+	free(ctl_list->elem_hash);
+	ctl_list->elem_hash = NULL;
+}
+
 static void uc_mgr_free_ctl(struct ctl_list *ctl_list)
 {
 	struct list_head *pos, *npos;
@@ -152,6 +289,7 @@ static void uc_mgr_free_ctl(struct ctl_list *ctl_list)
 		free(ctl_dev->device);
 		free(ctl_dev);
 	}
+	uc_mgr_ctl_elem_flush(ctl_list);
 	snd_ctl_card_info_free(ctl_list->ctl_info);
 	free(ctl_list);
 }
@@ -214,6 +352,7 @@ static int uc_mgr_ctl_add(snd_use_case_mgr_t *uc_mgr,
 			return -ENOMEM;
 		INIT_LIST_HEAD(&cl->dev_list);
 		cl->ctl = ctl;
+		cl->elem_hash = NULL;
 		if (snd_ctl_card_info_malloc(&cl->ctl_info) < 0) {
 			free(cl);
 			return -ENOMEM;
@@ -404,6 +543,7 @@ static void uc_mgr_free_value1(struct ucm_value *val)
 {
 	free(val->name);
 	free(val->data);
+	free(val->cache);
 	list_del(&val->list);
 	free(val);
 }
@@ -514,6 +654,7 @@ void uc_mgr_free_sequence_element(struct sequence_element *seq)
 		free(seq->data.sysw);
 		break;
 	case SEQUENCE_ELEMENT_TYPE_EXEC:
+	case SEQUENCE_ELEMENT_TYPE_EXEC_BG:
 	case SEQUENCE_ELEMENT_TYPE_SHELL:
 		free(seq->data.exec);
 		break;
@@ -691,6 +832,7 @@ int uc_mgr_set_variable(snd_use_case_mgr_t *uc_mgr, const char *name,
 				return -ENOMEM;
 			free(curr->data);
 			curr->data = val2;
+			uc_mgr->value_gen++;
 			return 0;
 		}
 	}
@@ -710,6 +852,7 @@ int uc_mgr_set_variable(snd_use_case_mgr_t *uc_mgr, const char *name,
 		return -ENOMEM;
 	}
 	list_add_tail(&curr->list, &uc_mgr->variable_list);
+	uc_mgr->value_gen++;
 	return 0;
 }
 
@@ -722,6 +865,7 @@ int uc_mgr_delete_variable(snd_use_case_mgr_t *uc_mgr, const char *name)
 		curr = list_entry(pos, struct ucm_value, list);
 		if (strcmp(curr->name, name) == 0) {
 			uc_mgr_free_value1(curr);
+			uc_mgr->value_gen++;
 			return 0;
 		}
 	}
@@ -734,6 +878,7 @@ void uc_mgr_free_verb(snd_use_case_mgr_t *uc_mgr)
 	struct list_head *pos, *npos;
 	struct use_case_verb *verb;
 
+	uc_mgr_index_invalidate(uc_mgr);
 	if (uc_mgr->local_config) {
 		snd_config_delete(uc_mgr->local_config);
 		uc_mgr->local_config = NULL;
@@ -746,6 +891,8 @@ void uc_mgr_free_verb(snd_use_case_mgr_t *uc_mgr)
 		verb = list_entry(pos, struct use_case_verb, list);
 		free(verb->name);
 		free(verb->comment);
+		free(verb->file);
+		free(verb->variant);
 		uc_mgr_free_sequence(&verb->enable_list);
 		uc_mgr_free_sequence(&verb->disable_list);
 		uc_mgr_free_transition(&verb->transition_list);
@@ -778,6 +925,9 @@ void uc_mgr_free(snd_use_case_mgr_t *uc_mgr)
 {
 	uc_mgr_free_verb(uc_mgr);
 	uc_mgr_free_ctl_list(uc_mgr);
+	uc_mgr_regex_cache_free(uc_mgr);
+	uc_mgr_subs_cache_free(uc_mgr);
+	uc_mgr_state_free(uc_mgr);
 	free(uc_mgr->card_name);
 	free(uc_mgr);
 }
@@ -0,0 +1,209 @@
+/*
+ *  PCM channel area copy and silence benchmark
+ *
+ *  Measures snd_pcm_areas_copy() and snd_pcm_areas_silence() for the
+ *  layouts the plugins and the mmap emulation use:
+ *    i2n  interleaved -> non-interleaved
+ *    n2i  non-interleaved -> interleaved
+ *    sub  two channels of an interleaved buffer -> interleaved stereo
+ *    sil  silence the upper half of the channels of an interleaved buffer
+ *  Each layout, format and channel count is timed per frame and in
+ *  copied bytes per second.
+ *
+ *  Example:
+ *    areas-bench -c 2,6,8 -f 1024 -t 1
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "../include/asoundlib.h"
+#include "bench.h"
+
+#define MAX_CHANNELS	32
+
+enum layout { I2N, N2I, SUB, SIL, LAYOUTS };
+
+static const char *const layout_names[LAYOUTS] = { "i2n", "n2i", "sub", "sil" };
+
+static unsigned int channel_counts[BENCH_MAX_LIST] = { 2, 6, 8 };
+static unsigned int num_channel_counts = 3;
+static const snd_pcm_format_t formats[] = {
+	SND_PCM_FORMAT_S16, SND_PCM_FORMAT_S24_3LE, SND_PCM_FORMAT_S32
+};
+static unsigned int frames = 1024;
+static double seconds = 1;
+
+static void set_interleaved(snd_pcm_channel_area_t *areas, void *buf,
+			    unsigned int channels, unsigned int width)
+{
+	unsigned int c;
+
+	for (c = 0; c < channels; c++) {
+		areas[c].addr = buf;
+		areas[c].first = c * width;
+		areas[c].step = channels * width;
+	}
+}
+
+static void set_planar(snd_pcm_channel_area_t *areas, void *buf,
+		       unsigned int channels, unsigned int width)
+{
+	unsigned int c;
+
+	for (c = 0; c < channels; c++) {
+		areas[c].addr = buf;
+		areas[c].first = c * frames * width;
+		areas[c].step = width;
+	}
+}
+
+/* returns the time per frame in ns, or a negative error code */
+static double run(enum layout layout, snd_pcm_format_t format,
+		  unsigned int channels, double *bytes_per_s)
+{
+	snd_pcm_channel_area_t src[MAX_CHANNELS], dst[MAX_CHANNELS];
+	unsigned int width = snd_pcm_format_physical_width(format);
+	unsigned int copied = channels;
+	size_t size = (size_t)frames * channels * width / 8;
+	unsigned long loops = 0;
+	double t0, t1, end;
+	char *sbuf, *dbuf;
+	int err = 0;
+
+	sbuf = malloc(size);
+	dbuf = malloc(size);
+	if (!sbuf || !dbuf) {
+		free(sbuf);
+		free(dbuf);
+		return -1;
+	}
+	memset(sbuf, 0x5a, size);
+	memset(dbuf, 0, size);
+	switch (layout) {
+	case I2N:
+		set_interleaved(src, sbuf, channels, width);
+		set_planar(dst, dbuf, channels, width);
+		break;
+	case N2I:
+		set_planar(src, sbuf, channels, width);
+		set_interleaved(dst, dbuf, channels, width);
+		break;
+	case SUB:
+		set_interleaved(src, sbuf, channels, width);
+		set_interleaved(dst, dbuf, 2, width);
+		copied = 2;
+		break;
+	case SIL:
+		set_interleaved(dst, dbuf, channels, width);
+		copied = channels - channels / 2;
+		break;
+	default:
+		break;
+	}
+
+	t0 = bench_now_us();
+	end = t0 + seconds * 1e6;
+	do {
+		unsigned int k;
+		for (k = 0; k < 16 && err >= 0; k++) {
+			if (layout == SIL)
+				err = snd_pcm_areas_silence(dst + channels / 2, 0,
+							    copied, frames, format);
+			else
+				err = snd_pcm_areas_copy(dst, 0, src, 0, copied,
+							 frames, format);
+		}
+		loops += 16;
+	} while (err >= 0 && (t1 = bench_now_us()) < end);
+	free(sbuf);
+	free(dbuf);
+	if (err < 0)
+		return err;
+	*bytes_per_s = (double)loops * frames * copied * width / 8 /
+		       ((t1 - t0) / 1e6);
+	return (t1 - t0) * 1e3 / ((double)loops * frames);
+}
+
+static void print_result(enum layout layout, snd_pcm_format_t format,
+			 unsigned int channels, double ns, double bps)
+{
+	bench_record_begin();
+	bench_field_str("layout", layout_names[layout]);
+	bench_field_str("format", snd_pcm_format_name(format));
+	bench_field_uint("channels", channels);
+	bench_field_uint("frames", frames);
+	bench_field_double("ns_per_frame", 2, ns);
+	bench_field_double("mbytes_per_s", 0, bps / 1e6);
+	bench_record_end();
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct bench_option options[] = {
+		{"channels", 1, 'c', "comma separated channel counts (default 2,6,8)"},
+		{"frames", 1, 'f', "frames per call (default 1024)"},
+		{"time", 1, 't', "seconds per run (default 1)"},
+		{NULL},
+	};
+	unsigned int c, f, l;
+	int opt, ret = 0;
+
+	while ((opt = bench_getopt(argc, argv, "areas-bench", options)) != -1) {
+		switch (opt) {
+		case 'c':
+			num_channel_counts = bench_parse_list(optarg, channel_counts);
+			break;
+		case 'f':
+			frames = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			seconds = atof(optarg);
+			break;
+		}
+	}
+	if (!frames || seconds <= 0) {
+		fprintf(stderr, "invalid parameters\n");
+		return 1;
+	}
+	for (c = 0; c < num_channel_counts; c++) {
+		if (channel_counts[c] < 2 || channel_counts[c] > MAX_CHANNELS) {
+			fprintf(stderr, "invalid channel count %u\n", channel_counts[c]);
+			return 1;
+		}
+	}
+
+	for (l = 0; l < LAYOUTS; l++) {
+		for (f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+			for (c = 0; c < num_channel_counts; c++) {
+				double bps = 0, ns;
+				if (l == SUB && channel_counts[c] <= 2)
+					continue;
+				ns = run(l, formats[f], channel_counts[c], &bps);
+				if (ns < 0) {
+					fprintf(stderr, "%s failed\n", layout_names[l]);
+					ret = 1;
+					continue;
+				}
+				print_result(l, formats[f], channel_counts[c], ns, bps);
+			}
+		}
+	}
+	return ret;
+}
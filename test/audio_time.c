@@ -33,6 +33,7 @@ static void usage(char *command)
 		"-p, --playback          playback tstamps \n"
 		"-t, --ts_type=TYPE      Compat(0),default(1),link(2),link_absolute(3),link_estimated(4),link_synchronized(5) \n"
 		"-r, --report            show audio timestamp and accuracy validity\n"
+		"-R, --ring              capture tstamps from the per-period ring\n"
 		, command);
 }
 
@@ -126,7 +127,7 @@ int main(int argc, char *argv[])
 	snd_pcm_audio_tstamp_report_t audio_tstamp_report_c;
 
 	int option_index;
-	static const char short_options[] = "hcpdrD:t:";
+	static const char short_options[] = "hcpdrRD:t:";
 
 	static const struct option long_options[] = {
 		{"capture", 0, 0, 'c'},
@@ -136,6 +137,7 @@ int main(int argc, char *argv[])
 		{"playback", 0, 0, 'p'},
 		{"ts_type", required_argument, 0, 't'},
 		{"report", 0, 0, 'r'},
+		{"ring", 0, 0, 'R'},
 		{0, 0, 0, 0}
 	};
 
@@ -144,6 +146,7 @@ int main(int argc, char *argv[])
 	int do_capture = 0;
 	int type = 0;
 	int do_report = 0;
+	int do_ring = 0;
 
 	while ((c = getopt_long(argc, argv, short_options, long_options, &option_index)) != -1) {
 		switch (c) {
@@ -167,6 +170,10 @@ int main(int argc, char *argv[])
 			break;
 		case 'r':
 			do_report = 1;
+			break;
+		case 'R':
+			do_ring = 1;
+			break;
 		}
 	}
 
@@ -308,6 +315,16 @@ int main(int argc, char *argv[])
 			printf("Unable to set swparams_c : %s\n", snd_strerror(err));
 			goto _exit;
 		}
+
+		if (do_ring) {
+			audio_tstamp_config_c.type_requested = type;
+			audio_tstamp_config_c.report_delay = do_delay;
+			err = snd_pcm_tstamp_ring_enable(handle_c, 64, &audio_tstamp_config_c);
+			if (err < 0) {
+				printf("Unable to enable tstamp ring : %s\n", snd_strerror(err));
+				goto _exit;
+			}
+		}
 	}
 
 	if (do_playback && do_capture) {
@@ -362,37 +379,48 @@ int main(int argc, char *argv[])
 			}
 			frame_count_c += frames;
 
+			if (do_ring) {
+				snd_pcm_tstamp_entry_t entries[64];
+				int n = snd_pcm_tstamp_ring_read(handle_c, entries, 64);
+
+				for (c = 0; c < n; c++)
+					printf("\t capture ring: hw_ptr %lu, systime %lli nsec, audio time %lli nsec\n",
+					       (unsigned long)entries[c].hw_ptr,
+					       timestamp2ns(entries[c].tstamp),
+					       timestamp2ns(entries[c].audio_tstamp));
+			} else {
 #if defined(TRACK_CAPTURE)
-			audio_tstamp_config_c.type_requested = type;
-			audio_tstamp_config_c.report_delay = do_delay;
-			_gettimestamp(handle_c, &tstamp_c, &trigger_tstamp_c,
-				&audio_tstamp_c, &audio_tstamp_config_c, &audio_tstamp_report_c,
-				&avail_c, &delay_c);
+				audio_tstamp_config_c.type_requested = type;
+				audio_tstamp_config_c.report_delay = do_delay;
+				_gettimestamp(handle_c, &tstamp_c, &trigger_tstamp_c,
+					&audio_tstamp_c, &audio_tstamp_config_c, &audio_tstamp_report_c,
+					&avail_c, &delay_c);
 #if defined(TRACK_SAMPLE_COUNTS)
-			curr_count_c = frame_count_c + delay_c; /* read plus queued */
+				curr_count_c = frame_count_c + delay_c; /* read plus queued */
 
 
-			printf("capture: curr_count %lli driver count %lli, delta %lli\n",
-				(long long)curr_count_c * 1000000000LL / SAMPLE_FREQ ,
-				timestamp2ns(audio_tstamp_c),
-				(long long)curr_count_c * 1000000000LL / SAMPLE_FREQ - timestamp2ns(audio_tstamp_c)
-				);
+				printf("capture: curr_count %lli driver count %lli, delta %lli\n",
+					(long long)curr_count_c * 1000000000LL / SAMPLE_FREQ ,
+					timestamp2ns(audio_tstamp_c),
+					(long long)curr_count_c * 1000000000LL / SAMPLE_FREQ - timestamp2ns(audio_tstamp_c)
+					);
 #endif
-			if (do_report) {
-				if (audio_tstamp_report_c.valid == 0)
-					printf("Audio capture timestamp report invalid - ");
-				if (audio_tstamp_report_c.accuracy_report == 0)
-					printf("Audio capture timestamp accuracy report invalid");
-				printf("\n");
-			}
-
-
-			printf("\t capture: systime: %lli nsec, audio time %lli nsec, \tsystime delta %lli \t resolution %d ns \n", 
-				timediff(tstamp_c, trigger_tstamp_c),
-				timestamp2ns(audio_tstamp_c),
-				timediff(tstamp_c, trigger_tstamp_c) - timestamp2ns(audio_tstamp_c), audio_tstamp_report_c.accuracy
-				);
+				if (do_report) {
+					if (audio_tstamp_report_c.valid == 0)
+						printf("Audio capture timestamp report invalid - ");
+					if (audio_tstamp_report_c.accuracy_report == 0)
+						printf("Audio capture timestamp accuracy report invalid");
+					printf("\n");
+				}
+
+
+				printf("\t capture: systime: %lli nsec, audio time %lli nsec, \tsystime delta %lli \t resolution %d ns \n", 
+					timediff(tstamp_c, trigger_tstamp_c),
+					timestamp2ns(audio_tstamp_c),
+					timediff(tstamp_c, trigger_tstamp_c) - timestamp2ns(audio_tstamp_c), audio_tstamp_report_c.accuracy
+					);
 #endif
+			}
 		}
 
 		if (do_playback) {
@@ -0,0 +1,223 @@
+/*
+ *  Common helpers of the benchmark programs (*-bench)
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <getopt.h>
+#include <sys/resource.h>
+#include "../include/asoundlib.h"
+#include "bench.h"
+
+#define MAX_OPTIONS	32
+
+int bench_json;
+
+static char header[1024];		/* CSV header of the first record */
+static int header_done;
+static char line[1024];			/* the current record */
+static int fields;
+
+static void usage(const char *prog, const struct bench_option *options)
+{
+	unsigned int i;
+
+	printf("Usage: %s [OPTION]...\n", prog);
+	printf("-h,--help      help\n");
+	for (i = 0; options[i].name; i++)
+		printf("-%c,--%-9s %s\n", options[i].val, options[i].name,
+		       options[i].help);
+	printf("-j,--json      print JSON lines instead of CSV\n");
+}
+
+int bench_getopt(int argc, char *argv[], const char *prog,
+		 const struct bench_option *options)
+{
+	static struct option long_option[MAX_OPTIONS + 3];
+	static char short_option[3 * MAX_OPTIONS + 3];
+	int opt;
+
+	if (!long_option[0].name) {
+		unsigned int i, n = 0, k = 0;
+
+		long_option[n++] = (struct option){ "help", 0, NULL, 'h' };
+		long_option[n++] = (struct option){ "json", 0, NULL, 'j' };
+		short_option[k++] = 'h';
+		short_option[k++] = 'j';
+		for (i = 0; options[i].name && i < MAX_OPTIONS; i++) {
+			long_option[n++] = (struct option){
+				options[i].name, options[i].has_arg,
+				NULL, options[i].val
+			};
+			short_option[k++] = options[i].val;
+			if (options[i].has_arg)
+				short_option[k++] = ':';
+		}
+	}
+	opt = getopt_long(argc, argv, short_option, long_option, NULL);
+	switch (opt) {
+	case 'h':
+		usage(prog, options);
+		exit(EXIT_SUCCESS);
+	case 'j':
+		bench_json = 1;
+		return bench_getopt(argc, argv, prog, options);
+	case '?':
+	case ':':
+		usage(prog, options);
+		exit(EXIT_FAILURE);
+	}
+	return opt;
+}
+
+unsigned int bench_parse_list(const char *arg, unsigned int *list)
+{
+	char *tmp = strdup(arg), *tok, *save;
+	unsigned int n = 0;
+
+	for (tok = strtok_r(tmp, ",", &save); tok && n < BENCH_MAX_LIST;
+	     tok = strtok_r(NULL, ",", &save))
+		list[n++] = strtoul(tok, NULL, 0);
+	free(tmp);
+	return n;
+}
+
+double bench_clock_us(clockid_t clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+double bench_now_us(void)
+{
+	return bench_clock_us(CLOCK_MONOTONIC);
+}
+
+double bench_cpu_us(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1e6 +
+	       ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+void bench_sort(double *v, unsigned long n)
+{
+	qsort(v, n, sizeof(*v), cmp_double);
+}
+
+/* v sorted ascending */
+double bench_percentile(const double *v, unsigned long n, double pct)
+{
+	unsigned long i;
+
+	if (!n)
+		return 0;
+	i = (unsigned long)(pct / 100.0 * (n - 1) + 0.5);
+	return v[i];
+}
+
+void bench_record_begin(void)
+{
+	line[0] = '\0';
+	fields = 0;
+}
+
+static void append(char *buf, size_t size, const char *fmt, ...)
+{
+	size_t len = strlen(buf);
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(buf + len, size - len, fmt, ap);
+	va_end(ap);
+}
+
+/* the separator and, for JSON, the key of the next field */
+static void field(const char *name)
+{
+	if (!header_done)
+		append(header, sizeof(header), "%s%s", fields ? "," : "", name);
+	if (bench_json)
+		append(line, sizeof(line), "%s\"%s\":", fields ? "," : "", name);
+	else if (fields)
+		append(line, sizeof(line), ",");
+	fields++;
+}
+
+void bench_field_str(const char *name, const char *value)
+{
+	field(name);
+	append(line, sizeof(line), bench_json ? "\"%s\"" : "%s", value);
+}
+
+void bench_field_bool(const char *name, int value)
+{
+	field(name);
+	if (bench_json)
+		append(line, sizeof(line), "%s", value ? "true" : "false");
+	else
+		append(line, sizeof(line), "%s", value ? "yes" : "no");
+}
+
+void bench_field_uint(const char *name, unsigned long value)
+{
+	field(name);
+	append(line, sizeof(line), "%lu", value);
+}
+
+void bench_field_int(const char *name, long value)
+{
+	field(name);
+	append(line, sizeof(line), "%ld", value);
+}
+
+void bench_field_double(const char *name, int precision, double value)
+{
+	field(name);
+	append(line, sizeof(line), "%.*f", precision, value);
+}
+
+void bench_field_status(int err)
+{
+	bench_field_str("status", err < 0 ? snd_strerror(err) : "ok");
+}
+
+void bench_record_end(void)
+{
+	if (!header_done && !bench_json)
+		printf("%s\n", header);
+	header_done = 1;
+	if (bench_json)
+		printf("{%s}\n", line);
+	else
+		printf("%s\n", line);
+	fflush(stdout);
+}
@@ -0,0 +1,65 @@
+/*
+ *  Common helpers of the benchmark programs (*-bench)
+ *
+ *  Every benchmark prints one record per measured case, as CSV with a
+ *  header line or, with -j, as JSON lines.  A record is built field by
+ *  field between bench_record_begin() and bench_record_end(); the CSV
+ *  header is taken from the field names of the first record.
+ *
+ *  The options are described by a table of struct bench_option;
+ *  bench_getopt() adds -h,--help and -j,--json, prints the usage and
+ *  exits on those and on unknown options, and returns the others like
+ *  getopt_long().
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __BENCH_H
+#define __BENCH_H
+
+#include <time.h>
+
+#define BENCH_MAX_LIST	32
+
+struct bench_option {
+	const char *name;		/* long option */
+	int has_arg;
+	int val;			/* short option */
+	const char *help;
+};
+
+extern int bench_json;
+
+int bench_getopt(int argc, char *argv[], const char *prog,
+		 const struct bench_option *options);
+unsigned int bench_parse_list(const char *arg, unsigned int *list);
+
+double bench_clock_us(clockid_t clock);
+double bench_now_us(void);
+double bench_cpu_us(void);
+void bench_sort(double *v, unsigned long n);
+double bench_percentile(const double *v, unsigned long n, double pct);
+
+void bench_record_begin(void);
+void bench_field_str(const char *name, const char *value);
+void bench_field_bool(const char *name, int value);
+void bench_field_uint(const char *name, unsigned long value);
+void bench_field_int(const char *name, long value);
+void bench_field_double(const char *name, int precision, double value);
+void bench_field_status(int err);
+void bench_record_end(void);
+
+#endif
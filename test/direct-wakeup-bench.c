@@ -0,0 +1,324 @@
+/*
+ *  Direct plugin wakeup benchmark
+ *
+ *  Opens a dmix (playback) or dsnoop (capture) instance on top of the
+ *  given slave device once for every wakeup source given on the command
+ *  line ("timer" is the slave PCM timer, "timerfd" the hrtimer based
+ *  source) and keeps the stream running for a number of seconds, waking
+ *  up with snd_pcm_wait() once per period.  A run reports the wakeup
+ *  interval jitter percentiles, the count of spurious wakeups (avail
+ *  below avail_min), the xrun count and the CPU time per wakeup.
+ *
+ *  Example:
+ *    direct-wakeup-bench -D hw:0,0 -w timer,timerfd -p 64,256 -t 10 -j
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <unistd.h>
+#include "../include/asoundlib.h"
+#include "bench.h"
+
+#define CHANNELS	2
+
+struct result {
+	unsigned long wakeups;
+	unsigned long spurious;
+	unsigned long xruns;
+	double jitter[4];	/* |interval - period| p50, p95, p99, max (us) */
+	double cpu;		/* CPU time per wakeup (us) */
+};
+
+static const char *slave = "hw:0,0";
+static const char *wakeups[BENCH_MAX_LIST] = { "timer", "timerfd" };
+static unsigned int num_wakeups = 2;
+static unsigned int period_sizes[BENCH_MAX_LIST] = { 256 };
+static unsigned int num_period_sizes = 1;
+static unsigned int periods = 4;
+static unsigned int rate = 48000;
+static unsigned int seconds = 5;
+static int capture;
+
+/* global configuration plus a private direct plugin definition */
+static int open_direct(snd_pcm_t **pcm, const char *wakeup,
+		       unsigned int period_size, snd_config_t **top)
+{
+	snd_input_t *in;
+	char conf[1024];
+	int err;
+
+	snprintf(conf, sizeof(conf),
+		 "pcm.wakeup_bench {\n"
+		 "	type %s\n"
+		 "	ipc_key %d\n"
+		 "	tstamp_type monotonic\n"
+		 "	wakeup %s\n"
+		 "	slave {\n"
+		 "		pcm \"%s\"\n"
+		 "		rate %u\n"
+		 "		channels %u\n"
+		 "		period_size %u\n"
+		 "		buffer_size %u\n"
+		 "	}\n"
+		 "}\n",
+		 capture ? "dsnoop" : "dmix", (int)(0x57a4e000 + getpid()),
+		 wakeup, slave, rate, CHANNELS, period_size,
+		 period_size * periods);
+	err = snd_config_update();
+	if (err < 0)
+		return err;
+	err = snd_config_copy(top, snd_config);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&in, conf, -1);
+	if (err < 0)
+		return err;
+	err = snd_config_load(*top, in);
+	snd_input_close(in);
+	if (err < 0)
+		return err;
+	return snd_pcm_open_lconf(pcm, "wakeup_bench",
+				  capture ? SND_PCM_STREAM_CAPTURE : SND_PCM_STREAM_PLAYBACK,
+				  0, *top);
+}
+
+static int setup(snd_pcm_t *pcm, unsigned int period_size)
+{
+	snd_pcm_hw_params_t *hw;
+	snd_pcm_sw_params_t *sw;
+	snd_pcm_uframes_t size = period_size;
+	int err;
+
+	snd_pcm_hw_params_alloca(&hw);
+	snd_pcm_sw_params_alloca(&sw);
+	err = snd_pcm_hw_params_any(pcm, hw);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_access(pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_format(pcm, hw, SND_PCM_FORMAT_S16);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_channels(pcm, hw, CHANNELS);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_rate(pcm, hw, rate, 0);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_period_size_near(pcm, hw, &size, NULL);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params(pcm, hw);
+	if (err < 0)
+		return err;
+	err = snd_pcm_sw_params_current(pcm, sw);
+	if (err < 0)
+		return err;
+	err = snd_pcm_sw_params_set_avail_min(pcm, sw, size);
+	if (err < 0)
+		return err;
+	err = snd_pcm_sw_params_set_start_threshold(pcm, sw, size);
+	if (err < 0)
+		return err;
+	return snd_pcm_sw_params(pcm, sw);
+}
+
+static int run(const char *wakeup, unsigned int period_size, struct result *res)
+{
+	snd_config_t *top = NULL;
+	snd_pcm_t *pcm = NULL;
+	snd_pcm_sframes_t avail, n;
+	unsigned long max_wakeups;
+	double *jitter = NULL;
+	double period_us, start, end, last, t, cpu;
+	short *buf = NULL;
+	int err;
+
+	memset(res, 0, sizeof(*res));
+	err = open_direct(&pcm, wakeup, period_size, &top);
+	if (err < 0)
+		goto out;
+	err = setup(pcm, period_size);
+	if (err < 0)
+		goto out;
+	buf = calloc(period_size * periods, CHANNELS * sizeof(short));
+	max_wakeups = (unsigned long)seconds * rate / period_size * 2 + 16;
+	jitter = malloc(max_wakeups * sizeof(*jitter));
+	if (!buf || !jitter) {
+		err = -ENOMEM;
+		goto out;
+	}
+	period_us = period_size * 1e6 / rate;
+
+	if (capture)
+		err = snd_pcm_start(pcm);
+	else
+		err = snd_pcm_writei(pcm, buf, period_size * periods) < 0 ? -EIO : 0;
+	if (err < 0)
+		goto out;
+
+	cpu = bench_cpu_us();
+	start = last = bench_now_us();
+	end = start + seconds * 1e6;
+	while ((t = bench_now_us()) < end && res->wakeups < max_wakeups) {
+		err = snd_pcm_wait(pcm, 1000);
+		t = bench_now_us();
+		avail = snd_pcm_avail_update(pcm);
+		if (err < 0 || avail < 0) {
+			res->xruns++;
+			err = snd_pcm_recover(pcm, err < 0 ? err : (int)avail, 1);
+			if (err < 0)
+				goto out;
+			if (capture)
+				snd_pcm_start(pcm);
+			last = bench_now_us();
+			continue;
+		}
+		if ((snd_pcm_uframes_t)avail < period_size) {
+			res->spurious++;
+			continue;
+		}
+		jitter[res->wakeups++] = t - last > period_us ?
+			t - last - period_us : period_us - (t - last);
+		last = t;
+		avail -= avail % period_size;
+		if (capture)
+			n = snd_pcm_readi(pcm, buf, avail);
+		else
+			n = snd_pcm_writei(pcm, buf, avail);
+		if (n < 0) {
+			res->xruns++;
+			if (snd_pcm_recover(pcm, n, 1) < 0)
+				goto out;
+			if (capture)
+				snd_pcm_start(pcm);
+		}
+	}
+	cpu = bench_cpu_us() - cpu;
+	err = 0;
+
+	/* the first interval includes the stream start */
+	if (res->wakeups > 1) {
+		bench_sort(jitter + 1, res->wakeups - 1);
+		res->jitter[0] = bench_percentile(jitter + 1, res->wakeups - 1, 50);
+		res->jitter[1] = bench_percentile(jitter + 1, res->wakeups - 1, 95);
+		res->jitter[2] = bench_percentile(jitter + 1, res->wakeups - 1, 99);
+		res->jitter[3] = jitter[res->wakeups - 1];
+	}
+	if (res->wakeups + res->spurious)
+		res->cpu = cpu / (res->wakeups + res->spurious);
+
+ out:
+	if (pcm)
+		snd_pcm_close(pcm);
+	if (top)
+		snd_config_delete(top);
+	free(buf);
+	free(jitter);
+	return err;
+}
+
+static void print_result(const char *wakeup, unsigned int period_size,
+			 int err, const struct result *res)
+{
+	bench_record_begin();
+	bench_field_str("stream", capture ? "capture" : "playback");
+	bench_field_str("wakeup", wakeup);
+	bench_field_uint("period", period_size);
+	bench_field_status(err);
+	bench_field_uint("wakeups", res->wakeups);
+	bench_field_uint("spurious", res->spurious);
+	bench_field_uint("xruns", res->xruns);
+	bench_field_double("jitter_p50_us", 1, res->jitter[0]);
+	bench_field_double("jitter_p95_us", 1, res->jitter[1]);
+	bench_field_double("jitter_p99_us", 1, res->jitter[2]);
+	bench_field_double("jitter_max_us", 1, res->jitter[3]);
+	bench_field_double("cpu_us", 2, res->cpu);
+	bench_record_end();
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct bench_option options[] = {
+		{"device", 1, 'D', "slave device (default hw:0,0)"},
+		{"wakeup", 1, 'w', "comma separated wakeup sources: timer,timerfd (default both)"},
+		{"period", 1, 'p', "comma separated period sizes in frames (default 256)"},
+		{"periods", 1, 'n', "periods per buffer (default 4)"},
+		{"rate", 1, 'r', "rate (default 48000)"},
+		{"time", 1, 't', "seconds per run (default 5)"},
+		{"capture", 0, 'C', "use dsnoop instead of dmix"},
+		{NULL},
+	};
+	unsigned int w, p;
+	int c, ret = 0;
+
+	while ((c = bench_getopt(argc, argv, "direct-wakeup-bench", options)) != -1) {
+		switch (c) {
+		case 'D':
+			slave = optarg;
+			break;
+		case 'w': {
+			char *tmp = strdup(optarg), *tok, *save;
+			num_wakeups = 0;
+			for (tok = strtok_r(tmp, ",", &save); tok && num_wakeups < BENCH_MAX_LIST;
+			     tok = strtok_r(NULL, ",", &save)) {
+				if (strcmp(tok, "timer") && strcmp(tok, "timerfd")) {
+					fprintf(stderr, "unknown wakeup source %s\n", tok);
+					return 1;
+				}
+				wakeups[num_wakeups++] = strcmp(tok, "timer") ? "timerfd" : "timer";
+			}
+			free(tmp);
+			break;
+		}
+		case 'p':
+			num_period_sizes = bench_parse_list(optarg, period_sizes);
+			break;
+		case 'n':
+			periods = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			rate = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		case 'C':
+			capture = 1;
+			break;
+		}
+	}
+	if (periods < 2 || !rate || !seconds) {
+		fprintf(stderr, "invalid parameters\n");
+		return 1;
+	}
+
+	for (w = 0; w < num_wakeups; w++)
+		for (p = 0; p < num_period_sizes; p++) {
+			struct result res;
+			int err = run(wakeups[w], period_sizes[p], &res);
+			print_result(wakeups[w], period_sizes[p], err, &res);
+			if (err < 0)
+				ret = 1;
+		}
+	return ret;
+}
@@ -0,0 +1,355 @@
+/*
+ * dmix mixing kernel microbenchmark
+ *
+ * Compares the generic scalar dmix routines with the SIMD (AVX2/NEON)
+ * ones from src/pcm/pcm_dmix_simd.h and, on x86-64, with the inline
+ * assembler routines.  The SIMD results are verified against the scalar
+ * reference before timing.
+ *
+ * usage: dmix-bench [frames [clients [channels [loops]]]]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * reference code, copied from src/pcm/pcm_dmix_generic.c
+ */
+static void generic_mix_areas_16_native(unsigned int size,
+					volatile signed short *dst,
+					signed short *src,
+					volatile signed int *sum,
+					size_t dst_step,
+					size_t src_step,
+					size_t sum_step)
+{
+	register signed int sample;
+
+	for (;;) {
+		sample = *src;
+		if (! *dst) {
+			*sum = sample;
+			*dst = *src;
+		} else {
+			sample += *sum;
+			*sum = sample;
+			if (sample > 0x7fff)
+				sample = 0x7fff;
+			else if (sample < -0x8000)
+				sample = -0x8000;
+			*dst = sample;
+		}
+		if (!--size)
+			return;
+		src = (signed short *) ((char *)src + src_step);
+		dst = (signed short *) ((char *)dst + dst_step);
+		sum = (signed int *)   ((char *)sum + sum_step);
+	}
+}
+
+static void generic_remix_areas_16_native(unsigned int size,
+					  volatile signed short *dst,
+					  signed short *src,
+					  volatile signed int *sum,
+					  size_t dst_step,
+					  size_t src_step,
+					  size_t sum_step)
+{
+	register signed int sample;
+
+	for (;;) {
+		sample = *src;
+		if (! *dst) {
+			*sum = -sample;
+			*dst = -sample;
+		} else {
+			*sum = sample = *sum - sample;
+			if (sample > 0x7fff)
+				sample = 0x7fff;
+			else if (sample < -0x8000)
+				sample = -0x8000;
+			*dst = sample;
+		}
+		if (!--size)
+			return;
+		src = (signed short *) ((char *)src + src_step);
+		dst = (signed short *) ((char *)dst + dst_step);
+		sum = (signed int *)   ((char *)sum + sum_step);
+	}
+}
+
+static void generic_mix_areas_32_native(unsigned int size,
+					volatile signed int *dst,
+					signed int *src,
+					volatile signed int *sum,
+					size_t dst_step,
+					size_t src_step,
+					size_t sum_step)
+{
+	register signed int sample;
+
+	for (;;) {
+		sample = *src >> 8;
+		if (! *dst) {
+			*sum = sample;
+			*dst = *src;
+		} else {
+			sample += *sum;
+			*sum = sample;
+			if (sample > 0x7fffff)
+				sample = 0x7fffffff;
+			else if (sample < -0x800000)
+				sample = -0x80000000;
+			else
+				sample *= 256;
+			*dst = sample;
+		}
+		if (!--size)
+			return;
+		src = (signed int *) ((char *)src + src_step);
+		dst = (signed int *) ((char *)dst + dst_step);
+		sum = (signed int *) ((char *)sum + sum_step);
+	}
+}
+
+static void generic_remix_areas_32_native(unsigned int size,
+					  volatile signed int *dst,
+					  signed int *src,
+					  volatile signed int *sum,
+					  size_t dst_step,
+					  size_t src_step,
+					  size_t sum_step)
+{
+	register signed int sample;
+
+	for (;;) {
+		sample = *src >> 8;
+		if (! *dst) {
+			*sum = -sample;
+			*dst = -*src;
+		} else {
+			*sum = sample = *sum - sample;
+			if (sample > 0x7fffff)
+				sample = 0x7fffffff;
+			else if (sample < -0x800000)
+				sample = -0x80000000;
+			else
+				sample *= 256;
+			*dst = sample;
+		}
+		if (!--size)
+			return;
+		src = (signed int *) ((char *)src + src_step);
+		dst = (signed int *) ((char *)dst + dst_step);
+		sum = (signed int *) ((char *)sum + sum_step);
+	}
+}
+
+#include "../src/pcm/pcm_dmix_simd.h"
+
+#if defined(__x86_64__)
+#define MIX_AREAS_16 x86_64_mix_areas_16
+#define MIX_AREAS_32 x86_64_mix_areas_32
+#define MIX_AREAS_24 x86_64_mix_areas_24
+#define LOCK_PREFIX "lock ; "
+#define XADD "addl"
+#define XSUB "subl"
+#include "../src/pcm/pcm_dmix_x86_64.h"
+static void *ptr_x86_64_mix_areas_24 __attribute__((unused)) = &x86_64_mix_areas_24;
+#endif
+
+typedef void (mix16_t)(unsigned int size, volatile signed short *dst,
+		       signed short *src, volatile signed int *sum,
+		       size_t dst_step, size_t src_step, size_t sum_step);
+typedef void (mix32_t)(unsigned int size, volatile signed int *dst,
+		       signed int *src, volatile signed int *sum,
+		       size_t dst_step, size_t src_step, size_t sum_step);
+
+struct kernel {
+	const char *name;
+	mix16_t *mix16;
+	mix16_t *remix16;
+	mix32_t *mix32;
+	mix32_t *remix32;
+};
+
+static struct kernel kernels[] = {
+	{ "generic", generic_mix_areas_16_native, generic_remix_areas_16_native,
+	  generic_mix_areas_32_native, generic_remix_areas_32_native },
+#ifdef DMIX_SIMD_AVX2
+	{ "avx2", avx2_mix_areas_16, avx2_remix_areas_16,
+	  avx2_mix_areas_32, avx2_remix_areas_32 },
+#endif
+#ifdef DMIX_SIMD_NEON
+	{ "neon", neon_mix_areas_16, neon_remix_areas_16,
+	  neon_mix_areas_32, neon_remix_areas_32 },
+#endif
+#if defined(__x86_64__)
+	{ "x86_64 asm", x86_64_mix_areas_16, NULL, x86_64_mix_areas_32, NULL },
+#endif
+};
+
+#define NKERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+static int kernel_available(const struct kernel *k)
+{
+#ifdef DMIX_SIMD_AVX2
+	if (k->mix16 == avx2_mix_areas_16)
+		return __builtin_cpu_supports("avx2");
+#endif
+	return 1;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *alloc_aligned(size_t size)
+{
+	void *p;
+
+	if (posix_memalign(&p, 64, size))
+		return NULL;
+	memset(p, 0, size);
+	return p;
+}
+
+/* mix all clients, then remove the last one; offset breaks alignment */
+static void run16(const struct kernel *k, unsigned int size, unsigned int ofs,
+		  signed short *dst, signed short **srcs, signed int *sum,
+		  unsigned int clients)
+{
+	unsigned int i;
+
+	memset(dst, 0, sizeof(*dst) * (size + ofs));
+	for (i = 0; i < clients; i++)
+		k->mix16(size, dst + ofs, srcs[i] + ofs, sum + ofs, 2, 2, 4);
+	if (k->remix16)
+		k->remix16(size, dst + ofs, srcs[0] + ofs, sum + ofs, 2, 2, 4);
+}
+
+static void run32(const struct kernel *k, unsigned int size, unsigned int ofs,
+		  signed int *dst, signed int **srcs, signed int *sum,
+		  unsigned int clients)
+{
+	unsigned int i;
+
+	memset(dst, 0, sizeof(*dst) * (size + ofs));
+	for (i = 0; i < clients; i++)
+		k->mix32(size, dst + ofs, srcs[i] + ofs, sum + ofs, 4, 4, 4);
+	if (k->remix32)
+		k->remix32(size, dst + ofs, srcs[0] + ofs, sum + ofs, 4, 4, 4);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int frames = 1024, clients = 8, channels = 2, loops = 2000;
+	unsigned int size, i, j, t, ofs;
+	signed short *dst16, *ref16, **srcs16;
+	signed int *dst32, *ref32, **srcs32, *sum, *refsum;
+	double begin, best16[NKERNELS], best32[NKERNELS];
+	int err = 0;
+
+	if (argc > 1)
+		frames = atoi(argv[1]);
+	if (argc > 2)
+		clients = atoi(argv[2]);
+	if (argc > 3)
+		channels = atoi(argv[3]);
+	if (argc > 4)
+		loops = atoi(argv[4]);
+	if (!frames || !clients || !channels || !loops) {
+		fprintf(stderr, "invalid arguments\n");
+		return EXIT_FAILURE;
+	}
+	size = frames * channels;
+
+	dst16 = alloc_aligned(sizeof(*dst16) * (size + 16));
+	ref16 = alloc_aligned(sizeof(*ref16) * (size + 16));
+	dst32 = alloc_aligned(sizeof(*dst32) * (size + 16));
+	ref32 = alloc_aligned(sizeof(*ref32) * (size + 16));
+	sum = alloc_aligned(sizeof(*sum) * (size + 16));
+	refsum = alloc_aligned(sizeof(*refsum) * (size + 16));
+	srcs16 = calloc(clients, sizeof(*srcs16));
+	srcs32 = calloc(clients, sizeof(*srcs32));
+	if (!dst16 || !ref16 || !dst32 || !ref32 || !sum || !refsum ||
+	    !srcs16 || !srcs32) {
+		fprintf(stderr, "out of memory\n");
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < clients; i++) {
+		srcs16[i] = alloc_aligned(sizeof(**srcs16) * (size + 16));
+		srcs32[i] = alloc_aligned(sizeof(**srcs32) * (size + 16));
+		if (!srcs16[i] || !srcs32[i]) {
+			fprintf(stderr, "out of memory\n");
+			return EXIT_FAILURE;
+		}
+		/* loud enough to hit the clipping paths */
+		for (j = 0; j < size + 16; j++) {
+			srcs16[i][j] = (rand() & 0xffff) - 0x8000;
+			srcs32[i][j] = (int)((unsigned int)rand() << 1);
+			if (!(j % 7))
+				srcs16[i][j] = srcs32[i][j] = 0;
+		}
+	}
+
+	/* verify with aligned and misaligned buffers */
+	for (i = 1; i < NKERNELS; i++) {
+		if (!kernel_available(&kernels[i]))
+			continue;
+		for (ofs = 0; ofs < 16; ofs += 5) {
+			run16(&kernels[0], size, ofs, ref16, srcs16, refsum, clients);
+			run16(&kernels[i], size, ofs, dst16, srcs16, sum, clients);
+			if (kernels[i].remix16 &&
+			    (memcmp(dst16, ref16, sizeof(*dst16) * (size + ofs)) ||
+			     memcmp(sum, refsum, sizeof(*sum) * (size + ofs)))) {
+				printf("%s: 16-bit mismatch (offset %u)\n", kernels[i].name, ofs);
+				err = 1;
+			}
+			run32(&kernels[0], size, ofs, ref32, srcs32, refsum, clients);
+			run32(&kernels[i], size, ofs, dst32, srcs32, sum, clients);
+			if (kernels[i].remix32 &&
+			    (memcmp(dst32, ref32, sizeof(*dst32) * (size + ofs)) ||
+			     memcmp(sum, refsum, sizeof(*sum) * (size + ofs)))) {
+				printf("%s: 32-bit mismatch (offset %u)\n", kernels[i].name, ofs);
+				err = 1;
+			}
+		}
+	}
+
+	printf("frames %u, channels %u, clients %u, loops %u\n\n",
+	       frames, channels, clients, loops);
+	printf("%-12s %14s %14s\n", "kernel", "S16 ns/sample", "S32 ns/sample");
+	for (i = 0; i < NKERNELS; i++) {
+		best16[i] = best32[i] = 1e9;
+		if (!kernel_available(&kernels[i]))
+			continue;
+		for (t = 0; t < loops; t++) {
+			begin = now();
+			run16(&kernels[i], size, 0, dst16, srcs16, sum, clients);
+			begin = now() - begin;
+			if (begin < best16[i])
+				best16[i] = begin;
+			begin = now();
+			run32(&kernels[i], size, 0, dst32, srcs32, sum, clients);
+			begin = now() - begin;
+			if (begin < best32[i])
+				best32[i] = begin;
+		}
+		/* the asm kernels have no remix callback here */
+		j = kernels[i].remix16 ? clients + 1 : clients;
+		printf("%-12s %14.3f %14.3f   (x%.2f, x%.2f)\n", kernels[i].name,
+		       best16[i] * 1e9 / ((double)size * j),
+		       best32[i] * 1e9 / ((double)size * j),
+		       best16[0] / best16[i] * j / (clients + 1),
+		       best32[0] / best32[i] * j / (clients + 1));
+	}
+
+	return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,373 @@
+/*
+ *  Latency benchmark
+ *
+ *  Non-interactive companion of latency.c: runs the capture -> playback
+ *  loop for every combination of device pair, period size, period count
+ *  and scheduling policy given on the command line, measuring the
+ *  round-trip latency and wakeup latency percentiles, the xrun count and
+ *  the CPU time per period.
+ *
+ *  Example:
+ *    latency-bench -D hw:0,0 -D plughw:0,0 -D dmix@dsnoop \
+ *                  -p 64,128,256 -n 2,3 -s other,fifo -t 10 -j
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include "../include/asoundlib.h"
+#include "bench.h"
+
+
+struct device_pair {
+	const char *pdevice;
+	const char *cdevice;
+};
+
+struct result {
+	unsigned long periods;
+	unsigned long xruns;
+	double lat[4];		/* round trip p50, p95, p99, max (us) */
+	double wake[3];		/* wakeup p50, p99, max (us) */
+	double cpu;		/* CPU time per period (us) */
+};
+
+static struct device_pair devices[BENCH_MAX_LIST];
+static unsigned int num_devices;
+static unsigned int period_sizes[BENCH_MAX_LIST] = { 128 };
+static unsigned int num_period_sizes = 1;
+static unsigned int period_counts[BENCH_MAX_LIST] = { 2 };
+static unsigned int num_period_counts = 1;
+static int policies[BENCH_MAX_LIST] = { SCHED_OTHER };
+static unsigned int num_policies = 1;
+static snd_pcm_format_t format = SND_PCM_FORMAT_S16_LE;
+static unsigned int rate = 48000;
+static unsigned int channels = 2;
+static unsigned int loop_sec = 5;
+
+static const char *policy_name(int policy)
+{
+	switch (policy) {
+	case SCHED_FIFO:
+		return "fifo";
+	case SCHED_RR:
+		return "rr";
+	default:
+		return "other";
+	}
+}
+
+static int parse_policy(const char *name)
+{
+	if (!strcmp(name, "other"))
+		return SCHED_OTHER;
+	if (!strcmp(name, "fifo"))
+		return SCHED_FIFO;
+	if (!strcmp(name, "rr"))
+		return SCHED_RR;
+	return -1;
+}
+
+static int set_scheduler(int policy)
+{
+	struct sched_param param;
+
+	memset(&param, 0, sizeof(param));
+	if (policy != SCHED_OTHER)
+		param.sched_priority = sched_get_priority_max(policy);
+	if (sched_setscheduler(0, policy, &param) < 0) {
+		fprintf(stderr, "cannot set the %s scheduler: %s\n",
+			policy_name(policy), strerror(errno));
+		return -errno;
+	}
+	return 0;
+}
+
+static int setparams(snd_pcm_t *handle, unsigned int period, unsigned int periods,
+		     snd_pcm_uframes_t start_threshold)
+{
+	snd_pcm_hw_params_t *hw;
+	snd_pcm_sw_params_t *sw;
+	snd_pcm_uframes_t size;
+	unsigned int rrate = rate;
+	int err;
+
+	snd_pcm_hw_params_alloca(&hw);
+	snd_pcm_sw_params_alloca(&sw);
+	if ((err = snd_pcm_hw_params_any(handle, hw)) < 0 ||
+	    (err = snd_pcm_hw_params_set_access(handle, hw, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0 ||
+	    (err = snd_pcm_hw_params_set_format(handle, hw, format)) < 0 ||
+	    (err = snd_pcm_hw_params_set_channels(handle, hw, channels)) < 0 ||
+	    (err = snd_pcm_hw_params_set_rate_near(handle, hw, &rrate, 0)) < 0)
+		return err;
+	if (rrate != rate)
+		return -EINVAL;
+	size = period;
+	if ((err = snd_pcm_hw_params_set_period_size(handle, hw, size, 0)) < 0)
+		return err;
+	size = (snd_pcm_uframes_t)period * periods;
+	if ((err = snd_pcm_hw_params_set_buffer_size(handle, hw, size)) < 0)
+		return err;
+	if ((err = snd_pcm_hw_params(handle, hw)) < 0)
+		return err;
+	if ((err = snd_pcm_sw_params_current(handle, sw)) < 0 ||
+	    (err = snd_pcm_sw_params_set_start_threshold(handle, sw, start_threshold)) < 0 ||
+	    (err = snd_pcm_sw_params_set_avail_min(handle, sw, period)) < 0 ||
+	    (err = snd_pcm_sw_params_set_tstamp_mode(handle, sw, SND_PCM_TSTAMP_ENABLE)) < 0 ||
+	    (err = snd_pcm_sw_params_set_tstamp_type(handle, sw, SND_PCM_TSTAMP_TYPE_MONOTONIC)) < 0)
+		return err;
+	return snd_pcm_sw_params(handle, sw);
+}
+
+/* prefills the playback side and starts both (linked) streams */
+static int start_streams(snd_pcm_t *phandle, snd_pcm_t *chandle, char *buf,
+			 unsigned int period, unsigned int periods)
+{
+	unsigned int i;
+	int err;
+
+	if ((err = snd_pcm_prepare(phandle)) < 0)
+		return err;
+	if (snd_pcm_state(chandle) != SND_PCM_STATE_PREPARED &&
+	    (err = snd_pcm_prepare(chandle)) < 0)
+		return err;
+	snd_pcm_format_set_silence(format, buf, period * channels);
+	for (i = 0; i + 1 < periods; i++)
+		if ((err = snd_pcm_writei(phandle, buf, period)) < 0)
+			return err;
+	return snd_pcm_start(chandle);
+}
+
+static int run(const struct device_pair *dev, unsigned int period,
+	       unsigned int periods, struct result *res)
+{
+	snd_pcm_t *phandle = NULL, *chandle = NULL;
+	unsigned long max_samples, n = 0;
+	double *lat = NULL, *wake = NULL, cpu_start, deadline;
+	char *buf = NULL;
+	int err, linked;
+
+	memset(res, 0, sizeof(*res));
+	if ((err = snd_pcm_open(&phandle, dev->pdevice, SND_PCM_STREAM_PLAYBACK, 0)) < 0 ||
+	    (err = snd_pcm_open(&chandle, dev->cdevice, SND_PCM_STREAM_CAPTURE, 0)) < 0)
+		goto out;
+	if ((err = setparams(phandle, period, periods, (snd_pcm_uframes_t)period * periods * 2)) < 0 ||
+	    (err = setparams(chandle, period, periods, (snd_pcm_uframes_t)period * periods * 2)) < 0)
+		goto out;
+	linked = snd_pcm_link(chandle, phandle) >= 0;
+
+	max_samples = (unsigned long)loop_sec * rate / period + 16;
+	lat = malloc(max_samples * sizeof(*lat));
+	wake = malloc(max_samples * sizeof(*wake));
+	buf = malloc(snd_pcm_frames_to_bytes(chandle, period));
+	if (!lat || !wake || !buf) {
+		err = -ENOMEM;
+		goto out;
+	}
+	if ((err = start_streams(phandle, chandle, buf, period, periods)) < 0)
+		goto out;
+	if (!linked && (err = snd_pcm_start(phandle)) < 0)
+		goto out;
+
+	cpu_start = bench_clock_us(CLOCK_THREAD_CPUTIME_ID);
+	deadline = bench_clock_us(CLOCK_MONOTONIC) + loop_sec * 1e6;
+	while (n < max_samples && bench_clock_us(CLOCK_MONOTONIC) < deadline) {
+		snd_pcm_sframes_t r, pdelay, cdelay;
+		snd_pcm_uframes_t avail;
+		snd_htimestamp_t tstamp;
+
+		r = snd_pcm_readi(chandle, buf, period);
+		if (r >= 0 && snd_pcm_htimestamp(chandle, &avail, &tstamp) >= 0 &&
+		    (tstamp.tv_sec || tstamp.tv_nsec))
+			wake[n] = bench_clock_us(CLOCK_MONOTONIC) -
+				  (tstamp.tv_sec * 1e6 + tstamp.tv_nsec / 1e3);
+		else
+			wake[n] = 0;
+		if (r >= 0)
+			r = snd_pcm_writei(phandle, buf, r);
+		if (r >= 0) {
+			if (snd_pcm_delay(phandle, &pdelay) >= 0 &&
+			    snd_pcm_delay(chandle, &cdelay) >= 0) {
+				lat[n] = (double)(pdelay + cdelay) * 1e6 / rate;
+				n++;
+			}
+			continue;
+		}
+		if (r != -EPIPE && r != -ESTRPIPE) {
+			err = r;
+			goto out;
+		}
+		/* xrun: restart both streams from scratch */
+		res->xruns++;
+		snd_pcm_drop(chandle);
+		snd_pcm_drop(phandle);
+		if ((err = start_streams(phandle, chandle, buf, period, periods)) < 0)
+			goto out;
+		if (!linked && (err = snd_pcm_start(phandle)) < 0)
+			goto out;
+	}
+	res->cpu = n ? (bench_clock_us(CLOCK_THREAD_CPUTIME_ID) - cpu_start) / n : 0;
+	res->periods = n;
+	bench_sort(lat, n);
+	bench_sort(wake, n);
+	res->lat[0] = bench_percentile(lat, n, 50);
+	res->lat[1] = bench_percentile(lat, n, 95);
+	res->lat[2] = bench_percentile(lat, n, 99);
+	res->lat[3] = n ? lat[n - 1] : 0;
+	res->wake[0] = bench_percentile(wake, n, 50);
+	res->wake[1] = bench_percentile(wake, n, 99);
+	res->wake[2] = n ? wake[n - 1] : 0;
+	err = 0;
+ out:
+	if (chandle) {
+		snd_pcm_drop(chandle);
+		snd_pcm_unlink(chandle);
+		snd_pcm_close(chandle);
+	}
+	if (phandle) {
+		snd_pcm_drop(phandle);
+		snd_pcm_close(phandle);
+	}
+	free(lat);
+	free(wake);
+	free(buf);
+	return err;
+}
+
+static void print_result(const struct device_pair *dev, unsigned int period,
+			 unsigned int periods, int policy, int err,
+			 const struct result *res)
+{
+	bench_record_begin();
+	bench_field_str("pdevice", dev->pdevice);
+	bench_field_str("cdevice", dev->cdevice);
+	bench_field_uint("rate", rate);
+	bench_field_uint("period", period);
+	bench_field_uint("periods", periods);
+	bench_field_str("sched", policy_name(policy));
+	bench_field_status(err);
+	bench_field_uint("periods_run", res->periods);
+	bench_field_uint("xruns", res->xruns);
+	bench_field_double("lat_p50_us", 1, res->lat[0]);
+	bench_field_double("lat_p95_us", 1, res->lat[1]);
+	bench_field_double("lat_p99_us", 1, res->lat[2]);
+	bench_field_double("lat_max_us", 1, res->lat[3]);
+	bench_field_double("wake_p50_us", 1, res->wake[0]);
+	bench_field_double("wake_p99_us", 1, res->wake[1]);
+	bench_field_double("wake_max_us", 1, res->wake[2]);
+	bench_field_double("cpu_us_per_period", 2, res->cpu);
+	bench_record_end();
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct bench_option options[] = {
+		{"device", 1, 'D', "PLAYBACK[@CAPTURE] device pair, may be repeated (default hw:0,0)"},
+		{"period", 1, 'p', "comma separated period sizes in frames (default 128)"},
+		{"periods", 1, 'n', "comma separated period counts (default 2)"},
+		{"sched", 1, 's', "comma separated policies: other, fifo, rr (default other)"},
+		{"rate", 1, 'r', "rate (default 48000)"},
+		{"channels", 1, 'c', "channels (default 2)"},
+		{"format", 1, 'f', "sample format (default S16_LE)"},
+		{"time", 1, 't', "seconds per run (default 5)"},
+		{NULL},
+	};
+	unsigned int d, p, n, s;
+	int c, ret = 0;
+
+	while ((c = bench_getopt(argc, argv, "latency-bench", options)) != -1) {
+		switch (c) {
+		case 'D': {
+			char *pair = strdup(optarg), *at;
+			if (num_devices >= BENCH_MAX_LIST)
+				break;
+			at = strchr(pair, '@');
+			if (at)
+				*at++ = '\0';
+			devices[num_devices].pdevice = pair;
+			devices[num_devices].cdevice = at ? at : pair;
+			num_devices++;
+			break;
+		}
+		case 'p':
+			num_period_sizes = bench_parse_list(optarg, period_sizes);
+			break;
+		case 'n':
+			num_period_counts = bench_parse_list(optarg, period_counts);
+			break;
+		case 's': {
+			char *tmp = strdup(optarg), *tok, *save;
+			num_policies = 0;
+			for (tok = strtok_r(tmp, ",", &save); tok && num_policies < BENCH_MAX_LIST;
+			     tok = strtok_r(NULL, ",", &save)) {
+				int policy = parse_policy(tok);
+				if (policy < 0) {
+					fprintf(stderr, "unknown policy %s\n", tok);
+					return 1;
+				}
+				policies[num_policies++] = policy;
+			}
+			free(tmp);
+			break;
+		}
+		case 'r':
+			rate = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			channels = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			format = snd_pcm_format_value(optarg);
+			if (format == SND_PCM_FORMAT_UNKNOWN) {
+				fprintf(stderr, "unknown format %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 't':
+			loop_sec = strtoul(optarg, NULL, 0);
+			break;
+		}
+	}
+	if (!num_devices) {
+		devices[0].pdevice = devices[0].cdevice = "hw:0,0";
+		num_devices = 1;
+	}
+
+	for (s = 0; s < num_policies; s++) {
+		if (set_scheduler(policies[s]) < 0)
+			continue;
+		for (d = 0; d < num_devices; d++)
+			for (p = 0; p < num_period_sizes; p++)
+				for (n = 0; n < num_period_counts; n++) {
+					struct result res;
+					int err = run(&devices[d], period_sizes[p],
+						      period_counts[n], &res);
+					print_result(&devices[d], period_sizes[p],
+						     period_counts[n], policies[s],
+						     err, &res);
+					if (err < 0)
+						ret = 1;
+				}
+	}
+	set_scheduler(SCHED_OTHER);
+	return ret;
+}
@@ -0,0 +1,647 @@
+/*
+ * The emulated card of fakecard.h: this file talks the kernel ABI only
+ * (sound/asound.h), the tests use alsa-lib on top of it.
+ */
+
+#define _GNU_SOURCE
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sound/asound.h>
+#include "fakecard.h"
+
+#define FAKE_DEV_DIR		"/dev/snd/"
+#define FAKE_FRAME_BYTES	(2 * FAKE_CHANNELS)
+#define FAKE_BUFFER_BYTES	(FAKE_BUFFER_SIZE * FAKE_FRAME_BYTES)
+
+struct fake_node {
+	char path[64];
+	dev_t dev;
+	ino_t ino;
+};
+
+struct fake_pcm {
+	struct fake_node node;
+	int stream;
+	short *data;			/* shared mapping of the node file */
+	pthread_mutex_t lock;
+	snd_pcm_state_t state;
+	snd_pcm_uframes_t hw_ptr;
+	snd_pcm_uframes_t appl_ptr;
+	snd_pcm_uframes_t avail_min;
+	snd_pcm_uframes_t stop_threshold;
+	snd_pcm_uframes_t silence_size;
+	snd_pcm_uframes_t boundary;
+	struct timespec trigger;	/* of the running frame count */
+	unsigned long long frames;	/* frames run since the trigger */
+};
+
+struct fake_card {
+	char dir[32];
+	struct fake_node ctl;
+	struct fake_pcm pcm[2];
+};
+
+static struct fake_card *fake;
+
+static int fake_node_create(struct fake_node *node, const char *name,
+			    size_t size)
+{
+	struct stat st;
+	int fd;
+
+	snprintf(node->path, sizeof(node->path), "%s/%s", fake->dir, name);
+	fd = syscall(SYS_openat, AT_FDCWD, node->path,
+		     O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	if (fd < 0)
+		return -errno;
+	if (ftruncate(fd, size) < 0 || fstat(fd, &st) < 0) {
+		close(fd);
+		return -errno;
+	}
+	node->dev = st.st_dev;
+	node->ino = st.st_ino;
+	return fd;
+}
+
+int fake_card_create(void)
+{
+	pthread_mutexattr_t attr;
+	int stream, fd;
+
+	fake = mmap(NULL, sizeof(*fake), PROT_READ | PROT_WRITE,
+		    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (fake == MAP_FAILED) {
+		fake = NULL;
+		return -errno;
+	}
+	strcpy(fake->dir, "/tmp/alsa-fakecard-XXXXXX");
+	if (!mkdtemp(fake->dir))
+		goto _err;
+	fd = fake_node_create(&fake->ctl, "controlC0", 0);
+	if (fd < 0)
+		goto _err;
+	close(fd);
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	for (stream = 0; stream < 2; stream++) {
+		struct fake_pcm *p = &fake->pcm[stream];
+
+		fd = fake_node_create(&p->node, stream ? "pcmC0D0c" : "pcmC0D0p",
+				      FAKE_BUFFER_BYTES);
+		if (fd < 0)
+			goto _err;
+		p->data = mmap(NULL, FAKE_BUFFER_BYTES, PROT_READ | PROT_WRITE,
+			       MAP_SHARED, fd, 0);
+		close(fd);
+		if (p->data == MAP_FAILED)
+			goto _err;
+		p->stream = stream;
+		p->state = SNDRV_PCM_STATE_OPEN;
+		pthread_mutex_init(&p->lock, &attr);
+	}
+	pthread_mutexattr_destroy(&attr);
+	return 0;
+
+ _err:
+	fd = -errno;
+	fake_card_destroy();
+	return fd;
+}
+
+void fake_card_destroy(void)
+{
+	int stream;
+
+	if (!fake)
+		return;
+	for (stream = 0; stream < 2; stream++) {
+		if (fake->pcm[stream].node.path[0])
+			unlink(fake->pcm[stream].node.path);
+	}
+	if (fake->ctl.path[0])
+		unlink(fake->ctl.path);
+	rmdir(fake->dir);
+	munmap(fake, sizeof(*fake));
+	fake = NULL;
+}
+
+const short *fake_card_buffer(int capture)
+{
+	return fake->pcm[!!capture].data;
+}
+
+/*
+ * the "hardware"
+ */
+
+static snd_pcm_uframes_t fake_avail(struct fake_pcm *p)
+{
+	snd_pcm_sframes_t avail;
+
+	if (p->stream == SNDRV_PCM_STREAM_PLAYBACK)
+		avail = p->hw_ptr + FAKE_BUFFER_SIZE - p->appl_ptr;
+	else
+		avail = p->hw_ptr - p->appl_ptr;
+	if (avail < 0)
+		avail += p->boundary;
+	else if ((snd_pcm_uframes_t)avail >= p->boundary)
+		avail -= p->boundary;
+	return avail;
+}
+
+/* the device moves on by the time elapsed since the last update */
+static void fake_update(struct fake_pcm *p)
+{
+	unsigned long long frames, n;
+	struct timespec now;
+
+	if (p->state != SNDRV_PCM_STATE_RUNNING &&
+	    p->state != SNDRV_PCM_STATE_DRAINING)
+		return;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	frames = ((now.tv_sec - p->trigger.tv_sec) * 1000000000ULL +
+		  now.tv_nsec - p->trigger.tv_nsec) * FAKE_RATE / 1000000000ULL;
+	n = frames - p->frames;
+	p->frames = frames;
+	if (n > FAKE_BUFFER_SIZE) {
+		/* only the last buffer of a long gap can be filled */
+		p->hw_ptr = (p->hw_ptr + n - FAKE_BUFFER_SIZE) % p->boundary;
+		n = FAKE_BUFFER_SIZE;
+	}
+	for (; n > 0; n--) {
+		short *frame = p->data + (p->hw_ptr % FAKE_BUFFER_SIZE) * FAKE_CHANNELS;
+		unsigned int chn;
+
+		for (chn = 0; chn < FAKE_CHANNELS; chn++) {
+			if (p->stream == SNDRV_PCM_STREAM_CAPTURE)
+				frame[chn] = fake_card_sample(p->hw_ptr, chn);
+			else if (p->silence_size >= p->boundary)
+				frame[chn] = 0;
+		}
+		p->hw_ptr = (p->hw_ptr + 1) % p->boundary;
+	}
+	if (fake_avail(p) >= p->stop_threshold)
+		p->state = SNDRV_PCM_STATE_XRUN;
+}
+
+static void fake_trigger(struct fake_pcm *p)
+{
+	unsigned long long ns = p->frames * 1000000000ULL / FAKE_RATE;
+
+	/* keep the frame count running from where it was */
+	clock_gettime(CLOCK_MONOTONIC, &p->trigger);
+	p->trigger.tv_sec -= ns / 1000000000ULL;
+	p->trigger.tv_nsec -= ns % 1000000000ULL;
+	if (p->trigger.tv_nsec < 0) {
+		p->trigger.tv_sec--;
+		p->trigger.tv_nsec += 1000000000L;
+	}
+}
+
+static int fake_mask_refine(struct snd_pcm_hw_params *params, int var,
+			    unsigned int allowed)
+{
+	struct snd_mask *m = &params->masks[var - SNDRV_PCM_HW_PARAM_FIRST_MASK];
+	unsigned int i;
+
+	for (i = 1; i < sizeof(m->bits) / sizeof(m->bits[0]); i++)
+		m->bits[i] = 0;
+	if (!(m->bits[0] & allowed))
+		return -EINVAL;
+	if (m->bits[0] & ~allowed)
+		params->cmask |= 1U << var;
+	m->bits[0] &= allowed;
+	return 0;
+}
+
+static int fake_interval_refine(struct snd_pcm_hw_params *params, int var,
+				unsigned int val)
+{
+	struct snd_interval *i =
+		&params->intervals[var - SNDRV_PCM_HW_PARAM_FIRST_INTERVAL];
+
+	if (i->empty || val < i->min || (val == i->min && i->openmin) ||
+	    val > i->max || (val == i->max && i->openmax))
+		return -EINVAL;
+	if (i->min != val || i->max != val || i->openmin || i->openmax ||
+	    !i->integer)
+		params->cmask |= 1U << var;
+	i->min = i->max = val;
+	i->openmin = i->openmax = 0;
+	i->integer = 1;
+	return 0;
+}
+
+/* there is a single setup: every parameter has one value */
+static int fake_hw_refine(struct snd_pcm_hw_params *params)
+{
+	static const struct {
+		int var;
+		unsigned int val;
+	} intervals[] = {
+		{ SNDRV_PCM_HW_PARAM_SAMPLE_BITS, 16 },
+		{ SNDRV_PCM_HW_PARAM_FRAME_BITS, 8 * FAKE_FRAME_BYTES },
+		{ SNDRV_PCM_HW_PARAM_CHANNELS, FAKE_CHANNELS },
+		{ SNDRV_PCM_HW_PARAM_RATE, FAKE_RATE },
+		{ SNDRV_PCM_HW_PARAM_PERIOD_TIME,
+		  FAKE_PERIOD_SIZE * 1000000ULL / FAKE_RATE },
+		{ SNDRV_PCM_HW_PARAM_PERIOD_SIZE, FAKE_PERIOD_SIZE },
+		{ SNDRV_PCM_HW_PARAM_PERIOD_BYTES,
+		  FAKE_PERIOD_SIZE * FAKE_FRAME_BYTES },
+		{ SNDRV_PCM_HW_PARAM_PERIODS, FAKE_PERIODS },
+		{ SNDRV_PCM_HW_PARAM_BUFFER_TIME,
+		  FAKE_BUFFER_SIZE * 1000000ULL / FAKE_RATE },
+		{ SNDRV_PCM_HW_PARAM_BUFFER_SIZE, FAKE_BUFFER_SIZE },
+		{ SNDRV_PCM_HW_PARAM_BUFFER_BYTES, FAKE_BUFFER_BYTES },
+	};
+	unsigned int k;
+	int err;
+
+	params->cmask = 0;
+	err = fake_mask_refine(params, SNDRV_PCM_HW_PARAM_ACCESS,
+			       1U << SNDRV_PCM_ACCESS_MMAP_INTERLEAVED);
+	if (err < 0)
+		return err;
+	err = fake_mask_refine(params, SNDRV_PCM_HW_PARAM_FORMAT,
+			       1U << SNDRV_PCM_FORMAT_S16_LE);
+	if (err < 0)
+		return err;
+	err = fake_mask_refine(params, SNDRV_PCM_HW_PARAM_SUBFORMAT,
+			       1U << SNDRV_PCM_SUBFORMAT_STD);
+	if (err < 0)
+		return err;
+	for (k = 0; k < sizeof(intervals) / sizeof(intervals[0]); k++) {
+		err = fake_interval_refine(params, intervals[k].var,
+					   intervals[k].val);
+		if (err < 0)
+			return err;
+	}
+	params->rmask = 0;
+	params->info = SNDRV_PCM_INFO_MMAP | SNDRV_PCM_INFO_MMAP_VALID |
+		       SNDRV_PCM_INFO_INTERLEAVED |
+		       SNDRV_PCM_INFO_BLOCK_TRANSFER | SNDRV_PCM_INFO_PAUSE;
+	params->msbits = 16;
+	params->rate_num = FAKE_RATE;
+	params->rate_den = 1;
+	params->fifo_size = 0;
+	return 0;
+}
+
+static void fake_pcm_info(struct snd_pcm_info *info, int stream)
+{
+	memset(info, 0, sizeof(*info));
+	info->stream = stream;
+	strcpy((char *)info->id, "Fake PCM");
+	strcpy((char *)info->name, "Fake PCM");
+	strcpy((char *)info->subname, "subdevice #0");
+	info->dev_class = SNDRV_PCM_CLASS_GENERIC;
+	info->subdevices_count = 1;
+}
+
+static snd_pcm_sframes_t fake_pcm_delay(struct fake_pcm *p)
+{
+	if (p->stream == SNDRV_PCM_STREAM_PLAYBACK)
+		return FAKE_BUFFER_SIZE - fake_avail(p);
+	return fake_avail(p);
+}
+
+static snd_pcm_uframes_t fake_appl_move(struct fake_pcm *p,
+					snd_pcm_sframes_t frames)
+{
+	snd_pcm_sframes_t appl = p->appl_ptr + frames;
+
+	if (appl < 0)
+		appl += p->boundary;
+	p->appl_ptr = appl % p->boundary;
+	return frames < 0 ? -frames : frames;
+}
+
+static int fake_pcm_ioctl(struct fake_pcm *p, unsigned long request, void *arg)
+{
+	struct timespec now;
+
+	switch (request) {
+	case SNDRV_PCM_IOCTL_PVERSION:
+		*(int *)arg = SNDRV_PCM_VERSION;
+		return 0;
+	case SNDRV_PCM_IOCTL_INFO:
+		fake_pcm_info(arg, p->stream);
+		return 0;
+	case SNDRV_PCM_IOCTL_USER_PVERSION:
+	case SNDRV_PCM_IOCTL_TSTAMP:
+	case SNDRV_PCM_IOCTL_TTSTAMP:
+		return 0;
+	case SNDRV_PCM_IOCTL_HW_REFINE:
+		return fake_hw_refine(arg);
+	case SNDRV_PCM_IOCTL_HW_PARAMS:
+		if (fake_hw_refine(arg) < 0)
+			return -EINVAL;
+		p->state = SNDRV_PCM_STATE_SETUP;
+		p->hw_ptr = p->appl_ptr = 0;
+		p->boundary = FAKE_BUFFER_SIZE;
+		p->stop_threshold = FAKE_BUFFER_SIZE;
+		memset(p->data, 0, FAKE_BUFFER_BYTES);
+		return 0;
+	case SNDRV_PCM_IOCTL_HW_FREE:
+		p->state = SNDRV_PCM_STATE_OPEN;
+		return 0;
+	case SNDRV_PCM_IOCTL_SW_PARAMS: {
+		struct snd_pcm_sw_params *sw = arg;
+		if (p->state == SNDRV_PCM_STATE_OPEN || !sw->boundary ||
+		    sw->boundary % FAKE_BUFFER_SIZE)
+			return -EINVAL;
+		p->avail_min = sw->avail_min;
+		p->stop_threshold = sw->stop_threshold;
+		p->silence_size = sw->silence_size;
+		p->boundary = sw->boundary;
+		return 0;
+	}
+	case SNDRV_PCM_IOCTL_CHANNEL_INFO: {
+		struct snd_pcm_channel_info *info = arg;
+		if (info->channel >= FAKE_CHANNELS)
+			return -EINVAL;
+		info->offset = 0;
+		info->first = info->channel * 16;
+		info->step = 8 * FAKE_FRAME_BYTES;
+		return 0;
+	}
+	case SNDRV_PCM_IOCTL_STATUS:
+	case SNDRV_PCM_IOCTL_STATUS_EXT: {
+		struct snd_pcm_status *status = arg;
+		fake_update(p);
+		memset(status, 0, sizeof(*status));
+		status->state = p->state;
+		status->trigger_tstamp = p->trigger;
+		clock_gettime(CLOCK_MONOTONIC, &status->tstamp);
+		status->appl_ptr = p->appl_ptr;
+		status->hw_ptr = p->hw_ptr;
+		status->delay = fake_pcm_delay(p);
+		status->avail = fake_avail(p);
+		status->avail_max = status->avail;
+		return 0;
+	}
+	case SNDRV_PCM_IOCTL_SYNC_PTR: {
+		struct snd_pcm_sync_ptr *sync = arg;
+		if (!(sync->flags & SNDRV_PCM_SYNC_PTR_APPL))
+			p->appl_ptr = sync->c.control.appl_ptr;
+		if (!(sync->flags & SNDRV_PCM_SYNC_PTR_AVAIL_MIN))
+			p->avail_min = sync->c.control.avail_min;
+		fake_update(p);
+		sync->s.status.state = p->state;
+		sync->s.status.hw_ptr = p->hw_ptr;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		sync->s.status.tstamp.tv_sec = now.tv_sec;
+		sync->s.status.tstamp.tv_nsec = now.tv_nsec;
+		sync->s.status.suspended_state = 0;
+		sync->c.control.appl_ptr = p->appl_ptr;
+		sync->c.control.avail_min = p->avail_min;
+		return 0;
+	}
+	case SNDRV_PCM_IOCTL_HWSYNC:
+		fake_update(p);
+		return p->state == SNDRV_PCM_STATE_XRUN ? -EPIPE : 0;
+	case SNDRV_PCM_IOCTL_DELAY:
+		fake_update(p);
+		*(snd_pcm_sframes_t *)arg = fake_pcm_delay(p);
+		return 0;
+	case SNDRV_PCM_IOCTL_PREPARE:
+		if (p->state == SNDRV_PCM_STATE_OPEN)
+			return -EBADFD;
+		p->state = SNDRV_PCM_STATE_PREPARED;
+		p->hw_ptr %= FAKE_BUFFER_SIZE;
+		p->appl_ptr = p->hw_ptr;
+		return 0;
+	case SNDRV_PCM_IOCTL_RESET:
+		fake_update(p);
+		p->appl_ptr = p->hw_ptr;
+		return 0;
+	case SNDRV_PCM_IOCTL_START:
+		if (p->state != SNDRV_PCM_STATE_PREPARED)
+			return -EBADFD;
+		p->frames = 0;
+		fake_trigger(p);
+		p->state = SNDRV_PCM_STATE_RUNNING;
+		return 0;
+	case SNDRV_PCM_IOCTL_DROP:
+	case SNDRV_PCM_IOCTL_DRAIN:
+		if (p->state == SNDRV_PCM_STATE_OPEN)
+			return -EBADFD;
+		p->state = SNDRV_PCM_STATE_SETUP;
+		return 0;
+	case SNDRV_PCM_IOCTL_PAUSE:
+		if (*(int *)arg && p->state == SNDRV_PCM_STATE_RUNNING) {
+			fake_update(p);
+			p->state = SNDRV_PCM_STATE_PAUSED;
+		} else if (!*(int *)arg && p->state == SNDRV_PCM_STATE_PAUSED) {
+			fake_trigger(p);
+			p->state = SNDRV_PCM_STATE_RUNNING;
+		} else {
+			return -EBADFD;
+		}
+		return 0;
+	case SNDRV_PCM_IOCTL_XRUN:
+		p->state = SNDRV_PCM_STATE_XRUN;
+		return 0;
+	case SNDRV_PCM_IOCTL_REWIND: {
+		snd_pcm_uframes_t *frames = arg;
+		snd_pcm_uframes_t max = FAKE_BUFFER_SIZE - fake_avail(p);
+		if (p->stream == SNDRV_PCM_STREAM_CAPTURE)
+			max = FAKE_BUFFER_SIZE - max;
+		*frames = fake_appl_move(p, -(snd_pcm_sframes_t)
+					 (*frames < max ? *frames : max));
+		return 0;
+	}
+	case SNDRV_PCM_IOCTL_FORWARD: {
+		snd_pcm_uframes_t *frames = arg;
+		snd_pcm_uframes_t max = fake_avail(p);
+		*frames = fake_appl_move(p, *frames < max ? *frames : max);
+		return 0;
+	}
+	}
+	if (getenv("FAKECARD_DEBUG"))
+		fprintf(stderr, "fakecard: unknown pcm ioctl 0x%lx\n", request);
+	return -ENOTTY;
+}
+
+static int fake_ctl_ioctl(unsigned long request, void *arg)
+{
+	switch (request) {
+	case SNDRV_CTL_IOCTL_PVERSION:
+		*(int *)arg = SNDRV_CTL_VERSION;
+		return 0;
+	case SNDRV_CTL_IOCTL_CARD_INFO: {
+		struct snd_ctl_card_info *info = arg;
+		memset(info, 0, sizeof(*info));
+		strcpy((char *)info->id, "Fake");
+		strcpy((char *)info->driver, "Fake");
+		strcpy((char *)info->name, "Fake");
+		strcpy((char *)info->longname, "Fake card of the test suite");
+		return 0;
+	}
+	case SNDRV_CTL_IOCTL_PCM_INFO: {
+		struct snd_pcm_info *info = arg;
+		int stream = info->stream;
+		if (info->device || info->subdevice > 0 ||
+		    (stream != SNDRV_PCM_STREAM_PLAYBACK &&
+		     stream != SNDRV_PCM_STREAM_CAPTURE))
+			return -ENOENT;
+		fake_pcm_info(info, stream);
+		return 0;
+	}
+	case SNDRV_CTL_IOCTL_PCM_NEXT_DEVICE:
+		*(int *)arg = *(int *)arg < 0 ? 0 : -1;
+		return 0;
+	case SNDRV_CTL_IOCTL_RAWMIDI_NEXT_DEVICE:
+	case SNDRV_CTL_IOCTL_HWDEP_NEXT_DEVICE:
+		*(int *)arg = -1;
+		return 0;
+	case SNDRV_CTL_IOCTL_PCM_PREFER_SUBDEVICE:
+	case SNDRV_CTL_IOCTL_SUBSCRIBE_EVENTS:
+		return 0;
+	case SNDRV_CTL_IOCTL_ELEM_LIST: {
+		struct snd_ctl_elem_list *list = arg;
+		list->used = list->count = 0;
+		return 0;
+	}
+	}
+	if (getenv("FAKECARD_DEBUG"))
+		fprintf(stderr, "fakecard: unknown control ioctl 0x%lx\n", request);
+	return -ENOTTY;
+}
+
+/*
+ * the system calls taken over from libc
+ */
+
+static int fake_node_match(const struct fake_node *node, const struct stat *st)
+{
+	return node->ino == st->st_ino && node->dev == st->st_dev;
+}
+
+/* returns 0 = not a fake node, 1 = control, 2 + stream = pcm */
+static int fake_fd_lookup(int fd)
+{
+	struct stat st;
+	int stream;
+
+	if (!fake || fd < 0 || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+		return 0;
+	if (fake_node_match(&fake->ctl, &st))
+		return 1;
+	for (stream = 0; stream < 2; stream++) {
+		if (fake_node_match(&fake->pcm[stream].node, &st))
+			return 2 + stream;
+	}
+	return 0;
+}
+
+static int fake_open(const char *file, int oflag, mode_t mode)
+{
+	const char *path = file;
+
+	if (fake && !strncmp(file, FAKE_DEV_DIR, strlen(FAKE_DEV_DIR))) {
+		const char *name = file + strlen(FAKE_DEV_DIR);
+		if (!strcmp(name, "controlC0"))
+			path = fake->ctl.path;
+		else if (!strcmp(name, "pcmC0D0p"))
+			path = fake->pcm[0].node.path;
+		else if (!strcmp(name, "pcmC0D0c"))
+			path = fake->pcm[1].node.path;
+		else {
+			errno = ENOENT;
+			return -1;
+		}
+		oflag &= ~(O_CREAT | O_EXCL | O_TRUNC);
+	}
+	return syscall(SYS_openat, AT_FDCWD, path, oflag, mode);
+}
+
+int open(const char *file, int oflag, ...)
+{
+	mode_t mode = 0;
+	va_list ap;
+
+	if ((oflag & O_CREAT) || (oflag & O_TMPFILE) == O_TMPFILE) {
+		va_start(ap, oflag);
+		mode = va_arg(ap, mode_t);
+		va_end(ap);
+	}
+	return fake_open(file, oflag, mode);
+}
+
+int open64(const char *file, int oflag, ...)
+{
+	mode_t mode = 0;
+	va_list ap;
+
+	if ((oflag & O_CREAT) || (oflag & O_TMPFILE) == O_TMPFILE) {
+		va_start(ap, oflag);
+		mode = va_arg(ap, mode_t);
+		va_end(ap);
+	}
+	return fake_open(file, oflag, mode);
+}
+
+int ioctl(int fd, unsigned long request, ...)
+{
+	void *arg;
+	va_list ap;
+	int node, err;
+
+	va_start(ap, request);
+	arg = va_arg(ap, void *);
+	va_end(ap);
+	node = fake_fd_lookup(fd);
+	if (!node)
+		return syscall(SYS_ioctl, fd, request, arg);
+	if (node == 1) {
+		err = fake_ctl_ioctl(request, arg);
+	} else {
+		struct fake_pcm *p = &fake->pcm[node - 2];
+		pthread_mutex_lock(&p->lock);
+		err = fake_pcm_ioctl(p, request, arg);
+		pthread_mutex_unlock(&p->lock);
+	}
+	if (err < 0) {
+		errno = -err;
+		return -1;
+	}
+	return err;
+}
+
+static void *fake_mmap(void *addr, size_t len, int prot, int flags, int fd,
+		       long long offset)
+{
+	/* no status and control pages: the hw plugin uses SYNC_PTR */
+	if (offset && fake_fd_lookup(fd) >= 2) {
+		errno = ENXIO;
+		return MAP_FAILED;
+	}
+#ifdef SYS_mmap2
+	return (void *)syscall(SYS_mmap2, addr, len, prot, flags, fd,
+			       (unsigned long)(offset / 4096));
+#else
+	return (void *)syscall(SYS_mmap, addr, len, prot, flags, fd, offset);
+#endif
+}
+
+void *mmap(void *addr, size_t len, int prot, int flags, int fd, off_t offset)
+{
+	return fake_mmap(addr, len, prot, flags, fd, offset);
+}
+
+void *mmap64(void *addr, size_t len, int prot, int flags, int fd, off64_t offset)
+{
+	return fake_mmap(addr, len, prot, flags, fd, offset);
+}
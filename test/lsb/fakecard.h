@@ -0,0 +1,34 @@
+#ifndef FAKECARD_H_INCLUDED
+#define FAKECARD_H_INCLUDED
+
+/*
+ * A sound card emulated in the test process: open(), ioctl() and mmap()
+ * of the test binary take over the /dev/snd nodes of card 0 (a control
+ * device and pcmC0D0p / pcmC0D0c), so that the direct plugins run on
+ * top of the hw plugin without a kernel driver.  The hardware pointers
+ * follow the monotonic clock.  The state lives in shared memory, so the
+ * children forked by the library (the dmix server) see the same card.
+ *
+ * The only hw setup is S16_LE, 2 channels, 48000 Hz, mmap interleaved,
+ * FAKE_PERIOD_SIZE frames period and FAKE_BUFFER_SIZE frames buffer.
+ */
+
+#define FAKE_RATE		48000
+#define FAKE_CHANNELS		2
+#define FAKE_PERIOD_SIZE	960
+#define FAKE_PERIODS		4
+#define FAKE_BUFFER_SIZE	(FAKE_PERIOD_SIZE * FAKE_PERIODS)
+
+int fake_card_create(void);
+void fake_card_destroy(void);
+
+/* the device ring buffer of the given stream, interleaved S16 */
+const short *fake_card_buffer(int capture);
+
+/* the sample the capture "hardware" records at the given frame position */
+static inline short fake_card_sample(unsigned long pos, unsigned int chn)
+{
+	return (short)((pos * FAKE_CHANNELS + chn) & 0x7fff);
+}
+
+#endif
@@ -0,0 +1,628 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <signal.h>
+#include <sys/shm.h>
+#include "test.h"
+#include "fakecard.h"
+
+/*
+ * The direct plugins on the card of fakecard.c.
+ */
+
+/*
+ * Every test uses instances of its own: the shm of an instance stays a
+ * bit after its last client, and a late client would attach to it.
+ * client_rate uses the next key too.
+ */
+static int direct_instance;
+
+static void next_instance(void)
+{
+	direct_instance += 2;
+}
+
+static key_t direct_key(void)
+{
+	return 0x7a000000 | (getpid() & 0xffff) << 8 | direct_instance;
+}
+
+/* the definition of pcm.test on the slave of the card */
+static void direct_conf(char *buf, size_t size, const char *type,
+			const char *opts)
+{
+	snprintf(buf, size,
+		 "pcm.test { type %s ipc_key %d ipc_perm 0600 wakeup timerfd "
+		 "%s slave { pcm { type hw card 0 device 0 } "
+		 "format S16_LE rate %d channels %d "
+		 "period_size %d buffer_size %d } }",
+		 type, direct_key(), opts,
+		 FAKE_RATE, FAKE_CHANNELS, FAKE_PERIOD_SIZE, FAKE_BUFFER_SIZE);
+}
+
+static int open_conf(snd_pcm_t **pcmp, const char *name,
+		     snd_pcm_stream_t stream, const char *text)
+{
+	snd_config_t *conf;
+	snd_input_t *input;
+	int err;
+
+	err = snd_config_top(&conf);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&input, text, strlen(text));
+	if (err >= 0) {
+		err = snd_config_load(conf, input);
+		snd_input_close(input);
+	}
+	if (err >= 0)
+		err = snd_pcm_open_lconf(pcmp, name, stream, 0, conf);
+	snd_config_delete(conf);
+	return err;
+}
+
+static int open_direct(snd_pcm_t **pcmp, const char *type,
+		       snd_pcm_stream_t stream, const char *opts)
+{
+	char buf[1024];
+
+	direct_conf(buf, sizeof(buf), type, opts);
+	return open_conf(pcmp, "test", stream, buf);
+}
+
+static int setup_params(snd_pcm_t *pcm, snd_pcm_access_t access,
+			unsigned int channels, unsigned int rate)
+{
+	snd_pcm_hw_params_t *params;
+	int err;
+
+	snd_pcm_hw_params_alloca(&params);
+	err = snd_pcm_hw_params_any(pcm, params);
+	if (err >= 0)
+		err = snd_pcm_hw_params_set_access(pcm, params, access);
+	if (err >= 0)
+		err = snd_pcm_hw_params_set_format(pcm, params, SND_PCM_FORMAT_S16_LE);
+	if (err >= 0)
+		err = snd_pcm_hw_params_set_channels(pcm, params, channels);
+	if (err >= 0)
+		err = snd_pcm_hw_params_set_rate(pcm, params, rate, 0);
+	if (err >= 0)
+		err = snd_pcm_hw_params(pcm, params);
+	return err;
+}
+
+/* the format of the slave */
+static int setup(snd_pcm_t *pcm, snd_pcm_access_t access)
+{
+	return setup_params(pcm, access, FAKE_CHANNELS, FAKE_RATE);
+}
+
+static void fill(short *buf, short val, unsigned int frames)
+{
+	unsigned int i;
+
+	for (i = 0; i < frames * FAKE_CHANNELS; i++)
+		buf[i] = val;
+}
+
+/*
+ * memfd: the sum buffer of the first client is handed to the second one
+ * by the server, both mix into it
+ */
+static void test_dmix_memfd(void)
+{
+	static short buf[FAKE_BUFFER_SIZE * FAKE_CHANNELS];
+	snd_pcm_t *a, *b;
+	const short *hw = fake_card_buffer(0);
+	unsigned int i, both = 0, bad = 0;
+	char line[256];
+	int memfd = 0;
+	FILE *maps;
+
+	next_instance();
+	if (ALSA_CHECK(open_direct(&a, "dmix", SND_PCM_STREAM_PLAYBACK,
+				   "memfd yes")) < 0)
+		return;
+	if (ALSA_CHECK(open_direct(&b, "dmix", SND_PCM_STREAM_PLAYBACK,
+				   "memfd yes")) < 0) {
+		snd_pcm_close(a);
+		return;
+	}
+	maps = fopen("/proc/self/maps", "r");
+	if (maps) {
+		while (fgets(line, sizeof(line), maps))
+			if (strstr(line, "/memfd:alsa-dmix-sum"))
+				memfd++;
+		fclose(maps);
+		/* one mapping for each client */
+		TEST_CHECK(memfd == 2);
+	}
+	if (ALSA_CHECK(setup(a, SND_PCM_ACCESS_RW_INTERLEAVED)) >= 0 &&
+	    ALSA_CHECK(setup(b, SND_PCM_ACCESS_RW_INTERLEAVED)) >= 0) {
+		fill(buf, 1000, FAKE_BUFFER_SIZE);
+		TEST_CHECK(snd_pcm_writei(a, buf, FAKE_PERIOD_SIZE * 2) ==
+			   FAKE_PERIOD_SIZE * 2);
+		fill(buf, 2000, FAKE_BUFFER_SIZE);
+		TEST_CHECK(snd_pcm_writei(b, buf, FAKE_PERIOD_SIZE * 2) ==
+			   FAKE_PERIOD_SIZE * 2);
+		/* both are ahead of the hardware by more than a period */
+		for (i = 0; i < FAKE_BUFFER_SIZE * FAKE_CHANNELS; i++) {
+			if (hw[i] == 3000)
+				both++;
+			else if (hw[i] != 0 && hw[i] != 1000 && hw[i] != 2000)
+				bad++;
+		}
+		TEST_CHECK(both >= FAKE_PERIOD_SIZE * FAKE_CHANNELS);
+		TEST_CHECK(bad == 0);
+	}
+	ALSA_CHECK(snd_pcm_close(b));
+	ALSA_CHECK(snd_pcm_close(a));
+}
+
+/* the samples of the slave ring by what they hold */
+struct mix_count {
+	unsigned int silence, a, b, both, bad;
+};
+
+static int near(short v, short x)
+{
+	return v >= x - 1 && v <= x + 1;
+}
+
+/* ea and eb as written by one client alone, esum by both */
+static void count_mix(struct mix_count *c, short ea, short eb, short esum)
+{
+	const short *hw = fake_card_buffer(0);
+	unsigned int i;
+
+	memset(c, 0, sizeof(*c));
+	for (i = 0; i < FAKE_BUFFER_SIZE * FAKE_CHANNELS; i++) {
+		if (near(hw[i], esum))
+			c->both++;
+		else if (near(hw[i], ea))
+			c->a++;
+		else if (near(hw[i], eb))
+			c->b++;
+		else if (hw[i] == 0)
+			c->silence++;
+		else
+			c->bad++;
+	}
+	if (c->bad)
+		fprintf(stderr, "%u unexpected samples, expected %d + %d = %d\n",
+			c->bad, ea, eb, esum);
+}
+
+static int open_pair(snd_pcm_t **a, snd_pcm_t **b, const char *opts)
+{
+	int err;
+
+	err = ALSA_CHECK(open_direct(a, "dmix", SND_PCM_STREAM_PLAYBACK, opts));
+	if (err < 0)
+		return err;
+	err = ALSA_CHECK(open_direct(b, "dmix", SND_PCM_STREAM_PLAYBACK, opts));
+	if (err >= 0)
+		err = ALSA_CHECK(setup(*a, SND_PCM_ACCESS_RW_INTERLEAVED));
+	if (err >= 0)
+		err = ALSA_CHECK(setup(*b, SND_PCM_ACCESS_RW_INTERLEAVED));
+	if (err < 0) {
+		if (*b)
+			snd_pcm_close(*b);
+		snd_pcm_close(*a);
+	}
+	return err;
+}
+
+/* the value in chunks of the given size, all of them written */
+static int write_value(snd_pcm_t *pcm, short val, unsigned int frames,
+		       unsigned int chunk)
+{
+	static short buf[FAKE_BUFFER_SIZE * FAKE_CHANNELS];
+	snd_pcm_sframes_t n;
+
+	fill(buf, val, FAKE_BUFFER_SIZE);
+	while (frames > 0) {
+		n = snd_pcm_writei(pcm, buf, frames < chunk ? frames : chunk);
+		if (n < 0)
+			return n;
+		frames -= n;
+	}
+	return 0;
+}
+
+/*
+ * two clients with the given options write two periods each; where both
+ * are ahead of the hardware the slave ring holds their sum, esum
+ */
+static void test_dmix_mix(const char *opts, short va, short vb,
+			  short ea, short eb, short esum, unsigned int chunk)
+{
+	snd_pcm_t *a = NULL, *b = NULL;
+	struct mix_count c;
+
+	next_instance();
+	if (open_pair(&a, &b, opts) < 0)
+		return;
+	ALSA_CHECK(write_value(a, va, FAKE_PERIOD_SIZE * 2, chunk));
+	ALSA_CHECK(write_value(b, vb, FAKE_PERIOD_SIZE * 2, chunk));
+	count_mix(&c, ea, eb, esum);
+	TEST_CHECK(c.both >= FAKE_PERIOD_SIZE * FAKE_CHANNELS);
+	TEST_CHECK(c.bad == 0);
+	ALSA_CHECK(snd_pcm_close(b));
+	ALSA_CHECK(snd_pcm_close(a));
+}
+
+static void test_dmix_modes(void)
+{
+	/* the default mixing, with the sum clipped to the sample range */
+	test_dmix_mix("", 1000, 2000, 1000, 2000, 3000, FAKE_PERIOD_SIZE);
+	test_dmix_mix("", 20000, 20000, 20000, 20000, 32767, FAKE_PERIOD_SIZE);
+	test_dmix_mix("", -20000, -20000, -20000, -20000, -32768,
+		      FAKE_PERIOD_SIZE);
+	/* per-client slabs summed by the reducer */
+	test_dmix_mix("mix_mode staging", 1000, 2000, 1000, 2000, 3000,
+		      FAKE_PERIOD_SIZE);
+	test_dmix_mix("mix_mode staging", 20000, 20000, 20000, 20000, 32767,
+		      FAKE_PERIOD_SIZE);
+	/* -6 and +6 dB, the gained sum is clipped too */
+	test_dmix_mix("gain -6.0206", 1000, 2000, 500, 1000, 1500,
+		      FAKE_PERIOD_SIZE);
+	test_dmix_mix("gain 6.0206", 10000, 10000, 20000, 20000, 32767,
+		      FAKE_PERIOD_SIZE);
+	test_dmix_mix("mix_lock mutex", 1000, 2000, 1000, 2000, 3000,
+		      FAKE_PERIOD_SIZE);
+	/* small writes, most of them mixed two at a time */
+	test_dmix_mix("commit_frames 240", 1000, 2000, 1000, 2000, 3000, 120);
+}
+
+/* a rewind of one client takes its frames out of the sum again */
+static void test_dmix_history_rewind(void)
+{
+	snd_pcm_t *a = NULL, *b = NULL;
+	struct mix_count c;
+	unsigned int b_ahead;
+	snd_pcm_sframes_t n;
+
+	next_instance();
+	if (open_pair(&a, &b, "mix_mode semaphore history yes") < 0)
+		return;
+	ALSA_CHECK(write_value(a, 1000, FAKE_PERIOD_SIZE * 2, FAKE_PERIOD_SIZE));
+	ALSA_CHECK(write_value(b, 2000, FAKE_PERIOD_SIZE * 2, FAKE_PERIOD_SIZE));
+	count_mix(&c, 1000, 2000, 3000);
+	TEST_CHECK(c.both >= FAKE_PERIOD_SIZE * FAKE_CHANNELS);
+	/* the second client started a little later, so it ends later too */
+	b_ahead = c.b;
+	n = snd_pcm_rewind(b, FAKE_PERIOD_SIZE);
+	TEST_CHECK(n == FAKE_PERIOD_SIZE);
+	/* the frames taken back hold the first client alone */
+	count_mix(&c, 1000, 2000, 3000);
+	TEST_CHECK(n <= 0 || c.a + b_ahead >= n * FAKE_CHANNELS);
+	TEST_CHECK(c.bad == 0);
+	/* and the second client mixes into them again */
+	ALSA_CHECK(write_value(b, 2000, FAKE_PERIOD_SIZE, FAKE_PERIOD_SIZE));
+	count_mix(&c, 1000, 2000, 3000);
+	TEST_CHECK(c.both >= FAKE_PERIOD_SIZE * FAKE_CHANNELS);
+	TEST_CHECK(c.bad == 0);
+	ALSA_CHECK(snd_pcm_close(b));
+	ALSA_CHECK(snd_pcm_close(a));
+}
+
+/*
+ * staging with a mono client on each slave channel: the reducer writes
+ * only the channels marked for a period, and none of them is lost
+ */
+static void test_dmix_staging_bindings(void)
+{
+	const short *hw = fake_card_buffer(0);
+	unsigned int i, n[2] = { 0, 0 }, bad = 0;
+	snd_pcm_t *a, *b;
+	char conf[1024];
+
+	next_instance();
+	direct_conf(conf, sizeof(conf), "dmix",
+		    "mix_mode staging bindings { 0 0 }");
+	if (ALSA_CHECK(open_conf(&a, "test", SND_PCM_STREAM_PLAYBACK, conf)) < 0)
+		return;
+	direct_conf(conf, sizeof(conf), "dmix",
+		    "mix_mode staging bindings { 0 1 }");
+	if (ALSA_CHECK(open_conf(&b, "test", SND_PCM_STREAM_PLAYBACK, conf)) < 0) {
+		snd_pcm_close(a);
+		return;
+	}
+	if (ALSA_CHECK(setup_params(a, SND_PCM_ACCESS_RW_INTERLEAVED, 1,
+				    FAKE_RATE)) >= 0 &&
+	    ALSA_CHECK(setup_params(b, SND_PCM_ACCESS_RW_INTERLEAVED, 1,
+				    FAKE_RATE)) >= 0) {
+		ALSA_CHECK(write_value(a, 1000, FAKE_PERIOD_SIZE * 2,
+				       FAKE_PERIOD_SIZE));
+		ALSA_CHECK(write_value(b, 2000, FAKE_PERIOD_SIZE * 2,
+				       FAKE_PERIOD_SIZE));
+		for (i = 0; i < FAKE_BUFFER_SIZE * FAKE_CHANNELS; i++) {
+			if (hw[i] == (i % FAKE_CHANNELS ? 2000 : 1000))
+				n[i % FAKE_CHANNELS]++;
+			else if (hw[i] != 0)
+				bad++;
+		}
+		TEST_CHECK(n[0] >= FAKE_PERIOD_SIZE && n[1] >= FAKE_PERIOD_SIZE);
+		TEST_CHECK(bad == 0);
+	}
+	ALSA_CHECK(snd_pcm_close(b));
+	ALSA_CHECK(snd_pcm_close(a));
+}
+
+/* the process other than this one that maps the shm of the instance */
+static pid_t find_server(void)
+{
+	char path[64], line[512], shm[32];
+	struct dirent *d;
+	pid_t pid, server = -1;
+	DIR *dir;
+	FILE *maps;
+
+	dir = opendir("/proc");
+	if (!dir)
+		return -1;
+	snprintf(shm, sizeof(shm), "/SYSV%08x", direct_key());
+	while (server < 0 && (d = readdir(dir)) != NULL) {
+		pid = atoi(d->d_name);
+		if (pid <= 0 || pid == getpid())
+			continue;
+		snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+		maps = fopen(path, "r");
+		if (!maps)
+			continue;
+		while (fgets(line, sizeof(line), maps))
+			if (strstr(line, shm)) {
+				server = pid;
+				break;
+			}
+		fclose(maps);
+	}
+	closedir(dir);
+	return server;
+}
+
+/*
+ * persist: the server keeps the slave and the shm after the last client,
+ * the next client attaches to them, and a SIGTERM to the server drops
+ * everything
+ */
+static void test_dmix_persist(void)
+{
+	snd_pcm_t *a, *b;
+	struct mix_count c;
+	unsigned int i;
+	pid_t server;
+
+	next_instance();
+	if (ALSA_CHECK(open_direct(&a, "dmix", SND_PCM_STREAM_PLAYBACK,
+				   "persist yes")) < 0)
+		return;
+	if (ALSA_CHECK(setup(a, SND_PCM_ACCESS_RW_INTERLEAVED)) >= 0)
+		ALSA_CHECK(write_value(a, 1000, FAKE_PERIOD_SIZE * 2,
+				       FAKE_PERIOD_SIZE));
+	ALSA_CHECK(snd_pcm_close(a));
+	TEST_CHECK(shmget(direct_key(), 0, 0) >= 0);
+	/* let the frames of the first client play out */
+	usleep(FAKE_BUFFER_SIZE * 2000000ULL / FAKE_RATE);
+	if (ALSA_CHECK(open_direct(&b, "dmix", SND_PCM_STREAM_PLAYBACK,
+				   "persist yes")) >= 0) {
+		if (ALSA_CHECK(setup(b, SND_PCM_ACCESS_RW_INTERLEAVED)) >= 0) {
+			ALSA_CHECK(write_value(b, 2000, FAKE_PERIOD_SIZE * 2,
+					       FAKE_PERIOD_SIZE));
+			count_mix(&c, 2000, 2000, 2000);
+			TEST_CHECK(c.both >= FAKE_PERIOD_SIZE * FAKE_CHANNELS);
+			TEST_CHECK(c.bad == 0);
+		}
+		ALSA_CHECK(snd_pcm_close(b));
+	}
+	server = find_server();
+	TEST_CHECK(server > 0);
+	if (server <= 0)
+		return;
+	kill(server, SIGTERM);
+	for (i = 0; i < 200 && shmget(direct_key(), 0, 0) >= 0; i++)
+		usleep(10000);
+	TEST_CHECK(shmget(direct_key(), 0, 0) < 0);
+}
+
+/*
+ * ptr_refresh: the clients share one slave pointer estimate, which still
+ * follows the hardware
+ */
+static void test_dmix_ptr_refresh(void)
+{
+	snd_pcm_sframes_t a1, a2, b2;
+	snd_pcm_t *a = NULL, *b = NULL;
+	struct mix_count c;
+
+	next_instance();
+	if (open_pair(&a, &b, "slowptr yes ptr_refresh 2000") < 0)
+		return;
+	ALSA_CHECK(write_value(a, 1000, FAKE_PERIOD_SIZE * 2, FAKE_PERIOD_SIZE));
+	ALSA_CHECK(write_value(b, 2000, FAKE_PERIOD_SIZE * 2, FAKE_PERIOD_SIZE));
+	count_mix(&c, 1000, 2000, 3000);
+	TEST_CHECK(c.both >= FAKE_PERIOD_SIZE * FAKE_CHANNELS);
+	TEST_CHECK(c.bad == 0);
+	a1 = ALSA_CHECK(snd_pcm_avail(a));
+	usleep(FAKE_PERIOD_SIZE * 1000000ULL / FAKE_RATE);
+	a2 = ALSA_CHECK(snd_pcm_avail(a));
+	b2 = ALSA_CHECK(snd_pcm_avail(b));
+	TEST_CHECK(a2 > a1);
+	TEST_CHECK(a2 - b2 <= FAKE_PERIOD_SIZE && b2 - a2 <= FAKE_PERIOD_SIZE);
+	ALSA_CHECK(snd_pcm_close(b));
+	ALSA_CHECK(snd_pcm_close(a));
+}
+
+/* count the mappings of /proc/self/maps with both strings */
+static int count_maps(const char *name, const char *perm)
+{
+	char line[512];
+	int n = 0;
+	FILE *maps;
+
+	maps = fopen("/proc/self/maps", "r");
+	if (!maps)
+		return -1;
+	while (fgets(line, sizeof(line), maps))
+		if (strstr(line, name) && strstr(line, perm))
+			n++;
+	fclose(maps);
+	return n;
+}
+
+/* the frames follow the capture pattern of the card from any position */
+static int check_pattern(const short *buf, unsigned int frames)
+{
+	unsigned long pos = (unsigned short)buf[0] / FAKE_CHANNELS;
+	unsigned int i, chn;
+
+	for (i = 0; i < frames; i++)
+		for (chn = 0; chn < FAKE_CHANNELS; chn++)
+			if (buf[i * FAKE_CHANNELS + chn] !=
+			    fake_card_sample(pos + i, chn))
+				return 0;
+	return 1;
+}
+
+/*
+ * zerocopy: a plain client reads the slave ring in place, a client below
+ * a file plugin with an infile keeps a private copy, as the infile data
+ * overwrites its samples; the plain client still sees the card
+ */
+static void test_dsnoop_zerocopy(void)
+{
+	static short buf[FAKE_BUFFER_SIZE * FAKE_CHANNELS];
+	char ifname[] = "/tmp/alsa-pcm_direct-XXXXXX";
+	char conf[2048];
+	snd_pcm_t *a, *b;
+	unsigned int i;
+	int fd, ok;
+
+	next_instance();
+	fd = mkstemp(ifname);
+	if (fd < 0) {
+		TEST_CHECK(fd >= 0);
+		return;
+	}
+	fill(buf, 1234, FAKE_BUFFER_SIZE);
+	ok = write(fd, buf, sizeof(buf)) == sizeof(buf);
+	close(fd);
+	TEST_CHECK(ok);
+	direct_conf(conf, sizeof(conf), "dsnoop", "zerocopy yes");
+	snprintf(conf + strlen(conf), sizeof(conf) - strlen(conf),
+		 " pcm.infile { type file slave.pcm test "
+		 "file \"/dev/null\" infile \"%s\" }", ifname);
+	if (ALSA_CHECK(open_conf(&a, "infile", SND_PCM_STREAM_CAPTURE, conf)) < 0)
+		goto _unlink;
+	if (ALSA_CHECK(open_direct(&b, "dsnoop", SND_PCM_STREAM_CAPTURE,
+				   "zerocopy yes")) < 0) {
+		snd_pcm_close(a);
+		goto _unlink;
+	}
+	if (ALSA_CHECK(setup(a, SND_PCM_ACCESS_MMAP_INTERLEAVED)) >= 0 &&
+	    ALSA_CHECK(setup(b, SND_PCM_ACCESS_RW_INTERLEAVED)) >= 0) {
+		/* only the plain client maps the ring read-only */
+		TEST_CHECK(count_maps("/pcmC0D0c", " r--s ") == 1);
+		ALSA_CHECK(snd_pcm_start(a));
+		ALSA_CHECK(snd_pcm_start(b));
+		for (i = 0; i < 2; i++) {
+			memset(buf, 0, sizeof(buf));
+			TEST_CHECK(snd_pcm_mmap_readi(a, buf, FAKE_PERIOD_SIZE) ==
+				   FAKE_PERIOD_SIZE);
+			TEST_CHECK(buf[0] == 1234 &&
+				   buf[FAKE_PERIOD_SIZE * FAKE_CHANNELS - 1] == 1234);
+			memset(buf, 0, sizeof(buf));
+			TEST_CHECK(snd_pcm_readi(b, buf, FAKE_PERIOD_SIZE) ==
+				   FAKE_PERIOD_SIZE);
+			TEST_CHECK(check_pattern(buf, FAKE_PERIOD_SIZE));
+		}
+	}
+	ALSA_CHECK(snd_pcm_close(b));
+	ALSA_CHECK(snd_pcm_close(a));
+ _unlink:
+	unlink(ifname);
+}
+
+/*
+ * client_rate: two clients at half the slave rate read the decimated
+ * capture pattern, a ramp rising by two slave frames per frame; the
+ * filter only smears the wrap of the pattern
+ */
+static void test_dsnoop_client_rate(void)
+{
+	static short buf[2][FAKE_BUFFER_SIZE * FAKE_CHANNELS];
+	const unsigned int frames = FAKE_PERIOD_SIZE / 2;
+	snd_pcm_t *pcm[2];
+	unsigned int i, k, chn, bad;
+	int d;
+
+	next_instance();
+	if (ALSA_CHECK(open_direct(&pcm[0], "dsnoop", SND_PCM_STREAM_CAPTURE,
+				   "client_rate 24000")) < 0)
+		return;
+	if (ALSA_CHECK(open_direct(&pcm[1], "dsnoop", SND_PCM_STREAM_CAPTURE,
+				   "client_rate 24000")) < 0) {
+		snd_pcm_close(pcm[0]);
+		return;
+	}
+	if (ALSA_CHECK(setup_params(pcm[0], SND_PCM_ACCESS_RW_INTERLEAVED,
+				    FAKE_CHANNELS, FAKE_RATE / 2)) < 0 ||
+	    ALSA_CHECK(setup_params(pcm[1], SND_PCM_ACCESS_RW_INTERLEAVED,
+				    FAKE_CHANNELS, FAKE_RATE / 2)) < 0)
+		goto _close;
+	ALSA_CHECK(snd_pcm_start(pcm[0]));
+	ALSA_CHECK(snd_pcm_start(pcm[1]));
+	/*
+	 * a period from each in turn, so that neither overruns; the first
+	 * one holds the settling of the filter and is overwritten
+	 */
+	for (i = 0; i < 3; i++)
+		for (k = 0; k < 2; k++)
+			TEST_CHECK(snd_pcm_readi(pcm[k], buf[k] + (i ? i - 1 : 0) *
+						 frames * FAKE_CHANNELS,
+						 frames) == frames);
+	for (k = 0; k < 2; k++) {
+		bad = 0;
+		for (i = 1; i < frames * 2; i++) {
+			for (chn = 0; chn < FAKE_CHANNELS; chn++) {
+				d = buf[k][i * FAKE_CHANNELS + chn] -
+				    buf[k][(i - 1) * FAKE_CHANNELS + chn];
+				if (d < 2 * FAKE_CHANNELS - 1 ||
+				    d > 2 * FAKE_CHANNELS + 1)
+					bad++;
+			}
+		}
+		/* at most one wrap over the 32 taps of the filter */
+		if (bad > FAKE_CHANNELS * 17)
+			fprintf(stderr, "client %u: %u wrong steps\n", k, bad);
+		TEST_CHECK(bad <= FAKE_CHANNELS * 17);
+	}
+ _close:
+	ALSA_CHECK(snd_pcm_close(pcm[1]));
+	ALSA_CHECK(snd_pcm_close(pcm[0]));
+}
+
+int main(void)
+{
+	int err;
+
+	/* only the configuration of open_direct() matters */
+	setenv("ALSA_CONFIG_PATH", "/dev/null", 1);
+	err = fake_card_create();
+	if (err < 0) {
+		fprintf(stderr, "cannot create the fake card: %s\n", strerror(-err));
+		return EXIT_FAILURE;
+	}
+	test_dmix_memfd();
+	test_dmix_modes();
+	test_dmix_history_rewind();
+	test_dmix_staging_bindings();
+	test_dmix_ptr_refresh();
+	test_dmix_persist();
+	test_dsnoop_zerocopy();
+	test_dsnoop_client_rate();
+	fake_card_destroy();
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,365 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "test.h"
+
+/*
+ * Round trip of the rice encoder of the file plugin: the frames written
+ * to a file PCM on a null slave are decoded from the file again and must
+ * come back unchanged.  The decoder follows the stream description at the
+ * top of src/pcm/pcm_file_rice.c.
+ */
+
+#define RICE_ESCAPE	31
+#define RICE_VERBATIM	0xff
+
+struct bit_reader {
+	const unsigned char *p, *end;
+	uint64_t acc;
+	unsigned int n;
+	int err;
+};
+
+static uint32_t get_le(const unsigned char *p, unsigned int bytes)
+{
+	uint32_t v = 0;
+
+	while (bytes-- > 0)
+		v = (v << 8) | p[bytes];
+	return v;
+}
+
+/* bits <= 32 */
+static uint64_t bits_get(struct bit_reader *r, unsigned int bits)
+{
+	if (!bits)
+		return 0;
+	while (r->n < bits) {
+		if (r->p >= r->end) {
+			r->err = 1;
+			return 0;
+		}
+		r->acc = (r->acc << 8) | *r->p++;
+		r->n += 8;
+	}
+	r->n -= bits;
+	return (r->acc >> r->n) & ((1ULL << bits) - 1);
+}
+
+static uint64_t bits_get64(struct bit_reader *r, unsigned int bits)
+{
+	uint64_t v = 0;
+
+	if (bits > 32) {
+		v = bits_get(r, bits - 32) << 32;
+		bits = 32;
+	}
+	return v | bits_get(r, bits);
+}
+
+static int32_t sign_extend(uint32_t u, unsigned int width)
+{
+	unsigned int shift = 32 - width;
+
+	return (int32_t)(u << shift) >> shift;
+}
+
+/* one channel of a block into x[0], x[channels], ..., returns the end */
+static const unsigned char *decode_channel(const unsigned char *p,
+					   const unsigned char *end,
+					   int32_t *x, unsigned int channels,
+					   unsigned int frames, unsigned int phys,
+					   unsigned int width)
+{
+	struct bit_reader r;
+	unsigned int order, k, i, warm;
+	int64_t v;
+
+	if (end - p < 2)
+		return NULL;
+	order = *p++;
+	k = *p++;
+	if (order != RICE_VERBATIM && (order > 3 || k > 40))
+		return NULL;
+	warm = order == RICE_VERBATIM ? frames : order;
+	if (warm > frames || (size_t)(end - p) < (size_t)warm * phys)
+		return NULL;
+	for (i = 0; i < warm; i++, p += phys)
+		x[i * channels] = sign_extend(get_le(p, phys), width);
+	if (order == RICE_VERBATIM)
+		return p;
+	r.p = p;
+	r.end = end;
+	r.acc = 0;
+	r.n = 0;
+	r.err = 0;
+	for (i = order; i < frames; i++) {
+		uint64_t u, q = 0;
+		while (q < RICE_ESCAPE && bits_get(&r, 1))
+			q++;
+		if (q == RICE_ESCAPE)
+			u = bits_get64(&r, 64);
+		else
+			u = (q << k) | bits_get64(&r, k);
+		v = u & 1 ? -(int64_t)(u >> 1) - 1 : (int64_t)(u >> 1);
+		switch (order) {
+		case 1:
+			v += x[(i - 1) * channels];
+			break;
+		case 2:
+			v += 2 * (int64_t)x[(i - 1) * channels] - x[(i - 2) * channels];
+			break;
+		case 3:
+			v += 3 * (int64_t)x[(i - 1) * channels] -
+				3 * (int64_t)x[(i - 2) * channels] + x[(i - 3) * channels];
+			break;
+		}
+		x[i * channels] = v;
+	}
+	return r.err ? NULL : r.p;
+}
+
+/*
+ * decodes the stream into interleaved samples, returns the frame count
+ * or -1 on a malformed stream
+ */
+static long rice_decode(const unsigned char *p, size_t size,
+			snd_pcm_format_t format, unsigned int channels,
+			unsigned int block, int32_t *out, size_t max_frames)
+{
+	const unsigned char *end = p + size, *bend;
+	unsigned int phys = snd_pcm_format_physical_width(format) / 8;
+	unsigned int width = snd_pcm_format_width(format);
+	unsigned int frames, bytes, c;
+	size_t total = 0;
+
+	if (size < 16 || memcmp(p, "ALSR", 4) || p[4] != 1 || p[5] != format ||
+	    get_le(p + 6, 2) != channels || get_le(p + 8, 4) != 48000 ||
+	    get_le(p + 12, 4) != block)
+		return -1;
+	p += 16;
+	while (p < end) {
+		if (end - p < 12 || memcmp(p, "ALSB", 4))
+			return -1;
+		frames = get_le(p + 4, 4);
+		bytes = get_le(p + 8, 4);
+		p += 12;
+		if (!frames || frames > block || (size_t)(end - p) < bytes ||
+		    total + frames > max_frames)
+			return -1;
+		bend = p + bytes;
+		for (c = 0; c < channels && p; c++)
+			p = decode_channel(p, bend, out + total * channels + c,
+					   channels, frames, phys, width);
+		if (p != bend)
+			return -1;
+		total += frames;
+	}
+	return total;
+}
+
+/* stores v at the sample position, with garbage in the padding bits */
+static void put_sample(snd_pcm_format_t format, unsigned char *p, int32_t v)
+{
+	unsigned int phys = snd_pcm_format_physical_width(format) / 8;
+	unsigned int width = snd_pcm_format_width(format);
+	uint64_t u = (uint32_t)v & (uint32_t)((1ULL << width) - 1);
+	unsigned int i;
+
+	if (snd_pcm_format_unsigned(format) == 1)
+		u ^= 1ULL << (width - 1);
+	u |= 0xa5a5a5a5ULL << width;
+	for (i = 0; i < phys; i++) {
+		if (snd_pcm_format_big_endian(format) == 1)
+			p[phys - 1 - i] = u >> (i * 8);
+		else
+			p[i] = u >> (i * 8);
+	}
+}
+
+enum { SILENCE, FULL_SCALE, SPIKES, NOISE, TRIANGLE, SIGNALS };
+
+static int32_t signal_value(int signal, unsigned int width, unsigned int frame,
+			    unsigned int chn, unsigned int *seed)
+{
+	int32_t max = (int32_t)((1ULL << (width - 1)) - 1), min = -max - 1;
+	int32_t t;
+
+	switch (signal) {
+	case FULL_SCALE:
+		/* alternating extremes, the other channels stuck at one */
+		if (chn == 0)
+			return frame & 1 ? max : min;
+		return chn & 1 ? max : min;
+	case SPIKES:
+		/* escape codes in an otherwise small block */
+		return frame % 7 == 3 ? (chn & 1 ? min : max) : (int32_t)(frame & 3) - 2;
+	case NOISE:
+		return sign_extend(rand_r(seed) ^ ((uint32_t)rand_r(seed) << 16), width);
+	case TRIANGLE:
+		t = (frame * (chn + 1) * 97) % 512;
+		return (int32_t)((t < 256 ? t : 511 - t) - 128) << (width > 12 ? width - 10 : 0);
+	default:
+		return 0;
+	}
+}
+
+static int write_file_pcm(const char *fname, snd_pcm_format_t format,
+			  unsigned int channels, unsigned int block,
+			  const void *buf, unsigned int frames)
+{
+	char text[512];
+	snd_config_t *conf;
+	snd_input_t *input;
+	snd_pcm_t *pcm;
+	snd_pcm_hw_params_t *params;
+	snd_pcm_sframes_t n;
+	int err;
+
+	snprintf(text, sizeof(text),
+		 "pcm.test { type file slave.pcm { type null } file \"%s\" "
+		 "encoder { name rice block %u } }", fname, block);
+	err = snd_config_top(&conf);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&input, text, strlen(text));
+	if (err >= 0) {
+		err = snd_config_load(conf, input);
+		snd_input_close(input);
+	}
+	if (err >= 0)
+		err = snd_pcm_open_lconf(&pcm, "test", SND_PCM_STREAM_PLAYBACK, 0, conf);
+	snd_config_delete(conf);
+	if (err < 0)
+		return err;
+	snd_pcm_hw_params_alloca(&params);
+	err = snd_pcm_hw_params_any(pcm, params);
+	if (err >= 0)
+		err = snd_pcm_hw_params_set_access(pcm, params,
+						   SND_PCM_ACCESS_RW_INTERLEAVED);
+	if (err >= 0)
+		err = snd_pcm_hw_params_set_format(pcm, params, format);
+	if (err >= 0)
+		err = snd_pcm_hw_params_set_channels(pcm, params, channels);
+	if (err >= 0)
+		err = snd_pcm_hw_params_set_rate(pcm, params, 48000, 0);
+	if (err >= 0)
+		err = snd_pcm_hw_params(pcm, params);
+	while (err >= 0 && frames > 0) {
+		n = snd_pcm_writei(pcm, buf, frames);
+		if (n < 0) {
+			err = n;
+			break;
+		}
+		buf = (const char *)buf + snd_pcm_frames_to_bytes(pcm, n);
+		frames -= n;
+	}
+	snd_pcm_close(pcm);
+	return err;
+}
+
+static unsigned char *read_file(const char *fname, size_t *size)
+{
+	unsigned char *buf;
+	FILE *f;
+	long len;
+
+	f = fopen(fname, "rb");
+	if (!f)
+		return NULL;
+	fseek(f, 0, SEEK_END);
+	len = ftell(f);
+	rewind(f);
+	buf = malloc(len > 0 ? len : 1);
+	if (buf && fread(buf, 1, len, f) != (size_t)len) {
+		free(buf);
+		buf = NULL;
+	}
+	fclose(f);
+	*size = len;
+	return buf;
+}
+
+static void test_round_trip(const char *fname, snd_pcm_format_t format,
+			    unsigned int channels, int signal,
+			    unsigned int block, unsigned int frames)
+{
+	unsigned int phys = snd_pcm_format_physical_width(format) / 8;
+	unsigned int width = snd_pcm_format_width(format);
+	size_t samples = (size_t)frames * channels, size, i;
+	int32_t *ref = malloc(samples * sizeof(*ref));
+	int32_t *dec = malloc(samples * sizeof(*dec));
+	unsigned char *pcm = malloc(samples * phys);
+	unsigned char *data = NULL;
+	unsigned int seed = frames, bad = 0;
+	long n;
+
+	if (!ref || !dec || !pcm) {
+		TEST_CHECK(0);
+		goto _free;
+	}
+	for (i = 0; i < samples; i++) {
+		ref[i] = signal_value(signal, width, i / channels, i % channels, &seed);
+		put_sample(format, pcm + i * phys, ref[i]);
+	}
+	if (ALSA_CHECK(write_file_pcm(fname, format, channels, block, pcm, frames)) < 0)
+		goto _free;
+	data = read_file(fname, &size);
+	if (!data) {
+		TEST_CHECK(data != NULL);
+		goto _free;
+	}
+	n = rice_decode(data, size, format, channels, block, dec, frames);
+	for (i = 0; n == frames && i < samples; i++)
+		if (dec[i] != ref[i])
+			bad++;
+	if (n != frames || bad)
+		fprintf(stderr, "%s, %u channels, signal %d, block %u, %u frames: "
+			"%ld frames decoded, %u wrong samples\n",
+			snd_pcm_format_name(format), channels, signal, block,
+			frames, n, bad);
+	TEST_CHECK(n == frames);
+	TEST_CHECK(bad == 0);
+	/* silence must shrink to a few bits per sample */
+	if (signal == SILENCE && block >= 1000)
+		TEST_CHECK(size < samples * phys / 4);
+ _free:
+	free(data);
+	free(pcm);
+	free(dec);
+	free(ref);
+}
+
+int main(void)
+{
+	static const snd_pcm_format_t formats[] = {
+		SND_PCM_FORMAT_S8, SND_PCM_FORMAT_U8,
+		SND_PCM_FORMAT_S16_LE, SND_PCM_FORMAT_S16_BE, SND_PCM_FORMAT_U16_LE,
+		SND_PCM_FORMAT_S24_LE, SND_PCM_FORMAT_U24_BE,
+		SND_PCM_FORMAT_S24_3LE, SND_PCM_FORMAT_S24_3BE, SND_PCM_FORMAT_S20_3LE,
+		SND_PCM_FORMAT_S32_LE, SND_PCM_FORMAT_S32_BE, SND_PCM_FORMAT_U32_LE,
+	};
+	/* odd frame counts around the block size, a single frame */
+	static const unsigned int sizes[][2] = {
+		{ 16, 1 }, { 16, 17 }, { 16, 1001 }, { 4096, 4097 },
+	};
+	char fname[] = "/tmp/alsa-pcm_file_rice-XXXXXX";
+	unsigned int f, s, signal;
+	int fd;
+
+	setenv("ALSA_CONFIG_PATH", "/dev/null", 1);
+	fd = mkstemp(fname);
+	if (fd < 0) {
+		perror("mkstemp");
+		return EXIT_FAILURE;
+	}
+	close(fd);
+	for (f = 0; f < sizeof(formats) / sizeof(formats[0]); f++)
+		for (signal = 0; signal < SIGNALS; signal++)
+			for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+				test_round_trip(fname, formats[f], 1 + (f + s) % 3,
+						signal, sizes[s][0], sizes[s][1]);
+	unlink(fname);
+	return TEST_EXIT_CODE();
+}
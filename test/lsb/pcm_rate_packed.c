@@ -0,0 +1,220 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "test.h"
+
+/*
+ * Resampling towards packed 3-byte slaves, as most USB devices use.  The
+ * rate converters work on S16 or S32, so a rate plugin running on S24_3LE
+ * has to convert through its temporary buffers; run under ASan to catch
+ * accesses past their end.
+ */
+
+static int open_conf(snd_pcm_t **pcm, const char *text)
+{
+	snd_config_t *conf;
+	snd_input_t *input;
+	int err;
+
+	err = snd_config_top(&conf);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&input, text, strlen(text));
+	if (err >= 0) {
+		err = snd_config_load(conf, input);
+		snd_input_close(input);
+	}
+	if (err >= 0)
+		err = snd_pcm_open_lconf(pcm, "test", SND_PCM_STREAM_PLAYBACK, 0, conf);
+	snd_config_delete(conf);
+	return err;
+}
+
+static int setup(snd_pcm_t *pcm, snd_pcm_format_t format,
+		 unsigned int channels, unsigned int rate)
+{
+	snd_pcm_hw_params_t *params;
+	int err;
+
+	snd_pcm_hw_params_alloca(&params);
+	err = snd_pcm_hw_params_any(pcm, params);
+	if (err >= 0)
+		err = snd_pcm_hw_params_set_access(pcm, params,
+						   SND_PCM_ACCESS_RW_INTERLEAVED);
+	if (err >= 0)
+		err = snd_pcm_hw_params_set_format(pcm, params, format);
+	if (err >= 0)
+		err = snd_pcm_hw_params_set_channels(pcm, params, channels);
+	if (err >= 0)
+		err = snd_pcm_hw_params_set_rate(pcm, params, rate, 0);
+	if (err >= 0)
+		err = snd_pcm_hw_params_set_period_size(pcm, params, 441, 0);
+	if (err >= 0)
+		err = snd_pcm_hw_params(pcm, params);
+	return err;
+}
+
+static int write_frames(snd_pcm_t *pcm, const void *buf, unsigned int frames)
+{
+	snd_pcm_sframes_t n;
+
+	while (frames > 0) {
+		n = snd_pcm_writei(pcm, buf, frames);
+		if (n < 0)
+			return n;
+		buf = (const char *)buf + snd_pcm_frames_to_bytes(pcm, n);
+		frames -= n;
+	}
+	return 0;
+}
+
+/* the text of the plug plan line of the dump */
+static char *plug_plan(snd_pcm_t *pcm)
+{
+	snd_output_t *out;
+	char *text, *line, *end, *plan = NULL;
+
+	if (snd_output_buffer_open(&out) < 0)
+		return NULL;
+	snd_pcm_dump(pcm, out);
+	snd_output_buffer_string(out, &text);
+	line = strstr(text, "Plug plan: ");
+	if (line) {
+		end = strchr(line, '\n');
+		plan = strndup(line, end ? (size_t)(end - line) : strlen(line));
+	}
+	snd_output_close(out);
+	return plan;
+}
+
+static void test_plug_chain(void)
+{
+	snd_pcm_t *pcm;
+	char *plan, *rate, *end;
+	void *buf;
+
+	if (ALSA_CHECK(open_conf(&pcm,
+		"pcm.test { type plug slave { pcm { type null } "
+		"format S24_3LE rate 32000 channels 6 } }")) < 0)
+		return;
+	if (ALSA_CHECK(setup(pcm, SND_PCM_FORMAT_S32_LE, 2, 44100)) >= 0) {
+		plan = plug_plan(pcm);
+		TEST_CHECK(plan != NULL);
+		rate = plan ? strstr(plan, "rate ") : NULL;
+		TEST_CHECK(rate != NULL);
+		if (rate) {
+			end = strchr(rate, '|');
+			if (end)
+				*end = '\0';
+			if (strstr(rate, "S24_3LE"))
+				fprintf(stderr, "rate on a packed format: %s\n", plan);
+			TEST_CHECK(strstr(rate, "S24_3LE") == NULL);
+		}
+		free(plan);
+		buf = calloc(4410, snd_pcm_frames_to_bytes(pcm, 1));
+		if (buf)
+			ALSA_CHECK(write_frames(pcm, buf, 4410));
+		free(buf);
+	}
+	snd_pcm_close(pcm);
+}
+
+/* rate has to run on S24_3LE here, the plan still gets a real estimate */
+static void test_plug_packed_only(void)
+{
+	snd_pcm_t *pcm;
+	char *plan, *est;
+	unsigned long cost;
+
+	if (ALSA_CHECK(open_conf(&pcm,
+		"pcm.test { type plug slave { pcm { type null } "
+		"format FLOAT_LE rate 96000 } }")) < 0)
+		return;
+	if (ALSA_CHECK(setup(pcm, SND_PCM_FORMAT_S24_3LE, 3, 44100)) >= 0) {
+		plan = plug_plan(pcm);
+		est = plan ? strstr(plan, "estimated cost ") : NULL;
+		TEST_CHECK(est != NULL);
+		if (est) {
+			cost = strtoul(est + 15, NULL, 10);
+			if (cost >= 10000)
+				fprintf(stderr, "saturated cost: %s\n", plan);
+			TEST_CHECK(cost > 0 && cost < 10000);
+		}
+		free(plan);
+	}
+	snd_pcm_close(pcm);
+}
+
+/*
+ * The converter works on S32, the rate plugin converts from and to
+ * S24_3LE.  A constant input must come out of the file unchanged once
+ * the filter has settled; a 4-byte store of a 3-byte sample clobbers
+ * the low byte of the next one.
+ */
+static void test_rate_s24_3le(const char *converter)
+{
+	char fname[] = "/tmp/alsa-pcm_rate_packed-XXXXXX";
+	const unsigned int channels = 3, frames = 4410, value = 0xc0;
+	char text[512];
+	snd_pcm_t *pcm;
+	unsigned char *buf, *data = NULL;
+	unsigned int i, bad = 0;
+	long size = 0;
+	int fd, err;
+	FILE *f;
+
+	fd = mkstemp(fname);
+	if (fd < 0) {
+		TEST_CHECK(fd >= 0);
+		return;
+	}
+	close(fd);
+	snprintf(text, sizeof(text),
+		 "pcm.test { type rate slave { pcm { type file "
+		 "slave.pcm { type null } file \"%s\" format raw } "
+		 "format S24_3LE rate 32000 } converter \"%s\" }",
+		 fname, converter);
+	buf = calloc(frames * channels, 3);
+	if (!buf || ALSA_CHECK(open_conf(&pcm, text)) < 0)
+		goto _free;
+	for (i = 0; i < frames * channels; i++)
+		buf[i * 3] = value;
+	err = ALSA_CHECK(setup(pcm, SND_PCM_FORMAT_S24_3LE, channels, 44100));
+	if (err >= 0)
+		ALSA_CHECK(write_frames(pcm, buf, frames));
+	snd_pcm_close(pcm);
+	f = fopen(fname, "rb");
+	if (f) {
+		fseek(f, 0, SEEK_END);
+		size = ftell(f);
+		rewind(f);
+		data = malloc(size > 0 ? size : 1);
+		if (data && fread(data, 1, size, f) != (size_t)size)
+			size = 0;
+		fclose(f);
+	}
+	/* skip the settling of the filter at both ends */
+	TEST_CHECK(size / 3 / channels > 512);
+	for (i = 256 * channels; data && i < size / 3 - 256 * channels; i++) {
+		int v = data[i * 3] | data[i * 3 + 1] << 8 |
+			(signed char)data[i * 3 + 2] << 16;
+		if (v < (int)value - 2 || v > (int)value + 2)
+			bad++;
+	}
+	if (bad)
+		fprintf(stderr, "%s: %u wrong samples\n", converter, bad);
+	TEST_CHECK(bad == 0);
+ _free:
+	free(data);
+	free(buf);
+	unlink(fname);
+}
+
+int main(void)
+{
+	setenv("ALSA_CONFIG_PATH", "/dev/null", 1);
+	test_plug_chain();
+	test_plug_packed_only();
+	test_rate_s24_3le("polyphase");
+	return TEST_EXIT_CODE();
+}
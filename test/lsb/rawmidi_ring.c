@@ -0,0 +1,133 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include "test.h"
+
+/*
+ * A blocking reader against a writer on a small ring, so that both
+ * sides keep going to sleep on the doorbells.  A lost wakeup hangs
+ * the test until the alarm fires.
+ */
+
+#define TOTAL_BYTES	(1 << 21)
+
+static unsigned char pattern(unsigned int pos)
+{
+	return (pos * 7 + (pos >> 8)) & 0xff;
+}
+
+struct reader {
+	snd_rawmidi_t *in;
+	unsigned int errors;
+	int err;
+};
+
+static void *reader_thread(void *arg)
+{
+	struct reader *r = arg;
+	unsigned char buf[29];
+	unsigned int pos = 0, seed = 1;
+	ssize_t i, n;
+
+	while (pos < TOTAL_BYTES) {
+		n = snd_rawmidi_read(r->in, buf, 1 + rand_r(&seed) % sizeof(buf));
+		if (n < 0) {
+			r->err = n;
+			break;
+		}
+		for (i = 0; i < n; i++, pos++)
+			if (buf[i] != pattern(pos))
+				r->errors++;
+	}
+	return NULL;
+}
+
+static int open_ring(snd_rawmidi_t **in, snd_rawmidi_t **out, const char *path)
+{
+	char text[256];
+	snd_config_t *conf;
+	snd_input_t *input;
+	int err;
+
+	snprintf(text, sizeof(text), "rawmidi.test { type ring size 16 %s%s%s }",
+		 path ? "path \"" : "", path ? path : "", path ? "\"" : "");
+	err = snd_config_top(&conf);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&input, text, strlen(text));
+	if (err >= 0) {
+		err = snd_config_load(conf, input);
+		snd_input_close(input);
+	}
+	if (err >= 0)
+		err = snd_rawmidi_open_lconf(in, out, "test", 0, conf);
+	snd_config_delete(conf);
+	return err;
+}
+
+static void test_stress(const char *path)
+{
+	snd_rawmidi_t *in, *out;
+	struct reader r = { 0 };
+	unsigned char buf[37];
+	unsigned int pos = 0, seed = 2;
+	pthread_t thread;
+	size_t i, len;
+	ssize_t n;
+
+	if (ALSA_CHECK(open_ring(&in, &out, path)) < 0)
+		return;
+	r.in = in;
+	if (pthread_create(&thread, NULL, reader_thread, &r) != 0) {
+		TEST_CHECK(0);
+		goto _close;
+	}
+	while (pos < TOTAL_BYTES) {
+		len = 1 + rand_r(&seed) % sizeof(buf);
+		if (len > TOTAL_BYTES - pos)
+			len = TOTAL_BYTES - pos;
+		for (i = 0; i < len; i++)
+			buf[i] = pattern(pos + i);
+		n = snd_rawmidi_write(out, buf, len);
+		if (n < 0) {
+			ALSA_CHECK(n);
+			break;
+		}
+		pos += n;
+	}
+	ALSA_CHECK(snd_rawmidi_drain(out));
+	pthread_join(thread, NULL);
+	ALSA_CHECK(r.err);
+	TEST_CHECK(r.errors == 0);
+ _close:
+	snd_rawmidi_close(out);
+	snd_rawmidi_close(in);
+}
+
+int main(void)
+{
+	char path[] = "/tmp/alsa-rawmidi_ring-XXXXXX";
+	char name[sizeof(path) + 8];
+	int fd;
+
+	setenv("ALSA_CONFIG_PATH", "/dev/null", 1);
+	/* a hang is a lost wakeup */
+	alarm(60);
+	test_stress(NULL);
+
+	fd = mkstemp(path);
+	if (fd >= 0) {
+		close(fd);
+		/* the plugin initializes an empty file */
+		unlink(path);
+		test_stress(path);
+		unlink(path);
+		snprintf(name, sizeof(name), "%s.data", path);
+		unlink(name);
+		snprintf(name, sizeof(name), "%s.space", path);
+		unlink(name);
+	}
+	return TEST_EXIT_CODE();
+}
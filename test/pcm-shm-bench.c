@@ -0,0 +1,267 @@
+/*
+ *  Shared memory PCM throughput benchmark
+ *
+ *  Opens the shm plugin against a running aserver (the server side PCM
+ *  is "null" by default, so the result is the transport cost only) and
+ *  writes periods as fast as the server accepts them for a number of
+ *  seconds, once for every period size given on the command line.  The
+ *  frame throughput, the writes per second and the client CPU time per
+ *  write are measured.
+ *
+ *  Example (with server.bench { socket "/tmp/alsa-shm-bench" } defined
+ *  in the configuration):
+ *    aserver bench &
+ *    pcm-shm-bench -s /tmp/alsa-shm-bench -p 16,64,256 -t 5 -j
+ *
+ *  With -P the TCP transport is measured instead (server.bench { host
+ *  "localhost" port 8400 } for the server).
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <unistd.h>
+#include "../include/asoundlib.h"
+#include "bench.h"
+
+#define CHANNELS	2
+
+struct result {
+	unsigned long frames;
+	unsigned long writes;
+	double fps;		/* frames per second */
+	double wps;		/* writes per second */
+	double cpu;		/* client CPU time per write (us) */
+};
+
+static const char *sockname = "/tmp/alsa-shm-bench";
+static const char *host = "localhost";
+static int port = -1;
+static const char *slave = "null";
+static unsigned int period_sizes[BENCH_MAX_LIST] = { 64 };
+static unsigned int num_period_sizes = 1;
+static unsigned int periods = 4;
+static unsigned int rate = 48000;
+static unsigned int seconds = 5;
+static int direct;
+
+/* global configuration plus a private server and shm plugin definition */
+static int open_shm(snd_pcm_t **pcm, snd_config_t **top)
+{
+	snd_input_t *in;
+	char conf[1024], server[256];
+	int err;
+
+	if (port >= 0)
+		snprintf(server, sizeof(server), "host \"%s\" port %d", host, port);
+	else
+		snprintf(server, sizeof(server), "socket \"%s\"", sockname);
+	snprintf(conf, sizeof(conf),
+		 "server.shm_bench {\n"
+		 "	%s\n"
+		 "}\n"
+		 "pcm.shm_bench {\n"
+		 "	type shm\n"
+		 "	server shm_bench\n"
+		 "	pcm \"%s\"\n"
+		 "	direct %s\n"
+		 "}\n",
+		 server, slave, direct ? "yes" : "no");
+	err = snd_config_update();
+	if (err < 0)
+		return err;
+	err = snd_config_copy(top, snd_config);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&in, conf, -1);
+	if (err < 0)
+		return err;
+	err = snd_config_load(*top, in);
+	snd_input_close(in);
+	if (err < 0)
+		return err;
+	return snd_pcm_open_lconf(pcm, "shm_bench", SND_PCM_STREAM_PLAYBACK,
+				  0, *top);
+}
+
+static int setup(snd_pcm_t *pcm, unsigned int period_size)
+{
+	snd_pcm_hw_params_t *hw;
+	snd_pcm_uframes_t size = period_size;
+	int err;
+
+	snd_pcm_hw_params_alloca(&hw);
+	err = snd_pcm_hw_params_any(pcm, hw);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_access(pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_format(pcm, hw, SND_PCM_FORMAT_S16);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_channels(pcm, hw, CHANNELS);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_rate(pcm, hw, rate, 0);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_period_size_near(pcm, hw, &size, 0);
+	if (err < 0)
+		return err;
+	size *= periods;
+	err = snd_pcm_hw_params_set_buffer_size_near(pcm, hw, &size);
+	if (err < 0)
+		return err;
+	return snd_pcm_hw_params(pcm, hw);
+}
+
+static int run(unsigned int period_size, struct result *res)
+{
+	snd_config_t *top = NULL;
+	snd_pcm_t *pcm;
+	snd_pcm_sframes_t n;
+	double t0, t1, c0, end;
+	short *buf;
+	int err;
+
+	memset(res, 0, sizeof(*res));
+	err = open_shm(&pcm, &top);
+	if (err < 0)
+		goto __top;
+	err = setup(pcm, period_size);
+	if (err < 0)
+		goto __close;
+	buf = calloc(period_size, CHANNELS * sizeof(short));
+	if (buf == NULL) {
+		err = -ENOMEM;
+		goto __close;
+	}
+
+	t0 = bench_now_us();
+	c0 = bench_cpu_us();
+	end = t0 + seconds * 1e6;
+	do {
+		n = snd_pcm_writei(pcm, buf, period_size);
+		if (n == -EPIPE) {
+			err = snd_pcm_prepare(pcm);
+			if (err < 0)
+				break;
+			continue;
+		}
+		if (n < 0) {
+			err = n;
+			break;
+		}
+		res->frames += n;
+		res->writes++;
+	} while ((t1 = bench_now_us()) < end);
+	t1 = bench_now_us();
+	if (res->writes) {
+		res->fps = res->frames / ((t1 - t0) / 1e6);
+		res->wps = res->writes / ((t1 - t0) / 1e6);
+		res->cpu = (bench_cpu_us() - c0) / res->writes;
+	}
+	free(buf);
+ __close:
+	snd_pcm_close(pcm);
+ __top:
+	if (top)
+		snd_config_delete(top);
+	return err;
+}
+
+static void print_result(unsigned int period_size, int err,
+			 const struct result *res)
+{
+	bench_record_begin();
+	bench_field_bool("direct", direct);
+	bench_field_uint("period", period_size);
+	bench_field_status(err);
+	bench_field_uint("frames", res->frames);
+	bench_field_uint("writes", res->writes);
+	bench_field_double("frames_per_s", 0, res->fps);
+	bench_field_double("writes_per_s", 0, res->wps);
+	bench_field_double("cpu_us", 2, res->cpu);
+	bench_record_end();
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct bench_option options[] = {
+		{"socket", 1, 's', "aserver socket (default /tmp/alsa-shm-bench)"},
+		{"host", 1, 'H', "aserver host for the TCP transport (default localhost)"},
+		{"port", 1, 'P', "aserver port, selects the TCP transport"},
+		{"device", 1, 'D', "server side PCM (default null)"},
+		{"period", 1, 'p', "comma separated period sizes in frames (default 64)"},
+		{"periods", 1, 'n', "periods per buffer (default 4)"},
+		{"rate", 1, 'r', "rate (default 48000)"},
+		{"time", 1, 't', "seconds per run (default 5)"},
+		{"direct", 0, 'd', "read state and avail from the shared area"},
+		{NULL},
+	};
+	unsigned int p;
+	int c, ret = 0;
+
+	while ((c = bench_getopt(argc, argv, "pcm-shm-bench", options)) != -1) {
+		switch (c) {
+		case 's':
+			sockname = optarg;
+			break;
+		case 'H':
+			host = optarg;
+			break;
+		case 'P':
+			port = atoi(optarg);
+			break;
+		case 'D':
+			slave = optarg;
+			break;
+		case 'p':
+			num_period_sizes = bench_parse_list(optarg, period_sizes);
+			break;
+		case 'n':
+			periods = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			rate = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			direct = 1;
+			break;
+		}
+	}
+	if (periods < 2 || !rate || !seconds) {
+		fprintf(stderr, "invalid parameters\n");
+		return 1;
+	}
+
+	for (p = 0; p < num_period_sizes; p++) {
+		struct result res;
+		int err = run(period_sizes[p], &res);
+		print_result(period_sizes[p], err, &res);
+		if (err < 0)
+			ret = 1;
+	}
+	return ret;
+}
@@ -1,5 +1,14 @@
 /*
  *  This small demo sends a simple sinusoidal wave to your speakers.
+ *
+ *  With -B SECS it is a benchmark of the transfer methods instead: each
+ *  method (all of them with -m all) runs for SECS seconds and one CSV
+ *  record is printed with the CPU usage, the wakeups (voluntary context
+ *  switches) per second, the xruns and the distribution of the time
+ *  spent in the transfer calls.  -T plays to a null PCM which consumes
+ *  the samples in real time, for measuring the library alone:
+ *
+ *	pcm -B 5 -m all -T -p 10000 -b 40000
  */
 
 #include <stdio.h>
@@ -10,6 +19,8 @@
 #include <getopt.h>
 #include "../include/asoundlib.h"
 #include <sys/time.h>
+#include <sys/resource.h>
+#include <time.h>
 #include <math.h>
 
 static char *device = "plughw:0,0";			/* playback device */
@@ -22,11 +33,114 @@ static double freq = 440;				/* sinusoidal wave frequency in Hz */
 static int verbose = 0;					/* verbose flag */
 static int resample = 1;				/* enable alsa-lib resampling */
 static int period_event = 0;				/* produce poll event after each period */
+static double bench_time = 0;				/* benchmark seconds per method, 0 = play */
+static int timed_null = 0;				/* benchmark against the timed null PCM */
 
 static snd_pcm_sframes_t buffer_size;
 static snd_pcm_sframes_t period_size;
 static snd_output_t *output = NULL;
 
+/*
+ *   Benchmark counters
+ */
+
+#define BENCH_BUCKETS	256
+
+static struct {
+	unsigned long long end;			/* deadline in ns */
+	unsigned long long calls;
+	unsigned long long max_ns;
+	unsigned long long hist[BENCH_BUCKETS];	/* four buckets per octave */
+	unsigned int xruns;
+} bench;
+
+static unsigned long long bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int bench_done(void)
+{
+	return bench_time > 0 && bench_now() >= bench.end;
+}
+
+static unsigned int bench_bucket(unsigned long long ns)
+{
+	unsigned int msb, b;
+
+	if (ns < 4)
+		return ns;
+	msb = 63 - __builtin_clzll(ns);
+	b = msb * 4 + ((ns >> (msb - 2)) & 3) - 4;
+	return b < BENCH_BUCKETS ? b : BENCH_BUCKETS - 1;
+}
+
+/* the largest value falling into the bucket */
+static unsigned long long bench_bucket_max(unsigned int b)
+{
+	unsigned int msb;
+
+	if (b < 4)
+		return b;
+	msb = b / 4 + 1;
+	return ((4ULL + b % 4 + 1) << (msb - 2)) - 1;
+}
+
+/* start timing a transfer call, 0 when not benchmarking */
+static inline unsigned long long bench_call(void)
+{
+	return bench_time > 0 ? bench_now() : 0;
+}
+
+static void bench_called(unsigned long long start)
+{
+	unsigned long long ns;
+
+	if (!start)
+		return;
+	ns = bench_now() - start;
+	bench.calls++;
+	bench.hist[bench_bucket(ns)]++;
+	if (ns > bench.max_ns)
+		bench.max_ns = ns;
+}
+
+static double bench_percentile(double pct)
+{
+	unsigned long long n = 0, limit = bench.calls * pct / 100.0;
+	unsigned int b;
+
+	for (b = 0; b < BENCH_BUCKETS; b++) {
+		n += bench.hist[b];
+		if (n > limit)
+			break;
+	}
+	if (b < BENCH_BUCKETS && bench_bucket_max(b) < bench.max_ns)
+		return bench_bucket_max(b) / 1000.0;
+	return bench.max_ns / 1000.0;
+}
+
+/* sleep until the benchmark is over, or a second when playing */
+static void bench_sleep(void)
+{
+	struct timespec ts;
+	unsigned long long now;
+
+	if (bench_time <= 0) {
+		sleep(1);
+		return;
+	}
+	now = bench_now();
+	if (now >= bench.end)
+		return;
+	ts.tv_sec = (bench.end - now) / 1000000000ULL;
+	ts.tv_nsec = (bench.end - now) % 1000000000ULL;
+	nanosleep(&ts, NULL);	/* interrupted by the async signals */
+}
+
 static void generate_sine(const snd_pcm_channel_area_t *areas, 
 			  snd_pcm_uframes_t offset,
 			  int count, double *_phase)
@@ -224,6 +338,7 @@ static int xrun_recovery(snd_pcm_t *handle, int err)
 	if (verbose)
 		printf("stream recovery\n");
 	if (err == -EPIPE) {	/* under-run */
+		bench.xruns++;
 		err = snd_pcm_prepare(handle);
 		if (err < 0)
 			printf("Can't recovery from underrun, prepare failed: %s\n", snd_strerror(err));
@@ -253,12 +368,14 @@ static int write_loop(snd_pcm_t *handle,
 	signed short *ptr;
 	int err, cptr;
 
-	while (1) {
+	while (!bench_done()) {
 		generate_sine(areas, 0, period_size, &phase);
 		ptr = samples;
 		cptr = period_size;
 		while (cptr > 0) {
+			unsigned long long t = bench_call();
 			err = snd_pcm_writei(handle, ptr, cptr);
+			bench_called(t);
 			if (err == -EAGAIN)
 				continue;
 			if (err < 0) {
@@ -272,6 +389,7 @@ static int write_loop(snd_pcm_t *handle,
 			cptr -= err;
 		}
 	}
+	return 0;
 }
  
 /*
@@ -318,7 +436,7 @@ static int write_and_poll_loop(snd_pcm_t *handle,
 	}
 
 	init = 1;
-	while (1) {
+	while (!bench_done()) {
 		if (!init) {
 			err = wait_for_poll(handle, ufds, count);
 			if (err < 0) {
@@ -341,7 +459,9 @@ static int write_and_poll_loop(snd_pcm_t *handle,
 		ptr = samples;
 		cptr = period_size;
 		while (cptr > 0) {
+			unsigned long long t = bench_call();
 			err = snd_pcm_writei(handle, ptr, cptr);
+			bench_called(t);
 			if (err < 0) {
 				if (xrun_recovery(handle, err) < 0) {
 					printf("Write error: %s\n", snd_strerror(err));
@@ -375,6 +495,8 @@ static int write_and_poll_loop(snd_pcm_t *handle,
 			}
 		}
 	}
+	free(ufds);
+	return 0;
 }
 
 /*
@@ -398,8 +520,11 @@ static void async_callback(snd_async_handler_t *ahandler)
 	
 	avail = snd_pcm_avail_update(handle);
 	while (avail >= period_size) {
+		unsigned long long t;
 		generate_sine(areas, 0, period_size, &data->phase);
+		t = bench_call();
 		err = snd_pcm_writei(handle, samples, period_size);
+		bench_called(t);
 		if (err < 0) {
 			printf("Write error: %s\n", snd_strerror(err));
 			exit(EXIT_FAILURE);
@@ -426,7 +551,7 @@ static int async_loop(snd_pcm_t *handle,
 	err = snd_async_add_pcm_handler(&ahandler, handle, async_callback, &data);
 	if (err < 0) {
 		printf("Unable to register async handler\n");
-		exit(EXIT_FAILURE);
+		return err;
 	}
 	for (count = 0; count < 2; count++) {
 		generate_sine(areas, 0, period_size, &data.phase);
@@ -450,9 +575,10 @@ static int async_loop(snd_pcm_t *handle,
 
 	/* because all other work is done in the signal handler,
 	   suspend the process */
-	while (1) {
-		sleep(1);
-	}
+	while (!bench_done())
+		bench_sleep();
+	snd_async_del_handler(ahandler);
+	return 0;
 }
 
 /*
@@ -467,6 +593,7 @@ static void async_direct_callback(snd_async_handler_t *ahandler)
 	snd_pcm_uframes_t offset, frames, size;
 	snd_pcm_sframes_t avail, commitres;
 	snd_pcm_state_t state;
+	unsigned long long t;
 	int first = 0, err;
 	
 	while (1) {
@@ -511,7 +638,9 @@ static void async_direct_callback(snd_async_handler_t *ahandler)
 		size = period_size;
 		while (size > 0) {
 			frames = size;
+			t = bench_call();
 			err = snd_pcm_mmap_begin(handle, &my_areas, &offset, &frames);
+			bench_called(t);
 			if (err < 0) {
 				if ((err = xrun_recovery(handle, err)) < 0) {
 					printf("MMAP begin avail error: %s\n", snd_strerror(err));
@@ -520,7 +649,9 @@ static void async_direct_callback(snd_async_handler_t *ahandler)
 				first = 1;
 			}
 			generate_sine(my_areas, offset, frames, &data->phase);
+			t = bench_call();
 			commitres = snd_pcm_mmap_commit(handle, offset, frames);
+			bench_called(t);
 			if (commitres < 0 || (snd_pcm_uframes_t)commitres != frames) {
 				if ((err = xrun_recovery(handle, commitres >= 0 ? -EPIPE : commitres)) < 0) {
 					printf("MMAP commit error: %s\n", snd_strerror(err));
@@ -550,7 +681,7 @@ static int async_direct_loop(snd_pcm_t *handle,
 	err = snd_async_add_pcm_handler(&ahandler, handle, async_direct_callback, &data);
 	if (err < 0) {
 		printf("Unable to register async handler\n");
-		exit(EXIT_FAILURE);
+		return err;
 	}
 	for (count = 0; count < 2; count++) {
 		size = period_size;
@@ -582,9 +713,10 @@ static int async_direct_loop(snd_pcm_t *handle,
 
 	/* because all other work is done in the signal handler,
 	   suspend the process */
-	while (1) {
-		sleep(1);
-	}
+	while (!bench_done())
+		bench_sleep();
+	snd_async_del_handler(ahandler);
+	return 0;
 }
 
 /*
@@ -600,9 +732,10 @@ static int direct_loop(snd_pcm_t *handle,
 	snd_pcm_uframes_t offset, frames, size;
 	snd_pcm_sframes_t avail, commitres;
 	snd_pcm_state_t state;
+	unsigned long long t;
 	int err, first = 1;
 
-	while (1) {
+	while (!bench_done()) {
 		state = snd_pcm_state(handle);
 		if (state == SND_PCM_STATE_XRUN) {
 			err = xrun_recovery(handle, -EPIPE);
@@ -651,7 +784,9 @@ static int direct_loop(snd_pcm_t *handle,
 		size = period_size;
 		while (size > 0) {
 			frames = size;
+			t = bench_call();
 			err = snd_pcm_mmap_begin(handle, &my_areas, &offset, &frames);
+			bench_called(t);
 			if (err < 0) {
 				if ((err = xrun_recovery(handle, err)) < 0) {
 					printf("MMAP begin avail error: %s\n", snd_strerror(err));
@@ -660,7 +795,9 @@ static int direct_loop(snd_pcm_t *handle,
 				first = 1;
 			}
 			generate_sine(my_areas, offset, frames, &phase);
+			t = bench_call();
 			commitres = snd_pcm_mmap_commit(handle, offset, frames);
+			bench_called(t);
 			if (commitres < 0 || (snd_pcm_uframes_t)commitres != frames) {
 				if ((err = xrun_recovery(handle, commitres >= 0 ? -EPIPE : commitres)) < 0) {
 					printf("MMAP commit error: %s\n", snd_strerror(err));
@@ -671,6 +808,7 @@ static int direct_loop(snd_pcm_t *handle,
 			size -= frames;
 		}
 	}
+	return 0;
 }
  
 /*
@@ -685,12 +823,14 @@ static int direct_write_loop(snd_pcm_t *handle,
 	signed short *ptr;
 	int err, cptr;
 
-	while (1) {
+	while (!bench_done()) {
 		generate_sine(areas, 0, period_size, &phase);
 		ptr = samples;
 		cptr = period_size;
 		while (cptr > 0) {
+			unsigned long long t = bench_call();
 			err = snd_pcm_mmap_writei(handle, ptr, cptr);
+			bench_called(t);
 			if (err == -EAGAIN)
 				continue;
 			if (err < 0) {
@@ -704,6 +844,7 @@ static int direct_write_loop(snd_pcm_t *handle,
 			cptr -= err;
 		}
 	}
+	return 0;
 }
  
 /*
@@ -746,6 +887,8 @@ static void help(void)
 "-v,--verbose   show the PCM setup parameters\n"
 "-n,--noresample  do not resample\n"
 "-e,--pevent    enable poll event after each period\n"
+"-B,--bench     benchmark each method for the given seconds\n"
+"-T,--timed-null  benchmark against a null PCM running in real time\n"
 "\n");
         printf("Recognized sample formats are:");
         for (k = 0; k < SND_PCM_FORMAT_LAST; ++k) {
@@ -757,7 +900,117 @@ static void help(void)
         printf("Recognized transfer methods are:");
         for (k = 0; transfer_methods[k].name; k++)
         	printf(" %s", transfer_methods[k].name);
-	printf("\n");
+	printf(" (all, with -B)\n");
+}
+
+static int open_pcm(snd_pcm_t **handle)
+{
+	static const char conf[] =
+		"pcm.pcm_bench_null { type null timed true }\n";
+	snd_config_t *top;
+	snd_input_t *in;
+	int err;
+
+	if (!timed_null)
+		return snd_pcm_open(handle, device, SND_PCM_STREAM_PLAYBACK, 0);
+	err = snd_config_update();
+	if (err < 0)
+		return err;
+	err = snd_config_copy(&top, snd_config);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&in, conf, -1);
+	if (err >= 0) {
+		err = snd_config_load(top, in);
+		snd_input_close(in);
+	}
+	if (err >= 0)
+		err = snd_pcm_open_lconf(handle, "pcm_bench_null",
+					 SND_PCM_STREAM_PLAYBACK, 0, top);
+	snd_config_delete(top);
+	return err;
+}
+
+static void bench_report(int method, unsigned long long start,
+			 const struct rusage *ru0)
+{
+	struct rusage ru1;
+	double secs, cpu;
+
+	getrusage(RUSAGE_SELF, &ru1);
+	secs = (bench_now() - start) / 1e9;
+	cpu = (ru1.ru_utime.tv_sec - ru0->ru_utime.tv_sec) +
+	      (ru1.ru_utime.tv_usec - ru0->ru_utime.tv_usec) / 1e6 +
+	      (ru1.ru_stime.tv_sec - ru0->ru_stime.tv_sec) +
+	      (ru1.ru_stime.tv_usec - ru0->ru_stime.tv_usec) / 1e6;
+	printf("%s,%.2f,%.2f,%.1f,%u,%llu,%.1f,%.1f,%.1f,%.1f\n",
+	       transfer_methods[method].name, secs, 100.0 * cpu / secs,
+	       (ru1.ru_nvcsw - ru0->ru_nvcsw) / secs, bench.xruns, bench.calls,
+	       bench_percentile(50), bench_percentile(90),
+	       bench_percentile(99), bench.max_ns / 1000.0);
+	fflush(stdout);
+}
+
+static int run_method(int method, snd_pcm_hw_params_t *hwparams,
+		      snd_pcm_sw_params_t *swparams)
+{
+	snd_pcm_t *handle;
+	signed short *samples;
+	snd_pcm_channel_area_t *areas;
+	unsigned long long start;
+	struct rusage ru0;
+	unsigned int chn;
+	int err;
+
+	if ((err = open_pcm(&handle)) < 0) {
+		printf("Playback open error: %s\n", snd_strerror(err));
+		return err;
+	}
+	
+	if ((err = set_hwparams(handle, hwparams, transfer_methods[method].access)) < 0) {
+		printf("Setting of hwparams failed: %s\n", snd_strerror(err));
+		exit(EXIT_FAILURE);
+	}
+	if ((err = set_swparams(handle, swparams)) < 0) {
+		printf("Setting of swparams failed: %s\n", snd_strerror(err));
+		exit(EXIT_FAILURE);
+	}
+
+	if (verbose > 0)
+		snd_pcm_dump(handle, output);
+
+	samples = malloc((period_size * channels * snd_pcm_format_physical_width(format)) / 8);
+	if (samples == NULL) {
+		printf("No enough memory\n");
+		exit(EXIT_FAILURE);
+	}
+	
+	areas = calloc(channels, sizeof(snd_pcm_channel_area_t));
+	if (areas == NULL) {
+		printf("No enough memory\n");
+		exit(EXIT_FAILURE);
+	}
+	for (chn = 0; chn < channels; chn++) {
+		areas[chn].addr = samples;
+		areas[chn].first = chn * snd_pcm_format_physical_width(format);
+		areas[chn].step = channels * snd_pcm_format_physical_width(format);
+	}
+
+	memset(&bench, 0, sizeof(bench));
+	getrusage(RUSAGE_SELF, &ru0);
+	start = bench_now();
+	bench.end = start + bench_time * 1e9;
+	err = transfer_methods[method].transfer_loop(handle, samples, areas);
+	if (err < 0)
+		printf("Transfer failed: %s\n", snd_strerror(err));
+	else if (bench_time > 0)
+		bench_report(method, start, &ru0);
+
+	snd_pcm_drop(handle);
+	free(areas);
+	free(samples);
+	snd_pcm_close(handle);
+	return err;
 }
 
 int main(int argc, char *argv[])
@@ -776,16 +1029,14 @@ int main(int argc, char *argv[])
 		{"verbose", 1, NULL, 'v'},
 		{"noresample", 1, NULL, 'n'},
 		{"pevent", 1, NULL, 'e'},
+		{"bench", 1, NULL, 'B'},
+		{"timed-null", 0, NULL, 'T'},
 		{NULL, 0, NULL, 0},
 	};
-	snd_pcm_t *handle;
 	int err, morehelp;
 	snd_pcm_hw_params_t *hwparams;
 	snd_pcm_sw_params_t *swparams;
 	int method = 0;
-	signed short *samples;
-	unsigned int chn;
-	snd_pcm_channel_area_t *areas;
 
 	snd_pcm_hw_params_alloca(&hwparams);
 	snd_pcm_sw_params_alloca(&swparams);
@@ -793,7 +1044,7 @@ int main(int argc, char *argv[])
 	morehelp = 0;
 	while (1) {
 		int c;
-		if ((c = getopt_long(argc, argv, "hD:r:c:f:b:p:m:o:vne", long_option, NULL)) < 0)
+		if ((c = getopt_long(argc, argv, "hD:r:c:f:b:p:m:o:vneB:T", long_option, NULL)) < 0)
 			break;
 		switch (c) {
 		case 'h':
@@ -828,6 +1079,10 @@ int main(int argc, char *argv[])
 			period_time = period_time > 1000000 ? 1000000 : period_time;
 			break;
 		case 'm':
+			if (!strcasecmp(optarg, "all")) {
+				method = -1;
+				break;
+			}
 			for (method = 0; transfer_methods[method].name; method++)
 					if (!strcasecmp(transfer_methods[method].name, optarg))
 					break;
@@ -860,6 +1115,12 @@ int main(int argc, char *argv[])
 		case 'e':
 			period_event = 1;
 			break;
+		case 'B':
+			bench_time = atof(optarg);
+			break;
+		case 'T':
+			timed_null = 1;
+			break;
 		}
 	}
 
@@ -874,52 +1135,24 @@ int main(int argc, char *argv[])
 		return 0;
 	}
 
+	if (bench_time > 0) {
+		printf("method,seconds,cpu_percent,wakeups_per_sec,xruns,calls,"
+		       "p50_us,p90_us,p99_us,max_us\n");
+		if (method >= 0)
+			return run_method(method, hwparams, swparams) < 0;
+		for (method = 0; transfer_methods[method].name; method++)
+			run_method(method, hwparams, swparams);
+		return 0;
+	}
+	if (method < 0)
+		method = 0;
+
 	printf("Playback device is %s\n", device);
 	printf("Stream parameters are %uHz, %s, %u channels\n", rate, snd_pcm_format_name(format), channels);
 	printf("Sine wave rate is %.4fHz\n", freq);
 	printf("Using transfer method: %s\n", transfer_methods[method].name);
 
-	if ((err = snd_pcm_open(&handle, device, SND_PCM_STREAM_PLAYBACK, 0)) < 0) {
-		printf("Playback open error: %s\n", snd_strerror(err));
-		return 0;
-	}
-	
-	if ((err = set_hwparams(handle, hwparams, transfer_methods[method].access)) < 0) {
-		printf("Setting of hwparams failed: %s\n", snd_strerror(err));
-		exit(EXIT_FAILURE);
-	}
-	if ((err = set_swparams(handle, swparams)) < 0) {
-		printf("Setting of swparams failed: %s\n", snd_strerror(err));
-		exit(EXIT_FAILURE);
-	}
-
-	if (verbose > 0)
-		snd_pcm_dump(handle, output);
-
-	samples = malloc((period_size * channels * snd_pcm_format_physical_width(format)) / 8);
-	if (samples == NULL) {
-		printf("No enough memory\n");
-		exit(EXIT_FAILURE);
-	}
-	
-	areas = calloc(channels, sizeof(snd_pcm_channel_area_t));
-	if (areas == NULL) {
-		printf("No enough memory\n");
-		exit(EXIT_FAILURE);
-	}
-	for (chn = 0; chn < channels; chn++) {
-		areas[chn].addr = samples;
-		areas[chn].first = chn * snd_pcm_format_physical_width(format);
-		areas[chn].step = channels * snd_pcm_format_physical_width(format);
-	}
-
-	err = transfer_methods[method].transfer_loop(handle, samples, areas);
-	if (err < 0)
-		printf("Transfer failed: %s\n", snd_strerror(err));
-
-	free(areas);
-	free(samples);
-	snd_pcm_close(handle);
+	run_method(method, hwparams, swparams);
 	return 0;
 }
 
@@ -0,0 +1,381 @@
+/*
+ *  PCM transfer plugin throughput benchmark
+ *
+ *  Runs every conversion plugin on top of the null plugin (nothing is
+ *  played, the null plugin only moves its pointers) and writes the same
+ *  fixed workload through it with snd_pcm_writei(): -n periods of -p
+ *  frames of a test signal.  The plugins and the client formats are:
+ *    linear   S16_LE -> S32_LE, S32_LE -> S16_LE
+ *    lfloat   S16_LE -> FLOAT_LE, FLOAT_LE -> S32_LE
+ *    route    S16_LE, S32_LE stereo cross-mix with a volume ttable
+ *    rate     S16_LE 48000 -> 44100 (default converter)
+ *    softvol  S16_LE, S32_LE (needs a card for its control element)
+ *    alaw     S16_LE -> A_LAW, A_LAW -> S16_LE
+ *    mulaw    S16_LE -> MU_LAW, MU_LAW -> S16_LE
+ *    adpcm    S16_LE -> IMA_ADPCM
+ *    iec958   S16_LE -> IEC958_SUBFRAME_LE
+ *    ladspa   FLOAT_LE through the amp_mono example plugin
+ *    plug     S16_LE 48000 -> S32_LE 44100
+ *  A case whose PCM cannot be opened (no card for softvol, no LADSPA
+ *  plugin in -L) is reported on stderr and skipped.  Each plugin, client
+ *  format and channel count is measured in frames per second and, on
+ *  x86, in TSC cycles per frame.
+ *
+ *  Example:
+ *    plugin-bench -c 1,2,8 -n 500 -j
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <math.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+#include "../include/asoundlib.h"
+#include "bench.h"
+
+#define MAX_CHANNELS	32
+
+struct bench_case {
+	const char *plugin;
+	const char *pcm;		/* definition name in conf[] */
+	snd_pcm_format_t format;	/* client format */
+	unsigned int channels;		/* fixed channel count or 0 */
+};
+
+static const struct bench_case cases[] = {
+	{ "linear", "plugin_bench_linear32", SND_PCM_FORMAT_S16_LE, 0 },
+	{ "linear", "plugin_bench_linear16", SND_PCM_FORMAT_S32_LE, 0 },
+	{ "lfloat", "plugin_bench_lfloat", SND_PCM_FORMAT_S16_LE, 0 },
+	{ "lfloat", "plugin_bench_lfloat_int", SND_PCM_FORMAT_FLOAT_LE, 0 },
+	{ "route", "plugin_bench_route", SND_PCM_FORMAT_S16_LE, 2 },
+	{ "route", "plugin_bench_route", SND_PCM_FORMAT_S32_LE, 2 },
+	{ "rate", "plugin_bench_rate", SND_PCM_FORMAT_S16_LE, 0 },
+	{ "softvol", "plugin_bench_softvol", SND_PCM_FORMAT_S16_LE, 0 },
+	{ "softvol", "plugin_bench_softvol", SND_PCM_FORMAT_S32_LE, 0 },
+	{ "alaw", "plugin_bench_alaw", SND_PCM_FORMAT_S16_LE, 0 },
+	{ "alaw", "plugin_bench_alaw_dec", SND_PCM_FORMAT_A_LAW, 0 },
+	{ "mulaw", "plugin_bench_mulaw", SND_PCM_FORMAT_S16_LE, 0 },
+	{ "mulaw", "plugin_bench_mulaw_dec", SND_PCM_FORMAT_MU_LAW, 0 },
+	{ "adpcm", "plugin_bench_adpcm", SND_PCM_FORMAT_S16_LE, 0 },
+	{ "iec958", "plugin_bench_iec958", SND_PCM_FORMAT_S16_LE, 0 },
+	{ "ladspa", "plugin_bench_ladspa", SND_PCM_FORMAT_FLOAT_LE, 0 },
+	{ "plug", "plugin_bench_plug", SND_PCM_FORMAT_S16_LE, 0 },
+};
+
+static const char conf[] =
+	"pcm.plugin_bench_null {\n"
+	"	type null\n"
+	"}\n"
+	"pcm.plugin_bench_linear32 {\n"
+	"	type linear\n"
+	"	slave { pcm plugin_bench_null format S32_LE }\n"
+	"}\n"
+	"pcm.plugin_bench_linear16 {\n"
+	"	type linear\n"
+	"	slave { pcm plugin_bench_null format S16_LE }\n"
+	"}\n"
+	"pcm.plugin_bench_lfloat {\n"
+	"	type lfloat\n"
+	"	slave { pcm plugin_bench_null format FLOAT_LE }\n"
+	"}\n"
+	"pcm.plugin_bench_lfloat_int {\n"
+	"	type lfloat\n"
+	"	slave { pcm plugin_bench_null format S32_LE }\n"
+	"}\n"
+	"pcm.plugin_bench_route {\n"
+	"	type route\n"
+	"	slave { pcm plugin_bench_null channels 2 }\n"
+	"	ttable.0.0 0.7\n"
+	"	ttable.0.1 0.3\n"
+	"	ttable.1.0 0.3\n"
+	"	ttable.1.1 0.7\n"
+	"}\n"
+	"pcm.plugin_bench_rate {\n"
+	"	type rate\n"
+	"	slave { pcm plugin_bench_null rate 44100 }\n"
+	"}\n"
+	"pcm.plugin_bench_softvol {\n"
+	"	type softvol\n"
+	"	slave.pcm plugin_bench_null\n"
+	"	control { name \"Plugin Bench Volume\" card 0 }\n"
+	"}\n"
+	"pcm.plugin_bench_alaw {\n"
+	"	type alaw\n"
+	"	slave { pcm plugin_bench_null format A_LAW }\n"
+	"}\n"
+	"pcm.plugin_bench_alaw_dec {\n"
+	"	type alaw\n"
+	"	slave { pcm plugin_bench_null format S16_LE }\n"
+	"}\n"
+	"pcm.plugin_bench_mulaw {\n"
+	"	type mulaw\n"
+	"	slave { pcm plugin_bench_null format MU_LAW }\n"
+	"}\n"
+	"pcm.plugin_bench_mulaw_dec {\n"
+	"	type mulaw\n"
+	"	slave { pcm plugin_bench_null format S16_LE }\n"
+	"}\n"
+	"pcm.plugin_bench_adpcm {\n"
+	"	type adpcm\n"
+	"	slave { pcm plugin_bench_null format IMA_ADPCM }\n"
+	"}\n"
+	"pcm.plugin_bench_iec958 {\n"
+	"	type iec958\n"
+	"	slave { pcm plugin_bench_null format IEC958_SUBFRAME_LE }\n"
+	"}\n"
+	"pcm.plugin_bench_plug {\n"
+	"	type plug\n"
+	"	slave { pcm plugin_bench_null format S32_LE rate 44100 }\n"
+	"}\n";
+
+static unsigned int channel_counts[BENCH_MAX_LIST] = { 1, 2, 8 };
+static unsigned int num_channel_counts = 3;
+static unsigned int periods = 1000;
+static unsigned int period_size = 1024;
+static unsigned int rate = 48000;
+static const char *ladspa_path = "/usr/lib/ladspa";
+
+static unsigned long long cycles(void)
+{
+#ifdef HAVE_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static int load_config(snd_config_t **top)
+{
+	char ladspa[512];
+	snd_input_t *in;
+	int err;
+
+	err = snd_config_update();
+	if (err < 0)
+		return err;
+	err = snd_config_copy(top, snd_config);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&in, conf, -1);
+	if (err < 0)
+		return err;
+	err = snd_config_load(*top, in);
+	snd_input_close(in);
+	if (err < 0)
+		return err;
+	/* the LADSPA example amp_mono, 1.0 gain, run on every channel */
+	snprintf(ladspa, sizeof(ladspa),
+		 "pcm.plugin_bench_ladspa {\n"
+		 "	type ladspa\n"
+		 "	slave.pcm plugin_bench_null\n"
+		 "	path \"%s\"\n"
+		 "	plugins [ { label amp_mono input.controls [ 1.0 ] } ]\n"
+		 "}\n", ladspa_path);
+	err = snd_input_buffer_open(&in, ladspa, -1);
+	if (err < 0)
+		return err;
+	err = snd_config_load(*top, in);
+	snd_input_close(in);
+	return err;
+}
+
+/* one period of a 997 Hz sine, a bit below full scale */
+static void *make_signal(snd_pcm_format_t format, unsigned int channels)
+{
+	unsigned int width = snd_pcm_format_physical_width(format) / 8;
+	unsigned int frames = period_size, f, c;
+	unsigned char *buf;
+
+	if (format == SND_PCM_FORMAT_IMA_ADPCM)
+		return NULL;
+	buf = malloc((size_t)frames * channels * width);
+	if (!buf)
+		return NULL;
+	for (f = 0; f < frames; f++) {
+		double v = 0.8 * sin(2 * M_PI * 997 * f / rate);
+		for (c = 0; c < channels; c++) {
+			unsigned char *p = buf + ((size_t)f * channels + c) * width;
+			switch (format) {
+			case SND_PCM_FORMAT_S16_LE: {
+				int16_t s = v * 32767;
+				memcpy(p, &s, 2);
+				break;
+			}
+			case SND_PCM_FORMAT_S32_LE: {
+				int32_t s = v * 2147483647.0;
+				memcpy(p, &s, 4);
+				break;
+			}
+			case SND_PCM_FORMAT_FLOAT_LE: {
+				float s = v;
+				memcpy(p, &s, 4);
+				break;
+			}
+			default:
+				/* the 8 bit companded formats: any byte is valid */
+				*p = (unsigned char)(v * 127) ^ 0x55;
+				break;
+			}
+		}
+	}
+	return buf;
+}
+
+/* returns frames per second, or a negative error code */
+static double run(snd_config_t *top, const struct bench_case *bc,
+		  unsigned int channels, double *cycles_per_frame)
+{
+	snd_pcm_t *pcm;
+	void *buf;
+	unsigned long long c0, c1;
+	double t0, t1;
+	unsigned int i;
+	int err;
+
+	err = snd_pcm_open_lconf(&pcm, bc->pcm, SND_PCM_STREAM_PLAYBACK, 0, top);
+	if (err < 0)
+		return err;
+	err = snd_pcm_set_params(pcm, bc->format, SND_PCM_ACCESS_RW_INTERLEAVED,
+				 channels, rate, 1, 100000);
+	if (err < 0)
+		goto __close;
+	buf = make_signal(bc->format, channels);
+	if (!buf) {
+		err = -ENOMEM;
+		goto __close;
+	}
+	/* warm up */
+	err = snd_pcm_writei(pcm, buf, period_size);
+	if (err < 0)
+		goto __free;
+	t0 = bench_now_us();
+	c0 = cycles();
+	for (i = 0; i < periods; i++) {
+		err = snd_pcm_writei(pcm, buf, period_size);
+		if (err < 0)
+			goto __free;
+	}
+	c1 = cycles();
+	t1 = bench_now_us();
+	free(buf);
+	snd_pcm_close(pcm);
+	*cycles_per_frame = (double)(c1 - c0) / ((double)periods * period_size);
+	return (double)periods * period_size / ((t1 - t0) / 1e6);
+ __free:
+	free(buf);
+ __close:
+	snd_pcm_close(pcm);
+	return err;
+}
+
+static void print_result(const struct bench_case *bc, unsigned int channels,
+			 double fps, double cpf)
+{
+	bench_record_begin();
+	bench_field_str("plugin", bc->plugin);
+	bench_field_str("pcm", bc->pcm);
+	bench_field_str("format", snd_pcm_format_name(bc->format));
+	bench_field_uint("channels", channels);
+	bench_field_uint("frames", (unsigned long)periods * period_size);
+	bench_field_double("frames_per_s", 0, fps);
+	bench_field_double("cycles_per_frame", 2, cpf);
+	bench_record_end();
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct bench_option options[] = {
+		{"channels", 1, 'c', "comma separated channel counts (default 1,2,8)"},
+		{"periods", 1, 'n', "periods written per case (default 1000)"},
+		{"period", 1, 'p', "period size in frames (default 1024)"},
+		{"rate", 1, 'r', "client rate (default 48000)"},
+		{"plugin", 1, 'P', "run only this plugin"},
+		{"ladspa", 1, 'L', "LADSPA plugin directory (default /usr/lib/ladspa)"},
+		{NULL},
+	};
+	snd_config_t *top = NULL;
+	const char *only = NULL;
+	unsigned int i, c;
+	int opt, err, ret = 0;
+
+	while ((opt = bench_getopt(argc, argv, "plugin-bench", options)) != -1) {
+		switch (opt) {
+		case 'c':
+			num_channel_counts = bench_parse_list(optarg, channel_counts);
+			break;
+		case 'n':
+			periods = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			period_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			rate = strtoul(optarg, NULL, 0);
+			break;
+		case 'P':
+			only = optarg;
+			break;
+		case 'L':
+			ladspa_path = optarg;
+			break;
+		}
+	}
+	if (!periods || !period_size || !rate) {
+		fprintf(stderr, "invalid parameters\n");
+		return 1;
+	}
+	for (c = 0; c < num_channel_counts; c++) {
+		if (channel_counts[c] < 1 || channel_counts[c] > MAX_CHANNELS) {
+			fprintf(stderr, "invalid channel count %u\n", channel_counts[c]);
+			return 1;
+		}
+	}
+	err = load_config(&top);
+	if (err < 0) {
+		fprintf(stderr, "unable to load the configuration: %s\n", snd_strerror(err));
+		return 1;
+	}
+
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		const struct bench_case *bc = &cases[i];
+		if (only && strcmp(only, bc->plugin))
+			continue;
+		for (c = 0; c < num_channel_counts; c++) {
+			unsigned int channels = bc->channels ? bc->channels : channel_counts[c];
+			double cpf = 0, fps;
+			/* a fixed channel count is run once */
+			if (bc->channels && c > 0)
+				break;
+			fps = run(top, bc, channels, &cpf);
+			if (fps < 0) {
+				fprintf(stderr, "%s (%s, %s, %u channels) skipped: %s\n",
+					bc->plugin, bc->pcm,
+					snd_pcm_format_name(bc->format), channels,
+					snd_strerror((int)fps));
+				continue;
+			}
+			print_result(bc, channels, fps, cpf);
+		}
+	}
+	snd_config_delete(top);
+	return ret;
+}
@@ -0,0 +1,433 @@
+/*
+ *  Rawmidi benchmark
+ *
+ *  Non-interactive companion of rawmidi.c and midiloop.c: a fixed number
+ *  of SysEx messages is written to a rawmidi output and read back from
+ *  the input it is looped to, once for every combination of path,
+ *  buffer size and avail_min given on the command line.  The byte
+ *  throughput, the message latency percentiles and the jitter (mean
+ *  difference of the latencies of successive messages) are measured.
+ *
+ *  Paths:
+ *    hw     a hw rawmidi device, its output looped to its input by a
+ *           cable (as for midiloop)
+ *    virt   a virtual rawmidi (sequencer) port subscribed to itself
+ *    tread  as hw, read in the timestamped framing mode; the latency is
+ *           taken at the kernel timestamp of the bytes
+ *
+ *  Example:
+ *    rawmidi-bench -D hw:1,0 -m hw,tread,virt -b 0,64,4096 -a 1,32 -j
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "../include/asoundlib.h"
+#include "bench.h"
+
+#define MAX_MESSAGE	4096
+
+enum {
+	PATH_HW,
+	PATH_VIRT,
+	PATH_TREAD,
+};
+
+struct result {
+	unsigned long sent;
+	unsigned long received;
+	double rate;			/* received bytes per second */
+	double lat[4];			/* message p50, p95, p99, max (us) */
+	double jitter;			/* us */
+};
+
+struct receiver {
+	snd_rawmidi_t *in;
+	int tread;
+	unsigned long expected;
+	double *sent_at;		/* written by the sender */
+	double *lat;
+	unsigned long received;		/* complete messages */
+	unsigned long bytes;
+	double first, last;		/* arrival of the first and last byte */
+	int err;
+};
+
+static int paths[BENCH_MAX_LIST] = { PATH_HW };
+static unsigned int num_paths = 1;
+static unsigned int buffers[BENCH_MAX_LIST] = { 0 };
+static unsigned int num_buffers = 1;
+static unsigned int avail_mins[BENCH_MAX_LIST] = { 1 };
+static unsigned int num_avail_mins = 1;
+static unsigned long num_messages = 10000;
+static unsigned int message_size = 3;
+static unsigned int interval_us;
+static const char *device = "hw:0,0";
+
+static const char *path_name(int path)
+{
+	switch (path) {
+	case PATH_VIRT:
+		return "virt";
+	case PATH_TREAD:
+		return "tread";
+	default:
+		return "hw";
+	}
+}
+
+static int parse_path(const char *name)
+{
+	if (!strcmp(name, "hw"))
+		return PATH_HW;
+	if (!strcmp(name, "virt"))
+		return PATH_VIRT;
+	if (!strcmp(name, "tread"))
+		return PATH_TREAD;
+	return -1;
+}
+
+static double ts_us(const struct timespec *ts)
+{
+	return ts->tv_sec * 1e6 + ts->tv_nsec / 1e3;
+}
+
+/* the messages are counted by their end of exclusive bytes */
+static void receive_bytes(struct receiver *r, const unsigned char *buf,
+			  ssize_t n, double t)
+{
+	ssize_t i;
+
+	if (!r->bytes)
+		r->first = t;
+	r->last = t;
+	r->bytes += n;
+	for (i = 0; i < n; i++) {
+		if (buf[i] != 0xf7)
+			continue;
+		if (r->received < r->expected)
+			r->lat[r->received] = t - r->sent_at[r->received];
+		r->received++;
+	}
+}
+
+static void *receiver_thread(void *arg)
+{
+	struct receiver *r = arg;
+	unsigned char buf[4096];
+	struct pollfd pfds[4];
+	struct timespec ts;
+	unsigned short revents;
+	ssize_t n;
+	int npfds;
+
+	npfds = snd_rawmidi_poll_descriptors(r->in, pfds, 4);
+	while (r->received < r->expected) {
+		/* a second without bytes ends the run */
+		n = poll(pfds, npfds, 1000);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		snd_rawmidi_poll_descriptors_revents(r->in, pfds, npfds, &revents);
+		if (revents & (POLLERR | POLLHUP)) {
+			r->err = -ENODEV;
+			break;
+		}
+		if (!(revents & POLLIN))
+			continue;
+		while (1) {
+			if (r->tread) {
+				n = snd_rawmidi_tread(r->in, &ts, buf, sizeof(buf));
+				if (n > 0)
+					receive_bytes(r, buf, n, ts_us(&ts));
+			} else {
+				n = snd_rawmidi_read(r->in, buf, sizeof(buf));
+				if (n > 0)
+					receive_bytes(r, buf, n, bench_now_us());
+			}
+			if (n == -EAGAIN || n == 0)
+				break;
+			if (n < 0) {
+				r->err = n;
+				return NULL;
+			}
+		}
+	}
+	return NULL;
+}
+
+static int set_params(snd_rawmidi_t *rmidi, unsigned int buffer,
+		      unsigned int avail_min, int tread)
+{
+	snd_rawmidi_params_t *params;
+	int err;
+
+	snd_rawmidi_params_alloca(&params);
+	if ((err = snd_rawmidi_params_current(rmidi, params)) < 0)
+		return err;
+	if (buffer && (err = snd_rawmidi_params_set_buffer_size(rmidi, params, buffer)) < 0)
+		return err;
+	if ((err = snd_rawmidi_params_set_avail_min(rmidi, params, avail_min)) < 0)
+		return err;
+	if (tread) {
+		if ((err = snd_rawmidi_params_set_read_mode(rmidi, params, SND_RAWMIDI_READ_TSTAMP)) < 0 ||
+		    (err = snd_rawmidi_params_set_clock_type(rmidi, params, SND_RAWMIDI_CLOCK_MONOTONIC)) < 0)
+			return err;
+	}
+	return snd_rawmidi_params(rmidi, params);
+}
+
+/*
+ * The virtual rawmidi port is the one of the sequencer client of this
+ * process; it is subscribed to itself, so the output comes back as input.
+ */
+static int loop_virtual(snd_seq_t **seqp)
+{
+	snd_seq_client_info_t *cinfo;
+	snd_seq_port_info_t *pinfo;
+	snd_seq_port_subscribe_t *sub;
+	snd_seq_t *seq;
+	int err;
+
+	if ((err = snd_seq_open(&seq, "default", SND_SEQ_OPEN_DUPLEX, 0)) < 0)
+		return err;
+	snd_seq_client_info_alloca(&cinfo);
+	snd_seq_port_info_alloca(&pinfo);
+	snd_seq_port_subscribe_alloca(&sub);
+	snd_seq_client_info_set_client(cinfo, -1);
+	while (snd_seq_query_next_client(seq, cinfo) >= 0) {
+		if (snd_seq_client_info_get_pid(cinfo) != getpid())
+			continue;
+		snd_seq_port_info_set_client(pinfo, snd_seq_client_info_get_client(cinfo));
+		snd_seq_port_info_set_port(pinfo, -1);
+		while (snd_seq_query_next_port(seq, pinfo) >= 0) {
+			if (strcmp(snd_seq_port_info_get_name(pinfo), "Virtual RawMIDI"))
+				continue;
+			snd_seq_port_subscribe_set_sender(sub, snd_seq_port_info_get_addr(pinfo));
+			snd_seq_port_subscribe_set_dest(sub, snd_seq_port_info_get_addr(pinfo));
+			err = snd_seq_subscribe_port(seq, sub);
+			if (err < 0)
+				snd_seq_close(seq);
+			else
+				*seqp = seq;
+			return err;
+		}
+	}
+	snd_seq_close(seq);
+	return -ENOENT;
+}
+
+static int run(int path, unsigned int buffer, unsigned int avail_min,
+	       struct result *res)
+{
+	snd_rawmidi_t *out = NULL;
+	snd_seq_t *loop = NULL;
+	struct receiver rx;
+	unsigned char msg[MAX_MESSAGE];
+	struct timespec gap;
+	pthread_t thread;
+	unsigned long sent = 0, n;
+	unsigned int i;
+	ssize_t written;
+	int err, started = 0;
+
+	memset(res, 0, sizeof(*res));
+	memset(&rx, 0, sizeof(rx));
+	rx.expected = num_messages;
+	rx.tread = path == PATH_TREAD;
+	err = snd_rawmidi_open(&rx.in, &out, path == PATH_VIRT ? "virtual" : device,
+			       SND_RAWMIDI_NONBLOCK);
+	if (err < 0)
+		return err;
+	/* blocking writes, the input stays non-blocking */
+	if ((err = snd_rawmidi_nonblock(out, 0)) < 0 ||
+	    (err = set_params(out, buffer, avail_min, 0)) < 0 ||
+	    (err = set_params(rx.in, buffer, avail_min, rx.tread)) < 0)
+		goto out;
+	if (path == PATH_VIRT && (err = loop_virtual(&loop)) < 0)
+		goto out;
+	/* drop what the input collected before the run */
+	snd_rawmidi_drop(rx.in);
+
+	rx.sent_at = calloc(num_messages, sizeof(*rx.sent_at));
+	rx.lat = malloc(num_messages * sizeof(*rx.lat));
+	if (!rx.sent_at || !rx.lat) {
+		err = -ENOMEM;
+		goto out;
+	}
+	msg[0] = 0xf0;
+	msg[1] = 0x7d;			/* non-commercial id */
+	msg[message_size - 1] = 0xf7;
+	gap.tv_sec = interval_us / 1000000;
+	gap.tv_nsec = (interval_us % 1000000) * 1000;
+
+	if ((err = pthread_create(&thread, NULL, receiver_thread, &rx)) != 0) {
+		err = -err;
+		goto out;
+	}
+	started = 1;
+	for (sent = 0; sent < num_messages; sent++) {
+		for (i = 2; i + 1 < message_size; i++)
+			msg[i] = (sent + i) & 0x7f;
+		rx.sent_at[sent] = bench_now_us();
+		for (n = 0; n < message_size; n += written) {
+			written = snd_rawmidi_write(out, msg + n, message_size - n);
+			if (written < 0) {
+				err = written;
+				break;
+			}
+		}
+		if (err < 0)
+			break;
+		if (interval_us)
+			clock_nanosleep(CLOCK_MONOTONIC, 0, &gap, NULL);
+	}
+	if (err >= 0)
+		snd_rawmidi_drain(out);
+	pthread_join(thread, NULL);
+	started = 0;
+	if (err >= 0)
+		err = rx.err;
+
+	res->sent = sent;
+	res->received = rx.received;
+	if (rx.bytes > 1 && rx.last > rx.first)
+		res->rate = (rx.bytes - 1) / ((rx.last - rx.first) / 1e6);
+	n = rx.received < num_messages ? rx.received : num_messages;
+	for (i = 1; i < n; i++) {
+		double d = rx.lat[i] - rx.lat[i - 1];
+		res->jitter += d < 0 ? -d : d;
+	}
+	if (n > 1)
+		res->jitter /= n - 1;
+	bench_sort(rx.lat, n);
+	res->lat[0] = bench_percentile(rx.lat, n, 50);
+	res->lat[1] = bench_percentile(rx.lat, n, 95);
+	res->lat[2] = bench_percentile(rx.lat, n, 99);
+	res->lat[3] = n ? rx.lat[n - 1] : 0;
+ out:
+	if (started)
+		pthread_join(thread, NULL);
+	if (loop)
+		snd_seq_close(loop);
+	snd_rawmidi_close(out);
+	snd_rawmidi_close(rx.in);
+	free(rx.sent_at);
+	free(rx.lat);
+	return err;
+}
+
+static void print_result(int path, unsigned int buffer, unsigned int avail_min,
+			 int err, const struct result *res)
+{
+	bench_record_begin();
+	bench_field_str("path", path_name(path));
+	bench_field_uint("buffer", buffer);
+	bench_field_uint("avail_min", avail_min);
+	bench_field_uint("size", message_size);
+	bench_field_status(err);
+	bench_field_uint("sent", res->sent);
+	bench_field_uint("received", res->received);
+	bench_field_double("bytes_per_sec", 0, res->rate);
+	bench_field_double("lat_p50_us", 1, res->lat[0]);
+	bench_field_double("lat_p95_us", 1, res->lat[1]);
+	bench_field_double("lat_p99_us", 1, res->lat[2]);
+	bench_field_double("lat_max_us", 1, res->lat[3]);
+	bench_field_double("jitter_us", 1, res->jitter);
+	bench_record_end();
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct bench_option options[] = {
+		{"device", 1, 'D', "rawmidi device of the hw and tread paths, looped back (default hw:0,0)"},
+		{"path", 1, 'm', "comma separated paths: hw, virt, tread (default hw)"},
+		{"buffer", 1, 'b', "comma separated buffer sizes in bytes, 0 = the default (default 0)"},
+		{"avail-min", 1, 'a', "comma separated avail_min values in bytes (default 1)"},
+		{"size", 1, 's', "bytes per SysEx message, at least 3 (default 3)"},
+		{"messages", 1, 'n', "messages per run (default 10000)"},
+		{"interval", 1, 'i', "microseconds between the messages, 0 = as fast as possible (default 0)"},
+		{NULL},
+	};
+	unsigned int p, b, a;
+	int c, ret = 0;
+
+	while ((c = bench_getopt(argc, argv, "rawmidi-bench", options)) != -1) {
+		switch (c) {
+		case 'D':
+			device = optarg;
+			break;
+		case 'm': {
+			char *tmp = strdup(optarg), *tok, *save;
+			num_paths = 0;
+			for (tok = strtok_r(tmp, ",", &save); tok && num_paths < BENCH_MAX_LIST;
+			     tok = strtok_r(NULL, ",", &save)) {
+				int path = parse_path(tok);
+				if (path < 0) {
+					fprintf(stderr, "unknown path %s\n", tok);
+					return 1;
+				}
+				paths[num_paths++] = path;
+			}
+			free(tmp);
+			break;
+		}
+		case 'b':
+			num_buffers = bench_parse_list(optarg, buffers);
+			break;
+		case 'a':
+			num_avail_mins = bench_parse_list(optarg, avail_mins);
+			break;
+		case 's':
+			message_size = strtoul(optarg, NULL, 0);
+			if (message_size < 3 || message_size > MAX_MESSAGE) {
+				fprintf(stderr, "invalid message size %u\n", message_size);
+				return 1;
+			}
+			break;
+		case 'n':
+			num_messages = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			interval_us = strtoul(optarg, NULL, 0);
+			break;
+		}
+	}
+	if (!num_messages) {
+		fprintf(stderr, "no messages to send\n");
+		return 1;
+	}
+
+	for (p = 0; p < num_paths; p++)
+		for (b = 0; b < num_buffers; b++)
+			for (a = 0; a < num_avail_mins; a++) {
+				struct result res;
+				int err = run(paths[p], buffers[b], avail_mins[a], &res);
+				print_result(paths[p], buffers[b], avail_mins[a], err, &res);
+				if (err < 0 || res.received < res.sent)
+					ret = 1;
+			}
+	return ret;
+}
@@ -0,0 +1,311 @@
+/*
+ *  PCM hardware parameter negotiation benchmark
+ *
+ *  Opens a few representative plugin chains on top of the null plugin
+ *  (nothing is played) and repeats the parameter negotiation which
+ *  snd_pcm_set_params() does: refine the space with the requested
+ *  access, format, channels, rate, buffer and period time, then choose and
+ *  install one configuration with snd_pcm_hw_params().  The chains are:
+ *    null   the null plugin alone
+ *    plug   plug with format and rate conversion to the null plugin
+ *    deep   plug -> rate -> route -> linear -> copy -> null
+ *  The time per negotiation is measured for every chain.
+ *
+ *  With -m the memory per handle is reported instead: -n handles of
+ *  every chain are kept open at once, and the heap growth per handle is
+ *  printed after the open, after an info query and a parameter space
+ *  query (snd_pcm_hw_params_any()), and after the setup.
+ *
+ *  Example:
+ *    refine-bench -n 2000 -j
+ *    refine-bench -m -n 500
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <malloc.h>
+#include "../include/asoundlib.h"
+#include "bench.h"
+
+static const char *const chains[] = { "null", "plug", "deep" };
+
+static const char conf[] =
+	"pcm.refine_bench_null {\n"
+	"	type null\n"
+	"}\n"
+	"pcm.refine_bench_plug {\n"
+	"	type plug\n"
+	"	slave { pcm refine_bench_null format S32_LE rate 44100 }\n"
+	"}\n"
+	"pcm.refine_bench_deep {\n"
+	"	type plug\n"
+	"	slave { pcm refine_bench_rate format S32_LE channels 4 }\n"
+	"}\n"
+	"pcm.refine_bench_rate {\n"
+	"	type rate\n"
+	"	slave { pcm refine_bench_route rate 44100 }\n"
+	"}\n"
+	"pcm.refine_bench_route {\n"
+	"	type route\n"
+	"	slave { pcm refine_bench_linear channels 4 }\n"
+	"	ttable.0.0 1\n"
+	"	ttable.1.1 1\n"
+	"	ttable.0.2 1\n"
+	"	ttable.1.3 1\n"
+	"}\n"
+	"pcm.refine_bench_linear {\n"
+	"	type linear\n"
+	"	slave { pcm refine_bench_copy format S16_LE }\n"
+	"}\n"
+	"pcm.refine_bench_copy {\n"
+	"	type copy\n"
+	"	slave.pcm refine_bench_null\n"
+	"}\n";
+
+static unsigned int iterations = 1000;
+static unsigned int rate = 48000;
+static unsigned int channels = 2;
+static int memory;
+
+static int load_config(snd_config_t **top)
+{
+	snd_input_t *in;
+	int err;
+
+	err = snd_config_update();
+	if (err < 0)
+		return err;
+	err = snd_config_copy(top, snd_config);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&in, conf, -1);
+	if (err < 0)
+		return err;
+	err = snd_config_load(*top, in);
+	snd_input_close(in);
+	return err;
+}
+
+/* the same steps as snd_pcm_set_params() */
+static int negotiate(snd_pcm_t *pcm, snd_pcm_hw_params_t *hw)
+{
+	unsigned int buffer_time = 100000;
+	unsigned int period_time = buffer_time / 4;
+	unsigned int val = rate;
+	int err;
+
+	err = snd_pcm_hw_params_any(pcm, hw);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_access(pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_format(pcm, hw, SND_PCM_FORMAT_S16_LE);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_channels(pcm, hw, channels);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_rate_near(pcm, hw, &val, 0);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_buffer_time_near(pcm, hw, &buffer_time, NULL);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_period_time_near(pcm, hw, &period_time, NULL);
+	if (err < 0)
+		return err;
+	return snd_pcm_hw_params(pcm, hw);
+}
+
+/* returns the time per negotiation in us, or a negative error code */
+static double run(snd_config_t *top, const char *chain)
+{
+	snd_pcm_hw_params_t *hw;
+	snd_pcm_t *pcm;
+	char name[64];
+	double t0, t1;
+	unsigned int i;
+	int err;
+
+	snd_pcm_hw_params_alloca(&hw);
+	snprintf(name, sizeof(name), "refine_bench_%s", chain);
+	err = snd_pcm_open_lconf(&pcm, name, SND_PCM_STREAM_PLAYBACK, 0, top);
+	if (err < 0)
+		return err;
+	/* warm up */
+	err = negotiate(pcm, hw);
+	if (err < 0)
+		goto __close;
+	t0 = bench_now_us();
+	for (i = 0; i < iterations; i++) {
+		err = negotiate(pcm, hw);
+		if (err < 0)
+			goto __close;
+	}
+	t1 = bench_now_us();
+	snd_pcm_close(pcm);
+	return (t1 - t0) / iterations;
+ __close:
+	snd_pcm_close(pcm);
+	return err;
+}
+
+static size_t heap_used(void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+	return mallinfo2().uordblks;
+#else
+	return (unsigned int)mallinfo().uordblks;
+#endif
+}
+
+/* bytes per handle after open, query and setup */
+static int run_memory(snd_config_t *top, const char *chain, long bytes[3])
+{
+	snd_pcm_hw_params_t *hw;
+	snd_pcm_info_t *info;
+	snd_pcm_t **pcms;
+	char name[64];
+	size_t base, used[3];
+	unsigned int i, n = 0;
+	int err = 0;
+
+	snd_pcm_hw_params_alloca(&hw);
+	snd_pcm_info_alloca(&info);
+	snprintf(name, sizeof(name), "refine_bench_%s", chain);
+	pcms = calloc(iterations, sizeof(*pcms));
+	if (!pcms)
+		return -ENOMEM;
+	base = heap_used();
+	for (n = 0; n < iterations; n++) {
+		err = snd_pcm_open_lconf(&pcms[n], name, SND_PCM_STREAM_PLAYBACK, 0, top);
+		if (err < 0)
+			goto __close;
+	}
+	used[0] = heap_used();
+	for (i = 0; i < n; i++) {
+		err = snd_pcm_info(pcms[i], info);
+		if (err >= 0)
+			err = snd_pcm_hw_params_any(pcms[i], hw);
+		if (err < 0)
+			goto __close;
+	}
+	used[1] = heap_used();
+	for (i = 0; i < n; i++) {
+		err = negotiate(pcms[i], hw);
+		if (err < 0)
+			goto __close;
+	}
+	used[2] = heap_used();
+	for (i = 0; i < 3; i++)
+		bytes[i] = ((long)used[i] - (long)base) / (long)n;
+ __close:
+	while (n > 0)
+		snd_pcm_close(pcms[--n]);
+	free(pcms);
+	return err < 0 ? err : 0;
+}
+
+static void print_memory(const char *chain, const long bytes[3])
+{
+	bench_record_begin();
+	bench_field_str("chain", chain);
+	bench_field_uint("handles", iterations);
+	bench_field_int("bytes_open", bytes[0]);
+	bench_field_int("bytes_query", bytes[1]);
+	bench_field_int("bytes_setup", bytes[2]);
+	bench_record_end();
+}
+
+static void print_result(const char *chain, double us)
+{
+	bench_record_begin();
+	bench_field_str("chain", chain);
+	bench_field_uint("iterations", iterations);
+	bench_field_double("us_per_negotiation", 2, us);
+	bench_record_end();
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct bench_option options[] = {
+		{"count", 1, 'n', "negotiations (or handles with -m) per chain (default 1000)"},
+		{"rate", 1, 'r', "requested rate (default 48000)"},
+		{"channels", 1, 'c', "requested channels (default 2)"},
+		{"memory", 0, 'm', "report the heap used per open handle"},
+		{NULL},
+	};
+	snd_config_t *top = NULL;
+	unsigned int c;
+	int opt, err, ret = 0;
+
+	while ((opt = bench_getopt(argc, argv, "refine-bench", options)) != -1) {
+		switch (opt) {
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			rate = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			channels = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			memory = 1;
+			break;
+		}
+	}
+	if (!iterations || !rate || !channels) {
+		fprintf(stderr, "invalid parameters\n");
+		return 1;
+	}
+	err = load_config(&top);
+	if (err < 0) {
+		fprintf(stderr, "unable to load the configuration: %s\n", snd_strerror(err));
+		return 1;
+	}
+
+	for (c = 0; c < sizeof(chains) / sizeof(chains[0]); c++) {
+		double us;
+
+		if (memory) {
+			long bytes[3];
+
+			err = run_memory(top, chains[c], bytes);
+			if (err < 0) {
+				fprintf(stderr, "%s: %s\n", chains[c], snd_strerror(err));
+				ret = 1;
+				continue;
+			}
+			print_memory(chains[c], bytes);
+			continue;
+		}
+		us = run(top, chains[c]);
+		if (us < 0) {
+			fprintf(stderr, "%s: %s\n", chains[c], snd_strerror((int)us));
+			ret = 1;
+			continue;
+		}
+		print_result(chains[c], us);
+	}
+	snd_config_delete(top);
+	return ret;
+}
@@ -0,0 +1,423 @@
+/*
+ *  Sequencer benchmark
+ *
+ *  Non-interactive companion of seq.c and seq-sender.c: a sender and a
+ *  receiver client, each with its own handle, are connected through the
+ *  hw sequencer and the sender pushes a fixed number of events to the
+ *  receiver, once for every combination of delivery mode, payload size
+ *  and burst size given on the command line.  The events per second and
+ *  the delivery latency percentiles are measured.
+ *
+ *  Delivery modes:
+ *    direct  events are delivered directly, without a queue
+ *    tick    events are scheduled on a queue at the current tick
+ *    real    events are scheduled on a queue at the current real time
+ *
+ *  A payload size above zero sends variable length (SysEx) events with so
+ *  many bytes, e.g. -P 16 for the size of the largest UMP packet.
+ *
+ *  Example:
+ *    seq-bench -m direct,tick,real -P 0,16,256 -b 1,64 -e 200000 -j
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include "../include/asoundlib.h"
+#include "bench.h"
+
+#define MAX_BURST	4096
+
+enum {
+	MODE_DIRECT,
+	MODE_TICK,
+	MODE_REAL,
+};
+
+struct result {
+	unsigned long sent;
+	unsigned long received;
+	double rate;			/* received events per second */
+	double lat[4];			/* delivery p50, p95, p99, max (us) */
+};
+
+struct receiver {
+	snd_seq_t *seq;
+	unsigned long expected;
+	double *lat;
+	unsigned long received;
+	double first, last;		/* arrival of the first and last event */
+	int err;
+};
+
+static int modes[BENCH_MAX_LIST] = { MODE_DIRECT };
+static unsigned int num_modes = 1;
+static unsigned int payloads[BENCH_MAX_LIST] = { 0 };
+static unsigned int num_payloads = 1;
+static unsigned int bursts[BENCH_MAX_LIST] = { 1 };
+static unsigned int num_bursts = 1;
+static unsigned long num_events = 100000;
+static const char *seq_name = "hw";
+static int use_multi;			/* snd_seq_event_output_multi() */
+static int use_batch;			/* snd_seq_event_input_batch() */
+
+static const char *mode_name(int mode)
+{
+	switch (mode) {
+	case MODE_TICK:
+		return "tick";
+	case MODE_REAL:
+		return "real";
+	default:
+		return "direct";
+	}
+}
+
+static int parse_mode(const char *name)
+{
+	if (!strcmp(name, "direct"))
+		return MODE_DIRECT;
+	if (!strcmp(name, "tick"))
+		return MODE_TICK;
+	if (!strcmp(name, "real"))
+		return MODE_REAL;
+	return -1;
+}
+
+/* the send time travels in the event itself, or in its payload */
+static void put_stamp(snd_seq_event_t *ev, double t)
+{
+	if (snd_seq_ev_is_variable(ev))
+		memcpy(ev->data.ext.ptr, &t, sizeof(t));
+	else
+		memcpy(ev->data.raw8.d, &t, sizeof(t));
+}
+
+static double get_stamp(const snd_seq_event_t *ev)
+{
+	double t;
+
+	if (snd_seq_ev_is_variable(ev))
+		memcpy(&t, ev->data.ext.ptr, sizeof(t));
+	else
+		memcpy(&t, ev->data.raw8.d, sizeof(t));
+	return t;
+}
+
+static void receive_event(struct receiver *r, const snd_seq_event_t *ev, double t)
+{
+	if (ev->type != SND_SEQ_EVENT_SYSEX && ev->type != SND_SEQ_EVENT_USR0)
+		return;
+	if (!r->received)
+		r->first = t;
+	r->last = t;
+	if (r->received < r->expected)
+		r->lat[r->received] = t - get_stamp(ev);
+	r->received++;
+}
+
+static void *receiver_thread(void *arg)
+{
+	struct receiver *r = arg;
+	snd_seq_event_t *evs[MAX_BURST];
+	struct pollfd pfd;
+	double t;
+	int i, n;
+
+	snd_seq_poll_descriptors(r->seq, &pfd, 1, POLLIN);
+	while (r->received < r->expected) {
+		/* a second without events ends the run */
+		n = poll(&pfd, 1, 1000);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		do {
+			if (use_batch) {
+				n = snd_seq_event_input_batch(r->seq, evs, MAX_BURST);
+			} else {
+				n = snd_seq_event_input(r->seq, &evs[0]);
+				if (n >= 0)
+					n = 1;
+			}
+			if (n == -ENOSPC) {
+				r->err = n;
+				return NULL;
+			}
+			if (n < 0)
+				break;
+			t = bench_now_us();
+			for (i = 0; i < n; i++)
+				receive_event(r, evs[i], t);
+		} while (snd_seq_event_input_pending(r->seq, 0) > 0);
+	}
+	return NULL;
+}
+
+static int open_client(snd_seq_t **seq, int streams, const char *name,
+		       unsigned int caps)
+{
+	int err, port;
+
+	if ((err = snd_seq_open(seq, seq_name, streams, 0)) < 0)
+		return err;
+	snd_seq_set_client_name(*seq, name);
+	port = snd_seq_create_simple_port(*seq, name, caps,
+					  SND_SEQ_PORT_TYPE_MIDI_GENERIC |
+					  SND_SEQ_PORT_TYPE_APPLICATION);
+	if (port < 0) {
+		snd_seq_close(*seq);
+		*seq = NULL;
+		return port;
+	}
+	return port;
+}
+
+static int send_events(snd_seq_t *seq, snd_seq_event_t *evs, unsigned int n)
+{
+	unsigned int i;
+	int err;
+
+	if (use_multi) {
+		unsigned int done = 0;
+		while (done < n) {
+			err = snd_seq_event_output_multi(seq, evs + done, n - done);
+			if (err < 0)
+				return err;
+			done += err;
+		}
+		return 0;
+	}
+	for (i = 0; i < n; i++)
+		if ((err = snd_seq_event_output(seq, &evs[i])) < 0)
+			return err;
+	err = snd_seq_drain_output(seq);
+	return err < 0 ? err : 0;
+}
+
+static int run(int mode, unsigned int payload, unsigned int burst,
+	       struct result *res)
+{
+	snd_seq_t *tx = NULL;
+	struct receiver rx;
+	snd_seq_event_t *evs = NULL;
+	unsigned char *data = NULL;
+	snd_seq_real_time_t zero = { 0, 0 };
+	pthread_t thread;
+	int err, tx_port, rx_port, queue = -1, started = 0;
+	unsigned long sent = 0;
+	unsigned int i, n;
+
+	memset(res, 0, sizeof(*res));
+	memset(&rx, 0, sizeof(rx));
+	/* room for the send time */
+	if (payload && payload < sizeof(double))
+		payload = sizeof(double);
+	rx.expected = num_events;
+	rx_port = open_client(&rx.seq, SND_SEQ_OPEN_INPUT, "seq-bench receiver",
+			      SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE);
+	if (rx_port < 0)
+		return rx_port;
+	tx_port = open_client(&tx, SND_SEQ_OPEN_OUTPUT, "seq-bench sender",
+			      SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ);
+	if (tx_port < 0) {
+		err = tx_port;
+		goto out;
+	}
+	if ((err = snd_seq_nonblock(rx.seq, 1)) < 0 ||
+	    (err = snd_seq_connect_to(tx, tx_port, snd_seq_client_id(rx.seq), rx_port)) < 0)
+		goto out;
+	if (mode != MODE_DIRECT) {
+		if ((queue = snd_seq_alloc_queue(tx)) < 0) {
+			err = queue;
+			goto out;
+		}
+		if ((err = snd_seq_start_queue(tx, queue, NULL)) < 0 ||
+		    (err = snd_seq_drain_output(tx)) < 0)
+			goto out;
+	}
+
+	rx.lat = malloc(num_events * sizeof(*rx.lat));
+	evs = calloc(burst, sizeof(*evs));
+	if (payload)
+		data = calloc(burst, payload);
+	if (!rx.lat || !evs || (payload && !data)) {
+		err = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < burst; i++) {
+		snd_seq_event_t *ev = &evs[i];
+		snd_seq_ev_clear(ev);
+		snd_seq_ev_set_source(ev, tx_port);
+		snd_seq_ev_set_subs(ev);
+		if (payload) {
+			ev->type = SND_SEQ_EVENT_SYSEX;
+			snd_seq_ev_set_variable(ev, payload, data + (size_t)i * payload);
+		} else {
+			ev->type = SND_SEQ_EVENT_USR0;
+		}
+		if (mode == MODE_TICK)
+			snd_seq_ev_schedule_tick(ev, queue, 1, 0);
+		else if (mode == MODE_REAL)
+			snd_seq_ev_schedule_real(ev, queue, 1, &zero);
+		else
+			snd_seq_ev_set_direct(ev);
+	}
+
+	if ((err = pthread_create(&thread, NULL, receiver_thread, &rx)) != 0) {
+		err = -err;
+		goto out;
+	}
+	started = 1;
+	while (sent < num_events) {
+		double t = bench_now_us();
+		n = num_events - sent < burst ? num_events - sent : burst;
+		for (i = 0; i < n; i++)
+			put_stamp(&evs[i], t);
+		if ((err = send_events(tx, evs, n)) < 0)
+			break;
+		sent += n;
+	}
+	pthread_join(thread, NULL);
+	started = 0;
+	if (err >= 0)
+		err = rx.err;
+
+	res->sent = sent;
+	res->received = rx.received;
+	if (rx.received > 1 && rx.last > rx.first)
+		res->rate = (rx.received - 1) / ((rx.last - rx.first) / 1e6);
+	n = rx.received < num_events ? rx.received : num_events;
+	bench_sort(rx.lat, n);
+	res->lat[0] = bench_percentile(rx.lat, n, 50);
+	res->lat[1] = bench_percentile(rx.lat, n, 95);
+	res->lat[2] = bench_percentile(rx.lat, n, 99);
+	res->lat[3] = n ? rx.lat[n - 1] : 0;
+ out:
+	if (started)
+		pthread_join(thread, NULL);
+	if (tx) {
+		if (queue >= 0)
+			snd_seq_free_queue(tx, queue);
+		snd_seq_close(tx);
+	}
+	snd_seq_close(rx.seq);
+	free(rx.lat);
+	free(evs);
+	free(data);
+	return err;
+}
+
+static void print_result(int mode, unsigned int payload, unsigned int burst,
+			 int err, const struct result *res)
+{
+	bench_record_begin();
+	bench_field_str("mode", mode_name(mode));
+	bench_field_uint("payload", payload);
+	bench_field_uint("burst", burst);
+	bench_field_str("output", use_multi ? "multi" : "buffer");
+	bench_field_str("input", use_batch ? "batch" : "single");
+	bench_field_status(err);
+	bench_field_uint("sent", res->sent);
+	bench_field_uint("received", res->received);
+	bench_field_double("events_per_sec", 0, res->rate);
+	bench_field_double("lat_p50_us", 1, res->lat[0]);
+	bench_field_double("lat_p95_us", 1, res->lat[1]);
+	bench_field_double("lat_p99_us", 1, res->lat[2]);
+	bench_field_double("lat_max_us", 1, res->lat[3]);
+	bench_record_end();
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct bench_option options[] = {
+		{"device", 1, 'D', "sequencer name (default hw)"},
+		{"mode", 1, 'm', "comma separated delivery modes: direct, tick, real (default direct)"},
+		{"payload", 1, 'P', "comma separated payload sizes in bytes, 0 = fixed size events (default 0)"},
+		{"burst", 1, 'b', "comma separated events per output call (default 1, max 4096)"},
+		{"events", 1, 'e', "events per run (default 100000)"},
+		{"multi", 0, 'M', "send with snd_seq_event_output_multi()"},
+		{"batch", 0, 'B', "receive with snd_seq_event_input_batch()"},
+		{NULL},
+	};
+	unsigned int m, p, b;
+	int c, ret = 0;
+
+	while ((c = bench_getopt(argc, argv, "seq-bench", options)) != -1) {
+		switch (c) {
+		case 'D':
+			seq_name = optarg;
+			break;
+		case 'm': {
+			char *tmp = strdup(optarg), *tok, *save;
+			num_modes = 0;
+			for (tok = strtok_r(tmp, ",", &save); tok && num_modes < BENCH_MAX_LIST;
+			     tok = strtok_r(NULL, ",", &save)) {
+				int mode = parse_mode(tok);
+				if (mode < 0) {
+					fprintf(stderr, "unknown mode %s\n", tok);
+					return 1;
+				}
+				modes[num_modes++] = mode;
+			}
+			free(tmp);
+			break;
+		}
+		case 'P':
+			num_payloads = bench_parse_list(optarg, payloads);
+			break;
+		case 'b':
+			num_bursts = bench_parse_list(optarg, bursts);
+			for (b = 0; b < num_bursts; b++) {
+				if (bursts[b] < 1 || bursts[b] > MAX_BURST) {
+					fprintf(stderr, "invalid burst size %u\n", bursts[b]);
+					return 1;
+				}
+			}
+			break;
+		case 'e':
+			num_events = strtoul(optarg, NULL, 0);
+			break;
+		case 'M':
+			use_multi = 1;
+			break;
+		case 'B':
+			use_batch = 1;
+			break;
+		}
+	}
+	if (!num_events) {
+		fprintf(stderr, "no events to send\n");
+		return 1;
+	}
+
+	for (m = 0; m < num_modes; m++)
+		for (p = 0; p < num_payloads; p++)
+			for (b = 0; b < num_bursts; b++) {
+				struct result res;
+				int err = run(modes[m], payloads[p], bursts[b], &res);
+				print_result(modes[m], payloads[p], bursts[b], err, &res);
+				if (err < 0 || res.received < res.sent)
+					ret = 1;
+			}
+	return ret;
+}
@@ -0,0 +1,278 @@
+/*
+ *  Timer wakeup benchmark
+ *
+ *  Non-interactive companion of timer.c: every timer of the timer catalog
+ *  (or the timers named on the command line) is opened with
+ *  snd_timer_open() and run for a fixed time at each requested period.
+ *  Each wakeup is compared to the time the timer reports for it (the
+ *  ticks read times their resolution).  Every timer and period reports
+ *  the deviation percentiles, a histogram of the deviations, the lost
+ *  ticks and overruns from snd_timer_status() and the CPU time of the
+ *  process.
+ *
+ *  Timers that do not run by themselves (PCM timers of idle streams)
+ *  report no wakeups.
+ *
+ *  Example:
+ *    timer-bench -p 1000,5000,20000 -d 5 -j
+ *    timer-bench -t hw:CLASS=1,SCLASS=0,CARD=0,DEV=3,SUBDEV=0 -p 500
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include "../include/asoundlib.h"
+#include "bench.h"
+
+#define MAX_TIMERS	64
+
+/* upper bounds of the histogram buckets (us), the last one is open */
+static const double hist_bounds[] = { 10, 50, 100, 500, 1000, 5000 };
+#define HIST_BUCKETS	(sizeof(hist_bounds) / sizeof(hist_bounds[0]) + 1)
+
+struct result {
+	char id[64];
+	long resolution;		/* ns */
+	long ticks;			/* timer ticks per wakeup */
+	unsigned long wakeups;
+	unsigned long lost;
+	unsigned long overrun;
+	double dev[4];			/* |deviation| p50, p95, p99, max (us) */
+	double mean;			/* mean signed deviation (us) */
+	unsigned long hist[HIST_BUCKETS];
+	double cpu;			/* percent of the wall time */
+};
+
+static char *timers[MAX_TIMERS];
+static unsigned int num_timers;
+static unsigned int periods[BENCH_MAX_LIST] = { 1000 };
+static unsigned int num_periods = 1;
+static unsigned int duration = 2;
+
+/* the timers of the catalog, slave timers left out */
+static int list_timers(void)
+{
+	snd_timer_id_t *tid;
+	char name[128];
+	int err;
+
+	snd_timer_id_alloca(&tid);
+	snd_timer_id_set_class(tid, SND_TIMER_CLASS_NONE);
+	while (num_timers < MAX_TIMERS) {
+		if ((err = snd_timer_catalog_next(tid)) < 0)
+			return err;
+		if (snd_timer_id_get_class(tid) < 0)
+			break;
+		if (snd_timer_id_get_class(tid) == SND_TIMER_CLASS_SLAVE)
+			continue;
+		snprintf(name, sizeof(name), "hw:CLASS=%i,SCLASS=%i,CARD=%i,DEV=%i,SUBDEV=%i",
+			 snd_timer_id_get_class(tid), snd_timer_id_get_sclass(tid),
+			 snd_timer_id_get_card(tid), snd_timer_id_get_device(tid),
+			 snd_timer_id_get_subdevice(tid));
+		timers[num_timers++] = strdup(name);
+	}
+	return 0;
+}
+
+static void add_deviation(struct result *res, double *devs, double dev)
+{
+	double a = dev < 0 ? -dev : dev;
+	unsigned int b;
+
+	for (b = 0; b < HIST_BUCKETS - 1; b++)
+		if (a < hist_bounds[b])
+			break;
+	res->hist[b]++;
+	res->mean += dev;
+	devs[res->wakeups++] = a;
+}
+
+static int run(const char *name, unsigned int period, struct result *res)
+{
+	snd_timer_t *timer;
+	snd_timer_info_t *info;
+	snd_timer_params_t *params;
+	snd_timer_status_t *status;
+	snd_timer_read_t tr;
+	struct pollfd pfds[4];
+	double *devs = NULL, start, end, cpu, last, t;
+	unsigned long max_wakeups;
+	int err, npfds, started = 0;
+
+	memset(res, 0, sizeof(*res));
+	snd_timer_info_alloca(&info);
+	snd_timer_params_alloca(&params);
+	snd_timer_status_alloca(&status);
+	if ((err = snd_timer_open(&timer, name, SND_TIMER_OPEN_NONBLOCK)) < 0)
+		return err;
+	if ((err = snd_timer_info(timer, info)) < 0)
+		goto out;
+	snprintf(res->id, sizeof(res->id), "%s", snd_timer_info_get_id(info));
+	res->resolution = snd_timer_info_get_resolution(info);
+	if (res->resolution <= 0) {
+		err = -EINVAL;
+		goto out;
+	}
+	res->ticks = (period * 1000L) / res->resolution;
+	if (res->ticks < 1)
+		res->ticks = 1;
+	snd_timer_params_set_auto_start(params, 1);
+	snd_timer_params_set_ticks(params, res->ticks);
+	if ((err = snd_timer_params(timer, params)) < 0)
+		goto out;
+	/* room for the wakeups at the maximal rate of the timer */
+	max_wakeups = (unsigned long)duration * 1000000000UL /
+		      (res->ticks * res->resolution) + 16;
+	devs = malloc(max_wakeups * sizeof(*devs));
+	if (!devs) {
+		err = -ENOMEM;
+		goto out;
+	}
+	npfds = snd_timer_poll_descriptors(timer, pfds, 4);
+	cpu = bench_cpu_us();
+	start = last = bench_now_us();
+	end = start + duration * 1e6;
+	if ((err = snd_timer_start(timer)) < 0)
+		goto out;
+	started = 1;
+	while ((t = bench_now_us()) < end && res->wakeups < max_wakeups) {
+		err = poll(pfds, npfds, (int)((end - t) / 1000) + 1);
+		if (err < 0 && errno == EINTR)
+			continue;
+		if (err < 0) {
+			err = -errno;
+			goto out;
+		}
+		if (err == 0)
+			break;
+		t = bench_now_us();
+		while (snd_timer_read(timer, &tr, sizeof(tr)) == sizeof(tr)) {
+			double expected = (double)tr.ticks * tr.resolution / 1e3;
+			if (res->wakeups < max_wakeups)
+				add_deviation(res, devs, t - last - expected);
+			last = t;
+		}
+	}
+	err = 0;
+	res->cpu = (bench_cpu_us() - cpu) * 100.0 / (bench_now_us() - start);
+	if (snd_timer_status(timer, status) >= 0) {
+		res->lost = snd_timer_status_get_lost(status);
+		res->overrun = snd_timer_status_get_overrun(status);
+	}
+	if (res->wakeups)
+		res->mean /= res->wakeups;
+	bench_sort(devs, res->wakeups);
+	res->dev[0] = bench_percentile(devs, res->wakeups, 50);
+	res->dev[1] = bench_percentile(devs, res->wakeups, 95);
+	res->dev[2] = bench_percentile(devs, res->wakeups, 99);
+	res->dev[3] = res->wakeups ? devs[res->wakeups - 1] : 0;
+ out:
+	if (started)
+		snd_timer_stop(timer);
+	snd_timer_close(timer);
+	free(devs);
+	return err;
+}
+
+static void print_result(const char *name, unsigned int period, int err,
+			 const struct result *res)
+{
+	char hist[16];
+	unsigned int b;
+
+	bench_record_begin();
+	bench_field_str("timer", name);
+	bench_field_str("id", res->id);
+	bench_field_int("resolution_ns", res->resolution);
+	bench_field_uint("period_us", period);
+	bench_field_int("ticks", res->ticks);
+	bench_field_status(err);
+	bench_field_uint("wakeups", res->wakeups);
+	bench_field_uint("lost", res->lost);
+	bench_field_uint("overrun", res->overrun);
+	bench_field_double("dev_mean_us", 1, res->mean);
+	bench_field_double("dev_p50_us", 1, res->dev[0]);
+	bench_field_double("dev_p95_us", 1, res->dev[1]);
+	bench_field_double("dev_p99_us", 1, res->dev[2]);
+	bench_field_double("dev_max_us", 1, res->dev[3]);
+	for (b = 0; b < HIST_BUCKETS; b++) {
+		if (b < HIST_BUCKETS - 1)
+			snprintf(hist, sizeof(hist), "hist_lt%.0fus", hist_bounds[b]);
+		else
+			snprintf(hist, sizeof(hist), "hist_ge%.0fus", hist_bounds[b - 1]);
+		bench_field_uint(hist, res->hist[b]);
+	}
+	bench_field_double("cpu_pct", 2, res->cpu);
+	bench_record_end();
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct bench_option options[] = {
+		{"timer", 1, 't', "timer name, may be repeated (default all timers of the catalog)"},
+		{"period", 1, 'p', "comma separated wakeup periods in microseconds (default 1000)"},
+		{"duration", 1, 'd', "seconds per timer and period (default 2)"},
+		{NULL},
+	};
+	unsigned int t, p;
+	int c, err, ret = 0;
+
+	while ((c = bench_getopt(argc, argv, "timer-bench", options)) != -1) {
+		switch (c) {
+		case 't':
+			if (num_timers < MAX_TIMERS)
+				timers[num_timers++] = strdup(optarg);
+			break;
+		case 'p':
+			num_periods = bench_parse_list(optarg, periods);
+			for (p = 0; p < num_periods; p++) {
+				if (!periods[p]) {
+					fprintf(stderr, "invalid period 0\n");
+					return 1;
+				}
+			}
+			break;
+		case 'd':
+			duration = strtoul(optarg, NULL, 0);
+			break;
+		}
+	}
+	if (!duration) {
+		fprintf(stderr, "no duration\n");
+		return 1;
+	}
+	if (!num_timers && (err = list_timers()) < 0) {
+		fprintf(stderr, "unable to list the timers: %s\n", snd_strerror(err));
+		return 1;
+	}
+
+	for (t = 0; t < num_timers; t++)
+		for (p = 0; p < num_periods; p++) {
+			struct result res;
+			err = run(timers[t], periods[p], &res);
+			print_result(timers[t], periods[p], err, &res);
+			if (err < 0)
+				ret = 1;
+		}
+	for (t = 0; t < num_timers; t++)
+		free(timers[t]);
+	return ret;
+}
@@ -10,6 +10,7 @@
 #include "../include/asoundlib.h"
 #include <sound/tlv.h>
 #include <stdbool.h>
+#include <time.h>
 
 struct elem_set_trial {
 	snd_ctl_t *handle;
@@ -719,7 +720,139 @@ end:
 	return 0;
 }
 
-int main(void)
+/*
+ * Benchmark: many small element sets with TLV and initial values, created
+ * one by one through snd_ctl_add_integer_elem_set() and friends, and in
+ * one snd_ctl_add_elem_sets() call.
+ */
+#define BENCH_SETS	256
+#define BENCH_MEMBERS	2
+
+static unsigned int bench_drain_events(snd_ctl_t *handle)
+{
+	snd_ctl_event_t *event;
+	unsigned int count = 0;
+
+	snd_ctl_event_alloca(&event);
+	while (snd_ctl_read(handle, event) > 0)
+		count++;
+	return count;
+}
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench_remove(snd_ctl_t *handle, snd_ctl_elem_set_desc_t *descs)
+{
+	snd_ctl_elem_id_t *id;
+	unsigned int i;
+
+	snd_ctl_elem_id_alloca(&id);
+	for (i = 0; i < BENCH_SETS; i++) {
+		snd_ctl_elem_info_get_id(descs[i].info, id);
+		snd_ctl_elem_remove(handle, id);
+	}
+}
+
+static int bench_elem_sets(snd_ctl_t *handle, long initial)
+{
+	static const unsigned int tlv[4] = {
+		SNDRV_CTL_TLVT_DB_SCALE, 2 * sizeof(int), -5100, 100
+	};
+	snd_ctl_elem_set_desc_t *descs = NULL;
+	snd_ctl_elem_info_t *infos = NULL, *info;
+	snd_ctl_elem_value_t *value;
+	snd_ctl_elem_id_t *id;
+	snd_ctl_t *events;
+	unsigned int i, j, count;
+	double start;
+	int err;
+
+	err = snd_ctl_open(&events, "hw:0", SND_CTL_NONBLOCK);
+	if (err < 0)
+		return err;
+	err = snd_ctl_subscribe_events(events, 1);
+	if (err < 0)
+		goto end;
+
+	infos = calloc(BENCH_SETS, snd_ctl_elem_info_sizeof());
+	descs = calloc(BENCH_SETS, sizeof(*descs));
+	if (infos == NULL || descs == NULL) {
+		err = -ENOMEM;
+		goto end;
+	}
+	snd_ctl_elem_id_alloca(&id);
+	snd_ctl_elem_value_alloca(&value);
+	for (j = 0; j < BENCH_MEMBERS; j++)
+		snd_ctl_elem_value_set_integer(value, j, initial);
+
+	for (i = 0; i < BENCH_SETS; i++) {
+		char name[44];
+
+		info = (void *)((char *)infos + i * snd_ctl_elem_info_sizeof());
+		snprintf(name, sizeof(name), "userspace-bench-%u", i);
+		snd_ctl_elem_info_set_interface(info, SND_CTL_ELEM_IFACE_MIXER);
+		snd_ctl_elem_info_set_name(info, name);
+		descs[i].info = info;
+		descs[i].type = SND_CTL_ELEM_TYPE_INTEGER;
+		descs[i].element_count = 1;
+		descs[i].member_count = BENCH_MEMBERS;
+		descs[i].max = 100;
+		descs[i].step = 1;
+		descs[i].tlv = tlv;
+		descs[i].value = value;
+	}
+
+	/* one call per operation */
+	start = bench_now();
+	for (i = 0; i < BENCH_SETS; i++) {
+		info = descs[i].info;
+		err = snd_ctl_add_integer_elem_set(handle, info, 1,
+						   BENCH_MEMBERS, 0, 100, 1);
+		if (err < 0)
+			break;
+		snd_ctl_elem_info_get_id(info, id);
+		err = snd_ctl_elem_tlv_write(handle, id, tlv);
+		if (err >= 0) {
+			snd_ctl_elem_value_set_id(value, id);
+			err = snd_ctl_elem_write(handle, value);
+		}
+		if (err < 0)
+			break;
+	}
+	printf("initial %ld, single: %8.1f us/set, %u events\n", initial,
+	       (bench_now() - start) * 1e6 / BENCH_SETS,
+	       bench_drain_events(events));
+	bench_remove(handle, descs);
+	bench_drain_events(events);
+	if (err < 0)
+		goto end;
+
+	start = bench_now();
+	count = snd_ctl_add_elem_sets(handle, descs, BENCH_SETS);
+	printf("initial %ld, bulk:   %8.1f us/set, %u events\n", initial,
+	       (bench_now() - start) * 1e6 / BENCH_SETS,
+	       bench_drain_events(events));
+	bench_remove(handle, descs);
+	for (i = 0; count != BENCH_SETS && i < BENCH_SETS; i++) {
+		if (descs[i].result < 0) {
+			err = descs[i].result;
+			break;
+		}
+	}
+end:
+	free(descs);
+	free(infos);
+	snd_ctl_close(events);
+	return err < 0 ? err : 0;
+}
+
+int main(int argc, char *argv[])
 {
 	struct elem_set_trial trial = {0};
 	unsigned int i;
@@ -731,6 +864,15 @@ int main(void)
 	if (err < 0)
 		return EXIT_FAILURE;
 
+	if (argc > 1 && !strcmp(argv[1], "--bench")) {
+		err = bench_elem_sets(trial.handle, 0);
+		if (err >= 0)
+			err = bench_elem_sets(trial.handle, 50);
+		if (err < 0)
+			printf("%s\n", snd_strerror(err));
+		return err < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
 	err = snd_ctl_subscribe_events(trial.handle, 1);
 	if (err < 0)
 		return EXIT_FAILURE;